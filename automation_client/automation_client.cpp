@@ -0,0 +1,1101 @@
+/* automation_client.cpp -- C++ client for Mednafen's automation socket
+ *
+ * Framing (see the header comment of src/drivers/automation.cpp):
+ *   "<n>\n" + n bytes   text ack of the command just sent
+ *   "#<n>\n" + n bytes  binary reply (read_mem, read_regs), before its text ack
+ *   "!<n>\n" + n bytes  pushed event (after "subscribe on")
+ * Every text message ends with " cycle=N seq=M\n".
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#include "automation_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET sock_t;
+#define SOCK_INVALID INVALID_SOCKET
+#define sock_close closesocket
+#define sock_poll WSAPoll
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <errno.h>
+typedef int sock_t;
+#define SOCK_INVALID (-1)
+#define sock_close close
+#define sock_poll poll
+#endif
+
+namespace AutomationClient
+{
+
+static const intptr_t NoSocket = (intptr_t)SOCK_INVALID;
+
+std::string Ack::Field(const std::string& key) const
+{
+ const std::string line = FirstLine();
+ size_t pos = 0;
+
+ while (pos < line.size()) {
+  size_t end = line.find(' ', pos);
+  if (end == std::string::npos)
+   end = line.size();
+  if (end - pos > key.size() && line.compare(pos, key.size(), key) == 0 && line[pos + key.size()] == '=')
+   return line.substr(pos + key.size() + 1, end - pos - key.size() - 1);
+  pos = end + 1;
+ }
+ return std::string();
+}
+
+uint64_t Ack::FieldU64(const std::string& key, uint64_t def) const
+{
+ const std::string v = Field(key);
+ if (v.empty())
+  return def;
+ return strtoull(v.c_str(), nullptr, 0);
+}
+
+// Split " cycle=N seq=M" off the end of a text message.
+static void parse_text(const std::string& body, Ack* ack)
+{
+ std::string t = body;
+ while (!t.empty() && (t.back() == '\n' || t.back() == '\r'))
+  t.pop_back();
+
+ const size_t c = t.rfind(" cycle=");
+ const size_t s = t.rfind(" seq=");
+ if (c != std::string::npos && s != std::string::npos && s > c) {
+  ack->cycle = strtoll(t.c_str() + c + 7, nullptr, 10);
+  ack->seq = strtoull(t.c_str() + s + 5, nullptr, 10);
+  t.resize(c);
+ }
+ ack->text = t;
+}
+
+// Pauses are "break ...", "done ..." and pause-mode "hit ..." (which carry
+// the register dump on further lines); a single-line "hit" is log mode, and
+// "done save_state" only reports a background write finishing.
+static bool is_pause(const Ack& ack)
+{
+ const std::string& t = ack.text;
+ if (!t.compare(0, 16, "done save_state "))
+  return false;
+ if (!t.compare(0, 6, "break ") || !t.compare(0, 5, "done "))
+  return true;
+ return !t.compare(0, 4, "hit ") && t.find('\n') != std::string::npos;
+}
+
+static std::string hex32(uint32_t v)
+{
+ char buf[16];
+ snprintf(buf, sizeof(buf), "%08X", v);
+ return buf;
+}
+
+static std::string sock_error(const char* what)
+{
+#ifdef _WIN32
+ return std::string(what) + ": winsock error " + std::to_string(WSAGetLastError());
+#else
+ return std::string(what) + ": " + strerror(errno);
+#endif
+}
+
+Client::Client() : fd(NoSocket), timeout_ms(30000)
+{
+
+}
+
+Client::~Client()
+{
+ Close();
+}
+
+bool Client::Connected(void) const
+{
+ return fd != NoSocket;
+}
+
+void Client::Close(void)
+{
+ if (fd != NoSocket) {
+  sock_close((sock_t)fd);
+  fd = NoSocket;
+ }
+ rx.clear();
+ events.clear();
+}
+
+void Client::Connect(const std::string& spec, unsigned connect_timeout_ms)
+{
+ sock_t s = SOCK_INVALID;
+
+ Close();
+
+#ifdef _WIN32
+ static bool wsa_started = false;
+ if (!wsa_started) {
+  WSADATA wsa;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa))
+   throw Error("WSAStartup failed");
+  wsa_started = true;
+ }
+#endif
+
+ if (spec.compare(0, 4, "tcp:") == 0) {
+  std::string host = "127.0.0.1", port = spec.substr(4);
+  const size_t colon = port.rfind(':');
+  if (colon != std::string::npos) {
+   host = port.substr(0, colon);
+   port = port.substr(colon + 1);
+  }
+
+  struct addrinfo hints, *res = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) || !res)
+   throw Error("automation client: can't resolve " + spec);
+
+  // The emulator may still be starting up; retry until connect_timeout_ms.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connect_timeout_ms);
+  for (;;) {
+   s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+   if (s == SOCK_INVALID) {
+    freeaddrinfo(res);
+    throw Error(sock_error("socket"));
+   }
+   if (connect(s, res->ai_addr, (int)res->ai_addrlen) == 0)
+    break;
+   sock_close(s);
+   s = SOCK_INVALID;
+   if (std::chrono::steady_clock::now() >= deadline) {
+    freeaddrinfo(res);
+    throw Error(sock_error(("connect " + spec).c_str()));
+   }
+#ifdef _WIN32
+   Sleep(50);
+#else
+   usleep(50000);
+#endif
+  }
+  freeaddrinfo(res);
+
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+ }
+ else {
+#ifdef _WIN32
+  throw Error("automation client: only tcp:<port> sockets are supported on Windows");
+#else
+  struct sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  if (spec.size() >= sizeof(sa.sun_path))
+   throw Error("automation client: socket path too long: " + spec);
+  memcpy(sa.sun_path, spec.c_str(), spec.size());
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connect_timeout_ms);
+  for (;;) {
+   if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) == SOCK_INVALID)
+    throw Error(sock_error("socket"));
+   if (connect(s, (struct sockaddr*)&sa, sizeof(sa)) == 0)
+    break;
+   sock_close(s);
+   s = SOCK_INVALID;
+   if (std::chrono::steady_clock::now() >= deadline)
+    throw Error(sock_error(("connect " + spec).c_str()));
+   usleep(50000);
+  }
+#endif
+ }
+
+ fd = (intptr_t)s;
+
+ const Ack ack = Command("subscribe on");
+ if (ack.text.compare(0, 12, "ok subscribe")) {
+  Close();
+  throw Error("automation client: subscribe failed: " + ack.text);
+ }
+}
+
+void Client::Send(const std::string& line)
+{
+ if (fd == NoSocket)
+  throw Error("automation client: not connected");
+
+ const std::string data = line + "\n";
+ const char* p = data.data();
+ size_t left = data.size();
+
+ while (left) {
+#if defined(_WIN32)
+  const int n = send((sock_t)fd, p, (int)left, 0);
+#elif defined(MSG_NOSIGNAL)
+  const ssize_t n = send((sock_t)fd, p, left, MSG_NOSIGNAL);
+#else
+  const ssize_t n = send((sock_t)fd, p, left, 0);
+#endif
+  if (n <= 0) {
+#ifndef _WIN32
+   if (n < 0 && errno == EINTR)
+    continue;
+#endif
+   const std::string err = sock_error("send");
+   Close();
+   throw Error(err);
+  }
+  p += n;
+  left -= n;
+ }
+}
+
+// Receive until rx holds need bytes, or (need == 0) a '\n'. Returns false on
+// timeout; ms == 0 means no wait when polling and no limit otherwise.
+bool Client::Fill(size_t need, unsigned ms)
+{
+ const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+ while (need ? (rx.size() < need) : (rx.find('\n') == std::string::npos)) {
+  if (ms) {
+   const auto now = std::chrono::steady_clock::now();
+   if (now >= deadline)
+    return false;
+
+   struct pollfd pfd;
+   pfd.fd = (sock_t)fd;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+   const int wait = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+   const int r = sock_poll(&pfd, 1, wait);
+   if (r == 0)
+    continue;
+#ifndef _WIN32
+   if (r < 0 && errno == EINTR)
+    continue;
+#endif
+   if (r < 0) {
+    const std::string err = sock_error("poll");
+    Close();
+    throw Error(err);
+   }
+  }
+
+  char buf[65536];
+#ifdef _WIN32
+  const int n = recv((sock_t)fd, buf, sizeof(buf), 0);
+#else
+  const ssize_t n = recv((sock_t)fd, buf, sizeof(buf), 0);
+  if (n < 0 && errno == EINTR)
+   continue;
+#endif
+  if (n <= 0) {
+   const std::string err = n ? sock_error("recv") : std::string("automation client: connection closed");
+   Close();
+   throw Error(err);
+  }
+  rx.append(buf, n);
+ }
+ return true;
+}
+
+Client::FrameKind Client::ReadFrame(std::string* payload, unsigned ms)
+{
+ if (fd == NoSocket)
+  throw Error("automation client: not connected");
+
+ if (!Fill(0, ms))
+  throw Error("automation client: timed out waiting for the emulator");
+
+ const size_t nl = rx.find('\n');
+ FrameKind kind = Frame_Ack;
+ size_t p = 0;
+
+ if (rx[0] == '#') { kind = Frame_Bin; p = 1; }
+ else if (rx[0] == '!') { kind = Frame_Event; p = 1; }
+
+ char* end;
+ const unsigned long long n = strtoull(rx.c_str() + p, &end, 10);
+ if (end != rx.c_str() + nl || end == rx.c_str() + p) {
+  Close();
+  throw Error("automation client: bad frame header");
+ }
+
+ // Fill() counts from the start of rx; the header is still in it.
+ if (!Fill(nl + 1 + n, ms))
+  throw Error("automation client: timed out waiting for the emulator");
+
+ payload->assign(rx, nl + 1, n);
+ rx.erase(0, nl + 1 + n);
+ return kind;
+}
+
+Ack Client::Command(const std::string& line, std::vector<uint8_t>* bin_sink)
+{
+ std::string payload;
+
+ Send(line);
+ for (;;) {
+  switch (ReadFrame(&payload, timeout_ms)) {
+   case Frame_Bin:
+	if (bin_sink)
+	 bin_sink->insert(bin_sink->end(), payload.begin(), payload.end());
+	break;
+
+   case Frame_Event:
+	{
+	 Event ev;
+	 parse_text(payload, &ev);
+	 ev.paused = is_pause(ev);
+	 events.push_back(ev);
+	}
+	break;
+
+   case Frame_Ack:
+	{
+	 Ack ack;
+	 parse_text(payload, &ack);
+	 return ack;
+	}
+  }
+ }
+}
+
+bool Client::NextEvent(Event* ev, unsigned ms)
+{
+ std::string payload;
+
+ while (events.empty()) {
+  if (ms == 0) {
+   // Poll: take what's already buffered or readable right now.
+   if (rx.find('\n') == std::string::npos) {
+    struct pollfd pfd;
+    pfd.fd = (sock_t)fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (fd == NoSocket || sock_poll(&pfd, 1, 0) <= 0)
+     return false;
+   }
+   ms = 1;
+  }
+  try {
+   if (ReadFrame(&payload, ms) != Frame_Event)
+    continue;	// stray reply to a command we gave up on
+  }
+  catch (Error&) {
+   if (fd != NoSocket)
+    return false;	// timeout
+   throw;
+  }
+  Event e;
+  parse_text(payload, &e);
+  e.paused = is_pause(e);
+  events.push_back(e);
+ }
+
+ *ev = events.front();
+ events.pop_front();
+ return true;
+}
+
+Event Client::WaitStop(void)
+{
+ for (auto it = events.begin(); it != events.end(); ++it) {
+  if (it->paused) {
+   const Event ev = *it;
+   events.erase(it);
+   return ev;
+  }
+ }
+
+ std::string payload;
+ for (;;) {
+  if (ReadFrame(&payload, timeout_ms) != Frame_Event)
+   continue;
+  Event ev;
+  parse_text(payload, &ev);
+  ev.paused = is_pause(ev);
+  if (ev.paused)
+   return ev;
+  events.push_back(ev);
+ }
+}
+
+Ack Client::Check(const Ack& ack)
+{
+ if (ack.IsError())
+  throw Error(ack.text);
+ return ack;
+}
+
+// Send a command that resumes emulation and wait for the pause that ends it.
+// Pauses queued before its ack belong to an earlier command and are skipped.
+Event Client::RunCommand(const std::string& line)
+{
+ const Ack ack = Check(Command(line));
+
+ if (ack.text.compare(0, 8, "warning ") == 0) {
+  // e.g. run_to_cycle with a target already reached: still paused, no event follows.
+  Event ev;
+  ev.text = ack.text;
+  ev.cycle = ack.cycle;
+  ev.seq = ack.seq;
+  ev.paused = true;
+  return ev;
+ }
+
+ for (;;) {
+  const Event ev = WaitStop();
+  if (ev.seq > ack.seq)
+   return ev;
+ }
+}
+
+Event Client::Step(uint64_t n)
+{
+ return RunCommand("step " + std::to_string(n));
+}
+
+Event Client::StepSlave(uint64_t n)
+{
+ return RunCommand("step_slave " + std::to_string(n));
+}
+
+Event Client::StepOver(void)
+{
+ return RunCommand("step_over");
+}
+
+Event Client::StepOut(void)
+{
+ return RunCommand("step_out");
+}
+
+Event Client::FrameAdvance(uint64_t n)
+{
+ return RunCommand("frame_advance " + std::to_string(n));
+}
+
+Event Client::RunToFrame(uint64_t frame)
+{
+ return RunCommand("run_to_frame " + std::to_string(frame));
+}
+
+Event Client::RunToCycle(int64_t cycle)
+{
+ return RunCommand("run_to_cycle " + std::to_string(cycle));
+}
+
+void Client::Run(void)
+{
+ // "run" has no ack; the next thing to arrive is whatever pauses it.
+ Send("run");
+}
+
+Ack Client::Pause(void)
+{
+ return Check(Command("pause"));
+}
+
+void Client::AddBreakpoint(uint32_t addr, CPU cpu, const std::string& cond, bool log)
+{
+ std::string line = "breakpoint " + hex32(addr);
+ if (log)
+  line += " log";
+ if (cpu == CPU_Slave)
+  line += " slave";
+ if (!cond.empty())
+  line += " if " + cond;
+ Check(Command(line));
+}
+
+bool Client::RemoveBreakpoint(uint32_t addr, CPU cpu)
+{
+ static const std::string not_found = "error breakpoint_remove: not found";
+ const Ack ack = Command("breakpoint_remove " + hex32(addr) + (cpu == CPU_Slave ? " slave" : ""));
+ if (ack.text.compare(0, not_found.size(), not_found) == 0)
+  return false;
+ Check(ack);
+ return true;
+}
+
+void Client::ClearBreakpoints(void)
+{
+ Check(Command("breakpoint_clear"));
+}
+
+void Client::ReadMem(uint32_t addr, void* dest, uint32_t size)
+{
+ ReadMem(std::vector<std::pair<uint32_t, uint32_t>>(1, std::make_pair(addr, size)), dest);
+}
+
+void Client::ReadMem(const std::vector<std::pair<uint32_t, uint32_t>>& ranges, void* dest)
+{
+ std::string line = "read_mem";
+ uint64_t total = 0;
+ std::vector<uint8_t> bin;
+
+ for (const auto& r : ranges) {
+  line += " " + hex32(r.first) + " " + hex32(r.second);
+  total += r.second;
+ }
+ bin.reserve((size_t)total);
+ Check(Command(line, &bin));
+ if (bin.size() != total)
+  throw Error("automation client: read_mem returned " + std::to_string(bin.size()) + " bytes, expected " + std::to_string(total));
+ if (total)
+  memcpy(dest, bin.data(), (size_t)total);
+}
+
+void Client::WriteMem(uint32_t addr, const void* data, uint32_t size)
+{
+ static const char digits[] = "0123456789ABCDEF";
+ const uint8_t* p = (const uint8_t*)data;
+ std::string line = "write_mem_bin " + hex32(addr) + " hex:";
+
+ line.reserve(line.size() + size * 2);
+ for (uint32_t i = 0; i < size; i++) {
+  line += digits[p[i] >> 4];
+  line += digits[p[i] & 0xF];
+ }
+ Check(Command(line));
+}
+
+void Client::Poke(uint32_t addr, const void* data, uint32_t size)
+{
+ const uint8_t* p = (const uint8_t*)data;
+ std::string line = "poke " + hex32(addr);
+
+ for (uint32_t i = 0; i < size; i++) {
+  char buf[4];
+  snprintf(buf, sizeof(buf), " %02X", p[i]);
+  line += buf;
+ }
+ Check(Command(line));
+}
+
+void Client::ReadRegs(CPU cpu, Regs* regs)
+{
+ std::vector<uint8_t> bin;
+
+ Check(Command(cpu == CPU_Slave ? "read_regs slave" : "read_regs master", &bin));
+ if (bin.size() != sizeof(regs->r))
+  throw Error("automation client: read_regs returned " + std::to_string(bin.size()) + " bytes");
+ memcpy(regs->r, bin.data(), sizeof(regs->r));	// host byte order on both ends
+}
+
+int64_t Client::Cycle(void)
+{
+ return (int64_t)Check(Command("dump_cycle")).FieldU64("value");
+}
+
+uint64_t Client::SnapSave(unsigned slot, int base)
+{
+ std::string line = "snap_save " + std::to_string(slot);
+ if (base >= 0)
+  line += " " + std::to_string(base);
+ return Check(Command(line)).FieldU64("bytes");
+}
+
+void Client::SnapLoad(unsigned slot)
+{
+ Check(Command("snap_load " + std::to_string(slot)));
+}
+
+void Client::SnapFree(unsigned slot)
+{
+ Check(Command("snap_free " + std::to_string(slot)));
+}
+
+void Client::SaveState(const std::string& path)
+{
+ Check(Command("save_state " + path));
+}
+
+void Client::LoadState(const std::string& path)
+{
+ Check(Command("load_state " + path));
+}
+
+void Client::Quit(void)
+{
+ try {
+  Command("quit");
+ }
+ catch (Error&) {
+  // The emulator may close the socket before the ack gets out.
+ }
+ Close();
+}
+
+//
+// Batch
+//
+
+// Read-only view of one instance's obs_expose file (ObsHeader in
+// src/drivers/automation.cpp: seq at 32, pixels at data_offset).
+struct Batch::ObsMap
+{
+ const uint8_t* base = nullptr;
+ size_t size = 0;
+#ifdef _WIN32
+ HANDLE file = INVALID_HANDLE_VALUE;
+ HANDLE map = NULL;
+#endif
+
+ ~ObsMap()
+ {
+#ifdef _WIN32
+  if (base) UnmapViewOfFile(base);
+  if (map) CloseHandle(map);
+  if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+  if (base) munmap((void*)base, size);
+#endif
+ }
+
+ void Open(const std::string& path)
+ {
+#ifdef _WIN32
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+   throw Error("automation client: cannot open " + path);
+  LARGE_INTEGER len;
+  GetFileSizeEx(file, &len);
+  size = (size_t)len.QuadPart;
+  map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (map)
+   base = (const uint8_t*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, size);
+  if (!base)
+   throw Error("automation client: cannot map " + path);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+   throw Error("automation client: cannot open " + path + ": " + strerror(errno));
+  size = (size_t)lseek(fd, 0, SEEK_END);
+  void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+   throw Error("automation client: cannot map " + path + ": " + strerror(errno));
+  base = (const uint8_t*)p;
+#endif
+ }
+};
+
+static void check_ack(const Ack& ack)
+{
+ if (ack.IsError())
+  throw Error(ack.text);
+}
+
+Batch::Batch() : obs_bytes(0), ram_bytes(0), action_port(0), reset_slot(-1), job(nullptr), generation(0), running(0), quit(false)
+{
+}
+
+Batch::~Batch()
+{
+ Close();
+}
+
+void Batch::Open(const std::vector<std::string>& specs, const std::string& obs_dir,
+                 unsigned obs_w, unsigned obs_h, bool obs_rgb, unsigned connect_timeout_ms)
+{
+ Close();
+
+ const size_t n = specs.size();
+ for (size_t i = 0; i < n; i++) {
+  clients.push_back(new Client);
+  obs_maps.push_back(new ObsMap);
+ }
+ reset_obs.resize(n);
+ reset_ram.resize(n);
+ errors.resize(n);
+ obs_bytes = (size_t)obs_w * obs_h * (obs_rgb ? 3 : 1);
+ quit = false;
+ for (size_t i = 0; i < n; i++)
+  workers.push_back(std::thread(&Batch::Worker, this, i));
+
+ try {
+  RunAll([&](size_t i) {
+   const std::string path = obs_dir + "/mdfn_obs_" + std::to_string(i);
+   clients[i]->Connect(specs[i], connect_timeout_ms);
+   check_ack(clients[i]->Command("obs_expose " + path + " w=" + std::to_string(obs_w) + " h=" + std::to_string(obs_h)
+                                         + (obs_rgb ? " rgb" : " gray")));
+   obs_maps[i]->Open(path);
+  });
+ }
+ catch (...) {
+  Close();
+  throw;
+ }
+}
+
+void Batch::Close(void)
+{
+ {
+  std::lock_guard<std::mutex> g(lock);
+  quit = true;
+ }
+ wake.notify_all();
+ for (std::thread& t : workers)
+  t.join();
+ workers.clear();
+
+ for (ObsMap* m : obs_maps)
+  delete m;
+ obs_maps.clear();
+ for (Client* c : clients) {
+  if (c->Connected()) {
+   try {
+    c->Command("obs_close");
+   }
+   catch (Error&) {
+   }
+  }
+  delete c;
+ }
+ clients.clear();
+ reset_obs.clear();
+ reset_ram.clear();
+ errors.clear();
+ ram_ranges.clear();
+ obs_bytes = ram_bytes = 0;
+ reset_slot = -1;
+}
+
+void Batch::Worker(size_t i)
+{
+ uint64_t seen = 0;
+ std::unique_lock<std::mutex> g(lock);
+
+ for (;;) {
+  wake.wait(g, [&]() { return quit || generation != seen; });
+  if (quit)
+   return;
+  seen = generation;
+  const std::function<void(size_t)>* f = job;
+  g.unlock();
+  std::string err;
+  try {
+   (*f)(i);
+  }
+  catch (std::exception& e) {
+   err = e.what();
+  }
+  g.lock();
+  errors[i] = err;
+  if (!--running)
+   finished.notify_all();
+ }
+}
+
+// Run job(i) for every instance on its worker; rethrow the first failure.
+void Batch::RunAll(const std::function<void(size_t)>& f)
+{
+ std::unique_lock<std::mutex> g(lock);
+
+ job = &f;
+ running = clients.size();
+ generation++;
+ wake.notify_all();
+ finished.wait(g, [&]() { return running == 0; });
+ job = nullptr;
+
+ for (size_t i = 0; i < errors.size(); i++)
+  if (!errors[i].empty())
+   throw Error("instance " + std::to_string(i) + ": " + errors[i]);
+}
+
+void Batch::CopyObs(size_t i, uint8_t* dest) const
+{
+ const uint8_t* base = obs_maps[i]->base;
+ uint32_t data_offset;
+
+ memcpy(&data_offset, base + 12, sizeof(data_offset));
+ if (data_offset + obs_bytes > obs_maps[i]->size)
+  throw Error("automation client: observation mapping too small");
+ // The instance is paused here, so the seqlock can only be mid-update if it
+ // was when the pause began; check anyway.
+ for (;;) {
+  const uint64_t seq = *(const volatile uint64_t*)(base + 32);
+  memcpy(dest, base + data_offset, obs_bytes);
+  if (!(seq & 1) && *(const volatile uint64_t*)(base + 32) == seq)
+   return;
+  std::this_thread::yield();
+ }
+}
+
+void Batch::Command(const std::string& line)
+{
+ RunAll([&](size_t i) { check_ack(clients[i]->Command(line)); });
+}
+
+void Batch::SetRamFeatures(const std::vector<std::pair<uint32_t, uint32_t>>& ranges)
+{
+ ram_ranges = ranges;
+ ram_bytes = 0;
+ for (const auto& r : ranges)
+  ram_bytes += r.second;
+}
+
+void Batch::SaveReset(unsigned slot)
+{
+ RunAll([&](size_t i) {
+  clients[i]->SnapSave(slot);
+  reset_obs[i].resize(obs_bytes);
+  CopyObs(i, reset_obs[i].data());
+  reset_ram[i].resize(ram_bytes);
+  if (ram_bytes)
+   clients[i]->ReadMem(ram_ranges, reset_ram[i].data());
+ });
+ reset_slot = slot;
+}
+
+// A loaded snapshot doesn't redraw the framebuffer, so the observation (and
+// RAM features, for ranges set after SaveReset too) come from SaveReset.
+void Batch::Reset(const uint8_t* mask, uint8_t* obs, uint8_t* ram)
+{
+ if (reset_slot < 0)
+  throw Error("automation client: Reset() before SaveReset()");
+ RunAll([&](size_t i) {
+  if (mask && !mask[i])
+   return;
+  clients[i]->SnapLoad(reset_slot);
+  if (obs)
+   memcpy(obs + i * obs_bytes, reset_obs[i].data(), obs_bytes);
+  if (ram && ram_bytes) {
+   if (reset_ram[i].size() == ram_bytes)
+    memcpy(ram + i * ram_bytes, reset_ram[i].data(), ram_bytes);
+   else
+    clients[i]->ReadMem(ram_ranges, ram + i * ram_bytes);
+  }
+ });
+}
+
+void Batch::Step(const uint8_t* actions, size_t action_size, unsigned frames, uint8_t* obs, uint8_t* ram, uint8_t* done)
+{
+ static const char digits[] = "0123456789ABCDEF";
+
+ RunAll([&](size_t i) {
+  Client& c = *clients[i];
+  if (actions && action_size) {
+   std::string line = "input_port " + std::to_string(action_port) + " ";
+   const uint8_t* a = actions + i * action_size;
+   for (size_t j = 0; j < action_size; j++) {
+    line += digits[a[j] >> 4];
+    line += digits[a[j] & 0xF];
+   }
+   check_ack(c.Command(line));
+  }
+  const Event ev = c.FrameAdvance(std::max(1u, frames));
+  if (done)
+   done[i] = ev.text.compare(0, 19, "done frame_advance ") != 0;
+  if (obs)
+   CopyObs(i, obs + i * obs_bytes);
+  if (ram && ram_bytes)
+   c.ReadMem(ram_ranges, ram + i * ram_bytes);
+ });
+}
+
+}
+
+//
+// C API
+//
+using namespace AutomationClient;
+
+struct mdfn_ac
+{
+ Client client;
+ std::string error;
+};
+
+template<typename T, typename F>
+static int guarded(T* c, F f)
+{
+ try {
+  f();
+  c->error.clear();
+  return 0;
+ }
+ catch (std::exception& e) {
+  c->error = e.what();
+  return -1;
+ }
+}
+
+static void copy_out(const std::string& s, char* out, size_t out_size)
+{
+ if (!out || !out_size)
+  return;
+ const size_t n = std::min(s.size(), out_size - 1);
+ memcpy(out, s.data(), n);
+ out[n] = 0;
+}
+
+extern "C" mdfn_ac* mdfn_ac_connect(const char* spec, unsigned timeout_ms)
+{
+ mdfn_ac* c = new mdfn_ac;
+
+ guarded(c, [&]() { c->client.Connect(spec, timeout_ms); });
+ return c;	// check mdfn_ac_error() for a failed connect
+}
+
+extern "C" void mdfn_ac_close(mdfn_ac* c)
+{
+ delete c;
+}
+
+extern "C" const char* mdfn_ac_error(mdfn_ac* c)
+{
+ return c->error.empty() ? nullptr : c->error.c_str();
+}
+
+extern "C" int mdfn_ac_command(mdfn_ac* c, const char* line, char* out, size_t out_size)
+{
+ return guarded(c, [&]() { copy_out(c->client.Command(line).text, out, out_size); });
+}
+
+extern "C" int mdfn_ac_wait_stop(mdfn_ac* c, char* out, size_t out_size)
+{
+ return guarded(c, [&]() { copy_out(c->client.WaitStop().text, out, out_size); });
+}
+
+extern "C" int mdfn_ac_step(mdfn_ac* c, uint64_t n, char* out, size_t out_size)
+{
+ return guarded(c, [&]() { copy_out(c->client.Step(n).text, out, out_size); });
+}
+
+extern "C" int mdfn_ac_frame_advance(mdfn_ac* c, uint64_t n, char* out, size_t out_size)
+{
+ return guarded(c, [&]() { copy_out(c->client.FrameAdvance(n).text, out, out_size); });
+}
+
+extern "C" int mdfn_ac_add_breakpoint(mdfn_ac* c, uint32_t addr, int slave, const char* cond)
+{
+ return guarded(c, [&]() { c->client.AddBreakpoint(addr, slave ? CPU_Slave : CPU_Master, cond ? cond : ""); });
+}
+
+extern "C" int mdfn_ac_remove_breakpoint(mdfn_ac* c, uint32_t addr, int slave)
+{
+ bool removed = false;
+ if (guarded(c, [&]() { removed = c->client.RemoveBreakpoint(addr, slave ? CPU_Slave : CPU_Master); }))
+  return -1;
+ return removed ? 0 : 1;
+}
+
+extern "C" int mdfn_ac_read_mem(mdfn_ac* c, uint32_t addr, void* dest, uint32_t size)
+{
+ return guarded(c, [&]() { c->client.ReadMem(addr, dest, size); });
+}
+
+extern "C" int mdfn_ac_write_mem(mdfn_ac* c, uint32_t addr, const void* data, uint32_t size)
+{
+ return guarded(c, [&]() { c->client.WriteMem(addr, data, size); });
+}
+
+extern "C" int mdfn_ac_read_regs(mdfn_ac* c, int slave, uint32_t* regs22)
+{
+ return guarded(c, [&]() {
+  Regs r;
+  c->client.ReadRegs(slave ? CPU_Slave : CPU_Master, &r);
+  memcpy(regs22, r.r, sizeof(r.r));
+ });
+}
+
+extern "C" int mdfn_ac_snap_save(mdfn_ac* c, unsigned slot, int base)
+{
+ return guarded(c, [&]() { c->client.SnapSave(slot, base); });
+}
+
+extern "C" int mdfn_ac_snap_load(mdfn_ac* c, unsigned slot)
+{
+ return guarded(c, [&]() { c->client.SnapLoad(slot); });
+}
+
+struct mdfn_ac_batch
+{
+ Batch batch;
+ std::string error;
+};
+
+extern "C" mdfn_ac_batch* mdfn_ac_batch_open(const char* const* specs, unsigned n, const char* obs_dir,
+                                             unsigned obs_w, unsigned obs_h, int obs_rgb, unsigned timeout_ms)
+{
+ mdfn_ac_batch* b = new mdfn_ac_batch;
+
+ guarded(b, [&]() { b->batch.Open(std::vector<std::string>(specs, specs + n), obs_dir, obs_w, obs_h, obs_rgb != 0, timeout_ms); });
+ return b;	// check mdfn_ac_batch_error()
+}
+
+extern "C" void mdfn_ac_batch_close(mdfn_ac_batch* b)
+{
+ delete b;
+}
+
+extern "C" const char* mdfn_ac_batch_error(mdfn_ac_batch* b)
+{
+ return b->error.empty() ? nullptr : b->error.c_str();
+}
+
+extern "C" size_t mdfn_ac_batch_obs_bytes(mdfn_ac_batch* b)
+{
+ return b->batch.ObsBytes();
+}
+
+extern "C" size_t mdfn_ac_batch_ram_bytes(mdfn_ac_batch* b)
+{
+ return b->batch.RamBytes();
+}
+
+extern "C" int mdfn_ac_batch_command(mdfn_ac_batch* b, const char* line)
+{
+ return guarded(b, [&]() { b->batch.Command(line); });
+}
+
+extern "C" int mdfn_ac_batch_set_ram(mdfn_ac_batch* b, const uint32_t* ranges, unsigned n_ranges)
+{
+ return guarded(b, [&]() {
+  std::vector<std::pair<uint32_t, uint32_t>> r;
+  for (unsigned i = 0; i < n_ranges; i++)
+   r.push_back(std::make_pair(ranges[i * 2], ranges[i * 2 + 1]));
+  b->batch.SetRamFeatures(r);
+ });
+}
+
+extern "C" int mdfn_ac_batch_set_action_port(mdfn_ac_batch* b, unsigned port)
+{
+ return guarded(b, [&]() { b->batch.SetActionPort(port); });
+}
+
+extern "C" int mdfn_ac_batch_save_reset(mdfn_ac_batch* b, unsigned slot)
+{
+ return guarded(b, [&]() { b->batch.SaveReset(slot); });
+}
+
+extern "C" int mdfn_ac_batch_reset(mdfn_ac_batch* b, const uint8_t* mask, uint8_t* obs, uint8_t* ram)
+{
+ return guarded(b, [&]() { b->batch.Reset(mask, obs, ram); });
+}
+
+extern "C" int mdfn_ac_batch_step(mdfn_ac_batch* b, const uint8_t* actions, size_t action_size, unsigned frames,
+                                  uint8_t* obs, uint8_t* ram, uint8_t* done)
+{
+ return guarded(b, [&]() { b->batch.Step(actions, action_size, frames, obs, ram, done); });
+}
@@ -0,0 +1,279 @@
+/* automation_client.h -- C++ client for Mednafen's automation socket
+ *
+ * Talks the socket transport of src/drivers/automation.cpp (start Mednafen
+ * with --automation_socket tcp:<port> | <unix path>) without any file I/O or
+ * text scraping on the caller's side: memory and registers come back as binary
+ * frames straight into caller buffers, and pauses (breakpoint, watchpoint,
+ * exception, "done step" ...) arrive as pushed events because Connect() sends
+ * "subscribe on". One client per emulator, one thread per client.
+ *
+ * Every call blocks until its ack arrives. An "error ..." ack, a timeout or a
+ * dropped connection throws AutomationClient::Error.
+ *
+ *   AutomationClient::Client c;
+ *   c.Connect("tcp:4500");
+ *   c.AddBreakpoint(0x06004000);
+ *   AutomationClient::Event ev = c.FrameAdvance(600);   // "break pc=0x06004000 ..." or "done frame_advance ..."
+ *   uint8_t buf[0x100];
+ *   c.ReadMem(0x06010000, buf, sizeof(buf));
+ *   c.SnapSave(0);
+ *
+ * Batch drives N emulators (one per socket, e.g. children of "spawn") with
+ * gym-style Step()/Reset() calls that fan out over one worker thread per
+ * instance, so the instances emulate in parallel and a step costs one round
+ * trip of the slowest instance rather than the sum of them.
+ *
+ * The extern "C" mdfn_ac_* functions at the end wrap the same calls for
+ * ctypes (automation_client.py).
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_AUTOMATION_CLIENT_H
+#define __MDFN_AUTOMATION_CLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+#include <stdexcept>
+#include <string>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace AutomationClient
+{
+
+struct Error : public std::runtime_error
+{
+ explicit Error(const std::string& what) : std::runtime_error(what) { }
+};
+
+// One text message from the emulator: a command's ack or a pushed event.
+struct Ack
+{
+ std::string text;	// full text, first line first, without the trailing cycle=/seq= tokens
+ int64_t cycle = -1;	// absolute master SH-2 cycle when it was written
+ uint64_t seq = 0;
+
+ std::string FirstLine(void) const { return text.substr(0, text.find('\n')); }
+ bool IsError(void) const { return text.compare(0, 6, "error ") == 0; }
+ // Value of a key=value token on the first line (e.g. "pc", "frame"); empty if absent.
+ std::string Field(const std::string& key) const;
+ uint64_t FieldU64(const std::string& key, uint64_t def = 0) const;	// accepts 0x... hex
+};
+
+// A pushed event. Paused is true for everything that leaves the emulator
+// waiting for a command (break/done/pause-mode hits); false for log-mode
+// watchpoint and exception hits, which keep running, and for background
+// results such as "done save_state".
+struct Event : public Ack
+{
+ bool paused = false;
+};
+
+// dump_regs_bin layout.
+struct Regs
+{
+ enum { R0 = 0, PC = 16, SR, PR, GBR, VBR, MACH, Count };
+ uint32_t r[Count];
+};
+
+enum CPU { CPU_Master = 0, CPU_Slave = 1 };
+
+class Client
+{
+ public:
+
+ Client();
+ ~Client();
+
+ Client(const Client&) = delete;
+ Client& operator=(const Client&) = delete;
+
+ // spec: "tcp:<port>", "tcp:<host>:<port>" or a Unix socket path.
+ void Connect(const std::string& spec, unsigned connect_timeout_ms = 10000);
+ void Close(void);
+ bool Connected(void) const;
+
+ void SetTimeout(unsigned ms) { timeout_ms = ms; }	// per reply and per WaitStop(); 0 = wait forever
+
+ // Raw command; returns its ack (events seen meanwhile are queued). Binary
+ // frames sent before the ack are handed to bin_sink if given, else dropped.
+ Ack Command(const std::string& line, std::vector<uint8_t>* bin_sink = nullptr);
+
+ // Next paused event (log-mode events are queued for NextEvent()).
+ Event WaitStop(void);
+ // Next event of any kind, or false after ms milliseconds (0 = poll).
+ bool NextEvent(Event* ev, unsigned ms);
+
+ // Execution. The Step* calls, FrameAdvance, RunToFrame and RunToCycle wait for the
+ // pause that ends them, which may be a breakpoint or watchpoint instead.
+ Event Step(uint64_t n = 1);
+ Event StepSlave(uint64_t n = 1);
+ Event StepOver(void);	// a call runs to its return
+ Event StepOut(void);
+ Event FrameAdvance(uint64_t n = 1);
+ Event RunToFrame(uint64_t frame);
+ Event RunToCycle(int64_t cycle);
+ void Run(void);
+ Ack Pause(void);
+
+ // Breakpoints; cond uses the breakpoint condition syntax ("R4 == 0x06001000").
+ void AddBreakpoint(uint32_t addr, CPU cpu = CPU_Master, const std::string& cond = std::string(), bool log = false);
+ bool RemoveBreakpoint(uint32_t addr, CPU cpu = CPU_Master);	// false if it wasn't set
+ void ClearBreakpoints(void);
+
+ // Memory and registers, as the backing store sees them.
+ void ReadMem(uint32_t addr, void* dest, uint32_t size);
+ void ReadMem(const std::vector<std::pair<uint32_t, uint32_t>>& ranges, void* dest);	// back to back
+ void WriteMem(uint32_t addr, const void* data, uint32_t size);	// write_mem_bin hex:, WRAM only
+ void Poke(uint32_t addr, const void* data, uint32_t size);
+ void ReadRegs(CPU cpu, Regs* regs);
+ int64_t Cycle(void);
+
+ // Snapshots: in-memory slots (0-4095, optional delta base) and state files.
+ uint64_t SnapSave(unsigned slot, int base = -1);	// returns bytes held
+ void SnapLoad(unsigned slot);
+ void SnapFree(unsigned slot);
+ void SaveState(const std::string& path);
+ void LoadState(const std::string& path);
+
+ void Quit(void);
+
+ private:
+
+ enum FrameKind { Frame_Ack, Frame_Event, Frame_Bin };
+
+ void Send(const std::string& line);
+ FrameKind ReadFrame(std::string* payload, unsigned ms);
+ bool Fill(size_t need, unsigned ms);
+ Ack Check(const Ack& ack);
+ Event RunCommand(const std::string& line);
+
+ intptr_t fd;
+ unsigned timeout_ms;
+ std::string rx;
+ std::deque<Event> events;
+};
+
+// Batch environment over instances on this host. Observations come from each
+// instance's obs_expose mapping (obs_dir/mdfn_obs_<i>, best on a tmpfs), RAM
+// features from one read_mem per step. Outputs are laid out instance after
+// instance: Size() x ObsBytes() observation bytes, Size() x RamBytes() RAM
+// feature bytes, Size() done flags. An instance is done when its step ended in
+// any pause other than the frame count running out, e.g. a breakpoint set on
+// the game's "game over" routine through Instance(i) or Command().
+class Batch
+{
+ public:
+
+ Batch();
+ ~Batch();
+
+ Batch(const Batch&) = delete;
+ Batch& operator=(const Batch&) = delete;
+
+ void Open(const std::vector<std::string>& specs, const std::string& obs_dir,
+           unsigned obs_w = 80, unsigned obs_h = 60, bool obs_rgb = false, unsigned connect_timeout_ms = 10000);
+ void Close(void);
+
+ size_t Size(void) const { return clients.size(); }
+ size_t ObsBytes(void) const { return obs_bytes; }
+ size_t RamBytes(void) const { return ram_bytes; }
+ Client& Instance(size_t i) { return *clients[i]; }
+
+ // The same command on every instance, e.g. "breakpoint 0600A000".
+ void Command(const std::string& line);
+ // RAM features: these ranges, back to back, after every step and reset.
+ void SetRamFeatures(const std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+ // Actions are raw port data (input_port), action_size bytes per instance.
+ void SetActionPort(unsigned port) { action_port = port; }
+
+ // snap_save <slot> everywhere and remember the observations that go with it.
+ void SaveReset(unsigned slot);
+ // snap_load the reset slot on the instances whose mask byte is set (all if null).
+ void Reset(const uint8_t* mask, uint8_t* obs, uint8_t* ram);
+ void Step(const uint8_t* actions, size_t action_size, unsigned frames, uint8_t* obs, uint8_t* ram, uint8_t* done);
+
+ private:
+
+ struct ObsMap;
+
+ void RunAll(const std::function<void(size_t)>& job);
+ void Worker(size_t i);
+ void CopyObs(size_t i, uint8_t* dest) const;
+
+ std::vector<Client*> clients;
+ std::vector<ObsMap*> obs_maps;
+ std::vector<std::vector<uint8_t>> reset_obs, reset_ram;
+ std::vector<std::pair<uint32_t, uint32_t>> ram_ranges;
+ size_t obs_bytes, ram_bytes;
+ unsigned action_port;
+ int reset_slot;
+
+ std::vector<std::thread> workers;
+ std::mutex lock;
+ std::condition_variable wake, finished;
+ const std::function<void(size_t)>* job;
+ uint64_t generation;
+ size_t running;
+ bool quit;
+ std::vector<std::string> errors;
+};
+
+}
+#endif
+
+//
+// C API for ctypes. Functions return 0 on success and -1 on error (message via
+// mdfn_ac_error()); text results are copied into out[out_size], NUL-terminated.
+//
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mdfn_ac mdfn_ac;
+
+mdfn_ac* mdfn_ac_connect(const char* spec, unsigned timeout_ms);
+void mdfn_ac_close(mdfn_ac* c);
+const char* mdfn_ac_error(mdfn_ac* c);
+
+int mdfn_ac_command(mdfn_ac* c, const char* line, char* out, size_t out_size);
+int mdfn_ac_wait_stop(mdfn_ac* c, char* out, size_t out_size);
+int mdfn_ac_step(mdfn_ac* c, uint64_t n, char* out, size_t out_size);
+int mdfn_ac_frame_advance(mdfn_ac* c, uint64_t n, char* out, size_t out_size);
+int mdfn_ac_add_breakpoint(mdfn_ac* c, uint32_t addr, int slave, const char* cond);
+int mdfn_ac_remove_breakpoint(mdfn_ac* c, uint32_t addr, int slave);	// 1 if it wasn't set
+int mdfn_ac_read_mem(mdfn_ac* c, uint32_t addr, void* dest, uint32_t size);
+int mdfn_ac_write_mem(mdfn_ac* c, uint32_t addr, const void* data, uint32_t size);
+int mdfn_ac_read_regs(mdfn_ac* c, int slave, uint32_t* regs22);
+int mdfn_ac_snap_save(mdfn_ac* c, unsigned slot, int base);
+int mdfn_ac_snap_load(mdfn_ac* c, unsigned slot);
+
+// Batch; ranges are n_ranges (addr, size) pairs, masks and done flags one byte per instance.
+typedef struct mdfn_ac_batch mdfn_ac_batch;
+
+mdfn_ac_batch* mdfn_ac_batch_open(const char* const* specs, unsigned n, const char* obs_dir,
+                                  unsigned obs_w, unsigned obs_h, int obs_rgb, unsigned timeout_ms);
+void mdfn_ac_batch_close(mdfn_ac_batch* b);
+const char* mdfn_ac_batch_error(mdfn_ac_batch* b);
+size_t mdfn_ac_batch_obs_bytes(mdfn_ac_batch* b);
+size_t mdfn_ac_batch_ram_bytes(mdfn_ac_batch* b);
+int mdfn_ac_batch_command(mdfn_ac_batch* b, const char* line);
+int mdfn_ac_batch_set_ram(mdfn_ac_batch* b, const uint32_t* ranges, unsigned n_ranges);
+int mdfn_ac_batch_set_action_port(mdfn_ac_batch* b, unsigned port);
+int mdfn_ac_batch_save_reset(mdfn_ac_batch* b, unsigned slot);
+int mdfn_ac_batch_reset(mdfn_ac_batch* b, const uint8_t* mask, uint8_t* obs, uint8_t* ram);
+int mdfn_ac_batch_step(mdfn_ac_batch* b, const uint8_t* actions, size_t action_size, unsigned frames,
+                       uint8_t* obs, uint8_t* ram, uint8_t* done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+"""ctypes bindings for the automation client library (automation_client.h).
+
+Build the shared library first (`make` in this directory), then:
+
+    from automation_client import AutomationClient
+    c = AutomationClient("tcp:4500")
+    c.add_breakpoint(0x06004000)
+    print(c.frame_advance(600))          # "break pc=0x06004000 ..." or "done frame_advance ..."
+    data = c.read_mem(0x06010000, 0x100)
+    regs = c.read_regs()                 # 22 ints, dump_regs_bin layout
+
+    env = BatchEnv(["/tmp/mdfn0.sock", "/tmp/mdfn1.sock"], "/dev/shm")
+    env.save_reset(0)
+    obs, ram, done = env.step([b"\\x00\\x10", b"\\x00\\x00"], frames=4)   # raw input_port bytes each
+
+Errors raise RuntimeError with the emulator's "error ..." text.
+"""
+
+import ctypes
+import os
+import sys
+
+_TEXT_MAX = 1 << 16
+
+
+def _load(path=None):
+    if path is None:
+        name = "libmdfn_automation_client." + ("dll" if sys.platform == "win32" else "so")
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    lib = ctypes.CDLL(path)
+    P, S, U32, U64 = ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint64
+    sigs = {
+        "mdfn_ac_connect": (P, [S, ctypes.c_uint]),
+        "mdfn_ac_close": (None, [P]),
+        "mdfn_ac_error": (S, [P]),
+        "mdfn_ac_command": (ctypes.c_int, [P, S, P, ctypes.c_size_t]),
+        "mdfn_ac_wait_stop": (ctypes.c_int, [P, P, ctypes.c_size_t]),
+        "mdfn_ac_step": (ctypes.c_int, [P, U64, P, ctypes.c_size_t]),
+        "mdfn_ac_frame_advance": (ctypes.c_int, [P, U64, P, ctypes.c_size_t]),
+        "mdfn_ac_add_breakpoint": (ctypes.c_int, [P, U32, ctypes.c_int, S]),
+        "mdfn_ac_remove_breakpoint": (ctypes.c_int, [P, U32, ctypes.c_int]),
+        "mdfn_ac_read_mem": (ctypes.c_int, [P, U32, P, U32]),
+        "mdfn_ac_write_mem": (ctypes.c_int, [P, U32, P, U32]),
+        "mdfn_ac_read_regs": (ctypes.c_int, [P, ctypes.c_int, P]),
+        "mdfn_ac_snap_save": (ctypes.c_int, [P, ctypes.c_uint, ctypes.c_int]),
+        "mdfn_ac_snap_load": (ctypes.c_int, [P, ctypes.c_uint]),
+        "mdfn_ac_batch_open": (P, [P, ctypes.c_uint, S, ctypes.c_uint, ctypes.c_uint, ctypes.c_int, ctypes.c_uint]),
+        "mdfn_ac_batch_close": (None, [P]),
+        "mdfn_ac_batch_error": (S, [P]),
+        "mdfn_ac_batch_obs_bytes": (ctypes.c_size_t, [P]),
+        "mdfn_ac_batch_ram_bytes": (ctypes.c_size_t, [P]),
+        "mdfn_ac_batch_command": (ctypes.c_int, [P, S]),
+        "mdfn_ac_batch_set_ram": (ctypes.c_int, [P, P, ctypes.c_uint]),
+        "mdfn_ac_batch_set_action_port": (ctypes.c_int, [P, ctypes.c_uint]),
+        "mdfn_ac_batch_save_reset": (ctypes.c_int, [P, ctypes.c_uint]),
+        "mdfn_ac_batch_reset": (ctypes.c_int, [P, P, P, P]),
+        "mdfn_ac_batch_step": (ctypes.c_int, [P, P, ctypes.c_size_t, ctypes.c_uint, P, P, P]),
+    }
+    for fn, (res, args) in sigs.items():
+        f = getattr(lib, fn)
+        f.restype = res
+        f.argtypes = args
+    return lib
+
+
+class AutomationClient:
+    def __init__(self, spec, timeout_ms=10000, lib_path=None):
+        self._lib = _load(lib_path)
+        self._c = self._lib.mdfn_ac_connect(spec.encode(), timeout_ms)
+        err = self._lib.mdfn_ac_error(self._c)
+        if err:
+            self._lib.mdfn_ac_close(self._c)
+            self._c = None
+            raise RuntimeError(err.decode())
+        self._text = ctypes.create_string_buffer(_TEXT_MAX)
+
+    def _check(self, rc):
+        if rc < 0:
+            raise RuntimeError(self._lib.mdfn_ac_error(self._c).decode())
+        return rc
+
+    def _call_text(self, fn, *args):
+        self._check(fn(self._c, *args, self._text, _TEXT_MAX))
+        return self._text.value.decode()
+
+    def command(self, line):
+        return self._call_text(self._lib.mdfn_ac_command, line.encode())
+
+    def wait_stop(self):
+        return self._call_text(self._lib.mdfn_ac_wait_stop)
+
+    def step(self, n=1):
+        return self._call_text(self._lib.mdfn_ac_step, n)
+
+    def frame_advance(self, n=1):
+        return self._call_text(self._lib.mdfn_ac_frame_advance, n)
+
+    def add_breakpoint(self, addr, slave=False, cond=None):
+        self._check(self._lib.mdfn_ac_add_breakpoint(self._c, addr, int(slave), cond.encode() if cond else None))
+
+    def remove_breakpoint(self, addr, slave=False):
+        return self._check(self._lib.mdfn_ac_remove_breakpoint(self._c, addr, int(slave))) == 0
+
+    def read_mem(self, addr, size):
+        buf = ctypes.create_string_buffer(size)
+        self._check(self._lib.mdfn_ac_read_mem(self._c, addr, buf, size))
+        return buf.raw
+
+    def write_mem(self, addr, data):
+        self._check(self._lib.mdfn_ac_write_mem(self._c, addr, data, len(data)))
+
+    def read_regs(self, slave=False):
+        regs = (ctypes.c_uint32 * 22)()
+        self._check(self._lib.mdfn_ac_read_regs(self._c, int(slave), regs))
+        return list(regs)
+
+    def snap_save(self, slot, base=-1):
+        self._check(self._lib.mdfn_ac_snap_save(self._c, slot, base))
+
+    def snap_load(self, slot):
+        self._check(self._lib.mdfn_ac_snap_load(self._c, slot))
+
+    def close(self):
+        if self._c:
+            self._lib.mdfn_ac_close(self._c)
+            self._c = None
+
+    def __del__(self):
+        self.close()
+
+
+class BatchEnv:
+    """N emulators stepped together (automation_client.h, class Batch).
+
+    step() and reset() return (observations, ram_features, done): a list of
+    bytes objects of width * height gray (or RGB) pixels per instance, a list
+    of the RAM feature bytes per instance, and a list of bools.
+    """
+
+    def __init__(self, specs, obs_dir, width=80, height=60, rgb=False, timeout_ms=10000, lib_path=None):
+        self._lib = _load(lib_path)
+        self.n = len(specs)
+        arr = (ctypes.c_char_p * self.n)(*[s.encode() for s in specs])
+        self._b = self._lib.mdfn_ac_batch_open(arr, self.n, obs_dir.encode(), width, height, int(rgb), timeout_ms)
+        err = self._lib.mdfn_ac_batch_error(self._b)
+        if err:
+            self._lib.mdfn_ac_batch_close(self._b)
+            self._b = None
+            raise RuntimeError(err.decode())
+        self._obs_bytes = self._lib.mdfn_ac_batch_obs_bytes(self._b)
+        self._ram_bytes = 0
+        self._alloc()
+
+    def _alloc(self):
+        self._obs = ctypes.create_string_buffer(max(1, self.n * self._obs_bytes))
+        self._ram = ctypes.create_string_buffer(max(1, self.n * self._ram_bytes))
+        self._done = ctypes.create_string_buffer(max(1, self.n))
+
+    def _check(self, rc):
+        if rc < 0:
+            raise RuntimeError(self._lib.mdfn_ac_batch_error(self._b).decode())
+        return rc
+
+    def _split(self, buf, size):
+        raw = buf.raw
+        return [raw[i * size:(i + 1) * size] for i in range(self.n)]
+
+    def _results(self):
+        return (self._split(self._obs, self._obs_bytes), self._split(self._ram, self._ram_bytes),
+                [bool(d) for d in self._done.raw[:self.n]])
+
+    def command(self, line):
+        self._check(self._lib.mdfn_ac_batch_command(self._b, line.encode()))
+
+    def set_ram_features(self, ranges):
+        flat = (ctypes.c_uint32 * (2 * len(ranges)))(*[v for r in ranges for v in r])
+        self._check(self._lib.mdfn_ac_batch_set_ram(self._b, flat, len(ranges)))
+        self._ram_bytes = self._lib.mdfn_ac_batch_ram_bytes(self._b)
+        self._alloc()
+
+    def set_action_port(self, port):
+        self._check(self._lib.mdfn_ac_batch_set_action_port(self._b, port))
+
+    def save_reset(self, slot=0):
+        self._check(self._lib.mdfn_ac_batch_save_reset(self._b, slot))
+
+    def reset(self, mask=None):
+        m = bytes(1 if x else 0 for x in mask) if mask is not None else None
+        ctypes.memset(self._done, 0, self.n)
+        self._check(self._lib.mdfn_ac_batch_reset(self._b, m, self._obs, self._ram))
+        return self._results()
+
+    def step(self, actions, frames=1):
+        size = len(actions[0]) if actions else 0
+        buf = b"".join(actions)
+        if len(buf) != size * self.n:
+            raise ValueError("step: need one equal-sized action per instance")
+        self._check(self._lib.mdfn_ac_batch_step(self._b, buf or None, size, frames, self._obs, self._ram, self._done))
+        return self._results()
+
+    def close(self):
+        if self._b:
+            self._lib.mdfn_ac_batch_close(self._b)
+            self._b = None
+
+    def __del__(self):
+        self.close()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Run deterministic emulator benchmarks from save states and report frames/s per scene.
+
+Each run launches a headless instance, sends "benchmark <frames> <state>" (load the state,
+release all input, run N frames unthrottled with perf_stats on) and reads back frames/s, the
+per-frame host time of each subsystem and an end-state hash. The same state and frame count
+must always give the same hash; a different one means the build changed emulation, not just
+its speed.
+
+A manifest lists standard scenes (benchmark_scenes.json), paths relative to the manifest:
+
+    {"scenes": [{"name": "2d_heavy", "cue": "games/x.cue", "state": "states/x_2d.mc0",
+                 "frames": 1800, "hash": "0123456789abcdef"}, ...]}
+
+"hash" is optional; when present a mismatch is reported and the exit status is 1. Scenes
+whose files are missing are skipped.
+
+Usage:
+    benchmark.py game.cue scene.mc0 1800
+    benchmark.py --manifest benchmark_scenes.json --runs 3 --json results.json
+"""
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+
+from mednafen_bot import MednafenBot
+
+# perf_stats columns shown in the table, in microseconds per frame
+COLUMNS = ["master", "slave", "vdp1", "vdp2", "vdp2_wait", "sound", "cdb", "scu", "frame", "driver"]
+
+
+def parse_ack(ack):
+    """Ack tokens after "done benchmark" -> {key: float, or str for hash}."""
+    out = {}
+    for tok in ack.split()[2:]:
+        if "=" not in tok:
+            continue
+        k, v = tok.split("=", 1)
+        try:
+            out[k] = float(v) if k != "hash" else v
+        except ValueError:
+            out[k] = v
+    return out
+
+
+def run_scene(binary, cue, state, frames, runs, timeout):
+    results = []
+    ipc = tempfile.mkdtemp(prefix="mednafen_bench_")
+    bot = MednafenBot(ipc, cue, binary=binary, extra_args=["--automation_headless"])
+    if not bot.start():
+        raise RuntimeError("emulator didn't start for " + cue)
+    try:
+        for _ in range(runs):
+            ack = bot.send_and_wait("benchmark %d %s" % (frames, os.path.abspath(state)),
+                                    ["done benchmark", "error benchmark"], timeout=timeout)
+            if ack is None or ack.startswith("error") or "done benchmark" not in ack:
+                ack = ack or bot.last_ack
+                raise RuntimeError(ack)
+            results.append(parse_ack(ack[ack.index("done benchmark"):]))
+    finally:
+        bot.quit()
+    return results
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("cue", nargs="?")
+    ap.add_argument("state", nargs="?")
+    ap.add_argument("frames", nargs="?", type=int)
+    ap.add_argument("--manifest", help="JSON list of scenes instead of cue/state/frames")
+    ap.add_argument("--runs", type=int, default=1, help="runs per scene; the fastest is reported (default 1)")
+    ap.add_argument("--mednafen", help="emulator binary (default: as mednafen_bot.py finds it)")
+    ap.add_argument("--timeout", type=float, default=600, help="seconds per run (default 600)")
+    ap.add_argument("--json", help="also write all runs to this file")
+    args = ap.parse_args()
+
+    if args.manifest:
+        base = os.path.dirname(os.path.abspath(args.manifest))
+        with open(args.manifest) as f:
+            scenes = json.load(f)["scenes"]
+        for s in scenes:
+            s["cue"] = os.path.join(base, s["cue"])
+            s["state"] = os.path.join(base, s["state"])
+    elif args.cue and args.state and args.frames:
+        scenes = [{"name": os.path.basename(args.state), "cue": args.cue, "state": args.state,
+                   "frames": args.frames}]
+    else:
+        ap.error("give cue, state and frames, or --manifest")
+
+    print("%-16s %8s %7s %16s  %s" % ("scene", "fps", "speed", "hash", " ".join("%9s" % c for c in COLUMNS)))
+    report, bad = [], False
+    for s in scenes:
+        if not (os.path.exists(s["cue"]) and os.path.exists(s["state"])):
+            print("%-16s skipped (missing %s)" % (s["name"], s["cue"] if not os.path.exists(s["cue"]) else s["state"]))
+            continue
+        runs = run_scene(args.mednafen, s["cue"], s["state"], s["frames"], args.runs, args.timeout)
+        best = max(runs, key=lambda r: r.get("fps", 0))
+        hashes = {r.get("hash") for r in runs}
+        note = ""
+        if len(hashes) > 1:
+            note, bad = "  nondeterministic: " + " ".join(sorted(hashes)), True
+        elif s.get("hash") and s["hash"] != best.get("hash"):
+            note, bad = "  expected hash " + s["hash"], True
+        print("%-16s %8.1f %6.1f%% %16s  %s%s" % (s["name"], best.get("fps", 0), best.get("speed", 0), best.get("hash", "?"),
+              " ".join("%9.1f" % best.get(c, 0) for c in COLUMNS), note))
+        report.append({"name": s["name"], "frames": s["frames"], "runs": runs})
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(report, f, indent=1)
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
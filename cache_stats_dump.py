@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Print an SH-2 cache statistics file (cache_stats_dump).
+
+File layout (Automation_CacheStatsDump in src/ss/ss.cpp): "MDFNCST1", then
+for the master and the slave SH-2: 8 x le64 counters (ihit, imiss, dhit,
+dmiss, purges, ccr_writes, ccr_flushes, dropped), le32 n, and n miss entries
+of le32 line address (bit 1 set = instruction fetch) and le32 count, most
+misses first.
+
+Usage:
+    cache_stats_dump.py stats.bin             # counters + top 20 lines per CPU
+    cache_stats_dump.py stats.bin --top 100 --kind i
+"""
+
+import argparse
+import struct
+import sys
+
+COUNTERS = ["ihit", "imiss", "dhit", "dmiss", "purges", "ccr_writes", "ccr_flushes", "dropped"]
+
+
+def load(path):
+    """Return [(counters_dict, [(line, is_instr, count), ...]) for master, slave]."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNCST1":
+        raise ValueError("%s: not a cache statistics file" % path)
+    pos = 8
+    cpus = []
+    for _ in range(2):
+        counters = dict(zip(COUNTERS, struct.unpack_from("<8Q", data, pos)))
+        pos += 64
+        (n,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        misses = []
+        for _ in range(n):
+            key, count = struct.unpack_from("<II", data, pos)
+            pos += 8
+            misses.append((key & ~0xF, bool(key & 2), count))
+        cpus.append((counters, misses))
+    return cpus
+
+
+def ratio(hit, miss):
+    return "%.2f%%" % (100.0 * hit / (hit + miss)) if hit + miss else "-"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("stats", help="file written by cache_stats_dump")
+    ap.add_argument("--top", type=int, default=20, help="miss lines to list per CPU")
+    ap.add_argument("--kind", choices=["i", "d"], help="only instruction or data misses")
+    args = ap.parse_args()
+
+    out = sys.stdout
+    for name, (c, misses) in zip(("master", "slave"), load(args.stats)):
+        out.write("%s: insn %d hit / %d miss (%s)  data %d hit / %d miss (%s)\n" % (
+            name, c["ihit"], c["imiss"], ratio(c["ihit"], c["imiss"]),
+            c["dhit"], c["dmiss"], ratio(c["dhit"], c["dmiss"])))
+        out.write("  purges=%d ccr_writes=%d ccr_flushes=%d lines=%d dropped=%d\n" % (
+            c["purges"], c["ccr_writes"], c["ccr_flushes"], len(misses), c["dropped"]))
+        if args.kind:
+            misses = [m for m in misses if m[1] == (args.kind == "i")]
+        for line, instr, count in misses[:args.top]:
+            out.write("  0x%08X %s %d  (set %d)\n" % (line, "i" if instr else "d", count, (line >> 4) & 0x3F))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Print a capture plan file (capture_plan set <path> [every=N] [zlib] <item ...>).
+
+File layout (capture_frame in src/drivers/automation.cpp): "MDFNCAP1", le32
+flags (bit 0: the rest is in TraceRing deflate blocks of le32 raw_len, le32
+comp_len, data), le32 period, le32 item count, then per item le32 kind, le32
+param, le32 size. Records: le64 frame, le64 master cycle, then each item's
+bytes. Kinds: 0 mem (param address, big-endian bytes), 1 regs (param CPU, 22
+host-order uint32s: R0-R15 PC SR PR GBR VBR MACH), 2 hash (le64), 3 obs (param
+width | height << 12 | channels << 24, pixels).
+
+Usage:
+    capture_plan_dump.py run.cap                    # one line per record
+    capture_plan_dump.py run.cap --item 0           # frame and that item only
+    capture_plan_dump.py run.cap --item 2 -o obs/   # write item 2 of each record to obs/<frame>.bin
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+KINDS = ["mem", "regs", "hash", "obs"]
+REGS = ["R%d" % i for i in range(16)] + ["PC", "SR", "PR", "GBR", "VBR", "MACH"]
+
+
+def parse(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNCAP1":
+        raise ValueError("%s: not a capture plan file" % path)
+    flags, period, n = struct.unpack_from("<III", data, 8)
+    items = [struct.unpack_from("<III", data, 20 + 12 * i) for i in range(n)]
+    body = data[20 + 12 * n:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return period, items, body
+
+
+def records(items, body):
+    size = 16 + sum(it[2] for it in items)
+    for pos in range(0, len(body) - size + 1, size):
+        frame, cycle = struct.unpack_from("<QQ", body, pos)
+        parts = []
+        off = pos + 16
+        for it in items:
+            parts.append(body[off:off + it[2]])
+            off += it[2]
+        yield frame, cycle, parts
+
+
+def describe(item, raw):
+    kind, param, size = item
+    if kind == 0:
+        return "mem 0x%08X: %s" % (param, raw.hex().upper())
+    if kind == 1:
+        regs = struct.unpack("=22I", raw)
+        return ("regs_slave " if param else "regs ") + " ".join("%s=%08X" % r for r in zip(REGS, regs))
+    if kind == 2:
+        return "hash %016x" % struct.unpack("<Q", raw)[0]
+    if kind == 3:
+        return "obs %dx%dx%d" % (param & 0xFFF, (param >> 12) & 0xFFF, param >> 24)
+    return "type=%d %d bytes" % (kind, size)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--item", type=int, help="only this item (index in the plan)")
+    ap.add_argument("-o", "--out", help="directory: write the --item bytes of each record to <frame>.bin")
+    args = ap.parse_args()
+
+    period, items, body = parse(args.file)
+    if args.item is not None and not 0 <= args.item < len(items):
+        sys.exit("capture_plan_dump.py: item %d out of range (plan has %d)" % (args.item, len(items)))
+    if args.out and args.item is None:
+        sys.exit("capture_plan_dump.py: -o needs --item")
+    out = sys.stdout
+    try:
+        out.write("# every=%d items: %s\n" % (period, " ".join(
+            "%d:%s(%d)" % (i, KINDS[k] if k < len(KINDS) else k, s) for i, (k, p, s) in enumerate(items))))
+        for frame, cycle, parts in records(items, body):
+            if args.out:
+                with open(os.path.join(args.out, "%d.bin" % frame), "wb") as f:
+                    f.write(parts[args.item])
+                continue
+            which = [args.item] if args.item is not None else range(len(items))
+            out.write("frame %d cycle=%d %s\n" % (frame, cycle, " | ".join(describe(items[i], parts[i]) for i in which)))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
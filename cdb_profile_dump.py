@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Print a CD Block profile event file (cdb_profile_start <path> [zlib]).
+
+File layout (CDB_ProfileStart in src/ss/cdb.cpp): "MDFNCDP1", le32 flags (bit 0:
+the rest is in TraceRing deflate blocks of le32 raw_len, le32 comp_len, data),
+then 16-byte records: le64 master cycle, u8 type, u8 a, le16 b, le32 c. Types:
+0 command issued (a command, b HIRQ), 1 command result (a command, b HIRQ, c
+latency), 2 drive phase (a new phase, b old phase, c cycles in the old one), 3
+buffer (a 0 alloc / 1 free, b free buffers after it, c FAD).
+
+Usage:
+    cdb_profile_dump.py cdb.bin                  # one line per event
+    cdb_profile_dump.py cdb.bin --occupancy      # used buffers at each change
+    cdb_profile_dump.py cdb.bin --latency        # per command: count, mean, min, max latency
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+PHASES = ["STOPPED", "PLAY", "SEEK_START3", "SEEK", "SCAN", "EJECTED0", "EJECTED1",
+          "EJECTED_WAIT", "STARTUP", "RESETTING", "SEEK_START1", "SEEK_START2", "PAUSE"]
+NUM_BUFFERS = 200
+
+
+def phase(p):
+    return PHASES[p] if p < len(PHASES) else str(p)
+
+
+def payload(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNCDP1":
+        raise ValueError("%s: not a CD Block profile file" % path)
+    (flags,) = struct.unpack_from("<I", data, 8)
+    body = data[12:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return body
+
+
+def records(body):
+    for pos in range(0, len(body) - 15, 16):
+        yield struct.unpack_from("<QBBHI", body, pos)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--occupancy", action="store_true", help="cycle and used buffer count at each buffer change")
+    ap.add_argument("--latency", action="store_true", help="latency totals per command code")
+    args = ap.parse_args()
+
+    body = payload(args.file)
+    out = sys.stdout
+    try:
+        if args.occupancy:
+            for cycle, kind, a, b, c in records(body):
+                if kind == 3:
+                    out.write("%d %d\n" % (cycle, NUM_BUFFERS - b))
+        elif args.latency:
+            total = {}
+            for cycle, kind, a, b, c in records(body):
+                if kind == 1:
+                    t = total.setdefault(a, [0, 0, None, 0])
+                    t[0] += 1
+                    t[1] += c
+                    t[2] = c if t[2] is None else min(t[2], c)
+                    t[3] = max(t[3], c)
+            for cmd, (n, s, lo, hi) in sorted(total.items(), key=lambda e: -e[1][1]):
+                out.write("cmd 0x%02X count=%d total=%d mean=%d min=%d max=%d\n" % (cmd, n, s, s // n, lo, hi))
+        else:
+            for cycle, kind, a, b, c in records(body):
+                if kind == 0:
+                    out.write("%d CMD 0x%02X HIRQ=0x%04X\n" % (cycle, a, b))
+                elif kind == 1:
+                    out.write("%d RES 0x%02X HIRQ=0x%04X latency=%d\n" % (cycle, a, b, c))
+                elif kind == 2:
+                    out.write("%d DRV %s->%s spent=%d\n" % (cycle, phase(b), phase(a), c))
+                elif kind == 3:
+                    out.write("%d BUF %s free=%d fad=0x%06X\n" % (cycle, "FREE" if a else "ALLOC", b, c))
+                else:
+                    out.write("%d type=%d a=%d b=%d c=%d\n" % (cycle, kind, a, b, c))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Read a sparse CDL file (cdl_dump) and summarize or expand it.
+
+File layout (Automation_CDLDump in src/ss/ss.cpp): "MDFNCDL2", le32 page
+size, le32 page count, le32 lo, le32 hi, then per page that has any flag set:
+le32 address, le32 encoded length, runs of (varint count, u8 flags).
+
+Flag bits per byte: 0x01 CODE, 0x02 DATA_READ, 0x04 DATA_WRITE,
+0x10 touched by the master SH-2, 0x20 touched by the slave SH-2.
+
+Usage:
+    cdl_dump.py game.cdl                                  # per-region summary
+    cdl_dump.py game.cdl --ranges --flag code             # code address ranges
+    cdl_dump.py game.cdl --dense 06000000 06100000 -o hwr.bin
+"""
+
+import argparse
+import struct
+import sys
+
+CODE, READ, WRITE, MASTER, SLAVE = 0x01, 0x02, 0x04, 0x10, 0x20
+FLAGS = {"code": CODE, "read": READ, "write": WRITE, "master": MASTER, "slave": SLAVE}
+REGIONS = [
+    (0x00000000, 0x00100000, "BIOS"),
+    (0x00200000, 0x00300000, "Low WRAM"),
+    (0x02000000, 0x05000000, "Cart (A-bus)"),
+    (0x05C00000, 0x05C80000, "VDP1 VRAM"),
+    (0x06000000, 0x06100000, "High WRAM"),
+]
+
+
+def load(path):
+    """Return (lo, hi, {page_addr: bytearray}) for a CDL file."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNCDL2":
+        raise ValueError("%s: not a sparse CDL file" % path)
+    page_size, n_pages, lo, hi = struct.unpack_from("<IIII", data, 8)
+    pos = 24
+    pages = {}
+    for _ in range(n_pages):
+        addr, enc_len = struct.unpack_from("<II", data, pos)
+        pos += 8
+        end = pos + enc_len
+        page = bytearray()
+        while pos < end:
+            run = shift = 0
+            while True:
+                b = data[pos]
+                pos += 1
+                run |= (b & 0x7F) << shift
+                if not b & 0x80:
+                    break
+                shift += 7
+            page += bytes([data[pos]]) * run
+            pos += 1
+        if len(page) != page_size:
+            raise ValueError("page 0x%08X: decoded %d bytes" % (addr, len(page)))
+        pages[addr] = page
+    return lo, hi, pages
+
+
+def region_name(addr):
+    for lo, hi, name in REGIONS:
+        if lo <= addr < hi:
+            return name
+    return "other"
+
+
+def summary(pages, out):
+    totals = {}
+    for addr, page in pages.items():
+        t = totals.setdefault(region_name(addr), [0, 0, 0, 0, 0])
+        t[0] += 1
+        for v in page:
+            if v & CODE:
+                t[1] += 1
+            if v & READ:
+                t[2] += 1
+            if v & WRITE:
+                t[3] += 1
+            if (v & (MASTER | SLAVE)) == (MASTER | SLAVE):
+                t[4] += 1
+    out.write("%-14s %6s %10s %10s %10s %10s\n" % ("region", "pages", "code", "read", "write", "both_cpus"))
+    for name, t in sorted(totals.items()):
+        out.write("%-14s %6d %10d %10d %10d %10d\n" % (name, *t))
+
+
+def ranges(pages, mask, out):
+    start = prev = None
+    for addr in sorted(pages):
+        for i, v in enumerate(pages[addr]):
+            a = addr + i
+            if not v & mask:
+                continue
+            if prev is not None and a == prev + 1:
+                prev = a
+                continue
+            if start is not None:
+                out.write("0x%08X-0x%08X\n" % (start, prev + 1))
+            start = prev = a
+    if start is not None:
+        out.write("0x%08X-0x%08X\n" % (start, prev + 1))
+
+
+def dense(pages, lo, hi, out):
+    """Legacy layout: le32 lo, le32 hi, one flag byte per address in [lo, hi)."""
+    buf = bytearray(hi - lo)
+    for addr, page in pages.items():
+        for i, v in enumerate(page):
+            if lo <= addr + i < hi:
+                buf[addr + i - lo] = v
+    out.write(struct.pack("<II", lo, hi))
+    out.write(bytes(buf))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("cdl", help="file written by cdl_dump")
+    ap.add_argument("--ranges", action="store_true", help="print address ranges with --flag set")
+    ap.add_argument("--flag", choices=sorted(FLAGS), default="code")
+    ap.add_argument("--dense", nargs=2, metavar=("LO", "HI"),
+                    help="expand [LO,HI) (hex) to the old flat bitmap format")
+    ap.add_argument("-o", "--output", help="write here instead of stdout")
+    args = ap.parse_args()
+
+    _, _, pages = load(args.cdl)
+
+    if args.dense:
+        lo, hi = (int(x, 16) for x in args.dense)
+        out = open(args.output, "wb") if args.output else sys.stdout.buffer
+        dense(pages, lo, hi, out)
+    else:
+        out = open(args.output, "w") if args.output else sys.stdout
+        if args.ranges:
+            ranges(pages, FLAGS[args.flag], out)
+        else:
+            summary(pages, out)
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
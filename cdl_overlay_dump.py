@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Print a code overlay log (cdl_overlay_log <path> [zlib]).
+
+File layout (Automation_CDLOverlayStart in src/ss/ss.cpp): "MDFNOVL1", le32
+flags (bit 0: the rest is in TraceRing deflate blocks of le32 raw_len, le32
+comp_len, data), then 16-byte records: le64 frame, le32 page address (4KB
+pages, 27-bit bus), u8 writer, three zero bytes. A record means something
+wrote into a page that code had been fetched from; the page is logged again
+only after code runs there again.
+
+Usage:
+    cdl_overlay_dump.py ovl.bin              # one line per record
+    cdl_overlay_dump.py ovl.bin --pages      # per page and writer: hits, first and last frame
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+WRITERS = ["SCU0", "SCU1", "SCU2", "SH2M0", "SH2M1", "SH2S0", "SH2S1", "?", "MSH2", "SSH2"]
+
+
+def writer(i):
+    return WRITERS[i] if i < len(WRITERS) else str(i)
+
+
+def payload(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNOVL1":
+        raise ValueError("%s: not a code overlay log" % path)
+    (flags,) = struct.unpack_from("<I", data, 8)
+    body = data[12:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return body
+
+
+def records(body):
+    for pos in range(0, len(body) - 15, 16):
+        yield struct.unpack_from("<QIB", body, pos)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--pages", action="store_true", help="hits per page and writer, most hits first")
+    args = ap.parse_args()
+
+    body = payload(args.file)
+    out = sys.stdout
+    try:
+        if args.pages:
+            total = {}
+            for frame, page, src in records(body):
+                t = total.setdefault((page, src), [0, frame, frame])
+                t[0] += 1
+                t[2] = frame
+            for (page, src), (n, first, last) in sorted(total.items(), key=lambda e: (-e[1][0], e[0])):
+                out.write("0x%08X %-5s hits=%d frames=%d..%d\n" % (page, writer(src), n, first, last))
+        else:
+            for frame, page, src in records(body):
+                out.write("%d 0x%08X %s\n" % (frame, page, writer(src)))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,537 @@
+/* cdl_tool.cpp -- Merge and compare CDL files offline
+ *
+ * Reads the sparse CDL files written by cdl_dump ("MDFNCDL2", see
+ * Automation_CDLDump in src/ss/ss.cpp) and the old flat layout (le32 lo,
+ * le32 hi, one flag byte per address in [lo, hi), as cdl_dump.py --dense
+ * writes it), in any mix.
+ *
+ *   cdl_tool merge -o all.cdl [-j N] a.cdl b.cdl ...   OR everything into one MDFNCDL2 file
+ *   cdl_tool delta [-j N] [--flag F] [--range LO:HI]... [--ranges] OLD... -- NEW...
+ *                                                      per-range coverage of OLD and NEW and what
+ *                                                      NEW gained or lost; --ranges lists gained runs
+ *   cdl_tool summary [-j N] a.cdl ...                  per-range coverage of the merged set
+ *
+ * Files are decoded and ORed into per-thread page tables, -j threads at a time
+ * (default: all cores), and the tables are ORed together at the end, 16 bytes
+ * per step. Memory use is 4KB per page touched per thread.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+enum : uint32_t
+{
+ PAGE_BITS = 12,
+ PAGE_SIZE = 1U << PAGE_BITS,
+ PAGE_COUNT = 1U << (32 - PAGE_BITS)
+};
+
+enum : uint8_t { CODE = 0x01, READ = 0x02, WRITE = 0x04, MASTER = 0x10, SLAVE = 0x20 };
+
+struct Region
+{
+ uint32_t lo, hi;
+ std::string name;
+};
+
+// Same as cdl_dump.py.
+static const Region DefaultRegions[] =
+{
+ { 0x00000000, 0x00100000, "BIOS" },
+ { 0x00200000, 0x00300000, "Low WRAM" },
+ { 0x02000000, 0x05000000, "Cart (A-bus)" },
+ { 0x05C00000, 0x05C80000, "VDP1 VRAM" },
+ { 0x06000000, 0x06100000, "High WRAM" },
+};
+
+struct Error : public std::runtime_error
+{
+ explicit Error(const std::string& what) : std::runtime_error(what) { }
+};
+
+static uint32_t le32(const uint8_t* p)
+{
+ return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(std::vector<uint8_t>* v, uint32_t x)
+{
+ for (unsigned i = 0; i < 4; i++)
+  v->push_back(x >> (i * 8));
+}
+
+// Sparse flag table over the 32-bit address space, one 4KB page at a time.
+class PageTable
+{
+ public:
+
+ PageTable() : pages(PAGE_COUNT) { }
+
+ uint8_t* Page(uint32_t page)
+ {
+  if (!pages[page]) {
+   pages[page].reset(new uint8_t[PAGE_SIZE + 15]);
+   memset(Aligned(page), 0, PAGE_SIZE);
+  }
+  return Aligned(page);
+ }
+
+ const uint8_t* Find(uint32_t page) const { return pages[page] ? Aligned(page) : nullptr; }
+
+ // OR n bytes of flags starting at addr; a run of one value is stored as n == count, src == nullptr.
+ void Or(uint32_t addr, const uint8_t* src, uint8_t value, uint64_t n)
+ {
+  while (n) {
+   const uint32_t offs = addr & (PAGE_SIZE - 1);
+   const uint32_t chunk = (uint32_t)std::min<uint64_t>(n, PAGE_SIZE - offs);
+   uint8_t* dst = Page(addr >> PAGE_BITS) + offs;
+
+   if (src) {
+    OrBytes(dst, src, chunk);
+    src += chunk;
+   } else if (value) {
+    for (uint32_t i = 0; i < chunk; i++)
+     dst[i] |= value;
+   }
+   addr += chunk;
+   n -= chunk;
+  }
+ }
+
+ void Merge(const PageTable& other)
+ {
+  for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+   if (other.pages[page])
+    OrBytes(Page(page), other.Aligned(page), PAGE_SIZE);
+  }
+ }
+
+ static void OrBytes(uint8_t* dst, const uint8_t* src, uint32_t n)
+ {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+   const __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+   const __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+   _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(a, b));
+  }
+#endif
+  for (; i < n; i++)
+   dst[i] |= src[i];
+ }
+
+ private:
+
+ uint8_t* Aligned(uint32_t page) const
+ {
+  return (uint8_t*)(((uintptr_t)pages[page].get() + 15) & ~(uintptr_t)15);
+ }
+
+ std::vector<std::unique_ptr<uint8_t[]>> pages;
+};
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+ FILE* f = fopen(path.c_str(), "rb");
+ if (!f)
+  throw Error(path + ": " + strerror(errno));
+
+ std::vector<uint8_t> data;
+ uint8_t buf[1 << 16];
+ size_t n;
+ while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+  data.insert(data.end(), buf, buf + n);
+ const bool failed = ferror(f);
+ fclose(f);
+ if (failed)
+  throw Error(path + ": read error");
+ return data;
+}
+
+static void load_sparse(const std::string& path, const std::vector<uint8_t>& data, PageTable* pt)
+{
+ if (data.size() < 24)
+  throw Error(path + ": truncated header");
+
+ const uint32_t page_size = le32(&data[8]);
+ const uint32_t n_pages = le32(&data[12]);
+ size_t pos = 24;
+
+ for (uint32_t p = 0; p < n_pages; p++) {
+  if (pos + 8 > data.size())
+   throw Error(path + ": truncated page header");
+
+  const uint32_t addr = le32(&data[pos]);
+  const size_t end = pos + 8 + le32(&data[pos + 4]);
+  uint64_t decoded = 0;
+
+  pos += 8;
+  if (end > data.size())
+   throw Error(path + ": truncated page data");
+
+  while (pos < end) {
+   uint64_t run = 0;
+   unsigned shift = 0;
+   uint8_t b;
+
+   do {
+    if (pos >= end || shift > 35)
+     throw Error(path + ": bad run length");
+    b = data[pos++];
+    run |= (uint64_t)(b & 0x7F) << shift;
+    shift += 7;
+   } while (b & 0x80);
+
+   if (pos >= end)
+    throw Error(path + ": bad run");
+   if (decoded + run > page_size)
+    throw Error(path + ": page overrun");
+   pt->Or(addr + (uint32_t)decoded, nullptr, data[pos++], run);
+   decoded += run;
+  }
+
+  if (decoded != page_size)
+   throw Error(path + ": short page");
+ }
+}
+
+static void load_file(const std::string& path, PageTable* pt)
+{
+ const std::vector<uint8_t> data = read_file(path);
+
+ if (data.size() >= 8 && !memcmp(data.data(), "MDFNCDL2", 8)) {
+  load_sparse(path, data, pt);
+  return;
+ }
+
+ if (data.size() >= 8) {
+  const uint32_t lo = le32(&data[0]);
+  const uint32_t hi = le32(&data[4]);
+
+  if (hi >= lo && (uint64_t)data.size() == 8 + (uint64_t)(hi - lo)) {
+   pt->Or(lo, data.data() + 8, 0, hi - lo);
+   return;
+  }
+ }
+
+ throw Error(path + ": not a CDL file");
+}
+
+static unsigned default_jobs(void)
+{
+ const unsigned n = std::thread::hardware_concurrency();
+ return n ? n : 1;
+}
+
+// ORs all of 'paths' into one table, with up to 'jobs' threads each taking the next unread file.
+static std::unique_ptr<PageTable> load_set(const std::vector<std::string>& paths, unsigned jobs)
+{
+ jobs = std::max<unsigned>(1, std::min<size_t>(jobs, paths.size()));
+
+ std::vector<std::unique_ptr<PageTable>> tables(jobs);
+ std::vector<std::string> errors(jobs);
+ std::vector<std::thread> threads;
+ std::atomic<size_t> next(0);
+
+ for (unsigned t = 0; t < jobs; t++) {
+  tables[t].reset(new PageTable());
+  threads.emplace_back([&, t]() {
+   try {
+    for (size_t i; (i = next.fetch_add(1)) < paths.size(); )
+     load_file(paths[i], tables[t].get());
+   } catch (std::exception& e) {
+    errors[t] = e.what();
+    next.store(paths.size());
+   }
+  });
+ }
+
+ for (std::thread& th : threads)
+  th.join();
+
+ for (const std::string& e : errors)
+  if (!e.empty())
+   throw Error(e);
+
+ for (unsigned t = 1; t < jobs; t++) {
+  tables[0]->Merge(*tables[t]);
+  tables[t].reset();
+ }
+ return std::move(tables[0]);
+}
+
+// Same encoding as Automation_CDLDump(): only pages with a flag set, as (varint count, flags) runs.
+static void write_sparse(const std::string& path, const PageTable& pt)
+{
+ std::vector<uint8_t> out, enc;
+ uint32_t used = 0, lo = 0, hi = 0;
+
+ out.insert(out.end(), (const uint8_t*)"MDFNCDL2", (const uint8_t*)"MDFNCDL2" + 8);
+ put_le32(&out, PAGE_SIZE);
+ put_le32(&out, 0);	// page count, lo and hi are patched below
+ put_le32(&out, 0);
+ put_le32(&out, 0);
+
+ for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+  const uint8_t* p = pt.Find(page);
+
+  if (!p || std::all_of(p, p + PAGE_SIZE, [](uint8_t v) { return v == 0; }))
+   continue;
+
+  enc.clear();
+  for (uint32_t i = 0; i < PAGE_SIZE; ) {
+   uint32_t run = 1;
+
+   while (i + run < PAGE_SIZE && p[i + run] == p[i])
+    run++;
+   for (uint32_t v = run; ; v >>= 7) {
+    enc.push_back((v & 0x7F) | ((v >= 0x80) ? 0x80 : 0));
+    if (v < 0x80)
+     break;
+   }
+   enc.push_back(p[i]);
+   i += run;
+  }
+
+  if (!used)
+   lo = page << PAGE_BITS;
+  hi = (page + 1) << PAGE_BITS;
+  used++;
+  put_le32(&out, page << PAGE_BITS);
+  put_le32(&out, enc.size());
+  out.insert(out.end(), enc.begin(), enc.end());
+ }
+
+ for (unsigned i = 0; i < 4; i++) {
+  out[12 + i] = used >> (i * 8);
+  out[16 + i] = lo >> (i * 8);
+  out[20 + i] = hi >> (i * 8);
+ }
+
+ FILE* f = fopen(path.c_str(), "wb");
+ if (!f)
+  throw Error(path + ": " + strerror(errno));
+ const bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+ if (fclose(f) || !ok)
+  throw Error(path + ": write error");
+}
+
+static uint64_t count_flag(const PageTable& pt, const Region& r, uint8_t mask)
+{
+ uint64_t n = 0;
+
+ for (uint64_t a = r.lo; a < r.hi; ) {
+  const uint32_t page = (uint32_t)(a >> PAGE_BITS);
+  const uint64_t end = std::min<uint64_t>(r.hi, ((uint64_t)page + 1) << PAGE_BITS);
+  const uint8_t* p = pt.Find(page);
+
+  if (p) {
+   for (uint64_t i = a; i < end; i++)
+    n += (p[i & (PAGE_SIZE - 1)] & mask) != 0;
+  }
+  a = end;
+ }
+ return n;
+}
+
+// Runs of bytes that have 'mask' in b but not in a.
+static void print_gained(const PageTable& a, const PageTable& b, const Region& r, uint8_t mask)
+{
+ int64_t start = -1;
+ uint64_t addr = r.lo;
+
+ while (addr < r.hi) {
+  const uint32_t page = (uint32_t)(addr >> PAGE_BITS);
+  const uint64_t end = std::min<uint64_t>(r.hi, ((uint64_t)page + 1) << PAGE_BITS);
+  const uint8_t* ap = a.Find(page);
+  const uint8_t* bp = b.Find(page);
+
+  for (; addr < end; addr++) {
+   const uint32_t offs = addr & (PAGE_SIZE - 1);
+   const bool gained = bp && (bp[offs] & mask) && !(ap && (ap[offs] & mask));
+
+   if (gained && start < 0)
+    start = addr;
+   else if (!gained && start >= 0) {
+    printf("0x%08X-0x%08X %s\n", (uint32_t)start, (uint32_t)addr, r.name.c_str());
+    start = -1;
+   }
+  }
+ }
+
+ if (start >= 0)
+  printf("0x%08X-0x%08X %s\n", (uint32_t)start, (uint32_t)r.hi, r.name.c_str());
+}
+
+static uint8_t parse_flag(const std::string& s)
+{
+ static const struct { const char* name; uint8_t mask; } names[] =
+ {
+  { "code", CODE }, { "read", READ }, { "write", WRITE }, { "master", MASTER }, { "slave", SLAVE }, { "any", 0xFF }
+ };
+
+ for (const auto& n : names)
+  if (s == n.name)
+   return n.mask;
+ throw Error("unknown flag \"" + s + "\" (code, read, write, master, slave, any)");
+}
+
+static Region parse_range(const std::string& s)
+{
+ const size_t colon = s.find(':');
+ char* end;
+ Region r;
+
+ if (colon == std::string::npos)
+  throw Error("bad range \"" + s + "\" (LO:HI in hex)");
+ r.lo = strtoul(s.substr(0, colon).c_str(), &end, 16);
+ const uint64_t hi = strtoull(s.c_str() + colon + 1, &end, 16);
+ if (*end || hi <= r.lo || hi > 0x100000000ULL)
+  throw Error("bad range \"" + s + "\" (LO:HI in hex)");
+ r.hi = (uint32_t)std::min<uint64_t>(hi, 0xFFFFFFFFU);
+ r.name = s;
+ return r;
+}
+
+static int usage(void)
+{
+ fprintf(stderr,
+  "usage: cdl_tool merge -o OUT [-j N] FILE...\n"
+  "       cdl_tool delta [-j N] [--flag F] [--range LO:HI]... [--ranges] OLD... -- NEW...\n"
+  "       cdl_tool summary [-j N] [--flag F] [--range LO:HI]... FILE...\n"
+  "FILE: MDFNCDL2 (cdl_dump) or flat (le32 lo, le32 hi, bitmap). F: code (default), read, write,\n"
+  "master, slave or any. Ranges default to BIOS, Low WRAM, cart, VDP1 VRAM and High WRAM.\n");
+ return 2;
+}
+
+static int run(int argc, char* argv[])
+{
+ if (argc < 2)
+  return usage();
+
+ const std::string cmd = argv[1];
+ std::vector<std::string> files[2];
+ std::vector<Region> regions;
+ std::string out_path;
+ unsigned jobs = default_jobs();
+ uint8_t mask = CODE;
+ bool list_ranges = false;
+ unsigned set = 0;
+
+ for (int i = 2; i < argc; i++) {
+  const std::string a = argv[i];
+  const bool has_val = (i + 1) < argc;
+
+  if (a == "-o" && has_val)
+   out_path = argv[++i];
+  else if (a == "-j" && has_val)
+   jobs = std::max(1, atoi(argv[++i]));
+  else if (a == "--flag" && has_val)
+   mask = parse_flag(argv[++i]);
+  else if (a == "--range" && has_val)
+   regions.push_back(parse_range(argv[++i]));
+  else if (a == "--ranges")
+   list_ranges = true;
+  else if (a == "--" && cmd == "delta" && !set)
+   set = 1;
+  else if (a.size() > 1 && a[0] == '-')
+   return usage();
+  else
+   files[set].push_back(a);
+ }
+
+ if (regions.empty())
+  regions.assign(std::begin(DefaultRegions), std::end(DefaultRegions));
+
+ if (cmd == "merge") {
+  if (out_path.empty() || files[0].empty())
+   return usage();
+  write_sparse(out_path, *load_set(files[0], jobs));
+  printf("%s: merged %zu files\n", out_path.c_str(), files[0].size());
+  return 0;
+ }
+
+ if (cmd == "summary") {
+  if (files[0].empty())
+   return usage();
+
+  const std::unique_ptr<PageTable> pt = load_set(files[0], jobs);
+
+  printf("%-24s %10s %10s\n", "range", "bytes", "covered");
+  for (const Region& r : regions)
+   printf("%-24s %10llu %10llu\n", r.name.c_str(), (unsigned long long)(r.hi - r.lo), (unsigned long long)count_flag(*pt, r, mask));
+  return 0;
+ }
+
+ if (cmd == "delta") {
+  if (files[0].empty() || files[1].empty())
+   return usage();
+
+  const std::unique_ptr<PageTable> old_pt = load_set(files[0], jobs);
+  const std::unique_ptr<PageTable> new_pt = load_set(files[1], jobs);
+
+  printf("%-24s %10s %10s %10s %10s\n", "range", "old", "new", "gained", "lost");
+  for (const Region& r : regions) {
+   uint64_t gained = 0, lost = 0;
+
+   for (uint64_t a = r.lo; a < r.hi; ) {
+    const uint32_t page = (uint32_t)(a >> PAGE_BITS);
+    const uint64_t end = std::min<uint64_t>(r.hi, ((uint64_t)page + 1) << PAGE_BITS);
+    const uint8_t* op = old_pt->Find(page);
+    const uint8_t* np = new_pt->Find(page);
+
+    if (op || np) {
+     for (uint64_t i = a; i < end; i++) {
+      const bool o = op && (op[i & (PAGE_SIZE - 1)] & mask);
+      const bool n = np && (np[i & (PAGE_SIZE - 1)] & mask);
+
+      gained += n && !o;
+      lost += o && !n;
+     }
+    }
+    a = end;
+   }
+   printf("%-24s %10llu %10llu %10llu %10llu\n", r.name.c_str(), (unsigned long long)count_flag(*old_pt, r, mask),
+          (unsigned long long)count_flag(*new_pt, r, mask), (unsigned long long)gained, (unsigned long long)lost);
+  }
+
+  if (list_ranges) {
+   for (const Region& r : regions)
+    print_gained(*old_pt, *new_pt, r, mask);
+  }
+  return 0;
+ }
+
+ return usage();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+ try {
+  return run(argc, argv);
+ } catch (std::exception& e) {
+  fprintf(stderr, "cdl_tool: %s\n", e.what());
+  return 1;
+ }
+}
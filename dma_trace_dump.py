@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Print a binary DMA trace file (dma_trace_bin <path> [zlib] [frames_only]).
+
+File layout (Automation_DMATraceBinStart in src/ss/ss.cpp): "MDFNDMA1", le32
+flags (bit 0: the rest is in TraceRing deflate blocks of le32 raw_len, le32
+comp_len, data; bit 1: frames only), then records tagged by their first byte.
+Transfer (0), 36 bytes: u8 0, u8 source, u8 src region, u8 dst region, le32 src,
+le32 dst, le32 bytes, le64 start cycle, le64 end cycle, le32 SH-2 stall cycles.
+Frame (1): u8 1, u8 0, le16 n, le32 transfers, le64 frame, le64 DMA cycles, le64
+stall cycles, then n x (u8 source, u8 src region, u8 dst region, u8 0, le32
+transfers, le64 bytes).
+
+Usage:
+    dma_trace_dump.py dma.bin                # transfers and frame summaries
+    dma_trace_dump.py dma.bin --frames       # one bandwidth line per frame
+    dma_trace_dump.py dma.bin --summary      # totals per source and region pair, most bytes first
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+SOURCES = ["SCU0", "SCU1", "SCU2", "SH2M0", "SH2M1", "SH2S0", "SH2S1", "SCSP"]
+REGIONS = ["ROM", "LWRAM", "ABUS", "CDB", "SNDRAM", "SCSP", "VDP1", "VDP2", "HWRAM", "OTHER"]
+
+
+def name(table, i):
+    return table[i] if i < len(table) else str(i)
+
+
+def payload(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNDMA1":
+        raise ValueError("%s: not a binary DMA trace" % path)
+    (flags,) = struct.unpack_from("<I", data, 8)
+    body = data[12:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return body
+
+
+def records(body):
+    """Yield ("xfer", fields) and ("frame", (frame, transfers, cycles, stall, pairs))."""
+    pos = 0
+    while pos < len(body):
+        if body[pos] == 0:
+            if pos + 36 > len(body):
+                break
+            yield "xfer", struct.unpack_from("<xBBBIIIQQI", body, pos)
+            pos += 36
+        else:
+            if pos + 32 > len(body):
+                break
+            n, transfers, frame, cycles, stall = struct.unpack_from("<xxHIQQQ", body, pos)
+            pos += 32
+            pairs = [struct.unpack_from("<BBBxIQ", body, pos + 16 * i) for i in range(n)]
+            pos += 16 * n
+            yield "frame", (frame, transfers, cycles, stall, pairs)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--frames", action="store_true", help="one line per frame: transfers, bytes, DMA and stall cycles")
+    ap.add_argument("--summary", action="store_true", help="totals per source and region pair over the whole file")
+    args = ap.parse_args()
+
+    body = payload(args.file)
+    out = sys.stdout
+    try:
+        if args.summary:
+            total = {}
+            nframes = 0
+            for kind, r in records(body):
+                if kind != "frame":
+                    continue
+                nframes += 1
+                for src, sr, dr, count, nbytes in r[4]:
+                    t = total.setdefault((src, sr, dr), [0, 0])
+                    t[0] += count
+                    t[1] += nbytes
+            out.write("# %d frames\n" % nframes)
+            for (src, sr, dr), (count, nbytes) in sorted(total.items(), key=lambda e: -e[1][1]):
+                out.write("%-5s %s->%s transfers=%d bytes=%d bytes/frame=%.1f\n"
+                          % (name(SOURCES, src), name(REGIONS, sr), name(REGIONS, dr), count, nbytes,
+                             nbytes / float(max(1, nframes))))
+        else:
+            for kind, r in records(body):
+                if kind == "xfer":
+                    if args.frames:
+                        continue
+                    src, sr, dr, sa, da, nbytes, start, end, stall = r
+                    out.write("%-5s 0x%08X(%s) -> 0x%08X(%s) bytes=%d start=%d end=%d cycles=%d stall=%d\n"
+                              % (name(SOURCES, src), sa, name(REGIONS, sr), da, name(REGIONS, dr),
+                                 nbytes, start, end, end - start, stall))
+                else:
+                    frame, transfers, cycles, stall, pairs = r
+                    out.write("frame %d transfers=%d bytes=%d cycles=%d stall=%d\n"
+                              % (frame, transfers, sum(p[4] for p in pairs), cycles, stall))
+                    if args.frames:
+                        continue
+                    for src, sr, dr, count, nbytes in pairs:
+                        out.write("  %-5s %s->%s transfers=%d bytes=%d\n"
+                                  % (name(SOURCES, src), name(REGIONS, sr), name(REGIONS, dr), count, nbytes))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
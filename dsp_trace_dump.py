@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Print an SCU DSP trace file (dsp_profile_start <path> [zlib]).
+
+File layout (Automation_DSPProfileStart in src/ss/ss.cpp): "MDFNDSP1", le32
+flags (bit 0: the rest is in TraceRing deflate blocks of le32 raw_len, le32
+comp_len, data), then 16-byte records: le64 master cycle, le32 instruction, u8
+program RAM address, u8 flags (bit 0 DMA busy before the instruction, bit 1
+after it, bit 2 placeholder NOP after a PC load), le16 stall cycles (saturated).
+
+Usage:
+    dsp_trace_dump.py dsp.bin                # one line per instruction
+    dsp_trace_dump.py dsp.bin --summary      # per address, most cycles first
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+
+def payload(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNDSP1":
+        raise ValueError("%s: not an SCU DSP trace" % path)
+    (flags,) = struct.unpack_from("<I", data, 8)
+    body = data[12:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return body
+
+
+def records(body):
+    for pos in range(0, len(body) - 15, 16):
+        yield struct.unpack_from("<QIBBH", body, pos)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--summary", action="store_true",
+                    help="executions, stall and DMA-busy counts per address, most cycles first")
+    args = ap.parse_args()
+
+    body = payload(args.file)
+    out = sys.stdout
+    try:
+        if args.summary:
+            total = {}
+            for _, instr, addr, flags, stall in records(body):
+                if flags & 4:
+                    continue
+                t = total.setdefault(addr, [0, 0, 0, instr])
+                t[0] += 1
+                t[1] += stall
+                t[2] += flags & 1
+            cycles = sum(2 * t[0] + t[1] for t in total.values())
+            out.write("# addr executions stall dma_busy cycles% instruction\n")
+            for addr, (n, stall, busy, instr) in sorted(total.items(), key=lambda e: -(2 * e[1][0] + e[1][1])):
+                out.write("%02X %12d %12d %12d %6.2f%% %08X\n"
+                          % (addr, n, stall, busy, 100.0 * (2 * n + stall) / cycles if cycles else 0.0, instr))
+        else:
+            for cycle, instr, addr, flags, stall in records(body):
+                out.write("cycle=%d pc=%s instr=0x%08X%s%s%s\n"
+                          % (cycle, "--" if flags & 4 else "0x%02X" % addr, instr,
+                             " stall=%d" % stall if stall else "",
+                             " dma" if flags & 1 else "", " dma_after" if flags & 3 == 2 else ""))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
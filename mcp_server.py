@@ -551,7 +551,8 @@ async def breakpoint_list() -> str:
 @mcp.tool()
 async def breakpoint_set_from_file(path: str,
                                    result_path: str = "",
-                                   clear_existing: bool = False) -> str:
+                                   clear_existing: bool = False,
+                                   count: bool = False) -> str:
     """Bulk-install PC breakpoints (log mode) from a text file.
 
     File format: one hex address per line (optional 0x prefix). '#' starts a
@@ -567,6 +568,10 @@ async def breakpoint_set_from_file(path: str,
     previously installed in pause mode (plain `breakpoint_set(..., log=False)`)
     will stop pausing for the rest of the session — they become log-only too.
 
+    count=True keeps only a hit counter and first-hit frame/cycle per address
+    instead of the text log, which makes coverage sweeps over thousands of
+    addresses nearly free; read them with breakpoint_hits_dump.
+
     Returns a compact one-line status. Full per-failure detail is written to
     result_path (defaults to <path>.result.json next to the input)."""
     if not _alive():
@@ -584,6 +589,8 @@ async def breakpoint_set_from_file(path: str,
     cmd = f"breakpoint_set_from_file {wsl_path(in_path)} {wsl_path(out_path)}"
     if clear_existing:
         cmd += " clear"
+    if count:
+        cmd += " count"
     ack = await _send_and_wait(cmd,
                                ["ok breakpoint_set_from_file",
                                 "error breakpoint_set_from_file",
@@ -614,6 +621,21 @@ async def breakpoint_set_from_file(path: str,
     return ack
 
 
+@mcp.tool()
+async def breakpoint_hits_dump(path: str, binary: bool = False, reset: bool = False) -> str:
+    """Write per-breakpoint hit counts and first-hit frame/cycle (count mode).
+
+    Every installed breakpoint is listed, unhit ones with hits 0. JSON by
+    default; binary=True writes the MDFNBPH1 layout. reset=True zeroes the
+    counters after writing."""
+    if not _alive():
+        return "FAIL: No session"
+    out_path = os.path.abspath(path)
+    cmd = f"breakpoint_hits_dump {wsl_path(out_path)}" + (" bin" if binary else "") + (" reset" if reset else "")
+    ack = await _send_and_wait(cmd, ["ok breakpoint_hits_dump", "error breakpoint_hits_dump"], timeout=30)
+    return ack if ack else "FAIL: breakpoint_hits_dump timed out"
+
+
 @mcp.tool()
 async def breakpoint_hits_summary(result_path: str = "",
                                   hits_path: str = "") -> str:
@@ -6,6 +6,7 @@ All tools that need to launch and control Mednafen should import from here.
 """
 
 import os
+import socket
 import time
 import subprocess
 import tempfile
@@ -36,11 +37,85 @@ def _win_path(p):
     return p.replace("\\", "/")
 
 
+class EventStream:
+    """Subscriber on the automation socket (--automation_socket tcp:<port> | <path>).
+
+    After "subscribe on", breakpoint/watchpoint/exception hits and "done ..."
+    messages arrive as "!<nbytes>\\n" frames the moment they happen, in seq
+    order, even when the command that caused them came through the action file.
+    Replies to commands sent on this connection still arrive as plain frames.
+    """
+
+    def __init__(self, spec, timeout=10):
+        if spec.startswith("tcp:"):
+            self.sock = socket.create_connection(("127.0.0.1", int(spec[4:])), timeout=timeout)
+        else:
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.sock.settimeout(timeout)
+            self.sock.connect(spec)
+        self.buf = b""
+        self.events = []
+        reply = self.command("subscribe on")
+        if not reply or not reply.startswith("ok subscribe"):
+            raise RuntimeError(f"subscribe failed: {reply!r}")
+
+    def _frame(self, timeout):
+        """Read one frame; returns (kind, payload) with kind '', '!' or '#'."""
+        self.sock.settimeout(timeout)
+        while b"\n" not in self.buf:
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("automation socket closed")
+            self.buf += chunk
+        line, self.buf = self.buf.split(b"\n", 1)
+        kind = line[:1].decode() if line[:1] in (b"!", b"#") else ""
+        n = int(line[len(kind):])
+        while len(self.buf) < n:
+            chunk = self.sock.recv(max(65536, n - len(self.buf)))
+            if not chunk:
+                raise ConnectionError("automation socket closed")
+            self.buf += chunk
+        payload, self.buf = self.buf[:n], self.buf[n:]
+        return kind, payload
+
+    def command(self, cmd, timeout=30):
+        """Send a command on this connection and return its text reply (events are queued)."""
+        self.sock.sendall(cmd.encode() + b"\n")
+        while True:
+            kind, payload = self._frame(timeout)
+            if kind == "!":
+                self.events.append(payload.decode().strip())
+            elif kind == "":
+                return payload.decode().strip()
+
+    def next_event(self, keyword=None, timeout=30):
+        """Return the next event (containing keyword, if given), or None on timeout."""
+        keywords = [keyword] if isinstance(keyword, str) else keyword
+        deadline = time.time() + timeout
+        while True:
+            while self.events:
+                ev = self.events.pop(0)
+                if not keywords or any(k in ev for k in keywords):
+                    return ev
+            left = deadline - time.time()
+            if left <= 0:
+                return None
+            try:
+                kind, payload = self._frame(left)
+            except socket.timeout:
+                return None
+            if kind == "!":
+                self.events.append(payload.decode().strip())
+
+    def close(self):
+        self.sock.close()
+
+
 class MednafenBot:
     """Drives Windows Mednafen via file-based automation IPC."""
 
     def __init__(self, ipc_dir, cue_path, show=False, sound=False,
-                 home_dir=None, verbose=False):
+                 home_dir=None, verbose=False, binary=None, extra_args=()):
         self.ipc_dir = ipc_dir
         self.action_file = os.path.join(ipc_dir, "mednafen_action.txt")
         self.ack_file = os.path.join(ipc_dir, "mednafen_ack.txt")
@@ -53,10 +128,12 @@ class MednafenBot:
         self.sound = sound
         self.home_dir = home_dir or _DEFAULT_HOME
         self.verbose = verbose
+        self.binary = binary
+        self.extra_args = list(extra_args)
 
     def start(self, timeout=45):
         """Launch Mednafen and wait for ready ack."""
-        med_bin = _find_mednafen()
+        med_bin = self.binary or _find_mednafen()
         os.makedirs(self.ipc_dir, exist_ok=True)
         os.makedirs(self.home_dir, exist_ok=True)
 
@@ -91,7 +168,7 @@ class MednafenBot:
         self.proc = subprocess.Popen(
             [med_bin, "--sound", "1" if self.sound else "0",
              "-cd.image_memcache", "1",
-             "--automation", self.ipc_dir, self.cue_path],
+             "--automation", self.ipc_dir] + self.extra_args + [self.cue_path],
             stdin=subprocess.DEVNULL,
             stdout=subprocess.DEVNULL,
             stderr=self.stderr_file,
@@ -175,6 +252,23 @@ class MednafenBot:
             f"frame_advance {n}", "done frame_advance", timeout=timeout
         )
 
+    def cdl_delta(self, mask=0xFF, timeout=30):
+        """Return {addr: gained_flags} for bytes that gained CDL bits since the last call.
+
+        Requires cdl_start. mask limits which flag bits count (0x01 = code).
+        Returns None on timeout.
+        """
+        ack = self.send_and_wait(f"cdl_delta {mask:X}", "cdl_delta", timeout=timeout)
+        if ack is None:
+            return None
+        gained = {}
+        for line in ack.splitlines()[1:]:
+            addr, hexbits = line.split()[:2]
+            base = int(addr, 16)
+            for i, bits in enumerate(bytes.fromhex(hexbits)):
+                gained[base + i] = bits
+        return gained
+
     def check_stderr(self, patterns=None):
         """Check captured stderr for fatal patterns. Returns list of matches."""
         if patterns is None:
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Print an op_stats per-frame file (op_stats_start ... <path>).
+
+File layout (Automation_OpStatsStart in src/ss/ss.cpp): "MDFNOPS1", le32 256,
+256 x 32-byte NUL-padded handler names, then records of le64 frame and, for the
+master then the slave, le64 x (14 totals + 256 handler counts), all deltas
+since the previous record.
+
+Usage:
+    op_stats_dump.py ops.bin --top 20        # totals over the whole file
+    op_stats_dump.py ops.bin --frames        # totals per record
+"""
+
+import argparse
+import struct
+import sys
+
+SUMS = ["insns", "delay_slot", "cond_taken", "cond_untaken", "branch", "mac", "div", "mul",
+        "read8", "read16", "read32", "write8", "write16", "write32"]
+
+
+def load(path):
+    """Return (names, [(frame, [(sums, handlers) master, slave])])."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNOPS1":
+        raise ValueError("%s: not an op_stats file" % path)
+    (n,) = struct.unpack_from("<I", data, 8)
+    pos = 12
+    names = []
+    for _ in range(n):
+        names.append(data[pos:pos + 32].split(b"\0", 1)[0].decode())
+        pos += 32
+    per_cpu = len(SUMS) + n
+    rec_size = 8 + 2 * 8 * per_cpu
+    records = []
+    while pos + rec_size <= len(data):
+        vals = struct.unpack_from("<Q%dQ" % (2 * per_cpu), data, pos)
+        pos += rec_size
+        cpus = []
+        for cpu in range(2):
+            v = vals[1 + cpu * per_cpu:1 + (cpu + 1) * per_cpu]
+            cpus.append((list(v[:len(SUMS)]), list(v[len(SUMS):])))
+        records.append((vals[0], cpus))
+    return names, records
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--top", type=int, default=0, help="handlers to list per CPU (0 = all)")
+    ap.add_argument("--frames", action="store_true", help="one line of totals per record")
+    args = ap.parse_args()
+
+    names, records = load(args.file)
+    out = sys.stdout
+    try:
+        if args.frames:
+            for frame, cpus in records:
+                for cpu, (sums, _) in enumerate(cpus):
+                    if sums[0]:
+                        out.write("frame=%d cpu=%s %s\n" % (frame, "slave" if cpu else "master",
+                                  " ".join("%s=%d" % kv for kv in zip(SUMS, sums))))
+            return
+        for cpu in range(2):
+            sums = [sum(r[1][cpu][0][i] for r in records) for i in range(len(SUMS))]
+            handlers = [sum(r[1][cpu][1][h] for r in records) for h in range(len(names))]
+            if not sums[0]:
+                continue
+            out.write("# op_stats cpu=%s records=%d %s\n" % ("slave" if cpu else "master", len(records),
+                      " ".join("%s=%d" % kv for kv in zip(SUMS, sums))))
+            order = sorted((h for h in range(len(names)) if handlers[h]), key=lambda h: -handlers[h])
+            if args.top:
+                order = order[:args.top]
+            for h in order:
+                out.write("%s %02X %12d %6.2f%% %s\n" % ("S" if cpu else "M", h, handlers[h],
+                          100.0 * handlers[h] / sums[0], names[h]))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
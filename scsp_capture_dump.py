@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Summarize or split an SCSP capture (scsp_capture <path> [raw]).
+
+File layout (Automation_SCSPCaptureStart in src/ss/sound.cpp): a 16-bit PCM WAV at
+44100 Hz (no header with raw) of 68 interleaved le16 channels per sample: slot0-31
+(after envelope and total level, before pan), mixs0-15 (top 16 of the 20 MIXS
+bits), efreg0-15, exts0-1, outl, outr. <path>.keys: "MDFNSCK1", le32 sample rate,
+then 16-byte records: le64 sample number, u8 slot, u8 type (1 key on, 0 key off),
+le16 OCT/FNS register, le32 SA (key on only).
+
+Usage:
+    scsp_capture_dump.py cap.wav                         # peak and RMS per nonsilent channel
+    scsp_capture_dump.py cap.wav --keys                  # one line per key on/off
+    scsp_capture_dump.py cap.wav --wav out.wav --channels slot3,efreg0   # extract channels
+"""
+
+import argparse
+import array
+import math
+import os
+import struct
+import sys
+
+RATE = 44100
+CHANNELS = (["slot%d" % i for i in range(32)] + ["mixs%d" % i for i in range(16)] +
+            ["efreg%d" % i for i in range(16)] + ["exts0", "exts1", "outl", "outr"])
+
+
+def load(path):
+    """Return the samples as one flat array of int16s, channel after channel per sample."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] == b"RIFF" and data[8:12] == b"WAVE":
+        (nch,) = struct.unpack_from("<H", data, 22)
+        if nch != len(CHANNELS):
+            raise ValueError("%s: %d channels, not an SCSP capture" % (path, nch))
+        data = data[44:]
+    data = data[:len(data) - len(data) % (2 * len(CHANNELS))]
+    pcm = array.array("h")
+    pcm.frombytes(data)
+    if sys.byteorder != "little":
+        pcm.byteswap()
+    return pcm
+
+
+def keys(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNSCK1":
+        raise ValueError("%s: not an SCSP key event file" % path)
+    for pos in range(12, len(data) - 15, 16):
+        yield struct.unpack_from("<QBBHI", data, pos)
+
+
+def write_wav(path, pcm, picks):
+    nch = len(CHANNELS)
+    out = array.array("h")
+    for base in range(0, len(pcm), nch):
+        out.extend(pcm[base + c] for c in picks)
+    if sys.byteorder != "little":
+        out.byteswap()
+    body = out.tobytes()
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 36 + len(body)) + b"WAVEfmt " +
+                struct.pack("<IHHIIHH", 16, 1, len(picks), RATE, RATE * 2 * len(picks), 2 * len(picks), 16) +
+                b"data" + struct.pack("<I", len(body)))
+        f.write(body)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--keys", action="store_true", help="print the key events from FILE.keys")
+    ap.add_argument("--wav", metavar="OUT", help="write the --channels to OUT as a WAV")
+    ap.add_argument("--channels", default="outl,outr", help="comma-separated channel names (default outl,outr)")
+    args = ap.parse_args()
+
+    out = sys.stdout
+    try:
+        if args.keys:
+            for sample, slot, on, pitch, sa in keys(args.file + ".keys"):
+                if on:
+                    out.write("%d %.6f ON  slot%d oct=%d fns=0x%03X sa=0x%05X\n" % (
+                        sample, sample / RATE, slot, (pitch >> 11) & 0xF, pitch & 0x7FF, sa))
+                else:
+                    out.write("%d %.6f OFF slot%d\n" % (sample, sample / RATE, slot))
+            return
+
+        pcm = load(args.file)
+        nch = len(CHANNELS)
+        if args.wav:
+            picks = [CHANNELS.index(c) for c in args.channels.split(",")]
+            write_wav(args.wav, pcm, picks)
+            out.write("%s: %d samples, %s\n" % (args.wav, len(pcm) // nch, args.channels))
+            return
+
+        n = len(pcm) // nch
+        out.write("# %d samples (%.3f s)\n" % (n, n / RATE))
+        for c, name in enumerate(CHANNELS):
+            col = pcm[c::nch]
+            peak = max((abs(v) for v in col), default=0)
+            if not peak:
+                continue
+            rms = math.sqrt(sum(v * v for v in col) / n)
+            out.write("%-7s peak=%5d rms=%8.1f\n" % (name, peak, rms))
+        if os.path.exists(args.file + ".keys"):
+            ons = sum(1 for _, _, on, _, _ in keys(args.file + ".keys") if on)
+            out.write("# key on events: %d\n" % ons)
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -284,6 +284,32 @@ void MemoryStream::write(const void *data, uint64 count)
 // Don't add code to reduce the amount of memory allocated(when possible) without providing a 
 // per-stream setting to disable that behavior.
 //
+const uint8* MemoryStream::read_map(uint64 count)
+{
+ if(count > data_buffer_size || position > (data_buffer_size - count))
+  throw MDFN_Error(0, _("Unexpected EOF"));
+
+ const uint8* ret = &data_buffer[position];
+ position += count;
+
+ return ret;
+}
+
+uint8* MemoryStream::write_map(uint64 count)
+{
+ uint64 nrs = position + count;
+
+ if(nrs < position)
+  throw MDFN_Error(ErrnoHolder(EFBIG));
+
+ grow_if_necessary(nrs, position);
+
+ uint8* ret = &data_buffer[position];
+ position += count;
+
+ return ret;
+}
+
 void MemoryStream::truncate(uint64 length)
 {
  grow_if_necessary(length, length);
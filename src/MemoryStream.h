@@ -133,6 +133,12 @@ class MemoryStream : public Stream
   return -1;
  }
 
+ // Returns a pointer to the "count" bytes at the current position, and advances the position past them.
+ // read_map() throws if fewer than "count" bytes remain; write_map() extends the stream as needed, leaving
+ // any newly-added bytes uninitialized.  The pointer is invalidated by any other call on the object.
+ const uint8* read_map(uint64 count);
+ uint8* write_map(uint64 count);
+
  void shrink_to_fit(void) noexcept;	// Minimizes alloced memory.
 
  void mswin_utf8_convert_kludge(void);
@@ -36,9 +36,360 @@
 
 #include "CDAFReader_PCM.h"
 
+#include <mednafen/FileStream.h>
+#include <mednafen/NativeVFS.h>
+#include <mednafen/MThreading.h>
+#include <mednafen/hash/md5.h>
+
 namespace Mednafen
 {
 
+static std::string DecodeCacheDir;
+
+void CDAFR_SetDecodeCacheDir(const std::string& dir)
+{
+ DecodeCacheDir = dir;
+}
+
+//
+// Decoded PCM cache file, named after the MD5 of the compressed file's contents:
+//  "MDFNCDAC", le64 frame count, then per frame le16 left and right samples.
+//
+// The file is mapped read-only, so instances playing the same audio track share its pages.
+//
+class CDAFReader_Cache final : public CDAFReader
+{
+ public:
+ CDAFReader_Cache(std::unique_ptr<Stream> s, const uint8* p, uint64 frames) : src(std::move(s)), pcm(p), num_frames(frames)
+ {
+
+ }
+
+ ~CDAFReader_Cache()
+ {
+  src->unmap();
+ }
+
+ uint64 Read_(int16 *buffer, uint64 frames) override
+ {
+  const uint64 count = std::min<uint64>(frames, num_frames - pos);
+
+  for(uint64 i = 0; i < count * 2; i++)
+   buffer[i] = MDFN_de16lsb(pcm + (pos * 2 + i) * 2);
+
+  pos += count;
+
+  return count;
+ }
+
+ bool Seek_(uint64 frame_offset) override
+ {
+  if(frame_offset > num_frames)
+   return false;
+
+  pos = frame_offset;
+  return true;
+ }
+
+ uint64 FrameCount(void) override
+ {
+  return num_frames;
+ }
+
+ private:
+ std::unique_ptr<Stream> src;
+ const uint8* const pcm;
+ const uint64 num_frames;
+ uint64 pos = 0;
+};
+
+static CDAFReader* OpenDecodeCache(const std::string& path, const uint64 frames)
+{
+ std::unique_ptr<Stream> s(FileStream::open(path, FileStream::MODE_READ));
+
+ if(!s || s->size() != 16 + frames * 4)
+  return NULL;
+
+ const uint8* const p = s->map();
+
+ if(!p || memcmp(p, "MDFNCDAC", 8) || MDFN_de64lsb(p + 8) != frames)
+  return NULL;
+
+ return new CDAFReader_Cache(std::move(s), p + 16, frames);
+}
+
+static bool WriteDecodeCache(CDAFReader* ar, const std::string& path)
+{
+ const std::string tmp_path = path + ".tmp";
+ const uint64 frames = ar->FrameCount();
+ std::unique_ptr<FileStream> fs;
+
+ try
+ {
+  // Fails if another instance is writing the same file; it'll be used once it's there.
+  fs.reset(new FileStream(tmp_path, FileStream::MODE_WRITE_SAFE));
+ }
+ catch(MDFN_Error& e)
+ {
+  if(e.GetErrno() != EEXIST)
+   MDFN_printf(_("Error creating decoded audio cache file: %s\n"), e.what());
+
+  return false;
+ }
+
+ try
+ {
+  uint8 header[16];
+  int16 buf[588 * 2];
+  uint8 obuf[588 * 4];
+  uint64 done = 0;
+
+  memcpy(header, "MDFNCDAC", 8);
+  MDFN_en64lsb(header + 8, frames);
+  fs->write(header, sizeof(header));
+
+  while(done < frames)
+  {
+   const uint64 count = ar->Read(done, buf, std::min<uint64>(588, frames - done));
+
+   if(!count)
+    throw MDFN_Error(0, _("Audio track ended early."));
+
+   for(uint64 i = 0; i < count * 2; i++)
+    MDFN_en16lsb(obuf + i * 2, buf[i]);
+
+   fs->write(obuf, count * 4);
+   done += count;
+  }
+
+  fs->close();
+  fs.reset();
+  NVFS.rename(tmp_path, path);
+ }
+ catch(std::exception& e)
+ {
+  MDFN_printf(_("Error writing decoded audio cache file \"%s\": %s\n"), path.c_str(), e.what());
+  fs.reset();
+  NVFS.unlink(tmp_path);
+  return false;
+ }
+
+ return true;
+}
+
+static CDAFReader* UseDecodeCache(Stream* fp, CDAFReader* ar_in)
+{
+ std::unique_ptr<CDAFReader> ar(ar_in);
+ std::string path;
+
+ {
+  md5_hasher h;
+  uint8 buf[8192];
+  uint64 count;
+
+  fp->rewind();
+  while((count = fp->read(buf, sizeof(buf), false)))
+   h.process(buf, count);
+  fp->rewind();
+
+  const md5_digest d = h.digest();
+
+  path = NVFS.eval_fip(DecodeCacheDir, md5_context::asciistr(d.data(), false) + ".pcm", true);
+ }
+
+ CDAFReader* ret = OpenDecodeCache(path, ar->FrameCount());
+
+ if(!ret && WriteDecodeCache(ar.get(), path))
+  ret = OpenDecodeCache(path, ar->FrameCount());
+
+ if(!ret)
+  return ar.release();
+
+ return ret;
+}
+
+//
+// Decode-ahead for compressed audio tracks.  A worker thread, started on the first read or hint, decodes from that
+// position into a ring of Ring_Frames PCM frames and stays up to Ring_Frames ahead of the reader, so sector reads
+// during CD-DA playback are copies out of the ring.  A read outside of the decoded range(a seek nobody hinted)
+// repositions the worker and waits for it; the data returned never depends on timing.
+//
+class CDAFReader_DecodeAhead final : public CDAFReader
+{
+ public:
+ CDAFReader_DecodeAhead(CDAFReader* ar) : src(ar), num_frames(ar->FrameCount()), ring(new int16[Ring_Frames * 2])
+ {
+  mutex = MThreading::Mutex_Create();
+  wake_worker = MThreading::Cond_Create();
+  wake_reader = MThreading::Cond_Create();
+ }
+
+ ~CDAFReader_DecodeAhead()
+ {
+  if(thread)
+  {
+   MThreading::Mutex_Lock(mutex);
+   quit = true;
+   MThreading::Cond_Signal(wake_worker);
+   MThreading::Mutex_Unlock(mutex);
+
+   MThreading::Thread_Wait(thread, nullptr);
+  }
+
+  MThreading::Cond_Destroy(wake_reader);
+  MThreading::Cond_Destroy(wake_worker);
+  MThreading::Mutex_Destroy(mutex);
+ }
+
+ uint64 Read_(int16 *buffer, uint64 frames) override
+ {
+  uint64 count = std::min<uint64>(frames, num_frames - std::min<uint64>(num_frames, pos));
+
+  MThreading::Mutex_Lock(mutex);
+
+  if(!InRange(pos))
+   Reposition(pos);
+
+  // Keeps the worker from overwriting [pos, pos + count) while this waits.
+  anchor = pos;
+
+  while(end < pos + count && !failed)
+   MThreading::Cond_Wait(wake_reader, mutex);
+
+  count = std::min<uint64>(count, end - pos);
+
+  for(uint64 i = 0; i < count; i++)
+  {
+   const size_t ri = ((pos + i) % Ring_Frames) * 2;
+
+   buffer[i * 2 + 0] = ring[ri + 0];
+   buffer[i * 2 + 1] = ring[ri + 1];
+  }
+
+  pos += count;
+  anchor = pos;
+  MThreading::Cond_Signal(wake_worker);
+  MThreading::Mutex_Unlock(mutex);
+
+  return count;
+ }
+
+ bool Seek_(uint64 frame_offset) override
+ {
+  if(frame_offset > num_frames)
+   return false;
+
+  pos = frame_offset;
+  return true;
+ }
+
+ uint64 FrameCount(void) override
+ {
+  return num_frames;
+ }
+
+ void Hint(uint64 frame_offset) override
+ {
+  if(frame_offset >= num_frames)
+   return;
+
+  MThreading::Mutex_Lock(mutex);
+
+  if(!InRange(frame_offset))
+   Reposition(frame_offset);
+
+  MThreading::Mutex_Unlock(mutex);
+ }
+
+ private:
+
+ enum : uint32 { Ring_Frames = 588 * 75 * 2 };	// 2 seconds
+ enum : uint32 { Chunk_Frames = 588 * 4 };
+
+ // Mutex held for these two.
+ INLINE bool InRange(uint64 frame_offset)
+ {
+  return thread && frame_offset >= std::max<uint64>(begin, end - std::min<uint64>(end, Ring_Frames)) && frame_offset <= end;
+ }
+
+ void Reposition(uint64 frame_offset)
+ {
+  begin = end = anchor = frame_offset;
+  generation++;
+  failed = false;
+
+  if(!thread)
+   thread = MThreading::Thread_Create(ThreadEntry, this, "CDAF Decode");
+  else
+   MThreading::Cond_Signal(wake_worker);
+ }
+
+ static int ThreadEntry(void* data)
+ {
+  return ((CDAFReader_DecodeAhead*)data)->RunThread();
+ }
+
+ int RunThread(void)
+ {
+  std::unique_ptr<int16[]> tmp(new int16[Chunk_Frames * 2]);
+
+  MThreading::Mutex_Lock(mutex);
+
+  while(!quit)
+  {
+   if(failed || end >= num_frames || (end - anchor + Chunk_Frames) > Ring_Frames)
+   {
+    MThreading::Cond_Wait(wake_worker, mutex);
+    continue;
+   }
+   //
+   const uint64 start_pos = end;
+   const uint64 start_generation = generation;
+   const uint64 count = std::min<uint64>(Chunk_Frames, num_frames - start_pos);
+   uint64 got;
+
+   MThreading::Mutex_Unlock(mutex);
+   got = src->Read(start_pos, tmp.get(), count);
+   MThreading::Mutex_Lock(mutex);
+
+   if(generation != start_generation)
+    continue;
+
+   for(uint64 i = 0; i < got; i++)
+   {
+    const size_t ri = ((start_pos + i) % Ring_Frames) * 2;
+
+    ring[ri + 0] = tmp[i * 2 + 0];
+    ring[ri + 1] = tmp[i * 2 + 1];
+   }
+
+   end += got;
+   failed = (got < count);	// end of the data, or a decode error
+   MThreading::Cond_Signal(wake_reader);
+  }
+
+  MThreading::Mutex_Unlock(mutex);
+
+  return 0;
+ }
+
+ std::unique_ptr<CDAFReader> src;	// only the worker touches it once it's running
+ const uint64 num_frames;
+ std::unique_ptr<int16[]> ring;	// frame f at (f % Ring_Frames)
+ uint64 pos = 0;		// reader's position; not shared
+
+ MThreading::Thread* thread = nullptr;
+ MThreading::Mutex* mutex = nullptr;
+ MThreading::Cond* wake_worker = nullptr;
+ MThreading::Cond* wake_reader = nullptr;
+ uint64 begin = 0;		// [begin, end) decoded since the last reposition
+ uint64 end = 0;
+ uint64 anchor = 0;		// the worker stays at most Ring_Frames ahead of this
+ uint64 generation = 0;	// bumped on reposition, so a chunk decoded for the old position is dropped
+ bool failed = false;		// short read from src; no more decoding until a reposition
+ bool quit = false;
+};
+
 CDAFReader::CDAFReader() : LastReadPos(0)
 {
 
@@ -49,6 +400,11 @@ CDAFReader::~CDAFReader()
 
 }
 
+void CDAFReader::Hint(uint64 frame_offset)
+{
+
+}
+
 CDAFReader* CDAFR_Open(Stream* fp)
 {
  static CDAFReader* (* const OpenFuncs[])(Stream* fp) =
@@ -66,7 +422,19 @@ CDAFReader* CDAFR_Open(Stream* fp)
   try
   {
    fp->rewind();
-   return f(fp);
+
+   CDAFReader* ret = f(fp);
+
+   if(f != CDAFR_PCM_Open)
+   {
+    if(!DecodeCacheDir.empty())
+     ret = UseDecodeCache(fp, ret);
+
+    if(!dynamic_cast<CDAFReader_Cache*>(ret))
+     ret = new CDAFReader_DecodeAhead(ret);
+   }
+
+   return ret;
   }
   catch(int i)
   {
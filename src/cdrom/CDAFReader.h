@@ -34,6 +34,9 @@ class CDAFReader
  virtual ~CDAFReader();
 
  virtual uint64 FrameCount(void) = 0;
+
+ // Hint that reading will start at frame_offset soon; may be called from any thread.
+ virtual void Hint(uint64 frame_offset);
  INLINE uint64 Read(uint64 frame_offset, int16 *buffer, uint64 frames)
  {
   uint64 ret;
@@ -65,5 +68,11 @@ class CDAFReader
 // to it for as long as the CDAFReader object exists.
 CDAFReader *CDAFR_Open(Stream *fp);
 
+// Compressed formats are wrapped so that they're decoded ahead on a worker thread, from the last read or
+// Hint()'d position.
+//
+// Directory for decoded-PCM cache files of compressed audio tracks, or empty to decode on the fly.
+void CDAFR_SetDecodeCacheDir(const std::string& dir);
+
 }
 #endif
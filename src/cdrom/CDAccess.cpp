@@ -23,6 +23,10 @@
 #include "CDAccess.h"
 #include "CDAccess_Image.h"
 #include "CDAccess_CCD.h"
+#include "CDAccess_ZCD.h"
+
+#include <mednafen/MemoryStream.h>
+#include <mednafen/ExtMemStream.h>
 
 namespace Mednafen
 {
@@ -39,16 +43,82 @@ CDAccess::~CDAccess()
 
 }
 
-CDAccess* CDAccess_Open(VirtualFS* vfs, const std::string& path, bool image_memcache)
+void CDAccess::HintReadSector(int32 lba)
+{
+
+}
+
+CDAccess* CDAccess_Open(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap)
 {
  CDAccess *ret = NULL;
 
  if(vfs->test_ext(path, ".ccd"))
-  ret = new CDAccess_CCD(vfs, path, image_memcache);
+  ret = new CDAccess_CCD(vfs, path, image_memcache, image_mmap);
  else
-  ret = new CDAccess_Image(vfs, path, image_memcache);
+  ret = new CDAccess_Image(vfs, path, image_memcache, image_mmap);
 
  return ret;
 }
 
+//
+// Read-only view of a mapped image file.  The pages come straight from the OS page cache, so
+// instances that have the same image open share them, and nothing is read until it's accessed.
+//
+class CDAccess_MappedStream final : public ExtMemStream
+{
+ public:
+
+ CDAccess_MappedStream(std::unique_ptr<Stream> s, const uint8* p, uint64 length) : ExtMemStream((const void*)p, length), src(std::move(s))
+ {
+
+ }
+
+ virtual ~CDAccess_MappedStream() override
+ {
+  src->unmap();
+ }
+
+ private:
+
+ std::unique_ptr<Stream> src;
+};
+
+Stream* CDAccess_OpenImageStream(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap)
+{
+ std::unique_ptr<Stream> s(vfs->open(path, VirtualFS::MODE_READ));
+
+ if(CDAccess_ZCDStream::Detect(s.get()))
+ {
+  s.reset(new CDAccess_ZCDStream(std::move(s)));
+
+  if(image_memcache)
+   return new MemoryStream(s.release());
+
+  return s.release();
+ }
+
+ if(image_memcache)
+  return new MemoryStream(s.release());
+
+ if(image_mmap && s->size() > 0)
+ {
+  const uint8* p = s->map();
+
+  if(p)
+  {
+   const uint64 length = s->map_size();
+
+   return new CDAccess_MappedStream(std::move(s), p, length);
+  }
+
+  // Compressed archive entries can't be mapped; decompress them into memory as with image_memcache.
+  if(vfs != &NVFS)
+   return new MemoryStream(s.release());
+ }
+
+ s->require_fast_seekable();
+
+ return s.release();
+}
+
 }
@@ -44,12 +44,22 @@ class CDAccess
 
  virtual void Read_TOC(CDUtility::TOC *toc) = 0;
 
+ // Reading is expected to start at lba soon; lets compressed audio tracks start decoding there.
+ virtual void HintReadSector(int32 lba);
+
  private:
  CDAccess(const CDAccess&);	// No copy constructor.
  CDAccess& operator=(const CDAccess&); // No assignment operator.
 };
 
-CDAccess* CDAccess_Open(VirtualFS* vfs, const std::string& path, bool image_memcache);
+CDAccess* CDAccess_Open(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
+
+// Opens an image data file for reading: read entirely into memory if "image_memcache" is true, else
+// mmap()'d read-only if "image_mmap" is true and the file can be mapped, else read from as-is.
+// Stored(uncompressed) ZIP entries map in place; other archive entries fall back to memory with "image_mmap".
+// Hunk-compressed(ZCD) files are recognized by their header and decompressed as they're read, or
+// decompressed entirely into memory with "image_memcache"; "image_mmap" doesn't apply to them.
+Stream* CDAccess_OpenImageStream(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
 
 }
 #endif
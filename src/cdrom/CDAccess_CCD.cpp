@@ -82,12 +82,12 @@ static T CCD_ReadInt(CCD_Section &s, const std::string &propname, const bool hav
 }
 
 
-CDAccess_CCD::CDAccess_CCD(VirtualFS* vfs, const std::string& path, bool image_memcache) : img_numsectors(0)
+CDAccess_CCD::CDAccess_CCD(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap) : img_numsectors(0)
 {
- Load(vfs, path, image_memcache);
+ Load(vfs, path, image_memcache, image_mmap);
 }
 
-void CDAccess_CCD::Load(VirtualFS* vfs, const std::string& path, bool image_memcache)
+void CDAccess_CCD::Load(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap)
 {
  std::unique_ptr<Stream> cf(vfs->open(path, VirtualFS::MODE_READ));
  std::map<std::string, CCD_Section> Sections;
@@ -245,15 +245,7 @@ void CDAccess_CCD::Load(VirtualFS* vfs, const std::string& path, bool image_memc
  {
   std::string image_path = vfs->eval_fip(dir_path, file_base + "." + img_extsd, true);
 
-  if(image_memcache)
-  {
-   img_stream.reset(new MemoryStream(vfs->open(image_path, VirtualFS::MODE_READ)));
-  }
-  else
-  {
-   img_stream.reset(vfs->open(image_path, VirtualFS::MODE_READ));
-   img_stream->require_fast_seekable();
-  }
+  img_stream.reset(CDAccess_OpenImageStream(vfs, image_path, image_memcache, image_mmap));
 
   uint64 ss = img_stream->size();
 
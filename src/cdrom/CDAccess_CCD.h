@@ -28,7 +28,7 @@ class CDAccess_CCD : public CDAccess
 {
  public:
 
- CDAccess_CCD(VirtualFS* vfs, const std::string& path, bool image_memcache);
+ CDAccess_CCD(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
  virtual ~CDAccess_CCD();
 
  virtual void Read_Raw_Sector(uint8 *buf, int32 lba);
@@ -39,7 +39,7 @@ class CDAccess_CCD : public CDAccess
 
  private:
 
- void Load(VirtualFS* vfs, const std::string& path, bool image_memcache);
+ void Load(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
  void Cleanup(void);
 
  void CheckSubQSanity(void);
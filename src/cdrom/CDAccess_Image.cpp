@@ -186,7 +186,7 @@ uint32 CDAccess_Image::GetSectorCount(CDRFILE_TRACK_INFO *track)
  return size / div;
 }
 
-void CDAccess_Image::ParseTOCFileLineInfo(VirtualFS* vfs, CDRFILE_TRACK_INFO *track, const int tracknum, const std::string &filename, const char *binoffset, const char *msfoffset, const char *length, bool image_memcache, std::map<std::string, Stream*> &toc_streamcache)
+void CDAccess_Image::ParseTOCFileLineInfo(VirtualFS* vfs, CDRFILE_TRACK_INFO *track, const int tracknum, const std::string &filename, const char *binoffset, const char *msfoffset, const char *length, bool image_memcache, bool image_mmap, std::map<std::string, Stream*> &toc_streamcache)
 {
  long offset = 0; // In bytes!
  long tmp_long;
@@ -211,22 +211,23 @@ void CDAccess_Image::ParseTOCFileLineInfo(VirtualFS* vfs, CDRFILE_TRACK_INFO *tr
 
   efn = vfs->eval_fip(base_dir, filename);
 
-  if(image_memcache)
-   track->fp = new MemoryStream(vfs->open(efn, VirtualFS::MODE_READ));
-  else
-  {
-   track->fp = vfs->open(efn, VirtualFS::MODE_READ);
-   track->fp->require_fast_seekable();
-  }
+  track->fp = CDAccess_OpenImageStream(vfs, efn, image_memcache, image_mmap);
 
   toc_streamcache[filename] = track->fp;
  }
 
  if(filename.length() >= 4 && !MDFN_strazicmp(filename.c_str() + filename.length() - 4, ".wav"))
  {
+  // Tracks in the same file share its reader, as it reads the file from its own thread.
+  for(int32 t = 0; t < 100 && !track->FirstFileInstance && !track->AReader; t++)
+  {
+   if(&Tracks[t] != track && Tracks[t].fp == track->fp)
+    track->AReader = Tracks[t].AReader;
+  }
+
   try
   {
-   if(!(track->AReader = CDAFR_Open(track->fp)))
+   if(!track->AReader && !(track->AReader = CDAFR_Open(track->fp)))
     throw MDFN_Error(0, _("Unsupported audio track file format."));
   }
   catch(std::exception& e)
@@ -387,7 +388,7 @@ static void StringToMSF(const char* str, unsigned* m, unsigned* s, unsigned* f)
   throw MDFN_Error(0, _("M:S:F time \"%s\" contains component(s) out of range."), MDFN_strhumesc(str).c_str());
 }
 
-void CDAccess_Image::ImageOpen(VirtualFS* vfs, const std::string& path, bool image_memcache)
+void CDAccess_Image::ImageOpen(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap)
 {
  MemoryStream fp(vfs->open(path, VirtualFS::MODE_READ));
  static const unsigned max_args = 4;
@@ -539,7 +540,7 @@ void CDAccess_Image::ImageOpen(VirtualFS* vfs, const std::string& path, bool ima
       length = args[2].c_str();
      }
      //printf("%s, %s, %s, %s\n", args[0].c_str(), binoffset, msfoffset, length);
-     ParseTOCFileLineInfo(vfs, &TmpTrack, active_track, args[0], binoffset, msfoffset, length, image_memcache, toc_streamcache);
+     ParseTOCFileLineInfo(vfs, &TmpTrack, active_track, args[0], binoffset, msfoffset, length, image_memcache, image_mmap, toc_streamcache);
     }
     else if(cmdbuf == "DATAFILE")
     {
@@ -554,7 +555,7 @@ void CDAccess_Image::ImageOpen(VirtualFS* vfs, const std::string& path, bool ima
      else
       length = args[1].c_str();
 
-     ParseTOCFileLineInfo(vfs, &TmpTrack, active_track, args[0], binoffset, NULL, length, image_memcache, toc_streamcache);
+     ParseTOCFileLineInfo(vfs, &TmpTrack, active_track, args[0], binoffset, NULL, length, image_memcache, image_mmap, toc_streamcache);
     }
     else if(cmdbuf == "INDEX")
     {
@@ -646,14 +647,9 @@ void CDAccess_Image::ImageOpen(VirtualFS* vfs, const std::string& path, bool ima
      }
 
      std::string efn = vfs->eval_fip(base_dir, args[0]);
-     TmpTrack.fp = vfs->open(efn, VirtualFS::MODE_READ);
+     TmpTrack.fp = CDAccess_OpenImageStream(vfs, efn, image_memcache, image_mmap);
      TmpTrack.FirstFileInstance = 1;
 
-     if(image_memcache)
-      TmpTrack.fp = new MemoryStream(TmpTrack.fp);
-     else
-      TmpTrack.fp->require_fast_seekable();
-
      if(!MDFN_strazicmp(args[1].c_str(), "BINARY"))
      {
       //TmpTrack.Format = TRACK_FORMAT_DATA;
@@ -967,13 +963,13 @@ void CDAccess_Image::Cleanup(void)
  }
 }
 
-CDAccess_Image::CDAccess_Image(VirtualFS* vfs, const std::string& path, bool image_memcache) : NumTracks(0), FirstTrack(0), LastTrack(0), total_sectors(0)
+CDAccess_Image::CDAccess_Image(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap) : NumTracks(0), FirstTrack(0), LastTrack(0), total_sectors(0)
 {
  memset(Tracks, 0, sizeof(Tracks));
 
  try
  {
-  ImageOpen(vfs, path, image_memcache);
+  ImageOpen(vfs, path, image_memcache, image_mmap);
  }
  catch(...)
  {
@@ -987,6 +983,20 @@ CDAccess_Image::~CDAccess_Image()
  Cleanup();
 }
 
+void CDAccess_Image::HintReadSector(int32 lba)
+{
+ for(int32 track = FirstTrack; track < (FirstTrack + NumTracks); track++)
+ {
+  const CDRFILE_TRACK_INFO* ct = &Tracks[track];
+
+  if(ct->AReader && lba >= ct->LBA && lba < (ct->LBA + ct->sectors))
+  {
+   ct->AReader->Hint((ct->FileOffset / 4) + (lba - ct->LBA) * 588);
+   break;
+  }
+ }
+}
+
 void CDAccess_Image::Read_Raw_Sector(uint8 *buf, int32 lba)
 {
   uint8 SimuQ[0xC];
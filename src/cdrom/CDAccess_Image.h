@@ -66,7 +66,7 @@ class CDAccess_Image : public CDAccess
 {
  public:
 
- CDAccess_Image(VirtualFS* vfs, const std::string& path, bool image_memcache);
+ CDAccess_Image(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
  virtual ~CDAccess_Image();
 
  virtual void Read_Raw_Sector(uint8 *buf, int32 lba);
@@ -75,6 +75,8 @@ class CDAccess_Image : public CDAccess
 
  virtual void Read_TOC(CDUtility::TOC *toc);
 
+ virtual void HintReadSector(int32 lba) override;
+
  private:
 
  int32 NumTracks;
@@ -89,7 +91,7 @@ class CDAccess_Image : public CDAccess
 
  std::string base_dir;
 
- void ImageOpen(VirtualFS* vfs, const std::string& path, bool image_memcache);
+ void ImageOpen(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap);
  void LoadSBI(VirtualFS* vfs, const std::string& sbi_path);
  void GenerateTOC(void);
  void Cleanup(void);
@@ -97,7 +99,7 @@ class CDAccess_Image : public CDAccess
  // MakeSubPQ will OR the simulated P and Q subchannel data into SubPWBuf.
  int32 MakeSubPQ(int32 lba, uint8 *SubPWBuf) const;
 
- void ParseTOCFileLineInfo(VirtualFS* vfs, CDRFILE_TRACK_INFO *track, const int tracknum, const std::string &filename, const char *binoffset, const char *msfoffset, const char *length, bool image_memcache, std::map<std::string, Stream*> &toc_streamcache);
+ void ParseTOCFileLineInfo(VirtualFS* vfs, CDRFILE_TRACK_INFO *track, const int tracknum, const std::string &filename, const char *binoffset, const char *msfoffset, const char *length, bool image_memcache, bool image_mmap, std::map<std::string, Stream*> &toc_streamcache);
  uint32 GetSectorCount(CDRFILE_TRACK_INFO *track);
 };
 
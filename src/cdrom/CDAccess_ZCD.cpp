@@ -0,0 +1,254 @@
+/******************************************************************************/
+/* Mednafen - Multi-system Emulator                                           */
+/******************************************************************************/
+/* CDAccess_ZCD.cpp:
+**  Copyright (C) 2026 Mednafen Team
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software Foundation, Inc.,
+** 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <mednafen/mednafen.h>
+#include "CDAccess_ZCD.h"
+
+namespace Mednafen
+{
+
+static const char ZCD_Magic[8] = { 'M', 'D', 'F', 'N', 'Z', 'C', 'D', '1' };
+enum : uint32 { ZCD_MaxHunkSize = 1U << 20 };
+
+bool CDAccess_ZCDStream::Detect(Stream* s)
+{
+ uint8 magic[sizeof(ZCD_Magic)];
+ const uint64 rc = s->read(magic, sizeof(magic), false);
+
+ s->seek(0, SEEK_SET);
+
+ return rc == sizeof(magic) && !memcmp(magic, ZCD_Magic, sizeof(magic));
+}
+
+CDAccess_ZCDStream::CDAccess_ZCDStream(std::unique_ptr<Stream> s) : src(std::move(s)), dctx(nullptr), use_counter(0), cbuf_size(0), position(0)
+{
+ uint8 header[24];
+ uint64 file_size;
+
+ src->require_fast_seekable();
+ file_size = src->size();
+
+ src->read(header, sizeof(header));
+
+ if(memcmp(header, ZCD_Magic, sizeof(ZCD_Magic)))
+  throw MDFN_Error(0, _("Not a compressed CD image file."));
+
+ hunk_size = MDFN_de32lsb(&header[8]);
+ hunk_count = MDFN_de32lsb(&header[12]);
+ total_size = MDFN_de64lsb(&header[16]);
+
+ if(!hunk_size || hunk_size > ZCD_MaxHunkSize)
+  throw MDFN_Error(0, _("Compressed CD image hunk size of %u bytes is invalid."), hunk_size);
+
+ if(hunk_count != (total_size + hunk_size - 1) / hunk_size)
+  throw MDFN_Error(0, _("Compressed CD image hunk count doesn't match its size."));
+
+ if(((uint64)hunk_count + 1) * 8 > file_size - sizeof(header))
+  throw MDFN_Error(0, _("Compressed CD image hunk index is truncated."));
+
+ hunk_offs.reset(new uint64[hunk_count + 1]);
+ {
+  std::unique_ptr<uint8[]> raw(new uint8[((size_t)hunk_count + 1) * 8]);
+
+  src->read(raw.get(), ((uint64)hunk_count + 1) * 8);
+
+  for(uint32 i = 0; i <= hunk_count; i++)
+  {
+   hunk_offs[i] = MDFN_de64lsb(&raw[(size_t)i * 8]);
+
+   if(hunk_offs[i] < sizeof(header) + ((uint64)hunk_count + 1) * 8 || hunk_offs[i] > file_size || (i && hunk_offs[i] < hunk_offs[i - 1]))
+    throw MDFN_Error(0, _("Compressed CD image hunk index entry %u is invalid."), i);
+
+   if(i)
+    cbuf_size = std::max<uint64>(cbuf_size, hunk_offs[i] - hunk_offs[i - 1]);
+  }
+ }
+
+ if(cbuf_size > ZSTD_COMPRESSBOUND(hunk_size))
+  throw MDFN_Error(0, _("Compressed CD image has a hunk larger than its hunk size allows."));
+
+ cbuf.reset(new uint8[std::max<uint32>(1, cbuf_size)]);
+
+ for(auto& ce : cache)
+ {
+  ce.index = ~0U;
+  ce.last_used = 0;
+  ce.data.reset(new uint8[hunk_size]);
+ }
+
+ if(!(dctx = ZSTD_createDCtx()))
+  throw MDFN_Error(0, _("%s failed."), "ZSTD_createDCtx()");
+}
+
+CDAccess_ZCDStream::~CDAccess_ZCDStream()
+{
+ if(dctx)
+ {
+  ZSTD_freeDCtx(dctx);
+  dctx = nullptr;
+ }
+}
+
+const uint8* CDAccess_ZCDStream::GetHunk(uint32 index)
+{
+ auto* victim = &cache[0];
+
+ use_counter++;
+
+ for(auto& ce : cache)
+ {
+  if(ce.index == index)
+  {
+   ce.last_used = use_counter;
+   return ce.data.get();
+  }
+
+  if(ce.last_used < victim->last_used)
+   victim = &ce;
+ }
+ //
+ //
+ const uint64 clen = hunk_offs[index + 1] - hunk_offs[index];
+ const uint32 ulen = (index == hunk_count - 1) ? (uint32)(total_size - (uint64)index * hunk_size) : hunk_size;
+
+ victim->index = ~0U;
+
+ src->seek(hunk_offs[index], SEEK_SET);
+
+ if(clen == ulen)
+  src->read(victim->data.get(), ulen);
+ else
+ {
+  src->read(cbuf.get(), clen);
+
+  const size_t res = ZSTD_decompressDCtx(dctx, victim->data.get(), ulen, cbuf.get(), clen);
+
+  if(ZSTD_isError(res))
+   throw MDFN_Error(0, _("Error decompressing CD image hunk %u: %s"), index, ZSTD_getErrorName(res));
+
+  if(res != ulen)
+   throw MDFN_Error(0, _("CD image hunk %u decompressed to %llu bytes instead of %u."), index, (unsigned long long)res, ulen);
+ }
+
+ victim->index = index;
+ victim->last_used = use_counter;
+
+ return victim->data.get();
+}
+
+uint64 CDAccess_ZCDStream::attributes(void)
+{
+ return ATTRIBUTE_READABLE | ATTRIBUTE_SEEKABLE;
+}
+
+uint64 CDAccess_ZCDStream::read(void *data, uint64 count, bool error_on_eos)
+{
+ uint8* d = (uint8*)data;
+ uint64 ret = 0;
+
+ if(position >= total_size || count > total_size - position)
+ {
+  if(error_on_eos)
+   throw MDFN_Error(0, _("Unexpected EOF"));
+
+  count = (position < total_size) ? (total_size - position) : 0;
+ }
+
+ while(count)
+ {
+  const uint32 index = position / hunk_size;
+  const uint32 offs = position % hunk_size;
+  const uint32 n = std::min<uint64>(count, hunk_size - offs);
+
+  memcpy(d, GetHunk(index) + offs, n);
+  d += n;
+  position += n;
+  count -= n;
+  ret += n;
+ }
+
+ return ret;
+}
+
+void CDAccess_ZCDStream::write(const void *data, uint64 count)
+{
+ throw MDFN_Error(EINVAL, _("Write attempted to compressed CD image stream."));
+}
+
+void CDAccess_ZCDStream::truncate(uint64 length)
+{
+ throw MDFN_Error(EINVAL, _("Truncate attempted on compressed CD image stream."));
+}
+
+void CDAccess_ZCDStream::seek(int64 offset, int whence)
+{
+ int64 new_position;
+
+ switch(whence)
+ {
+  default:
+	throw MDFN_Error(ErrnoHolder(EINVAL));
+	break;
+
+  case SEEK_SET:
+	new_position = offset;
+	break;
+
+  case SEEK_CUR:
+	new_position = position + offset;
+	break;
+
+  case SEEK_END:
+	new_position = total_size + offset;
+	break;
+ }
+
+ if(new_position < 0)
+  throw MDFN_Error(ErrnoHolder(EINVAL));
+
+ position = new_position;
+}
+
+uint64 CDAccess_ZCDStream::tell(void)
+{
+ return position;
+}
+
+uint64 CDAccess_ZCDStream::size(void)
+{
+ return total_size;
+}
+
+void CDAccess_ZCDStream::flush(void)
+{
+
+}
+
+void CDAccess_ZCDStream::close(void)
+{
+ if(src)
+ {
+  src->close();
+  src.reset();
+ }
+}
+
+}
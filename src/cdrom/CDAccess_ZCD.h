@@ -0,0 +1,90 @@
+/******************************************************************************/
+/* Mednafen - Multi-system Emulator                                           */
+/******************************************************************************/
+/* CDAccess_ZCD.h:
+**  Copyright (C) 2026 Mednafen Team
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software Foundation, Inc.,
+** 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __MDFN_CDROM_CDACCESS_ZCD_H
+#define __MDFN_CDROM_CDACCESS_ZCD_H
+
+#include <mednafen/Stream.h>
+
+#include <zstd/zstd.h>
+
+namespace Mednafen
+{
+
+//
+// Read-only random access view of a hunk-compressed image data file(written by zcd_pack.py).  Layout, all little-endian:
+//
+//  "MDFNZCD1", le32 hunk size, le32 hunk count, le64 uncompressed size,
+//  le64 file offset of each hunk's data, plus one more for the end of the last hunk,
+//  then the hunks: each a zstd frame, or stored as-is when its compressed length equals its uncompressed length.
+//
+// Every hunk but the last is "hunk size" bytes uncompressed.  The most recently used hunks are kept decompressed.
+//
+class CDAccess_ZCDStream final : public Stream
+{
+ public:
+
+ // Returns true if "s" starts with the ZCD magic; "s" is left positioned at 0.
+ static bool Detect(Stream* s);
+
+ CDAccess_ZCDStream(std::unique_ptr<Stream> s);
+ virtual ~CDAccess_ZCDStream() override;
+
+ virtual uint64 attributes(void) override;
+
+ virtual uint64 read(void *data, uint64 count, bool error_on_eos = true) override;
+ virtual void write(const void *data, uint64 count) override;
+ virtual void truncate(uint64 length) override;
+ virtual void seek(int64 offset, int whence) override;
+ virtual uint64 tell(void) override;
+ virtual uint64 size(void) override;
+ virtual void flush(void) override;
+ virtual void close(void) override;
+
+ private:
+
+ const uint8* GetHunk(uint32 index);
+
+ std::unique_ptr<Stream> src;
+ ZSTD_DCtx* dctx;
+
+ uint32 hunk_size;
+ uint32 hunk_count;
+ uint64 total_size;
+ std::unique_ptr<uint64[]> hunk_offs;
+
+ enum { CacheSize = 16 };
+ struct
+ {
+  uint32 index;
+  uint64 last_used;
+  std::unique_ptr<uint8[]> data;
+ } cache[CacheSize];
+ uint64 use_counter;
+
+ std::unique_ptr<uint8[]> cbuf;
+ uint32 cbuf_size;
+
+ uint64 position;
+};
+
+}
+#endif
@@ -47,6 +47,11 @@ bool CDInterface::NonDeterministic_CheckSectorReady(int32 lba)
  return true;
 }
 
+void CDInterface::HintReadRange(int32 lba, int32 end_lba)
+{
+ HintReadSector(lba);
+}
+
 uint8 CDInterface::ReadSectors(uint8* buf, int32 lba, uint32 sector_count)
 {
  uint8 ret = 0;
@@ -227,23 +232,24 @@ Stream *CDInterface::MakeStream(int32 lba, uint32 sector_count)
 }
 
 
-CDInterface* CDInterface::Open(VirtualFS* vfs, const std::string& path, bool image_memcache, const uint64 affinity)
+CDInterface* CDInterface::Open(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap, const uint64 affinity)
 {
  //
- // Don't allow a custom VirtualFS implementation unless CD image memory caching is enabled, due to thread
- // safety and vfs object persistence/lifetime issues.
+ // Don't allow a custom VirtualFS implementation unless CD image memory caching or mapping is enabled, due to
+ // thread safety and vfs object persistence/lifetime issues(archive entries opened with image_mmap are mapped or
+ // decompressed into memory, and the single-threaded interface is used).
  //
  // TODO: Maybe add is_nonpersistent() and is_mtsafe() sort of functions to VirtualFS instead?
  // TODO: More general error message when 'vfs' isn't an object of a class derived from ArchiveReader.
  //
- if(vfs != &NVFS && !image_memcache)
-  throw MDFN_Error(0, _("CD image memory caching must be enabled to allow loading a CD image from an archive."));
+ if(vfs != &NVFS && !image_memcache && !image_mmap)
+  throw MDFN_Error(0, _("CD image memory caching or mapping must be enabled to allow loading a CD image from an archive."));
  //
  //
  //
- std::unique_ptr<CDAccess> cda(CDAccess_Open(vfs, path, image_memcache));
+ std::unique_ptr<CDAccess> cda(CDAccess_Open(vfs, path, image_memcache, image_mmap));
 
- if(image_memcache)
+ if(image_memcache || image_mmap)
   return new CDInterface_ST(std::move(cda));
  else
   return new CDInterface_MT(std::move(cda), affinity);
@@ -35,13 +35,16 @@ class CDInterface
 
  //
  // Creates a multi-threaded or single-threaded CD interface object, depending
- // on the value of "image_memcache", to read the CD image at "path".
+ // on the value of "image_memcache" and "image_mmap", to read the CD image at "path".
  //
  // If "image_memcache" is false, then the VirtualFS object must remain valid until
  // the CDInterface object is deleted.  If "image_memcache" is true, then the VirtualFS object
  // only needs to remain valid until Open() returns.
  //
- static CDInterface* Open(VirtualFS* vfs, const std::string& path, bool image_memcache, const uint64 affinity);
+ // "image_mmap" maps the image files read-only instead of reading them in, when "image_memcache"
+ // is false and the files can be mapped; reads are then done synchronously like with "image_memcache".
+ //
+ static CDInterface* Open(VirtualFS* vfs, const std::string& path, bool image_memcache, bool image_mmap, const uint64 affinity);
 
  CDInterface();
  virtual ~CDInterface();
@@ -58,6 +61,13 @@ class CDInterface
  //
  virtual void HintReadSector(int32 lba) = 0;
 
+ //
+ // Like HintReadSector(), but sectors lba through end_lba - 1 are also expected to
+ // be read in order afterwards(e.g. a CD play range), so they may be read ahead in
+ // larger chunks.
+ //
+ virtual void HintReadRange(int32 lba, int32 end_lba);
+
  //
  // Reads 2352+96 bytes of data into buf.  The data for "data" sectors is 
  // currently returned descrambled(TODO: probably want to change that someday).
@@ -135,6 +135,7 @@ int CDInterface_MT::ReadThreadStart()
  ra_lba = 0;
  ra_count = 0;
  last_read_lba = LBA_Read_Maximum + 1;
+ ra_window_end = 0;
 
  try
  {
@@ -149,6 +150,7 @@ int CDInterface_MT::ReadThreadStart()
   ra_lba = 0;
   ra_count = 0;
   last_read_lba = LBA_Read_Maximum + 1;
+  ra_window_end = 0;
   memset(SectorBuffers, 0, SBSize * sizeof(CDInterface_Sector_Buffer));
  }
  catch(std::exception &e)
@@ -175,16 +177,26 @@ int CDInterface_MT::ReadThreadStart()
     static const int max_ra = 16;
     static const int initial_ra = 1;
     static const int speedmult_ra = 2;
+    static const int window_ra = 192;	// Inside a hinted sequential window.
     //
     const int32 new_lba = msg.args[0];
+    const int32 new_window_end = msg.args[1];
 
     static_assert((unsigned int)max_ra < (SBSize / 4), "Max readahead too large.");
+    static_assert((unsigned int)window_ra < (SBSize / 4), "Window readahead too large.");
+
+    if(new_window_end)
+     ra_window_end = new_window_end;
+    else if(new_lba != (last_read_lba + 1) && new_lba != last_read_lba && (new_lba < ra_lba - window_ra || new_lba >= ra_window_end))
+     ra_window_end = 0;	// Jumped somewhere else.
 
     if(new_lba == (last_read_lba + 1))
     {
      int how_far_ahead = ra_lba - new_lba;
 
-     if(how_far_ahead <= max_ra)
+     if(new_lba < ra_window_end)
+      ra_count = std::max(ra_count, std::min<int32>(1 + window_ra - how_far_ahead, ra_window_end - ra_lba));
+     else if(how_far_ahead <= max_ra)
       ra_count = std::min(speedmult_ra, 1 + max_ra - how_far_ahead);
      else
       ra_count++;
@@ -192,7 +204,7 @@ int CDInterface_MT::ReadThreadStart()
     else if(new_lba != last_read_lba)
     {
      ra_lba = new_lba;
-     ra_count = initial_ra;
+     ra_count = (new_lba < ra_window_end) ? std::min<int32>(window_ra, ra_window_end - new_lba) : initial_ra;
     }
 
     last_read_lba = new_lba;
@@ -414,4 +426,17 @@ void CDInterface_MT::HintReadSector(int32 lba)
  ReadThreadQueue.Write(CDInterface_Message(CDInterface_MSG_READ_SECTOR, lba));
 }
 
+void CDInterface_MT::HintReadRange(int32 lba, int32 end_lba)
+{
+ if(UnrecoverableError)
+  return;
+
+ end_lba = std::min<int32>(end_lba, LBA_Read_Maximum + 1);
+
+ if(end_lba <= lba + 1)
+  HintReadSector(lba);
+ else
+  ReadThreadQueue.Write(CDInterface_Message(CDInterface_MSG_READ_SECTOR, lba, end_lba));
+}
+
 }
@@ -39,6 +39,7 @@ class CDInterface_MT : public CDInterface
  virtual ~CDInterface_MT() MDFN_COLD;
 
  virtual void HintReadSector(int32 lba) override;
+ virtual void HintReadRange(int32 lba, int32 end_lba) override;
  virtual bool ReadRawSector(uint8 *buf, int32 lba) override;
  virtual bool ReadRawSectorPWOnly(uint8* pwbuf, int32 lba, bool hint_fullread) override;
 
@@ -67,6 +68,7 @@ class CDInterface_MT : public CDInterface
 
   CDInterface_MSG_READ_SECTOR,		/* Emu -> read
 					args[0] = lba
+					args[1] = end of the sequential read window(exclusive), or 0 to keep the current one
 				*/
  };
 
@@ -108,7 +110,7 @@ class CDInterface_MT : public CDInterface
  // Queue for messages to the emu thread.
  CDInterface_Queue EmuThreadQueue;
 
- enum { SBSize = 256 };
+ enum { SBSize = 1024 };
  struct CDInterface_Sector_Buffer
  {
   bool valid;
@@ -128,6 +130,7 @@ class CDInterface_MT : public CDInterface
  int32 ra_lba;
  int32 ra_count;
  int32 last_read_lba;
+ int32 ra_window_end;
 };
 
 }
@@ -115,16 +115,49 @@ static const unsigned long  edctable[256] =
  0x71C0FC00L, 0xE151FD01L, 0xE0E1FE01L, 0x7070FF00L
 };
 
+/*
+ * Slicing-by-8 tables: slice[k][b] is the CRC of byte b followed by k zero
+ * bytes, so eight input bytes are folded in with eight independent lookups
+ * rather than a chain of eight dependent ones.
+ */
+
+static const struct EDCSliceTable
+{
+ uint32 slice[8][256];
+
+ EDCSliceTable()
+ {
+  for(unsigned i = 0; i < 256; i++)
+   slice[0][i] = edctable[i];
+
+  for(unsigned k = 1; k < 8; k++)
+   for(unsigned i = 0; i < 256; i++)
+    slice[k][i] = (slice[k - 1][i] >> 8) ^ slice[0][slice[k - 1][i] & 0xFF];
+ }
+} edcslice;
+
 /*
  * CDROM EDC calculation
  */
 
 uint32 EDCCrc32(const unsigned char *data, int len)
 {  
+ const uint32 (*const t)[256] = edcslice.slice;
  uint32 crc = 0;
 
+ while(len >= 8)
+ {
+  const uint32 lo = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24));
+
+  crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+	t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+
+  data += 8;
+  len -= 8;
+ }
+
  while(len--)
-  crc = edctable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
 
  return crc;
 }
@@ -39,7 +39,8 @@ class StreamViewFilter : public Stream
 {
  public:
 
- StreamViewFilter(Stream* source_stream, const std::string& vfc, uint64 sp, uint64 bp, uint64 expcrc32 = (uint64)-1);
+ // Shares ownership of the source stream, so the view stays usable after the ZIPReader is gone.
+ StreamViewFilter(std::shared_ptr<Stream> source_stream, const std::string& vfc, uint64 sp, uint64 bp, uint64 expcrc32 = (uint64)-1);
  virtual ~StreamViewFilter() override;
  virtual uint64 read(void *data, uint64 count, bool error_on_eos = true) override;
  virtual void write(const void *data, uint64 count) override;
@@ -51,8 +52,12 @@ class StreamViewFilter : public Stream
  virtual void truncate(uint64 length) override;
  virtual void flush(void) override;
 
+ virtual uint8* map(void) noexcept override;
+ virtual uint64 map_size(void) noexcept override;
+ virtual void unmap(void) noexcept override;
+
  private:
- Stream* ss;
+ std::shared_ptr<Stream> ss;
  uint64 ss_start_pos;
  uint64 ss_bound_pos;
 
@@ -64,7 +69,7 @@ class StreamViewFilter : public Stream
  const std::string vfcontext;
 };
 
-StreamViewFilter::StreamViewFilter(Stream* source_stream, const std::string& vfc, uint64 sp, uint64 bp, uint64 expcrc32) : ss(source_stream), ss_start_pos(sp), ss_bound_pos(bp), pos(0), running_crc32(0), running_crc32_posreached(0), expected_crc32(expcrc32), vfcontext(vfc)
+StreamViewFilter::StreamViewFilter(std::shared_ptr<Stream> source_stream, const std::string& vfc, uint64 sp, uint64 bp, uint64 expcrc32) : ss(std::move(source_stream)), ss_start_pos(sp), ss_bound_pos(bp), pos(0), running_crc32(0), running_crc32_posreached(0), expected_crc32(expcrc32), vfcontext(vfc)
 {
  if(ss_bound_pos < ss_start_pos)
   throw MDFN_Error(0, _("StreamViewFilter() bound_pos < start_pos"));
@@ -185,7 +190,7 @@ uint64 StreamViewFilter::size(void)
 
 void StreamViewFilter::close(void)
 {
- ss = nullptr;
+ ss.reset();
 }
 
 uint64 StreamViewFilter::attributes(void)
@@ -204,6 +209,31 @@ void StreamViewFilter::flush(void)
  ss->flush();
 }
 
+//
+// Maps the whole archive through the source stream and points into it, so a stored entry is used in place
+// without being copied; the CRC32 isn't checked in that case, as that would mean reading in all of the data up
+// front.  The mapping belongs to the source stream and goes away with it, so unmap() leaves it alone.
+//
+uint8* StreamViewFilter::map(void) noexcept
+{
+ uint8* p = ss->map();
+
+ if(!p || ss->map_size() < ss_bound_pos)
+  return nullptr;
+
+ return p + ss_start_pos;
+}
+
+uint64 StreamViewFilter::map_size(void) noexcept
+{
+ return (ss->map_size() >= ss_bound_pos ? (ss_bound_pos - ss_start_pos) : 0);
+}
+
+void StreamViewFilter::unmap(void) noexcept
+{
+
+}
+
 
 size_t ZIPReader::num_files(void)
 {
@@ -284,10 +314,10 @@ Stream* ZIPReader::open(size_t which)
 
  const std::string vfcontext = MDFN_sprintf(_("opened file %s"), this->get_human_path(e.name).c_str());
 
- return make_stream(zs.get(), vfcontext, e.method, e.comp_size, e.uncomp_size, e.crc32);
+ return make_stream(zs, vfcontext, e.method, e.comp_size, e.uncomp_size, e.crc32);
 }
 
-Stream* ZIPReader::make_stream(Stream* s, std::string vfcontext, const uint16 method, const uint64 comp_size, const uint64 uncomp_size, const uint32 crc)
+Stream* ZIPReader::make_stream(const std::shared_ptr<Stream>& s, std::string vfcontext, const uint16 method, const uint64 comp_size, const uint64 uncomp_size, const uint32 crc)
 {
  if(method == 0)
  {
@@ -297,9 +327,9 @@ Stream* ZIPReader::make_stream(Stream* s, std::string vfcontext, const uint16 me
   return new StreamViewFilter(s, vfcontext, start_pos, bound_pos, crc);
  }
  else if(method == 8)
-  return new ZLInflateFilter(s, vfcontext, ZLInflateFilter::FORMAT::RAW, comp_size, uncomp_size, crc);
+  return new ZLInflateFilter(s.get(), vfcontext, ZLInflateFilter::FORMAT::RAW, comp_size, uncomp_size, crc);
  else if(method == 93 || method == 20)
-  return new ZstdDecompressFilter(s, vfcontext, comp_size, uncomp_size, EnableZstandardCRC32Check ? crc : (uint64)-1);
+  return new ZstdDecompressFilter(s.get(), vfcontext, comp_size, uncomp_size, EnableZstandardCRC32Check ? crc : (uint64)-1);
  //else if(method == 97) // TODO, maybe?
  // return new WAVPackDecodeFilter(s, vfcontext, comp_size, uncomp_size, crc);
  else
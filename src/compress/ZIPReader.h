@@ -72,7 +72,7 @@ class ZIPReader : public ArchiveReader
  };
 
  void read_central_directory(Stream* s, const uint64 zip_size, const uint64 total_cde_count);
- Stream* make_stream(Stream* s, std::string vfcontext, const uint16 method, const uint64 comp_size, const uint64 uncomp_size, const uint32 crc);
+ Stream* make_stream(const std::shared_ptr<Stream>& s, std::string vfcontext, const uint16 method, const uint64 comp_size, const uint64 uncomp_size, const uint32 crc);
 
  struct FileEntry
  {
@@ -87,7 +87,7 @@ class ZIPReader : public ArchiveReader
   uint16 method;
  };
 
- std::unique_ptr<Stream> zs;
+ std::shared_ptr<Stream> zs;	// shared with the stored entries' views
  std::vector<FileEntry> entries;
  std::map<std::string, size_t > entries_map;
 
@@ -5,13 +5,76 @@
  *   Mednafen executes command, writes result to <base_dir>/mednafen_ack.txt
  *   External tool reads ack, writes next command.
  *
+ *   Optional socket transport (--automation_socket tcp:<port> | <unix path>):
+ *   send the same commands as '\n'-terminated lines; each ack comes back as
+ *   "<nbytes>\n" followed by nbytes of ack text. Binary replies (read_mem,
+ *   read_regs) come first as "#<nbytes>\n" + raw bytes, then the text ack.
+ *   Acks go to whichever transport issued the most recent command. Paused loops block on socket
+ *   readiness instead of sleeping, so round trips are sub-millisecond.
+ *
+ *   Event stream ("subscribe on" over the socket): everything written while no command is
+ *   running -- breakpoint/watchpoint/exception hits, "done ..." of frame_advance and friends,
+ *   background write results -- is pushed to the socket as "!<nbytes>\n" + text, in order and
+ *   with the usual seq=, whichever transport issued the command; log-mode watchpoint and
+ *   exception hits, which never ack, are pushed too. Replies to commands keep the plain framing.
+ *
+ *   Headless batch mode (--automation_headless): no window, no throttling, and
+ *   VDP2 output is only composed for frames a screenshot or scheduled pause
+ *   needs; a screenshot of a skipped frame is acked when the next frame ends.
+ *
  * Commands:
  *   frame_advance [N]          - Run N frames then pause (default 1)
- *   screenshot <path>          - Save cached framebuffer to PNG (no frame advance, no PC movement)
+ *   screenshot <path> [crop=X,Y,W,H] [down=N] - Save cached framebuffer to PNG (no frame advance, no
+ *                                PC movement); crop in image pixels, down = integer downscale
+ *   screenshot_phash [crop=X,Y,W,H] - No file: ack a 64-bit DCT perceptual hash of the frame (or crop)
+ *   frame_dump <dir> [every=N] [format=png|qoi|raw|none] [workers=N] [stream]
+ *                              - Write every Nth frame (default 1) to dir on background encoder
+ *                                threads (default png at zlib level 1, 2 workers); stream also
+ *                                appends RGB24 frames to dir/stream.rgb for ffmpeg (see frame_dump.h).
+ *                                Dumped frames are always rendered, also in headless mode.
+ *   frame_dump_stop            - Finish writing queued frames; reports frames, stalls, stream size
+ *   fb_hash_start [path] [all] - XXH64 of each rendered frame's visible lines (per-line widths), shown
+ *                                by status; with path, appends "frame=N hash=H" per hashed frame.
+ *                                "all" renders (and hashes) every frame, also in headless mode.
+ *   fb_hash_stop               - Stop hashing and close the log
+ *   diverge_record <path> [N]  - Every N frames, append CPU registers and per-64 KiB RAM/VRAM hashes to path
+ *   diverge_check <path>       - Compare against a diverge_record file (live or finished); pauses with
+ *                                "break diverge" at the first differing sample
+ *   diverge_stop               - Stop recording/checking
+ *   state_hash                 - XXH64 of each save state section (SH2-M, MAIN, VDP2, SOUND, CDB ...) now
+ *   state_hash_log <path> [N]  - Every N frames, append a "frame= cycle= SECTION=hash ..." line to path
+ *   state_hash_check <path>    - Compare against a state_hash_log file; pauses with "break state_hash"
+ *                                naming the first section that differs
+ *   state_hash_stop            - Stop logging/checking
+ *   journal_record <path>      - Start a replay journal: the current state, then only what comes from
+ *                                outside the core (input changes, pokes, state loads), cycle-keyed
+ *   journal_play <path>        - Load the journal's state and replay it free-running; acks
+ *                                "done journal_play match=yes|no" where journal_stop was recorded
+ *   journal_stop               - Finish recording (stores an end-state hash) or stop playback
+ *   render_skip [on|off]       - Skip VDP2 output for all but the last frame of frame_advance N /
+ *                                run_to_frame / mem_sample (emulated state is unaffected)
+ *   benchmark <frames> <state> - Load state, release all input and run N frames at speed max with
+ *                                perf_stats on; acks "done benchmark frames=N seconds=S fps=F
+ *                                hash=<state xxh64>" plus the perf_stats per-frame averages
+ *   speed [max|normal]         - max: run frames back to back with no throttling, no sound output and
+ *                                VDP2 output only where headless mode would render (also --automation_turbo)
  *   input <button>             - Press button (START, A, B, C, X, Y, Z, UP, DOWN, LEFT, RIGHT, L, R)
  *   input_release <button>     - Release button
  *   input_clear                - Release all buttons
+ *   input_port <port> <hex>|clear - Set a port's raw input data (the device's own byte layout, e.g.
+ *                                "0880" for a gamepad), replacing mapped input until cleared
+ *   input_exclusive on|off     - Automation owns the input: the driver stops polling keyboard/joysticks,
+ *                                command keys and input mapping, and ports carry only automation input
  *   run_to_frame <N>           - Run until frame N then pause
+ *   run_until [every=C] <expr> [max_frames] - Run until expr (breakpoint condition syntax, plus frame and
+ *                                cycles since the command) is nonzero at a frame end, or with every=C
+ *                                also every C master cycles; "done run_until ... [timeout]"
+ *   run_to_line <line> [frame] - Run until VDP2 starts scanline <line> (0 = first active line), in
+ *                                frame <frame> or later if given; "done run_to_line line=N frame=F pc=..."
+ *   break_on_vblank_in on|off  - Pause when VBlank starts ("break vblank_in line=N frame=F pc=...")
+ *   break_on_vblank_out on|off - Pause when VBlank ends ("break vblank_out ...")
+ *   gdb_server <port>|stop     - Serve the GDB remote protocol on loopback <port> (also --automation_gdb):
+ *                                both SH-2s as threads, Z0-Z4 breakpoints/watchpoints, vCont, monitor <cmd>
  *   quit                       - Clean shutdown
  *   dump_regs                  - Dump SH-2 master CPU registers (text: 23 values incl MACL)
  *   dump_regs_bin <path>       - Write 22 uint32s (R0-R15,PC,SR,PR,GBR,VBR,MACH) to binary file
@@ -19,31 +82,225 @@
  *   dump_slave_regs_bin <path> - Write 22 uint32s for slave SH-2
  *   dump_mem <addr> <size>     - Dump memory (hex), addr in hex, max 4KB text (use dump_mem_bin for larger)
  *   dump_mem_bin <addr> <sz> <path> - Write raw memory bytes to binary file (max 1MB)
+ *   read_mem <addr> <sz> [<addr> <sz> ...] - Socket only: all ranges in one binary frame (max 16MB)
+ *   read_regs [master|slave|both] - Socket only: 22 uint32s per CPU (dump_regs_bin layout) as a binary frame
+ *   subscribe on|off           - Socket only: push events to this connection (see Event stream above)
  *   poke <addr> <b0> [b1 ...]    - Write bytes to memory (hex addr, hex bytes). Updates cache.
- *   dump_region <name> <path>  - Dump named region: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram
+ *   write_mem_bin <addr> <path|hex:bytes> - Bulk write a file (max 16MB) or inline hex to WRAM-H/L,
+ *                                purging the touched SH-2 cache lines
+ *   dump_region <name> <path> [cached]
+ *                              - Dump named region: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram;
+ *                                cached = overlay the master SH-2 cache, as the CPU sees it
+ *   vram_delta <path> [append] [full] [vdp1_vram] [vdp2_vram] [vdp2_cram]
+ *                              - Write the 32-byte blocks of the regions (default all three) changed
+ *                                since the last vram_delta, as runs; full = every block
+ *   scan_start <1|2|4> [region ...] - Start a value search over named regions (default wram_high wram_low)
+ *   scan_filter <op> [N]       - Keep candidates where op holds: eq ne gt lt (vs N, or vs the last snapshot
+ *                                if N is omitted), changed, unchanged, delta N (now - last == N)
+ *   scan_list [max]            - List surviving addresses with their last values (default 100)
+ *   scan_stop                  - Drop the search
+ *   mem_snapshot <name> [region ...] - Keep a copy of named regions (default wram_high wram_low)
+ *   mem_snapshot_free <name|all> - Drop snapshots
+ *   mem_diff <a> <b|live> [max=N] [bytes=N] - Changed ranges between two snapshots (or a snapshot and
+ *                                memory now): addr:len old=hex new=hex, first N ranges (default 100)
  *   dump_vdp2_regs <path>      - Write VDP2 register state to binary file
+ *   dump_vdp1_fb <draw|display> <path> [png=<path>] - Write a whole VDP1 framebuffer as raw big-endian
+ *                                words (bus order; 8bpp modes are one byte per pixel), optionally also
+ *                                as a PNG on a background encoder thread
+ *   shm_expose <path> [every=N] [region ...] - Map named regions (default all) into a shared file,
+ *                                refreshed every N frames; header has a seqlock counter
+ *   shm_sync                   - Refresh the shared mapping now (e.g. while paused mid-frame)
+ *   shm_close                  - Remove the shared mapping
+ *   obs_expose <path> [w=80] [h=60] [gray|rgb] [every=N] - Map an area-averaged, downscaled copy of
+ *                                the visible frame into a shared file, refreshed every N frames (seqlock)
+ *   obs_close                  - Remove the observation mapping
  *   dump_cycle                 - Report current absolute master cycle count
- *   run_to_cycle <N>           - Run until master cycle count reaches N
+ *   run_to_cycle <N>           - Run until master cycle count reaches N (N in the past: re-run from history)
+ *   history_start [every=N] [slots=M]
+ *                              - Keep a snapshot every N frames (default 60) in a ring of M (default 16),
+ *                                plus the input and pokes since the oldest, for reverse execution
+ *   history_stop               - Drop the history
+ *   history_status             - Mode, snapshot count, oldest/newest frame and cycle, bytes held
+ *   step_back [N]              - Back N master instructions (default 1): restore + re-execute
+ *   reverse_continue [N]       - Back to the Nth previous breakpoint or watchpoint hit that paused
  *   pc_trace_frame <path>      - Trace all master CPU PCs for 1 frame to binary file
+ *   profile_start [interval] [master|slave|both] - Sampling profiler: PC + shadow call chain every
+ *                                interval master cycles (default 1000, both CPUs). Clears old samples.
+ *   profile_stop               - Stop sampling (samples kept for profile_dump)
+ *   profile_dump <path> [flat|func] - Folded stacks for flamegraph.pl/speedscope, weighted in cycles;
+ *                                "flat" = per-PC "<cpu> <pc> <samples> <cycles>", hottest first;
+ *                                "func" = the same summed per load_symbols function
+ *   profile_status             - Report active state, interval, samples per CPU, unique stacks
+ *   cache_stats_start          - Count SH-2 cache read hits/misses (insn/data), purges, CCR writes,
+ *                                and misses per 16-byte line. Insn fetches need full cache emulation.
+ *   cache_stats [N]            - Report counters per CPU, plus the top N missing lines (default 16)
+ *   cache_stats_dump <path>    - Write counters + full miss histogram ("MDFNCST1", see Automation_CacheStatsDump)
+ *   cache_stats_stop           - Stop counting (counters kept)
+ *   cache_mode [detect [assoc_purge|ccr_purge|alias|smc ...]|off|full]
+ *                              - Report the SH-2 cache emulation mode; arm (default assoc_purge alias smc)
+ *                                or disarm the switch to full emulation, or switch now (next frame, one way)
+ *   bus_profile_start [path]   - Count SH-2 external bus accesses + cycles per CPU x read/write x region
+ *                                (BIOS LWRAM HWRAM VDP1 VDP2 SCSP CD CART SCU OTHER), rolled per frame.
+ *                                With path, appends one line per frame to that file.
+ *   bus_profile [total]        - Report the last frame's (or, with "total", all) nonzero counters as
+ *                                m.r.HWRAM=<count>/<cycles> tokens (m/s = CPU, r/w = direction)
+ *   bus_profile_stop           - Stop counting and close the per-frame log
+ *   int_latency_start [path]   - Time SCU interrupts from assertion to the master SH-2's vector
+ *                                fetch per source, rolled per frame; with path, one line per frame
+ *   int_latency [total]        - Last frame's (or all) VBIN=<count>/<cycles>/<max>/<masked>[b<k>=<n>,...]
+ *                                tokens; b<k> counts latencies of 2^k to 2^(k+1)-1 cycles
+ *   int_latency_dump <path>    - Write the totals: histograms, then the PCs where SR.I held interrupts off
+ *   int_latency_stop           - Stop timing and close the per-frame log
+ *   sync_profile_start [path]  - Count cycles each SH-2 spends in polling loops on work RAM or FTCSR
+ *                                (sync waits) per loop, rolled per frame; with path, one line per frame
+ *   sync_profile [total]       - Last frame's (or all) m=<wait>/<cycles> s=<wait>/<cycles>, plus the
+ *                                top sync point per CPU as m.top=<pc>:<cycles>
+ *   sync_profile_dump <path> [top] - Write the sync points per CPU, most wait cycles first
+ *   sync_profile_stop          - Stop counting and close the per-frame log
+ *   event_stats [total|reset]  - Scheduler event handler calls in the last frame (or since the
+ *                                last reset) as sh2_m_dma=<calls> ... tokens; "reset" zeroes them
+ *   vdp2_timing_start [path]   - Time the VDP2 render thread per layer (setup spr rbg0 rbg1 nbg0-3 mix),
+ *                                summed per rendered frame; also shown under the FPS overlay.
+ *                                With path, appends one line per rendered frame to that file.
+ *   vdp2_timing [total]        - Report the last rendered frame (or the per-frame average) in microseconds
+ *   vdp2_timing_stop           - Stop timing and close the per-frame log
+ *   vdp2_preview [on|off]      - Preview rendering: odd lines repeat the line above (about half the VDP2
+ *                                render cost; output only, not accurate); no argument reports the mode
+ *   vdp1_stats_start [path]    - Count VDP1 drawing per frame: cycles, plotted pixels, distinct VRAM
+ *                                words read by drawing and written by the bus, and commands by type
+ *                                as polygon=<count>/<cycles> tokens. With path, one line per frame.
+ *   vdp1_stats [total]         - Report the last frame (or the sums since start)
+ *   vdp1_stats_stop            - Stop counting and close the per-frame log
+ *   vdp1_cmd_stats_start [path] - Count cycles, pixels drawn and pixels clipped per VDP1 command table
+ *                                entry each frame. With path, one line per entry per frame.
+ *   vdp1_cmd_stats [n]         - Last frame's entries, most cycles first (all, or the first n):
+ *                                one "addr=0x<vram offset> type=.. fetches=.. cycles=.. pixels=.. clipped=.."
+ *                                line each after the ack line
+ *   vdp1_cmd_stats_stop        - Stop counting and close the per-frame log
+ *   vdp1_cmd_break <addr> [log] - Pause when VDP1 fetches the command table entry at addr (VDP1 VRAM
+ *                                offset or 0x25C0xxxx address, 32-byte aligned), on the next master
+ *                                instruction, with "break vdp1_cmd addr=.. cmdctrl=.. type=.. pc=..".
+ *                                "log" = push a "hit vdp1_cmd ..." event instead and keep running.
+ *   vdp1_cmd_break_remove <addr> - Remove one VDP1 command break
+ *   vdp1_cmd_break_clear       - Remove all VDP1 command breaks
+ *   vdp1_cmd_break_list        - List VDP1 command breaks
+ *   m68k_break <addr> [log]    - Pause before the sound 68K executes addr (sound RAM offset), with
+ *                                "break m68k pc=.." and an m68k_regs line; "log" = push
+ *                                "hit m68k_break .." and keep running
+ *   m68k_break_remove <addr>   - Remove one 68K breakpoint
+ *   m68k_break_clear           - Remove all 68K breakpoints
+ *   m68k_break_list            - List 68K breakpoints
+ *   m68k_step [N]              - Resume; pause before the Nth 68K instruction ("done m68k_step pc=..")
+ *   m68k_regs                  - D0-D7 A0-A7 PC SR of the sound 68K
+ *   m68k_watch <addr> [len] [log] - Pause when the 68K changes sound RAM in addr..addr+len-1 (len
+ *                                hex, default 2): "hit m68k_watch pc= addr= old= new= size="
+ *   m68k_watch_clear           - Remove all 68K watches
+ *   m68k_call_trace <path>|stop - Log each 68K JSR/BSR and RTS/RTE/RTR as "cycle C|R site target"
+ *   scsp_capture <path> [raw]  - Record every SCSP sample asynchronously: 68 channels (32 slots before
+ *                                panning, 16 MIXS, 16 EFREG, 2 EXTS, L/R out) as a WAV (headerless with
+ *                                raw), key on/off events to <path>.keys (scsp_capture_dump.py reads both)
+ *   scsp_capture_stop          - Close the capture; reports samples, key events and dropped records
+ *   perf_stats_start [path]    - Time Emulate() per subsystem on the host (master slave sh2_dma scu smpc
+ *                                vdp1 vdp2 vdp2_wait cdb sound cart other frame driver); with path, one
+ *                                CSV row per frame to that file
+ *   perf_stats [total]         - The last frame (or the per-frame average) in microseconds, with speed=<%>
+ *   perf_stats_stop            - Stop timing and close the CSV file
+ *   frame_pacing [hist]        - Host frame pacing since start or frame_pacing_reset, in microseconds:
+ *                                frame interval, emulate, sound write waits, throttle, blit and vsync
+ *                                (count, mean, sd, min, p50/p95/p99, max; frame adds late=); hist adds
+ *                                the nonzero 0.1ms buckets
+ *   frame_pacing_reset         - Clear the frame pacing histograms
+ *   vdp1_capture_start <path>  - Record each completed VDP1 drawing (VRAM, starting framebuffer, clip/mode
+ *                                registers, resulting framebuffer crc32) for vdp1_bench
+ *   vdp1_capture_stop          - Stop recording; reports drawings written and dropped (cut short)
+ *   vdp1_bench <path> [repeat] - Replay a capture through the VDP1 rasterizer, repeat times per drawing
+ *                                (default 1); reports host time, emulated cycles and crc32 mismatches.
+ *                                Emulation state is restored afterwards.
+ *   sh2_bench <kernel> [insns=N] [icache=on|off|both] [at=ADDR] - Time the master SH-2 interpreter
+ *                                alone on a loop kernel: alu, branch, mac, cache, div, or file=<path> (raw
+ *                                big-endian code that loops itself, loaded at at=, default 0x00200000).
+ *                                insns default 20000000, icache default both. Reports ns/insn, mips,
+ *                                emulated cycles/insn and a register hash per run. Only at a frame
+ *                                boundary; emulation state is restored afterwards.
+ *   vdp2_capture_start <path> [frames] - Record the next frames rendered frames (default 60, 0 = until
+ *                                stopped): starting registers/VRAM/CRAM/render state, every VDP2 write
+ *                                and line draw, output crc32; for vdp2_bench
+ *   vdp2_capture_stop          - Stop recording; reports frames written
+ *   vdp2_layer_capture <path>  - Write the next rendered frame's layers (sprite, RBG0, NBG0/RBG1, NBG1-3,
+ *                                line color, back) as separate planes, all from one render pass; that
+ *                                frame is always rendered (vdp2_layers_dump.py)
+ *   vdp2_layer_capture_cancel  - Drop a vdp2_layer_capture whose frame hasn't run yet
+ *   vdp2_bench <path> [repeat] - Replay a capture through the VDP2 renderer, repeat times per frame, single-
+ *                                threaded and with the NBG workers; reports ns per line, per-layer ns per
+ *                                line and crc32 mismatches. Emulation state is restored afterwards.
+ *   func_profile_start [master|slave|both] - Exact per-function profiler on the shadow call stack:
+ *                                calls, inclusive/exclusive cycles, fetch wait cycles (default both)
+ *   func_profile_reset         - Zero the counters (e.g. right before a frame_advance 1)
+ *   func_profile_stop          - Stop, closing open frames; counters kept for func_profile_dump
+ *   func_profile_dump <path> [N] - Text report sorted by exclusive cycles (top N per CPU)
+ *   flight_rec_start [entries=N] [mem] [master|slave|both] [auto=off|<path>]
+ *                              - Keep the last N instructions per CPU in memory (default 65536), with
+ *                                mem also each one's last data access; dumped on exception/breakpoint
+ *                                pauses (default <base>/flight_rec.txt, named in the ack)
+ *   flight_rec_stop            - Stop and free the rings
+ *   flight_rec_dump <path> [last] - Write the rings now, oldest first (last N per CPU)
+ *   crash_bundle <dir> [exception] [hang=<sec>] [vblank=<frames>] [max=N] [thumb=<w>]
+ *                              - Arm crash bundles: on an exception (the default trigger), a frame not
+ *                                completing within <sec> of host time, or <frames> frames without a
+ *                                VBlank-IN, write <dir>/crash_<frame>_<kind>/ (info.txt with both CPUs'
+ *                                registers and shadow stacks, flight_rec.txt, events.txt with recent
+ *                                DMA/CDB events, thumb.png, state.mcs), at most N (default 4)
+ *   crash_bundle [off]         - Report the triggers and bundle counts, or disarm
+ *   crash_bundle_now [note]    - Write a bundle now (kind "manual")
+ *   call_graph_start [master|slave|both] [cycles] - Count caller->callee edges on the shadow call stack,
+ *                                with first/last frame seen; cycles = also inclusive cycles per edge
+ *   call_graph_reset / call_graph_stop - Clear the edges / stop counting (edges kept)
+ *   call_graph_dump <path> [dot|json] - Write the graph (default DOT)
  *   show_window                - Make the emulator window visible (for visual inspection)
  *   hide_window                - Hide the emulator window again
  *   step [N]                   - Step N CPU instructions then pause (default 1)
- *   breakpoint <addr> [log]    - Add PC breakpoint (hex address). "log" = log-only (no pause),
- *                                 writes full context (regs + call stack) to breakpoint_hits.txt
- *   breakpoint_remove <addr>   - Remove specific PC breakpoint
+ *   step_over                  - Step one instruction; if it's a call, run until it returns (one ack)
+ *   step_out                   - Run until the current function returns (shadow call stack, else PR)
+ *   step_slave [N]             - Step N slave CPU instructions then pause (default 1)
+ *   breakpoint <addr> [log] [count] [slave] - Add PC breakpoint (hex address). "log" = log-only (no pause),
+ *                                 writes full context (regs + call stack) to breakpoint_hits.txt.
+ *                                 "count" = log-only, but hits just bump a per-address counter
+ *                                 (with first frame/cycle) instead; see breakpoint_hits_dump.
+ *                                 "slave" = break on the slave SH-2 instead of the master.
+ *                                 "if <expr>" (rest of line) = only break when expr is nonzero,
+ *                                 e.g. if R4 == 0x060A0000 && [0x06001234].w > 3 && hitcount % 100 == 0
+ *   breakpoint_remove <addr> [slave] - Remove specific PC breakpoint
  *   breakpoint_clear           - Remove all breakpoints
  *   breakpoint_list            - List active breakpoints
- *   breakpoint_set_from_file <input_path> <result_path> [clear]
+ *   breakpoint_set_from_file <input_path> <result_path> [clear] [count]
  *                              - Bulk-install PC breakpoints in log mode from a text file
  *                                (one hex address per line, optional 0x prefix; '#' = comment).
  *                                Writes per-line failure list + summary to <result_path> as JSON.
  *                                "clear" token clears existing breakpoints + log before install.
+ *                                "count" token = count hits instead of logging them (coverage sweeps).
+ *   load_symbols <path> [append] - Load function ranges ("<start> [<end>] <name>" per line, hex):
+ *                                break acks gain sym=, call stacks fn=, and profile/func_profile/
+ *                                call_graph dumps and insn_trace_disasm name what they can
+ *   symbols_clear              - Drop the symbol table
+ *   symbol_lookup <addr> [addr...] - Resolve addresses to name+offset
+ *   breakpoint_hits_dump <path> [json|bin] [reset]
+ *                              - Write hit counts and first-hit frame/cycle for every installed
+ *                                breakpoint (default JSON); reset zeroes the counters afterwards
+ *   func_hook <addr> [args=0..4] [ret] - Log each entry to addr with R4.. (default 4 args) and,
+ *                                with ret, the matching exit with R0/R1 (master only, no pause)
+ *   func_hook_remove <addr> / func_hook_clear / func_hook_list
+ *   func_hook_log <path> [zlib] - Binary record stream for func_hook (async writer)
+ *   func_hook_log_stop         - Close it; ack reports records, dropped and lost exits
  *   poke_breakpoint <trigger_pc> <n> <addr>:<val>:<width> ...
  *                              - On each hit at trigger_pc, write <n> pokes (atomic)
  *                                and continue without pausing. width is bits (8/16/32).
  *   poke_breakpoint_remove <trigger_pc> - Remove one poke trigger
  *   poke_breakpoint_clear      - Remove all poke triggers + any playback
  *   poke_breakpoint_list       - List all poke triggers
+ *   freeze <addr>:<val>:<width> ... [nopurge] - Hold Work RAM values: rewritten at the start of
+ *                                every frame from pre-resolved backing words, purging only the
+ *                                cache lines whose value changed (none with nopurge)
+ *   freeze_remove <addr> / freeze_clear / freeze_list
  *   poke_playback_start <trigger_pc> <base_addr> <start_row> <end_row> <on_end>
  *                       <n_cols> <col1> ... <colN> <csv_path>
  *                              - CSV-driven playback: each hit pokes one row's worth
@@ -55,57 +312,183 @@
  *                                the cell (for narrow fields packed inside a wider column).
  *   poke_playback_stop         - Stop playback and remove its trigger
  *   poke_playback_status       - Report row cursor, trigger hits, poke count
+ *   script_load <path>         - In-process rules, one per line: "frame [every=N] [if <expr>] do <cmd>; ...",
+ *                                "break <pc> [slave] [if <expr>] do ...", "watch <id> [if <expr>] do ...";
+ *                                ${expr} in a command is replaced by its value (hex, ${expr:d} decimal)
+ *   script_add <rule>          - Add one rule
+ *   script_clear / script_list - Remove all rules / list them with hit, fired and error counts
  *   call_trace <path>          - Start logging JSR/BSR/BSRF calls to text file
  *   call_trace_stop            - Stop call trace logging
+ *   call_trace_filter [include=LO-HI,..] [exclude=LO-HI,..] [depth=N] [collapse] | off
+ *                              - Drop calls before they're formatted: callee outside include / inside
+ *                                exclude ranges (hex, inclusive), deeper than N on the shadow stack;
+ *                                collapse = a run of one call becomes its first line + "repeat=N"
+ *   call_trace_stats           - Calls written, filtered and collapsed since call_trace_filter
  *   unified_trace <path>       - Combined call trace + CD Block events
- *   unified_trace_stop         - Stop unified trace
- *   insn_trace <path> <start> <stop> - Per-instruction trace to file
+ *   unified_trace_bin <path> [zlib] - Binary unified trace + <path>.idx frame index
+ *   unified_trace_stop         - Stop unified trace (text or binary)
+ *   insn_trace <path> <start> <stop> [raw] - Per-instruction trace to file; raw = binary records
+ *                                (cycle, cpu, pc, opcode, PC-relative literal), no disassembly
+ *   insn_trace_disasm <raw> <out> [first] [count] - Disassemble a window of a raw insn trace to text
  *   insn_trace_unified <start> <stop> - Per-instruction trace into unified trace
+ *   insn_trace_window <path> [raw] [cpu=master|slave|both] [frames=A-B] [cycles=A-B] [enter=LO-HI]
+ *                     [after=ADDR:N] [count=N]
+ *                              - insn_trace without a unified trace: opens at frame A / cycle A, once
+ *                                PC enters [LO,HI) and after the Nth hit of ADDR (all that are given);
+ *                                closes after frame B, at cycle B or after N instructions
+ *   insn_trace_window_status   - "armed", "open", "closed" or "off", and instructions traced
  *   insn_trace_stop            - Stop instruction trace
  *   scdq_trace <path>          - Start logging SCDQ events
  *   scdq_trace_stop            - Stop SCDQ trace
  *   cdb_trace <path>           - Start logging CD Block events
  *   cdb_trace_stop             - Stop CD Block trace
+ *   cdb_profile_start [path] [zlib] - Count CD Block command latency, drive phase time and
+ *                                buffer occupancy; with a path, also binary events ("MDFNCDP1",
+ *                                see CDBProf_Record in cdb.cpp; cdb_profile_dump.py reads it)
+ *   cdb_profile_dump <path>    - Totals since cdb_profile_start as text
+ *   cdb_profile_stop           - Stop counting, close the event file
+ *   hotmem_status              - Hot memory arena address, size and backing (ss.hugepages,
+ *                                see hotmem.h); huge_kb is what the kernel actually gave it
+ *   sound_status               - Sound output state; with sound.ring, ring fill, adaptive target
+ *                                latency, underrun and dropped-frame counts
  *   input_trace <path>         - Log real keyboard button presses/releases with frame numbers
  *   input_trace_stop           - Stop input trace logging
  *   input_playback <path>      - Replay recorded input trace (events injected at correct frames)
- *   input_playback_stop        - Stop input playback
+ *   input_trace_bin <path>     - Record raw port data changes (all ports and device types) as a binary
+ *                                stream keyed by (frame, SMPC read); stopped by input_trace_stop
+ *   input_playback_bin <path>  - Stream a binary input file from disk, applying each event right before its
+ *                                SMPC INTBACK read (read 0 = frame start)
+ *   input_playback_stop        - Stop input playback (text or binary)
  *   call_stack [scan_size]     - Heuristic SH-2 call stack (scans stack for return addresses)
- *   watchpoint <addr> [eq <val>] [log] - Break on memory write to addr (hex), reports PC+old+new value
+ *   watchpoint <addr> [len <n>] [eq <val>] [log] - Break on memory write to addr (hex), reports PC+old+new value
+ *                                 Replaces the watchpoint set by the previous `watchpoint` command.
+ *                                 Optional: "len <n>" watches n (hex) bytes from addr instead of 4
  *                                 Optional: "eq <val>" only fires when new value == val
  *                                 Optional: "log" = log-only (no pause), writes full context to watchpoint_hits.txt
- *   watchpoint_clear           - Remove memory watchpoint
- *   read_watchpoint <addr> [log] - Break on memory read from addr (hex), reports PC+value. Pauses with
- *                                 full register dump + call stack, same as write watchpoints.
- *                                 Also logs all hits to read_watchpoint_hits.txt.
+ *   watchpoint_add <addr> [len <n>] [read] [eq <val>] [log] - Add one more watchpoint; any number can
+ *                                 be active, each with its own range, direction, filter and mode.
+ *                                 Reports id=N for watchpoint_remove. Hits carry id=N.
+ *   watchpoint_remove <id>     - Remove one watchpoint (read or write)
+ *   watchpoint_list            - List watchpoints: id, addr, len, direction, filter, mode
+ *   watchpoint_clear           - Remove all write watchpoints
+ *   read_watchpoint <addr> [len <n>] [eq <val>] [log] - Break on memory read from addr (hex), reports
+ *                                 PC+value. Pauses with full register dump + call stack, same as write
+ *                                 watchpoints. Also logs all hits to read_watchpoint_hits.txt.
+ *                                 Replaces the watchpoint set by the previous `read_watchpoint` command.
  *                                 Optional: "log" = log-only (no pause), writes full context to log file.
- *   read_watchpoint_clear      - Remove read watchpoint and resume if paused
+ *   read_watchpoint_clear      - Remove all read watchpoints and resume if paused
  *   exception_break <mode>    - Control SH-2 exception reporting (enable=pause, log=log-only, disable=off)
  *                               Catches: address errors, illegal instructions, slot illegal, NMI.
  *                               Reports type, PC, SR, VBR, handler address + full register dump + call stack.
- *   vdp2_watchpoint <lo> <hi> <path> - Watch VDP2 address range
- *   vdp2_watchpoint_clear      - Remove VDP2 watchpoint
- *   cdl_start [lo hi]           - Start Code/Data Logging for address range [lo,hi)
- *                                 Defaults to HWR (0x06000000–0x06100000) if no args.
+ *   vdp2_watchpoint <lo> <hi> <path> [text|bin|agg[=N]] [zlib]
+ *                               - Log every write to a VDP2 address range through the async trace
+ *                                 writer: text lines (default), binary records, or per frame the
+ *                                 N-byte lines written (default 64) and by which PCs
+ *   vdp2_watchpoint_clear      - Remove VDP2 watchpoint, flush and close its file
+ *   cdl_start [lo hi]           - Start Code/Data Logging (clears previous data), both SH-2s
+ *                                 Defaults to the whole bus (0x00000000–0x08000000); 4KB pages
+ *                                 are allocated on first touch. Optional [lo,hi) limits it.
  *                                 Example: cdl_start 00200000 00300000 (LWR, 1MB)
  *   cdl_stop                    - Stop CDL (preserves bitmap)
  *   cdl_reset                   - Clear CDL bitmap without stopping
- *   cdl_dump <path>             - Dump CDL bitmap to file (8-byte header: lo+hi, then bitmap)
+ *   cdl_dump <path>             - Dump CDL to a compact page-indexed, run-length file
+ *                                 ("MDFNCDL2", see Automation_CDLDump; cdl_dump.py reads it)
  *   cdl_status                  - Report CDL active state
+ *   cdl_delta [mask [path]]     - Bytes that gained any flag in mask (hex, default FF) since the
+ *                                 last cdl_delta/cdl_start/cdl_reset, as "0xADDR <gained bits hex>"
+ *                                 runs after the ack line, or written to path instead
+ *   cdl_overlay_log <path> [zlib] - Log CPU and DMA writes into pages CDL has seen code in, once
+ *                                 per page until code runs there again ("MDFNOVL1": frame, page,
+ *                                 writer; cdl_overlay_dump.py reads it). Needs cdl_start first
+ *   cdl_overlay_stop            - Close it, reporting records written and dropped
  *   dma_trace <path>            - Start logging SCU DMA transfers to text file
  *   dma_trace_stop              - Stop DMA trace logging
+ *   dma_trace_bin <path> [zlib] [frames_only] - Binary SCU, SH-2 DMAC and SCSP DMA records plus
+ *                                 per-frame bandwidth by source and region pair ("MDFNDMA1",
+ *                                 see DMABin_Transfer in ss.cpp; dma_trace_dump.py reads it)
+ *   dma_trace_bin_stop          - Close it, reporting transfers, bytes and frames
  *   mem_profile <lo> <hi> <path> - Log writes to address range [lo,hi] to text file
  *   mem_profile_stop            - Stop memory write profiling
+ *   write_log_start [entries=N] [<lo> <hi> ...]
+ *                               - Keep every write to these Work RAM ranges (default all of High
+ *                                 Work RAM) in memory, indexed per word; ring of N (default 4M)
+ *   write_log_stop              - Drop the write log
+ *   write_log_status            - Writes logged, held, and the oldest cycle still held
+ *   last_writer <addr> [before_cycle] [count=N]
+ *                               - The last N writes covering addr (before the cycle), newest first
  *   mem_read_profile <lo> <hi> <path> - Log CPU reads in address range to text file (pc, pr, addr, sz)
  *   mem_read_profile_stop       - Stop memory read profiling
- *   mem_sample <addr> <sz> <frames> <path> - Dump memory region every frame for N frames to binary file
+ *   mem_heatmap <lo> <hi> <path> [every=N] [top=K] [zlib]
+ *                               - Count reads/writes per 64-byte line (CPU and DMA apart) plus the K
+ *                                 busiest (pc, line) pairs; binary dump every N frames (default 60)
+ *   mem_heatmap_stop            - Write the last partial dump and close the heatmap file
+ *   op_stats_start [master|slave] [path] [every=N]
+ *                               - Count executions per decoded SH-2 handler (delay slots apart),
+ *                                 taken/untaken branches, MAC/DIV/MUL and memory ops by size; optional
+ *                                 binary deltas to path every N frames. Uses the debug run loop
+ *   op_stats_dump <path> [top=N] - Totals since op_stats_start as text, busiest handlers first
+ *   op_stats_stop               - Stop counting, close the per-frame file
+ *   dsp_profile_start [path] [zlib] - Count SCU DSP executions and stall cycles per program RAM address;
+ *                                 with path, also a 16-byte binary record per DSP instruction
+ *                                 (dsp_trace_dump.py)
+ *   dsp_profile_dump <path> [top=N] - Counts since dsp_profile_start as text, most cycles first
+ *   dsp_profile_stop            - Stop counting, close the trace
+ *   dsp_regs                    - SCU DSP PC, flags, loop/CT registers, AC, P, RX, RY, DMA addresses
+ *   dsp_dump_prog <path>        - SCU DSP program RAM, 256 big-endian 32-bit words
+ *   dsp_dump_data <path>        - SCU DSP data RAM, banks 0-3 of 64 big-endian 32-bit words
+ *   mem_sample <addr> <sz> <frames> <path> [<addr> <sz> ...] [xor] [zlib]
+ *                              - Dump memory ranges every frame for N frames to a binary file, through
+ *                                the async trace writer; xor = each frame XORed with the previous one,
+ *                                zlib = deflated blocks (file layout at mem_sample_frame)
  *   mem_sample_stop             - Abort memory sampling early
+ *   capture_plan set <path> [every=N] [zlib] <item ...> - From now on, write one record per Nth frame
+ *                                to path through the async trace writer; items: mem:<addr>:<size> (hex),
+ *                                regs, regs_slave, hash, obs (the obs_expose pixels); layout at capture_frame
+ *   capture_plan stop | status  - Close the capture file / report records written and dropped
  *   save_state <path>           - Save full emulator state to file
  *   load_state <path>           - Load emulator state from file
+ *   movie_record <path> [keyframes=N] - Record a Mednafen movie from here; with keyframes (or the
+ *                                 movie.keyframe_interval setting), a state every N frames to <path>.mki
+ *   movie_play <path>           - Play a movie back (loads its starting state; frame counter restarts at 0)
+ *   movie_seek <frame>          - Restore the nearest keyframe at or before the movie frame, then run
+ *                                 the rest like frame_advance ("done frame_advance frame=<frame>")
+ *   movie_stop                  - Stop recording or playback
+ *   movie_status                - Mode, movie frame and keyframe count
+ *   save_state_raw <path>       - Save an uncompressed, mmap()-loadable state (MDFNSS_SaveRaw) for this
+ *                                 build and game only; load_state and spawn take it like any other
+ *   nv_dump <path> [cart]       - Write internal backup RAM (.bkr format), or the cart's backup memory, to file
+ *   nv_load <path> [cart]       - Replace internal backup RAM, or the cart's backup memory, from a file;
+ *                                 with ss.nv_memory_only the save directory is never touched
+ *   snap_save <slot> [base]     - Save state to in-memory slot (0-4095); no file, no compression.
+ *                                 With a base slot, only 4 KiB pages that differ from it are kept
+ *   snap_load <slot>            - Restore in-memory slot, including its frame counter
+ *   snap_free <slot>|all        - Release one slot's memory, or all of them
+ *   rewind <frames>             - Go back up to N frames through the state rewinding history
+ *                                 (-automation_rewind or srwautoenable); acks the frames gone back
+ *   rewind_status               - Frames the rewind history holds now, its capacity and size
+ *   tree_save [parent]          - Save state as a new node of the snapshot tree (default parent:
+ *                                 the node last saved or loaded; '-' for a root); acks node=<id>
+ *   tree_load <node>            - Restore a tree node, including its frame counter
+ *   tree_prune <node>           - Delete a node and all of its descendants
+ *   tree_info [node]            - Tree totals, or one node's parent, children and frame
+ *   spawn <ipc_dir> [state]     - (POSIX, headless) fork() a child that continues from this exact
+ *                                 point, or from state, paused at frame 0 with its own ipc_dir
  *   deterministic              - Enable deterministic mode (fixed RTC seed)
+ *   setting_get <name>          - Current value of a setting ("ok setting_get <name> <value>")
+ *   setting_set <name> <value>  - Set a setting for this run only (global override; never saved to the
+ *                                 settings file); some settings apply only when the next game loads
  *   status                     - Report current frame, pause state, etc.
+ *   status_json                - "status_json {...}": frame, cycle, pause flags, host fps and speed ratio,
+ *                                hook flags, breakpoint/watchpoint counts, async writer bytes and drops,
+ *                                and the last perf_stats frame (null unless perf_stats is on)
  *   run                        - Free-run (unpause)
  *   pause                      - Pause emulation (blocking)
+ *   batch_begin [stop_on_error] - Start collecting acks; following commands run as usual
+ *   batch_end                  - Emit one aggregated ack: "done batch n=N errors=E skipped=S"
+ *                                then per command a "[i] <command line>" line + its ack text.
+ *                                stop_on_error skips (ack "skipped") everything after the
+ *                                first error. A batch must close within one action file
+ *                                write; on the socket it blocks emulation until batch_end.
  *
  * All ack responses include cycle=N seq=M appended by write_ack().
  * cycle= is absolute master SH-2 cycle count (int64); seq= is monotonic for change detection.
@@ -122,6 +505,7 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
 #include <fstream>
 #include "../MemoryStream.h"
 #include "../compress/GZFileStream.h"
@@ -130,17 +514,49 @@
 #include <sys/stat.h>
 #include <time.h>
 #ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/prctl.h>
 #endif
+#endif
+#include <atomic>
 
 #include <mednafen/mednafen.h>
 #include <mednafen/state.h>
+#include <mednafen/state_rewind.h>
+#include <mednafen/movie.h>
 #include <mednafen/FileStream.h>
+#include <mednafen/Time.h>
 #include "../video/png.h"
+#include "../video/resize.h"
 #include "../ss/automation_ss.h"
+#include "../ss/trace_ring.h"
+#include "automation_cond.h"
+#include "frame_dump.h"
+#define XXH_STATIC_LINKING_ONLY
+#include "../zstd/common/xxhash.h"
 #include "video.h"
+#include "fps.h"
+#include "sound.h"
 
 static FILE* unified_trace_file = nullptr;
+static bool unified_trace_bin = false;  // unified_trace_bin active (ring lives SS-side)
 static bool automation_active = false;
 
 // Check if the main thread received a quit request (SDL_QUIT from window
@@ -161,10 +577,22 @@ static uint64_t frame_counter = 0;
 static int64_t frames_to_advance = -1;  // -1 = free-running, 0 = paused, >0 = counting down
 static int64_t run_to_frame_target = -1;
 
-// Per-frame memory sampler: dumps a memory region every frame to binary file
-static FILE*    mem_sample_file = nullptr;
-static uint32_t mem_sample_addr = 0;
-static uint32_t mem_sample_size = 0;
+// Host frame rate for status_json: frames per second of running (not
+// paused) time, remeasured about once a second in Automation_Poll.
+static int64_t host_fps_start_us = 0;
+static uint32_t host_fps_frames = 0;
+static double host_fps = 0;
+
+// Per-frame memory sampler: dumps memory ranges every frame to a binary file
+// through the async trace writer (see mem_sample_frame)
+struct MemSampleRange { uint32_t addr, size; };
+static MDFN_IEN_SS::TraceRing* mem_sample_ring = nullptr;
+static std::vector<MemSampleRange> mem_sample_ranges;
+static std::vector<uint8_t> mem_sample_buf;   // this frame (plus header in framed mode)
+static std::vector<uint8_t> mem_sample_prev;  // xor: the last frame written
+static bool     mem_sample_framed = false;    // "MDFNMSM1" header and per-frame records
+static bool     mem_sample_xor = false;
+static uint32_t mem_sample_size = 0;          // bytes per frame, all ranges
 static int64_t  mem_sample_frames = 0;     // frames remaining
 static int64_t  mem_sample_total = 0;      // total frames requested
 
@@ -194,9 +622,22 @@ enum SaturnButton {
 static uint16_t input_buttons = 0;  // bitmask of pressed buttons
 static bool input_override = false;
 
-// Cached framebuffer for instant screenshots (no frame advance needed).
-// Updated every frame in Automation_Poll with a full copy of the pixel data.
-// Saturn max: 704x576x4 = ~1.5MB — trivial.
+// input_port: raw port data, in the layout of the device on that port,
+// replacing whatever the driver mapped (empty = not injected).
+// input_exclusive: Input_Update skips physical devices, command keys and
+// mapping altogether and hands automation zeroed port buffers.
+static std::vector<uint8_t> input_port_data[16];
+static bool input_exclusive = false;
+
+// Framebuffer for instant screenshots (no frame advance needed).
+// Automation_Poll only records where the frame it was handed lives; a
+// screenshot taken inside that Poll (paused at a frame boundary) is written
+// straight from it. The copy below is refreshed when leaving Poll only if a
+// pause can happen mid-frame (breakpoint, watchpoint, exception), since the
+// emulator may then be redrawing that buffer while we wait for commands.
+static const MDFN_Surface* live_fb_surface = nullptr;  // non-null only inside Poll
+static const MDFN_Rect* live_fb_rect = nullptr;
+static const int32* live_fb_lw = nullptr;
 static uint32_t* cached_fb_pixels = nullptr;
 static int32* cached_fb_lw = nullptr;
 static MDFN_Rect cached_fb_rect;
@@ -204,41 +645,196 @@ static MDFN_PixelFormat cached_fb_format;
 static int32 cached_fb_w = 0, cached_fb_h = 0, cached_fb_pitch = 0;
 static bool cached_fb_valid = false;
 
+// Headless mode (--automation_headless): no window, and the driver only has
+// frames rendered when Automation_FrameSkip() asks for one. A screenshot of a
+// frame that wasn't rendered is queued here and written, and acked, at the
+// end of the next emulated frame.
+static bool headless = false;
+
+// speed max (--automation_turbo): headless pacing with the window kept. The
+// driver skips its throttle, sound output and blit waits (Automation_Turbo()),
+// and frames are skipped as in headless mode.
+static bool turbo = false;
+
+// benchmark: a frame_advance from a loaded state with no input, run at
+// speed max with perf_stats on, that acks its timing and end-state hash.
+static bool bench_active = false;
+static bool bench_turbo_was = false;	// speed before the run
+static bool bench_perf_was = false;	// perf_stats already on (left running afterwards)
+static int64_t bench_frames = 0;
+static int64_t bench_start_us = 0;
+
+// spawn: true in a forked child. It has no main (video/event) thread.
+static bool fork_child = false;
+
+struct ScreenshotReq {
+ std::string path;      // empty for screenshot_phash
+ bool crop = false;
+ int32 crop_x = 0, crop_y = 0, crop_w = 0, crop_h = 0;
+ unsigned down = 1;
+};
+static std::vector<ScreenshotReq> pending_screenshots;
+
+// frame_dump: every frame_dump_every-th frame is queued to the encoder pool
+// from Poll; the emulation thread only copies pixels.
+static FrameDump* frame_dump = nullptr;
+static int64_t frame_dump_every = 1;
+
+// fb_hash: XXH64 of the last rendered frame, for desync/golden-run checks
+// without image I/O. fb_hash_frame is 0 until a frame has been hashed.
+static bool fb_hash_on = false;
+static bool fb_hash_all = false;
+static FILE* fb_hash_log = nullptr;
+static uint64_t fb_hash_value = 0;
+static uint64_t fb_hash_frame = 0;
+
+// render_skip on: also skip output for the intermediate frames of
+// frame_advance N / run_to_frame / mem_sample in windowed mode.
+static bool render_skip = false;
+static bool last_frame_rendered = false;  // did the most recent Poll get a surface?
+
 // Pending window visibility changes
 // show_window/hide_window now call Video_Automation*Window() directly (no pending flag)
 
 // PC trace state
-static FILE* pc_trace_file = nullptr;
+static MDFN_IEN_SS::TraceRing* pc_trace_ring = nullptr;  // async writer (see trace_ring.h)
 static bool pc_trace_active = false;
 static bool pc_trace_frame_mode = false;
 
+// Bus profiler: counters are rolled once per frame in Automation_Poll;
+// bus_profile_log gets one "frame=N m.r.HWRAM=count/cycles ..." line per frame.
+static bool bus_profile_on = false;
+static FILE* bus_profile_log = nullptr;
+
+// Interrupt latency profiler: same per-frame roll and log as the bus profiler.
+static bool int_latency_on = false;
+static FILE* int_latency_log = nullptr;
+
+// Sync wait profiler: likewise.
+static bool sync_profile_on = false;
+static FILE* sync_profile_log = nullptr;
+
+// VDP2 render timing: bus-profiler-style, but only rendered frames produce
+// a log line (skipped frames have nothing to time).
+static bool vdp2_timing_on = false;
+static FILE* vdp2_timing_log = nullptr;
+static FILE* vdp1_stats_log = nullptr;
+static FILE* vdp1_cmd_stats_log = nullptr;
+
+// vdp1_cmd_break: table address -> log mode. A pausing hit can't wait inside
+// VDP1 drawing, so it sets vdp1_break_pending and the debug hook pauses on the
+// next master instruction.
+static std::map<uint32_t, bool> vdp1_cmd_breaks;
+static bool vdp1_break_pending = false;
+static std::string vdp1_break_msg;
+static FILE* perf_stats_log = nullptr;	// perf_stats_start <path>: CSV
+
 // Instruction stepping state
 static int64_t instructions_to_step = -1;  // -1=not stepping, 0=step done, >0=counting
+static int64_t slave_instructions_to_step = -1;  // same, for the slave CPU (step_slave)
 static bool instruction_paused = false;     // true when spin-waiting inside debug hook
 
-// Breakpoint set (O(1) lookup, deduplicates automatically)
+// Breakpoint sets (O(1) lookup, deduplicates automatically)
 static std::unordered_set<uint32_t> breakpoints;
+static std::unordered_set<uint32_t> slave_breakpoints;
+
+// Conditions for "breakpoint <addr> if <expr>", per CPU, keyed by address.
+// Only consulted on an address hit; hits counts every address hit.
+struct BpCond
+{
+ BpCondition cond;
+ uint32_t hits = 0;
+};
+static std::unordered_map<uint32_t, BpCond> bp_conditions[2];
 
-// Track whether the CPU debug hook is currently enabled
-static bool cpu_hook_active = false;
+// Track whether the CPU debug hook is currently enabled, per CPU
+static bool cpu_hook_active[2] = { false, false };
 
 // Cycle-based stopping
 static int64_t run_to_cycle_target = -1;  // -1 = not active
 
-// Memory watchpoint state
-static bool watchpoint_active = false;
-static uint32_t watchpoint_addr = 0;
+// step_over / step_out: a one-shot stop at a return address. Only its page
+// goes into the hook bitmap, so the callee free-runs. The hit is the first
+// instruction at step_return_addr (or +2, as for breakpoints) with the shadow
+// call stack popped to step_return_depth, which skips recursive returns to the
+// same address. step_over first takes one step and only sets the return stop
+// if that step made a call.
+static bool step_return_active = false;
+static uint32_t step_return_addr = 0;
+static int32_t step_return_depth = -1;    // -1 = no depth check (step_out from PR)
+static const char* step_return_op = "step_out";
+static bool step_over_pending = false;
+static unsigned step_over_depth = 0;
+static bool journal_hook = false;  // journal_play: the next event is mid-frame, so the hook must see every insn
+
+// Reverse execution (history_start); see the history section further down.
+// Seek, Scan and Land are a reverse command in progress.
+enum HistoryMode : uint8_t { Hist_Off, Hist_Record, Hist_Seek, Hist_Scan, Hist_Land };
+static HistoryMode history_mode = Hist_Off;
+static void history_clear(void);
+
+// run_until <expr>: evaluated at every frame end and, with every=N, from
+// SS_EVENT_TICK every N master cycles. A tick hit can't pause inside the
+// event loop, so it sets run_until_break and the debug hook pauses on the
+// next master instruction.
+static bool run_until_active = false;
+static BpCondition run_until_cond;
+static int64_t run_until_max_frame = -1;  // -1 = no limit
+static uint32_t run_until_every = 0;      // 0 = frame ends only
+static uint32_t run_until_evals = 0;
+static int64_t run_until_start_cycle = 0;
+static bool run_until_break = false;
+static bool run_until_eval(void);
+static void run_until_tick(void);
+
+// run_to_line and break_on_vblank_in/out: checked by the VDP2 line hook once
+// per scanline (nothing per instruction). Like a tick hit, a line hit sets
+// raster_break and the debug hook pauses on the next master instruction.
+static int32_t run_to_line_target = -1;   // -1 = not active
+static int64_t run_to_line_frame = -1;    // -1 = any frame
+static bool break_vblank_in = false, break_vblank_out = false;
+static bool raster_break = false;
+static std::string raster_break_msg;
+static void raster_update_hook(void);
+
+// Sound 68K debugging (m68k_*). Breakpoints, stepping and the call trace run
+// on the per-instruction hook in SOUND_Update, watches on the sound RAM write
+// hook; each is only installed while something uses it. A pausing hit
+// spin-waits inside the 68K's run loop, like an SH-2 watchpoint on the bus.
+struct M68KWatch
+{
+ uint32_t addr, len;
+ bool log_mode;
+};
+static std::map<uint32_t, bool> m68k_breaks;	// pc -> log mode
+static std::vector<M68KWatch> m68k_watches;
+static int64_t m68k_to_step = -1;	// -1 = not stepping
+static bool m68k_paused = false;
+static FILE* m68k_call_trace = nullptr;
+static int m68k_trace_kind = 0;		// 'C' / 'R' when the last instruction was a call / return
+static uint32_t m68k_trace_site = 0;
+static void m68k_update_hooks(void);
+static std::string m68k_format_regs(void);
+
+// Memory watchpoint state. ss.cpp does the bus-side matching
+// (Automation_AddWatchpoint); this table holds what to do on a hit.
+struct Watchpoint {
+ uint32_t addr = 0;
+ uint32_t len = 4;
+ bool is_read = false;
+ bool log_mode = false;       // true = log-only (no pause), false = pause on hit
+ bool filter_active = false;  // conditional: only fire on specific value
+ uint32_t filter_value = 0;   // value to match (when filter active)
+};
+static std::map<unsigned, Watchpoint> watchpoints;  // by id
+static unsigned next_watchpoint_id = 1;
+static unsigned legacy_wp_id = 0;       // set by `watchpoint`, replaced by the next one (0 = none)
+static unsigned legacy_rwp_id = 0;      // same for `read_watchpoint`
 static bool watchpoint_paused = false;  // true when paused on watchpoint hit
-static bool watchpoint_log_mode = false; // true = log-only (no pause), false = pause on hit
 static FILE* wp_log = nullptr;          // watchpoint hit log file
-static bool watchpoint_filter_active = false;  // conditional: only fire on specific value
-static uint32_t watchpoint_filter_value = 0;   // value to match (when filter active)
 
 // Read watchpoint state — same pattern as write watchpoints
-static bool read_watchpoint_active = false;
-static uint32_t read_watchpoint_addr = 0;
 static bool read_watchpoint_paused = false;
-static bool read_watchpoint_log_mode = false; // true = log-only (no pause)
 static FILE* rwp_log = nullptr;
 
 // Exception break state
@@ -251,21 +847,35 @@ static FILE* exc_log = nullptr;
 
 // Breakpoint logging state
 static bool breakpoint_log_mode = false;  // true = log-only (no pause) for ALL breakpoints
+static bool breakpoint_count_mode = false;  // with log mode: count hits per address instead of writing bp_log
 static FILE* bp_log = nullptr;
 
+// Hit counters for count mode, per CPU, keyed by breakpoint address. An entry
+// exists once the address has been hit; breakpoint_hits_dump reports the rest as 0.
+struct BpHitCount
+{
+ uint64_t hits = 0;
+ uint64_t first_frame = 0;
+ int64_t first_cycle = 0;
+};
+static std::unordered_map<uint32_t, BpHitCount> bp_hit_counts[2];
+
 // Poke triggers: on hit at trigger PC, write memory then continue without pausing.
 // Each entry is either a static poke list, or a CSV-driven playback that advances
-// one row per hit. Writes go through Automation_WriteMem8 (same as the `poke`
+// one row per hit. Writes go through Automation_WriteMemBlock (same as the `poke`
 // command) and are atomic within a single hit — no SH-2 cycles intervene.
 struct PokeOp {
  uint32_t addr;
  uint32_t value;
  uint8_t  width;  // bits: 8, 16, or 32
+ uint8_t  bytes[4];  // value as written, big-endian, width/8 bytes
 };
 
 struct PokePlaybackCol {
  uint32_t offset;        // byte offset from base_addr
  uint8_t  width;         // bits: 8, 16, or 32
+ uint32_t row_offset;    // where this column's bytes start in a row of row_data
+ uint32_t nbytes;
  size_t   csv_col_idx;   // column index in parsed CSV row
  bool     slice_enabled;
  int      slice_lo;      // inclusive byte index into BE32 source
@@ -283,8 +893,11 @@ struct PokeTrigger {
  // Playback mode
  uint32_t                              base_addr   = 0;
  std::vector<PokePlaybackCol>          columns;
- // rows[row_idx][col_idx] = pre-computed bytes to write.
- std::vector<std::vector<std::vector<uint8_t>>> rows;
+ // Pre-computed bytes to write, row after row, row_stride bytes each; a
+ // column's bytes are at row_offset within its row.
+ std::vector<uint8_t>                  row_data;
+ size_t                                row_stride  = 0;
+ size_t                                row_count   = 0;
  size_t                                start_row   = 0;
  size_t                                end_row     = 0;   // exclusive
  size_t                                cur_row     = 0;
@@ -297,6 +910,71 @@ struct PokeTrigger {
 };
 
 static std::unordered_map<uint32_t, PokeTrigger> poke_triggers;
+// Function hooks: on entry to a hooked function, log the arguments (R4..) to
+// a binary record stream; with ret, pair the exit too and log R0/R1. An exit
+// is the first instruction at the entry's return address (PR) with R15 back
+// at its entry value, which is what the shadow stack's rts matching amounts
+// to, but seen after the delay slot (which often sets R0).
+struct FuncHook {
+ unsigned nargs = 4;     // R4 .. R4+nargs-1
+ bool     ret = false;
+ uint64_t hits = 0;
+};
+
+struct FuncHookFrame {
+ uint32_t id, func, ret_addr, sp;
+};
+
+enum : unsigned { FuncHook_MaxFrames = 256 };
+
+static std::unordered_map<uint32_t, FuncHook> func_hooks;
+static std::vector<FuncHookFrame> func_hook_frames;  // open calls awaiting exit, innermost last
+static MDFN_IEN_SS::TraceRing* func_hook_ring = nullptr;
+static uint32_t func_hook_seq = 0;
+static uint64_t func_hook_records = 0;
+static uint64_t func_hook_lost = 0;       // exits never seen (longjmp, overflow, state load)
+static uint32_t func_hook_direct = ~0U;   // hook hit at pc itself on the previous instruction
+
+// Flight recorder (flight_rec_start): dump to flight_rec_path on pause events.
+static bool flight_rec_auto = false;
+static std::string flight_rec_path;
+
+// Crash bundles (crash_bundle): on an exception, a frame that doesn't complete within
+// crash_hang_ms of wall-clock time, or crash_vblank_frames frames without a VBlank-IN,
+// write <crash_dir>/crash_<frame>_<kind>/. The watchdog thread only reads the atomics
+// and the copy of the directory it was started with.
+static std::string crash_dir;             // empty: disarmed
+static bool crash_on_exception = false;
+static int64_t crash_hang_ms = 0;         // 0: no watchdog
+static uint64_t crash_vblank_frames = 0;  // 0: no VBlank-IN check
+static uint64_t crash_vbin_last = 0, crash_vbin_frame = 0;
+static unsigned crash_max = 4, crash_written = 0, crash_skipped = 0;
+static int32_t crash_thumb_w = 160;
+struct CrashPending {
+ std::string dir;
+ bool thumb;                               // no frame to show when the bundle was written
+};
+static std::vector<CrashPending> crash_pending;  // bundles whose state waits for the frame end
+static FrameDump* crash_png = nullptr;    // thumbnail encoder thread
+static MThreading::Thread* crash_watchdog = nullptr;
+static std::string crash_watchdog_dir;
+static std::atomic<int64_t> crash_alive_ms{0};     // last frame end or paused wait
+static std::atomic<uint64_t> crash_alive_frame{0};
+static std::atomic<int64_t> crash_stalled_ms{0};   // set by the watchdog, cleared at the frame end
+static std::atomic<bool> crash_watchdog_exit{false};
+
+// Pages (same granularity as the SS-side hook filter) holding a poke trigger
+// or function hook PC at pc or pc + 2, rebuilt by update_cpu_hook. The hook
+// often runs for other reasons (breakpoints on the page, stepping, pc_trace);
+// this keeps trigger lookups off every instruction that can't match.
+enum : unsigned { TRIGGER_PAGE_BITS = 12 };
+static uint32_t trigger_pages[(1U << (32 - TRIGGER_PAGE_BITS)) / 32];
+
+static INLINE bool trigger_page(uint32_t pc)
+{
+ const uint32_t page = pc >> TRIGGER_PAGE_BITS;
+ return (trigger_pages[page >> 5] >> (page & 31)) & 1;
+}
 // One playback trigger at a time (single cursor). Tracked so stop/status can find it.
 static bool     poke_playback_running = false;
 static uint32_t poke_playback_pc = 0;
@@ -305,6 +983,40 @@ static uint32_t poke_playback_pc = 0;
 static bool     poke_playback_halt_pending = false;
 static uint32_t poke_playback_halt_pc = 0;
 
+// Script rules (script_load / script_add): "when <trigger> [if <expr>] do
+// <command>; ...", run in-process at frame end, on a PC hit or on a
+// watchpoint hit, so per-frame decisions cost no IPC round trip. Conditions
+// use the breakpoint expression language; ${expr} in an action is replaced by
+// the expression's value in hex (${expr:d} decimal). Actions are ordinary
+// commands; their acks are swallowed except errors, counted per rule.
+struct ScriptPiece {
+ std::string text;      // literal text, or the source of expr
+ bool is_expr = false;
+ bool decimal = false;
+ BpCondition expr;
+};
+
+struct ScriptRule {
+ enum Kind : uint8_t { On_Frame, On_Break, On_Watch } kind = On_Frame;
+ uint32_t addr = 0;      // On_Break: PC; On_Watch: watchpoint id
+ bool slave = false;     // On_Break on the slave SH-2
+ uint32_t every = 1;     // On_Frame: every N frames
+ bool has_cond = false;
+ BpCondition cond;
+ std::vector<std::vector<ScriptPiece>> actions;  // one per ';'-separated command
+ std::string src;
+ uint64_t hits = 0, fired = 0, errors = 0;
+ std::string last_error;
+};
+
+static std::vector<ScriptRule> script_rules;
+static std::unordered_map<uint32_t, std::vector<size_t>> script_break_index[2];  // PC -> rules, per CPU
+static bool script_have_frame = false, script_have_watch = false;
+static bool script_running = false;  // write_ack() stores into script_ack instead of sending
+static std::string script_ack;
+static bool script_parse_rule(const std::string& src, ScriptRule* rule, std::string* err);
+static void script_index(void);
+
 // Input trace state -- logs real keyboard input changes with frame numbers
 static FILE* input_trace_file = nullptr;
 static uint16_t last_traced_input = 0;
@@ -322,6 +1034,233 @@ static size_t playback_index = 0;        // next event to process
 static bool playback_active = false;
 static uint64_t playback_base_frame = 0; // frame_counter at playback start
 
+// load_state keeps the last file it read, decompressed, and reloads it from memory while
+// the file's inode, size and mtime are unchanged; the state loader then also reuses its parsed
+// section map, so reloading one checkpoint over and over doesn't reallocate.  save_state
+// drops the cached file, since a rewrite within the mtime granularity can look unchanged.
+static std::string load_state_path;
+static struct stat load_state_stat;
+static std::unique_ptr<MemoryStream> load_state_blob;
+static StateLoader load_state_loader;
+
+static void load_state_forget(void)
+{
+ load_state_blob.reset();
+ load_state_path.clear();
+}
+
+static bool load_state_unchanged(const struct stat& a, const struct stat& b)
+{
+#ifdef __APPLE__
+ const struct timespec& ta = a.st_mtimespec;
+ const struct timespec& tb = b.st_mtimespec;
+#else
+ const struct timespec& ta = a.st_mtim;
+ const struct timespec& tb = b.st_mtim;
+#endif
+ return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+        ta.tv_sec == tb.tv_sec && ta.tv_nsec == tb.tv_nsec;
+}
+
+// Load a (gzip'd) save state file as load_state does; throws on error.
+static void load_state_file(const std::string& path)
+{
+ MDFNSS_WaitAsync();  // a save_state to this path may still be in flight
+ // Raw states (save_state_raw) are applied straight from an mmap() of the file; the
+ // page cache does the keeping, so there's no blob to hold on to.
+ {
+  char magic[8] = { 0 };
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f) {
+   const size_t n = fread(magic, 1, sizeof(magic), f);
+   fclose(f);
+   if (n == sizeof(magic) && !memcmp(magic, "MDFNRAW1", 8)) {
+    MDFNSS_LoadRaw(path);
+    return;
+   }
+  }
+ }
+ struct stat sb;
+ if (stat(path.c_str(), &sb) != 0 || !load_state_blob || path != load_state_path ||
+     !load_state_unchanged(sb, load_state_stat)) {
+  // Match MDFNI_LoadState: gzip decompress, parse header, LoadSM
+  load_state_blob.reset();
+  GZFileStream st(path, GZFileStream::MODE::READ);
+  uint8 header[32];
+  st.read(header, 32);
+  uint32 st_len = MDFN_de32lsb(header + 16 + 4) & 0x7FFFFFFF;
+  if (st_len < 32)
+   throw std::runtime_error("Save state header length field is bad");
+  std::unique_ptr<MemoryStream> sm(new MemoryStream(st_len, -1));
+  memcpy(sm->map(), header, 32);
+  st.read(sm->map() + 32, st_len - 32);
+  load_state_blob = std::move(sm);
+  load_state_path = path;
+  load_state_stat = sb;
+ }
+ load_state_blob->seek(0, SEEK_SET);
+ load_state_loader.Load(load_state_blob.get());
+}
+
+// In-memory snapshots (snap_save / snap_load). Each slot holds a data-only state
+// (the rewinder's format: no header, section names or compression). A slot's
+// buffer is rewritten in place by later saves, and new slots are reserved at the
+// largest size seen so far, so a save doesn't allocate once a slot exists.
+// Snapshots only live for the session and are only valid for the loaded game.
+//
+// A delta slot keeps only the pages that differ from a full base slot. Pages are
+// found by comparing the serialized state against the base rather than by
+// tracking writes, so no writer (CPU, DMA, VDP1 drawing, SCSP, CD block) can be
+// missed. Base slots can't be overwritten or freed while deltas use them.
+struct Snapshot
+{
+ std::unique_ptr<MemoryStream> data;  // full state, or the changed pages in order
+ std::vector<uint32_t> pages;         // delta: page index of each page in data
+ uint64_t size = 0;                   // full state size
+ int base = -1;                       // delta: base slot
+ uint64_t frame = 0;
+};
+static std::vector<Snapshot> snapshots;
+static uint64_t snapshot_size_hint = 0;
+static MemoryStream snapshot_scratch;
+enum : unsigned { Snapshot_MaxSlots = 4096 };
+enum : uint32_t { Snapshot_PageSize = 4096 };
+
+static unsigned snapshot_dependents(unsigned slot)
+{
+ unsigned n = 0;
+ for (const Snapshot& s : snapshots)
+  n += (s.data && s.base == (int)slot);
+ return n;
+}
+
+// Full state of a slot: the slot's own buffer, or the base with the delta's pages applied in snapshot_scratch.
+static MemoryStream* snapshot_expand(Snapshot& snap)
+{
+ if (snap.base < 0)
+  return snap.data.get();
+
+ const Snapshot& base = snapshots[snap.base];
+ const uint8* src = snap.data->map();
+
+ snapshot_scratch.truncate(0);
+ snapshot_scratch.seek(0, SEEK_SET);
+ snapshot_scratch.write(base.data->map(), base.size);
+ for (uint32_t pg : snap.pages) {
+  const uint64_t offs = (uint64_t)pg * Snapshot_PageSize;
+  const uint32_t n = (uint32_t)std::min<uint64_t>(Snapshot_PageSize, snap.size - offs);
+  memcpy(snapshot_scratch.map() + offs, src, n);
+  src += n;
+ }
+ return &snapshot_scratch;
+}
+
+// Snapshot tree (tree_save / tree_load / tree_prune), for search bots that keep
+// many related states. Each node's data-only state is split into 4 KiB chunks;
+// chunks are looked up by XXH64 (then compared in full) and stored once,
+// refcounted across all nodes. Sibling and child states share nearly all their
+// chunks, so a node typically costs only the pages that changed since its
+// parent. Node IDs are never reused.
+struct TreeChunk
+{
+ std::unique_ptr<uint8[]> data;
+ uint64_t hash = 0;
+ uint32_t len = 0;
+ uint32_t refs = 0;
+};
+struct TreeNode
+{
+ bool used = false;
+ int64_t parent = -1;
+ std::vector<uint32_t> children;
+ std::vector<uint32_t> chunks;
+ uint64_t frame = 0;
+};
+static std::vector<TreeChunk> tree_chunks;
+static std::vector<uint32_t> tree_free_chunks;
+static std::unordered_multimap<uint64_t, uint32_t> tree_chunk_index;
+static std::vector<TreeNode> tree_nodes;
+static int64_t tree_current = -1;
+static uint64_t tree_chunk_bytes = 0;
+
+static uint32_t tree_add_chunk(const uint8* data, uint32_t len, bool* added)
+{
+ const uint64_t h = XXH64(data, len, 0);
+ auto range = tree_chunk_index.equal_range(h);
+
+ for (auto it = range.first; it != range.second; ++it) {
+  TreeChunk& c = tree_chunks[it->second];
+  if (c.len == len && !memcmp(c.data.get(), data, len)) {
+   c.refs++;
+   *added = false;
+   return it->second;
+  }
+ }
+
+ uint32_t id;
+ if (!tree_free_chunks.empty()) {
+  id = tree_free_chunks.back();
+  tree_free_chunks.pop_back();
+ } else {
+  id = tree_chunks.size();
+  tree_chunks.emplace_back();
+ }
+ TreeChunk& c = tree_chunks[id];
+ c.data.reset(new uint8[len]);
+ memcpy(c.data.get(), data, len);
+ c.hash = h;
+ c.len = len;
+ c.refs = 1;
+ tree_chunk_index.emplace(h, id);
+ tree_chunk_bytes += len;
+ *added = true;
+ return id;
+}
+
+static void tree_release_chunk(uint32_t id)
+{
+ TreeChunk& c = tree_chunks[id];
+ if (--c.refs)
+  return;
+
+ auto range = tree_chunk_index.equal_range(c.hash);
+ for (auto it = range.first; it != range.second; ++it) {
+  if (it->second == id) {
+   tree_chunk_index.erase(it);
+   break;
+  }
+ }
+ tree_chunk_bytes -= c.len;
+ c.data.reset();
+ c.len = 0;
+ tree_free_chunks.push_back(id);
+}
+
+// Deletes a node and its subtree; returns the number of nodes deleted.
+static unsigned tree_prune(uint32_t node)
+{
+ std::vector<uint32_t> stack(1, node);
+ unsigned n = 0;
+
+ if (tree_nodes[node].parent >= 0) {
+  std::vector<uint32_t>& sib = tree_nodes[tree_nodes[node].parent].children;
+  sib.erase(std::find(sib.begin(), sib.end(), node));
+ }
+
+ while (!stack.empty()) {
+  TreeNode& tn = tree_nodes[stack.back()];
+  if (stack.back() == tree_current)
+   tree_current = -1;
+  stack.pop_back();
+  for (uint32_t ch : tn.chunks)
+   tree_release_chunk(ch);
+  stack.insert(stack.end(), tn.children.begin(), tn.children.end());
+  tn = TreeNode();
+  n++;
+ }
+ return n;
+}
+
 // Monotonic sequence counter -- appended to every ack to guarantee uniqueness.
 // This solves change detection on DrvFS (Windows->WSL) where stat() mtime has
 // only 1-second resolution and file size padding isn't always sufficient.
@@ -333,16 +1272,164 @@ static uint64_t ack_seq = 0;
 // the first line (comment with sequence number) and compare to last-seen content.
 static std::string last_action_header;
 
+// Batch mode (batch_begin ... batch_end): sub-command acks are collected here
+// instead of being written, then emitted as one aggregated ack at batch_end.
+static bool batch_active = false;
+static bool batch_stop_on_error = false;  // skip remaining commands after first error
+static bool batch_failed = false;
+static std::vector<std::string> batch_results;
+static std::vector<std::string> batch_cmds;
+
+// Socket transport -- optional second command channel (--automation_socket).
+// Same command grammar as the action file, one command per '\n'-terminated line.
+// Each ack is sent as a decimal byte count line followed by exactly that many
+// bytes of ack text (acks can be multi-line, e.g. dump_mem / break context).
+// Unlike the file transport, paused loops block on socket readiness instead of
+// sleeping a fixed 10ms, so a command round trip costs microseconds.
+#ifdef WIN32
+typedef SOCKET auto_sock_t;
+#define AUTO_SOCK_INVALID INVALID_SOCKET
+#define auto_sock_close closesocket
+#else
+typedef int auto_sock_t;
+#define AUTO_SOCK_INVALID (-1)
+#define auto_sock_close close
+#endif
+static auto_sock_t sock_listen_fd = AUTO_SOCK_INVALID;
+static auto_sock_t sock_client_fd = AUTO_SOCK_INVALID;
+static std::string sock_unix_path;   // non-empty if we bound an AF_UNIX path (unlinked on kill)
+static std::string sock_spec;        // what Automation_InitSocket() listened on
+static std::string sock_rx_buf;      // partial command line received so far
+static bool acks_to_socket = false;  // true when the last command arrived over the socket
+static bool sock_subscribed = false; // "subscribe on": push events to the socket client
+static unsigned in_command = 0;      // nonzero while process_command() runs
+
+// GDB remote serial protocol stub (--automation_gdb <port> or gdb_server).
+// Both SH-2s are threads (1 = master, 2 = slave). Registers, memory,
+// breakpoints (Z0/Z1, the same PC breakpoints as the breakpoint command, on
+// the master) and watchpoints (Z2-Z4, the bus-side ones) map onto automation
+// state; c/s/vCont run the existing run/step/step_slave commands, so gdb and
+// an automation client can share one session. Packets are read in
+// poll_commands(), which every pause loop blocks on via wait_for_command().
+// A stop is reported once the emulator is paused again after a resume.
+// The functions follow check_socket().
+static auto_sock_t gdb_listen_fd = AUTO_SOCK_INVALID;
+static auto_sock_t gdb_client_fd = AUTO_SOCK_INVALID;
+static unsigned gdb_port = 0;
+static std::string gdb_rx_buf;
+static std::string gdb_last_packet;   // resent on '-'
+static bool gdb_no_ack = false;       // QStartNoAckMode
+static bool gdb_resumed = false;      // c/s/vCont sent, stop reply owed
+static unsigned gdb_thread_g = 0;     // Hg: CPU for g/G/p/P
+static unsigned gdb_thread_c = 0;     // Hc: CPU for s without a thread
+static int gdb_signal = 5;            // SIGTRAP, or SIGINT after ^C
+// Set where the emulator pauses: which CPU stopped and why ("swbreak:;",
+// "watch:<addr>;"), for the next stop reply.
+static unsigned gdb_stop_cpu = 0;
+static std::string gdb_stop_why;
+static std::map<std::string, std::vector<unsigned>> gdb_watch_ids;  // "type,addr,len" -> watchpoint ids
+static bool gdb_listen(unsigned port);
+static void gdb_shutdown(void);
+
+static void socket_close_client(void)
+{
+ if (sock_client_fd != AUTO_SOCK_INVALID) {
+  auto_sock_close(sock_client_fd);
+  sock_client_fd = AUTO_SOCK_INVALID;
+ }
+ sock_rx_buf.clear();
+ acks_to_socket = false;
+ sock_subscribed = false;
+ // A half-received socket batch has nobody left to ack to; drop it.
+ if (batch_active) {
+  batch_active = false;
+  batch_cmds.clear();
+  batch_results.clear();
+ }
+}
+
+static bool socket_send_all(const char* data, size_t len)
+{
+ while (len > 0) {
+#ifdef WIN32
+  int n = send(sock_client_fd, data, (int)len, 0);
+#elif defined(MSG_NOSIGNAL)
+  ssize_t n = send(sock_client_fd, data, len, MSG_NOSIGNAL);
+#else
+  ssize_t n = send(sock_client_fd, data, len, 0);
+#endif
+  if (n <= 0) {
+#ifndef WIN32
+   if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+    struct pollfd pfd = { sock_client_fd, POLLOUT, 0 };
+    poll(&pfd, 1, 100);
+    continue;
+   }
+#endif
+   socket_close_client();
+   return false;
+  }
+  data += n;
+  len -= n;
+ }
+ return true;
+}
+
 // Get current absolute master cycle count (for inclusion in ack messages).
 static int64_t get_cycle(void)
 {
  return MDFN_IEN_SS::Automation_GetMasterCycle();
 }
 
+// Event frame for subscribers: "!<nbytes>\n" + body.
+static bool send_event(const std::string& body)
+{
+ std::string hdr = "!" + std::to_string(body.size()) + "\n";
+ return socket_send_all(hdr.data(), hdr.size())
+     && socket_send_all(body.data(), body.size());
+}
+
+// Push a message that isn't an ack (e.g. a log-mode watchpoint hit) to a subscriber.
+static void push_event(const std::string& msg)
+{
+ if (!sock_subscribed || sock_client_fd == AUTO_SOCK_INVALID)
+  return;
+ ack_seq++;
+ send_event(msg + " cycle=" + std::to_string(get_cycle()) + " seq=" + std::to_string(ack_seq) + "\n");
+}
+
 static void write_ack(const std::string& msg)
 {
+ if (script_running) {
+  script_ack = msg;
+  return;
+ }
+
+ if (batch_active) {
+  batch_results.push_back(msg);
+  return;
+ }
+
  ack_seq++;
  int64_t cyc = get_cycle();
+
+ // Not a reply to a command: an event. A subscriber gets it as an event
+ // frame; if it also issued the command, that's the only copy it gets.
+ if (!in_command && sock_subscribed && sock_client_fd != AUTO_SOCK_INVALID) {
+  send_event(msg + " cycle=" + std::to_string(cyc) + " seq=" + std::to_string(ack_seq) + "\n");
+  if (acks_to_socket)
+   return;
+ }
+
+ // Reply on the channel the most recent command came from.
+ if (acks_to_socket && sock_client_fd != AUTO_SOCK_INVALID) {
+  std::string body = msg + " cycle=" + std::to_string(cyc) + " seq=" + std::to_string(ack_seq) + "\n";
+  std::string hdr = std::to_string(body.size()) + "\n";
+  if (socket_send_all(hdr.data(), hdr.size()))
+   socket_send_all(body.data(), body.size());
+  return;
+ }
+
  std::ofstream f(ack_file, std::ios::trunc);
  if (f.is_open()) {
   f << msg << " cycle=" << cyc << " seq=" << ack_seq << "\n";
@@ -350,19 +1437,75 @@ static void write_ack(const std::string& msg)
  }
 }
 
+// Send a binary payload to the socket client as "#<nbytes>\n" + bytes.
+// Binary frames always precede the text ack of the command that produced
+// them. Only valid while replying on the socket transport.
+static bool write_bin_frame(const void* data, size_t len)
+{
+ if (!acks_to_socket || sock_client_fd == AUTO_SOCK_INVALID)
+  return false;
+ std::string hdr = "#" + std::to_string(len) + "\n";
+ return socket_send_all(hdr.data(), hdr.size())
+     && socket_send_all((const char*)data, len);
+}
+
 // Enable/disable the SH-2 CPU debug hook based on what features need it.
 // Called after any change to pc_trace, stepping, or breakpoint state.
+//
+// Breakpoints and poke triggers only need the hook on the pages that hold
+// them, so those are compiled into the SS-side page bitmap; stepping,
+// pc_trace, run_to_cycle and history re-runs still need it on every instruction.
 static void update_cpu_hook(void)
 {
  // Watchpoints don't need the CPU hook -- they're detected inline in BusRW_DB_CS3
- bool need = pc_trace_active || (instructions_to_step >= 0) || !breakpoints.empty()
-          || (run_to_cycle_target >= 0) || !poke_triggers.empty();
- if (need && !cpu_hook_active) {
-  MDFN_IEN_SS::Automation_EnableCPUHook();
-  cpu_hook_active = true;
- } else if (!need && cpu_hook_active) {
-  MDFN_IEN_SS::Automation_DisableCPUHook();
-  cpu_hook_active = false;
+ const bool need_all[2] = {
+  pc_trace_active || (instructions_to_step >= 0) || (run_to_cycle_target >= 0) || journal_hook || run_until_break || vdp1_break_pending || raster_break
+  || history_mode == Hist_Scan || history_mode == Hist_Land,
+  slave_instructions_to_step >= 0
+ };
+ const bool need[2] = {
+  need_all[0] || !breakpoints.empty() || !poke_triggers.empty() || !func_hooks.empty() || !script_break_index[0].empty()
+  || step_return_active,
+  need_all[1] || !slave_breakpoints.empty() || !script_break_index[1].empty()
+ };
+
+ MDFN_IEN_SS::Automation_ClearCPUHookPages(0);
+ for (uint32_t addr : breakpoints)
+  MDFN_IEN_SS::Automation_AddCPUHookPage(0, addr);
+ memset(trigger_pages, 0, sizeof(trigger_pages));
+ auto add_trigger = [](uint32_t tpc) {
+  MDFN_IEN_SS::Automation_AddCPUHookPage(0, tpc);
+  for (uint32_t a : { tpc, tpc + 2 }) {
+   const uint32_t page = a >> TRIGGER_PAGE_BITS;
+   trigger_pages[page >> 5] |= 1U << (page & 31);
+  }
+ };
+ for (const auto& kv : poke_triggers)
+  add_trigger(kv.first);
+ for (const auto& kv : func_hooks)
+  add_trigger(kv.first);
+ for (const auto& kv : script_break_index[0])
+  add_trigger(kv.first);
+ for (const FuncHookFrame& f : func_hook_frames)
+  MDFN_IEN_SS::Automation_AddCPUHookPage(0, f.ret_addr);
+ if (step_return_active)
+  MDFN_IEN_SS::Automation_AddCPUHookPage(0, step_return_addr);
+
+ MDFN_IEN_SS::Automation_ClearCPUHookPages(1);
+ for (uint32_t addr : slave_breakpoints)
+  MDFN_IEN_SS::Automation_AddCPUHookPage(1, addr);
+ for (const auto& kv : script_break_index[1])
+  MDFN_IEN_SS::Automation_AddCPUHookPage(1, kv.first);
+
+ for (unsigned cpu = 0; cpu < 2; cpu++) {
+  MDFN_IEN_SS::Automation_SetCPUHookFilter(cpu, !need_all[cpu]);
+  if (need[cpu] && !cpu_hook_active[cpu]) {
+   MDFN_IEN_SS::Automation_EnableCPUHook(cpu);
+   cpu_hook_active[cpu] = true;
+  } else if (!need[cpu] && cpu_hook_active[cpu]) {
+   MDFN_IEN_SS::Automation_DisableCPUHook(cpu);
+   cpu_hook_active[cpu] = false;
+  }
  }
 }
 
@@ -423,1402 +1566,9364 @@ static void dump_memory(uint32_t addr, uint32_t size)
  write_ack(ss.str());
 }
 
-static void do_screenshot(const std::string& path)
+// Per visible line: le32 width, then that many host-order pixels from rect.x.
+// Stable across runs of one build and video setup(pixel format), which is
+// what determinism checks compare.
+static uint64_t hash_framebuffer(const MDFN_Surface* surface, const MDFN_Rect& rect, const int32* lw)
 {
- if (!cached_fb_valid || !cached_fb_pixels) {
-  write_ack("error screenshot: no cached framebuffer (need at least 1 frame)");
-  return;
- }
+ XXH64_state_t st;
+ const bool use_lw = lw && lw[0] != ~0;
 
- // Create a temporary surface pointing to our cached pixel buffer.
- // pixels_is_external=true (p_pixels != NULL) so destructor won't free it.
- MDFN_Surface tmp(cached_fb_pixels, cached_fb_w, cached_fb_h, cached_fb_pitch, cached_fb_format);
- try {
-  PNGWrite(path, &tmp, cached_fb_rect, cached_fb_lw);
-  write_ack("ok screenshot " + path);
- } catch(std::exception& e) {
-  write_ack(std::string("error screenshot: ") + e.what());
+ XXH64_reset(&st, 0);
+ for (int32 y = rect.y; y < rect.y + rect.h; y++) {
+  const int32 w = std::max<int32>(0, use_lw ? lw[y] : rect.w);
+  uint8 wb[4];
+  MDFN_en32lsb(wb, w);
+  XXH64_update(&st, wb, sizeof(wb));
+  XXH64_update(&st, surface->pixels + (size_t)y * surface->pitchinpix + rect.x, w * sizeof(uint32));
  }
+ return XXH64_digest(&st);
 }
 
-static void close_wp_log(void)
+// pHash as in Python's imagehash.phash: 32x32 grayscale (box filtered here),
+// 2-D DCT-II, and one bit per low 8x8 coefficient above their median, row
+// major from the MSB. Compare hashes by Hamming distance; they're close to,
+// not bit-identical with, imagehash's (different downscale filter).
+static uint64_t screenshot_phash(const MDFN_Surface* surface, const MDFN_Rect& rect, const int32* widths)
 {
- if (wp_log) {
-  fclose(wp_log);
-  wp_log = nullptr;
+ const int32 w = std::max<int32>(1, *std::max_element(widths + rect.y, widths + rect.y + rect.h));
+ double luma[32][32], rows[32][8], coef[64], sorted[64], cosines[8][32];
+ uint64_t hash = 0;
+
+ for (int cy = 0; cy < 32; cy++) {
+  const int32 y0 = rect.h * cy / 32, y1 = std::max<int32>(y0 + 1, rect.h * (cy + 1) / 32);
+  for (int cx = 0; cx < 32; cx++) {
+   const int32 x0 = w * cx / 32, x1 = std::max<int32>(x0 + 1, w * (cx + 1) / 32);
+   double sum = 0;
+   for (int32 y = y0; y < y1; y++) {
+    const uint32* line = surface->pixels + (size_t)(rect.y + y) * surface->pitchinpix + rect.x;
+    for (int32 x = x0; x < std::min<int32>(x1, widths[rect.y + y]); x++) {
+     int r, g, b;
+     surface->format.DecodeColor(line[x], r, g, b);
+     sum += r * 0.299 + g * 0.587 + b * 0.114;
+    }
+   }
+   luma[cy][cx] = sum / ((y1 - y0) * (x1 - x0));
+  }
  }
+
+ for (int k = 0; k < 8; k++)
+  for (int n = 0; n < 32; n++)
+   cosines[k][n] = cos(M_PI * k * (2 * n + 1) / 64);
+ for (int y = 0; y < 32; y++)
+  for (int k = 0; k < 8; k++) {
+   rows[y][k] = 0;
+   for (int x = 0; x < 32; x++)
+    rows[y][k] += luma[y][x] * cosines[k][x];
+  }
+ for (int k = 0; k < 8; k++)
+  for (int l = 0; l < 8; l++) {
+   coef[k * 8 + l] = 0;
+   for (int y = 0; y < 32; y++)
+    coef[k * 8 + l] += rows[y][l] * cosines[k][y];
+  }
+
+ memcpy(sorted, coef, sizeof(sorted));
+ std::sort(sorted, sorted + 64);
+ const double median = (sorted[31] + sorted[32]) / 2;
+ for (int i = 0; i < 64; i++)
+  if (coef[i] > median)
+   hash |= 1ULL << (63 - i);
+ return hash;
 }
 
-static void process_command(const std::string& line)
+static void write_screenshot(const ScreenshotReq& req, const MDFN_Surface* surface, const MDFN_Rect& rect, const int32* lw)
 {
- if (line.empty() || line[0] == '#')
-  return;
+ const std::string name = req.path.empty() ? "screenshot_phash" : "screenshot";
+ try {
+  // Per-line widths over the whole surface, as PNGWrite indexes them; lines
+  // outside the (cropped) rect are 0.
+  std::vector<int32> widths(surface->h, 0);
+  const bool use_lw = lw && lw[0] != ~0;
+  MDFN_Rect r = rect;
+  int32 max_w = 0;
 
- std::istringstream iss(line);
- std::string cmd;
- iss >> cmd;
+  for (int32 y = rect.y; y < rect.y + rect.h; y++) {
+   widths[y] = use_lw ? lw[y] : rect.w;
+   max_w = std::max<int32>(max_w, widths[y]);
+  }
 
- if (cmd == "frame_advance") {
-  int64_t n = 1;
-  iss >> n;
-  if (n < 1) n = 1;
-  frames_to_advance = n;
-  instruction_paused = false;   // unblock instruction-level pause
-  watchpoint_paused = false;    // unblock watchpoint pause
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  instructions_to_step = -1;    // cancel step mode
-  run_to_cycle_target = -1;     // cancel cycle target
-  update_cpu_hook();
-  write_ack("ok frame_advance " + std::to_string(n));
- }
- else if (cmd == "screenshot") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error screenshot: no path specified");
-  } else {
-   // Immediate screenshot from cached framebuffer — no frame advance, no PC movement.
-   do_screenshot(path);
+  if (req.crop) {
+   const int32 cx = std::min<int32>(std::max<int32>(0, req.crop_x), max_w);
+   const int32 cy = std::min<int32>(std::max<int32>(0, req.crop_y), rect.h);
+   const int32 cw = std::min<int32>(req.crop_w, max_w - cx);
+   const int32 ch = std::min<int32>(req.crop_h, rect.h - cy);
+
+   if (cw <= 0 || ch <= 0)
+    throw MDFN_Error(0, "crop rectangle is outside the %dx%d frame", max_w, rect.h);
+
+   for (int32 y = rect.y; y < rect.y + rect.h; y++) {
+    const bool in = y >= rect.y + cy && y < rect.y + cy + ch;
+    widths[y] = in ? std::min<int32>(cw, std::max<int32>(0, widths[y] - cx)) : 0;
+   }
+   r.x += cx;
+   r.y += cy;
+   r.w = max_w = cw;
+   r.h = ch;
   }
- }
- else if (cmd == "input") {
-  std::string button;
-  iss >> button;
-  int b = parse_button(button.c_str());
-  if (b >= 0) {
-   input_buttons |= (1 << b);
-   input_override = true;
-   write_ack("ok input " + button);
-  } else {
-   write_ack("error input: unknown button " + button);
+
+  if (req.path.empty()) {
+   char buf[64];
+   snprintf(buf, sizeof(buf), "ok screenshot_phash %016llx", (unsigned long long)screenshot_phash(surface, r, widths.data()));
+   write_ack(buf);
+   return;
   }
- }
- else if (cmd == "input_release") {
-  std::string button;
-  iss >> button;
-  int b = parse_button(button.c_str());
-  if (b >= 0) {
-   input_buttons &= ~(1 << b);
-   if (input_buttons == 0) input_override = false;
-   write_ack("ok input_release " + button);
+
+  if (req.down > 1) {
+   MDFN_Rect dr;
+   dr.x = dr.y = 0;
+   dr.w = std::max<int32>(1, (max_w + req.down - 1) / req.down);
+   dr.h = std::max<int32>(1, (r.h + req.down - 1) / req.down);
+   MDFN_Surface small(NULL, dr.w, dr.h, dr.w, surface->format);
+   MDFN_ResizeSurface(surface, &r, widths.data(), &small, &dr);
+   PNGWrite(req.path, &small, dr, nullptr, MDFN_GetSettingI("filesys.snap_comp_level"), MDFN_GetSettingUI("filesys.snap_comp_threads"));
   } else {
-   write_ack("error input_release: unknown button " + button);
+   PNGWrite(req.path, surface, r, widths.data(), MDFN_GetSettingI("filesys.snap_comp_level"), MDFN_GetSettingUI("filesys.snap_comp_threads"));
   }
+  write_ack("ok screenshot " + req.path);
+ } catch(std::exception& e) {
+  write_ack("error " + name + ": " + e.what());
  }
- else if (cmd == "input_clear") {
-  input_buttons = 0;
-  input_override = false;
-  write_ack("ok input_clear");
- }
- else if (cmd == "run_to_frame") {
-  int64_t n = 0;
-  iss >> n;
-  run_to_frame_target = n;
-  frames_to_advance = -1;  // free-run until target
-  instruction_paused = false;
-  watchpoint_paused = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  instructions_to_step = -1;
-  run_to_cycle_target = -1;
-  update_cpu_hook();
-  write_ack("ok run_to_frame " + std::to_string(n));
- }
- else if (cmd == "run") {
-  frames_to_advance = -1;
-  run_to_frame_target = -1;
-  instruction_paused = false;
-  watchpoint_paused = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  instructions_to_step = -1;
-  run_to_cycle_target = -1;
-  update_cpu_hook();
-  // No ack -- single-threaded, command is guaranteed to execute.
-  // Next ack will be the break/watchpoint event (no overwrite race).
- }
- else if (cmd == "pause") {
-  frames_to_advance = 0;
-  write_ack("ok pause frame=" + std::to_string(frame_counter));
- }
- else if (cmd == "quit") {
-  write_ack("ok quit");
-  MainRequestExit();
- }
- else if (cmd == "dump_regs") {
-  dump_registers();
- }
- else if (cmd == "dump_mem") {
-  uint32_t addr = 0, size = 256;  // default 256 bytes if size omitted
-  iss >> std::hex >> addr >> size;
-  dump_memory(addr, size);
- }
- else if (cmd == "status") {
-  std::ostringstream ss;
-  ss << "status frame=" << frame_counter;
-  ss << " paused=" << ((frames_to_advance == 0 || instruction_paused) ? "true" : "false");
-  ss << " inst_paused=" << (instruction_paused ? "true" : "false");
-  ss << " breakpoints=" << breakpoints.size();
-  ss << " input=0x" << std::hex << input_buttons;
-  write_ack(ss.str());
- }
- else if (cmd == "dump_regs_bin") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error dump_regs_bin: no path");
-  } else {
-   MDFN_IEN_SS::Automation_DumpRegsBin(path.c_str());
-   write_ack("ok dump_regs_bin " + path);
-  }
+}
+
+static void do_screenshot(const ScreenshotReq& req)
+{
+ if (live_fb_surface) {
+  write_screenshot(req, live_fb_surface, *live_fb_rect, live_fb_lw);
+  return;
  }
- else if (cmd == "dump_slave_regs") {
-  write_ack(MDFN_IEN_SS::Automation_DumpSlaveRegs());
+
+ // Headless keeps no copy; a skipped frame has nothing to show yet.
+ if (headless || !last_frame_rendered) {
+  pending_screenshots.push_back(req);
+  return;
  }
- else if (cmd == "call_stack") {
-  uint32_t scan = 0x400;  // default 1024 bytes
-  iss >> std::hex >> scan;
-  if (scan > 0x1000) scan = 0x1000;
-  write_ack(MDFN_IEN_SS::Automation_CallStack(scan));
+
+ if (!cached_fb_valid || !cached_fb_pixels) {
+  write_ack("error " + std::string(req.path.empty() ? "screenshot_phash" : "screenshot") + ": no cached framebuffer (need at least 1 frame)");
+  return;
  }
- else if (cmd == "dump_slave_regs_bin") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error dump_slave_regs_bin: no path");
+
+ // Create a temporary surface pointing to our cached pixel buffer.
+ // pixels_is_external=true (p_pixels != NULL) so destructor won't free it.
+ MDFN_Surface tmp(cached_fb_pixels, cached_fb_w, cached_fb_h, cached_fb_pitch, cached_fb_format);
+ write_screenshot(req, &tmp, cached_fb_rect, cached_fb_lw);
+}
+
+// Parses screenshot options after the path; false (with *err set) on a bad one.
+static bool parse_screenshot_opts(std::istringstream& iss, ScreenshotReq* req, std::string* err)
+{
+ std::string tok;
+ while (iss >> tok) {
+  if (tok.compare(0, 5, "crop=") == 0) {
+   if (sscanf(tok.c_str() + 5, "%d,%d,%d,%d", &req->crop_x, &req->crop_y, &req->crop_w, &req->crop_h) != 4
+       || req->crop_w <= 0 || req->crop_h <= 0) {
+    *err = "crop expects X,Y,W,H with W,H > 0";
+    return false;
+   }
+   req->crop = true;
+  } else if (tok.compare(0, 5, "down=") == 0 && !req->path.empty()) {
+   const int n = atoi(tok.c_str() + 5);
+   if (n < 1 || n > 64) {
+    *err = "down expects 1-64";
+    return false;
+   }
+   req->down = n;
   } else {
-   MDFN_IEN_SS::Automation_DumpSlaveRegsBin(path.c_str());
-   write_ack("ok dump_slave_regs_bin " + path);
+   *err = "unknown option '" + tok + "'";
+   return false;
   }
  }
- else if (cmd == "poke") {
-  // Write bytes to memory. Usage: poke <addr_hex> <byte_hex> [byte_hex ...]
-  uint32_t addr = 0;
-  iss >> std::hex >> addr;
-  int count = 0;
-  uint32_t val;
-  while (iss >> std::hex >> val) {
-   MDFN_IEN_SS::Automation_WriteMem8(addr + count, (uint8_t)(val & 0xFF));
-   count++;
-  }
-  char buf[128];
-  snprintf(buf, sizeof(buf), "ok poke 0x%08X %d bytes", addr, count);
-  write_ack(buf);
+ return true;
+}
+
+// Copy the live frame into cached_fb_* (leaving Poll with a mid-frame pause possible).
+static void cache_framebuffer(void)
+{
+ const MDFN_Surface* surface = live_fb_surface;
+
+ // Reallocate if dimensions changed
+ if (!cached_fb_pixels || cached_fb_w != surface->w || cached_fb_h != surface->h
+     || cached_fb_pitch != surface->pitchinpix) {
+  delete[] cached_fb_pixels;
+  delete[] cached_fb_lw;
+  cached_fb_pixels = new uint32_t[surface->pitchinpix * surface->h];
+  cached_fb_lw = new int32[surface->h];
+  cached_fb_w = surface->w;
+  cached_fb_h = surface->h;
+  cached_fb_pitch = surface->pitchinpix;
  }
- else if (cmd == "dump_mem_bin") {
+ memcpy(cached_fb_pixels, surface->pixels, surface->pitchinpix * surface->h * sizeof(uint32_t));
+ if (live_fb_lw) memcpy(cached_fb_lw, live_fb_lw, surface->h * sizeof(int32));
+ else memset(cached_fb_lw, 0, surface->h * sizeof(int32));
+ cached_fb_rect = *live_fb_rect;
+ cached_fb_format = surface->format;
+ cached_fb_valid = true;
+}
+
+// Shared-memory RAM view (shm_expose). One file-backed mapping holds a
+// header followed by page-aligned big-endian copies of each region, refreshed
+// at every frame boundary (and on shm_sync). Readers map the file read-only
+// and use the seqlock: read seq, copy/inspect, re-read seq; an odd or changed
+// seq means an update was in progress. While paused, seq never changes.
+struct ShmRegionDesc {
+ char     name[16];
+ uint32_t saturn_addr;
+ uint32_t size;
+ uint64_t offset;       // from start of mapping
+};
+
+struct ShmHeader {
+ char     magic[8];     // "MDFNSHM1"
+ uint32_t header_size;
+ uint32_t n_regions;
+ volatile uint64_t seq; // odd while an update is in progress
+ uint64_t frame;
+ int64_t  cycle;
+ ShmRegionDesc regions[8];
+};
+
+static const struct { const char* name; uint32_t addr; uint32_t size; } shm_region_table[] = {
+ { "wram_high", 0x06000000, 0x100000 },
+ { "wram_low",  0x00200000, 0x100000 },
+ { "vdp1_vram", 0x05C00000, 0x080000 },
+ { "vdp2_vram", 0x05E00000, 0x080000 },
+ { "vdp2_cram", 0x05F00000, 0x001000 },
+ { "sound_ram", 0x05A00000, 0x080000 },
+};
+static_assert(sizeof(shm_region_table) / sizeof(shm_region_table[0]) <= sizeof(ShmHeader::regions) / sizeof(ShmHeader::regions[0]),
+              "ShmHeader::regions can't hold every shm region");
+
+// A file-backed MAP_SHARED mapping (shm_expose, obs_expose). The file is
+// created or truncated to size; readers map the same path.
+struct SharedFileMap {
+ uint8_t* base = nullptr;
+ size_t   size = 0;
+#ifdef WIN32
+ HANDLE   file_handle = INVALID_HANDLE_VALUE;
+ HANDLE   map_handle = NULL;
+#endif
+};
+
+static void shared_file_unmap(SharedFileMap& m)
+{
+ if (!m.base)
+  return;
+#ifdef WIN32
+ UnmapViewOfFile(m.base);
+ CloseHandle(m.map_handle);
+ CloseHandle(m.file_handle);
+ m.map_handle = NULL;
+ m.file_handle = INVALID_HANDLE_VALUE;
+#else
+ munmap(m.base, m.size);
+#endif
+ m.base = nullptr;
+ m.size = 0;
+}
+
+static bool shared_file_map(SharedFileMap& m, const std::string& path, size_t size, std::string& err)
+{
+ shared_file_unmap(m);
+#ifdef WIN32
+ m.file_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+ if (m.file_handle == INVALID_HANDLE_VALUE) { err = "cannot create " + path; return false; }
+ m.map_handle = CreateFileMappingA(m.file_handle, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+ if (!m.map_handle) { CloseHandle(m.file_handle); m.file_handle = INVALID_HANDLE_VALUE; err = "CreateFileMapping failed"; return false; }
+ void* p = MapViewOfFile(m.map_handle, FILE_MAP_WRITE, 0, 0, size);
+ if (!p) { CloseHandle(m.map_handle); CloseHandle(m.file_handle); m.map_handle = NULL; m.file_handle = INVALID_HANDLE_VALUE; err = "MapViewOfFile failed"; return false; }
+#else
+ int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+ if (fd < 0) { err = "cannot create " + path + ": " + strerror(errno); return false; }
+ if (ftruncate(fd, size) != 0) { close(fd); err = std::string("ftruncate failed: ") + strerror(errno); return false; }
+ void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+ close(fd);
+ if (p == MAP_FAILED) { err = std::string("mmap failed: ") + strerror(errno); return false; }
+#endif
+ m.base = (uint8_t*)p;
+ m.size = size;
+ return true;
+}
+
+static SharedFileMap shm_map;
+static uint8_t*& shm_base = shm_map.base;
+static int64_t  shm_period = 1;       // frames between refreshes
+static std::string shm_path;
+
+static void shm_update(uint64_t frame)
+{
+ if (!shm_base)
+  return;
+ ShmHeader* h = (ShmHeader*)shm_base;
+ h->seq = h->seq + 1;
+ __sync_synchronize();
+ for (uint32_t i = 0; i < h->n_regions; i++) {
+  const ShmRegionDesc& r = h->regions[i];
+  MDFN_IEN_SS::Automation_ReadMemBlock(r.saturn_addr, shm_base + r.offset, r.size);
+ }
+ h->frame = frame;
+ h->cycle = get_cycle();
+ __sync_synchronize();
+ h->seq = h->seq + 1;
+}
+
+static void shm_close(void)
+{
+ shared_file_unmap(shm_map);
+ shm_path.clear();
+}
+
+// Create (or recreate) the mapping at path with the named regions.
+static bool shm_open_regions(const std::string& path, const std::vector<int>& which, std::string& err)
+{
+ shm_close();
+
+ if (which.size() > sizeof(ShmHeader::regions) / sizeof(ShmHeader::regions[0])) {
+  err = "too many regions";
+  return false;
+ }
+
+ size_t off = (sizeof(ShmHeader) + 4095) & ~(size_t)4095;
+ std::vector<ShmRegionDesc> descs;
+ for (int idx : which) {
+  ShmRegionDesc d;
+  memset(&d, 0, sizeof(d));
+  strncpy(d.name, shm_region_table[idx].name, sizeof(d.name) - 1);
+  d.saturn_addr = shm_region_table[idx].addr;
+  d.size = shm_region_table[idx].size;
+  d.offset = off;
+  off += (d.size + 4095) & ~(size_t)4095;
+  descs.push_back(d);
+ }
+
+ if (!shared_file_map(shm_map, path, off, err))
+  return false;
+ shm_path = path;
+
+ ShmHeader* h = (ShmHeader*)shm_base;
+ memcpy(h->magic, "MDFNSHM1", 8);
+ h->header_size = sizeof(ShmHeader);
+ h->n_regions = descs.size();
+ h->seq = 0;
+ for (size_t i = 0; i < descs.size(); i++)
+  h->regions[i] = descs[i];
+ return true;
+}
+
+// Observation buffer (obs_expose): the visible rect area-averaged down to a
+// fixed width x height of 8-bit gray or R,G,B, refreshed from rendered frames
+// in Automation_Poll. Same file-backed mapping and seqlock as shm_expose, so
+// an agent reads an observation without file I/O or screenshot decoding.
+struct ObsHeader {
+ char     magic[8];     // "MDFNOBS1"
+ uint32_t header_size;
+ uint32_t data_offset;  // pixels: height rows of width * channels bytes
+ uint32_t width;
+ uint32_t height;
+ uint32_t channels;     // 1 = gray (BT.601 luma), 3 = R,G,B
+ uint32_t reserved;
+ volatile uint64_t seq; // odd while an update is in progress
+ uint64_t frame;
+ int64_t  cycle;
+ uint32_t src_w;        // widest visible line and line count of the source
+ uint32_t src_h;
+};
+static_assert(sizeof(ObsHeader) <= 64, "ObsHeader grew past data_offset");
+
+static SharedFileMap obs_map;
+static uint8_t*& obs_base = obs_map.base;
+static int64_t  obs_period = 1;
+static std::vector<uint32_t> obs_acc;   // per output column: R, G, B sums and pixel count
+
+static void obs_update(const MDFN_Surface* surface, const MDFN_Rect& rect, const int32* lw, uint64_t frame)
+{
+ ObsHeader* h = (ObsHeader*)obs_base;
+ const uint32_t ow = h->width, oh = h->height;
+ const bool use_lw = lw && lw[0] != ~0;
+ const unsigned rs = surface->format.Rshift, gs = surface->format.Gshift, bs = surface->format.Bshift;
+ uint8_t* out = obs_base + h->data_offset;
+ int32 src_w = 0;
+
+ h->seq = h->seq + 1;
+ __sync_synchronize();
+ obs_acc.resize(ow * 4);
+ for (uint32_t oy = 0; oy < oh; oy++) {
+  int32 y0 = (int64_t)rect.h * oy / oh, y1 = (int64_t)rect.h * (oy + 1) / oh;
+  if (y1 <= y0) y1 = std::min<int32>(y0 + 1, rect.h);
+  std::fill(obs_acc.begin(), obs_acc.end(), 0);
+  for (int32 y = rect.y + y0; y < rect.y + y1; y++) {
+   const int32 w = std::max<int32>(0, use_lw ? lw[y] : rect.w);
+   const uint32* line = surface->pixels + (size_t)y * surface->pitchinpix + rect.x;
+   src_w = std::max(src_w, w);
+   for (uint32_t ox = 0; ox < ow; ox++) {
+    int32 x0 = (int64_t)w * ox / ow, x1 = (int64_t)w * (ox + 1) / ow;
+    if (x1 <= x0) x1 = std::min<int32>(x0 + 1, w);
+    // Plain shift/mask/add over a contiguous run, which the compiler vectorizes.
+    uint32_t r = 0, g = 0, b = 0;
+    for (int32 x = x0; x < x1; x++) {
+     const uint32 pix = line[x];
+     r += (pix >> rs) & 0xFF;
+     g += (pix >> gs) & 0xFF;
+     b += (pix >> bs) & 0xFF;
+    }
+    uint32_t* a = &obs_acc[ox * 4];
+    a[0] += r;
+    a[1] += g;
+    a[2] += b;
+    a[3] += std::max<int32>(0, x1 - x0);
+   }
+  }
+  for (uint32_t ox = 0; ox < ow; ox++) {
+   const uint32_t* a = &obs_acc[ox * 4];
+   const uint32_t n = std::max<uint32_t>(1, a[3]);
+   if (h->channels == 1)
+    *out++ = ((uint64_t)a[0] * 77 + (uint64_t)a[1] * 150 + (uint64_t)a[2] * 29) / ((uint64_t)n * 256);
+   else {
+    *out++ = a[0] / n;
+    *out++ = a[1] / n;
+    *out++ = a[2] / n;
+   }
+  }
+ }
+ h->frame = frame;
+ h->cycle = get_cycle();
+ h->src_w = src_w;
+ h->src_h = rect.h;
+ __sync_synchronize();
+ h->seq = h->seq + 1;
+}
+
+static void obs_close(void)
+{
+ shared_file_unmap(obs_map);
+ obs_acc.clear();
+}
+
+static bool obs_open(const std::string& path, uint32_t width, uint32_t height, uint32_t channels, std::string& err)
+{
+ const size_t size = (64 + (size_t)width * height * channels + 4095) & ~(size_t)4095;
+ obs_close();
+ if (!shared_file_map(obs_map, path, size, err))
+  return false;
+ ObsHeader* h = (ObsHeader*)obs_base;
+ memcpy(h->magic, "MDFNOBS1", 8);
+ h->header_size = sizeof(ObsHeader);
+ h->data_offset = 64;
+ h->width = width;
+ h->height = height;
+ h->channels = channels;
+ h->seq = 0;
+ return true;
+}
+
+static void close_wp_log(void)
+{
+ if (wp_log) {
+  fclose(wp_log);
+  wp_log = nullptr;
+ }
+}
+
+// Parses "[len <n>] [read] [eq <val>] [log]" after the address.
+static void parse_watchpoint_opts(std::istringstream& iss, Watchpoint& wp)
+{
+ std::string token;
+ while (iss >> token) {
+  if (token == "len") {
+   iss >> std::hex >> wp.len;
+  } else if (token == "eq") {
+   iss >> std::hex >> wp.filter_value;
+   wp.filter_active = true;
+  } else if (token == "read") {
+   wp.is_read = true;
+  } else if (token == "write") {
+   wp.is_read = false;
+  } else if (token == "log") {
+   wp.log_mode = true;
+  }
+ }
+}
+
+// Returns the new id, or 0 if the range isn't watchable.
+static unsigned add_watchpoint(const Watchpoint& wp)
+{
+ const unsigned id = next_watchpoint_id;
+ if (!MDFN_IEN_SS::Automation_AddWatchpoint(id, wp.addr, wp.len, wp.is_read, wp.filter_active, wp.filter_value))
+  return 0;
+ next_watchpoint_id++;
+ watchpoints[id] = wp;
+ return id;
+}
+
+static void remove_watchpoint(unsigned id)
+{
+ MDFN_IEN_SS::Automation_RemoveWatchpoint(id);
+ watchpoints.erase(id);
+ if (id == legacy_wp_id)
+  legacy_wp_id = 0;
+ if (id == legacy_rwp_id)
+  legacy_rwp_id = 0;
+}
+
+// Removes all read or all write watchpoints; returns how many.
+static size_t clear_watchpoints(bool is_read)
+{
+ std::vector<unsigned> ids;
+ for (const auto& kv : watchpoints)
+  if (kv.second.is_read == is_read)
+   ids.push_back(kv.first);
+ for (unsigned id : ids)
+  remove_watchpoint(id);
+ return ids.size();
+}
+
+// " 0xADDR [len=0xN] [eq 0xV] [log]" -- len omitted for the 4-byte default.
+static std::string describe_watchpoint(const Watchpoint& wp)
+{
+ char buf[96];
+ int n = snprintf(buf, sizeof(buf), " 0x%08X", wp.addr);
+ if (wp.len != 4)
+  n += snprintf(buf + n, sizeof(buf) - n, " len=0x%X", wp.len);
+ if (wp.filter_active)
+  n += snprintf(buf + n, sizeof(buf) - n, " eq 0x%08X", wp.filter_value);
+ if (wp.log_mode)
+  snprintf(buf + n, sizeof(buf) - n, " log");
+ return buf;
+}
+
+// Header naming the watchpoints a freshly opened hit log covers.
+static void write_wp_log_header(FILE* fp, bool is_read)
+{
+ for (const auto& kv : watchpoints) {
+  if (kv.second.is_read != is_read)
+   continue;
+  fprintf(fp, "# %s hits for id=%u addr%s\n", is_read ? "Read watchpoint" : "Watchpoint",
+   kv.first, describe_watchpoint(kv.second).c_str());
+ }
+}
+
+// Emit the aggregated batch ack. Each sub-result starts with a "[i] <cmd>"
+// line; any multi-line sub-ack text (dump_mem etc.) follows unchanged.
+static void finish_batch(const char* terminator)
+{
+ size_t n_cmds = batch_cmds.size(), n_err = 0, n_skipped = 0;
+ std::string body;
+ for (size_t i = 0; i < batch_cmds.size(); i++) {
+  const std::string& r = (i < batch_results.size()) ? batch_results[i] : std::string();
+  if (r.compare(0, 5, "error") == 0) n_err++;
+  if (r == "skipped") n_skipped++;
+  body += "\n[" + std::to_string(i) + "] " + batch_cmds[i] + "\n" + r;
+ }
+ batch_active = false;
+ batch_cmds.clear();
+ batch_results.clear();
+
+ char hdr[128];
+ snprintf(hdr, sizeof(hdr), "done batch n=%zu errors=%zu skipped=%zu%s",
+          n_cmds, n_err, n_skipped, terminator);
+ write_ack(hdr + body);
+}
+
+static void dispatch_command(const std::string& line, std::istringstream& iss, const std::string& cmd);
+
+static void process_command(const std::string& line)
+{
+ if (line.empty() || line[0] == '#')
+  return;
+
+ std::istringstream iss(line);
+ std::string cmd;
+ iss >> cmd;
+
+ if (cmd == "subscribe") {
+  std::string arg;
+  iss >> arg;
+  if (!acks_to_socket)
+   write_ack("error subscribe: requires the socket transport");
+  else if (arg != "on" && arg != "off")
+   write_ack("error subscribe: expected on or off");
+  else {
+   sock_subscribed = (arg == "on");
+   write_ack("ok subscribe " + arg);
+  }
+  return;
+ }
+ if (cmd == "batch_begin") {
+  if (batch_active) {
+   batch_cmds.push_back(line);
+   batch_results.push_back("error batch_begin: batch already open");
+   return;
+  }
+  std::string opt;
+  iss >> opt;
+  batch_active = true;
+  batch_stop_on_error = (opt == "stop_on_error");
+  batch_failed = false;
+  batch_cmds.clear();
+  batch_results.clear();
+  return;
+ }
+ if (cmd == "batch_end") {
+  if (!batch_active)
+   write_ack("error batch_end: no batch open");
+  else
+   finish_batch("");
+  return;
+ }
+
+ if (!batch_active) {
+  dispatch_command(line, iss, cmd);
+  return;
+ }
+
+ // Inside a batch: exactly one result slot per command, so the aggregated
+ // ack lines up with the input even for commands that don't ack.
+ batch_cmds.push_back(line);
+ size_t before = batch_results.size();
+ if (batch_failed)
+  batch_results.push_back("skipped");
+ else
+  dispatch_command(line, iss, cmd);
+ if (batch_results.size() == before)
+  batch_results.push_back("ok");
+ else if (batch_results.size() > before + 1) {
+  // Merge multiple acks from one command into its slot.
+  std::string merged = batch_results[before];
+  for (size_t i = before + 1; i < batch_results.size(); i++)
+   merged += "\n" + batch_results[i];
+  batch_results.resize(before + 1);
+  batch_results[before] = merged;
+ }
+ if (batch_stop_on_error && batch_results[before].compare(0, 5, "error") == 0)
+  batch_failed = true;
+}
+
+// Divergence hunting (diverge_record / diverge_check). Every diverge_every
+// frames, a sample of both CPUs' registers (Automation_GetRegs layout) and an
+// XXH64 of each 64 KiB chunk of the shm regions is appended to a file (record)
+// or compared with the next sample read from one (check). The checking run
+// stops at the first sample that differs and reports the first register or
+// chunk that's off. A check can run alongside its recording run: when the
+// sample isn't in the file yet it waits for it, briefly, instead of failing.
+//
+// File: "MDFNDIV1", le32 every, le32 sample size, then samples of u64 frame,
+// 2 x 22 u32 registers, one u64 per chunk; host byte order (same machine).
+enum : uint32_t { Diverge_ChunkSize = 0x10000, Diverge_WaitMS = 10000 };
+static FILE* diverge_file = nullptr;
+static bool diverge_checking = false;
+static uint64_t diverge_every = 1;
+static uint64_t diverge_samples = 0;
+static std::vector<uint8_t> diverge_cur, diverge_ref, diverge_mem;
+
+static size_t diverge_chunk_count(void)
+{
+ size_t n = 0;
+ for (const auto& r : shm_region_table)
+  n += (r.size + Diverge_ChunkSize - 1) / Diverge_ChunkSize;
+ return n;
+}
+
+static size_t diverge_sample_size(void)
+{
+ return 8 + 2 * 22 * 4 + diverge_chunk_count() * 8;
+}
+
+static void diverge_take_sample(std::vector<uint8_t>& out)
+{
+ out.resize(diverge_sample_size());
+ uint8_t* p = out.data();
+ const uint64_t frame = frame_counter;
+ memcpy(p, &frame, 8);
+ p += 8;
+ for (unsigned cpu = 0; cpu < 2; cpu++) {
+  MDFN_IEN_SS::Automation_GetRegs(cpu, (uint32*)p);
+  p += 22 * 4;
+ }
+ for (const auto& r : shm_region_table) {
+  diverge_mem.resize(r.size);
+  MDFN_IEN_SS::Automation_ReadMemBlock(r.addr, diverge_mem.data(), r.size);
+  for (uint32_t offs = 0; offs < r.size; offs += Diverge_ChunkSize) {
+   const uint64_t h = XXH64(&diverge_mem[offs], std::min<uint32_t>(Diverge_ChunkSize, r.size - offs), 0);
+   memcpy(p, &h, 8);
+   p += 8;
+  }
+ }
+}
+
+static void diverge_close(void)
+{
+ if (diverge_file) {
+  fclose(diverge_file);
+  diverge_file = nullptr;
+ }
+ diverge_checking = false;
+}
+
+// First difference between the reference and current sample, as ack text.
+static std::string diverge_describe(void)
+{
+ static const char* const reg_names[22] = {
+  "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15",
+  "PC", "SR", "PR", "GBR", "VBR", "MACH"
+ };
+ char buf[160];
+ uint64_t ref_frame;
+ memcpy(&ref_frame, diverge_ref.data(), 8);
+ if (ref_frame != frame_counter) {
+  snprintf(buf, sizeof(buf), "what=frame ref=%llu", (unsigned long long)ref_frame);
+  return buf;
+ }
+ const uint8_t* rp = diverge_ref.data() + 8;
+ const uint8_t* cp = diverge_cur.data() + 8;
+ for (unsigned cpu = 0; cpu < 2; cpu++) {
+  for (unsigned i = 0; i < 22; i++, rp += 4, cp += 4) {
+   uint32_t rv, cv;
+   memcpy(&rv, rp, 4);
+   memcpy(&cv, cp, 4);
+   if (rv != cv) {
+    snprintf(buf, sizeof(buf), "what=reg cpu=%s reg=%s ref=0x%08X got=0x%08X", cpu ? "slave" : "master", reg_names[i], rv, cv);
+    return buf;
+   }
+  }
+ }
+ for (const auto& r : shm_region_table) {
+  for (uint32_t offs = 0; offs < r.size; offs += Diverge_ChunkSize, rp += 8, cp += 8) {
+   if (memcmp(rp, cp, 8)) {
+    snprintf(buf, sizeof(buf), "what=mem region=%s addr=0x%08X size=0x%X", r.name, r.addr + offs, std::min<uint32_t>(Diverge_ChunkSize, r.size - offs));
+    return buf;
+   }
+  }
+ }
+ return "what=none";
+}
+
+// Poll-time hook: record or check this frame's sample.
+static void diverge_frame(void)
+{
+ diverge_take_sample(diverge_cur);
+ if (!diverge_checking) {
+  fwrite(diverge_cur.data(), 1, diverge_cur.size(), diverge_file);
+  diverge_samples++;
+  return;
+ }
+
+ // The recording run may still be behind; wait for its sample to land.
+ const long pos = ftell(diverge_file);
+ diverge_ref.resize(diverge_cur.size());
+ for (uint32_t waited = 0;; waited++) {
+  if (fread(diverge_ref.data(), 1, diverge_ref.size(), diverge_file) == diverge_ref.size())
+   break;
+  if (waited >= Diverge_WaitMS) {
+   frames_to_advance = 0;
+   write_ack("done diverge_check reference_ended frame=" + std::to_string(frame_counter) + " samples=" + std::to_string(diverge_samples));
+   diverge_close();
+   return;
+  }
+  clearerr(diverge_file);
+  fseek(diverge_file, pos, SEEK_SET);
+#ifdef WIN32
+  Sleep(1);
+#else
+  struct timespec ts = {0, 1000000};
+  nanosleep(&ts, NULL);
+#endif
+ }
+
+ if (diverge_ref != diverge_cur) {
+  frames_to_advance = 0;  // Pause
+  write_ack("break diverge frame=" + std::to_string(frame_counter) + " samples=" + std::to_string(diverge_samples) + " " + diverge_describe());
+  diverge_close();
+  return;
+ }
+ diverge_samples++;
+}
+
+// Save state section hashes (state_hash, state_hash_log, state_hash_check).
+// MDFNSS_HashSections() hashes every section's variables in place, so a line
+// costs a pass over the state (a few MB) and no serializing. Sections are the
+// state's own: SH2-M and SH2-S (CPUs), MAIN (work RAM, backup RAM, event
+// scheduler), SCU, SMPC, CDB, VDP1, VDP2, VDP2REND, SOUND (SCSP and 68K),
+// CART_*, so the first line that differs says which part diverged first. The
+// check reads (and waits for, like diverge_check) the log line by line.
+static FILE* state_hash_file = nullptr;
+static bool state_hash_checking = false;
+static uint64_t state_hash_every = 1;
+static uint64_t state_hash_lines = 0;
+
+static std::string state_hash_line(void)
+{
+ std::vector<std::pair<std::string, uint64>> hashes;
+ char buf[96];
+
+ MDFNSS_HashSections(&hashes);
+ snprintf(buf, sizeof(buf), "frame=%llu cycle=%lld", (unsigned long long)frame_counter, (long long)get_cycle());
+ std::string line = buf;
+ for (const auto& h : hashes) {
+  snprintf(buf, sizeof(buf), " %s=%016llx", h.first.c_str(), (unsigned long long)h.second);
+  line += buf;
+ }
+ return line;
+}
+
+static void state_hash_close(void)
+{
+ if (state_hash_file) {
+  fclose(state_hash_file);
+  state_hash_file = nullptr;
+ }
+ state_hash_checking = false;
+}
+
+// First token of cur that differs from ref, as ack text; empty if none does.
+// The cycle count isn't part of the state (a run from a loaded state differs
+// there alone), so it isn't compared.
+static std::string state_hash_describe(const std::string& ref, const std::string& cur)
+{
+ std::istringstream rs(ref), cs(cur);
+ std::string rt, ct;
+ for (;;) {
+  const bool have_r = (bool)(rs >> rt), have_c = (bool)(cs >> ct);
+  if (!have_r && !have_c)
+   return std::string();
+  if (!have_r || !have_c)
+   return "what=layout";
+  const size_t eq = rt.find('=');
+  if (eq == std::string::npos || rt.compare(0, eq + 1, ct, 0, eq + 1))
+   return "what=layout";
+  if (rt == ct || !rt.compare(0, 6, "cycle="))
+   continue;
+  return (!rt.compare(0, 6, "frame=") ? std::string("what=frame") : "section=" + rt.substr(0, eq))
+       + " ref=" + rt.substr(eq + 1) + " got=" + ct.substr(eq + 1);
+ }
+}
+
+// Poll-time hook: log or check this frame's line.
+static void state_hash_frame(void)
+{
+ std::string cur;
+ try {
+  cur = state_hash_line();
+ }
+ catch (std::exception& e) {
+  frames_to_advance = 0;
+  write_ack(std::string("error state_hash_log: ") + e.what());
+  state_hash_close();
+  return;
+ }
+ if (!state_hash_checking) {
+  fprintf(state_hash_file, "%s\n", cur.c_str());
+  state_hash_lines++;
+  return;
+ }
+
+ char ref[8192];
+ const long pos = ftell(state_hash_file);
+ for (uint32_t waited = 0;; waited++) {
+  if (fgets(ref, sizeof(ref), state_hash_file) && strchr(ref, '\n'))
+   break;
+  if (waited >= Diverge_WaitMS) {
+   frames_to_advance = 0;
+   write_ack("done state_hash_check reference_ended frame=" + std::to_string(frame_counter) + " lines=" + std::to_string(state_hash_lines));
+   state_hash_close();
+   return;
+  }
+  clearerr(state_hash_file);
+  fseek(state_hash_file, pos, SEEK_SET);
+#ifdef WIN32
+  Sleep(1);
+#else
+  struct timespec ts = {0, 1000000};
+  nanosleep(&ts, NULL);
+#endif
+ }
+ *strchr(ref, '\n') = 0;
+
+ const std::string what = state_hash_describe(ref, cur);
+ if (!what.empty()) {
+  frames_to_advance = 0;  // Pause
+  write_ack("break state_hash frame=" + std::to_string(frame_counter) + " lines=" + std::to_string(state_hash_lines) + " " + what);
+  state_hash_close();
+  return;
+ }
+ state_hash_lines++;
+}
+
+// Replay journal (journal_record / journal_play). Emulation is deterministic
+// given its inputs, so besides a starting state the journal only holds what
+// comes from outside the core: each change of port input data, pokes (from
+// poke or from poke triggers), the SR unstick at frame-level pauses, loaded
+// states and the deterministic RTC reset. Events are keyed by master cycles
+// since the last state event (the cycle counter isn't part of save states).
+// CD reads don't need an entry: NonDeterministic_CheckSectorReady() is a
+// constant true and its one caller (cdb.cpp) is compiled out.
+//
+// File: "MDFNJRN1", then events of le64 cycle, le32 payload length, u8 type,
+// u8 flags, payload. Journal_MidFrame marks events made inside the CPU hook or
+// at an instruction-level pause; playback turns the hook on to land those on
+// the same instruction. Journal_End holds the frame and an XXH64 of the
+// diverge_record sample at journal_stop, which journal_play checks.
+enum : uint8_t { Journal_State = 1, Journal_Input, Journal_Poke, Journal_SR, Journal_Deterministic, Journal_End };
+enum : uint8_t { Journal_MidFrame = 0x01 };
+enum : unsigned { Journal_HeaderSize = 14, Journal_MaxPorts = 16 };
+static FILE* journal_file = nullptr;          // recording
+static bool journal_playing = false;
+static int64_t journal_base_cycle = 0;        // master cycle at the last state event
+static int64_t journal_frame_cycle = 0;       // master cycle at the last Automation_Poll
+static uint64_t journal_events = 0;
+static std::vector<uint8_t> journal_inputs[Journal_MaxPorts];  // last recorded / replayed data per port
+static std::vector<uint8_t> journal_data;     // playing: whole file
+static size_t journal_pos = 0;
+
+static void journal_event(uint8_t type, uint8_t flags, const void* a, uint32_t a_len, const void* b = nullptr, uint32_t b_len = 0)
+{
+ uint8_t h[Journal_HeaderSize];
+ MDFN_en64lsb(&h[0], (uint64_t)(get_cycle() - journal_base_cycle));
+ MDFN_en32lsb(&h[8], a_len + b_len);
+ h[12] = type;
+ h[13] = flags;
+ fwrite(h, 1, sizeof(h), journal_file);
+ fwrite(a, 1, a_len, journal_file);
+ if (b_len)
+  fwrite(b, 1, b_len, journal_file);
+ journal_events++;
+}
+
+static uint8_t journal_flags(void)
+{
+ return (get_cycle() != journal_frame_cycle) ? Journal_MidFrame : 0;
+}
+
+static void journal_poke(uint32_t addr, const uint8_t* bytes, uint32_t n)
+{
+ uint8_t a[4];
+ if (!journal_file || !n)
+  return;
+ MDFN_en32lsb(a, addr);
+ journal_event(Journal_Poke, journal_flags(), a, 4, bytes, n);
+}
+
+static void journal_sr(uint32_t sr)
+{
+ uint8_t a[4];
+ if (!journal_file)
+  return;
+ MDFN_en32lsb(a, sr);
+ journal_event(Journal_SR, journal_flags(), a, 4);
+}
+
+// Record the current state (after journal_record or a state load) and restart
+// the cycle keys from it.
+static void journal_state(void)
+{
+ MemoryStream ms(snapshot_size_hint);
+ uint8_t a[8];
+ if (!journal_file)
+  return;
+ MDFNSS_SaveSM(&ms, true);
+ MDFN_en64lsb(a, frame_counter);
+ journal_event(Journal_State, journal_flags(), a, 8, ms.map(), ms.size());
+ journal_base_cycle = get_cycle();
+}
+
+static uint64_t journal_digest(void)
+{
+ diverge_take_sample(diverge_cur);
+ return XXH64(diverge_cur.data(), diverge_cur.size(), 0);
+}
+
+static void journal_play_end(const std::string& msg)
+{
+ journal_playing = false;
+ journal_hook = false;
+ journal_data.clear();
+ journal_data.shrink_to_fit();
+ update_cpu_hook();
+ frames_to_advance = 0;  // Pause at the end of this frame
+ write_ack(msg + " frame=" + std::to_string(frame_counter) + " events=" + std::to_string(journal_events));
+}
+
+// Playing: apply every event that's due by the current master cycle. Called
+// from Automation_GetInput, Automation_Poll and, for mid-frame events, the
+// master CPU hook.
+static void journal_apply(void)
+{
+ while (journal_playing) {
+  const int64_t now = get_cycle();
+  if (journal_data.size() - journal_pos < Journal_HeaderSize) {
+   journal_play_end("error journal_play: truncated journal");
+   return;
+  }
+  const uint8_t* h = &journal_data[journal_pos];
+  const int64_t at = journal_base_cycle + (int64_t)MDFN_de64lsb(&h[0]);
+  const uint32_t len = MDFN_de32lsb(&h[8]);
+  const uint8_t* p = h + Journal_HeaderSize;
+  if (journal_data.size() - journal_pos - Journal_HeaderSize < len) {
+   journal_play_end("error journal_play: truncated journal");
+   return;
+  }
+  if (at > now) {
+   const bool hook = (h[13] & Journal_MidFrame) != 0;
+   if (hook != journal_hook) {
+    journal_hook = hook;
+    update_cpu_hook();
+   }
+   return;
+  }
+  journal_pos += Journal_HeaderSize + len;
+  journal_events++;
+
+  switch (h[12]) {
+   case Journal_State:
+    if (len < 8) {
+     journal_play_end("error journal_play: bad state event");
+     return;
+    }
+    try {
+     MemoryStream ms(len - 8, -1);
+     memcpy(ms.map(), p + 8, len - 8);
+     MDFNSS_LoadSM(&ms, true);
+    } catch (std::exception& e) {
+     journal_play_end(std::string("error journal_play: ") + e.what());
+     return;
+    }
+    frame_counter = MDFN_de64lsb(p);
+    journal_base_cycle = get_cycle();
+    history_clear();
+    break;
+
+   case Journal_Input:
+    if (len && p[0] < Journal_MaxPorts)
+     journal_inputs[p[0]].assign(p + 1, p + len);
+    break;
+
+   case Journal_Poke:
+    if (len > 4)
+     MDFN_IEN_SS::Automation_WriteMemBlock(MDFN_de32lsb(p), p + 4, len - 4);
+    break;
+
+   case Journal_SR:
+    if (len >= 4)
+     MDFN_IEN_SS::Automation_SetMasterSR(MDFN_de32lsb(p));
+    break;
+
+   case Journal_Deterministic:
+    MDFN_IEN_SS::Automation_SetDeterministic();
+    break;
+
+   case Journal_End: {
+    const bool match = len >= 16 && MDFN_de64lsb(p) == frame_counter && MDFN_de64lsb(p + 8) == journal_digest();
+    journal_play_end(std::string("done journal_play match=") + (match ? "yes" : "no"));
+    return;
+   }
+
+   default:
+    journal_play_end("error journal_play: unknown event type " + std::to_string(h[12]));
+    return;
+  }
+ }
+}
+
+// Binary input streams (input_trace_bin / input_playback_bin): raw port data
+// for any port and peripheral type, keyed by (frame, read), where read 0 is
+// the frame-start latch and read k >= 1 is the k-th SMPC INTBACK peripheral
+// read in that frame. An event's data holds until the port's next event.
+// Playback streams the file through a one-event lookahead and replaces the
+// port data outright; events for read k are written into the port's data
+// and relatched by the SMPC poll hook right before that read. At the end of
+// the file the last data is held until input_playback_stop.
+//
+// File: "MDFNIPB1", then events of le32 frame (relative to the start),
+// u8 read, u8 port, u8 size, size bytes of port data.
+enum : unsigned { IPB_HeaderSize = 7 };
+struct IPBEvent {
+ uint32_t frame;
+ uint8_t read, port, size;
+ uint8_t data[255];
+};
+static FILE* ipb_trace_file = nullptr;
+static uint64_t ipb_trace_base = 0;
+static uint64_t ipb_trace_events = 0;
+static FILE* ipb_play_file = nullptr;
+static uint64_t ipb_play_base = 0;
+static uint64_t ipb_play_events = 0;
+static IPBEvent ipb_next;
+static bool ipb_next_valid = false;
+static std::vector<uint8_t> ipb_trace_last[Journal_MaxPorts];
+static std::vector<uint8_t> ipb_held[Journal_MaxPorts];  // playback: current data per port
+static uint8_t* ipb_port_ptr[Journal_MaxPorts];          // playback: the port buffers seen by Automation_GetInput
+static unsigned ipb_port_size[Journal_MaxPorts];
+
+// Read index for Automation_GetInput: 0 at the start of a frame; mid-frame
+// (a MidSync input update), new data first shows at the next INTBACK read.
+static unsigned ipb_read_index(void)
+{
+ return (get_cycle() != journal_frame_cycle) ? MDFN_IEN_SS::Automation_GetSMPCPollIndex() + 1 : 0;
+}
+
+static void ipb_play_close(void)
+{
+ if (ipb_play_file) {
+  fclose(ipb_play_file);
+  ipb_play_file = nullptr;
+  MDFN_IEN_SS::Automation_SetSMPCPollHook(nullptr);
+ }
+ ipb_next_valid = false;
+ for (auto& d : ipb_held)
+  d.clear();
+ memset(ipb_port_ptr, 0, sizeof(ipb_port_ptr));
+}
+
+static void ipb_read_next(void)
+{
+ uint8_t h[IPB_HeaderSize];
+ ipb_next_valid = fread(h, 1, sizeof(h), ipb_play_file) == sizeof(h);
+ if (ipb_next_valid) {
+  ipb_next.frame = MDFN_de32lsb(&h[0]);
+  ipb_next.read = h[4];
+  ipb_next.port = h[5];
+  ipb_next.size = h[6];
+  ipb_next_valid = fread(ipb_next.data, 1, ipb_next.size, ipb_play_file) == ipb_next.size;
+ }
+}
+
+// Apply every event due at (frame, read); returns the mask of ports changed.
+static uint32_t ipb_apply(unsigned read)
+{
+ const uint64_t frame = frame_counter - ipb_play_base;
+ uint32_t changed = 0;
+ while (ipb_next_valid && (ipb_next.frame < frame || (ipb_next.frame == frame && ipb_next.read <= read))) {
+  if (ipb_next.port < Journal_MaxPorts) {
+   const unsigned port = ipb_next.port;
+   ipb_held[port].assign(ipb_next.data, ipb_next.data + ipb_next.size);
+   if (ipb_port_ptr[port]) {
+    memset(ipb_port_ptr[port], 0, ipb_port_size[port]);
+    memcpy(ipb_port_ptr[port], ipb_next.data, std::min<unsigned>(ipb_next.size, ipb_port_size[port]));
+    changed |= 1U << port;
+   }
+  }
+  ipb_play_events++;
+  ipb_read_next();
+ }
+ return changed;
+}
+
+static uint32_t ipb_poll_hook(unsigned index)
+{
+ return ipb_apply(index);
+}
+
+// Automation_GetInput side of both: record this port's data if it changed,
+// or put the held playback data in place.
+static void ipb_port_input(unsigned port, uint8_t* data, unsigned data_size)
+{
+ if (port >= Journal_MaxPorts || data_size > 255)
+  return;
+
+ if (ipb_trace_file) {
+  std::vector<uint8_t>& last = ipb_trace_last[port];
+  if (last.size() != data_size || memcmp(last.data(), data, data_size)) {
+   uint8_t h[IPB_HeaderSize];
+   MDFN_en32lsb(&h[0], (uint32_t)(frame_counter - ipb_trace_base));
+   h[4] = (uint8_t)std::min<unsigned>(255, ipb_read_index());
+   h[5] = port;
+   h[6] = data_size;
+   fwrite(h, 1, sizeof(h), ipb_trace_file);
+   fwrite(data, 1, data_size, ipb_trace_file);
+   last.assign(data, data + data_size);
+   ipb_trace_events++;
+  }
+ }
+
+ if (ipb_play_file) {
+  ipb_port_ptr[port] = data;
+  ipb_port_size[port] = data_size;
+  if (ipb_read_index() == 0)
+   ipb_apply(0);
+  const std::vector<uint8_t>& held = ipb_held[port];
+  memset(data, 0, data_size);
+  if (!held.empty())
+   memcpy(data, held.data(), std::min<size_t>(held.size(), data_size));
+ }
+}
+
+// Reverse execution (history_start / step_back / reverse_continue, and
+// run_to_cycle into the past). While recording, a data-only snapshot is taken
+// at Automation_Poll every N frames into a ring, and everything from outside
+// the core since the oldest one is logged with its master cycle: port input
+// changes, pokes and the SR unstick, as the replay journal does. Going back
+// restores the snapshot before the target at a frame boundary, the same point
+// it was taken at, and re-executes with those events replayed in place of the
+// live input.
+//
+// step_back and reverse_continue first scan: re-run from the newest snapshot
+// to where the command was given, counting master instructions (step_back) or
+// breakpoint and watchpoint hits that would pause (reverse_continue), and if
+// the span held too few, scan the one before it. Then they land: re-run the
+// span that holds the target and pause on the counted instruction or hit.
+// Nothing else pauses or logs during these re-runs. On landing, snapshots and
+// events past the new position are dropped and recording continues from there.
+enum HistoryKind : uint8_t { Hist_Insn, Hist_Hit, Hist_Cycle };
+enum : uint8_t { HistEv_Input, HistEv_Poke, HistEv_SR };
+struct HistorySnap
+{
+ std::unique_ptr<MemoryStream> data;
+ int64_t cycle = 0;
+ uint64_t frame = 0;
+ size_t events = 0;                               // history_events logged before it
+ std::vector<uint8_t> inputs[Journal_MaxPorts];  // port data held at the snapshot
+};
+struct HistoryEvent
+{
+ int64_t cycle = 0;
+ uint32_t arg = 0;  // port, poke address or SR
+ uint8_t type = 0;
+ std::vector<uint8_t> data;
+};
+static std::vector<HistorySnap> history_snaps;   // oldest first
+static std::vector<HistoryEvent> history_events;
+static std::vector<uint8_t> history_inputs[Journal_MaxPorts];
+static size_t history_pos = 0;                   // re-running: next event to apply
+static unsigned history_every = 60;
+static unsigned history_slots = 16;
+static unsigned history_countdown = 0;           // Polls to the next snapshot (0 = next one)
+// The reverse command in progress
+static HistoryKind history_kind = Hist_Insn;
+static HistoryMode history_next = Hist_Off;      // mode after the pending restore
+static size_t history_seg = 0;                   // snapshot being re-run from
+static int64_t history_target = 0;               // scan: end of the span; Hist_Cycle: landing cycle
+static uint64_t history_need = 0;                // instructions or hits still to go back
+static uint64_t history_count = 0;               // counted in this re-run
+static uint64_t history_land_index = 0;
+static std::string history_op, history_note;
+
+static bool history_at_frame_boundary(void)
+{
+ return !instruction_paused && !watchpoint_paused && !read_watchpoint_paused && !exception_paused;
+}
+
+static void history_event(uint8_t type, uint32_t arg, const uint8_t* data, uint32_t len)
+{
+ if (history_mode != Hist_Record)
+  return;
+ HistoryEvent ev;
+ ev.cycle = get_cycle();
+ ev.arg = arg;
+ ev.type = type;
+ ev.data.assign(data, data + len);
+ history_events.push_back(std::move(ev));
+}
+
+// Take a snapshot, reusing the oldest one's buffer once the ring is full, and
+// forget the events from before the oldest snapshot left. Throws on error.
+static void history_snapshot(void)
+{
+ HistorySnap snap;
+ if (history_snaps.size() >= history_slots) {
+  snap = std::move(history_snaps.front());
+  history_snaps.erase(history_snaps.begin());
+ }
+ if (!snap.data)
+  snap.data.reset(new MemoryStream(snapshot_size_hint));
+ snap.data->truncate(0);
+ snap.data->seek(0, SEEK_SET);
+ MDFNSS_SaveSM(snap.data.get(), true);
+ snapshot_size_hint = std::max<uint64_t>(snapshot_size_hint, snap.data->size());
+ snap.cycle = get_cycle();
+ snap.frame = frame_counter;
+ snap.events = history_events.size();
+ for (unsigned p = 0; p < Journal_MaxPorts; p++)
+  snap.inputs[p] = history_inputs[p];
+ history_snaps.push_back(std::move(snap));
+
+ const size_t drop = history_snaps.front().events;
+ if (drop) {
+  history_events.erase(history_events.begin(), history_events.begin() + drop);
+  for (HistorySnap& s : history_snaps)
+   s.events -= drop;
+ }
+ history_countdown = history_every;
+}
+
+// A state load or RTC reset breaks the timeline: start over from the next Poll.
+static void history_clear(void)
+{
+ if (history_mode == Hist_Off)
+  return;
+ if (history_mode != Hist_Record) {
+  write_ack("error " + history_op + ": history cleared by a state load");
+  history_mode = Hist_Record;
+  update_cpu_hook();
+ }
+ history_snaps.clear();
+ history_events.clear();
+ for (auto& in : history_inputs)
+  in.clear();
+ history_countdown = 0;
+}
+
+static void history_stop(void)
+{
+ history_clear();
+ history_mode = Hist_Off;
+ update_cpu_hook();
+}
+
+// Re-running: apply every logged event that's due by the current master cycle.
+static void history_apply(void)
+{
+ const int64_t now = get_cycle();
+ while (history_pos < history_events.size() && history_events[history_pos].cycle <= now) {
+  const HistoryEvent& ev = history_events[history_pos++];
+  switch (ev.type) {
+   case HistEv_Input:
+    history_inputs[ev.arg] = ev.data;
+    break;
+   case HistEv_Poke:
+    MDFN_IEN_SS::Automation_WriteMemBlock(ev.arg, ev.data.data(), ev.data.size());
+    break;
+   case HistEv_SR:
+    MDFN_IEN_SS::Automation_SetMasterSR(ev.arg);
+    break;
+  }
+ }
+}
+
+// Automation_GetInput side: log this port's data if it changed, or put the
+// logged data in place while re-running.
+static void history_input(unsigned port, uint8_t* data, unsigned data_size)
+{
+ std::vector<uint8_t>& last = history_inputs[port];
+ if (history_mode == Hist_Scan || history_mode == Hist_Land) {
+  history_apply();
+  if (!last.empty()) {
+   memset(data, 0, data_size);
+   memcpy(data, last.data(), std::min<size_t>(last.size(), data_size));
+  }
+ } else if (history_mode == Hist_Record && (last.size() != data_size || memcmp(last.data(), data, data_size))) {
+  last.assign(data, data + data_size);
+  history_event(HistEv_Input, port, data, data_size);
+ }
+}
+
+// Queue a restore of snapshot "seg" followed by "next", and let emulation run
+// (nothing pauses) to the frame boundary where it happens.
+static void history_seek(size_t seg, HistoryMode next)
+{
+ history_seg = seg;
+ history_next = next;
+ history_mode = Hist_Seek;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ run_to_cycle_target = -1;
+ run_to_frame_target = -1;
+ frames_to_advance = -1;
+ update_cpu_hook();
+}
+
+// At a frame boundary with a seek pending.
+static void history_restore(void)
+{
+ HistorySnap& s = history_snaps[history_seg];
+ try {
+  s.data->seek(0, SEEK_SET);
+  MDFNSS_LoadSM(s.data.get(), true);
+ } catch (std::exception& e) {
+  write_ack("error " + history_op + ": " + e.what());
+  history_stop();
+  return;
+ }
+ frame_counter = s.frame;
+ MDFN_IEN_SS::Automation_SetMasterCycle(s.cycle);
+ MDFN_IEN_SS::Automation_WriteLogRewind(s.cycle);  // those writes happen again
+ for (unsigned p = 0; p < Journal_MaxPorts; p++)
+  history_inputs[p] = s.inputs[p];
+ history_pos = s.events;
+ history_count = 0;
+ history_mode = history_next;
+ history_apply();
+ update_cpu_hook();
+}
+
+// Landed: the future past here is gone, record on from this point.
+static void history_landed(void)
+{
+ history_events.resize(history_pos);
+ history_snaps.resize(history_seg + 1);
+ const uint64_t next = history_snaps.back().frame + history_every;
+ history_countdown = (next > frame_counter) ? (unsigned)(next - frame_counter) : 1;
+ history_mode = Hist_Record;
+ update_cpu_hook();
+}
+
+// The scan of history_seg reached its end with history_count counted.
+static void history_scan_done(void)
+{
+ if (history_count >= history_need) {
+  history_land_index = history_count - history_need;
+  history_seek(history_seg, Hist_Land);
+  return;
+ }
+ history_need -= history_count;
+ if (history_seg == 0) {
+  // Not that far back: stop on the oldest snapshot's first instruction.
+  history_note = (history_kind == Hist_Hit) ? " reached=history_start" : " short=" + std::to_string(history_need);
+  history_kind = Hist_Insn;
+  history_land_index = 0;
+  history_seek(0, Hist_Land);
+  return;
+ }
+ history_target = history_snaps[history_seg].cycle;
+ history_seek(history_seg - 1, Hist_Scan);
+}
+
+// Master hook while re-running; bp_stop is a breakpoint hit that would pause.
+// True to pause here.
+static bool history_hook(bool bp_stop)
+{
+ if (history_mode == Hist_Seek)
+  return false;
+ history_apply();
+ const int64_t now = get_cycle();
+ if (history_mode == Hist_Scan) {
+  if (now >= history_target)
+   history_scan_done();
+  else if (history_kind == Hist_Insn || bp_stop)
+   history_count++;
+  return false;
+ }
+ const bool land = (history_kind == Hist_Cycle) ? (now >= history_target)
+                 : ((history_kind == Hist_Insn || bp_stop) && history_count++ == history_land_index);
+ if (land)
+  history_landed();
+ return land;
+}
+
+// Pausing watchpoint hit while re-running. True to pause on it.
+static bool history_watch_hit(void)
+{
+ if (history_kind != Hist_Hit)
+  return false;
+ if (history_mode == Hist_Scan) {
+  if (get_cycle() < history_target)
+   history_count++;
+  return false;
+ }
+ if (history_mode == Hist_Land && history_count++ == history_land_index) {
+  history_landed();
+  return true;
+ }
+ return false;
+}
+
+// Why a reverse command can't start now ("" if it can).
+static std::string history_unavailable(void)
+{
+ if (history_mode == Hist_Off)
+  return "history is off (use history_start)";
+ if (history_mode != Hist_Record)
+  return history_op + " is still running";
+ if (history_snaps.empty())
+  return "no snapshot yet (one is taken at the next frame end)";
+ if (journal_file || journal_playing)
+  return "not while a journal is recorded or played";
+ if (ipb_play_file || playback_active || poke_playback_running)
+  return "not during input or poke playback";
+ return "";
+}
+
+// Start a reverse command at the snapshot "seg", restoring right away when
+// the command came in at a frame boundary.
+static void history_begin(const std::string& op, HistoryKind kind, size_t seg, HistoryMode mode)
+{
+ const bool boundary = history_at_frame_boundary();
+ history_op = op;
+ history_note.clear();
+ history_kind = kind;
+ history_seek(seg, mode);
+ if (boundary)
+  history_restore();
+}
+
+// mem_sample: one frame of every range. Ranges inside the RAM/VRAM regions of
+// shm_region_table are block-copied from the backing store; anything else
+// (registers, cartridge space) still goes through Automation_ReadMem8.
+//
+// A single range without xor/zlib writes the raw bytes back to back, as
+// mem_sample always has. Otherwise the file is "framed": "MDFNMSM1", le32
+// range count, le32 xor flag, le32 addr + le32 size per range, then per frame
+// le64 frame number and the ranges' bytes. With xor, those bytes are XORed
+// with the previous frame written (the first frame is as-is), so unchanged
+// memory is zero; with zlib the trace writer deflates the stream in blocks
+// (see trace_ring.h), which is what makes xor recordings small. A frame the
+// writer has no room for is dropped whole, and xor continues from the last
+// frame that was written, so frame numbers tell a reader what's missing.
+static void mem_sample_read(uint32_t addr, uint8_t* buf, uint32_t size)
+{
+ const uint32_t a = addr & 0x0FFFFFFF;
+ for (const auto& r : shm_region_table) {
+  if (a - r.addr < r.size && size <= r.size - (a - r.addr)) {
+   MDFN_IEN_SS::Automation_ReadMemBlock(a, buf, size);
+   return;
+  }
+ }
+ for (uint32_t i = 0; i < size; i++)
+  buf[i] = MDFN_IEN_SS::Automation_ReadMem8(addr + i);
+}
+
+static void mem_sample_frame(void)
+{
+ uint8_t* const data = mem_sample_buf.data() + (mem_sample_framed ? 8 : 0);
+ uint8_t* p = data;
+ for (const MemSampleRange& r : mem_sample_ranges) {
+  mem_sample_read(r.addr, p, r.size);
+  p += r.size;
+ }
+
+ if (!mem_sample_framed) {
+  mem_sample_ring->Write(data, mem_sample_size);
+  return;
+ }
+
+ MDFN_en64lsb(mem_sample_buf.data(), frame_counter);
+ if (mem_sample_xor && !mem_sample_prev.empty()) {
+  // Keep this frame's raw bytes for the next one, write the XOR
+  mem_sample_prev.swap(mem_sample_buf);
+  uint8_t* out = mem_sample_buf.data() + 8;
+  const uint8_t* cur = mem_sample_prev.data() + 8;
+  memcpy(mem_sample_buf.data(), mem_sample_prev.data(), 8);
+  for (uint32_t i = 0; i < mem_sample_size; i++)
+   out[i] ^= cur[i];
+  if (!mem_sample_ring->Write(mem_sample_buf.data(), mem_sample_buf.size()))
+   mem_sample_prev.swap(mem_sample_buf);  // dropped: the last frame written stays the reference
+  return;
+ }
+
+ if (mem_sample_ring->Write(mem_sample_buf.data(), mem_sample_buf.size()) && mem_sample_xor)
+  mem_sample_prev = mem_sample_buf;
+}
+
+// Capture plan (capture_plan set): a fixed list of items written as one
+// record every capture_period frames, so "frame_advance N" alone streams N
+// frames of data. File: "MDFNCAP1", le32 flags (bit 0: the rest is in
+// TraceRing deflate blocks), le32 period, le32 item count, then per item le32
+// kind, le32 param, le32 size. Each record is le64 frame, le64 master cycle,
+// then every item's bytes in order:
+//   0 mem   param addr; big-endian memory as read_mem returns it
+//   1 regs  param CPU (0 master, 1 slave); 22 host-order uint32s (dump_regs_bin)
+//   2 hash  le64 hash_framebuffer() of the frame (fb_hash_start's)
+//   3 obs   param width | height << 12 | channels << 24; the obs_expose pixels
+// Frames due for a record are rendered; a record the writer has no room for
+// is dropped whole.
+enum { CAP_MEM = 0, CAP_REGS, CAP_HASH, CAP_OBS };
+struct CaptureItem { uint32_t kind, param, size; };
+static MDFN_IEN_SS::TraceRing* capture_ring = nullptr;
+static std::vector<CaptureItem> capture_items;
+static std::vector<uint8_t> capture_buf;
+static int64_t capture_period = 1;
+static bool capture_wants_frame = false;   // a hash or obs item
+static uint64_t capture_hash = 0;          // this frame's, from Automation_Poll
+static uint64_t capture_records = 0;
+
+static bool capture_due(uint64_t frame)
+{
+ return capture_ring && (frame % capture_period) == 0;
+}
+
+static void capture_frame(void)
+{
+ uint8_t* p = capture_buf.data();
+ MDFN_en64lsb(p, frame_counter);
+ MDFN_en64lsb(p + 8, get_cycle());
+ p += 16;
+ for (const CaptureItem& it : capture_items) {
+  switch (it.kind) {
+   case CAP_MEM:
+	mem_sample_read(it.param, p, it.size);
+	break;
+
+   case CAP_REGS:
+	{
+	 uint32_t regs[22];
+	 MDFN_IEN_SS::Automation_GetRegs(it.param, regs);
+	 memcpy(p, regs, sizeof(regs));
+	}
+	break;
+
+   case CAP_HASH:
+	MDFN_en64lsb(p, capture_hash);
+	break;
+
+   case CAP_OBS:
+	if (obs_base && ((ObsHeader*)obs_base)->data_offset + it.size <= obs_map.size)
+	 memcpy(p, obs_base + ((ObsHeader*)obs_base)->data_offset, it.size);
+	else
+	 memset(p, 0, it.size);
+	break;
+  }
+  p += it.size;
+ }
+ if (capture_ring->Write(capture_buf.data(), capture_buf.size()))
+  capture_records++;
+}
+
+static void capture_stop(void)
+{
+ delete capture_ring;  // drains the ring
+ capture_ring = nullptr;
+ capture_items.clear();
+ capture_wants_frame = false;
+}
+
+// Memory scan (scan_start/scan_filter/scan_list), the RAM search of
+// mempatcher.cpp done over the backing store of named regions. Each region
+// keeps its last snapshot (big-endian bytes, from Automation_ReadMemBlock) and
+// a bitmap with one bit per aligned value of scan_size bytes. A filter reads
+// the regions again, clears the bits where the op fails and makes the new
+// read the snapshot. Bitmap words with every bit set go through a branchless
+// 64-value loop the compiler can vectorize; others only visit their set bits,
+// so once a search has narrowed, a step costs little more than the reads.
+struct ScanRegion {
+ uint32_t addr, size;
+ std::vector<uint8_t> last;
+ std::vector<uint64_t> live;
+};
+static std::vector<ScanRegion> scan_regions;
+static unsigned scan_size = 0;      // 1, 2 or 4 bytes; 0 = no search
+static uint64_t scan_count = 0;     // surviving candidates
+static std::vector<uint8_t> scan_cur;
+
+enum ScanOp { Scan_EQ, Scan_NE, Scan_GT, Scan_LT, Scan_Delta };
+
+template<unsigned W>
+static INLINE uint32_t scan_load(const uint8_t* p)
+{
+ return W == 1 ? p[0] : (W == 2 ? MDFN_de16msb(p) : MDFN_de32msb(p));
+}
+
+// true to keep: "a" is the value now, "b" the last snapshot or the operand
+template<ScanOp op>
+static INLINE bool scan_test(uint32_t a, uint32_t b, uint32_t delta, uint32_t mask)
+{
+ switch (op) {
+  case Scan_EQ: return a == b;
+  case Scan_NE: return a != b;
+  case Scan_GT: return a > b;
+  case Scan_LT: return a < b;
+  case Scan_Delta: return ((a - b) & mask) == delta;
+ }
+ return false;
+}
+
+template<unsigned W, ScanOp op, bool vs_last>
+static uint64_t scan_filter_region(ScanRegion& r, uint32_t operand, uint32_t delta)
+{
+ const uint8_t* const cur = scan_cur.data();
+ const uint8_t* const last = r.last.data();
+ const uint32_t mask = (W == 4) ? 0xFFFFFFFF : ((1U << (W * 8)) - 1);
+ uint64_t count = 0;
+
+ for (size_t wi = 0; wi < r.live.size(); wi++) {
+  uint64_t m = r.live[wi];
+  uint64_t keep = 0;
+
+  if (!m)
+   continue;
+
+  if (m == ~(uint64_t)0) {
+   const size_t base = wi * 64 * W;
+   for (unsigned b = 0; b < 64; b++) {
+    const uint32_t a = scan_load<W>(cur + base + b * W);
+    const uint32_t o = vs_last ? scan_load<W>(last + base + b * W) : operand;
+    keep |= (uint64_t)scan_test<op>(a, o, delta, mask) << b;
+   }
+  } else {
+   while (m) {
+    const unsigned b = __builtin_ctzll(m);
+    const size_t off = (wi * 64 + b) * W;
+    const uint32_t o = vs_last ? scan_load<W>(last + off) : operand;
+    if (scan_test<op>(scan_load<W>(cur + off), o, delta, mask))
+     keep |= (uint64_t)1 << b;
+    m &= m - 1;
+   }
+  }
+
+  r.live[wi] = keep;
+  count += __builtin_popcountll(keep);
+ }
+
+ return count;
+}
+
+template<unsigned W>
+static uint64_t scan_filter_width(ScanRegion& r, ScanOp op, bool vs_last, uint32_t operand)
+{
+ switch (op) {
+  case Scan_EQ: return vs_last ? scan_filter_region<W, Scan_EQ, true>(r, 0, 0) : scan_filter_region<W, Scan_EQ, false>(r, operand, 0);
+  case Scan_NE: return vs_last ? scan_filter_region<W, Scan_NE, true>(r, 0, 0) : scan_filter_region<W, Scan_NE, false>(r, operand, 0);
+  case Scan_GT: return vs_last ? scan_filter_region<W, Scan_GT, true>(r, 0, 0) : scan_filter_region<W, Scan_GT, false>(r, operand, 0);
+  case Scan_LT: return vs_last ? scan_filter_region<W, Scan_LT, true>(r, 0, 0) : scan_filter_region<W, Scan_LT, false>(r, operand, 0);
+  case Scan_Delta: return scan_filter_region<W, Scan_Delta, true>(r, 0, operand);
+ }
+ return 0;
+}
+
+static void scan_filter(ScanOp op, bool vs_last, uint32_t operand)
+{
+ scan_count = 0;
+ for (ScanRegion& r : scan_regions) {
+  scan_cur.resize(r.size);
+  MDFN_IEN_SS::Automation_ReadMemBlock(r.addr, scan_cur.data(), r.size);
+  if (scan_size == 1)
+   scan_count += scan_filter_width<1>(r, op, vs_last, operand);
+  else if (scan_size == 2)
+   scan_count += scan_filter_width<2>(r, op, vs_last, operand);
+  else
+   scan_count += scan_filter_width<4>(r, op, vs_last, operand);
+  r.last.swap(scan_cur);
+ }
+}
+
+// Named region snapshots (mem_snapshot) and their diff (mem_diff), so
+// "before and after" comparisons don't ship megabytes to the client. The diff
+// compares 64 bytes at a time with memcmp(), which libc does with vector
+// loads, and only walks the bytes of blocks that differ; changes closer than
+// MemDiff_Gap bytes are merged into one range.
+struct MemSnapRegion {
+ uint32_t addr, size;
+ std::vector<uint8_t> data;
+};
+static std::map<std::string, std::vector<MemSnapRegion>> mem_snapshots;
+
+struct MemDiffRange { uint32_t addr, len; const uint8_t* a; const uint8_t* b; };
+enum : uint32_t { MemDiff_Gap = 4 };
+
+static uint64_t mem_diff_region(uint32_t addr, const uint8_t* a, const uint8_t* b, uint32_t size, std::vector<MemDiffRange>& out)
+{
+ uint64_t changed = 0;
+ bool open = false;
+ for (uint32_t blk = 0; blk < size; blk += 64) {
+  const uint32_t n = std::min<uint32_t>(64, size - blk);
+  if (!memcmp(a + blk, b + blk, n))
+   continue;
+  for (uint32_t i = blk; i < blk + n; i++) {
+   if (a[i] == b[i])
+    continue;
+   changed++;
+   MemDiffRange* last = open ? &out.back() : nullptr;
+   if (last && addr + i - (last->addr + last->len) <= MemDiff_Gap)
+    last->len = addr + i + 1 - last->addr;
+   else {
+    out.push_back({ addr + i, 1, a + i, b + i });
+    open = true;
+   }
+  }
+ }
+ return changed;
+}
+
+#ifndef WIN32
+// spawn (fork server): a reason the process can't fork right now, or null.
+// The child must not share the parent's open logs, dumps or shared memory.
+static const char* spawn_blocker(void)
+{
+ if (!headless)
+  return "requires --automation_headless";
+ if (MDFN_GetSettingB("sound"))
+  return "requires -sound 0";
+ if (!MDFN_GetSettingB("cd.image_memcache") && !MDFN_GetSettingB("cd.image_mmap"))
+  return "requires cd.image_memcache or cd.image_mmap (the CD read thread doesn't survive fork)";
+ if (MDFNSRW_IsRunning())
+  return "requires state rewinding off (its compression thread doesn't survive fork)";
+ if (batch_active)
+  return "not allowed inside a batch";
+ if (frame_dump || shm_base || obs_base)
+  return "stop frame_dump, shm and obs first";
+ if (crash_watchdog || crash_png)
+  return "crash_bundle off first (its threads don't survive fork)";
+ if (unified_trace_file || unified_trace_bin || mem_sample_ring || capture_ring || input_trace_file)
+  return "stop traces, mem_sample and capture_plan first";
+ if (fb_hash_log || bus_profile_log || int_latency_log || sync_profile_log || vdp2_timing_log || vdp1_stats_log || vdp1_cmd_stats_log || perf_stats_log || wp_log || rwp_log || exc_log || bp_log)
+  return "close hash, profile, timing and hit logs first";
+ if (diverge_file || state_hash_file)
+  return "stop diverge_record/diverge_check and state_hash_log/state_hash_check first";
+ if (journal_file || journal_playing)
+  return "stop journal_record/journal_play first";
+ if (ipb_trace_file || ipb_play_file)
+  return "stop input_trace_bin/input_playback_bin first";
+ if (func_hook_ring)
+  return "stop func_hook_log first";
+ if (m68k_call_trace)
+  return "stop m68k_call_trace first";
+ if (MDFN_IEN_SS::Automation_HeatmapIsActive() || MDFN_IEN_SS::Automation_VDP2WatchIsActive() || MDFN_IEN_SS::Automation_OpStatsIsActive()
+  || MDFN_IEN_SS::Automation_DSPProfileIsActive() || MDFN_IEN_SS::Automation_DMATraceBinIsActive() || MDFN_IEN_SS::CDB_ProfileIsActive())
+  return "stop mem_heatmap, vdp2_watchpoint, op_stats, dsp_profile, dma_trace_bin and cdb_profile first";
+ if (MDFN_IEN_SS::Automation_CDLOverlayIsActive())
+  return "stop cdl_overlay_log first";
+ return nullptr;
+}
+
+// In the forked child: drop the parent's command transports and take over
+// ipc_dir, optionally from a save state. The parent's socket stays the
+// parent's; the child only uses the action/ack files in ipc_dir.
+static void spawn_child_init(const std::string& dir, const std::string& state)
+{
+ fork_child = true;
+ if (sock_client_fd != AUTO_SOCK_INVALID)
+  auto_sock_close(sock_client_fd);
+ if (sock_listen_fd != AUTO_SOCK_INVALID)
+  auto_sock_close(sock_listen_fd);
+ sock_client_fd = sock_listen_fd = AUTO_SOCK_INVALID;
+ sock_unix_path.clear();
+ sock_rx_buf.clear();
+ acks_to_socket = false;
+ sock_subscribed = false;
+ if (gdb_client_fd != AUTO_SOCK_INVALID)
+  auto_sock_close(gdb_client_fd);
+ if (gdb_listen_fd != AUTO_SOCK_INVALID)
+  auto_sock_close(gdb_listen_fd);
+ gdb_client_fd = gdb_listen_fd = AUTO_SOCK_INVALID;
+ gdb_rx_buf.clear();
+ gdb_resumed = false;
+
+ mkdir(dir.c_str(), 0777);
+ if (!state.empty()) {
+  try {
+   load_state_file(state);
+  } catch (std::exception& e) {
+   fprintf(stderr, "Automation: spawn: error loading %s: %s\n", state.c_str(), e.what());
+   _exit(1);
+  }
+ }
+ Automation_Init(dir);  // paused at frame 0, "ready frame=0" in dir's ack file
+}
+
+// Instance pool (pool_start, --automation_pool): the supervisor forks N spawn
+// children from where it is paused, each with its own ipc dir and, when the
+// supervisor has a socket, its own socket (tcp:<port + 1 + i>, or
+// <path>.<i>). pool_acquire leases a free one out; pool_release kills it and
+// forks a fresh one in its slot, so every lease starts from the supervisor's
+// checkpoint, with no state to scrub. Children publish their frame count
+// in a shared page for pool_status throughput, and die with the supervisor.
+struct PoolShared
+{
+ std::atomic<uint64_t> frames;
+};
+
+struct PoolSlot
+{
+ pid_t pid = -1;	// -1: exited, or failed to fork
+ bool leased = false;
+ uint64_t leases = 0;
+ std::string dir, sock;
+};
+
+static std::vector<PoolSlot> pool_slots;
+static PoolShared* pool_shared = nullptr;	// MAP_SHARED, one per slot
+static size_t pool_shared_size = 0;
+static PoolShared* pool_self = nullptr;	// in a pool child: its entry
+static unsigned pool_pending = 0;	// --automation_pool, started on the first Poll
+static std::string pool_state;
+static uint64_t pool_retired_frames = 0;	// frames of children already replaced
+static int64_t pool_start_us = 0;
+static int64_t pool_last_us = 0;
+static uint64_t pool_last_frames = 0;
+
+static uint64_t pool_frames(void)
+{
+ uint64_t total = pool_retired_frames;
+ for (size_t i = 0; i < pool_slots.size(); i++)
+  total += pool_shared[i].frames.load(std::memory_order_relaxed);
+ return total;
+}
+
+// Fork slot i: 1 in the supervisor, 0 in the new child, -1 on error.
+static int pool_fork(size_t i, std::string* err)
+{
+ PoolSlot& s = pool_slots[i];
+ const char* blocker = spawn_blocker();
+ if (blocker) {
+  *err = blocker;
+  return -1;
+ }
+
+ pool_retired_frames += pool_shared[i].frames.exchange(0);
+ MDFNSS_KillAsync();
+ MDFN_IEN_SS::Automation_SuspendThreads();
+ fflush(NULL);
+ const pid_t pid = fork();
+ MDFN_IEN_SS::Automation_ResumeThreads();
+
+ if (pid < 0) {
+  *err = std::string("fork: ") + strerror(errno);
+  s.pid = -1;
+  return -1;
+ }
+ if (pid == 0) {
+#ifdef __linux__
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+  const PoolSlot self = s;
+  pool_self = &pool_shared[i];
+  pool_shared = nullptr;	// the supervisor's to unmap
+  pool_slots.clear();
+  spawn_child_init(self.dir, pool_state);
+  if (!self.sock.empty() && !Automation_InitSocket(self.sock))
+   _exit(1);
+  return 0;
+ }
+ s.pid = pid;
+ s.leased = false;
+ return 1;
+}
+
+// Kill slot i's child, if any, and wait for it.
+static void pool_kill(size_t i)
+{
+ PoolSlot& s = pool_slots[i];
+ if (s.pid > 0) {
+  kill(s.pid, SIGKILL);
+  waitpid(s.pid, nullptr, 0);
+  s.pid = -1;
+ }
+ if (!s.sock.empty() && s.sock.compare(0, 4, "tcp:"))
+  unlink(s.sock.c_str());
+}
+
+// Reap children that exited on their own; free slots get a new one.
+// Returns 0 if this is now a new child.
+static int pool_reap(void)
+{
+ for (PoolSlot& s : pool_slots) {
+  if (s.pid > 0 && waitpid(s.pid, nullptr, WNOHANG) != 0)
+   s.pid = -1;
+ }
+ for (size_t i = 0; i < pool_slots.size(); i++) {
+  std::string err;
+  if (pool_slots[i].pid < 0 && !pool_slots[i].leased && pool_fork(i, &err) == 0)
+   return 0;
+ }
+ return 1;
+}
+
+static void pool_stop(void)
+{
+ for (size_t i = 0; i < pool_slots.size(); i++)
+  pool_kill(i);
+ pool_slots.clear();
+ if (pool_shared) {
+  munmap(pool_shared, pool_shared_size);
+  pool_shared = nullptr;
+ }
+ pool_retired_frames = 0;
+}
+
+// 1 in the supervisor, 0 in a new child, -1 on error.
+static int pool_start(unsigned n, const std::string& dir, const std::string& state, std::string* err)
+{
+ if (fork_child) {
+  *err = "not in a spawned child";
+  return -1;
+ }
+ pool_stop();
+ pool_shared_size = (n * sizeof(PoolShared) + 4095) & ~(size_t)4095;
+ void* p = mmap(nullptr, pool_shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+ if (p == MAP_FAILED) {
+  *err = std::string("mmap: ") + strerror(errno);
+  return -1;
+ }
+ pool_shared = new (p) PoolShared[n];
+ for (unsigned i = 0; i < n; i++)
+  pool_shared[i].frames = 0;
+
+ pool_state = state;
+ pool_slots.resize(n);
+ mkdir(dir.c_str(), 0777);
+ for (unsigned i = 0; i < n; i++) {
+  PoolSlot& s = pool_slots[i];
+  s.dir = dir + "/" + std::to_string(i);
+  if (sock_spec.empty())
+   s.sock.clear();
+  else if (!sock_spec.compare(0, 4, "tcp:"))
+   s.sock = "tcp:" + std::to_string(atoi(sock_spec.c_str() + 4) + 1 + i);
+  else
+   s.sock = sock_spec + "." + std::to_string(i);
+ }
+ for (unsigned i = 0; i < n; i++) {
+  const int r = pool_fork(i, err);
+  if (r <= 0) {
+   if (r < 0)
+    pool_stop();
+   return r;
+  }
+ }
+ pool_start_us = pool_last_us = Time::MonoUS();
+ pool_last_frames = 0;
+ return 1;
+}
+#endif
+
+static void raster_line_hook(uint32_t line, bool vb_in, bool vb_out)
+{
+ if (raster_break || history_mode >= Hist_Seek)
+  return;
+
+ char msg[96];
+ if (run_to_line_target >= 0 && line == (uint32_t)run_to_line_target
+  && (run_to_line_frame < 0 || (int64_t)frame_counter >= run_to_line_frame)) {
+  snprintf(msg, sizeof(msg), "done run_to_line line=%u frame=%llu", line, (unsigned long long)frame_counter);
+  run_to_line_target = -1;
+  run_to_line_frame = -1;
+ }
+ else if ((vb_in && break_vblank_in) || (vb_out && break_vblank_out))
+  snprintf(msg, sizeof(msg), "break %s line=%u frame=%llu", vb_in ? "vblank_in" : "vblank_out",
+   line, (unsigned long long)frame_counter);
+ else
+  return;
+
+ raster_break_msg = msg;
+ raster_break = true;
+ update_cpu_hook();
+ raster_update_hook();
+}
+
+static void raster_update_hook(void)
+{
+ const bool on = run_to_line_target >= 0 || break_vblank_in || break_vblank_out;
+ MDFN_IEN_SS::Automation_SetLineHook(on ? raster_line_hook : nullptr);
+}
+
+static void step_return_cancel(void)
+{
+ step_return_active = false;
+ step_over_pending = false;
+}
+
+static void run_to_line_cancel(void)
+{
+ run_to_line_target = -1;
+ run_to_line_frame = -1;
+ raster_update_hook();
+}
+
+static void run_until_stop(void)
+{
+ if (run_until_every)
+  MDFN_IEN_SS::Automation_SetTickHook(nullptr, 0);
+ run_until_active = false;
+ run_until_break = false;
+ run_until_every = 0;
+}
+
+// frame_advance, run or pause during a benchmark end it without its ack.
+static void bench_cancel(void)
+{
+ if (!bench_active)
+  return;
+ bench_active = false;
+ turbo = bench_turbo_was;
+ if (!bench_perf_was)
+  MDFN_IEN_SS::Automation_PerfStatsStop();
+}
+
+static uint32_t cond_read_mem(uint32_t addr, unsigned size);
+
+// Script rule grammar:
+//   frame [every=N] [if <expr>] do <cmd>; ...
+//   break <pc> [slave] [if <expr>] do <cmd>; ...
+//   watch <id> [if <expr>] do <cmd>; ...
+static bool script_parse_rule(const std::string& src, ScriptRule* rule, std::string* err)
+{
+ const size_t do_pos = (" " + src + " ").find(" do ");
+ if (do_pos == std::string::npos) {
+  *err = "expected '... do <command>'";
+  return false;
+ }
+
+ std::istringstream head(src.substr(0, do_pos));
+ std::string kind, tok;
+ head >> kind;
+ rule->src = src;
+ if (kind == "frame")
+  rule->kind = ScriptRule::On_Frame;
+ else if (kind == "break") {
+  rule->kind = ScriptRule::On_Break;
+  if (!(head >> std::hex >> rule->addr)) {
+   *err = "break: expected a hex PC";
+   return false;
+  }
+ }
+ else if (kind == "watch") {
+  rule->kind = ScriptRule::On_Watch;
+  if (!(head >> std::dec >> rule->addr)) {
+   *err = "watch: expected a watchpoint id";
+   return false;
+  }
+ }
+ else {
+  *err = "expected frame, break or watch, got '" + kind + "'";
+  return false;
+ }
+
+ while (head >> tok) {
+  if (tok == "if") {
+   std::string expr;
+   std::getline(head, expr);
+   if (!rule->cond.Compile(expr, err)) {
+    *err = "condition: " + *err;
+    return false;
+   }
+   rule->has_cond = true;
+   break;
+  }
+  else if (rule->kind == ScriptRule::On_Frame && !tok.compare(0, 6, "every="))
+   rule->every = std::max<uint32_t>(1, strtoul(tok.c_str() + 6, nullptr, 0));
+  else if (rule->kind == ScriptRule::On_Break && tok == "slave")
+   rule->slave = true;
+  else {
+   *err = "unexpected '" + tok + "'";
+   return false;
+  }
+ }
+
+ // Actions, with ${expr} / ${expr:d} compiled once here.
+ std::string acts = src.substr(std::min(do_pos + 3, src.size()));
+ size_t start = 0;
+ while (start <= acts.size()) {
+  size_t end = acts.find(';', start);
+  if (end == std::string::npos)
+   end = acts.size();
+  std::string act = acts.substr(start, end - start);
+  start = end + 1;
+
+  act.erase(0, act.find_first_not_of(" \t"));
+  act.erase(act.find_last_not_of(" \t\r") + 1);
+  if (act.empty())
+   continue;
+
+  const std::string name = act.substr(0, act.find(' '));
+  if (!name.compare(0, 7, "script_") || !name.compare(0, 6, "batch_") || name == "subscribe"
+      || name == "read_mem" || name == "read_regs") {
+   *err = "'" + name + "' can't be used in a script action";
+   return false;
+  }
+
+  std::vector<ScriptPiece> pieces;
+  size_t p = 0;
+  while (p < act.size()) {
+   const size_t open = act.find("${", p);
+   ScriptPiece lit;
+   lit.text = act.substr(p, (open == std::string::npos ? act.size() : open) - p);
+   if (!lit.text.empty())
+    pieces.push_back(lit);
+   if (open == std::string::npos)
+    break;
+
+   const size_t close = act.find('}', open);
+   if (close == std::string::npos) {
+    *err = "unterminated ${ in '" + act + "'";
+    return false;
+   }
+   ScriptPiece ex;
+   ex.is_expr = true;
+   ex.text = act.substr(open + 2, close - open - 2);
+   if (ex.text.size() >= 2 && !ex.text.compare(ex.text.size() - 2, 2, ":d")) {
+    ex.decimal = true;
+    ex.text.resize(ex.text.size() - 2);
+   }
+   if (!ex.expr.Compile(ex.text, err)) {
+    *err = "${" + ex.text + "}: " + *err;
+    return false;
+   }
+   pieces.push_back(ex);
+   p = close + 1;
+  }
+  rule->actions.push_back(pieces);
+ }
+
+ if (rule->actions.empty()) {
+  *err = "no actions after 'do'";
+  return false;
+ }
+ return true;
+}
+
+static void script_index(void)
+{
+ script_break_index[0].clear();
+ script_break_index[1].clear();
+ script_have_frame = script_have_watch = false;
+ for (size_t i = 0; i < script_rules.size(); i++) {
+  const ScriptRule& r = script_rules[i];
+  if (r.kind == ScriptRule::On_Break)
+   script_break_index[r.slave][r.addr].push_back(i);
+  script_have_frame |= (r.kind == ScriptRule::On_Frame);
+  script_have_watch |= (r.kind == ScriptRule::On_Watch);
+ }
+ update_cpu_hook();
+}
+
+// Evaluate one rule and, if it holds, run its actions. A rule that pauses
+// emulation (e.g. "do pause") reports "break script rule=N".
+static void script_fire(size_t index, unsigned cpu, const uint32_t* ext)
+{
+ ScriptRule& r = script_rules[index];
+ uint32_t regs[BpCondition::Num_Regs];
+
+ MDFN_IEN_SS::Automation_GetRegs(cpu, regs);
+ r.hits++;
+ if (r.has_cond && !r.cond.Eval(regs, (uint32_t)r.hits, cond_read_mem, (uint32_t)frame_counter, 0, ext))
+  return;
+ r.fired++;
+
+ const bool was_running = frames_to_advance != 0;
+ for (const std::vector<ScriptPiece>& act : r.actions) {
+  std::string line;
+  for (const ScriptPiece& piece : act) {
+   if (!piece.is_expr) {
+    line += piece.text;
+    continue;
+   }
+   char buf[16];
+   snprintf(buf, sizeof(buf), piece.decimal ? "%u" : "%X",
+    piece.expr.Value(regs, (uint32_t)r.hits, cond_read_mem, (uint32_t)frame_counter, 0, ext));
+   line += buf;
+  }
+
+  std::istringstream iss(line);
+  std::string cmd;
+  iss >> cmd;
+  script_running = true;
+  script_ack.clear();
+  dispatch_command(line, iss, cmd);
+  script_running = false;
+  if (!script_ack.compare(0, 6, "error ")) {
+   r.errors++;
+   r.last_error = script_ack;
+  }
+ }
+
+ if (was_running && frames_to_advance == 0)
+  write_ack("break script rule=" + std::to_string(index) + " frame=" + std::to_string(frame_counter));
+}
+
+static void script_frame(void)
+{
+ for (size_t i = 0; i < script_rules.size(); i++) {
+  if (script_rules[i].kind == ScriptRule::On_Frame && (frame_counter % script_rules[i].every) == 0)
+   script_fire(i, 0, nullptr);
+ }
+}
+
+// Same pc / pc-2 fallback as breakpoints and poke triggers.
+static void script_break(unsigned cpu, uint32_t pc)
+{
+ auto it = script_break_index[cpu].find(pc);
+ if (it == script_break_index[cpu].end() && (it = script_break_index[cpu].find(pc - 2)) == script_break_index[cpu].end())
+  return;
+
+ const uint32_t ext[BpCondition::Num_Ext] = { it->first, 0, 0 };
+ const std::vector<size_t> rules = it->second;  // an action may reindex
+ for (size_t i : rules)
+  script_fire(i, cpu, ext);
+}
+
+static void script_watch(unsigned id, uint32_t addr, uint32_t old_val, uint32_t new_val)
+{
+ const uint32_t ext[BpCondition::Num_Ext] = { addr, old_val, new_val };
+ for (size_t i = 0; i < script_rules.size(); i++) {
+  if (script_rules[i].kind == ScriptRule::On_Watch && script_rules[i].addr == id)
+   script_fire(i, 0, ext);
+ }
+}
+
+//
+// Command table. Every command is an entry in command_table (after the
+// handlers) with a name, an optional argument schema and a handler, and
+// dispatch_command() finds it in one hash lookup. Without a schema the handler
+// gets the line and its istringstream, positioned after the command word, and
+// parses the rest itself. With one, the arguments are parsed and checked first
+// (a mismatch acks "error <cmd>: usage: <cmd> <schema>") and the handler gets
+// them typed in CmdArgs, so a caller that already holds typed values can
+// fill one for cmd_lookup()'s entry and call the handler without any text.
+//
+// Schema: space-separated items. "name:t" is a positional argument of type x
+// (hex uint32), u (decimal uint64), i (decimal int64) or s (one word); in [...]
+// it is optional, and optional positionals come last. "[word]" is a flag and
+// "[key=t]" a keyed option; both may appear anywhere among the positionals.
+//
+// Parsing is as lenient as the commands' own istringstream parses were: a
+// number only needs to start with digits (like operator>>), a malformed value
+// leaves its argument unset so an optional one takes its default, and tokens
+// the schema has no place for are ignored. Only a missing or malformed
+// required argument is a usage error.
+//
+struct CmdArg
+{
+ std::string name;	// flag word, key or positional name
+ char type;		// 'x', 'u', 'i', 's', or 'f' for a flag
+ bool optional;
+ bool keyed;		// flag or key=value, matched by name rather than position
+};
+
+struct CmdArgs
+{
+ const std::vector<CmdArg>* spec = nullptr;
+ std::vector<uint8_t> set;
+ std::vector<uint64_t> num;
+ std::vector<std::string> str;
+
+ size_t find(const char* name) const
+ {
+  for (size_t i = 0; i < spec->size(); i++) {
+   if ((*spec)[i].name == name)
+    return i;
+  }
+  assert(false);
+  return 0;
+ }
+ bool has(const char* name) const { return set[find(name)]; }
+ uint64_t u(const char* name, uint64_t def = 0) const { const size_t k = find(name); return set[k] ? num[k] : def; }
+ int64_t i(const char* name, int64_t def = 0) const { const size_t k = find(name); return set[k] ? (int64_t)num[k] : def; }
+ const std::string& s(const char* name) const { return str[find(name)]; }
+};
+
+typedef void (*CommandRawFn)(const std::string& line, std::istringstream& iss, const std::string& cmd);
+typedef void (*CommandArgsFn)(const CmdArgs& args);
+
+struct CommandDef
+{
+ const char* name;
+ const char* schema;	// nullptr: raw handler
+ CommandRawFn raw;
+ CommandArgsFn typed;
+};
+
+struct CommandEntry
+{
+ const CommandDef* def;
+ std::vector<CmdArg> args;	// schema, parsed once
+};
+
+static bool cmd_parse_schema(const char* schema, std::vector<CmdArg>* args)
+{
+ std::istringstream ss(schema);
+ std::string item;
+ bool seen_optional = false;
+
+ while (ss >> item) {
+  CmdArg a;
+  a.optional = item.size() > 2 && item.front() == '[' && item.back() == ']';
+  if (a.optional)
+   item = item.substr(1, item.size() - 2);
+  const size_t sep = item.find_first_of(":=");
+  a.keyed = sep == std::string::npos || item[sep] == '=';
+  if (!a.optional && a.keyed)
+   return false;
+  a.name = item.substr(0, sep);
+  a.type = sep == std::string::npos ? 'f' : (sep + 2 == item.size() ? item[sep + 1] : 0);
+  if (!strchr("xuisf", a.type) || !a.type || (!a.keyed && seen_optional && !a.optional))
+   return false;
+  seen_optional |= !a.keyed && a.optional;
+  args->push_back(a);
+ }
+ return true;
+}
+
+static bool cmd_parse_value(const CmdArg& a, const std::string& tok, uint64_t* num, std::string* str)
+{
+ const char* const s = tok.c_str();
+ char* end = nullptr;
+
+ if (tok.empty())
+  return false;
+ errno = 0;
+ switch (a.type) {
+  case 'x': *num = strtoull(s, &end, 16); return end != s && !errno && *num <= 0xFFFFFFFF && tok[0] != '-';
+  case 'u': *num = strtoull(s, &end, 10); return end != s && !errno && tok[0] != '-';
+  case 'i': *num = (uint64_t)strtoll(s, &end, 10); return end != s && !errno;
+  default: *str = tok; return true;
+ }
+}
+
+static bool cmd_parse_args(const CommandEntry& e, std::istringstream& iss, CmdArgs* out)
+{
+ const std::vector<CmdArg>& spec = e.args;
+ size_t next_pos = 0;
+ std::string tok;
+
+ out->spec = &spec;
+ out->set.assign(spec.size(), 0);
+ out->num.assign(spec.size(), 0);
+ out->str.assign(spec.size(), std::string());
+
+ while (iss >> tok) {
+  size_t k = spec.size();
+  const size_t eq = tok.find('=');
+
+  for (size_t i = 0; i < spec.size() && k == spec.size(); i++) {
+   if (spec[i].keyed && (spec[i].type == 'f' ? tok == spec[i].name : (eq == spec[i].name.size() && !tok.compare(0, eq, spec[i].name))))
+    k = i;
+  }
+  if (k < spec.size()) {
+   if (spec[k].type == 'f' || cmd_parse_value(spec[k], tok.substr(eq + 1), &out->num[k], &out->str[k]))
+    out->set[k] = 1;
+   continue;
+  }
+  while (next_pos < spec.size() && spec[next_pos].keyed)
+   next_pos++;
+  if (next_pos == spec.size())
+   continue;
+  // A malformed value still takes its position, as iss >> n would have.
+  if (cmd_parse_value(spec[next_pos], tok, &out->num[next_pos], &out->str[next_pos]))
+   out->set[next_pos] = 1;
+  next_pos++;
+ }
+
+ for (size_t i = 0; i < spec.size(); i++) {
+  if (!spec[i].optional && !out->set[i])
+   return false;
+ }
+ return true;
+}
+
+static void cmd_frame_advance(const CmdArgs& args)
+{
+ const int64_t n = std::max<int64_t>(1, args.i("n", 1));
+ run_until_stop();
+ run_to_line_cancel();
+ step_return_cancel();
+ bench_cancel();
+ frames_to_advance = n;
+ instruction_paused = false;   // unblock instruction-level pause
+ watchpoint_paused = false;    // unblock watchpoint pause
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;    // cancel step mode
+ slave_instructions_to_step = -1;
+ run_to_cycle_target = -1;     // cancel cycle target
+ update_cpu_hook();
+ write_ack("ok frame_advance " + std::to_string(n));
+}
+
+static void cmd_screenshot(const std::string&, std::istringstream& iss, const std::string&)
+{
+ ScreenshotReq req;
+ std::string err;
+ iss >> req.path;
+ if (req.path.empty()) {
+  write_ack("error screenshot: no path specified");
+ } else if (!parse_screenshot_opts(iss, &req, &err)) {
+  write_ack("error screenshot: " + err);
+ } else {
+  // Immediate screenshot from cached framebuffer — no frame advance, no PC movement.
+  do_screenshot(req);
+ }
+}
+
+static void cmd_screenshot_phash(const std::string&, std::istringstream& iss, const std::string&)
+{
+ ScreenshotReq req;
+ std::string err;
+ if (!parse_screenshot_opts(iss, &req, &err))
+  write_ack("error screenshot_phash: " + err);
+ else
+  do_screenshot(req);
+}
+
+static void cmd_frame_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string dir, tok, err;
+ int64_t every = 1;
+ unsigned workers = 2;
+ bool stream = false;
+ FrameDump::Format format = FrameDump::FMT_PNG;
+ struct stat st;
+ iss >> dir;
+ if (dir.empty()) {
+  write_ack("error frame_dump: usage frame_dump <dir> [every=N] [format=png|qoi|raw|none] [workers=N] [stream]");
+  return;
+ }
+ while (iss >> tok) {
+  if (tok.compare(0, 6, "every=") == 0) {
+   every = std::max<int64_t>(1, atoll(tok.c_str() + 6));
+  } else if (tok.compare(0, 8, "workers=") == 0) {
+   workers = atoi(tok.c_str() + 8);
+  } else if (tok == "stream") {
+   stream = true;
+  } else if (tok == "format=png") {
+   format = FrameDump::FMT_PNG;
+  } else if (tok == "format=qoi") {
+   format = FrameDump::FMT_QOI;
+  } else if (tok == "format=raw") {
+   format = FrameDump::FMT_RAW;
+  } else if (tok == "format=none") {
+   format = FrameDump::FMT_NONE;
+  } else {
+   write_ack("error frame_dump: unknown option '" + tok + "'");
+   return;
+  }
+ }
+ if (stat(dir.c_str(), &st) || !S_ISDIR(st.st_mode)) {
+  write_ack("error frame_dump: not a directory: " + dir);
+  return;
+ }
+ delete frame_dump;
+ if (!(frame_dump = FrameDump::Open(dir, format, stream, workers, &err))) {
+  write_ack("error frame_dump: " + err);
+  return;
+ }
+ frame_dump_every = every;
+ write_ack("ok frame_dump " + dir + " every=" + std::to_string(every));
+}
+
+static void cmd_frame_dump_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (!frame_dump) {
+  write_ack("error frame_dump_stop: not active");
+  return;
+ }
+ frame_dump->Finish();
+ const std::string size = frame_dump->StreamSize();
+ const std::string err = frame_dump->Error();
+ std::string msg = "frames=" + std::to_string(frame_dump->Submitted()) + " stalls=" + std::to_string(frame_dump->Stalls());
+ if (!size.empty())
+  msg += " stream=" + size;
+ delete frame_dump;
+ frame_dump = nullptr;
+ if (!err.empty())
+  write_ack("error frame_dump_stop: " + err + " " + msg);
+ else
+  write_ack("ok frame_dump_stop " + msg);
+}
+
+static void cmd_input(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string button;
+ iss >> button;
+ int b = parse_button(button.c_str());
+ if (b >= 0) {
+  input_buttons |= (1 << b);
+  input_override = true;
+  write_ack("ok input " + button);
+ } else {
+  write_ack("error input: unknown button " + button);
+ }
+}
+
+static void cmd_input_release(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string button;
+ iss >> button;
+ int b = parse_button(button.c_str());
+ if (b >= 0) {
+  input_buttons &= ~(1 << b);
+  if (input_buttons == 0) input_override = false;
+  write_ack("ok input_release " + button);
+ } else {
+  write_ack("error input_release: unknown button " + button);
+ }
+}
+
+static void cmd_input_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ input_buttons = 0;
+ input_override = false;
+ write_ack("ok input_clear");
+}
+
+static void cmd_input_port(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned port = ~0U;
+ std::string hex;
+ iss >> port >> hex;
+ std::vector<uint8_t> bytes;
+ bool bad = port >= 16 || hex.empty() || (hex != "clear" && (hex.size() & 1));
+ for (size_t i = 0; !bad && hex != "clear" && i < hex.size(); i += 2) {
+  char* end;
+  const std::string pair = hex.substr(i, 2);
+  bytes.push_back((uint8_t)strtoul(pair.c_str(), &end, 16));
+  bad = *end != 0;
+ }
+ if (bad) {
+  write_ack("error input_port: usage: input_port <port 0-15> <hex bytes>|clear");
+ } else {
+  input_port_data[port] = bytes;
+  write_ack("ok input_port " + std::to_string(port) + " " + hex);
+ }
+}
+
+static void cmd_input_exclusive(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string arg;
+ iss >> arg;
+ if (arg != "on" && arg != "off") {
+  write_ack("error input_exclusive: expected on or off");
+ } else {
+  input_exclusive = (arg == "on");
+  write_ack("ok input_exclusive " + arg);
+ }
+}
+
+static void cmd_run_to_frame(const std::string&, std::istringstream& iss, const std::string&)
+{
+ int64_t n = 0;
+ iss >> n;
+ run_until_stop();
+ run_to_line_cancel();
+ step_return_cancel();
+ run_to_frame_target = n;
+ frames_to_advance = -1;  // free-run until target
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ run_to_cycle_target = -1;
+ update_cpu_hook();
+ write_ack("ok run_to_frame " + std::to_string(n));
+}
+
+static void cmd_run(const std::string&, std::istringstream&, const std::string&)
+{
+ run_until_stop();
+ run_to_line_cancel();
+ step_return_cancel();
+ bench_cancel();
+ frames_to_advance = -1;
+ run_to_frame_target = -1;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ run_to_cycle_target = -1;
+ update_cpu_hook();
+ // No ack -- single-threaded, command is guaranteed to execute.
+ // Next ack will be the break/watchpoint event (no overwrite race).
+}
+
+static void cmd_run_until(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // run_until [every=N] <expr> [max_frames]: a trailing number is max_frames
+ // only if the expression doesn't parse with it.
+ std::string rest, err;
+ uint32_t every = 0;
+ int64_t max_frames = -1;
+ std::getline(iss >> std::ws, rest);
+ if (!rest.compare(0, 6, "every=")) {
+  every = strtoul(rest.c_str() + 6, nullptr, 0);
+  const size_t sp = rest.find(' ');
+  rest = (sp == std::string::npos) ? std::string() : rest.substr(sp + 1);
+ }
+ BpCondition cond;
+ if (!cond.Compile(rest, &err)) {
+  const size_t sp = rest.find_last_of(' ');
+  std::string err2;
+  char* end = nullptr;
+  const long long mf = (sp != std::string::npos) ? strtoll(rest.c_str() + sp + 1, &end, 0) : -1;
+  if (end && !*end && mf > 0 && cond.Compile(rest.substr(0, sp), &err2))
+   max_frames = mf;
+  else {
+   write_ack("error run_until: " + err);
+   return;
+  }
+ }
+ run_until_stop();
+ run_until_cond = cond;
+ run_until_active = true;
+ run_until_evals = 0;
+ run_until_start_cycle = get_cycle();
+ run_until_max_frame = (max_frames > 0) ? (int64_t)frame_counter + max_frames : -1;
+ run_until_every = every;
+ if (every)
+  MDFN_IEN_SS::Automation_SetTickHook(run_until_tick, every);
+ frames_to_advance = -1;
+ run_to_frame_target = -1;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ run_to_cycle_target = -1;
+ update_cpu_hook();
+ write_ack("ok run_until" + std::string(every ? " every=" + std::to_string(every) : "")
+           + (max_frames > 0 ? " max_frames=" + std::to_string(max_frames) : ""));
+}
+
+static void cmd_render_skip(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (mode == "on" || mode == "off") {
+  render_skip = (mode == "on");
+  write_ack("ok render_skip " + mode);
+ } else if (mode.empty())
+  write_ack(std::string("ok render_skip ") + (render_skip ? "on" : "off"));
+ else
+  write_ack("error render_skip: expected on or off");
+}
+
+static void cmd_benchmark(const std::string&, std::istringstream& iss, const std::string&)
+{
+ int64_t n = 0;
+ std::string path;
+ iss >> n;
+ std::getline(iss >> std::ws, path);
+ if (n < 1 || path.empty()) {
+  write_ack("error benchmark: usage: benchmark <frames> <state>");
+ } else if (bench_active) {
+  write_ack("error benchmark: already running");
+ } else {
+  try {
+   load_state_file(path);
+   frame_counter = 0;
+   journal_state();
+   history_clear();
+   run_until_stop();
+   run_to_frame_target = -1;
+   run_to_cycle_target = -1;
+   update_cpu_hook();
+   input_buttons = 0;
+   input_override = false;
+   bench_active = true;
+   bench_turbo_was = turbo;
+   bench_perf_was = MDFN_IEN_SS::Automation_PerfStatsIsActive();
+   bench_frames = n;
+   turbo = true;
+   MDFN_IEN_SS::Automation_PerfStatsStart();
+   bench_start_us = Time::MonoUS();
+   frames_to_advance = n;
+   write_ack("ok benchmark frames=" + std::to_string(n) + " " + path);
+  } catch (std::exception& e) {
+   write_ack(std::string("error benchmark: ") + e.what());
+  }
+ }
+}
+
+static void cmd_speed(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (mode == "max" || mode == "normal") {
+  turbo = (mode == "max");
+  write_ack("ok speed " + mode);
+ } else if (mode.empty())
+  write_ack(std::string("ok speed ") + (turbo ? "max" : "normal"));
+ else
+  write_ack("error speed: expected max or normal");
+}
+
+static void cmd_pause(const std::string&, std::istringstream&, const std::string&)
+{
+ run_until_stop();
+ run_to_line_cancel();
+ step_return_cancel();
+ bench_cancel();
+ frames_to_advance = 0;
+ write_ack("ok pause frame=" + std::to_string(frame_counter));
+}
+
+static void cmd_quit(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack("ok quit");
+ if (fork_child) {
+  // No main thread to shut down in a spawned child, and nothing of its own
+  // (settings, backup RAM) to save.
+  fflush(NULL);
+  _exit(0);
+ }
+ MainRequestExit();
+}
+
+static void cmd_dump_regs(const std::string&, std::istringstream&, const std::string&)
+{
+ dump_registers();
+}
+
+static void cmd_dump_mem(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t addr = 0, size = 256;  // default 256 bytes if size omitted
+ iss >> std::hex >> addr >> size;
+ dump_memory(addr, size);
+}
+
+static void cmd_status(const std::string&, std::istringstream&, const std::string&)
+{
+ std::ostringstream ss;
+ ss << "status frame=" << frame_counter;
+ ss << " paused=" << ((frames_to_advance == 0 || instruction_paused) ? "true" : "false");
+ ss << " inst_paused=" << (instruction_paused ? "true" : "false");
+ ss << " breakpoints=" << breakpoints.size();
+ ss << " slave_breakpoints=" << slave_breakpoints.size();
+ if (fb_hash_on) {
+  char hbuf[64];
+  snprintf(hbuf, sizeof(hbuf), " fb_hash=%016llx fb_hash_frame=%llu", (unsigned long long)fb_hash_value, (unsigned long long)fb_hash_frame);
+  ss << hbuf;
+ }
+ ss << " input=0x" << std::hex << input_buttons;
+ write_ack(ss.str());
+}
+
+static void cmd_status_json(const std::string& line, std::istringstream&, const std::string&)
+{
+ // One JSON object on the ack's first line, for dashboards; cycle=/seq= follow it.
+ static const char* const history_names[] = { "off", "record", "seek", "scan", "land" };
+ auto b = [](bool v) { return v ? "true" : "false"; };
+ const double emu_fps = MDFNGameInfo ? MDFNGameInfo->fps / (65536.0 * 256) : 0;
+ char buf[256];
+ std::string js = "{\"frame\":" + std::to_string(frame_counter) + ",\"cycle\":" + std::to_string(get_cycle());
+
+ js += std::string(",\"paused\":") + b(frames_to_advance == 0 || instruction_paused || watchpoint_paused || read_watchpoint_paused || exception_paused || m68k_paused);
+ js += std::string(",\"pause\":{\"frame\":") + b(frames_to_advance == 0) + ",\"instruction\":" + b(instruction_paused)
+     + ",\"watchpoint\":" + b(watchpoint_paused) + ",\"read_watchpoint\":" + b(read_watchpoint_paused)
+     + ",\"exception\":" + b(exception_paused) + ",\"m68k\":" + b(m68k_paused) + "}";
+ snprintf(buf, sizeof(buf), ",\"host_fps\":%.2f,\"emu_fps\":%.4f,\"speed\":%.4f", host_fps, emu_fps, emu_fps > 0 ? host_fps / emu_fps : 0.0);
+ js += buf;
+ js += std::string(",\"headless\":") + b(headless) + ",\"turbo\":" + b(turbo) + ",\"transport\":\"" + (acks_to_socket ? "socket" : "file")
+     + "\",\"subscribed\":" + b(sock_subscribed) + ",\"vdp2_preview\":" + b(MDFN_IEN_SS::Automation_VDP2PreviewIsActive());
+
+ js += std::string(",\"hooks\":{\"master\":") + b(cpu_hook_active[0]) + ",\"slave\":" + b(cpu_hook_active[1])
+     + ",\"pc_trace\":" + b(pc_trace_active) + ",\"run_until\":" + b(run_until_active)
+     + ",\"journal\":" + b(journal_playing) + ",\"history\":\"" + history_names[history_mode] + "\""
+     + ",\"perf_stats\":" + b(MDFN_IEN_SS::Automation_PerfStatsIsActive()) + "}";
+
+ js += ",\"counts\":{\"breakpoints\":" + std::to_string(breakpoints.size())
+     + ",\"slave_breakpoints\":" + std::to_string(slave_breakpoints.size())
+     + ",\"watchpoints\":" + std::to_string(watchpoints.size())
+     + ",\"poke_triggers\":" + std::to_string(poke_triggers.size())
+     + ",\"func_hooks\":" + std::to_string(func_hooks.size())
+     + ",\"script_rules\":" + std::to_string(script_rules.size()) + "}";
+
+ // Async writers: bytes queued so far (before any zlib) and records dropped on a full ring.
+ std::string writers;
+ auto ring = [&](const char* name, const MDFN_IEN_SS::TraceRing* r) {
+  if (!r)
+   return;
+  snprintf(buf, sizeof(buf), "%s\"%s\":{\"bytes\":%llu,\"dropped\":%llu}", writers.empty() ? "" : ",", name,
+   (unsigned long long)r->Position(), (unsigned long long)r->Dropped());
+  writers += buf;
+ };
+ ring("pc_trace", pc_trace_ring);
+ ring("mem_sample", mem_sample_ring);
+ ring("capture_plan", capture_ring);
+ ring("func_hook_log", func_hook_ring);
+ if (frame_dump) {
+  snprintf(buf, sizeof(buf), "%s\"frame_dump\":{\"frames\":%llu,\"stalls\":%llu}", writers.empty() ? "" : ",",
+   (unsigned long long)frame_dump->Submitted(), (unsigned long long)frame_dump->Stalls());
+  writers += buf;
+ }
+ const std::string ss_writers = MDFN_IEN_SS::Automation_TraceWritersJSON();
+ if (!ss_writers.empty())
+  writers += (writers.empty() ? "" : ",") + ss_writers;
+ js += ",\"writers\":{" + writers + "}";
+
+ js += ",\"perf\":" + MDFN_IEN_SS::Automation_PerfStatsJSON() + "}";
+ write_ack("status_json " + js);
+}
+
+static void cmd_read_mem(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // Socket-only inline binary read: read_mem <addr> <size> [<addr> <size> ...]
+ // One binary frame holding every range back to back, then a text ack.
+ if (!acks_to_socket) {
+  write_ack("error read_mem: requires the socket transport (use dump_mem_bin)");
+  return;
+ }
+ std::vector<std::pair<uint32_t, uint32_t>> ranges;
+ uint64_t total = 0;
+ uint32_t addr, size;
+ while (iss >> std::hex >> addr >> size) {
+  ranges.push_back(std::make_pair(addr, size));
+  total += size;
+ }
+ if (ranges.empty()) {
+  write_ack("error read_mem: usage read_mem <addr> <size> [<addr> <size> ...]");
+  return;
+ }
+ if (total > 0x1000000) {
+  write_ack("error read_mem: total size exceeds 16MB");
+  return;
+ }
+ std::vector<uint8_t> buf((size_t)total);
+ size_t off = 0;
+ for (const auto& r : ranges) {
+  if (r.second)
+   MDFN_IEN_SS::Automation_ReadMemBlock(r.first, &buf[off], r.second);
+  off += r.second;
+ }
+ if (!write_bin_frame(buf.data(), buf.size()))
+  return;  // client went away
+ char msg[96];
+ snprintf(msg, sizeof(msg), "ok read_mem ranges=%zu bytes=%llu",
+          ranges.size(), (unsigned long long)total);
+ write_ack(msg);
+}
+
+static void cmd_read_regs(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // Socket-only inline register read: read_regs [master|slave|both]
+ // Binary frame of 22 uint32s per CPU (dump_regs_bin layout, host byte order).
+ if (!acks_to_socket) {
+  write_ack("error read_regs: requires the socket transport (use dump_regs_bin)");
+  return;
+ }
+ std::string which = "master";
+ iss >> which;
+ uint32_t regs[44];
+ unsigned n;
+ if (which == "master") { MDFN_IEN_SS::Automation_GetRegs(0, regs); n = 22; }
+ else if (which == "slave") { MDFN_IEN_SS::Automation_GetRegs(1, regs); n = 22; }
+ else if (which == "both") {
+  MDFN_IEN_SS::Automation_GetRegs(0, regs);
+  MDFN_IEN_SS::Automation_GetRegs(1, regs + 22);
+  n = 44;
+ }
+ else {
+  write_ack("error read_regs: expected master, slave or both");
+  return;
+ }
+ if (!write_bin_frame(regs, n * sizeof(uint32_t)))
+  return;
+ write_ack("ok read_regs " + which);
+}
+
+static void cmd_dump_regs_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error dump_regs_bin: no path");
+ } else {
+  MDFN_IEN_SS::Automation_DumpRegsBin(path.c_str());
+  write_ack("ok dump_regs_bin " + path);
+ }
+}
+
+static void cmd_dump_slave_regs(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack(MDFN_IEN_SS::Automation_DumpSlaveRegs());
+}
+
+static void cmd_call_stack(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t scan = 0x400;  // default 1024 bytes
+ iss >> std::hex >> scan;
+ if (scan > 0x1000) scan = 0x1000;
+ write_ack(MDFN_IEN_SS::Automation_CallStack(scan));
+}
+
+static void cmd_dump_slave_regs_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error dump_slave_regs_bin: no path");
+ } else {
+  MDFN_IEN_SS::Automation_DumpSlaveRegsBin(path.c_str());
+  write_ack("ok dump_slave_regs_bin " + path);
+ }
+}
+
+static void cmd_poke(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // Write bytes to memory. Usage: poke <addr_hex> <byte_hex> [byte_hex ...]
+ uint32_t addr = 0;
+ iss >> std::hex >> addr;
+ int count = 0;
+ uint32_t val;
+ std::vector<uint8_t> bytes;
+ while (iss >> std::hex >> val) {
+  bytes.push_back((uint8_t)val);
+  count++;
+ }
+ MDFN_IEN_SS::Automation_WriteMemBlock(addr, bytes.data(), bytes.size());
+ journal_poke(addr, bytes.data(), bytes.size());
+ history_event(HistEv_Poke, addr, bytes.data(), bytes.size());
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok poke 0x%08X %d bytes", addr, count);
+ write_ack(buf);
+}
+
+static void cmd_write_mem_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // write_mem_bin <addr_hex> <path> | hex:<bytes>
+ uint32_t addr = 0;
+ std::string src;
+ std::vector<uint8_t> data;
+ iss >> std::hex >> addr >> src;
+ if (src.empty()) {
+  write_ack("error write_mem_bin: usage: write_mem_bin <addr_hex> <path|hex:bytes>");
+  return;
+ }
+ if (src.compare(0, 4, "hex:") == 0) {
+  bool bad = (src.size() & 1) != 0;
+  for (size_t i = 4; i + 1 < src.size() && !bad; i += 2) {
+   char hex[3] = { src[i], src[i + 1], 0 };
+   char* end = nullptr;
+   data.push_back((uint8_t)strtoul(hex, &end, 16));
+   bad = *end != 0;
+  }
+  if (bad || data.empty()) {
+   write_ack("error write_mem_bin: bad hex data");
+   return;
+  }
+ } else {
+  FILE* f = fopen(src.c_str(), "rb");
+  if (!f) {
+   write_ack("error write_mem_bin: cannot open " + src);
+   return;
+  }
+  fseek(f, 0, SEEK_END);
+  const long fsize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (fsize <= 0 || fsize > 0x1000000) {
+   fclose(f);
+   write_ack("error write_mem_bin: file must be 1 byte to 16MB");
+   return;
+  }
+  data.resize(fsize);
+  data.resize(fread(data.data(), 1, data.size(), f));
+  fclose(f);
+ }
+ const uint32_t written = MDFN_IEN_SS::Automation_WriteMemBlock(addr, data.data(), data.size());
+ journal_poke(addr, data.data(), data.size());
+ history_event(HistEv_Poke, addr, data.data(), data.size());
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok write_mem_bin 0x%08X bytes=%zu written=%u", addr, data.size(), written);
+ write_ack(buf);
+}
+
+static void cmd_dump_mem_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t addr = 0, size = 0;
+ std::string path;
+ iss >> std::hex >> addr >> size >> path;
+ if (path.empty() || size == 0) {
+  write_ack("error dump_mem_bin: need addr size path");
+ } else {
+  if (size > 0x100000) size = 0x100000;
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f) {
+   for (uint32_t i = 0; i < size; i++) {
+    uint8_t b = MDFN_IEN_SS::Automation_ReadMem8(addr + i);
+    fwrite(&b, 1, 1, f);
+   }
+   fclose(f);
+   char ack_msg[128];
+   snprintf(ack_msg, sizeof(ack_msg), "ok dump_mem_bin 0x%08X 0x%X", addr, size);
+   write_ack(ack_msg);
+  } else {
+   write_ack("error dump_mem_bin: cannot open " + path);
+  }
+ }
+}
+
+static void cmd_dump_region(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // Convenience command: dump named memory region to binary file.
+ // Usage: dump_region <name> <path> [cached]
+ // Regions: wram_high (1MB), wram_low (1MB), vdp1_vram (512KB),
+ //          vdp2_vram (512KB), vdp2_cram (4KB), sound_ram (512KB)
+ std::string name, path, mode;
+ iss >> name >> path >> mode;
+ if (name.empty() || path.empty() || (!mode.empty() && mode != "cached")) {
+  write_ack("error dump_region: usage: dump_region <name> <path> [cached]");
+ } else {
   uint32_t addr = 0, size = 0;
-  std::string path;
-  iss >> std::hex >> addr >> size >> path;
-  if (path.empty() || size == 0) {
-   write_ack("error dump_mem_bin: need addr size path");
+  if (name == "wram_high")      { addr = 0x06000000; size = 0x100000; }
+  else if (name == "wram_low")  { addr = 0x00200000; size = 0x100000; }
+  else if (name == "vdp1_vram") { addr = 0x05C00000; size = 0x080000; }
+  else if (name == "vdp2_vram") { addr = 0x05E00000; size = 0x080000; }
+  else if (name == "vdp2_cram") { addr = 0x05F00000; size = 0x001000; }
+  else if (name == "sound_ram") { addr = 0x05A00000; size = 0x080000; }
+  else {
+   write_ack("error dump_region: unknown region '" + name +
+    "' (valid: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram)");
+   return;
+  }
+  std::vector<uint8_t> buf(size);
+  if (mode == "cached")
+   MDFN_IEN_SS::Automation_ReadMemBlockCoherent(addr, buf.data(), size);
+  else
+   MDFN_IEN_SS::Automation_ReadMemBlock(addr, buf.data(), size);
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f) {
+   fwrite(buf.data(), 1, size, f);
+   fclose(f);
+   char ack_msg[128];
+   snprintf(ack_msg, sizeof(ack_msg), "ok dump_region %s 0x%08X 0x%X %s",
+    name.c_str(), addr, size, path.c_str());
+   write_ack(ack_msg);
+  } else {
+   write_ack("error dump_region: cannot open " + path);
+  }
+ }
+}
+
+static void cmd_vram_delta(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // File: "MDFNVRD1" once, then per call le64 frame, le64 master cycle, le32
+ // run count n, and n runs of u8 region (0 vdp1_vram, 1 vdp2_vram, 2
+ // vdp2_cram), u8 0, le16 0, le32 offset, le32 length, then the bytes in
+ // dump_region order. A run is consecutive 32-byte blocks written since the
+ // previous call (after power-up or a state load: all of them).
+ static const struct { const char* name; uint32_t addr, size; } vd_regions[] = {
+  { "vdp1_vram", 0x05C00000, 0x080000 },
+  { "vdp2_vram", 0x05E00000, 0x080000 },
+  { "vdp2_cram", 0x05F00000, 0x001000 },
+ };
+ std::string path, tok;
+ bool append = false, full = false, bad = false;
+ unsigned mask = 0;
+ iss >> path;
+ while (iss >> tok) {
+  if (tok == "append")
+   append = true;
+  else if (tok == "full")
+   full = true;
+  else {
+   unsigned r = 0;
+   while (r < 3 && tok != vd_regions[r].name)
+    r++;
+   if (r == 3)
+    bad = true;
+   mask |= 1U << r;
+  }
+ }
+ FILE* f = (path.empty() || bad) ? nullptr : fopen(path.c_str(), append ? "ab" : "wb");
+ if (path.empty() || bad) {
+  write_ack("error vram_delta: usage: vram_delta <path> [append] [full] [vdp1_vram] [vdp2_vram] [vdp2_cram]");
+ } else if (!f) {
+  write_ack("error vram_delta: cannot open " + path);
+ } else {
+  std::vector<uint8_t> out(20);
+  uint32_t runs = 0, bytes = 0;
+  if (!mask)
+   mask = 7;
+  for (unsigned r = 0; r < 3; r++) {
+   if (!(mask & (1U << r)))
+    continue;
+   uint64_t bits[256];
+   const uint32_t nblocks = MDFN_IEN_SS::Automation_TakeVideoDirty(r, bits) * 64;
+   uint32_t b = 0;
+   while (b < nblocks) {
+    if (!full && !((bits[b >> 6] >> (b & 63)) & 1)) {
+     b++;
+     continue;
+    }
+    const uint32_t start = b;
+    while (b < nblocks && (full || ((bits[b >> 6] >> (b & 63)) & 1)))
+     b++;
+    const uint32_t off = start * 32, len = (b - start) * 32;
+    const size_t pos = out.size();
+    out.resize(pos + 12 + len);
+    out[pos] = r;
+    out[pos + 1] = 0;
+    MDFN_en16lsb(&out[pos + 2], 0);
+    MDFN_en32lsb(&out[pos + 4], off);
+    MDFN_en32lsb(&out[pos + 8], len);
+    MDFN_IEN_SS::Automation_ReadMemBlock(vd_regions[r].addr + off, &out[pos + 12], len);
+    runs++;
+    bytes += len;
+   }
+  }
+  MDFN_en64lsb(&out[0], frame_counter);
+  MDFN_en64lsb(&out[8], get_cycle());
+  MDFN_en32lsb(&out[16], runs);
+  fseek(f, 0, SEEK_END);
+  if (ftell(f) == 0)
+   fwrite("MDFNVRD1", 1, 8, f);
+  fwrite(out.data(), 1, out.size(), f);
+  fclose(f);
+  write_ack("ok vram_delta frame=" + std::to_string(frame_counter) + " runs=" + std::to_string(runs) + " bytes=" + std::to_string(bytes));
+ }
+}
+
+static void cmd_scan_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned size = 0;
+ std::string tok;
+ std::vector<ScanRegion> regions;
+ iss >> size;
+ if (size != 1 && size != 2 && size != 4) {
+  write_ack("error scan_start: usage: scan_start <1|2|4> [region ...]");
+  return;
+ }
+ while (iss >> tok) {
+  bool found = false;
+  for (const auto& t : shm_region_table) {
+   if (tok == t.name) {
+    regions.push_back({ t.addr, t.size, {}, {} });
+    found = true;
+   }
+  }
+  if (!found) {
+   write_ack("error scan_start: unknown region '" + tok +
+    "' (valid: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram)");
+   return;
+  }
+ }
+ if (regions.empty()) {
+  regions.push_back({ shm_region_table[0].addr, shm_region_table[0].size, {}, {} });
+  regions.push_back({ shm_region_table[1].addr, shm_region_table[1].size, {}, {} });
+ }
+ scan_size = size;
+ scan_count = 0;
+ for (ScanRegion& r : regions) {
+  const uint32_t slots = r.size / size;
+  r.last.resize(r.size);
+  MDFN_IEN_SS::Automation_ReadMemBlock(r.addr, r.last.data(), r.size);
+  r.live.assign((slots + 63) / 64, ~(uint64_t)0);
+  if (slots & 63)
+   r.live.back() = ((uint64_t)1 << (slots & 63)) - 1;
+  scan_count += slots;
+ }
+ scan_regions.swap(regions);
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok scan_start size=%u regions=%zu count=%llu",
+  scan_size, scan_regions.size(), (unsigned long long)scan_count);
+ write_ack(buf);
+}
+
+static void cmd_scan_filter(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string op, val;
+ iss >> op >> val;
+ ScanOp sop;
+ if (op == "eq" || op == "unchanged") sop = Scan_EQ;
+ else if (op == "ne" || op == "changed") sop = Scan_NE;
+ else if (op == "gt") sop = Scan_GT;
+ else if (op == "lt") sop = Scan_LT;
+ else if (op == "delta") sop = Scan_Delta;
+ else {
+  write_ack("error scan_filter: usage: scan_filter eq|ne|gt|lt [N] | changed | unchanged | delta N");
+  return;
+ }
+ char* end = nullptr;
+ const uint32_t operand = (uint32_t)strtoll(val.c_str(), &end, 0);
+ if (!scan_size) {
+  write_ack("error scan_filter: no scan (use scan_start)");
+ } else if ((!val.empty() && (*end || op == "changed" || op == "unchanged")) || (val.empty() && sop == Scan_Delta)) {
+  write_ack("error scan_filter: usage: scan_filter eq|ne|gt|lt [N] | changed | unchanged | delta N");
+ } else {
+  const uint32_t mask = (scan_size == 4) ? 0xFFFFFFFF : ((1U << (scan_size * 8)) - 1);
+  scan_filter(sop, val.empty(), operand & mask);
+  char buf[128];
+  snprintf(buf, sizeof(buf), "ok scan_filter %s count=%llu", op.c_str(), (unsigned long long)scan_count);
+  write_ack(buf);
+ }
+}
+
+static void cmd_scan_list(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint64_t max = 100;
+ iss >> max;
+ if (!scan_size) {
+  write_ack("error scan_list: no scan (use scan_start)");
+  return;
+ }
+ std::ostringstream ss;
+ uint64_t shown = 0;
+ ss << "scan count=" << scan_count << " shown=" << std::min<uint64_t>(max, scan_count);
+ for (const ScanRegion& r : scan_regions) {
+  for (size_t wi = 0; wi < r.live.size() && shown < max; wi++) {
+   for (uint64_t m = r.live[wi]; m && shown < max; m &= m - 1, shown++) {
+    const uint32_t off = (wi * 64 + __builtin_ctzll(m)) * scan_size;
+    uint32_t v = 0;
+    for (unsigned i = 0; i < scan_size; i++)
+     v = (v << 8) | r.last[off + i];
+    char buf[32];
+    snprintf(buf, sizeof(buf), " 0x%08X=0x%0*X", r.addr + off, scan_size * 2, v);
+    ss << buf;
+   }
+  }
+ }
+ write_ack(ss.str());
+}
+
+static void cmd_scan_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ std::vector<ScanRegion>().swap(scan_regions);
+ std::vector<uint8_t>().swap(scan_cur);
+ scan_size = 0;
+ scan_count = 0;
+ write_ack("ok scan_stop");
+}
+
+static void cmd_mem_snapshot(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // mem_snapshot <name> [region ...]  (default: wram_high wram_low)
+ std::string name, tok;
+ std::vector<MemSnapRegion> regions;
+ iss >> name;
+ if (name.empty() || name == "live") {
+  write_ack("error mem_snapshot: usage: mem_snapshot <name> [region ...] (\"live\" is reserved)");
+  return;
+ }
+ while (iss >> tok) {
+  bool found = false;
+  for (const auto& t : shm_region_table) {
+   if (tok == t.name) {
+    regions.push_back({ t.addr, t.size, {} });
+    found = true;
+   }
+  }
+  if (!found) {
+   write_ack("error mem_snapshot: unknown region '" + tok +
+    "' (valid: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram)");
+   return;
+  }
+ }
+ if (regions.empty()) {
+  regions.push_back({ shm_region_table[0].addr, shm_region_table[0].size, {} });
+  regions.push_back({ shm_region_table[1].addr, shm_region_table[1].size, {} });
+ }
+ uint64_t bytes = 0;
+ for (MemSnapRegion& r : regions) {
+  r.data.resize(r.size);
+  MDFN_IEN_SS::Automation_ReadMemBlock(r.addr, r.data.data(), r.size);
+  bytes += r.size;
+ }
+ mem_snapshots[name].swap(regions);
+ write_ack("ok mem_snapshot " + name + " regions=" + std::to_string(mem_snapshots[name].size()) + " bytes=" + std::to_string(bytes));
+}
+
+static void cmd_mem_snapshot_free(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string name;
+ iss >> name;
+ if (name == "all")
+  mem_snapshots.clear();
+ else if (!mem_snapshots.erase(name)) {
+  write_ack("error mem_snapshot_free: no snapshot '" + name + "'");
+  return;
+ }
+ write_ack("ok mem_snapshot_free " + name);
+}
+
+static void cmd_mem_diff(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // mem_diff <a> <b|live> [max=N] [bytes=N]
+ std::string na, nb, tok;
+ uint64_t max = 100, show = 16;
+ iss >> na >> nb;
+ while (iss >> tok) {
+  if (tok.compare(0, 4, "max=") == 0)
+   max = strtoull(tok.c_str() + 4, nullptr, 10);
+  else if (tok.compare(0, 6, "bytes=") == 0)
+   show = std::max<uint64_t>(1, strtoull(tok.c_str() + 6, nullptr, 10));
+ }
+ auto ia = mem_snapshots.find(na);
+ auto ib = mem_snapshots.find(nb);
+ if (ia == mem_snapshots.end() || (nb != "live" && ib == mem_snapshots.end())) {
+  write_ack("error mem_diff: usage: mem_diff <snapshot> <snapshot|live> [max=N] [bytes=N] (no snapshot '"
+            + (ia == mem_snapshots.end() ? na : nb) + "')");
+  return;
+ }
+ // Regions of a that b also has; "live" reads them now.
+ std::vector<MemSnapRegion> live;
+ std::vector<MemDiffRange> ranges;
+ uint64_t changed = 0;
+ unsigned compared = 0;
+ if (nb == "live") {
+  for (const MemSnapRegion& r : ia->second) {
+   live.push_back({ r.addr, r.size, std::vector<uint8_t>(r.size) });
+   MDFN_IEN_SS::Automation_ReadMemBlock(r.addr, live.back().data.data(), r.size);
+  }
+ }
+ const std::vector<MemSnapRegion>& rb = nb == "live" ? live : ib->second;
+ for (const MemSnapRegion& r : ia->second) {
+  for (const MemSnapRegion& s : rb) {
+   if (s.addr == r.addr && s.size == r.size) {
+    changed += mem_diff_region(r.addr, r.data.data(), s.data.data(), r.size, ranges);
+    compared++;
+   }
+  }
+ }
+ std::ostringstream ss;
+ ss << "ok mem_diff " << na << " " << nb << " regions=" << compared << " ranges=" << ranges.size()
+    << " bytes=" << changed << " shown=" << std::min<uint64_t>(max, ranges.size());
+ for (size_t i = 0; i < ranges.size() && i < max; i++) {
+  const MemDiffRange& d = ranges[i];
+  const uint32_t n = std::min<uint64_t>(d.len, show);
+  char buf[32];
+  snprintf(buf, sizeof(buf), " 0x%08X:%u", d.addr, d.len);
+  ss << buf << " old=";
+  for (uint32_t j = 0; j < n; j++) { snprintf(buf, sizeof(buf), "%02X", d.a[j]); ss << buf; }
+  ss << (n < d.len ? "... new=" : " new=");
+  for (uint32_t j = 0; j < n; j++) { snprintf(buf, sizeof(buf), "%02X", d.b[j]); ss << buf; }
+  if (n < d.len)
+   ss << "...";
+ }
+ write_ack(ss.str());
+}
+
+static void cmd_shm_expose(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // shm_expose <path> [every=N] [region ...]  (default: all regions)
+ std::string path, tok;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error shm_expose: usage shm_expose <path> [every=N] [region ...]");
+  return;
+ }
+ int64_t period = 1;
+ std::vector<int> which;
+ while (iss >> tok) {
+  if (tok.compare(0, 6, "every=") == 0) {
+   period = atoll(tok.c_str() + 6);
+   if (period < 1) period = 1;
+   continue;
+  }
+  int found = -1;
+  for (size_t i = 0; i < sizeof(shm_region_table) / sizeof(shm_region_table[0]); i++)
+   if (tok == shm_region_table[i].name) found = (int)i;
+  if (found < 0) {
+   write_ack("error shm_expose: unknown region '" + tok + "'");
+   return;
+  }
+  if (std::find(which.begin(), which.end(), found) == which.end())  // each region once
+   which.push_back(found);
+ }
+ if (which.empty())
+  for (size_t i = 0; i < sizeof(shm_region_table) / sizeof(shm_region_table[0]); i++)
+   which.push_back((int)i);
+ std::string err;
+ if (!shm_open_regions(path, which, err)) {
+  write_ack("error shm_expose: " + err);
+  return;
+ }
+ shm_period = period;
+ shm_update(frame_counter);
+ char buf[160];
+ snprintf(buf, sizeof(buf), "ok shm_expose %s regions=%zu bytes=%zu every=%lld",
+          path.c_str(), which.size(), shm_map.size, (long long)period);
+ write_ack(buf);
+}
+
+static void cmd_shm_sync(const std::string&, std::istringstream&, const std::string&)
+{
+ // Refresh now, e.g. while paused at a breakpoint mid-frame.
+ if (!shm_base) {
+  write_ack("error shm_sync: shm_expose not active");
+  return;
+ }
+ shm_update(frame_counter);
+ write_ack("ok shm_sync seq=" + std::to_string(((ShmHeader*)shm_base)->seq));
+}
+
+static void cmd_shm_close(const std::string&, std::istringstream&, const std::string&)
+{
+ shm_close();
+ write_ack("ok shm_close");
+}
+
+static void cmd_obs_expose(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // obs_expose <path> [w=80] [h=60] [gray|rgb] [every=N]
+ std::string path, tok;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error obs_expose: usage obs_expose <path> [w=N] [h=N] [gray|rgb] [every=N]");
+  return;
+ }
+ long width = 80, height = 60;
+ int64_t period = 1;
+ uint32_t channels = 1;
+ while (iss >> tok) {
+  if (tok.compare(0, 2, "w=") == 0)
+   width = atol(tok.c_str() + 2);
+  else if (tok.compare(0, 2, "h=") == 0)
+   height = atol(tok.c_str() + 2);
+  else if (tok.compare(0, 6, "every=") == 0)
+   period = std::max<int64_t>(1, atoll(tok.c_str() + 6));
+  else if (tok == "gray")
+   channels = 1;
+  else if (tok == "rgb")
+   channels = 3;
+  else {
+   write_ack("error obs_expose: unknown option '" + tok + "'");
+   return;
+  }
+ }
+ if (width < 1 || width > 1024 || height < 1 || height > 1024) {
+  write_ack("error obs_expose: w and h must be 1-1024");
+  return;
+ }
+ std::string err;
+ if (!obs_open(path, width, height, channels, err)) {
+  write_ack("error obs_expose: " + err);
+  return;
+ }
+ obs_period = period;
+ if (live_fb_surface)
+  obs_update(live_fb_surface, *live_fb_rect, live_fb_lw, frame_counter);
+ char buf[160];
+ snprintf(buf, sizeof(buf), "ok obs_expose %s %ldx%ld %s bytes=%zu every=%lld",
+          path.c_str(), width, height, channels == 1 ? "gray" : "rgb", obs_map.size, (long long)period);
+ write_ack(buf);
+}
+
+static void cmd_obs_close(const std::string&, std::istringstream&, const std::string&)
+{
+ obs_close();
+ write_ack("ok obs_close");
+}
+
+static void cmd_dump_vdp2_regs(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error dump_vdp2_regs: no path");
+ } else {
+  MDFN_IEN_SS::Automation_DumpVDP2RegsBin(path.c_str());
+  write_ack("ok dump_vdp2_regs " + path);
+ }
+}
+
+// dump_vdp1_fb png=: one FrameDump encoder thread, started on first use, so the
+// PNG is compressed off the emulation thread.
+static FrameDump* vdp1_fb_png = nullptr;
+
+static void cmd_dump_vdp1_fb(const CmdArgs& args)
+{
+ const std::string& which = args.s("which");
+ const std::string& path = args.s("path");
+ if (which != "draw" && which != "display") {
+  write_ack("error dump_vdp1_fb: expected draw or display, got " + which);
+  return;
+ }
+
+ std::vector<uint16> fb(0x20000);
+ uint8 tvmr;
+ MDFN_IEN_SS::Automation_VDP1ReadFB(which == "display", fb.data(), &tvmr);
+
+ std::vector<uint8> raw(fb.size() * 2);
+ for (size_t i = 0; i < fb.size(); i++)
+  MDFN_en16msb(&raw[i * 2], fb[i]);
+
+ FILE* fp = fopen(path.c_str(), "wb");
+ bool ok = fp && fwrite(raw.data(), 1, raw.size(), fp) == raw.size();
+ if (fp && fclose(fp))
+  ok = false;
+ if (!ok) {
+  write_ack("error dump_vdp1_fb: cannot write " + path);
+  return;
+ }
+
+ // TVMR bit 0: 8bpp, bit 1: rotation; 8bpp rotation is 512x512, lines 256-511 in the
+ // second half of each 1024-byte line.
+ const bool bpp8 = tvmr & 0x1, rotate = tvmr & 0x2;
+ const int32 w = (bpp8 && !rotate) ? 1024 : 512, h = (bpp8 && rotate) ? 512 : 256;
+ char buf[128];
+ snprintf(buf, sizeof(buf), " %dx%d bpp=%d rotate=%d tvmr=0x%02X", (int)w, (int)h, bpp8 ? 8 : 16, (int)rotate, tvmr);
+ std::string msg = "ok dump_vdp1_fb " + which + " " + path + buf;
+
+ if (args.has("png")) {
+  const std::string& png_path = args.s("png");
+  std::string err;
+
+  // An encoder error shows up on the next dump_vdp1_fb png=.
+  if (vdp1_fb_png && !(err = vdp1_fb_png->Error()).empty()) {
+   delete vdp1_fb_png;
+   vdp1_fb_png = nullptr;
+   msg += " last_png_error=\"" + err + "\"";
+  }
+  if (!vdp1_fb_png && !(vdp1_fb_png = FrameDump::Open(std::string(), FrameDump::FMT_PNG, false, 1, &err))) {
+   write_ack("error dump_vdp1_fb: " + err);
+   return;
+  }
+
+  // RGB words as they are, palette words and 8bpp codes as gray levels of their low byte.
+  MDFN_Surface surf(NULL, w, h, w, MDFN_PixelFormat(MDFN_PixelFormat::ABGR32_8888));
+  MDFN_Rect rect;
+  rect.x = rect.y = 0;
+  rect.w = w;
+  rect.h = h;
+  for (int32 y = 0; y < h; y++) {
+   uint32* line = surf.pixels + (size_t)y * w;
+   for (int32 x = 0; x < w; x++) {
+    if (bpp8) {
+     const uint8 c = raw[(size_t)(y & 0xFF) * 1024 + ((y & 0x100) << 1) + x];
+     line[x] = surf.format.MakeColor(c, c, c);
+    } else {
+     const uint16 v = fb[(size_t)y * 512 + x];
+     if (v & 0x8000)
+      line[x] = surf.format.MakeColor((v & 0x1F) << 3, ((v >> 5) & 0x1F) << 3, ((v >> 10) & 0x1F) << 3);
+     else
+      line[x] = surf.format.MakeColor(v & 0xFF, v & 0xFF, v & 0xFF);
+    }
+   }
+  }
+  vdp1_fb_png->Submit(frame_counter, &surf, rect, nullptr, png_path);
+  msg += " png=" + png_path;
+ }
+ write_ack(msg);
+}
+
+static void cmd_save_state(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error save_state: no path");
+ } else {
+  try {
+   // Match MDFNI_SaveState: SaveSM to memory now, then gzip to <path>.tmp and
+   // rename it over <path> in the background. "ok" means the state is taken;
+   // "done save_state" (or an error) follows once the file is complete.
+   std::unique_ptr<MemoryStream> ms(new MemoryStream(65536));
+   MDFNSS_SaveSM(ms.get());
+   load_state_forget();
+   MDFNSS_WriteAsync(std::move(ms), path, 6, [](const std::string& p, const std::string& error) {
+    if (error.empty())
+     write_ack("done save_state " + p);
+    else
+     write_ack("error save_state: " + error);
+   });
+   write_ack("ok save_state " + path);
+  } catch (std::exception& e) {
+   write_ack(std::string("error save_state: ") + e.what());
+  }
+ }
+}
+
+static void cmd_save_state_raw(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error save_state_raw: no path");
+ } else {
+  try {
+   MDFNSS_SaveRaw(path);
+   struct stat sb;
+   const long long bytes = (stat(path.c_str(), &sb) == 0) ? (long long)sb.st_size : -1;
+   write_ack("ok save_state_raw " + path + " bytes=" + std::to_string(bytes));
+  } catch (std::exception& e) {
+   write_ack(std::string("error save_state_raw: ") + e.what());
+  }
+ }
+}
+
+static void cmd_load_state(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error load_state: no path");
+ } else {
+  try {
+   load_state_file(path);
+   frame_counter = 0;  // Reset to 0 — all frame references are relative to save state load
+   journal_state();
+   history_clear();
+   write_ack("ok load_state " + path);
+  } catch (std::exception& e) {
+   write_ack(std::string("error load_state: ") + e.what());
+  }
+ }
+}
+
+static void cmd_movie_record(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ int64_t keyframes = -1;
+ while (iss >> tok) {
+  if (tok.compare(0, 10, "keyframes=") == 0)
+   keyframes = strtoll(tok.c_str() + 10, nullptr, 0);
+  else
+   path = tok;
+ }
+ if (path.empty() || keyframes < -1) {
+  write_ack("error movie_record: usage: movie_record <path> [keyframes=N]");
+  return;
+ }
+ if (Mednafen::MDFNMOV_IsPlaying() || Mednafen::MDFNMOV_IsRecording()) {
+  write_ack("error movie_record: a movie is active (movie_stop first)");
+  return;
+ }
+ if (keyframes >= 0)
+  MDFNI_SetSettingUI("movie.keyframe_interval", keyframes);
+ MDFNI_SaveMovie(&path[0], nullptr, nullptr, nullptr);
+ if (!Mednafen::MDFNMOV_IsRecording())
+  write_ack("error movie_record: cannot record " + path);
+ else
+  write_ack("ok movie_record " + path + " keyframes=" + std::to_string(MDFN_GetSettingUI("movie.keyframe_interval")));
+}
+
+static void cmd_movie_play(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error movie_play: usage: movie_play <path>");
+  return;
+ }
+ if (Mednafen::MDFNMOV_IsPlaying() || Mednafen::MDFNMOV_IsRecording()) {
+  write_ack("error movie_play: a movie is active (movie_stop first)");
+  return;
+ }
+ MDFNI_LoadMovie(&path[0]);
+ if (!Mednafen::MDFNMOV_IsPlaying()) {
+  write_ack("error movie_play: cannot play " + path);
+  return;
+ }
+ frame_counter = 0;
+ journal_state();
+ history_clear();
+ write_ack("ok movie_play " + path + " keyframes=" + std::to_string(MDFNI_MovieKeyframes()));
+}
+
+static void cmd_movie_seek(const std::string&, std::istringstream& iss, const std::string&)
+{
+ int64_t frame = -1;
+ uint64 from = 0;
+ iss >> frame;
+ if (frame < 0) {
+  write_ack("error movie_seek: usage: movie_seek <frame>");
+  return;
+ }
+ try {
+  const uint64 before = MDFNI_MovieFrame();
+  const uint64 replay = MDFNI_SeekMovie(frame, &from);
+  if (from != before) {
+   frame_counter = from;
+   history_clear();
+  }
+  if (replay) {
+   // Replay the remaining frames the way frame_advance runs them.
+   run_until_stop();
+   run_to_line_cancel();
+   step_return_cancel();
+   bench_cancel();
+   frames_to_advance = replay;
+   instruction_paused = false;
+   watchpoint_paused = false;
+   read_watchpoint_paused = false;
+   m68k_paused = false;
+   exception_paused = false;
+   instructions_to_step = -1;
+   slave_instructions_to_step = -1;
+   run_to_cycle_target = -1;
+   update_cpu_hook();
+  }
+  write_ack("ok movie_seek " + std::to_string(frame) + " from=" + std::to_string(from) + " replay=" + std::to_string(replay));
+ } catch (std::exception& e) {
+  write_ack(std::string("error movie_seek: ") + e.what());
+ }
+}
+
+static void cmd_movie_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const uint64 frames = MDFNI_MovieFrame();
+ Mednafen::MDFNMOV_Stop();
+ write_ack("ok movie_stop frames=" + std::to_string(frames));
+}
+
+static void cmd_movie_status(const std::string&, std::istringstream&, const std::string&)
+{
+ const char* mode = Mednafen::MDFNMOV_IsPlaying() ? "playing" : (Mednafen::MDFNMOV_IsRecording() ? "recording" : "stopped");
+ write_ack(std::string("ok movie_status mode=") + mode + " frame=" + std::to_string(MDFNI_MovieFrame()) +
+           " keyframes=" + std::to_string(MDFNI_MovieKeyframes()));
+}
+
+static void cmd_spawn(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string dir, state;
+ iss >> dir;
+ std::getline(iss >> std::ws, state);
+ if (dir.empty()) {
+  write_ack("error spawn: no ipc_dir");
+  return;
+ }
+#ifdef WIN32
+ write_ack("error spawn: not supported on Windows");
+#else
+ const char* blocker = spawn_blocker();
+ if (blocker) {
+  write_ack(std::string("error spawn: ") + blocker);
+  return;
+ }
+ while (waitpid(-1, nullptr, WNOHANG) > 0) { }  // reap children that have exited
+
+ // The child has only this thread: finish and end every other one first.
+ MDFNSS_KillAsync();
+ MDFN_IEN_SS::Automation_SuspendThreads();
+ fflush(NULL);
+ const pid_t pid = fork();
+ MDFN_IEN_SS::Automation_ResumeThreads();
+
+ if (pid < 0)
+  write_ack(std::string("error spawn: fork: ") + strerror(errno));
+ else if (pid == 0)
+  spawn_child_init(dir, state);
+ else
+  write_ack("ok spawn pid=" + std::to_string(pid) + " " + dir);
+#endif
+}
+
+static void cmd_pool_start(const CmdArgs& args)
+{
+#ifdef WIN32
+ write_ack("error pool_start: not supported on Windows");
+#else
+ const uint64_t n = args.u("n");
+ const std::string dir = args.has("dir") ? args.s("dir") : auto_base_dir + "/pool";
+ std::string err;
+ if (n < 1 || n > 256) {
+  write_ack("error pool_start: n must be 1-256");
+  return;
+ }
+ const int r = pool_start(n, dir, args.s("state"), &err);
+ if (r < 0)
+  write_ack("error pool_start: " + err);
+ else if (r > 0)
+  write_ack("ok pool_start size=" + std::to_string(n) + " dir=" + dir + (sock_spec.empty() ? "" : " socket=" + pool_slots[0].sock));
+#endif
+}
+
+static void cmd_pool_acquire(const CmdArgs&)
+{
+#ifdef WIN32
+ write_ack("error pool_acquire: no pool");
+#else
+ if (pool_slots.empty()) {
+  write_ack("error pool_acquire: no pool (pool_start first)");
+  return;
+ }
+ if (!pool_reap())
+  return;
+ for (size_t i = 0; i < pool_slots.size(); i++) {
+  PoolSlot& s = pool_slots[i];
+  if (s.pid > 0 && !s.leased) {
+   s.leased = true;
+   s.leases++;
+   write_ack("ok pool_acquire id=" + std::to_string(i) + " pid=" + std::to_string(s.pid) + " dir=" + s.dir
+    + (s.sock.empty() ? "" : " socket=" + s.sock));
+   return;
+  }
+ }
+ write_ack("error pool_acquire: no free instance");
+#endif
+}
+
+static void cmd_pool_release(const CmdArgs& args)
+{
+#ifdef WIN32
+ write_ack("error pool_release: no pool");
+#else
+ const uint64_t id = args.u("id");
+ std::string err;
+ if (id >= pool_slots.size() || !pool_slots[id].leased) {
+  write_ack("error pool_release: instance " + std::to_string(id) + " is not leased");
+  return;
+ }
+ pool_kill(id);
+ const int r = pool_fork(id, &err);
+ if (r < 0)
+  write_ack("error pool_release: " + err);
+ else if (r > 0)
+  write_ack("ok pool_release id=" + std::to_string(id) + " pid=" + std::to_string(pool_slots[id].pid));
+#endif
+}
+
+static void cmd_pool_status(const CmdArgs&)
+{
+#ifdef WIN32
+ write_ack("ok pool_status size=0");
+#else
+ if (!pool_reap())
+  return;
+ const int64_t now = Time::MonoUS();
+ const uint64_t frames = pool_frames();
+ size_t free_n = 0;
+ for (const PoolSlot& s : pool_slots)
+  free_n += s.pid > 0 && !s.leased;
+ char buf[256];
+ snprintf(buf, sizeof(buf), "ok pool_status size=%zu free=%zu leased=%zu frames=%llu fps=%.1f fps_recent=%.1f uptime=%.1f",
+  pool_slots.size(), free_n, (size_t)std::count_if(pool_slots.begin(), pool_slots.end(), [](const PoolSlot& s) { return s.leased; }),
+  (unsigned long long)frames, now > pool_start_us ? frames * 1e6 / (now - pool_start_us) : 0.0,
+  now > pool_last_us ? (frames - pool_last_frames) * 1e6 / (now - pool_last_us) : 0.0, pool_slots.empty() ? 0.0 : (now - pool_start_us) / 1e6);
+ std::string out = buf;
+ for (size_t i = 0; i < pool_slots.size(); i++) {
+  const PoolSlot& s = pool_slots[i];
+  out += "\n[" + std::to_string(i) + "] pid=" + std::to_string(s.pid) + (s.leased ? " leased" : " free")
+   + " frames=" + std::to_string(pool_shared[i].frames.load(std::memory_order_relaxed)) + " leases=" + std::to_string(s.leases)
+   + " dir=" + s.dir + (s.sock.empty() ? "" : " socket=" + s.sock);
+ }
+ pool_last_us = now;
+ pool_last_frames = frames;
+ write_ack(out);
+#endif
+}
+
+static void cmd_pool_stop(const CmdArgs&)
+{
+#ifndef WIN32
+ const size_t n = pool_slots.size();
+ pool_stop();
+ write_ack("ok pool_stop stopped=" + std::to_string(n));
+#else
+ write_ack("ok pool_stop stopped=0");
+#endif
+}
+
+static void cmd_snap_save(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned slot;
+ std::string base_arg;
+ int base = -1;
+ if (!(iss >> slot) || slot >= Snapshot_MaxSlots) {
+  write_ack("error snap_save: slot must be 0-" + std::to_string(Snapshot_MaxSlots - 1));
+ } else if ((iss >> base_arg) && (sscanf(base_arg.c_str(), "%d", &base) != 1 || base < 0 || (unsigned)base >= snapshots.size() || !snapshots[base].data || snapshots[base].base >= 0 || (unsigned)base == slot)) {
+  write_ack("error snap_save: base must be another slot holding a full snapshot");
+ } else if (snapshot_dependents(slot)) {
+  write_ack("error snap_save: slot " + std::to_string(slot) + " is the base of " + std::to_string(snapshot_dependents(slot)) + " delta(s)");
+ } else {
+  try {
+   if (slot >= snapshots.size())
+    snapshots.resize(slot + 1);
+   Snapshot& snap = snapshots[slot];
+   if (!snap.data)
+    snap.data.reset(new MemoryStream(snapshot_size_hint));
+   snap.data->truncate(0);
+   snap.data->seek(0, SEEK_SET);
+   snap.pages.clear();
+   snap.base = -1;
+
+   if (base >= 0) {
+    const Snapshot& b = snapshots[base];
+    snapshot_scratch.truncate(0);
+    snapshot_scratch.seek(0, SEEK_SET);
+    MDFNSS_SaveSM(&snapshot_scratch, true);
+    snap.size = snapshot_scratch.size();
+    if (snap.size == b.size) {
+     const uint8* cur = snapshot_scratch.map();
+     const uint8* ref = b.data->map();
+     for (uint64_t offs = 0; offs < snap.size; offs += Snapshot_PageSize) {
+      const uint32_t n = (uint32_t)std::min<uint64_t>(Snapshot_PageSize, snap.size - offs);
+      if (memcmp(cur + offs, ref + offs, n)) {
+       snap.pages.push_back(offs / Snapshot_PageSize);
+       snap.data->write(cur + offs, n);
+      }
+     }
+     snap.base = base;
+    } else
+     snap.data->write(snapshot_scratch.map(), snap.size);
+   } else {
+    MDFNSS_SaveSM(snap.data.get(), true);
+    snap.size = snap.data->size();
+   }
+   snap.frame = frame_counter;
+   snapshot_size_hint = std::max<uint64_t>(snapshot_size_hint, snap.data->size());
+   std::string ack = "ok snap_save " + std::to_string(slot) + " bytes=" + std::to_string(snap.data->size());
+   if (snap.base >= 0)
+    ack += " base=" + std::to_string(snap.base) + " pages=" + std::to_string(snap.pages.size()) + "/" + std::to_string((snap.size + Snapshot_PageSize - 1) / Snapshot_PageSize);
+   write_ack(ack);
+  } catch (std::exception& e) {
+   if (slot < snapshots.size())
+    snapshots[slot].data.reset();
+   write_ack(std::string("error snap_save: ") + e.what());
+  }
+ }
+}
+
+static void cmd_snap_load(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned slot;
+ if (!(iss >> slot) || slot >= snapshots.size() || !snapshots[slot].data) {
+  write_ack("error snap_load: slot is empty");
+ } else {
+  try {
+   Snapshot& snap = snapshots[slot];
+   MemoryStream* st = snapshot_expand(snap);
+   st->seek(0, SEEK_SET);
+   MDFNSS_LoadSM(st, true);
+   frame_counter = snap.frame;
+   journal_state();
+   history_clear();
+   write_ack("ok snap_load " + std::to_string(slot) + " frame=" + std::to_string(frame_counter));
+  } catch (std::exception& e) {
+   write_ack(std::string("error snap_load: ") + e.what());
+  }
+ }
+}
+
+static void cmd_rewind(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t frames = 0;
+ if (!(iss >> frames) || !frames) {
+  write_ack("error rewind: usage: rewind <frames>");
+ } else if (!MDFNSRW_IsRunning()) {
+  write_ack("error rewind: state rewinding is off (start with -automation_rewind)");
+ } else {
+  try {
+   const uint32 done = MDFNSRW_Rewind(frames);
+   frame_counter = (frame_counter > done) ? frame_counter - done : 0;
+   journal_state();
+   history_clear();
+   write_ack("ok rewind frames=" + std::to_string(done) + " frame=" + std::to_string(frame_counter));
+  } catch (std::exception& e) {
+   write_ack(std::string("error rewind: ") + e.what());
+  }
+ }
+}
+
+static void cmd_rewind_status(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFNSRW_Status rs;
+ MDFNSRW_GetStatus(&rs);
+ write_ack("ok rewind_status running=" + std::to_string(rs.running) + " frames=" + std::to_string(rs.frames) +
+           " capacity=" + std::to_string(rs.capacity) + " bytes=" + std::to_string(rs.bytes) +
+           " limit=" + std::to_string(rs.bytes_limit) + " state_bytes=" + std::to_string(rs.state_bytes));
+}
+
+static void cmd_snap_free(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string arg;
+ unsigned slot;
+ iss >> arg;
+ if (arg == "all") {
+  snapshots.clear();
+  snapshot_size_hint = 0;
+  write_ack("ok snap_free all");
+ } else if (sscanf(arg.c_str(), "%u", &slot) == 1) {
+  if (snapshot_dependents(slot))
+   write_ack("error snap_free: slot " + std::to_string(slot) + " is the base of " + std::to_string(snapshot_dependents(slot)) + " delta(s)");
+  else {
+   if (slot < snapshots.size()) {
+    snapshots[slot].data.reset();
+    snapshots[slot].pages.clear();
+    snapshots[slot].base = -1;
+   }
+   write_ack("ok snap_free " + std::to_string(slot));
+  }
+ } else {
+  write_ack("error snap_free: expected slot or 'all'");
+ }
+}
+
+static void cmd_tree_save(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string arg;
+ int64_t parent = tree_current;
+ if (iss >> arg)
+  parent = (arg == "-") ? -1 : strtoll(arg.c_str(), nullptr, 0);
+ if (parent >= (int64_t)tree_nodes.size() || (parent >= 0 && !tree_nodes[parent].used) || parent < -1) {
+  write_ack("error tree_save: no such parent node");
+ } else {
+  try {
+   snapshot_scratch.truncate(0);
+   snapshot_scratch.seek(0, SEEK_SET);
+   MDFNSS_SaveSM(&snapshot_scratch, true);
+
+   const uint32_t id = tree_nodes.size();
+   const uint64_t size = snapshot_scratch.size();
+   TreeNode tn;
+   unsigned added = 0;
+   tn.used = true;
+   tn.parent = parent;
+   tn.frame = frame_counter;
+   for (uint64_t offs = 0; offs < size; offs += Snapshot_PageSize) {
+    bool a;
+    tn.chunks.push_back(tree_add_chunk(snapshot_scratch.map() + offs, (uint32_t)std::min<uint64_t>(Snapshot_PageSize, size - offs), &a));
+    added += a;
+   }
+   tree_nodes.push_back(std::move(tn));
+   if (parent >= 0)
+    tree_nodes[parent].children.push_back(id);
+   tree_current = id;
+   write_ack("ok tree_save node=" + std::to_string(id) + " parent=" + std::to_string(parent) + " new_chunks=" + std::to_string(added) + "/" + std::to_string(tree_nodes[id].chunks.size()));
+  } catch (std::exception& e) {
+   write_ack(std::string("error tree_save: ") + e.what());
+  }
+ }
+}
+
+static void cmd_tree_load(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t node;
+ if (!(iss >> node) || node >= tree_nodes.size() || !tree_nodes[node].used) {
+  write_ack("error tree_load: no such node");
+ } else {
+  try {
+   const TreeNode& tn = tree_nodes[node];
+   snapshot_scratch.truncate(0);
+   snapshot_scratch.seek(0, SEEK_SET);
+   for (uint32_t ch : tn.chunks)
+    snapshot_scratch.write(tree_chunks[ch].data.get(), tree_chunks[ch].len);
+   snapshot_scratch.seek(0, SEEK_SET);
+   MDFNSS_LoadSM(&snapshot_scratch, true);
+   frame_counter = tn.frame;
+   tree_current = node;
+   journal_state();
+   history_clear();
+   write_ack("ok tree_load " + std::to_string(node) + " frame=" + std::to_string(frame_counter));
+  } catch (std::exception& e) {
+   write_ack(std::string("error tree_load: ") + e.what());
+  }
+ }
+}
+
+static void cmd_tree_prune(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t node;
+ if (!(iss >> node) || node >= tree_nodes.size() || !tree_nodes[node].used) {
+  write_ack("error tree_prune: no such node");
+ } else {
+  const unsigned n = tree_prune(node);
+  write_ack("ok tree_prune " + std::to_string(node) + " nodes=" + std::to_string(n));
+ }
+}
+
+static void cmd_tree_info(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t node;
+ if (iss >> node) {
+  if (node >= tree_nodes.size() || !tree_nodes[node].used) {
+   write_ack("error tree_info: no such node");
+  } else {
+   const TreeNode& tn = tree_nodes[node];
+   std::string ack = "ok tree_info " + std::to_string(node) + " parent=" + std::to_string(tn.parent) + " frame=" + std::to_string(tn.frame) + " children=";
+   for (size_t i = 0; i < tn.children.size(); i++)
+    ack += (i ? "," : "") + std::to_string(tn.children[i]);
+   write_ack(ack);
+  }
+ } else {
+  uint64_t nodes = 0, logical = 0;
+  for (const TreeNode& tn : tree_nodes) {
+   if (tn.used) {
+    nodes++;
+    for (uint32_t ch : tn.chunks)
+     logical += tree_chunks[ch].len;
+   }
+  }
+  write_ack("ok tree_info nodes=" + std::to_string(nodes) + " current=" + std::to_string(tree_current) +
+            " chunks=" + std::to_string(tree_chunk_index.size()) + " stored_bytes=" + std::to_string(tree_chunk_bytes) + " logical_bytes=" + std::to_string(logical));
+ }
+}
+
+static void cmd_pc_trace_frame(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error pc_trace_frame: no path");
+ } else {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+   write_ack("error pc_trace_frame: cannot open " + path);
+  } else {
+   delete pc_trace_ring;
+   pc_trace_ring = new MDFN_IEN_SS::TraceRing(f);
+   pc_trace_active = true;
+   pc_trace_frame_mode = true;
+   frames_to_advance = 1;
+   instruction_paused = false;   // unblock instruction-level pause
+   watchpoint_paused = false;    // unblock watchpoint pause
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+   instructions_to_step = -1;    // cancel step mode
+   slave_instructions_to_step = -1;
+   run_to_cycle_target = -1;     // cancel cycle target
+   update_cpu_hook();
+   write_ack("ok pc_trace_frame_started");
+  }
+ }
+}
+
+static void cmd_step(const CmdArgs& args)
+{
+ const int64_t n = std::max<int64_t>(1, args.i("n", 1));
+ step_return_cancel();
+ instructions_to_step = n;
+ instruction_paused = false;  // unblock instruction-level pause if active
+ watchpoint_paused = false;   // unblock watchpoint pause
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ // Unblock frame-level pause -- the CPU hook will pause us after N instructions
+ if (frames_to_advance == 0)
+  frames_to_advance = -1;
+ update_cpu_hook();
+ write_ack("ok step " + std::to_string(n));
+}
+
+static void cmd_step_over(const std::string&, std::istringstream&, const std::string& cmd)
+{
+ uint32_t ret = 0;
+ const unsigned depth = MDFN_IEN_SS::Automation_ShadowDepth(0, &ret);
+ step_return_cancel();
+ char buf[96];
+ if (cmd == "step_over") {
+  // One step; the debug hook turns it into a return stop if it called
+  step_over_pending = true;
+  step_over_depth = depth;
+  instructions_to_step = 1;
+  snprintf(buf, sizeof(buf), "ok step_over");
+ } else {
+  if (depth) {
+   step_return_depth = (int32_t)depth - 1;
+  } else {
+   uint32_t regs[22];
+   MDFN_IEN_SS::Automation_GetRegs(0, regs);
+   ret = regs[18];
+   step_return_depth = -1;
+  }
+  step_return_addr = ret;
+  step_return_op = "step_out";
+  step_return_active = true;
+  snprintf(buf, sizeof(buf), "ok step_out ret=0x%08X%s", ret, depth ? "" : " from=pr");
+ }
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ if (frames_to_advance == 0)
+  frames_to_advance = -1;
+ update_cpu_hook();
+ write_ack(buf);
+}
+
+static void cmd_step_slave(const CmdArgs& args)
+{
+ const int64_t n = std::max<int64_t>(1, args.i("n", 1));
+ slave_instructions_to_step = n;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ // The master keeps running; the slave hook pauses us after N slave instructions
+ if (frames_to_advance == 0)
+  frames_to_advance = -1;
+ update_cpu_hook();
+ write_ack("ok step_slave " + std::to_string(n));
+}
+
+static void cmd_breakpoint(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t addr = 0;
+ iss >> std::hex >> addr;
+ // Optional "log" and "slave" flags, in any order, then "if <expr>"
+ bool slave = false;
+ std::string token, cond_src;
+ while (iss >> token) {
+  if (token == "slave")
+   slave = true;
+  else if (token == "if") {
+   std::getline(iss, cond_src);
+   break;
+  }
+  else if (token == "log") {
+   breakpoint_log_mode = true;
+   if (!bp_log && !breakpoint_count_mode) {
+    std::string path = auto_base_dir + "/breakpoint_hits.txt";
+    bp_log = fopen(path.c_str(), "w");
+    if (bp_log)
+     fprintf(bp_log, "# Breakpoint hit log (log mode)\n");
+   }
+  }
+  else if (token == "count")
+   breakpoint_log_mode = breakpoint_count_mode = true;
+ }
+ BpCond bc;
+ std::string cond_err;
+ if (!cond_src.empty() && !bc.cond.Compile(cond_src, &cond_err)) {
+  write_ack("error breakpoint: condition: " + cond_err);
+ } else {
+  auto& set = slave ? slave_breakpoints : breakpoints;
+  set.insert(addr);
+  // Re-adding an address replaces (or drops) its condition and hit count.
+  if (cond_src.empty())
+   bp_conditions[slave].erase(addr);
+  else
+   bp_conditions[slave][addr] = bc;
+  update_cpu_hook();
+  char buf[64];
+  snprintf(buf, sizeof(buf), "0x%08X", addr);
+  std::string ack_msg = "ok breakpoint " + std::string(buf) + " total=" + std::to_string(set.size());
+  if (slave) ack_msg += " slave";
+  if (breakpoint_log_mode) ack_msg += breakpoint_count_mode ? " count" : " log";
+  if (!cond_src.empty()) ack_msg += " cond";
+  write_ack(ack_msg);
+ }
+}
+
+static void cmd_breakpoint_remove(const CmdArgs& args)
+{
+ const uint32_t addr = args.u("addr");
+ const bool slave = args.has("slave");
+ auto& set = slave ? slave_breakpoints : breakpoints;
+ size_t removed = set.erase(addr);
+ bp_conditions[slave].erase(addr);
+ bp_hit_counts[slave].erase(addr);
+ update_cpu_hook();
+ char buf[80];
+ if (removed) {
+  snprintf(buf, sizeof(buf), "ok breakpoint_remove 0x%08X total=%zu%s", addr, set.size(), slave ? " slave" : "");
+ } else {
+  snprintf(buf, sizeof(buf), "error breakpoint_remove: not found 0x%08X%s", addr, slave ? " slave" : "");
+ }
+ write_ack(buf);
+}
+
+static void cmd_breakpoint_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ size_t count = breakpoints.size() + slave_breakpoints.size();
+ breakpoints.clear();
+ slave_breakpoints.clear();
+ bp_conditions[0].clear();
+ bp_conditions[1].clear();
+ bp_hit_counts[0].clear();
+ bp_hit_counts[1].clear();
+ breakpoint_log_mode = false;
+ breakpoint_count_mode = false;
+ if (bp_log) { fclose(bp_log); bp_log = nullptr; }
+ update_cpu_hook();
+ write_ack("ok breakpoint_clear removed=" + std::to_string(count));
+}
+
+static void cmd_breakpoint_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::ostringstream ss;
+ ss << "breakpoints count=" << breakpoints.size();
+ for (auto addr : breakpoints) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), " 0x%08X", addr);
+  ss << buf;
+ }
+ if (!slave_breakpoints.empty()) {
+  ss << " slave count=" << slave_breakpoints.size();
+  for (auto addr : slave_breakpoints) {
+   char buf[16];
+   snprintf(buf, sizeof(buf), " 0x%08X", addr);
+   ss << buf;
+  }
+ }
+ write_ack(ss.str());
+}
+
+static void cmd_breakpoint_set_from_file(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // breakpoint_set_from_file <input_path> <result_path> [clear] [count]
+ // Bulk installer for PC breakpoints in log mode (no pause). Input is a text file
+ // with one hex address per line (optional 0x prefix). '#' starts a comment,
+ // blank lines are ignored. Per-line parse failures are surfaced in the result
+ // JSON; install proceeds for all valid addresses.
+ //
+ // Side effect: flips breakpoint_log_mode globally. Any previously-installed
+ // pause-mode breakpoints become log-only for the rest of the session (matches
+ // singular `breakpoint <addr> log` semantics).
+ //
+ // Atomic ordering: parse input + write result file FIRST. Only mutate the
+ // live breakpoint set if the result file was successfully written — keeps
+ // Python-side bookkeeping in sync on I/O failures.
+ //
+ // "count" switches log mode to hit counters (breakpoint_hits_dump) so a sweep
+ // over thousands of addresses costs a map update per hit, not a context dump.
+ std::string input_path, result_path, opt_tok;
+ iss >> input_path >> result_path;
+ bool clear_existing = false, count_mode = false, bad_opt = false;
+ while (iss >> opt_tok) {
+  if (opt_tok == "clear") clear_existing = true;
+  else if (opt_tok == "count") count_mode = true;
+  else bad_opt = true;
+ }
+
+ if (input_path.empty() || result_path.empty() || bad_opt) {
+  write_ack("error breakpoint_set_from_file: usage <input_path> <result_path> [clear] [count]");
+ } else {
+  std::ifstream in(input_path.c_str());
+  if (!in.is_open()) {
+   write_ack("error breakpoint_set_from_file: cannot open input " + input_path);
+  } else {
+   // ---- Pass 1: parse input into temp structures (no state mutation yet) ----
+   int requested = 0;
+   std::vector<uint32_t> valid_addrs;
+   std::vector<std::pair<int, std::string>> failures;
+   std::string line;
+   int line_no = 0;
+   while (std::getline(in, line)) {
+    line_no++;
+    auto hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    auto b = line.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) continue;
+    auto e = line.find_last_not_of(" \t\r\n");
+    std::string tok = line.substr(b, e - b + 1);
+    if (tok.empty()) continue;
+
+    requested++;
+    std::string raw = tok;
+    if (tok.size() >= 2 && (tok.compare(0, 2, "0x") == 0 || tok.compare(0, 2, "0X") == 0))
+     tok.erase(0, 2);
+    if (tok.empty() || tok.size() > 8 ||
+        tok.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+     failures.push_back({line_no, raw});
+     continue;
+    }
+    valid_addrs.push_back((uint32_t)strtoul(tok.c_str(), nullptr, 16));
+   }
+   in.close();
+
+   // Simulate the install so the result JSON reflects the final state.
+   std::unordered_set<uint32_t> sim;
+   if (!clear_existing) sim = breakpoints;
+   int installed = 0, duplicates = 0;
+   for (uint32_t a : valid_addrs) {
+    if (sim.insert(a).second) installed++;
+    else duplicates++;
+   }
+
+   // ---- Pass 2: write result JSON FIRST. Bail without mutating state on I/O fail. ----
+   FILE* out = fopen(result_path.c_str(), "w");
+   if (!out) {
+    write_ack("error breakpoint_set_from_file: cannot write result " + result_path);
+   } else {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"requested\": %d,\n", requested);
+    fprintf(out, "  \"installed\": %d,\n", installed);
+    fprintf(out, "  \"duplicates\": %d,\n", duplicates);
+    fprintf(out, "  \"failed\": %zu,\n", failures.size());
+    fprintf(out, "  \"total_breakpoints\": %zu,\n", sim.size());
+    fprintf(out, "  \"cleared_before_install\": %s,\n", clear_existing ? "true" : "false");
+    fprintf(out, "  \"log_mode\": true,\n");
+    fprintf(out, "  \"count_mode\": %s,\n", (count_mode || (breakpoint_count_mode && !clear_existing)) ? "true" : "false");
+    fputs("  \"failures\": [", out);
+    for (size_t i = 0; i < failures.size(); ++i) {
+     // JSON-escape per RFC 8259: \\, \", and control chars < 0x20 → \uXXXX.
+     // Pass higher bytes through as-is (valid UTF-8 remains valid UTF-8).
+     std::string esc;
+     for (unsigned char c : failures[i].second) {
+      if (c == '"') esc += "\\\"";
+      else if (c == '\\') esc += "\\\\";
+      else if (c < 0x20) {
+       char ubuf[8];
+       snprintf(ubuf, sizeof(ubuf), "\\u%04X", c);
+       esc += ubuf;
+      } else {
+       esc += (char)c;
+      }
+     }
+     fprintf(out, "%s\n    {\"line\": %d, \"raw\": \"%s\"}",
+             i ? "," : "", failures[i].first, esc.c_str());
+    }
+    fputs(failures.empty() ? "]\n" : "\n  ]\n", out);
+    fputs("}\n", out);
+    fclose(out);
+
+    // ---- Pass 3: mutate live state, now that persistence has succeeded. ----
+    if (clear_existing) {
+     breakpoints.clear();
+     bp_conditions[0].clear();
+     bp_hit_counts[0].clear();
+     breakpoint_count_mode = false;
+     if (bp_log) { fclose(bp_log); bp_log = nullptr; }
+    }
+    breakpoint_log_mode = true;
+    if (count_mode)
+     breakpoint_count_mode = true;
+    if (!bp_log && !breakpoint_count_mode) {
+     std::string hits_path = auto_base_dir + "/breakpoint_hits.txt";
+     bp_log = fopen(hits_path.c_str(), "w");
+     if (bp_log)
+      fprintf(bp_log, "# Breakpoint hit log (log mode)\n");
+    }
+    for (uint32_t a : valid_addrs) { breakpoints.insert(a); bp_conditions[0].erase(a); bp_hit_counts[0].erase(a); }
+    update_cpu_hook();
+
+    std::ostringstream ack;
+    ack << "ok breakpoint_set_from_file requested=" << requested
+        << " installed=" << installed
+        << " duplicates=" << duplicates
+        << " failed=" << failures.size()
+        << " total=" << breakpoints.size()
+        << (breakpoint_count_mode ? " count" : "")
+        << " result=" << result_path;
+    write_ack(ack.str());
+   }
+  }
+ }
+}
+
+static void cmd_load_symbols(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok, err;
+ bool append = false;
+ iss >> path;
+ if (iss >> tok && tok == "append")
+  append = true;
+ if (path.empty()) {
+  write_ack("error load_symbols: usage: load_symbols <path> [append]");
+ } else {
+  const int n = MDFN_IEN_SS::Automation_LoadSymbols(path.c_str(), append, &err);
+  if (n < 0)
+   write_ack("error load_symbols: " + err);
+  else
+   write_ack("ok load_symbols " + path + " loaded=" + std::to_string(n) + " total=" + std::to_string(MDFN_IEN_SS::Automation_SymbolCount()));
+ }
+}
+
+static void cmd_symbols_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const uint32_t n = MDFN_IEN_SS::Automation_SymbolCount();
+ MDFN_IEN_SS::Automation_ClearSymbols();
+ write_ack("ok symbols_clear removed=" + std::to_string(n));
+}
+
+static void cmd_symbol_lookup(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // symbol_lookup <addr> [addr...]: "0x06004010=func+0x10", "=?" outside every symbol
+ std::string ack = "ok symbol_lookup";
+ uint32_t addr;
+ unsigned n = 0;
+ while (iss >> std::hex >> addr) {
+  char buf[16];
+  const std::string sym = MDFN_IEN_SS::Automation_SymbolFormat(addr);
+  snprintf(buf, sizeof(buf), " 0x%08X=", addr);
+  ack += buf + (sym.empty() ? std::string("?") : sym);
+  n++;
+ }
+ if (!n)
+  write_ack("error symbol_lookup: usage: symbol_lookup <addr> [addr...]");
+ else
+  write_ack(ack);
+}
+
+static void cmd_breakpoint_hits_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // JSON: {"frame", "cycle", "entries": [{"cpu", "addr", "hits", "first_frame",
+ // "first_cycle"}], "breakpoints", "hit", "hits"}, first_* null if never hit.
+ // bin: "MDFNBPH1", le32 n, le32 0, then n x (le32 addr, u8 cpu, u8 0, le16 0,
+ // le64 hits, le64 first_frame, le64 first_cycle), first_* all ones if never hit.
+ // Entries are sorted by CPU, then address.
+ std::string path, tok;
+ bool bin = false, reset = false, bad = false;
+ iss >> path;
+ while (iss >> tok) {
+  if (tok == "bin") bin = true;
+  else if (tok == "json") bin = false;
+  else if (tok == "reset") reset = true;
+  else bad = true;
+ }
+ FILE* f = (path.empty() || bad) ? nullptr : fopen(path.c_str(), bin ? "wb" : "w");
+ if (path.empty() || bad) {
+  write_ack("error breakpoint_hits_dump: usage: breakpoint_hits_dump <path> [json|bin] [reset]");
+ } else if (!f) {
+  write_ack("error breakpoint_hits_dump: cannot open " + path);
+ } else {
+  std::vector<std::pair<unsigned, uint32_t>> order;
+  for (unsigned cpu = 0; cpu < 2; cpu++) {
+   for (uint32_t a : cpu ? slave_breakpoints : breakpoints)
+    order.push_back({cpu, a});
+  }
+  std::sort(order.begin(), order.end());
+  uint64_t hit = 0, hits = 0;
+  if (bin) {
+   uint8_t hdr[16];
+   memcpy(hdr, "MDFNBPH1", 8);
+   MDFN_en32lsb(&hdr[8], order.size());
+   MDFN_en32lsb(&hdr[12], 0);
+   fwrite(hdr, 1, sizeof(hdr), f);
+  } else {
+   fprintf(f, "{\n  \"frame\": %llu,\n  \"cycle\": %lld,\n  \"entries\": [", (unsigned long long)frame_counter, (long long)get_cycle());
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+   const unsigned cpu = order[i].first;
+   const uint32_t a = order[i].second;
+   auto it = bp_hit_counts[cpu].find(a);
+   const BpHitCount* h = (it != bp_hit_counts[cpu].end()) ? &it->second : nullptr;
+   if (h) {
+    hit++;
+    hits += h->hits;
+   }
+   if (bin) {
+    uint8_t rec[32];
+    MDFN_en32lsb(&rec[0], a);
+    rec[4] = cpu;
+    rec[5] = 0;
+    MDFN_en16lsb(&rec[6], 0);
+    MDFN_en64lsb(&rec[8], h ? h->hits : 0);
+    MDFN_en64lsb(&rec[16], h ? h->first_frame : ~(uint64_t)0);
+    MDFN_en64lsb(&rec[24], h ? (uint64_t)h->first_cycle : ~(uint64_t)0);
+    fwrite(rec, 1, sizeof(rec), f);
+   } else if (h) {
+    fprintf(f, "%s\n    {\"cpu\": \"%s\", \"addr\": \"0x%08X\", \"hits\": %llu, \"first_frame\": %llu, \"first_cycle\": %lld}",
+            i ? "," : "", cpu ? "slave" : "master", a, (unsigned long long)h->hits, (unsigned long long)h->first_frame, (long long)h->first_cycle);
+   } else {
+    fprintf(f, "%s\n    {\"cpu\": \"%s\", \"addr\": \"0x%08X\", \"hits\": 0, \"first_frame\": null, \"first_cycle\": null}",
+            i ? "," : "", cpu ? "slave" : "master", a);
+   }
+  }
+  if (!bin)
+   fprintf(f, "%s,\n  \"breakpoints\": %zu,\n  \"hit\": %llu,\n  \"hits\": %llu\n}\n", order.empty() ? "]" : "\n  ]", order.size(), (unsigned long long)hit, (unsigned long long)hits);
+  fclose(f);
+  if (reset) {
+   bp_hit_counts[0].clear();
+   bp_hit_counts[1].clear();
+  }
+  write_ack("ok breakpoint_hits_dump " + path + " breakpoints=" + std::to_string(order.size()) + " hit=" + std::to_string(hit) + " hits=" + std::to_string(hits) + (breakpoint_count_mode ? "" : " count_mode=false"));
+ }
+}
+
+static void cmd_show_window(const std::string&, std::istringstream&, const std::string&)
+{
+ Video_AutomationShowWindow();
+ write_ack("ok show_window");
+}
+
+static void cmd_hide_window(const std::string&, std::istringstream&, const std::string&)
+{
+ Video_AutomationHideWindow();
+ write_ack("ok hide_window");
+}
+
+static void cmd_call_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error call_trace: no path");
+ } else {
+  MDFN_IEN_SS::Automation_EnableCallTrace(path.c_str());
+  write_ack("ok call_trace " + path);
+ }
+}
+
+static void cmd_call_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_DisableCallTrace();
+ write_ack("ok call_trace_stop");
+}
+
+static void cmd_call_trace_filter(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // call_trace_filter [include=LO-HI,...] [exclude=LO-HI,...] [depth=N] [collapse] | off
+ std::vector<uint32> inc, exc;
+ unsigned depth = 0;
+ bool collapse = false, bad = false, off = false;
+ auto ranges = [](const std::string& v, std::vector<uint32>* out) {
+  std::istringstream rs(v);
+  std::string r;
+  while (std::getline(rs, r, ',')) {
+   const size_t dash = r.find('-');
+   if (dash == std::string::npos || dash == 0 || dash + 1 == r.size())
+    return false;
+   const uint32 lo = strtoul(r.c_str(), nullptr, 16), hi = strtoul(r.c_str() + dash + 1, nullptr, 16);
+   if (hi < lo)
+    return false;
+   out->push_back(lo);
+   out->push_back(hi);
+  }
+  return !out->empty();
+ };
+ std::string tok;
+ while (iss >> tok && !bad) {
+  if (tok == "off")
+   off = true;
+  else if (tok == "collapse")
+   collapse = true;
+  else if (tok.compare(0, 8, "include=") == 0)
+   bad = !ranges(tok.substr(8), &inc);
+  else if (tok.compare(0, 8, "exclude=") == 0)
+   bad = !ranges(tok.substr(8), &exc);
+  else if (tok.compare(0, 6, "depth=") == 0)
+   depth = strtoul(tok.c_str() + 6, nullptr, 10);
+  else
+   bad = true;
+ }
+ if (off && (!inc.empty() || !exc.empty() || depth || collapse))
+  bad = true;
+ if (bad || (!off && inc.empty() && exc.empty() && !depth && !collapse)) {
+  write_ack("error call_trace_filter: usage: call_trace_filter [include=LO-HI,...] [exclude=LO-HI,...] [depth=N] [collapse] | off");
+ } else if (!MDFN_IEN_SS::Automation_SetCallTraceFilter(inc.data(), inc.size() / 2, exc.data(), exc.size() / 2, depth, collapse)) {
+  write_ack("error call_trace_filter: at most 16 include and 16 exclude ranges");
+ } else {
+  char buf[128];
+  snprintf(buf, sizeof(buf), "ok call_trace_filter include=%zu exclude=%zu depth=%u%s", inc.size() / 2, exc.size() / 2, depth, collapse ? " collapse" : "");
+  write_ack(off ? std::string("ok call_trace_filter off") : std::string(buf));
+ }
+}
+
+static void cmd_call_trace_stats(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t written, filtered, collapsed;
+ MDFN_IEN_SS::Automation_CallTraceStats(&written, &filtered, &collapsed);
+ write_ack("ok call_trace_stats written=" + std::to_string(written) + " filtered=" + std::to_string(filtered) + " collapsed=" + std::to_string(collapsed));
+}
+
+static void cmd_scdq_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error scdq_trace: no path");
+ } else {
+  MDFN_IEN_SS::CDB_EnableSCDQTrace(path.c_str());
+  write_ack("ok scdq_trace " + path);
+ }
+}
+
+static void cmd_scdq_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::CDB_DisableSCDQTrace();
+ write_ack("ok scdq_trace_stop");
+}
+
+static void cmd_cdb_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error cdb_trace: no path");
+ } else {
+  MDFN_IEN_SS::CDB_EnableCDBTrace(path.c_str());
+  write_ack("ok cdb_trace " + path);
+ }
+}
+
+static void cmd_cdb_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::CDB_DisableCDBTrace();
+ write_ack("ok cdb_trace_stop");
+}
+
+static void cmd_cdb_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ bool zlib = false;
+ while (iss >> tok) {
+  if (tok == "zlib")
+   zlib = true;
+  else
+   path = tok;
+ }
+ if (!MDFN_IEN_SS::CDB_ProfileStart(path.empty() ? nullptr : path.c_str(), zlib))
+  write_ack("error cdb_profile_start: cannot open " + path);
+ else
+  write_ack("ok cdb_profile_start" + (path.empty() ? std::string() : " " + path) + (zlib ? " zlib" : ""));
+}
+
+static void cmd_cdb_profile_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ uint64_t commands = 0;
+ iss >> path;
+ if (path.empty())
+  write_ack("error cdb_profile_dump: usage: cdb_profile_dump <path>");
+ else if (!MDFN_IEN_SS::CDB_ProfileIsActive())
+  write_ack("error cdb_profile_dump: not profiling (cdb_profile_start first)");
+ else if (!MDFN_IEN_SS::CDB_ProfileDump(path.c_str(), &commands))
+  write_ack("error cdb_profile_dump: cannot open " + path);
+ else
+  write_ack("ok cdb_profile_dump " + path + " commands=" + std::to_string(commands));
+}
+
+static void cmd_cdb_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t records = 0;
+ const uint64_t dropped = MDFN_IEN_SS::CDB_ProfileStop(&records);
+ write_ack("ok cdb_profile_stop records=" + std::to_string(records) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_hotmem_status(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack("ok hotmem_status " + MDFN_IEN_SS::Automation_HotMemStatus());
+}
+
+static void cmd_sound_status(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack("ok sound_status " + Sound_RingStatus());
+}
+
+static void cmd_unified_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error unified_trace: no path");
+ } else {
+  // Stop any existing unified trace
+  if (unified_trace_bin) {
+   MDFN_IEN_SS::Automation_DisableUnifiedBinTrace();
+   unified_trace_bin = false;
+  }
+  if (unified_trace_file) {
+   MDFN_IEN_SS::Automation_ClearCallTraceFile();
+   MDFN_IEN_SS::CDB_ClearCDBTraceFile();
+   fclose(unified_trace_file);
+   unified_trace_file = nullptr;
+  }
+  unified_trace_file = fopen(path.c_str(), "w");
+  if (unified_trace_file) {
+   fprintf(unified_trace_file, "# Unified trace: <sh2_cycle> <source> <details>\n"
+     "# M/S = SH-2 master/slave call, CMD/DRV/IRQ/BUF = CD Block\n");
+   MDFN_IEN_SS::Automation_SetCallTraceFile(unified_trace_file);
+   MDFN_IEN_SS::CDB_SetCDBTraceFile(unified_trace_file);
+   write_ack("ok unified_trace " + path);
+  } else {
+   write_ack("error unified_trace: failed to open " + path);
+  }
+ }
+}
+
+static void cmd_unified_trace_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, opt;
+ iss >> path >> opt;
+ if (path.empty() || (!opt.empty() && opt != "zlib")) {
+  write_ack("error unified_trace_bin: usage: unified_trace_bin <path> [zlib]");
+ } else if (unified_trace_file) {
+  write_ack("error unified_trace_bin: text unified_trace is active");
+ } else if (MDFN_IEN_SS::Automation_EnableUnifiedBinTrace(path.c_str(), opt == "zlib", frame_counter)) {
+  unified_trace_bin = true;
+  write_ack("ok unified_trace_bin " + path);
+ } else {
+  write_ack("error unified_trace_bin: failed to open " + path);
+ }
+}
+
+static void cmd_unified_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_ClearCallTraceFile();
+ MDFN_IEN_SS::CDB_ClearCDBTraceFile();
+ if (unified_trace_file) {
+  fflush(unified_trace_file);
+  fclose(unified_trace_file);
+  unified_trace_file = nullptr;
+ }
+ if (unified_trace_bin) {
+  uint64_t dropped = MDFN_IEN_SS::Automation_DisableUnifiedBinTrace();
+  unified_trace_bin = false;
+  write_ack("ok unified_trace_stop dropped=" + std::to_string(dropped));
+ } else
+  write_ack("ok unified_trace_stop");
+}
+
+static void cmd_input_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error input_trace: no path");
+ } else {
+  if (input_trace_file) fclose(input_trace_file);
+  input_trace_file = fopen(path.c_str(), "w");
+  if (input_trace_file) {
+   fprintf(input_trace_file, "# Input trace -- frame PRESS/RELEASE BUTTON\n");
+   last_traced_input = 0;
+   write_ack("ok input_trace " + path);
+  } else {
+   write_ack("error input_trace: cannot open " + path);
+  }
+ }
+}
+
+static void cmd_input_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (input_trace_file) {
+  fclose(input_trace_file);
+  input_trace_file = nullptr;
+ }
+ if (ipb_trace_file) {
+  fclose(ipb_trace_file);
+  ipb_trace_file = nullptr;
+  write_ack("ok input_trace_stop events=" + std::to_string(ipb_trace_events));
+ } else
+  write_ack("ok input_trace_stop");
+}
+
+static void cmd_input_playback(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error input_playback: no path");
+ } else {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) {
+   write_ack("error input_playback: cannot open " + path);
+  } else {
+   playback_events.clear();
+   playback_index = 0;
+   char line[256];
+   while (fgets(line, sizeof(line), f)) {
+    // Parse: frame=N PRESS/RELEASE BUTTON
+    uint64_t fr = 0;
+    char action[32] = {0}, button[32] = {0};
+    if (sscanf(line, "frame=%llu %31s %31s", (unsigned long long*)&fr, action, button) == 3) {
+     int b = parse_button(button);
+     if (b >= 0) {
+      InputEvent ev;
+      ev.frame = fr;
+      ev.press = (strcmp(action, "PRESS") == 0);
+      ev.button = b;
+      playback_events.push_back(ev);
+     }
+    }
+   }
+   fclose(f);
+   // Clear current input state for clean playback
+   input_buttons = 0;
+   input_override = false;
+   playback_base_frame = frame_counter;
+   playback_active = true;
+   char buf[256];
+   snprintf(buf, sizeof(buf), "ok input_playback %zu events from %s",
+            playback_events.size(), path.c_str());
+   write_ack(buf);
+  }
+ }
+}
+
+static void cmd_input_playback_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ playback_active = false;
+ playback_events.clear();
+ playback_index = 0;
+ if (ipb_play_file) {
+  ipb_play_close();
+  write_ack("ok input_playback_stop events=" + std::to_string(ipb_play_events));
+ } else
+  write_ack("ok input_playback_stop");
+}
+
+static void cmd_input_trace_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error input_trace_bin: no path");
+ } else {
+  if (ipb_trace_file) fclose(ipb_trace_file);
+  if ((ipb_trace_file = fopen(path.c_str(), "wb"))) {
+   fwrite("MDFNIPB1", 1, 8, ipb_trace_file);
+   for (auto& d : ipb_trace_last)
+    d.clear();
+   ipb_trace_base = frame_counter;
+   ipb_trace_events = 0;
+   write_ack("ok input_trace_bin " + path);
+  } else {
+   write_ack("error input_trace_bin: cannot open " + path);
+  }
+ }
+}
+
+static void cmd_input_playback_bin(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ char magic[8];
+ if (path.empty()) {
+  write_ack("error input_playback_bin: no path");
+ } else if (journal_file || journal_playing) {
+  write_ack("error input_playback_bin: the replay journal can't hold sub-frame input; stop it first");
+ } else {
+  ipb_play_close();
+  if (!(ipb_play_file = fopen(path.c_str(), "rb"))) {
+   write_ack("error input_playback_bin: cannot open " + path);
+  } else if (fread(magic, 1, 8, ipb_play_file) != 8 || memcmp(magic, "MDFNIPB1", 8)) {
+   ipb_play_close();
+   write_ack("error input_playback_bin: not a binary input stream: " + path);
+  } else {
+   // Like input_playback, start from a clean state.
+   input_buttons = 0;
+   input_override = false;
+   playback_active = false;
+   ipb_play_base = frame_counter;
+   ipb_play_events = 0;
+   ipb_read_next();
+   MDFN_IEN_SS::Automation_SetSMPCPollHook(ipb_poll_hook);
+   write_ack("ok input_playback_bin " + path);
+  }
+ }
+}
+
+static void cmd_watchpoint(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ // Single-watchpoint form: replaces the one the previous command of the
+ // same name installed, leaving watchpoint_add entries alone.
+ const bool is_read = (cmd == "read_watchpoint");
+ Watchpoint wp;
+ iss >> std::hex >> wp.addr;
+ parse_watchpoint_opts(iss, wp);
+ wp.is_read = is_read;
+ unsigned& legacy_id = is_read ? legacy_rwp_id : legacy_wp_id;
+ if (legacy_id)
+  remove_watchpoint(legacy_id);
+ if (is_read) {
+  read_watchpoint_paused = false;
+  // Close stale log
+  if (rwp_log) { fclose(rwp_log); rwp_log = nullptr; }
+ } else {
+  watchpoint_paused = false;
+  read_watchpoint_paused = false;
+  exception_paused = false;
+  // Close stale log from previous watchpoint
+  close_wp_log();
+ }
+ legacy_id = add_watchpoint(wp);
+ if (!legacy_id) {
+  write_ack("error " + cmd + ": address range not watchable (Work RAM L/H, or VDP1 for writes)");
+ } else {
+  write_ack("ok " + cmd + describe_watchpoint(wp) + " id=" + std::to_string(legacy_id));
+ }
+}
+
+static void cmd_watchpoint_add(const std::string&, std::istringstream& iss, const std::string&)
+{
+ Watchpoint wp;
+ iss >> std::hex >> wp.addr;
+ parse_watchpoint_opts(iss, wp);
+ const unsigned id = add_watchpoint(wp);
+ if (!id) {
+  write_ack("error watchpoint_add: address range not watchable (Work RAM L/H, or VDP1 for writes)");
+ } else {
+  // Keep one log per direction: name the new range if it's already open.
+  FILE* fp = wp.is_read ? rwp_log : wp_log;
+  if (fp) {
+   fprintf(fp, "# %s hits for id=%u addr%s\n", wp.is_read ? "Read watchpoint" : "Watchpoint",
+    id, describe_watchpoint(wp).c_str());
+   fflush(fp);
+  }
+  write_ack("ok watchpoint_add id=" + std::to_string(id) + describe_watchpoint(wp)
+   + (wp.is_read ? " read" : "") + " total=" + std::to_string(watchpoints.size()));
+ }
+}
+
+static void cmd_watchpoint_remove(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned id = 0;
+ iss >> id;
+ if (!watchpoints.count(id)) {
+  write_ack("error watchpoint_remove: no watchpoint id=" + std::to_string(id));
+ } else {
+  remove_watchpoint(id);
+  write_ack("ok watchpoint_remove id=" + std::to_string(id) + " total=" + std::to_string(watchpoints.size()));
+ }
+}
+
+static void cmd_watchpoint_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::string out = "watchpoints count=" + std::to_string(watchpoints.size());
+ for (const auto& kv : watchpoints)
+  out += "\nid=" + std::to_string(kv.first) + (kv.second.is_read ? " read" : " write") + describe_watchpoint(kv.second);
+ write_ack(out);
+}
+
+static void cmd_watchpoint_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = clear_watchpoints(false);
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ exception_paused = false;
+ close_wp_log();
+ write_ack("ok watchpoint_clear removed=" + std::to_string(count));
+}
+
+static void cmd_vdp2_watchpoint(const std::string& line, std::istringstream& iss, const std::string&)
+{
+ static const char* const mode_names[] = { "text", "bin", "agg" };
+ uint32_t lo = 0, hi = 0;
+ unsigned mode = 0, line_size = 64;
+ bool zlib = false, bad = false;
+ std::string logpath, tok;
+ iss >> std::hex >> lo >> hi >> std::dec >> logpath;
+ while (iss >> tok) {
+  if (tok == "text")
+   mode = 0;
+  else if (tok == "bin")
+   mode = 1;
+  else if (tok == "agg")
+   mode = 2;
+  else if (tok.compare(0, 4, "agg=") == 0) {
+   mode = 2;
+   line_size = strtoul(tok.c_str() + 4, nullptr, 0);
+  }
+  else if (tok == "zlib")
+   zlib = true;
+  else
+   bad = true;
+ }
+ if (logpath.empty() || bad) {
+  write_ack("error vdp2_watchpoint: usage: vdp2_watchpoint <lo_hex> <hi_hex> <logpath> [text|bin|agg[=line bytes]] [zlib]");
+ } else if (!MDFN_IEN_SS::Automation_SetVDP2Watchpoint(lo, hi, logpath.c_str(), mode, line_size, zlib)) {
+  write_ack("error vdp2_watchpoint: cannot open " + logpath + ", range is empty or over 2MiB, or line size is not a power of 2 in 4..65536");
+ } else {
+  char buf[320];
+  snprintf(buf, sizeof(buf), "ok vdp2_watchpoint 0x%08X-0x%08X %s mode=%s", lo, hi, logpath.c_str(), mode_names[mode]);
+  std::string ack = buf;
+  if (mode == 2)
+   ack += " line=" + std::to_string(line_size);
+  if (zlib && mode)
+   ack += " zlib";
+  write_ack(ack);
+ }
+}
+
+static void cmd_vdp2_watchpoint_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t records = 0;
+ const uint64_t dropped = MDFN_IEN_SS::Automation_ClearVDP2Watchpoint(frame_counter, &records);
+ write_ack("ok vdp2_watchpoint_clear records=" + std::to_string(records) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_read_watchpoint_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = clear_watchpoints(true);
+ read_watchpoint_paused = false;
+ exception_paused = false;
+ if (rwp_log) { fclose(rwp_log); rwp_log = nullptr; }
+ write_ack("ok read_watchpoint_clear removed=" + std::to_string(count));
+}
+
+static void cmd_deterministic(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_SetDeterministic();
+ if (journal_file)
+  journal_event(Journal_Deterministic, journal_flags(), nullptr, 0);
+ history_clear();
+ write_ack("ok deterministic");
+}
+
+static bool setting_exists(const std::string& name)
+{
+ for (const MDFNCS& s : *MDFNI_GetSettings())
+  if (name == s.desc.name)
+   return true;
+ return false;
+}
+
+static void cmd_setting_get(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string name;
+ iss >> name;
+ if (name.empty() || !setting_exists(name)) {
+  write_ack("error setting_get: unknown setting \"" + name + "\"");
+  return;
+ }
+ write_ack("ok setting_get " + name + " " + MDFN_GetSettingS(name));
+}
+
+static void cmd_setting_set(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string name, value;
+ iss >> name;
+ std::getline(iss >> std::ws, value);
+ if (name.empty() || !setting_exists(name)) {
+  write_ack("error setting_set: unknown setting \"" + name + "\"");
+  return;
+ }
+ // Override level 1, like -ovconfig: kept across game loads, left out of the saved settings file.
+ if (!MDFNI_SetSetting(name, value, true)) {
+  write_ack("error setting_set: invalid value for " + name);
+  return;
+ }
+ write_ack("ok setting_set " + name + " " + MDFN_GetSettingS(name));
+}
+
+static void cmd_exception_break(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (mode == "enable") {
+  exception_mode = EXC_ENABLE;
+  write_ack("ok exception_break enable");
+ } else if (mode == "log") {
+  exception_mode = EXC_LOG;
+  if (!exc_log) {
+   std::string path = auto_base_dir + "/exception_hits.txt";
+   exc_log = fopen(path.c_str(), "w");
+   if (exc_log) fprintf(exc_log, "# SH-2 exception log\n");
+  }
+  write_ack("ok exception_break log");
+ } else if (mode == "disable") {
+  exception_mode = EXC_DISABLE;
+  exception_paused = false;
+  if (exc_log) { fclose(exc_log); exc_log = nullptr; }
+  write_ack("ok exception_break disable");
+ } else {
+  write_ack("error exception_break: usage: exception_break <enable|log|disable>");
+ }
+}
+
+static void cmd_insn_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, mode;
+ int64_t start_line = 0, stop_line = 0;
+ iss >> path >> start_line >> stop_line >> mode;
+ if (path.empty() || start_line <= 0 || stop_line <= 0 || (!mode.empty() && mode != "raw")) {
+  write_ack("error insn_trace: usage: insn_trace <path> <start_line> <stop_line> [raw]");
+ } else {
+  MDFN_IEN_SS::Automation_EnableInsnTrace(path.c_str(), start_line, stop_line, mode == "raw");
+  char buf[256];
+  snprintf(buf, sizeof(buf), "ok insn_trace %s start=%lld stop=%lld%s", path.c_str(), (long long)start_line, (long long)stop_line, mode.empty() ? "" : " raw");
+  write_ack(buf);
+ }
+}
+
+static void cmd_insn_trace_disasm(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string in_path, out_path;
+ uint64_t first = 0, count = 0;
+ iss >> in_path >> out_path;
+ if (!(iss >> first))
+  first = 0;
+ if (!(iss >> count))
+  count = 0;
+ if (in_path.empty() || out_path.empty()) {
+  write_ack("error insn_trace_disasm: usage: insn_trace_disasm <raw_path> <out_path> [first] [count]");
+ } else {
+  const int64_t lines = MDFN_IEN_SS::Automation_InsnTraceDisasm(in_path.c_str(), out_path.c_str(), first, count);
+  if (lines < 0)
+   write_ack("error insn_trace_disasm: cannot open " + out_path + " or " + in_path + " is not a raw insn trace");
+  else
+   write_ack("ok insn_trace_disasm " + out_path + " lines=" + std::to_string(lines));
+ }
+}
+
+static void cmd_insn_trace_unified(const std::string&, std::istringstream& iss, const std::string&)
+{
+ int64_t start_line = 0, stop_line = 0;
+ iss >> start_line >> stop_line;
+ if (start_line <= 0 || stop_line <= 0) {
+  write_ack("error insn_trace_unified: usage: insn_trace_unified <start_line> <stop_line>");
+ } else {
+  MDFN_IEN_SS::Automation_EnableInsnTraceUnified(start_line, stop_line);
+  char buf[256];
+  snprintf(buf, sizeof(buf), "ok insn_trace_unified start=%lld stop=%lld", (long long)start_line, (long long)stop_line);
+  write_ack(buf);
+ }
+}
+
+static void cmd_insn_trace_window(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ bool raw = false, bad = false;
+ MDFN_IEN_SS::Automation_InsnTraceWindow w;
+ iss >> path;
+ // "A-B" ranges; an empty B ("A-") leaves that end open.
+ auto range = [](const std::string& v, int base, int64_t* lo, int64_t* hi) {
+  const size_t dash = v.find('-');
+  if (dash == std::string::npos || dash == 0)
+   return false;
+  *lo = strtoll(v.c_str(), nullptr, base);
+  if (dash + 1 < v.size())
+   *hi = strtoll(v.c_str() + dash + 1, nullptr, base);
+  return true;
+ };
+ while (iss >> tok && !bad) {
+  const size_t eq = tok.find('=');
+  const std::string key = tok.substr(0, eq), val = (eq == std::string::npos) ? std::string() : tok.substr(eq + 1);
+  int64_t lo = 0, hi = 0;
+  if (tok == "raw")
+   raw = true;
+  else if (key == "cpu" && (val == "master" || val == "slave" || val == "both"))
+   w.cpu_mask = (val == "master") ? 1 : (val == "slave") ? 2 : 3;
+  else if (key == "frames" && range(val, 10, &w.frame_lo, &w.frame_hi))
+   ;
+  else if (key == "cycles" && range(val, 10, &w.cycle_lo, &w.cycle_hi))
+   ;
+  else if (key == "enter" && range(val, 16, &lo, &hi) && hi > lo) {
+   w.enter_lo = (uint32_t)lo;
+   w.enter_hi = (uint32_t)hi;
+  }
+  else if (key == "after" && val.find(':') != std::string::npos) {
+   w.after_pc = strtoul(val.c_str(), nullptr, 16);
+   w.after_n = strtoull(val.c_str() + val.find(':') + 1, nullptr, 10);
+   bad = !w.after_n;
+  }
+  else if (key == "count" && !val.empty())
+   w.count = strtoull(val.c_str(), nullptr, 10);
+  else
+   bad = true;
+ }
+ if (path.empty() || bad) {
+  write_ack("error insn_trace_window: usage: insn_trace_window <path> [raw] [cpu=master|slave|both] [frames=A-B] [cycles=A-B] [enter=LO-HI] [after=ADDR:N] [count=N]");
+ } else if (!MDFN_IEN_SS::Automation_EnableInsnTraceWindow(path.c_str(), w, raw, frame_counter)) {
+  write_ack("error insn_trace_window: cannot open " + path);
+ } else {
+  write_ack("ok insn_trace_window " + path + (raw ? " raw" : "") + " armed");
+ }
+}
+
+static void cmd_insn_trace_window_status(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t traced = 0;
+ const char* state = MDFN_IEN_SS::Automation_InsnTraceWindowState(&traced);
+ write_ack(std::string("ok insn_trace_window_status state=") + state + " traced=" + std::to_string(traced));
+}
+
+static void cmd_insn_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dropped = MDFN_IEN_SS::Automation_DisableInsnTrace();
+ write_ack("ok insn_trace_stop dropped=" + std::to_string(dropped));
+}
+
+static void cmd_dump_cycle(const std::string&, std::istringstream&, const std::string&)
+{
+ char buf[64];
+ snprintf(buf, sizeof(buf), "ok dump_cycle value=%lld", (long long)get_cycle());
+ write_ack(buf);
+}
+
+static void cmd_gdb_server(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // gdb_server <port> | stop
+ std::string arg;
+ iss >> arg;
+ const unsigned port = (unsigned)atoi(arg.c_str());
+ if (arg == "stop") {
+  gdb_shutdown();
+  write_ack("ok gdb_server stop");
+ } else if (gdb_listen_fd != AUTO_SOCK_INVALID) {
+  write_ack("error gdb_server: already listening on port " + std::to_string(gdb_port));
+ } else if (!port || port > 65535) {
+  write_ack("error gdb_server: usage gdb_server <port>|stop");
+ } else if (!gdb_listen(port)) {
+  write_ack("error gdb_server: cannot listen on port " + arg);
+ } else {
+  write_ack("ok gdb_server port=" + arg);
+ }
+}
+
+static void cmd_run_to_line(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // run_to_line <line> [frame]
+ int64_t line = -1, frame = -1;
+ iss >> line;
+ if (!(iss >> frame))
+  frame = -1;
+ if (line < 0 || line >= 512) {
+  write_ack("error run_to_line: usage run_to_line <line 0-511> [frame]");
+  return;
+ }
+ run_to_line_target = (int32_t)line;
+ run_to_line_frame = frame;
+ raster_break = false;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ if (frames_to_advance == 0)
+  frames_to_advance = -1;
+ update_cpu_hook();
+ raster_update_hook();
+ write_ack("ok run_to_line line=" + std::to_string(line) + (frame >= 0 ? " frame=" + std::to_string(frame) : ""));
+}
+
+static void cmd_break_on_vblank_in(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ std::string arg;
+ iss >> arg;
+ if (arg != "on" && arg != "off") {
+  write_ack("error " + cmd + ": usage " + cmd + " on|off");
+  return;
+ }
+ (cmd == "break_on_vblank_in" ? break_vblank_in : break_vblank_out) = (arg == "on");
+ raster_update_hook();
+ write_ack("ok " + cmd + " " + arg);
+}
+
+static void cmd_run_to_cycle(const std::string&, std::istringstream& iss, const std::string&)
+{
+ int64_t n = 0;
+ iss >> n;
+ int64_t current = get_cycle();
+ if (n < current && history_mode == Hist_Record && !history_snaps.empty()) {
+  // Into the past: re-run from the last snapshot at or before the target
+  const std::string err = history_unavailable();
+  if (!err.empty()) {
+   write_ack("error run_to_cycle: " + err);
+  } else if (n < history_snaps.front().cycle) {
+   write_ack("error run_to_cycle: target " + std::to_string(n) + " is before the oldest snapshot (cycle "
+    + std::to_string(history_snaps.front().cycle) + ")");
+  } else {
+   size_t seg = history_snaps.size() - 1;
+   while (history_snaps[seg].cycle > n)
+    seg--;
+   write_ack("ok run_to_cycle target=" + std::to_string(n) + " reverse from=" + std::to_string(current));
+   history_target = n;
+   history_begin("run_to_cycle", Hist_Cycle, seg, Hist_Land);
+  }
+  return;
+ }
+ if (n <= current) {
+  char buf[128];
+  snprintf(buf, sizeof(buf), "warning run_to_cycle: target %lld <= current %lld, firing immediately", (long long)n, (long long)current);
+  write_ack(buf);
+  return;
+ }
+ run_to_cycle_target = n;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ m68k_paused = false;
+ exception_paused = false;
+ instructions_to_step = -1;
+ slave_instructions_to_step = -1;
+ if (frames_to_advance == 0)
+  frames_to_advance = -1;
+ update_cpu_hook();
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok run_to_cycle target=%lld", (long long)n);
+ write_ack(buf);
+}
+
+static void cmd_history_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string tok;
+ unsigned every = 60, slots = 16;
+ bool bad = false;
+ while (iss >> tok) {
+  if (tok.compare(0, 6, "every=") == 0)
+   every = strtoul(tok.c_str() + 6, nullptr, 0);
+  else if (tok.compare(0, 6, "slots=") == 0)
+   slots = strtoul(tok.c_str() + 6, nullptr, 0);
+  else
+   bad = true;
+ }
+ if (bad || every < 1 || slots < 1 || slots > Snapshot_MaxSlots) {
+  write_ack("error history_start: usage: history_start [every=N frames] [slots=1.." + std::to_string(Snapshot_MaxSlots) + "]");
+ } else if (history_mode >= Hist_Seek) {
+  write_ack("error history_start: " + history_op + " is still running");
+ } else {
+  history_clear();
+  history_mode = Hist_Record;
+  history_every = every;
+  history_slots = slots;
+  std::string first = " first=next_frame";
+  if (history_at_frame_boundary()) {
+   try {
+    history_snapshot();
+    first = " first=now";
+   } catch (std::exception& e) {
+    history_stop();
+    write_ack(std::string("error history_start: ") + e.what());
+    return;
+   }
+  }
+  write_ack("ok history_start every=" + std::to_string(every) + " slots=" + std::to_string(slots) + first);
+ }
+}
+
+static void cmd_history_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const bool running = history_mode >= Hist_Seek;
+ history_stop();
+ write_ack(std::string("ok history_stop") + (running ? " cancelled=" + history_op : ""));
+}
+
+static void cmd_history_status(const std::string&, std::istringstream&, const std::string&)
+{
+ static const char* const mode_names[] = { "off", "record", "seek", "scan", "land" };
+ uint64_t bytes = 0;
+ for (const HistorySnap& s : history_snaps)
+  bytes += s.data->size();
+ std::string ack = std::string("ok history_status mode=") + mode_names[history_mode]
+  + " snapshots=" + std::to_string(history_snaps.size()) + "/" + std::to_string(history_slots)
+  + " every=" + std::to_string(history_every) + " events=" + std::to_string(history_events.size())
+  + " bytes=" + std::to_string(bytes);
+ if (!history_snaps.empty())
+  ack += " oldest_frame=" + std::to_string(history_snaps.front().frame) + " oldest_cycle=" + std::to_string(history_snaps.front().cycle)
+   + " newest_frame=" + std::to_string(history_snaps.back().frame) + " newest_cycle=" + std::to_string(history_snaps.back().cycle);
+ write_ack(ack);
+}
+
+static void cmd_step_back(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ // step_back [N]: N master instructions back. reverse_continue [N]: back to
+ // the Nth previous pausing breakpoint or watchpoint hit.
+ uint64_t n = 1;
+ std::string arg;
+ const std::string err = history_unavailable();
+ if ((iss >> arg) && (n = strtoull(arg.c_str(), nullptr, 10)) < 1) {
+  write_ack("error " + cmd + ": usage: " + cmd + " [N >= 1]");
+ } else if (!err.empty()) {
+  write_ack("error " + cmd + ": " + err);
+ } else {
+  write_ack("ok " + cmd + " n=" + std::to_string(n) + " from=" + std::to_string(get_cycle()));
+  history_need = n;
+  history_target = get_cycle();
+  history_begin(cmd, (cmd == "step_back") ? Hist_Insn : Hist_Hit, history_snaps.size() - 1, Hist_Scan);
+ }
+}
+
+static void cmd_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t interval = 1000;
+ std::string which = "both";
+ std::string tok;
+ while (iss >> tok) {
+  if (tok == "master" || tok == "slave" || tok == "both")
+   which = tok;
+  else
+   interval = (uint32_t)strtoul(tok.c_str(), nullptr, 0);
+ }
+ const unsigned mask = (which == "master") ? 1 : (which == "slave") ? 2 : 3;
+ if (MDFN_IEN_SS::Automation_ProfileStart(interval, mask))
+  write_ack("ok profile_start interval=" + std::to_string(interval) + " cpu=" + which);
+ else
+  write_ack("error profile_start: interval must be 16..16777216 cycles");
+}
+
+static void cmd_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_ProfileStop();
+ write_ack("ok profile_stop samples=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetSamples(0) + MDFN_IEN_SS::Automation_ProfileGetSamples(1)));
+}
+
+static void cmd_profile_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, mode;
+ iss >> path >> mode;
+ if (path.empty()) {
+  write_ack("error profile_dump: no path");
+ } else if (!mode.empty() && mode != "flat" && mode != "func") {
+  write_ack("error profile_dump: usage: profile_dump <path> [flat|func]");
+ } else if (mode == "func" && !MDFN_IEN_SS::Automation_SymbolCount()) {
+  write_ack("error profile_dump: func needs load_symbols first");
+ } else if (MDFN_IEN_SS::Automation_ProfileDump(path.c_str(), mode == "flat" ? 1 : mode == "func" ? 2 : 0)) {
+  write_ack("ok profile_dump " + path + " stacks=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetStacks()));
+ } else {
+  write_ack("error profile_dump: cannot open " + path);
+ }
+}
+
+static void cmd_profile_status(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack(std::string("ok profile_status active=") +
+  (MDFN_IEN_SS::Automation_ProfileIsActive() ? "true" : "false") +
+  " interval=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetInterval()) +
+  " master=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetSamples(0)) +
+  " slave=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetSamples(1)) +
+  " stacks=" + std::to_string(MDFN_IEN_SS::Automation_ProfileGetStacks()));
+}
+
+static void cmd_cache_stats_start(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CacheStatsStart();
+ write_ack("ok cache_stats_start");
+}
+
+static void cmd_cache_stats(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned top = 16;
+ iss >> std::dec >> top;
+ write_ack(std::string("ok cache_stats active=") + (MDFN_IEN_SS::Automation_CacheStatsIsActive() ? "true" : "false") +
+  "\n" + MDFN_IEN_SS::Automation_CacheStatsFormat(top));
+}
+
+static void cmd_cache_stats_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error cache_stats_dump: no path");
+ } else if (MDFN_IEN_SS::Automation_CacheStatsDump(path.c_str())) {
+  write_ack("ok cache_stats_dump " + path);
+ } else {
+  write_ack("error cache_stats_dump: cannot write " + path);
+ }
+}
+
+static void cmd_cache_stats_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CacheStatsStop();
+ write_ack("ok cache_stats_stop");
+}
+
+static void cmd_cache_mode(const std::string&, std::istringstream& iss, const std::string&)
+{
+ static const char* const names[] = { "assoc_purge", "ccr_purge", "alias", "smc" };
+ std::string sub, tok;
+ iss >> sub;
+ if (sub.empty()) {
+  write_ack("ok cache_mode " + MDFN_IEN_SS::Automation_CacheModeStatus());
+ } else if (sub == "detect" || sub == "off") {
+  unsigned mask = 0;
+  bool bad = false;
+  while (sub == "detect" && iss >> tok) {
+   unsigned i = 0;
+   while (i < 4 && tok != names[i])
+    i++;
+   if (i == 4) {
+    write_ack("error cache_mode: unknown trigger " + tok);
+    bad = true;
+    break;
+   }
+   mask |= 1U << i;
+  }
+  if (sub == "detect" && !mask)
+   mask = 0x1 | 0x4 | 0x8;
+  if (!bad) {
+   if (!MDFN_IEN_SS::Automation_CacheModeDetect(mask))
+    write_ack("error cache_mode: already full");
+   else
+    write_ack("ok cache_mode " + MDFN_IEN_SS::Automation_CacheModeStatus());
+  }
+ } else if (sub == "full") {
+  MDFN_IEN_SS::Automation_CacheModeFull();
+  write_ack("ok cache_mode full_pending " + MDFN_IEN_SS::Automation_CacheModeStatus());
+ } else {
+  write_ack("error cache_mode: expected detect, off or full");
+ }
+}
+
+static void cmd_bus_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (bus_profile_log) {
+  fclose(bus_profile_log);
+  bus_profile_log = nullptr;
+ }
+ if (!path.empty() && !(bus_profile_log = fopen(path.c_str(), "w"))) {
+  write_ack("error bus_profile_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_BusProfileStart();
+  bus_profile_on = true;
+  write_ack(path.empty() ? std::string("ok bus_profile_start") : "ok bus_profile_start " + path);
+ }
+}
+
+static void cmd_bus_profile(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!bus_profile_on) {
+  write_ack("error bus_profile: not started");
+ } else {
+  write_ack("ok bus_profile frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_BusProfileFormat(mode == "total"));
+ }
+}
+
+static void cmd_event_stats(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (mode == "reset") {
+  MDFN_IEN_SS::Automation_EventStatsReset();
+  write_ack("ok event_stats reset");
+ } else if (!mode.empty() && mode != "total") {
+  write_ack("error event_stats: expected total or reset");
+ } else {
+  write_ack("ok event_stats frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_EventStatsFormat(mode == "total"));
+ }
+}
+
+static void cmd_bus_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_BusProfileStop();
+ bus_profile_on = false;
+ if (bus_profile_log) {
+  fclose(bus_profile_log);
+  bus_profile_log = nullptr;
+ }
+ write_ack("ok bus_profile_stop");
+}
+
+static void cmd_int_latency_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (int_latency_log) {
+  fclose(int_latency_log);
+  int_latency_log = nullptr;
+ }
+ if (!path.empty() && !(int_latency_log = fopen(path.c_str(), "w"))) {
+  write_ack("error int_latency_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_IntLatencyStart();
+  int_latency_on = true;
+  write_ack(path.empty() ? std::string("ok int_latency_start") : "ok int_latency_start " + path);
+ }
+}
+
+static void cmd_int_latency(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!int_latency_on) {
+  write_ack("error int_latency: not started");
+ } else {
+  write_ack("ok int_latency frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_IntLatencyFormat(mode == "total"));
+ }
+}
+
+static void cmd_int_latency_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error int_latency_dump: expected <path>");
+ } else if (!int_latency_on) {
+  write_ack("error int_latency_dump: not started");
+ } else if (!MDFN_IEN_SS::Automation_IntLatencyDump(path.c_str())) {
+  write_ack("error int_latency_dump: cannot write " + path);
+ } else {
+  write_ack("ok int_latency_dump " + path);
+ }
+}
+
+static void cmd_int_latency_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_IntLatencyStop();
+ int_latency_on = false;
+ if (int_latency_log) {
+  fclose(int_latency_log);
+  int_latency_log = nullptr;
+ }
+ write_ack("ok int_latency_stop");
+}
+
+static void cmd_sync_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (sync_profile_log) {
+  fclose(sync_profile_log);
+  sync_profile_log = nullptr;
+ }
+ if (!path.empty() && !(sync_profile_log = fopen(path.c_str(), "w"))) {
+  write_ack("error sync_profile_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_SyncProfileStart();
+  sync_profile_on = true;
+  write_ack(path.empty() ? std::string("ok sync_profile_start") : "ok sync_profile_start " + path);
+ }
+}
+
+static void cmd_sync_profile(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!sync_profile_on) {
+  write_ack("error sync_profile: not started");
+ } else {
+  write_ack("ok sync_profile frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_SyncProfileFormat(mode == "total"));
+ }
+}
+
+static void cmd_sync_profile_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ unsigned top = 0;
+ iss >> path >> top;
+ if (path.empty()) {
+  write_ack("error sync_profile_dump: expected <path> [top]");
+ } else if (!sync_profile_on) {
+  write_ack("error sync_profile_dump: not started");
+ } else if (!MDFN_IEN_SS::Automation_SyncProfileDump(path.c_str(), top)) {
+  write_ack("error sync_profile_dump: cannot write " + path);
+ } else {
+  write_ack("ok sync_profile_dump " + path);
+ }
+}
+
+static void cmd_sync_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_SyncProfileStop();
+ sync_profile_on = false;
+ if (sync_profile_log) {
+  fclose(sync_profile_log);
+  sync_profile_log = nullptr;
+ }
+ write_ack("ok sync_profile_stop");
+}
+
+static void cmd_fb_hash_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ bool all = false;
+ while (iss >> tok) {
+  if (tok == "all")
+   all = true;
+  else
+   path = tok;
+ }
+ if (fb_hash_log) {
+  fclose(fb_hash_log);
+  fb_hash_log = nullptr;
+ }
+ if (!path.empty() && !(fb_hash_log = fopen(path.c_str(), "w"))) {
+  write_ack("error fb_hash_start: cannot open " + path);
+ } else {
+  fb_hash_on = true;
+  fb_hash_all = all;
+  fb_hash_value = 0;
+  fb_hash_frame = 0;
+  write_ack(std::string("ok fb_hash_start") + (path.empty() ? "" : " " + path) + (all ? " all" : ""));
+ }
+}
+
+static void cmd_fb_hash_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ fb_hash_on = false;
+ fb_hash_all = false;
+ if (fb_hash_log) {
+  fclose(fb_hash_log);
+  fb_hash_log = nullptr;
+ }
+ write_ack("ok fb_hash_stop");
+}
+
+static void cmd_journal_record(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ if (path.empty()) {
+  write_ack("error journal_record: no path");
+ } else if (journal_file || journal_playing) {
+  write_ack("error journal_record: a journal is already being recorded or played");
+ } else if (ipb_play_file) {
+  write_ack("error journal_record: stop input_playback_bin first");
+ } else if (instruction_paused) {
+  write_ack("error journal_record: start at a frame boundary, not mid-frame");
+ } else if (!(journal_file = fopen(path.c_str(), "wb"))) {
+  write_ack("error journal_record: cannot open " + path);
+ } else {
+  try {
+   fwrite("MDFNJRN1", 1, 8, journal_file);
+   for (auto& in : journal_inputs)
+    in.clear();
+   journal_events = 0;
+   journal_frame_cycle = get_cycle();
+   journal_base_cycle = get_cycle();
+   journal_state();
+   write_ack("ok journal_record " + path + " frame=" + std::to_string(frame_counter) + " bytes=" + std::to_string(ftell(journal_file)));
+  } catch (std::exception& e) {
+   fclose(journal_file);
+   journal_file = nullptr;
+   write_ack(std::string("error journal_record: ") + e.what());
+  }
+ }
+}
+
+static void cmd_journal_play(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ FILE* f = nullptr;
+ if (path.empty()) {
+  write_ack("error journal_play: no path");
+ } else if (journal_file || journal_playing) {
+  write_ack("error journal_play: a journal is already being recorded or played");
+ } else if (!poke_triggers.empty()) {
+  write_ack("error journal_play: clear poke triggers first (their pokes are in the journal)");
+ } else if (ipb_play_file) {
+  write_ack("error journal_play: stop input_playback_bin first");
+ } else if (instruction_paused) {
+  write_ack("error journal_play: start at a frame boundary, not mid-frame");
+ } else if (!(f = fopen(path.c_str(), "rb"))) {
+  write_ack("error journal_play: cannot open " + path);
+ } else {
+  char magic[8];
+  journal_data.clear();
+  if (fread(magic, 1, 8, f) == 8 && !memcmp(magic, "MDFNJRN1", 8)) {
+   std::vector<uint8_t> buf(65536);
+   size_t n;
+   while ((n = fread(buf.data(), 1, buf.size(), f)) > 0)
+    journal_data.insert(journal_data.end(), buf.begin(), buf.begin() + n);
+  }
+  fclose(f);
+  if (journal_data.size() < Journal_HeaderSize || journal_data[12] != Journal_State) {
+   journal_data.clear();
+   write_ack("error journal_play: not a journal: " + path);
+   return;
+  }
+  for (auto& in : journal_inputs)
+   in.clear();
+  journal_pos = 0;
+  journal_events = 0;
+  journal_base_cycle = get_cycle();
+  journal_playing = true;
+  journal_apply();  // the starting state
+  if (journal_playing) {
+   frames_to_advance = -1;
+   run_to_frame_target = -1;
+   watchpoint_paused = false;
+   read_watchpoint_paused = false;
+   m68k_paused = false;
+   exception_paused = false;
+   instructions_to_step = -1;
+   slave_instructions_to_step = -1;
+   run_to_cycle_target = -1;
+   update_cpu_hook();
+   write_ack("ok journal_play " + path + " frame=" + std::to_string(frame_counter) + " bytes=" + std::to_string(journal_data.size() + 8));
+  }
+ }
+}
+
+static void cmd_journal_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (journal_file) {
+  uint8_t end[16];
+  MDFN_en64lsb(&end[0], frame_counter);
+  MDFN_en64lsb(&end[8], journal_digest());
+  journal_event(Journal_End, journal_flags(), end, sizeof(end));
+  const long bytes = ftell(journal_file);
+  const bool ok = !ferror(journal_file);
+  fclose(journal_file);
+  journal_file = nullptr;
+  if (ok)
+   write_ack("ok journal_stop frame=" + std::to_string(frame_counter) + " events=" + std::to_string(journal_events) + " bytes=" + std::to_string(bytes));
+  else
+   write_ack("error journal_stop: write error, journal is incomplete");
+ } else if (journal_playing) {
+  journal_play_end("ok journal_stop stopped=playback");
+ } else
+  write_ack("ok journal_stop");
+}
+
+static void cmd_diverge_record(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ std::string path;
+ uint64_t every = 1;
+ iss >> path;
+ if (cmd == "diverge_record" && !(iss >> every))
+  every = 1;
+ diverge_close();
+ if (path.empty() || !every) {
+  write_ack("error " + cmd + ": usage: diverge_record <path> [every_frames] | diverge_check <path>");
+  return;
+ }
+ const bool check = (cmd == "diverge_check");
+ uint8_t hdr[16];
+ const uint32_t sample_size = diverge_sample_size();
+ if (!(diverge_file = fopen(path.c_str(), check ? "rb" : "wb"))) {
+  write_ack("error " + cmd + ": cannot open " + path);
+  return;
+ }
+ if (check) {
+  uint32_t every32, size32;
+  if (fread(hdr, 1, sizeof(hdr), diverge_file) != sizeof(hdr) || memcmp(hdr, "MDFNDIV1", 8)) {
+   diverge_close();
+   write_ack("error diverge_check: not a divergence file: " + path);
+   return;
+  }
+  every32 = MDFN_de32lsb(&hdr[8]);
+  size32 = MDFN_de32lsb(&hdr[12]);
+  if (!every32 || size32 != sample_size) {
+   diverge_close();
+   write_ack("error diverge_check: sample layout mismatch in " + path);
+   return;
+  }
+  every = every32;
+ } else {
+  memcpy(hdr, "MDFNDIV1", 8);
+  MDFN_en32lsb(&hdr[8], (uint32_t)every);
+  MDFN_en32lsb(&hdr[12], sample_size);
+  fwrite(hdr, 1, sizeof(hdr), diverge_file);
+  setvbuf(diverge_file, NULL, _IONBF, 0);  // a concurrent check reads samples as they're written
+ }
+ diverge_checking = check;
+ diverge_every = every;
+ diverge_samples = 0;
+ write_ack("ok " + cmd + " " + path + " every=" + std::to_string(every));
+}
+
+static void cmd_state_hash(const std::string&, std::istringstream&, const std::string&)
+{
+ try {
+  write_ack("ok state_hash " + state_hash_line());
+ }
+ catch (std::exception& e) {
+  write_ack(std::string("error state_hash: ") + e.what());
+ }
+}
+
+static void cmd_state_hash_log(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ std::string path;
+ uint64_t every = 1;
+ iss >> path;
+ if (!(iss >> every))
+  every = 1;
+ state_hash_close();
+ if (path.empty() || !every) {
+  write_ack("error " + cmd + ": usage: " + cmd + " <path> [every_frames]");
+  return;
+ }
+ const bool check = (cmd == "state_hash_check");
+ if (!(state_hash_file = fopen(path.c_str(), check ? "r" : "w"))) {
+  write_ack("error " + cmd + ": cannot open " + path);
+  return;
+ }
+ if (!check)
+  setvbuf(state_hash_file, NULL, _IOLBF, 0);  // a concurrent check reads lines as they're written
+ state_hash_checking = check;
+ state_hash_every = every;
+ state_hash_lines = 0;
+ write_ack("ok " + cmd + " " + path + " every=" + std::to_string(every));
+}
+
+static void cmd_state_hash_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const bool was_checking = state_hash_checking;
+ const bool was_on = state_hash_file != nullptr;
+ state_hash_close();
+ write_ack(std::string("ok state_hash_stop") + (was_on ? (was_checking ? " checked=" : " logged=") + std::to_string(state_hash_lines) : ""));
+}
+
+static void cmd_diverge_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const bool was_checking = diverge_checking;
+ const bool was_on = diverge_file != nullptr;
+ diverge_close();
+ write_ack(std::string("ok diverge_stop") + (was_on ? (was_checking ? " checked=" : " recorded=") + std::to_string(diverge_samples) : ""));
+}
+
+static void cmd_vdp2_timing_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (vdp2_timing_log) {
+  fclose(vdp2_timing_log);
+  vdp2_timing_log = nullptr;
+ }
+ if (!path.empty() && !(vdp2_timing_log = fopen(path.c_str(), "w"))) {
+  write_ack("error vdp2_timing_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_VDP2TimingStart();
+  vdp2_timing_on = true;
+  write_ack(path.empty() ? std::string("ok vdp2_timing_start") : "ok vdp2_timing_start " + path);
+ }
+}
+
+static void cmd_perf_stats_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (perf_stats_log) {
+  fclose(perf_stats_log);
+  perf_stats_log = nullptr;
+ }
+ if (!path.empty() && !(perf_stats_log = fopen(path.c_str(), "w"))) {
+  write_ack("error perf_stats_start: cannot open " + path);
+ } else {
+  if (perf_stats_log)
+   fprintf(perf_stats_log, "frame,%s\n", MDFN_IEN_SS::Automation_PerfStatsCSV(true).c_str());
+  MDFN_IEN_SS::Automation_PerfStatsStart();
+  write_ack(path.empty() ? std::string("ok perf_stats_start") : "ok perf_stats_start " + path);
+ }
+}
+
+static void cmd_perf_stats(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!MDFN_IEN_SS::Automation_PerfStatsIsActive()) {
+  write_ack("error perf_stats: not started");
+ } else {
+  write_ack("ok perf_stats frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_PerfStatsFormat(mode == "total"));
+ }
+}
+
+static void cmd_perf_stats_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_PerfStatsStop();
+ if (perf_stats_log) {
+  fclose(perf_stats_log);
+  perf_stats_log = nullptr;
+ }
+ write_ack("ok perf_stats_stop");
+}
+
+static void cmd_frame_pacing(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ write_ack("ok frame_pacing frame=" + std::to_string(frame_counter) + " " + FPS_TimeStats(mode == "hist"));
+}
+
+static void cmd_frame_pacing_reset(const std::string&, std::istringstream&, const std::string&)
+{
+ FPS_ResetTimes();
+ write_ack("ok frame_pacing_reset");
+}
+
+static void cmd_vdp2_timing(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!vdp2_timing_on) {
+  write_ack("error vdp2_timing: not started");
+ } else {
+  write_ack("ok vdp2_timing frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_VDP2TimingFormat(mode == "total"));
+ }
+}
+
+static void cmd_vdp2_preview(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (mode == "on" || mode == "off")
+  MDFN_IEN_SS::Automation_VDP2SetPreview(mode == "on");
+ else if (!mode.empty()) {
+  write_ack("error vdp2_preview: usage: vdp2_preview [on|off]");
+  return;
+ }
+ write_ack(std::string("ok vdp2_preview ") + (MDFN_IEN_SS::Automation_VDP2PreviewIsActive() ? "on" : "off"));
+}
+
+static void cmd_vdp2_timing_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_VDP2TimingStop();
+ vdp2_timing_on = false;
+ if (vdp2_timing_log) {
+  fclose(vdp2_timing_log);
+  vdp2_timing_log = nullptr;
+ }
+ FPS_SetAuxText("");
+ write_ack("ok vdp2_timing_stop");
+}
+
+static void cmd_vdp1_stats_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (vdp1_stats_log) {
+  fclose(vdp1_stats_log);
+  vdp1_stats_log = nullptr;
+ }
+ if (!path.empty() && !(vdp1_stats_log = fopen(path.c_str(), "w"))) {
+  write_ack("error vdp1_stats_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_VDP1StatsStart();
+  write_ack(path.empty() ? std::string("ok vdp1_stats_start") : "ok vdp1_stats_start " + path);
+ }
+}
+
+static void cmd_vdp1_stats(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string mode;
+ iss >> mode;
+ if (!MDFN_IEN_SS::Automation_VDP1StatsIsActive()) {
+  write_ack("error vdp1_stats: not started");
+ } else {
+  write_ack("ok vdp1_stats frame=" + std::to_string(frame_counter) + (mode == "total" ? " total" : "") +
+   MDFN_IEN_SS::Automation_VDP1StatsFormat(mode == "total"));
+ }
+}
+
+static void cmd_vdp1_stats_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_VDP1StatsStop();
+ if (vdp1_stats_log) {
+  fclose(vdp1_stats_log);
+  vdp1_stats_log = nullptr;
+ }
+ write_ack("ok vdp1_stats_stop");
+}
+
+static void cmd_vdp1_cmd_stats_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (vdp1_cmd_stats_log) {
+  fclose(vdp1_cmd_stats_log);
+  vdp1_cmd_stats_log = nullptr;
+ }
+ if (!path.empty() && !(vdp1_cmd_stats_log = fopen(path.c_str(), "w"))) {
+  write_ack("error vdp1_cmd_stats_start: cannot open " + path);
+ } else {
+  MDFN_IEN_SS::Automation_VDP1CmdStatsStart();
+  write_ack(path.empty() ? std::string("ok vdp1_cmd_stats_start") : "ok vdp1_cmd_stats_start " + path);
+ }
+}
+
+static void cmd_vdp1_cmd_stats(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned n = 0;
+ iss >> n;
+ if (!MDFN_IEN_SS::Automation_VDP1CmdStatsIsActive()) {
+  write_ack("error vdp1_cmd_stats: not started");
+ } else {
+  std::string lines = MDFN_IEN_SS::Automation_VDP1CmdStatsFormat(n, "");
+  if (!lines.empty() && lines.back() == '\n')
+   lines.pop_back();
+  write_ack("ok vdp1_cmd_stats frame=" + std::to_string(frame_counter) + " commands=" +
+   std::to_string(MDFN_IEN_SS::Automation_VDP1CmdStatsCount()) + (lines.empty() ? "" : "\n" + lines));
+ }
+}
+
+static void cmd_vdp1_cmd_stats_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_VDP1CmdStatsStop();
+ if (vdp1_cmd_stats_log) {
+  fclose(vdp1_cmd_stats_log);
+  vdp1_cmd_stats_log = nullptr;
+ }
+ write_ack("ok vdp1_cmd_stats_stop");
+}
+
+static void cmd_vdp1_cmd_break(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ uint32_t addr = 0xFFFFFFFF;
+ std::string token;
+ iss >> std::hex >> addr >> token;
+ if (addr >= 0x25C00000 && addr < 0x25C80000)
+  addr -= 0x25C00000;
+ char buf[96];
+ if (addr > 0x7FFFF || (addr & 0x1F)) {
+  write_ack("error " + cmd + ": usage: " + cmd + " <32-byte aligned VDP1 VRAM offset or 0x25C0xxxx address>");
+ } else if (cmd == "vdp1_cmd_break") {
+  vdp1_cmd_breaks[addr] = (token == "log");
+  MDFN_IEN_SS::Automation_VDP1CmdBreakAdd(addr);
+  snprintf(buf, sizeof(buf), "ok vdp1_cmd_break 0x%05X total=%zu%s", addr, vdp1_cmd_breaks.size(), token == "log" ? " log" : "");
+  write_ack(buf);
+ } else if (!vdp1_cmd_breaks.erase(addr)) {
+  snprintf(buf, sizeof(buf), "error vdp1_cmd_break_remove: not found 0x%05X", addr);
+  write_ack(buf);
+ } else {
+  MDFN_IEN_SS::Automation_VDP1CmdBreakRemove(addr);
+  snprintf(buf, sizeof(buf), "ok vdp1_cmd_break_remove 0x%05X total=%zu", addr, vdp1_cmd_breaks.size());
+  write_ack(buf);
+ }
+}
+
+static void cmd_vdp1_cmd_break_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = vdp1_cmd_breaks.size();
+ vdp1_cmd_breaks.clear();
+ MDFN_IEN_SS::Automation_VDP1CmdBreakClear();
+ write_ack("ok vdp1_cmd_break_clear removed=" + std::to_string(count));
+}
+
+static void cmd_vdp1_cmd_break_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::string ack = "vdp1_cmd_breaks count=" + std::to_string(vdp1_cmd_breaks.size());
+ for (const auto& b : vdp1_cmd_breaks) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), " 0x%05X%s", b.first, b.second ? ":log" : "");
+  ack += buf;
+ }
+ write_ack(ack);
+}
+
+static void cmd_m68k_break(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ uint32_t addr;
+ std::string mode;
+ if (!(iss >> std::hex >> addr)) {
+  write_ack("error " + cmd + ": expected address");
+ } else if (cmd == "m68k_break_remove") {
+  const bool had = m68k_breaks.erase(addr & 0x7FFFF) != 0;
+  m68k_update_hooks();
+  char buf[64];
+  snprintf(buf, sizeof(buf), had ? "ok m68k_break_remove 0x%05X" : "error m68k_break_remove: 0x%05X not set", addr & 0x7FFFF);
+  write_ack(buf);
+ } else {
+  iss >> mode;
+  addr &= 0x7FFFF;	// sound RAM, where the 68K runs from
+  m68k_breaks[addr] = (mode == "log");
+  m68k_update_hooks();
+  char buf[64];
+  snprintf(buf, sizeof(buf), "ok m68k_break 0x%05X%s", addr, mode == "log" ? " log" : "");
+  write_ack(buf);
+ }
+}
+
+static void cmd_m68k_break_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = m68k_breaks.size();
+ m68k_breaks.clear();
+ m68k_update_hooks();
+ write_ack("ok m68k_break_clear count=" + std::to_string(count));
+}
+
+static void cmd_m68k_break_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::string ack = "m68k_breaks count=" + std::to_string(m68k_breaks.size());
+ for (const auto& b : m68k_breaks) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), " 0x%05X%s", b.first, b.second ? ":log" : "");
+  ack += buf;
+ }
+ write_ack(ack);
+}
+
+static void cmd_m68k_step(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // m68k_step [N]: resume and pause before the Nth 68K instruction from here.
+ // Runs the whole machine; it ends wherever the sound CPU gets there.
+ int64_t n = 1;
+ iss >> n;
+ if (n < 1) n = 1;
+ m68k_to_step = n;
+ m68k_update_hooks();
+ run_to_line_cancel();
+ frames_to_advance = -1;
+ instruction_paused = false;
+ watchpoint_paused = false;
+ read_watchpoint_paused = false;
+ exception_paused = false;
+ m68k_paused = false;
+ // No ack: the hook sends "done m68k_step ..." (or a breakpoint's ack)
+}
+
+static void cmd_m68k_regs(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack(m68k_format_regs());
+}
+
+static void cmd_m68k_watch(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // m68k_watch <addr> [len] [log]: sound RAM writes by the 68K that change a byte in range
+ M68KWatch w = { 0, 2, false };
+ std::string tok;
+ if (!(iss >> std::hex >> w.addr)) {
+  write_ack("error m68k_watch: expected address");
+ } else {
+  while (iss >> tok) {
+   if (tok == "log")
+    w.log_mode = true;
+   else
+    w.len = strtoul(tok.c_str(), nullptr, 16);
+  }
+  w.addr &= 0x7FFFF;
+  if (!w.len) w.len = 1;
+  m68k_watches.push_back(w);
+  m68k_update_hooks();
+  char buf[80];
+  snprintf(buf, sizeof(buf), "ok m68k_watch 0x%05X len=0x%X%s count=%zu", w.addr, w.len, w.log_mode ? " log" : "", m68k_watches.size());
+  write_ack(buf);
+ }
+}
+
+static void cmd_m68k_watch_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = m68k_watches.size();
+ m68k_watches.clear();
+ m68k_update_hooks();
+ write_ack("ok m68k_watch_clear count=" + std::to_string(count));
+}
+
+static void cmd_m68k_call_trace(const std::string& line, std::istringstream& iss, const std::string&)
+{
+ // m68k_call_trace <path> | stop: one "cycle C|R site target" line per JSR/BSR or RTS/RTE/RTR
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error m68k_call_trace: expected path or stop");
+ } else if (path == "stop") {
+  if (m68k_call_trace) { fclose(m68k_call_trace); m68k_call_trace = nullptr; }
+  m68k_trace_kind = 0;
+  m68k_update_hooks();
+  write_ack("ok m68k_call_trace stopped");
+ } else {
+  if (m68k_call_trace) fclose(m68k_call_trace);
+  m68k_call_trace = fopen(path.c_str(), "w");
+  m68k_trace_kind = 0;
+  m68k_update_hooks();
+  if (!m68k_call_trace)
+   write_ack("error m68k_call_trace: cannot open " + path);
+  else {
+   fprintf(m68k_call_trace, "# cycle kind site target (C = JSR/BSR, R = RTS/RTE/RTR)\n");
+   write_ack("ok m68k_call_trace " + path);
+  }
+ }
+}
+
+static void cmd_scsp_capture(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ bool raw = false;
+ while (iss >> tok) {
+  if (tok == "raw")
+   raw = true;
+  else
+   path = tok;
+ }
+ if (path.empty())
+  write_ack("error scsp_capture: usage: scsp_capture <path> [raw]");
+ else if (!MDFN_IEN_SS::Automation_SCSPCaptureStart(path.c_str(), raw))
+  write_ack("error scsp_capture: cannot open " + path);
+ else
+  write_ack("ok scsp_capture " + path + (raw ? " raw" : ""));
+}
+
+static void cmd_scsp_capture_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t totals[2];
+ std::string path;
+ if (!MDFN_IEN_SS::Automation_SCSPCaptureIsActive()) {
+  write_ack("error scsp_capture_stop: not capturing");
+  return;
+ }
+ const uint64_t dropped = MDFN_IEN_SS::Automation_SCSPCaptureStop(totals, &path);
+ write_ack("ok scsp_capture_stop " + path + " samples=" + std::to_string(totals[0]) +
+           " keys=" + std::to_string(totals[1]) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_vdp1_capture_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error vdp1_capture_start: expected path");
+ } else if (!MDFN_IEN_SS::Automation_VDP1CaptureStart(path.c_str())) {
+  write_ack("error vdp1_capture_start: cannot open " + path);
+ } else {
+  write_ack("ok vdp1_capture_start " + path);
+ }
+}
+
+static void cmd_vdp1_capture_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const uint32 frames = MDFN_IEN_SS::Automation_VDP1CaptureStop();
+ write_ack("ok vdp1_capture_stop frames=" + std::to_string(frames) +
+  " dropped=" + std::to_string(MDFN_IEN_SS::Automation_VDP1CaptureDropped()));
+}
+
+static void cmd_vdp1_bench(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, report;
+ unsigned repeat = 1;
+ iss >> path >> repeat;
+ if (path.empty()) {
+  write_ack("error vdp1_bench: expected path");
+ } else if (!MDFN_IEN_SS::Automation_VDP1Bench(path.c_str(), repeat, &report)) {
+  write_ack("error vdp1_bench: " + report);
+ } else {
+  write_ack("ok vdp1_bench" + report);
+ }
+}
+
+static void cmd_nv_dump(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ std::string path, which, err;
+ iss >> path >> which;
+ if (path.empty() || (!which.empty() && which != "cart")) {
+  write_ack("error " + cmd + ": usage: " + cmd + " <path> [cart]");
+ } else if (!(cmd == "nv_dump" ? MDFN_IEN_SS::Automation_NVDump : MDFN_IEN_SS::Automation_NVLoad)(path.c_str(), which == "cart", &err)) {
+  write_ack("error " + cmd + ": " + err);
+ } else {
+  write_ack("ok " + cmd + " " + path);
+ }
+}
+
+static void cmd_sh2_bench(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string kernel, path, tok, report;
+ uint64 insns = 20000000;
+ uint32 at = 0x00200000;
+ unsigned icache_mask = 3;
+ bool bad = false;
+ iss >> kernel;
+ if (kernel.compare(0, 5, "file=") == 0) {
+  path = kernel.substr(5);
+  kernel = "file";
+ }
+ while (iss >> tok) {
+  if (tok.compare(0, 6, "insns=") == 0)
+   insns = strtoull(tok.c_str() + 6, nullptr, 0);
+  else if (tok.compare(0, 3, "at=") == 0)
+   at = strtoul(tok.c_str() + 3, nullptr, 0);
+  else if (tok == "icache=off")
+   icache_mask = 1;
+  else if (tok == "icache=on")
+   icache_mask = 2;
+  else if (tok == "icache=both")
+   icache_mask = 3;
+  else
+   bad = true;
+ }
+ if (bad || kernel.empty()) {
+  write_ack("error sh2_bench: usage: sh2_bench <alu|branch|mac|cache|div|file=<path>> [insns=N] [icache=on|off|both] [at=ADDR]");
+ } else if (!history_at_frame_boundary()) {
+  write_ack("error sh2_bench: only at a frame boundary");
+ } else {
+  MemoryStream ms(snapshot_size_hint);
+  bool ok;
+  MDFNSS_SaveSM(&ms, true);
+  ok = MDFN_IEN_SS::Automation_SH2Bench(kernel.c_str(), path.c_str(), at, insns, icache_mask, &report);
+  ms.rewind();
+  MDFNSS_LoadSM(&ms, true);
+  write_ack((ok ? "ok sh2_bench" : "error sh2_bench: ") + report);
+ }
+}
+
+static void cmd_vdp2_capture_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ uint32 frames = 60;
+ iss >> path >> frames;
+ if (path.empty()) {
+  write_ack("error vdp2_capture_start: expected path");
+ } else if (!MDFN_IEN_SS::Automation_VDP2CaptureStart(path.c_str(), frames)) {
+  write_ack("error vdp2_capture_start: cannot open " + path);
+ } else {
+  write_ack("ok vdp2_capture_start " + path + " frames=" + std::to_string(frames));
+ }
+}
+
+static void cmd_vdp2_capture_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ const uint32 frames = MDFN_IEN_SS::Automation_VDP2CaptureStop();
+ write_ack("ok vdp2_capture_stop frames=" + std::to_string(frames));
+}
+
+static void cmd_vdp2_layer_capture(const CmdArgs& args)
+{
+ const std::string& path = args.s("path");
+ if (!MDFN_IEN_SS::Automation_VDP2LayerCaptureStart(path.c_str()))
+  write_ack("error vdp2_layer_capture: cannot open " + path);
+ else
+  write_ack("ok vdp2_layer_capture " + path);
+}
+
+static void cmd_vdp2_layer_capture_cancel(const std::string&, std::istringstream&, const std::string&)
+{
+ const bool pending = MDFN_IEN_SS::Automation_VDP2LayerCaptureIsPending();
+ MDFN_IEN_SS::Automation_VDP2LayerCaptureStop();
+ write_ack(std::string("ok vdp2_layer_capture_cancel pending=") + (pending ? "1" : "0"));
+}
+
+static void cmd_vdp2_bench(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, report;
+ unsigned repeat = 1;
+ iss >> path >> repeat;
+ if (path.empty()) {
+  write_ack("error vdp2_bench: expected path");
+ } else if (!MDFN_IEN_SS::Automation_VDP2Bench(path.c_str(), repeat, &report)) {
+  write_ack("error vdp2_bench: " + report);
+ } else {
+  write_ack("ok vdp2_bench" + report);
+ }
+}
+
+static void cmd_func_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string which = "both";
+ iss >> which;
+ const unsigned mask = (which == "master") ? 1 : (which == "slave") ? 2 : (which == "both") ? 3 : 0;
+ if (!mask) {
+  write_ack("error func_profile_start: expected master, slave or both");
+ } else {
+  MDFN_IEN_SS::Automation_FuncProfileStart(mask);
+  write_ack("ok func_profile_start cpu=" + which);
+ }
+}
+
+static void cmd_func_profile_reset(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_FuncProfileReset();
+ write_ack("ok func_profile_reset");
+}
+
+static void cmd_func_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_FuncProfileStop();
+ write_ack("ok func_profile_stop functions=" + std::to_string(MDFN_IEN_SS::Automation_FuncProfileGetFuncs()));
+}
+
+static void cmd_func_profile_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ unsigned top = 0;
+ iss >> path >> std::dec >> top;
+ if (path.empty()) {
+  write_ack("error func_profile_dump: no path");
+ } else if (MDFN_IEN_SS::Automation_FuncProfileDump(path.c_str(), top)) {
+  write_ack("ok func_profile_dump " + path + " functions=" + std::to_string(MDFN_IEN_SS::Automation_FuncProfileGetFuncs()));
+ } else {
+  write_ack("error func_profile_dump: cannot open " + path);
+ }
+}
+
+static void cmd_flight_rec_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // flight_rec_start [entries=N] [mem] [master|slave|both] [auto=off|<path>]
+ std::string tok, which = "both";
+ size_t entries = 65536;
+ bool mem = false, bad = false;
+ flight_rec_auto = true;
+ flight_rec_path = auto_base_dir + "/flight_rec.txt";
+ while (iss >> tok) {
+  if (tok == "mem")
+   mem = true;
+  else if (tok == "master" || tok == "slave" || tok == "both")
+   which = tok;
+  else if (tok.compare(0, 8, "entries=") == 0)
+   entries = strtoull(tok.c_str() + 8, nullptr, 0);
+  else if (tok == "auto=off")
+   flight_rec_auto = false;
+  else if (tok.compare(0, 5, "auto=") == 0 && tok.size() > 5)
+   flight_rec_path = tok.substr(5);
+  else
+   bad = true;
+ }
+ if (bad || entries < 1 || entries > (1U << 24)) {
+  write_ack("error flight_rec_start: usage: flight_rec_start [entries=1..16777216] [mem] [master|slave|both] [auto=off|<path>]");
+ } else {
+  MDFN_IEN_SS::Automation_FlightRecStart(entries, (which == "master") ? 1 : (which == "slave") ? 2 : 3, mem);
+  write_ack("ok flight_rec_start cpu=" + which + " entries=" + std::to_string(entries) + (mem ? " mem" : "")
+   + " auto=" + (flight_rec_auto ? flight_rec_path : std::string("off")));
+ }
+}
+
+static void cmd_flight_rec_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_FlightRecStop();
+ flight_rec_auto = false;
+ write_ack("ok flight_rec_stop");
+}
+
+static void cmd_flight_rec_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ size_t last = 0;
+ iss >> path >> std::dec >> last;
+ if (path.empty()) {
+  write_ack("error flight_rec_dump: usage: flight_rec_dump <path> [last]");
+ } else if (!MDFN_IEN_SS::Automation_FlightRecActive()) {
+  write_ack("error flight_rec_dump: not recording (use flight_rec_start)");
+ } else {
+  const int64 lines = MDFN_IEN_SS::Automation_FlightRecDump(path.c_str(), last);
+  if (lines < 0)
+   write_ack("error flight_rec_dump: cannot open " + path);
+  else
+   write_ack("ok flight_rec_dump " + path + " lines=" + std::to_string(lines));
+ }
+}
+
+// Crash bundle thumbnail: the frame on screen now (the live frame inside Poll, else the
+// cached copy), downscaled to at most crash_thumb_w wide and compressed on crash_png's
+// thread. False if there's no frame yet.
+static bool crash_bundle_thumb(const std::string& path)
+{
+ const MDFN_Surface* surface = live_fb_surface;
+ const int32* lw = live_fb_lw;
+ std::unique_ptr<MDFN_Surface> tmp;
+ MDFN_Rect rect;
+ std::string err;
+
+ if (surface) {
+  rect = *live_fb_rect;
+ } else if (cached_fb_valid && cached_fb_pixels) {
+  tmp.reset(new MDFN_Surface(cached_fb_pixels, cached_fb_w, cached_fb_h, cached_fb_pitch, cached_fb_format));
+  surface = tmp.get();
+  rect = cached_fb_rect;
+  lw = cached_fb_lw;
+ } else {
+  return false;
+ }
+
+ std::vector<int32> widths(surface->h, 0);
+ const bool use_lw = lw && lw[0] != ~0;
+ int32 max_w = 0;
+ for (int32 y = rect.y; y < rect.y + rect.h; y++) {
+  widths[y] = use_lw ? lw[y] : rect.w;
+  max_w = std::max<int32>(max_w, widths[y]);
+ }
+ if (max_w <= 0 || rect.h <= 0)
+  return false;
+ if (!crash_png && !(crash_png = FrameDump::Open(std::string(), FrameDump::FMT_PNG, false, 1, &err)))
+  return false;
+
+ const int32 down = std::max<int32>(1, (max_w + crash_thumb_w - 1) / crash_thumb_w);
+ MDFN_Rect dr;
+ dr.x = dr.y = 0;
+ dr.w = std::max<int32>(1, (max_w + down - 1) / down);
+ dr.h = std::max<int32>(1, (rect.h + down - 1) / down);
+ MDFN_Surface small(NULL, dr.w, dr.h, dr.w, surface->format);
+ MDFN_ResizeSurface(surface, &rect, widths.data(), &small, &dr);
+ crash_png->Submit(frame_counter, &small, dr, nullptr, path);
+ return true;
+}
+
+// Crash bundle state: SaveSM to memory now, gzipped to <dir>/state.mcs in the background
+// like save_state; the event names the file once it's complete.
+static void crash_bundle_state(const std::string& dir)
+{
+ try {
+  std::unique_ptr<MemoryStream> ms(new MemoryStream(65536));
+  MDFNSS_SaveSM(ms.get());
+  MDFNSS_WriteAsync(std::move(ms), dir + "/state.mcs", 6, [](const std::string& p, const std::string& error) {
+   push_event(error.empty() ? "crash_bundle_state " + p : "crash_bundle_state error " + error);
+  });
+ } catch (std::exception& e) {
+  push_event(std::string("crash_bundle_state error ") + e.what());
+ }
+}
+
+// Writes <crash_dir>/crash_<frame>_<kind>/: info.txt (reason, both CPUs' registers and
+// shadow call stacks), flight_rec.txt if the flight recorder is on, events.txt (recent
+// DMA and CD Block events), thumb.png and state.mcs. Inside an instruction (frame_end
+// false) the state can't be taken, so it follows at the end of the frame, with the
+// thumbnail too if there was no frame yet. Returns the directory, empty once crash_max
+// bundles have been written since crash_bundle or on an error.
+static std::string crash_bundle_write(const char* kind, const std::string& reason, bool frame_end)
+{
+ if (crash_written >= crash_max) {
+  crash_skipped++;
+  return "";
+ }
+ crash_written++;
+
+ const std::string dir = crash_dir + "/crash_" + std::to_string(frame_counter) + "_" + kind;
+ FILE* fp = nullptr;
+ try {
+  NVFS.mkdir(dir, false);
+ } catch (std::exception& e) {
+  push_event(std::string("crash_bundle error ") + e.what());
+  return "";
+ }
+ if (!(fp = fopen((dir + "/info.txt").c_str(), "w"))) {
+  push_event("crash_bundle error cannot write " + dir + "/info.txt");
+  return "";
+ }
+
+ const time_t now = time(nullptr);
+ char when[32];
+ strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&now));
+ fprintf(fp, "# crash bundle\nreason=%s\nframe=%llu cycle=%lld host_time=%s\n", reason.c_str(),
+  (unsigned long long)frame_counter, (long long)get_cycle(), when);
+ fprintf(fp, "%s\n%s\n%s\n%s\n", MDFN_IEN_SS::Automation_DumpRegs().c_str(), MDFN_IEN_SS::Automation_DumpSlaveRegs().c_str(),
+  MDFN_IEN_SS::Automation_CallStackCPU(0).c_str(), MDFN_IEN_SS::Automation_CallStackCPU(1).c_str());
+
+ std::string files = "info.txt";
+ if (MDFN_IEN_SS::Automation_FlightRecActive() && MDFN_IEN_SS::Automation_FlightRecDump((dir + "/flight_rec.txt").c_str(), 0) >= 0)
+  files += " flight_rec.txt";
+ if (MDFN_IEN_SS::Automation_RecentEventsDump((dir + "/events.txt").c_str()) >= 0)
+  files += " events.txt";
+
+ bool thumb = false;
+ try {
+  thumb = crash_bundle_thumb(dir + "/thumb.png");
+ } catch (std::exception& e) {
+  fprintf(fp, "thumb_error=%s\n", e.what());
+ }
+ if (thumb)
+  files += " thumb.png";
+
+ if (frame_end) {
+  crash_bundle_state(dir);
+  files += " state.mcs";
+ } else {
+  crash_pending.push_back(CrashPending{ dir, !thumb });
+  files += " state.mcs(end of frame)";
+  if (!thumb)
+   files += " thumb.png(end of frame)";
+ }
+ fprintf(fp, "files=%s\n", files.c_str());
+ fclose(fp);
+
+ fprintf(stderr, "Automation: crash bundle %s (%s)\n", dir.c_str(), reason.c_str());
+ push_event("crash_bundle " + dir + " kind=" + kind);
+ return dir;
+}
+
+// Poll: states waiting for the frame end, the bundle for a frame the watchdog saw stall,
+// and the VBlank-IN check.
+static void crash_bundle_frame(void)
+{
+ for (const CrashPending& p : crash_pending) {
+  crash_bundle_state(p.dir);
+  if (p.thumb) {
+   try {
+    crash_bundle_thumb(p.dir + "/thumb.png");
+   } catch (std::exception&) {
+   }
+  }
+ }
+ crash_pending.clear();
+
+ if (crash_hang_ms) {
+  const int64_t now = Time::MonoUS() / 1000;
+  const int64_t took = now - crash_alive_ms.load();
+  if (crash_stalled_ms.exchange(0))
+   crash_bundle_write("hang", "hang frame took " + std::to_string(took) + " ms of host time (limit "
+                      + std::to_string(crash_hang_ms) + " ms)", true);
+  crash_alive_frame.store(frame_counter);
+  crash_alive_ms.store(now);
+ }
+
+ if (crash_vblank_frames) {
+  const uint64_t vb = MDFN_IEN_SS::Automation_VBlankInTaken();
+  if (vb != crash_vbin_last || frame_counter < crash_vbin_frame) {
+   crash_vbin_last = vb;
+   crash_vbin_frame = frame_counter;
+  } else if (frame_counter - crash_vbin_frame == crash_vblank_frames) {
+   char buf[96];
+   snprintf(buf, sizeof(buf), "vblank no VBlank-IN taken for %llu frames master_sr=0x%08X",
+            (unsigned long long)crash_vblank_frames, (unsigned)MDFN_IEN_SS::Automation_GetMasterSR());
+   crash_bundle_write("vblank", buf, true);
+  }
+ }
+}
+
+// Watchdog thread: a frame that hasn't ended (and no paused wait) for crash_hang_ms. The
+// emulation thread is somewhere inside the frame, so only a note can be written from
+// here; crash_bundle_frame writes the bundle if the frame ever completes.
+static int crash_watchdog_main(void*)
+{
+ while (!crash_watchdog_exit.load()) {
+  Time::SleepMS(100);
+  const int64_t stalled = Time::MonoUS() / 1000 - crash_alive_ms.load();
+  if (stalled < crash_hang_ms || crash_stalled_ms.load())
+   continue;
+  crash_stalled_ms.store(stalled);
+
+  const unsigned long long frame = crash_alive_frame.load();
+  const std::string path = crash_watchdog_dir + "/hang_" + std::to_string(frame) + ".txt";
+  FILE* fp = fopen(path.c_str(), "w");
+  if (fp) {
+   fprintf(fp, "# crash bundle watchdog\nno frame completed for %lld ms after frame %llu\n", (long long)stalled, frame);
+   fclose(fp);
+  }
+  fprintf(stderr, "Automation: crash_bundle: no frame completed for %lld ms after frame %llu\n", (long long)stalled, frame);
+ }
+ return 0;
+}
+
+static void crash_bundle_disarm(void)
+{
+ if (crash_watchdog) {
+  crash_watchdog_exit.store(true);
+  MThreading::Thread_Wait(crash_watchdog, nullptr);
+  crash_watchdog = nullptr;
+  crash_watchdog_exit.store(false);
+ }
+ delete crash_png;  // waits for queued thumbnails
+ crash_png = nullptr;
+ if (MDFN_IEN_SS::Automation_RecentEventsActive())
+  MDFN_IEN_SS::Automation_RecentEventsStop();
+ crash_dir.clear();
+ crash_on_exception = false;
+ crash_hang_ms = 0;
+ crash_vblank_frames = 0;
+ crash_pending.clear();
+ crash_stalled_ms.store(0);
+}
+
+static std::string crash_bundle_status(void)
+{
+ if (crash_dir.empty())
+  return " off";
+ std::string s = " dir=" + crash_dir + (crash_on_exception ? " exception" : "");
+ if (crash_hang_ms)
+  s += " hang=" + std::to_string(crash_hang_ms) + "ms";
+ if (crash_vblank_frames)
+  s += " vblank=" + std::to_string(crash_vblank_frames);
+ return s + " max=" + std::to_string(crash_max) + " written=" + std::to_string(crash_written)
+        + " skipped=" + std::to_string(crash_skipped);
+}
+
+static void cmd_crash_bundle(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // crash_bundle [<dir> [exception] [hang=<sec>] [vblank=<frames>] [max=N] [thumb=<w>] | off]
+ std::string dir, tok;
+ bool exc = false, bad = false;
+ double hang = 0;
+ long long vblank = 0, max = 4, thumb = 160;
+ iss >> dir;
+ if (dir.empty()) {
+  write_ack("ok crash_bundle" + crash_bundle_status());
+  return;
+ }
+ if (dir == "off") {
+  const std::string status = crash_bundle_status();
+  crash_bundle_disarm();
+  write_ack("ok crash_bundle off" + (status == " off" ? std::string() : status.substr(status.find(" written="))));
+  return;
+ }
+ while (iss >> tok) {
+  if (tok == "exception")
+   exc = true;
+  else if (tok.compare(0, 5, "hang=") == 0)
+   hang = strtod(tok.c_str() + 5, nullptr);
+  else if (tok.compare(0, 7, "vblank=") == 0)
+   vblank = strtoll(tok.c_str() + 7, nullptr, 0);
+  else if (tok.compare(0, 4, "max=") == 0)
+   max = strtoll(tok.c_str() + 4, nullptr, 0);
+  else if (tok.compare(0, 6, "thumb=") == 0)
+   thumb = strtoll(tok.c_str() + 6, nullptr, 0);
+  else
+   bad = true;
+ }
+ if (bad || !(hang >= 0 && hang <= 3600) || vblank < 0 || vblank > 1000000 || max < 1 || max > 1000 || thumb < 16 || thumb > 704) {
+  write_ack("error crash_bundle: usage: crash_bundle <dir> [exception] [hang=0..3600] [vblank=0..1000000] [max=1..1000] [thumb=16..704] | off");
+  return;
+ }
+
+ crash_bundle_disarm();
+ try {
+  NVFS.mkdir(dir, false);
+ } catch (std::exception& e) {
+  write_ack(std::string("error crash_bundle: ") + e.what());
+  return;
+ }
+ crash_dir = dir;
+ crash_on_exception = exc || (hang <= 0 && vblank <= 0);  // exceptions unless only other triggers are named
+ crash_hang_ms = (int64_t)(hang * 1000);
+ crash_vblank_frames = vblank;
+ crash_max = max;
+ crash_thumb_w = thumb;
+ crash_written = crash_skipped = 0;
+ crash_vbin_last = MDFN_IEN_SS::Automation_VBlankInTaken();
+ crash_vbin_frame = frame_counter;
+ MDFN_IEN_SS::Automation_RecentEventsStart();
+ if (crash_hang_ms) {
+  crash_watchdog_dir = dir;
+  crash_alive_frame.store(frame_counter);
+  crash_alive_ms.store(Time::MonoUS() / 1000);
+  crash_watchdog = MThreading::Thread_Create(crash_watchdog_main, nullptr, "CrashWatchdog");
+ }
+ write_ack("ok crash_bundle" + crash_bundle_status());
+}
+
+static void cmd_crash_bundle_now(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string note;
+ std::getline(iss >> std::ws, note);
+ if (crash_dir.empty()) {
+  write_ack("error crash_bundle_now: not armed (use crash_bundle <dir>)");
+  return;
+ }
+ // Paused inside the Exception macro the state has to wait for the frame end.
+ const std::string dir = crash_bundle_write("manual", note.empty() ? "manual" : "manual " + note, !exception_paused);
+ if (dir.empty())
+  write_ack("error crash_bundle_now: not written (max=" + std::to_string(crash_max) + " reached or error; see events)");
+ else
+  write_ack("ok crash_bundle_now " + dir);
+}
+
+static void cmd_call_graph_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string tok, which = "both";
+ bool cycles = false, bad = false;
+ while (iss >> tok) {
+  if (tok == "cycles")
+   cycles = true;
+  else if (tok == "master" || tok == "slave" || tok == "both")
+   which = tok;
+  else
+   bad = true;
+ }
+ if (bad) {
+  write_ack("error call_graph_start: usage: call_graph_start [master|slave|both] [cycles]");
+ } else {
+  MDFN_IEN_SS::Automation_CallGraphFrame(frame_counter);
+  MDFN_IEN_SS::Automation_CallGraphStart((which == "master") ? 1 : (which == "slave") ? 2 : 3, cycles);
+  write_ack("ok call_graph_start cpu=" + which + (cycles ? " cycles" : ""));
+ }
+}
+
+static void cmd_call_graph_reset(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CallGraphReset();
+ write_ack("ok call_graph_reset");
+}
+
+static void cmd_call_graph_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CallGraphStop();
+ write_ack("ok call_graph_stop edges=" + std::to_string(MDFN_IEN_SS::Automation_CallGraphGetEdges()));
+}
+
+static void cmd_call_graph_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, format = "dot";
+ iss >> path >> format;
+ if (path.empty() || (format != "dot" && format != "json")) {
+  write_ack("error call_graph_dump: usage: call_graph_dump <path> [dot|json]");
+ } else if (MDFN_IEN_SS::Automation_CallGraphDump(path.c_str(), format == "json")) {
+  write_ack("ok call_graph_dump " + path + " edges=" + std::to_string(MDFN_IEN_SS::Automation_CallGraphGetEdges()));
+ } else {
+  write_ack("error call_graph_dump: cannot open " + path);
+ }
+}
+
+static void cmd_cdl_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // Optional: cdl_start <lo_hex> <hi_hex>
+ // Defaults to the whole 27-bit bus (sparse, so only touched pages cost memory)
+ uint32_t lo = 0x00000000, hi = 0x08000000;
+ uint32_t user_lo;
+ if (iss >> std::hex >> user_lo) {
+  uint32_t user_hi;
+  if (!(iss >> std::hex >> user_hi)) {
+   write_ack("error cdl_start: need both lo and hi, or neither");
   } else {
-   if (size > 0x100000) size = 0x100000;
-   FILE* f = fopen(path.c_str(), "wb");
-   if (f) {
-    for (uint32_t i = 0; i < size; i++) {
-     uint8_t b = MDFN_IEN_SS::Automation_ReadMem8(addr + i);
-     fwrite(&b, 1, 1, f);
-    }
-    fclose(f);
-    char ack_msg[128];
-    snprintf(ack_msg, sizeof(ack_msg), "ok dump_mem_bin 0x%08X 0x%X", addr, size);
-    write_ack(ack_msg);
-   } else {
-    write_ack("error dump_mem_bin: cannot open " + path);
+   lo = user_lo;
+   hi = user_hi;
+  }
+ }
+ MDFN_IEN_SS::Automation_CDLStart(lo, hi);
+ // Use actual range from CDL state (after masking/validation)
+ uint32_t actual_lo = MDFN_IEN_SS::Automation_CDLGetLo();
+ uint32_t actual_hi = MDFN_IEN_SS::Automation_CDLGetHi();
+ uint32_t actual_size = MDFN_IEN_SS::Automation_CDLGetSize();
+ if (actual_size == 0) {
+  write_ack("error cdl_start: invalid range");
+ } else {
+  char buf[128];
+  snprintf(buf, sizeof(buf), "ok cdl_start 0x%08X-0x%08X (%uKB range, sparse)",
+           actual_lo, actual_hi, actual_size / 1024);
+  write_ack(buf);
+ }
+}
+
+static void cmd_cdl_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CDLStop();
+ write_ack("ok cdl_stop");
+}
+
+static void cmd_cdl_reset(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_CDLReset();
+ write_ack("ok cdl_reset");
+}
+
+static void cmd_cdl_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error cdl_dump: no path");
+ } else {
+  if (MDFN_IEN_SS::Automation_CDLDump(path.c_str()))
+   write_ack("ok cdl_dump " + path);
+  else
+   write_ack("error cdl_dump: cannot open " + path);
+ }
+}
+
+static void cmd_cdl_status(const std::string&, std::istringstream&, const std::string&)
+{
+ const uint32_t pages = MDFN_IEN_SS::Automation_CDLGetPages();
+ write_ack(std::string("ok cdl_status active=") +
+  (MDFN_IEN_SS::Automation_CDLIsActive() ? "true" : "false") +
+  " pages=" + std::to_string(pages) + " resident=" + std::to_string(pages * 4) + "KB");
+}
+
+static void cmd_cdl_delta(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t mask = 0xFF;
+ std::string path;
+ iss >> std::hex >> mask >> path;
+ uint32_t nbytes = 0;
+ const std::string runs = MDFN_IEN_SS::Automation_CDLDelta(mask & 0xFF, &nbytes);
+ const size_t nruns = runs.empty() ? 0 : std::count(runs.begin(), runs.end(), '\n') + 1;
+ std::string out = "ok cdl_delta bytes=" + std::to_string(nbytes) + " runs=" + std::to_string(nruns);
+ FILE* f = nullptr;
+ if (path.empty()) {
+  if (!runs.empty())
+   out += "\n" + runs;
+  write_ack(out);
+ } else if (!(f = fopen(path.c_str(), "w"))) {
+  write_ack("error cdl_delta: cannot open " + path);
+ } else {
+  fputs(runs.c_str(), f);
+  if (!runs.empty())
+   fputc('\n', f);
+  fclose(f);
+  write_ack(out + " path=" + path);
+ }
+}
+
+static void cmd_cdl_overlay_log(const CmdArgs& args)
+{
+ const std::string& path = args.s("path");
+ const bool zlib = args.has("zlib");
+ if (!MDFN_IEN_SS::Automation_CDLIsActive())
+  write_ack("error cdl_overlay_log: cdl_start first (only pages CDL has seen code in are watched)");
+ else if (!MDFN_IEN_SS::Automation_CDLOverlayStart(path.c_str(), zlib))
+  write_ack("error cdl_overlay_log: cannot open " + path);
+ else {
+  MDFN_IEN_SS::Automation_CDLOverlayFrame(frame_counter);
+  write_ack("ok cdl_overlay_log " + path + (zlib ? " zlib" : ""));
+ }
+}
+
+static void cmd_cdl_overlay_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dropped = 0;
+ const uint64_t records = MDFN_IEN_SS::Automation_CDLOverlayStop(&dropped);
+ write_ack("ok cdl_overlay_stop records=" + std::to_string(records) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_dma_trace(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ iss >> path;
+ if (path.empty()) {
+  write_ack("error dma_trace: no path");
+ } else {
+  MDFN_IEN_SS::Automation_EnableDMATrace(path.c_str());
+  write_ack("ok dma_trace " + path);
+ }
+}
+
+static void cmd_dma_trace_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dropped = MDFN_IEN_SS::Automation_DisableDMATrace();
+ write_ack("ok dma_trace_stop dropped=" + std::to_string(dropped));
+}
+
+static void cmd_dma_trace_bin(const CmdArgs& args)
+{
+ const std::string& path = args.s("path");
+ const bool zlib = args.has("zlib"), frames_only = args.has("frames_only");
+ if (!MDFN_IEN_SS::Automation_DMATraceBinStart(path.c_str(), zlib, frames_only))
+  write_ack("error dma_trace_bin: cannot open " + path);
+ else
+  write_ack("ok dma_trace_bin " + path + (zlib ? " zlib" : "") + (frames_only ? " frames_only" : ""));
+}
+
+static void cmd_dma_trace_bin_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t totals[3];
+ const uint64_t dropped = MDFN_IEN_SS::Automation_DMATraceBinStop(frame_counter, totals);
+ write_ack("ok dma_trace_bin_stop transfers=" + std::to_string(totals[0]) + " bytes=" + std::to_string(totals[1])
+  + " frames=" + std::to_string(totals[2]) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_mem_profile(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t lo = 0, hi = 0;
+ std::string path;
+ iss >> std::hex >> lo >> hi >> path;
+ if (path.empty()) {
+  write_ack("error mem_profile: usage: mem_profile <lo_hex> <hi_hex> <path>");
+ } else {
+  MDFN_IEN_SS::Automation_EnableMemProfile(path.c_str(), lo, hi);
+  char buf[256];
+  snprintf(buf, sizeof(buf), "ok mem_profile 0x%08X-0x%08X %s", lo, hi, path.c_str());
+  write_ack(buf);
+ }
+}
+
+static void cmd_mem_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dropped = MDFN_IEN_SS::Automation_DisableMemProfile();
+ write_ack("ok mem_profile_stop dropped=" + std::to_string(dropped));
+}
+
+static void cmd_write_log_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // write_log_start [entries=N] [<lo> <hi> ...]: default all of High Work RAM
+ std::vector<uint32_t> ranges;
+ std::string tok;
+ size_t entries = 1U << 22;
+ bool bad = false;
+ while (iss >> tok) {
+  if (tok.compare(0, 8, "entries=") == 0)
+   entries = strtoull(tok.c_str() + 8, nullptr, 0);
+  else {
+   char* end;
+   ranges.push_back(strtoul(tok.c_str(), &end, 16));
+   bad |= (*end != 0);
+  }
+ }
+ if (ranges.empty()) {
+  ranges.push_back(0x06000000);
+  ranges.push_back(0x060FFFFF);
+ }
+ if (bad || (ranges.size() & 1) || entries < 1 || entries > (1U << 28)) {
+  write_ack("error write_log_start: usage: write_log_start [entries=1..268435456] [<lo_hex> <hi_hex> ...]");
+ } else if (!MDFN_IEN_SS::Automation_WriteLogStart(ranges.data(), ranges.size() / 2, entries)) {
+  write_ack("error write_log_start: ranges must lie within Low (0x00200000-0x002FFFFF) or High (0x06000000-0x060FFFFF) Work RAM");
+ } else {
+  size_t cap = 1;
+  while (cap < entries)
+   cap <<= 1;
+  std::string ack = "ok write_log_start entries=" + std::to_string(cap) + " bytes=" + std::to_string(cap * 32 + 2 * 0x100000 * 2);
+  char buf[32];
+  for (size_t i = 0; i < ranges.size(); i += 2) {
+   snprintf(buf, sizeof(buf), " 0x%08X-0x%08X", ranges[i], ranges[i + 1]);
+   ack += buf;
+  }
+  write_ack(ack);
+ }
+}
+
+static void cmd_write_log_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64 total, held;
+ int64 oldest;
+ MDFN_IEN_SS::Automation_WriteLogStats(&total, &held, &oldest);
+ MDFN_IEN_SS::Automation_WriteLogStop();
+ write_ack("ok write_log_stop writes=" + std::to_string(total));
+}
+
+static void cmd_write_log_status(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64 total, held;
+ int64 oldest;
+ MDFN_IEN_SS::Automation_WriteLogStats(&total, &held, &oldest);
+ write_ack(std::string("ok write_log_status active=") + (MDFN_IEN_SS::Automation_WriteLogActive() ? "yes" : "no")
+  + " writes=" + std::to_string(total) + " held=" + std::to_string(held) + " oldest_cycle=" + std::to_string(oldest));
+}
+
+static void cmd_last_writer(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // last_writer <addr> [before_cycle] [count=N]: newest first
+ static const char* const src_names[] = { "master", "slave", "scu_dma", "dsp" };
+ uint32_t addr = 0;
+ int64_t before = INT64_MAX;
+ int count = 1;
+ std::string tok;
+ bool bad = !(iss >> std::hex >> addr);
+ iss >> std::dec;
+ while (!bad && (iss >> tok)) {
+  if (tok.compare(0, 6, "count=") == 0)
+   count = atoi(tok.c_str() + 6);
+  else
+   before = strtoll(tok.c_str(), nullptr, 10);
+ }
+ if (bad || count < 1 || count > 4096) {
+  write_ack("error last_writer: usage: last_writer <addr_hex> [before_cycle] [count=1..4096]");
+ } else {
+  std::vector<MDFN_IEN_SS::Automation_WriteLogHit> hits(count);
+  bool complete;
+  const int n = MDFN_IEN_SS::Automation_WriteLogQuery(addr, before, hits.data(), count, &complete);
+  if (n < 0) {
+   write_ack(MDFN_IEN_SS::Automation_WriteLogActive() ? "error last_writer: address isn't in a write_log range" : "error last_writer: write_log_start first");
+  } else {
+   char buf[192];
+   snprintf(buf, sizeof(buf), "ok last_writer addr=0x%08X before=%s found=%d complete=%s", addr,
+    (before == INT64_MAX) ? "now" : std::to_string(before).c_str(), n, complete ? "yes" : "no");
+   std::string ack = buf;
+   for (int i = 0; i < n; i++) {
+    const MDFN_IEN_SS::Automation_WriteLogHit& h = hits[i];
+    snprintf(buf, sizeof(buf), "\ncycle=%lld pc=0x%08X src=%s addr=0x%08X size=%u old=0x%08X new=0x%08X",
+     (long long)h.cycle, h.pc, src_names[h.source & 3], h.addr, h.size, h.old_val, h.new_val);
+    ack += buf;
    }
+   write_ack(ack);
   }
  }
- else if (cmd == "dump_region") {
-  // Convenience command: dump named memory region to binary file.
-  // Usage: dump_region <name> <path>
-  // Regions: wram_high (1MB), wram_low (1MB), vdp1_vram (512KB),
-  //          vdp2_vram (512KB), vdp2_cram (4KB), sound_ram (512KB)
-  std::string name, path;
-  iss >> name >> path;
-  if (name.empty() || path.empty()) {
-   write_ack("error dump_region: usage: dump_region <name> <path>");
-  } else {
-   uint32_t addr = 0, size = 0;
-   if (name == "wram_high")      { addr = 0x06000000; size = 0x100000; }
-   else if (name == "wram_low")  { addr = 0x00200000; size = 0x100000; }
-   else if (name == "vdp1_vram") { addr = 0x05C00000; size = 0x080000; }
-   else if (name == "vdp2_vram") { addr = 0x05E00000; size = 0x080000; }
-   else if (name == "vdp2_cram") { addr = 0x05F00000; size = 0x001000; }
-   else if (name == "sound_ram") { addr = 0x05A00000; size = 0x080000; }
-   else {
-    write_ack("error dump_region: unknown region '" + name +
-     "' (valid: wram_high wram_low vdp1_vram vdp2_vram vdp2_cram sound_ram)");
-    return;
-   }
-   std::vector<uint8_t> buf(size);
-   MDFN_IEN_SS::Automation_ReadMemBlock(addr, buf.data(), size);
-   FILE* f = fopen(path.c_str(), "wb");
-   if (f) {
-    fwrite(buf.data(), 1, size, f);
-    fclose(f);
-    char ack_msg[128];
-    snprintf(ack_msg, sizeof(ack_msg), "ok dump_region %s 0x%08X 0x%X %s",
-     name.c_str(), addr, size, path.c_str());
-    write_ack(ack_msg);
-   } else {
-    write_ack("error dump_region: cannot open " + path);
-   }
-  }
+}
+
+static void cmd_mem_read_profile(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t lo = 0, hi = 0;
+ std::string path;
+ iss >> std::hex >> lo >> hi >> path;
+ if (path.empty()) {
+  write_ack("error mem_read_profile: usage: mem_read_profile <lo_hex> <hi_hex> <path>");
+ } else {
+  MDFN_IEN_SS::Automation_EnableMemReadProfile(path.c_str(), lo, hi);
+  char buf[256];
+  snprintf(buf, sizeof(buf), "ok mem_read_profile 0x%08X-0x%08X %s", lo, hi, path.c_str());
+  write_ack(buf);
+ }
+}
+
+static void cmd_mem_read_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dropped = MDFN_IEN_SS::Automation_DisableMemReadProfile();
+ write_ack("ok mem_read_profile_stop dropped=" + std::to_string(dropped));
+}
+
+static void cmd_mem_heatmap(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t lo = 0, hi = 0;
+ unsigned every = 60, top = 64;
+ bool zlib = false, bad = false;
+ std::string path, tok;
+ iss >> std::hex >> lo >> hi >> std::dec >> path;
+ while (iss >> tok) {
+  if (tok.compare(0, 6, "every=") == 0)
+   every = strtoul(tok.c_str() + 6, nullptr, 0);
+  else if (tok.compare(0, 4, "top=") == 0)
+   top = strtoul(tok.c_str() + 4, nullptr, 0);
+  else if (tok == "zlib")
+   zlib = true;
+  else
+   bad = true;
+ }
+ if (path.empty() || bad || every < 1 || top > 65536) {
+  write_ack("error mem_heatmap: usage: mem_heatmap <lo_hex> <hi_hex> <path> [every=N frames] [top=0..65536] [zlib]");
+ } else if (!MDFN_IEN_SS::Automation_HeatmapStart(path.c_str(), lo, hi, every, top, zlib)) {
+  write_ack("error mem_heatmap: cannot open " + path + " or range is empty or over 64MiB");
+ } else {
+  char buf[320];
+  snprintf(buf, sizeof(buf), "ok mem_heatmap 0x%08X-0x%08X %s every=%u top=%u%s", lo, hi, path.c_str(), every, top, zlib ? " zlib" : "");
+  write_ack(buf);
+ }
+}
+
+static void cmd_op_stats_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ unsigned mask = 3, every = 1;
+ bool bad = false;
+ std::string path, tok;
+ while (iss >> tok) {
+  if (tok == "master")
+   mask = 1;
+  else if (tok == "slave")
+   mask = 2;
+  else if (tok.compare(0, 6, "every=") == 0)
+   every = strtoul(tok.c_str() + 6, nullptr, 0);
+  else if (path.empty())
+   path = tok;
+  else
+   bad = true;
+ }
+ if (bad || every < 1) {
+  write_ack("error op_stats_start: usage: op_stats_start [master|slave] [path] [every=N frames]");
+ } else if (!MDFN_IEN_SS::Automation_OpStatsStart(mask, path.empty() ? nullptr : path.c_str(), every)) {
+  write_ack(path.empty() ? "error op_stats_start: needs a build with the debugger (WANT_DEBUGGER)" : "error op_stats_start: cannot open " + path + " or no debugger in this build");
+ } else {
+  std::string ack = std::string("ok op_stats_start cpu=") + (mask == 1 ? "master" : mask == 2 ? "slave" : "both");
+  if (!path.empty())
+   ack += " " + path + " every=" + std::to_string(every);
+  write_ack(ack);
  }
- else if (cmd == "dump_vdp2_regs") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error dump_vdp2_regs: no path");
-  } else {
-   MDFN_IEN_SS::Automation_DumpVDP2RegsBin(path.c_str());
-   write_ack("ok dump_vdp2_regs " + path);
-  }
+}
+
+static void cmd_op_stats_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ unsigned top = 0;
+ iss >> path;
+ while (iss >> tok) {
+  if (tok.compare(0, 4, "top=") == 0)
+   top = strtoul(tok.c_str() + 4, nullptr, 0);
  }
- else if (cmd == "save_state") {
-  std::string path;
-  std::getline(iss >> std::ws, path);
-  if (path.empty()) {
-   write_ack("error save_state: no path");
-  } else {
-   try {
-    // Match MDFNI_SaveState: SaveSM to memory, then gzip to file
-    MemoryStream ms(65536);
-    MDFNSS_SaveSM(&ms);
-    GZFileStream gp(path, GZFileStream::MODE::WRITE, 6);
-    gp.write(ms.map(), ms.size());
-    gp.close();
-    write_ack("ok save_state " + path);
-   } catch (std::exception& e) {
-    write_ack(std::string("error save_state: ") + e.what());
+ if (path.empty())
+  write_ack("error op_stats_dump: usage: op_stats_dump <path> [top=N]");
+ else if (!MDFN_IEN_SS::Automation_OpStatsDump(path.c_str(), top))
+  write_ack("error op_stats_dump: cannot open " + path);
+ else
+  write_ack("ok op_stats_dump " + path + " master=" + std::to_string(MDFN_IEN_SS::Automation_OpStatsTotal(0)) + " slave=" + std::to_string(MDFN_IEN_SS::Automation_OpStatsTotal(1)));
+}
+
+static void cmd_op_stats_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t records = 0;
+ const uint64_t dropped = MDFN_IEN_SS::Automation_OpStatsStop(frame_counter, &records);
+ write_ack("ok op_stats_stop master=" + std::to_string(MDFN_IEN_SS::Automation_OpStatsTotal(0)) + " slave=" + std::to_string(MDFN_IEN_SS::Automation_OpStatsTotal(1)) + " records=" + std::to_string(records) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_dsp_profile_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ bool zlib = false;
+ while (iss >> tok) {
+  if (tok == "zlib")
+   zlib = true;
+  else
+   path = tok;
+ }
+ if (!MDFN_IEN_SS::Automation_DSPProfileStart(path.empty() ? nullptr : path.c_str(), zlib))
+  write_ack("error dsp_profile_start: cannot open " + path);
+ else
+  write_ack("ok dsp_profile_start" + (path.empty() ? std::string() : " " + path) + (zlib ? " zlib" : ""));
+}
+
+static void cmd_dsp_profile_dump(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string path, tok;
+ unsigned top = 0;
+ iss >> path;
+ while (iss >> tok) {
+  if (tok.compare(0, 4, "top=") == 0)
+   top = strtoul(tok.c_str() + 4, nullptr, 0);
+ }
+ uint64_t insns, stall;
+ MDFN_IEN_SS::Automation_DSPProfileTotals(&insns, &stall);
+ if (path.empty())
+  write_ack("error dsp_profile_dump: usage: dsp_profile_dump <path> [top=N]");
+ else if (!MDFN_IEN_SS::Automation_DSPProfileDump(path.c_str(), top))
+  write_ack("error dsp_profile_dump: cannot open " + path);
+ else
+  write_ack("ok dsp_profile_dump " + path + " instructions=" + std::to_string(insns) + " stall=" + std::to_string(stall));
+}
+
+static void cmd_dsp_profile_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t records = 0, insns, stall;
+ const uint64_t dropped = MDFN_IEN_SS::Automation_DSPProfileStop(&records);
+ MDFN_IEN_SS::Automation_DSPProfileTotals(&insns, &stall);
+ write_ack("ok dsp_profile_stop instructions=" + std::to_string(insns) + " stall=" + std::to_string(stall) + " records=" + std::to_string(records) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_dsp_regs(const std::string&, std::istringstream&, const std::string&)
+{
+ write_ack(MDFN_IEN_SS::Automation_DSPRegs());
+}
+
+static void cmd_dsp_dump_prog(const std::string&, std::istringstream& iss, const std::string& cmd)
+{
+ std::string path;
+ iss >> path;
+ uint32 prog[256], data[256];
+ MDFN_IEN_SS::Automation_DSPReadRAM(prog, data);
+ const uint32* words = (cmd == "dsp_dump_prog") ? prog : data;
+ FILE* f = path.empty() ? nullptr : fopen(path.c_str(), "wb");
+ if (path.empty()) {
+  write_ack("error " + cmd + ": no path");
+ } else if (!f) {
+  write_ack("error " + cmd + ": cannot open " + path);
+ } else {
+  uint8 be[256 * 4];
+  for (unsigned i = 0; i < 256; i++)
+   MDFN_en32msb(&be[i * 4], words[i]);
+  fwrite(be, 1, sizeof(be), f);
+  fclose(f);
+  write_ack("ok " + cmd + " " + path + " 0x400");
+ }
+}
+
+static void cmd_mem_heatmap_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ uint64_t dumps = 0;
+ uint64_t dropped = MDFN_IEN_SS::Automation_HeatmapStop(frame_counter, &dumps);
+ write_ack("ok mem_heatmap_stop dumps=" + std::to_string(dumps) + " dropped=" + std::to_string(dropped));
+}
+
+static void cmd_mem_sample(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t addr = 0, sz = 0;
+ int64_t frames = 0;
+ std::string path, tok;
+ std::vector<MemSampleRange> ranges;
+ bool xor_frames = false, zlib = false, bad = false;
+ uint64_t total = 0;
+ iss >> std::hex >> addr >> sz >> std::dec >> frames >> path;
+ ranges.push_back({ addr, sz });
+ // Extra "<addr_hex> <size_hex>" pairs, and the xor/zlib flags
+ while (iss >> tok) {
+  if (tok == "xor")
+   xor_frames = true;
+  else if (tok == "zlib")
+   zlib = true;
+  else {
+   std::string sz_tok;
+   char* end_a = nullptr;
+   char* end_s = nullptr;
+   MemSampleRange r;
+   r.addr = strtoul(tok.c_str(), &end_a, 16);
+   if (!(iss >> sz_tok) || *end_a || (r.size = strtoul(sz_tok.c_str(), &end_s, 16), *end_s)) {
+    bad = true;
+    break;
    }
+   ranges.push_back(r);
   }
  }
- else if (cmd == "load_state") {
-  std::string path;
-  std::getline(iss >> std::ws, path);
-  if (path.empty()) {
-   write_ack("error load_state: no path");
-  } else {
-   try {
-    // Match MDFNI_LoadState: gzip decompress, parse header, LoadSM
-    GZFileStream st(path, GZFileStream::MODE::READ);
-    uint8 header[32];
-    st.read(header, 32);
-    uint32 st_len = MDFN_de32lsb(header + 16 + 4) & 0x7FFFFFFF;
-    if (st_len < 32)
-     throw std::runtime_error("Save state header length field is bad");
-    MemoryStream sm(st_len, -1);
-    memcpy(sm.map(), header, 32);
-    st.read(sm.map() + 32, st_len - 32);
-    MDFNSS_LoadSM(&sm, false);
-    frame_counter = 0;  // Reset to 0 — all frame references are relative to save state load
-    write_ack("ok load_state " + path);
-   } catch (std::exception& e) {
-    write_ack(std::string("error load_state: ") + e.what());
+ for (const MemSampleRange& r : ranges) {
+  bad |= !r.size;
+  total += r.size;
+ }
+ if (path.empty() || bad || frames <= 0) {
+  write_ack("error mem_sample: usage: mem_sample <addr_hex> <size_hex> <frames_dec> <path> [<addr_hex> <size_hex> ...] [xor] [zlib]");
+ } else if (total > 0x10000000) {
+  write_ack("error mem_sample: more than 256MB per frame");
+ } else {
+  delete mem_sample_ring;
+  mem_sample_ring = nullptr;
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f) {
+   mem_sample_ranges = ranges;
+   mem_sample_size = total;
+   mem_sample_framed = ranges.size() > 1 || xor_frames || zlib;
+   mem_sample_xor = xor_frames;
+   mem_sample_prev.clear();
+   mem_sample_buf.resize((mem_sample_framed ? 8 : 0) + total);
+   if (mem_sample_framed) {
+    uint8_t hdr[16];
+    memcpy(hdr, "MDFNMSM1", 8);
+    MDFN_en32lsb(&hdr[8], ranges.size());
+    MDFN_en32lsb(&hdr[12], xor_frames);
+    fwrite(hdr, 1, sizeof(hdr), f);
+    for (const MemSampleRange& r : ranges) {
+     MDFN_en32lsb(&hdr[0], r.addr);
+     MDFN_en32lsb(&hdr[4], r.size);
+     fwrite(hdr, 1, 8, f);
+    }
    }
+   // Room for a few frames in flight, so a slow disk drops whole frames rarely.
+   mem_sample_ring = new MDFN_IEN_SS::TraceRing(f, true, std::max<size_t>(MDFN_IEN_SS::TraceRing::Default_Capacity, mem_sample_buf.size() * 4), zlib);
+   mem_sample_frames = frames;
+   mem_sample_total = frames;
+   // Free-run — mem_sample_frames controls when to stop
+   frames_to_advance = -1;
+   instruction_paused = false;
+   watchpoint_paused = false;
+   read_watchpoint_paused = false;
+   m68k_paused = false;
+   exception_paused = false;
+   instructions_to_step = -1;
+   slave_instructions_to_step = -1;
+   run_to_cycle_target = -1;
+   update_cpu_hook();
+   char buf[256];
+   snprintf(buf, sizeof(buf), "ok mem_sample 0x%08X 0x%X %lld %s ranges=%zu bytes=%llu",
+            addr, sz, (long long)frames, path.c_str(), ranges.size(), (unsigned long long)total);
+   write_ack(buf);
+  } else {
+   write_ack("error mem_sample: cannot open " + path);
   }
  }
- else if (cmd == "pc_trace_frame") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error pc_trace_frame: no path");
-  } else {
-   pc_trace_file = fopen(path.c_str(), "wb");
-   if (!pc_trace_file) {
-    write_ack("error pc_trace_frame: cannot open " + path);
-   } else {
-    pc_trace_active = true;
-    pc_trace_frame_mode = true;
-    frames_to_advance = 1;
-    instruction_paused = false;   // unblock instruction-level pause
-    watchpoint_paused = false;    // unblock watchpoint pause
-  read_watchpoint_paused = false;
-  exception_paused = false;
-    instructions_to_step = -1;    // cancel step mode
-    run_to_cycle_target = -1;     // cancel cycle target
-    update_cpu_hook();
-    write_ack("ok pc_trace_frame_started");
+}
+
+static void cmd_capture_plan(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // capture_plan set <path> [every=N] [zlib] <item ...> | stop | status
+ std::string sub, path, tok;
+ iss >> sub;
+ if (sub == "stop" || sub == "status") {
+  char buf[160];
+  snprintf(buf, sizeof(buf), "ok capture_plan %s active=%d records=%llu dropped=%llu", sub.c_str(), capture_ring != nullptr,
+           (unsigned long long)capture_records, (unsigned long long)(capture_ring ? capture_ring->Dropped() : 0));
+  if (sub == "stop")
+   capture_stop();
+  write_ack(buf);
+  return;
+ }
+ iss >> path;
+ if (sub != "set" || path.empty()) {
+  write_ack("error capture_plan: usage: capture_plan set <path> [every=N] [zlib] <mem:addr:size|regs|regs_slave|hash|obs ...> | stop | status");
+  return;
+ }
+ std::vector<CaptureItem> items;
+ int64_t period = 1;
+ bool zlib = false;
+ uint64_t total = 16;
+ while (iss >> tok) {
+  CaptureItem it = { 0, 0, 0 };
+  if (tok.compare(0, 6, "every=") == 0) {
+   period = std::max<int64_t>(1, atoll(tok.c_str() + 6));
+   continue;
+  }
+  else if (tok == "zlib") {
+   zlib = true;
+   continue;
+  }
+  else if (tok.compare(0, 4, "mem:") == 0) {
+   char* end_a = nullptr;
+   char* end_s = nullptr;
+   it.kind = CAP_MEM;
+   it.param = strtoul(tok.c_str() + 4, &end_a, 16);
+   if (*end_a == ':')
+    it.size = strtoul(end_a + 1, &end_s, 16);
+   if (*end_a != ':' || *end_s || !it.size) {
+    write_ack("error capture_plan: bad range '" + tok + "' (mem:<addr_hex>:<size_hex>)");
+    return;
    }
   }
- }
- else if (cmd == "step") {
-  int64_t n = 1;
-  iss >> n;
-  if (n < 1) n = 1;
-  instructions_to_step = n;
-  instruction_paused = false;  // unblock instruction-level pause if active
-  watchpoint_paused = false;   // unblock watchpoint pause
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  // Unblock frame-level pause -- the CPU hook will pause us after N instructions
-  if (frames_to_advance == 0)
-   frames_to_advance = -1;
-  update_cpu_hook();
-  write_ack("ok step " + std::to_string(n));
- }
- else if (cmd == "breakpoint") {
-  uint32_t addr = 0;
-  iss >> std::hex >> addr;
-  // Check for "log" flag
-  std::string token;
-  if (iss >> token && token == "log") {
-   breakpoint_log_mode = true;
-   if (!bp_log) {
-    std::string path = auto_base_dir + "/breakpoint_hits.txt";
-    bp_log = fopen(path.c_str(), "w");
-    if (bp_log)
-     fprintf(bp_log, "# Breakpoint hit log (log mode)\n");
+  else if (tok == "regs" || tok == "regs_slave") {
+   it.kind = CAP_REGS;
+   it.param = tok == "regs_slave";
+   it.size = 22 * sizeof(uint32_t);
+  }
+  else if (tok == "hash") {
+   it.kind = CAP_HASH;
+   it.size = 8;
+  }
+  else if (tok == "obs") {
+   if (!obs_base) {
+    write_ack("error capture_plan: obs needs obs_expose first");
+    return;
    }
+   const ObsHeader* h = (const ObsHeader*)obs_base;
+   it.kind = CAP_OBS;
+   it.param = h->width | (h->height << 12) | (h->channels << 24);
+   it.size = h->width * h->height * h->channels;
   }
-  breakpoints.insert(addr);
-  update_cpu_hook();
-  char buf[64];
-  snprintf(buf, sizeof(buf), "0x%08X", addr);
-  std::string ack_msg = "ok breakpoint " + std::string(buf) + " total=" + std::to_string(breakpoints.size());
-  if (breakpoint_log_mode) ack_msg += " log";
-  write_ack(ack_msg);
+  else {
+   write_ack("error capture_plan: unknown item '" + tok + "'");
+   return;
+  }
+  items.push_back(it);
+  total += it.size;
  }
- else if (cmd == "breakpoint_remove") {
-  uint32_t addr = 0;
-  iss >> std::hex >> addr;
-  size_t removed = breakpoints.erase(addr);
-  update_cpu_hook();
+ if (items.empty()) {
+  write_ack("error capture_plan: no items");
+  return;
+ }
+ if (total > 0x10000000) {
+  write_ack("error capture_plan: more than 256MB per record");
+  return;
+ }
+ capture_stop();
+ FILE* f = fopen(path.c_str(), "wb");
+ if (!f) {
+  write_ack("error capture_plan: cannot open " + path);
+  return;
+ }
+ uint8_t hdr[20];
+ memcpy(hdr, "MDFNCAP1", 8);
+ MDFN_en32lsb(&hdr[8], zlib);
+ MDFN_en32lsb(&hdr[12], period);
+ MDFN_en32lsb(&hdr[16], items.size());
+ fwrite(hdr, 1, sizeof(hdr), f);
+ for (const CaptureItem& it : items) {
+  MDFN_en32lsb(&hdr[0], it.kind);
+  MDFN_en32lsb(&hdr[4], it.param);
+  MDFN_en32lsb(&hdr[8], it.size);
+  fwrite(hdr, 1, 12, f);
+  capture_wants_frame |= it.kind == CAP_HASH || it.kind == CAP_OBS;
+ }
+ capture_items = items;
+ capture_buf.resize(total);
+ capture_period = period;
+ capture_records = 0;
+ capture_ring = new MDFN_IEN_SS::TraceRing(f, true, std::max<size_t>(MDFN_IEN_SS::TraceRing::Default_Capacity, capture_buf.size() * 4), zlib);
+ char buf[256];
+ snprintf(buf, sizeof(buf), "ok capture_plan set %s items=%zu bytes=%llu every=%lld%s",
+          path.c_str(), items.size(), (unsigned long long)total, (long long)period, zlib ? " zlib" : "");
+ write_ack(buf);
+}
+
+static void cmd_mem_sample_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (mem_sample_ring) {
+  int64_t captured = mem_sample_total - mem_sample_frames;
+  const uint64_t dropped = mem_sample_ring->Dropped();
+  delete mem_sample_ring;  // drains the ring
+  mem_sample_ring = nullptr;
+  mem_sample_frames = 0;
+  char buf[128];
+  snprintf(buf, sizeof(buf), "ok mem_sample_stop captured=%lld dropped=%llu", (long long)captured, (unsigned long long)dropped);
+  write_ack(buf);
+ } else {
+  write_ack("ok mem_sample_stop (not active)");
+ }
+}
+
+static void cmd_func_hook(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // func_hook <addr_hex> [args=N] [ret]
+ uint32_t addr = 0;
+ std::string tok;
+ FuncHook h;
+ bool bad = !(iss >> std::hex >> addr);
+ while (!bad && iss >> tok) {
+  if (tok == "ret")
+   h.ret = true;
+  else if (tok.compare(0, 5, "args=") == 0 && tok.size() == 6 && tok[5] >= '0' && tok[5] <= '4')
+   h.nargs = tok[5] - '0';
+  else
+   bad = true;
+ }
+ if (bad || (addr & 1)) {
+  write_ack("error func_hook: usage: func_hook <addr_hex> [args=0..4] [ret]");
+  return;
+ }
+ func_hooks[addr] = h;
+ update_cpu_hook();
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok func_hook 0x%08X args=%u%s total=%zu%s",
+          addr, h.nargs, h.ret ? " ret" : "", func_hooks.size(), func_hook_ring ? "" : " (no func_hook_log open)");
+ write_ack(buf);
+}
+
+static void cmd_func_hook_remove(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t addr = 0;
+ iss >> std::hex >> addr;
+ if (!func_hooks.erase(addr)) {
   char buf[64];
-  if (removed) {
-   snprintf(buf, sizeof(buf), "ok breakpoint_remove 0x%08X total=%zu", addr, breakpoints.size());
-  } else {
-   snprintf(buf, sizeof(buf), "error breakpoint_remove: not found 0x%08X", addr);
-  }
+  snprintf(buf, sizeof(buf), "error func_hook_remove: not found 0x%08X", addr);
   write_ack(buf);
+  return;
  }
- else if (cmd == "breakpoint_clear") {
-  size_t count = breakpoints.size();
-  breakpoints.clear();
-  breakpoint_log_mode = false;
-  if (bp_log) { fclose(bp_log); bp_log = nullptr; }
-  update_cpu_hook();
-  write_ack("ok breakpoint_clear removed=" + std::to_string(count));
+ update_cpu_hook();
+ char buf[96];
+ snprintf(buf, sizeof(buf), "ok func_hook_remove 0x%08X total=%zu", addr, func_hooks.size());
+ write_ack(buf);
+}
+
+static void cmd_func_hook_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t count = func_hooks.size();
+ func_hooks.clear();
+ func_hook_frames.clear();
+ update_cpu_hook();
+ write_ack("ok func_hook_clear removed=" + std::to_string(count));
+}
+
+static void cmd_func_hook_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::ostringstream ss;
+ ss << "func_hooks count=" << func_hooks.size() << " open=" << func_hook_frames.size() << " lost=" << func_hook_lost;
+ for (const auto& kv : func_hooks) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), " 0x%08X=args%u%s,hits=%llu", kv.first, kv.second.nargs,
+           kv.second.ret ? "+ret" : "", (unsigned long long)kv.second.hits);
+  ss << buf;
  }
- else if (cmd == "breakpoint_list") {
-  std::ostringstream ss;
-  ss << "breakpoints count=" << breakpoints.size();
-  for (auto addr : breakpoints) {
-   char buf[16];
-   snprintf(buf, sizeof(buf), " 0x%08X", addr);
-   ss << buf;
-  }
-  write_ack(ss.str());
- }
- else if (cmd == "breakpoint_set_from_file") {
-  // breakpoint_set_from_file <input_path> <result_path> [clear]
-  // Bulk installer for PC breakpoints in log mode (no pause). Input is a text file
-  // with one hex address per line (optional 0x prefix). '#' starts a comment,
-  // blank lines are ignored. Per-line parse failures are surfaced in the result
-  // JSON; install proceeds for all valid addresses.
-  //
-  // Side effect: flips breakpoint_log_mode globally. Any previously-installed
-  // pause-mode breakpoints become log-only for the rest of the session (matches
-  // singular `breakpoint <addr> log` semantics).
-  //
-  // Atomic ordering: parse input + write result file FIRST. Only mutate the
-  // live breakpoint set if the result file was successfully written — keeps
-  // Python-side bookkeeping in sync on I/O failures.
-  std::string input_path, result_path, clear_tok;
-  iss >> input_path >> result_path;
-  bool clear_existing = false;
-  if (iss >> clear_tok && clear_tok == "clear") clear_existing = true;
-
-  if (input_path.empty() || result_path.empty()) {
-   write_ack("error breakpoint_set_from_file: usage <input_path> <result_path> [clear]");
-  } else {
-   std::ifstream in(input_path.c_str());
-   if (!in.is_open()) {
-    write_ack("error breakpoint_set_from_file: cannot open input " + input_path);
-   } else {
-    // ---- Pass 1: parse input into temp structures (no state mutation yet) ----
-    int requested = 0;
-    std::vector<uint32_t> valid_addrs;
-    std::vector<std::pair<int, std::string>> failures;
-    std::string line;
-    int line_no = 0;
-    while (std::getline(in, line)) {
-     line_no++;
-     auto hash = line.find('#');
-     if (hash != std::string::npos) line.erase(hash);
-     auto b = line.find_first_not_of(" \t\r\n");
-     if (b == std::string::npos) continue;
-     auto e = line.find_last_not_of(" \t\r\n");
-     std::string tok = line.substr(b, e - b + 1);
-     if (tok.empty()) continue;
-
-     requested++;
-     std::string raw = tok;
-     if (tok.size() >= 2 && (tok.compare(0, 2, "0x") == 0 || tok.compare(0, 2, "0X") == 0))
-      tok.erase(0, 2);
-     if (tok.empty() || tok.size() > 8 ||
-         tok.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
-      failures.push_back({line_no, raw});
-      continue;
-     }
-     valid_addrs.push_back((uint32_t)strtoul(tok.c_str(), nullptr, 16));
-    }
-    in.close();
-
-    // Simulate the install so the result JSON reflects the final state.
-    std::unordered_set<uint32_t> sim;
-    if (!clear_existing) sim = breakpoints;
-    int installed = 0, duplicates = 0;
-    for (uint32_t a : valid_addrs) {
-     if (sim.insert(a).second) installed++;
-     else duplicates++;
-    }
+ write_ack(ss.str());
+}
 
-    // ---- Pass 2: write result JSON FIRST. Bail without mutating state on I/O fail. ----
-    FILE* out = fopen(result_path.c_str(), "w");
-    if (!out) {
-     write_ack("error breakpoint_set_from_file: cannot write result " + result_path);
-    } else {
-     fprintf(out, "{\n");
-     fprintf(out, "  \"requested\": %d,\n", requested);
-     fprintf(out, "  \"installed\": %d,\n", installed);
-     fprintf(out, "  \"duplicates\": %d,\n", duplicates);
-     fprintf(out, "  \"failed\": %zu,\n", failures.size());
-     fprintf(out, "  \"total_breakpoints\": %zu,\n", sim.size());
-     fprintf(out, "  \"cleared_before_install\": %s,\n", clear_existing ? "true" : "false");
-     fprintf(out, "  \"log_mode\": true,\n");
-     fputs("  \"failures\": [", out);
-     for (size_t i = 0; i < failures.size(); ++i) {
-      // JSON-escape per RFC 8259: \\, \", and control chars < 0x20 → \uXXXX.
-      // Pass higher bytes through as-is (valid UTF-8 remains valid UTF-8).
-      std::string esc;
-      for (unsigned char c : failures[i].second) {
-       if (c == '"') esc += "\\\"";
-       else if (c == '\\') esc += "\\\\";
-       else if (c < 0x20) {
-        char ubuf[8];
-        snprintf(ubuf, sizeof(ubuf), "\\u%04X", c);
-        esc += ubuf;
-       } else {
-        esc += (char)c;
-       }
-      }
-      fprintf(out, "%s\n    {\"line\": %d, \"raw\": \"%s\"}",
-              i ? "," : "", failures[i].first, esc.c_str());
-     }
-     fputs(failures.empty() ? "]\n" : "\n  ]\n", out);
-     fputs("}\n", out);
-     fclose(out);
-
-     // ---- Pass 3: mutate live state, now that persistence has succeeded. ----
-     if (clear_existing) {
-      breakpoints.clear();
-      if (bp_log) { fclose(bp_log); bp_log = nullptr; }
-     }
-     breakpoint_log_mode = true;
-     if (!bp_log) {
-      std::string hits_path = auto_base_dir + "/breakpoint_hits.txt";
-      bp_log = fopen(hits_path.c_str(), "w");
-      if (bp_log)
-       fprintf(bp_log, "# Breakpoint hit log (log mode)\n");
-     }
-     for (uint32_t a : valid_addrs) breakpoints.insert(a);
-     update_cpu_hook();
-
-     std::ostringstream ack;
-     ack << "ok breakpoint_set_from_file requested=" << requested
-         << " installed=" << installed
-         << " duplicates=" << duplicates
-         << " failed=" << failures.size()
-         << " total=" << breakpoints.size()
-         << " result=" << result_path;
-     write_ack(ack.str());
-    }
-   }
-  }
+static void cmd_func_hook_log(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // func_hook_log <path> [zlib]
+ std::string path, opt;
+ iss >> path >> opt;
+ if (path.empty() || (!opt.empty() && opt != "zlib")) {
+  write_ack("error func_hook_log: usage: func_hook_log <path> [zlib]");
+  return;
  }
- else if (cmd == "show_window") {
-  Video_AutomationShowWindow();
-  write_ack("ok show_window");
+ FILE* f = fopen(path.c_str(), "wb");
+ if (!f) {
+  write_ack("error func_hook_log: cannot open " + path);
+  return;
  }
- else if (cmd == "hide_window") {
-  Video_AutomationHideWindow();
-  write_ack("ok hide_window");
+ fwrite("MDFNFNH1", 1, 8, f);
+ delete func_hook_ring;
+ func_hook_ring = new MDFN_IEN_SS::TraceRing(f, true, MDFN_IEN_SS::TraceRing::Default_Capacity, opt == "zlib");
+ func_hook_records = 0;
+ write_ack("ok func_hook_log " + path + (opt.empty() ? "" : " " + opt));
+}
+
+static void cmd_func_hook_log_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (!func_hook_ring) {
+  write_ack("ok func_hook_log_stop (not active)");
+  return;
  }
- else if (cmd == "call_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error call_trace: no path");
-  } else {
-   MDFN_IEN_SS::Automation_EnableCallTrace(path.c_str());
-   write_ack("ok call_trace " + path);
+ const uint64_t dropped = func_hook_ring->Dropped();
+ delete func_hook_ring;  // drains the ring
+ func_hook_ring = nullptr;
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok func_hook_log_stop records=%llu dropped=%llu lost=%llu",
+          (unsigned long long)func_hook_records, (unsigned long long)dropped, (unsigned long long)func_hook_lost);
+ write_ack(buf);
+}
+
+static void cmd_freeze(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // freeze <addr_hex>:<val_hex>:<width> ... [nopurge]; same spec as poke_breakpoint
+ std::vector<PokeOp> specs;
+ bool purge = true;
+ std::string spec;
+ while (iss >> spec) {
+  if (spec == "nopurge") {
+   purge = false;
+   continue;
+  }
+  const size_t c1 = spec.find(':');
+  const size_t c2 = (c1 == std::string::npos) ? std::string::npos : spec.find(':', c1 + 1);
+  PokeOp p;
+  try {
+   if (c2 == std::string::npos)
+    throw std::invalid_argument(spec);
+   p.addr  = (uint32_t)std::stoul(spec.substr(0, c1), nullptr, 16);
+   p.value = (uint32_t)std::stoul(spec.substr(c1 + 1, c2 - c1 - 1), nullptr, 16);
+   p.width = (uint8_t)std::stoi(spec.substr(c2 + 1));
+  } catch (...) {
+   write_ack("error freeze: bad spec (need addr:val:width): " + spec);
+   return;
+  }
+  if (p.width != 8 && p.width != 16 && p.width != 32) {
+   write_ack("error freeze: width must be 8/16/32");
+   return;
   }
+  specs.push_back(p);
  }
- else if (cmd == "call_trace_stop") {
-  MDFN_IEN_SS::Automation_DisableCallTrace();
-  write_ack("ok call_trace_stop");
+ if (specs.empty()) {
+  write_ack("error freeze: usage: freeze <addr>:<val>:<width> ... [nopurge]");
+  return;
  }
- else if (cmd == "scdq_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error scdq_trace: no path");
-  } else {
-   MDFN_IEN_SS::CDB_EnableSCDQTrace(path.c_str());
-   write_ack("ok scdq_trace " + path);
+ for (const PokeOp& p : specs) {
+  if (!MDFN_IEN_SS::Automation_FreezeSet(p.addr, p.width / 8, p.width == 32 ? p.value : p.value & ((1U << p.width) - 1), purge)) {
+   char buf[96];
+   snprintf(buf, sizeof(buf), "error freeze: 0x%08X is not in Work RAM", p.addr);
+   write_ack(buf);
+   return;
   }
  }
- else if (cmd == "scdq_trace_stop") {
-  MDFN_IEN_SS::CDB_DisableSCDQTrace();
-  write_ack("ok scdq_trace_stop");
+ uint32_t entries, words;
+ uint64_t rewrites;
+ MDFN_IEN_SS::Automation_FreezeStats(&entries, &words, &rewrites);
+ write_ack("ok freeze entries=" + std::to_string(entries) + " words=" + std::to_string(words));
+}
+
+static void cmd_freeze_remove(const CmdArgs& args)
+{
+ const unsigned n = MDFN_IEN_SS::Automation_FreezeRemove(args.u("addr"));
+ write_ack("ok freeze_remove removed=" + std::to_string(n));
+}
+
+static void cmd_freeze_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ MDFN_IEN_SS::Automation_FreezeClear();
+ write_ack("ok freeze_clear");
+}
+
+static void cmd_freeze_list(const std::string&, std::istringstream&, const std::string&)
+{
+ uint32_t entries, words;
+ uint64_t rewrites;
+ MDFN_IEN_SS::Automation_FreezeStats(&entries, &words, &rewrites);
+ std::string out = "ok freeze_list entries=" + std::to_string(entries) + " words=" + std::to_string(words)
+  + " rewrites=" + std::to_string(rewrites);
+ const std::string list = MDFN_IEN_SS::Automation_FreezeList();
+ if (!list.empty())
+  out += "\n" + list.substr(0, list.size() - 1);
+ write_ack(out);
+}
+
+static void cmd_poke_breakpoint(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // poke_breakpoint <trigger_pc_hex> <n_pokes> <addr_hex>:<val_hex>:<width> ...
+ // Each hit at trigger_pc writes all pokes (atomic, no intervening cycles)
+ // and continues without pausing. Replaces any existing trigger at that PC.
+ uint32_t tpc = 0;
+ int n_pokes = 0;
+ iss >> std::hex >> tpc;
+ iss >> std::dec >> n_pokes;
+ if (n_pokes < 1 || n_pokes > 64) {
+  write_ack("error poke_breakpoint: n_pokes out of range (1..64)");
+  return;
  }
- else if (cmd == "cdb_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error cdb_trace: no path");
-  } else {
-   MDFN_IEN_SS::CDB_EnableCDBTrace(path.c_str());
-   write_ack("ok cdb_trace " + path);
+ std::vector<PokeOp> pokes;
+ pokes.reserve(n_pokes);
+ for (int i = 0; i < n_pokes; i++) {
+  std::string spec;
+  if (!(iss >> spec)) {
+   write_ack("error poke_breakpoint: missing poke spec");
+   return;
   }
+  // Split spec on ':'
+  size_t c1 = spec.find(':');
+  size_t c2 = (c1 == std::string::npos) ? std::string::npos : spec.find(':', c1 + 1);
+  if (c1 == std::string::npos || c2 == std::string::npos) {
+   write_ack("error poke_breakpoint: bad spec (need addr:val:width): " + spec);
+   return;
+  }
+  PokeOp p;
+  try {
+   p.addr  = (uint32_t)std::stoul(spec.substr(0, c1), nullptr, 16);
+   p.value = (uint32_t)std::stoul(spec.substr(c1 + 1, c2 - c1 - 1), nullptr, 16);
+   int w   = std::stoi(spec.substr(c2 + 1));
+   if (w != 8 && w != 16 && w != 32) {
+    write_ack("error poke_breakpoint: width must be 8/16/32");
+    return;
+   }
+   p.width = (uint8_t)w;
+   MDFN_en32msb(p.bytes, p.value << (32 - w));
+  } catch (...) {
+   write_ack("error poke_breakpoint: parse error in spec: " + spec);
+   return;
+  }
+  pokes.push_back(p);
+ }
+ // If a playback was active at this PC, it's being replaced — clear flags.
+ auto existing = poke_triggers.find(tpc);
+ if (existing != poke_triggers.end() && existing->second.is_playback) {
+  if (poke_playback_running && poke_playback_pc == tpc) {
+   poke_playback_running = false;
+   poke_playback_pc = 0;
+  }
+ }
+ PokeTrigger trig;
+ trig.is_playback     = false;
+ trig.static_pokes    = std::move(pokes);
+ trig.trigger_hits    = 0;
+ trig.pokes_performed = 0;
+ poke_triggers[tpc]   = std::move(trig);
+ update_cpu_hook();
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok poke_breakpoint 0x%08X pokes=%d total_triggers=%zu",
+          tpc, n_pokes, poke_triggers.size());
+ write_ack(buf);
+}
+
+static void cmd_poke_breakpoint_remove(const std::string&, std::istringstream& iss, const std::string&)
+{
+ uint32_t tpc = 0;
+ iss >> std::hex >> tpc;
+ auto it = poke_triggers.find(tpc);
+ if (it == poke_triggers.end()) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "error poke_breakpoint_remove: not found 0x%08X", tpc);
+  write_ack(buf);
+  return;
  }
- else if (cmd == "cdb_trace_stop") {
-  MDFN_IEN_SS::CDB_DisableCDBTrace();
-  write_ack("ok cdb_trace_stop");
+ if (it->second.is_playback && poke_playback_running && poke_playback_pc == tpc) {
+  poke_playback_running = false;
+  poke_playback_pc = 0;
  }
- else if (cmd == "unified_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error unified_trace: no path");
+ poke_triggers.erase(it);
+ update_cpu_hook();
+ char buf[128];
+ snprintf(buf, sizeof(buf), "ok poke_breakpoint_remove 0x%08X total_triggers=%zu",
+          tpc, poke_triggers.size());
+ write_ack(buf);
+}
+
+static void cmd_poke_breakpoint_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ size_t count = poke_triggers.size();
+ poke_triggers.clear();
+ poke_playback_running = false;
+ poke_playback_pc = 0;
+ poke_playback_halt_pending = false;
+ update_cpu_hook();
+ write_ack("ok poke_breakpoint_clear removed=" + std::to_string(count));
+}
+
+static void cmd_poke_breakpoint_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::ostringstream ss;
+ ss << "poke_triggers count=" << poke_triggers.size();
+ for (const auto& kv : poke_triggers) {
+  char buf[128];
+  if (kv.second.is_playback) {
+   snprintf(buf, sizeof(buf), " 0x%08X=playback(rows=%zu,cur=%zu,hits=%llu)",
+            kv.first, kv.second.row_count, kv.second.cur_row,
+            (unsigned long long)kv.second.trigger_hits);
   } else {
-   // Stop any existing unified trace
-   if (unified_trace_file) {
-    MDFN_IEN_SS::Automation_ClearCallTraceFile();
-    MDFN_IEN_SS::CDB_ClearCDBTraceFile();
-    fclose(unified_trace_file);
-    unified_trace_file = nullptr;
+   snprintf(buf, sizeof(buf), " 0x%08X=static(pokes=%zu,hits=%llu)",
+            kv.first, kv.second.static_pokes.size(),
+            (unsigned long long)kv.second.trigger_hits);
+  }
+  ss << buf;
+ }
+ write_ack(ss.str());
+}
+
+static void cmd_poke_playback_start(const std::string&, std::istringstream& iss, const std::string&)
+{
+ // poke_playback_start <trigger_pc> <base_addr> <start_row> <end_row>
+ //                     <on_end> <n_cols> <col1> ... <colN> <csv_path>
+ // Each col: <csv_name>:<offset_hex>:<width>[:<slice_lo>:<slice_hi>]
+ // on_end: halt|loop|hold
+ // end_row=-1 means EOF. Replaces any existing trigger at that PC, and
+ // supersedes any prior playback (only one playback cursor at a time).
+ uint32_t tpc = 0, base = 0;
+ int64_t  start_row_in = 0, end_row_in = -1;
+ std::string on_end_str;
+ int n_cols = 0;
+ iss >> std::hex >> tpc >> base;
+ iss >> std::dec >> start_row_in >> end_row_in >> on_end_str >> n_cols;
+ if (n_cols < 1 || n_cols > 256) {
+  write_ack("error poke_playback_start: n_cols out of range (1..256)");
+  return;
+ }
+ PokePlaybackOnEnd on_end;
+ if      (on_end_str == "halt") on_end = PPOE_HALT;
+ else if (on_end_str == "loop") on_end = PPOE_LOOP;
+ else if (on_end_str == "hold") on_end = PPOE_HOLD;
+ else {
+  write_ack("error poke_playback_start: on_end must be halt|loop|hold");
+  return;
+ }
+ // Parse column specs
+ std::vector<std::string>        col_names(n_cols);
+ std::vector<PokePlaybackCol>    cols(n_cols);
+ for (int i = 0; i < n_cols; i++) {
+  std::string spec;
+  if (!(iss >> spec)) {
+   write_ack("error poke_playback_start: missing column spec");
+   return;
+  }
+  // Split on ':' into up to 5 parts: name, offset, width, [slice_lo, slice_hi]
+  std::vector<std::string> parts;
+  size_t start = 0;
+  while (true) {
+   size_t pos = spec.find(':', start);
+   if (pos == std::string::npos) { parts.push_back(spec.substr(start)); break; }
+   parts.push_back(spec.substr(start, pos - start));
+   start = pos + 1;
+  }
+  if (parts.size() != 3 && parts.size() != 5) {
+   write_ack("error poke_playback_start: column spec must be name:offset:width[:lo:hi] — got " + spec);
+   return;
+  }
+  try {
+   col_names[i]          = parts[0];
+   cols[i].offset        = (uint32_t)std::stoul(parts[1], nullptr, 16);
+   int w                 = std::stoi(parts[2]);
+   if (w != 8 && w != 16 && w != 32) {
+    write_ack("error poke_playback_start: width must be 8/16/32");
+    return;
    }
-   unified_trace_file = fopen(path.c_str(), "w");
-   if (unified_trace_file) {
-    fprintf(unified_trace_file, "# Unified trace: <sh2_cycle> <source> <details>\n"
-      "# M/S = SH-2 master/slave call, CMD/DRV/IRQ/BUF = CD Block\n");
-    MDFN_IEN_SS::Automation_SetCallTraceFile(unified_trace_file);
-    MDFN_IEN_SS::CDB_SetCDBTraceFile(unified_trace_file);
-    write_ack("ok unified_trace " + path);
+   cols[i].width         = (uint8_t)w;
+   cols[i].slice_enabled = (parts.size() == 5);
+   if (cols[i].slice_enabled) {
+    cols[i].slice_lo = std::stoi(parts[3]);
+    cols[i].slice_hi = std::stoi(parts[4]);
+    if (cols[i].slice_lo < 0 || cols[i].slice_hi > 4
+        || cols[i].slice_lo >= cols[i].slice_hi
+        || (cols[i].slice_hi - cols[i].slice_lo) * 8 != w) {
+     write_ack("error poke_playback_start: bad byte_slice (must be within [0,4] and match width)");
+     return;
+    }
    } else {
-    write_ack("error unified_trace: failed to open " + path);
+    cols[i].slice_lo = cols[i].slice_hi = 0;
    }
+   cols[i].csv_col_idx   = 0; // filled in after header parse
+  } catch (...) {
+   write_ack("error poke_playback_start: parse error in col spec: " + spec);
+   return;
   }
  }
- else if (cmd == "unified_trace_stop") {
-  MDFN_IEN_SS::Automation_ClearCallTraceFile();
-  MDFN_IEN_SS::CDB_ClearCDBTraceFile();
-  if (unified_trace_file) {
-   fflush(unified_trace_file);
-   fclose(unified_trace_file);
-   unified_trace_file = nullptr;
+ // Rest of line is the CSV path (single token, no spaces supported)
+ std::string csv_path;
+ iss >> csv_path;
+ if (csv_path.empty()) {
+  write_ack("error poke_playback_start: missing csv_path");
+  return;
+ }
+ std::ifstream cf(csv_path);
+ if (!cf.is_open()) {
+  write_ack("error poke_playback_start: cannot open CSV " + csv_path);
+  return;
+ }
+ // Parse header
+ std::string line;
+ if (!std::getline(cf, line)) {
+  write_ack("error poke_playback_start: empty CSV");
+  return;
+ }
+ auto split_csv = [](const std::string& s, std::vector<std::string>& out) {
+  out.clear();
+  std::string tok;
+  for (size_t i = 0; i < s.size(); i++) {
+   char ch = s[i];
+   if (ch == ',') { out.push_back(tok); tok.clear(); }
+   else if (ch != '\r' && ch != '\n') tok.push_back(ch);
+  }
+  out.push_back(tok);
+ };
+ std::vector<std::string> headers;
+ split_csv(line, headers);
+ // Resolve each requested name to a header index
+ for (int i = 0; i < n_cols; i++) {
+  bool found = false;
+  for (size_t j = 0; j < headers.size(); j++) {
+   if (headers[j] == col_names[i]) { cols[i].csv_col_idx = j; found = true; break; }
   }
-  write_ack("ok unified_trace_stop");
- }
- else if (cmd == "input_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error input_trace: no path");
-  } else {
-   if (input_trace_file) fclose(input_trace_file);
-   input_trace_file = fopen(path.c_str(), "w");
-   if (input_trace_file) {
-    fprintf(input_trace_file, "# Input trace -- frame PRESS/RELEASE BUTTON\n");
-    last_traced_input = 0;
-    write_ack("ok input_trace " + path);
-   } else {
-    write_ack("error input_trace: cannot open " + path);
-   }
+  if (!found) {
+   write_ack("error poke_playback_start: column '" + col_names[i] + "' not in CSV header");
+   return;
   }
  }
- else if (cmd == "input_trace_stop") {
-  if (input_trace_file) {
-   fclose(input_trace_file);
-   input_trace_file = nullptr;
-  }
-  write_ack("ok input_trace_stop");
+ // Parse all data rows, pre-compute bytes for each (row, col) into one
+ // flat array, so a hit writes straight out of it
+ size_t row_stride = 0;
+ for (int c = 0; c < n_cols; c++) {
+  cols[c].nbytes = cols[c].slice_enabled ? cols[c].slice_hi - cols[c].slice_lo : cols[c].width / 8;
+  cols[c].row_offset = row_stride;
+  row_stride += cols[c].nbytes;
  }
- else if (cmd == "input_playback") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error input_playback: no path");
-  } else {
-   FILE* f = fopen(path.c_str(), "r");
-   if (!f) {
-    write_ack("error input_playback: cannot open " + path);
-   } else {
-    playback_events.clear();
-    playback_index = 0;
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-     // Parse: frame=N PRESS/RELEASE BUTTON
-     uint64_t fr = 0;
-     char action[32] = {0}, button[32] = {0};
-     if (sscanf(line, "frame=%llu %31s %31s", (unsigned long long*)&fr, action, button) == 3) {
-      int b = parse_button(button);
-      if (b >= 0) {
-       InputEvent ev;
-       ev.frame = fr;
-       ev.press = (strcmp(action, "PRESS") == 0);
-       ev.button = b;
-       playback_events.push_back(ev);
-      }
-     }
-    }
-    fclose(f);
-    // Clear current input state for clean playback
-    input_buttons = 0;
-    input_override = false;
-    playback_base_frame = frame_counter;
-    playback_active = true;
-    char buf[256];
-    snprintf(buf, sizeof(buf), "ok input_playback %zu events from %s",
-             playback_events.size(), path.c_str());
+ std::vector<uint8_t> row_data;
+ size_t row_count = 0;
+ while (std::getline(cf, line)) {
+  if (line.empty()) continue;
+  if (line[0] == '#') continue;
+  std::vector<std::string> cells;
+  split_csv(line, cells);
+  for (int c = 0; c < n_cols; c++) {
+   if (cols[c].csv_col_idx >= cells.size()) {
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "error poke_playback_start: row %zu has %zu cols, col index %zu out of range",
+             row_count, cells.size(), cols[c].csv_col_idx);
     write_ack(buf);
+    return;
+   }
+   const std::string& cell = cells[cols[c].csv_col_idx];
+   std::string s = cell;
+   if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s = s.substr(2);
+   uint64_t val;
+   try {
+    val = std::stoull(s, nullptr, 16);
+   } catch (...) {
+    write_ack("error poke_playback_start: bad hex cell '" + cell + "'");
+    return;
+   }
+   // Render as big-endian 4 bytes (source assumed 32-bit hex column)
+   uint8_t be4[4] = {
+    (uint8_t)((val >> 24) & 0xFF),
+    (uint8_t)((val >> 16) & 0xFF),
+    (uint8_t)((val >>  8) & 0xFF),
+    (uint8_t)(val         & 0xFF)
+   };
+   if (cols[c].slice_enabled) {
+    row_data.insert(row_data.end(), be4 + cols[c].slice_lo, be4 + cols[c].slice_hi);
+   } else {
+    // Take low (width/8) bytes in BE order
+    row_data.insert(row_data.end(), be4 + 4 - cols[c].nbytes, be4 + 4);
    }
   }
+  row_count++;
  }
- else if (cmd == "input_playback_stop") {
-  playback_active = false;
-  playback_events.clear();
-  playback_index = 0;
-  write_ack("ok input_playback_stop");
+ cf.close();
+ if (!row_count) {
+  write_ack("error poke_playback_start: CSV has no data rows");
+  return;
  }
- else if (cmd == "watchpoint") {
-  uint32_t addr = 0;
-  iss >> std::hex >> addr;
-  watchpoint_addr = addr;
-  watchpoint_active = true;
-  watchpoint_paused = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  watchpoint_filter_active = false;
-  watchpoint_filter_value = 0;
-  watchpoint_log_mode = false;
-  // Close stale log from previous watchpoint
-  close_wp_log();
-  MDFN_IEN_SS::Automation_SetWatchpoint(addr);
-  // Parse optional flags: "watchpoint <addr> [eq <value>] [log]"
-  std::string token;
-  while (iss >> token) {
-   if (token == "eq") {
-    uint32_t filter_val = 0;
-    iss >> std::hex >> filter_val;
-    watchpoint_filter_active = true;
-    watchpoint_filter_value = filter_val;
-    MDFN_IEN_SS::Automation_SetWatchpointFilter(true, filter_val);
-   } else if (token == "log") {
-    watchpoint_log_mode = true;
-   }
-  }
-  update_cpu_hook();
-  char buf[128];
-  if (watchpoint_filter_active && watchpoint_log_mode)
-   snprintf(buf, sizeof(buf), "ok watchpoint 0x%08X eq 0x%08X log", addr, watchpoint_filter_value);
-  else if (watchpoint_filter_active)
-   snprintf(buf, sizeof(buf), "ok watchpoint 0x%08X eq 0x%08X", addr, watchpoint_filter_value);
-  else if (watchpoint_log_mode)
-   snprintf(buf, sizeof(buf), "ok watchpoint 0x%08X log", addr);
-  else
-   snprintf(buf, sizeof(buf), "ok watchpoint 0x%08X", addr);
+ // Resolve row bounds
+ size_t start_row = (start_row_in < 0) ? 0 : (size_t)start_row_in;
+ size_t end_row   = (end_row_in   < 0) ? row_count : (size_t)end_row_in;
+ if (start_row >= row_count || end_row > row_count || start_row >= end_row) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "error poke_playback_start: bad row range start=%zu end=%zu total=%zu",
+           start_row, end_row, row_count);
   write_ack(buf);
+  return;
  }
- else if (cmd == "watchpoint_clear") {
-  watchpoint_active = false;
-  watchpoint_paused = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  close_wp_log();
-  MDFN_IEN_SS::Automation_ClearWatchpoint();
-  update_cpu_hook();
-  write_ack("ok watchpoint_clear");
- }
- else if (cmd == "vdp2_watchpoint") {
-  uint32_t lo = 0, hi = 0;
-  std::string logpath;
-  iss >> std::hex >> lo >> hi >> logpath;
-  if (logpath.empty()) {
-   write_ack("error vdp2_watchpoint: usage: vdp2_watchpoint <lo_hex> <hi_hex> <logpath>");
-  } else {
-   MDFN_IEN_SS::Automation_SetVDP2Watchpoint(lo, hi, logpath.c_str());
-   char buf[128];
-   snprintf(buf, sizeof(buf), "ok vdp2_watchpoint 0x%08X-0x%08X %s", lo, hi, logpath.c_str());
-   write_ack(buf);
-  }
+ // Supersede any prior playback
+ if (poke_playback_running) {
+  poke_triggers.erase(poke_playback_pc);
+  poke_playback_running = false;
+ }
+ PokeTrigger trig;
+ trig.is_playback     = true;
+ trig.base_addr       = base;
+ trig.columns         = std::move(cols);
+ trig.row_data        = std::move(row_data);
+ trig.row_stride      = row_stride;
+ trig.row_count       = row_count;
+ trig.start_row       = start_row;
+ trig.end_row         = end_row;
+ trig.cur_row         = start_row;
+ trig.on_end          = on_end;
+ trig.done            = false;
+ trig.trigger_hits    = 0;
+ trig.pokes_performed = 0;
+ poke_triggers[tpc]   = std::move(trig);
+ poke_playback_running = true;
+ poke_playback_pc      = tpc;
+ poke_playback_halt_pending = false;
+ update_cpu_hook();
+ char buf[192];
+ snprintf(buf, sizeof(buf),
+          "ok poke_playback_start 0x%08X base=0x%08X rows=%zu..%zu cols=%d on_end=%s",
+          tpc, base, start_row, end_row, n_cols, on_end_str.c_str());
+ write_ack(buf);
+}
+
+static void cmd_poke_playback_stop(const std::string&, std::istringstream&, const std::string&)
+{
+ if (!poke_playback_running) {
+  write_ack("ok poke_playback_stop (not active)");
+  return;
+ }
+ uint32_t tpc = poke_playback_pc;
+ poke_triggers.erase(tpc);
+ poke_playback_running = false;
+ poke_playback_pc = 0;
+ poke_playback_halt_pending = false;
+ update_cpu_hook();
+ char buf[96];
+ snprintf(buf, sizeof(buf), "ok poke_playback_stop 0x%08X", tpc);
+ write_ack(buf);
+}
+
+static void cmd_poke_playback_status(const std::string&, std::istringstream&, const std::string&)
+{
+ if (!poke_playback_running) {
+  write_ack("poke_playback inactive");
+  return;
  }
- else if (cmd == "vdp2_watchpoint_clear") {
-  MDFN_IEN_SS::Automation_ClearVDP2Watchpoint();
-  write_ack("ok vdp2_watchpoint_clear");
+ auto it = poke_triggers.find(poke_playback_pc);
+ if (it == poke_triggers.end() || !it->second.is_playback) {
+  write_ack("poke_playback inactive (stale)");
+  return;
  }
- else if (cmd == "read_watchpoint") {
-  uint32_t addr = 0;
-  iss >> std::hex >> addr;
-  read_watchpoint_addr = addr;
-  read_watchpoint_active = true;
-  read_watchpoint_log_mode = false;
-  // Close stale log
-  if (rwp_log) { fclose(rwp_log); rwp_log = nullptr; }
-  // Check for "log" flag
-  std::string token;
-  if (iss >> token && token == "log") {
-   read_watchpoint_log_mode = true;
+ const auto& t = it->second;
+ char buf[256];
+ snprintf(buf, sizeof(buf),
+          "poke_playback pc=0x%08X base=0x%08X row=%zu/%zu start=%zu end=%zu "
+          "triggers_seen=%llu pokes=%llu done=%s on_end=%s",
+          poke_playback_pc, t.base_addr, t.cur_row, t.end_row,
+          t.start_row, t.end_row,
+          (unsigned long long)t.trigger_hits,
+          (unsigned long long)t.pokes_performed,
+          t.done ? "true" : "false",
+          (t.on_end == PPOE_HALT) ? "halt" :
+          (t.on_end == PPOE_LOOP) ? "loop" : "hold");
+ write_ack(buf);
+}
+
+static void cmd_script_load(const std::string& line, std::istringstream& iss, const std::string&)
+{
+ std::string path;
+ std::getline(iss >> std::ws, path);
+ std::ifstream f(path);
+ if (path.empty() || !f.is_open()) {
+  write_ack("error script_load: cannot open " + path);
+  return;
+ }
+ // All or nothing: a bad line keeps the rules already loaded.
+ std::vector<ScriptRule> rules;
+ std::string rline, err;
+ unsigned lineno = 0;
+ while (std::getline(f, rline)) {
+  lineno++;
+  if (!rline.empty() && rline.back() == '\r')
+   rline.pop_back();
+  const size_t first = rline.find_first_not_of(" \t");
+  if (first == std::string::npos || rline[first] == '#')
+   continue;
+  ScriptRule r;
+  if (!script_parse_rule(rline.substr(first), &r, &err)) {
+   write_ack("error script_load: line " + std::to_string(lineno) + ": " + err);
+   return;
   }
-  MDFN_IEN_SS::Automation_SetReadWatchpoint(addr);
-  char buf[128];
-  if (read_watchpoint_log_mode)
-   snprintf(buf, sizeof(buf), "ok read_watchpoint 0x%08X log", addr);
-  else
-   snprintf(buf, sizeof(buf), "ok read_watchpoint 0x%08X", addr);
-  write_ack(buf);
+  rules.push_back(r);
  }
- else if (cmd == "read_watchpoint_clear") {
-  read_watchpoint_active = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  if (rwp_log) { fclose(rwp_log); rwp_log = nullptr; }
-  MDFN_IEN_SS::Automation_ClearReadWatchpoint();
-  write_ack("ok read_watchpoint_clear");
+ script_rules.swap(rules);
+ script_index();
+ write_ack("ok script_load rules=" + std::to_string(script_rules.size()));
+}
+
+static void cmd_script_add(const std::string&, std::istringstream& iss, const std::string&)
+{
+ std::string src, err;
+ std::getline(iss >> std::ws, src);
+ ScriptRule r;
+ if (!script_parse_rule(src, &r, &err)) {
+  write_ack("error script_add: " + err);
+  return;
  }
- else if (cmd == "deterministic") {
-  MDFN_IEN_SS::Automation_SetDeterministic();
-  write_ack("ok deterministic");
+ script_rules.push_back(r);
+ script_index();
+ write_ack("ok script_add rule=" + std::to_string(script_rules.size() - 1));
+}
+
+static void cmd_script_clear(const std::string&, std::istringstream&, const std::string&)
+{
+ const size_t n = script_rules.size();
+ script_rules.clear();
+ script_index();
+ write_ack("ok script_clear removed=" + std::to_string(n));
+}
+
+static void cmd_script_list(const std::string&, std::istringstream&, const std::string&)
+{
+ std::string out = "script rules=" + std::to_string(script_rules.size());
+ for (size_t i = 0; i < script_rules.size(); i++) {
+  const ScriptRule& r = script_rules[i];
+  out += "\n[" + std::to_string(i) + "] hits=" + std::to_string(r.hits) + " fired=" + std::to_string(r.fired)
+       + " errors=" + std::to_string(r.errors) + " " + r.src;
+  if (!r.last_error.empty())
+   out += "\n    last_error: " + r.last_error;
  }
- else if (cmd == "exception_break") {
-  std::string mode;
-  iss >> mode;
-  if (mode == "enable") {
-   exception_mode = EXC_ENABLE;
-   write_ack("ok exception_break enable");
-  } else if (mode == "log") {
-   exception_mode = EXC_LOG;
-   if (!exc_log) {
-    std::string path = auto_base_dir + "/exception_hits.txt";
-    exc_log = fopen(path.c_str(), "w");
-    if (exc_log) fprintf(exc_log, "# SH-2 exception log\n");
+ write_ack(out);
+}
+
+// In the order the old if/else chain tested them. Names that shared a branch
+// share a handler, which tells them apart by cmd.
+static const CommandDef command_table[] = {
+ { "frame_advance", "[n:i]", nullptr, cmd_frame_advance },
+ { "screenshot", nullptr, cmd_screenshot, nullptr },
+ { "screenshot_phash", nullptr, cmd_screenshot_phash, nullptr },
+ { "frame_dump", nullptr, cmd_frame_dump, nullptr },
+ { "frame_dump_stop", nullptr, cmd_frame_dump_stop, nullptr },
+ { "input", nullptr, cmd_input, nullptr },
+ { "input_release", nullptr, cmd_input_release, nullptr },
+ { "input_clear", nullptr, cmd_input_clear, nullptr },
+ { "input_port", nullptr, cmd_input_port, nullptr },
+ { "input_exclusive", nullptr, cmd_input_exclusive, nullptr },
+ { "run_to_frame", nullptr, cmd_run_to_frame, nullptr },
+ { "run", nullptr, cmd_run, nullptr },
+ { "run_until", nullptr, cmd_run_until, nullptr },
+ { "render_skip", nullptr, cmd_render_skip, nullptr },
+ { "benchmark", nullptr, cmd_benchmark, nullptr },
+ { "speed", nullptr, cmd_speed, nullptr },
+ { "pause", nullptr, cmd_pause, nullptr },
+ { "quit", nullptr, cmd_quit, nullptr },
+ { "dump_regs", nullptr, cmd_dump_regs, nullptr },
+ { "dump_mem", nullptr, cmd_dump_mem, nullptr },
+ { "status", nullptr, cmd_status, nullptr },
+ { "status_json", nullptr, cmd_status_json, nullptr },
+ { "read_mem", nullptr, cmd_read_mem, nullptr },
+ { "read_regs", nullptr, cmd_read_regs, nullptr },
+ { "dump_regs_bin", nullptr, cmd_dump_regs_bin, nullptr },
+ { "dump_slave_regs", nullptr, cmd_dump_slave_regs, nullptr },
+ { "call_stack", nullptr, cmd_call_stack, nullptr },
+ { "dump_slave_regs_bin", nullptr, cmd_dump_slave_regs_bin, nullptr },
+ { "poke", nullptr, cmd_poke, nullptr },
+ { "write_mem_bin", nullptr, cmd_write_mem_bin, nullptr },
+ { "dump_mem_bin", nullptr, cmd_dump_mem_bin, nullptr },
+ { "dump_region", nullptr, cmd_dump_region, nullptr },
+ { "vram_delta", nullptr, cmd_vram_delta, nullptr },
+ { "scan_start", nullptr, cmd_scan_start, nullptr },
+ { "scan_filter", nullptr, cmd_scan_filter, nullptr },
+ { "scan_list", nullptr, cmd_scan_list, nullptr },
+ { "scan_stop", nullptr, cmd_scan_stop, nullptr },
+ { "mem_snapshot", nullptr, cmd_mem_snapshot, nullptr },
+ { "mem_snapshot_free", nullptr, cmd_mem_snapshot_free, nullptr },
+ { "mem_diff", nullptr, cmd_mem_diff, nullptr },
+ { "shm_expose", nullptr, cmd_shm_expose, nullptr },
+ { "shm_sync", nullptr, cmd_shm_sync, nullptr },
+ { "shm_close", nullptr, cmd_shm_close, nullptr },
+ { "obs_expose", nullptr, cmd_obs_expose, nullptr },
+ { "obs_close", nullptr, cmd_obs_close, nullptr },
+ { "dump_vdp2_regs", nullptr, cmd_dump_vdp2_regs, nullptr },
+ { "dump_vdp1_fb", "which:s path:s [png=s]", nullptr, cmd_dump_vdp1_fb },
+ { "save_state", nullptr, cmd_save_state, nullptr },
+ { "save_state_raw", nullptr, cmd_save_state_raw, nullptr },
+ { "load_state", nullptr, cmd_load_state, nullptr },
+ { "movie_record", nullptr, cmd_movie_record, nullptr },
+ { "movie_play", nullptr, cmd_movie_play, nullptr },
+ { "movie_seek", nullptr, cmd_movie_seek, nullptr },
+ { "movie_stop", nullptr, cmd_movie_stop, nullptr },
+ { "movie_status", nullptr, cmd_movie_status, nullptr },
+ { "spawn", nullptr, cmd_spawn, nullptr },
+ { "pool_start", "n:u [dir=s] [state=s]", nullptr, cmd_pool_start },
+ { "pool_acquire", "", nullptr, cmd_pool_acquire },
+ { "pool_release", "id:u", nullptr, cmd_pool_release },
+ { "pool_status", "", nullptr, cmd_pool_status },
+ { "pool_stop", "", nullptr, cmd_pool_stop },
+ { "snap_save", nullptr, cmd_snap_save, nullptr },
+ { "snap_load", nullptr, cmd_snap_load, nullptr },
+ { "rewind", nullptr, cmd_rewind, nullptr },
+ { "rewind_status", nullptr, cmd_rewind_status, nullptr },
+ { "snap_free", nullptr, cmd_snap_free, nullptr },
+ { "tree_save", nullptr, cmd_tree_save, nullptr },
+ { "tree_load", nullptr, cmd_tree_load, nullptr },
+ { "tree_prune", nullptr, cmd_tree_prune, nullptr },
+ { "tree_info", nullptr, cmd_tree_info, nullptr },
+ { "pc_trace_frame", nullptr, cmd_pc_trace_frame, nullptr },
+ { "step", "[n:i]", nullptr, cmd_step },
+ { "step_over", nullptr, cmd_step_over, nullptr },
+ { "step_out", nullptr, cmd_step_over, nullptr },
+ { "step_slave", "[n:i]", nullptr, cmd_step_slave },
+ { "breakpoint", nullptr, cmd_breakpoint, nullptr },
+ { "breakpoint_remove", "[addr:x] [slave]", nullptr, cmd_breakpoint_remove },
+ { "breakpoint_clear", nullptr, cmd_breakpoint_clear, nullptr },
+ { "breakpoint_list", nullptr, cmd_breakpoint_list, nullptr },
+ { "breakpoint_set_from_file", nullptr, cmd_breakpoint_set_from_file, nullptr },
+ { "load_symbols", nullptr, cmd_load_symbols, nullptr },
+ { "symbols_clear", nullptr, cmd_symbols_clear, nullptr },
+ { "symbol_lookup", nullptr, cmd_symbol_lookup, nullptr },
+ { "breakpoint_hits_dump", nullptr, cmd_breakpoint_hits_dump, nullptr },
+ { "show_window", nullptr, cmd_show_window, nullptr },
+ { "hide_window", nullptr, cmd_hide_window, nullptr },
+ { "call_trace", nullptr, cmd_call_trace, nullptr },
+ { "call_trace_stop", nullptr, cmd_call_trace_stop, nullptr },
+ { "call_trace_filter", nullptr, cmd_call_trace_filter, nullptr },
+ { "call_trace_stats", nullptr, cmd_call_trace_stats, nullptr },
+ { "scdq_trace", nullptr, cmd_scdq_trace, nullptr },
+ { "scdq_trace_stop", nullptr, cmd_scdq_trace_stop, nullptr },
+ { "cdb_trace", nullptr, cmd_cdb_trace, nullptr },
+ { "cdb_trace_stop", nullptr, cmd_cdb_trace_stop, nullptr },
+ { "cdb_profile_start", nullptr, cmd_cdb_profile_start, nullptr },
+ { "cdb_profile_dump", nullptr, cmd_cdb_profile_dump, nullptr },
+ { "cdb_profile_stop", nullptr, cmd_cdb_profile_stop, nullptr },
+ { "hotmem_status", nullptr, cmd_hotmem_status, nullptr },
+ { "sound_status", nullptr, cmd_sound_status, nullptr },
+ { "unified_trace", nullptr, cmd_unified_trace, nullptr },
+ { "unified_trace_bin", nullptr, cmd_unified_trace_bin, nullptr },
+ { "unified_trace_stop", nullptr, cmd_unified_trace_stop, nullptr },
+ { "input_trace", nullptr, cmd_input_trace, nullptr },
+ { "input_trace_stop", nullptr, cmd_input_trace_stop, nullptr },
+ { "input_playback", nullptr, cmd_input_playback, nullptr },
+ { "input_playback_stop", nullptr, cmd_input_playback_stop, nullptr },
+ { "input_trace_bin", nullptr, cmd_input_trace_bin, nullptr },
+ { "input_playback_bin", nullptr, cmd_input_playback_bin, nullptr },
+ { "watchpoint", nullptr, cmd_watchpoint, nullptr },
+ { "read_watchpoint", nullptr, cmd_watchpoint, nullptr },
+ { "watchpoint_add", nullptr, cmd_watchpoint_add, nullptr },
+ { "watchpoint_remove", nullptr, cmd_watchpoint_remove, nullptr },
+ { "watchpoint_list", nullptr, cmd_watchpoint_list, nullptr },
+ { "watchpoint_clear", nullptr, cmd_watchpoint_clear, nullptr },
+ { "vdp2_watchpoint", nullptr, cmd_vdp2_watchpoint, nullptr },
+ { "vdp2_watchpoint_clear", nullptr, cmd_vdp2_watchpoint_clear, nullptr },
+ { "read_watchpoint_clear", nullptr, cmd_read_watchpoint_clear, nullptr },
+ { "deterministic", nullptr, cmd_deterministic, nullptr },
+ { "setting_get", nullptr, cmd_setting_get, nullptr },
+ { "setting_set", nullptr, cmd_setting_set, nullptr },
+ { "exception_break", nullptr, cmd_exception_break, nullptr },
+ { "insn_trace", nullptr, cmd_insn_trace, nullptr },
+ { "insn_trace_disasm", nullptr, cmd_insn_trace_disasm, nullptr },
+ { "insn_trace_unified", nullptr, cmd_insn_trace_unified, nullptr },
+ { "insn_trace_window", nullptr, cmd_insn_trace_window, nullptr },
+ { "insn_trace_window_status", nullptr, cmd_insn_trace_window_status, nullptr },
+ { "insn_trace_stop", nullptr, cmd_insn_trace_stop, nullptr },
+ { "dump_cycle", nullptr, cmd_dump_cycle, nullptr },
+ { "gdb_server", nullptr, cmd_gdb_server, nullptr },
+ { "run_to_line", nullptr, cmd_run_to_line, nullptr },
+ { "break_on_vblank_in", nullptr, cmd_break_on_vblank_in, nullptr },
+ { "break_on_vblank_out", nullptr, cmd_break_on_vblank_in, nullptr },
+ { "run_to_cycle", nullptr, cmd_run_to_cycle, nullptr },
+ { "history_start", nullptr, cmd_history_start, nullptr },
+ { "history_stop", nullptr, cmd_history_stop, nullptr },
+ { "history_status", nullptr, cmd_history_status, nullptr },
+ { "step_back", nullptr, cmd_step_back, nullptr },
+ { "reverse_continue", nullptr, cmd_step_back, nullptr },
+ { "profile_start", nullptr, cmd_profile_start, nullptr },
+ { "profile_stop", nullptr, cmd_profile_stop, nullptr },
+ { "profile_dump", nullptr, cmd_profile_dump, nullptr },
+ { "profile_status", nullptr, cmd_profile_status, nullptr },
+ { "cache_stats_start", nullptr, cmd_cache_stats_start, nullptr },
+ { "cache_stats", nullptr, cmd_cache_stats, nullptr },
+ { "cache_stats_dump", nullptr, cmd_cache_stats_dump, nullptr },
+ { "cache_stats_stop", nullptr, cmd_cache_stats_stop, nullptr },
+ { "cache_mode", nullptr, cmd_cache_mode, nullptr },
+ { "bus_profile_start", nullptr, cmd_bus_profile_start, nullptr },
+ { "bus_profile", nullptr, cmd_bus_profile, nullptr },
+ { "event_stats", nullptr, cmd_event_stats, nullptr },
+ { "bus_profile_stop", nullptr, cmd_bus_profile_stop, nullptr },
+ { "int_latency_start", nullptr, cmd_int_latency_start, nullptr },
+ { "int_latency", nullptr, cmd_int_latency, nullptr },
+ { "int_latency_dump", nullptr, cmd_int_latency_dump, nullptr },
+ { "int_latency_stop", nullptr, cmd_int_latency_stop, nullptr },
+ { "sync_profile_start", nullptr, cmd_sync_profile_start, nullptr },
+ { "sync_profile", nullptr, cmd_sync_profile, nullptr },
+ { "sync_profile_dump", nullptr, cmd_sync_profile_dump, nullptr },
+ { "sync_profile_stop", nullptr, cmd_sync_profile_stop, nullptr },
+ { "fb_hash_start", nullptr, cmd_fb_hash_start, nullptr },
+ { "fb_hash_stop", nullptr, cmd_fb_hash_stop, nullptr },
+ { "journal_record", nullptr, cmd_journal_record, nullptr },
+ { "journal_play", nullptr, cmd_journal_play, nullptr },
+ { "journal_stop", nullptr, cmd_journal_stop, nullptr },
+ { "diverge_record", nullptr, cmd_diverge_record, nullptr },
+ { "diverge_check", nullptr, cmd_diverge_record, nullptr },
+ { "state_hash", nullptr, cmd_state_hash, nullptr },
+ { "state_hash_log", nullptr, cmd_state_hash_log, nullptr },
+ { "state_hash_check", nullptr, cmd_state_hash_log, nullptr },
+ { "state_hash_stop", nullptr, cmd_state_hash_stop, nullptr },
+ { "diverge_stop", nullptr, cmd_diverge_stop, nullptr },
+ { "vdp2_timing_start", nullptr, cmd_vdp2_timing_start, nullptr },
+ { "perf_stats_start", nullptr, cmd_perf_stats_start, nullptr },
+ { "perf_stats", nullptr, cmd_perf_stats, nullptr },
+ { "frame_pacing", nullptr, cmd_frame_pacing, nullptr },
+ { "frame_pacing_reset", nullptr, cmd_frame_pacing_reset, nullptr },
+ { "perf_stats_stop", nullptr, cmd_perf_stats_stop, nullptr },
+ { "vdp2_timing", nullptr, cmd_vdp2_timing, nullptr },
+ { "vdp2_preview", nullptr, cmd_vdp2_preview, nullptr },
+ { "vdp2_timing_stop", nullptr, cmd_vdp2_timing_stop, nullptr },
+ { "vdp1_stats_start", nullptr, cmd_vdp1_stats_start, nullptr },
+ { "vdp1_stats", nullptr, cmd_vdp1_stats, nullptr },
+ { "vdp1_stats_stop", nullptr, cmd_vdp1_stats_stop, nullptr },
+ { "vdp1_cmd_stats_start", nullptr, cmd_vdp1_cmd_stats_start, nullptr },
+ { "vdp1_cmd_stats", nullptr, cmd_vdp1_cmd_stats, nullptr },
+ { "vdp1_cmd_stats_stop", nullptr, cmd_vdp1_cmd_stats_stop, nullptr },
+ { "vdp1_cmd_break", nullptr, cmd_vdp1_cmd_break, nullptr },
+ { "vdp1_cmd_break_remove", nullptr, cmd_vdp1_cmd_break, nullptr },
+ { "vdp1_cmd_break_clear", nullptr, cmd_vdp1_cmd_break_clear, nullptr },
+ { "vdp1_cmd_break_list", nullptr, cmd_vdp1_cmd_break_list, nullptr },
+ { "m68k_break", nullptr, cmd_m68k_break, nullptr },
+ { "m68k_break_remove", nullptr, cmd_m68k_break, nullptr },
+ { "m68k_break_clear", nullptr, cmd_m68k_break_clear, nullptr },
+ { "m68k_break_list", nullptr, cmd_m68k_break_list, nullptr },
+ { "m68k_step", nullptr, cmd_m68k_step, nullptr },
+ { "m68k_regs", nullptr, cmd_m68k_regs, nullptr },
+ { "m68k_watch", nullptr, cmd_m68k_watch, nullptr },
+ { "m68k_watch_clear", nullptr, cmd_m68k_watch_clear, nullptr },
+ { "m68k_call_trace", nullptr, cmd_m68k_call_trace, nullptr },
+ { "scsp_capture", nullptr, cmd_scsp_capture, nullptr },
+ { "scsp_capture_stop", nullptr, cmd_scsp_capture_stop, nullptr },
+ { "vdp1_capture_start", nullptr, cmd_vdp1_capture_start, nullptr },
+ { "vdp1_capture_stop", nullptr, cmd_vdp1_capture_stop, nullptr },
+ { "vdp1_bench", nullptr, cmd_vdp1_bench, nullptr },
+ { "nv_dump", nullptr, cmd_nv_dump, nullptr },
+ { "nv_load", nullptr, cmd_nv_dump, nullptr },
+ { "sh2_bench", nullptr, cmd_sh2_bench, nullptr },
+ { "vdp2_capture_start", nullptr, cmd_vdp2_capture_start, nullptr },
+ { "vdp2_capture_stop", nullptr, cmd_vdp2_capture_stop, nullptr },
+ { "vdp2_layer_capture", "path:s", nullptr, cmd_vdp2_layer_capture },
+ { "vdp2_layer_capture_cancel", nullptr, cmd_vdp2_layer_capture_cancel, nullptr },
+ { "vdp2_bench", nullptr, cmd_vdp2_bench, nullptr },
+ { "func_profile_start", nullptr, cmd_func_profile_start, nullptr },
+ { "func_profile_reset", nullptr, cmd_func_profile_reset, nullptr },
+ { "func_profile_stop", nullptr, cmd_func_profile_stop, nullptr },
+ { "func_profile_dump", nullptr, cmd_func_profile_dump, nullptr },
+ { "flight_rec_start", nullptr, cmd_flight_rec_start, nullptr },
+ { "flight_rec_stop", nullptr, cmd_flight_rec_stop, nullptr },
+ { "flight_rec_dump", nullptr, cmd_flight_rec_dump, nullptr },
+ { "crash_bundle", nullptr, cmd_crash_bundle, nullptr },
+ { "crash_bundle_now", nullptr, cmd_crash_bundle_now, nullptr },
+ { "call_graph_start", nullptr, cmd_call_graph_start, nullptr },
+ { "call_graph_reset", nullptr, cmd_call_graph_reset, nullptr },
+ { "call_graph_stop", nullptr, cmd_call_graph_stop, nullptr },
+ { "call_graph_dump", nullptr, cmd_call_graph_dump, nullptr },
+ { "cdl_start", nullptr, cmd_cdl_start, nullptr },
+ { "cdl_stop", nullptr, cmd_cdl_stop, nullptr },
+ { "cdl_reset", nullptr, cmd_cdl_reset, nullptr },
+ { "cdl_dump", nullptr, cmd_cdl_dump, nullptr },
+ { "cdl_status", nullptr, cmd_cdl_status, nullptr },
+ { "cdl_delta", nullptr, cmd_cdl_delta, nullptr },
+ { "cdl_overlay_log", "path:s [zlib]", nullptr, cmd_cdl_overlay_log },
+ { "cdl_overlay_stop", nullptr, cmd_cdl_overlay_stop, nullptr },
+ { "dma_trace", nullptr, cmd_dma_trace, nullptr },
+ { "dma_trace_stop", nullptr, cmd_dma_trace_stop, nullptr },
+ { "dma_trace_bin", "path:s [zlib] [frames_only]", nullptr, cmd_dma_trace_bin },
+ { "dma_trace_bin_stop", nullptr, cmd_dma_trace_bin_stop, nullptr },
+ { "mem_profile", nullptr, cmd_mem_profile, nullptr },
+ { "mem_profile_stop", nullptr, cmd_mem_profile_stop, nullptr },
+ { "write_log_start", nullptr, cmd_write_log_start, nullptr },
+ { "write_log_stop", nullptr, cmd_write_log_stop, nullptr },
+ { "write_log_status", nullptr, cmd_write_log_status, nullptr },
+ { "last_writer", nullptr, cmd_last_writer, nullptr },
+ { "mem_read_profile", nullptr, cmd_mem_read_profile, nullptr },
+ { "mem_read_profile_stop", nullptr, cmd_mem_read_profile_stop, nullptr },
+ { "mem_heatmap", nullptr, cmd_mem_heatmap, nullptr },
+ { "op_stats_start", nullptr, cmd_op_stats_start, nullptr },
+ { "op_stats_dump", nullptr, cmd_op_stats_dump, nullptr },
+ { "op_stats_stop", nullptr, cmd_op_stats_stop, nullptr },
+ { "dsp_profile_start", nullptr, cmd_dsp_profile_start, nullptr },
+ { "dsp_profile_dump", nullptr, cmd_dsp_profile_dump, nullptr },
+ { "dsp_profile_stop", nullptr, cmd_dsp_profile_stop, nullptr },
+ { "dsp_regs", nullptr, cmd_dsp_regs, nullptr },
+ { "dsp_dump_prog", nullptr, cmd_dsp_dump_prog, nullptr },
+ { "dsp_dump_data", nullptr, cmd_dsp_dump_prog, nullptr },
+ { "mem_heatmap_stop", nullptr, cmd_mem_heatmap_stop, nullptr },
+ { "mem_sample", nullptr, cmd_mem_sample, nullptr },
+ { "capture_plan", nullptr, cmd_capture_plan, nullptr },
+ { "mem_sample_stop", nullptr, cmd_mem_sample_stop, nullptr },
+ { "func_hook", nullptr, cmd_func_hook, nullptr },
+ { "func_hook_remove", nullptr, cmd_func_hook_remove, nullptr },
+ { "func_hook_clear", nullptr, cmd_func_hook_clear, nullptr },
+ { "func_hook_list", nullptr, cmd_func_hook_list, nullptr },
+ { "func_hook_log", nullptr, cmd_func_hook_log, nullptr },
+ { "func_hook_log_stop", nullptr, cmd_func_hook_log_stop, nullptr },
+ { "freeze", nullptr, cmd_freeze, nullptr },
+ { "freeze_remove", "addr:x", nullptr, cmd_freeze_remove },
+ { "freeze_clear", nullptr, cmd_freeze_clear, nullptr },
+ { "freeze_list", nullptr, cmd_freeze_list, nullptr },
+ { "poke_breakpoint", nullptr, cmd_poke_breakpoint, nullptr },
+ { "poke_breakpoint_remove", nullptr, cmd_poke_breakpoint_remove, nullptr },
+ { "poke_breakpoint_clear", nullptr, cmd_poke_breakpoint_clear, nullptr },
+ { "poke_breakpoint_list", nullptr, cmd_poke_breakpoint_list, nullptr },
+ { "poke_playback_start", nullptr, cmd_poke_playback_start, nullptr },
+ { "poke_playback_stop", nullptr, cmd_poke_playback_stop, nullptr },
+ { "poke_playback_status", nullptr, cmd_poke_playback_status, nullptr },
+ { "script_load", nullptr, cmd_script_load, nullptr },
+ { "script_add", nullptr, cmd_script_add, nullptr },
+ { "script_clear", nullptr, cmd_script_clear, nullptr },
+ { "script_list", nullptr, cmd_script_list, nullptr },
+};
+
+static std::unordered_map<std::string, CommandEntry> command_index;
+
+static const CommandEntry* cmd_lookup(const std::string& cmd)
+{
+ if (command_index.empty()) {
+  for (const CommandDef& d : command_table) {
+   CommandEntry& e = command_index[d.name];
+   e.def = &d;
+   if (d.schema && !cmd_parse_schema(d.schema, &e.args)) {
+    fprintf(stderr, "automation: bad schema for %s: %s\n", d.name, d.schema);
+    abort();
    }
-   write_ack("ok exception_break log");
-  } else if (mode == "disable") {
-   exception_mode = EXC_DISABLE;
-   exception_paused = false;
-   if (exc_log) { fclose(exc_log); exc_log = nullptr; }
-   write_ack("ok exception_break disable");
-  } else {
-   write_ack("error exception_break: usage: exception_break <enable|log|disable>");
   }
  }
- else if (cmd == "insn_trace") {
-  std::string path;
-  int64_t start_line = 0, stop_line = 0;
-  iss >> path >> start_line >> stop_line;
-  if (path.empty() || start_line <= 0 || stop_line <= 0) {
-   write_ack("error insn_trace: usage: insn_trace <path> <start_line> <stop_line>");
-  } else {
-   MDFN_IEN_SS::Automation_EnableInsnTrace(path.c_str(), start_line, stop_line);
-   char buf[256];
-   snprintf(buf, sizeof(buf), "ok insn_trace %s start=%lld stop=%lld", path.c_str(), (long long)start_line, (long long)stop_line);
-   write_ack(buf);
-  }
+
+ auto it = command_index.find(cmd);
+ return it == command_index.end() ? nullptr : &it->second;
+}
+
+static void dispatch_command(const std::string& line, std::istringstream& iss, const std::string& cmd)
+{
+ const CommandEntry* e = cmd_lookup(cmd);
+
+ if (!e)
+  write_ack("error unknown command: " + cmd);
+ else if (!e->def->schema)
+  e->def->raw(line, iss, cmd);
+ else {
+  CmdArgs args;
+  if (cmd_parse_args(*e, iss, &args))
+   e->def->typed(args);
+  else
+   write_ack("error " + cmd + ": usage: " + cmd + " " + e->def->schema);
  }
- else if (cmd == "insn_trace_unified") {
-  int64_t start_line = 0, stop_line = 0;
-  iss >> start_line >> stop_line;
-  if (start_line <= 0 || stop_line <= 0) {
-   write_ack("error insn_trace_unified: usage: insn_trace_unified <start_line> <stop_line>");
-  } else {
-   MDFN_IEN_SS::Automation_EnableInsnTraceUnified(start_line, stop_line);
-   char buf[256];
-   snprintf(buf, sizeof(buf), "ok insn_trace_unified start=%lld stop=%lld", (long long)start_line, (long long)stop_line);
-   write_ack(buf);
-  }
+}
+
+static bool check_action_file(void)
+{
+ // Content-based change detection: read file and check if header line changed.
+ // This avoids DrvFS stat() caching issues.
+ std::ifstream f(action_file);
+ if (!f.is_open())
+  return false;
+
+ // Read first line (header comment with sequence number, e.g. "# 5.....")
+ std::string header;
+ if (!std::getline(f, header)) {
+  f.close();
+  return false;
  }
- else if (cmd == "insn_trace_stop") {
-  MDFN_IEN_SS::Automation_DisableInsnTrace();
-  write_ack("ok insn_trace_stop");
+ // Strip \r
+ if (!header.empty() && header.back() == '\r')
+  header.pop_back();
+
+ if (header == last_action_header) {
+  f.close();
+  return false;
  }
- else if (cmd == "dump_cycle") {
-  char buf[64];
-  snprintf(buf, sizeof(buf), "ok dump_cycle value=%lld", (long long)get_cycle());
-  write_ack(buf);
+ last_action_header = header;
+ acks_to_socket = false;  // file commands are acked through the ack file
+
+ // Process remaining lines as commands
+ std::string line;
+ while (std::getline(f, line)) {
+  // Strip \r (Windows line endings)
+  if (!line.empty() && line.back() == '\r')
+   line.pop_back();
+  in_command++;
+  process_command(line);
+  in_command--;
  }
- else if (cmd == "run_to_cycle") {
-  int64_t n = 0;
-  iss >> n;
-  int64_t current = get_cycle();
-  if (n <= current) {
-   char buf[128];
-   snprintf(buf, sizeof(buf), "warning run_to_cycle: target %lld <= current %lld, firing immediately", (long long)n, (long long)current);
-   write_ack(buf);
-   return;
+ f.close();
+
+ // A batch must be complete within one action file write.
+ if (batch_active)
+  finish_batch(" unterminated");
+
+ return true;
+}
+
+// Accept a pending connection and run any complete command lines received
+// from the socket client. Non-blocking; returns true if any command ran.
+static bool check_socket(void)
+{
+ if (sock_listen_fd == AUTO_SOCK_INVALID)
+  return false;
+
+ if (sock_client_fd == AUTO_SOCK_INVALID) {
+  auto_sock_t c = accept(sock_listen_fd, NULL, NULL);
+  if (c == AUTO_SOCK_INVALID)
+   return false;
+  // Commands are short; don't let Nagle hold back ack bytes on TCP.
+  {
+   int one = 1;
+   setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
   }
-  run_to_cycle_target = n;
-  instruction_paused = false;
-  watchpoint_paused = false;
-  read_watchpoint_paused = false;
-  exception_paused = false;
-  instructions_to_step = -1;
-  if (frames_to_advance == 0)
-   frames_to_advance = -1;
-  update_cpu_hook();
-  char buf[128];
-  snprintf(buf, sizeof(buf), "ok run_to_cycle target=%lld", (long long)n);
-  write_ack(buf);
+#ifdef WIN32
+  u_long nb = 1;
+  ioctlsocket(c, FIONBIO, &nb);
+#else
+  fcntl(c, F_SETFL, fcntl(c, F_GETFL) | O_NONBLOCK);
+#endif
+  sock_client_fd = c;
+  sock_rx_buf.clear();
+  fprintf(stderr, "Automation: socket client connected\n");
  }
- else if (cmd == "cdl_start") {
-  // Optional: cdl_start <lo_hex> <hi_hex>
-  // Defaults to HWR: 0x06000000-0x06100000
-  uint32_t lo = 0x06000000, hi = 0x06100000;
-  uint32_t user_lo;
-  if (iss >> std::hex >> user_lo) {
-   uint32_t user_hi;
-   if (!(iss >> std::hex >> user_hi)) {
-    write_ack("error cdl_start: need both lo and hi, or neither");
-   } else {
-    lo = user_lo;
-    hi = user_hi;
-   }
+
+ bool ran = false;
+ char buf[4096];
+ for (;;) {
+  // An open batch is a transaction: keep reading (without letting
+  // emulation run) until batch_end arrives or the client goes away.
+  if (batch_active && automation_active) {
+#ifdef WIN32
+   WSAPOLLFD pfd;
+#else
+   struct pollfd pfd;
+#endif
+   pfd.fd = sock_client_fd;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+#ifdef WIN32
+   WSAPoll(&pfd, 1, 10);
+#else
+   poll(&pfd, 1, 10);
+#endif
+   check_exit_requested();
   }
-  MDFN_IEN_SS::Automation_CDLStart(lo, hi);
-  // Use actual range from CDL state (after masking/validation)
-  uint32_t actual_lo = MDFN_IEN_SS::Automation_CDLGetLo();
-  uint32_t actual_hi = MDFN_IEN_SS::Automation_CDLGetHi();
-  uint32_t actual_size = MDFN_IEN_SS::Automation_CDLGetSize();
-  if (actual_size == 0) {
-   write_ack("error cdl_start: invalid range");
-  } else {
-   char buf[128];
-   snprintf(buf, sizeof(buf), "ok cdl_start 0x%08X-0x%08X (%uKB)",
-            actual_lo, actual_hi, actual_size / 1024);
-   write_ack(buf);
+
+#ifdef WIN32
+  int n = recv(sock_client_fd, buf, sizeof(buf), 0);
+#else
+  ssize_t n = recv(sock_client_fd, buf, sizeof(buf), 0);
+#endif
+  if (n == 0) {
+   fprintf(stderr, "Automation: socket client disconnected\n");
+   socket_close_client();
+   break;
+  }
+  if (n < 0) {
+#ifdef WIN32
+   if (WSAGetLastError() != WSAEWOULDBLOCK)
+    socket_close_client();
+   else if (batch_active && automation_active)
+    continue;
+#else
+   if (errno == EINTR)
+    continue;
+   if (errno != EAGAIN && errno != EWOULDBLOCK)
+    socket_close_client();
+   else if (batch_active && automation_active)
+    continue;
+#endif
+   break;
+  }
+  sock_rx_buf.append(buf, n);
+
+  size_t pos;
+  while ((pos = sock_rx_buf.find('\n')) != std::string::npos) {
+   std::string line = sock_rx_buf.substr(0, pos);
+   sock_rx_buf.erase(0, pos + 1);
+   if (!line.empty() && line.back() == '\r')
+    line.pop_back();
+   acks_to_socket = true;
+   in_command++;
+   process_command(line);
+   in_command--;
+   ran = true;
+   // A command may have dropped the connection (e.g. send failure).
+   if (sock_client_fd == AUTO_SOCK_INVALID)
+    return ran;
   }
  }
- else if (cmd == "cdl_stop") {
-  MDFN_IEN_SS::Automation_CDLStop();
-  write_ack("ok cdl_stop");
- }
- else if (cmd == "cdl_reset") {
-  MDFN_IEN_SS::Automation_CDLReset();
-  write_ack("ok cdl_reset");
+ return ran;
+}
+
+static void gdb_close_client(void)
+{
+ if (gdb_client_fd != AUTO_SOCK_INVALID) {
+  auto_sock_close(gdb_client_fd);
+  gdb_client_fd = AUTO_SOCK_INVALID;
+  fprintf(stderr, "Automation: gdb disconnected\n");
  }
- else if (cmd == "cdl_dump") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error cdl_dump: no path");
-  } else {
-   if (MDFN_IEN_SS::Automation_CDLDump(path.c_str()))
-    write_ack("ok cdl_dump " + path);
-   else
-    write_ack("error cdl_dump: cannot open " + path);
+ gdb_rx_buf.clear();
+ gdb_last_packet.clear();
+ gdb_no_ack = false;
+ gdb_resumed = false;
+ gdb_thread_g = gdb_thread_c = 0;
+}
+
+static bool gdb_send_raw(const std::string& s)
+{
+ const char* data = s.data();
+ size_t len = s.size();
+ while (len > 0) {
+#ifdef WIN32
+  int n = send(gdb_client_fd, data, (int)len, 0);
+#elif defined(MSG_NOSIGNAL)
+  ssize_t n = send(gdb_client_fd, data, len, MSG_NOSIGNAL);
+#else
+  ssize_t n = send(gdb_client_fd, data, len, 0);
+#endif
+  if (n <= 0) {
+#ifndef WIN32
+   if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+    struct pollfd pfd = { gdb_client_fd, POLLOUT, 0 };
+    poll(&pfd, 1, 100);
+    continue;
+   }
+#endif
+   gdb_close_client();
+   return false;
   }
+  data += n;
+  len -= n;
  }
- else if (cmd == "cdl_status") {
-  write_ack(std::string("ok cdl_status active=") +
-   (MDFN_IEN_SS::Automation_CDLIsActive() ? "true" : "false"));
+ return true;
+}
+
+static void gdb_send(const std::string& payload)
+{
+ uint8_t sum = 0;
+ for (char c : payload)
+  sum += (uint8_t)c;
+ char tail[4];
+ snprintf(tail, sizeof(tail), "#%02x", sum);
+ gdb_last_packet = "$" + payload + tail;
+ gdb_send_raw(gdb_last_packet);
+}
+
+static std::string gdb_hex(const void* data, size_t len)
+{
+ static const char digits[] = "0123456789abcdef";
+ std::string s;
+ s.reserve(len * 2);
+ for (size_t i = 0; i < len; i++) {
+  const uint8_t b = ((const uint8_t*)data)[i];
+  s += digits[b >> 4];
+  s += digits[b & 0xF];
  }
- else if (cmd == "dma_trace") {
-  std::string path;
-  iss >> path;
-  if (path.empty()) {
-   write_ack("error dma_trace: no path");
-  } else {
-   MDFN_IEN_SS::Automation_EnableDMATrace(path.c_str());
-   write_ack("ok dma_trace " + path);
-  }
+ return s;
+}
+
+static bool gdb_unhex(const char* s, size_t nbytes, uint8_t* out)
+{
+ for (size_t i = 0; i < nbytes; i++) {
+  char hex[3] = { s[i * 2], s[i * 2 + 1], 0 };
+  char* end = nullptr;
+  if (!hex[0] || !hex[1])
+   return false;
+  out[i] = (uint8_t)strtoul(hex, &end, 16);
+  if (*end)
+   return false;
  }
- else if (cmd == "dma_trace_stop") {
-  MDFN_IEN_SS::Automation_DisableDMATrace();
-  write_ack("ok dma_trace_stop");
+ return true;
+}
+
+// Register values go over the wire in target (big-endian) byte order.
+static std::string gdb_hex32(uint32_t v)
+{
+ char buf[9];
+ snprintf(buf, sizeof(buf), "%08x", v);
+ return buf;
+}
+
+// Run an automation command and return its ack, without sending it anywhere.
+static std::string gdb_command(const std::string& line)
+{
+ std::istringstream iss(line);
+ std::string cmd;
+ iss >> cmd;
+ const bool was_running = script_running;
+ script_running = true;
+ script_ack.clear();
+ dispatch_command(line, iss, cmd);
+ script_running = was_running;
+ return script_ack;
+}
+
+static bool gdb_target_stopped(void)
+{
+ return instruction_paused || watchpoint_paused || read_watchpoint_paused || exception_paused || frames_to_advance == 0;
+}
+
+// Thread ids: 1 = master, 2 = slave; 0 and -1 (any / all) pick the master.
+static unsigned gdb_parse_thread(const std::string& s)
+{
+ return strtol(s.c_str(), nullptr, 16) == 2 ? 1 : 0;
+}
+
+static std::string gdb_stop_reply(void)
+{
+ char buf[32];
+ snprintf(buf, sizeof(buf), "T%02x", gdb_signal);
+ return buf + (gdb_signal == 5 ? gdb_stop_why : std::string()) + "thread:" + (gdb_stop_cpu ? "2" : "1") + ";";
+}
+
+static void gdb_resume(bool step, unsigned cpu)
+{
+ gdb_signal = 5;
+ gdb_stop_cpu = cpu;
+ gdb_stop_why.clear();
+ gdb_resumed = true;
+ gdb_command(step ? (cpu ? "step_slave 1" : "step 1") : "run");
+}
+
+// Stop the running target at the next master instruction (^C, or '?' while running).
+static void gdb_halt(void)
+{
+ gdb_resumed = true;
+ gdb_signal = 2;
+ if (!gdb_target_stopped())
+  gdb_command("step 1");
+}
+
+static std::string gdb_watch(bool insert, char type, uint32_t addr, uint32_t len)
+{
+ char key[48];
+ snprintf(key, sizeof(key), "%c,%x,%x", type, addr, len);
+ if (!insert) {
+  auto it = gdb_watch_ids.find(key);
+  if (it == gdb_watch_ids.end())
+   return "E01";
+  for (unsigned id : it->second)
+   remove_watchpoint(id);
+  gdb_watch_ids.erase(it);
+  return "OK";
  }
- else if (cmd == "mem_profile") {
-  uint32_t lo = 0, hi = 0;
-  std::string path;
-  iss >> std::hex >> lo >> hi >> path;
-  if (path.empty()) {
-   write_ack("error mem_profile: usage: mem_profile <lo_hex> <hi_hex> <path>");
-  } else {
-   MDFN_IEN_SS::Automation_EnableMemProfile(path.c_str(), lo, hi);
-   char buf[256];
-   snprintf(buf, sizeof(buf), "ok mem_profile 0x%08X-0x%08X %s", lo, hi, path.c_str());
-   write_ack(buf);
+ std::vector<unsigned> ids;
+ for (unsigned pass = 0; pass < 2; pass++) {
+  // 2 = write, 3 = read, 4 = access (both)
+  const bool is_read = pass ? true : type == '3';
+  if (pass && type != '4')
+   break;
+  Watchpoint wp;
+  wp.addr = addr;
+  wp.len = len ? len : 1;
+  wp.is_read = is_read;
+  const unsigned id = add_watchpoint(wp);
+  if (!id) {
+   for (unsigned i : ids)
+    remove_watchpoint(i);
+   return "E01";
   }
+  ids.push_back(id);
+ }
+ gdb_watch_ids[key] = ids;
+ return "OK";
+}
+
+static void gdb_packet(const std::string& p)
+{
+ const char kind = p.empty() ? 0 : p[0];
+ const unsigned cpu_g = gdb_thread_g;
+
+ if (kind == '?') {
+  if (gdb_target_stopped())
+   gdb_send(gdb_stop_reply());
+  else
+   gdb_halt();
  }
- else if (cmd == "mem_profile_stop") {
-  MDFN_IEN_SS::Automation_DisableMemProfile();
-  write_ack("ok mem_profile_stop");
+ else if (p.compare(0, 10, "qSupported") == 0)
+  gdb_send("PacketSize=4000;QStartNoAckMode+;vContSupported+;swbreak+;hwbreak+");
+ else if (p == "QStartNoAckMode") {
+  gdb_send("OK");
+  gdb_no_ack = true;
  }
- else if (cmd == "mem_read_profile") {
-  uint32_t lo = 0, hi = 0;
-  std::string path;
-  iss >> std::hex >> lo >> hi >> path;
-  if (path.empty()) {
-   write_ack("error mem_read_profile: usage: mem_read_profile <lo_hex> <hi_hex> <path>");
-  } else {
-   MDFN_IEN_SS::Automation_EnableMemReadProfile(path.c_str(), lo, hi);
-   char buf[256];
-   snprintf(buf, sizeof(buf), "ok mem_read_profile 0x%08X-0x%08X %s", lo, hi, path.c_str());
-   write_ack(buf);
+ else if (p == "qAttached")
+  gdb_send("1");
+ else if (p == "qC")
+  gdb_send(gdb_stop_cpu ? "QC2" : "QC1");
+ else if (p == "qfThreadInfo")
+  gdb_send("m1,2");
+ else if (p == "qsThreadInfo")
+  gdb_send("l");
+ else if (p.compare(0, 17, "qThreadExtraInfo,") == 0) {
+  const char* name = gdb_parse_thread(p.substr(17)) ? "slave SH-2" : "master SH-2";
+  gdb_send(gdb_hex(name, strlen(name)));
+ }
+ else if (p == "qOffsets")
+  gdb_send("Text=0;Data=0;Bss=0");
+ else if (p.compare(0, 6, "qRcmd,") == 0) {
+  // monitor <automation command>
+  std::string line(p.size() / 2 - 3, 0);
+  if (!gdb_unhex(p.c_str() + 6, line.size(), (uint8_t*)&line[0]))
+   gdb_send("E01");
+  else {
+   const std::string out = gdb_command(line) + "\n";
+   gdb_send("O" + gdb_hex(out.data(), out.size()));
+   gdb_send("OK");
   }
  }
- else if (cmd == "mem_read_profile_stop") {
-  MDFN_IEN_SS::Automation_DisableMemReadProfile();
-  write_ack("ok mem_read_profile_stop");
+ else if (kind == 'H' && p.size() >= 2) {
+  (p[1] == 'g' ? gdb_thread_g : gdb_thread_c) = gdb_parse_thread(p.substr(2));
+  gdb_send("OK");
  }
- else if (cmd == "mem_sample") {
-  uint32_t addr = 0, sz = 0;
-  int64_t frames = 0;
-  std::string path;
-  iss >> std::hex >> addr >> sz >> std::dec >> frames >> path;
-  if (path.empty() || sz == 0 || frames <= 0) {
-   write_ack("error mem_sample: usage: mem_sample <addr_hex> <size_hex> <frames_dec> <path>");
-  } else {
-   if (sz > 0x10000) sz = 0x10000;  // 64KB max per frame
-   if (mem_sample_file) fclose(mem_sample_file);
-   mem_sample_file = fopen(path.c_str(), "wb");
-   if (mem_sample_file) {
-    mem_sample_addr = addr;
-    mem_sample_size = sz;
-    mem_sample_frames = frames;
-    mem_sample_total = frames;
-    // Free-run — mem_sample_frames controls when to stop
-    frames_to_advance = -1;
-    instruction_paused = false;
-    watchpoint_paused = false;
-    read_watchpoint_paused = false;
-    exception_paused = false;
-    instructions_to_step = -1;
-    run_to_cycle_target = -1;
-    update_cpu_hook();
-    char buf[256];
-    snprintf(buf, sizeof(buf), "ok mem_sample 0x%08X 0x%X %lld %s",
-             addr, sz, (long long)frames, path.c_str());
-    write_ack(buf);
-   } else {
-    write_ack("error mem_sample: cannot open " + path);
-   }
-  }
+ else if (kind == 'T')
+  gdb_send("OK");  // both threads are always alive
+ else if (kind == 'g') {
+  uint32_t regs[MDFN_IEN_SS::GDBReg_Count];
+  MDFN_IEN_SS::Automation_GetGDBRegs(cpu_g, regs);
+  std::string out;
+  for (uint32_t r : regs)
+   out += gdb_hex32(r);
+  gdb_send(out);
  }
- else if (cmd == "mem_sample_stop") {
-  if (mem_sample_file) {
-   int64_t captured = mem_sample_total - mem_sample_frames;
-   fclose(mem_sample_file);
-   mem_sample_file = nullptr;
-   mem_sample_frames = 0;
-   char buf[128];
-   snprintf(buf, sizeof(buf), "ok mem_sample_stop captured=%lld", (long long)captured);
-   write_ack(buf);
-  } else {
-   write_ack("ok mem_sample_stop (not active)");
-  }
- }
- else if (cmd == "poke_breakpoint") {
-  // poke_breakpoint <trigger_pc_hex> <n_pokes> <addr_hex>:<val_hex>:<width> ...
-  // Each hit at trigger_pc writes all pokes (atomic, no intervening cycles)
-  // and continues without pausing. Replaces any existing trigger at that PC.
-  uint32_t tpc = 0;
-  int n_pokes = 0;
-  iss >> std::hex >> tpc;
-  iss >> std::dec >> n_pokes;
-  if (n_pokes < 1 || n_pokes > 64) {
-   write_ack("error poke_breakpoint: n_pokes out of range (1..64)");
-   return;
+ else if (kind == 'p') {
+  const unsigned n = strtoul(p.c_str() + 1, nullptr, 16);
+  uint32_t regs[MDFN_IEN_SS::GDBReg_Count];
+  MDFN_IEN_SS::Automation_GetGDBRegs(cpu_g, regs);
+  gdb_send(n < MDFN_IEN_SS::GDBReg_Count ? gdb_hex32(regs[n]) : std::string("E01"));
+ }
+ else if (kind == 'G' || kind == 'P') {
+  // G: all registers from index 0; P<n>=<value>: one. PC can only be "written" unchanged.
+  uint32_t cur[MDFN_IEN_SS::GDBReg_Count];
+  MDFN_IEN_SS::Automation_GetGDBRegs(cpu_g, cur);
+  unsigned first = 0;
+  const char* hex = p.c_str() + 1;
+  if (kind == 'P') {
+   char* end = nullptr;
+   first = strtoul(hex, &end, 16);
+   hex = (*end == '=') ? end + 1 : "";
   }
-  std::vector<PokeOp> pokes;
-  pokes.reserve(n_pokes);
-  for (int i = 0; i < n_pokes; i++) {
-   std::string spec;
-   if (!(iss >> spec)) {
-    write_ack("error poke_breakpoint: missing poke spec");
-    return;
-   }
-   // Split spec on ':'
-   size_t c1 = spec.find(':');
-   size_t c2 = (c1 == std::string::npos) ? std::string::npos : spec.find(':', c1 + 1);
-   if (c1 == std::string::npos || c2 == std::string::npos) {
-    write_ack("error poke_breakpoint: bad spec (need addr:val:width): " + spec);
-    return;
-   }
-   PokeOp p;
-   try {
-    p.addr  = (uint32_t)std::stoul(spec.substr(0, c1), nullptr, 16);
-    p.value = (uint32_t)std::stoul(spec.substr(c1 + 1, c2 - c1 - 1), nullptr, 16);
-    int w   = std::stoi(spec.substr(c2 + 1));
-    if (w != 8 && w != 16 && w != 32) {
-     write_ack("error poke_breakpoint: width must be 8/16/32");
-     return;
-    }
-    p.width = (uint8_t)w;
-   } catch (...) {
-    write_ack("error poke_breakpoint: parse error in spec: " + spec);
-    return;
-   }
-   pokes.push_back(p);
-  }
-  // If a playback was active at this PC, it's being replaced — clear flags.
-  auto existing = poke_triggers.find(tpc);
-  if (existing != poke_triggers.end() && existing->second.is_playback) {
-   if (poke_playback_running && poke_playback_pc == tpc) {
-    poke_playback_running = false;
-    poke_playback_pc = 0;
-   }
+  std::vector<uint32_t> vals;
+  for (size_t len = strlen(hex); len >= 8 && first + vals.size() < MDFN_IEN_SS::GDBReg_Count; len -= 8, hex += 8) {
+   uint8_t b[4];
+   if (!gdb_unhex(hex, 4, b))
+    break;
+   vals.push_back(MDFN_de32msb(b));
   }
-  PokeTrigger trig;
-  trig.is_playback     = false;
-  trig.static_pokes    = std::move(pokes);
-  trig.trigger_hits    = 0;
-  trig.pokes_performed = 0;
-  poke_triggers[tpc]   = std::move(trig);
-  update_cpu_hook();
-  char buf[128];
-  snprintf(buf, sizeof(buf), "ok poke_breakpoint 0x%08X pokes=%d total_triggers=%zu",
-           tpc, n_pokes, poke_triggers.size());
-  write_ack(buf);
+  bool ok = !vals.empty();
+  for (size_t i = 0; ok && i < vals.size(); i++)
+   ok = first + i != MDFN_IEN_SS::GDBReg_PC || vals[i] == cur[MDFN_IEN_SS::GDBReg_PC];
+  for (size_t i = 0; ok && i < vals.size(); i++)
+   if (first + i != MDFN_IEN_SS::GDBReg_PC)
+    MDFN_IEN_SS::Automation_SetGDBReg(cpu_g, first + i, vals[i]);
+  gdb_send(ok ? "OK" : "E01");
  }
- else if (cmd == "poke_breakpoint_remove") {
-  uint32_t tpc = 0;
-  iss >> std::hex >> tpc;
-  auto it = poke_triggers.find(tpc);
-  if (it == poke_triggers.end()) {
-   char buf[64];
-   snprintf(buf, sizeof(buf), "error poke_breakpoint_remove: not found 0x%08X", tpc);
-   write_ack(buf);
-   return;
-  }
-  if (it->second.is_playback && poke_playback_running && poke_playback_pc == tpc) {
-   poke_playback_running = false;
-   poke_playback_pc = 0;
+ else if (kind == 'm') {
+  uint32_t addr = 0, len = 0;
+  if (sscanf(p.c_str() + 1, "%x,%x", &addr, &len) != 2)
+   gdb_send("E01");
+  else {
+   std::vector<uint8_t> buf(std::min<uint32_t>(len, 0x1F00));
+   if (!buf.empty())
+    MDFN_IEN_SS::Automation_ReadMemBlock(addr, buf.data(), buf.size());
+   gdb_send(gdb_hex(buf.data(), buf.size()));
   }
-  poke_triggers.erase(it);
-  update_cpu_hook();
-  char buf[128];
-  snprintf(buf, sizeof(buf), "ok poke_breakpoint_remove 0x%08X total_triggers=%zu",
-           tpc, poke_triggers.size());
-  write_ack(buf);
  }
- else if (cmd == "poke_breakpoint_clear") {
-  size_t count = poke_triggers.size();
-  poke_triggers.clear();
-  poke_playback_running = false;
-  poke_playback_pc = 0;
-  poke_playback_halt_pending = false;
-  update_cpu_hook();
-  write_ack("ok poke_breakpoint_clear removed=" + std::to_string(count));
- }
- else if (cmd == "poke_breakpoint_list") {
-  std::ostringstream ss;
-  ss << "poke_triggers count=" << poke_triggers.size();
-  for (const auto& kv : poke_triggers) {
-   char buf[128];
-   if (kv.second.is_playback) {
-    snprintf(buf, sizeof(buf), " 0x%08X=playback(rows=%zu,cur=%zu,hits=%llu)",
-             kv.first, kv.second.rows.size(), kv.second.cur_row,
-             (unsigned long long)kv.second.trigger_hits);
-   } else {
-    snprintf(buf, sizeof(buf), " 0x%08X=static(pokes=%zu,hits=%llu)",
-             kv.first, kv.second.static_pokes.size(),
-             (unsigned long long)kv.second.trigger_hits);
-   }
-   ss << buf;
+ else if (kind == 'M') {
+  uint32_t addr = 0, len = 0;
+  const size_t colon = p.find(':');
+  std::vector<uint8_t> data;
+  bool ok = colon != std::string::npos && sscanf(p.c_str() + 1, "%x,%x", &addr, &len) == 2
+            && p.size() - colon - 1 >= (size_t)len * 2;
+  if (ok) {
+   data.resize(len);
+   ok = gdb_unhex(p.c_str() + colon + 1, len, data.data());
   }
-  write_ack(ss.str());
- }
- else if (cmd == "poke_playback_start") {
-  // poke_playback_start <trigger_pc> <base_addr> <start_row> <end_row>
-  //                     <on_end> <n_cols> <col1> ... <colN> <csv_path>
-  // Each col: <csv_name>:<offset_hex>:<width>[:<slice_lo>:<slice_hi>]
-  // on_end: halt|loop|hold
-  // end_row=-1 means EOF. Replaces any existing trigger at that PC, and
-  // supersedes any prior playback (only one playback cursor at a time).
-  uint32_t tpc = 0, base = 0;
-  int64_t  start_row_in = 0, end_row_in = -1;
-  std::string on_end_str;
-  int n_cols = 0;
-  iss >> std::hex >> tpc >> base;
-  iss >> std::dec >> start_row_in >> end_row_in >> on_end_str >> n_cols;
-  if (n_cols < 1 || n_cols > 256) {
-   write_ack("error poke_playback_start: n_cols out of range (1..256)");
-   return;
+  if (ok && len) {
+   ok = MDFN_IEN_SS::Automation_WriteMemBlock(addr, data.data(), len) == len;
+   journal_poke(addr, data.data(), len);
+   history_event(HistEv_Poke, addr, data.data(), len);
   }
-  PokePlaybackOnEnd on_end;
-  if      (on_end_str == "halt") on_end = PPOE_HALT;
-  else if (on_end_str == "loop") on_end = PPOE_LOOP;
-  else if (on_end_str == "hold") on_end = PPOE_HOLD;
-  else {
-   write_ack("error poke_playback_start: on_end must be halt|loop|hold");
-   return;
+  gdb_send(ok ? "OK" : "E01");
+ }
+ else if ((kind == 'Z' || kind == 'z') && p.size() > 3) {
+  uint32_t addr = 0, len = 0;
+  sscanf(p.c_str() + 3, "%x,%x", &addr, &len);
+  const bool insert = (kind == 'Z');
+  if (p[1] == '0' || p[1] == '1') {
+   char line[64];
+   snprintf(line, sizeof(line), insert ? "breakpoint %08X" : "breakpoint_remove %08X", addr);
+   gdb_send(gdb_command(line).compare(0, 6, "error ") ? "OK" : "E01");
   }
-  // Parse column specs
-  std::vector<std::string>        col_names(n_cols);
-  std::vector<PokePlaybackCol>    cols(n_cols);
-  for (int i = 0; i < n_cols; i++) {
-   std::string spec;
-   if (!(iss >> spec)) {
-    write_ack("error poke_playback_start: missing column spec");
-    return;
-   }
-   // Split on ':' into up to 5 parts: name, offset, width, [slice_lo, slice_hi]
-   std::vector<std::string> parts;
-   size_t start = 0;
-   while (true) {
-    size_t pos = spec.find(':', start);
-    if (pos == std::string::npos) { parts.push_back(spec.substr(start)); break; }
-    parts.push_back(spec.substr(start, pos - start));
-    start = pos + 1;
-   }
-   if (parts.size() != 3 && parts.size() != 5) {
-    write_ack("error poke_playback_start: column spec must be name:offset:width[:lo:hi] — got " + spec);
-    return;
-   }
-   try {
-    col_names[i]          = parts[0];
-    cols[i].offset        = (uint32_t)std::stoul(parts[1], nullptr, 16);
-    int w                 = std::stoi(parts[2]);
-    if (w != 8 && w != 16 && w != 32) {
-     write_ack("error poke_playback_start: width must be 8/16/32");
-     return;
-    }
-    cols[i].width         = (uint8_t)w;
-    cols[i].slice_enabled = (parts.size() == 5);
-    if (cols[i].slice_enabled) {
-     cols[i].slice_lo = std::stoi(parts[3]);
-     cols[i].slice_hi = std::stoi(parts[4]);
-     if (cols[i].slice_lo < 0 || cols[i].slice_hi > 4
-         || cols[i].slice_lo >= cols[i].slice_hi
-         || (cols[i].slice_hi - cols[i].slice_lo) * 8 != w) {
-      write_ack("error poke_playback_start: bad byte_slice (must be within [0,4] and match width)");
-      return;
-     }
-    } else {
-     cols[i].slice_lo = cols[i].slice_hi = 0;
-    }
-    cols[i].csv_col_idx   = 0; // filled in after header parse
-   } catch (...) {
-    write_ack("error poke_playback_start: parse error in col spec: " + spec);
-    return;
+  else if (p[1] >= '2' && p[1] <= '4')
+   gdb_send(gdb_watch(insert, p[1], addr, len));
+  else
+   gdb_send("");
+ }
+ else if (kind == 'c' || kind == 'C')
+  gdb_resume(false, 0);
+ else if (kind == 's' || kind == 'S')
+  gdb_resume(true, gdb_thread_c);
+ else if (p == "vCont?")
+  gdb_send("vCont;c;C;s;S;t");
+ else if (p.compare(0, 6, "vCont;") == 0) {
+  // Both CPUs always run together, so only the stepped thread (if any) matters.
+  bool step = false, stop = false;
+  unsigned step_cpu = gdb_thread_c;
+  std::istringstream acts(p.substr(6));
+  std::string act;
+  while (std::getline(acts, act, ';')) {
+   const size_t colon = act.find(':');
+   if (act[0] == 's' || act[0] == 'S') {
+    step = true;
+    if (colon != std::string::npos)
+     step_cpu = gdb_parse_thread(act.substr(colon + 1));
+    break;
    }
+   if (act[0] == 't')
+    stop = true;
   }
-  // Rest of line is the CSV path (single token, no spaces supported)
-  std::string csv_path;
-  iss >> csv_path;
-  if (csv_path.empty()) {
-   write_ack("error poke_playback_start: missing csv_path");
-   return;
-  }
-  std::ifstream cf(csv_path);
-  if (!cf.is_open()) {
-   write_ack("error poke_playback_start: cannot open CSV " + csv_path);
+  if (step)
+   gdb_resume(true, step_cpu);
+  else if (stop)
+   gdb_halt();
+  else
+   gdb_resume(false, 0);
+ }
+ else if (kind == 'D') {
+  gdb_send("OK");
+  gdb_close_client();
+  if (gdb_target_stopped())
+   gdb_command("run");
+ }
+ else if (kind == 'k')
+  gdb_close_client();
+ else
+  gdb_send("");  // unsupported
+}
+
+// Accept a debugger and handle whatever it has sent; non-blocking. The stop
+// reply owed after a resume goes out here once the emulator is paused again.
+static void check_gdb(void)
+{
+ if (gdb_listen_fd == AUTO_SOCK_INVALID)
+  return;
+
+ if (gdb_client_fd == AUTO_SOCK_INVALID) {
+  auto_sock_t c = accept(gdb_listen_fd, NULL, NULL);
+  if (c == AUTO_SOCK_INVALID)
    return;
-  }
-  // Parse header
-  std::string line;
-  if (!std::getline(cf, line)) {
-   write_ack("error poke_playback_start: empty CSV");
+  int one = 1;
+  setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef WIN32
+  u_long nb = 1;
+  ioctlsocket(c, FIONBIO, &nb);
+#else
+  fcntl(c, F_SETFL, fcntl(c, F_GETFL) | O_NONBLOCK);
+#endif
+  gdb_client_fd = c;
+  fprintf(stderr, "Automation: gdb connected\n");
+ }
+
+ char buf[4096];
+ for (;;) {
+#ifdef WIN32
+  int n = recv(gdb_client_fd, buf, sizeof(buf), 0);
+#else
+  ssize_t n = recv(gdb_client_fd, buf, sizeof(buf), 0);
+#endif
+  if (n == 0) {
+   gdb_close_client();
    return;
   }
-  auto split_csv = [](const std::string& s, std::vector<std::string>& out) {
-   out.clear();
-   std::string tok;
-   for (size_t i = 0; i < s.size(); i++) {
-    char ch = s[i];
-    if (ch == ',') { out.push_back(tok); tok.clear(); }
-    else if (ch != '\r' && ch != '\n') tok.push_back(ch);
-   }
-   out.push_back(tok);
-  };
-  std::vector<std::string> headers;
-  split_csv(line, headers);
-  // Resolve each requested name to a header index
-  for (int i = 0; i < n_cols; i++) {
-   bool found = false;
-   for (size_t j = 0; j < headers.size(); j++) {
-    if (headers[j] == col_names[i]) { cols[i].csv_col_idx = j; found = true; break; }
-   }
-   if (!found) {
-    write_ack("error poke_playback_start: column '" + col_names[i] + "' not in CSV header");
+  if (n < 0) {
+#ifdef WIN32
+   if (WSAGetLastError() != WSAEWOULDBLOCK)
+#else
+   if (errno == EINTR)
+    continue;
+   if (errno != EAGAIN && errno != EWOULDBLOCK)
+#endif
+   {
+    gdb_close_client();
     return;
    }
+   break;
   }
-  // Parse all data rows, pre-compute bytes for each (row, col)
-  std::vector<std::vector<std::vector<uint8_t>>> rows;
-  while (std::getline(cf, line)) {
-   if (line.empty()) continue;
-   if (line[0] == '#') continue;
-   std::vector<std::string> cells;
-   split_csv(line, cells);
-   std::vector<std::vector<uint8_t>> row_bytes(n_cols);
-   for (int c = 0; c < n_cols; c++) {
-    if (cols[c].csv_col_idx >= cells.size()) {
-     char buf[160];
-     snprintf(buf, sizeof(buf),
-              "error poke_playback_start: row %zu has %zu cols, col index %zu out of range",
-              rows.size(), cells.size(), cols[c].csv_col_idx);
-     write_ack(buf);
-     return;
-    }
-    const std::string& cell = cells[cols[c].csv_col_idx];
-    std::string s = cell;
-    if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s = s.substr(2);
-    uint64_t val;
-    try {
-     val = std::stoull(s, nullptr, 16);
-    } catch (...) {
-     write_ack("error poke_playback_start: bad hex cell '" + cell + "'");
-     return;
-    }
-    // Render as big-endian 4 bytes (source assumed 32-bit hex column)
-    uint8_t be4[4] = {
-     (uint8_t)((val >> 24) & 0xFF),
-     (uint8_t)((val >> 16) & 0xFF),
-     (uint8_t)((val >>  8) & 0xFF),
-     (uint8_t)(val         & 0xFF)
-    };
-    std::vector<uint8_t> bytes;
-    if (cols[c].slice_enabled) {
-     for (int b = cols[c].slice_lo; b < cols[c].slice_hi; b++) bytes.push_back(be4[b]);
-    } else {
-     // Take low (width/8) bytes in BE order
-     int n = cols[c].width / 8;
-     for (int b = 4 - n; b < 4; b++) bytes.push_back(be4[b]);
-    }
-    row_bytes[c] = std::move(bytes);
-   }
-   rows.push_back(std::move(row_bytes));
-  }
-  cf.close();
-  if (rows.empty()) {
-   write_ack("error poke_playback_start: CSV has no data rows");
-   return;
-  }
-  // Resolve row bounds
-  size_t start_row = (start_row_in < 0) ? 0 : (size_t)start_row_in;
-  size_t end_row   = (end_row_in   < 0) ? rows.size() : (size_t)end_row_in;
-  if (start_row >= rows.size() || end_row > rows.size() || start_row >= end_row) {
-   char buf[160];
-   snprintf(buf, sizeof(buf),
-            "error poke_playback_start: bad row range start=%zu end=%zu total=%zu",
-            start_row, end_row, rows.size());
-   write_ack(buf);
-   return;
-  }
-  // Supersede any prior playback
-  if (poke_playback_running) {
-   poke_triggers.erase(poke_playback_pc);
-   poke_playback_running = false;
-  }
-  PokeTrigger trig;
-  trig.is_playback     = true;
-  trig.base_addr       = base;
-  trig.columns         = std::move(cols);
-  trig.rows            = std::move(rows);
-  trig.start_row       = start_row;
-  trig.end_row         = end_row;
-  trig.cur_row         = start_row;
-  trig.on_end          = on_end;
-  trig.done            = false;
-  trig.trigger_hits    = 0;
-  trig.pokes_performed = 0;
-  poke_triggers[tpc]   = std::move(trig);
-  poke_playback_running = true;
-  poke_playback_pc      = tpc;
-  poke_playback_halt_pending = false;
-  update_cpu_hook();
-  char buf[192];
-  snprintf(buf, sizeof(buf),
-           "ok poke_playback_start 0x%08X base=0x%08X rows=%zu..%zu cols=%d on_end=%s",
-           tpc, base, start_row, end_row, n_cols, on_end_str.c_str());
-  write_ack(buf);
+  gdb_rx_buf.append(buf, n);
  }
- else if (cmd == "poke_playback_stop") {
-  if (!poke_playback_running) {
-   write_ack("ok poke_playback_stop (not active)");
-   return;
+
+ while (!gdb_rx_buf.empty() && gdb_client_fd != AUTO_SOCK_INVALID) {
+  const char c = gdb_rx_buf[0];
+  if (c == '\x03') {
+   gdb_rx_buf.erase(0, 1);
+   if (gdb_resumed && !gdb_target_stopped())
+    gdb_halt();
+   continue;
   }
-  uint32_t tpc = poke_playback_pc;
-  poke_triggers.erase(tpc);
-  poke_playback_running = false;
-  poke_playback_pc = 0;
-  poke_playback_halt_pending = false;
-  update_cpu_hook();
-  char buf[96];
-  snprintf(buf, sizeof(buf), "ok poke_playback_stop 0x%08X", tpc);
-  write_ack(buf);
- }
- else if (cmd == "poke_playback_status") {
-  if (!poke_playback_running) {
-   write_ack("poke_playback inactive");
-   return;
+  if (c == '-' && !gdb_no_ack) {
+   gdb_rx_buf.erase(0, 1);
+   gdb_send_raw(gdb_last_packet);
+   continue;
   }
-  auto it = poke_triggers.find(poke_playback_pc);
-  if (it == poke_triggers.end() || !it->second.is_playback) {
-   write_ack("poke_playback inactive (stale)");
-   return;
+  if (c != '$') {
+   gdb_rx_buf.erase(0, 1);  // '+' and line noise
+   continue;
   }
-  const auto& t = it->second;
-  char buf[256];
-  snprintf(buf, sizeof(buf),
-           "poke_playback pc=0x%08X base=0x%08X row=%zu/%zu start=%zu end=%zu "
-           "triggers_seen=%llu pokes=%llu done=%s on_end=%s",
-           poke_playback_pc, t.base_addr, t.cur_row, t.end_row,
-           t.start_row, t.end_row,
-           (unsigned long long)t.trigger_hits,
-           (unsigned long long)t.pokes_performed,
-           t.done ? "true" : "false",
-           (t.on_end == PPOE_HALT) ? "halt" :
-           (t.on_end == PPOE_LOOP) ? "loop" : "hold");
-  write_ack(buf);
+  const size_t hash = gdb_rx_buf.find('#');
+  if (hash == std::string::npos || gdb_rx_buf.size() < hash + 3)
+   break;  // incomplete
+  const std::string payload = gdb_rx_buf.substr(1, hash - 1);
+  const unsigned want = strtoul(gdb_rx_buf.substr(hash + 1, 2).c_str(), nullptr, 16);
+  gdb_rx_buf.erase(0, hash + 3);
+  uint8_t sum = 0;
+  for (char ch : payload)
+   sum += (uint8_t)ch;
+  if (!gdb_no_ack && !gdb_send_raw(sum == want ? "+" : "-"))
+   return;
+  if (sum == want || gdb_no_ack)
+   gdb_packet(payload);
  }
- else {
-  write_ack("error unknown command: " + cmd);
+
+ if (gdb_client_fd != AUTO_SOCK_INVALID && gdb_resumed && gdb_target_stopped()) {
+  gdb_resumed = false;
+  gdb_send(gdb_stop_reply());
  }
 }
 
-static bool check_action_file(void)
+static bool gdb_listen(unsigned port)
 {
- // Content-based change detection: read file and check if header line changed.
- // This avoids DrvFS stat() caching issues.
- std::ifstream f(action_file);
- if (!f.is_open())
+ auto_sock_t fd = socket(AF_INET, SOCK_STREAM, 0);
+ if (fd == AUTO_SOCK_INVALID)
   return false;
-
- // Read first line (header comment with sequence number, e.g. "# 5.....")
- std::string header;
- if (!std::getline(f, header)) {
-  f.close();
+ int one = 1;
+ setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+ struct sockaddr_in sa;
+ memset(&sa, 0, sizeof(sa));
+ sa.sin_family = AF_INET;
+ sa.sin_port = htons((uint16_t)port);
+ sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+ if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 || listen(fd, 1) != 0) {
+  auto_sock_close(fd);
   return false;
  }
- // Strip \r
- if (!header.empty() && header.back() == '\r')
-  header.pop_back();
+#ifdef WIN32
+ u_long nb = 1;
+ ioctlsocket(fd, FIONBIO, &nb);
+#else
+ fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+ gdb_listen_fd = fd;
+ gdb_port = port;
+ return true;
+}
 
- if (header == last_action_header) {
-  f.close();
-  return false;
+static void gdb_shutdown(void)
+{
+ gdb_close_client();
+ for (const auto& kv : gdb_watch_ids)
+  for (unsigned id : kv.second)
+   remove_watchpoint(id);
+ gdb_watch_ids.clear();
+ if (gdb_listen_fd != AUTO_SOCK_INVALID) {
+  auto_sock_close(gdb_listen_fd);
+  gdb_listen_fd = AUTO_SOCK_INVALID;
  }
- last_action_header = header;
+ gdb_port = 0;
+}
 
- // Process remaining lines as commands
- std::string line;
- while (std::getline(f, line)) {
-  // Strip \r (Windows line endings)
-  if (!line.empty() && line.back() == '\r')
-   line.pop_back();
-  process_command(line);
+// Poll every command transport once.
+static void poll_commands(void)
+{
+ MDFNSS_PollAsync();  // acks for finished background save_state writes
+ check_socket();
+ check_gdb();
+ check_action_file();
+}
+
+// Wait (at most ~10ms) for the next command to possibly be available.
+// With the socket transport open this returns as soon as data or a new
+// connection arrives; otherwise it's the plain 10ms sleep the file
+// transport has always used.
+static void wait_for_command(void)
+{
+ if (crash_watchdog)  // a paused wait isn't a hang
+  crash_alive_ms.store(Time::MonoUS() / 1000);
+
+ if (sock_listen_fd != AUTO_SOCK_INVALID || gdb_listen_fd != AUTO_SOCK_INVALID) {
+#ifdef WIN32
+  WSAPOLLFD pfd[2];
+#else
+  struct pollfd pfd[2];
+#endif
+  unsigned n = 0;
+  // One client at a time per transport: wait on the client if connected, else on accept().
+  if (sock_listen_fd != AUTO_SOCK_INVALID)
+   pfd[n++].fd = (sock_client_fd != AUTO_SOCK_INVALID) ? sock_client_fd : sock_listen_fd;
+  if (gdb_listen_fd != AUTO_SOCK_INVALID)
+   pfd[n++].fd = (gdb_client_fd != AUTO_SOCK_INVALID) ? gdb_client_fd : gdb_listen_fd;
+  for (unsigned i = 0; i < n; i++) {
+   pfd[i].events = POLLIN;
+   pfd[i].revents = 0;
+  }
+#ifdef WIN32
+  WSAPoll(pfd, n, 10);
+#else
+  poll(pfd, n, 10);
+#endif
+  return;
+ }
+#ifdef WIN32
+ Sleep(10); // 10ms
+#else
+ struct timespec ts = {0, 10000000}; // 10ms
+ nanosleep(&ts, NULL);
+#endif
+}
+
+// Open the socket transport. spec is either "tcp:<port>" (loopback only)
+// or, on POSIX, a filesystem path for a Unix domain socket.
+static bool socket_listen(const std::string& spec)
+{
+#ifdef WIN32
+ static bool wsa_started = false;
+ if (!wsa_started) {
+  WSADATA wsa_data;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+   fprintf(stderr, "Automation: WSAStartup() failed\n");
+   return false;
+  }
+  wsa_started = true;
+ }
+#endif
+ auto_sock_t fd = AUTO_SOCK_INVALID;
+
+ if (spec.compare(0, 4, "tcp:") == 0) {
+  int port = atoi(spec.c_str() + 4);
+  if (port <= 0 || port > 65535) {
+   fprintf(stderr, "Automation: bad socket port in \"%s\"\n", spec.c_str());
+   return false;
+  }
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd == AUTO_SOCK_INVALID)
+   return false;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons((uint16_t)port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+   fprintf(stderr, "Automation: bind() to %s failed\n", spec.c_str());
+   auto_sock_close(fd);
+   return false;
+  }
+ } else {
+#ifdef WIN32
+  fprintf(stderr, "Automation: only tcp:<port> sockets are supported on Windows\n");
+  return false;
+#else
+  struct sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  if (spec.size() >= sizeof(sa.sun_path)) {
+   fprintf(stderr, "Automation: socket path too long: %s\n", spec.c_str());
+   return false;
+  }
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == AUTO_SOCK_INVALID)
+   return false;
+  sa.sun_family = AF_UNIX;
+  strcpy(sa.sun_path, spec.c_str());
+  unlink(spec.c_str());  // stale socket from a previous (crashed) run
+  if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+   fprintf(stderr, "Automation: bind() to %s failed: %s\n", spec.c_str(), strerror(errno));
+   auto_sock_close(fd);
+   return false;
+  }
+  sock_unix_path = spec;
+#endif
  }
- f.close();
 
+ if (listen(fd, 1) != 0) {
+  auto_sock_close(fd);
+  return false;
+ }
+#ifdef WIN32
+ u_long nb = 1;
+ ioctlsocket(fd, FIONBIO, &nb);
+#else
+ fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+ sock_listen_fd = fd;
  return true;
 }
 
+static void socket_shutdown(void)
+{
+ socket_close_client();
+ if (sock_listen_fd != AUTO_SOCK_INVALID) {
+  auto_sock_close(sock_listen_fd);
+  sock_listen_fd = AUTO_SOCK_INVALID;
+ }
+#ifndef WIN32
+ if (!sock_unix_path.empty()) {
+  unlink(sock_unix_path.c_str());
+  sock_unix_path.clear();
+ }
+#endif
+}
+
 
 // === Public API ===
 
@@ -1832,42 +10937,172 @@ void Automation_Init(const std::string& dir)
  frames_to_advance = 0;  // Start PAUSED -- external tool must send "run" or "frame_advance"
  last_action_header.clear();
 
- // Write initial ack so external tools know we're ready
- write_ack("ready frame=0");
+ // Write initial ack so external tools know we're ready
+ write_ack("ready frame=0");
+
+ fprintf(stderr, "Automation: initialized\n");
+ fprintf(stderr, "  Action file: %s\n", action_file.c_str());
+ fprintf(stderr, "  Ack file:    %s\n", ack_file.c_str());
+}
+
+bool Automation_InitGDB(unsigned port)
+{
+ if (!automation_active || !port || port > 65535)
+  return false;
+ if (!gdb_listen(port)) {
+  fprintf(stderr, "Automation: gdb server on port %u unavailable\n", port);
+  return false;
+ }
+ fprintf(stderr, "  GDB server:  tcp:%u\n", port);
+ return true;
+}
+
+bool Automation_InitSocket(const std::string& spec)
+{
+ if (!automation_active || spec.empty())
+  return false;
+ if (!socket_listen(spec)) {
+  fprintf(stderr, "Automation: socket transport unavailable, using files only\n");
+  return false;
+ }
+ fprintf(stderr, "  Socket:      %s\n", spec.c_str());
+ sock_spec = spec;
+ return true;
+}
+
+void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const int32* lw)
+{
+ if (!automation_active)
+  return;
+
+ frame_counter++;
+ journal_frame_cycle = get_cycle();
+#ifndef WIN32
+ if (pool_self)
+  pool_self->frames.store(frame_counter, std::memory_order_relaxed);
+#endif
+
+ {
+  const int64_t now = Time::MonoUS();
+  host_fps_frames++;
+  if (!host_fps_start_us) {
+   host_fps_start_us = now;
+   host_fps_frames = 0;
+  } else if (now - host_fps_start_us >= 1000000) {
+   host_fps = host_fps_frames * 1e6 / (now - host_fps_start_us);
+   host_fps_start_us = now;
+   host_fps_frames = 0;
+  }
+ }
+
+ // This frame is what screenshots see until Poll returns (no copy yet).
+ // surface is null for frames the driver skipped.
+ last_frame_rendered = surface && rect && surface->pixels;
+ if (last_frame_rendered) {
+  live_fb_surface = surface;
+  live_fb_rect = rect;
+  live_fb_lw = lw;
+  cached_fb_valid = false;
+
+  for (const ScreenshotReq& req : pending_screenshots)
+   write_screenshot(req, surface, *rect, lw);
+  pending_screenshots.clear();
+
+  if (frame_dump && (frame_counter % frame_dump_every) == 0)
+   frame_dump->Submit(frame_counter, surface, *rect, lw);
+
+  if (obs_base && ((frame_counter % obs_period) == 0 || (capture_wants_frame && capture_due(frame_counter))))
+   obs_update(surface, *rect, lw, frame_counter);
+
+  if (capture_wants_frame && capture_due(frame_counter))
+   capture_hash = hash_framebuffer(surface, *rect, lw);
+
+  if (fb_hash_on) {
+   fb_hash_value = hash_framebuffer(surface, *rect, lw);
+   fb_hash_frame = frame_counter;
+   if (fb_hash_log)
+    fprintf(fb_hash_log, "frame=%llu hash=%016llx\n", (unsigned long long)frame_counter, (unsigned long long)fb_hash_value);
+  }
+ }
+
+ if (shm_base && (frame_counter % shm_period) == 0)
+  shm_update(frame_counter);
+
+ if (diverge_file && (frame_counter % diverge_every) == 0)
+  diverge_frame();
+
+ if (state_hash_file && (frame_counter % state_hash_every) == 0)
+  state_hash_frame();
+
+ if (unified_trace_bin)
+  MDFN_IEN_SS::Automation_UnifiedBinFrame(frame_counter);
+
+ MDFN_IEN_SS::Automation_EventStatsFrame();
+
+ if (MDFN_IEN_SS::Automation_HeatmapIsActive())
+  MDFN_IEN_SS::Automation_HeatmapFrame(frame_counter);
+
+ if (MDFN_IEN_SS::Automation_VDP2WatchIsActive())
+  MDFN_IEN_SS::Automation_VDP2WatchFrame(frame_counter);
+
+ if (MDFN_IEN_SS::Automation_OpStatsIsActive())
+  MDFN_IEN_SS::Automation_OpStatsFrame(frame_counter);
+
+ if (MDFN_IEN_SS::Automation_DMATraceBinIsActive())
+  MDFN_IEN_SS::Automation_DMATraceBinFrame(frame_counter);
 
- fprintf(stderr, "Automation: initialized\n");
- fprintf(stderr, "  Action file: %s\n", action_file.c_str());
- fprintf(stderr, "  Ack file:    %s\n", ack_file.c_str());
-}
+ if (MDFN_IEN_SS::Automation_CDLOverlayIsActive())
+  MDFN_IEN_SS::Automation_CDLOverlayFrame(frame_counter);
 
-void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const int32* lw)
-{
- if (!automation_active)
-  return;
+ MDFN_IEN_SS::Automation_InsnTraceWindowFrame(frame_counter);
 
- frame_counter++;
+ if (MDFN_IEN_SS::Automation_CallGraphIsActive())
+  MDFN_IEN_SS::Automation_CallGraphFrame(frame_counter);
+
+ if (bus_profile_on) {
+  MDFN_IEN_SS::Automation_BusProfileFrame();
+  if (bus_profile_log)
+   fprintf(bus_profile_log, "frame=%llu%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_BusProfileFormat(false).c_str());
+ }
+
+ if (int_latency_on) {
+  MDFN_IEN_SS::Automation_IntLatencyFrame();
+  if (int_latency_log)
+   fprintf(int_latency_log, "frame=%llu%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_IntLatencyFormat(false).c_str());
+ }
+
+ if (sync_profile_on) {
+  MDFN_IEN_SS::Automation_SyncProfileFrame();
+  if (sync_profile_log)
+   fprintf(sync_profile_log, "frame=%llu%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_SyncProfileFormat(false).c_str());
+ }
+
+ if (!crash_dir.empty())
+  crash_bundle_frame();
+
+ if (vdp2_timing_on && last_frame_rendered) {
+  FPS_SetAuxText(MDFN_IEN_SS::Automation_VDP2TimingSummary().c_str());
+  if (vdp2_timing_log)
+   fprintf(vdp2_timing_log, "frame=%llu%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_VDP2TimingFormat(false).c_str());
+ }
 
- // Cache framebuffer for instant screenshots (no frame advance needed).
- if (surface && rect && surface->pixels) {
-  // Reallocate if dimensions changed
-  if (!cached_fb_pixels || cached_fb_w != surface->w || cached_fb_h != surface->h
-      || cached_fb_pitch != surface->pitchinpix) {
-   delete[] cached_fb_pixels;
-   delete[] cached_fb_lw;
-   cached_fb_pixels = new uint32_t[surface->pitchinpix * surface->h];
-   cached_fb_lw = new int32[surface->h];
-   cached_fb_w = surface->w;
-   cached_fb_h = surface->h;
-   cached_fb_pitch = surface->pitchinpix;
-  }
-  memcpy(cached_fb_pixels, surface->pixels, surface->pitchinpix * surface->h * sizeof(uint32_t));
-  if (lw) memcpy(cached_fb_lw, lw, surface->h * sizeof(int32));
-  else memset(cached_fb_lw, 0, surface->h * sizeof(int32));
-  cached_fb_rect = *rect;
-  cached_fb_format = surface->format;
-  cached_fb_valid = true;
+ if (MDFN_IEN_SS::Automation_VDP1StatsIsActive()) {
+  MDFN_IEN_SS::Automation_VDP1StatsFrame();
+  if (vdp1_stats_log)
+   fprintf(vdp1_stats_log, "frame=%llu%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_VDP1StatsFormat(false).c_str());
  }
 
+ if (MDFN_IEN_SS::Automation_VDP1CmdStatsIsActive()) {
+  MDFN_IEN_SS::Automation_VDP1CmdStatsFrame();
+  if (vdp1_cmd_stats_log) {
+   const std::string prefix = "frame=" + std::to_string(frame_counter) + " ";
+   fputs(MDFN_IEN_SS::Automation_VDP1CmdStatsFormat(0, prefix.c_str()).c_str(), vdp1_cmd_stats_log);
+  }
+ }
+
+ if (perf_stats_log)
+  fprintf(perf_stats_log, "%llu,%s\n", (unsigned long long)frame_counter, MDFN_IEN_SS::Automation_PerfStatsCSV(false).c_str());
+
  // Check run_to_frame
  if (run_to_frame_target >= 0 && (int64_t)frame_counter >= run_to_frame_target) {
   frames_to_advance = 0;  // Pause
@@ -1875,6 +11110,17 @@ void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const i
   write_ack("done run_to_frame frame=" + std::to_string(frame_counter));
  }
 
+ // run_until: condition at frame end, then the frame limit
+ if (run_until_active) {
+  const bool hit = run_until_eval();
+  if (hit || (run_until_max_frame >= 0 && (int64_t)frame_counter >= run_until_max_frame)) {
+   const uint32_t evals = run_until_evals;
+   run_until_stop();
+   frames_to_advance = 0;  // Pause
+   write_ack("done run_until frame=" + std::to_string(frame_counter) + " evals=" + std::to_string(evals) + (hit ? "" : " timeout"));
+  }
+ }
+
  // Input playback: process events up to and including the current frame.
  // Apply ALL events that should have fired by now (not just exact matches),
  // so that frame=0 events work even if Poll first runs at frame 1.
@@ -1897,45 +11143,90 @@ void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const i
   }
  }
 
- // Per-frame memory sampler: dump region to binary file each frame
- if (mem_sample_file && mem_sample_frames > 0) {
-  uint8_t sample_buf[0x10000]; // 64KB max (matches command handler cap)
-  for (uint32_t i = 0; i < mem_sample_size; i++) {
-   sample_buf[i] = MDFN_IEN_SS::Automation_ReadMem8(mem_sample_addr + i);
-  }
-  fwrite(sample_buf, 1, mem_sample_size, mem_sample_file);
+ if (capture_due(frame_counter))
+  capture_frame();
+
+ // Per-frame memory sampler: dump ranges to binary file each frame
+ if (mem_sample_ring && mem_sample_frames > 0) {
+  mem_sample_frame();
   mem_sample_frames--;
   if (mem_sample_frames == 0) {
-   fclose(mem_sample_file);
-   mem_sample_file = nullptr;
+   const uint64_t dropped = mem_sample_ring->Dropped();
+   delete mem_sample_ring;  // drains the ring
+   mem_sample_ring = nullptr;
    frames_to_advance = 0; // pause emulation
    char buf[256];
-   snprintf(buf, sizeof(buf), "done mem_sample frames=%lld addr=0x%08X size=0x%X",
-            (long long)mem_sample_total, mem_sample_addr, mem_sample_size);
+   snprintf(buf, sizeof(buf), "done mem_sample frames=%lld addr=0x%08X size=0x%X dropped=%llu",
+            (long long)mem_sample_total, mem_sample_ranges[0].addr, mem_sample_size, (unsigned long long)dropped);
    write_ack(buf);
   }
  }
 
+ if (script_have_frame && history_mode < Hist_Seek)
+  script_frame();
+
  // Handle frame advance countdown
  if (frames_to_advance > 0) {
   frames_to_advance--;
   if (frames_to_advance == 0) {
    // If tracing a frame, close trace and disable hook
-   if (pc_trace_frame_mode && pc_trace_file) {
-    fclose(pc_trace_file);
-    pc_trace_file = nullptr;
+   if (pc_trace_frame_mode && pc_trace_ring) {
+    // Destructor drains the ring, so the file is complete when the ack goes out.
+    uint64_t dropped = pc_trace_ring->Dropped();
+    delete pc_trace_ring;
+    pc_trace_ring = nullptr;
     pc_trace_active = false;
     pc_trace_frame_mode = false;
     update_cpu_hook();
-    write_ack("done pc_trace_frame frame=" + std::to_string(frame_counter));
+    write_ack("done pc_trace_frame frame=" + std::to_string(frame_counter)
+              + " dropped=" + std::to_string(dropped));
+   } else if (bench_active) {
+    const double secs = (Time::MonoUS() - bench_start_us) / 1e6;
+    char buf[160];
+    snprintf(buf, sizeof(buf), "done benchmark frames=%lld seconds=%.3f fps=%.2f hash=%016llx", (long long)bench_frames,
+     secs, secs > 0 ? bench_frames / secs : 0.0, (unsigned long long)journal_digest());
+    write_ack(buf + MDFN_IEN_SS::Automation_PerfStatsFormat(true));
+    bench_cancel();
    } else {
     write_ack("done frame_advance frame=" + std::to_string(frame_counter));
    }
   }
  }
 
+ if (journal_playing)
+  journal_apply();
+
+ // Reverse execution: the pending restore, or the next snapshot
+ if (history_mode == Hist_Seek) {
+  history_restore();
+ } else if (history_mode == Hist_Scan || history_mode == Hist_Land) {
+  history_apply();
+ } else if (history_mode == Hist_Record) {
+  if (history_countdown)
+   history_countdown--;
+  if (!history_countdown) {
+   try {
+    history_snapshot();
+   } catch (std::exception& e) {
+    history_stop();
+    write_ack(std::string("error history_start: ") + e.what());
+   }
+  }
+ }
+
+ // --automation_pool: the first frame after the game loaded is the checkpoint
+#ifndef WIN32
+ if (pool_pending) {
+  std::string err;
+  const unsigned n = pool_pending;
+  pool_pending = 0;
+  if (pool_start(n, auto_base_dir + "/pool", std::string(), &err) < 0)
+   fprintf(stderr, "Automation: automation_pool: %s\n", err.c_str());
+ }
+#endif
+
  // Poll for new commands (every frame)
- check_action_file();
+ poll_commands();
 
  // Unstick CPU if caught inside VBlank handler with interrupts masked.
  // The SH-2's VBlank interrupt is delivered at IRL level 15. If the frame
@@ -1948,22 +11239,94 @@ void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const i
   uint32_t sr = MDFN_IEN_SS::Automation_GetMasterSR();
   if (((sr >> 4) & 0xF) >= 0xF) {
    MDFN_IEN_SS::Automation_SetMasterSR(sr & ~0xF0);
+   journal_sr(sr & ~0xF0);
+   history_event(HistEv_SR, sr & ~0xF0, nullptr, 0);
   }
  }
 
  // Block emulation when paused -- spin-wait until a command unpauses us.
  // This prevents the emulator from running ahead while the orchestrator
  // reads acks and sends new commands.
+ const bool was_paused = frames_to_advance == 0;
  while (frames_to_advance == 0 && automation_active) {
+  wait_for_command();
+  poll_commands();
+  check_exit_requested();
+ }
+ if (was_paused) {
+  MDFN_IEN_SS::Automation_PerfStatsIdle();  // the pause isn't driver time
+  host_fps_start_us = Time::MonoUS();
+  host_fps_frames = 0;
+ }
+
+ // Back to emulation: keep a copy only if a command can still arrive
+ // before the next Poll (headless queues those screenshots instead).
+ if (live_fb_surface) {
+  const bool mid_frame_pause = cpu_hook_active[0] || cpu_hook_active[1]
+                               || !watchpoints.empty() || exception_mode == EXC_ENABLE;
+  if (!headless && mid_frame_pause)
+   cache_framebuffer();
+  live_fb_surface = nullptr;
+ }
+}
+
+void Automation_SetHeadless(bool on)
+{
+ headless = on;
+ if (on)
+  fprintf(stderr, "  Headless:    no window, frames rendered on demand\n");
+}
+
+void Automation_SetTurbo(bool on)
+{
+ turbo = on;
+ if (on)
+  fprintf(stderr, "  Turbo:       unthrottled, frames rendered on demand\n");
+}
+
+void Automation_SetPool(unsigned n)
+{
 #ifdef WIN32
-  Sleep(10); // 10ms
+ if (n)
+  fprintf(stderr, "Automation: automation_pool is not supported on Windows\n");
 #else
-  struct timespec ts = {0, 10000000}; // 10ms
-  nanosleep(&ts, NULL);
+ pool_pending = n;
+ if (n)
+  fprintf(stderr, "  Pool:        %u instances in %s/pool once the game has loaded\n", n, auto_base_dir.c_str());
 #endif
-  check_action_file();
-  check_exit_requested();
- }
+}
+
+bool Automation_Turbo(void)
+{
+ return automation_active && turbo;
+}
+
+bool Automation_FrameSkip(bool driver_skip)
+{
+ if (!automation_active)
+  return driver_skip;
+
+ // Always render frames something will look at: queued screenshots, and
+ // frames that end in a scheduled pause (frame_advance, run_to_frame,
+ // mem_sample), so "frame_advance N" then "screenshot" needs no deferral.
+ const bool pause_due = frames_to_advance == 1
+     || (run_to_frame_target >= 0 && (int64_t)frame_counter + 1 >= run_to_frame_target)
+     || (mem_sample_ring && mem_sample_frames == 1);
+ const bool dump_due = (frame_dump && ((frame_counter + 1) % frame_dump_every) == 0)
+     || (obs_base && ((frame_counter + 1) % obs_period) == 0)
+     || (capture_wants_frame && capture_due(frame_counter + 1))
+     || MDFN_IEN_SS::Automation_VDP2LayerCaptureIsPending();
+ if (!pending_screenshots.empty() || pause_due || dump_due || fb_hash_all)
+  return false;
+
+ if (headless || turbo)
+  return true;
+
+ // render_skip: nobody sees the intermediate frames of a countdown.
+ if (render_skip && (frames_to_advance > 1 || run_to_frame_target >= 0 || mem_sample_ring))
+  return true;
+
+ return driver_skip;
 }
 
 void Automation_Kill(void)
@@ -1973,6 +11336,10 @@ void Automation_Kill(void)
  if (automation_active)
   write_ack("shutdown frame=" + std::to_string(frame_counter));
  automation_active = false;
+ socket_shutdown();
+ gdb_shutdown();
+ shm_close();
+ obs_close();
 
  // Unconditionally clean up all resources — check_exit_requested may
  // have cleared automation_active before we get here, but file handles
@@ -1982,29 +11349,94 @@ void Automation_Kill(void)
  if (bp_log) { fclose(bp_log); bp_log = nullptr; }
  if (exc_log) { fclose(exc_log); exc_log = nullptr; }
  poke_triggers.clear();
+ MDFN_IEN_SS::Automation_FreezeClear();
+#ifndef WIN32
+ pool_stop();
+#endif
  poke_playback_running = false;
  poke_playback_pc = 0;
  poke_playback_halt_pending = false;
+ func_hooks.clear();
+ func_hook_frames.clear();
+ if (func_hook_ring) { delete func_hook_ring; func_hook_ring = nullptr; }
+ MDFN_IEN_SS::Automation_FlightRecStop();
+ flight_rec_auto = false;
+ history_stop();
+ MDFN_IEN_SS::Automation_WriteLogStop();
  if (unified_trace_file) { fclose(unified_trace_file); unified_trace_file = nullptr; }
- if (pc_trace_file) { fclose(pc_trace_file); pc_trace_file = nullptr; }
+ if (unified_trace_bin) { MDFN_IEN_SS::Automation_DisableUnifiedBinTrace(); unified_trace_bin = false; }
+ delete pc_trace_ring; pc_trace_ring = nullptr;
  if (input_trace_file) { fclose(input_trace_file); input_trace_file = nullptr; }
- if (mem_sample_file) { fclose(mem_sample_file); mem_sample_file = nullptr; }
+ if (mem_sample_ring) { delete mem_sample_ring; mem_sample_ring = nullptr; }
+ capture_stop();
+ state_hash_close();
  delete[] cached_fb_pixels;  cached_fb_pixels = nullptr;
  delete[] cached_fb_lw;      cached_fb_lw = nullptr;
  cached_fb_valid = false;
+ live_fb_surface = nullptr;
+ pending_screenshots.clear();
+ delete frame_dump; frame_dump = nullptr;
+ delete vdp1_fb_png; vdp1_fb_png = nullptr;
+ crash_bundle_disarm();
+ fb_hash_on = fb_hash_all = false;
+ if (fb_hash_log) { fclose(fb_hash_log); fb_hash_log = nullptr; }
+ render_skip = false;
+ MDFN_IEN_SS::Automation_CDLOverlayStop(nullptr);
  MDFN_IEN_SS::Automation_CDLStop();
  MDFN_IEN_SS::Automation_DisableMemProfile();
  MDFN_IEN_SS::Automation_DisableMemReadProfile();
+ {
+  uint64_t dumps;
+  MDFN_IEN_SS::Automation_HeatmapStop(frame_counter, &dumps);
+ }
+ MDFN_IEN_SS::Automation_DSPProfileStop(nullptr);
+ MDFN_IEN_SS::Automation_VDP2TimingStop();
+ vdp2_timing_on = false;
+ if (vdp2_timing_log) { fclose(vdp2_timing_log); vdp2_timing_log = nullptr; }
+ MDFN_IEN_SS::Automation_VDP1StatsStop();
+ if (vdp1_stats_log) { fclose(vdp1_stats_log); vdp1_stats_log = nullptr; }
+ MDFN_IEN_SS::Automation_VDP1CmdStatsStop();
+ if (vdp1_cmd_stats_log) { fclose(vdp1_cmd_stats_log); vdp1_cmd_stats_log = nullptr; }
+ vdp1_cmd_breaks.clear();
+ vdp1_break_pending = false;
+ MDFN_IEN_SS::Automation_VDP1CmdBreakClear();
+ run_to_line_target = -1;
+ run_to_line_frame = -1;
+ step_return_cancel();
+ break_vblank_in = break_vblank_out = false;
+ raster_break = false;
+ MDFN_IEN_SS::Automation_SetLineHook(nullptr);
+ m68k_breaks.clear();
+ m68k_watches.clear();
+ m68k_to_step = -1;
+ m68k_paused = false;
+ if (m68k_call_trace) { fclose(m68k_call_trace); m68k_call_trace = nullptr; }
+ m68k_update_hooks();
+ MDFN_IEN_SS::Automation_SCSPCaptureStop(nullptr, nullptr);
+ MDFN_IEN_SS::Automation_PerfStatsStop();
+ if (perf_stats_log) { fclose(perf_stats_log); perf_stats_log = nullptr; }
  MDFN_IEN_SS::Automation_DisableDMATrace();
+ MDFN_IEN_SS::Automation_DMATraceBinStop(frame_counter, nullptr);
+ MDFN_IEN_SS::CDB_ProfileStop(nullptr);
  MDFN_IEN_SS::Automation_DisableCallTrace();
  MDFN_IEN_SS::Automation_DisableInsnTrace();
 }
 
+bool Automation_NoVideoThread(void)
+{
+ return fork_child;
+}
+
 bool Automation_IsActive(void)
 {
  return automation_active;
 }
 
+bool Automation_OwnsInput(void)
+{
+ return automation_active && input_exclusive;
+}
+
 bool Automation_SuppressRaise(void)
 {
  return automation_active;
@@ -2029,6 +11461,34 @@ bool Automation_GetInput(unsigned port, uint8_t* data, unsigned data_size)
   data[1] |= (uint8_t)((input_buttons >> 8) & 0xFF);
  }
 
+ if (automation_active && port < 16 && !input_port_data[port].empty()) {
+  memset(data, 0, data_size);
+  memcpy(data, input_port_data[port].data(), std::min<size_t>(input_port_data[port].size(), data_size));
+ }
+
+ if (automation_active && (ipb_trace_file || ipb_play_file))
+  ipb_port_input(port, data, data_size);
+
+ // Replay journal: playback replaces the port data outright (keyboard
+ // included); recording logs each change of it.
+ if (automation_active && port < Journal_MaxPorts) {
+  std::vector<uint8_t>& last = journal_inputs[port];
+  if (journal_playing) {
+   journal_apply();
+   memset(data, 0, data_size);
+   if (!last.empty())
+    memcpy(data, last.data(), std::min<size_t>(last.size(), data_size));
+  } else if (journal_file && (last.size() != data_size || memcmp(last.data(), data, data_size))) {
+   const uint8_t p = port;
+   last.assign(data, data + data_size);
+   journal_event(Journal_Input, 0, &p, 1, data, data_size);
+  }
+ }
+
+ // Reverse execution: log input changes, or replay them while re-running
+ if (automation_active && port < Journal_MaxPorts && history_mode != Hist_Off)
+  history_input(port, data, data_size);
+
  // Input tracing: log combined button state (keyboard + automation) AFTER override.
  // This captures the full input picture — what the game actually sees.
  if (automation_active && input_trace_file && port == 0 && data_size >= 2) {
@@ -2069,40 +11529,49 @@ bool Automation_ConsumePendingHideWindow(void)
  return false;
 }
 
-// Called from ss.cpp (BusRW_DB_CS3 / DMA_Write) when a memory write hits the watched address.
-// pc = current CPU PC, addr = full address written, old_val/new_val = 32-bit values.
+// Called from ss.cpp (BusRW_DB_CS0/CS3, SCU DMA_Write, VDP1 B-bus) when a memory
+// write changes a watched range. id = watchpoint id.
+// pc = current CPU PC, addr = full address written, old_val/new_val = the
+// 32-bit word written (16-bit for VDP1) before and after.
 // pr = return address register (caller context).
-// source = "CPU" or "DMA" -- indicates write origin.
+// source = "CPU", "SH2DMA" (SH-2 DMAC), "DMA" (SCU DMA) or "DSP" (SCU DSP DMA) -- write origin.
 // This runs inline in the CPU execution path -- must NOT block.
-void Automation_WatchpointHit(uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source)
+void Automation_WatchpointHit(unsigned id, uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source)
 {
- if (!watchpoint_active || !automation_active)
+ auto it = watchpoints.find(id);
+ if (it == watchpoints.end() || !automation_active)
+  return;
+ const bool log_mode = it->second.log_mode;
+
+ // Re-running history: only a reverse_continue landing pauses, nothing is logged
+ bool history_hit = false;
+ if (history_mode >= Hist_Seek && (log_mode || !(history_hit = history_watch_hit())))
   return;
 
+ if (script_have_watch && !script_running && history_mode < Hist_Seek)
+  script_watch(id, addr, old_val, new_val);
+
  // Log hit to watchpoint log file (append mode)
  if (!wp_log) {
   std::string path = auto_base_dir + "/watchpoint_hits.txt";
   wp_log = fopen(path.c_str(), "w");
-  if (wp_log) {
-   if (watchpoint_filter_active)
-    fprintf(wp_log, "# Watchpoint hits for addr 0x%08X (filter: eq 0x%08X)\n", watchpoint_addr, watchpoint_filter_value);
-   else
-    fprintf(wp_log, "# Watchpoint hits for addr 0x%08X\n", watchpoint_addr);
-  }
+  if (wp_log)
+   write_wp_log_header(wp_log, false);
  }
  if (wp_log) {
-  fprintf(wp_log, "pc=0x%08X pr=0x%08X addr=0x%08X old=0x%08X new=0x%08X source=%s frame=%llu\n",
-   pc, pr, addr, old_val, new_val, source, (unsigned long long)frame_counter);
+  fprintf(wp_log, "pc=0x%08X pr=0x%08X addr=0x%08X old=0x%08X new=0x%08X source=%s frame=%llu id=%u\n",
+   pc, pr, addr, old_val, new_val, source, (unsigned long long)frame_counter, id);
   fflush(wp_log);
  }
 
  char msg[256];
  snprintf(msg, sizeof(msg),
-  "hit watchpoint pc=0x%08X pr=0x%08X addr=0x%08X old=0x%08X new=0x%08X source=%s frame=%llu",
-  pc, pr, addr, old_val, new_val, source, (unsigned long long)frame_counter);
+  "hit watchpoint pc=0x%08X pr=0x%08X addr=0x%08X old=0x%08X new=0x%08X source=%s frame=%llu id=%u",
+  pc, pr, addr, old_val, new_val, source, (unsigned long long)frame_counter, id);
 
  // Log mode: write full context to log file, don't pause
- if (watchpoint_log_mode) {
+ if (log_mode) {
+  push_event(msg);
   if (wp_log) {
    std::string regs = MDFN_IEN_SS::Automation_DumpRegs();
    std::string stack = MDFN_IEN_SS::Automation_CallStack(0x400);
@@ -2116,7 +11585,9 @@ void Automation_WatchpointHit(uint32_t pc, uint32_t addr, uint32_t old_val, uint
  // This spin-waits inside the memory bus write path (BusRW_DB_CS3).
  // Safe because Mednafen is single-threaded.
  std::string full_msg;
- if (run_to_frame_target >= 0) {
+ if (history_hit) {
+  full_msg = "done " + history_op + " " + msg;
+ } else if (run_to_frame_target >= 0) {
   full_msg = "done run_to_frame frame=" + std::to_string(frame_counter)
            + " STOPPED_BY_WATCHPOINT " + msg;
   run_to_frame_target = -1;
@@ -2133,39 +11604,171 @@ void Automation_WatchpointHit(uint32_t pc, uint32_t addr, uint32_t old_val, uint
  full_msg += "\n" + MDFN_IEN_SS::Automation_CallStack(0x400);
  write_ack(full_msg);
 
+ char why[24];
+ snprintf(why, sizeof(why), "watch:%08x;", addr);
+ gdb_stop_cpu = 0;  // the hit doesn't say which SH-2 wrote
+ gdb_stop_why = why;
  watchpoint_paused = true;
  while (watchpoint_paused && automation_active) {
-#ifdef WIN32
-  Sleep(10);
-#else
-  struct timespec ts = {0, 10000000}; // 10ms
-  nanosleep(&ts, NULL);
-#endif
-  check_action_file();
+  wait_for_command();
+  poll_commands();
   check_exit_requested();
  }
 }
 
-void Automation_ReadWatchpointHit(uint32_t pc, uint32_t addr, uint32_t val, uint32_t pr)
+// val = the 32-bit word containing the read.
+void Automation_VDP1CmdBreakHit(uint32_t addr, uint16_t cmdctrl, const char* type)
+{
+ auto it = vdp1_cmd_breaks.find(addr);
+ if (it == vdp1_cmd_breaks.end() || !automation_active || history_mode >= Hist_Seek)
+  return;
+
+ char msg[128];
+ snprintf(msg, sizeof(msg), "vdp1_cmd addr=0x%05X cmdctrl=0x%04X type=%s frame=%llu",
+  addr, cmdctrl, type, (unsigned long long)frame_counter);
+
+ if (it->second) {
+  push_event(std::string("hit ") + msg);
+  return;
+ }
+
+ if (vdp1_break_pending)
+  return;
+
+ vdp1_break_msg = msg;
+ vdp1_break_pending = true;
+ update_cpu_hook();
+}
+
+static std::string m68k_format_regs(void)
+{
+ uint32_t r[18];
+ MDFN_IEN_SS::Automation_Get68KRegs(r);
+ std::string s = "m68k_regs";
+ char buf[16];
+ for (unsigned i = 0; i < 16; i++) {
+  snprintf(buf, sizeof(buf), " %c%u=%08X", i < 8 ? 'D' : 'A', i & 7, r[i]);
+  s += buf;
+ }
+ snprintf(buf, sizeof(buf), " PC=%06X", r[16]);
+ s += buf;
+ snprintf(buf, sizeof(buf), " SR=%04X", r[17]);
+ return s + buf;
+}
+
+// Pause mode: ack with the 68K registers and spin-wait in the 68K's run loop.
+static void m68k_pause(const std::string& msg)
+{
+ write_ack(msg + "\n" + m68k_format_regs());
+ m68k_paused = true;
+ while (m68k_paused && automation_active) {
+  wait_for_command();
+  poll_commands();
+  check_exit_requested();
+ }
+}
+
+// Before each 68K instruction; pc is the instruction's address.
+static void m68k_insn_hook(uint32_t pc, uint16_t opcode)
+{
+ if (!automation_active || history_mode >= Hist_Seek)
+  return;
+
+ if (m68k_call_trace) {
+  // The instruction after a call or return is its target.
+  if (m68k_trace_kind) {
+   fprintf(m68k_call_trace, "%lld %c 0x%06X 0x%06X\n", (long long)get_cycle(), m68k_trace_kind, m68k_trace_site, pc);
+   m68k_trace_kind = 0;
+  }
+  if ((opcode & 0xFFC0) == 0x4E80 || (opcode & 0xFF00) == 0x6100)	// JSR, BSR
+   m68k_trace_kind = 'C';
+  else if (opcode == 0x4E75 || opcode == 0x4E73 || opcode == 0x4E77)	// RTS, RTE, RTR
+   m68k_trace_kind = 'R';
+  m68k_trace_site = pc;
+ }
+
+ bool step_done = false;
+ if (m68k_to_step > 0 && --m68k_to_step == 0) {
+  m68k_to_step = -1;
+  step_done = true;
+  m68k_update_hooks();
+ }
+
+ auto it = m68k_breaks.find(pc);
+ if (it == m68k_breaks.end() && !step_done)
+  return;
+
+ char msg[96];
+ if (!step_done && it->second) {
+  snprintf(msg, sizeof(msg), "hit m68k_break pc=0x%06X frame=%llu", pc, (unsigned long long)frame_counter);
+  push_event(msg);
+  return;
+ }
+ if (it != m68k_breaks.end())
+  snprintf(msg, sizeof(msg), "break m68k pc=0x%06X frame=%llu", pc, (unsigned long long)frame_counter);
+ else
+  snprintf(msg, sizeof(msg), "done m68k_step pc=0x%06X frame=%llu", pc, (unsigned long long)frame_counter);
+ m68k_pause(msg);
+}
+
+// 68K write to sound RAM (addr < 0x80000); old_val/new_val are size bytes wide.
+static void m68k_write_hook(uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, unsigned size)
+{
+ if (!automation_active || history_mode >= Hist_Seek || old_val == new_val)
+  return;
+
+ for (const M68KWatch& w : m68k_watches) {
+  if (addr >= w.addr + w.len || addr + size <= w.addr)
+   continue;
+
+  char msg[160];
+  snprintf(msg, sizeof(msg), "hit m68k_watch pc=0x%06X addr=0x%05X old=0x%0*X new=0x%0*X size=%u frame=%llu",
+   pc, addr, size * 2, old_val, size * 2, new_val, size, (unsigned long long)frame_counter);
+  if (w.log_mode)
+   push_event(msg);
+  else
+   m68k_pause(msg);
+  return;
+ }
+}
+
+static void m68k_update_hooks(void)
+{
+ const bool insn = !m68k_breaks.empty() || m68k_to_step > 0 || m68k_call_trace;
+ MDFN_IEN_SS::Automation_Set68KHook(insn ? m68k_insn_hook : nullptr);
+ MDFN_IEN_SS::Automation_Set68KWriteHook(m68k_watches.empty() ? nullptr : m68k_write_hook);
+}
+
+void Automation_ReadWatchpointHit(unsigned id, uint32_t pc, uint32_t addr, uint32_t val, uint32_t pr)
 {
- if (!read_watchpoint_active || !automation_active)
+ auto it = watchpoints.find(id);
+ if (it == watchpoints.end() || !automation_active)
   return;
+ const bool log_mode = it->second.log_mode;
+
+ // Re-running history: only a reverse_continue landing pauses, nothing is logged
+ bool history_hit = false;
+ if (history_mode >= Hist_Seek && (log_mode || !(history_hit = history_watch_hit())))
+  return;
+
+ if (script_have_watch && !script_running && history_mode < Hist_Seek)
+  script_watch(id, addr, val, val);
 
  // Log hit to file (always, both modes)
  if (!rwp_log) {
   std::string path = auto_base_dir + "/read_watchpoint_hits.txt";
   rwp_log = fopen(path.c_str(), "w");
   if (rwp_log)
-   fprintf(rwp_log, "# Read watchpoint hits for addr 0x%08X\n", read_watchpoint_addr);
+   write_wp_log_header(rwp_log, true);
  }
 
  char msg[256];
  snprintf(msg, sizeof(msg),
-  "hit read_watchpoint pc=0x%08X pr=0x%08X addr=0x%08X val=0x%08X frame=%llu",
-  pc, pr, addr, val, (unsigned long long)frame_counter);
+  "hit read_watchpoint pc=0x%08X pr=0x%08X addr=0x%08X val=0x%08X frame=%llu id=%u",
+  pc, pr, addr, val, (unsigned long long)frame_counter, id);
 
  // Log mode: write full context to log file, don't pause
- if (read_watchpoint_log_mode) {
+ if (log_mode) {
   if (rwp_log) {
    std::string regs = MDFN_IEN_SS::Automation_DumpRegs();
    std::string stack = MDFN_IEN_SS::Automation_CallStack(0x400);
@@ -2177,13 +11780,15 @@ void Automation_ReadWatchpointHit(uint32_t pc, uint32_t addr, uint32_t val, uint
 
  // Pause mode: log summary line then ack + spin-wait
  if (rwp_log) {
-  fprintf(rwp_log, "pc=0x%08X pr=0x%08X addr=0x%08X val=0x%08X frame=%llu\n",
-   pc, pr, addr, val, (unsigned long long)frame_counter);
+  fprintf(rwp_log, "pc=0x%08X pr=0x%08X addr=0x%08X val=0x%08X frame=%llu id=%u\n",
+   pc, pr, addr, val, (unsigned long long)frame_counter, id);
   fflush(rwp_log);
  }
 
  std::string full_msg;
- if (run_to_frame_target >= 0) {
+ if (history_hit) {
+  full_msg = "done " + history_op + " " + msg;
+ } else if (run_to_frame_target >= 0) {
   full_msg = "done run_to_frame frame=" + std::to_string(frame_counter)
            + " STOPPED_BY_READ_WATCHPOINT " + msg;
   run_to_frame_target = -1;
@@ -2200,19 +11805,30 @@ void Automation_ReadWatchpointHit(uint32_t pc, uint32_t addr, uint32_t val, uint
  full_msg += "\n" + MDFN_IEN_SS::Automation_CallStack(0x400);
  write_ack(full_msg);
 
+ char why[24];
+ snprintf(why, sizeof(why), "rwatch:%08x;", addr);
+ gdb_stop_cpu = 0;
+ gdb_stop_why = why;
  read_watchpoint_paused = true;
  while (read_watchpoint_paused && automation_active) {
-#ifdef WIN32
-  Sleep(10);
-#else
-  struct timespec ts = {0, 10000000}; // 10ms
-  nanosleep(&ts, NULL);
-#endif
-  check_action_file();
+  wait_for_command();
+  poll_commands();
   check_exit_requested();
  }
 }
 
+// Flight recorder auto-dump: on an exception or breakpoint pause, write the
+// ring alongside the ack and name the file in it.
+static std::string flight_rec_autodump(void)
+{
+ if (!flight_rec_auto || !MDFN_IEN_SS::Automation_FlightRecActive())
+  return "";
+ const int64 lines = MDFN_IEN_SS::Automation_FlightRecDump(flight_rec_path.c_str(), 0);
+ if (lines < 0)
+  return " flight_rec=error";
+ return " flight_rec=" + flight_rec_path;
+}
+
 static const char* exception_name(unsigned exnum)
 {
  switch (exnum) {
@@ -2230,13 +11846,15 @@ static const char* exception_name(unsigned exnum)
 void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32_t pc, uint32_t sr,
                               uint32_t r15, uint32_t pr, uint32_t vbr, uint32_t handler_pc)
 {
- if (!automation_active || exception_mode == EXC_DISABLE)
+ if (!automation_active || (exception_mode == EXC_DISABLE && !crash_on_exception))
   return;
 
  // Don't report if already paused on another event (e.g., watchpoint hit
  // on the stack push inside the Exception macro itself)
  if (watchpoint_paused || read_watchpoint_paused || exception_paused)
   return;
+ if (history_mode >= Hist_Seek)  // re-running history for a reverse command
+  return;
 
  char msg[512];
  snprintf(msg, sizeof(msg),
@@ -2245,8 +11863,19 @@ void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32_t pc, uint3
   exception_name(exnum), exnum, vecnum, pc, sr, r15, pr, vbr, handler_pc,
   (unsigned long long)frame_counter);
 
+ // Crash bundle first; its directory is named in the event or ack.
+ std::string bundle;
+ if (crash_on_exception) {
+  bundle = crash_bundle_write("exception", msg + 4, false);
+  if (!bundle.empty())
+   bundle = " crash_bundle=" + bundle;
+ }
+ if (exception_mode == EXC_DISABLE)
+  return;
+
  if (exception_mode == EXC_LOG) {
   // Log mode: write full context to file, don't pause
+  push_event(msg + bundle);
   if (!exc_log) {
    std::string path = auto_base_dir + "/exception_hits.txt";
    exc_log = fopen(path.c_str(), "w");
@@ -2277,23 +11906,98 @@ void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32_t pc, uint3
   frames_to_advance = 0;
  }
 
+ full_msg += flight_rec_autodump() + bundle;
  full_msg += "\n" + MDFN_IEN_SS::Automation_DumpRegs();
  full_msg += "\n" + MDFN_IEN_SS::Automation_CallStack(0x400);
  write_ack(full_msg);
 
  exception_paused = true;
  while (exception_paused && automation_active) {
-#ifdef WIN32
-  Sleep(10);
-#else
-  struct timespec ts = {0, 10000000}; // 10ms
-  nanosleep(&ts, NULL);
-#endif
-  check_action_file();
+  wait_for_command();
+  poll_commands();
   check_exit_requested();
  }
 }
 
+// One record: le64 cycle, le32 call id, le32 function, u8 kind (0 = entry,
+// 1 = exit), u8 word count, le16 0, then the words (entry: PR, R15, args;
+// exit: R0, R1).
+static void func_hook_record(uint32_t id, uint32_t func, uint8_t kind, const uint32_t* words, unsigned n)
+{
+ uint8_t rec[20 + 8 * 4];
+ MDFN_en64lsb(&rec[0], get_cycle());
+ MDFN_en32lsb(&rec[8], id);
+ MDFN_en32lsb(&rec[12], func);
+ rec[16] = kind;
+ rec[17] = n;
+ MDFN_en16lsb(&rec[18], 0);
+ for (unsigned i = 0; i < n; i++)
+  MDFN_en32lsb(&rec[20 + i * 4], words[i]);
+ if (func_hook_ring->Write(rec, 20 + n * 4))
+  func_hook_records++;
+}
+
+static void func_hook_check(uint32_t pc)
+{
+ uint32_t regs[22];
+ bool have_regs = false;
+
+ // Exit: innermost open call whose return address we're at, with the stack
+ // pointer back where it was. Calls opened above it never returned normally.
+ for (size_t i = func_hook_frames.size(); i-- > 0; ) {
+  const FuncHookFrame& f = func_hook_frames[i];
+  if (pc != f.ret_addr && pc != f.ret_addr + 2)
+   continue;
+  if (!have_regs) {
+   MDFN_IEN_SS::Automation_GetRegs(0, regs);
+   have_regs = true;
+  }
+  if (regs[15] != f.sp)
+   continue;
+  if (func_hook_ring)
+   func_hook_record(f.id, f.func, 1, regs, 2);
+  func_hook_lost += func_hook_frames.size() - 1 - i;
+  func_hook_frames.resize(i);
+  break;
+ }
+
+ if (func_hooks.empty() || !trigger_page(pc)) {
+  func_hook_direct = ~0U;
+  return;
+ }
+
+ // Entry: same pc/pc-2 fallback as poke triggers, but not twice for one
+ // entry when the hook also fired at the entry point itself.
+ auto it = func_hooks.find(pc);
+ if (it == func_hooks.end() && func_hook_direct != pc - 2)
+  it = func_hooks.find(pc - 2);
+ func_hook_direct = (it != func_hooks.end() && it->first == pc) ? pc : ~0U;
+ if (it == func_hooks.end())
+  return;
+
+ FuncHook& h = it->second;
+ h.hits++;
+ if (!have_regs)
+  MDFN_IEN_SS::Automation_GetRegs(0, regs);
+
+ const uint32_t id = func_hook_seq++;
+ if (func_hook_ring) {
+  uint32_t words[2 + 4] = { regs[18], regs[15] };
+  for (unsigned i = 0; i < h.nargs; i++)
+   words[2 + i] = regs[4 + i];
+  func_hook_record(id, it->first, 0, words, 2 + h.nargs);
+ }
+
+ if (h.ret) {
+  if (func_hook_frames.size() >= FuncHook_MaxFrames) {
+   func_hook_frames.erase(func_hook_frames.begin());
+   func_hook_lost++;
+  }
+  func_hook_frames.push_back({ id, it->first, regs[18], regs[15] });
+  MDFN_IEN_SS::Automation_AddCPUHookPage(0, regs[18]);
+ }
+}
+
 // Execute all pokes configured for this trigger. For static triggers, writes
 // the fixed list. For playback triggers, writes the current row's bytes and
 // advances the row cursor (honoring on_end: halt/loop/hold).
@@ -2304,17 +12008,8 @@ static void perform_pokes_from_trigger(PokeTrigger& trig, uint32_t trigger_pc)
 
  if (!trig.is_playback) {
   for (const auto& p : trig.static_pokes) {
-   if (p.width == 8) {
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr, (uint8_t)(p.value & 0xFF));
-   } else if (p.width == 16) {
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr,     (uint8_t)((p.value >> 8) & 0xFF));
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr + 1, (uint8_t)(p.value & 0xFF));
-   } else { // 32
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr,     (uint8_t)((p.value >> 24) & 0xFF));
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr + 1, (uint8_t)((p.value >> 16) & 0xFF));
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr + 2, (uint8_t)((p.value >>  8) & 0xFF));
-    MDFN_IEN_SS::Automation_WriteMem8(p.addr + 3, (uint8_t)(p.value & 0xFF));
-   }
+   MDFN_IEN_SS::Automation_WriteMemBlock(p.addr, p.bytes, p.width / 8);
+   journal_poke(p.addr, p.bytes, p.width / 8);
    trig.pokes_performed++;
   }
   return;
@@ -2322,15 +12017,14 @@ static void perform_pokes_from_trigger(PokeTrigger& trig, uint32_t trigger_pc)
 
  // Playback mode
  if (trig.done) return;
- if (trig.cur_row >= trig.end_row || trig.cur_row >= trig.rows.size()) return;
+ if (trig.cur_row >= trig.end_row || trig.cur_row >= trig.row_count) return;
 
- const auto& row = trig.rows[trig.cur_row];
- for (size_t c = 0; c < trig.columns.size(); c++) {
-  const auto& col   = trig.columns[c];
-  const auto& bytes = row[c];
+ const uint8_t* row = trig.row_data.data() + trig.cur_row * trig.row_stride;
+ for (const auto& col : trig.columns) {
+  const uint8_t* bytes = row + col.row_offset;
   uint32_t dst = trig.base_addr + col.offset;
-  for (size_t i = 0; i < bytes.size(); i++)
-   MDFN_IEN_SS::Automation_WriteMem8(dst + i, bytes[i]);
+  MDFN_IEN_SS::Automation_WriteMemBlock(dst, bytes, col.nbytes);
+  journal_poke(dst, bytes, col.nbytes);
   trig.pokes_performed++;
  }
 
@@ -2353,17 +12047,66 @@ static void perform_pokes_from_trigger(PokeTrigger& trig, uint32_t trigger_pc)
  }
 }
 
-bool Automation_DebugHook(uint32_t pc)
+// Memory reads for breakpoint conditions ([addr].b/.w/.l), big-endian.
+static uint32_t cond_read_mem(uint32_t addr, unsigned size)
+{
+ uint32_t v = 0;
+ for (unsigned i = 0; i < size; i++)
+  v = (v << 8) | MDFN_IEN_SS::Automation_ReadMem8(addr + i);
+ return v;
+}
+
+static bool run_until_eval(void)
+{
+ uint32_t regs[BpCondition::Num_Regs];
+ MDFN_IEN_SS::Automation_GetRegs(0, regs);
+ run_until_evals++;
+ return run_until_cond.Eval(regs, run_until_evals, cond_read_mem, (uint32_t)frame_counter, (uint32_t)(get_cycle() - run_until_start_cycle));
+}
+
+static void run_until_tick(void)
+{
+ if (run_until_active && !run_until_break && run_until_eval()) {
+  run_until_break = true;
+  update_cpu_hook();
+ }
+}
+
+// Why a hook is pausing, handed from debug_hook() to debug_hook_stop().
+struct HookStop
+{
+ bool bp_hit = false;
+ uint32_t bp_addr = 0;
+ bool history_hit = false, cycle_hit = false, poke_halt = false;
+ uint32_t poke_halt_pc = 0;
+ bool until_hit = false, vdp1_hit = false, raster_hit = false, return_hit = false, over_done = false;
+};
+
+static HookStop slave_latched_stop;	// see Automation_SlaveLatchedStop()
+
+static void debug_hook_stop(const unsigned cpu, uint32_t pc, const HookStop& s);
+
+// Shared body of the master and slave hooks. Breakpoints and step counts are
+// per CPU; pc_trace, poke triggers and run_to_cycle are master-only.
+// With latch set, a slave pause is recorded instead of taken and true is
+// returned; Automation_SlaveLatchedStop() then takes it.
+static bool debug_hook(const unsigned cpu, uint32_t pc, const bool latch)
 {
+ std::unordered_set<uint32_t>& bps = cpu ? slave_breakpoints : breakpoints;
+ int64_t& to_step = cpu ? slave_instructions_to_step : instructions_to_step;
+
  // PC trace -- record every instruction's PC to file
- if (pc_trace_active && pc_trace_file) {
-  fwrite(&pc, 4, 1, pc_trace_file);
+ if (!cpu && pc_trace_active && pc_trace_ring && history_mode < Hist_Seek) {
+  pc_trace_ring->Write(&pc, 4);
  }
 
+ if (!cpu && journal_hook)
+  journal_apply();
+
  // Poke triggers fire before any pause logic -- they write memory and
  // continue. Same pc/pc-2 fallback as breakpoints (delayed-branch pipeline
  // quirk: PC arrives as target+2 after JSR/BSR/JMP).
- if (!poke_triggers.empty()) {
+ if (!cpu && trigger_page(pc)) {
   auto it = poke_triggers.find(pc);
   uint32_t poke_tpc = pc;
   if (it == poke_triggers.end()) {
@@ -2374,42 +12117,127 @@ bool Automation_DebugHook(uint32_t pc)
    perform_pokes_from_trigger(it->second, poke_tpc);
  }
 
+ if (!cpu && (!func_hooks.empty() || !func_hook_frames.empty()) && history_mode < Hist_Seek)
+  func_hook_check(pc);
+
+ if (!script_break_index[cpu].empty() && (cpu || trigger_page(pc)) && !script_running && history_mode < Hist_Seek)
+  script_break(cpu, pc);
+
  // Check breakpoints (O(1) lookup via unordered_set)
  // Also check pc-2: after JSR/BSR/JMP/RTS, the SH-2 pipeline fetch stage
  // advances PC past the first instruction at the branch target.
  // UCDelayBranch does FetchIF_ForceIBufferFill() which sets PC = target+2.
  // So when this hook fires, PC is already target+2 and a breakpoint set at
  // the exact branch target ('target') would miss without this fallback.
- bool bp_hit = breakpoints.count(pc) > 0;
+ bool bp_hit = bps.count(pc) > 0;
  uint32_t bp_addr = pc;
- if (!bp_hit && breakpoints.count(pc - 2) > 0) {
+ if (!bp_hit && bps.count(pc - 2) > 0) {
   bp_hit = true;
   bp_addr = pc - 2;
  }
 
+ // Conditional breakpoint: count the hit and evaluate the compiled condition
+ // before paying for any context capture, logging or IPC.
+ if (bp_hit && !bp_conditions[cpu].empty()) {
+  auto it = bp_conditions[cpu].find(bp_addr);
+  if (it != bp_conditions[cpu].end()) {
+   uint32_t regs[BpCondition::Num_Regs];
+   MDFN_IEN_SS::Automation_GetRegs(cpu, regs);
+   it->second.hits++;
+   bp_hit = it->second.cond.Eval(regs, it->second.hits, cond_read_mem, (uint32_t)frame_counter);
+  }
+ }
+
+ // Re-running history for a reverse command: only its landing pauses
+ bool history_hit = false;
+ if (history_mode >= Hist_Seek) {
+  if (cpu || !(history_hit = history_hook(bp_hit && !breakpoint_log_mode)))
+   return false;
+  bp_hit = bp_hit && history_kind == Hist_Hit;
+ }
+
  // Check cycle target
  bool cycle_hit = false;
- if (run_to_cycle_target >= 0 && get_cycle() >= run_to_cycle_target) {
+ if (!cpu && run_to_cycle_target >= 0 && get_cycle() >= run_to_cycle_target) {
   cycle_hit = true;
   run_to_cycle_target = -1;
  }
 
  // Instruction step countdown
- if (instructions_to_step > 0)
-  instructions_to_step--;
+ if (to_step > 0)
+  to_step--;
+
+ // step_over: the one step made a call, so run on to its return instead
+ bool over_done = false;
+ if (!cpu && step_over_pending && to_step == 0) {
+  step_over_pending = false;
+  uint32_t ret = 0;
+  if (MDFN_IEN_SS::Automation_ShadowDepth(0, &ret) > step_over_depth) {
+   step_return_addr = ret;
+   step_return_depth = (int32_t)step_over_depth;
+   step_return_op = "step_over";
+   step_return_active = true;
+   to_step = -1;
+   update_cpu_hook();
+  }
+  else
+   over_done = true;
+ }
+
+ // step_over / step_out return stop
+ bool return_hit = false;
+ if (!cpu && step_return_active && (pc == step_return_addr || pc == step_return_addr + 2)) {
+  uint32_t ret;
+  if (step_return_depth < 0 || MDFN_IEN_SS::Automation_ShadowDepth(0, &ret) <= (unsigned)step_return_depth) {
+   return_hit = true;
+   step_return_active = false;
+   update_cpu_hook();
+  }
+ }
 
  // Poke playback halt: consumed once, treated as a pause source
- bool poke_halt = poke_playback_halt_pending;
+ bool poke_halt = !cpu && poke_playback_halt_pending;
  uint32_t poke_halt_pc_local = poke_playback_halt_pc;
  if (poke_halt) poke_playback_halt_pending = false;
 
+ // run_until hit from a tick: consumed once, treated as a pause source
+ const bool until_hit = !cpu && run_until_break;
+ if (until_hit) {
+  run_until_stop();
+  update_cpu_hook();
+ }
+
+ // VDP1 command break from drawing: consumed once, treated as a pause source
+ const bool vdp1_hit = !cpu && vdp1_break_pending;
+ if (vdp1_hit) {
+  vdp1_break_pending = false;
+  update_cpu_hook();
+ }
+
+ // Scanline hit (run_to_line, break_on_vblank_*): consumed once, treated as a pause source
+ const bool raster_hit = !cpu && raster_break;
+ if (raster_hit) {
+  raster_break = false;
+  update_cpu_hook();
+ }
+
  // Determine if we should pause
- bool should_pause = bp_hit || cycle_hit || (instructions_to_step == 0) || poke_halt;
+ bool should_pause = bp_hit || cycle_hit || (to_step == 0) || poke_halt || until_hit || history_hit || vdp1_hit || raster_hit || return_hit;
  if (!should_pause)
   return false;
 
+ // Breakpoint count mode: bump the address's counter, don't pause
+ if (bp_hit && breakpoint_log_mode && breakpoint_count_mode) {
+  BpHitCount& h = bp_hit_counts[cpu][bp_addr];
+  if (!h.hits++) {
+   h.first_frame = frame_counter;
+   h.first_cycle = get_cycle();
+  }
+  if (!cycle_hit && to_step != 0)
+   return false;
+ }
  // Breakpoint log mode: log full context to file, don't pause
- if (bp_hit && breakpoint_log_mode) {
+ else if (bp_hit && breakpoint_log_mode) {
   if (!bp_log) {
    std::string path = auto_base_dir + "/breakpoint_hits.txt";
    bp_log = fopen(path.c_str(), "w");
@@ -2417,62 +12245,128 @@ bool Automation_DebugHook(uint32_t pc)
     fprintf(bp_log, "# Breakpoint hit log (log mode)\n");
   }
   if (bp_log) {
-   std::string regs = MDFN_IEN_SS::Automation_DumpRegs();
+   std::string regs = cpu ? MDFN_IEN_SS::Automation_DumpSlaveRegs() : MDFN_IEN_SS::Automation_DumpRegs();
    std::string stack = MDFN_IEN_SS::Automation_CallStack(0x400);
-   fprintf(bp_log, "--- break pc=0x%08X addr=0x%08X frame=%llu ---\n%s\n%s\n",
-    pc, bp_addr, (unsigned long long)frame_counter, regs.c_str(), stack.c_str());
+   fprintf(bp_log, "--- break %spc=0x%08X addr=0x%08X frame=%llu ---\n%s\n%s\n",
+    cpu ? "cpu=slave " : "", pc, bp_addr, (unsigned long long)frame_counter, regs.c_str(), stack.c_str());
    fflush(bp_log);
   }
   // If ONLY a breakpoint hit (not also cycle/step), don't pause
-  if (!cycle_hit && instructions_to_step != 0)
+  if (!cycle_hit && to_step != 0)
    return false;
  }
 
- // Pause at instruction level
+ // The slave hook also runs while the master is mid-instruction (a master bus
+ // access catching the slave up); that stop waits for the master's next boundary.
+ HookStop stop;
+ stop.bp_hit = bp_hit;
+ stop.bp_addr = bp_addr;
+ stop.history_hit = history_hit;
+ stop.cycle_hit = cycle_hit;
+ stop.poke_halt = poke_halt;
+ stop.poke_halt_pc = poke_halt_pc_local;
+ stop.until_hit = until_hit;
+ stop.vdp1_hit = vdp1_hit;
+ stop.raster_hit = raster_hit;
+ stop.return_hit = return_hit;
+ stop.over_done = over_done;
+ if (cpu && latch) {
+  slave_latched_stop = stop;
+  return true;
+ }
+ debug_hook_stop(cpu, pc, stop);
+ return false;
+}
+
+// Reports a hook stop and spins on commands until a resume. Split from
+// debug_hook() so a slave stop latched mid master instruction can be
+// reported later, once the master is between instructions.
+static void debug_hook_stop(const unsigned cpu, uint32_t pc, const HookStop& s)
+{
+ // Pause at instruction level; a step_over/step_out still running ends here too
  instruction_paused = true;
- instructions_to_step = -1;
+ (cpu ? slave_instructions_to_step : instructions_to_step) = -1;
+ gdb_stop_cpu = cpu;
+ gdb_stop_why = s.bp_hit ? "swbreak:;" : "";
+ if (!cpu && step_return_active) {
+  step_return_cancel();
+  update_cpu_hook();
+ }
 
  // NOTE on PC values:
  // This hook fires BEFORE CPU[0].Step() in RunLoop_INLINE (ss.cpp).
  // At this point, CPU[0].PC is the address of the instruction about to execute,
  // which is the correct value for breakpoint matching and step reporting.
  // For step completion, we use Automation_GetMasterPC() which returns CPU[0].PC.
- uint32_t real_pc = MDFN_IEN_SS::Automation_GetMasterPC();
+ // The slave hook is handed CPU[1].PC at the same point.
+ uint32_t real_pc = cpu ? pc : MDFN_IEN_SS::Automation_GetMasterPC();
+ const char* cpu_tag = cpu ? "cpu=slave " : "";
 
  char msg[256];
- if (bp_hit)
-  snprintf(msg, sizeof(msg), "break pc=0x%08X addr=0x%08X frame=%llu",
-   pc, bp_addr, (unsigned long long)frame_counter);
- else if (cycle_hit)
+ if (s.history_hit && s.bp_hit)
+  snprintf(msg, sizeof(msg), "done %s break pc=0x%08X addr=0x%08X frame=%llu",
+   history_op.c_str(), pc, s.bp_addr, (unsigned long long)frame_counter);
+ else if (s.history_hit)
+  snprintf(msg, sizeof(msg), "done %s pc=0x%08X frame=%llu cycle=%lld%s",
+   history_op.c_str(), real_pc, (unsigned long long)frame_counter, (long long)get_cycle(), history_note.c_str());
+ else if (s.bp_hit)
+  snprintf(msg, sizeof(msg), "break %spc=0x%08X addr=0x%08X frame=%llu",
+   cpu_tag, pc, s.bp_addr, (unsigned long long)frame_counter);
+ else if (s.cycle_hit)
   snprintf(msg, sizeof(msg), "done run_to_cycle pc=0x%08X frame=%llu",
    real_pc, (unsigned long long)frame_counter);
- else if (poke_halt)
+ else if (s.poke_halt)
   snprintf(msg, sizeof(msg), "done poke_playback pc=0x%08X trigger=0x%08X frame=%llu",
-   real_pc, poke_halt_pc_local, (unsigned long long)frame_counter);
+   real_pc, s.poke_halt_pc, (unsigned long long)frame_counter);
+ else if (s.until_hit)
+  snprintf(msg, sizeof(msg), "done run_until pc=0x%08X frame=%llu evals=%u",
+   real_pc, (unsigned long long)frame_counter, run_until_evals);
+ else if (s.vdp1_hit)
+  snprintf(msg, sizeof(msg), "break %s pc=0x%08X", vdp1_break_msg.c_str(), real_pc);
+ else if (s.raster_hit)
+  snprintf(msg, sizeof(msg), "%s pc=0x%08X", raster_break_msg.c_str(), real_pc);
+ else if (s.return_hit || s.over_done)
+  snprintf(msg, sizeof(msg), "done %s pc=0x%08X frame=%llu",
+   s.return_hit ? step_return_op : "step_over", real_pc, (unsigned long long)frame_counter);
  else
-  snprintf(msg, sizeof(msg), "done step pc=0x%08X frame=%llu",
-   real_pc, (unsigned long long)frame_counter);
+  snprintf(msg, sizeof(msg), "done step %spc=0x%08X frame=%llu",
+   cpu_tag, real_pc, (unsigned long long)frame_counter);
 
  // Auto-context: append registers + call stack to every break event
  std::string full_msg = msg;
- full_msg += "\n" + MDFN_IEN_SS::Automation_DumpRegs();
+ if (MDFN_IEN_SS::Automation_SymbolCount()) {
+  const std::string sym = MDFN_IEN_SS::Automation_SymbolFormat(s.bp_hit ? s.bp_addr : real_pc);
+  if (!sym.empty())
+   full_msg += " sym=" + sym;
+ }
+ if (s.bp_hit)
+  full_msg += flight_rec_autodump();
+ full_msg += "\n" + (cpu ? MDFN_IEN_SS::Automation_DumpSlaveRegs() : MDFN_IEN_SS::Automation_DumpRegs());
  full_msg += "\n" + MDFN_IEN_SS::Automation_CallStack(0x400);
  write_ack(full_msg);
 
  // Spin-wait for commands while paused at instruction level.
  // This blocks the SH-2 CPU loop. Commands like dump_regs, dump_mem,
  // step, run, breakpoint all work during this pause because
- // check_action_file -> process_command handles them.
+ // poll_commands -> process_command handles them.
  while (instruction_paused && automation_active) {
-#ifdef WIN32
-  Sleep(10);
-#else
-  struct timespec ts = {0, 10000000}; // 10ms
-  nanosleep(&ts, NULL);
-#endif
-  check_action_file();
+  wait_for_command();
+  poll_commands();
   check_exit_requested();
  }
+}
 
- return false;
+bool Automation_DebugHook(uint32_t pc)
+{
+ return debug_hook(0, pc, false);
+}
+
+bool Automation_SlaveDebugHook(uint32_t pc, bool latch)
+{
+ return debug_hook(1, pc, latch);
+}
+
+void Automation_SlaveLatchedStop(uint32_t pc)
+{
+ debug_hook_stop(1, pc, slave_latched_stop);
 }
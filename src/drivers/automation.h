@@ -3,6 +3,7 @@
  * Provides:
  *  - Background window mode (no focus steal)
  *  - File-based command interface (frame advance, screenshot, input, debug)
+ *  - Optional socket transport carrying the same commands
  *  - SH-2 debug tools (register dump, memory dump, PC trace)
  *  - Instruction-level stepping and PC breakpoints
  *
@@ -18,13 +19,48 @@
 // base_dir: directory for action/ack files (e.g. mednafen base dir)
 void Automation_Init(const std::string& base_dir);
 
+// Open the optional socket command transport (call after Automation_Init).
+// spec: "tcp:<port>" (loopback) or a Unix domain socket path (POSIX only).
+// The action/ack files remain active alongside it. Returns false on failure.
+bool Automation_InitSocket(const std::string& spec);
+
+// Open the GDB remote protocol server on loopback TCP port (call after
+// Automation_Init). Returns false on failure.
+bool Automation_InitGDB(unsigned port);
+
 // Poll for commands. Call once per frame from the game thread (MDFND_Update).
-// surface/rect/lw: current framebuffer for screenshot commands
+// surface/rect/lw: current framebuffer for screenshot commands (all null for
+// a frame the headless driver skipped)
 void Automation_Poll(const MDFN_Surface* surface, const MDFN_Rect* rect, const int32* lw);
 
+// Headless batch mode (--automation_headless; call after Automation_Init).
+// The driver then creates no window and most frames are skipped.
+void Automation_SetHeadless(bool on);
+
+// speed max / --automation_turbo (call after Automation_Init): while
+// Automation_Turbo() is true the driver doesn't throttle, write sound or wait
+// for the video thread, and frames are skipped as in headless mode.
+void Automation_SetTurbo(bool on);
+bool Automation_Turbo(void);
+
+// --automation_pool (call after Automation_Init and Automation_InitSocket):
+// pool_start n on the first Poll, so the game's first frame is the checkpoint
+// every pooled instance is forked from.
+void Automation_SetPool(unsigned n);
+
+// Frame skip decision for the next frame, given the driver's own (timing)
+// decision: forced on in headless mode or for render_skip countdown frames,
+// forced off when a screenshot is queued or a pause is due at its end.
+// The driver must still call Automation_Poll (with null surface) for skipped frames.
+bool Automation_FrameSkip(bool driver_skip);
+
 // Shutdown automation subsystem.
 void Automation_Kill(void);
 
+// True in a child forked by the spawn command: it has no main (video/event)
+// thread, so the driver must not hand it frames to blit.
+bool Automation_NoVideoThread(void);
+
 // Check if automation mode is active (--automation flag passed)
 bool Automation_IsActive(void);
 
@@ -35,14 +71,31 @@ bool Automation_SuppressRaise(void);
 // Automation input is ORed into existing keyboard state (additive, not exclusive).
 bool Automation_GetInput(unsigned port, uint8_t* data, unsigned data_size);
 
+// True while input_exclusive is on: Input_Update then only zeroes each port's
+// data and passes it to Automation_GetInput.
+bool Automation_OwnsInput(void);
+
 // Debug hook called from SH-2 step (master CPU only).
 // Checks breakpoints, steps, cycle targets. Spin-waits when paused.
 // Always returns false (pause is handled internally via spin-wait).
 bool Automation_DebugHook(uint32_t pc);
 
-// Memory watchpoint hit callback -- called from ss.cpp when a write hits the watched address.
-// source: "CPU" for CPU writes, "DMA" for SCU DMA writes.
-void Automation_WatchpointHit(uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source);
+// Slave SH-2 counterpart: slave breakpoints and step_slave only.
+// latch: the master is mid-instruction, so a pause is only recorded(returns
+// true) and taken by Automation_SlaveLatchedStop() at the master's next
+// instruction boundary, with the slave still at pc.
+bool Automation_SlaveDebugHook(uint32_t pc, bool latch);
+void Automation_SlaveLatchedStop(uint32_t pc);
+
+// Memory watchpoint hit callback -- called from ss.cpp when a write changes a watched range.
+// id: watchpoint id given to Automation_AddWatchpoint.
+// source: "CPU", "SH2DMA" (SH-2 DMAC), "DMA" (SCU DMA) or "DSP" (SCU DSP DMA).
+void Automation_WatchpointHit(unsigned id, uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source);
+
+// VDP1 command break callback -- called from vdp1.cpp when VDP1 fetches a command table
+// entry set with vdp1_cmd_break. addr = byte offset in VDP1 VRAM, cmdctrl = its first word.
+// Runs inside VDP1 drawing -- must NOT block; the pause happens on the next master instruction.
+void Automation_VDP1CmdBreakHit(uint32_t addr, uint16_t cmdctrl, const char* type);
 
 // Log a Mednafen system command (screenshot, save state, etc.) to the input trace file.
 void Automation_LogSystemCommand(const char* cmd_name);
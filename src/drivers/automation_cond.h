@@ -0,0 +1,368 @@
+/* automation_cond.h -- Conditional breakpoint expressions
+ *
+ * A condition such as
+ *
+ *   R4 == 0x060A0000 && [0x06001234].w > 3 && hitcount % 100 == 0
+ *
+ * is compiled once, when the breakpoint is installed, into a flat postfix
+ * program. Automation_DebugHook then evaluates the program on each hit with a
+ * small fixed-size value stack. No strings are built and nothing is
+ * allocated, so a hit that fails its condition costs about as much as a miss.
+ *
+ * Grammar (C precedence, unsigned 32-bit arithmetic):
+ *   expr    := expr binop expr | unop expr | '(' expr ')' | primary
+ *   binop   := || && | ^ & == != < <= > >= << >> + - * / %
+ *   unop    := - ! ~
+ *   primary := number (decimal or 0x hex)
+ *            | R0..R15 | PC | SR | PR | GBR | VBR | MACH
+ *            | hitcount | frame | cycles | addr | old | new
+ *            | '[' expr ']' ['.b' | '.w' | '.l']    (memory read, default .l)
+ *
+ * && and || don't short-circuit; reads have no side effects, so only cost
+ * differs. Division by zero yields 0. frame and cycles are whatever the
+ * caller passes to Eval(): for run_until, the frame counter and master
+ * cycles since the command (low 32 bits); breakpoints pass cycles as 0.
+ * addr, old and new are the watchpoint hit's values for script rules
+ * (script_load), 0 elsewhere. Value() returns the expression's value rather
+ * than its truth, for ${expr} substitutions in script actions.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_DRIVERS_AUTOMATION_COND_H
+#define __MDFN_DRIVERS_AUTOMATION_COND_H
+
+#include <stdint.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class BpCondition
+{
+ public:
+
+ enum : unsigned { Num_Regs = 22 };	// Automation_GetRegs() layout
+ enum : unsigned { Max_Stack = 32 };
+ enum : unsigned { Num_Ext = 3 };	// addr, old, new
+
+ // Reads 'size' (1/2/4) bytes big-endian from the Saturn address space.
+ typedef uint32_t (*ReadFn)(uint32_t addr, unsigned size);
+
+ // Returns false and sets *err on a syntax error.
+ bool Compile(const std::string& src, std::string* err)
+ {
+  text = src;
+  code.clear();
+  p = text.c_str();
+  error.clear();
+  depth = max_depth = 0;
+
+  Parse(0);
+  SkipSpace();
+  if(error.empty() && *p)
+   Fail("unexpected '" + std::string(p, 1) + "'");
+  if(error.empty() && (unsigned)max_depth > Max_Stack)
+   Fail("expression too deep");
+
+  if(!error.empty())
+  {
+   *err = error;
+   code.clear();
+   return false;
+  }
+  return true;
+ }
+
+ bool Eval(const uint32_t* regs, uint32_t hitcount, ReadFn read, uint32_t frame = 0, uint32_t cycles = 0, const uint32_t* ext = nullptr) const
+ {
+  return Value(regs, hitcount, read, frame, cycles, ext) != 0;
+ }
+
+ // ext: addr, old, new (Num_Ext values), or null for all zero.
+ uint32_t Value(const uint32_t* regs, uint32_t hitcount, ReadFn read, uint32_t frame = 0, uint32_t cycles = 0, const uint32_t* ext = nullptr) const
+ {
+  uint32_t st[Max_Stack];
+  unsigned sp = 0;
+
+  for(const Insn& in : code)
+  {
+   switch(in.op)
+   {
+    case OP_CONST: st[sp++] = in.arg; break;
+    case OP_REG:   st[sp++] = regs[in.arg]; break;
+    case OP_HITS:  st[sp++] = hitcount; break;
+    case OP_FRAME: st[sp++] = frame; break;
+    case OP_CYCLES: st[sp++] = cycles; break;
+    case OP_EXT:   st[sp++] = ext ? ext[in.arg] : 0; break;
+    case OP_LOAD:  st[sp - 1] = read(st[sp - 1], in.arg); break;
+    case OP_NEG:   st[sp - 1] = -st[sp - 1]; break;
+    case OP_LNOT:  st[sp - 1] = !st[sp - 1]; break;
+    case OP_BNOT:  st[sp - 1] = ~st[sp - 1]; break;
+
+    default:
+    {
+     const uint32_t b = st[--sp];
+     uint32_t& a = st[sp - 1];
+
+     switch(in.op)
+     {
+      case OP_LOR:  a = a || b; break;
+      case OP_LAND: a = a && b; break;
+      case OP_OR:   a |= b; break;
+      case OP_XOR:  a ^= b; break;
+      case OP_AND:  a &= b; break;
+      case OP_EQ:   a = (a == b); break;
+      case OP_NE:   a = (a != b); break;
+      case OP_LT:   a = (a < b); break;
+      case OP_LE:   a = (a <= b); break;
+      case OP_GT:   a = (a > b); break;
+      case OP_GE:   a = (a >= b); break;
+      case OP_SHL:  a = (b < 32) ? (a << b) : 0; break;
+      case OP_SHR:  a = (b < 32) ? (a >> b) : 0; break;
+      case OP_ADD:  a += b; break;
+      case OP_SUB:  a -= b; break;
+      case OP_MUL:  a *= b; break;
+      case OP_DIV:  a = b ? a / b : 0; break;
+      case OP_MOD:  a = b ? a % b : 0; break;
+     }
+    }
+    break;
+   }
+  }
+
+  return sp ? st[0] : 0;
+ }
+
+ private:
+
+ enum : uint8_t
+ {
+  OP_CONST, OP_REG, OP_HITS, OP_FRAME, OP_CYCLES, OP_EXT, OP_LOAD, OP_NEG, OP_LNOT, OP_BNOT,
+  // binary
+  OP_LOR, OP_LAND, OP_OR, OP_XOR, OP_AND, OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+  OP_SHL, OP_SHR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD
+ };
+
+ struct Insn
+ {
+  uint8_t op;
+  uint32_t arg;
+ };
+
+ struct BinOp
+ {
+  const char* tok;
+  uint8_t op;
+  int prec;
+ };
+
+ void Emit(uint8_t op, uint32_t arg = 0)
+ {
+  code.push_back({ op, arg });
+
+  if(op <= OP_EXT)
+   depth++;
+  else if(op >= OP_LOR)
+   depth--;
+  if(depth > max_depth)
+   max_depth = depth;
+ }
+
+ void Fail(const std::string& msg)
+ {
+  if(error.empty())
+   error = msg + " at column " + std::to_string((unsigned)(p - text.c_str()) + 1);
+ }
+
+ void SkipSpace(void)
+ {
+  while(isspace((unsigned char)*p))
+   p++;
+ }
+
+ bool Accept(const char* tok)
+ {
+  SkipSpace();
+  const size_t n = strlen(tok);
+  if(strncmp(p, tok, n))
+   return false;
+  p += n;
+  return true;
+ }
+
+ // Precedence climbing; prec 0 is the loosest (||).
+ void Parse(int min_prec)
+ {
+  static const BinOp ops[] =
+  {
+   // Longest tokens first so "<=" isn't read as "<".
+   { "||", OP_LOR, 0 }, { "&&", OP_LAND, 1 },
+   { "==", OP_EQ, 5 }, { "!=", OP_NE, 5 },
+   { "<<", OP_SHL, 7 }, { ">>", OP_SHR, 7 },
+   { "<=", OP_LE, 6 }, { ">=", OP_GE, 6 }, { "<", OP_LT, 6 }, { ">", OP_GT, 6 },
+   { "|", OP_OR, 2 }, { "^", OP_XOR, 3 }, { "&", OP_AND, 4 },
+   { "+", OP_ADD, 8 }, { "-", OP_SUB, 8 },
+   { "*", OP_MUL, 9 }, { "/", OP_DIV, 9 }, { "%", OP_MOD, 9 },
+  };
+
+  Unary();
+
+  while(error.empty())
+  {
+   SkipSpace();
+   const BinOp* found = nullptr;
+
+   for(const BinOp& o : ops)
+   {
+    if(!strncmp(p, o.tok, strlen(o.tok)))
+    {
+     found = &o;
+     break;
+    }
+   }
+
+   if(!found || found->prec < min_prec)
+    return;
+
+   p += strlen(found->tok);
+   Parse(found->prec + 1);
+   Emit(found->op);
+  }
+ }
+
+ void Unary(void)
+ {
+  if(Accept("-")) { Unary(); Emit(OP_NEG); }
+  else if(Accept("!")) { Unary(); Emit(OP_LNOT); }
+  else if(Accept("~")) { Unary(); Emit(OP_BNOT); }
+  else
+   Primary();
+ }
+
+ void Primary(void)
+ {
+  static const char* const reg_names[Num_Regs] =
+  {
+   "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7",
+   "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15",
+   "PC", "SR", "PR", "GBR", "VBR", "MACH"
+  };
+
+  SkipSpace();
+
+  if(Accept("("))
+  {
+   Parse(0);
+   if(!Accept(")"))
+    Fail("expected ')'");
+   return;
+  }
+
+  if(Accept("["))
+  {
+   Parse(0);
+   if(!Accept("]"))
+   {
+    Fail("expected ']'");
+    return;
+   }
+
+   unsigned size = 4;
+   if(*p == '.')
+   {
+    const char w = tolower((unsigned char)p[1]);
+    size = (w == 'b') ? 1 : (w == 'w') ? 2 : (w == 'l') ? 4 : 0;
+    if(!size)
+    {
+     Fail("expected .b, .w or .l");
+     return;
+    }
+    p += 2;
+   }
+   Emit(OP_LOAD, size);
+   return;
+  }
+
+  if(isdigit((unsigned char)*p))
+  {
+   char* end;
+   const bool hex = (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'));
+   const unsigned long long v = strtoull(p, &end, hex ? 16 : 10);
+   if(v > 0xFFFFFFFFULL)
+   {
+    Fail("constant out of range");
+    return;
+   }
+   p = end;
+   Emit(OP_CONST, (uint32_t)v);
+   return;
+  }
+
+  if(isalpha((unsigned char)*p))
+  {
+   const char* start = p;
+   while(isalnum((unsigned char)*p) || *p == '_')
+    p++;
+
+   std::string id(start, p - start);
+   for(char& c : id)
+    c = toupper((unsigned char)c);
+
+   if(id == "HITCOUNT")
+   {
+    Emit(OP_HITS);
+    return;
+   }
+
+   if(id == "FRAME")
+   {
+    Emit(OP_FRAME);
+    return;
+   }
+
+   if(id == "CYCLES")
+   {
+    Emit(OP_CYCLES);
+    return;
+   }
+
+   static const char* const ext_names[Num_Ext] = { "ADDR", "OLD", "NEW" };
+   for(unsigned i = 0; i < Num_Ext; i++)
+   {
+    if(id == ext_names[i])
+    {
+     Emit(OP_EXT, i);
+     return;
+    }
+   }
+
+   for(unsigned i = 0; i < Num_Regs; i++)
+   {
+    if(id == reg_names[i])
+    {
+     Emit(OP_REG, i);
+     return;
+    }
+   }
+
+   p = start;
+   Fail("unknown name '" + id + "'");
+   return;
+  }
+
+  Fail(*p ? "unexpected '" + std::string(p, 1) + "'" : std::string("unexpected end of expression"));
+ }
+
+ std::string text;
+ std::vector<Insn> code;
+
+ // Compile-time state
+ const char* p = nullptr;
+ std::string error;
+ int depth = 0;
+ int max_depth = 0;
+};
+
+#endif
@@ -20,11 +20,13 @@
 #include "fps.h"
 
 #include <trio/trio.h>
+#include <atomic>
 
 static struct
 {
  //int64 vcycles;
  uint32 t;
+ uint32 interval;	// us since the previous FPS_UpdateCalc()
  uint8 mask;
 } TimeDrawn[128];
 
@@ -32,6 +34,7 @@ static unsigned TDIndex;
 static MDFN_Surface *FPSSurface = NULL;
 static MDFN_Rect FPSRect;
 static volatile float cur_vfps, cur_dfps, cur_bfps;
+static volatile float cur_worst_ms;
 static uint8 inc_mask;
 //static int64 inc_vcycles;
 
@@ -45,10 +48,39 @@ static unsigned font_height;
 static uint32 text_color;
 static uint32 bg_color;
 
+// Extra overlay lines(e.g. automation VDP2 render timing).  Double-buffered: the game thread writes the slot
+// not being shown, then flips aux_cur.
+enum { AUX_LINES = 2, AUX_LEN = 16 };
+static char aux_text[2][AUX_LINES][AUX_LEN];
+static volatile unsigned aux_cur;
+static volatile unsigned aux_lines;
+
+// Frame pacing(FPS_AddTime()): a histogram per FPS_TIME_* of 0.1ms buckets up to 100ms, plus one for
+// anything longer.  Each is only written by one thread; readers may see a sample half-added, which
+// doesn't matter here.  FPS_ResetTimes() bumps reset_gen, and the writer clears on its next sample.
+enum { FT_BUCKET_US = 100, FT_BUCKETS = 1000 };
+static const char* const FrameTimeNames[FPS_TIME_COUNT] = { "frame", "emulate", "sound", "sync", "blit", "vsync" };
+static struct FrameTimeHist
+{
+ std::atomic<uint32> bucket[FT_BUCKETS + 1];
+ std::atomic<uint64> count, sum, sumsq;
+ std::atomic<uint32> min, max;
+ uint32 gen;
+} FrameTimes[FPS_TIME_COUNT];
+static std::atomic<uint32> reset_gen(1);	// != the zeroed gen, so the first sample clears
+
+static int64 last_calc_us;
+static int64 frame_waits[2];	// FPS_TIME_SOUND and FPS_TIME_SYNC so far this frame
+static int64 wait_total;
+static int64 emulate_start, emulate_waits;
+
 void FPS_Init(const unsigned fps_pos, const unsigned fps_scale, const unsigned fps_font, const uint32 fps_tcolor, const uint32 fps_bgcolor)
 {
  TDIndex = 0;
 
+ aux_cur = 0;
+ aux_lines = 0;
+
  inc_mask = 0;
  //inc_vcycles = 0;
 
@@ -57,6 +89,10 @@ void FPS_Init(const unsigned fps_pos, const unsigned fps_scale, const unsigned f
  cur_bfps = 0;
 
  memset(TimeDrawn, 0, sizeof(TimeDrawn));
+ cur_worst_ms = 0;
+ last_calc_us = 0;
+ frame_waits[0] = frame_waits[1] = 0;
+ FPS_ResetTimes();
 
  position = fps_pos;
  scale = fps_scale;
@@ -69,9 +105,9 @@ void FPS_Init(const unsigned fps_pos, const unsigned fps_scale, const unsigned f
 
  FPSRect.x = FPSRect.y = 0;
  FPSRect.w = 6 * font_width;
- FPSRect.h = 3 * font_height;
+ FPSRect.h = 4 * font_height;
 
- FPSSurface = new MDFN_Surface(NULL, FPSRect.w, FPSRect.h, FPSRect.w, MDFN_PixelFormat::ABGR32_8888);
+ FPSSurface = new MDFN_Surface(NULL, FPSRect.w, FPSRect.h + AUX_LINES * font_height, FPSRect.w, MDFN_PixelFormat::ABGR32_8888);
 }
 
 void FPS_Kill(void)
@@ -99,6 +135,160 @@ void FPS_IncBlitted(void)
  inc_mask |= 4;
 }
 
+void FPS_SetAuxText(const char* text)
+{
+ const unsigned slot = aux_cur ^ 1;
+ unsigned n = 0;
+
+ while(*text && n < AUX_LINES)
+ {
+  size_t len = strcspn(text, "\n");
+  const size_t copy_len = std::min<size_t>(len, AUX_LEN - 1);
+
+  memcpy(aux_text[slot][n], text, copy_len);
+  aux_text[slot][n][copy_len] = 0;
+  n++;
+
+  text += len;
+  if(*text == '\n')
+   text++;
+ }
+
+ aux_cur = slot;
+ aux_lines = n;
+}
+
+static void FrameTime_Add(FrameTimeHist* h, int64 us)
+{
+ const uint32 gen = reset_gen.load(std::memory_order_relaxed);
+ const uint32 v = std::min<int64>(std::max<int64>(0, us), 0xFFFFFFFF);
+
+ if(MDFN_UNLIKELY(h->gen != gen))
+ {
+  for(auto& b : h->bucket)
+   b.store(0, std::memory_order_relaxed);
+  h->count.store(0, std::memory_order_relaxed);
+  h->sum.store(0, std::memory_order_relaxed);
+  h->sumsq.store(0, std::memory_order_relaxed);
+  h->min.store(~0U, std::memory_order_relaxed);
+  h->max.store(0, std::memory_order_relaxed);
+  h->gen = gen;
+ }
+
+ auto& b = h->bucket[std::min<uint32>(FT_BUCKETS, v / FT_BUCKET_US)];
+ b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+ h->count.store(h->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+ h->sum.store(h->sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+ h->sumsq.store(h->sumsq.load(std::memory_order_relaxed) + (uint64)v * v, std::memory_order_relaxed);
+ if(v < h->min.load(std::memory_order_relaxed))
+  h->min.store(v, std::memory_order_relaxed);
+ if(v > h->max.load(std::memory_order_relaxed))
+  h->max.store(v, std::memory_order_relaxed);
+}
+
+void FPS_AddTime(unsigned which, int64 us)
+{
+ if(which == FPS_TIME_SOUND || which == FPS_TIME_SYNC)
+ {
+  frame_waits[which - FPS_TIME_SOUND] += us;
+  wait_total += us;
+ }
+ else
+  FrameTime_Add(&FrameTimes[which], us);
+}
+
+void FPS_BeginEmulate(void)
+{
+ emulate_start = Time::MonoUS();
+ emulate_waits = wait_total;
+}
+
+void FPS_EndEmulate(void)
+{
+ // Midsync sound output and throttling happen inside Emulate(); they have their own histograms.
+ FPS_AddTime(FPS_TIME_EMULATE, Time::MonoUS() - emulate_start - (wait_total - emulate_waits));
+}
+
+void FPS_ResetTimes(void)
+{
+ reset_gen.fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint32 FrameTimePercentile(const FrameTimeHist* h, const uint64 count, const double frac)
+{
+ const uint64 target = std::max<uint64>(1, (uint64)(count * frac + 0.5));
+ uint64 seen = 0;
+
+ for(unsigned i = 0; i <= FT_BUCKETS; i++)
+ {
+  seen += h->bucket[i].load(std::memory_order_relaxed);
+  if(seen >= target)
+   return i * FT_BUCKET_US + FT_BUCKET_US / 2;
+ }
+ return FT_BUCKETS * FT_BUCKET_US;
+}
+
+std::string FPS_TimeStats(bool hist)
+{
+ const uint32 gen = reset_gen.load(std::memory_order_relaxed);
+ std::string ret;
+ char tmp[256];
+
+ for(unsigned which = 0; which < FPS_TIME_COUNT; which++)
+ {
+  const FrameTimeHist* h = &FrameTimes[which];
+  const uint64 count = (h->gen == gen) ? h->count.load(std::memory_order_relaxed) : 0;
+
+  if(!count)
+  {
+   trio_snprintf(tmp, sizeof(tmp), "%s%s n=0", ret.size() ? " " : "", FrameTimeNames[which]);
+   ret += tmp;
+   continue;
+  }
+
+  const double mean = (double)h->sum.load(std::memory_order_relaxed) / count;
+  const double var = std::max<double>(0, (double)h->sumsq.load(std::memory_order_relaxed) / count - mean * mean);
+  const uint32 p50 = FrameTimePercentile(h, count, 0.50);
+
+  trio_snprintf(tmp, sizeof(tmp), "%s%s n=%llu mean=%.1f sd=%.1f min=%u p50=%u p95=%u p99=%u max=%u", ret.size() ? " " : "", FrameTimeNames[which],
+	(unsigned long long)count, mean, sqrt(var), h->min.load(std::memory_order_relaxed), p50, FrameTimePercentile(h, count, 0.95),
+	FrameTimePercentile(h, count, 0.99), h->max.load(std::memory_order_relaxed));
+  ret += tmp;
+
+  if(which == FPS_TIME_FRAME)
+  {
+   uint64 late = 0;
+
+   // Frames that took over 1.5x the median: the stutters.
+   for(unsigned i = (p50 * 3 / 2) / FT_BUCKET_US + 1; i <= FT_BUCKETS; i++)
+    late += h->bucket[i].load(std::memory_order_relaxed);
+
+   trio_snprintf(tmp, sizeof(tmp), " late=%llu", (unsigned long long)late);
+   ret += tmp;
+  }
+
+  if(hist)
+  {
+   bool first = true;
+
+   ret += " hist=";
+   for(unsigned i = 0; i <= FT_BUCKETS; i++)
+   {
+    const uint32 n = h->bucket[i].load(std::memory_order_relaxed);
+
+    if(n)
+    {
+     trio_snprintf(tmp, sizeof(tmp), "%s%u:%u", first ? "" : ",", i * FT_BUCKET_US, n);
+     ret += tmp;
+     first = false;
+    }
+   }
+  }
+ }
+
+ return ret;
+}
+
 static bool isactive = 0;
 
 void FPS_ToggleView(void)
@@ -108,10 +298,27 @@ void FPS_ToggleView(void)
 
 void FPS_UpdateCalc(void)
 {
- uint32 curtime = Time::MonoMS();
+ const int64 curtime_us = Time::MonoUS();
+ uint32 curtime = curtime_us / 1000;
  uint32 mintime = ~0U;
+ uint32 interval = 0;
+
+ if(last_calc_us)
+ {
+  interval = std::min<int64>(curtime_us - last_calc_us, 0xFFFFFFFF);
+  FrameTime_Add(&FrameTimes[FPS_TIME_FRAME], interval);
+ }
+ last_calc_us = curtime_us;
+
+ // Sound and sync waits go in once per frame, however many calls they were made of.
+ for(unsigned i = 0; i < 2; i++)
+ {
+  FrameTime_Add(&FrameTimes[FPS_TIME_SOUND + i], frame_waits[i]);
+  frame_waits[i] = 0;
+ }
 
  TimeDrawn[TDIndex].t = curtime;
+ TimeDrawn[TDIndex].interval = interval;
  //TimeDrawn[TDIndex].vcycles = inc_vcycles;
  TimeDrawn[TDIndex].mask = inc_mask;
  TDIndex = (TDIndex + 1) & 127;
@@ -122,6 +329,7 @@ void FPS_UpdateCalc(void)
   return;
 
  uint32 vt_frames_drawn = 0, dt_frames_drawn = 0, bt_frames_drawn = 0;
+ uint32 worst = 0;
  //uint64 vcyc_accum = 0;
 
  for(int x = 0; x < 128; x++)
@@ -135,6 +343,7 @@ void FPS_UpdateCalc(void)
     vt_frames_drawn += (bool)(TimeDrawn[qi].mask & 0x1);
     dt_frames_drawn += (bool)(TimeDrawn[qi].mask & 0x2);
     bt_frames_drawn += (bool)(TimeDrawn[qi].mask & 0x4);
+    worst = std::max<uint32>(worst, TimeDrawn[qi].interval);
 
     //vcyc_accum += TimeDrawn[qi].vcycles;
    }
@@ -150,18 +359,20 @@ void FPS_UpdateCalc(void)
   cur_vfps = (float)vt_frames_drawn * 1000 / (curtime - mintime);
   cur_dfps = (float)dt_frames_drawn * 1000 / (curtime - mintime);
   cur_bfps = (float)bt_frames_drawn * 1000 / (curtime - mintime);
+  cur_worst_ms = (float)worst / 1000;
  }
  else
  {
   cur_vfps = 0;
   cur_dfps = 0;
   cur_bfps = 0;
+  cur_worst_ms = 0;
  }
 }
 
-static void CalcFramerates(char *virtfps, char *drawnfps, char *blitfps, size_t maxlen)
+static void CalcFramerates(char *virtfps, char *drawnfps, char *blitfps, char *worstms, size_t maxlen)
 {
- double vf = cur_vfps, df = cur_dfps, bf = cur_bfps;
+ double vf = cur_vfps, df = cur_dfps, bf = cur_bfps, wm = cur_worst_ms;
 
  if(vf != 0)
   trio_snprintf(virtfps, maxlen, "%f", vf);
@@ -177,6 +388,12 @@ static void CalcFramerates(char *virtfps, char *drawnfps, char *blitfps, size_t
   trio_snprintf(blitfps, maxlen, "%f", bf);
  else
   trio_snprintf(blitfps, maxlen, "?");
+
+ // Longest frame interval in the last second, in milliseconds.
+ if(wm != 0)
+  trio_snprintf(worstms, maxlen, "%.1fms", wm);
+ else
+  trio_snprintf(worstms, maxlen, "?");
 }
 
 void FPS_DrawToScreen(const MDFN_PixelFormat& pf, const MDFN_Rect& cr, unsigned min_screen_w_h)
@@ -187,22 +404,34 @@ void FPS_DrawToScreen(const MDFN_PixelFormat& pf, const MDFN_Rect& cr, unsigned
  FPSSurface->SetFormat(pf, false);
  //
  const unsigned eff_scale = scale ? scale : std::max<unsigned>(1, /*std::min(cr.w, cr.h)*/min_screen_w_h / std::max(FPSRect.w, FPSRect.h) / 8);
- char virtfps[32], drawnfps[32], blitfps[32];
+ char virtfps[32], drawnfps[32], blitfps[32], worstms[32];
  const uint32 surf_text_color = FPSSurface->MakeColor((text_color >> 16) & 0xFF, (text_color >> 8) & 0xFF, (text_color >> 0) & 0xFF, (text_color >> 24) & 0xFF);
 
- CalcFramerates(virtfps, drawnfps, blitfps, 32);
+ CalcFramerates(virtfps, drawnfps, blitfps, worstms, 32);
 
  FPSSurface->Fill((bg_color >> 16) & 0xFF, (bg_color >> 8) & 0xFF, (bg_color >> 0) & 0xFF, (bg_color >> 24) & 0xFF);
 
  DrawText(FPSSurface, 0, font_height * 0, virtfps, surf_text_color, font);
  DrawText(FPSSurface, 0, font_height * 1, drawnfps, surf_text_color, font);
  DrawText(FPSSurface, 0, font_height * 2, blitfps, surf_text_color, font);
+ DrawText(FPSSurface, 0, font_height * 3, worstms, surf_text_color, font);
+
+ MDFN_Rect srect = FPSRect;
+ {
+  const unsigned slot = aux_cur;
+  const unsigned n = std::min<unsigned>((unsigned)aux_lines, AUX_LINES);
+
+  for(unsigned i = 0; i < n; i++)
+   DrawText(FPSSurface, 0, font_height * (4 + i), aux_text[slot][i], surf_text_color, font);
+
+  srect.h += n * font_height;
+ }
  //
  //
  MDFN_Rect drect;
 
- drect.w = FPSRect.w * eff_scale;
- drect.h = FPSRect.h * eff_scale;
+ drect.w = srect.w * eff_scale;
+ drect.h = srect.h * eff_scale;
 
  switch(position)
  {
@@ -226,5 +455,5 @@ void FPS_DrawToScreen(const MDFN_PixelFormat& pf, const MDFN_Rect& cr, unsigned
 	drect.y = cr.y + (cr.h - drect.h) / 2;
 	break;
  }
- BlitOSD(FPSSurface, &FPSRect, &drect, -1);
+ BlitOSD(FPSSurface, &srect, &drect, -1);
 }
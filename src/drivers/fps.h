@@ -15,6 +15,27 @@ void FPS_IncVirtual(int64 vcycles);	// GT
 void FPS_IncDrawn(void);	// GT
 void FPS_IncBlitted(void);	// GT
 void FPS_UpdateCalc(void);	// GT
+void FPS_SetAuxText(const char* text);	// GT; up to two '\n'-separated lines shown below the rates, "" to clear
+
+// Frame pacing histograms, in microseconds.  FRAME is the interval between FPS_UpdateCalc() calls, EMULATE
+// the time between FPS_BeginEmulate() and FPS_EndEmulate() less the waits in it, SOUND(blocking sound
+// writes) and SYNC(real-time throttle) are summed per frame.
+enum
+{
+ FPS_TIME_FRAME = 0,
+ FPS_TIME_EMULATE,
+ FPS_TIME_SOUND,
+ FPS_TIME_SYNC,
+ FPS_TIME_BLIT,
+ FPS_TIME_VSYNC,
+
+ FPS_TIME_COUNT
+};
+void FPS_AddTime(unsigned which, int64 us);	// GT, except FPS_TIME_BLIT and FPS_TIME_VSYNC(MT)
+void FPS_BeginEmulate(void);	// GT
+void FPS_EndEmulate(void);	// GT
+void FPS_ResetTimes(void);
+std::string FPS_TimeStats(bool hist);	// One "<name> n= mean= sd= min= p50= p95= p99= max=" group per FPS_TIME_*
 
 void FPS_DrawToScreen(const MDFN_PixelFormat& pf, const MDFN_Rect& cr, unsigned min_screen_w_h);	// MT
 
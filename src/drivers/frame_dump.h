@@ -0,0 +1,416 @@
+/* frame_dump.h -- Background frame dump pipeline (frame_dump)
+ *
+ * Automation_Poll hands every Nth rendered frame to Submit(), which only
+ * copies the visible rectangle (each line up to its LineWidths entry, black
+ * beyond) into a job and queues it. A small pool of encoder threads turns
+ * jobs into files in the dump directory:
+ *
+ *   raw   <frame>_<w>x<h>.rgb   packed RGB24, top to bottom
+ *   qoi   <frame>.qoi           QOI, 3 channels
+ *   png   <frame>.png           PNGWrite at zlib level 1
+ *   none  no per-frame files (stream only)
+ *
+ * <frame> is the 8-digit automation frame number; a job submitted with a path
+ * goes to that one file instead (dump_vdp1_fb png=). With a stream, every dumped
+ * frame is also appended, in frame order, to stream.rgb as RGB24 at the size
+ * of the first frame (cropped or padded with black), for
+ *
+ *   ffmpeg -f rawvideo -pix_fmt rgb24 -s <w>x<h> -r 60 -i stream.rgb out.mp4
+ *
+ * At most Max_Queue frames are queued or being encoded; Submit() blocks on a
+ * full queue (counted in Stalls()), so no frame is dropped and the emulation
+ * thread only waits when the encoders fall behind.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_DRIVERS_FRAME_DUMP_H
+#define __MDFN_DRIVERS_FRAME_DUMP_H
+
+#include <mednafen/mednafen.h>
+#include <mednafen/MThreading.h>
+#include "../video/png.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class FrameDump
+{
+ public:
+
+ enum Format : unsigned { FMT_NONE = 0, FMT_RAW, FMT_QOI, FMT_PNG };
+ enum : unsigned { Max_Workers = 8 };
+ enum : unsigned { Max_Queue = 8 };
+
+ // Returns nullptr (with *err set) if the stream file can't be created.
+ static FrameDump* Open(const std::string& dir, Format format, bool stream, unsigned workers, std::string* err)
+ {
+  FILE* sfp = nullptr;
+
+  if(stream && !(sfp = fopen((dir + "/stream.rgb").c_str(), "wb")))
+  {
+   *err = "cannot create " + dir + "/stream.rgb";
+   return nullptr;
+  }
+
+  return new FrameDump(dir, format, sfp, std::max<unsigned>(1, std::min<unsigned>(Max_Workers, workers)));
+ }
+
+ ~FrameDump()
+ {
+  Finish();
+
+  Mednafen::MThreading::Sem_Destroy(slots_sem);
+  Mednafen::MThreading::Sem_Destroy(jobs_sem);
+  Mednafen::MThreading::Mutex_Destroy(mutex);
+ }
+
+ void Submit(uint64 frame, const Mednafen::MDFN_Surface* surface, const Mednafen::MDFN_Rect& rect, const int32* lw, const std::string& path = std::string())
+ {
+  const bool use_lw = lw && lw[0] != ~0;
+  int32 w = rect.w;
+
+  if(use_lw)
+  {
+   w = 0;
+   for(int32 y = 0; y < rect.h; y++)
+    w = std::max<int32>(w, lw[rect.y + y]);
+  }
+
+  if(w <= 0 || rect.h <= 0)
+   return;
+
+  if(!Mednafen::MThreading::Sem_TimedWait(slots_sem, 0))
+  {
+   stalls++;
+   Mednafen::MThreading::Sem_Wait(slots_sem);
+  }
+
+  Job* job = new Job;
+
+  job->frame = frame;
+  job->path = path;
+  job->seq = submitted++;
+  job->w = w;
+  job->h = rect.h;
+  job->format = surface->format;
+  job->pixels.resize((size_t)w * rect.h);
+
+  for(int32 y = 0; y < rect.h; y++)
+  {
+   const uint32* src = surface->pixels + (size_t)(rect.y + y) * surface->pitchinpix + rect.x;
+   uint32* dst = &job->pixels[(size_t)y * w];
+   const int32 lwy = use_lw ? std::min<int32>(w, lw[rect.y + y]) : w;
+
+   memcpy(dst, src, lwy * sizeof(uint32));
+   memset(dst + lwy, 0, (w - lwy) * sizeof(uint32));
+  }
+
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  if(stream_fp && !job->seq)
+  {
+   stream_w = w;
+   stream_h = rect.h;
+  }
+  queue.push_back(job);
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+  Mednafen::MThreading::Sem_Post(jobs_sem);
+ }
+
+ // Waits for every queued frame to be written and stops the encoders; Submit() must not be called afterwards.
+ void Finish(void)
+ {
+  if(!num_workers)
+   return;
+
+  for(unsigned i = 0; i < num_workers; i++)
+   Mednafen::MThreading::Sem_Post(jobs_sem);
+
+  for(unsigned i = 0; i < num_workers; i++)
+   Mednafen::MThreading::Thread_Wait(workers[i], nullptr);
+
+  num_workers = 0;
+
+  if(stream_fp && fclose(stream_fp))
+   Fail("cannot write " + dir + "/stream.rgb");
+  stream_fp = nullptr;
+ }
+
+ INLINE uint64 Submitted(void) const { return submitted; }
+ INLINE uint64 Stalls(void) const { return stalls; }
+
+ // "WxH" of stream.rgb once a frame has been submitted, else empty.
+ std::string StreamSize(void)
+ {
+  std::string ret;
+
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  if(stream_w)
+   ret = std::to_string(stream_w) + "x" + std::to_string(stream_h);
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+
+  return ret;
+ }
+
+ // First encoder or write error, if any.
+ std::string Error(void)
+ {
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  const std::string ret = error;
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+
+  return ret;
+ }
+
+ private:
+
+ struct Job
+ {
+  uint64 frame;
+  std::string path;	// instead of dir + <frame>.<ext>, if set
+  uint64 seq;
+  int32 w, h;
+  Mednafen::MDFN_PixelFormat format;
+  std::vector<uint32> pixels;	// w * h, zero past each line's width
+  std::vector<uint8> rgb;	// stream frame, stream_w * stream_h * 3
+ };
+
+ FrameDump(const std::string& d, Format f, FILE* sfp, unsigned n) : dir(d), format(f), stream_fp(sfp), num_workers(n)
+ {
+  mutex = Mednafen::MThreading::Mutex_Create();
+  jobs_sem = Mednafen::MThreading::Sem_Create();
+  slots_sem = Mednafen::MThreading::Sem_Create();
+
+  for(unsigned i = 0; i < Max_Queue; i++)
+   Mednafen::MThreading::Sem_Post(slots_sem);
+
+  for(unsigned i = 0; i < num_workers; i++)
+   workers[i] = Mednafen::MThreading::Thread_Create(WorkerEntry, this, "FrameDump");
+ }
+
+ static int WorkerEntry(void* data)
+ {
+  FrameDump* fd = (FrameDump*)data;
+
+  for(;;)
+  {
+   Job* job = nullptr;
+
+   Mednafen::MThreading::Sem_Wait(fd->jobs_sem);
+   Mednafen::MThreading::Mutex_Lock(fd->mutex);
+   if(!fd->queue.empty())
+   {
+    job = fd->queue.front();
+    fd->queue.pop_front();
+   }
+   Mednafen::MThreading::Mutex_Unlock(fd->mutex);
+
+   // Exit posts come after every job post, so the queue is drained first.
+   if(!job)
+    return 0;
+
+   fd->Encode(job);
+  }
+ }
+
+ static void DecodeRGB(const Job* job, int32 x0, int32 y0, int32 w, int32 h, uint8* out)
+ {
+  for(int32 y = 0; y < h; y++)
+  {
+   for(int32 x = 0; x < w; x++)
+   {
+    int r = 0, g = 0, b = 0;
+
+    if(x + x0 < job->w && y + y0 < job->h)
+     job->format.DecodeColor(job->pixels[(size_t)(y + y0) * job->w + x + x0], r, g, b);
+
+    out[0] = r;
+    out[1] = g;
+    out[2] = b;
+    out += 3;
+   }
+  }
+ }
+
+ static void EncodeQOI(const uint8* rgb, const uint32 w, const uint32 h, std::vector<uint8>* out)
+ {
+  uint8 index[64][4];	// RGBA like the decoder's, so never-written slots(alpha 0) don't match
+  uint8 prev[3] = { 0, 0, 0 };
+  unsigned run = 0;
+
+  memset(index, 0, sizeof(index));
+  out->clear();
+  out->reserve(14 + (size_t)w * h * 4 + 8);
+  out->insert(out->end(), { 'q', 'o', 'i', 'f' });
+  for(const uint32 v : { w, h })
+   out->insert(out->end(), { (uint8)(v >> 24), (uint8)(v >> 16), (uint8)(v >> 8), (uint8)v });
+  out->insert(out->end(), { 3, 0 });
+
+  for(size_t i = 0; i < (size_t)w * h; i++, rgb += 3)
+  {
+   if(!memcmp(rgb, prev, 3))
+   {
+    if(++run == 62)
+    {
+     out->push_back(0xC0 | (run - 1));
+     run = 0;
+    }
+    continue;
+   }
+
+   if(run)
+   {
+    out->push_back(0xC0 | (run - 1));
+    run = 0;
+   }
+
+   const unsigned hi = (rgb[0] * 3 + rgb[1] * 5 + rgb[2] * 7 + 255 * 11) & 0x3F;
+
+   if(!memcmp(index[hi], rgb, 3) && index[hi][3] == 0xFF)
+    out->push_back(hi);
+   else
+   {
+    const int vr = (int8)(rgb[0] - prev[0]);
+    const int vg = (int8)(rgb[1] - prev[1]);
+    const int vb = (int8)(rgb[2] - prev[2]);
+    const int vg_r = vr - vg;
+    const int vg_b = vb - vg;
+
+    memcpy(index[hi], rgb, 3);
+    index[hi][3] = 0xFF;
+
+    if(vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1)
+     out->push_back(0x40 | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2));
+    else if(vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 && vg_b >= -8 && vg_b <= 7)
+     out->insert(out->end(), { (uint8)(0x80 | (vg + 32)), (uint8)(((vg_r + 8) << 4) | (vg_b + 8)) });
+    else
+     out->insert(out->end(), { 0xFE, rgb[0], rgb[1], rgb[2] });
+   }
+   memcpy(prev, rgb, 3);
+  }
+
+  if(run)
+   out->push_back(0xC0 | (run - 1));
+
+  out->insert(out->end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+ }
+
+ void Fail(const std::string& msg)
+ {
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  if(error.empty())
+   error = msg;
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+ }
+
+ void WriteFile(const std::string& path, const void* data, size_t len)
+ {
+  FILE* fp = fopen(path.c_str(), "wb");
+  bool ok = fp && fwrite(data, 1, len, fp) == len;
+
+  if(fp && fclose(fp))
+   ok = false;
+
+  if(!ok)
+   Fail("cannot write " + path);
+ }
+
+ void Encode(Job* job)
+ {
+  char name[64];
+
+  try
+  {
+   if(format == FMT_RAW || format == FMT_QOI)
+   {
+    std::vector<uint8> rgb((size_t)job->w * job->h * 3);
+
+    DecodeRGB(job, 0, 0, job->w, job->h, rgb.data());
+    if(format == FMT_RAW)
+    {
+     snprintf(name, sizeof(name), "/%08llu_%dx%d.rgb", (unsigned long long)job->frame, (int)job->w, (int)job->h);
+     WriteFile(job->path.size() ? job->path : dir + name, rgb.data(), rgb.size());
+    }
+    else
+    {
+     std::vector<uint8> qoi;
+
+     EncodeQOI(rgb.data(), job->w, job->h, &qoi);
+     snprintf(name, sizeof(name), "/%08llu.qoi", (unsigned long long)job->frame);
+     WriteFile(job->path.size() ? job->path : dir + name, qoi.data(), qoi.size());
+    }
+   }
+   else if(format == FMT_PNG)
+   {
+    Mednafen::MDFN_Surface surf(job->pixels.data(), job->w, job->h, job->w, job->format);
+    Mednafen::MDFN_Rect rect;
+
+    rect.x = rect.y = 0;
+    rect.w = job->w;
+    rect.h = job->h;
+    snprintf(name, sizeof(name), "/%08llu.png", (unsigned long long)job->frame);
+    Mednafen::PNGWrite(job->path.size() ? job->path : dir + name, &surf, rect, nullptr, 1);
+   }
+  }
+  catch(std::exception& e)
+  {
+   Fail(e.what());
+  }
+
+  if(!stream_fp)
+  {
+   delete job;
+   Mednafen::MThreading::Sem_Post(slots_sem);
+   return;
+  }
+
+  // stream_w/h were set with job 0 in Submit(), before any job reached a worker.
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  const int32 sw = stream_w, sh = stream_h;
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+
+  job->rgb.resize((size_t)sw * sh * 3);
+  DecodeRGB(job, 0, 0, sw, sh, job->rgb.data());
+  job->pixels = std::vector<uint32>();
+
+  // Whoever completes the oldest outstanding frame writes it and any later ones already done.
+  Mednafen::MThreading::Mutex_Lock(mutex);
+  stream_pending[job->seq] = job;
+  while(!stream_pending.empty() && stream_pending.begin()->first == stream_next)
+  {
+   Job* sj = stream_pending.begin()->second;
+
+   if(fwrite(sj->rgb.data(), 1, sj->rgb.size(), stream_fp) != sj->rgb.size() && error.empty())
+    error = "cannot write " + dir + "/stream.rgb";
+   stream_pending.erase(stream_pending.begin());
+   stream_next++;
+   delete sj;
+   Mednafen::MThreading::Sem_Post(slots_sem);
+  }
+  Mednafen::MThreading::Mutex_Unlock(mutex);
+ }
+
+ const std::string dir;
+ const Format format;
+ FILE* stream_fp;
+ unsigned num_workers;
+
+ Mednafen::MThreading::Mutex* mutex = nullptr;
+ Mednafen::MThreading::Sem* jobs_sem = nullptr;	// one post per queued job, plus one per worker to exit
+ Mednafen::MThreading::Sem* slots_sem = nullptr;	// Max_Queue minus frames queued or being encoded
+ Mednafen::MThreading::Thread* workers[Max_Workers];
+
+ // Under mutex
+ std::deque<Job*> queue;
+ std::map<uint64, Job*> stream_pending;	// encoded, waiting for earlier frames
+ uint64 stream_next = 0;
+ int32 stream_w = 0, stream_h = 0;
+ std::string error;
+
+ // Emulation thread only
+ uint64 submitted = 0;
+ uint64 stalls = 0;
+};
+
+#endif
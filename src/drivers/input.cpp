@@ -2108,6 +2108,19 @@ void Input_Update(bool VirtualDevicesOnly, bool UpdateRapidFire)
 {
  static unsigned int rapid=0;
 
+ if(Automation_OwnsInput())
+ {
+  for(unsigned int x = 0; x < CurGame->PortInfo.size(); x++)
+  {
+   if(!PIDC[x].Data)
+    continue;
+
+   memset(PIDC[x].Data, 0, PIDC[x].Device->IDII.InputByteSize);
+   Automation_GetInput(x, PIDC[x].Data, PIDC[x].Device->IDII.InputByteSize);
+  }
+  return;
+ }
+
  UpdatePhysicalDeviceState();
 
  DoKeyStateZeroing();	// Call before CheckCommandKeys()
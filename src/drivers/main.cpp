@@ -81,6 +81,16 @@ static bool NeededWMInputBehavior_Dirty = false;
 bool MDFNDHaveFocus;
 static bool RemoteOn = FALSE;
 static char* PendingAutomationDir = NULL;
+static char* PendingAutomationSocket = NULL;
+static int AutomationGDBPort = 0;
+static int AutomationPool = 0;
+static int AutomationHeadless = 0;
+static int AutomationTurbo = 0;
+static int AutomationRewind = 0;
+static bool AutomationRequested = false;	// -automation is on the command line(known before settings are loaded).
+static bool SettingsReadOnly = false;		// -settings_readonly, or another instance holds the base directory lock; don't write the settings file.
+static int SettingsReadOnlyArg = 0;		// -settings_readonly(known before settings are loaded): no lock file either.
+static std::string SettingsPath;		// -settings_file(known before settings are loaded); empty for mednafen.cfg in the base directory.
 bool pending_save_state, pending_snapshot, pending_ssnapshot, pending_save_movie;
 static uint64 MainThreadID = 0;
 static bool ffnosound;
@@ -190,6 +200,7 @@ static const MDFNSetting DriverSettings[] =
   { "sound", MDFNSF_NOFLAGS, gettext_noop("Enable sound output."), NULL, MDFNST_BOOL, "1" },
   { "sound.period_time", MDFNSF_NOFLAGS, gettext_noop("Desired period size in microseconds(μs)."), gettext_noop("Currently only affects OSS, ALSA, WASAPI(exclusive mode), and SDL output.  A value of 0 defers to the default in the driver code in SexyAL.\n\nNote: This is not the \"sound buffer size\" setting, that would be \"\5sound.buffer_time\"."), MDFNST_UINT,  "0", "0", "100000" },
   { "sound.buffer_time", MDFNSF_NOFLAGS, gettext_noop("Desired buffer size in milliseconds(ms)."), gettext_noop("The default value of 0 enables automatic buffer size selection."), MDFNST_UINT, "0", "0", "1000" },
+  { "sound.ring", MDFNSF_NOFLAGS, gettext_noop("Write sound to the device from a separate thread."), gettext_noop("The emulation thread hands sound to a writer thread through a lock-free ring buffer and never waits on the sound device; it's kept to real-time speed by the timer instead.  The ring's latency adapts to underruns: it grows by 5 ms after one, up to 200 ms, and shrinks by 1 ms after every 5 seconds without one, down to 5 ms.  Meant for interactive debugging next to automation; the automation command \"sound_status\" reports the ring's state."), MDFNST_BOOL, "0" },
   { "sound.rate", MDFNSF_NOFLAGS, gettext_noop("Specifies the sound playback rate, in sound frames per second(\"Hz\")."), NULL, MDFNST_UINT, "48000", "22050", "192000"},
 
   #ifdef WANT_DEBUGGER
@@ -717,8 +728,8 @@ static void CDTest(const char* path)
   CDUtility::TOC toc[2];
   const uint64 affinity = 0;
 
-  cds[0] = CDInterface::Open(&NVFS, path, false, affinity);
-  cds[1] = CDInterface::Open(&NVFS, path, true, affinity);
+  cds[0] = CDInterface::Open(&NVFS, path, false, false, affinity);
+  cds[1] = CDInterface::Open(&NVFS, path, true, false, affinity);
 
   for(unsigned i = 0; i < 2; i++)
    cds[0]->ReadTOC(&toc[i]);
@@ -885,6 +896,7 @@ static bool DoArgs(int argc, char *argv[], char **filename)
 	char *dsfn = NULL;
 	char *dmfn = NULL;
 	char *dummy_remote = NULL;
+	char *dummy_settings_file = NULL;	// Taken before settings are loaded; see SettingsPath.
 	char *exptestspath = NULL;
 	char *cdtestpath = NULL;
 	int swiftresamptest = 0;
@@ -912,6 +924,14 @@ static bool DoArgs(int argc, char *argv[], char **filename)
 
 	 { "remote", /*_("Enable remote mode with the specified stdout key(EXPERIMENTAL AND INCOMPLETE).")*/NULL, 0, &dummy_remote, SUBSTYPE_STRING_ALLOC },
 	 { "automation", _("Enable automation mode with specified directory for action/ack files."), 0, &PendingAutomationDir, SUBSTYPE_STRING_ALLOC },
+	 { "automation_socket", _("Also accept automation commands on a socket(\"tcp:<port>\" or a Unix socket path)."), 0, &PendingAutomationSocket, SUBSTYPE_STRING_ALLOC },
+	 { "automation_gdb", _("With -automation: serve the GDB remote protocol on this loopback TCP port(both SH-2s as threads)."), 0, &AutomationGDBPort, SUBSTYPE_INTEGER },
+	 { "automation_pool", _("With -automation_headless: fork this many instances once the game has loaded and lease them out(pool_acquire/pool_release); each gets its own directory and, with -automation_socket, its own socket."), 0, &AutomationPool, SUBSTYPE_INTEGER },
+	 { "automation_headless", _("With -automation: no window or video output, no speed throttling(use with -sound 0); frames are rendered only when a screenshot needs them."), &AutomationHeadless, 0, 0 },
+	 { "automation_turbo", _("With -automation: start in \"speed max\"(no throttling or sound output, frames rendered only when needed) but keep the window."), &AutomationTurbo, 0, 0 },
+	 { "settings_readonly", _("Load settings without locking the base directory or the settings file, and never save them; many instances can share one base directory and settings file."), &SettingsReadOnlyArg, 0, 0 },
+	 { "settings_file", _("Load settings from the specified file instead of mednafen.cfg in the base directory(e.g. a prebuilt file shared with -settings_readonly)."), 0, &dummy_settings_file, SUBSTYPE_STRING_ALLOC },
+	 { "automation_rewind", _("With -automation: turn on state rewinding when a game loads, for the \"rewind\" command(see srwframes and srwmemory)."), &AutomationRewind, 0, 0 },
 	 { "dump_settings_def", /*_("Dump settings definition data to specified file.")*/NULL, 0, &dsfn, SUBSTYPE_STRING_ALLOC },
 	 { "dump_modules_def", /*_("Dump modules definition data to specified file.")*/NULL, 0, &dmfn, SUBSTYPE_STRING_ALLOC },
 
@@ -976,6 +996,12 @@ static bool DoArgs(int argc, char *argv[], char **filename)
 	  dummy_remote = NULL;
 	 }
 
+	 if(dummy_settings_file)
+	 {
+	  free(dummy_settings_file);
+	  dummy_settings_file = NULL;
+	 }
+
 	 if(ShowCLHelp)
 	 {
           printf(usage_string, argv[0]);
@@ -1179,7 +1205,7 @@ static int LoadGame(const char *force_module, const char *path)
         }
 
 	ffnosound = MDFN_GetSettingB("ffnosound");
-	RewindState = MDFN_GetSettingB("srwautoenable");
+	RewindState = MDFN_GetSettingB("srwautoenable") || AutomationRewind;
 	if(RewindState)
 	{
 	 MDFN_Notify(MDFN_NOTICE_STATUS, _("State rewinding functionality enabled."));
@@ -1318,6 +1344,9 @@ static int GameLoop(void *arg)
 	 fskip &= !(pending_ssnapshot || pending_snapshot || pending_save_state || pending_save_movie || NeedFrameAdvance);
 	 fskip |= (bool)NoWaiting;
 
+	 if(Automation_IsActive())	// Headless and render_skip: compose only frames automation will look at.
+	  fskip = Automation_FrameSkip(fskip) && !(pending_ssnapshot || pending_snapshot || pending_save_state || pending_save_movie);
+
 	 //printf("fskip %d; NeedFrameAdvance=%d\n", fskip, NeedFrameAdvance);
 
 	 NeedFrameAdvance = false;
@@ -1336,10 +1365,23 @@ static int GameLoop(void *arg)
 	 espec.soundmultiplier = CurGameSpeed;
 	 espec.NeedRewind = DNeedRewind;
 
- 	 espec.SoundRate = Sound_GetRate();
-	 espec.SoundBuf = Sound_GetEmuModBuffer(&espec.SoundBufMaxSize);
+ 	 // Automation "speed max" drops the sound(see UpdateSoundSync()); unless it's being recorded, ask for none,
+	 // so the core skips resampling and mixing it.
+	 if(Automation_Turbo() && !qtrecfn && !soundrecfn)
+	 {
+	  espec.SoundRate = 0;
+	  espec.SoundBuf = NULL;
+	  espec.SoundBufMaxSize = 0;
+	 }
+	 else
+	 {
+ 	  espec.SoundRate = Sound_GetRate();
+	  espec.SoundBuf = Sound_GetEmuModBuffer(&espec.SoundBufMaxSize);
+	 }
  	 espec.SoundVolume = (double)MDFN_GetSettingUI("sound.volume") / 100;
 
+	 FPS_BeginEmulate();
+
 	 if(MDFN_UNLIKELY(StateFuzzTest))
 	 {
 	  EmulateSpecStruct estmp = espec;
@@ -1388,6 +1430,8 @@ static int GameLoop(void *arg)
 	 else
           MDFNI_Emulate(&espec);
 
+	 FPS_EndEmulate();
+
 	 if(MDFN_UNLIKELY(StateSLSTest))
 	 {
 	  MemoryStream orig_state(524288);
@@ -1890,8 +1934,27 @@ char *GetFileDialog(void)
 }
 #endif
 
+static std::string GetSettingsPath(void)
+{
+ return SettingsPath.empty() ? (DrBaseDirectory + MDFN_PSS + "mednafen.cfg") : SettingsPath;
+}
+
 static bool LoadSettings(void)
 {
+ // A read-only or explicitly given settings file is used as it is: no lock, no write access, no 0.9.x migration.
+ if(SettingsReadOnly || !SettingsPath.empty())
+ {
+  const int r = MDFNI_LoadSettings(GetSettingsPath().c_str(), false, SettingsReadOnly);
+
+  if(r < 0 && !SettingsPath.empty())
+  {
+   MDFN_Notify(MDFN_NOTICE_ERROR, _("Settings file \"%s\" not found."), MDFN_strhumesc(SettingsPath).c_str());
+   return false;
+  }
+
+  return r != 0;
+ }
+
  const std::string opath09x = DrBaseDirectory + MDFN_PSS + "mednafen-09x.cfg";
  const std::string npath = DrBaseDirectory + MDFN_PSS + "mednafen.cfg";
  bool mednafencfg_old = false;	// "mednafen.cfg" is old(0.8.x or earlier), or nonexistent
@@ -1987,11 +2050,12 @@ static bool LoadSettings(void)
 
 static void SaveSettings(void)
 {
+ if(SettingsReadOnly)
+  return;
+
  try
  {
-  const std::string npath = DrBaseDirectory + MDFN_PSS + "mednafen.cfg";
-
-  MDFNI_SaveSettings(npath.c_str());
+  MDFNI_SaveSettings(GetSettingsPath().c_str());
  }
  catch(std::exception& e)
  {
@@ -2016,7 +2080,8 @@ static bool MainVideoLoop(void)
    {
     VideoError = false;     // Set to false before calling Video_Sync().
     //
-    Video_Sync(CurGame);
+    if(!AutomationHeadless)	// Headless: no window or GL context to (re)create.
+     Video_Sync(CurGame);
     PumpWrap();
     //
     FirstVideoSync = false; // Set to false AFTER calling Video_Sync().
@@ -2025,7 +2090,8 @@ static bool MainVideoLoop(void)
 
    if(NeededWMInputBehavior_Dirty)
    {
-    Video_SetWMInputBehavior(NeededWMInputBehavior);
+    if(!AutomationHeadless)
+     Video_SetWMInputBehavior(NeededWMInputBehavior);
     NeededWMInputBehavior_Dirty = false;
    }
 
@@ -2034,7 +2100,7 @@ static bool MainVideoLoop(void)
 
     if(vtr >= 0)
     {
-     if(!VideoError)
+     if(!VideoError && !AutomationHeadless)
       BlitScreen(SoftFB[vtr].surface.get(), &SoftFB[vtr].rect, SoftFB[vtr].lw.get(), VTRotated, SoftFB[vtr].field, VTSSnapshot);
 
      // Set to -1 after we're done blitting everything(including on-screen display stuff), and NOT just the emulated system's video surface.
@@ -2326,6 +2392,25 @@ int main(int argc, char *argv[])
 	 InitSTDIOInterface(argv[2]);
 	}
 
+	// Headless automation hosts usually have no display; SDL still needs a video driver for event processing.
+	for(int i = 1; i < argc; i++)
+	{
+	 if(!MDFN_strazicmp(argv[i], "-automation_headless") || !MDFN_strazicmp(argv[i], "--automation_headless"))
+	  SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+	 if(!MDFN_strazicmp(argv[i], "-automation") || !MDFN_strazicmp(argv[i], "--automation"))
+	  AutomationRequested = true;
+
+	 if(!MDFN_strazicmp(argv[i], "-settings_readonly") || !MDFN_strazicmp(argv[i], "--settings_readonly"))
+	 {
+	  SettingsReadOnlyArg = 1;
+	  SettingsReadOnly = true;
+	 }
+
+	 if((!MDFN_strazicmp(argv[i], "-settings_file") || !MDFN_strazicmp(argv[i], "--settings_file")) && (i + 1) < argc)
+	  SettingsPath = argv[i + 1];
+	}
+
 	#ifdef WIN32
 	HandleConsoleMadness();
 	#endif
@@ -2451,8 +2536,11 @@ int main(int argc, char *argv[])
 	//
 	//
 	//
-	MDFN_printf(_("Opening lockfile...\n"));
+	if(SettingsReadOnlyArg)
+	 MDFN_printf(_("Settings are read-only; not opening lockfile.\n"));
+	else
 	{
+	 MDFN_printf(_("Opening lockfile...\n"));
 	 MDFN_AutoIndent aind(1);
 	 try
 	 {
@@ -2464,7 +2552,14 @@ int main(int argc, char *argv[])
 	  {
 	   char* env_aw = getenv("MEDNAFEN_ALLOWMULTI");
 
-	   if(env_aw && atoi(env_aw) != 0)
+	   if(AutomationRequested)
+	   {
+	    // Automation instances each have their own IPC directory, so a fleet of them can share one base directory; only
+	    // the instance holding the lock writes the settings file.
+	    MDFN_printf(_("Base directory is in use by another instance; proceeding for automation, without saving settings.\n"));
+	    SettingsReadOnly = true;
+	   }
+	   else if(env_aw && atoi(env_aw) != 0)
 	   {	
 	    MDFN_printf(_("Error, but proceeding anyway per environment variable \"MEDNAFEN_ALLOWMULTI\".\n"));
 	   }
@@ -2508,6 +2603,32 @@ int main(int argc, char *argv[])
 	 Automation_Init(std::string(PendingAutomationDir));
 	 free(PendingAutomationDir);
 	 PendingAutomationDir = NULL;
+
+	 if(PendingAutomationSocket)
+	  Automation_InitSocket(std::string(PendingAutomationSocket));
+
+	 if(AutomationGDBPort)
+	  Automation_InitGDB(AutomationGDBPort);
+
+	 if(AutomationHeadless)
+	  Automation_SetHeadless(true);
+
+	 if(AutomationTurbo)
+	  Automation_SetTurbo(true);
+
+	 if(AutomationPool > 0)
+	  Automation_SetPool(AutomationPool);
+	}
+	else
+	{
+	 AutomationHeadless = 0;	// Meaningless without automation to drive it.
+	 AutomationRewind = 0;
+	}
+
+	if(PendingAutomationSocket)
+	{
+	 free(PendingAutomationSocket);
+	 PendingAutomationSocket = NULL;
 	}
 	//
 	//
@@ -2540,7 +2661,8 @@ int main(int argc, char *argv[])
 
 	 VTWakeupSem = MThreading::Sem_Create();
 	 //
-	 Video_Init();
+	 if(!AutomationHeadless)
+	  Video_Init();
 	 //
 	 JoystickManager::Init();
 	 JoystickManager::SetAnalogThreshold(MDFN_GetSettingF("analogthreshold") / 100);
@@ -2590,6 +2712,20 @@ int main(int argc, char *argv[])
 static uint32 last_btime = 0;
 static void UpdateSoundSync(int16 *Buffer, uint32 Count)
 {
+ static bool WasTurbo = false;
+
+ // Automation "speed max": drop the sound and don't sync to real time; restart the clock afterwards.
+ if(Automation_Turbo())
+ {
+  WasTurbo = true;
+  return;
+ }
+ else if(WasTurbo)
+ {
+  WasTurbo = false;
+  ers.SetETtoRT();
+ }
+
  if(Count)
  {
   if(ffnosound && CurGameSpeed != 1)
@@ -2601,7 +2737,7 @@ static void UpdateSoundSync(int16 *Buffer, uint32 Count)
   //
   //
   const uint32 cw = Sound_CanWrite();
-  bool NeedETtoRT = (Count >= (cw * 0.95));
+  bool NeedETtoRT = Sound_Blocks() && (Count >= (cw * 0.95));
 
   if(NoWaiting && Count > cw)
   {
@@ -2636,17 +2772,34 @@ static void UpdateSoundSync(int16 *Buffer, uint32 Count)
    }
   }
 
+  const int64 write_start = Time::MonoUS();
+
   Sound_Write(Buffer, Count);
+  FPS_AddTime(FPS_TIME_SOUND, Time::MonoUS() - write_start);
 
   if(NeedETtoRT)
    ers.SetETtoRT();
+
+  // sound.ring: the write above didn't wait for the device, so sync to real time here.
+  if(!Sound_Blocks() && !NoWaiting && !MDFN_GetSettingB("nothrottle") && !AutomationHeadless && GameThreadRun && !MDFNDnetplay)
+  {
+   const int64 sync_start = Time::MonoUS();
+
+   ers.Sync();
+   FPS_AddTime(FPS_TIME_SYNC, Time::MonoUS() - sync_start);
+  }
  }
  else
  {
   bool nothrottle = MDFN_GetSettingB("nothrottle");
 
-  if(!NoWaiting && !nothrottle && GameThreadRun && !MDFNDnetplay)
+  if(!NoWaiting && !nothrottle && !AutomationHeadless && GameThreadRun && !MDFNDnetplay)
+  {
+   const int64 sync_start = Time::MonoUS();
+
    ers.Sync();
+   FPS_AddTime(FPS_TIME_SYNC, Time::MonoUS() - sync_start);
+  }
  }
 }
 
@@ -2700,7 +2853,7 @@ void Mednafen::MDFND_MidSync(EmulateSpecStruct *espec, const unsigned flags)
 
 static bool PassBlit(const int WhichVideoBuffer)
 {
- if(WhichVideoBuffer < 0)
+ if(WhichVideoBuffer < 0 || Automation_NoVideoThread())
   return false;
 
  while(VTReady.load(std::memory_order_acquire) >= 0)
@@ -2710,7 +2863,7 @@ static bool PassBlit(const int WhichVideoBuffer)
      for fast-forwarding to respond well(since keyboard updates are
      handled in the main thread) on slower systems or when using a higher fast-forwarding speed ratio.
   */
-  if(!GameThreadRun || ((last_btime + 100) >= Time::MonoMS() && !pending_ssnapshot))
+  if(!GameThreadRun || (((last_btime + 100) >= Time::MonoMS() || Automation_Turbo()) && !pending_ssnapshot))
    return false;
   else
    Time::SleepMS(1);
@@ -2784,6 +2937,8 @@ static bool MDFND_Update(int WhichVideoBuffer, int16 *Buffer, int Count)
 
   pending_save_movie = pending_snapshot = pending_save_state = false;
  }
+ else if(Automation_IsActive())
+  Automation_Poll(NULL, NULL, NULL);	// Skipped frames still count; automation runs once per emulated frame.
 
  if(false == sc_blit_timesync)
  {
@@ -569,16 +569,16 @@ static const int32 byte_minrows = 4;
 static const int32 byte_maxrows = 16;
 
 
-// Call this function from the game thread
-void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_Rect *screen_rect)
+//
+// The hex and text columns are drawn into "pane", and a row's address or a byte's two
+// cells are only redrawn there when what they show changes(address, value, highlight);
+// each frame the pane is copied to the debugger surface, then the blinking edit cursor
+// is drawn over it, instead of ~530 DrawText() calls every frame.
+//
+void MemDebugger::DrawHexPane(MDFN_Surface *surface, const MDFN_Rect *rect, const int32 base_y, const uint32 curtime, const uint32 bg)
 {
- if(!IsActive)
-  return;
- //
- //
  const MDFN_PixelFormat pf_cache = surface->format;
 
- const uint32 title_color = pf_cache.MakeColor(0x20, 0xFF, 0x20, 0xFF);
  const uint32 addr_color = pf_cache.MakeColor(0xA0, 0xA0, 0xFF, 0xFF);
  const uint32 addr_active_color = pf_cache.MakeColor(0xB0, 0xC0, 0xFF, 0xFF);
 
@@ -588,23 +588,17 @@ void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_
  const uint32 byte_active_other_color = pf_cache.MakeColor(0xFF, 0x80, 0x80, 0xFF);
 
  const uint32 edit_cursor_color = pf_cache.MakeColor(0xFF, 0xFF, 0xFF, 0xFF);
-
- const uint32 error_border_color = pf_cache.MakeColor(0xFF, 0xFF, 0xFF, 0xFF);
- const uint32 error_bg_color = pf_cache.MakeColor(0x00, 0x00, 0x00, 0xFF);
- const uint32 error_color = pf_cache.MakeColor(0xFF, 0x00, 0x00, 0xFF);
  //
  //
- const uint32 curtime = Time::MonoMS();
- int32 text_y = 0;
  const uint64 zemod = ASpace->size;
 
- DrawText(surface, 0, text_y, ASpace->long_name, title_color, MDFN_FONT_6x12, rect->w);
- text_y += 12;
-
- if(ASpace->IsWave && ASpace->size <= sizeof(waveform) && ASpace->WaveBits <= 6)
+ if(!pane || pane->w != rect->w || pane->format != surface->format || pane_bg != bg || pane_aspace != CurASpace)
  {
-  text_y += 4;
-  text_y += DrawWaveform(surface, text_y, rect->w);
+  pane.reset(new MDFN_Surface(NULL, rect->w, byte_maxrows * byte_vspacing, rect->w, surface->format));
+  std::fill(pane->pixels, pane->pixels + pane->pitchinpix * pane->h, bg);
+  pane_keys.assign(byte_maxrows * (1 + byte_bpr), ~(uint64)0);
+  pane_bg = bg;
+  pane_aspace = CurASpace;
  }
 
  uint32 A;
@@ -624,35 +618,45 @@ void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_
  else if(numrows < byte_minrows)
   numrows = byte_minrows;
 
+ const uint32 test_match_pos = ASpacePos[CurASpace] % zemod;
+ int cursor_y = -1, cursor_x = 0;
+ char cursor_hex[16] = { 0 };
+ char cursor_ascii[2] = { 0 };
+
  for(int y = 0; y < numrows; y++)
  {
   uint8 byte_buffer[byte_bpr];
   char abuf[32];
+  const int32 text_y = y * byte_vspacing;
+  uint64* keys = &pane_keys[y * (1 + byte_bpr)];
 
   Ameow %= zemod;
 
   ASpace->GetAddressSpaceBytes(ASpace->name.c_str(), Ameow, byte_bpr, byte_buffer);
 
-  trio_snprintf(abuf, 32, "%0*X:", (std::max<int>(12, 63 - MDFN_lzcount64(round_up_pow2(zemod))) + 3) / 4, Ameow);
-
-  uint32 alen = addr_left_padding;
   {
-   uint32 color = addr_color;
+   const bool active = (Ameow == (ASpacePos[CurASpace] & ~0xF));
+   const uint64 key = Ameow | ((uint64)active << 32);
 
-   if(Ameow == (ASpacePos[CurASpace] & ~0xF))
-    color = addr_active_color;
+   if(keys[0] != key)
+   {
+    trio_snprintf(abuf, 32, "%0*X:", (std::max<int>(12, 63 - MDFN_lzcount64(round_up_pow2(zemod))) + 3) / 4, Ameow);
 
-   alen += DrawText(surface, alen, text_y, abuf, color, addr_font);
-   alen += addr_right_padding;
+    MDFN_DrawFillRect(pane.get(), 0, text_y, pane_alen ? pane_alen : pane->w, byte_vspacing, bg);
+    pane_alen = addr_left_padding + DrawText(pane.get(), addr_left_padding, text_y, abuf, active ? addr_active_color : addr_color, addr_font) + addr_right_padding;
+    keys[0] = key;
+   }
   }
 
+  const uint32 alen = pane_alen;
+
   for(int x = 0; x < byte_bpr; x++)
   {
    uint32 bcolor = byte_hex_color;
    uint32 acolor = byte_char_color;
+   unsigned hilite = 0;
 
    char quickbuf[16];
-   uint32 test_match_pos;
    char ascii_str[2];
 
    ascii_str[1] = 0;
@@ -661,31 +665,9 @@ void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_
    if((uint8)ascii_str[0] < 0x20 || (uint8)ascii_str[0] >= 128)
     ascii_str[0] = '.';
 
-   trio_snprintf(quickbuf, 16, "%02X", byte_buffer[x]);
-
-   test_match_pos = ASpacePos[CurASpace] % zemod;
-
    if(Ameow == test_match_pos)
    {
-    if(InEditMode)
-    {
-     if(curtime & 0x80)
-     {
-      int pix_offset = alen;
-
-      if(InTextArea)
-      {
-       pix_offset += byte_bpr * byte_hex_spacing + byte_hex_right_padding + x * byte_char_spacing + ((byte_bpr - 1) / 4) * byte_hex_group_pad;
-       DrawText(surface, pix_offset, text_y + byte_char_y_adjust, "▉", edit_cursor_color, byte_char_font); 
-      }
-      else
-      {
-       pix_offset += (LowNib ? byte_hex_font_width : 0) + x * byte_hex_spacing + (x / 4) * byte_hex_group_pad;
-       DrawText(surface, pix_offset, text_y, "▉", edit_cursor_color, byte_hex_font);
-      }
-
-     }
-    }
+    hilite = 1 + InTextArea;
 
     if(InTextArea)
     {
@@ -699,16 +681,94 @@ void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_
     }
    }
 
-   // hex display
-   DrawText(surface, alen + x * byte_hex_spacing + ((x / 4) * byte_hex_group_pad), text_y, quickbuf, bcolor, byte_hex_font);
+   const int32 hex_x = alen + x * byte_hex_spacing + ((x / 4) * byte_hex_group_pad);
+   const int32 ascii_x = alen + byte_bpr * byte_hex_spacing + byte_hex_right_padding + x * byte_char_spacing + ((byte_bpr - 1) / 4) * byte_hex_group_pad;
+   const uint64 key = byte_buffer[x] | (hilite << 8);
 
-   // ASCII display
-   DrawText(surface, alen + byte_bpr * byte_hex_spacing + byte_hex_right_padding + x * byte_char_spacing + ((byte_bpr - 1) / 4) * byte_hex_group_pad, text_y + byte_char_y_adjust, ascii_str, acolor, byte_char_font);
+   if(keys[1 + x] != key || hilite)
+   {
+    trio_snprintf(quickbuf, 16, "%02X", byte_buffer[x]);
+
+    if(keys[1 + x] != key)
+    {
+     MDFN_DrawFillRect(pane.get(), hex_x, text_y, byte_hex_font_width * 2, byte_vspacing, bg);
+     MDFN_DrawFillRect(pane.get(), ascii_x, text_y, byte_char_spacing, byte_vspacing, bg);
+
+     // hex display
+     DrawText(pane.get(), hex_x, text_y, quickbuf, bcolor, byte_hex_font);
+
+     // ASCII display
+     DrawText(pane.get(), ascii_x, text_y + byte_char_y_adjust, ascii_str, acolor, byte_char_font);
+     keys[1 + x] = key;
+    }
+
+    if(hilite)
+    {
+     cursor_y = text_y;
+     cursor_x = x;
+     memcpy(cursor_hex, quickbuf, sizeof(cursor_hex));
+     memcpy(cursor_ascii, ascii_str, sizeof(cursor_ascii));
+    }
+   }
    Ameow++;
   }
-  text_y += byte_vspacing;
  }
 
+ //
+ // Copy the pane's rows, and draw the edit cursor under the cursor byte's text like the pane would.
+ //
+ const int32 copy_h = std::min<int32>(numrows * byte_vspacing, surface->h - base_y);
+
+ for(int32 y = 0; y < copy_h; y++)
+  memcpy(surface->pixels + (size_t)(base_y + y) * surface->pitchinpix, pane->pixels + (size_t)y * pane->pitchinpix, std::min<int32>(pane->w, surface->w) * sizeof(uint32));
+
+ if(InEditMode && (curtime & 0x80) && cursor_y >= 0)
+ {
+  const int32 hex_x = pane_alen + cursor_x * byte_hex_spacing + ((cursor_x / 4) * byte_hex_group_pad);
+  const int32 ascii_x = pane_alen + byte_bpr * byte_hex_spacing + byte_hex_right_padding + cursor_x * byte_char_spacing + ((byte_bpr - 1) / 4) * byte_hex_group_pad;
+  const int32 text_y = base_y + cursor_y;
+
+  if(InTextArea)
+   DrawText(surface, ascii_x, text_y + byte_char_y_adjust, "▉", edit_cursor_color, byte_char_font);
+  else
+   DrawText(surface, hex_x + (LowNib ? byte_hex_font_width : 0), text_y, "▉", edit_cursor_color, byte_hex_font);
+
+  DrawText(surface, hex_x, text_y, cursor_hex, InTextArea ? byte_active_other_color : byte_active_color, byte_hex_font);
+  DrawText(surface, ascii_x, text_y + byte_char_y_adjust, cursor_ascii, InTextArea ? byte_active_color : byte_active_other_color, byte_char_font);
+ }
+}
+
+// Call this function from the game thread
+void MemDebugger::Draw(MDFN_Surface *surface, const MDFN_Rect *rect, const MDFN_Rect *screen_rect)
+{
+ if(!IsActive)
+  return;
+ //
+ //
+ const MDFN_PixelFormat pf_cache = surface->format;
+ const uint32 bg = surface->pixels[0];	// the debugger's fill, before anything is drawn
+
+ const uint32 title_color = pf_cache.MakeColor(0x20, 0xFF, 0x20, 0xFF);
+
+ const uint32 error_border_color = pf_cache.MakeColor(0xFF, 0xFF, 0xFF, 0xFF);
+ const uint32 error_bg_color = pf_cache.MakeColor(0x00, 0x00, 0x00, 0xFF);
+ const uint32 error_color = pf_cache.MakeColor(0xFF, 0x00, 0x00, 0xFF);
+ //
+ //
+ const uint32 curtime = Time::MonoMS();
+ int32 text_y = 0;
+
+ DrawText(surface, 0, text_y, ASpace->long_name, title_color, MDFN_FONT_6x12, rect->w);
+ text_y += 12;
+
+ if(ASpace->IsWave && ASpace->size <= sizeof(waveform) && ASpace->WaveBits <= 6)
+ {
+  text_y += 4;
+  text_y += DrawWaveform(surface, text_y, rect->w);
+ }
+
+ DrawHexPane(surface, rect, text_y, curtime, bg);
+
  DrawAtCursorInfo(surface, 10 + byte_maxrows * byte_vspacing, rect->w);
  
  if(InPrompt)
@@ -1048,6 +1108,7 @@ int MemDebugger::Event(const SDL_Event *event)
 // Called after a game is loaded.
 MemDebugger::MemDebugger() : AddressSpaces(NULL), ASpace(NULL), IsActive(false), CurASpace(0),
 			     LowNib(false), InEditMode(false), InTextArea(false), error_string(NULL), error_time(-1),
+			     pane_bg(0), pane_aspace(-1), pane_alen(0),
 			     ict_game_to_utf8((iconv_t)-1), ict_utf8_to_game((iconv_t)-1), InPrompt(None), PromptTAKC(SDLK_UNKNOWN)
 {
  if(CurGame->Debugger)
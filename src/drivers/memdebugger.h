@@ -51,6 +51,7 @@ class MemDebugger
 
  int32 DrawWaveform(MDFN_Surface* surface, const int32 base_y, const uint32 hcenterw);
  void DrawAtCursorInfo(MDFN_Surface* surface, const int32 base_y, const uint32 hcenterw);
+ void DrawHexPane(MDFN_Surface* surface, const MDFN_Rect* rect, const int32 base_y, const uint32 curtime, const uint32 bg);
 
  // Local cache variable set after game load to reduce dereferences and make the code nicer.
  // (the game structure's debugger info struct doesn't change during emulation, so this is safe)
@@ -71,6 +72,14 @@ class MemDebugger
  char *error_string;
  int64 error_time;
 
+ // Hex pane cache(DrawHexPane()): pane_keys holds, per row, the address drawn and then
+ // each byte's value and highlight.
+ std::unique_ptr<MDFN_Surface> pane;
+ std::vector<uint64> pane_keys;
+ uint32 pane_bg;
+ int pane_aspace;
+ int32 pane_alen;
+
  typedef enum
  {
   None = 0,
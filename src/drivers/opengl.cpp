@@ -448,9 +448,12 @@ void OpenGL_Blitter::Blit(const MDFN_Surface *src_surface, const MDFN_Rect *src_
   shader->ShaderBegin(gl_screen_w, gl_screen_h, src_rect, dest_rect, tmpwidth, tmpheight, round((double)tmpwidth * original_src_rect->w / tex_src_rect.w), round((double)tmpheight * (original_src_rect->h >> ShaderIlace) / tex_src_rect.h), rotated);
 
  p_glPixelStorei(GL_UNPACK_ALIGNMENT, src_surface->format.opp);
- p_glPixelStorei(GL_UNPACK_ROW_LENGTH, src_surface->pitchinpix << ShaderIlace);
 
- p_glTexSubImage2D(GL_TEXTURE_2D, 0, tex_src_rect.x, tex_src_rect.y, tex_src_rect.w, tex_src_rect.h, PixelFormat, PixelType, src_pixies);
+ if(!UsePBO || !UploadPBO(src_pixies, tex_src_rect.w, tex_src_rect.h, (src_surface->pitchinpix << ShaderIlace) * src_surface->format.opp, src_surface->format.opp))
+ {
+  p_glPixelStorei(GL_UNPACK_ROW_LENGTH, src_surface->pitchinpix << ShaderIlace);
+  p_glTexSubImage2D(GL_TEXTURE_2D, 0, tex_src_rect.x, tex_src_rect.y, tex_src_rect.w, tex_src_rect.h, PixelFormat, PixelType, src_pixies);
+ }
 
  //
  // Draw texture
@@ -512,6 +515,58 @@ void OpenGL_Blitter::Blit(const MDFN_Surface *src_surface, const MDFN_Rect *src_
 }
 
 
+//
+// Copy the frame into the next buffer of the PBO ring, and update the texture from that buffer; the texture update
+// then doesn't have to be finished before glTexSubImage2D() returns, as it does when sourcing client memory.  With
+// GL_ARB_sync, a fence after each update keeps a buffer from being rewritten while the update reading it may
+// still be pending(only possible when the GL falls PBO_Count frames behind); without, the buffer's storage is
+// orphaned instead.  Returns false, with nothing uploaded, if the buffer can't be mapped.
+//
+bool OpenGL_Blitter::UploadPBO(const void* src_pixels, const uint32 w, const uint32 h, const uint32 src_pitch_bytes, const unsigned opp)
+{
+ auto& pb = PBORing[PBONext];
+ const size_t row_bytes = (size_t)w * opp;
+ const size_t size = row_bytes * h;
+ uint8* dest;
+
+ PBONext = (PBONext + 1) % PBO_Count;
+
+ if(pb.fence)
+ {
+  p_glClientWaitSync(pb.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  p_glDeleteSync(pb.fence);
+  pb.fence = nullptr;
+ }
+
+ p_glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, pb.buffer);
+
+ if(size > pb.size || !SupportARBSync)
+ {
+  p_glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, std::max(size, pb.size), NULL, GL_STREAM_DRAW_ARB);
+  pb.size = std::max(size, pb.size);
+ }
+
+ if(!(dest = (uint8*)p_glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB)))
+ {
+  p_glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+  return false;
+ }
+
+ for(uint32 y = 0; y < h; y++)
+  memcpy(dest + y * row_bytes, (const uint8*)src_pixels + (size_t)y * src_pitch_bytes, row_bytes);
+
+ p_glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+
+ p_glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+ p_glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, PixelFormat, PixelType, (const GLvoid*)0);
+ p_glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+
+ if(SupportARBSync)
+  pb.fence = p_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+ return true;
+}
+
 #if 0
 void OpenGL_Blitter::HardSync(uint64 timeout)
 {
@@ -539,6 +594,21 @@ void OpenGL_Blitter::HardSync(uint64 timeout)
 
 void OpenGL_Blitter::Cleanup(void)
 {
+ for(auto& pb : PBORing)
+ {
+  if(pb.fence)
+  {
+   p_glDeleteSync(pb.fence);
+   pb.fence = nullptr;
+  }
+
+  if(pb.buffer)
+  {
+   p_glDeleteBuffersARB(1, &pb.buffer);
+   pb.buffer = 0;
+  }
+ }
+
  if(textures[0])
   p_glDeleteTextures(4, &textures[0]);
 
@@ -734,7 +804,7 @@ static bool MednafenToGLFormat(const unsigned gl_version_h, const MDFN_PixelForm
 }
 
 /* Rectangle, left, right(not inclusive), top, bottom(not inclusive). */
-OpenGL_Blitter::OpenGL_Blitter(int scanlines, ShaderType pixshader, const ShaderParams& shader_params, MDFN_PixelFormat* game_pf, MDFN_PixelFormat* osd_pf, uint32 preferred_format)
+OpenGL_Blitter::OpenGL_Blitter(int scanlines, ShaderType pixshader, const ShaderParams& shader_params, MDFN_PixelFormat* game_pf, MDFN_PixelFormat* osd_pf, uint32 preferred_format, bool use_pbo)
 {
  try
  {
@@ -751,6 +821,15 @@ OpenGL_Blitter::OpenGL_Blitter(int scanlines, ShaderType pixshader, const Shader
  for(unsigned i = 0; i < 4; i++)
   textures[i] = 0;
 
+ UsePBO = false;
+ for(auto& pb : PBORing)
+ {
+  pb.buffer = 0;
+  pb.fence = nullptr;
+  pb.size = 0;
+ }
+ PBONext = 0;
+
  using_scanlines = 0;
  last_w = 0;
  last_h = 0;
@@ -853,11 +932,35 @@ OpenGL_Blitter::OpenGL_Blitter(int scanlines, ShaderType pixshader, const Shader
   SupportARBSync = true;
  }
 
+ if(CheckExtension(extensions, "GL_ARB_pixel_buffer_object"))
+ {
+  MDFN_printf(_("GL_ARB_pixel_buffer_object found.\n"));
+
+  if(use_pbo)
+  {
+   LFG(glGenBuffersARB);
+   LFG(glDeleteBuffersARB);
+   LFG(glBindBufferARB);
+   LFG(glBufferDataARB);
+   LFG(glMapBufferARB);
+   LFG(glUnmapBufferARB);
+   UsePBO = true;
+  }
+ }
+
  MDFN_indent(-1);
 
  p_glGenTextures(4, &textures[0]);
  using_scanlines = 0;
 
+ if(UsePBO)
+ {
+  for(auto& pb : PBORing)
+   p_glGenBuffersARB(1, &pb.buffer);
+
+  MDFN_printf(_("Using a ring of %u pixel buffer objects%s for emulated video texture uploads.\n"), (unsigned)PBO_Count, SupportARBSync ? _(" with fences") : "");
+ }
+
  shader = NULL;
 
  if(pixshader != SHADER_NONE)
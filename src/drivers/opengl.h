@@ -116,6 +116,25 @@ typedef void GLAPIENTRY (*glWaitSync_Func)(GLsync sync, GLbitfield flags, GLuint
 typedef void GLAPIENTRY (*glGetInteger64v_Func)(GLenum pname, GLint64 *params);
 typedef void GLAPIENTRY (*glGetSynciv_Func)(GLsync sync, GLenum pname, GLsizei bufSize, GLsizei *length, GLint *values);
 
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+#define GL_PIXEL_UNPACK_BUFFER_ARB	0x88EC
+#endif
+
+#ifndef GL_STREAM_DRAW_ARB
+#define GL_STREAM_DRAW_ARB		0x88E0
+#endif
+
+#ifndef GL_WRITE_ONLY_ARB
+#define GL_WRITE_ONLY_ARB		0x88B9
+#endif
+
+typedef void GLAPIENTRY (*glGenBuffersARB_Func)(GLsizei n, GLuint *buffers);
+typedef void GLAPIENTRY (*glDeleteBuffersARB_Func)(GLsizei n, const GLuint *buffers);
+typedef void GLAPIENTRY (*glBindBufferARB_Func)(GLenum target, GLuint buffer);
+typedef void GLAPIENTRY (*glBufferDataARB_Func)(GLenum target, ptrdiff_t size, const GLvoid *data, GLenum usage);
+typedef GLvoid* GLAPIENTRY (*glMapBufferARB_Func)(GLenum target, GLenum access);
+typedef GLboolean GLAPIENTRY (*glUnmapBufferARB_Func)(GLenum target);
+
 typedef GLhandleARB GLAPIENTRY (*glCreateShaderObjectARB_Func)(GLenum);
 typedef void GLAPIENTRY (*glShaderSourceARB_Func)(GLhandleARB, GLsizei, const GLcharARB* *, const GLint *);
 typedef void GLAPIENTRY (*glCompileShaderARB_Func)(GLhandleARB);
@@ -149,7 +168,7 @@ class OpenGL_Blitter
 {
  public:
 
- OpenGL_Blitter(int scanlines, ShaderType pixshader, const ShaderParams& shader_params, MDFN_PixelFormat* game_pf, MDFN_PixelFormat* osd_pf, uint32 preferred_format);
+ OpenGL_Blitter(int scanlines, ShaderType pixshader, const ShaderParams& shader_params, MDFN_PixelFormat* game_pf, MDFN_PixelFormat* osd_pf, uint32 preferred_format, bool use_pbo);
  ~OpenGL_Blitter();
 
  void SetViewport(int w, int h);
@@ -167,6 +186,7 @@ class OpenGL_Blitter
  void Cleanup(void);
  void DrawQuad(float src_coords[4][2], int dest_coords[4][2]);
  void DrawLinearIP(const unsigned UsingIP, const unsigned rotated, const MDFN_Rect *tex_src_rect, const MDFN_Rect *dest_rect, const uint32 tmpwidth, const uint32 tmpheight);
+ bool UploadPBO(const void* src_pixels, const uint32 w, const uint32 h, const uint32 src_pitch_bytes, const unsigned opp);
 
  glGetError_Func p_glGetError;
  glBindTexture_Func p_glBindTexture;
@@ -217,6 +237,13 @@ class OpenGL_Blitter
  glGetInteger64v_Func p_glGetInteger64v;
  glGetSynciv_Func p_glGetSynciv;
 
+ glGenBuffersARB_Func p_glGenBuffersARB;
+ glDeleteBuffersARB_Func p_glDeleteBuffersARB;
+ glBindBufferARB_Func p_glBindBufferARB;
+ glBufferDataARB_Func p_glBufferDataARB;
+ glMapBufferARB_Func p_glMapBufferARB;
+ glUnmapBufferARB_Func p_glUnmapBufferARB;
+
  glCreateShaderObjectARB_Func p_glCreateShaderObjectARB;
  glShaderSourceARB_Func p_glShaderSourceARB;
  glCompileShaderARB_Func p_glCompileShaderARB;
@@ -246,6 +273,7 @@ class OpenGL_Blitter
  uint32 MaxTextureSize;		// Maximum power-of-2 texture width/height(we assume they're the same, and if they're not, this is set to the lower value of the two)
  bool SupportNPOT; 		// True if the OpenGL implementation supports non-power-of-2-sized textures
  bool SupportARBSync;
+ bool UsePBO;			// Upload the emulated fb through PBORing(GL_ARB_pixel_buffer_object)
  GLenum InternalFormat, OSDInternalFormat;
  GLenum PixelFormat, OSDPixelFormat;// For glTexSubImage2D()
  GLenum PixelType, OSDPixelType;// For glTexSubImage2D()
@@ -253,6 +281,15 @@ class OpenGL_Blitter
  int gl_screen_w, gl_screen_h;
  GLuint textures[4];		// emulated fb, scanlines, osd, raw(netplay)
 
+ enum { PBO_Count = 3 };
+ struct
+ {
+  GLuint buffer;
+  GLsync fence;		// after the texture update reading it, if GL_ARB_sync
+  size_t size;
+ } PBORing[PBO_Count];
+ unsigned PBONext;
+
  int using_scanlines;	// Don't change to bool.
  unsigned int last_w, last_h;
 
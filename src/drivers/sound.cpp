@@ -21,11 +21,187 @@
 #include "sound.h"
 
 #include <mednafen/sexyal/sexyal.h>
+#include <mednafen/MThreading.h>
+
+#include <atomic>
 
 static SexyAL_device* Output = NULL;
 static SexyAL_format format;
 static SexyAL_buffering buffering;
 
+//
+// sound.ring: the game thread hands audio to a writer thread through a single-producer/single-consumer ring,
+// and the writer does the blocking device writes, so the game thread never waits on the sound device(it's
+// throttled by the real-time syncher instead, as with sound off; see UpdateSoundSync() in main.cpp).
+//
+// The writer plays from the ring once it holds "target" frames.  When it runs dry it counts an underrun,
+// plays a period of silence, raises the target by 5 ms(up to 200 ms) and waits for the ring to refill; after
+// 5 seconds without an underrun the target drops by 1 ms(down to 5 ms).  The game thread drops what doesn't
+// fit below twice the target plus a period, so latency stays bounded when the emulator runs ahead.
+//
+static struct
+{
+ int16* buf = nullptr;
+ uint32 size_mask;	// frames - 1, power of two
+ uint32 chunk;		// writer's write size, in frames
+ uint32 min_target, max_target, step_up, step_down;
+
+ std::atomic<uint32> read_pos, write_pos;	// in frames, wrapping
+ std::atomic<uint32> target;
+ std::atomic<uint64> underruns, dropped, played;
+ std::atomic<bool> quit;
+
+ MThreading::Thread* thread = nullptr;
+} Ring;
+
+static INLINE uint32 Ring_Fill(void)
+{
+ return Ring.write_pos.load(std::memory_order_acquire) - Ring.read_pos.load(std::memory_order_acquire);
+}
+
+static INLINE uint32 Ring_Limit(void)
+{
+ return std::min<uint32>(Ring.size_mask + 1, Ring.target.load(std::memory_order_relaxed) * 2 + Ring.chunk);
+}
+
+// Game thread.
+static void Ring_Push(const int16* data, uint32 frames)
+{
+ const uint32 fill = Ring_Fill();
+ const uint32 space = Ring_Limit() - std::min<uint32>(Ring_Limit(), fill);
+ const uint32 count = std::min<uint32>(frames, space);
+ uint32 wp = Ring.write_pos.load(std::memory_order_relaxed);
+
+ for(uint32 i = 0; i < count; i++, wp++)
+ {
+  for(uint32 ch = 0; ch < format.channels; ch++)
+   Ring.buf[(wp & Ring.size_mask) * format.channels + ch] = data ? data[i * format.channels + ch] : 0;
+ }
+
+ Ring.write_pos.store(wp, std::memory_order_release);
+
+ if(count < frames)
+  Ring.dropped.fetch_add(frames - count, std::memory_order_relaxed);
+}
+
+static int Ring_Thread(void*)
+{
+ std::unique_ptr<int16[]> tmp(new int16[Ring.chunk * format.channels]);
+ uint64 since_underrun = 0;
+ bool prebuffering = true;
+
+ while(!Ring.quit.load(std::memory_order_relaxed))
+ {
+  const uint32 fill = Ring_Fill();
+  uint32 target = Ring.target.load(std::memory_order_relaxed);
+
+  if(prebuffering)
+  {
+   if(fill < std::max<uint32>(target, Ring.chunk))
+   {
+    Time::SleepMS(1);
+    continue;
+   }
+   prebuffering = false;
+  }
+
+  if(fill < Ring.chunk)
+  {
+   Ring.underruns.fetch_add(1, std::memory_order_relaxed);
+   Ring.target.store(std::min<uint32>(Ring.max_target, target + Ring.step_up), std::memory_order_relaxed);
+   since_underrun = 0;
+   prebuffering = true;
+
+   memset(tmp.get(), 0, sizeof(int16) * Ring.chunk * format.channels);
+   Output->Write(Output, tmp.get(), Ring.chunk);
+   continue;
+  }
+  //
+  uint32 rp = Ring.read_pos.load(std::memory_order_relaxed);
+
+  for(uint32 i = 0; i < Ring.chunk; i++, rp++)
+  {
+   for(uint32 ch = 0; ch < format.channels; ch++)
+    tmp[i * format.channels + ch] = Ring.buf[(rp & Ring.size_mask) * format.channels + ch];
+  }
+
+  Ring.read_pos.store(rp, std::memory_order_release);
+  Output->Write(Output, tmp.get(), Ring.chunk);
+  Ring.played.fetch_add(Ring.chunk, std::memory_order_relaxed);
+
+  since_underrun += Ring.chunk;
+  if(since_underrun >= (uint64)format.rate * 5)
+  {
+   Ring.target.store(std::max<uint32>(Ring.min_target, target - std::min<uint32>(target, Ring.step_down)), std::memory_order_relaxed);
+   since_underrun = 0;
+  }
+ }
+
+ return 0;
+}
+
+static void Ring_Start(void)
+{
+ uint32 frames = 1;
+
+ while(frames < format.rate)	// 1 second or a bit more
+  frames <<= 1;
+
+ Ring.buf = (int16*)calloc(sizeof(int16) * format.channels, frames);
+ Ring.size_mask = frames - 1;
+ Ring.chunk = buffering.period_size ? std::min<uint32>(buffering.period_size, format.rate / 100) : (format.rate / 200);
+ Ring.min_target = format.rate * 5 / 1000;
+ Ring.max_target = format.rate * 200 / 1000;
+ Ring.step_up = format.rate * 5 / 1000;
+ Ring.step_down = format.rate / 1000;
+
+ Ring.read_pos.store(0);
+ Ring.write_pos.store(0);
+ Ring.target.store(format.rate * 20 / 1000);
+ Ring.underruns.store(0);
+ Ring.dropped.store(0);
+ Ring.played.store(0);
+ Ring.quit.store(false);
+
+ Ring.thread = MThreading::Thread_Create(Ring_Thread, NULL, "MDFN Sound");
+}
+
+static void Ring_Stop(void)
+{
+ if(Ring.thread)
+ {
+  Ring.quit.store(true);
+  MThreading::Thread_Wait(Ring.thread, NULL);
+  Ring.thread = nullptr;
+ }
+
+ if(Ring.buf)
+ {
+  free(Ring.buf);
+  Ring.buf = nullptr;
+ }
+}
+
+bool Sound_Blocks(void)
+{
+ return !Ring.thread;
+}
+
+std::string Sound_RingStatus(void)
+{
+ if(!Output)
+  return "active=0";
+
+ if(!Ring.thread)
+  return MDFN_sprintf("active=1 ring=0 rate=%u latency_ms=%.1f", format.rate, (double)buffering.latency * 1000 / format.rate);
+
+ const double fpms = (double)format.rate / 1000;
+
+ return MDFN_sprintf("active=1 ring=1 rate=%u fill_ms=%.1f target_ms=%.1f device_latency_ms=%.1f underruns=%llu dropped_frames=%llu played_frames=%llu",
+	format.rate, Ring_Fill() / fpms, Ring.target.load() / fpms, (double)buffering.latency / fpms,
+	(unsigned long long)Ring.underruns.load(), (unsigned long long)Ring.dropped.load(), (unsigned long long)Ring.played.load());
+}
+
 static int16* EmuModBuffer = NULL;
 static int32 EmuModBufferSize = 0;	// In frames.
 
@@ -47,6 +223,9 @@ uint32 Sound_CanWrite(void)
  if(!Output)
   return 0;
 
+ if(Ring.thread)
+  return Ring_Limit() - std::min<uint32>(Ring_Limit(), Ring_Fill());
+
  return Output->CanWrite(Output);
 }
 
@@ -55,6 +234,12 @@ void Sound_Write(int16 *Buffer, int Count)
  if(!Output)
   return;
 
+ if(Ring.thread)
+ {
+  Ring_Push(Buffer, Count);
+  return;
+ }
+
  if(!Output->Write(Output, Buffer, Count))
  {
   //
@@ -68,6 +253,16 @@ void Sound_Write(int16 *Buffer, int Count)
 void Sound_WriteSilence(int ms)
 {
  unsigned int frames = (uint64)format.rate * ms / 1000;
+
+ if(Ring.thread)
+ {
+  const uint32 target = Ring.target.load(std::memory_order_relaxed);
+
+  Ring_Push(nullptr, std::min<uint32>(frames, target - std::min<uint32>(target, Ring_Fill())));
+  Time::SleepMS(ms);
+  return;
+ }
+
  int16 SBuffer[frames * format.channels];
 
  memset(SBuffer, 0, sizeof(SBuffer));
@@ -353,6 +548,13 @@ bool Sound_Init(MDFNGI *gi)
  EmuModBuffer = (int16 *)calloc(sizeof(int16) * format.channels, EmuModBufferSize);
 
  SoundRate = format.rate;
+
+ if(MDFN_GetSettingB("sound.ring"))
+ {
+  Ring_Start();
+  MDFNI_printf(_("Ring buffer: %u sample frames, writes of %u sample frames\n"), Ring.size_mask + 1, Ring.chunk);
+ }
+
  MDFN_indent(-2);
 
  return true;
@@ -362,6 +564,8 @@ void Sound_Kill(void) noexcept
 {
  SoundRate = 0;
 
+ Ring_Stop();
+
  if(EmuModBuffer)
  {
   free(EmuModBuffer);
@@ -11,6 +11,11 @@ void Sound_WriteSilence(int ms);
 
 uint32 Sound_CanWrite(void);
 
+// False with sound.ring, where Sound_Write() never waits on the device and the caller has to throttle.
+bool Sound_Blocks(void);
+// Ring fill, target latency and underrun/drop counts, as key=value pairs(automation "sound_status").
+std::string Sound_RingStatus(void);
+
 int16 *Sound_GetEmuModBuffer(int32 *max_size);
 
 double Sound_GetRate(void);
@@ -194,6 +194,8 @@ static const MDFNSetting GlobalVideoSettings[] =
 
  { "video.glvsync", MDFNSF_NOFLAGS, gettext_noop("Attempt to synchronize OpenGL page flips to vertical retrace period."), NULL, MDFNST_BOOL, "1" },
 
+ { "video.glpbo", MDFNSF_NOFLAGS, gettext_noop("Upload emulated video through OpenGL pixel buffer objects."), gettext_noop("Each frame is copied into the next of a ring of three pixel buffer objects, and the texture is updated from there, so the update can complete after the blit returns instead of before(which can take milliseconds with software OpenGL implementations).  Only used when the GL_ARB_pixel_buffer_object extension is available."), MDFNST_BOOL, "1" },
+
  { "video.disable_composition", MDFNSF_NOFLAGS, gettext_noop("Attempt to disable desktop composition."), gettext_noop("Currently, this setting only has an effect on Windows Vista and Windows 7(and probably the equivalent server versions as well)."), MDFNST_BOOL, "1" },
 
  { NULL }
@@ -1263,7 +1265,7 @@ void Video_Sync(MDFNGI *gi)
    if(CurrentScaler && (CurrentScaler->id == NTVB_HQ2X || CurrentScaler->id == NTVB_HQ3X || CurrentScaler->id == NTVB_HQ4X))
     preferred_format = EVFSUPPORT_NONE;
 
-   ogl_blitter = new OpenGL_Blitter(video_settings.scanlines, video_settings.shader, video_settings.shader_params, &game_pf, &osd_pf, preferred_format);
+   ogl_blitter = new OpenGL_Blitter(video_settings.scanlines, video_settings.shader, video_settings.shader_params, &game_pf, &osd_pf, preferred_format, MDFN_GetSettingB("video.glpbo"));
    ogl_blitter->SetViewport(screen_w, screen_h);
 
    emu_pf = game_pf;
@@ -1672,6 +1674,7 @@ void BlitScreen(MDFN_Surface *msurface, const MDFN_Rect *DisplayRect, const int3
  //
  //
  //
+ const int64 blit_start = Time::MonoUS();
  MDFN_Rect src_rect;
 
  if(rotated != new_rotated)
@@ -1980,6 +1983,7 @@ void BlitScreen(MDFN_Surface *msurface, const MDFN_Rect *DisplayRect, const int3
   FPS_DrawToScreen(osd_pf, cr, std::min(screen_w, screen_h));
  }
  //
+ const int64 swap_start = Time::MonoUS();
 
  if(vdriver != VDRIVER_OPENGL)
   SDL_UpdateWindowSurface(window);
@@ -1990,6 +1994,9 @@ void BlitScreen(MDFN_Surface *msurface, const MDFN_Rect *DisplayRect, const int3
   // Don't insert any GL calls after SDL_GL_SwapWindow() here that could block until the swap completes.
   //ogl_blitter->HardSync();
  }
+
+ FPS_AddTime(FPS_TIME_BLIT, swap_start - blit_start);
+ FPS_AddTime(FPS_TIME_VSYNC, Time::MonoUS() - swap_start);
 }
 
 void Video_Exposed(void)
@@ -1999,7 +2006,12 @@ void Video_Exposed(void)
 
 void Video_PtoV(const int in_x, const int in_y, float* out_x, float* out_y)
 {
- assert(VideoGI);
+ // No video mode is ever set in automation headless runs; report the screen center.
+ if(!VideoGI)
+ {
+  *out_x = *out_y = 0.5;
+  return;
+ }
  //
  int32 tmp_x = in_x - screen_dest_rect.x;
  int32 tmp_y = in_y - screen_dest_rect.y;
@@ -27,10 +27,20 @@ namespace Mednafen
 
 void Endian_A16_Swap(void *src, uint32 nelements)
 {
- uint32 i;
+ uint32 i = 0;
  uint8 *nsrc = (uint8 *)src;
 
- for(i = 0; i < nelements; i++)
+ // Four elements per 64-bit word; the compiler turns this into vector shuffles.
+ for(; i + 4 <= nelements; i += 4)
+ {
+  uint64 tmp;
+
+  memcpy(&tmp, &nsrc[i * 2], 8);
+  tmp = ((tmp & 0x00FF00FF00FF00FFULL) << 8) | ((tmp >> 8) & 0x00FF00FF00FF00FFULL);
+  memcpy(&nsrc[i * 2], &tmp, 8);
+ }
+
+ for(; i < nelements; i++)
  {
   uint8 tmp = nsrc[i * 2];
 
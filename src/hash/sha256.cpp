@@ -22,6 +22,12 @@
 #include <mednafen/mednafen.h>
 #include "sha256.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+ #define SHA256_X86_SHA 1
+ #include <cpuid.h>
+ #include <immintrin.h>
+#endif
+
 namespace Mednafen
 {
 
@@ -73,6 +79,72 @@ static INLINE uint32 ls1(const uint32 x)
  return rotr<17>(x) ^ rotr<19>(x) ^ (x >> 10);
 }
 
+#ifdef SHA256_X86_SHA
+//
+// SHA extensions(SHA-NI) path, picked at runtime; processes 'count' 64-byte blocks.
+//
+static bool x86_sha_detect(void)
+{
+ unsigned eax, ebx, ecx, edx;
+
+ if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1U << 9)) || !(ecx & (1U << 19)))	// SSSE3, SSE4.1
+  return false;
+
+ if(__get_cpuid_max(0, nullptr) < 7)
+  return false;
+
+ __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+ return (bool)(ebx & (1U << 29));	// SHA
+}
+
+static const bool x86_sha_ok = x86_sha_detect();
+
+static __attribute__((target("sha,ssse3,sse4.1"))) void process_blocks_x86_sha(uint32* state, const uint8* data, size_t count)
+{
+ const __m128i bswap_mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+ __m128i tmp, state0, state1;
+
+ tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);	// CDAB
+ state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);	// EFGH
+ state0 = _mm_alignr_epi8(tmp, state1, 8);	// ABEF
+ state1 = _mm_blend_epi16(state1, tmp, 0xF0);	// CDGH
+
+ for(; count; count--, data += 0x40)
+ {
+  const __m128i abef_save = state0;
+  const __m128i cdgh_save = state1;
+  __m128i w[4];
+
+  for(unsigned g = 0; g < 16; g++)
+  {
+   __m128i& wg = w[g & 3];
+
+   if(g < 4)
+    wg = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + (g << 4))), bswap_mask);
+   else
+   {
+    // W[t-16] + s0(W[t-15]), + W[t-7], + s1(W[t-2])
+    tmp = _mm_add_epi32(_mm_sha256msg1_epu32(wg, w[(g + 1) & 3]), _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+    wg = _mm_sha256msg2_epu32(tmp, w[(g + 3) & 3]);
+   }
+
+   tmp = _mm_add_epi32(wg, _mm_loadu_si128((const __m128i*)&K[g << 2]));
+   state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+   state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(tmp, 0x0E));
+  }
+
+  state0 = _mm_add_epi32(state0, abef_save);
+  state1 = _mm_add_epi32(state1, cdgh_save);
+ }
+
+ tmp = _mm_shuffle_epi32(state0, 0x1B);	// FEBA
+ state1 = _mm_shuffle_epi32(state1, 0xB1);	// DCHG
+ _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));	// DCBA
+ _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));	// HGFE
+}
+#endif
+
 sha256_hasher::sha256_hasher()
 {
  reset();
@@ -88,6 +160,13 @@ void sha256_hasher::reset(void)
 
 INLINE void sha256_hasher::process_block(const uint8* blk_data)
 {
+#ifdef SHA256_X86_SHA
+ if(x86_sha_ok)
+ {
+  process_blocks_x86_sha(h.data(), blk_data, 1);
+  return;
+ }
+#endif
  alignas(16) uint32 w[64];
  alignas(16) auto v = h;
 
@@ -140,6 +219,17 @@ void sha256_hasher::process(const void* data, size_t len)
   }
   else
   {
+#ifdef SHA256_X86_SHA
+   if(x86_sha_ok)
+   {
+    const size_t blocks_len = len &~ (size_t)0x3F;
+
+    process_blocks_x86_sha(h.data(), d8, blocks_len >> 6);
+    d8 += blocks_len;
+    len -= blocks_len;
+    continue;
+   }
+#endif
    process_block(d8);
    d8 += 0x40;
    len -= 0x40;
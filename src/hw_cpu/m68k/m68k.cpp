@@ -77,6 +77,7 @@ M68K::M68K(const bool rev_e) : Revision_E(rev_e),
  timestamp = 0;
  XPending = 0;
  IPL = 0;
+ SetFastMap(nullptr, 0, 0, nullptr);
  Reset(true);
 }
 
@@ -189,11 +190,17 @@ INLINE T M68K::Read(uint32 addr)
  {
   uint32 ret;
 
-  ret = BusRead16(addr) << 16;
-  ret |= BusRead16(addr + 2);
+  ret = Read<uint16>(addr) << 16;
+  ret |= Read<uint16>(addr + 2);
 
   return ret;
  }
+ else if(UseFastMap(addr, (sizeof(T) == 1) ? (FastMapMask & ~1U) : FastMapMask))
+ {
+  timestamp += FastMapCycles;
+
+  return ne16_rbo_be<T>(FastMap, addr);
+ }
  else if(sizeof(T) == 2)
   return BusRead16(addr);
  else
@@ -204,7 +211,13 @@ INLINE uint16 M68K::ReadOp(void)
 {
  uint16 ret;
 
- ret = BusReadInstr(PC);
+ if(UseFastMap(PC, FastMapMask))
+ {
+  timestamp += FastMapCycles;
+  ret = ne16_rbo_be<uint16>(FastMap, PC);
+ }
+ else
+  ret = BusReadInstr(PC);
  PC += 2;
 
  return ret;
@@ -217,15 +230,20 @@ INLINE void M68K::Write(uint32 addr, const T val)
  {
   if(long_dec)
   {
-   BusWrite16(addr + 2, val);
-   BusWrite16(addr, val >> 16);
+   Write<uint16>(addr + 2, val);
+   Write<uint16>(addr, val >> 16);
   }
   else
   {
-   BusWrite16(addr, val >> 16);
-   BusWrite16(addr + 2, val);
+   Write<uint16>(addr, val >> 16);
+   Write<uint16>(addr + 2, val);
   }
  }
+ else if(UseFastMap(addr, (sizeof(T) == 1) ? (FastMapMask & ~1U) : FastMapMask))
+ {
+  timestamp += FastMapCycles;
+  ne16_wbo_be<T>(FastMap, addr, val);
+ }
  else if(sizeof(T) == 2)
   BusWrite16(addr, val);
  else
@@ -42,6 +42,22 @@ class M68K
  void SetIPL(uint8 ipl_new);
  void SetExtHalted(bool state);
 
+ //
+ // Optional fast path for a region of plain memory with fixed access timing.  A read,
+ // write, or opcode fetch at an address with none of the 'mask' bits set accesses
+ // map(16-bit words in host byte order) directly and adds 'cycles' to timestamp, instead
+ // of calling the bus handlers.  The handlers are still called whenever
+ // timestamp + cycles >= *deadline, so they can run any event that falls due during
+ // the access.  Pass nullptr for map to disable.
+ //
+ INLINE void SetFastMap(uint16* map, uint32 mask, int32 cycles, const int32* deadline)
+ {
+  FastMap = map;
+  FastMapMask = mask;
+  FastMapCycles = cycles;
+  FastMapDeadline = deadline;
+ }
+
 
  //
  // SignalDTACKHalted() and SignalAddressError() should be called from the external
@@ -125,6 +141,16 @@ class M68K
 
  uint16 ReadOp(void);
 
+ uint16* FastMap;
+ uint32 FastMapMask;
+ int32 FastMapCycles;
+ const int32* FastMapDeadline;
+
+ INLINE bool UseFastMap(uint32 addr, uint32 mask)
+ {
+  return FastMap && !(addr & mask) && (timestamp + FastMapCycles) < *FastMapDeadline;
+ }
+
  template<typename T, bool long_dec = false>
  void Write(uint32 addr, const T val);
 
@@ -126,7 +126,8 @@ MDFNGI *MDFNI_LoadExternalCD(const char* force_module, const char* path_hint, CD
 // Loads settings from specified path.
 // Call once, after MDFNI_InitFinalize()
 // returns -1 if settings file didn't exist, 0 on error, and 1 on success
-int MDFNI_LoadSettings(const char* path, bool override = false);
+// read_only opens the file without locking or write access, for a file that won't be saved back.
+int MDFNI_LoadSettings(const char* path, bool override = false, bool read_only = false);
 
 // Saves settings to specified path.
 // Call at least once right before MDFNI_Kill()
@@ -19,6 +19,7 @@
 
 #include <mednafen/cdrom/CDUtility.h>
 #include <mednafen/cdrom/CDInterface.h>
+#include <mednafen/cdrom/CDAFReader.h>
 
 #include <mednafen/string/string.h>
 #include <mednafen/string/escape.h>
@@ -102,12 +103,17 @@ static const MDFNSetting MednafenSettings[] =
   { "netplay.password", MDFNSF_NOFLAGS, gettext_noop("Server password."), gettext_noop("Password to connect to the netplay server."), MDFNST_STRING, "" },
   { "netplay.localplayers", MDFNSF_NOFLAGS, gettext_noop("Local player count."), gettext_noop("Number of local players for network play.  This number is advisory to the server, and the server may assign fewer players if the number of players requested is higher than the number of controllers currently available."), MDFNST_UINT, "1", "0", "16" },
   { "netplay.nick", MDFNSF_NOFLAGS, gettext_noop("Nickname."), gettext_noop("Nickname to use for network play chat."), MDFNST_STRING, "" },
+  { "netplay.rollback", MDFNSF_NOFLAGS, gettext_noop("Rollback window, in frames."), gettext_noop("0 keeps netplay in lockstep, each frame waiting for the server's input for it.  Above 0, frames are emulated without waiting, predicting that remote players hold their last input, and up to this many frames are emulated again when the real input turns out different.  Hides latency up to that many frames, at the cost of a save state per frame and the re-emulation."), MDFNST_UINT, "0", "0", "60" },
+  { "netplay.delta_state", MDFNSF_NOFLAGS, gettext_noop("Send save states as changes since the last sync."), gettext_noop("When everyone connected already holds the last synchronized state, a state sent to them(a resync, or a state loaded locally) carries only the 4 KiB pages that differ from it.  Clients without this support can't load such a state; disable it when playing with them."), MDFNST_BOOL, "1" },
   { "netplay.gamekey", MDFNSF_NOFLAGS, gettext_noop("Key to hash with the MD5 hash of the game."), NULL, MDFNST_STRING, "" },
 
   { "srwframes", MDFNSF_NOFLAGS, gettext_noop("Number of frames to keep states for when state rewinding is enabled."), 
 	gettext_noop("Caution: Setting this to a large value may cause excessive RAM usage in some circumstances, such as with games that stream large volumes of data off of CDs."), MDFNST_UINT, "600", "10", "99999" },
+  { "srwmemory", MDFNSF_NOFLAGS, gettext_noop("Memory limit, in MiB, for state rewinding history."), gettext_noop("When the compressed history grows past this, the oldest frames are dropped, so fewer frames than \"\5srwframes\" may be kept.  0 means no limit."), MDFNST_UINT, "0", "0", "65536" },
 
   { "cd.image_memcache", MDFNSF_NOFLAGS, gettext_noop("Cache entire CD images in memory."), gettext_noop("Reads the entire CD image(s) into memory at startup(which will cause a small delay).  Can help obviate emulation hiccups due to emulated CD access.  May cause more harm than good on low memory systems, systems with swap enabled, and/or when the disc images in question are on a fast SSD.\n\nCaution: When using a 32-bit build of Mednafen on Windows or a 32-bit operating system, Mednafen may run out of address space(and error out, possibly in the middle of emulation) if this option is enabled when loading large disc sets(e.g. 3+ discs) via M3U files."), MDFNST_BOOL, "0" },
+  { "cd.image_mmap", MDFNSF_NOFLAGS, gettext_noop("Memory-map CD images."), gettext_noop("Maps the CD image files read-only instead of reading them from a separate thread, when \"\5cd.image_memcache\" is disabled.  Nothing is read in at startup, and the image data is shared, via the operating system's file cache, between all instances that have the same image open.  Sector reads block until the data is in memory, so the first access to a part of the disc may cause an emulation hiccup on slow storage.  Also allows loading CD images from ZIP archives: entries stored without compression are mapped in place, and compressed entries are decompressed into memory at startup."), MDFNST_BOOL, "0" },
+  { "cd.audio_cache_dir", MDFNSF_NOFLAGS, gettext_noop("Directory for decoded compressed CD audio tracks."), gettext_noop("If set, Ogg Vorbis, Musepack and FLAC audio track files are decoded once into raw PCM files in this directory, named after a hash of the compressed file, and later played from a read-only mapping of those files.  Instances sharing the directory decode each file only once and share the decoded data via the operating system's file cache.  Each decoded file takes about 10MiB per minute of audio.  Leave empty to decode on the fly."), MDFNST_STRING, "" },
   { "cd.m3u.recursion_limit", MDFNSF_NOFLAGS, gettext_noop("M3U recursion limit."), gettext_noop("A value of 0 effectively disables recursive loading of M3U files."), MDFNST_UINT, "9", "0", "99" },
   { "cd.m3u.disc_limit", MDFNSF_NOFLAGS, gettext_noop("M3U total number of disc images limit."), NULL, MDFNST_UINT, "25", "1", "999" },
   { "filesys.untrusted_fip_check", MDFNSF_NOFLAGS, gettext_noop("Enable untrusted file-inclusion path security check."),
@@ -118,6 +124,7 @@ static const MDFNSetting MednafenSettings[] =
   { "filesys.path_savbackup", MDFNSF_CAT_PATH, gettext_noop("Path to directory for backups of save games and nonvolatile memory."), NULL, MDFNST_STRING, "b" },
   { "filesys.path_state", MDFNSF_CAT_PATH, gettext_noop("Path to directory for save states."), NULL, MDFNST_STRING, "mcs" },
   { "filesys.path_movie", MDFNSF_CAT_PATH, gettext_noop("Path to directory for movies."), NULL, MDFNST_STRING, "mcm" },
+  { "movie.keyframe_interval", MDFNSF_NOFLAGS, gettext_noop("Frames between keyframe snapshots when recording movies."), gettext_noop("When above 0, recording a movie also writes a save state every this many frames to a companion file named after the movie with \".mki\" appended, most of them stored as the difference from the previous one.  Seeking in the movie during playback(automation \"movie_seek\") then restores the nearest keyframe and replays only the frames after it, instead of replaying the movie from its start.  The movie file itself is unchanged.  0 disables keyframes."), MDFNST_UINT, "0", "0", "1000000" },
   { "filesys.path_cheat", MDFNSF_CAT_PATH, gettext_noop("Path to directory for cheats."), NULL, MDFNST_STRING, "cheats" },
   { "filesys.path_palette", MDFNSF_CAT_PATH, gettext_noop("Path to directory for custom palettes."), NULL, MDFNST_STRING, "palettes" },
   { "filesys.path_pgconfig", MDFNSF_CAT_PATH, gettext_noop("Path to directory for per-game configuration override files."), NULL, MDFNST_STRING, "pgconfig" },
@@ -132,12 +139,15 @@ static const MDFNSetting MednafenSettings[] =
   { "filesys.old_gz_naming", MDFNSF_SUPPRESS_DOC, gettext_noop("Enable old handling of .gz file extensions with respect to data file path construction."), NULL, MDFNST_BOOL, "0" },
 
   { "filesys.state_comp_level", MDFNSF_NOFLAGS, gettext_noop("Save state file compression level."), gettext_noop("gzip/deflate compression level for save states saved to files.  -1 will disable gzip compression and wrapping entirely."), MDFNST_INT, "6", "-1", "9" },
+  { "filesys.snap_comp_level", MDFNSF_NOFLAGS, gettext_noop("Screen snapshot PNG compression level."), gettext_noop("zlib deflate compression level for PNG screen snapshots, from 0(store) to 9(smallest).  -1 selects zlib's default."), MDFNST_INT, "-1", "-1", "9" },
+  { "filesys.snap_comp_threads", MDFNSF_NOFLAGS, gettext_noop("Screen snapshot PNG compression threads."), gettext_noop("Large snapshots are split into up to this many row stripes that are deflated in parallel; the result is still a single standard PNG, a few bytes larger per extra stripe.  1 disables threading."), MDFNST_UINT, "4", "1", "16" },
 
 
   { "qtrecord.w_double_threshold", MDFNSF_NOFLAGS, gettext_noop("Double the raw image's width if it's below this threshold."), NULL, MDFNST_UINT, "384", "0", "1073741824" },
   { "qtrecord.h_double_threshold", MDFNSF_NOFLAGS, gettext_noop("Double the raw image's height if it's below this threshold."), NULL, MDFNST_UINT, "256", "0", "1073741824" },
 
   { "qtrecord.vcodec", MDFNSF_NOFLAGS, gettext_noop("Video codec to use."), NULL, MDFNST_ENUM, "cscd", NULL, NULL, NULL, NULL, VCodec_List },
+  { "qtrecord.pipe", MDFNSF_NOFLAGS, gettext_noop("Pipe recorded video to this external encoder command."), gettext_noop("If set, video is written to the command's standard input as a YUV4MPEG2 4:4:4 stream(e.g. \"ffmpeg -f yuv4mpegpipe -i - -c:v libx264 out.mkv\"), qtrecord.vcodec is ignored, and the recording file receives the audio as a 16-bit PCM WAV file instead of a QuickTime movie."), MDFNST_STRING, "" },
 
   { "video.deinterlacer", MDFNSF_CAT_VIDEO, gettext_noop("Deinterlacer to use for interlaced video."), NULL, MDFNST_ENUM, "weave", NULL, NULL, NULL, SettingChanged, Deinterlacer_List },
 
@@ -340,6 +350,7 @@ bool MDFNI_StartAVRecord(const char *path, double SoundRate)
   spec.VideoHeight = MDFNGameInfo->lcm_height;
   spec.VideoCodec = MDFN_GetSettingI("qtrecord.vcodec");
   spec.MasterClock = MDFNGameInfo->MasterClock;
+  spec.FPS = MDFNGameInfo->fps;
 
   if(spec.VideoWidth < MDFN_GetSettingUI("qtrecord.w_double_threshold"))
    spec.VideoWidth *= 2;
@@ -356,7 +367,10 @@ bool MDFNI_StartAVRecord(const char *path, double SoundRate)
   MDFN_indent(1);
   MDFN_printf(_("Video width: %u\n"), spec.VideoWidth);
   MDFN_printf(_("Video height: %u\n"), spec.VideoHeight);
-  MDFN_printf(_("Video codec: %s\n"), MDFN_GetSettingS("qtrecord.vcodec").c_str());
+  if(MDFN_GetSettingS("qtrecord.pipe").size())
+   MDFN_printf(_("Video pipe: %s\n"), MDFN_strhumesc(MDFN_GetSettingS("qtrecord.pipe")).c_str());
+  else
+   MDFN_printf(_("Video codec: %s\n"), MDFN_GetSettingS("qtrecord.vcodec").c_str());
 
   if(spec.SoundRate && spec.SoundChan)
   {
@@ -369,6 +383,10 @@ bool MDFNI_StartAVRecord(const char *path, double SoundRate)
   MDFN_indent(-1);
   MDFN_printf("\n");
 
+  const std::string pipe_command = MDFN_GetSettingS("qtrecord.pipe");
+
+  spec.PipeCommand = pipe_command.c_str();
+
   qtrecorder = new QTRecord(path, spec);
  }
  catch(std::exception &e)
@@ -464,6 +482,7 @@ void MDFNI_CloseGame(void)
   //
   MDFNSRW_End();
   TBlur_Kill();
+  MDFNSS_WaitAsync();
   //
   //
   //
@@ -660,14 +679,14 @@ static const std::vector<FileExtensionSpecStruct> KnownCDExtensions =
  { ".toc", -70, "cdrdao TOC" },
 };
 
-static MDFN_COLD void OpenCD(const bool image_memcache, const uint64 affinity, const uint32 m3u_recursion_limit, const uint32 m3u_disc_limit, std::vector<M3U_ListEntry> &file_list, size_t* default_cd, unsigned depth,
+static MDFN_COLD void OpenCD(const bool image_memcache, const bool image_mmap, const uint64 affinity, const uint32 m3u_recursion_limit, const uint32 m3u_disc_limit, std::vector<M3U_ListEntry> &file_list, size_t* default_cd, unsigned depth,
 	VirtualFS* inside_vfs, const std::string& inside_path, std::unique_ptr<std::string> name_in)
 {
  const bool vfs_is_archive = (dynamic_cast<ArchiveReader*>(inside_vfs) != nullptr); // TODO: cleaner way of detecting archiveyness.
  //
  //
- if(vfs_is_archive && !image_memcache)
-  throw MDFN_Error(0, _("Setting \"cd.image_memcache\" must be set to \"1\" to allow loading a CD image from an archive."));
+ if(vfs_is_archive && !image_memcache && !image_mmap)
+  throw MDFN_Error(0, _("Setting \"cd.image_memcache\" or \"cd.image_mmap\" must be set to \"1\" to allow loading a CD image from an archive."));
  //
  //
  if(!inside_vfs->test_ext(inside_path, ".m3u"))
@@ -675,7 +694,7 @@ static MDFN_COLD void OpenCD(const bool image_memcache, const uint64 affinity, c
   if(file_list.size() >= m3u_disc_limit)
    throw MDFN_Error(0, _("Loading %s would exceed the M3U total disc count limit of %u!"), inside_vfs->get_human_path(inside_path).c_str(), m3u_disc_limit);
 
-  file_list.emplace_back(M3U_ListEntry({ std::unique_ptr<CDInterface>(CDInterface::Open(inside_vfs, inside_path, image_memcache, affinity)), std::move(name_in) }));
+  file_list.emplace_back(M3U_ListEntry({ std::unique_ptr<CDInterface>(CDInterface::Open(inside_vfs, inside_path, image_memcache, image_mmap, affinity)), std::move(name_in) }));
   return;
  }
  //
@@ -758,7 +777,7 @@ static MDFN_COLD void OpenCD(const bool image_memcache, const uint64 affinity, c
    aind.adjust(1);
   }
 
-  OpenCD(image_memcache, affinity, m3u_recursion_limit, m3u_disc_limit, file_list, default_cd, depth + 1, next_vfs, next_path, (next_vfs->test_ext(next_path, ".m3u") ? nullptr : std::move(name)));
+  OpenCD(image_memcache, image_mmap, affinity, m3u_recursion_limit, m3u_disc_limit, file_list, default_cd, depth + 1, next_vfs, next_path, (next_vfs->test_ext(next_path, ".m3u") ? nullptr : std::move(name)));
  }
 }
 
@@ -1109,6 +1128,7 @@ static std::unique_ptr<RMD_Layout> MDFN_LoadCD(VirtualFS* inside_vfs, const std:
  assert(!CDInterfaces.size());
  //
  const bool image_memcache = MDFN_GetSettingB("cd.image_memcache");
+ const bool image_mmap = MDFN_GetSettingB("cd.image_mmap");
  const uint64 affinity = MDFN_GetSettingUI("affinity.cd");
  const uint32 m3u_recursion_limit = MDFN_GetSettingUI("cd.m3u.recursion_limit");
  const uint32 m3u_disc_limit = MDFN_GetSettingUI("cd.m3u.disc_limit");
@@ -1116,6 +1136,8 @@ static std::unique_ptr<RMD_Layout> MDFN_LoadCD(VirtualFS* inside_vfs, const std:
  std::vector<M3U_ListEntry> file_list;
  size_t default_cd = 0;
 
+ CDAFR_SetDecodeCacheDir(MDFN_GetSettingS("cd.audio_cache_dir"));
+
  if(cdif)
  {
   file_list.emplace_back(M3U_ListEntry({ }));
@@ -1123,7 +1145,7 @@ static std::unique_ptr<RMD_Layout> MDFN_LoadCD(VirtualFS* inside_vfs, const std:
   CDInterfaces[0] = cdif;
  }
  else
-  OpenCD(image_memcache, affinity, m3u_recursion_limit, m3u_disc_limit, file_list, &default_cd, 0, inside_vfs, inside_path, nullptr);
+  OpenCD(image_memcache, image_mmap, affinity, m3u_recursion_limit, m3u_disc_limit, file_list, &default_cd, 0, inside_vfs, inside_path, nullptr);
 
  CDInterfaces.resize(file_list.size());
  for(size_t i = 0; i < file_list.size(); i++)
@@ -1631,11 +1653,11 @@ bool MDFNI_InitFinalize(const char *basedir)
         return true;
 }
 
-int MDFNI_LoadSettings(const char* path, bool override)
+int MDFNI_LoadSettings(const char* path, bool override, bool read_only)
 {
  try
  {
-  if(!Settings.Load(path, override))
+  if(!Settings.Load(path, override, read_only))
    return -1;
  }
  catch(std::exception &e)
@@ -1678,6 +1700,7 @@ bool MDFNI_SaveSettingsCompact(Stream* s)
 
 void MDFNI_Kill(void)
 {
+ MDFNSS_KillAsync();
  Settings.Kill();
  //
  //
@@ -1886,6 +1909,8 @@ void MDFNI_Emulate(EmulateSpecStruct *espec)
  multiplier_save = 1;
  volume_save = 1;
 
+ MDFNSS_PollAsync();
+
  if(!espec->CustomPalette)
  {
   espec->CustomPalette = CustomPalette;
@@ -1929,10 +1954,12 @@ void MDFNI_Emulate(EmulateSpecStruct *espec)
   espec->SoundVolume = 1;
  }
 
+ MDFNMOV_StartFrame();
+
  if(MDFNGameInfo->TransformInput)
   MDFNGameInfo->TransformInput();
 
- Netplay_Update(PortDevice, PortData, PortDataLen);
+ Netplay_Update(espec, PortDevice, PortData, PortDataLen);
 
  MDFNMOV_ProcessInput(PortData, PortDataLen, MDFNGameInfo->PortInfo.size());
 
@@ -133,10 +133,64 @@ static bool CheatsActive = true;
 bool SubCheatsOn = 0;
 std::vector<SUBCHEAT> SubCheats[8];
 
+// Replace cheats without conditions, compiled by RebuildPeriodicCheats() to
+// one entry per byte so MDFNMP_ApplyPeriodicCheats() writes them in a single
+// pass. Bytes on pages with a RAMInfo pointer are resolved to it; the rest
+// (ptr == NULL) go through CheatInfo.MemWrite.
+struct PeriodicByte
+{
+ uint8* ptr;
+ uint32 addr;
+ uint8 value;
+};
+
+static std::vector<PeriodicByte> PeriodicBytes;
+
+static INLINE bool IsCompiledPeriodic(const CHEATF& c)
+{
+ return c.status && c.type == 'R' && c.conditions.size() == 0;
+}
+
+static void RebuildPeriodicCheats(void)
+{
+ PeriodicBytes.clear();
+
+ if(!CheatsActive || !NumPages)
+  return;
+
+ for(const CHEATF& c : cheats)
+ {
+  if(!IsCompiledPeriodic(c))
+   continue;
+
+  uint32 mltpl_addr = c.addr;
+  uint64 mltpl_val = c.val;
+
+  for(uint32 mltpl_count = c.mltpl_count; mltpl_count; mltpl_count--)
+  {
+   for(unsigned int x = 0; x < c.length; x++)
+   {
+    PeriodicByte pb;
+    const uint32 addr = (c.bigendian ? (mltpl_addr + c.length - 1 - x) : (mltpl_addr + x)) % ((uint64)PageSize * NumPages);
+    uint8* const page_ptr = RAMInfo[addr / PageSize].Ptr;
+
+    pb.ptr = page_ptr ? page_ptr + (addr % PageSize) : NULL;
+    pb.addr = addr;
+    pb.value = mltpl_val >> (x * 8);
+    PeriodicBytes.push_back(pb);
+   }
+   mltpl_addr += c.mltpl_addr_inc;
+   mltpl_val += c.mltpl_val_inc;
+  }
+ }
+}
+
 static void RebuildSubCheats(void)
 {
  std::vector<CHEATF>::iterator chit;
 
+ RebuildPeriodicCheats();
+
  SubCheatsOn = 0;
  for(int x = 0; x < 8; x++)
   SubCheats[x].clear();
@@ -183,6 +237,7 @@ void MDFNMP_Init(uint32 ps, uint32 numpages)
 void MDFNMP_Kill(void)
 {
  RAMInfo.resize(0);
+ PeriodicBytes.clear();
 }
 
 void MDFNMP_AddRAM(uint32 size, uint32 A, uint8 *RAM, bool use_in_search)
@@ -201,6 +256,8 @@ void MDFNMP_AddRAM(uint32 size, uint32 A, uint8 *RAM, bool use_in_search)
   if(RAM) // Don't increment the RAM pointer if we're passed a NULL pointer
    RAM += PageSize;
  }
+
+ RebuildPeriodicCheats();
 }
 
 void MDFNMP_RegSearchable(uint32 addr, uint32 size)
@@ -725,11 +782,19 @@ void MDFNMP_ApplyPeriodicCheats(void)
  if(!CheatsActive)
   return;
 
+ for(const PeriodicByte& pb : PeriodicBytes)
+ {
+  if(pb.ptr)
+   *pb.ptr = pb.value;
+  else if(MDFNGameInfo->CheatInfo.MemWrite)
+   MDFNGameInfo->CheatInfo.MemWrite(pb.addr, pb.value);
+ }
+
  //TestConditions("2 L 0x1F00F5 == 0xDEAD");
  //if(TestConditions("1 L 0x1F0058 > 0")) //, 1 L 0xC000 == 0x01"));
  for(std::vector<CHEATF>::iterator chit = cheats.begin(); chit != cheats.end(); chit++)
  {
-  if(chit->status && (chit->type == 'R' || chit->type == 'A' || chit->type == 'T'))
+  if(chit->status && (chit->type == 'R' || chit->type == 'A' || chit->type == 'T') && !IsCompiledPeriodic(*chit))
   {
    if(chit->conditions.size() == 0 || TestConditions(chit->conditions.c_str()))
    {
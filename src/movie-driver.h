@@ -4,4 +4,12 @@ void MDFNI_SelectMovie(int);
 
 void MDFNI_SaveMovie(char *fname, const MDFN_Surface *surface, const MDFN_Rect *DisplayRect, const int32 *LineWidths);
 void MDFNI_LoadMovie(char *fname);
+
+// Frames since the active movie's starting state, and keyframes recorded or loaded(see "movie.keyframe_interval").
+uint64 MDFNI_MovieFrame(void);
+size_t MDFNI_MovieKeyframes(void);
+// During playback: restore the nearest keyframe at or before frame(or the starting state) unless playing on from
+// the current frame is shorter.  *from is the frame playback is now at; returns how many frames to emulate to reach
+// frame.  Throws on error, after stopping the movie if emulation was left at an unknown point.
+uint64 MDFNI_SeekMovie(uint64 frame, uint64* from);
 }
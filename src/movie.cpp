@@ -18,6 +18,7 @@
 #include "mednafen.h"
 
 #include <trio/trio.h>
+#include <zlib.h>
 
 #include "driver.h"
 #include "state.h"
@@ -28,6 +29,7 @@
 #include "state.h"
 
 #include "FileStream.h"
+#include "MemoryStream.h"
 
 namespace Mednafen
 {
@@ -47,6 +49,194 @@ static int CurrentMovie = 0;
 static int RecentlySavedMovie = -1;
 static int MovieStatus[10];
 
+//
+// Keyframes("movie.keyframe_interval"): while recording, a save state every N frames goes to a companion file, <movie>.mki,
+// so that playback can jump to any frame by restoring the nearest keyframe at or before it and replaying only the rest.
+// The movie file itself is unchanged, and plays back the same with or without its .mki.
+//
+// <movie>.mki: "MDFNMKF1", le32 interval, then per keyframe le64 frame(MDFNI_Emulate() calls since the movie's starting
+// state), le64 movie file offset of that frame's input, le32 flags(bit 0: the state is XORed with the previous keyframe's),
+// le32 state size, le32 zlib data size, then the zlib data.  Records are only ever appended, so the records themselves are
+// the frame->offset index; every Keyframe_FullEvery-th one is a whole state, which bounds how many deltas a seek applies.
+//
+enum : uint32 { Keyframe_FullEvery = 16 };
+enum : uint32 { Keyframe_HeaderSize = 28 };
+
+struct MovieKeyframe
+{
+ uint64 frame;
+ uint64 movie_pos;
+ uint64 data_pos;	// Of the zlib data, in the .mki file.
+ uint32 flags;
+ uint32 size;
+ uint32 zsize;
+};
+
+static std::string ActiveMoviePath;
+static uint64 MovieFrame;
+static uint32 KeyframeInterval;
+static FileStream* KeyframeStream = NULL;
+static std::vector<MovieKeyframe> Keyframes;
+static std::unique_ptr<MemoryStream> KeyframePrev;	// Recording: the last keyframe's state, for the next delta; null to write a whole one.
+
+static void Keyframes_Close(void)
+{
+ if(KeyframeStream)
+ {
+  delete KeyframeStream;
+  KeyframeStream = NULL;
+ }
+ Keyframes.clear();
+ KeyframePrev.reset();
+ KeyframeInterval = 0;
+}
+
+static void Keyframes_OpenRecord(void)
+{
+ uint8 header[12];
+
+ if(!(KeyframeInterval = MDFN_GetSettingUI("movie.keyframe_interval")))
+  return;
+
+ memcpy(header, "MDFNMKF1", 8);
+ MDFN_en32lsb(&header[8], KeyframeInterval);
+ KeyframeStream = new FileStream(ActiveMoviePath + ".mki", FileStream::MODE_WRITE);
+ KeyframeStream->write(header, sizeof(header));
+}
+
+// A missing .mki is fine; seeking then replays from the movie's starting state.
+static void Keyframes_OpenPlay(void)
+{
+ std::unique_ptr<FileStream> fs;
+ uint8 header[Keyframe_HeaderSize];
+
+ try
+ {
+  fs.reset(new FileStream(ActiveMoviePath + ".mki", FileStream::MODE_READ));
+ }
+ catch(MDFN_Error& e)
+ {
+  if(e.GetErrno() == ENOENT)
+   return;
+
+  throw;
+ }
+
+ if(fs->read(header, 12, false) != 12 || memcmp(header, "MDFNMKF1", 8))
+  throw MDFN_Error(0, _("Movie keyframe file \"%s\" is not valid."), (ActiveMoviePath + ".mki").c_str());
+
+ const uint64 fsize = fs->size();
+
+ KeyframeInterval = MDFN_de32lsb(&header[8]);
+
+ // A record cut short by a crash while recording ends the index.
+ while(fs->read(header, Keyframe_HeaderSize, false) == Keyframe_HeaderSize)
+ {
+  MovieKeyframe kf;
+
+  kf.frame = MDFN_de64lsb(&header[0]);
+  kf.movie_pos = MDFN_de64lsb(&header[8]);
+  kf.flags = MDFN_de32lsb(&header[16]);
+  kf.size = MDFN_de32lsb(&header[20]);
+  kf.zsize = MDFN_de32lsb(&header[24]);
+  kf.data_pos = fs->tell();
+
+  if(kf.data_pos + kf.zsize > fsize || (Keyframes.size() && kf.frame <= Keyframes.back().frame) || (!Keyframes.size() && (kf.flags & 1)))
+   break;
+
+  Keyframes.push_back(kf);
+  fs->seek(kf.zsize, SEEK_CUR);
+ }
+
+ KeyframeStream = fs.release();
+}
+
+static void Keyframes_Write(void)
+{
+ std::unique_ptr<MemoryStream> st(new MemoryStream(65536));
+ const bool delta = KeyframePrev && (Keyframes.size() % Keyframe_FullEvery);
+ MovieKeyframe kf;
+ uint8 header[Keyframe_HeaderSize];
+
+ MDFNSS_SaveSM(st.get());
+
+ const uint32 size = st->size();
+ std::unique_ptr<uint8[]> dbuf;
+ const uint8* src = st->map();
+
+ if(delta)
+ {
+  const uint8* prev = KeyframePrev->map();
+  const uint32 common = std::min<uint64>(size, KeyframePrev->size());
+
+  dbuf.reset(new uint8[size]);
+  for(uint32 i = 0; i < common; i++)
+   dbuf[i] = src[i] ^ prev[i];
+  memcpy(&dbuf[common], src + common, size - common);
+  src = dbuf.get();
+ }
+
+ uLongf zsize = compressBound(size);
+ std::unique_ptr<uint8[]> zbuf(new uint8[zsize]);
+
+ if(compress2(zbuf.get(), &zsize, src, size, 1) != Z_OK)
+  throw MDFN_Error(0, _("Error compressing movie keyframe."));
+
+ kf.frame = MovieFrame;
+ kf.movie_pos = ActiveMovieStream->tell();
+ kf.flags = delta;
+ kf.size = size;
+ kf.zsize = zsize;
+
+ MDFN_en64lsb(&header[0], kf.frame);
+ MDFN_en64lsb(&header[8], kf.movie_pos);
+ MDFN_en32lsb(&header[16], kf.flags);
+ MDFN_en32lsb(&header[20], kf.size);
+ MDFN_en32lsb(&header[24], kf.zsize);
+ KeyframeStream->write(header, sizeof(header));
+ kf.data_pos = KeyframeStream->tell();
+ KeyframeStream->write(zbuf.get(), zsize);
+
+ Keyframes.push_back(kf);
+ KeyframePrev = std::move(st);
+}
+
+// Rebuild the state of keyframe "which" from the whole one before it and the deltas in between.
+static void Keyframes_Load(size_t which, MemoryStream* out)
+{
+ size_t first = which;
+ std::vector<uint8> state, raw, zbuf;
+
+ while(first && (Keyframes[first].flags & 1))
+  first--;
+
+ for(size_t i = first; i <= which; i++)
+ {
+  const MovieKeyframe& kf = Keyframes[i];
+  uLongf len = kf.size;
+
+  zbuf.resize(kf.zsize);
+  raw.resize(kf.size);
+  KeyframeStream->seek(kf.data_pos, SEEK_SET);
+  KeyframeStream->read(zbuf.data(), kf.zsize);
+
+  if(uncompress(raw.data(), &len, zbuf.data(), kf.zsize) != Z_OK || len != kf.size)
+   throw MDFN_Error(0, _("Movie keyframe at frame %llu is corrupt."), (unsigned long long)kf.frame);
+
+  if(kf.flags & 1)
+  {
+   const size_t common = std::min(raw.size(), state.size());
+
+   for(size_t j = 0; j < common; j++)
+    raw[j] ^= state[j];
+  }
+  state.swap(raw);
+ }
+
+ out->write(state.data(), state.size());
+ out->rewind();
+}
+
 static void HandleMovieError(const std::exception &e)
 {
  if(ActiveMovieStream)
@@ -54,6 +244,7 @@ static void HandleMovieError(const std::exception &e)
   delete ActiveMovieStream;
   ActiveMovieStream = NULL;
  }
+ Keyframes_Close();
 
  if(ActiveSlotNumber >= 0)
  {
@@ -70,6 +261,18 @@ static void HandleMovieError(const std::exception &e)
  ActiveSlotNumber = -1;
 }
 
+//
+// Serializes into memory first, so the movie file gets one sequential write instead of many small writes and
+// the reverse seeks the save state code does to fill in section sizes.
+//
+static void WriteMovieState(const MDFN_Surface *surface = nullptr, const MDFN_Rect *DisplayRect = nullptr, const int32 *LineWidths = nullptr)
+{
+ MemoryStream st(65536);
+
+ MDFNSS_SaveSM(&st, false, surface, DisplayRect, LineWidths);
+ ActiveMovieStream->write(st.map(), st.size());
+}
+
 bool MDFNMOV_IsPlaying(void) noexcept
 {
  return(ActiveMovieMode == MOVIE_PLAYING);
@@ -107,13 +310,16 @@ void MDFNI_SaveMovie(char *fname, const MDFN_Surface *surface, const MDFN_Rect *
 
   ActiveMovieMode = MOVIE_RECORDING;
   ActiveSlotNumber = fname ? -1 : CurrentMovie;
+  ActiveMoviePath = fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_MOVIE, CurrentMovie, 0);
+  MovieFrame = 0;
 
-  ActiveMovieStream = new FileStream(fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_MOVIE, CurrentMovie, 0), FileStream::MODE_WRITE);
+  ActiveMovieStream = new FileStream(ActiveMoviePath, FileStream::MODE_WRITE);
+  Keyframes_OpenRecord();
 
   //
   // Save save state first.
   //
-  MDFNSS_SaveSM(ActiveMovieStream, false, surface, DisplayRect, LineWidths);
+  WriteMovieState(surface, DisplayRect, LineWidths);
   ActiveMovieStream->flush(); 	    // Flush output so that previews will still work right while
 			    	    // the movie is being recorded.
 
@@ -145,6 +351,7 @@ void MDFNMOV_Stop(void) noexcept
    delete ActiveMovieStream;
    ActiveMovieStream = NULL;
   }
+  Keyframes_Close();
 
   ActiveMovieMode = MOVIE_STOPPED;
   ActiveSlotNumber = -1;
@@ -191,12 +398,15 @@ void MDFNI_LoadMovie(char *fname)
    MovieStatus[CurrentMovie] = 1;
   }
 
-  ActiveMovieStream = new FileStream(fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_MOVIE, CurrentMovie, 0), FileStream::MODE_READ);
+  ActiveMoviePath = fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_MOVIE, CurrentMovie, 0);
+  MovieFrame = 0;
+  ActiveMovieStream = new FileStream(ActiveMoviePath, FileStream::MODE_READ);
 
   //
   //
   //
   MDFNSS_LoadSM(ActiveMovieStream, false);
+  Keyframes_OpenPlay();
 
   MDFN_Notify(MDFN_NOTICE_STATUS, _("Movie playback started."));
  }
@@ -206,6 +416,79 @@ void MDFNI_LoadMovie(char *fname)
  }
 }
 
+void MDFNMOV_StartFrame(void) noexcept
+{
+ if(ActiveMovieMode == MOVIE_STOPPED)
+  return;
+
+ try
+ {
+  if(ActiveMovieMode == MOVIE_RECORDING && KeyframeStream && MovieFrame && !(MovieFrame % KeyframeInterval))
+   Keyframes_Write();
+ }
+ catch(std::exception &e)
+ {
+  HandleMovieError(e);
+  return;
+ }
+
+ MovieFrame++;
+}
+
+uint64 MDFNI_SeekMovie(uint64 frame, uint64* from)
+{
+ if(ActiveMovieMode != MOVIE_PLAYING)
+  throw MDFN_Error(0, _("No movie is playing."));
+
+ size_t k = std::upper_bound(Keyframes.begin(), Keyframes.end(), frame, [](uint64 f, const MovieKeyframe& kf) { return f < kf.frame; }) - Keyframes.begin();
+ const bool have_kf = (k != 0);
+ const uint64 kf_frame = have_kf ? Keyframes[k - 1].frame : 0;
+
+ // Already at or past the nearest keyframe, and before the target: just keep playing.
+ if(frame >= MovieFrame && MovieFrame >= kf_frame)
+ {
+  *from = MovieFrame;
+  return frame - MovieFrame;
+ }
+
+ try
+ {
+  if(have_kf)
+  {
+   MemoryStream st(Keyframes[k - 1].size);
+
+   Keyframes_Load(k - 1, &st);
+   MDFNSS_LoadSM(&st, false);
+   ActiveMovieStream->seek(Keyframes[k - 1].movie_pos, SEEK_SET);
+  }
+  else
+  {
+   ActiveMovieStream->seek(0, SEEK_SET);
+   MDFNSS_LoadSM(ActiveMovieStream, false);
+  }
+ }
+ catch(std::exception &e)
+ {
+  // Emulation and the movie position no longer agree.
+  HandleMovieError(e);
+  throw;
+ }
+
+ MovieFrame = kf_frame;
+ *from = kf_frame;
+ return frame - kf_frame;
+}
+
+uint64 MDFNI_MovieFrame(void)
+{
+ return MovieFrame;
+}
+
+size_t MDFNI_MovieKeyframes(void)
+{
+ return Keyframes.size();
+}
+
 void MDFNMOV_ProcessInput(uint8 *PortData[], uint32 PortLen[], int NumPorts) noexcept
 {
  try
@@ -284,7 +567,7 @@ void MDFNMOV_RecordState(void) noexcept
  try
  {
   ActiveMovieStream->put_u8(MDFNNPCMD_LOADSTATE);
-  MDFNSS_SaveSM(ActiveMovieStream, false);
+  WriteMovieState();
  }
  catch(std::exception &e)
  {
@@ -301,6 +584,7 @@ void MDFNMOV_StateAction(StateMem* sm, const unsigned load)
  SFORMAT StateRegs[] =
  {
   SFVAR(fpos),
+  SFVAR(MovieFrame),
   SFEND
  };
 
@@ -311,7 +595,22 @@ void MDFNMOV_StateAction(StateMem* sm, const unsigned load)
   ActiveMovieStream->seek(fpos, SEEK_SET);
 
   if(ActiveMovieMode == MOVIE_RECORDING)
+  {
    ActiveMovieStream->truncate(fpos);
+
+   // Keyframes past the rewound-to frame are recorded again as it's replayed; the next one is written whole.
+   if(KeyframeStream && Keyframes.size() && Keyframes.back().frame >= MovieFrame)
+   {
+    while(Keyframes.size() && Keyframes.back().frame >= MovieFrame)
+     Keyframes.pop_back();
+
+    const uint64 end = Keyframes.size() ? Keyframes.back().data_pos + Keyframes.back().zsize : 12;
+
+    KeyframeStream->truncate(end);
+    KeyframeStream->seek(end, SEEK_SET);
+    KeyframePrev.reset();
+   }
+  }
  }
 }
 
@@ -11,6 +11,7 @@ class MemoryStream;
 
 namespace Mednafen
 {
+void MDFNMOV_StartFrame(void) noexcept;	// Once per MDFNI_Emulate(), before any MDFNMOV_ProcessInput() for it.
 void MDFNMOV_ProcessInput(uint8 *PortData[], uint32 PortLen[], int NumPorts) noexcept;
 void MDFNMOV_Stop(void) noexcept;
 void MDFNMOV_AddCommand(uint8 cmd, uint32 data_len = 0, uint8* data = NULL) noexcept;
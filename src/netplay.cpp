@@ -61,6 +61,53 @@ static bool StateLoaded;	// Set to true/false in Netplay_Update() call paths, us
 static std::unique_ptr<uint8[]> incoming_buffer;	// TotalInputStateSize + 1
 static std::unique_ptr<uint8[]> outgoing_buffer;	// 1 + LocalInputStateSize + 4
 
+//
+// Rollback("netplay.rollback" > 0, while we control a port).  In lockstep, each frame waits for the server's combined
+// input for it, a round trip per frame.  With rollback, the frame is emulated right away with the remote ports
+// predicted to hold their last confirmed input, and a data-only snapshot of the state before each frame that isn't
+// confirmed yet is kept.  When the combined input for a frame arrives and differs from what it was emulated with,
+// the state is restored from that frame's snapshot and every frame since is emulated again, without video or sound
+// output, before the current one.  The server is unchanged: it still gets one input packet per frame from us, only
+// up to "window" frames ahead of the confirmed ones.
+//
+struct RBFrame
+{
+ std::unique_ptr<MemoryStream> state;	// Before this frame was emulated.
+ std::vector<uint8> input;		// Combined input(TotalInputStateSize) it was last emulated with.
+ bool confirmed = false;
+};
+
+static struct
+{
+ bool active = false;
+ uint32 window = 0;		// netplay.rollback
+ std::vector<RBFrame> ring;	// window + 1 entries, for frame % ring.size()
+ uint64 frame = 0;		// Frame about to be emulated, counted from when rollback started.
+ uint64 confirmed = 0;		// Frames before this have their combined input.
+ std::vector<uint8> last_input;	// Last confirmed combined input; the prediction for remote ports.
+ std::vector<uint8> next_input;	// This frame's.
+ bool next_confirmed = false;
+
+ uint64 rollbacks = 0;		// Statistics, for /rollback.
+ uint64 resim_frames = 0;
+ uint32 max_ahead = 0;
+} RB;
+
+//
+// Delta state sync("netplay.delta_state").  Every client that took the last MDFNNPCMD_LOADSTATE from the server's
+// stream holds the same state, kept here as SyncBase.  While nobody has connected since then, a new state is sent as
+// only the 4 KiB pages that differ from it, found by comparing page by page(see snap_save in automation.cpp for why
+// not write tracking), so a resync costs roughly what changed since the last one rather than the whole state.
+//
+// Payload: le32 0x80000000 | state size, 16 bytes MD5 of the base, le32 page count, then zlib of the le32 page
+// indices followed by the pages.  A full state is the plain le32 size + zlib data as before.
+//
+enum : uint32 { SyncPageSize = 4096, SyncDeltaFlag = 0x80000000U };
+
+static std::vector<uint8> SyncBase, SyncPrevBase;	// SyncPrevBase: in case the server echoes our own delta back.
+static uint8 SyncBaseMD5[16], SyncPrevBaseMD5[16];
+static bool SyncBaseShared = false;	// Everyone connected holds SyncBase.
+
 static void RebuildPortVtoVMap(const uint32 PortDevIdx[])
 {
  const unsigned NumPorts = MDFNGameInfo->PortInfo.size();
@@ -313,6 +360,15 @@ static void NetplayStart(const uint32 PortDeviceCache[16], const uint32 PortData
  SetLPM(0, PortDeviceCache, PortDataLenCache);
  Joined = false;
 
+ RB.active = false;
+ RB.ring.clear();
+ RB.window = MDFN_GetSettingUI("netplay.rollback");
+
+ SyncBase.clear();
+ SyncPrevBase.clear();
+ SyncBaseShared = false;
+ RB.rollbacks = RB.resim_frames = RB.max_ahead = 0;
+
  //
  //
  //
@@ -555,6 +611,20 @@ static int SendIntegrity(void)
 }
 
 
+static void SetSyncBase(const uint8* data, const uint32 size)
+{
+ md5_context md5;
+
+ SyncPrevBase.swap(SyncBase);
+ memcpy(SyncPrevBaseMD5, SyncBaseMD5, 16);
+
+ SyncBase.assign(data, data + size);
+ md5.starts();
+ md5.update(data, size);
+ md5.finish(SyncBaseMD5);
+ SyncBaseShared = true;
+}
+
 static void SendState(void)
 {
  std::vector<uint8> cbuf;
@@ -565,10 +635,45 @@ static void SendState(void)
 
   MDFNSS_SaveSM(&sm, false);
 
-  clen = sm.size() + sm.size() / 1000 + 12;
-  cbuf.resize(4 + clen);
-  MDFN_en32lsb(&cbuf[0], sm.size());
-  compress2((Bytef *)&cbuf[0] + 4, &clen, (Bytef *)sm.map(), sm.size(), 7);
+  if(SyncBaseShared && SyncBase.size() == sm.size() && MDFN_GetSettingB("netplay.delta_state"))
+  {
+   std::vector<uint8> pages;
+   std::vector<uint32> index;
+
+   for(uint32 offs = 0; offs < sm.size(); offs += SyncPageSize)
+   {
+    const uint32 n = std::min<uint32>(SyncPageSize, sm.size() - offs);
+
+    if(memcmp(sm.map() + offs, &SyncBase[offs], n))
+    {
+     index.push_back(offs / SyncPageSize);
+     pages.insert(pages.end(), sm.map() + offs, sm.map() + offs + n);
+    }
+   }
+
+   std::vector<uint8> raw(index.size() * 4);
+
+   for(size_t i = 0; i < index.size(); i++)
+    MDFN_en32lsb(&raw[i * 4], index[i]);
+   raw.insert(raw.end(), pages.begin(), pages.end());
+
+   clen = raw.size() + raw.size() / 1000 + 12;
+   cbuf.resize(4 + 16 + 4 + clen);
+   MDFN_en32lsb(&cbuf[0], SyncDeltaFlag | sm.size());
+   memcpy(&cbuf[4], SyncBaseMD5, 16);
+   MDFN_en32lsb(&cbuf[20], index.size());
+   compress2((Bytef *)&cbuf[24], &clen, (Bytef *)raw.data(), raw.size(), 7);
+   clen += 16 + 4;
+  }
+  else
+  {
+   clen = sm.size() + sm.size() / 1000 + 12;
+   cbuf.resize(4 + clen);
+   MDFN_en32lsb(&cbuf[0], sm.size());
+   compress2((Bytef *)&cbuf[0] + 4, &clen, (Bytef *)sm.map(), sm.size(), 7);
+  }
+
+  SetSyncBase(sm.map(), sm.size());
  }
 
  SendCommand(MDFNNPCMD_LOADSTATE, clen + 4, &cbuf[0]);
@@ -592,7 +697,8 @@ static void RecvState(const uint32 clen)
 
  RecvData(&cbuf[0], clen);
 
- uLongf len = MDFN_de32lsb(&cbuf[0]);
+ const bool delta = MDFN_de32lsb(&cbuf[0]) & SyncDeltaFlag;
+ uLongf len = MDFN_de32lsb(&cbuf[0]) &~ SyncDeltaFlag;
  if(len > 12 * 1024 * 1024) // Uncompressed length sanity check - 12 MiB max.
  {
   throw MDFN_Error(0, _("Uncompressed save state data is too large: %llu"), (unsigned long long)len);
@@ -600,7 +706,56 @@ static void RecvState(const uint32 clen)
 
  MemoryStream sm(len, -1);
 
- uncompress((Bytef *)sm.map(), &len, (Bytef *)&cbuf[0] + 4, clen - 4);
+ if(delta)
+ {
+  if(clen < 4 + 16 + 4)
+   throw MDFN_Error(0, _("Delta save state data is too small: %u"), clen);
+
+  const std::vector<uint8>* base;
+
+  if(SyncBase.size() == len && !memcmp(&cbuf[4], SyncBaseMD5, 16))
+   base = &SyncBase;
+  else if(SyncPrevBase.size() == len && !memcmp(&cbuf[4], SyncPrevBaseMD5, 16))
+   base = &SyncPrevBase;
+  else
+   throw MDFN_Error(0, _("Received a delta save state against a base state we don't hold."));
+
+  const uint32 count = MDFN_de32lsb(&cbuf[20]);
+  const uint32 total_pages = (len + SyncPageSize - 1) / SyncPageSize;
+
+  if(count > total_pages)
+   throw MDFN_Error(0, _("Delta save state page count is too large: %u"), count);
+
+  std::vector<uint8> raw(count * (4 + SyncPageSize));
+  uLongf raw_len = raw.size();
+
+  if(uncompress((Bytef *)raw.data(), &raw_len, (Bytef *)&cbuf[24], clen - 24) != Z_OK || raw_len < count * 4)
+   throw MDFN_Error(0, _("Error decompressing delta save state data."));
+
+  memcpy(sm.map(), base->data(), len);
+
+  uint32 rpos = count * 4;
+  for(uint32 i = 0; i < count; i++)
+  {
+   const uint32 pg = MDFN_de32lsb(&raw[i * 4]);
+
+   if(pg >= total_pages)
+    throw MDFN_Error(0, _("Delta save state page index is out of range: %u"), pg);
+
+   const uint32 offs = pg * SyncPageSize;
+   const uint32 n = std::min<uint32>(SyncPageSize, len - offs);
+
+   if(rpos + n > raw_len)
+    throw MDFN_Error(0, _("Delta save state data is truncated."));
+
+   memcpy(sm.map() + offs, &raw[rpos], n);
+   rpos += n;
+  }
+ }
+ else
+  uncompress((Bytef *)sm.map(), &len, (Bytef *)&cbuf[0] + 4, clen - 4);
+
+ SetSyncBase(sm.map(), sm.size());
 
  MDFNSS_LoadSM(&sm, false);
 
@@ -962,6 +1117,7 @@ static void ProcessCommand(const uint8 cmd, const uint32 raw_len, const uint32 P
 			 else
 			 {
                                   trio_asprintf(&textbuf, _("* %s has connected as: %s"), neobuf + 8, mps_string.c_str());
+				  SyncBaseShared = false;	// They haven't got our base state.
 			 }
 
 	                 MDFND_NetplayText(textbuf, false);
@@ -1023,7 +1179,225 @@ static void ProcessCommand(const uint8 cmd, const uint32 raw_len, const uint32 P
     }
 #endif
 
-void Netplay_Update(const uint32 PortDevIdx[], uint8* const PortData[], const uint32 PortLen[])
+static INLINE RBFrame& RB_At(const uint64 frame)
+{
+ return RB.ring[frame % RB.ring.size()];
+}
+
+static void RB_Save(const uint64 frame)
+{
+ MemoryStream* st = RB_At(frame).state.get();
+
+ st->truncate(0);
+ st->seek(0, SEEK_SET);
+ MDFNSS_SaveSM(st, true);
+}
+
+static void RB_Load(const uint64 frame)
+{
+ MemoryStream* st = RB_At(frame).state.get();
+
+ st->seek(0, SEEK_SET);
+ MDFNSS_LoadSM(st, true);
+}
+
+static void RB_Start(void)
+{
+ RB.ring.resize(RB.window + 1);
+ for(RBFrame& rf : RB.ring)
+ {
+  rf.state.reset(new MemoryStream(65536));
+  rf.input.assign(TotalInputStateSize, 0);
+  rf.confirmed = false;
+ }
+ // Until the first confirmed input arrives, predict the last one lockstep received.
+ RB.last_input.assign(&incoming_buffer[0], &incoming_buffer[0] + TotalInputStateSize);
+ RB.next_input.assign(TotalInputStateSize, 0);
+ RB.frame = 0;
+ RB.confirmed = 0;
+ RB.active = true;
+}
+
+// Fill in the ports we don't control from the last confirmed input.
+static void RB_Predict(uint8* input, const uint32 PortLen[], const unsigned NumPorts)
+{
+ for(unsigned x = 0, pos = 0; x < NumPorts; pos += PortLen[x], x++)
+ {
+  if(PortVtoLVMap[x] == 0xFF)
+   memcpy(input + pos, &RB.last_input[pos], PortLen[x]);
+ }
+}
+
+static void RB_SetPortData(const uint8* input, uint8* const PortData[], const uint32 PortLen[], const unsigned NumPorts)
+{
+ for(unsigned x = 0, rpos = 0; x < NumPorts; x++)
+ {
+  memcpy(PortData[x], input + rpos, PortLen[x]);
+  rpos += PortLen[x];
+ }
+}
+
+// Commands that read or change emulation state; they apply at the confirmed point, as they would in lockstep.
+static bool RB_CommandNeedsState(const uint8 cmd)
+{
+ switch(cmd)
+ {
+  case MDFNNPCMD_SERVERTEXT:
+  case MDFNNPCMD_ECHO:
+  case MDFNNPCMD_TEXT:
+  case MDFNNPCMD_NICKCHANGED:
+  case MDFNNPCMD_CTRL_CHANGE:
+  case MDFNNPCMD_CTRLR_SWAP_NOTIF:
+  case MDFNNPCMD_CTRLR_TAKE_NOTIF:
+  case MDFNNPCMD_CTRLR_DROP_NOTIF:
+  case MDFNNPCMD_CTRLR_DUPE_NOTIF:
+  case MDFNNPCMD_YOUJOINED:
+  case MDFNNPCMD_YOULEFT:
+  case MDFNNPCMD_PLAYERLEFT:
+  case MDFNNPCMD_PLAYERJOINED:
+	return false;
+
+  default:
+	return true;
+ }
+}
+
+static void RB_EmulateHidden(EmulateSpecStruct* espec)
+{
+ EmulateSpecStruct es = *espec;
+
+ es.skip = true;
+ es.SoundBufSize = 0;	// Overwritten by the real frame's samples afterwards.
+
+ MDFNGameInfo->Emulate(&es);
+}
+
+//
+// Returns false, with the emulator restored to the confirmed point, if we stopped controlling any port; the caller
+// then goes on in lockstep.
+//
+static bool RB_Update(EmulateSpecStruct* espec, const uint32 PortDevIdx[], uint8* const PortData[], const uint32 PortLen[], const unsigned NumPorts)
+{
+ if(!RB.active)
+  RB_Start();
+
+ uint64 resim_from = RB.frame;
+
+ // Our part of this frame's input, taken before PortData is overwritten by re-emulated frames.
+ for(unsigned x = 0, pos = 0; x < NumPorts; pos += PortLen[x], x++)
+ {
+  const unsigned n = PortVtoLVMap[x];
+
+  if(n != 0xFF)
+   memcpy(&RB.next_input[pos], PortData[n], PortLen[x]);
+ }
+ RB.next_confirmed = false;
+
+ //
+ // Take in what the server has sent, waiting while "window" frames are already ahead of the confirmed ones.
+ //
+ while(Connection->CanReceive() || (RB.frame - RB.confirmed) > RB.window)
+ {
+  RecvData(&incoming_buffer[0], TotalInputStateSize + 1);
+
+  const uint8 cmd = incoming_buffer[TotalInputStateSize];
+
+  if(cmd != 0)
+  {
+   const bool needs_state = RB_CommandNeedsState(cmd);
+   const bool behind = RB.confirmed < RB.frame;
+
+   if(needs_state && behind)
+    RB_Load(RB.confirmed);
+
+   ProcessCommand(cmd, MDFN_de32lsb(&incoming_buffer[0]), PortDevIdx, PortData, PortLen, NumPorts);
+
+   if(!Joined)
+   {
+    if(behind && !needs_state)
+     RB_Load(RB.confirmed);
+
+    RB.active = false;
+    RB.ring.clear();
+    return false;
+   }
+
+   if(needs_state && behind)
+   {
+    RB_Save(RB.confirmed);
+    resim_from = std::min<uint64>(resim_from, RB.confirmed);
+   }
+   continue;
+  }
+
+  if(RB.confirmed < RB.frame)
+  {
+   RBFrame& rf = RB_At(RB.confirmed);
+
+   if(memcmp(rf.input.data(), &incoming_buffer[0], TotalInputStateSize))
+    resim_from = std::min<uint64>(resim_from, RB.confirmed);
+
+   memcpy(rf.input.data(), &incoming_buffer[0], TotalInputStateSize);
+   rf.confirmed = true;
+  }
+  else if(RB.confirmed == RB.frame)
+  {
+   memcpy(RB.next_input.data(), &incoming_buffer[0], TotalInputStateSize);
+   RB.next_confirmed = true;
+  }
+  else
+   throw MDFN_Error(0, _("Server sent input for a frame we haven't sent input for."));
+
+  memcpy(RB.last_input.data(), &incoming_buffer[0], TotalInputStateSize);
+  RB.confirmed++;
+ }
+
+ //
+ // Emulate again from the first frame that was mispredicted, or whose starting state a command changed.
+ //
+ if(resim_from < RB.frame)
+ {
+  RB_Load(resim_from);
+
+  for(uint64 f = resim_from; f < RB.frame; f++)
+  {
+   RBFrame& rf = RB_At(f);
+
+   if(f != resim_from)
+    RB_Save(f);
+
+   if(!rf.confirmed)
+    RB_Predict(rf.input.data(), PortLen, NumPorts);
+
+   RB_SetPortData(rf.input.data(), PortData, PortLen, NumPorts);
+   RB_EmulateHidden(espec);
+  }
+  RB.rollbacks++;
+  RB.resim_frames += RB.frame - resim_from;
+ }
+
+ //
+ // This frame; MDFNI_Emulate() emulates it when we return.
+ //
+ {
+  RBFrame& rf = RB_At(RB.frame);
+
+  if(!RB.next_confirmed)
+   RB_Predict(RB.next_input.data(), PortLen, NumPorts);
+
+  rf.input = RB.next_input;
+  rf.confirmed = RB.next_confirmed;
+  RB_Save(RB.frame);
+  RB_SetPortData(rf.input.data(), PortData, PortLen, NumPorts);
+
+  RB.max_ahead = std::max<uint32>(RB.max_ahead, RB.frame - RB.confirmed);
+  RB.frame++;
+ }
+
+ return true;
+}
+
+void Netplay_Update(EmulateSpecStruct* espec, const uint32 PortDevIdx[], uint8* const PortData[], const uint32 PortLen[])
 {
  const unsigned NumPorts = MDFNGameInfo->PortInfo.size();
 
@@ -1077,6 +1451,9 @@ void Netplay_Update(const uint32 PortDevIdx[], uint8* const PortData[], const ui
     }
    }
    SendData(&outgoing_buffer[0], 1 + LocalInputStateSize);
+
+   if(RB.window && RB_Update(espec, PortDevIdx, PortData, PortLen, NumPorts))
+    return;
   }
   //
   //
@@ -1183,6 +1560,8 @@ static bool CC_dupe(const char *arg);
 static bool CC_drop(const char *arg);
 static bool CC_take(const char *arg);
 static bool CC_list(const char *arg);
+static bool CC_rollback(const char *arg);
+static bool CC_resync(const char *arg);
 
 static CommandEntry ConsoleCommands[]   =
 {
@@ -1208,6 +1587,10 @@ static CommandEntry ConsoleCommands[]   =
 
  { "/ping", CC_ping,		"", "Pings the server." },
 
+ { "/resync", CC_resync,	"", gettext_noop("Sends your emulation state to everyone, only the parts changed since the last sync when possible.") },
+
+ { "/rollback", CC_rollback,	"", gettext_noop("Shows rollback netplay statistics.") },
+
  //{ "/integrity", CC_integrity,	"", "Starts netplay integrity check sequence." },
 
  { NULL, NULL },
@@ -1228,6 +1611,8 @@ void MDFNI_NetplayDisconnect(void)
   PlayersList.clear();
   incoming_buffer.reset(nullptr);
   outgoing_buffer.reset(nullptr);
+  RB.active = false;
+  RB.ring.clear();
 
   NetPrintText(_("*** Disconnected"));
  }
@@ -1493,6 +1878,37 @@ static bool CC_ping(const char *arg)
  return(false);
 }
 
+static bool CC_resync(const char *arg)
+{
+ if(!MDFNnetplay)
+ {
+  NetPrintText(_("*** Not connected!"));
+  return(true);
+ }
+
+ NetplaySendState();
+
+ return(true);
+}
+
+static bool CC_rollback(const char *arg)
+{
+ if(!MDFNnetplay)
+ {
+  NetPrintText(_("*** Not connected!"));
+  return(true);
+ }
+
+ if(!RB.window)
+  NetPrintText(_("*** Rollback is off(netplay.rollback is 0)."));
+ else if(!RB.active)
+  NetPrintText(_("*** Rollback window %u; inactive(no controller taken)."), RB.window);
+ else
+  NetPrintText(_("*** Rollback window %u; %u frame(s) ahead, %u max; %llu rollback(s), %llu frame(s) re-emulated."), RB.window, (unsigned)(RB.frame - RB.confirmed), RB.max_ahead, (unsigned long long)RB.rollbacks, (unsigned long long)RB.resim_frames);
+
+ return(true);
+}
+
 #if 0
 static bool CC_integrity(const char *arg)
 {
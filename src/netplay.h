@@ -4,7 +4,7 @@
 namespace Mednafen
 {
 
-void Netplay_Update(const uint32 PortDeviceCache[], uint8* const PortData[], const uint32 PortLen[]);
+void Netplay_Update(EmulateSpecStruct* espec, const uint32 PortDeviceCache[], uint8* const PortData[], const uint32 PortLen[]);	// espec: for re-emulating frames with netplay.rollback
 void Netplay_PostProcess(const uint32 PortDevIdx[], uint8* const PortData[], const uint32 PortLen[]);
 
 void NetplaySendState(void);
@@ -2059,7 +2059,7 @@ static MDFN_COLD void Load(GameFile* gf)
 
    static std::vector<CDInterface*> CDInterfaces;
    CDInterfaces.clear();
-   CDInterfaces.push_back(CDInterface::Open(&NVFS, MDFN_GetSettingS("psx.dbg_exe_cdpath"), false, MDFN_GetSettingUI("affinity.cd")));
+   CDInterfaces.push_back(CDInterface::Open(&NVFS, MDFN_GetSettingS("psx.dbg_exe_cdpath"), false, false, MDFN_GetSettingUI("affinity.cd")));
    InitCommon(&CDInterfaces, IsPSF, true);
   }
   else
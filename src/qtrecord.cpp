@@ -27,6 +27,16 @@
 
 #include <zlib.h>
 
+#if !defined(WIN32) && defined(HAVE_PTHREAD_H)
+ #include <pthread.h>
+ #include <signal.h>
+#endif
+
+#ifdef WIN32
+ #define popen _popen
+ #define pclose _pclose
+#endif
+
 namespace Mednafen
 {
 
@@ -187,7 +197,8 @@ void QTRecord::atom_end(void)
  qtfile.seek(cur_offset, SEEK_SET);
 }
 
-QTRecord::QTRecord(const std::string& path, const VideoSpec &spec) : qtfile(path, FileStream::MODE_WRITE_SAFE), resampler(NULL)
+QTRecord::QTRecord(const std::string& path, const VideoSpec &spec) : qtfile(path, FileStream::MODE_WRITE_SAFE), resampler(NULL), PipeFP(NULL), WAVDataBytes(0),
+	EncMutex(NULL), EncJobsSem(NULL), EncSlotsSem(NULL), EncThread(NULL), EncFailed(false)
 {
  Finished = false;
 
@@ -242,20 +253,25 @@ QTRecord::QTRecord(const std::string& path, const VideoSpec &spec) : qtfile(path
 
  VideoCodec = spec.VideoCodec;
 
+ if(spec.PipeCommand && spec.PipeCommand[0])
+  VideoCodec = VCODEC_PIPE;
+
  if(VideoCodec == VCODEC_PNG)
-  RawVideoBuffer.resize((1 + QTVideoWidth * 3) * QTVideoHeight);
+  RawVideoSize = (1 + QTVideoWidth * 3) * QTVideoHeight;
  else if(VideoCodec == VCODEC_CSCD)
-  RawVideoBuffer.resize(((QTVideoWidth * 3 + 3) &~ 3) * QTVideoHeight);
+  RawVideoSize = ((QTVideoWidth * 3 + 3) &~ 3) * QTVideoHeight;
  else
-  RawVideoBuffer.resize(QTVideoWidth * 3 * QTVideoHeight);
+  RawVideoSize = QTVideoWidth * 3 * QTVideoHeight;
 
  if(VideoCodec == VCODEC_CSCD)
  {
   lzo1x_1_workmem.reset(new uint8[LZO1X_1_MEM_COMPRESS]);
-  CompressedVideoBuffer.resize((RawVideoBuffer.size() * 110 + 99 ) / 100);	// 1.10
+  CompressedVideoBuffer.resize((RawVideoSize * 110 + 99 ) / 100);	// 1.10
  }
  else if(VideoCodec == VCODEC_PNG)
-  CompressedVideoBuffer.resize(compressBound(RawVideoBuffer.size()));
+  CompressedVideoBuffer.resize(compressBound(RawVideoSize));
+ else if(VideoCodec == VCODEC_PIPE)
+  CompressedVideoBuffer.resize(RawVideoSize);
 
  {
   uint32 appley_time = Time::EpochTime() + 2082844800;
@@ -264,9 +280,174 @@ QTRecord::QTRecord(const std::string& path, const VideoSpec &spec) : qtfile(path
   ModificationTS = appley_time;
  }
 
- Write_ftyp();
+ if(VideoCodec == VCODEC_PIPE)
+ {
+  char y4m_header[128];
+
+  WriteWAVHeader(0);
+
+  if(!(PipeFP = popen(spec.PipeCommand, "w")))
+  {
+   ErrnoHolder ene(errno);
+
+   throw MDFN_Error(ene.Errno(), _("Error running recording pipe command \"%s\": %s"), spec.PipeCommand, ene.StrError());
+  }
+
+  snprintf(y4m_header, sizeof(y4m_header), "YUV4MPEG2 W%u H%u F%u:%u Ip A%u:%u C444\n", QTVideoWidth, QTVideoHeight, spec.FPS ? spec.FPS : (60U << 24), 1U << 24, A, D);
+
+  if(fputs(y4m_header, PipeFP) == EOF)
+  {
+   pclose(PipeFP);
+   PipeFP = NULL;
+   throw MDFN_Error(0, _("Error writing to recording pipe."));
+  }
+ }
+ else
+ {
+  Write_ftyp();
+
+  atom_begin("mdat", false);
+ }
+ //
+ // Last, so nothing above needs to tear the encoder thread down when it throws.
+ //
+ for(unsigned i = 0; i < Max_Queue; i++)
+ {
+  Jobs.emplace_back(new Job);
+  Jobs.back()->video.resize(RawVideoSize);
+  FreeJobs.push_back(Jobs.back().get());
+ }
+
+ EncMutex = MThreading::Mutex_Create();
+ EncJobsSem = MThreading::Sem_Create();
+ EncSlotsSem = MThreading::Sem_Create();
+
+ for(unsigned i = 0; i < Max_Queue; i++)
+  MThreading::Sem_Post(EncSlotsSem);
+
+ EncThread = MThreading::Thread_Create(EncodeThreadEntry, this, "MDFN QTRecord Encoder");
+}
+
+void QTRecord::WriteWAVHeader(uint32 data_bytes)
+{
+ const uint32 rate = (SoundRate && SoundChan) ? SoundRate : 48000;
+ const uint32 chan = (SoundRate && SoundChan) ? SoundChan : 1;
+ uint8 header[44];
+
+ memcpy(&header[0], "RIFF", 4);
+ MDFN_en32lsb(&header[4], 36 + data_bytes);
+ memcpy(&header[8], "WAVEfmt ", 8);
+ MDFN_en32lsb(&header[16], 16);
+ MDFN_en16lsb(&header[20], 1);			// PCM
+ MDFN_en16lsb(&header[22], chan);
+ MDFN_en32lsb(&header[24], rate);
+ MDFN_en32lsb(&header[28], rate * chan * sizeof(int16));
+ MDFN_en16lsb(&header[32], chan * sizeof(int16));
+ MDFN_en16lsb(&header[34], 16);
+ memcpy(&header[36], "data", 4);
+ MDFN_en32lsb(&header[40], data_bytes);
+
+ qtfile.seek(0, SEEK_SET);
+ qtfile.write(header, sizeof(header));
+}
+
+// BT.601 limited range, planar 4:4:4.
+void QTRecord::WriteY4MFrame(const uint8* rgb)
+{
+ static const char frame_header[] = "FRAME\n";
+ const size_t plane_size = (size_t)QTVideoWidth * QTVideoHeight;
+ uint8* yp = &CompressedVideoBuffer[0];
+ uint8* up = yp + plane_size;
+ uint8* vp = up + plane_size;
+
+ for(size_t i = 0; i < plane_size; i++)
+ {
+  const int r = rgb[i * 3 + 0];
+  const int g = rgb[i * 3 + 1];
+  const int b = rgb[i * 3 + 2];
+
+  yp[i] = ((  66 * r + 129 * g +  25 * b + 128) >> 8) +  16;
+  up[i] = (( -38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+  vp[i] = (( 112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+ }
+
+ if(fwrite(frame_header, 1, sizeof(frame_header) - 1, PipeFP) != (sizeof(frame_header) - 1) || fwrite(yp, 1, plane_size * 3, PipeFP) != plane_size * 3)
+ {
+  ErrnoHolder ene(errno);
+
+  throw MDFN_Error(ene.Errno(), _("Error writing to recording pipe: %s"), ene.StrError());
+ }
+}
+
+int QTRecord::EncodeThreadEntry(void* data)
+{
+#if !defined(WIN32) && defined(HAVE_PTHREAD_H)
+ // A dead encoder process should fail the write with EPIPE, not kill the emulator.
+ {
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+ }
+#endif
+ ((QTRecord*)data)->EncodeLoop();
 
- atom_begin("mdat", false);
+ return 0;
+}
+
+void QTRecord::EncodeLoop(void)
+{
+ for(;;)
+ {
+  Job* job;
+
+  MThreading::Sem_Wait(EncJobsSem);
+
+  MThreading::Mutex_Lock(EncMutex);
+  job = EncQueue.front();
+  EncQueue.pop_front();
+  MThreading::Mutex_Unlock(EncMutex);
+
+  if(!job)
+   break;
+
+  if(!EncFailed)
+  {
+   try
+   {
+    EncodeFrame(job);
+   }
+   catch(std::exception &e)
+   {
+    MThreading::Mutex_Lock(EncMutex);
+    EncError = e.what();
+    EncFailed = true;
+    MThreading::Mutex_Unlock(EncMutex);
+   }
+  }
+
+  MThreading::Mutex_Lock(EncMutex);
+  FreeJobs.push_back(job);
+  MThreading::Mutex_Unlock(EncMutex);
+  MThreading::Sem_Post(EncSlotsSem);
+ }
+}
+
+// Waits for every queued frame to be encoded, then stops the encoder thread.
+void QTRecord::StopEncoder(void)
+{
+ if(!EncThread)
+  return;
+
+ MThreading::Sem_Wait(EncSlotsSem);
+ MThreading::Mutex_Lock(EncMutex);
+ EncQueue.push_back(NULL);
+ MThreading::Mutex_Unlock(EncMutex);
+ MThreading::Sem_Post(EncJobsSem);
+
+ MThreading::Thread_Wait(EncThread, NULL);
+ EncThread = NULL;
 }
 
 
@@ -328,9 +509,7 @@ static void DecodeLine(const T* src, const MDFN_PixelFormat& src_pf, int src_wid
 void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayRect, const int32 *LineWidths,
 			  const int16 *SoundBuf, const int32 SoundBufSize, const int64 MasterCycles)
 {
- QTChunk qts;
-
- memset(&qts, 0, sizeof(qts));
+ Job* job;
 
  if(DisplayRect.h <= 0)
  {
@@ -338,10 +517,24 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
   return;
  }
 
+ MThreading::Sem_Wait(EncSlotsSem);
 
- qts.video_foffset = qtfile.tell();
+ MThreading::Mutex_Lock(EncMutex);
+ if(EncFailed)
+ {
+  const std::string err = EncError;
+
+  MThreading::Mutex_Unlock(EncMutex);
+  MThreading::Sem_Post(EncSlotsSem);
+
+  throw MDFN_Error(0, "%s", err.c_str());
+ }
+ job = FreeJobs.back();
+ FreeJobs.pop_back();
+ MThreading::Mutex_Unlock(EncMutex);
+
+ std::vector<uint8>& RawVideoBuffer = job->video;
 
- // Write video here
  {
   uint32 dest_y = 0;
   int yscale_factor = QTVideoHeight / DisplayRect.h;
@@ -407,7 +600,31 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
   } // end for(int y = DisplayRect.y; y < DisplayRect.y + DisplayRect.h; y++)
  }
 
- if(VideoCodec == VCODEC_CSCD)
+ job->sound.assign(SoundBuf, SoundBuf + SoundBufSize * SoundChan);
+ job->sound_frames = SoundBufSize;
+ job->master_cycles = MasterCycles;
+
+ MThreading::Mutex_Lock(EncMutex);
+ EncQueue.push_back(job);
+ MThreading::Mutex_Unlock(EncMutex);
+ MThreading::Sem_Post(EncJobsSem);
+}
+
+void QTRecord::EncodeFrame(Job* job)
+{
+ const std::vector<uint8>& RawVideoBuffer = job->video;
+ const int16* SoundBuf = job->sound.data();
+ const int32 SoundBufSize = job->sound_frames;
+ const int64 MasterCycles = job->master_cycles;
+ QTChunk qts;
+
+ memset(&qts, 0, sizeof(qts));
+
+ qts.video_foffset = qtfile.tell();
+
+ if(VideoCodec == VCODEC_PIPE)
+  WriteY4MFrame(&RawVideoBuffer[0]);
+ else if(VideoCodec == VCODEC_CSCD)
  {
   lzo_uint dst_len = CompressedVideoBuffer.size();
   uint8 tmp[2];
@@ -417,12 +634,12 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
 
   qtfile.write(tmp, 2);
 
-  lzo1x_1_compress(&RawVideoBuffer[0], RawVideoBuffer.size(), &CompressedVideoBuffer[0], &dst_len, lzo1x_1_workmem.get());
+  lzo1x_1_compress(&RawVideoBuffer[0], RawVideoSize, &CompressedVideoBuffer[0], &dst_len, lzo1x_1_workmem.get());
 
   qtfile.write(&CompressedVideoBuffer[0], dst_len);
  }
  else if(VideoCodec == VCODEC_RAW)
-  qtfile.write(&RawVideoBuffer[0], RawVideoBuffer.size());
+  qtfile.write(&RawVideoBuffer[0], RawVideoSize);
  else if(VideoCodec == VCODEC_PNG)
  {
   //PNGWrite(qtfile, surface, DisplayRect, LineWidths);
@@ -446,7 +663,7 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
 
   compress_buffer_size = CompressedVideoBuffer.size();
 
-  compress(&CompressedVideoBuffer[0], &compress_buffer_size, &RawVideoBuffer[0], RawVideoBuffer.size());
+  compress(&CompressedVideoBuffer[0], &compress_buffer_size, &RawVideoBuffer[0], RawVideoSize);
 
   PNGWrite::WriteChunk(qtfile, compress_buffer_size, "IDAT", &CompressedVideoBuffer[0]);
 
@@ -508,7 +725,12 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
   SoundBufROSize = out_len;
 
   for(unsigned i = 0; i < SoundBufROSize * SoundChan; i++)
-   MDFN_en16msb((uint8 *)&ResampOutBuffer[i], ResampOutBuffer[i]);
+  {
+   if(VideoCodec == VCODEC_PIPE)
+    MDFN_en16lsb((uint8 *)&ResampOutBuffer[i], ResampOutBuffer[i]);
+   else
+    MDFN_en16msb((uint8 *)&ResampOutBuffer[i], ResampOutBuffer[i]);
+  }
  }
  else
  {
@@ -518,7 +740,12 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
    ResampOutBuffer.resize(SoundBufSize * SoundChan);
 
   for(unsigned i = 0; i < SoundBufROSize * SoundChan; i++)
-   MDFN_en16msb((uint8 *)&ResampOutBuffer[i], SoundBuf[i]);
+  {
+   if(VideoCodec == VCODEC_PIPE)
+    MDFN_en16lsb((uint8 *)&ResampOutBuffer[i], SoundBuf[i]);
+   else
+    MDFN_en16msb((uint8 *)&ResampOutBuffer[i], SoundBuf[i]);
+  }
  }
 
  qtfile.write(&ResampOutBuffer[0], sizeof(int16) * SoundBufROSize * SoundChan);
@@ -528,6 +755,7 @@ void QTRecord::WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayR
  qts.audio_byte_size = qtfile.tell() - qts.audio_foffset;
 
  SoundFramesWritten += SoundBufROSize;
+ WAVDataBytes += qts.audio_byte_size;
 
  if(SoundRate && SoundChan)
  {
@@ -1082,11 +1310,28 @@ void QTRecord::Finish(void)
 
  Finished = true;
 
- atom_end();
+ StopEncoder();
+
+ if(VideoCodec == VCODEC_PIPE)
+ {
+  const int pipe_status = pclose(PipeFP);
+
+  PipeFP = NULL;
+
+  WriteWAVHeader(std::min<uint64>(WAVDataBytes, 0xFFFFFFFF - 36));
+  qtfile.close();
+
+  if(pipe_status)
+   throw MDFN_Error(0, _("Recording pipe command exited with status %d."), pipe_status);
+ }
+ else
+ {
+  atom_end();
 
- Write_moov();
+  Write_moov();
 
- qtfile.close();
+  qtfile.close();
+ }
 }
 
 QTRecord::~QTRecord(void)
@@ -1100,6 +1345,32 @@ QTRecord::~QTRecord(void)
   MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what());
  }
 
+ StopEncoder();
+
+ if(PipeFP)
+ {
+  pclose(PipeFP);
+  PipeFP = NULL;
+ }
+
+ if(EncSlotsSem)
+ {
+  MThreading::Sem_Destroy(EncSlotsSem);
+  EncSlotsSem = NULL;
+ }
+
+ if(EncJobsSem)
+ {
+  MThreading::Sem_Destroy(EncJobsSem);
+  EncJobsSem = NULL;
+ }
+
+ if(EncMutex)
+ {
+  MThreading::Mutex_Destroy(EncMutex);
+  EncMutex = NULL;
+ }
+
  if(resampler)
  {
   speex_resampler_destroy(resampler);
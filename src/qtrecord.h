@@ -23,8 +23,11 @@
 #define __MDFN_QTRECORD_H
 
 #include <mednafen/FileStream.h>
+#include <mednafen/MThreading.h>
 #include "resampler/resampler.h"
 
+#include <deque>
+
 namespace Mednafen
 {
 
@@ -36,7 +39,9 @@ class QTRecord
  {
   VCODEC_RAW = 0,
   VCODEC_CSCD,
-  VCODEC_PNG
+  VCODEC_PNG,
+
+  VCODEC_PIPE	// Internal, selected by VideoSpec::PipeCommand.
  };
 
  struct VideoSpec
@@ -53,16 +58,42 @@ class QTRecord
   int64 MasterClock;	// Fixed-point, 32.32, should be used when SoundRate == 0
 
   int VideoCodec;
+
+  uint32 FPS;		// Fixed-point, 8.24, as MDFNGI::fps; only used for the y4m header.
+
+  // If non-empty, video is piped to this command's stdin as YUV4MPEG2 4:4:4 instead, and the recording
+  // path receives the audio as a WAV file.
+  const char* PipeCommand;
  };
 
  QTRecord(const std::string& path, const VideoSpec &spec_arg);
  void Finish();
  ~QTRecord();
 
+ // Only converts the frame and queues it; compression and file I/O happen on the encoder thread.
+ // Throws if the encoder thread has failed.
  void WriteFrame(const MDFN_Surface *surface, const MDFN_Rect &DisplayRect, const int32 *LineWidths,
                           const int16 *SoundBuf, const int32 SoundBufSize, const int64 MasterCycles);
  private:
 
+ enum : unsigned { Max_Queue = 8 };
+
+ struct Job
+ {
+  std::vector<uint8> video;
+  std::vector<int16> sound;
+  int32 sound_frames;
+  int64 master_cycles;
+ };
+
+ static int EncodeThreadEntry(void* data);
+ void EncodeLoop(void);
+ void EncodeFrame(Job* job);
+ void StopEncoder(void);
+
+ void WriteY4MFrame(const uint8* rgb);
+ void WriteWAVHeader(uint32 data_bytes);
+
  void w8(uint8 val);
  void w16(uint16 val);
  void w32(uint32 val);
@@ -102,7 +133,7 @@ class QTRecord
 
  FileStream qtfile;
 
- std::vector<uint8> RawVideoBuffer;
+ size_t RawVideoSize;
  std::vector<uint8> CompressedVideoBuffer;
  std::unique_ptr<uint8[]> lzo1x_1_workmem;
 
@@ -148,6 +179,19 @@ class QTRecord
  std::vector<int16> ResampInBuffer;
  uint32 ResampInBufferFramesInCount;
  std::vector<int16> ResampOutBuffer;
+
+ FILE* PipeFP;
+ uint64 WAVDataBytes;
+
+ std::vector<std::unique_ptr<Job>> Jobs;
+ std::vector<Job*> FreeJobs;
+ std::deque<Job*> EncQueue;
+ MThreading::Mutex* EncMutex;
+ MThreading::Sem* EncJobsSem;
+ MThreading::Sem* EncSlotsSem;
+ MThreading::Thread* EncThread;
+ bool EncFailed;
+ std::string EncError;
 };
 
 }
@@ -68,6 +68,12 @@
 #include <mednafen/hw_cpu/m68k/m68k.h>
 #include <mednafen/jump.h>
 
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#elif defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
+
 #include <trio/trio.h>
 
 using namespace Mednafen;
@@ -174,6 +180,16 @@ static INLINE void SCSP_MainIntChanged(SS_SCSP* s, bool state)
  //
 }
 
+static INLINE void SCSP_DMAStarted(SS_SCSP* s, bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length)
+{
+ //
+}
+
+static INLINE void SCSP_SampleCaptured(SS_SCSP* s, const SS_SCSP::CaptureSample& cs)
+{
+ //
+}
+
 #include "../ss/scsp.inc"
 
 //
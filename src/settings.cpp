@@ -409,7 +409,7 @@ INLINE void SettingsManager::ParseSettingLine(char* ls, const char* lb, size_t*
  }
 }
 
-bool SettingsManager::Load(const std::string& path, unsigned override)
+bool SettingsManager::Load(const std::string& path, unsigned override, bool read_only)
 {
  if(!override)
   MDFN_printf(_("Loading settings from \"%s\"...\n"), MDFN_strhumesc(path).c_str());
@@ -422,8 +422,10 @@ bool SettingsManager::Load(const std::string& path, unsigned override)
  {
   //
   // MODE_READ_WRITE instead of MODE_READ to allow for locking, and to ensure that the file is writeable.
+  // A read-only load(a settings file shared by many instances that never save) does neither.
   //
-  MemoryStream mp(new FileStream(path, (override ? FileStream::MODE_READ : FileStream::MODE_READ_WRITE), !override));
+  const bool plain_read = override || read_only;
+  MemoryStream mp(new FileStream(path, (plain_read ? FileStream::MODE_READ : FileStream::MODE_READ_WRITE), !plain_read));
   size_t valid_count = 0;
   size_t unknown_count = 0;
   uint32 line_counter = 0;
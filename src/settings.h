@@ -39,7 +39,7 @@ class SettingsManager
 
  void Finalize(void);
 
- bool Load(const std::string& path, unsigned override = 0);
+ bool Load(const std::string& path, unsigned override = 0, bool read_only = false);
  void Save(const std::string& path);
  void SaveCompact(Stream* s);
 
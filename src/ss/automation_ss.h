@@ -1,7 +1,7 @@
 /* automation_ss.h -- Saturn-side automation accessors
  *
  * Shared interface between drivers/automation.cpp and ss/ss.cpp.
- * Functions are defined in ss.cpp within namespace MDFN_IEN_SS.
+ * Functions are defined in ss.cpp within namespace MDFN_IEN_SS (unless noted).
  *
  * Part of mednafen-saturn-debug fork.
  */
@@ -20,23 +20,70 @@ namespace MDFN_IEN_SS {
  // Memory writes (writes to backing store, invalidates cache line)
  void Automation_WriteMem8(uint32 addr, uint8 val);
 
+ // Bulk write to WorkRAMH/WorkRAML; purges the lines it touches from both SH-2
+ // caches. Bytes outside those regions are ignored. Returns bytes written.
+ uint32 Automation_WriteMemBlock(uint32 addr, const uint8* buf, uint32 size);
+ // Freeze list: Work RAM values rewritten at the start of every frame (ss.cpp)
+ bool Automation_FreezeSet(uint32 addr, unsigned size, uint32 value, bool purge);  // false outside Work RAM
+ unsigned Automation_FreezeRemove(uint32 addr);  // entries starting at addr
+ void Automation_FreezeClear(void);
+ std::string Automation_FreezeList(void);
+ void Automation_FreezeStats(uint32* entries, uint32* words, uint64* rewrites);
+
  // Bulk memory read — copies 'size' bytes from Saturn address space into 'buf'.
  // Uses backing store directly (bypasses cache) for speed on large reads.
  void Automation_ReadMemBlock(uint32 addr, uint8* buf, uint32 size);
 
+ // Same, with the valid lines of the master SH-2 cache laid over the backing store.
+ void Automation_ReadMemBlockCoherent(uint32 addr, uint8* buf, uint32 size);
+
+ // Dirty bits of 32-byte blocks written since the last call, then cleared.
+ // region: 0 VDP1 VRAM, 1 VDP2 VRAM, 2 VDP2 CRAM; up to 256 words, returns the count.
+ uint32 Automation_TakeVideoDirty(unsigned region, uint64* bits);
+
+ // fork() support (spawn): Suspend ends the VDP1 framebuffer workers and the VDP2
+ // render thread and NBG workers once their queued work is done, keeping all
+ // emulation state; Resume starts them again. Call Resume in the parent and child.
+ void Automation_SuspendThreads(void);
+ void Automation_ResumeThreads(void);
+
  // Register dumps
  std::string Automation_DumpRegs(void);
  void Automation_DumpRegsBin(const char* path);
+ void Automation_GetRegs(unsigned cpu, uint32* regs);  // 22 words, dump_regs_bin layout
+ // GDB's SH register order: R0-R15, PC, PR, GBR, VBR, MACH, MACL, SR.
+ enum { GDBReg_PC = 16, GDBReg_Count = 23 };
+ void Automation_GetGDBRegs(unsigned cpu, uint32* regs);
+ // False for PC (not writable under the pipeline) and out-of-range indices.
+ bool Automation_SetGDBReg(unsigned cpu, unsigned index, uint32 value);
  std::string Automation_CallStack(uint32 scan_size);
+ std::string Automation_CallStackCPU(unsigned cpu);  // the same for a given CPU (0 master, 1 slave)
+ // Shadow call stack depth for a CPU; *top_return gets the innermost frame's return address (if depth > 0).
+ unsigned Automation_ShadowDepth(unsigned cpu, uint32* top_return);
  std::string Automation_DumpSlaveRegs(void);
+
+ // Symbol table (load_symbols): function ranges, looked up by binary search.
+ // Ids are indices into the sorted table, valid until the next load/clear.
+ int Automation_LoadSymbols(const char* path, bool append, std::string* error);  // returns symbols loaded, -1 on error
+ void Automation_ClearSymbols(void);
+ uint32 Automation_SymbolCount(void);
+ int32 Automation_SymbolFind(uint32 addr);  // -1 if not inside a symbol
+ const char* Automation_SymbolName(int32 id);
+ uint32 Automation_SymbolStart(int32 id);
+ std::string Automation_SymbolFormat(uint32 addr);  // "name" or "name+0x1C"; empty if none
  void Automation_DumpSlaveRegsBin(const char* path);
  void Automation_DumpVDP2RegsBin(const char* path);
 
- // CPU hook control
- void Automation_EnableCPUHook(void);
- void Automation_DisableCPUHook(void);
+ // CPU hook control (cpu: 0 = master, 1 = slave)
+ void Automation_EnableCPUHook(unsigned cpu);
+ void Automation_DisableCPUHook(unsigned cpu);
+ void Automation_SetCPUHookFilter(unsigned cpu, bool filtered);  // true: hook only runs in marked pages
+ void Automation_ClearCPUHookPages(unsigned cpu);
+ void Automation_AddCPUHookPage(unsigned cpu, uint32 pc);
  uint32 Automation_GetMasterPC(void);
  int64_t Automation_GetMasterCycle(void);
+ std::string Automation_HotMemStatus(void);  // hot memory arena, see hotmem.h
+ void Automation_SetMasterCycle(int64_t cycle);
  uint32 Automation_GetMasterSR(void);
  void Automation_SetMasterSR(uint32 val);
 
@@ -45,19 +92,39 @@ namespace MDFN_IEN_SS {
  void Automation_DisableCallTrace(void);
  void Automation_SetCallTraceFile(FILE* f);
  void Automation_ClearCallTraceFile(void);
+ // Filters for call_trace and the unified traces: callee ranges (lo/hi pairs, inclusive, up to 16
+ // each), max shadow stack depth (0 = any), collapse runs of one call into "repeat=N" (text only)
+ bool Automation_SetCallTraceFilter(const uint32* include, unsigned n_include, const uint32* exclude, unsigned n_exclude, unsigned max_depth, bool collapse);
+ void Automation_CallTraceStats(uint64* written, uint64* filtered, uint64* collapsed);  // since the filter was set
 
- // Memory write watchpoints
- void Automation_SetWatchpoint(uint32 addr);
- void Automation_SetWatchpointFilter(bool active, uint32 value);
- void Automation_ClearWatchpoint(void);
- bool Automation_CheckWatchpointActive(void);
- void Automation_SetVDP2Watchpoint(uint32 lo, uint32 hi, const char* logpath);
- void Automation_ClearVDP2Watchpoint(void);
+ // Binary unified trace (bin_trace.h); <path>.idx gets the frame index
+ bool Automation_EnableUnifiedBinTrace(const char* path, bool zblocks, uint64 frame);
+ uint64 Automation_DisableUnifiedBinTrace(void);  // returns dropped record count
+ void Automation_UnifiedBinFrame(uint64 frame);
 
- // Memory read watchpoints (non-pausing, log-only)
- void Automation_SetReadWatchpoint(uint32 addr);
- void Automation_ClearReadWatchpoint(void);
- bool Automation_CheckReadWatchpointActive(void);
+ // Memory watchpoints: [addr, addr + len) in Work RAM L/H, or VDP1 (writes
+ // only). Returns false if the range isn't watchable. Hits are reported to
+ // Automation_WatchpointHit / Automation_ReadWatchpointHit with the id.
+ bool Automation_AddWatchpoint(unsigned id, uint32 addr, uint32 len, bool is_read, bool filter_active, uint32 filter_value);
+ void Automation_RemoveWatchpoint(unsigned id);
+ // Indexed write log over Work RAM (see WriteLogEntry in ss.cpp).
+ struct Automation_WriteLogHit
+ {
+  int64 cycle;
+  uint32 pc, addr, old_val, new_val;
+  unsigned size;
+  unsigned source;	// 0 = master, 1 = slave (CPU or its DMA), 2 = SCU DMA, 3 = SCU DSP
+ };
+ bool Automation_WriteLogStart(const uint32* ranges, unsigned count, size_t entries);  // ranges: lo/hi pairs, inclusive
+ void Automation_WriteLogStop(void);
+ bool Automation_WriteLogActive(void);
+ void Automation_WriteLogStats(uint64* total, uint64* held, int64* oldest_cycle);
+ int Automation_WriteLogQuery(uint32 addr, int64 before_cycle, Automation_WriteLogHit* out, int max, bool* complete);
+ void Automation_WriteLogRewind(int64 cycle);
+ bool Automation_SetVDP2Watchpoint(uint32 lo, uint32 hi, const char* logpath, unsigned mode, unsigned line_size, bool zlib);  // mode: 0 text, 1 bin, 2 agg
+ uint64 Automation_ClearVDP2Watchpoint(uint64 frame, uint64* records);  // returns records dropped
+ void Automation_VDP2WatchFrame(uint64 frame);
+ bool Automation_VDP2WatchIsActive(void);
 
  // CD Block tracing
  void CDB_EnableSCDQTrace(const char* path);
@@ -66,16 +133,45 @@ namespace MDFN_IEN_SS {
  void CDB_DisableCDBTrace(void);
  void CDB_SetCDBTraceFile(FILE* f);
  void CDB_ClearCDBTraceFile(void);
+ // CD Block profile: command latency, drive phase time and buffer occupancy, optional binary events
+ bool CDB_ProfileStart(const char* path, bool zlib);  // path may be null
+ uint64 CDB_ProfileStop(uint64* records);  // returns dropped records
+ bool CDB_ProfileIsActive(void);
+ bool CDB_ProfileDump(const char* path, uint64* commands);  // commands: results counted
 
  // Deterministic mode
  void Automation_SetDeterministic(void);
 
+ // Sub-frame input: hook runs before each INTBACK peripheral read (1-based index within the
+ // frame) and returns the mask of ports whose data it rewrote (see SMPC_SetPollHook)
+ void Automation_SetSMPCPollHook(uint32 (*hook)(unsigned index));
+ unsigned Automation_GetSMPCPollIndex(void);  // INTBACK peripheral reads so far this frame
+
  // Per-instruction tracing
- void Automation_EnableInsnTrace(const char* path, int64_t start_line, int64_t stop_line);
+ void Automation_EnableInsnTrace(const char* path, int64_t start_line, int64_t stop_line, bool raw);
+ // Disassembles records first..first+count-1 of a raw insn trace to text; lines written, or -1
+ int64 Automation_InsnTraceDisasm(const char* in_path, const char* out_path, uint64 first, uint64 count);
  void Automation_EnableInsnTraceUnified(int64_t start_line, int64_t stop_line);
- void Automation_DisableInsnTrace(void);
+ uint64 Automation_DisableInsnTrace(void);  // returns dropped record count
+ // Trace window decided per instruction in the emulator: opens once frame >= frame_lo,
+ // cycle >= cycle_lo, PC is in [enter_lo, enter_hi) (if enter_hi) and after_pc has
+ // been hit after_n times (if after_n), all on a CPU in cpu_mask; closes after frame_hi,
+ // at cycle_hi or after count instructions (each -1/0 = never). Only cpu_mask CPUs are traced.
+ struct Automation_InsnTraceWindow
+ {
+  unsigned cpu_mask = 3;
+  int64 frame_lo = 0, frame_hi = -1;
+  int64 cycle_lo = 0, cycle_hi = -1;
+  uint32 enter_lo = 0, enter_hi = 0;
+  uint32 after_pc = 0;
+  uint64 after_n = 0;
+  uint64 count = 0;
+ };
+ bool Automation_EnableInsnTraceWindow(const char* path, const Automation_InsnTraceWindow& w, bool raw, uint64 frame);
+ void Automation_InsnTraceWindowFrame(uint64 frame);
+ const char* Automation_InsnTraceWindowState(uint64* traced);  // "off", "armed", "open" or "closed"
 
- // Code/Data Logging (CDL) — configurable address range
+ // Code/Data Logging (CDL) — sparse over the 27-bit bus, optional [lo, hi) limit
  void Automation_CDLStart(uint32 lo, uint32 hi);
  void Automation_CDLStop(void);
  void Automation_CDLReset(void);
@@ -84,19 +180,257 @@ namespace MDFN_IEN_SS {
  uint32 Automation_CDLGetLo(void);
  uint32 Automation_CDLGetHi(void);
  uint32 Automation_CDLGetSize(void);
+ uint32 Automation_CDLGetPages(void);  // 4KB pages allocated so far
+ std::string Automation_CDLDelta(uint8 mask, uint32* nbytes);  // bytes gaining bits since last call
+ // Overlay log: CPU/DMA writes into pages CDL has seen code in (layout in ss.cpp)
+ bool Automation_CDLOverlayStart(const char* path, bool zlib);
+ uint64 Automation_CDLOverlayStop(uint64* dropped);  // returns records written
+ void Automation_CDLOverlayFrame(uint64 frame);
+ bool Automation_CDLOverlayIsActive(void);
+
+ // Sampling profiler (SS_EVENT_PROFILE): PC and shadow call chain every
+ // interval master cycles; cpu_mask bit 0 = master, bit 1 = slave
+ bool Automation_ProfileStart(uint32 interval, unsigned cpu_mask);
+ void Automation_ProfileStop(void);
+ bool Automation_ProfileIsActive(void);
+ uint32 Automation_ProfileGetInterval(void);
+ uint64 Automation_ProfileGetSamples(unsigned cpu);
+ uint32 Automation_ProfileGetStacks(void);  // unique call chains, both CPUs
+
+ // Periodic callback (SS_EVENT_TICK) every interval master cycles, from the event
+ // loop: it mustn't block. A null hook or interval 0 turns it off.
+ void Automation_SetTickHook(void (*hook)(void), uint32 interval);
+ // Per-scanline callback from the VDP2 line event (defined in vdp2.cpp): the new
+ // line counter and VBlank in/out edges. Also mustn't block; null turns it off.
+ void Automation_SetLineHook(void (*hook)(uint32 line, bool vb_in, bool vb_out));
+
+ // Sound 68K (sound.cpp). The instruction hook runs before each instruction
+ // (pc, its first opcode word); the write hook after each 68K byte/word write
+ // to sound RAM (addr 0-0x7FFFF, pc = that instruction's). Null turns them
+ // off; with both off the 68K runs unhooked.
+ void Automation_Set68KHook(void (*hook)(uint32 pc, uint16 opcode));
+ void Automation_Set68KWriteHook(void (*hook)(uint32 pc, uint32 addr, uint32 old_val, uint32 new_val, unsigned size));
+ void Automation_Get68KRegs(uint32* regs);  // 18 words: D0-D7, A0-A7, PC, SR
+ // SCSP DMA (sound.cpp): called as each transfer starts, in word units (to_ram: registers -> sound RAM).
+ void Automation_SetSCSPDMAHook(void (*hook)(bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length));
+ // SCSP capture (sound.cpp): per-slot, DSP and mix samples to path (WAV unless raw),
+ // key on/off events to <path>.keys. Stop returns dropped records; totals[2]:
+ // samples, key events; path gets the capture's file name.
+ bool Automation_SCSPCaptureStart(const char* path, bool raw);
+ uint64 Automation_SCSPCaptureStop(uint64* totals, std::string* path);
+ bool Automation_SCSPCaptureIsActive(void);
+ // mode 0: folded stacks, 1: flat per-PC counts, 2: per-symbol counts (needs load_symbols)
+ bool Automation_ProfileDump(const char* path, unsigned mode);
+
+ // SH-2 cache statistics: read hits/misses (instruction/data), purges, CCR
+ // writes and a per-line miss histogram
+ void Automation_CacheStatsStart(void);
+ void Automation_CacheStatsStop(void);
+ bool Automation_CacheStatsIsActive(void);
+ std::string Automation_CacheStatsFormat(unsigned top);  // counters, then top N miss lines per CPU
+ bool Automation_CacheStatsDump(const char* path);  // "MDFNCST1" binary
+
+ // Cache emulation mode (ss.dbg_cem detect): "full|data_cb|data detect=armed|off [switched_by=...]"
+ std::string Automation_CacheModeStatus(void);
+ bool Automation_CacheModeDetect(unsigned mask);  // 1 assoc_purge, 2 ccr_purge, 4 alias, 8 smc; 0 disarms. False in full mode
+ void Automation_CacheModeFull(void);  // one way, takes effect at the next frame
+
+ // Bus profiler: SH-2 external bus accesses and cycles per CPU x read/write x
+ // region; Automation_BusProfileFrame() closes each frame's counter set
+ void Automation_BusProfileStart(void);
+ void Automation_BusProfileStop(void);
+ bool Automation_BusProfileIsActive(void);
+ void Automation_BusProfileFrame(void);
+ std::string Automation_BusProfileFormat(bool total);  // " m.r.HWRAM=count/cycles ..."
+
+ // Interrupt latency profiler: SCU interrupts from assertion to the master
+ // SH-2's vector fetch, per source, and the PCs where SR.I held them off;
+ // Automation_IntLatencyFrame() closes each frame's counter set
+ void Automation_IntLatencyStart(void);
+ void Automation_IntLatencyStop(void);
+ bool Automation_IntLatencyIsActive(void);
+ void Automation_IntLatencyFrame(void);
+ std::string Automation_IntLatencyFormat(bool total);  // " VBIN=count/cycles/max/masked[b6=n,...] ..."
+ bool Automation_IntLatencyDump(const char* path);     // text report of the totals
+
+ // Sync wait profiler: cycles each SH-2 spends in polling loops on work RAM or
+ // FTCSR per frame, charged to the loop's branch; Automation_SyncProfileFrame()
+ // closes each frame
+ void Automation_SyncProfileStart(void);
+ void Automation_SyncProfileStop(void);
+ bool Automation_SyncProfileIsActive(void);
+ void Automation_SyncProfileFrame(void);
+ std::string Automation_SyncProfileFormat(bool total);  // " m=wait/cycles s=wait/cycles m.top=PC:cycles ..."
+ bool Automation_SyncProfileDump(const char* path, unsigned top);  // text, sync points per CPU; top = 0: all
+
+ // Scheduler event handler calls per event, always counted; the driver
+ // calls Automation_EventStatsFrame() once per frame.
+ void Automation_EventStatsFrame(void);
+ void Automation_EventStatsReset(void);
+ std::string Automation_EventStatsFormat(bool total);  // " sh2_m_dma=calls ..."
+
+ // Host time per subsystem (perf_stats), rolled at the end of each Emulate().
+ // Automation_PerfStatsIdle(): the gap until the next frame was a pause, not driver time.
+ void Automation_PerfStatsStart(void);
+ void Automation_PerfStatsStop(void);
+ bool Automation_PerfStatsIsActive(void);
+ void Automation_PerfStatsIdle(void);
+ std::string Automation_PerfStatsFormat(bool total);  // " frames=N emu=<us> host=<us> speed=<%> master=<us> ..."
+ std::string Automation_PerfStatsCSV(bool header);    // "emu,host,..." or the last frame's values
+ std::string Automation_PerfStatsJSON(void);          // last frame as a JSON object, or "null" when off
+ std::string Automation_TraceWritersJSON(void);       // "name":{"bytes":N,"dropped":N},... for open trace rings
+
+ // Backup memory as files (nv_dump/nv_load), in the .bkr or cart save file
+ // format; cart = the cart's backup memory instead of the internal backup RAM
+ bool Automation_NVDump(const char* path, bool cart, std::string* err);
+ bool Automation_NVLoad(const char* path, bool cart, std::string* err);
+
+ // SH-2 interpreter microbenchmark (sh2_bench): the master alone on a built-in
+ // loop kernel or a raw code file; clobbers the machine, reload state after.
+ // icache_mask bit 0 = run without instruction cache emulation, bit 1 = with.
+ bool Automation_SH2Bench(const char* kernel, const char* path, uint32 at, uint64 insns, unsigned icache_mask, std::string* report);  // " kernel=.. insns=N noicache: ns/insn=.. ..." or error text
+
+ // Exact function profiler (shadow call stack): calls, inclusive/exclusive
+ // cycles and instruction-fetch wait cycles per function entry point
+ void Automation_FuncProfileStart(unsigned cpu_mask);
+ void Automation_FuncProfileReset(void);  // clear counters, keep profiling
+ void Automation_FuncProfileStop(void);
+ bool Automation_FuncProfileIsActive(void);
+ uint32 Automation_FuncProfileGetFuncs(void);
+ bool Automation_FuncProfileDump(const char* path, unsigned top);  // top = 0: all
+
+ // Flight recorder: the last "entries" instructions per CPU (cycle, PC, opcode
+ // and, with mem, the last data access) kept in memory; cpu_mask bit 0 =
+ // master, bit 1 = slave. Dump returns the lines written, -1 on open failure.
+ void Automation_FlightRecStart(size_t entries, unsigned cpu_mask, bool mem);
+ void Automation_FlightRecStop(void);
+ bool Automation_FlightRecActive(void);
+ int64 Automation_FlightRecDump(const char* path, size_t last);  // last = 0: all held
+
+ // Recent events (crash bundles): the last 256 SCU DMA starts and CD Block trace
+ // lines, in memory. Dump returns the lines written, -1 on open failure.
+ void Automation_RecentEventsStart(void);
+ void Automation_RecentEventsStop(void);
+ bool Automation_RecentEventsActive(void);
+ int64 Automation_RecentEventsDump(const char* path);
+ uint64 Automation_VBlankInTaken(void);  // VBlank-IN vectors taken by the master SH-2 (not in save states)
+
+ // Call graph (shadow call stack): caller->callee edges with call counts,
+ // first/last frame seen and optionally inclusive cycles; dumped as DOT or JSON
+ void Automation_CallGraphStart(unsigned cpu_mask, bool cycles);
+ void Automation_CallGraphReset(void);
+ void Automation_CallGraphStop(void);
+ void Automation_CallGraphFrame(uint64 frame);  // frame number stamped on edges
+ bool Automation_CallGraphIsActive(void);
+ uint32 Automation_CallGraphGetEdges(void);
+ bool Automation_CallGraphDump(const char* path, bool json);
+
+ // VDP2 render timing (defined in vdp2_render.cpp): per-layer render thread
+ // time, summed per frame; values are microseconds
+ void Automation_VDP2TimingStart(void);
+ void Automation_VDP2TimingStop(void);
+ bool Automation_VDP2TimingIsActive(void);
+ std::string Automation_VDP2TimingFormat(bool total);  // " frames=N lines=L setup=.. spr=.. ..."
+ std::string Automation_VDP2TimingSummary(void);       // two short lines for the FPS overlay
+
+ // VDP2 preview mode (defined in vdp2_render.cpp): odd lines repeat the line
+ // above instead of being drawn; output only, not accurate (ss.vdp2_preview)
+ void Automation_VDP2SetPreview(bool enabled);
+ bool Automation_VDP2PreviewIsActive(void);
+
+ // VDP1 command list capture and replay (defined in vdp1.cpp): one record per
+ // completed drawing, replayed offline through the rasterizer
+ bool Automation_VDP1CaptureStart(const char* path);
+ uint32 Automation_VDP1CaptureStop(void);  // returns drawings written
+ bool Automation_VDP1CaptureIsActive(void);
+ uint32 Automation_VDP1CaptureDropped(void);  // drawings cut short, not written
+ bool Automation_VDP1Bench(const char* path, unsigned repeat, std::string* report);  // " frames=N ..." or error text
+
+ // One whole VDP1 framebuffer (0x20000 words, native order), the draw or the
+ // display one, straight from the backing array after the FB workers drain;
+ // *tvmr gets TVMR for its pixel layout
+ void Automation_VDP1ReadFB(bool display, uint16* dest, uint8* tvmr);
+
+ // VDP1 draw statistics (defined in vdp1.cpp): drawing cycles, plotted pixels,
+ // commands and cycles by type, distinct VRAM words read/written; per frame
+ void Automation_VDP1StatsStart(void);
+ void Automation_VDP1StatsStop(void);
+ bool Automation_VDP1StatsIsActive(void);
+ void Automation_VDP1StatsFrame(void);
+ std::string Automation_VDP1StatsFormat(bool total);  // " frames=N drawings=.. cycles=.. ..."
+
+ // Per-command VDP1 statistics, keyed by command table address: type, fetches,
+ // cycles, pixels drawn and pixels clipped, for the last frame
+ void Automation_VDP1CmdStatsStart(void);
+ void Automation_VDP1CmdStatsStop(void);
+ bool Automation_VDP1CmdStatsIsActive(void);
+ void Automation_VDP1CmdStatsFrame(void);
+ uint32 Automation_VDP1CmdStatsCount(void);  // entries in the last frame
+ std::string Automation_VDP1CmdStatsFormat(unsigned max, const char* prefix);  // "<prefix>addr=0x.. type=.. ...\n" per entry, most cycles first
+
+ // VDP1 command fetch breaks by table address (byte offset in VDP1 VRAM);
+ // hits go to ::Automation_VDP1CmdBreakHit()
+ void Automation_VDP1CmdBreakAdd(uint32 addr);
+ void Automation_VDP1CmdBreakRemove(uint32 addr);
+ void Automation_VDP1CmdBreakClear(void);
+
+ // VDP2 frame capture and replay (defined in vdp2_render.cpp): one record per
+ // rendered frame, replayed offline single- and multi-threaded; frames = 0
+ // records until stopped
+ bool Automation_VDP2CaptureStart(const char* path, uint32 frames);
+ uint32 Automation_VDP2CaptureStop(void);  // returns frames written
+ bool Automation_VDP2CaptureIsActive(void);
+ bool Automation_VDP2Bench(const char* path, unsigned repeat, std::string* report);  // " frames=N ..." or error text
+
+ // Per-layer VDP2 capture (defined in vdp2_render.cpp): the next rendered
+ // frame's sprite, RBG0/1, NBG0-3, line color and back planes, all from one
+ // pass; the file is closed once that frame is written
+ bool Automation_VDP2LayerCaptureStart(const char* path);
+ void Automation_VDP2LayerCaptureStop(void);  // drops a capture that hasn't run yet
+ bool Automation_VDP2LayerCaptureIsPending(void);
 
  // Memory read profiling
  void Automation_EnableMemReadProfile(const char* path, uint32 lo, uint32 hi);
- void Automation_DisableMemReadProfile(void);
+ uint64 Automation_DisableMemReadProfile(void);  // returns dropped record count
+
+ // Memory access heatmap: per-64-byte-line CPU/DMA read/write counters plus
+ // the busiest (pc, line) pairs, dumped in binary every N frames
+ // Opcode histogram per decoded handler; runs the DebugMode loops while on (WANT_DEBUGGER builds only)
+ bool Automation_OpStatsStart(unsigned cpu_mask, const char* path, unsigned every);  // path may be null
+ uint64 Automation_OpStatsStop(uint64 frame, uint64* records);  // returns dropped records
+ void Automation_OpStatsFrame(uint64 frame);
+ bool Automation_OpStatsIsActive(void);
+ uint64 Automation_OpStatsTotal(unsigned cpu);  // instructions counted since start
+ bool Automation_OpStatsDump(const char* path, unsigned top);
+
+ // SCU DSP profile: executions and stall cycles per program RAM address, optional binary trace
+ bool Automation_DSPProfileStart(const char* trace_path, bool zlib);  // trace_path may be null
+ uint64 Automation_DSPProfileStop(uint64* records);  // returns dropped records
+ bool Automation_DSPProfileIsActive(void);
+ void Automation_DSPProfileTotals(uint64* insns, uint64* stall);
+ bool Automation_DSPProfileDump(const char* path, unsigned top);
+ void Automation_DSPReadRAM(uint32* prog, uint32* data);  // 256 words each (data: 4 banks of 64)
+ std::string Automation_DSPRegs(void);
+
+ bool Automation_HeatmapStart(const char* path, uint32 lo, uint32 hi, unsigned every, unsigned top, bool zlib);
+ uint64 Automation_HeatmapStop(uint64 frame, uint64* dumps);  // writes any partial dump; returns dropped dump count
+ void Automation_HeatmapFrame(uint64 frame);
+ bool Automation_HeatmapIsActive(void);
 
  // DMA trace logging
  void Automation_EnableDMATrace(const char* path);
- void Automation_DisableDMATrace(void);
+ uint64 Automation_DisableDMATrace(void);  // returns dropped record count
  void Automation_LogDMA(int level, uint32 src, uint32 dst, uint32 bytes);
 
+ // Binary DMA trace: SCU, SH-2 DMAC and SCSP transfers with per-frame bandwidth summaries
+ bool Automation_DMATraceBinStart(const char* path, bool zlib, bool frames_only);
+ uint64 Automation_DMATraceBinStop(uint64 frame, uint64* totals);  // totals[3]: transfers, bytes, frames; returns dropped records
+ void Automation_DMATraceBinFrame(uint64 frame);
+ bool Automation_DMATraceBinIsActive(void);
+
  // Memory write profiling
  void Automation_EnableMemProfile(const char* path, uint32 lo, uint32 hi);
- void Automation_DisableMemProfile(void);
+ uint64 Automation_DisableMemProfile(void);  // returns dropped record count
 }
 
 #endif
@@ -0,0 +1,276 @@
+/* bin_trace.h -- Compact binary unified trace
+ *
+ * Binary counterpart of the text unified trace (unified_trace_bin): the same
+ * call / per-instruction / CD Block events plus SCU DMA, as packed records
+ * written through an async TraceRing. unified_trace_dump.py converts a file
+ * back to the text format.
+ *
+ * File:   "MDFNUTB1", le32 flags (bit 0: zlib blocks, see trace_ring.h),
+ *         then the record stream (plain, or split into blocks).
+ *
+ * Record: u8 tag (bits 0-3 type, bit 7 set = slave CPU),
+ *         varint zigzag(timestamp - timestamp of the previous record),
+ *         payload:
+ *   CALL   le32 caller PC, le32 target
+ *   INSN   le32 PC, le16 opcode, varint changed-register mask, then le32 for
+ *          each set bit (R0-R15, PR, SR, GBR, MACH, MACL), relative to the
+ *          previous INSN record of the same CPU
+ *   CDB    varint len, text of the CD Block line after its timestamp
+ *   DMA    u8 level, le32 src, le32 dst, le32 len, le32 master PC
+ *   NOTE   varint len, text of a "# ..." comment line
+ *   FRAME  (no timestamp field) le64 cycle base, le64 frame number.
+ *          Resets the timestamp delta and register state, so decoding can
+ *          start at any FRAME record.
+ *
+ * Timestamps are the SH-2 timestamps the text trace prints; the absolute
+ * cycle is the last FRAME's base + timestamp. If the ring drops a record, a
+ * FRAME record for the current frame is re-emitted before the next one.
+ *
+ * Index sidecar <path>.idx: "MDFNUTI1", then one {le64 frame, le64 cycle
+ * base, le64 stream offset} entry per frame, offsets in uncompressed stream
+ * bytes. Entries ascend in frame and cycle, so either can be binary searched.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_BIN_TRACE_H
+#define __MDFN_SS_BIN_TRACE_H
+
+#include "trace_ring.h"
+#include <string>
+
+namespace MDFN_IEN_SS
+{
+
+class BinTrace
+{
+ public:
+
+ enum : uint8
+ {
+  REC_CALL = 1,
+  REC_INSN = 2,
+  REC_CDB = 3,
+  REC_DMA = 4,
+  REC_NOTE = 5,
+  REC_FRAME = 6,
+
+  TAG_SLAVE = 0x80
+ };
+
+ enum : uint32 { FLAG_ZBLOCKS = 0x1 };
+ enum : unsigned { Num_Regs = 21 };
+
+ // Returns nullptr if either file can't be created.
+ static BinTrace* Open(const char* path, bool zblocks, uint64 frame, uint64 base)
+ {
+  FILE* fp = fopen(path, "wb");
+  if(!fp)
+   return nullptr;
+
+  FILE* idx = fopen((std::string(path) + ".idx").c_str(), "wb");
+  if(!idx)
+  {
+   fclose(fp);
+   return nullptr;
+  }
+
+  uint8 hdr[12];
+  memcpy(hdr, "MDFNUTB1", 8);
+  Mednafen::MDFN_en32lsb(&hdr[8], zblocks ? FLAG_ZBLOCKS : 0);
+  fwrite(hdr, 1, sizeof(hdr), fp);
+  fwrite("MDFNUTI1", 1, 8, idx);
+
+  BinTrace* ret = new BinTrace(fp, idx, zblocks);
+  ret->Frame(frame, base);
+  return ret;
+ }
+
+ ~BinTrace()
+ {
+  delete ring;
+  fclose(idx_fp);
+ }
+
+ // Start of a new frame; base is the absolute cycle timestamps count from.
+ void Frame(uint64 frame, uint64 base)
+ {
+  cur_frame = frame;
+  cur_base = base;
+
+  uint8 ent[24];
+  Mednafen::MDFN_en64lsb(&ent[0], frame);
+  Mednafen::MDFN_en64lsb(&ent[8], base);
+  Mednafen::MDFN_en64lsb(&ent[16], ring->Position());
+  fwrite(ent, 1, sizeof(ent), idx_fp);
+
+  resync = !EmitFrame();
+ }
+
+ void Call(unsigned cpu, uint32 ts, uint32 from, uint32 to)
+ {
+  uint8 rec[16];
+  uint8* p = Begin(rec, REC_CALL, cpu, ts);
+
+  if(!p)
+   return;
+
+  Mednafen::MDFN_en32lsb(p + 0, from);
+  Mednafen::MDFN_en32lsb(p + 4, to);
+  Commit(rec, p + 8, ts);
+ }
+
+ void Insn(unsigned cpu, uint32 ts, uint32 pc, uint16 opcode, const uint32* r, uint32 pr, uint32 sr, uint32 gbr, uint32 mach, uint32 macl)
+ {
+  uint8 rec[1 + 5 + 6 + 4 + Num_Regs * 4];
+  uint8* p = Begin(rec, REC_INSN, cpu, ts);
+
+  if(!p)
+   return;
+
+  uint32 regs[Num_Regs];
+  uint32* last = last_regs[cpu & 1];
+  uint32 changed = 0;
+
+  memcpy(regs, r, 16 * sizeof(uint32));
+  regs[16] = pr;
+  regs[17] = sr;
+  regs[18] = gbr;
+  regs[19] = mach;
+  regs[20] = macl;
+
+  for(unsigned i = 0; i < Num_Regs; i++)
+  {
+   if(!regs_valid[cpu & 1] || regs[i] != last[i])
+    changed |= 1U << i;
+  }
+
+  Mednafen::MDFN_en32lsb(p, pc);
+  Mednafen::MDFN_en16lsb(p + 4, opcode);
+  p = PutVarint(p + 6, changed);
+
+  for(unsigned i = 0; i < Num_Regs; i++)
+  {
+   if(changed & (1U << i))
+   {
+    Mednafen::MDFN_en32lsb(p, regs[i]);
+    p += 4;
+   }
+  }
+
+  if(Commit(rec, p, ts))
+  {
+   memcpy(last, regs, sizeof(regs));
+   regs_valid[cpu & 1] = true;
+  }
+ }
+
+ void DMA(uint32 ts, unsigned level, uint32 src, uint32 dst, uint32 len, uint32 pc)
+ {
+  uint8 rec[32];
+  uint8* p = Begin(rec, REC_DMA, 0, ts);
+
+  if(!p)
+   return;
+
+  p[0] = level;
+  Mednafen::MDFN_en32lsb(p + 1, src);
+  Mednafen::MDFN_en32lsb(p + 5, dst);
+  Mednafen::MDFN_en32lsb(p + 9, len);
+  Mednafen::MDFN_en32lsb(p + 13, pc);
+  Commit(rec, p + 17, ts);
+ }
+
+ // REC_CDB or REC_NOTE; text without the trailing newline.
+ void Text(uint8 type, uint32 ts, const char* text, size_t len)
+ {
+  uint8 rec[256 + 16];
+  uint8* p = Begin(rec, type, 0, ts);
+
+  if(!p)
+   return;
+
+  len = std::min<size_t>(len, 256);
+  p = PutVarint(p, len);
+  memcpy(p, text, len);
+  Commit(rec, p + len, ts);
+ }
+
+ INLINE uint64 Dropped(void) const { return ring->Dropped(); }
+ INLINE uint64 Position(void) const { return ring->Position(); }
+
+ private:
+
+ BinTrace(FILE* fp, FILE* idx, bool zblocks) : ring(new TraceRing(fp, true, TraceRing::Default_Capacity, zblocks)), idx_fp(idx)
+ {
+
+ }
+
+ static INLINE uint8* PutVarint(uint8* p, uint32 v)
+ {
+  while(v >= 0x80)
+  {
+   *p++ = (v & 0x7F) | 0x80;
+   v >>= 7;
+  }
+  *p++ = v;
+  return p;
+ }
+
+ bool EmitFrame(void)
+ {
+  uint8 rec[17];
+
+  rec[0] = REC_FRAME;
+  Mednafen::MDFN_en64lsb(&rec[1], cur_base);
+  Mednafen::MDFN_en64lsb(&rec[9], cur_frame);
+  if(!ring->Write(rec, sizeof(rec)))
+   return false;
+
+  last_ts = 0;
+  regs_valid[0] = regs_valid[1] = false;
+  return true;
+ }
+
+ // Writes tag and timestamp delta; returns the payload pointer, or nullptr
+ // if a pending resync couldn't be written either.
+ INLINE uint8* Begin(uint8* rec, uint8 type, unsigned cpu, uint32 ts)
+ {
+  if(MDFN_UNLIKELY(resync))
+  {
+   if(!EmitFrame())
+    return nullptr;
+   resync = false;
+  }
+
+  const int32 d = (int32)(ts - last_ts);
+
+  rec[0] = type | (cpu ? TAG_SLAVE : 0);
+  return PutVarint(rec + 1, ((uint32)d << 1) ^ (uint32)(d >> 31));
+ }
+
+ INLINE bool Commit(const uint8* rec, const uint8* end, uint32 ts)
+ {
+  if(!ring->Write(rec, end - rec))
+  {
+   resync = true;
+   return false;
+  }
+
+  last_ts = ts;
+  return true;
+ }
+
+ TraceRing* ring;
+ FILE* idx_fp;
+ uint64 cur_frame = 0;
+ uint64 cur_base = 0;
+ uint32 last_ts = 0;
+ bool resync = false;
+ bool regs_valid[2] = { false, false };
+ uint32 last_regs[2][Num_Regs];
+};
+
+}
+
+#endif
@@ -81,6 +81,7 @@ void CART_ExtRAM_Init(CartInfo* c, bool R4MiB)
   ExtRAM_Mask = 0x27FFFE;
  }
 
+ // Writeable, so SH-2 accesses take the fast map(BusRW_DB_CS12() in ss.cpp); the handlers below still serve SCU DMA and the DSP.
  SS_SetPhysMemMap(0x02400000, 0x025FFFFF, ExtRAM + (0x000000 / sizeof(uint16)), (R4MiB ? 0x200000 : 0x080000), true);
  SS_SetPhysMemMap(0x02600000, 0x027FFFFF, ExtRAM + (0x200000 / sizeof(uint16)), (R4MiB ? 0x200000 : 0x080000), true);
 
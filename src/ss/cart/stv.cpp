@@ -33,6 +33,13 @@
 
 #include <mednafen/hash/sha256.h>
 #include <mednafen/Time.h>
+#include <mednafen/FileStream.h>
+#include <mednafen/NativeVFS.h>
+#include <mednafen/general.h>
+
+#ifdef HAVE_MMAP
+#include <unistd.h>
+#endif
 
 namespace MDFN_IEN_SS
 {
@@ -46,6 +53,131 @@ static uint8 ROM_Mapped[0x3000000 / sizeof(uint16)];
 static uint8 rsg_thingy;
 static uint8 rsg_counter;
 
+//
+// ss.stv_rom_cache: the converted ROM image(interleaved, byte-swapped and descrambled, in host byte order) is
+// written once to "<fbase>.<key>.stvrom" in that directory, and memory-mapped read-only on later loads instead
+// of reading the ROM files; the kernel faults pages in as the game touches them, and every instance running the
+// same game shares them through the page cache.  The key covers the ROM file names, sizes and modification
+// times, the ROM layout and the host byte order, so a changed ROM set gets a new file.
+//
+// File layout: "MDFNSTV1", 32-byte key digest, 32-byte SHA-256 of the ROM file data, zero padding up to
+// ROMCACHE_HEADER_SIZE, then the 0x3000000-byte image.
+//
+enum : uint32 { ROMCACHE_HEADER_SIZE = 4096 };
+static std::unique_ptr<FileStream> ROMCache;	// non-null when ROM points into its mapping
+
+#ifdef HAVE_MMAP
+static std::string ROMCache_Path(GameFile* gf, const STVGameInfo* sgi, sha256_digest* key)
+{
+ const std::string dir = MDFN_GetSettingS("ss.stv_rom_cache");
+ const std::string fname = gf->fbase + (gf->ext.size() ? "." : "") + gf->ext;
+ std::string ks = MDFN_sprintf("%u %u\n", (unsigned)sgi->romtwiddle, (unsigned)MDFN_IS_BIGENDIAN);
+
+ if(dir.empty())
+  return std::string();
+
+ for(size_t i = 0; i < sizeof(sgi->rom_layout) / sizeof(sgi->rom_layout[0]) && sgi->rom_layout[i].size; i++)
+ {
+  const STVROMLayout* rle = &sgi->rom_layout[i];
+  const bool gf_fname_match = !MDFN_strazicmp(fname, rle->fname);
+  const std::string fpath = gf->vfs->eval_fip(gf->dir, gf_fname_match ? fname : rle->fname);
+  VirtualFS::FileInfo fi;
+
+  // Missing files are reported by the normal load path.
+  if(!gf->vfs->finfo(fpath, &fi, false))
+   return std::string();
+
+  ks += MDFN_sprintf("%s %08x %08x %u %llu %lld\n", rle->fname, rle->offset, rle->size, (unsigned)rle->map, (unsigned long long)fi.size, (long long)fi.mtime_us);
+ }
+
+ *key = sha256(ks.data(), ks.size());
+
+ std::string hex;
+
+ for(unsigned i = 0; i < 8; i++)
+  hex += MDFN_sprintf("%02x", (*key)[i]);
+
+ return NVFS.eval_fip(NVFS.eval_fip(MDFN_GetBaseDirectory(), dir), gf->fbase + "." + hex + ".stvrom");
+}
+
+static bool ROMCache_Load(const std::string& path, const sha256_digest& key, sha256_digest* dig)
+{
+ std::unique_ptr<FileStream> fs;
+ uint8* p;
+
+ try
+ {
+  fs.reset(new FileStream(path, FileStream::MODE_READ));
+ }
+ catch(MDFN_Error& e)
+ {
+  if(e.GetErrno() != ENOENT)
+   MDFN_Notify(MDFN_NOTICE_WARNING, _("ST-V ROM cache file \"%s\" not used: %s"), path.c_str(), e.what());
+
+  return false;
+ }
+
+ if(!(p = fs->map()) || fs->map_size() != ROMCACHE_HEADER_SIZE + 0x3000000 || memcmp(p, "MDFNSTV1", 8) || memcmp(p + 8, key.data(), key.size()))
+ {
+  MDFN_Notify(MDFN_NOTICE_WARNING, _("ST-V ROM cache file \"%s\" is invalid, recreating it."), path.c_str());
+  return false;
+ }
+
+ memcpy(dig->data(), p + 40, dig->size());
+ ROM = (uint16*)(p + ROMCACHE_HEADER_SIZE);
+ ROMCache = std::move(fs);
+
+ return true;
+}
+
+static bool ROMCache_Save(const std::string& path, const sha256_digest& key, const sha256_digest& dig)
+{
+ const std::string tmp_path = path + MDFN_sprintf(".%u.tmp", (unsigned)getpid());
+
+ try
+ {
+  std::unique_ptr<uint8[]> header(new uint8[ROMCACHE_HEADER_SIZE]());
+
+  memcpy(&header[0], "MDFNSTV1", 8);
+  memcpy(&header[8], key.data(), key.size());
+  memcpy(&header[40], dig.data(), dig.size());
+
+  NVFS.create_missing_dirs(path);
+  {
+   FileStream fs(tmp_path, FileStream::MODE_WRITE);
+
+   fs.write(&header[0], ROMCACHE_HEADER_SIZE);
+   fs.write(ROM, 0x3000000);
+   fs.close();
+  }
+  // Atomic, so instances starting at the same time never map a partial file.
+  NVFS.rename(tmp_path, path);
+  MDFN_printf(_("ST-V ROM cache: saved \"%s\".\n"), path.c_str());
+  return true;
+ }
+ catch(std::exception& e)
+ {
+  NVFS.unlink(tmp_path);
+  MDFN_Notify(MDFN_NOTICE_WARNING, _("ST-V ROM cache file \"%s\" not saved: %s"), path.c_str(), e.what());
+  return false;
+ }
+}
+#endif
+
+static void MarkMapped(const STVGameInfo* sgi)
+{
+#ifdef MDFN_ENABLE_DEV_BUILD
+ memset(ROM_Mapped, 0x00, sizeof(ROM_Mapped));
+
+ for(size_t i = 0; i < sizeof(sgi->rom_layout) / sizeof(sgi->rom_layout[0]) && sgi->rom_layout[i].size; i++)
+ {
+  const STVROMLayout* rle = &sgi->rom_layout[i];
+
+  memset(ROM_Mapped + (rle->offset >> 1), 0xFF, rle->size >> (rle->map != STV_MAP_BYTE));
+ }
+#endif
+}
+
 static MDFN_HOT void ROM_Read(uint32 A, uint16* DB)
 {
  *DB = *(uint16*)((uint8*)ROM + ((A - 0x2000000) & 0x3FFFFFE));
@@ -120,7 +252,12 @@ static void StateAction(StateMem* sm, const unsigned load, const bool data_only)
 
 static void Kill(void)
 {
- if(ROM)
+ if(ROMCache)
+ {
+  ROMCache.reset();
+  ROM = nullptr;
+ }
+ else if(ROM)
  {
   delete[] ROM;
   ROM = nullptr;
@@ -135,118 +272,135 @@ void CART_STV_Init(CartInfo* c, GameFile* gf, const STVGameInfo* sgi)
  {
   const std::string fname = gf->fbase + (gf->ext.size() ? "." : "") + gf->ext;
   sha256_hasher h;
+  sha256_digest dig;
+  std::string cache_path;
+  sha256_digest cache_key;
 
   ECChip = sgi->ec_chip;
+  MarkMapped(sgi);
 
-  ROM = new uint16[0x3000000 / sizeof(uint16)];
-  memset(ROM, 0xFF, 0x3000000);
-#ifdef MDFN_ENABLE_DEV_BUILD
-  memset(ROM_Mapped, 0x00, sizeof(ROM_Mapped));
-#endif
+#ifdef HAVE_MMAP
+  cache_path = ROMCache_Path(gf, sgi, &cache_key);
 
-  for(size_t i = 0; i < sizeof(sgi->rom_layout) / sizeof(sgi->rom_layout[0]) && sgi->rom_layout[i].size; i++)
+  if(cache_path.size() && ROMCache_Load(cache_path, cache_key, &dig))
+   MDFN_printf(_("ST-V ROM cache: mapped \"%s\".\n"), cache_path.c_str());
+  else
+#endif
   {
-   const STVROMLayout* rle = &sgi->rom_layout[i];
-   const STVROMLayout* prev_rle = i ? &sgi->rom_layout[i - 1] : nullptr;
-   const bool gf_fname_match = !MDFN_strazicmp(fname, rle->fname);
-   const std::string fpath = gf->vfs->eval_fip(gf->dir, gf_fname_match ? fname : rle->fname);
-   const bool prev_match = prev_rle && !strcmp(rle->fname, prev_rle->fname);
-   std::unique_ptr<Stream> ns;
-   Stream* s;
-
-   if(gf_fname_match)
-   {
-    s = gf->stream;
-    s->rewind();
-   }
-   else
+   ROM = new uint16[0x3000000 / sizeof(uint16)];
+   memset(ROM, 0xFF, 0x3000000);
+
+   for(size_t i = 0; i < sizeof(sgi->rom_layout) / sizeof(sgi->rom_layout[0]) && sgi->rom_layout[i].size; i++)
    {
-    ns.reset(gf->vfs->open(fpath, VirtualFS::MODE_READ));
-    s = ns.get();
-   }
+    const STVROMLayout* rle = &sgi->rom_layout[i];
+    const STVROMLayout* prev_rle = i ? &sgi->rom_layout[i - 1] : nullptr;
+    const bool gf_fname_match = !MDFN_strazicmp(fname, rle->fname);
+    const std::string fpath = gf->vfs->eval_fip(gf->dir, gf_fname_match ? fname : rle->fname);
+    const bool prev_match = prev_rle && !strcmp(rle->fname, prev_rle->fname);
+    std::unique_ptr<Stream> ns;
+    Stream* s;
+
+    if(gf_fname_match)
+    {
+     s = gf->stream;
+     s->rewind();
+    }
+    else
+    {
+     ns.reset(gf->vfs->open(fpath, VirtualFS::MODE_READ));
+     s = ns.get();
+    }
 
-#ifdef MDFN_ENABLE_DEV_BUILD
-   memset(ROM_Mapped + (rle->offset >> 1), 0xFF, rle->size >> (rle->map != STV_MAP_BYTE));
-#endif
+    if(prev_match)
+    {
+     assert(rle->size == prev_rle->size);
+     assert(rle->map == prev_rle->map);
 
-   if(prev_match)
-   {
-    assert(rle->size == prev_rle->size);
-    assert(rle->map == prev_rle->map);
+     if(rle->map == STV_MAP_BYTE)
+     {
+      for(uint32 j = 0; j < rle->size; j++)
+      {
+       uint8 tmp = ne16_rbo_be<uint8>(ROM, prev_rle->offset + (j << 1));
 
-    if(rle->map == STV_MAP_BYTE)
+       ne16_wbo_be<uint8>(ROM, rle->offset + (j << 1), tmp); 
+      }
+     }
+     else
+      memmove((uint8*)ROM + rle->offset, (uint8*)ROM + prev_rle->offset, rle->size);
+    }
+    else if(rle->map == STV_MAP_BYTE)
     {
      for(uint32 j = 0; j < rle->size; j++)
      {
-      uint8 tmp = ne16_rbo_be<uint8>(ROM, prev_rle->offset + (j << 1));
+      uint8 tmp;
+
+      if(s->read(&tmp, 1, false) != 1)
+       throw MDFN_Error(0, _("ROM image file %s is %u bytes smaller than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), rle->size - j, rle->size);
+
+      h.process(&tmp, 1);
 
-      ne16_wbo_be<uint8>(ROM, rle->offset + (j << 1), tmp); 
+      ne16_wbo_be<uint8>(ROM, rle->offset + (j << 1), tmp);
      }
     }
     else
-     memmove((uint8*)ROM + rle->offset, (uint8*)ROM + prev_rle->offset, rle->size);
-   }
-   else if(rle->map == STV_MAP_BYTE)
-   {
-    for(uint32 j = 0; j < rle->size; j++)
     {
-     uint8 tmp;
-
-     if(s->read(&tmp, 1, false) != 1)
-      throw MDFN_Error(0, _("ROM image file %s is %u bytes smaller than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), rle->size - j, rle->size);
+     assert(!(rle->offset & 1));
+     assert(!(rle->size & 1));
+     //
+     uint8* dest = (uint8*)ROM + rle->offset;
+     uint32 size = rle->size;
+     uint32 dr;
+
+     if((dr = s->read(dest, size, false)) != size)
+      throw MDFN_Error(0, _("ROM image file %s is %u bytes smaller than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), rle->size - dr, rle->size);
+
+     h.process(dest, size);
+
+     if(rle->map == STV_MAP_16LE)
+      Endian_A16_NE_LE(dest, size >> 1);
+     else
+      Endian_A16_NE_BE(dest, size >> 1);
+    }
 
-     h.process(&tmp, 1);
+    if(!prev_match)
+    {
+     const uint64 extra_data = s->read_discard();
 
-     ne16_wbo_be<uint8>(ROM, rle->offset + (j << 1), tmp);
+     if(extra_data)
+      throw MDFN_Error(0, _("ROM image file %s is %llu bytes larger than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), (unsigned long long)extra_data, rle->size);
     }
    }
-   else
-   {
-    assert(!(rle->offset & 1));
-    assert(!(rle->size & 1));
-    //
-    uint8* dest = (uint8*)ROM + rle->offset;
-    uint32 size = rle->size;
-    uint32 dr;
 
-    if((dr = s->read(dest, size, false)) != size)
-     throw MDFN_Error(0, _("ROM image file %s is %u bytes smaller than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), rle->size - dr, rle->size);
+   if(sgi->romtwiddle == STV_ROMTWIDDLE_SANJEON)
+   {
+    for(uint32 i = 0; i < 0x3000000 / sizeof(uint64); i++)
+    {
+     uint64 tmp = MDFN_densb<uint64>((uint8*)ROM + (i << 3));
 
-    h.process(dest, size);
+     tmp = ~tmp;
+     tmp = ((tmp & 0x0404040404040404ULL) >> 2) | ((tmp & 0x0101010101010101ULL) << 6) | (tmp & 0x2020202020202020ULL) | ((tmp & 0x1010101010101010ULL) >> 3) | ((tmp & 0x4040404040404040ULL) << 1) | ((tmp & 0x0808080808080808ULL) >> 1) | ((tmp & 0x8080808080808080ULL) >> 3) | ((tmp & 0x0202020202020202ULL) << 2);
 
-    if(rle->map == STV_MAP_16LE)
-     Endian_A16_NE_LE(dest, size >> 1);
-    else
-     Endian_A16_NE_BE(dest, size >> 1);
+     MDFN_ennsb<uint64>((uint8*)ROM + (i << 3), tmp);
+    }
    }
 
-   if(!prev_match)
-   {
-    const uint64 extra_data = s->read_discard();
-
-    if(extra_data)
-     throw MDFN_Error(0, _("ROM image file %s is %llu bytes larger than the required size of %u bytes."), gf->vfs->get_human_path(fpath).c_str(), (unsigned long long)extra_data, rle->size);
-   }
-  }
+   dig = h.digest();
 
-  if(sgi->romtwiddle == STV_ROMTWIDDLE_SANJEON)
-  {
-   for(uint32 i = 0; i < 0x3000000 / sizeof(uint64); i++)
+#ifdef HAVE_MMAP
+   if(cache_path.size())
    {
-    uint64 tmp = MDFN_densb<uint64>((uint8*)ROM + (i << 3));
+    uint16* const heap_rom = ROM;
 
-    tmp = ~tmp;
-    tmp = ((tmp & 0x0404040404040404ULL) >> 2) | ((tmp & 0x0101010101010101ULL) << 6) | (tmp & 0x2020202020202020ULL) | ((tmp & 0x1010101010101010ULL) >> 3) | ((tmp & 0x4040404040404040ULL) << 1) | ((tmp & 0x0808080808080808ULL) >> 1) | ((tmp & 0x8080808080808080ULL) >> 3) | ((tmp & 0x0202020202020202ULL) << 2);
-
-    MDFN_ennsb<uint64>((uint8*)ROM + (i << 3), tmp);
+    // Switch to the mapping right away, so the first instance shares its pages too.
+    if(ROMCache_Save(cache_path, cache_key, dig) && ROMCache_Load(cache_path, cache_key, &dig))
+     delete[] heap_rom;
+    else
+     ROM = heap_rom;
    }
+#endif
   }
 
-  {
-   sha256_digest dig = h.digest();
-
-   memcpy(MDFNGameInfo->MD5, dig.data(), 16);
-  }
+  memcpy(MDFNGameInfo->MD5, dig.data(), 16);
 
   SS_SetPhysMemMap (0x02000000, 0x04FFFFFF, ROM, 0x3000000, false);
   c->CS01_SetRW8W16(0x02000000, 0x04FFFFFF, ROM_Read, Write<uint8>, Write<uint16>);
@@ -137,6 +137,7 @@
 #include "scu.h"
 #include "sound.h"
 #include "cdb.h"
+#include "bin_trace.h"
 
 #include <mednafen/cdrom/CDUtility.h>
 #include <mednafen/cdrom/CDInterface.h>
@@ -147,6 +148,8 @@ namespace MDFN_IEN_SS
 
 // Defined in ss.cpp — per-instruction trace line counter
 extern void Automation_UnifiedLineWritten(void);
+extern int64_t Automation_GetCycleBase(void);
+extern void Automation_RecentEvent(int64 cycle, const char* text);
 
 static void CheckBufPauseResume(void);
 static void StartSeek(const uint32 cmd_target, const uint32 cur_play_end = 0x800000, const uint32 cur_play_repeat = 0, const uint32 play_end_irq_type = 0, const bool no_pickup_change = false);
@@ -540,11 +543,26 @@ static CDUtility::TOC toc;
 static sscpu_timestamp_t lastts;
 static FILE* scdq_trace_file = NULL;
 static FILE* cdb_trace_file = NULL;
+static BinTrace* cdb_trace_bin = NULL;	// binary unified trace, alternative to cdb_trace_file
+static bool cdb_recent = false;		// trace lines also go to the crash bundle's recent event ring
+#define CDB_TRACING (cdb_trace_file || cdb_trace_bin || cdb_recent)
 static int32 CommandPhase;
 //static bool CommandYield;
 static int64 CommandClockCounter;
 static uint32 CDB_ClockRatio;
 
+//
+// Fast-load: seeks and data sector reads take 1/8 of their normal drive time; CD-DA plays in real time.  The order of
+// sector buffering, the per-sector status checks and HIRQ bits is unchanged, only the spacing between them shrinks.
+//
+static bool FastLoad;
+enum : unsigned { FastLoad_Shift = 3 };
+
+static INLINE int64 DataDelay(int64 t)
+{
+ return FastLoad ? (t >> FastLoad_Shift) : t;
+}
+
 static struct
 {
  uint8 Command;
@@ -631,9 +649,36 @@ static const char* DrivePhase_Name(int phase)
  }
 }
 
+// One CD Block event line, "<lastts> <text>", to whichever trace sink is open, and to the
+// recent event ring if that's on.
+static void CDBTrace_Printf(const char* format, ...) MDFN_FORMATSTR(gnu_printf, 1, 2);
+static void CDBTrace_Printf(const char* format, ...)
+{
+ char line[256];
+ va_list ap;
+
+ va_start(ap, format);
+ int n = vsnprintf(line, sizeof(line), format, ap);
+ va_end(ap);
+
+ if(n < 0)
+  return;
+
+ if(cdb_recent)
+  Automation_RecentEvent(Automation_GetCycleBase() + lastts, line);
+
+ if(cdb_trace_file)
+  fprintf(cdb_trace_file, "%u %s\n", (unsigned)lastts, line);
+ else if(cdb_trace_bin)
+  cdb_trace_bin->Text(BinTrace::REC_CDB, lastts, line, std::min<size_t>(n, sizeof(line) - 1));
+ else
+  return;
+ Automation_UnifiedLineWritten();
+}
+
 static void CDBTrace_HIRQ(const char* tag, unsigned old_hirq, unsigned new_hirq)
 {
- if(MDFN_UNLIKELY(cdb_trace_file))
+ if(MDFN_UNLIKELY(CDB_TRACING))
  {
   unsigned changed = old_hirq ^ new_hirq;
   char bits[128];
@@ -652,36 +697,143 @@ static void CDBTrace_HIRQ(const char* tag, unsigned old_hirq, unsigned new_hirq)
   if(changed & HIRQ_MPED) strcat(bits, " MPED");
   if(changed & HIRQ_MPCM) strcat(bits, " MPCM");
   if(changed & HIRQ_MPST) strcat(bits, " MPST");
-  fprintf(cdb_trace_file, "%u IRQ %s 0x%04X->0x%04X%s\n",
-    (unsigned)lastts, tag, old_hirq, new_hirq, bits);
-  Automation_UnifiedLineWritten();
+  CDBTrace_Printf("IRQ %s 0x%04X->0x%04X%s", tag, old_hirq, new_hirq, bits);
  }
 }
 
 static void CDBTrace_DrivePhase(int old_phase, int new_phase)
 {
- if(MDFN_UNLIKELY(cdb_trace_file))
+ if(MDFN_UNLIKELY(CDB_TRACING))
  {
-  fprintf(cdb_trace_file, "%u DRV %s->%s sector=%u free=%d\n",
-    (unsigned)lastts, DrivePhase_Name(old_phase), DrivePhase_Name(new_phase),
+  CDBTrace_Printf("DRV %s->%s sector=%u free=%d", DrivePhase_Name(old_phase), DrivePhase_Name(new_phase),
     CurSector, FreeBufferCount);
-  Automation_UnifiedLineWritten();
  }
 }
 
 static void CDBTrace_Buf(const char* op, uint8 bfi, uint32 fad)
 {
- if(MDFN_UNLIKELY(cdb_trace_file))
+ if(MDFN_UNLIKELY(CDB_TRACING))
  {
-  fprintf(cdb_trace_file, "%u BUF %s idx=%d fad=0x%06X free=%d\n",
-    (unsigned)lastts, op, bfi, fad, FreeBufferCount);
-  Automation_UnifiedLineWritten();
+  CDBTrace_Printf("BUF %s idx=%d fad=0x%06X free=%d", op, bfi, fad, FreeBufferCount);
  }
 }
 
+//
+// Automation: CD Block profile(cdb_profile_start). Issue->result latency per command code, time in
+// each drive phase and time at each free buffer count, plus an optional binary event file. Times
+// are absolute master cycles: the cycle base plus lastts inside CDB_Update(), or plus
+// SH7095_mem_timestamp for command register writes.
+//
+enum { CDBProf_PhaseCount = DRIVEPHASE_PAUSE + 1, CDBProf_HistBuckets = 32 };
+struct CDBProfCmd
+{
+ uint64 count;
+ uint64 total;
+ uint64 min, max;
+ uint32 hist[CDBProf_HistBuckets];	// bucket n: latency in [2^n, 2^(n+1)), bucket 0 also 0
+};
+static bool cdbprof_active = false;
+static TraceRing* cdbprof_ring = NULL;
+static CDBProfCmd cdbprof_cmd[256];
+static uint64 cdbprof_phase_cycles[CDBProf_PhaseCount];
+static uint64 cdbprof_phase_entries[CDBProf_PhaseCount];
+static uint64 cdbprof_free_cycles[NumBuffers + 1];
+static int64 cdbprof_start_ts;
+static int64 cdbprof_issue_ts;
+static int cdbprof_issue_cmd;	// -1 = none pending
+static int64 cdbprof_phase_ts;
+static int32 cdbprof_phase;
+static int64 cdbprof_free_ts;
+static unsigned cdbprof_free;
+static uint64 cdbprof_records;
+
+// 16-byte record: le64 cycle, u8 type, u8 a, le16 b, le32 c.
+//  0 command issued  a = command, b = HIRQ
+//  1 command result  a = command, b = HIRQ, c = latency(saturated)
+//  2 drive phase     a = new phase, b = old phase, c = cycles spent in the old one(saturated)
+//  3 buffer          a = 0 alloc / 1 free, b = free buffers after it, c = FAD(alloc)
+static void CDBProf_Record(int64 ts, unsigned type, unsigned a, unsigned b, uint64 c)
+{
+ uint8 rec[16];
+
+ if(!cdbprof_ring)
+  return;
+
+ MDFN_en64lsb(&rec[0], ts);
+ rec[8] = type;
+ rec[9] = a;
+ MDFN_en16lsb(&rec[10], b);
+ MDFN_en32lsb(&rec[12], std::min<uint64>(c, 0xFFFFFFFF));
+ cdbprof_ring->Write(rec, sizeof(rec));
+ cdbprof_records++;
+}
+
+static void CDBProf_Issue(void)
+{
+ const int64 ts = Automation_GetCycleBase() + SH7095_mem_timestamp;
+
+ cdbprof_issue_ts = ts;
+ cdbprof_issue_cmd = CData[0] >> 8;
+ CDBProf_Record(ts, 0, cdbprof_issue_cmd, HIRQ, 0);
+}
+
+static void CDBProf_Result(void)
+{
+ const int64 ts = Automation_GetCycleBase() + lastts;
+ const uint64 lat = std::max<int64>(0, ts - cdbprof_issue_ts);
+
+ if(cdbprof_issue_cmd < 0)
+  return;
+
+ CDBProfCmd& c = cdbprof_cmd[cdbprof_issue_cmd];
+
+ if(!c.count || lat < c.min)
+  c.min = lat;
+ c.max = std::max<uint64>(c.max, lat);
+ c.total += lat;
+ c.count++;
+ c.hist[lat ? std::min<unsigned>(CDBProf_HistBuckets - 1, 63 - MDFN_lzcount64(lat)) : 0]++;
+ CDBProf_Record(ts, 1, cdbprof_issue_cmd, HIRQ, lat);
+ cdbprof_issue_cmd = -1;
+}
+
+static void CDBProf_DrivePhase(int32 new_phase)
+{
+ const int64 ts = Automation_GetCycleBase() + lastts;
+ const uint64 spent = std::max<int64>(0, ts - cdbprof_phase_ts);
+
+ if(new_phase == cdbprof_phase)
+  return;
+
+ if((uint32)cdbprof_phase < CDBProf_PhaseCount)
+  cdbprof_phase_cycles[cdbprof_phase] += spent;
+ if((uint32)new_phase < CDBProf_PhaseCount)
+  cdbprof_phase_entries[new_phase]++;
+ CDBProf_Record(ts, 2, new_phase, cdbprof_phase, spent);
+ cdbprof_phase = new_phase;
+ cdbprof_phase_ts = ts;
+}
+
+// Also brings the occupancy totals up to ts for Automation-side reads.
+static void CDBProf_FreeCount(int64 ts)
+{
+ cdbprof_free_cycles[std::min<unsigned>(cdbprof_free, NumBuffers)] += std::max<int64>(0, ts - cdbprof_free_ts);
+ cdbprof_free = FreeBufferCount;
+ cdbprof_free_ts = ts;
+}
+
+static void CDBProf_Buf(bool is_free, uint32 fad)
+{
+ const int64 ts = Automation_GetCycleBase() + lastts;
+
+ CDBProf_FreeCount(ts);
+ CDBProf_Record(ts, 3, is_free, FreeBufferCount, fad);
+}
+
 #define SET_DRIVE_PHASE(new_ph) do { \
- if(MDFN_UNLIKELY(cdb_trace_file)) CDBTrace_DrivePhase(DrivePhase, (new_ph)); \
+ if(MDFN_UNLIKELY(CDB_TRACING)) CDBTrace_DrivePhase(DrivePhase, (new_ph)); \
  DrivePhase = (new_ph); \
+ if(MDFN_UNLIKELY(cdbprof_active)) CDBProf_DrivePhase(DrivePhase); \
 } while(0)
 
 
@@ -823,9 +975,12 @@ static uint8 Buffer_Allocate(const bool zero_clear)
 
  FreeBufferCount--;
 
- if(MDFN_UNLIKELY(cdb_trace_file))
+ if(MDFN_UNLIKELY(CDB_TRACING))
   CDBTrace_Buf("ALLOC", bfsidx, CurPosInfo.fad);
 
+ if(MDFN_UNLIKELY(cdbprof_active))
+  CDBProf_Buf(false, CurPosInfo.fad);
+
  //
  Buffers[bfsidx].Prev = 0xFF;
  Buffers[bfsidx].Next = 0xFF;
@@ -852,8 +1007,11 @@ static void Buffer_Free(const uint8 bfsidx)
  FreeBufferCount++;
  FirstFreeBuf = bfsidx;
 
- if(MDFN_UNLIKELY(cdb_trace_file))
+ if(MDFN_UNLIKELY(CDB_TRACING))
   CDBTrace_Buf("FREE", bfsidx, 0);
+
+ if(MDFN_UNLIKELY(cdbprof_active))
+  CDBProf_Buf(true, 0);
 }
 
 static void Partition_LinkBuffer(const unsigned pnum, const unsigned bfsidx)
@@ -1520,6 +1678,11 @@ void CDB_SetClockRatio(uint32 ratio)
  CDB_ClockRatio = ratio;
 }
 
+void CDB_SetFastLoad(bool enabled)
+{
+ FastLoad = enabled;
+}
+
 static void SWReset(void)
 {
  GetSecLen = SECLEN_2048;
@@ -1730,7 +1893,7 @@ static INLINE void TriggerIRQ(unsigned bs)
  unsigned old_hirq = HIRQ;
  HIRQ |= bs;
 
- if(MDFN_UNLIKELY(cdb_trace_file) && (old_hirq != HIRQ))
+ if(MDFN_UNLIKELY(CDB_TRACING) && (old_hirq != HIRQ))
   CDBTrace_HIRQ("SET", old_hirq, HIRQ);
 
  RecalcIRQOut();
@@ -1958,6 +2121,9 @@ static void CDStatusResults(const bool rejected = false, const uint8 hb = 0)
  CommandPending = false;
  TriggerIRQ(HIRQ_CMOK | SWResetHIRQDeferred);
  SWResetHIRQDeferred = 0;
+
+ if(MDFN_UNLIKELY(cdbprof_active))
+  CDBProf_Result();
 }
 
 static void BasicResults(uint32 res0, uint32 res1, uint32 res2, uint32 res3)
@@ -1973,6 +2139,9 @@ static void BasicResults(uint32 res0, uint32 res1, uint32 res2, uint32 res3)
  CommandPending = false;
  TriggerIRQ(HIRQ_CMOK | SWResetHIRQDeferred);
  SWResetHIRQDeferred = 0;
+
+ if(MDFN_UNLIKELY(cdbprof_active))
+  CDBProf_Result();
 }
 
 //
@@ -2034,6 +2203,23 @@ static void SeekStart1(void)
  }
 }
 
+// FAD at which CheckEndMet() will end the current play range, for read-ahead hinting only;
+// track/index ends are rounded up to the start of the next track.
+static uint32 GetPlayEndFAD(void)
+{
+ const uint32 leadout_fad = 150 + toc.tracks[100].lba;
+
+ if(!CurPlayEnd)
+  return leadout_fad;
+
+ if(CurPlayEnd & 0x800000)
+  return std::min<uint32>(leadout_fad, CurPlayEnd & 0x7FFFFF);
+
+ const unsigned end_track = std::min<unsigned>(toc.last_track, std::max<unsigned>(toc.first_track, (CurPlayEnd >> 8) & 0xFF));
+
+ return (end_track < toc.last_track) ? 150 + toc.tracks[end_track + 1].lba : leadout_fad;
+}
+
 static void SeekStart2(int delay_sub = 0)
 {
  CurPosInfo.status = STATUS_BUSY;
@@ -2041,9 +2227,9 @@ static void SeekStart2(int delay_sub = 0)
  CurPosInfo.repcount = PlayRepeatCounter & 0xF;
  SET_DRIVE_PHASE(DRIVEPHASE_SEEK_START3);
 
- Cur_CDIF->HintReadSector(CurPosInfo.fad - 150);
+ Cur_CDIF->HintReadRange(CurPosInfo.fad - 150, (int32)GetPlayEndFAD() - 150);
 
- DriveCounter = (int64)(256000 - delay_sub) << 32;
+ DriveCounter = DataDelay((int64)(256000 - delay_sub) << 32);
  SeekIndexPhase = 0;
 }
 
@@ -2098,6 +2284,8 @@ static void StartSeek(const uint32 cmd_target, const uint32 cur_play_end, const
 
  CurPosInfo.status = STATUS_BUSY;
  DrivePhase = no_pickup_change ? DRIVEPHASE_SEEK_START2 : DRIVEPHASE_SEEK_START1;
+ if(MDFN_UNLIKELY(cdbprof_active))
+  CDBProf_DrivePhase(DrivePhase);
  PeriodicIdleCounter = PeriodicIdleCounter_Reload;
  DriveCounter = (int64)SeekCPIUpdateDelay << 32;
 }
@@ -2299,7 +2487,7 @@ static void Drive_Run(int64 clocks)
 
 	 CurPosInfo.status = STATUS_SEEK;
 	 SET_DRIVE_PHASE(DRIVEPHASE_SEEK);
-	 DriveCounter += (int64)seek_time << 32;
+	 DriveCounter += DataDelay((int64)seek_time << 32);
 	 CurSector = CurPosInfo.fad;
 	 SubQBuf_Safe_Valid = false;
 	}
@@ -2320,7 +2508,7 @@ static void Drive_Run(int64 clocks)
 	 if(!SubQBuf_Safe_Valid)
          {
 	  CurSector++;
-	  DriveCounter += (int64)((44100 * 256) / 150) << 32;
+	  DriveCounter += DataDelay((int64)((44100 * 256) / 150) << 32);
          }
 	 else
 	 {
@@ -2342,13 +2530,13 @@ static void Drive_Run(int64 clocks)
 	    {
 	     index_ok = false;
 	     CurSector += 4;
-	     DriveCounter += (int64)((44100 * 256) / 150) << 32;
+	     DriveCounter += DataDelay((int64)((44100 * 256) / 150) << 32);
 	    }
 	    else
 	    {
 	     index_ok = false;
 	     CurSector += 128;
-	     DriveCounter += (int64)((44100 * 256) / 150) << 32;
+	     DriveCounter += DataDelay((int64)((44100 * 256) / 150) << 32);
 	     SeekIndexPhase = 1;
 	    }
 	   }
@@ -2358,7 +2546,7 @@ static void Drive_Run(int64 clocks)
 	    {
 	     index_ok = false;
 	     CurSector -= 124;
-	     DriveCounter += (int64)((44100 * 256) / 150) << 32;
+	     DriveCounter += DataDelay((int64)((44100 * 256) / 150) << 32);
 	     SeekIndexPhase = 2;
 	    }
 	   }
@@ -2368,7 +2556,7 @@ static void Drive_Run(int64 clocks)
 	  {
 	   PlaySectorProcessed = false;
 	   SET_DRIVE_PHASE(DRIVEPHASE_PLAY);
-	   DriveCounter += (int64)((44100 * 256) / ((SubQBuf_Safe[0] & 0x40) ? 150 : 75)) << 32;
+	   DriveCounter += (SubQBuf_Safe[0] & 0x40) ? DataDelay((int64)((44100 * 256) / 150) << 32) : ((int64)((44100 * 256) / 75) << 32);
 
 #if 0
 	   if(!Cur_CDIF->NonDeterministic_CheckSectorReady(CurSector - 150))
@@ -2450,7 +2638,7 @@ static void Drive_Run(int64 clocks)
 	} // end if(SecPreBuf_In > 0)
 	// Fallthrough:
     case DRIVEPHASE_PAUSE:
-        PeriodicIdleCounter = 17712LL << 32;
+        PeriodicIdleCounter = (SubQBuf_Safe[0] & 0x40) ? DataDelay(17712LL << 32) : (17712LL << 32);
 
 	if(SecPreBuf_In)
 	{
@@ -2475,7 +2663,7 @@ static void Drive_Run(int64 clocks)
 	 }
 	}
 
-	DriveCounter += (int64)((44100 * 256) / ((SubQBuf_Safe[0] & 0x40) ? 150 : 75)) << 32;
+	DriveCounter += (SubQBuf_Safe[0] & 0x40) ? DataDelay((int64)((44100 * 256) / 150) << 32) : ((int64)((44100 * 256) / 75) << 32);
 	break;
    }
   }
@@ -2662,6 +2850,142 @@ void CDB_ClearCDBTraceFile(void)
  cdb_trace_external = false;
 }
 
+void CDB_SetCDBTraceBin(BinTrace* bt)
+{
+ cdb_trace_bin = bt;
+}
+
+void CDB_SetRecentEvents(bool on)
+{
+ cdb_recent = on;
+}
+
+uint64 CDB_ProfileStop(uint64* records)
+{
+ uint64 dropped = 0;
+
+ if(cdbprof_ring)
+ {
+  dropped = cdbprof_ring->Dropped();
+  delete cdbprof_ring;	// drains the ring
+  cdbprof_ring = NULL;
+ }
+ if(records)
+  *records = cdbprof_records;
+ cdbprof_active = false;
+ return dropped;
+}
+
+// path may be NULL(counters only). File: "MDFNCDP1", le32 flags(bit 0 zlib), then the
+// 16-byte records described at CDBProf_Record().
+bool CDB_ProfileStart(const char* path, bool zlib)
+{
+ const int64 ts = Automation_GetCycleBase() + lastts;
+
+ CDB_ProfileStop(NULL);
+
+ if(path)
+ {
+  FILE* f = fopen(path, "wb");
+  uint8 header[12];
+
+  if(!f)
+   return false;
+
+  memcpy(header, "MDFNCDP1", 8);
+  MDFN_en32lsb(&header[8], zlib);
+  fwrite(header, 1, sizeof(header), f);
+  cdbprof_ring = new TraceRing(f, true, TraceRing::Default_Capacity, zlib);
+ }
+ memset(cdbprof_cmd, 0, sizeof(cdbprof_cmd));
+ memset(cdbprof_phase_cycles, 0, sizeof(cdbprof_phase_cycles));
+ memset(cdbprof_phase_entries, 0, sizeof(cdbprof_phase_entries));
+ memset(cdbprof_free_cycles, 0, sizeof(cdbprof_free_cycles));
+ cdbprof_start_ts = ts;
+ cdbprof_issue_cmd = -1;	// a command already in flight has no issue time
+ cdbprof_phase = DrivePhase;
+ cdbprof_phase_ts = ts;
+ cdbprof_free = FreeBufferCount;
+ cdbprof_free_ts = ts;
+ cdbprof_records = 0;
+ cdbprof_active = true;
+ return true;
+}
+
+bool CDB_ProfileIsActive(void) { return cdbprof_active; }
+
+// Totals since CDB_ProfileStart() as text: a "cmd" line per command code seen(latency count,
+// mean, min, max and the nonzero log2 histogram buckets), a "phase" line per drive phase and
+// a "free" line per free buffer count that was held, with cycles and share of the elapsed time.
+bool CDB_ProfileDump(const char* path, uint64* commands)
+{
+ const int64 ts = Automation_GetCycleBase() + lastts;
+ const uint64 elapsed = std::max<int64>(1, ts - cdbprof_start_ts);
+ uint64 phase_cycles[CDBProf_PhaseCount];
+ uint64 ncmd = 0;
+ double used_sum = 0;
+ FILE* fp;
+
+ if(!(fp = fopen(path, "w")))
+  return false;
+
+ CDBProf_FreeCount(ts);
+ memcpy(phase_cycles, cdbprof_phase_cycles, sizeof(phase_cycles));
+ if((uint32)cdbprof_phase < CDBProf_PhaseCount)
+  phase_cycles[cdbprof_phase] += std::max<int64>(0, ts - cdbprof_phase_ts);
+
+ fprintf(fp, "# CD Block profile: %llu cycles\n", (unsigned long long)elapsed);
+ for(unsigned cmd = 0; cmd < 256; cmd++)
+ {
+  const CDBProfCmd& c = cdbprof_cmd[cmd];
+  const uint16 cd[4] = { (uint16)(cmd << 8), 0, 0, 0 };
+  char name[128];
+
+  if(!c.count)
+   continue;
+
+  GetCommandDetails(cd, name, sizeof(name));
+  if(char* semi = strchr(name, ';'))
+   *semi = 0;
+  bool first = true;
+
+  fprintf(fp, "cmd 0x%02X count=%llu mean=%llu min=%llu max=%llu hist=", cmd, (unsigned long long)c.count,
+	(unsigned long long)(c.total / c.count), (unsigned long long)c.min, (unsigned long long)c.max);
+  for(unsigned b = 0; b < CDBProf_HistBuckets; b++)
+  {
+   if(c.hist[b])
+   {
+    fprintf(fp, "%s%u:%u", first ? "" : ",", b, c.hist[b]);
+    first = false;
+   }
+  }
+  fprintf(fp, " %s\n", name);
+  ncmd += c.count;
+ }
+
+ for(unsigned p = 0; p < CDBProf_PhaseCount; p++)
+ {
+  if(phase_cycles[p] || cdbprof_phase_entries[p])
+   fprintf(fp, "phase %s cycles=%llu share=%.2f%% entries=%llu\n", DrivePhase_Name(p), (unsigned long long)phase_cycles[p],
+	100.0 * phase_cycles[p] / elapsed, (unsigned long long)cdbprof_phase_entries[p]);
+ }
+
+ for(unsigned n = 0; n <= NumBuffers; n++)
+ {
+  if(!cdbprof_free_cycles[n])
+   continue;
+
+  fprintf(fp, "free %u cycles=%llu share=%.2f%%\n", n, (unsigned long long)cdbprof_free_cycles[n], 100.0 * cdbprof_free_cycles[n] / elapsed);
+  used_sum += (double)(NumBuffers - n) * cdbprof_free_cycles[n];
+ }
+ fprintf(fp, "buffers mean_used=%.2f of %u\n", used_sum / elapsed, (unsigned)NumBuffers);
+ fclose(fp);
+
+ if(commands)
+  *commands = ncmd;
+ return true;
+}
+
 void CDB_GetCDDA(uint16* outbuf)
 {
  outbuf[0] = outbuf[1] = 0;
@@ -2742,14 +3066,12 @@ sscpu_timestamp_t CDB_Update(sscpu_timestamp_t timestamp)
      GetCommandDetails(CTR.CD, cdet, sizeof(cdet));
      SS_DBG(SS_DBG_CDB, "[CDB] Command: %s --- HIRQ=0x%04x, HIRQ_Mask=0x%04x --- %u\n", cdet, HIRQ, HIRQ_Mask, timestamp);
     }
-    if(MDFN_UNLIKELY(cdb_trace_file))
+    if(MDFN_UNLIKELY(CDB_TRACING))
     {
      char cdet[128];
      GetCommandDetails(CTR.CD, cdet, sizeof(cdet));
-     fprintf(cdb_trace_file, "%u CMD %s HIRQ=0x%04X drv=%s status=%d fad=0x%06X free=%d\n",
-       (unsigned)lastts, cdet, HIRQ, DrivePhase_Name(DrivePhase),
+     CDBTrace_Printf("CMD %s HIRQ=0x%04X drv=%s status=%d fad=0x%06X free=%d", cdet, HIRQ, DrivePhase_Name(DrivePhase),
        (int)CurPosInfo.status, CurPosInfo.fad, FreeBufferCount);
-     Automation_UnifiedLineWritten();
     }
     //
     //
@@ -4080,6 +4402,9 @@ sscpu_timestamp_t CDB_Update(sscpu_timestamp_t timestamp)
 
      ResultsRead = false;
      CommandPending = false;
+
+     if(MDFN_UNLIKELY(cdbprof_active))
+      CDBProf_Result();
     }
 
     if(ResetSelPending)
@@ -4355,7 +4680,7 @@ void CDB_Write_DBM(uint32 offset, uint16 DB, uint16 mask)
 	{
 	 unsigned old_hirq = HIRQ;
 	 HIRQ = HIRQ & (DB | ~mask);
-	 if(MDFN_UNLIKELY(cdb_trace_file) && (old_hirq != HIRQ))
+	 if(MDFN_UNLIKELY(CDB_TRACING) && (old_hirq != HIRQ))
 	  CDBTrace_HIRQ("CLR", old_hirq, HIRQ);
 	 RecalcIRQOut();
 	}
@@ -4384,6 +4709,9 @@ void CDB_Write_DBM(uint32 offset, uint16 DB, uint16 mask)
 	{
 	 CommandPending = true;
 	 nt = SH7095_mem_timestamp + 1;
+
+	 if(MDFN_UNLIKELY(cdbprof_active))
+	  CDBProf_Issue();
 	}
 	break;
  }
@@ -4395,6 +4723,7 @@ void CDB_Write_DBM(uint32 offset, uint16 DB, uint16 mask)
 
 void CDB_StateAction(StateMem* sm, const unsigned load, const bool data_only)
 {
+ bool state_fast_load = load ? false : FastLoad;
  SFORMAT StateRegs[] =
  {
   SFVAR(GetSecLen),
@@ -4572,6 +4901,8 @@ void CDB_StateAction(StateMem* sm, const unsigned load, const bool data_only)
   SFVAR(FLS.record),
   SFVAR(FLS.record_counter),
 
+  SFVAR(state_fast_load),
+
   SFEND
  };
 
@@ -4579,6 +4910,9 @@ void CDB_StateAction(StateMem* sm, const unsigned load, const bool data_only)
 
  if(load)
  {
+  if(state_fast_load != FastLoad)
+   MDFN_Notify(MDFN_NOTICE_WARNING, _("Save state was made with CD fast-load %s, but it is currently %s; CD timing will not match the run that made the state."), state_fast_load ? _("enabled") : _("disabled"), FastLoad ? _("enabled") : _("disabled"));
+
   if(load < 0x00102600)
   {
    if(DrivePhase == DRIVEPHASE_PLAY && SecPreBuf_In)
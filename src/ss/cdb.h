@@ -43,6 +43,7 @@ void CDB_GetCDDA(uint16* outbuf);	// writes to outbuf[0] and outbuf[1]
 
 
 void CDB_SetClockRatio(uint32 ratio);
+void CDB_SetFastLoad(bool enabled);
 void CDB_ResetCD(void);
 void CDB_SetCDActive(bool active);
 
@@ -72,6 +73,9 @@ void CDB_EnableCDBTrace(const char* path);
 void CDB_DisableCDBTrace(void);
 void CDB_SetCDBTraceFile(FILE* f);
 void CDB_ClearCDBTraceFile(void);
+class BinTrace;
+void CDB_SetCDBTraceBin(BinTrace* bt);
+void CDB_SetRecentEvents(bool on);	// CDB trace lines to Automation_RecentEvent()
 
 }
 
@@ -496,6 +496,39 @@ uint32 DB_LookupHH(const char* sgid, const uint8* fd_id)
  return 0;
 }
 
+static const struct
+{
+ const char* sgid;
+ PerfHints hints;
+ const char* game_name;
+ const char* purpose;
+ uint8 fd_id[16];
+} perfdb[] =
+{
+ { "GS-9126",	{ 0x3, 64, false },	"Fighters Megamix (Japan)", gettext_noop("Keeps CD fast-load off; the hang after FMV playback is timing-sensitive.") },
+ { "MK-81073",	{ 0x3, 64, false },	"Fighters Megamix (Europe/USA)", gettext_noop("Keeps CD fast-load off; the hang after FMV playback is timing-sensitive.") },
+
+ { "T-36102G",	{ 0x3, 0, true },	"Whizz (Japan)", gettext_noop("Keeps exact slave CPU sync; the startup hangs fixed by full cache emulation are timing-sensitive.") },
+ { "T-9515H-50",{ 0x3, 0, true },	"Whizz (Europe)", gettext_noop("Keeps exact slave CPU sync; the startup hangs fixed by full cache emulation are timing-sensitive.") },
+
+ { "T-28004G",	{ 0x3, 64, false },	"Yu-No (Japan)", gettext_noop("Keeps CD fast-load off; FMV length is timing-sensitive.") },
+
+ { "T-6006G",	{ 0x0, 0, false },	"Thunderhawk II (Japan)", gettext_noop("Keeps all speed settings off; already prone to timing-related hangs.") },
+ { "T-11501H00",{ 0x0, 0, false },	"Thunderstrike II (USA)", gettext_noop("Keeps all speed settings off; already prone to timing-related hangs.") },
+};
+
+void DB_LookupPerf(const char* sgid, const uint8* fd_id, PerfHints* const hints)
+{
+ for(auto& pe : perfdb)
+ {
+  if((pe.sgid && !strcmp(pe.sgid, sgid)) || (!pe.sgid && !memcmp(pe.fd_id, fd_id, 16)))
+  {
+   *hints = pe.hints;
+   break;
+  }
+ }
+}
+
 //
 //
 //
@@ -1994,6 +2027,36 @@ void DB_GetInternalDB(std::vector<GameDB_Database>* databases)
   e.Setting = sv;
   e.Purpose = hh.purpose ? _(hh.purpose) : "";
 
+  databases->back().Entries.push_back(e);
+ }
+ //
+ //
+ //
+ databases->push_back({
+	"perfprofile",
+	gettext_noop("Performance Profile"),
+	gettext_noop("This database is used when the \"\5ss.perf_profile\" setting is enabled, to keep idle loop skipping, a coarser slave CPU sync quantum or CD fast-load off for games they're known or likely to affect.  Games not listed get idle loop skipping on both CPUs, a slave CPU sync quantum of 64 cycles(only used with full cache emulation) and CD fast-load.  The individual settings still enable each of these regardless.")
+	});
+ for(auto& pe : perfdb)
+ {
+  std::string sv;
+  GameDB_Entry e;
+
+  if(pe.hints.idle_skip)
+   sv += (pe.hints.idle_skip == 0x3) ? _("Idle skip; ") : ((pe.hints.idle_skip & 1) ? _("Idle skip(master); ") : _("Idle skip(slave); "));
+
+  if(pe.hints.slave_quantum)
+   sv += _("Slave sync quantum ") + std::to_string(pe.hints.slave_quantum) + "; ";
+
+  if(pe.hints.fast_load)
+   sv += _("CD fast-load; ");
+
+  e.GameID = pe.sgid ? pe.sgid : FDIDToString(pe.fd_id);
+  e.GameIDIsHash = !pe.sgid;
+  e.Name = pe.game_name;
+  e.Setting = sv.size() ? sv.substr(0, sv.size() - 2) : _("None");
+  e.Purpose = pe.purpose ? _(pe.purpose) : "";
+
   databases->back().Entries.push_back(e);
  }
 }
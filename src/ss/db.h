@@ -36,6 +36,16 @@ enum
 void DB_Lookup(const char* path, const char* sgid, const char* sgname, const char* sgarea, const uint8* fd_id, unsigned* const region, int* const cart_type, unsigned* const cpucache_emumode);
 uint32 DB_LookupHH(const char* sgid, const uint8* fd_id);
 
+// Speed settings "ss.perf_profile" turns on for a game; games not in the database keep what the caller passes in.
+struct PerfHints
+{
+ unsigned idle_skip;		// CPUs to skip idle loops on; bit 0 = master, bit 1 = slave
+ unsigned slave_quantum;	// ss.sh2.slave_quantum value, 0 = exact
+ bool fast_load;		// CD fast-load
+};
+
+void DB_LookupPerf(const char* sgid, const uint8* fd_id, PerfHints* const hints);
+
 struct STVROMLayout
 {
  uint32 offset;
@@ -0,0 +1,90 @@
+/* flight_rec.h -- In-memory "flight recorder" of the last instructions
+ *
+ * A fixed power-of-two ring per CPU, written from SH7095::Step() with one
+ * store per field and no I/O, so it can stay on for a whole session. Each
+ * entry is the absolute cycle, PC and opcode of an instruction; with memory
+ * recording, MemRead/MemWrite also stamp the instruction's last data access
+ * (address, size, read/write) into the newest entry. Nothing leaves memory
+ * until the driver dumps the ring (flight_rec_dump, or automatically on an
+ * exception or breakpoint pause).
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_FLIGHT_REC_H
+#define __MDFN_SS_FLIGHT_REC_H
+
+#include <mednafen/types.h>
+#include <cstdlib>
+
+namespace MDFN_IEN_SS
+{
+
+class FlightRec
+{
+ public:
+
+ struct Entry
+ {
+  int64 cycle;
+  uint32 pc;
+  uint32 addr;		// last data access, if access != 0
+  uint16 opcode;
+  uint8 access;		// bits 0-2: size in bytes (0 = none), bit 3: write
+ };
+
+ enum : uint8 { ACCESS_WRITE = 0x08 };
+
+ // "entries" is rounded up to a power of two.
+ FlightRec(size_t entries)
+ {
+  size_t cap = 1;
+  while(cap < entries)
+   cap <<= 1;
+  mask = cap - 1;
+  ring = (Entry*)calloc(cap, sizeof(Entry));
+  pos = 0;
+ }
+
+ ~FlightRec()
+ {
+  free(ring);
+ }
+
+ INLINE void Insn(int64 cycle, uint32 pc, uint16 opcode)
+ {
+  Entry* e = &ring[pos & mask];
+
+  e->cycle = cycle;
+  e->pc = pc;
+  e->opcode = opcode;
+  e->access = 0;
+  pos++;
+ }
+
+ INLINE void Access(uint32 addr, unsigned size, bool write)
+ {
+  Entry* e = &ring[(pos - 1) & mask];
+
+  e->addr = addr;
+  e->access = size | (write ? ACCESS_WRITE : 0);
+ }
+
+ size_t Capacity(void) const { return mask + 1; }
+ uint64 Total(void) const { return pos; }	// instructions recorded since creation or Clear()
+ size_t Count(void) const { return (pos > mask) ? mask + 1 : pos; }
+
+ // i = 0 is the oldest entry still held, Count() - 1 the newest.
+ const Entry& Get(size_t i) const { return ring[(pos - Count() + i) & mask]; }
+
+ void Clear(void) { pos = 0; }
+
+ private:
+
+ Entry* ring;
+ size_t mask;
+ uint64 pos;
+};
+
+}
+#endif
@@ -0,0 +1,57 @@
+/* hotmem.h -- One arena for the hot emulated-memory arrays
+ *
+ * Work RAM, the BIOS ROM image, the SH-2 fast map, VDP1 VRAM and framebuffers,
+ * VDP2 VRAM (the bus copy and the renderer's copy) and the renderer's line
+ * info all live in SS_HotMem, a single static object aligned and padded to
+ * 2 MiB on Linux. The files that own them bind file-scope array references to
+ * its members ("static uint16 (&VRAM)[262144] = SS_HotMem.VDP2VRAM;"), which
+ * the compiler folds to the member's address, so accesses and sizeof() work as
+ * they did on the old separate arrays.
+ *
+ * ss.hugepages picks the backing when a game loads (SS_HotMem_Apply() in
+ * ss.cpp): "thp" advises the range for transparent huge pages, "hugetlb" moves
+ * it onto explicit huge pages (MAP_HUGETLB, falling back to thp). Both are
+ * Linux-only; elsewhere the arena is just one contiguous block.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_HOTMEM_H
+#define __MDFN_SS_HOTMEM_H
+
+#include <mednafen/mednafen.h>
+#include "vdp2_render.h"
+
+namespace MDFN_IEN_SS
+{
+
+#ifdef __linux__
+enum : size_t { SS_HotMem_Align = (size_t)1 << 21 };
+#else
+enum : size_t { SS_HotMem_Align = 4096 };
+#endif
+
+struct alignas(SS_HotMem_Align) SS_HotMemT
+{
+ uint16 WorkRAMH[1024 * 1024 / sizeof(uint16)];
+ uint16 WorkRAML[1024 * 1024 / sizeof(uint16)];
+ uintptr_t SH7095_FastMap[1U << (32 - 16)];	// SH7095_EXT_MAP_GRAN_BITS in ss.cpp
+ uint16 BIOSROM[524288 / sizeof(uint16)];
+ uint16 VDP1VRAM[0x40000];
+ uint16 VDP1FB[2][0x20000];
+ uint16 VDP2VRAM[262144];
+ uint16 VDP2RendVRAM[262144];
+ VDP2Rend_LIB VDP2RendLIB[256];
+};
+
+MDFN_HIDE extern SS_HotMemT SS_HotMem;
+
+enum
+{
+ SS_HOTMEM_OFF = 0,
+ SS_HOTMEM_THP,
+ SS_HOTMEM_HUGETLB
+};
+
+}
+#endif
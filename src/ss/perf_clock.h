@@ -0,0 +1,36 @@
+/* perf_clock.h -- Cheap host-time stamps for perf_stats
+ *
+ * PerfClock_Now() reads the TSC on x86 (a few cycles, not serializing) and
+ * falls back to steady_clock nanoseconds elsewhere. Its unit is only known
+ * by calibration: the perf_stats code in ss.cpp also takes a steady_clock
+ * reading at each frame edge and converts with the ratio of the two.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_PERF_CLOCK_H
+#define __MDFN_SS_PERF_CLOCK_H
+
+#include <mednafen/types.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+ #include <x86intrin.h>
+ #define PERF_CLOCK_TSC 1
+#else
+ #include <chrono>
+#endif
+
+namespace MDFN_IEN_SS
+{
+
+static INLINE uint64 PerfClock_Now(void)
+{
+#ifdef PERF_CLOCK_TSC
+ return __rdtsc();
+#else
+ return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+}
+#endif
@@ -53,8 +53,43 @@ class SS_SCSP
   return RAM;
  }
 
+ enum
+ {
+  DSP_MODE_INTERP = 0,	// Decode each MPROG step every sample.
+  DSP_MODE_CACHED,	// Run from a predecoded copy of MPROG, refreshed when MPROG changes.
+  DSP_MODE_COMPARE	// Run both and count samples where they disagree.
+ };
+
+ INLINE void SetDSPMode(unsigned mode) { DSPMode = mode; DSP.MPROG_Dirty = true; }
+
+ // When true, RunSample() keeps registers, timers, interrupts and slot
+ // playback positions exact but doesn't generate or mix any audio.
+ INLINE void SetSkipOutput(bool skip) { SkipOutput = skip; }
+
+ // Per-sample capture. While on, RunSample() fills this after mixing and
+ // passes it to SCSP_SampleCaptured() (defined by the includer, like
+ // SCSP_DMAStarted()). Slot samples are after the envelope, total level and
+ // ALFO, before DISDL/DIPAN/EFSDL/EFPAN; MIXS(top 16 of its 20 bits) is what
+ // the DSP reads next sample, EXTS what it read and EFREG what it wrote this
+ // sample. key_sa/key_pitch(SA, OCT/FNS register) are only valid for slots
+ // set in key_on. Output must not be skipped while capturing.
+ struct CaptureSample
+ {
+  int16 slot[32];
+  int16 mixs[16];
+  int16 efreg[16];
+  int16 exts[2];
+  int16 out[2];
+  uint32 key_on;
+  uint32 key_off;
+  uint32 key_sa[32];
+  uint16 key_pitch[32];
+ };
+ INLINE void SetCapture(bool on) { CaptureOn = on; Capture.key_on = Capture.key_off = 0; }
+ INLINE uint64 GetDSPMismatches(void) { return DSPMismatches; }
+
  INLINE uint64 PeekMPROG(uint32 A)	  { assert(A < 0x80); return DSP.MPROG[A]; }
- INLINE void PokeMPROG(uint32 A, uint64 V) { assert(A < 0x80); DSP.MPROG[A] = V; }
+ INLINE void PokeMPROG(uint32 A, uint64 V) { assert(A < 0x80); DSP.MPROG[A] = V; DSP.MPROG_Dirty = true; }
  INLINE uint32 PeekMEMS(uint32 A)	  { assert(A < 0x20); return DSP.MEMS[A]; }
  INLINE void PokeMEMS(uint32 A, uint32 V)  { assert(A < 0x20); DSP.MEMS[A] = V & 0x00FFFFFF; }
  INLINE uint32 PeekTEMPRel(uint32 A)	  { assert(A < 0x80); return DSP.TEMP[(DSP.MDEC_CT + A) & 0x7F]; }
@@ -158,8 +193,6 @@ class SS_SCSP
   uint8 ToDSPSelect;
   uint8 ToDSPLevel;
 
-  int16 DirectVolume[2];	// 1.14 fixed point, derived from DISDL and DIPAN
-  int16 EffectVolume[2];	// 1.14 fixed point, derived from EFSDL and EFPAN
   //
   //
   uint32 ShortWaveMask;
@@ -176,6 +209,18 @@ class SS_SCSP
   uint16 LFOTimeCounter;
  } Slots[32];
 
+ // Mix volumes, 1.14 fixed point, indexed [channel][slot] so the mix-down
+ // at the end of RunSample() can run across all 32 slots at once.
+ alignas(16) int16 DirectVolume[2][32];	// Derived from DISDL and DIPAN
+ alignas(16) int16 EffectVolume[2][32];	// Derived from EFSDL and EFPAN
+
+ void MixSlots(const int16* slot_out, int32* out_accum);
+ void RunSlotsSilent(void);
+ bool SkipOutput;
+
+ bool CaptureOn;
+ CaptureSample Capture;
+
  uint16 EXTS[2];
 
  void RecalcShortWaveMask(Slot* s);
@@ -268,6 +313,43 @@ class SS_SCSP
  uint8 RBL;
  void RunDSP(void);
 
+ struct DSPInstr
+ {
+  uint8 MASA;
+  uint8 CRA;
+  uint8 EWA;
+  uint8 IWA;
+  uint8 IRA;
+  uint8 YSEL;
+  uint8 TWA;
+  uint8 TRA;
+
+  bool NXADDR;
+  bool ADRGB;
+  bool NOFL;
+  bool BSEL;
+  bool ZERO;
+  bool NEGB;
+  bool YRL;
+  bool SHFT0;
+  bool SHFT1;
+  bool FRCL;
+  bool ADRL;
+  bool EWT;
+  bool MRT;
+  bool MWT;
+  bool TABLE;
+  bool IWT;
+  bool XSEL;
+  bool TWT;
+ };
+
+ static void DecodeDSPInstr(const uint64 instr, DSPInstr* d);
+ void RunDSPStep(const DSPInstr& d);
+ void RunDSPInterp(void);
+ void RunDSPCached(void);
+ void RunDSPCompare(void) MDFN_COLD;
+
  struct DSPS
  {
   uint64 MPROG[0x80];
@@ -298,13 +380,25 @@ class SS_SCSP
 
   bool MPROG_Dirty;
  } DSP;
+
+ unsigned DSPMode;
+ DSPInstr DSPCache[0x80];		// Decoded from DSPCacheKey[]
+ uint64 DSPCacheKey[0x80];
+
+ // Compare mode; the DSP writes at most one RAM word per step.
+ struct DSPRAMWrite
+ {
+  uint32 addr;
+  uint16 old_value;
+  uint16 new_value;
+ };
+ DSPRAMWrite DSPWriteLog[0x80];
+ unsigned DSPWriteLogCount;
+ bool DSPLogWrites;
+ uint64 DSPMismatches;
  //
  //
 
  uint16 RAM[262144 * 2];	// *2 for dummy so we don't have to have so many conditionals in the playback code.
-
-#ifdef MDFN_SS_SCSP_DSP_DYNAREC
- alignas(8) uint8 DynaRecPool[65536];
-#endif
 };
 
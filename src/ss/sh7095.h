@@ -22,7 +22,11 @@
 #ifndef __MDFN_SH7095_H
 #define __MDFN_SH7095_H
 
-class SH7095 final
+class TraceRing;
+class BinTrace;
+class FlightRec;
+
+class alignas(64) SH7095 final
 {
  public:
 
@@ -31,6 +35,7 @@ class SH7095 final
 
  void Init(const bool EmulateICache, const bool CacheBypassHack) MDFN_COLD;
  void SetDebugMode(const bool DebugMode); // Don't mark MDFN_COLD, will cause newer gcc's optimizer to put the CPU execution loop in the wrong text section.
+ void SetInstrumented(const bool Instrumented);	// Automation checks in the memory handler tables; must match Step()'s.
 
  void StateAction(StateMem* sm, const unsigned load, const bool data_only, const char* sname) MDFN_COLD;
  void StateAction_SlaveResume(StateMem* sm, const unsigned load, const bool data_only, const char* sname) MDFN_COLD;
@@ -64,8 +69,9 @@ class SH7095 final
   ExtHaltDMA = (ExtHaltDMA & ~2) | (state << 1);
  }
 
- // When entering Step(), EmulateICache and DebugMode must match what was passed to Init() and SetDebugMode()
- template<unsigned which, bool EmulateICache, bool DebugMode>
+ // When entering Step(), EmulateICache, DebugMode and Instrumented must match what was passed to Init(), SetDebugMode()
+ // and SetInstrumented().  Instrumented=false compiles out every automation check(traces, CDL, profilers, watchpoints).
+ template<unsigned which, bool EmulateICache, bool DebugMode, bool Instrumented>
  void Step(void);
 
  // Slave only
@@ -73,6 +79,13 @@ class SH7095 final
  NO_CLONE NO_INLINE void RunSlaveUntil_Debug(sscpu_timestamp_t bound_timestamp) MDFN_COLD;
 
  //private:
+ //
+ // Data members are ordered by how often the interpreter touches them, since both CPU objects are
+ // run in alternation: R[] through IBuffer fill the first two cache lines(the class is 64-byte
+ // aligned), WB_until[] the third, and the trace/debug hook pointers, each tested per instruction or
+ // per access, share the fourth.  Then the memory handler tables, and after those everything the
+ // common path never reads: caches, on-chip peripheral registers and the slave's resume state.
+ //
  uint32 R[16];
  uint32 PC;
 
@@ -92,6 +105,12 @@ class SH7095 final
  sscpu_timestamp_t MA_until;
  sscpu_timestamp_t MM_until;
  sscpu_timestamp_t write_finish_timestamp;
+ sscpu_timestamp_t FRT_WDT_NextTS;	// FRT/WDT; Step() compares it with timestamp every instruction
+
+ uint32 EPending;
+ uint32 Pipe_ID;
+ uint32 Pipe_IF;
+ uint32 IBuffer;
 
  INLINE void SetT(bool new_value) { SR &= ~1; SR |= new_value; }
  INLINE bool GetT(void) { return SR & 1; }
@@ -117,11 +136,48 @@ class SH7095 final
  INLINE uint64 GetMAC64(void) { return MACL | ((uint64)MACH << 32); }
  INLINE void SetMAC64(uint64 nv) { MACL = nv; MACH = nv >> 32; }
 
+ sscpu_timestamp_t WB_until[16];
+
  // Function call trace logging (JSR/BSR/BSRF)
  FILE* CallTraceFile = nullptr;
+ BinTrace* CallTraceBin = nullptr;	// binary unified trace (unified_trace_bin)
+
+ // Per-instruction trace logging (every single instruction).
+ // Async ring for a separate file; synchronous view of CallTraceFile in unified mode.
+ TraceRing* InsnTrace = nullptr;
+ BinTrace* InsnTraceBin = nullptr;
+ TraceRing* InsnTraceRaw = nullptr;	// insn_trace ... raw: undisassembled records(Automation_EnableInsnTrace())
+ // insn_trace_window: asked before each instruction while the window is armed or open; it
+ // points InsnTrace/InsnTraceRaw at the ring when the window opens(Automation_EnableInsnTraceWindow()).
+ void (*InsnTraceGate)(unsigned which, uint32 pc) = nullptr;
+
+ // Flight recorder (flight_rec.h): last N instructions in memory; FlightRecMem
+ // is the same ring when data accesses are recorded too, else nullptr.
+ FlightRec* FlightRecorder = nullptr;
+ FlightRec* FlightRecMem = nullptr;
+
+ // Opcode histogram(op_stats): executions per decoded-handler index(Pipe_ID >> 24; bit 7 = in a
+ // delay slot), and BT/BF/BT/S/BF/S outcomes. Counted only by the DebugMode variants of the run loops.
+ struct OpStatsCounters
+ {
+  uint64 handler[256];
+  uint64 cond_taken;
+  uint64 cond_untaken;
+ };
+ OpStatsCounters* OpStats = nullptr;
+ INLINE void OpStatsCount(void);
+
+ // Idle loop skipping("ss.sh2.idle_skip"), called by the run loops before Step().
+ // 'bound' is the timestamp the CPU may be advanced to without missing an event,
+ // and 'ram_ok' is whether nothing else can write work RAM(or trigger the FRT input capture) before then.
+ bool IdleSkip = false;
 
- // Per-instruction trace logging (every single instruction)
- FILE* InsnTraceFile = nullptr;
+ INLINE void IdleLoopCheck(const sscpu_timestamp_t bound, const bool ram_ok)
+ {
+  // BT/BF with a negative displacement, not in a delay slot and no exception pending.
+  if(MDFN_UNLIKELY((Pipe_ID & 0x80FFFD80) == 0x00008980))
+   IdleLoopBranch(bound, ram_ok);
+ }
 
  enum // must be in range of 0 ... 7
  {
@@ -137,8 +193,6 @@ class SH7095 final
  enum { EPENDING_PEXBITS_SHIFT = 16 };
  enum { EPENDING_OP_OR = 0xFF000000 };
 
- uint32 EPending;
-
  INLINE void SetPEX(const unsigned which)
  {
   EPending |= (1U << (which + EPENDING_PEXBITS_SHIFT));
@@ -153,9 +207,6 @@ class SH7095 final
    EPending = 0;
  }
 
- uint32 Pipe_ID;
- uint32 Pipe_IF;
-
  enum
  {
   EXCEPTION_POWERON = 0,// Power-on
@@ -198,7 +249,6 @@ class SH7095 final
  //
  //
  //
- uint32 IBuffer;
  uint32 (MDFN_FASTCALL *MRFPI[8])(uint32 A);
 
  uint8 (MDFN_FASTCALL *MRFP8[8])(uint32 A);
@@ -215,8 +265,6 @@ class SH7095 final
  void RecalcMRWFP_0(void);
  void RecalcMRWFP_1_7(void);
 
- sscpu_timestamp_t WB_until[16];
-
  //
  //
  // Cache:
@@ -246,6 +294,7 @@ class SH7095 final
  enum { CCR_W1 = 0x80 };	//
 
  void Cache_AssocPurge(const uint32 A);
+ void CEM_CheckWrite(const uint32 A) MDFN_COLD;
 
  int Cache_FindWay(CacheEntry* const cent, const uint32 ATM);
 
@@ -293,10 +342,10 @@ class SH7095 final
   uint32 last_mem_type;
  } BSC;
 
- template<typename T>
+ template<typename T, bool Instrumented = true>
  void INLINE BSC_BusWrite(uint32 A, T V, const bool BurstHax, int32* SH2DMAHax);
 
- template<typename T>
+ template<typename T, bool Instrumented = true>
  T INLINE BSC_BusRead(uint32 A, const bool BurstHax, int32* SH2DMAHax);
 
  uint32 UCRead_IF_Kludge;
@@ -385,8 +434,7 @@ class SH7095 final
 
  void FRT_WDT_Update(void);
  void FRT_WDT_Recalc_NET(void);
- uint32 FRT_WDT_ClockDivider;
- sscpu_timestamp_t FRT_WDT_NextTS;
+ uint32 FRT_WDT_ClockDivider;	// (FRT_WDT_NextTS is up with the hot state)
 
  //
  //
@@ -480,17 +528,40 @@ class SH7095 final
  bool ExtHalt;
  uint8 ExtHaltDMA;
 
+ //
+ //
+ //
+ enum : unsigned { IdleLoop_MaxBody = 8 };
+
+ struct
+ {
+  uint32 PC;		// Address of the BT/BF closing the candidate loop, ~0U if none.
+  bool OK;		// Loop body passed IdleLoopAnalyze().
+  int32 IterCycles;
+  sscpu_timestamp_t LastTS;
+  uint32 R[16];
+  uint32 SR;
+ } IdleLoop;
+
+ NO_INLINE void IdleLoopBranch(const sscpu_timestamp_t bound, const bool ram_ok);
+ bool IdleLoopAnalyze(const uint32 bpc, const bool ram_ok, uint32* shared_load = nullptr);
+
+ // Sync wait profiler(sync_profile_start), called by Step() for the same branches as IdleLoopCheck().
+ NO_INLINE void SyncLoopBranch(const unsigned which);
+
+ NO_INLINE MDFN_COLD void InsnTraceRawWrite(const unsigned which);
+
  uint8 (*const ExIVecFetch)(void);
  uint8 GetPendingInt(uint8*);
  void RecalcPendingIntPEX(void);
 
- template<bool EmulateICache, bool DebugMode, bool IntPreventNext>
+ template<bool EmulateICache, bool DebugMode, bool Instrumented, bool IntPreventNext>
  INLINE void DoIDIF_INLINE(void);
 
- template<bool SlavePenalty, typename T, bool BurstHax>
+ template<bool SlavePenalty, typename T, bool BurstHax, bool Instrumented>
  INLINE T ExtBusRead_INLINE(uint32 A);
 
- template<bool SlavePenalty, typename T>
+ template<bool SlavePenalty, typename T, bool Instrumented>
  INLINE void ExtBusWrite_INLINE(uint32 A, T V);
 
  template<typename T>
@@ -499,10 +570,10 @@ class SH7095 final
  template<typename T>
  INLINE T OnChipRegRead_INLINE(uint32 A);
 
- template<unsigned which, int NeedSlaveCall, bool CacheBypassHack, typename T, unsigned region, bool CacheEnabled, int32 IsInstr>
+ template<unsigned which, int NeedSlaveCall, bool CacheBypassHack, typename T, unsigned region, bool CacheEnabled, int32 IsInstr, bool Instrumented>
  INLINE T MemReadRT(uint32 A);
 
- template<unsigned which, int NeedSlaveCall, typename T, unsigned region, bool CacheEnabled>
+ template<unsigned which, int NeedSlaveCall, typename T, unsigned region, bool CacheEnabled, bool Instrumented>
  INLINE void MemWriteRT(uint32 A, T V);
  //
  //
@@ -609,12 +680,24 @@ class SH7095 final
  uint32 GetRegister(const unsigned id, char* const special, const uint32 special_len);
  void SetRegister(const unsigned id, const uint32 value) MDFN_COLD;
 
+ // Automation(sh2_bench): switch instruction cache emulation without Init(), and continue at "target" as if the
+ // next instruction were JMP @Rrn with a NOP in its delay slot(R[rn] is set to target).  Both only between
+ // instructions with nothing to resume.
+ void Automation_SetEmulateICache(const bool EmulateICache) MDFN_COLD;
+ bool Automation_GetCacheBypassHack(void) const { return CBH_Setting && !EIC_Setting; }
+
+ // Cache emulation detect mode: turn on instruction cache emulation for good, between frames.  live = false
+ // when a state recorded with it is about to be loaded(nothing to carry over).
+ void SwitchToICacheEmulation(const bool live) MDFN_COLD;
+ void Automation_Jump(const uint32 target, const unsigned rn) MDFN_COLD;
+
  void CheckRWBreakpoints(void (*MRead)(unsigned len, uint32 addr), void (*MWrite)(unsigned len, uint32 addr)) const;
  static void Disassemble(const uint16 instr, const uint32 PC, char* buffer, uint16 (*DisPeek16)(uint32), uint32 (*DisPeek32)(uint32));
  private:
  bool CBH_Setting;
  bool EIC_Setting;
  bool DM_Setting;
+ bool IM_Setting;
  uint32 PC_IF, PC_ID;	// Debug-related variables.
 #ifdef MDFN_ENABLE_DEV_BUILD
  void CheckDMARace(uint32 addr, uint32 size, bool write);
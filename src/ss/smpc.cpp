@@ -234,6 +234,9 @@ static IODevice* VirtualPorts[12];
 static uint8* VirtualPortsDPtr[12];
 static uint8* MiscInputPtr;
 
+static uint32 (*PollHook)(unsigned index) = nullptr;
+static unsigned PollIndex;
+
 IODevice::IODevice() { }
 IODevice::~IODevice() { }
 void IODevice::Power(void) { }
@@ -697,6 +700,8 @@ int32 SMPC_StartFrame(EmulateSpecStruct* espec)
   PendingClockDivisor = 0;
  }
 
+ PollIndex = 0;
+
  SMPC_ClockRatio = (1ULL << 32) * 4000000 * CurrentClockDivisor / MasterClock;
  SOUND_SetClockRatio((1ULL << 32) * 11289600 * CurrentClockDivisor / MasterClock);
  CDB_SetClockRatio((1ULL << 32) * 11289600 * CurrentClockDivisor / MasterClock);
@@ -752,6 +757,16 @@ void SMPC_UpdateInput(const int32 time_elapsed)
 }
 
 
+void SMPC_SetPollHook(uint32 (*hook)(unsigned index))
+{
+ PollHook = hook;
+}
+
+unsigned SMPC_GetPollIndex(void)
+{
+ return PollIndex;
+}
+
 void SMPC_Write(const sscpu_timestamp_t timestamp, uint8 A, uint8 V)
 {
  BusBuffer = V;
@@ -1249,6 +1264,18 @@ sscpu_timestamp_t SMPC_Update(sscpu_timestamp_t timestamp)
 
      if(IREG[1] & 0x8)
      {
+      PollIndex++;
+      if(PollHook)
+      {
+       const uint32 changed = PollHook(PollIndex);
+
+       for(unsigned vp = 0; vp < 12; vp++)
+       {
+        if((changed >> vp) & 1)
+         VirtualPorts[vp]->UpdateInput(VirtualPortsDPtr[vp], 0);
+       }
+      }
+
       #define JR_WAIT(cond)	{ SMPC_WAIT_UNTIL_COND((cond) || PendingVB); if(PendingVB) { SS_DBGTI(SS_DBG_SMPC, "[SMPC] abortjr wait"); goto AbortJR; } }
       #define JR_EAT(n)		{ SMPC_EAT_CLOCKS(n); if(PendingVB) { SS_DBGTI(SS_DBG_SMPC, "[SMPC] abortjr eat"); goto AbortJR; } }
       #define JR_WRNYB(val)															\
@@ -74,6 +74,12 @@ void SMPC_EndFrame(EmulateSpecStruct* espec, sscpu_timestamp_t timestamp);
 void SMPC_TransformInput(void);
 void SMPC_UpdateInput(const int32 time_elapsed);
 void SMPC_UpdateOutput(void);
+
+// Automation: "hook" is called at the start of each INTBACK peripheral data read with that read's
+// 1-based index within the frame, and returns a mask of virtual ports whose input data it changed;
+// those ports are relatched before the read.  SMPC_GetPollIndex() is the count of such reads so far.
+void SMPC_SetPollHook(uint32 (*hook)(unsigned index)) MDFN_COLD;
+unsigned SMPC_GetPollIndex(void);
 void SMPC_SetInput(unsigned port, const char* type, uint8* ptr) MDFN_COLD;
 void SMPC_SetMultitap(unsigned sport, bool enabled) MDFN_COLD;
 void SMPC_SetCrosshairsColor(unsigned port, uint32 color) MDFN_COLD;
@@ -29,11 +29,19 @@
 #include <mednafen/hw_cpu/m68k/m68k.h>
 #include <mednafen/jump.h>
 
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#elif defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
+
 #ifndef MDFN_SSFPLAY_COMPILE
 #include "ss.h"
 #include "sound.h"
 #include "scu.h"
 #include "cdb.h"
+#include "automation_ss.h"
+#include "trace_ring.h"
 
 namespace MDFN_IEN_SS
 {
@@ -61,6 +69,7 @@ static uint32 IBufferCount;
 static SpeexResamplerState* resampler = NULL;
 static int last_rate;
 static uint32 last_quality;
+static bool skip_when_silent;
 
 static INLINE void SCSP_SoundIntChanged(SS_SCSP* s, unsigned level)
 {
@@ -74,8 +83,93 @@ static INLINE void SCSP_MainIntChanged(SS_SCSP* s, bool state)
  #endif
 }
 
+#ifndef MDFN_SSFPLAY_COMPILE
+static void (*AutomationSCSPDMAHook)(bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length) = nullptr;
+#endif
+
+static INLINE void SCSP_DMAStarted(SS_SCSP* s, bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length)
+{
+ #ifndef MDFN_SSFPLAY_COMPILE
+ if(MDFN_UNLIKELY(AutomationSCSPDMAHook != nullptr))
+  AutomationSCSPDMAHook(to_ram, mem_addr, reg_addr, length);
+ #endif
+}
+
+#ifndef MDFN_SSFPLAY_COMPILE
+//
+// Automation: SCSP capture(Automation_SCSPCaptureStart()). Each sample goes to
+// one TraceRing as SCSPCap_Channels little-endian int16s(32 slots, 16 MIXS, 16
+// EFREG, 2 EXTS, L/R out, as in SS_SCSP::CaptureSample), key on/off events to
+// a second one, so the sound thread only copies into the rings.
+//
+enum { SCSPCap_Channels = 32 + 16 + 16 + 2 + 2 };
+enum { SCSPCap_Rate = 44100 };
+static TraceRing* scspcap_ring = nullptr;
+static TraceRing* scspcap_keys = nullptr;
+static std::string scspcap_path;
+static bool scspcap_wav;
+static uint64 scspcap_samples;
+static uint64 scspcap_key_events;
+
+static INLINE void SCSPCap_Key(uint8* rec, unsigned slot, bool on, uint16 pitch, uint32 sa)
+{
+ MDFN_en64lsb(&rec[0], scspcap_samples);
+ rec[8] = slot;
+ rec[9] = on;
+ MDFN_en16lsb(&rec[10], pitch);
+ MDFN_en32lsb(&rec[12], sa);
+ scspcap_keys->Write(rec, 16);
+ scspcap_key_events++;
+}
+#endif
+
+static INLINE void SCSP_SampleCaptured(SS_SCSP* s, const SS_SCSP::CaptureSample& cs)
+{
+ #ifndef MDFN_SSFPLAY_COMPILE
+ uint8 frame[SCSPCap_Channels * sizeof(int16)];
+ uint8* p = frame;
+
+ for(int16 v : cs.slot)
+  MDFN_en16lsb(p, v), p += 2;
+ for(int16 v : cs.mixs)
+  MDFN_en16lsb(p, v), p += 2;
+ for(int16 v : cs.efreg)
+  MDFN_en16lsb(p, v), p += 2;
+ for(int16 v : cs.exts)
+  MDFN_en16lsb(p, v), p += 2;
+ for(int16 v : cs.out)
+  MDFN_en16lsb(p, v), p += 2;
+
+ scspcap_ring->Write(frame, sizeof(frame));
+
+ if(MDFN_UNLIKELY(cs.key_on | cs.key_off))
+ {
+  uint8 rec[16];
+
+  for(unsigned slot = 0; slot < 32; slot++)
+  {
+   if(cs.key_off & (1U << slot))
+    SCSPCap_Key(rec, slot, false, 0, 0);
+   if(cs.key_on & (1U << slot))
+    SCSPCap_Key(rec, slot, true, cs.key_pitch[slot], cs.key_sa[slot]);
+  }
+ }
+ scspcap_samples++;
+ #endif
+}
+
 #include "scsp.inc"
 
+static void UpdateSkipOutput(void)
+{
+ bool skip = skip_when_silent && !last_rate;
+
+ #ifndef MDFN_SSFPLAY_COMPILE
+ skip &= !scspcap_ring;
+ #endif
+ SCSP.SetSkipOutput(skip);
+}
+
 //
 //
 template<typename T, bool TA_STV>
@@ -91,6 +185,20 @@ template<bool TA_STV>
 static MDFN_FASTCALL void SoundCPU_BusRMW(uint32 A, uint8 (MDFN_FASTCALL *cb)(M68K*, uint8));
 static MDFN_FASTCALL unsigned SoundCPU_BusIntAck(uint8 level);
 static MDFN_FASTCALL void SoundCPU_BusRESET(bool state);
+
+#ifndef MDFN_SSFPLAY_COMPILE
+//
+// Automation: 68K instruction and sound RAM write hooks. While either is set,
+// SOUND_Update() steps the 68K an instruction at a time and keeps the start PC
+// for write hits; otherwise it's the plain Run() loop. Write watching also
+// swaps in the watching bus write handlers and turns the fast map off (same
+// 6-cycle timing, see SOUND_Init()).
+//
+static void (*Automation68KHook)(uint32 pc, uint16 opcode) = nullptr;
+static void (*Automation68KWriteHook)(uint32 pc, uint32 addr, uint32 old_val, uint32 new_val, unsigned size) = nullptr;
+static uint32 Automation68KInsnPC;
+static bool SoundCPU_STV;
+#endif
 //
 //
 void SOUND_SetMIDIOutput(void (*p)(uint8))
@@ -98,6 +206,17 @@ void SOUND_SetMIDIOutput(void (*p)(uint8))
  MIDI_Out = p;
 }
 
+void SOUND_SetDSPMode(unsigned mode)
+{
+ SCSP.SetDSPMode(mode);
+}
+
+void SOUND_SetSkipWhenSilent(bool skip)
+{
+ skip_when_silent = skip;
+ UpdateSkipOutput();
+}
+
 void SOUND_Init(bool stv_mapping)
 {
  memset(IBuffer, 0, sizeof(IBuffer));
@@ -111,6 +230,11 @@ void SOUND_Init(bool stv_mapping)
  lastts = 0;
 
  MIDI_Out = nullptr;
+ skip_when_silent = false;
+
+ #ifndef MDFN_SSFPLAY_COMPILE
+ SoundCPU_STV = stv_mapping;
+ #endif
 
  if(stv_mapping)
  {
@@ -140,6 +264,11 @@ void SOUND_Init(bool stv_mapping)
  SoundCPU.BusIntAck = SoundCPU_BusIntAck;
  SoundCPU.BusRESET = SoundCPU_BusRESET;
 
+ // 68K accesses to the 512KiB of sound RAM take the same 6 cycles as going through
+ // SoundCPU_Bus*() above, which only differ by calling RunSCSP() once
+ // next_scsp_time is reached.
+ SoundCPU.SetFastMap(SCSP.GetRAMPtr(), 0xFFF80001, 6, &next_scsp_time);
+
  #ifndef MDFN_SSFPLAY_COMPILE
  SoundCPU.DBG_Warning = SS_DBG_Wrap<SS_DBG_WARNING | SS_DBG_M68K>;
  SoundCPU.DBG_Verbose = SS_DBG_Wrap<SS_DBG_M68K>;
@@ -154,6 +283,11 @@ uint8 SOUND_PeekRAM(uint32 A)
  return ne16_rbo_be<uint8>(SCSP.GetRAMPtr(), A & 0x7FFFF);
 }
 
+const uint16* SOUND_GetRAMPtr(void)
+{
+ return SCSP.GetRAMPtr();
+}
+
 void SOUND_PokeRAM(uint32 A, uint8 V)
 {
  ne16_wbo_be<uint8>(SCSP.GetRAMPtr(), A & 0x7FFFF, V);
@@ -223,6 +357,13 @@ void SOUND_ResetSCSP(void)
 
 void SOUND_Kill(void)
 {
+ #ifndef MDFN_SSFPLAY_COMPILE
+ Automation_SCSPCaptureStop(nullptr, nullptr);
+ #endif
+
+ if(SCSP.GetDSPMismatches())
+  MDFN_printf("SCSP DSP: %llu samples where the cached program and the interpreter disagreed.\n", (unsigned long long)SCSP.GetDSPMismatches());
+
  if(resampler)
  {
   speex_resampler_destroy(resampler);  
@@ -301,6 +442,24 @@ sscpu_timestamp_t SOUND_Update(sscpu_timestamp_t timestamp)
   {
    int32 next_time = std::min<int32>(next_scsp_time, run_until_time >> 32);
 
+   #ifndef MDFN_SSFPLAY_COMPILE
+   if(MDFN_UNLIKELY(Automation68KHook != nullptr || Automation68KWriteHook != nullptr))
+   {
+    while(SoundCPU.timestamp < next_time)
+    {
+     Automation68KInsnPC = SoundCPU.PC;
+     // Only when an instruction runs next(not halted, stopped or taking an exception)
+     if(Automation68KHook && !SoundCPU.XPending)
+     {
+      const uint16 opcode = (SoundCPU.PC < 0x80000) ? ne16_rbo_be<uint16>(SCSP.GetRAMPtr(), SoundCPU.PC & 0x7FFFE) : 0;
+
+      Automation68KHook(SoundCPU.PC, opcode);
+     }
+     SoundCPU.Step();
+    }
+   }
+   else
+   #endif
    SoundCPU.Run(next_time);
 
    if(SoundCPU.timestamp >= next_scsp_time)
@@ -335,6 +494,7 @@ void SOUND_StartFrame(double rate, uint32 quality)
 
   last_rate = (int)rate;
   last_quality = quality;
+  UpdateSkipOutput();
  }
 }
 
@@ -522,6 +682,25 @@ static MDFN_FASTCALL void SoundCPU_BusWrite(uint32 A, T V)
  SoundCPU.timestamp += 2;
 }
 
+#ifndef MDFN_SSFPLAY_COMPILE
+template<typename T, bool TA_STV>
+static MDFN_FASTCALL void SoundCPU_BusWriteWatch(uint32 A, T V)
+{
+ if(A & 0xFFF80000)
+ {
+  SoundCPU_BusWrite<T, TA_STV>(A, V);
+  return;
+ }
+
+ const T old_val = ne16_rbo_be<T>(SCSP.GetRAMPtr(), A);
+
+ SoundCPU_BusWrite<T, TA_STV>(A, V);
+
+ if(Automation68KWriteHook)
+  Automation68KWriteHook(Automation68KInsnPC, A, old_val, V, sizeof(T));
+}
+#endif
+
 template<bool TA_STV>
 static MDFN_FASTCALL void SoundCPU_BusRMW(uint32 A, uint8 (MDFN_FASTCALL *cb)(M68K*, uint8))
 {
@@ -607,6 +786,151 @@ void SOUND_SetM68KRegister(const unsigned id, const uint32 value)
  SoundCPU.SetRegister(id, value);
 }
 
+#ifndef MDFN_SSFPLAY_COMPILE
+void Automation_Set68KHook(void (*hook)(uint32 pc, uint16 opcode))
+{
+ Automation68KHook = hook;
+}
+
+void Automation_Set68KWriteHook(void (*hook)(uint32 pc, uint32 addr, uint32 old_val, uint32 new_val, unsigned size))
+{
+ Automation68KWriteHook = hook;
+
+ if(hook)
+ {
+  SoundCPU.BusWrite8 = SoundCPU_STV ? SoundCPU_BusWriteWatch<uint8, true> : SoundCPU_BusWriteWatch<uint8, false>;
+  SoundCPU.BusWrite16 = SoundCPU_STV ? SoundCPU_BusWriteWatch<uint16, true> : SoundCPU_BusWriteWatch<uint16, false>;
+  SoundCPU.SetFastMap(nullptr, 0, 0, nullptr);
+ }
+ else
+ {
+  SoundCPU.BusWrite8 = SoundCPU_STV ? SoundCPU_BusWrite<uint8, true> : SoundCPU_BusWrite<uint8, false>;
+  SoundCPU.BusWrite16 = SoundCPU_STV ? SoundCPU_BusWrite<uint16, true> : SoundCPU_BusWrite<uint16, false>;
+  SoundCPU.SetFastMap(SCSP.GetRAMPtr(), 0xFFF80001, 6, &next_scsp_time);
+ }
+}
+
+void Automation_SetSCSPDMAHook(void (*hook)(bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length))
+{
+ AutomationSCSPDMAHook = hook;
+}
+
+void Automation_Get68KRegs(uint32* regs)
+{
+ for(unsigned i = 0; i < 16; i++)
+  regs[i] = SoundCPU.DA[i];
+ regs[16] = SoundCPU.PC;
+ regs[17] = SoundCPU.GetRegister(M68K::GSREG_SR);
+}
+
+static void SCSPCap_WAVHeader(uint8* h, uint32 data_size)
+{
+ memcpy(&h[0], "RIFF", 4);
+ MDFN_en32lsb(&h[4], 36 + data_size);
+ memcpy(&h[8], "WAVEfmt ", 8);
+ MDFN_en32lsb(&h[16], 16);
+ MDFN_en16lsb(&h[20], 1);	// PCM
+ MDFN_en16lsb(&h[22], SCSPCap_Channels);
+ MDFN_en32lsb(&h[24], SCSPCap_Rate);
+ MDFN_en32lsb(&h[28], SCSPCap_Rate * SCSPCap_Channels * 2);
+ MDFN_en16lsb(&h[32], SCSPCap_Channels * 2);
+ MDFN_en16lsb(&h[34], 16);
+ memcpy(&h[36], "data", 4);
+ MDFN_en32lsb(&h[40], data_size);
+}
+
+// Samples to path(a WAV whose sizes are filled in on stop, or headerless with raw),
+// key events to <path>.keys: "MDFNSCK1", le32 sample rate, then 16-byte records of
+// le64 sample number, u8 slot, u8 type(1 key on, 0 key off), le16 OCT/FNS register,
+// le32 SA(key on only).
+bool Automation_SCSPCaptureStart(const char* path, bool raw)
+{
+ Automation_SCSPCaptureStop(nullptr, nullptr);
+
+ FILE* f = fopen(path, "wb");
+ FILE* kf;
+ uint8 header[44];
+
+ if(!f)
+  return false;
+
+ if(!(kf = fopen((std::string(path) + ".keys").c_str(), "wb")))
+ {
+  fclose(f);
+  return false;
+ }
+
+ if(!raw)
+ {
+  SCSPCap_WAVHeader(header, 0);
+  fwrite(header, 1, 44, f);
+ }
+ memcpy(header, "MDFNSCK1", 8);
+ MDFN_en32lsb(&header[8], SCSPCap_Rate);
+ fwrite(header, 1, 12, kf);
+
+ // 68 channels at 44.1kHz is about 6MB/s; give the writer a few seconds of slack.
+ scspcap_ring = new TraceRing(f, true, (size_t)1 << 25);
+ scspcap_keys = new TraceRing(kf, true, (size_t)1 << 20);
+ scspcap_path = path;
+ scspcap_wav = !raw;
+ scspcap_samples = 0;
+ scspcap_key_events = 0;
+ SCSP.SetCapture(true);
+ UpdateSkipOutput();
+ return true;
+}
+
+// Returns dropped records(samples and key events); totals[2]: samples, key events.
+uint64 Automation_SCSPCaptureStop(uint64* totals, std::string* path)
+{
+ uint64 dropped;
+
+ if(path)
+  *path = scspcap_path;
+ if(totals)
+ {
+  totals[0] = scspcap_samples;
+  totals[1] = scspcap_key_events;
+ }
+ if(!scspcap_ring)
+  return 0;
+
+ SCSP.SetCapture(false);
+ dropped = scspcap_ring->Dropped() + scspcap_keys->Dropped();
+ delete scspcap_ring;	// drains the ring and closes the file
+ delete scspcap_keys;
+ scspcap_ring = nullptr;
+ scspcap_keys = nullptr;
+ UpdateSkipOutput();
+
+ if(scspcap_wav)
+ {
+  if(FILE* f = fopen(scspcap_path.c_str(), "r+b"))
+  {
+   uint8 header[44];
+   long size;
+
+   fseek(f, 0, SEEK_END);
+   size = ftell(f);
+   if(size >= 44)
+   {
+    SCSPCap_WAVHeader(header, (uint32)std::min<uint64>(0xFFFFFFDB, size - 44));
+    fseek(f, 0, SEEK_SET);
+    fwrite(header, 1, 44, f);
+   }
+   fclose(f);
+  }
+ }
+ return dropped;
+}
+
+bool Automation_SCSPCaptureIsActive(void)
+{
+ return scspcap_ring != nullptr;
+}
+#endif
+
 
 }
 
@@ -27,6 +27,8 @@ namespace MDFN_IEN_SS
 
 void SOUND_Init(bool stv_mapping) MDFN_COLD;
 void SOUND_SetMIDIOutput(void (*p)(uint8)) MDFN_COLD;
+void SOUND_SetDSPMode(unsigned mode) MDFN_COLD;
+void SOUND_SetSkipWhenSilent(bool skip) MDFN_COLD;
 void SOUND_Reset(bool powering_up) MDFN_COLD;
 void SOUND_Kill(void) MDFN_COLD;
 
@@ -46,6 +48,7 @@ void SOUND_Write8(uint32 A, uint8 V);
 void SOUND_Write16(uint32 A, uint16 V);
 
 uint8 SOUND_PeekRAM(uint32 A);
+const uint16* SOUND_GetRAMPtr(void);
 void SOUND_PokeRAM(uint32 A, uint8 V);
 
 uint64 SOUND_PeekMPROG(uint32 A);
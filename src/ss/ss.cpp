@@ -26,14 +26,21 @@
 #include <mednafen/general.h>
 #include <mednafen/FileStream.h>
 #include <mednafen/compress/GZFileStream.h>
+#include <mednafen/MemoryStream.h>
 #include <mednafen/mempatcher.h>
 #include <mednafen/hash/sha256.h>
 #include <mednafen/hash/md5.h>
 #include <mednafen/Time.h>
 
 #include <bitset>
+#include <unordered_map>
+#include <map>
 #include <new>  // for std::nothrow
 
+#ifdef __linux__
+ #include <sys/mman.h>
+#endif
+
 #include <trio/trio.h>
 
 #if defined(HAVE_SSE2_INTRINSICS)
@@ -51,15 +58,25 @@ using namespace Mednafen;
 #include "cdb.h"
 #include "vdp1.h"
 #include "vdp2.h"
+#include "vdp2_render.h"
+#include "hotmem.h"
 #include "scu.h"
 #include "cart.h"
 #include "db.h"
+#include "trace_ring.h"
+#include "bin_trace.h"
+#include "flight_rec.h"
+#include "perf_clock.h"
+#include "automation_ss.h"
 
 // Forward declarations -- defined in drivers/automation.cpp (global namespace)
 bool Automation_DebugHook(uint32_t pc);
-void Automation_WatchpointHit(uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source);
-void Automation_ReadWatchpointHit(uint32_t pc, uint32_t addr, uint32_t val, uint32_t pr);
+bool Automation_SlaveDebugHook(uint32_t pc, bool latch);
+void Automation_SlaveLatchedStop(uint32_t pc);
+void Automation_WatchpointHit(unsigned id, uint32_t pc, uint32_t addr, uint32_t old_val, uint32_t new_val, uint32_t pr, const char* source);
+void Automation_ReadWatchpointHit(unsigned id, uint32_t pc, uint32_t addr, uint32_t val, uint32_t pr);
 void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32_t pc, uint32_t sr, uint32_t r15, uint32_t pr, uint32_t vbr, uint32_t handler_pc);
+bool Automation_IsActive(void);
 
 namespace MDFN_IEN_SS
 {
@@ -76,6 +93,399 @@ static sscpu_timestamp_t MidSync(const sscpu_timestamp_t timestamp);
 uint32 ss_dbg_mask;
 static std::bitset<0x200> BWMIgnoreAddr[2]; // 0=read, 1=write
 
+//
+// Deferred debug output(ss.dbg_defer): instead of formatting and printing as
+// they come, SS_DBG() and friends record the format string pointer, the raw
+// arguments(pulled by walking the conversions) and, for SS_DBGTI(), the VDP2
+// line, position and memory timestamp into DBG_Ring. SS_DBG_Flush() formats
+// them in one batch after each frame, and on close. A full ring drops new
+// records until the next flush. ss.dbg_rate caps each call site(format string)
+// per frame, deferred or not; what's over is counted and reported by the flush.
+//
+enum : unsigned { DBG_MaxArgs = 12, DBG_SiteBits = 9, DBG_SiteSize = 1U << DBG_SiteBits };
+
+struct DBGSpec
+{
+ const char* start;	// '%'
+ const char* end;	// one past the conversion character
+ bool star_w, star_p;
+ char length;		// 0, 'H'(hh), 'h', 'l', 'q'(ll), 'j', 'z', 't' or 'L'
+ char conv;
+};
+
+struct DBGRec
+{
+ const char* format;
+ uint8 nargs;
+ bool ti;
+ bool unrecorded;	// a conversion we can't capture, or too many arguments
+ uint32 strmask;	// args that are offsets into DBG_Strings
+ int32 line, hpos, memts;
+ uint64 args[DBG_MaxArgs];
+};
+
+struct DBGSite
+{
+ const char* format;
+ uint32 count;
+ uint32 over;
+};
+
+static std::vector<DBGRec> DBG_Ring;	// ss.dbg_defer records; empty = print immediately
+static size_t DBG_Count;
+static uint64 DBG_Dropped;
+static std::vector<char> DBG_Strings;
+static uint32 DBG_Rate;
+static DBGSite DBG_Sites[DBG_SiteSize];
+static uint32 DBG_SitesUsed;
+static bool DBG_SitesOver;
+
+// Advances p past the next conversion("%%" isn't one); false at the end of the string.
+static bool DBG_NextSpec(const char*& p, DBGSpec* s)
+{
+ for(; *p; p++)
+ {
+  if(*p != '%')
+   continue;
+
+  if(p[1] == '%')
+  {
+   p++;
+   continue;
+  }
+
+  s->start = p++;
+  while(*p && strchr("-+ #0'", *p))
+   p++;
+
+  if((s->star_w = (*p == '*')))
+   p++;
+  else
+   while(*p >= '0' && *p <= '9') p++;
+
+  s->star_p = false;
+  if(*p == '.')
+  {
+   p++;
+   if((s->star_p = (*p == '*')))
+    p++;
+   else
+    while(*p >= '0' && *p <= '9') p++;
+  }
+
+  s->length = 0;
+  if(*p == 'h' || *p == 'l')
+  {
+   s->length = *p++;
+   if(*p == s->length)
+   {
+    s->length = (*p == 'h') ? 'H' : 'q';
+    p++;
+   }
+  }
+  else if(*p == 'j' || *p == 'z' || *p == 't' || *p == 'L')
+   s->length = *p++;
+
+  s->conv = *p;
+  if(*p)
+   p++;
+  s->end = p;
+  return true;
+ }
+
+ return false;
+}
+
+// false if the call site is over ss.dbg_rate this frame. The site table only
+// holds formats; once it's full, new sites aren't limited.
+static bool DBG_SiteAllow(const char* format)
+{
+ uint32 h = ((uint32)(uintptr_t)format * 0x9E3779B1U) >> (32 - DBG_SiteBits);
+
+ for(;;)
+ {
+  DBGSite& s = DBG_Sites[h];
+
+  if(!s.format)
+  {
+   if(DBG_SitesUsed >= DBG_SiteSize / 4 * 3)
+    return true;
+   DBG_SitesUsed++;
+   s.format = format;
+  }
+
+  if(s.format == format)
+  {
+   if(s.count >= DBG_Rate)
+   {
+    s.over++;
+    DBG_SitesOver = true;
+    return false;
+   }
+   s.count++;
+   return true;
+  }
+  h = (h + 1) & (DBG_SiteSize - 1);
+ }
+}
+
+static void DBG_Record(bool ti, const char* format, va_list ap)
+{
+ if(DBG_Count == DBG_Ring.size())
+ {
+  DBG_Dropped++;
+  return;
+ }
+
+ DBGRec& r = DBG_Ring[DBG_Count++];
+ const char* p = format;
+ DBGSpec s;
+
+ r.format = format;
+ r.nargs = 0;
+ r.ti = ti;
+ r.unrecorded = false;
+ r.strmask = 0;
+
+ auto take = [&r](uint64 v) { if(r.nargs < DBG_MaxArgs) r.args[r.nargs++] = v; else r.unrecorded = true; };
+
+ while(!r.unrecorded && DBG_NextSpec(p, &s))
+ {
+  if(s.star_w)
+   take((uint64)va_arg(ap, int));
+
+  if(s.star_p)
+   take((uint64)va_arg(ap, int));
+
+  switch(s.conv)
+  {
+   case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+	switch(s.length)
+	{
+	 case 'l': take((uint64)va_arg(ap, long)); break;
+	 case 'q': take((uint64)va_arg(ap, long long)); break;
+	 case 'j': take((uint64)va_arg(ap, intmax_t)); break;
+	 case 'z': take((uint64)va_arg(ap, size_t)); break;
+	 case 't': take((uint64)va_arg(ap, ptrdiff_t)); break;
+	 default: take((uint64)va_arg(ap, int)); break;
+	}
+	break;
+
+   case 'p':
+	take((uintptr_t)va_arg(ap, void*));
+	break;
+
+   case 's':
+	{
+	 const char* str = va_arg(ap, const char*);
+
+	 if(!str)
+	  str = "(null)";
+
+	 if(r.nargs < DBG_MaxArgs)
+	  r.strmask |= 1U << r.nargs;
+	 take(DBG_Strings.size());
+	 DBG_Strings.insert(DBG_Strings.end(), str, str + strlen(str) + 1);
+	}
+	break;
+
+   case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+	{
+	 const double d = (s.length == 'L') ? (double)va_arg(ap, long double) : va_arg(ap, double);
+	 uint64 v;
+
+	 memcpy(&v, &d, sizeof(v));
+	 take(v);
+	}
+	break;
+
+   default:
+	r.unrecorded = true;
+	break;
+  }
+ }
+
+ if(ti)
+ {
+  r.line = VDP2::PeekLine();
+  r.hpos = VDP2::PeekHPos();
+  r.memts = SH7095_mem_timestamp;
+ }
+}
+
+static void DBG_Format(const DBGRec& r, std::string* out)
+{
+ const char* p = r.format;
+ const char* lit = p;
+ unsigned a = 0;
+ DBGSpec s;
+ char buf[512];
+
+ auto literal = [out](const char* b, const char* e)
+ {
+  for(; b != e; b++)
+  {
+   *out += *b;
+   if(*b == '%' && b + 1 != e && b[1] == '%')
+    b++;
+  }
+ };
+
+ if(r.unrecorded)
+ {
+  *out += "[SS_DBG] (arguments not recorded) ";
+  *out += r.format;
+ }
+ else
+ {
+  while(DBG_NextSpec(p, &s))
+  {
+   std::string spec;
+   const unsigned ai = a + s.star_w + s.star_p;
+
+   literal(lit, s.start);
+   lit = s.end;
+
+   // Stars become the recorded widths, so each conversion is one typed snprintf().
+   for(const char* c = s.start; c != s.end; c++)
+   {
+    if(*c == '*')
+     spec += std::to_string((int)r.args[a++]);
+    else
+     spec += *c;
+   }
+   a = ai + 1;
+
+   const uint64 v = r.args[ai];
+   const char* const f = spec.c_str();
+
+   switch(s.conv)
+   {
+    case 'd': case 'i': case 'c':
+	switch(s.length)
+	{
+	 case 'l': snprintf(buf, sizeof(buf), f, (long)v); break;
+	 case 'q': snprintf(buf, sizeof(buf), f, (long long)v); break;
+	 case 'j': snprintf(buf, sizeof(buf), f, (intmax_t)v); break;
+	 case 'z': case 't': snprintf(buf, sizeof(buf), f, (ptrdiff_t)v); break;
+	 default: snprintf(buf, sizeof(buf), f, (int)v); break;
+	}
+	break;
+
+    case 'u': case 'x': case 'X': case 'o':
+	switch(s.length)
+	{
+	 case 'l': snprintf(buf, sizeof(buf), f, (unsigned long)v); break;
+	 case 'q': snprintf(buf, sizeof(buf), f, (unsigned long long)v); break;
+	 case 'j': snprintf(buf, sizeof(buf), f, (uintmax_t)v); break;
+	 case 'z': case 't': snprintf(buf, sizeof(buf), f, (size_t)v); break;
+	 default: snprintf(buf, sizeof(buf), f, (unsigned)v); break;
+	}
+	break;
+
+    case 'p':
+	snprintf(buf, sizeof(buf), f, (void*)(uintptr_t)v);
+	break;
+
+    case 's':
+	snprintf(buf, sizeof(buf), f, &DBG_Strings[v]);
+	break;
+
+    default:
+	{
+	 double d;
+
+	 memcpy(&d, &v, sizeof(d));
+	 if(s.length == 'L')
+	  snprintf(buf, sizeof(buf), f, (long double)d);
+	 else
+	  snprintf(buf, sizeof(buf), f, d);
+	}
+	break;
+   }
+   *out += buf;
+  }
+  literal(lit, p);
+ }
+
+ if(r.ti)
+ {
+  snprintf(buf, sizeof(buf), " @Line=0x%03x, HPos=0x%03x, memts=%d\n", r.line, r.hpos, r.memts);
+  *out += buf;
+ }
+}
+
+static void DBG_Out(bool ti, const char* format, va_list ap)
+{
+ if(DBG_Rate && !DBG_SiteAllow(format))
+  return;
+
+ if(!DBG_Ring.empty())
+ {
+  DBG_Record(ti, format, ap);
+  return;
+ }
+
+ trio_vprintf(format, ap);
+
+ if(ti)
+  trio_printf(" @Line=0x%03x, HPos=0x%03x, memts=%d\n", VDP2::PeekLine(), VDP2::PeekHPos(), SH7095_mem_timestamp);
+}
+
+// Prints the recorded messages and the rate limit and drop counts, and starts
+// the next frame's per-site counts.
+static void SS_DBG_Flush(void)
+{
+ std::string out;
+
+ for(size_t i = 0; i < DBG_Count; i++)
+  DBG_Format(DBG_Ring[i], &out);
+
+ if(DBG_SitesOver)
+ {
+  for(DBGSite& s : DBG_Sites)
+  {
+   if(s.over)
+   {
+    std::string excerpt(s.format, strnlen(s.format, 48));
+
+    excerpt.erase(std::find(excerpt.begin(), excerpt.end(), '\n'), excerpt.end());
+    out += "[SS_DBG] " + std::to_string(s.over) + " more from \"" + excerpt + "\" (ss.dbg_rate)\n";
+   }
+  }
+ }
+
+ for(DBGSite& s : DBG_Sites)
+ {
+  s.count = 0;
+  s.over = 0;
+ }
+ DBG_SitesOver = false;
+
+ if(DBG_Dropped)
+ {
+  out += "[SS_DBG] " + std::to_string(DBG_Dropped) + " messages dropped, ring full (ss.dbg_defer)\n";
+  DBG_Dropped = 0;
+ }
+
+ DBG_Count = 0;
+ DBG_Strings.clear();
+
+ if(!out.empty())
+ {
+  fwrite(out.data(), 1, out.size(), stdout);
+  fflush(stdout);
+ }
+}
+
+void SS_DBGV(uint32 which, const char* format, va_list ap)
+{
+ if(MDFN_LIKELY(!(ss_dbg_mask & which)))
+  return;
+
+ DBG_Out(false, format, ap);
+}
+
 void SS_DBG(uint32 which, const char* format, ...)
 {
  if(MDFN_LIKELY(!(ss_dbg_mask & which)))
@@ -83,7 +493,7 @@ void SS_DBG(uint32 which, const char* format, ...)
  //
  va_list ap;
  va_start(ap, format);
- trio_vprintf(format, ap);
+ DBG_Out(false, format, ap);
  va_end(ap);
 }
 
@@ -94,10 +504,8 @@ void SS_DBGTI(uint32 which, const char* format, ...)
  //
  va_list ap;
  va_start(ap, format);
- trio_vprintf(format, ap);
+ DBG_Out(true, format, ap);
  va_end(ap);
- //
- trio_printf(" @Line=0x%03x, HPos=0x%03x, memts=%d\n", VDP2::PeekLine(), VDP2::PeekHPos(), SH7095_mem_timestamp);
 }
 #endif
 static std::vector<CDInterface*> DBGCDInterfaces;
@@ -107,11 +515,14 @@ static std::vector<CDInterface*> DBGCDInterfaces;
 uint32 ss_horrible_hacks;
 
 static bool NeedEmuICache;
+static int32 SlaveSyncQuantum;	// ss.sh2.slave_quantum; only with full cache emulation
 static const uint8 BRAM_Init_Data[0x10] = { 0x42, 0x61, 0x63, 0x6b, 0x55, 0x70, 0x52, 0x61, 0x6d, 0x20, 0x46, 0x6f, 0x72, 0x6d, 0x61, 0x74 };
 
 static void SaveBackupRAM(void);
+static void SaveBackupRAMAsync(void);
 static void LoadBackupRAM(void);
 static void SaveCartNV(void);
+static void SaveCartNVAsync(void);
 static void LoadCartNV(void);
 static void SaveSTVEEPROM(void);
 static void LoadSTVEEPROM(void);
@@ -129,17 +540,19 @@ static uint8 SCU_SSH2VectorFetch(void);
 static void INLINE MDFN_HOT CheckEventsByMemTS(void);
 
 SH7095 CPU[2]{ {"SH2-M", SS_EVENT_SH2_M_DMA, SCU_MSH2VectorFetch}, {"SH2-S", SS_EVENT_SH2_S_DMA, SCU_SSH2VectorFetch}};
-static uint16 BIOSROM[524288 / sizeof(uint16)];
-static uint16 WorkRAML[1024 * 1024 / sizeof(uint16)];
-static uint16 WorkRAMH[1024 * 1024 / sizeof(uint16)];	// Effectively 32-bit in reality, but 16-bit here because of CPU interpreter design(regarding fastmap).
+SS_HotMemT SS_HotMem;	// see hotmem.h
+static uint16 (&BIOSROM)[524288 / sizeof(uint16)] = SS_HotMem.BIOSROM;
+static uint16 (&WorkRAML)[1024 * 1024 / sizeof(uint16)] = SS_HotMem.WorkRAML;
+static uint16 (&WorkRAMH)[1024 * 1024 / sizeof(uint16)] = SS_HotMem.WorkRAMH;	// Effectively 32-bit in reality, but 16-bit here because of CPU interpreter design(regarding fastmap).
 static uint8 BackupRAM[32768];
 static uint8 BackupRAM_StateHelper[32768];
 static bool BackupRAM_Dirty;
 static int64 BackupRAM_SaveDelay;
 static int64 CartNV_SaveDelay;
+static bool NV_MemoryOnly;	// ss.nv_memory_only: backup RAM and cart NV are never loaded from or saved to files
 
 #define SH7095_EXT_MAP_GRAN_BITS 16
-static uintptr_t SH7095_FastMap[1U << (32 - SH7095_EXT_MAP_GRAN_BITS)];
+static uintptr_t (&SH7095_FastMap)[1U << (32 - SH7095_EXT_MAP_GRAN_BITS)] = SS_HotMem.SH7095_FastMap;
 
 int32 SH7095_mem_timestamp;
 static uint32 SH7095_BusLock;
@@ -156,6 +569,33 @@ static int64_t automation_total_cycles = 0;
 // ForceEventUpdates is NEVER called, so emulated timing is bit-identical
 // whether this hook is active or not.
 static void (*s_automation_inline_hook)(void) = nullptr;
+static void (*s_automation_slave_hook)(void) = nullptr;	// same, before each slave CPU instruction
+
+// Automation: with icache emulation the master's bus accesses catch the slave
+// up from inside CPU[0].Step(), so the slave hook can fire while the master is
+// mid-instruction. A slave stop there is latched: RunSlaveUntil() returns with
+// the slave still at that instruction, and the instrumented run loops take the
+// stop once CPU[0].Step() returns.
+static bool automation_master_in_step = false;
+static bool automation_slave_stop_latched = false;
+static bool automation_slave_hook_skip = false;	// the hook already ran for the slave at this PC
+static uint32 automation_slave_hook_skip_pc = 0;
+
+// Automation: page filter for the inline hook. When only breakpoints/poke
+// triggers need it, the hook runs just for PCs in pages marked here, so the
+// common no-hit case costs one bit test. Features that must see every
+// instruction (stepping, pc_trace, run_to_cycle) turn the filter off.
+enum : unsigned { AUTOHOOK_PAGE_BITS = 12 };
+static uint32 s_automation_hook_pages[2][(1U << (32 - AUTOHOOK_PAGE_BITS)) / 32];
+static bool s_automation_hook_filtered[2] = { false, false };
+
+template<unsigned which>
+static INLINE bool Automation_HookWanted(uint32 pc)
+{
+ const uint32 page = pc >> AUTOHOOK_PAGE_BITS;
+
+ return !s_automation_hook_filtered[which] || ((s_automation_hook_pages[which][page >> 5] >> (page & 31)) & 1);
+}
 
 // Automation: which CPU is currently performing a bus access.
 // 0 = master SH-2, 1 = slave SH-2, 2 = SCU DMA (no CPU).
@@ -176,1183 +616,5542 @@ static constexpr unsigned SHADOW_STACK_MAX = 128;
 static ShadowCallEntry shadow_stack[2][SHADOW_STACK_MAX]; // per-CPU
 static unsigned shadow_stack_depth[2] = {0, 0};
 
-static void ShadowStack_Push(unsigned cpu, uint32 call_site, uint32 target, uint32 return_addr)
+// Automation: exact function profiler on top of the shadow call stack.
+// Each call or return charges the cycles since the previous one to the
+// function on top of the stack (exclusive), along with the instruction-fetch
+// stall cycles counted in MemRead/FetchIF (fprof_wait_acc). Popping a frame
+// charges now - entry to that function (inclusive), so a recursive function
+// counts once per active frame. Functions live in a per-CPU open-addressing
+// table keyed by entry point; FPROF_ROOT collects time outside any tracked
+// call.
+enum : unsigned { FPROF_TABLE_BITS = 12, FPROF_TABLE_SIZE = 1U << FPROF_TABLE_BITS };
+enum : uint32 { FPROF_ROOT = 1 };	// odd, so never a real entry point
+
+struct FProfEntry
 {
- if(shadow_stack_depth[cpu] < SHADOW_STACK_MAX)
- {
-  ShadowCallEntry& e = shadow_stack[cpu][shadow_stack_depth[cpu]++];
-  e.call_site = call_site;
-  e.target = target;
-  e.return_addr = return_addr;
- }
+ uint32 func;	// 0 = empty slot
+ uint32 calls;
+ uint64 incl;
+ uint64 excl;
+ uint64 wait;
+};
+
+static bool fprof_active = false;
+static unsigned fprof_cpu_mask = 0;
+static FProfEntry fprof_table[2][FPROF_TABLE_SIZE];
+static uint32 fprof_used[2];
+static uint64 fprof_dropped[2];		// charges for functions that didn't fit
+static int64 fprof_start_ts[2];
+static int64 fprof_last_ts[2];
+static uint64 fprof_wait_acc[2];	// IF stall cycles since fprof_last_ts
+static int64 fprof_enter_ts[2][SHADOW_STACK_MAX];
+
+static INLINE int64 FProf_Now(unsigned cpu)
+{
+ return automation_total_cycles + CPU[cpu].timestamp;
 }
 
-static void ShadowStack_PopToReturn(unsigned cpu, uint32 pr)
+// Kept at most 3/4 full so probe runs stay short; returns nullptr when full.
+static FProfEntry* FProf_Lookup(unsigned cpu, uint32 func)
 {
- unsigned depth = shadow_stack_depth[cpu];
- // Scan from top for matching return address
- for(int i = (int)depth - 1; i >= 0; i--)
+ uint32 h = (func * 0x9E3779B1U) >> (32 - FPROF_TABLE_BITS);
+
+ for(;;)
  {
-  if(shadow_stack[cpu][i].return_addr == pr)
+  FProfEntry* e = &fprof_table[cpu][h];
+
+  if(e->func == func)
+   return e;
+
+  if(!e->func)
   {
-   shadow_stack_depth[cpu] = (unsigned)i;
-   return;
+   if(fprof_used[cpu] >= FPROF_TABLE_SIZE / 4 * 3)
+    return nullptr;
+
+   fprof_used[cpu]++;
+   e->func = func;
+   return e;
   }
+  h = (h + 1) & (FPROF_TABLE_SIZE - 1);
  }
- // No match — complete desync, clear the stack
- shadow_stack_depth[cpu] = 0;
 }
 
-// Write the shadow call chain for a CPU to a file, inline on one line.
-// Format: chain=target<-target<-target (innermost first, i.e. most recent callee)
-static void ShadowStack_FPrint(FILE* f, unsigned cpu)
+static void FProf_Charge(unsigned cpu, int64 now)
 {
- unsigned depth = shadow_stack_depth[cpu];
- if(depth == 0) return;
- fprintf(f, " chain=");
- for(int i = (int)depth - 1; i >= 0; i--)
+ const unsigned depth = shadow_stack_depth[cpu];
+ FProfEntry* e = FProf_Lookup(cpu, depth ? shadow_stack[cpu][depth - 1].target : (uint32)FPROF_ROOT);
+
+ if(e)
  {
-  if(i < (int)depth - 1) fprintf(f, "<-");
-  fprintf(f, "0x%08X", shadow_stack[cpu][i].target);
+  e->excl += now - fprof_last_ts[cpu];
+  e->wait += fprof_wait_acc[cpu];
  }
+ else
+  fprof_dropped[cpu]++;
+
+ fprof_last_ts[cpu] = now;
+ fprof_wait_acc[cpu] = 0;
 }
 
-// Automation: memory write watchpoint state.
-// Placed before scu.inc so both BusRW_DB_CS3, SCU DMA_Write, and BBusRW_DB can access.
-static bool automation_wp_active = false;
-static uint32 automation_wp_addr = 0;       // Work RAM offset (masked to 0xFFFFF)
-static uint32 automation_wp_full_addr = 0;  // Full address as provided by user (for VDP1/B-bus matching)
-static bool automation_wp_is_lwr = false;   // true = Low Work RAM (CS0), false = High Work RAM (CS3)
-static bool automation_wp_filter_active = false;  // Conditional watchpoint: only fire on specific value
-static uint32 automation_wp_filter_value = 0;     // Value to match (when filter is active)
+static MDFN_COLD NO_INLINE void FProf_Call(unsigned cpu, uint32 target)
+{
+ if(!(fprof_cpu_mask & (1U << cpu)))
+  return;
 
-// Automation: memory READ watchpoint state.
-// Same behavior as write watchpoints — pauses on hit, reports context.
-static bool automation_rwp_active = false;
-static uint32 automation_rwp_addr = 0;      // Work RAM offset (masked to 0xFFFFF)
-static bool automation_rwp_is_lwr = false;  // true = Low Work RAM (CS0), false = High Work RAM (CS3)
-static bool automation_rwp_paused = false;   // true when paused on read watchpoint hit
+ const int64 now = FProf_Now(cpu);
+ FProfEntry* e;
 
-// Automation: VDP2 VRAM write watchpoint (logs ALL writes in an address range)
-static bool automation_vdp2wp_active = false;
-static uint32 automation_vdp2wp_lo = 0;     // Low address (VDP2 bus addr, e.g. 0x05E7E500)
-static uint32 automation_vdp2wp_hi = 0;     // High address (inclusive)
-static FILE* automation_vdp2wp_log = nullptr;
+ FProf_Charge(cpu, now);
+ if(shadow_stack_depth[cpu] < SHADOW_STACK_MAX)
+  fprof_enter_ts[cpu][shadow_stack_depth[cpu]] = now;
 
-// Automation: Code/Data Logging (CDL)
-// Per-byte bitfield for High WRAM (0x06000000-0x060FFFFF, 1MB).
-// Bit 0 (0x01): CODE — fetched as instruction
-// Bit 1 (0x02): DATA_READ — read as data
-// Bit 2 (0x04): DATA_WRITE — written as data
-static bool cdl_active = false;
-static uint8* cdl_bitmap = nullptr;
-static uint32 cdl_lo = 0;
-static uint32 cdl_hi = 0;
-static uint32 cdl_size = 0;
+ if((e = FProf_Lookup(cpu, target)))
+  e->calls++;
+ else
+  fprof_dropped[cpu]++;
+}
 
-// Automation: DMA trace logging
-static FILE* dma_trace_file = nullptr;
+// Frames [new_depth, depth) are about to be popped.
+static MDFN_COLD NO_INLINE void FProf_Unwind(unsigned cpu, unsigned new_depth)
+{
+ if(!(fprof_cpu_mask & (1U << cpu)))
+  return;
 
-// Automation: Memory write profiling
-// Logs {pc, target_addr, value, size} for writes in a configurable address range.
-static FILE* memprofile_file = nullptr;
-static uint32 memprofile_lo = 0;   // Start address (masked to 0x0FFFFFFF)
-static uint32 memprofile_hi = 0;   // End address (inclusive, masked)
+ const int64 now = FProf_Now(cpu);
 
-// Automation: Memory read profiling
-// Logs {pc, pr, addr, size} for reads in a configurable address range.
-static FILE* memreadprofile_file = nullptr;
-static uint32 memreadprofile_lo = 0;
-static uint32 memreadprofile_hi = 0;
+ FProf_Charge(cpu, now);
+ for(unsigned i = new_depth; i < shadow_stack_depth[cpu]; i++)
+ {
+  FProfEntry* e = FProf_Lookup(cpu, shadow_stack[cpu][i].target);
 
-// Forward declaration — used in scu.inc, defined below
-void Automation_LogDMA(int level, uint32 src, uint32 dst, uint32 bytes);
+  if(e)
+   e->incl += now - fprof_enter_ts[cpu][i];
+  else
+   fprof_dropped[cpu]++;
+ }
+}
 
-#include "scu.inc"
+// Restart accounting from now with whatever is on the shadow stacks (start,
+// reset, state load).
+static void FProf_Resync(void)
+{
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const int64 now = FProf_Now(c);
 
-#include "debug.inc"
+  fprof_start_ts[c] = fprof_last_ts[c] = now;
+  fprof_wait_acc[c] = 0;
+  for(unsigned i = 0; i < shadow_stack_depth[c]; i++)
+   fprof_enter_ts[c][i] = now;
+ }
+}
 
-static sha256_digest BIOS_SHA256;	// SHA-256 hash of the currently-loaded BIOS; used for save state sanity checks.
-static int ActiveCartType;		// Used in save states.
-static std::vector<CDInterface*> *cdifs = NULL;
-static std::bitset<1U << (27 - SH7095_EXT_MAP_GRAN_BITS)> FMIsWriteable;
-static uint16 fmap_dummy[(1U << SH7095_EXT_MAP_GRAN_BITS) / sizeof(uint16)];
+// Automation: call graph on top of the shadow call stack. Each call counts
+// an edge from the function on top of the stack (FPROF_ROOT outside any
+// tracked call) to the callee, stamped with the first and last frame it was
+// seen in (Automation_CallGraphFrame). With cycles on, popping a frame
+// charges its entry-to-exit time to the edge that pushed it. Edges live in a
+// per-CPU open-addressing table keyed by (caller, callee); slots are never
+// moved, so each stack frame can keep a pointer to its edge.
+enum : unsigned { CGRAPH_TABLE_BITS = 14, CGRAPH_TABLE_SIZE = 1U << CGRAPH_TABLE_BITS };
 
-/*
- SH-2 external bus address map:
-  CS0: 0x00000000...0x01FFFFFF (16-bit)
-	0x00000000...0x000FFFFF: BIOS ROM (R)
-	0x00100000...0x0017FFFF: SMPC (R/W; 8-bit mapped as 16-bit)
-	0x00180000...0x001FFFFF: Backup RAM(32KiB) (R/W; 8-bit mapped as 16-bit)
-	0x00200000...0x003FFFFF: Low RAM(1MiB) (R/W)
-	0x01000000...0x017FFFFF: Slave FRT Input Capture Trigger (W)
-	0x01800000...0x01FFFFFF: Master FRT Input Capture Trigger (W)
+struct CGraphEdge
+{
+ uint32 caller;	// 0 = empty slot
+ uint32 callee;
+ uint32 first_frame;
+ uint32 last_frame;
+ uint64 calls;
+ uint64 cycles;
+};
 
-  CS1: 0x02000000...0x03FFFFFF (SCU managed)
+static bool cgraph_active = false;
+static bool cgraph_cycles = false;
+static unsigned cgraph_cpu_mask = 0;
+static uint32 cgraph_frame = 0;
+static CGraphEdge cgraph_table[2][CGRAPH_TABLE_SIZE];
+static uint32 cgraph_used[2];
+static uint64 cgraph_dropped[2];	// calls on edges that didn't fit
+static CGraphEdge* cgraph_frame_edge[2][SHADOW_STACK_MAX];
+static int64 cgraph_enter_ts[2][SHADOW_STACK_MAX];
+
+// Kept at most 3/4 full, like FProf_Lookup; returns nullptr when full.
+static CGraphEdge* CGraph_Lookup(unsigned cpu, uint32 caller, uint32 callee)
+{
+ uint32 h = ((caller * 0x9E3779B1U) ^ (callee * 0x85EBCA77U)) >> (32 - CGRAPH_TABLE_BITS);
+
+ for(;;)
+ {
+  CGraphEdge* e = &cgraph_table[cpu][h];
+
+  if(e->caller == caller && e->callee == callee)
+   return e;
+
+  if(!e->caller)
+  {
+   if(cgraph_used[cpu] >= CGRAPH_TABLE_SIZE / 4 * 3)
+    return nullptr;
+
+   cgraph_used[cpu]++;
+   e->caller = caller;
+   e->callee = callee;
+   e->first_frame = cgraph_frame;
+   return e;
+  }
+  h = (h + 1) & (CGRAPH_TABLE_SIZE - 1);
+ }
+}
+
+static MDFN_COLD NO_INLINE void CGraph_Call(unsigned cpu, uint32 target)
+{
+ if(!(cgraph_cpu_mask & (1U << cpu)))
+  return;
+
+ const unsigned depth = shadow_stack_depth[cpu];
+ CGraphEdge* e = CGraph_Lookup(cpu, depth ? shadow_stack[cpu][depth - 1].target : (uint32)FPROF_ROOT, target);
+
+ if(e)
+ {
+  e->calls++;
+  e->last_frame = cgraph_frame;
+ }
+ else
+  cgraph_dropped[cpu]++;
+
+ if(depth < SHADOW_STACK_MAX)
+ {
+  cgraph_frame_edge[cpu][depth] = e;
+  cgraph_enter_ts[cpu][depth] = FProf_Now(cpu);
+ }
+}
+
+// Frames [new_depth, depth) are about to be popped.
+static MDFN_COLD NO_INLINE void CGraph_Unwind(unsigned cpu, unsigned new_depth)
+{
+ if(!(cgraph_cpu_mask & (1U << cpu)))
+  return;
+
+ const int64 now = FProf_Now(cpu);
+
+ for(unsigned i = new_depth; i < shadow_stack_depth[cpu]; i++)
+ {
+  if(cgraph_frame_edge[cpu][i])
+   cgraph_frame_edge[cpu][i]->cycles += now - cgraph_enter_ts[cpu][i];
+ }
+}
+
+static void ShadowStack_Push(unsigned cpu, uint32 call_site, uint32 target, uint32 return_addr)
+{
+ if(MDFN_UNLIKELY(fprof_active))
+  FProf_Call(cpu, target);
+
+ if(MDFN_UNLIKELY(cgraph_active))
+  CGraph_Call(cpu, target);
+
+ if(shadow_stack_depth[cpu] < SHADOW_STACK_MAX)
+ {
+  ShadowCallEntry& e = shadow_stack[cpu][shadow_stack_depth[cpu]++];
+  e.call_site = call_site;
+  e.target = target;
+  e.return_addr = return_addr;
+ }
+}
+
+static void ShadowStack_PopToReturn(unsigned cpu, uint32 pr)
+{
+ unsigned depth = shadow_stack_depth[cpu];
+ unsigned new_depth = 0;	// No match — complete desync, clear the stack
+ // Scan from top for matching return address
+ for(int i = (int)depth - 1; i >= 0; i--)
+ {
+  if(shadow_stack[cpu][i].return_addr == pr)
+  {
+   new_depth = (unsigned)i;
+   break;
+  }
+ }
+
+ if(MDFN_UNLIKELY(fprof_active))
+  FProf_Unwind(cpu, new_depth);
+
+ if(MDFN_UNLIKELY(cgraph_active && cgraph_cycles))
+  CGraph_Unwind(cpu, new_depth);
+
+ shadow_stack_depth[cpu] = new_depth;
+}
+
+// Automation: call trace filters(call_trace_filter), checked before a call
+// event is formatted: callee include/exclude ranges, a shadow stack depth
+// limit and, in text traces, collapsing a run of the same call on one CPU into
+// the first line plus one "repeat=N" line when the run ends. Applies to
+// call_trace and both unified traces; only written lines count as unified
+// lines for insn_trace's triggers.
+enum { CALLTRACE_MAX_RANGES = 16 };
+
+struct CallTraceRun
+{
+ uint32 site, target;
+ uint32 repeats;
+ uint32 last_ts;
+ bool valid;
+};
+
+static bool calltrace_filter = false;
+static uint32 calltrace_include[CALLTRACE_MAX_RANGES][2];	// [lo, hi] inclusive
+static uint32 calltrace_exclude[CALLTRACE_MAX_RANGES][2];
+static unsigned calltrace_n_include = 0, calltrace_n_exclude = 0;
+static unsigned calltrace_max_depth = 0;	// 0 = no limit
+static bool calltrace_collapse = false;
+static CallTraceRun calltrace_run[2];
+static uint64 calltrace_written = 0, calltrace_filtered = 0, calltrace_collapsed = 0;
+
+void Automation_UnifiedLineWritten(void);
+
+static bool CallTrace_Pass(unsigned cpu, uint32 target)
+{
+ if(calltrace_max_depth && shadow_stack_depth[cpu] > calltrace_max_depth)
+  return false;
+
+ if(calltrace_n_include)
+ {
+  unsigned i = 0;
+
+  while(i < calltrace_n_include && (target < calltrace_include[i][0] || target > calltrace_include[i][1]))
+   i++;
+
+  if(i == calltrace_n_include)
+   return false;
+ }
+
+ for(unsigned i = 0; i < calltrace_n_exclude; i++)
+ {
+  if(target >= calltrace_exclude[i][0] && target <= calltrace_exclude[i][1])
+   return false;
+ }
+
+ return true;
+}
+
+static void CallTrace_EndRun(unsigned cpu, FILE* fp)
+{
+ CallTraceRun& r = calltrace_run[cpu];
+
+ if(r.repeats && fp)
+ {
+  fprintf(fp, "%u %c %08X %08X repeat=%u\n", r.last_ts, cpu ? 'S' : 'M', r.site, r.target, r.repeats);
+  Automation_UnifiedLineWritten();
+ }
+ r.valid = false;
+ r.repeats = 0;
+}
+
+// Called for JSR/BSR/BSRF after the shadow stack push, so the depth includes the callee.
+static NO_INLINE void CallTrace_Text(unsigned cpu, uint32 ts, uint32 site, uint32 target)
+{
+ FILE* fp = CPU[cpu].CallTraceFile;
+
+ if(calltrace_filter)
+ {
+  if(!CallTrace_Pass(cpu, target))
+  {
+   calltrace_filtered++;
+   return;
+  }
+
+  if(calltrace_collapse)
+  {
+   CallTraceRun& r = calltrace_run[cpu];
+
+   if(r.valid && r.site == site && r.target == target)
+   {
+    r.repeats++;
+    r.last_ts = ts;
+    calltrace_collapsed++;
+    return;
+   }
+   CallTrace_EndRun(cpu, fp);
+   r.site = site;
+   r.target = target;
+   r.valid = true;
+  }
+ }
+
+ fprintf(fp, "%u %c %08X %08X\n", ts, cpu ? 'S' : 'M', site, target);
+ calltrace_written++;
+ Automation_UnifiedLineWritten();
+}
+
+static NO_INLINE void CallTrace_Bin(unsigned cpu, uint32 ts, uint32 site, uint32 target)
+{
+ if(calltrace_filter && !CallTrace_Pass(cpu, target))
+ {
+  calltrace_filtered++;
+  return;
+ }
+
+ CPU[cpu].CallTraceBin->Call(cpu, ts, site, target);
+ calltrace_written++;
+ Automation_UnifiedLineWritten();
+}
+
+// Write the shadow call chain for a CPU to a file, inline on one line.
+// Format: chain=target<-target<-target (innermost first, i.e. most recent callee)
+// Format " chain=0x...<-0x..." (innermost first) into buf; empty if no frames.
+static void ShadowStack_Format(char* buf, size_t buf_size, unsigned cpu)
+{
+ unsigned depth = shadow_stack_depth[cpu];
+ size_t pos = 0;
+ buf[0] = 0;
+ if(depth == 0) return;
+ pos += snprintf(buf + pos, buf_size - pos, " chain=");
+ for(int i = (int)depth - 1; i >= 0 && pos < buf_size; i--)
+  pos += snprintf(buf + pos, buf_size - pos, "%s0x%08X", (i < (int)depth - 1) ? "<-" : "", shadow_stack[cpu][i].target);
+}
+
+// Automation: sampling profiler. SS_EVENT_PROFILE fires every
+// profile_interval master cycles and counts, per running SH-2, its PC and its
+// shadow call chain. Keys are the raw chain words (outermost call target
+// first), built in a reused scratch string so a sample of a known chain
+// doesn't allocate.
+static bool profile_active = false;
+static sscpu_timestamp_t profile_interval = 0;
+static unsigned profile_cpu_mask = 0;
+static uint64 profile_samples[2];
+static std::unordered_map<uint32, uint64> profile_pcs[2];
+static std::unordered_map<std::string, uint64> profile_stacks[2];
+static std::string profile_key;
+
+static void Profile_Sample(unsigned cpu)
+{
+ const unsigned depth = shadow_stack_depth[cpu];
+
+ profile_key.resize(depth * sizeof(uint32));
+ for(unsigned i = 0; i < depth; i++)
+  memcpy(&profile_key[i * sizeof(uint32)], &shadow_stack[cpu][i].target, sizeof(uint32));
+
+ profile_stacks[cpu][profile_key]++;
+ profile_pcs[cpu][CPU[cpu].PC]++;
+ profile_samples[cpu]++;
+}
+
+static sscpu_timestamp_t Profile_Update(const sscpu_timestamp_t timestamp)
+{
+ if(!profile_active)
+  return SS_EVENT_DISABLED_TS;
+
+ // ForceEventUpdates() calls every handler early; only sample when due.
+ if(timestamp < events[SS_EVENT_PROFILE].event_time)
+  return events[SS_EVENT_PROFILE].event_time;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  if((profile_cpu_mask & (1U << c)) && CPU[c].timestamp != SS_EVENT_DISABLED_TS)
+   Profile_Sample(c);
+ }
+
+ return timestamp + profile_interval;
+}
+
+// Automation: bus profiler. ExtBusRead/ExtBusWrite (sh7095.inc) count every
+// SH-2 external bus access by CPU, direction and region, with the cycles from
+// the CPU's request to the bus finishing it: wait states plus time spent
+// queued behind the other CPU or DMA. Counters accumulate in busprof_cur and
+// are rolled into busprof_last once per frame.
+enum : unsigned
+{
+ BUSPROF_BIOS, BUSPROF_LWRAM, BUSPROF_HWRAM, BUSPROF_VDP1, BUSPROF_VDP2,
+ BUSPROF_SCSP, BUSPROF_CD, BUSPROF_CART, BUSPROF_SCU, BUSPROF_OTHER,
+ BUSPROF_NUM_REGIONS
+};
+
+struct BusProfCounters
+{
+ uint64 count[2][2][BUSPROF_NUM_REGIONS];	// [cpu][is_write][region]
+ uint64 cycles[2][2][BUSPROF_NUM_REGIONS];
+};
+
+static bool busprof_active = false;
+static BusProfCounters busprof_cur, busprof_last, busprof_total;
+
+// A is the 27-bit external bus address.
+static unsigned BusProf_Region(uint32 A)
+{
+ if(A >= 0x06000000) return BUSPROF_HWRAM;
+ if(A >= 0x05FC0000) return BUSPROF_SCU;
+ if(A >= 0x05E00000) return BUSPROF_VDP2;
+ if(A >= 0x05C00000) return BUSPROF_VDP1;
+ if(A >= 0x05A00000) return BUSPROF_SCSP;
+ if(A >= 0x05800000 && A < 0x05900000) return BUSPROF_CD;
+ if(A >= 0x02000000 && A < 0x05000000) return BUSPROF_CART;
+ if(A >= 0x00200000 && A < 0x00400000) return BUSPROF_LWRAM;
+ if(A < 0x00100000) return BUSPROF_BIOS;
+
+ return BUSPROF_OTHER;
+}
+
+static MDFN_COLD NO_INLINE void BusProf_Count(unsigned cpu, bool is_write, uint32 A, sscpu_timestamp_t cycles)
+{
+ const unsigned r = BusProf_Region(A);
+
+ busprof_cur.count[cpu][is_write][r]++;
+ busprof_cur.cycles[cpu][is_write][r] += cycles;
+}
+
+// Automation: interrupt latency profiler. Times each SCU interrupt to the master
+// SH-2, in master cycles, from the edge that makes it pending(SetInt() and
+// ABusIRQCheck() in scu.inc) to the master's vector fetch. CheckDoMasterInt()
+// reports when the SCU raises IRL for it; until then it waits behind a higher
+// priority source or one the master hasn't taken yet, after that only on SR.I.
+// If SR.I is at or above the level when IRL goes up, the master's PC at that
+// point is charged with the cycles until the fetch. Counters roll per frame
+// like the bus profiler's; the masking PC table covers everything since start.
+enum : unsigned
+{
+ INTLAT_SOURCES = 32,
+ INTLAT_BUCKETS = 20,	// floor(log2(cycles)); 0 also holds 0 cycles, the last everything above
+ INTLAT_PC_BITS = 10,
+ INTLAT_PC_SIZE = 1U << INTLAT_PC_BITS
+};
+
+struct IntLatCounters
+{
+ uint64 count[INTLAT_SOURCES];
+ uint64 cycles[INTLAT_SOURCES];
+ uint64 max[INTLAT_SOURCES];
+ uint64 masked[INTLAT_SOURCES];		// fetches that SR.I held off
+ uint64 masked_cycles[INTLAT_SOURCES];
+ uint64 merged[INTLAT_SOURCES];		// asserted again while still pending(one of them is lost)
+ uint64 hist[INTLAT_SOURCES][INTLAT_BUCKETS];
+};
+
+struct IntLatMaskPC
+{
+ uint32 key;		// PC | 1, 0 = unused
+ uint32 sources;	// bit per source held off here
+ uint64 count;
+ uint64 cycles;
+ uint64 max;
+};
+
+static bool intlat_active = false;
+static IntLatCounters intlat_cur, intlat_last, intlat_total;
+static uint64 intlat_frames;
+static IntLatMaskPC intlat_pcs[INTLAT_PC_SIZE];
+static uint32 intlat_pcs_used;
+static uint64 intlat_pcs_dropped;
+static uint32 intlat_pending;			// assertion time known, not yet raised
+static int64 intlat_assert_ts[INTLAT_SOURCES];
+static int64 intlat_ivec_ts;			// assertion time of the source IRL is up for, -1 = unknown
+static unsigned intlat_ivec_src;
+static int64 intlat_raise_ts;
+static uint32 intlat_raise_key;			// PC | 1 if SR.I held it off at the raise, else 0
+
+static INLINE int64 IntLat_Now(void)
+{
+ return automation_total_cycles + CPU[0].timestamp;
+}
+
+static MDFN_COLD NO_INLINE void IntLat_Assert(uint32 bits)
+{
+ const int64 now = IntLat_Now();
+
+ for(uint32 b = bits; b; b &= b - 1)
+ {
+  const unsigned s = MDFN_tzcount32(b);
+
+  if(intlat_pending & (1U << s))
+   intlat_cur.merged[s]++;
+  else
+  {
+   intlat_pending |= 1U << s;
+   intlat_assert_ts[s] = now;
+  }
+ }
+}
+
+// IST writes can drop pending sources without the master taking them.
+static MDFN_COLD NO_INLINE void IntLat_Clear(uint32 still_pending)
+{
+ intlat_pending &= still_pending;
+}
+
+static MDFN_COLD NO_INLINE void IntLat_Raise(unsigned s, unsigned level)
+{
+ intlat_ivec_src = s;
+ intlat_ivec_ts = (intlat_pending & (1U << s)) ? intlat_assert_ts[s] : -1;
+ intlat_pending &= ~(1U << s);
+ intlat_raise_ts = IntLat_Now();
+ intlat_raise_key = (((CPU[0].SR >> 4) & 0xF) >= level) ? (CPU[0].PC | 1) : 0;
+}
+
+static void IntLat_ChargePC(uint32 key, unsigned s, uint64 cycles)
+{
+ uint32 h = (key * 0x9E3779B1U) >> (32 - INTLAT_PC_BITS);
+
+ for(;;)
+ {
+  IntLatMaskPC& e = intlat_pcs[h];
+
+  if(!e.key)
+  {
+   if(intlat_pcs_used >= INTLAT_PC_SIZE / 4 * 3)
+   {
+    intlat_pcs_dropped++;
+    return;
+   }
+   intlat_pcs_used++;
+   e.key = key;
+  }
+
+  if(e.key == key)
+  {
+   e.sources |= 1U << s;
+   e.count++;
+   e.cycles += cycles;
+   e.max = std::max<uint64>(e.max, cycles);
+   return;
+  }
+  h = (h + 1) & (INTLAT_PC_SIZE - 1);
+ }
+}
+
+static MDFN_COLD NO_INLINE void IntLat_Fetch(void)
+{
+ const int64 now = IntLat_Now();
+ const unsigned s = intlat_ivec_src;
+
+ // Unknown, or from before a state load.
+ if(intlat_ivec_ts < 0 || now < intlat_ivec_ts || now < intlat_raise_ts)
+ {
+  intlat_ivec_ts = -1;
+  return;
+ }
+
+ const uint64 lat = now - intlat_ivec_ts;
+ IntLatCounters& c = intlat_cur;
+
+ c.count[s]++;
+ c.cycles[s] += lat;
+ c.max[s] = std::max<uint64>(c.max[s], lat);
+ c.hist[s][(lat >> (INTLAT_BUCKETS - 1)) ? (INTLAT_BUCKETS - 1) : (31 - MDFN_lzcount32((uint32)lat | 1))]++;
+
+ if(intlat_raise_key)
+ {
+  const uint64 held = now - intlat_raise_ts;
+
+  c.masked[s]++;
+  c.masked_cycles[s] += held;
+  IntLat_ChargePC(intlat_raise_key, s, held);
+ }
+ intlat_ivec_ts = -1;
+}
+
+// Automation: sync wait profiler. At each backward BT/BF(the branches idle loop
+// skipping looks at), SH7095::SyncLoopBranch() in sh7095.inc asks
+// IdleLoopAnalyze() whether the loop is a poll: loads and register arithmetic
+// only, with at least one load from work RAM or FTCSR that the other CPU can
+// change. While a CPU keeps taking such a branch, each pass counts as waiting and
+// is charged to the branch's PC. The not-taken branch that leaves the loop ends
+// the wait, and so does an exception, so interrupt handlers count as work.
+// Passes that idle loop skipping jumps over are waiting too.
+enum : unsigned { SYNCPROF_BITS = 10, SYNCPROF_SIZE = 1U << SYNCPROF_BITS };
+
+struct SyncProfPoint
+{
+ uint32 key;		// branch PC | 1, 0 = unused
+ uint32 addr;		// first shared load, as of the latest wait
+ uint64 waits;
+ uint64 passes;
+ uint64 cycles;
+ uint64 max;		// longest single wait
+};
+
+struct SyncProfCPU
+{
+ uint32 bpc;		// last backward BT/BF executed, ~0U after an exception
+ bool taken;
+ SyncProfPoint* point;	// its entry, nullptr if the loop isn't a sync poll
+ int64 last_ts;
+ uint64 wait;		// cycles of the wait in progress
+};
+
+static bool syncprof_active = false;
+static SyncProfPoint syncprof_points[2][SYNCPROF_SIZE];
+static uint32 syncprof_used[2];
+static uint64 syncprof_dropped[2];
+static SyncProfCPU syncprof_cpu[2];
+static uint64 syncprof_frame_wait[2], syncprof_last_wait[2], syncprof_total_wait[2];
+static uint64 syncprof_last_cycles[2], syncprof_total_cycles[2];
+static int64 syncprof_frame_ts;
+
+static SyncProfPoint* SyncProf_Point(unsigned cpu, uint32 bpc, uint32 addr)
+{
+ const uint32 key = bpc | 1;
+ uint32 h = (key * 0x9E3779B1U) >> (32 - SYNCPROF_BITS);
+
+ for(;;)
+ {
+  SyncProfPoint& p = syncprof_points[cpu][h];
+
+  if(!p.key)
+  {
+   if(syncprof_used[cpu] >= SYNCPROF_SIZE / 4 * 3)
+   {
+    syncprof_dropped[cpu]++;
+    return nullptr;
+   }
+   syncprof_used[cpu]++;
+   p.key = key;
+  }
+
+  if(p.key == key)
+  {
+   p.addr = addr;
+   return &p;
+  }
+  h = (h + 1) & (SYNCPROF_SIZE - 1);
+ }
+}
+
+static void SyncProf_End(unsigned cpu)
+{
+ SyncProfCPU& st = syncprof_cpu[cpu];
+
+ if(st.wait)
+ {
+  st.point->waits++;
+  st.point->max = std::max<uint64>(st.point->max, st.wait);
+  st.wait = 0;
+ }
+}
+
+static MDFN_COLD NO_INLINE void SyncProf_Break(unsigned cpu)
+{
+ SyncProf_End(cpu);
+ syncprof_cpu[cpu].bpc = ~0U;
+ syncprof_cpu[cpu].point = nullptr;
+}
+
+// Automation: SH-2 cache statistics. MemRead (sh7095.inc) reports each
+// cacheable area 0 read after the tag lookup; Cache_AssocPurge and SetCCR
+// report purges and CCR writes. Instruction fetches only go through the cache
+// model with full cache emulation (ss.dbg_cem / game database). Misses are
+// also counted per 16-byte line in an open-addressing table whose keys are
+// line | 1 (used) | 2 (instruction fetch).
+enum : unsigned { CSTAT_MISS_BITS = 12, CSTAT_MISS_SIZE = 1U << CSTAT_MISS_BITS };
+
+struct CacheStatCounters
+{
+ uint64 ihit, imiss;
+ uint64 dhit, dmiss;
+ uint64 purges;		// associative purge writes
+ uint64 ccr_writes;	// CCR changed value
+ uint64 ccr_flushes;	// CCR writes with CP set (whole cache invalidated)
+ uint64 miss_dropped;	// misses on lines that didn't fit in the table
+};
+
+struct CacheStatMiss
+{
+ uint32 key;
+ uint32 count;
+};
+
+static bool cstat_active = false;
+static CacheStatCounters cstat[2];
+static CacheStatMiss cstat_miss[2][CSTAT_MISS_SIZE];
+static uint32 cstat_miss_used[2];
+
+static MDFN_COLD NO_INLINE void CacheStat_Read(unsigned cpu, bool instr, bool hit, uint32 A)
+{
+ CacheStatCounters& cs = cstat[cpu];
+
+ if(hit)
+ {
+  (instr ? cs.ihit : cs.dhit)++;
+  return;
+ }
+
+ (instr ? cs.imiss : cs.dmiss)++;
+
+ const uint32 key = (A & 0x1FFFFFF0) | 1 | (instr << 1);
+ uint32 h = (key * 0x9E3779B1U) >> (32 - CSTAT_MISS_BITS);
+
+ for(;;)
+ {
+  CacheStatMiss& m = cstat_miss[cpu][h];
+
+  if(m.key == key)
+  {
+   m.count++;
+   return;
+  }
+
+  if(!m.key)
+  {
+   if(cstat_miss_used[cpu] >= CSTAT_MISS_SIZE / 4 * 3)
+   {
+    cs.miss_dropped++;
+    return;
+   }
+   cstat_miss_used[cpu]++;
+   m.key = key;
+   m.count = 1;
+   return;
+  }
+  h = (h + 1) & (CSTAT_MISS_SIZE - 1);
+ }
+}
+
+// Cache emulation "detect" mode(ss.dbg_cem detect, or the cache_mode automation
+// command): run a game without a database entry in the fast data-only mode, and
+// switch both CPUs to full cache emulation at the next frame once one of them does
+// something whose outcome can depend on the instruction cache(CEM_HIT_*, enabled
+// per ss.dbg_cem_detect). The switch is one way; a state saved with full
+// emulation switches on load too.
+enum : unsigned
+{
+ CEM_HIT_ASSOC_PURGE = 0x01,	// associative purge
+ CEM_HIT_CCR_PURGE = 0x02,	// CCR CP with the cache on, outside the BIOS
+ CEM_HIT_ALIAS = 0x04,		// cache-through write to a line the writer has cached
+ CEM_HIT_SMC = 0x08,		// write within 32 bytes past either CPU's PC
+};
+static bool cem_detect_armed = false;
+static unsigned cem_detect_mask = 0;
+static bool cem_switch_pending = false;
+static struct
+{
+ unsigned reason;
+ unsigned cpu;
+ uint32 addr;
+ uint32 pc;
+ int64 cycle;
+} cem_hit;
+
+static MDFN_COLD NO_INLINE void CEM_DetectHit(unsigned reason, unsigned cpu, uint32 A, uint32 pc)
+{
+ if(!(cem_detect_mask & reason))
+  return;
+
+ cem_detect_armed = false;
+ cem_switch_pending = true;
+ cem_hit.reason = reason;
+ cem_hit.cpu = cpu;
+ cem_hit.addr = A;
+ cem_hit.pc = pc;
+ cem_hit.cycle = automation_total_cycles + CPU[0].timestamp;
+}
+
+// Automation: memory read/write watchpoints, any number of address ranges.
+// Placed before scu.inc so BusRW_DB_CS0/CS3, SCU DMA_Write, and BBusRW_DB can access.
+// Each bus path first tests a per-direction bitmap of 4KB pages holding at
+// least one watchpoint, so accesses to unwatched memory pay one bit test; only
+// accesses to a watched page compare against the list.
+enum : unsigned
+{
+ AUTOWP_LWR = 0,	// Low Work RAM (CS0), offset & 0xFFFFF
+ AUTOWP_HWR = 1,	// High Work RAM (CS3), offset & 0xFFFFF
+ AUTOWP_VDP1 = 2,	// VDP1 VRAM/framebuffer/registers (B-bus, writes only), offset & 0x1FFFFF
+ AUTOWP_NUM_REGIONS = 3
+};
+enum : unsigned { AUTOWP_REGION_BITS = 21, AUTOWP_PAGE_BITS = 12 };
+
+struct AutomationWatch
+{
+ unsigned id;
+ unsigned region;
+ uint32 start;	// region offset
+ uint32 end;	// exclusive
+ bool is_read;
+ bool filter_active;	// only fire when the new (read: loaded) value equals filter_value
+ uint32 filter_value;
+};
+
+static std::vector<AutomationWatch> automation_watches;
+static uint32 automation_wp_pages[2][(AUTOWP_NUM_REGIONS << (AUTOWP_REGION_BITS - AUTOWP_PAGE_BITS)) / 32];	// [is_read]
+
+static INLINE bool Automation_WatchPage(const bool is_read, const unsigned region, const uint32 offs)
+{
+ const uint32 page = (region << (AUTOWP_REGION_BITS - AUTOWP_PAGE_BITS)) | (offs >> AUTOWP_PAGE_BITS);
+
+ return automation_wp_pages[is_read][page >> 5] & (1U << (page & 31));
+}
+
+// Maps a bus address to a watch region; false if it isn't watchable.
+static bool Automation_WatchRegion(uint32 addr, unsigned* region, uint32* offs, uint32* region_size)
+{
+ const uint32 masked = addr & 0x0FFFFFFF;	// cache-through mirrors
+
+ if(masked >= 0x00200000 && masked <= 0x003FFFFF)
+ {
+  *region = AUTOWP_LWR;
+  *offs = masked & 0xFFFFF;
+  *region_size = 0x100000;
+ }
+ else if(masked >= 0x06000000 && masked <= 0x07FFFFFF)
+ {
+  *region = AUTOWP_HWR;
+  *offs = masked & 0xFFFFF;
+  *region_size = 0x100000;
+ }
+ else if(masked >= 0x05C00000 && masked <= 0x05D7FFFF)
+ {
+  *region = AUTOWP_VDP1;
+  *offs = masked & 0x1FFFFF;
+  *region_size = 0x180000;
+ }
+ else
+  return false;
+
+ return true;
+}
+
+// Whether any page of [addr, addr + len) (clamped to addr's region) holds a
+// watchpoint. Lets DMA-style writers check once per transfer instead of per word.
+static NO_INLINE bool Automation_WatchSpan(bool is_read, uint32 addr, uint64 len)
+{
+ unsigned region;
+ uint32 offs, region_size;
+
+ if(!len || !Automation_WatchRegion(addr, &region, &offs, &region_size))
+  return false;
+
+ const uint32 last = (uint32)std::min<uint64>((uint64)offs + len - 1, region_size - 1);
+
+ for(uint32 p = offs >> AUTOWP_PAGE_BITS; p <= (last >> AUTOWP_PAGE_BITS); p++)
+ {
+  if(Automation_WatchPage(is_read, region, p << AUTOWP_PAGE_BITS))
+   return true;
+ }
+
+ return false;
+}
+
+// Names the bus master behind a watched write for the hit's source= tag.
+// automation_current_cpu is 0/1 for an SH-2 (CPU or its DMAC), 2 while SCU
+// DMA runs (SCU_UpdateDMA), 3 while an SCU DSP DMA writes out (DMAInstr).
+static INLINE const char* Automation_WatchSource(const bool sh2_dma)
+{
+ if(automation_current_cpu == 2)
+  return "DMA";
+
+ if(automation_current_cpu == 3)
+  return "DSP";
+
+ return sh2_dma ? "SH2DMA" : "CPU";
+}
+
+// Automation: indexed write log (write_log_start / last_writer). Each write to
+// a logged Work RAM range goes into a ring of WriteLogEntry, and every 32-bit
+// word keeps the sequence number of its newest entry, which links to the one
+// before it; "who last wrote X before cycle C" walks that chain back instead
+// of searching the log. Logged pages are marked in the write watch bitmap, so
+// the log sees what write watchpoints see (both CPUs and their DMA, SCU DMA,
+// SCU DSP) and writes to other pages pay nothing extra.
+struct WriteLogEntry
+{
+ int64 cycle;
+ uint64 prev;		// sequence number + 1 of the word's previous entry, 0 = none
+ uint32 pc;		// 0 for SCU DMA and DSP writes
+ uint32 addr;		// bits 0-27: address; 28-29: log2(size); 30-31: automation_current_cpu
+ uint32 old_val;	// the 32-bit word before and after the write
+ uint32 new_val;
+};
+
+struct WriteLogRange
+{
+ unsigned region;
+ uint32 start, end;	// region offsets, end exclusive
+};
+
+static bool writelog_active = false;
+static std::vector<WriteLogRange> writelog_ranges;
+static std::unique_ptr<WriteLogEntry[]> writelog_ring;
+static uint64 writelog_mask = 0;
+static uint64 writelog_total = 0;			// entries ever written (next sequence number)
+static std::unique_ptr<uint64[]> writelog_head[2];	// [AUTOWP_LWR/HWR][word]: newest sequence number + 1
+
+static MDFN_COLD NO_INLINE void Automation_WriteLog(unsigned region, uint32 offs, unsigned size, uint32 old_val, uint32 new_val, uint32 pc)
+{
+ bool logged = false;
+
+ for(const WriteLogRange& r : writelog_ranges)
+  logged |= (r.region == region && offs < r.end && offs >= r.start);
+
+ if(!logged)
+  return;
+
+ const unsigned cpu = (automation_current_cpu < 2) ? automation_current_cpu : 0;
+ uint64& head = writelog_head[region][offs >> 2];
+ WriteLogEntry& e = writelog_ring[writelog_total & writelog_mask];
+
+ e.cycle = automation_total_cycles + CPU[cpu].timestamp;
+ e.prev = head;
+ e.pc = pc;
+ e.addr = ((region == AUTOWP_HWR) ? 0x06000000 : 0x00200000) + offs;
+ e.addr |= ((size == 4) ? 2 : (size >> 1)) << 28;	// log2
+ e.addr |= (automation_current_cpu & 3) << 30;
+ e.old_val = old_val;
+ e.new_val = new_val;
+ head = ++writelog_total;
+}
+
+// A write to [offs, offs + size) on a watched page changed the word covering it
+// (32-bit for Work RAM, 16-bit for VDP1) from old_val to new_val.
+static MDFN_COLD NO_INLINE void Automation_WatchWrite(unsigned region, uint32 A, uint32 offs, unsigned size, uint32 old_val, uint32 new_val, uint32 pc, uint32 pr, const char* source)
+{
+ if(writelog_active && region != AUTOWP_VDP1)
+  Automation_WriteLog(region, offs, size, old_val, new_val, pc);
+
+ if(old_val == new_val)
+  return;
+
+ // Indexed rather than range-for: a pausing hit runs commands that may edit the list.
+ for(size_t i = 0; i < automation_watches.size(); i++)
+ {
+  const AutomationWatch w = automation_watches[i];
+
+  if(w.is_read || w.region != region || offs >= w.end || offs + size <= w.start)
+   continue;
+
+  if(w.filter_active && new_val != w.filter_value)
+   continue;
+
+  ::Automation_WatchpointHit(w.id, pc, A, old_val, new_val, pr, source);
+ }
+}
+
+static MDFN_COLD NO_INLINE void Automation_WatchRead(unsigned region, uint32 A, uint32 offs, unsigned size, uint32 val)
+{
+ for(size_t i = 0; i < automation_watches.size(); i++)
+ {
+  const AutomationWatch w = automation_watches[i];
+
+  if(!w.is_read || w.region != region || offs >= w.end || offs + size <= w.start)
+   continue;
+
+  if(w.filter_active && val != w.filter_value)
+   continue;
+
+  ::Automation_ReadWatchpointHit(w.id, CPU[automation_current_cpu].PC, A, val, CPU[automation_current_cpu].PR);
+ }
+}
+
+// Automation: VDP2 VRAM write watchpoint (logs ALL writes in an address range)
+// through the async trace writer. Text mode keeps the old one-line-per-write
+// format. The binary modes start with "MDFNV2W1" (binary) or "MDFNV2A1"
+// (aggregate), le32 lo, le32 hi, le32 line size (0 for binary), le32 flags
+// (bit 0: the rest is in TraceRing deflate blocks). Binary mode then writes
+// 20-byte records: le64 master cycle, le32 pc, le32 addr, le16 value, u8
+// size, u8 source (Automation_VDP2WatchSourceID()). Aggregate mode only
+// counts writes per line and keeps up to VDP2WP_AGG_PCS distinct PCs per
+// line, dumped once per frame that saw writes: le64 frame, le32 line count n,
+// n times le32 line address, le32 writes, u8 PC count k, u8 overflow (more
+// PCs than kept), le16 0, k times le32 pc.
+enum { VDP2WP_TEXT = 0, VDP2WP_BIN, VDP2WP_AGG };
+enum { VDP2WP_AGG_PCS = 4 };
+
+struct VDP2WPLine
+{
+ uint32 writes;
+ uint32 pcs[VDP2WP_AGG_PCS];
+ uint8 npcs;
+ uint8 overflow;
+};
+
+static bool automation_vdp2wp_active = false;
+static uint32 automation_vdp2wp_lo = 0;     // Low address (VDP2 bus addr, e.g. 0x05E7E500)
+static uint32 automation_vdp2wp_hi = 0;     // High address (inclusive)
+static unsigned automation_vdp2wp_mode = VDP2WP_TEXT;
+static TraceRing* automation_vdp2wp_ring = nullptr;
+static unsigned vdp2wp_line_bits = 6;
+static std::vector<VDP2WPLine> vdp2wp_lines;
+static std::vector<uint32> vdp2wp_touched;	// indices into vdp2wp_lines written this frame
+static std::vector<uint8> vdp2wp_buf;
+static uint64 vdp2wp_records = 0;
+
+// 0 master CPU, 1 slave CPU, 2 SCU DMA, 3 SCU DSP, 4 master SH-2 DMAC, 5 slave SH-2 DMAC.
+static INLINE uint8 Automation_VDP2WatchSourceID(const bool sh2_dma)
+{
+ if(automation_current_cpu >= 2)
+  return automation_current_cpu;
+
+ return automation_current_cpu + (sh2_dma ? 4 : 0);
+}
+
+static MDFN_COLD NO_INLINE void Automation_VDP2WatchWrite(uint32 A, uint16 val, unsigned size, bool sh2_dma)
+{
+ const unsigned cpu = automation_current_cpu < 2 ? automation_current_cpu : 0;
+ const uint32 pc = (automation_current_cpu < 2) ? CPU[automation_current_cpu].PC : 0;
+
+ vdp2wp_records++;
+
+ if(automation_vdp2wp_mode == VDP2WP_TEXT)
+ {
+  automation_vdp2wp_ring->Printf("vdp2w addr=0x%08X val=0x%04X pc0=0x%08X pc1=0x%08X pr0=0x%08X pr1=0x%08X\n",
+   A, (unsigned)val, CPU[0].PC, CPU[1].PC, CPU[0].PR, CPU[1].PR);
+ }
+ else if(automation_vdp2wp_mode == VDP2WP_BIN)
+ {
+  uint8 rec[20];
+
+  MDFN_en64lsb(&rec[0], automation_total_cycles + CPU[cpu].timestamp);
+  MDFN_en32lsb(&rec[8], pc);
+  MDFN_en32lsb(&rec[12], A);
+  MDFN_en16lsb(&rec[16], val);
+  rec[18] = size;
+  rec[19] = Automation_VDP2WatchSourceID(sh2_dma);
+  automation_vdp2wp_ring->Write(rec, sizeof(rec));
+ }
+ else
+ {
+  const uint32 i = (A - automation_vdp2wp_lo) >> vdp2wp_line_bits;
+  VDP2WPLine& l = vdp2wp_lines[i];
+
+  if(!l.writes++)
+   vdp2wp_touched.push_back(i);
+
+  unsigned j = 0;
+
+  while(j < l.npcs && l.pcs[j] != pc)
+   j++;
+
+  if(j == l.npcs)
+  {
+   if(l.npcs < VDP2WP_AGG_PCS)
+    l.pcs[l.npcs++] = pc;
+   else
+    l.overflow = 1;
+  }
+ }
+}
+
+// Automation: Code/Data Logging (CDL)
+// Per-byte bitfield over the whole 27-bit SH-2 bus, kept in a two-level
+// sparse table: cdl_pages[] points at 4KB flag pages allocated on first touch.
+// Bit 0 (0x01): CODE — fetched as instruction
+// Bit 1 (0x02): DATA_READ — read as data
+// Bit 2 (0x04): DATA_WRITE — written as data
+// Bit 4 (0x10): touched by the master SH-2
+// Bit 5 (0x20): touched by the slave SH-2
+// Pages outside [cdl_lo, cdl_hi) all point at cdl_discard_page, so a
+// restricted range costs no more per access than the full bus.
+// A page that gains a bit goes on cdl_dirty_list; cdl_delta compares only
+// those pages against cdl_seen[] (the flags it last reported).
+//
+// cdl_code_pages has a bit per page that has had code executed in it. With
+// the overlay log on (Automation_CDLOverlayStart), a CPU or DMA write into
+// such a page writes one 16-byte record and clears the bit, so an overlay
+// load costs one record per replaced page until code runs there again:
+// le64 frame, le32 page address, u8 writer (CDLOVL_SRC_*), three zero bytes.
+enum : unsigned { CDL_PAGE_BITS = 12, CDL_BUS_BITS = 27, CDL_NUM_PAGES = 1U << (CDL_BUS_BITS - CDL_PAGE_BITS) };
+enum
+{
+ CDLOVL_SRC_SCU0 = 0,	// SCU DMA levels 0-2
+ CDLOVL_SRC_SH2DMA = 3,	// 3 + cpu * 2 + channel
+ CDLOVL_SRC_CPU = 8	// 8 master, 9 slave
+};
+
+static bool cdl_active = false;
+static uint8* cdl_pages[CDL_NUM_PAGES];
+static uint8* cdl_seen[CDL_NUM_PAGES];
+static uint8 cdl_discard_page[1U << CDL_PAGE_BITS];
+static uint32 cdl_dirty[CDL_NUM_PAGES / 32];
+static std::vector<uint32> cdl_dirty_list;
+static uint32 cdl_lo = 0;
+static uint32 cdl_hi = 0;
+static uint32 cdl_page_count = 0;
+static uint32 cdl_code_pages[CDL_NUM_PAGES / 32];
+static TraceRing* cdl_ovl_ring = nullptr;
+static uint64 cdl_ovl_frame = 0;
+static uint64 cdl_ovl_events = 0;
+
+static MDFN_COLD NO_INLINE uint8* CDL_AllocPage(uint32 page)
+{
+ const uint32 base = page << CDL_PAGE_BITS;
+ uint8* p = cdl_discard_page;
+
+ if(base < cdl_hi && base + (1U << CDL_PAGE_BITS) > cdl_lo)
+ {
+  p = new(std::nothrow) uint8[1U << CDL_PAGE_BITS]();
+  if(p)
+   cdl_page_count++;
+  else
+   p = cdl_discard_page;
+ }
+
+ cdl_pages[page] = p;
+ return p;
+}
+
+static MDFN_COLD NO_INLINE void CDL_Dirty(uint32 page)
+{
+ if(cdl_dirty[page >> 5] & (1U << (page & 31)))
+  return;
+
+ cdl_dirty[page >> 5] |= 1U << (page & 31);
+ cdl_dirty_list.push_back(page);
+}
+
+// A is an area 0 (cached) or area 1 (cache-through) address; callers filter
+// out the cache/purge/on-chip areas.
+static INLINE void CDL_Mark(uint32 A, unsigned size, uint8 bits)
+{
+ A &= (1U << CDL_BUS_BITS) - 1;
+
+ const uint32 page = A >> CDL_PAGE_BITS;
+ uint8* p = cdl_pages[page];
+
+ if(MDFN_UNLIKELY(!p))
+  p = CDL_AllocPage(page);
+
+ p += A & ((1U << CDL_PAGE_BITS) - 1);
+ for(unsigned i = 0; i < size; i++)
+ {
+  // Steady state is re-marking known bytes: test first, so only new coverage writes.
+  if(MDFN_UNLIKELY((p[i] | bits) != p[i]))
+  {
+   p[i] |= bits;
+   CDL_Dirty(page);
+   if(bits & 0x01)
+    cdl_code_pages[page >> 5] |= 1U << (page & 31);
+  }
+ }
+}
+
+static MDFN_COLD NO_INLINE void CDL_OverlayHit(uint32 page, unsigned source)
+{
+ uint8 rec[16];
+
+ cdl_code_pages[page >> 5] &= ~(1U << (page & 31));
+ MDFN_en64lsb(&rec[0], cdl_ovl_frame);
+ MDFN_en32lsb(&rec[8], page << CDL_PAGE_BITS);
+ rec[12] = source;
+ rec[13] = rec[14] = rec[15] = 0;
+ if(cdl_ovl_ring->Write(rec, sizeof(rec)))
+  cdl_ovl_events++;
+}
+
+// A write of len bytes at A (area 0/1 or SCU bus address) by source.
+static INLINE void CDL_CheckOverlay(uint32 A, uint32 len, unsigned source)
+{
+ A &= (1U << CDL_BUS_BITS) - 1;
+
+ const uint32 last = std::min<uint64>((uint64)A + std::max<uint32>(len, 1) - 1, (1U << CDL_BUS_BITS) - 1) >> CDL_PAGE_BITS;
+
+ for(uint32 page = A >> CDL_PAGE_BITS; page <= last; page++)
+ {
+  if(MDFN_UNLIKELY(cdl_code_pages[page >> 5] & (1U << (page & 31))))
+   CDL_OverlayHit(page, source);
+ }
+}
+
+// Automation: DMA trace logging (async ring, see trace_ring.h)
+static TraceRing* dma_trace_ring = nullptr;
+
+// Automation: recent events for crash bundles (Automation_RecentEventsStart). The last
+// RecentEv_Count SCU DMA starts and CD Block trace lines, kept in memory only.
+enum : unsigned { RecentEv_Count = 256, RecentEv_TextMax = 120 };
+struct RecentEv
+{
+ int64 cycle;
+ const char* kind;	// "DMA" or "CDB"
+ char text[RecentEv_TextMax];
+};
+static RecentEv* recent_ev = nullptr;	// non-null while on
+static uint64 recent_ev_total;
+
+// Automation: VBlank-IN vectors taken by the master SH-2 (Automation_VBlankInTaken).
+static uint64 automation_vbin_taken = 0;
+
+// Automation: binary DMA trace with per-frame bandwidth (Automation_DMATraceBinStart). One
+// record per finished SCU DMA transfer(each indirect table entry counts), SH-2 DMAC channel
+// run and SCSP DMA, plus per-frame totals by source and region pair.
+enum
+{
+ DMABIN_SRC_SCU0 = 0,	// levels 0-2
+ DMABIN_SRC_SH2 = 3,	// 3 + cpu * 2 + channel
+ DMABIN_SRC_SCSP = 7,
+ DMABIN_SRC__COUNT
+};
+enum { DMABIN_REGION__COUNT = 10 };	// see DMABin_Region()
+struct DMABinStart
+{
+ int64 cycle;
+ uint32 src, dst, bytes;
+ bool open;
+};
+struct DMABinSum
+{
+ uint32 count;
+ uint64 bytes;
+};
+static TraceRing* dmabin_ring = nullptr;
+static bool dmabin_frames_only = false;	// frame summaries without per-transfer records
+static DMABinStart dmabin_scu[3];
+static DMABinStart dmabin_sh2[2][2];
+static DMABinSum dmabin_sum[DMABIN_SRC__COUNT][DMABIN_REGION__COUNT][DMABIN_REGION__COUNT];
+static uint32 dmabin_frame_transfers;
+static uint64 dmabin_frame_cycles, dmabin_frame_stall;
+static uint64 dmabin_transfers, dmabin_bytes, dmabin_frames;
+
+// Automation: binary unified trace (see bin_trace.h); also receives DMA records.
+static BinTrace* unified_bin = nullptr;
+
+// Automation: Memory write profiling
+// Logs {pc, target_addr, value, size} for writes in a configurable address range.
+static TraceRing* memprofile_ring = nullptr;
+static uint32 memprofile_lo = 0;   // Start address (masked to 0x0FFFFFFF)
+static uint32 memprofile_hi = 0;   // End address (inclusive, masked)
+
+// Automation: Memory read profiling
+// Logs {pc, pr, addr, size} for reads in a configurable address range.
+static TraceRing* memreadprofile_ring = nullptr;
+static uint32 memreadprofile_lo = 0;
+static uint32 memreadprofile_hi = 0;
+
+// Automation: opcode histogram (op_stats); while set, Emulate() runs the
+// DebugMode run loops, which are the only ones that count. See OpStats_Start().
+static bool opstats_active = false;
+
+// Automation: SCU DSP profile (dsp_profile_start). While set, SCU_UpdateDSP()
+// runs DSP_RunProfiled() instead of its plain loop, counting executions and
+// stall cycles per program RAM address and, with a trace file, writing one
+// record per instruction (see Automation_DSPProfileStart()).
+static bool automation_dsp_profile = false;
+static uint16 automation_dsp_next_addr = 0x100;	// where DSP.NextInstr came from; 0x100 = the placeholder after a PC load
+static uint64 dsp_prof_exec[256];
+static uint64 dsp_prof_stall[256];
+static TraceRing* dsp_trace_ring = nullptr;
+static uint64 dsp_trace_records = 0;
+
+// Automation: memory access heatmap (mem_heatmap), the aggregating form of
+// the two profiles above. Data accesses in [heatmap_lo, heatmap_lo +
+// heatmap_size) are counted per 64-byte line, split into CPU (either SH-2)
+// and DMA (SH-2 DMAC, SCU DMA) reads and writes. CPU accesses also count into
+// an open-addressed (pc, line) table, from which the dump keeps the top
+// entries. Automation_HeatmapFrame() writes the counters in binary every N
+// frames and clears them.
+enum : unsigned { HEATMAP_LINE_BITS = 6, HEATMAP_PC_BITS = 16, HEATMAP_PC_SIZE = 1U << HEATMAP_PC_BITS };
+
+struct HeatmapLine
+{
+ uint32 cpu_read, cpu_write, dma_read, dma_write;
+};
+
+struct HeatmapPC
+{
+ uint32 pc, line;	// unused while reads + writes == 0
+ uint32 reads, writes;
+};
+
+static HeatmapLine* heatmap_lines = nullptr;	// nullptr = off
+static uint32 heatmap_lo = 0;
+static uint32 heatmap_size = 0;
+static HeatmapPC* heatmap_pcs = nullptr;	// nullptr = no (pc, line) table (top=0)
+static uint32 heatmap_pcs_used = 0;
+static uint32 heatmap_pcs_dropped = 0;
+
+static NO_INLINE void Heatmap_PC(uint32 pc, uint32 line, bool write)
+{
+ uint32 h = ((pc * 0x9E3779B1U) ^ (line * 0x85EBCA77U)) >> (32 - HEATMAP_PC_BITS);
+
+ for(;;)
+ {
+  HeatmapPC& e = heatmap_pcs[h];
+
+  if(!(e.reads | e.writes))
+  {
+   if(heatmap_pcs_used >= HEATMAP_PC_SIZE / 4 * 3)
+   {
+    heatmap_pcs_dropped++;
+    return;
+   }
+   heatmap_pcs_used++;
+   e.pc = pc;
+   e.line = line;
+  }
+  else if(e.pc != pc || e.line != line)
+  {
+   h = (h + 1) & (HEATMAP_PC_SIZE - 1);
+   continue;
+  }
+
+  (write ? e.writes : e.reads)++;
+  return;
+ }
+}
+
+static INLINE void Heatmap_Access(uint32 A, bool write, bool dma, uint32 pc)
+{
+ const uint32 offs = (A & 0x0FFFFFFF) - heatmap_lo;
+
+ if(offs >= heatmap_size)
+  return;
+
+ HeatmapLine& l = heatmap_lines[offs >> HEATMAP_LINE_BITS];
+
+ if(dma)
+  (write ? l.dma_write : l.dma_read)++;
+ else
+ {
+  (write ? l.cpu_write : l.cpu_read)++;
+
+  if(heatmap_pcs)
+   Heatmap_PC(pc, offs >> HEATMAP_LINE_BITS, write);
+ }
+}
+
+// Forward declaration — used in scu.inc, defined below
+void Automation_LogDMA(int level, uint32 src, uint32 dst, uint32 bytes);
+void Automation_RecentEvent(int64 cycle, const char* kind, const char* text);
+static void DMABin_Transfer(unsigned source, uint32 src, uint32 dst, uint32 bytes, int64 start, int64 end, uint32 stall);
+
+#include "scu.inc"
+
+#include "debug.inc"
+
+static sha256_digest BIOS_SHA256;	// SHA-256 hash of the currently-loaded BIOS; used for save state sanity checks.
+static int ActiveCartType;		// Used in save states.
+static std::vector<CDInterface*> *cdifs = NULL;
+static std::bitset<1U << (27 - SH7095_EXT_MAP_GRAN_BITS)> FMIsWriteable;
+static uint16 fmap_dummy[(1U << SH7095_EXT_MAP_GRAN_BITS) / sizeof(uint16)];
+
+/*
+ SH-2 external bus address map:
+  CS0: 0x00000000...0x01FFFFFF (16-bit)
+	0x00000000...0x000FFFFF: BIOS ROM (R)
+	0x00100000...0x0017FFFF: SMPC (R/W; 8-bit mapped as 16-bit)
+	0x00180000...0x001FFFFF: Backup RAM(32KiB) (R/W; 8-bit mapped as 16-bit)
+	0x00200000...0x003FFFFF: Low RAM(1MiB) (R/W)
+	0x01000000...0x017FFFFF: Slave FRT Input Capture Trigger (W)
+	0x01800000...0x01FFFFFF: Master FRT Input Capture Trigger (W)
+
+  CS1: 0x02000000...0x03FFFFFF (SCU managed)
 	0x02000000...0x03FFFFFF: A-bus CS0 (R/W)
 
-  CS2: 0x04000000...0x05FFFFFF (SCU managed)
-	0x04000000...0x04FFFFFF: A-bus CS1 (R/W)
-	0x05000000...0x057FFFFF: A-bus Dummy
-	0x05800000...0x058FFFFF: A-bus CS2 (R/W)
-	0x05A00000...0x05AFFFFF: SCSP RAM (R/W)
-	0x05B00000...0x05BFFFFF: SCSP Registers (R/W)
-	0x05C00000...0x05C7FFFF: VDP1 VRAM (R/W)
-	0x05C80000...0x05CFFFFF: VDP1 FB RAM (R/W; swappable between two framebuffers, but may be temporarily unreadable at swap time)
-	0x05D00000...0x05D7FFFF: VDP1 Registers (R/W)
-	0x05E00000...0x05EFFFFF: VDP2 VRAM (R/W)
-	0x05F00000...0x05F7FFFF: VDP2 CRAM (R/W; 8-bit writes are illegal)
-	0x05F80000...0x05FBFFFF: VDP2 Registers (R/W; 8-bit writes are illegal)
-	0x05FE0000...0x05FEFFFF: SCU Registers (R/W)
-	0x05FF0000...0x05FFFFFF: SCU Debug/Test Registers (R/W)
+  CS2: 0x04000000...0x05FFFFFF (SCU managed)
+	0x04000000...0x04FFFFFF: A-bus CS1 (R/W)
+	0x05000000...0x057FFFFF: A-bus Dummy
+	0x05800000...0x058FFFFF: A-bus CS2 (R/W)
+	0x05A00000...0x05AFFFFF: SCSP RAM (R/W)
+	0x05B00000...0x05BFFFFF: SCSP Registers (R/W)
+	0x05C00000...0x05C7FFFF: VDP1 VRAM (R/W)
+	0x05C80000...0x05CFFFFF: VDP1 FB RAM (R/W; swappable between two framebuffers, but may be temporarily unreadable at swap time)
+	0x05D00000...0x05D7FFFF: VDP1 Registers (R/W)
+	0x05E00000...0x05EFFFFF: VDP2 VRAM (R/W)
+	0x05F00000...0x05F7FFFF: VDP2 CRAM (R/W; 8-bit writes are illegal)
+	0x05F80000...0x05FBFFFF: VDP2 Registers (R/W; 8-bit writes are illegal)
+	0x05FE0000...0x05FEFFFF: SCU Registers (R/W)
+	0x05FF0000...0x05FFFFFF: SCU Debug/Test Registers (R/W)
+
+  CS3: 0x06000000...0x07FFFFFF
+	0x06000000...0x07FFFFFF: High RAM/SDRAM(1MiB) (R/W)
+*/
+//
+// Never add anything to SH7095_mem_timestamp when DMAHax is true.
+//
+// When BurstHax is true and we're accessing high work RAM, don't add anything.
+//
+// Instrumented=false(the SH-2s' plain run loop) compiles out the watchpoint checks; SH-2 DMA always keeps them.
+template<typename T, bool IsWrite, bool Instrumented = true>
+static INLINE void BusRW_DB_CS0(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+{
+ //
+ // Low(and kinda slow) work RAM
+ //
+ if(A >= 0x00200000 && A <= 0x003FFFFF)
+ {
+  if(!SH2DMAHax)
+   SH7095_mem_timestamp += 7;
+  else
+   *SH2DMAHax += 7;
+
+  //
+  // VA0 and VA1 don't map DRAM in the upper 1MiB of the 2MiB region, and return 0xFFFF(~0) on reads.
+  // VA2 mirrors DRAM into the upper 1MiB for both reads and writes, which incidentally breaks "Myst" in the generator room due to
+  //	it trying to load a file that's too large to fit, wrapping around and corrupting essential data in the process.
+  // VA3+ behavior is untested.
+  //
+  // VA0/VA1 behavior is emulated here.
+  //
+  if(MDFN_UNLIKELY(A & 0x100000))
+  {
+   if(IsWrite)
+    SS_DBG(SS_DBG_WARNING, "[RAM] %zu-byte write of 0x%08x to revision-dependent address 0x%08x\n", sizeof(T), DB >> (((A & 1) ^ (2 - sizeof(T))) << 3), A);
+   else
+   {
+    SS_DBG(SS_DBG_WARNING, "[RAM] %zu-byte read from revision-dependent address 0x%08x\n", sizeof(T), A);
+    DB = DB | 0xFFFF;
+   }
+
+   return;
+  }
+
+  // Automation watchpoints: page bitmap test, then the list (Automation_WatchWrite/Read)
+  const bool wp_match_l = Instrumented && MDFN_UNLIKELY(Automation_WatchPage(!IsWrite, AUTOWP_LWR, A & 0xFFFFF));
+  uint32 wp_old_l = 0;
+  if(IsWrite && wp_match_l)
+   wp_old_l = ne16_rbo_be<uint32>(WorkRAML, A & 0xFFFFC);
+
+  if(IsWrite)
+   ne16_wbo_be<T>(WorkRAML, A & 0xFFFFF, DB >> (((A & 1) ^ (2 - sizeof(T))) << 3));
+  else
+   DB = (DB & 0xFFFF0000) | ne16_rbo_be<uint16>(WorkRAML, A & 0xFFFFE);
+
+  if(MDFN_UNLIKELY(wp_match_l))
+  {
+   if(IsWrite)
+    Automation_WatchWrite(AUTOWP_LWR, A, A & 0xFFFFF, sizeof(T), wp_old_l, ne16_rbo_be<uint32>(WorkRAML, A & 0xFFFFC), CPU[automation_current_cpu].PC, CPU[automation_current_cpu].PR, Automation_WatchSource(SH2DMAHax != NULL));
+   else
+    Automation_WatchRead(AUTOWP_LWR, A, A & 0xFFFFF, sizeof(T), ne16_rbo_be<uint32>(WorkRAML, A & 0xFFFFC));
+  }
+
+  return;
+ }
+
+ //
+ // BIOS ROM
+ //
+ if(A >= 0x00000000 && A <= 0x000FFFFF)
+ {
+  if(!SH2DMAHax)
+   SH7095_mem_timestamp += 8;
+  else
+   *SH2DMAHax += 8;
+
+  if(!IsWrite) 
+   DB = (DB & 0xFFFF0000) | ne16_rbo_be<uint16>(BIOSROM, A & 0x7FFFE);
+
+  return;
+ }
+
+ //
+ // SMPC
+ //
+ if(A >= 0x00100000 && A <= 0x0017FFFF)
+ {
+  const uint32 SMPC_A = (A & 0x7F) >> 1;
+
+  if(!SH2DMAHax)
+  {
+   // SH7095_mem_timestamp += 2;
+   CheckEventsByMemTS();
+  }
+
+  if(IsWrite)
+  {
+   if(sizeof(T) == 2 || (A & 1))
+    SMPC_Write(SH7095_mem_timestamp, SMPC_A, DB);
+  }
+  else
+   DB = (DB & 0xFFFF0000) | 0xFF00 | SMPC_Read(SH7095_mem_timestamp, SMPC_A);
+
+  return;
+ }
+
+ //
+ // Backup RAM
+ //
+ if(A >= 0x00180000 && A <= 0x001FFFFF)
+ {
+  if(!SH2DMAHax)
+   SH7095_mem_timestamp += 8;
+  else
+   *SH2DMAHax += 8;
+
+  if(IsWrite)
+  {
+   if(sizeof(T) != 1 || (A & 1))
+   {
+    uint8* const brp = &BackupRAM[(A >> 1) & 0x7FFF];
+
+    if(*brp != (uint8)DB)
+    {
+     *brp = (uint8)DB;
+     BackupRAM_Dirty = true;
+    }
+   }
+  }
+  else
+   DB = (DB & 0xFFFF0000) | 0xFF00 | BackupRAM[(A >> 1) & 0x7FFF];
+
+  return;
+ }
+
+ //
+ // FRT trigger region
+ //
+ if(A >= 0x01000000 && A <= 0x01FFFFFF)
+ {
+  if(!SH2DMAHax)
+   SH7095_mem_timestamp += 8;
+  else
+   *SH2DMAHax += 8;
+
+  if(IsWrite)
+  {
+   if(sizeof(T) != 1)
+   {
+    const unsigned c = ((A >> 23) & 1) ^ 1;
+
+    // FTI logging disabled: was observer effect source (500 stderr writes during boot)
+    CPU[c].SetFTI(true);
+    CPU[c].SetFTI(false);
+   }
+  }
+  return;
+ }
+
+ //
+ // FIXME: Run ST-V hardware test for correct region size and other characteristics.
+ //
+ //if(A >= 0x00400000 && A <= 0x0047FFFF && ActiveCartType == CART_STV)
+ if(A >= 0x00400000 && A <= 0x0040007F && ActiveCartType == CART_STV)
+ {
+  const uint32 IOGA_A = (A & 0x7F) >> 1;
+
+  if(IsWrite)
+  {
+   if(sizeof(T) == 2 || (A & 1))
+    STVIO_WriteIOGA(SH7095_mem_timestamp, IOGA_A, DB);
+  }
+  else
+   DB = ((DB & 0xFFFF0000) | 0xFF00 | STVIO_ReadIOGA(SH7095_mem_timestamp, IOGA_A));
+
+  return;
+ }
+ //
+ //
+ //
+ if(!SH2DMAHax)
+  SH7095_mem_timestamp += 4;
+ else
+  *SH2DMAHax += 4;
+
+ if(IsWrite)
+  SS_DBG(SS_DBG_WARNING, "[SH2 BUS] Unknown %zu-byte write of 0x%08x to 0x%08x\n", sizeof(T), DB >> (((A & 1) ^ (2 - sizeof(T))) << 3), A);
+ else
+  SS_DBG(SS_DBG_WARNING, "[SH2 BUS] Unknown %zu-byte read from 0x%08x\n", sizeof(T), A);
+}
+
+template<typename T, bool IsWrite>
+static INLINE void BusRW_DB_CS12(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+{
+ //
+ // RAM carts(cart/extram.cpp) map their RAM into the fast map as writeable; the SH-2s go straight to it rather than
+ // through two cart handler calls per 32-bit access.
+ //
+ if(A >= 0x02000000 && A <= 0x04FFFFFF && FMIsWriteable[A >> SH7095_EXT_MAP_GRAN_BITS])
+ {
+  SCU_FromSH2_ABusRAM_RW_DB<T, IsWrite>(A, &DB, SH2DMAHax, SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS]);
+  return;
+ }
+
+ //
+ // CS1 and CS2: SCU
+ //
+ if(!IsWrite)
+  DB = 0;
+
+ SCU_FromSH2_BusRW_DB<T, IsWrite>(A, &DB, SH2DMAHax);
+}
+
+template<typename T, bool IsWrite, bool Instrumented = true>
+static INLINE void BusRW_DB_CS3(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+{
+ //
+ // CS3: High work RAM/SDRAM, 0x06000000 ... 0x07FFFFFF
+ //
+ //  Timing is handled in BSC_BusWrite() and BSC_BusRead() in sh7095.inc
+ //
+
+ // Automation watchpoints: page bitmap test, then the list (Automation_WatchWrite/Read)
+ const bool wp_match = Instrumented && MDFN_UNLIKELY(Automation_WatchPage(!IsWrite, AUTOWP_HWR, A & 0xFFFFF));
+ uint32 wp_old = 0;
+ if(IsWrite && wp_match)
+  wp_old = ne16_rbo_be<uint32>(WorkRAMH, A & 0xFFFFC);
+
+ if(!IsWrite || sizeof(T) == 4)
+  ne16_rwbo_be<uint32, IsWrite>(WorkRAMH, A & 0xFFFFC, &DB);
+ else
+  ne16_wbo_be<T>(WorkRAMH, A & 0xFFFFF, DB >> (((A & 3) ^ (4 - sizeof(T))) << 3));
+
+ // After the access: report directly (no CPU hook needed)
+ if(MDFN_UNLIKELY(wp_match))
+ {
+  if(IsWrite)
+   Automation_WatchWrite(AUTOWP_HWR, A, A & 0xFFFFF, sizeof(T), wp_old, ne16_rbo_be<uint32>(WorkRAMH, A & 0xFFFFC), CPU[automation_current_cpu].PC, CPU[automation_current_cpu].PR, Automation_WatchSource(SH2DMAHax != NULL));
+  else
+   Automation_WatchRead(AUTOWP_HWR, A, A & 0xFFFFF, sizeof(T), ne16_rbo_be<uint32>(WorkRAMH, A & 0xFFFFC));
+ }
+}
+
+//
+//
+//
+static MDFN_COLD uint8 CheatMemRead(uint32 A)
+{
+ A &= (1U << 27) - 1;
+
+ return ne16_rbo_be<uint8>(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS], A);
+}
+
+static MDFN_COLD void CheatMemWrite(uint32 A, uint8 V)
+{
+ A &= (1U << 27) - 1;
+
+ if(FMIsWriteable[A >> SH7095_EXT_MAP_GRAN_BITS])
+ {
+  ne16_wbo_be<uint8>(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS], A, V);
+
+  for(unsigned c = 0; c < 2; c++)
+  {
+   if(CPU[c].CCR & SH7095::CCR_CE)
+   {
+    for(uint32 Abase = 0x00000000; Abase < 0x20000000; Abase += 0x08000000)
+    {
+     CPU[c].Cache_WriteUpdate<uint8>(Abase + A, V);
+    }
+   }
+  }
+ }
+}
+//
+//
+//
+static void SetFastMemMap(uint32 Astart, uint32 Aend, uint16* ptr, uint32 length, bool is_writeable)
+{
+ const uint64 Abound = (uint64)Aend + 1;
+ assert((Astart & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
+ assert((Abound & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
+ assert((length & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
+ assert(length > 0);
+ assert(length <= (Abound - Astart));
+
+ for(uint64 A = Astart; A < Abound; A += (1U << SH7095_EXT_MAP_GRAN_BITS))
+ {
+  uintptr_t tmp = (uintptr_t)ptr + ((A - Astart) % length);
+
+  if(A < (1U << 27))
+   FMIsWriteable[A >> SH7095_EXT_MAP_GRAN_BITS] = is_writeable;
+
+  SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] = tmp - A;
+ }
+}
+
+static MDFN_COLD void InitFastMemMap(void)
+{
+ for(unsigned i = 0; i < sizeof(fmap_dummy) / sizeof(fmap_dummy[0]); i++)
+ {
+  fmap_dummy[i] = 0;
+ }
+
+ FMIsWriteable.reset();
+ MDFNMP_Init(1ULL << SH7095_EXT_MAP_GRAN_BITS, (1ULL << 27) / (1ULL << SH7095_EXT_MAP_GRAN_BITS));
+
+ for(uint64 A = 0; A < 1ULL << 32; A += (1U << SH7095_EXT_MAP_GRAN_BITS))
+ {
+  SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] = (uintptr_t)fmap_dummy - A;
+ }
+}
+
+void SS_SetPhysMemMap(uint32 Astart, uint32 Aend, uint16* ptr, uint32 length, bool is_writeable)
+{
+ assert(Astart < 0x20000000);
+ assert(Aend < 0x20000000);
+
+ if(!ptr)
+ {
+  ptr = fmap_dummy;
+  length = sizeof(fmap_dummy);
+ }
+
+ for(uint32 Abase = 0; Abase < 0x40000000; Abase += 0x20000000)
+  SetFastMemMap(Astart + Abase, Aend + Abase, ptr, length, is_writeable);
+}
+
+// Automation: index of the byte at "addr" within an SH-2 cache line, whose
+// data is kept as native-endian 32-bit words (NE32ASU8_IDX_ADJ in sh7095.inc,
+// which isn't included yet here).
+static INLINE unsigned Automation_CacheByte(uint32 addr)
+{
+#ifdef MSB_FIRST
+ return addr & 0x0F;
+#else
+ return (addr & 0x0F) ^ 3;
+#endif
+}
+
+// Automation: read a byte from Saturn address space as the master CPU sees it.
+// Checks the SH-2 cache first (matching the CPU's actual view), then falls back
+// to the backing store (WorkRAMH/WorkRAML/BIOSROM).
+uint8 Automation_ReadMem8(uint32 addr)
+{
+ addr &= 0x0FFFFFFF; // Strip mirror bits
+
+ // Check master SH-2 cache for cacheable regions (0x00000000-0x07FFFFFF).
+ // The SH-2 cache uses bits [28:26] as region, region 0 is cacheable.
+ if ((addr >> 27) == 0 && (CPU[0].CCR & SH7095::CCR_CE))
+ {
+  uint32 ATM = addr & (0x7FFFF << 10);
+  auto* cent = &CPU[0].Cache[(addr >> 4) & 0x3F];
+
+  for (int way = 0; way < 4; way++) {
+   if (cent->Tag[way] == ATM) {
+    // Cache hit — return the byte from cache data (native-endian 32-bit words)
+    return cent->Data[way][Automation_CacheByte(addr)];
+   }
+  }
+  // Cache miss — fall through to backing store
+ }
+
+ if (addr >= 0x06000000 && addr <= 0x060FFFFF) {
+  // WorkRAMH — stored as big-endian uint16 array
+  uint32 off = addr & 0xFFFFF;
+  uint16 w = WorkRAMH[off >> 1];
+  return (off & 1) ? (w & 0xFF) : (w >> 8);
+ }
+ else if (addr >= 0x00200000 && addr <= 0x002FFFFF) {
+  // WorkRAML
+  uint32 off = addr & 0xFFFFF;
+  uint16 w = WorkRAML[off >> 1];
+  return (off & 1) ? (w & 0xFF) : (w >> 8);
+ }
+ else if (addr < 0x00080000) {
+  // BIOSROM
+  uint16 w = BIOSROM[addr >> 1];
+  return (addr & 1) ? (w & 0xFF) : (w >> 8);
+ }
+
+ else if (addr >= 0x05C00000 && addr <= 0x05C7FFFF) {
+  // VDP1 VRAM (512KB)
+  return VDP1::PeekVRAM(addr - 0x05C00000);
+ }
+ else if (addr >= 0x05C80000 && addr <= 0x05CFFFFF) {
+  // VDP1 framebuffer (256KB, reads display buffer 0)
+  return VDP1::PeekFB(0, addr - 0x05C80000);
+ }
+ else if (addr >= 0x05A00000 && addr <= 0x05A7FFFF) {
+  // SCSP sound RAM (512KB)
+  return SOUND_PeekRAM(addr);
+ }
+ else if (addr >= 0x05E00000 && addr <= 0x05E7FFFF) {
+  // VDP2 VRAM (512KB)
+  return VDP2::PeekVRAM(addr - 0x05E00000);
+ }
+ else if (addr >= 0x05F00000 && addr <= 0x05F00FFF) {
+  // VDP2 CRAM (4KB)
+  return VDP2::PeekCRAM(addr - 0x05F00000);
+ }
+
+ return 0xFF; // Unmapped region
+}
+
+void Automation_WriteMem8(uint32 addr, uint8 val)
+{
+ addr &= 0x0FFFFFFF; // Strip mirror bits
+
+ if (addr >= 0x06000000 && addr <= 0x060FFFFF) {
+  // WorkRAMH — stored as big-endian uint16 array
+  uint32 off = addr & 0xFFFFF;
+  uint16& w = WorkRAMH[off >> 1];
+  if (off & 1)
+   w = (w & 0xFF00) | val;
+  else
+   w = (w & 0x00FF) | (val << 8);
+
+  // Invalidate cache line so CPU sees the write
+  uint32 ATM = addr & (0x7FFFF << 10);
+  auto* cent = &CPU[0].Cache[(addr >> 4) & 0x3F];
+  for (int way = 0; way < 4; way++) {
+   if (cent->Tag[way] == ATM) {
+    cent->Data[way][Automation_CacheByte(addr)] = val;
+   }
+  }
+ }
+ else if (addr >= 0x00200000 && addr <= 0x002FFFFF) {
+  // WorkRAML
+  uint32 off = addr & 0xFFFFF;
+  uint16& w = WorkRAML[off >> 1];
+  if (off & 1)
+   w = (w & 0xFF00) | val;
+  else
+   w = (w & 0x00FF) | (val << 8);
+ }
+ // Other regions not supported for writes
+}
+
+// Automation: drop the 16-byte line holding A from both SH-2 caches.
+static void Automation_PurgeCacheLine(uint32 A)
+{
+ const uint32 ATM = A & (0x7FFFF << 10);
+
+ for (unsigned c = 0; c < 2; c++) {
+  auto* cent = &CPU[c].Cache[(A >> 4) & 0x3F];
+
+  for (unsigned way = 0; way < 4; way++)
+   cent->Tag[way] |= (ATM == cent->Tag[way]);	// Set invalid bit to 1.
+ }
+}
+
+// Automation: bulk write into WorkRAMH/WorkRAML, the regions Automation_WriteMem8
+// writes. Each run within a region is byte-swapped into the big-endian uint16
+// backing store in one go, then every 16-byte line it touches is purged from
+// both SH-2 caches (as Cache_AssocPurge does, without counting toward the
+// cache statistics); the caches are write-through, so nothing is lost.
+// Bytes outside those regions are skipped. Returns the number written.
+uint32 Automation_WriteMemBlock(uint32 addr, const uint8* buf, uint32 size)
+{
+ struct MemRegion { uint32 lo, size; uint16* words; };
+ const MemRegion regions[] = {
+  { 0x06000000, 0x100000, WorkRAMH },
+  { 0x00200000, 0x100000, WorkRAML },
+ };
+ uint32 written = 0;
+
+ addr &= 0x0FFFFFFF;
+
+ uint32 i = 0;
+ while (i < size) {
+  const uint32 a = (addr + i) & 0x0FFFFFFF;
+  const MemRegion* r = nullptr;
+  for (const MemRegion& cand : regions) {
+   if (a - cand.lo < cand.size) { r = &cand; break; }
+  }
+
+  if (!r) {
+   i++;
+   continue;
+  }
+
+  uint32 off = a - r->lo;
+  uint32 n = std::min<uint32>(size - i, r->size - off);
+  const uint8* s = buf + i;
+
+  for (uint32 line = a & ~0xF; line < a + n; line += 0x10)
+   Automation_PurgeCacheLine(line);
+
+  i += n;
+  written += n;
+
+  if (off & 1) {
+   ne16_wbo_be<uint8>(r->words, off++, *s++);
+   n--;
+  }
+
+  uint8* d = (uint8*)r->words + off;
+  memcpy(d, s, n & ~1U);
+  Endian_A16_NE_BE(d, n >> 1);
+
+  if (n & 1)
+   ne16_wbo_be<uint8>(r->words, off + n - 1, s[n - 1]);
+ }
+
+ return written;
+}
+
+// Automation: freeze list. Each entry holds size bytes at addr (Work RAM
+// only) and is compiled into the big-endian uint16 backing words it covers;
+// Emulate() rewrites them at the start of every frame in one pass over
+// freeze_words. A word whose value actually changed has its 16-byte line
+// purged from both SH-2 caches unless every entry on it was set without purge.
+struct FreezeEntry
+{
+ uint32 addr;
+ uint32 value;
+ uint8 size;
+ bool purge;
+};
+
+struct FreezeWord
+{
+ uint16* w;
+ uint16 keep;	// bits not frozen
+ uint16 val;
+ uint32 line;	// bus address to purge, ~0U for none
+};
+
+static std::vector<FreezeEntry> freeze_entries;
+static std::vector<FreezeWord> freeze_words;
+static uint64 freeze_rewrites = 0;
+
+static uint16* Freeze_Word(uint32 A)
+{
+ A &= 0x0FFFFFFF;
+
+ if (A >= 0x06000000 && A <= 0x060FFFFF)
+  return &WorkRAMH[(A & 0xFFFFF) >> 1];
+ else if (A >= 0x00200000 && A <= 0x002FFFFF)
+  return &WorkRAML[(A & 0xFFFFF) >> 1];
+
+ return nullptr;
+}
+
+static NO_INLINE void Freeze_Apply(void)
+{
+ for (const FreezeWord& f : freeze_words) {
+  const uint16 nv = (*f.w & f.keep) | f.val;
+
+  if (*f.w != nv) {
+   *f.w = nv;
+   freeze_rewrites++;
+   if (f.line != ~0U)
+    Automation_PurgeCacheLine(f.line);
+  }
+ }
+}
+
+// Later entries win where they overlap; words come out in address order.
+static void Freeze_Compile(void)
+{
+ std::map<uint16*, FreezeWord> words;
+
+ for (const FreezeEntry& e : freeze_entries) {
+  for (unsigned i = 0; i < e.size; i++) {
+   const uint32 a = (e.addr + i) & 0x0FFFFFFF;
+   uint16* const w = Freeze_Word(a);
+   const unsigned shift = (a & 1) ? 0 : 8;
+   auto ins = words.insert({ w, { w, 0xFFFF, 0, ~0U } });
+   FreezeWord& f = ins.first->second;
+
+   f.keep &= ~(0xFF << shift);
+   f.val = (f.val & ~(0xFF << shift)) | (((e.value >> ((e.size - 1 - i) * 8)) & 0xFF) << shift);
+   if (e.purge)
+    f.line = a & ~0xF;
+  }
+ }
+
+ freeze_words.clear();
+ for (const auto& kv : words)
+  freeze_words.push_back(kv.second);
+}
+
+// size is 1, 2 or 4 bytes, value big-endian as the CPUs see it. Replaces an
+// entry at the same address and applies the list at once, so the value holds
+// from the next instruction. False if any byte is outside Work RAM.
+bool Automation_FreezeSet(uint32 addr, unsigned size, uint32 value, bool purge)
+{
+ for (unsigned i = 0; i < size; i++) {
+  if (!Freeze_Word(addr + i))
+   return false;
+ }
+
+ Automation_FreezeRemove(addr);
+ freeze_entries.push_back({ addr & 0x0FFFFFFF, value, (uint8)size, purge });
+ Freeze_Compile();
+ Freeze_Apply();
+ return true;
+}
+
+// Returns the number of entries removed (those starting at addr).
+unsigned Automation_FreezeRemove(uint32 addr)
+{
+ const size_t n = freeze_entries.size();
+
+ addr &= 0x0FFFFFFF;
+ freeze_entries.erase(std::remove_if(freeze_entries.begin(), freeze_entries.end(), [addr](const FreezeEntry& e) { return e.addr == addr; }), freeze_entries.end());
+ Freeze_Compile();
+ return n - freeze_entries.size();
+}
+
+void Automation_FreezeClear(void)
+{
+ freeze_entries.clear();
+ freeze_words.clear();
+ freeze_rewrites = 0;
+}
+
+// One "0xADDR value=0x.. size=N [nopurge]" line per entry, in the order set.
+std::string Automation_FreezeList(void)
+{
+ std::string ret;
+ char buf[64];
+
+ for (const FreezeEntry& e : freeze_entries) {
+  snprintf(buf, sizeof(buf), "0x%08X value=0x%0*X size=%u%s\n", e.addr, e.size * 2, e.value, e.size, e.purge ? "" : " nopurge");
+  ret += buf;
+ }
+ return ret;
+}
+
+// Entries, backing words they compile to, and words rewritten since the list was cleared.
+void Automation_FreezeStats(uint32* entries, uint32* words, uint64* rewrites)
+{
+ *entries = freeze_entries.size();
+ *words = freeze_words.size();
+ *rewrites = freeze_rewrites;
+}
+
+void Automation_SuspendThreads(void)
+{
+ VDP1::SuspendWorkers();
+ VDP2REND_SuspendThreads();
+}
+
+void Automation_ResumeThreads(void)
+{
+ VDP2REND_ResumeThreads();
+ VDP1::ResumeWorkers();
+}
+
+// Automation: bulk memory read — copies backing store directly for speed.
+// Bypasses SH-2 cache (reads physical memory, not CPU's cached view).
+// For regions stored as big-endian uint16 arrays, converts to byte order.
+// Each contiguous run within a region is one memcpy plus an in-place 16-bit
+// swap (Endian_A16_NE_BE); only an odd first or last byte is done singly.
+void Automation_ReadMemBlock(uint32 addr, uint8* buf, uint32 size)
+{
+ // Region table: resolve the region once per contiguous run instead of
+ // once per byte, so MB-sized dumps are a tight copy loop.
+ struct MemRegion { uint32 lo, size; const uint16* words; };
+ const MemRegion regions[] = {
+  { 0x06000000, 0x100000, WorkRAMH },
+  { 0x00200000, 0x100000, WorkRAML },
+  { 0x05C00000, 0x080000, VDP1::GetVRAMPtr() },
+  { 0x05E00000, 0x080000, VDP2::GetVRAMPtr() },
+  { 0x05F00000, 0x001000, VDP2::GetCRAMPtr() },
+  { 0x05A00000, 0x080000, SOUND_GetRAMPtr() },
+  { 0x00000000, 0x080000, BIOSROM },
+ };
+
+ addr &= 0x0FFFFFFF;
+
+ uint32 i = 0;
+ while (i < size) {
+  const uint32 a = (addr + i) & 0x0FFFFFFF;
+  const MemRegion* r = nullptr;
+  for (const MemRegion& cand : regions) {
+   if (a - cand.lo < cand.size) { r = &cand; break; }
+  }
+
+  if (!r) {
+   buf[i++] = 0xFF;
+   continue;
+  }
+
+  uint32 off = a - r->lo;
+  uint32 n = std::min<uint32>(size - i, r->size - off);
+  uint8* d = buf + i;
+
+  i += n;
+
+  if (off & 1) {
+   *d++ = ne16_rbo_be<uint8>(r->words, off++);
+   n--;
+  }
+
+  memcpy(d, (const uint8*)r->words + off, n & ~1U);
+  Endian_A16_NE_BE(d, n >> 1);
+
+  if (n & 1)
+   d[n - 1] = ne16_rbo_be<uint8>(r->words, off + n - 1);
+ }
+}
+
+// Automation: which 32-byte blocks of a video memory were written since the
+// last call (bus writes, debugger pokes; everything after power-up or a state
+// load).
+// region: 0 VDP1 VRAM, 1 VDP2 VRAM, 2 VDP2 CRAM. Returns the word count.
+uint32 Automation_TakeVideoDirty(unsigned region, uint64* bits)
+{
+ switch(region)
+ {
+  case 0: VDP1::TakeVRAMDirty(bits); return VDP1::VRAMDirty_Words;
+  case 1: VDP2::TakeVRAMDirty(bits); return VDP2::VRAMDirty_Words;
+  case 2: VDP2::TakeCRAMDirty(bits); return VDP2::CRAMDirty_Words;
+ }
+ return 0;
+}
+
+// Automation: bulk read as the master CPU sees it, like Automation_ReadMem8 but
+// in one pass: the backing store is block-copied, then every valid line in the
+// master SH-2 cache that falls in the range is laid over it.
+void Automation_ReadMemBlockCoherent(uint32 addr, uint8* buf, uint32 size)
+{
+ Automation_ReadMemBlock(addr, buf, size);
+
+ if (!(CPU[0].CCR & SH7095::CCR_CE))
+  return;
+
+ addr &= 0x0FFFFFFF;
+
+ for (unsigned entry = 0; entry < 64; entry++) {
+  const auto& cent = CPU[0].Cache[entry];
+
+  for (unsigned way = 0; way < 4; way++) {
+   if (cent.Tag[way] & ~(0x7FFFF << 10))  // Invalid
+    continue;
+
+   const uint32 line = cent.Tag[way] | (entry << 4);
+
+   for (unsigned b = 0; b < 16; b++) {
+    const uint32 rel = line + b - addr;
+    if (rel < size)
+     buf[rel] = cent.Data[way][Automation_CacheByte(b)];
+   }
+  }
+ }
+}
+
+// Automation: get current master CPU PC (the real register, not the debug pipeline PC).
+uint32 Automation_GetMasterPC(void)
+{
+ return CPU[0].PC;
+}
+
+// Automation: get/set master CPU SR (for interrupt mask level checks).
+uint32 Automation_GetMasterSR(void)
+{
+ return CPU[0].GetRegister(SH7095::GSREG_SR, nullptr, 0);
+}
+
+void Automation_SetMasterSR(uint32 val)
+{
+ CPU[0].SetRegister(SH7095::GSREG_SR, val);
+}
+
+// Automation: get absolute master cycle count (survives frame-boundary adjustments).
+int64_t Automation_GetMasterCycle(void)
+{
+ return automation_total_cycles + CPU[0].timestamp;
+}
+
+// Automation: master cycles before timestamp 0 of this frame; add any SH-2-clock timestamp
+// (e.g. the CD Block's lastts) to get an absolute cycle.
+int64_t Automation_GetCycleBase(void)
+{
+ return automation_total_cycles;
+}
+
+// Automation: set the absolute master cycle count, after loading a state
+// taken at that count (the counter isn't part of save states).
+void Automation_SetMasterCycle(int64_t cycle)
+{
+ automation_total_cycles = cycle - CPU[0].timestamp;
+}
+
+// Automation: dump master SH-2 CPU registers as a formatted string.
+std::string Automation_DumpRegs(void)
+{
+ std::string s = "regs";
+ char buf[64];
+
+ for (int i = 0; i < 16; i++) {
+  snprintf(buf, sizeof(buf), " R%d=%08X", i, CPU[0].R[i]);
+  s += buf;
+ }
+
+ snprintf(buf, sizeof(buf), " PC=%08X", CPU[0].PC); s += buf;
+ snprintf(buf, sizeof(buf), " SR=%08X", CPU[0].SR); s += buf;
+ snprintf(buf, sizeof(buf), " PR=%08X", CPU[0].PR); s += buf;
+ snprintf(buf, sizeof(buf), " GBR=%08X", CPU[0].GBR); s += buf;
+ snprintf(buf, sizeof(buf), " VBR=%08X", CPU[0].VBR); s += buf;
+ snprintf(buf, sizeof(buf), " MACH=%08X", CPU[0].MACH); s += buf;
+ snprintf(buf, sizeof(buf), " MACL=%08X", CPU[0].MACL); s += buf;
+
+ return s;
+}
+
+// Automation: 22-word register block (R0-R15,PC,SR,PR,GBR,VBR,MACH) shared
+// by the *_regs_bin file dumps and the socket read_regs reply.
+void Automation_GetRegs(unsigned cpu, uint32* regs)
+{
+ for (int i = 0; i < 16; i++)
+  regs[i] = CPU[cpu].R[i];
+ regs[16] = CPU[cpu].PC;
+ regs[17] = CPU[cpu].SR;
+ regs[18] = CPU[cpu].PR;
+ regs[19] = CPU[cpu].GBR;
+ regs[20] = CPU[cpu].VBR;
+ regs[21] = CPU[cpu].MACH;
+}
+
+void Automation_GetGDBRegs(unsigned cpu, uint32* regs)
+{
+ for(unsigned i = 0; i < 16; i++)
+  regs[i] = CPU[cpu].R[i];
+ regs[16] = CPU[cpu].PC;
+ regs[17] = CPU[cpu].PR;
+ regs[18] = CPU[cpu].GBR;
+ regs[19] = CPU[cpu].VBR;
+ regs[20] = CPU[cpu].MACH;
+ regs[21] = CPU[cpu].MACL;
+ regs[22] = CPU[cpu].SR;
+}
+
+bool Automation_SetGDBReg(unsigned cpu, unsigned index, uint32 value)
+{
+ static const unsigned ids[GDBReg_Count - GDBReg_PC - 1] =
+ {
+  SH7095::GSREG_PR, SH7095::GSREG_GBR, SH7095::GSREG_VBR, SH7095::GSREG_MACH, SH7095::GSREG_MACL, SH7095::GSREG_SR
+ };
+
+ if(index < 16)
+  CPU[cpu].SetRegister(SH7095::GSREG_R0 + index, value);
+ else if(index > GDBReg_PC && index < GDBReg_Count)
+  CPU[cpu].SetRegister(ids[index - GDBReg_PC - 1], value);
+ else
+  return false;
+
+ return true;
+}
+
+void Automation_DumpRegsBin(const char* path)
+{
+ uint32 regs[22];
+ Automation_GetRegs(0, regs);
+
+ FILE* f = fopen(path, "wb");
+ if (f) {
+  fwrite(regs, 4, 22, f);
+  fclose(f);
+ }
+}
+
+// Automation: symbol table for load_symbols. Lines are "<start> [<end>] <name>",
+// hex with optional 0x, fields separated by spaces, tabs or commas, '#' starts a
+// comment. end is exclusive; without it a symbol runs to the next one's start
+// (the last one to start + 0x1000). Addresses are compared with the cache area
+// bits (31-29) masked off, so 0x06004000 and 0x26004000 are the same function.
+// Overlaps resolve to the symbol with the highest start at or below the address.
+struct AutomationSymbol
+{
+ uint32 start;
+ uint32 end;
+ std::string name;
+};
+static std::vector<AutomationSymbol> automation_symbols;
+
+static INLINE uint32 Symbol_Norm(uint32 addr) { return addr & 0x1FFFFFFF; }
+
+int Automation_LoadSymbols(const char* path, bool append, std::string* error)
+{
+ FILE* fp = fopen(path, "r");
+ std::vector<AutomationSymbol> syms;
+ std::vector<bool> open_end;
+ char line[1024];
+ unsigned line_no = 0;
+
+ if(!fp)
+ {
+  *error = "cannot open " + std::string(path);
+  return -1;
+ }
+
+ while(fgets(line, sizeof(line), fp))
+ {
+  std::vector<std::string> tok;
+  char* s = line;
+
+  line_no++;
+  if(char* hash = strchr(s, '#'))
+   *hash = 0;
+  for(char* t = strtok(s, " \t\r\n,"); t; t = strtok(nullptr, " \t\r\n,"))
+   tok.push_back(t);
+
+  if(tok.empty())
+   continue;
+
+  auto parse_hex = [](const std::string& t, uint32* v) -> bool
+  {
+   const char* p = t.c_str();
+   char* e;
+
+   if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    p += 2;
+   if(!*p || strlen(p) > 8)
+    return false;
+   *v = strtoul(p, &e, 16);
+   return !*e;
+  };
+  AutomationSymbol sym;
+
+  if(tok.size() < 2 || tok.size() > 3 || !parse_hex(tok[0], &sym.start) || (tok.size() == 3 && (!parse_hex(tok[1], &sym.end) || Symbol_Norm(sym.end) <= Symbol_Norm(sym.start))))
+  {
+   fclose(fp);
+   *error = std::string(path) + ":" + std::to_string(line_no) + ": expected <start> [<end>] <name>";
+   return -1;
+  }
+  sym.start = Symbol_Norm(sym.start);
+  sym.end = (tok.size() == 3) ? Symbol_Norm(sym.end) : 0;
+  sym.name = tok.back();
+  open_end.push_back(tok.size() == 2);
+  syms.push_back(sym);
+ }
+ fclose(fp);
+
+ const size_t loaded = syms.size();
+
+ // Symbols run to the next start in this file when they have no end.
+ {
+  std::vector<uint32> starts;
+
+  for(const AutomationSymbol& sym : syms)
+   starts.push_back(sym.start);
+  std::sort(starts.begin(), starts.end());
+  for(size_t i = 0; i < syms.size(); i++)
+  {
+   if(!open_end[i])
+    continue;
+
+   auto next = std::upper_bound(starts.begin(), starts.end(), syms[i].start);
+   syms[i].end = (next != starts.end()) ? *next : syms[i].start + 0x1000;
+  }
+ }
+
+ if(append)
+  syms.insert(syms.begin(), automation_symbols.begin(), automation_symbols.end());
+ std::stable_sort(syms.begin(), syms.end(), [](const AutomationSymbol& a, const AutomationSymbol& b) { return a.start < b.start; });
+ automation_symbols.swap(syms);
+ return (int)loaded;
+}
+
+void Automation_ClearSymbols(void)
+{
+ automation_symbols.clear();
+ automation_symbols.shrink_to_fit();
+}
+
+uint32 Automation_SymbolCount(void) { return automation_symbols.size(); }
+
+int32 Automation_SymbolFind(uint32 addr)
+{
+ const uint32 a = Symbol_Norm(addr);
+ auto it = std::upper_bound(automation_symbols.begin(), automation_symbols.end(), a, [](uint32 v, const AutomationSymbol& sym) { return v < sym.start; });
+
+ if(it == automation_symbols.begin())
+  return -1;
+ --it;
+
+ return (a < it->end) ? (int32)(it - automation_symbols.begin()) : -1;
+}
+
+const char* Automation_SymbolName(int32 id)
+{
+ return (id >= 0 && (uint32)id < automation_symbols.size()) ? automation_symbols[id].name.c_str() : "";
+}
+
+uint32 Automation_SymbolStart(int32 id)
+{
+ return (id >= 0 && (uint32)id < automation_symbols.size()) ? automation_symbols[id].start : 0;
+}
+
+std::string Automation_SymbolFormat(uint32 addr)
+{
+ const int32 id = Automation_SymbolFind(addr);
+ std::string s;
+
+ if(id >= 0)
+ {
+  const uint32 off = Symbol_Norm(addr) - automation_symbols[id].start;
+
+  s = automation_symbols[id].name;
+  if(off)
+  {
+   char buf[16];
+
+   snprintf(buf, sizeof(buf), "+0x%X", off);
+   s += buf;
+  }
+ }
+
+ return s;
+}
+
+// Automation: shadow call stack — reads the per-CPU stack maintained by
+// jsr/bsr/bsrf/rts instrumentation. Self-healing via PR matching on rts.
+// With symbols loaded, each frame also names its target (fn=...).
+std::string Automation_CallStack(uint32 /*scan_size*/)
+{
+ // Use automation_current_cpu if valid (0 or 1), default to master
+ return Automation_CallStackCPU((automation_current_cpu < 2) ? automation_current_cpu : 0);
+}
+
+std::string Automation_CallStackCPU(unsigned cpu)
+{
+ cpu &= 1;
+ uint32 pc = CPU[cpu].PC;
+ uint32 pr = CPU[cpu].PR;
+ uint32 sp = CPU[cpu].R[15];
+
+ std::string s = "call_stack";
+ char buf[128];
+
+ snprintf(buf, sizeof(buf), " cpu=%s PC=0x%08X SP=0x%08X PR=0x%08X",
+  cpu ? "slave" : "master", pc, sp, pr);
+ s += buf;
+
+ // Shadow call stack (tracked via jsr/bsr/bsrf/rts instrumentation)
+ unsigned depth = shadow_stack_depth[cpu];
+ if(depth > 0)
+ {
+  for(int i = (int)depth - 1; i >= 0; i--)
+  {
+   const ShadowCallEntry& e = shadow_stack[cpu][i];
+   snprintf(buf, sizeof(buf), " | 0x%08X->0x%08X ret=0x%08X",
+    e.call_site, e.target, e.return_addr);
+   s += buf;
+   if(!automation_symbols.empty())
+   {
+    const std::string fn = Automation_SymbolFormat(e.target);
+
+    if(!fn.empty())
+     s += " fn=" + fn;
+   }
+  }
+ }
+
+ snprintf(buf, sizeof(buf), " | depth=%u", depth);
+ s += buf;
+
+ return s;
+}
+
+unsigned Automation_ShadowDepth(unsigned cpu, uint32* top_return)
+{
+ const unsigned depth = shadow_stack_depth[cpu & 1];
+
+ if(depth)
+  *top_return = shadow_stack[cpu & 1][depth - 1].return_addr;
+
+ return depth;
+}
+
+// Automation: dump slave SH-2 CPU registers as a formatted string.
+std::string Automation_DumpSlaveRegs(void)
+{
+ std::string s = "regs_slave";
+ char buf[64];
+
+ for (int i = 0; i < 16; i++) {
+  snprintf(buf, sizeof(buf), " R%d=%08X", i, CPU[1].R[i]);
+  s += buf;
+ }
+
+ snprintf(buf, sizeof(buf), " PC=%08X", CPU[1].PC); s += buf;
+ snprintf(buf, sizeof(buf), " SR=%08X", CPU[1].SR); s += buf;
+ snprintf(buf, sizeof(buf), " PR=%08X", CPU[1].PR); s += buf;
+ snprintf(buf, sizeof(buf), " GBR=%08X", CPU[1].GBR); s += buf;
+ snprintf(buf, sizeof(buf), " VBR=%08X", CPU[1].VBR); s += buf;
+ snprintf(buf, sizeof(buf), " MACH=%08X", CPU[1].MACH); s += buf;
+ snprintf(buf, sizeof(buf), " MACL=%08X", CPU[1].MACL); s += buf;
+
+ return s;
+}
+
+// Automation: dump slave SH-2 CPU registers to a binary file.
+void Automation_DumpSlaveRegsBin(const char* path)
+{
+ uint32 regs[22];
+ Automation_GetRegs(1, regs);
+
+ FILE* f = fopen(path, "wb");
+ if (f) {
+  fwrite(regs, 4, 22, f);
+  fclose(f);
+ }
+}
+
+// Automation: dump VDP2 internal register state to binary file.
+void Automation_DumpVDP2RegsBin(const char* path)
+{
+ VDP2::DumpRawRegsBin(path);
+}
+
+// Automation: passive inline hook callback.
+// Called from RunLoop_INLINE BEFORE CPU[0].Step() on every master CPU instruction.
+// At this point, CPU[0].PC is the address of the instruction about to execute.
+// Does NOT go through DebugMode/DBG_CPUHandler/ForceEventUpdates -- zero
+// timing side effects. Observation is completely invisible to the emulated Saturn.
+static void Automation_InlineHookCallback(void)
+{
+ uint32 pc = Automation_GetMasterPC();
+ ::Automation_DebugHook(pc);
+}
+
+// Slave counterpart, called before CPU[1].Step() (RunLoop_INLINE) or at the
+// top of each RunSlaveUntil() iteration. Bus-access attribution is switched to
+// the slave for the duration so call stacks and register dumps taken while
+// paused here describe CPU[1].
+static void Automation_SlaveInlineHookCallback(void)
+{
+ if(automation_slave_stop_latched)
+  return;
+
+ if(automation_slave_hook_skip)
+ {
+  automation_slave_hook_skip = false;
+
+  if(CPU[1].PC == automation_slave_hook_skip_pc)
+   return;
+ }
+
+ const unsigned saved_cpu = automation_current_cpu;
+
+ automation_current_cpu = 1;
+ automation_slave_stop_latched = ::Automation_SlaveDebugHook(CPU[1].PC, automation_master_in_step);
+ automation_current_cpu = saved_cpu;
+}
+
+static NO_INLINE void Automation_SlaveLatchedStop(void)
+{
+ const unsigned saved_cpu = automation_current_cpu;
+
+ automation_slave_stop_latched = false;
+ automation_slave_hook_skip = true;
+ automation_slave_hook_skip_pc = CPU[1].PC;
+ automation_current_cpu = 1;
+ ::Automation_SlaveLatchedStop(CPU[1].PC);
+ automation_current_cpu = saved_cpu;
+}
+
+void Automation_EnableCPUHook(unsigned cpu)
+{
+ if(cpu)
+  s_automation_slave_hook = Automation_SlaveInlineHookCallback;
+ else
+  s_automation_inline_hook = Automation_InlineHookCallback;
+}
+
+void Automation_DisableCPUHook(unsigned cpu)
+{
+ if(cpu)
+ {
+  s_automation_slave_hook = nullptr;
+  automation_slave_stop_latched = false;
+ }
+ else
+  s_automation_inline_hook = nullptr;
+}
+
+void Automation_SetCPUHookFilter(unsigned cpu, bool filtered)
+{
+ s_automation_hook_filtered[cpu & 1] = filtered;
+}
+
+void Automation_ClearCPUHookPages(unsigned cpu)
+{
+ memset(s_automation_hook_pages[cpu & 1], 0, sizeof(s_automation_hook_pages[0]));
+}
+
+// Marks the page(s) covering [pc, pc + 2]; the hook also matches pc - 2
+// (see Automation_DebugHook), which may fall in the next page.
+void Automation_AddCPUHookPage(unsigned cpu, uint32 pc)
+{
+ for(uint32 a : { pc, pc + 2 })
+ {
+  const uint32 page = a >> AUTOHOOK_PAGE_BITS;
+  s_automation_hook_pages[cpu & 1][page >> 5] |= 1U << (page & 31);
+ }
+}
+
+static void Automation_RebuildWatchPages(void)
+{
+ memset(automation_wp_pages, 0, sizeof(automation_wp_pages));
+
+ for(const AutomationWatch& w : automation_watches)
+ {
+  for(uint32 p = w.start >> AUTOWP_PAGE_BITS; p <= ((w.end - 1) >> AUTOWP_PAGE_BITS); p++)
+  {
+   const uint32 page = (w.region << (AUTOWP_REGION_BITS - AUTOWP_PAGE_BITS)) | p;
+   automation_wp_pages[w.is_read][page >> 5] |= 1U << (page & 31);
+  }
+ }
+
+ for(const WriteLogRange& r : writelog_ranges)
+ {
+  for(uint32 p = r.start >> AUTOWP_PAGE_BITS; p <= ((r.end - 1) >> AUTOWP_PAGE_BITS); p++)
+  {
+   const uint32 page = (r.region << (AUTOWP_REGION_BITS - AUTOWP_PAGE_BITS)) | p;
+   automation_wp_pages[false][page >> 5] |= 1U << (page & 31);
+  }
+ }
+
+ // Transfers already in flight re-decide whether they need checking.
+ for(DMALevelS& d : DMALevel)
+  DMA_UpdateWatch(&d);
+}
+
+bool Automation_AddWatchpoint(unsigned id, uint32 addr, uint32 len, bool is_read, bool filter_active, uint32 filter_value)
+{
+ AutomationWatch w;
+ uint32 region_size;
+
+ if(!Automation_WatchRegion(addr, &w.region, &w.start, &region_size))
+  return false;
+
+ if((is_read && w.region == AUTOWP_VDP1) || !len || len > region_size - w.start)
+  return false;
+
+ w.id = id;
+ w.end = w.start + len;
+ w.is_read = is_read;
+ w.filter_active = filter_active;
+ w.filter_value = filter_value;
+ automation_watches.push_back(w);
+ Automation_RebuildWatchPages();
+ return true;
+}
+
+void Automation_RemoveWatchpoint(unsigned id)
+{
+ for(auto it = automation_watches.begin(); it != automation_watches.end(); ++it)
+ {
+  if(it->id == id)
+  {
+   automation_watches.erase(it);
+   break;
+  }
+ }
+ Automation_RebuildWatchPages();
+}
+
+void Automation_WriteLogStop(void)
+{
+ writelog_active = false;
+ writelog_ranges.clear();
+ writelog_ring.reset();
+ for(auto& h : writelog_head)
+  h.reset();
+ Automation_RebuildWatchPages();
+}
+
+// Write log over Work RAM [ranges[2i], ranges[2i + 1]] (inclusive bus
+// addresses), "entries" rounded up to a power of two. False if a range isn't
+// inside Low or High Work RAM.
+bool Automation_WriteLogStart(const uint32* ranges, unsigned count, size_t entries)
+{
+ std::vector<WriteLogRange> rl;
+
+ for(unsigned i = 0; i < count; i++)
+ {
+  WriteLogRange r;
+  uint32 last, region_size;
+  unsigned last_region;
+
+  if(!Automation_WatchRegion(ranges[i * 2], &r.region, &r.start, &region_size) || r.region == AUTOWP_VDP1)
+   return false;
+
+  if(!Automation_WatchRegion(ranges[i * 2 + 1], &last_region, &last, &region_size) || last_region != r.region || last < r.start)
+   return false;
+
+  r.end = last + 1;
+  rl.push_back(r);
+ }
+
+ Automation_WriteLogStop();
+
+ size_t cap = 1;
+ while(cap < entries)
+  cap <<= 1;
+
+ writelog_ring.reset(new WriteLogEntry[cap]);
+ writelog_mask = cap - 1;
+ writelog_total = 0;
+ for(unsigned region = 0; region < 2; region++)
+ {
+  writelog_head[region].reset(new uint64[0x100000 / 4]);
+  memset(writelog_head[region].get(), 0, sizeof(uint64) * (0x100000 / 4));
+ }
+ writelog_ranges = rl;
+ writelog_active = true;
+ Automation_RebuildWatchPages();
+ return true;
+}
+
+bool Automation_WriteLogActive(void) { return writelog_active; }
+
+void Automation_WriteLogStats(uint64* total, uint64* held, int64* oldest_cycle)
+{
+ *total = writelog_total;
+ *held = writelog_active ? std::min<uint64>(writelog_total, writelog_mask + 1) : 0;
+ *oldest_cycle = *held ? writelog_ring[(writelog_total - *held) & writelog_mask].cycle : -1;
+}
+
+// Newest first, up to "max" writes covering byte "addr" made before
+// before_cycle. Returns the number found, or -1 if addr isn't logged. *complete
+// is false when the walk ran into entries the ring has already overwritten,
+// so older writes may exist.
+int Automation_WriteLogQuery(uint32 addr, int64 before_cycle, Automation_WriteLogHit* out, int max, bool* complete)
+{
+ unsigned region;
+ uint32 offs, region_size;
+ bool logged = false;
+ int n = 0;
+
+ *complete = true;
+
+ if(!writelog_active || !Automation_WatchRegion(addr, &region, &offs, &region_size) || region == AUTOWP_VDP1)
+  return -1;
+
+ for(const WriteLogRange& r : writelog_ranges)
+  logged |= (r.region == region && offs < r.end && offs >= r.start);
+
+ if(!logged)
+  return -1;
+
+ const uint64 floor = writelog_total - std::min<uint64>(writelog_total, writelog_mask + 1);
+
+ for(uint64 seq = writelog_head[region][offs >> 2]; seq && n < max; )
+ {
+  if(seq - 1 < floor)
+  {
+   *complete = false;
+   break;
+  }
+
+  const WriteLogEntry& e = writelog_ring[(seq - 1) & writelog_mask];
+  const uint32 a = e.addr & 0x0FFFFFFF;
+  const unsigned size = 1U << ((e.addr >> 28) & 3);
+
+  if(e.cycle < before_cycle && (addr & 0x0FFFFF) - (a & 0x0FFFFF) < size)
+  {
+   Automation_WriteLogHit& h = out[n++];
+
+   h.cycle = e.cycle;
+   h.pc = e.pc;
+   h.addr = a;
+   h.size = size;
+   h.source = e.addr >> 30;
+   h.old_val = e.old_val;
+   h.new_val = e.new_val;
+  }
+  seq = e.prev;
+ }
+
+ return n;
+}
+
+// Forget writes made at or after "cycle", for reverse execution: emulation is
+// about to run again from a snapshot taken at that cycle.
+void Automation_WriteLogRewind(int64 cycle)
+{
+ if(!writelog_active)
+  return;
+
+ const uint64 floor = writelog_total - std::min<uint64>(writelog_total, writelog_mask + 1);
+
+ while(writelog_total > floor)
+ {
+  const WriteLogEntry& e = writelog_ring[(writelog_total - 1) & writelog_mask];
+
+  if(e.cycle < cycle)
+   break;
+
+  const uint32 a = e.addr & 0x0FFFFFFF;
+  writelog_head[(a >= 0x06000000) ? AUTOWP_HWR : AUTOWP_LWR][(a & 0xFFFFF) >> 2] = e.prev;
+  writelog_total--;
+ }
+}
+
+void Automation_VDP2WatchFrame(uint64 frame)
+{
+ if(automation_vdp2wp_mode != VDP2WP_AGG || !automation_vdp2wp_ring || vdp2wp_touched.empty())
+  return;
+
+ std::sort(vdp2wp_touched.begin(), vdp2wp_touched.end());
+ vdp2wp_buf.resize(12 + vdp2wp_touched.size() * (12 + 4 * VDP2WP_AGG_PCS));
+ uint8* p = &vdp2wp_buf[12];
+
+ for(uint32 i : vdp2wp_touched)
+ {
+  VDP2WPLine& l = vdp2wp_lines[i];
+
+  MDFN_en32lsb(p + 0, automation_vdp2wp_lo + (i << vdp2wp_line_bits));
+  MDFN_en32lsb(p + 4, l.writes);
+  p[8] = l.npcs;
+  p[9] = l.overflow;
+  MDFN_en16lsb(p + 10, 0);
+  p += 12;
+  for(unsigned j = 0; j < l.npcs; j++, p += 4)
+   MDFN_en32lsb(p, l.pcs[j]);
+
+  memset(&l, 0, sizeof(l));
+ }
+
+ MDFN_en64lsb(&vdp2wp_buf[0], frame);
+ MDFN_en32lsb(&vdp2wp_buf[8], vdp2wp_touched.size());
+ automation_vdp2wp_ring->Write(vdp2wp_buf.data(), p - vdp2wp_buf.data());
+ vdp2wp_touched.clear();
+}
+
+bool Automation_VDP2WatchIsActive(void) { return automation_vdp2wp_ring != nullptr; }
+
+uint64 Automation_ClearVDP2Watchpoint(uint64 frame, uint64* records)
+{
+ uint64 dropped = 0;
+
+ automation_vdp2wp_active = false;
+ if(automation_vdp2wp_ring)
+ {
+  Automation_VDP2WatchFrame(frame);
+  dropped = automation_vdp2wp_ring->Dropped();
+  delete automation_vdp2wp_ring;	// drains the ring
+  automation_vdp2wp_ring = nullptr;
+ }
+ if(records)
+  *records = vdp2wp_records;
+ vdp2wp_records = 0;
+ vdp2wp_lines.clear();
+ vdp2wp_lines.shrink_to_fit();
+ vdp2wp_touched.clear();
+ vdp2wp_buf.clear();
+ return dropped;
+}
+
+// mode: 0 text, 1 binary, 2 aggregate per line_size (power of 2, 4..65536)
+// bytes. [lo, hi] inclusive, at most 2MiB wide (the whole VDP2 region).
+bool Automation_SetVDP2Watchpoint(uint32 lo, uint32 hi, const char* logpath, unsigned mode, unsigned line_size, bool zlib)
+{
+ Automation_ClearVDP2Watchpoint(0, nullptr);
+ if(hi < lo || hi - lo >= (2U << 20) || mode > VDP2WP_AGG)
+  return false;
+
+ if(mode == VDP2WP_AGG && (line_size < 4 || line_size > 65536 || (line_size & (line_size - 1))))
+  return false;
+
+ FILE* f = fopen(logpath, (mode == VDP2WP_TEXT) ? "w" : "wb");
+ if(!f)
+  return false;
+
+ if(mode == VDP2WP_TEXT)
+  fprintf(f, "# VDP2 VRAM write watchpoint: 0x%08X-0x%08X\n", lo, hi);
+ else
+ {
+  uint8 header[24];
+
+  memcpy(header, (mode == VDP2WP_BIN) ? "MDFNV2W1" : "MDFNV2A1", 8);
+  MDFN_en32lsb(&header[8], lo);
+  MDFN_en32lsb(&header[12], hi);
+  MDFN_en32lsb(&header[16], (mode == VDP2WP_AGG) ? line_size : 0);
+  MDFN_en32lsb(&header[20], zlib);
+  fwrite(header, 1, sizeof(header), f);
+ }
+
+ automation_vdp2wp_ring = new TraceRing(f, true, TraceRing::Default_Capacity, zlib && mode != VDP2WP_TEXT);
+ automation_vdp2wp_lo = lo;
+ automation_vdp2wp_hi = hi;
+ automation_vdp2wp_mode = mode;
+
+ if(mode == VDP2WP_AGG)
+ {
+  vdp2wp_line_bits = MDFN_log2(line_size);
+  vdp2wp_lines.assign(((hi - lo) >> vdp2wp_line_bits) + 1, VDP2WPLine());
+ }
+ automation_vdp2wp_active = true;
+ return true;
+}
+
+// CDL (Code/Data Logging) — sparse, optionally limited to [lo, hi)
+static void CDL_FreePages(void)
+{
+ for(uint8*& p : cdl_pages)
+ {
+  if(p != cdl_discard_page)
+   delete[] p;
+  p = nullptr;
+ }
+ for(uint8*& p : cdl_seen)
+ {
+  delete[] p;
+  p = nullptr;
+ }
+ memset(cdl_dirty, 0, sizeof(cdl_dirty));
+ memset(cdl_code_pages, 0, sizeof(cdl_code_pages));
+ cdl_dirty_list.clear();
+ cdl_page_count = 0;
+}
+
+void Automation_CDLStart(uint32 lo, uint32 hi)
+{
+ uint32 masked_lo = lo & 0x0FFFFFFF;
+ uint32 masked_hi = std::min<uint32>(hi & 0x0FFFFFFF, 1U << CDL_BUS_BITS);
+
+ CDL_FreePages();
+
+ // Validate range
+ if(masked_hi <= masked_lo) {
+  cdl_active = false;
+  cdl_lo = cdl_hi = 0;
+  return;
+ }
+
+ cdl_lo = masked_lo;
+ cdl_hi = masked_hi;
+ cdl_active = true;
+}
+
+void Automation_CDLStop(void)
+{
+ cdl_active = false;
+}
+
+void Automation_CDLReset(void)
+{
+ CDL_FreePages();
+}
+
+// Compact dump: "MDFNCDL2", le32 page size, le32 page count, le32 lo, le32 hi,
+// then for each page with any bit set, ascending: le32 address, le32 encoded
+// length, and the page as runs of (varint count, u8 flags). A full-game log
+// is dominated by long zero/constant runs, so it stays small.
+bool Automation_CDLDump(const char* path)
+{
+ if(!cdl_hi) return false;
+ FILE* f = fopen(path, "wb");
+ if(!f) return false;
+
+ const uint32 page_size = 1U << CDL_PAGE_BITS;
+ std::vector<uint8> enc;
+ std::vector<uint32> used;
+
+ for(uint32 page = 0; page < (1U << (CDL_BUS_BITS - CDL_PAGE_BITS)); page++)
+ {
+  const uint8* p = cdl_pages[page];
+
+  if(!p || p == cdl_discard_page)
+   continue;
+
+  for(uint32 i = 0; i < page_size; i++)
+  {
+   if(p[i])
+   {
+    used.push_back(page);
+    break;
+   }
+  }
+ }
+
+ uint8 hdr[24];
+ memcpy(hdr, "MDFNCDL2", 8);
+ MDFN_en32lsb(&hdr[8], page_size);
+ MDFN_en32lsb(&hdr[12], used.size());
+ MDFN_en32lsb(&hdr[16], cdl_lo);
+ MDFN_en32lsb(&hdr[20], cdl_hi);
+ fwrite(hdr, 1, sizeof(hdr), f);
+
+ for(uint32 page : used)
+ {
+  const uint8* p = cdl_pages[page];
+
+  enc.clear();
+  for(uint32 i = 0; i < page_size;)
+  {
+   uint32 run = 1;
+
+   while(i + run < page_size && p[i + run] == p[i])
+    run++;
+
+   for(uint32 v = run; ; v >>= 7)
+   {
+    enc.push_back((v & 0x7F) | ((v >= 0x80) ? 0x80 : 0));
+    if(v < 0x80)
+     break;
+   }
+   enc.push_back(p[i]);
+   i += run;
+  }
+
+  uint8 ph[8];
+  MDFN_en32lsb(&ph[0], page << CDL_PAGE_BITS);
+  MDFN_en32lsb(&ph[4], enc.size());
+  fwrite(ph, 1, sizeof(ph), f);
+  fwrite(enc.data(), 1, enc.size(), f);
+ }
+
+ fclose(f);
+ return true;
+}
+
+bool Automation_CDLIsActive(void)
+{
+ return cdl_active;
+}
+
+// Overlay log (layout above CDL_OverlayHit): "MDFNOVL1", le32 flags (bit 0:
+// the rest is in TraceRing deflate blocks), then the records. Only pages CDL
+// has seen code in are watched, so it runs alongside cdl_start.
+bool Automation_CDLOverlayStart(const char* path, bool zlib)
+{
+ FILE* f;
+ uint8 header[12];
+
+ Automation_CDLOverlayStop(nullptr);
+
+ if(!(f = fopen(path, "wb")))
+  return false;
+
+ memcpy(header, "MDFNOVL1", 8);
+ MDFN_en32lsb(&header[8], zlib);
+ fwrite(header, 1, sizeof(header), f);
+ cdl_ovl_ring = new TraceRing(f, true, TraceRing::Default_Capacity, zlib);
+ cdl_ovl_events = 0;
+ return true;
+}
+
+// Returns the records written; dropped, if given, gets those the writer had no room for.
+uint64 Automation_CDLOverlayStop(uint64* dropped)
+{
+ if(dropped)
+  *dropped = cdl_ovl_ring ? cdl_ovl_ring->Dropped() : 0;
+ delete cdl_ovl_ring;	// drains the ring
+ cdl_ovl_ring = nullptr;
+ return cdl_ovl_events;
+}
+
+void Automation_CDLOverlayFrame(uint64 frame)
+{
+ cdl_ovl_frame = frame;
+}
+
+bool Automation_CDLOverlayIsActive(void)
+{
+ return cdl_ovl_ring != nullptr;
+}
+
+uint32 Automation_CDLGetLo(void) { return cdl_lo; }
+uint32 Automation_CDLGetHi(void) { return cdl_hi; }
+uint32 Automation_CDLGetSize(void) { return cdl_hi - cdl_lo; }
+uint32 Automation_CDLGetPages(void) { return cdl_page_count; }
+
+// Bytes that gained any bit in mask since the previous call (or since
+// cdl_start/cdl_reset), one line per run of consecutive bytes:
+// "<addr> <hex gained bits, two digits per byte>". Only pages marked dirty
+// since the last call are scanned.
+std::string Automation_CDLDelta(uint8 mask, uint32* nbytes)
+{
+ const uint32 page_size = 1U << CDL_PAGE_BITS;
+ std::string ret;
+ uint32 count = 0;
+ int64 run_end = -1;	// address one past the current run, -1 = none
+
+ std::sort(cdl_dirty_list.begin(), cdl_dirty_list.end());
+
+ for(uint32 page : cdl_dirty_list)
+ {
+  cdl_dirty[page >> 5] &= ~(1U << (page & 31));
+
+  const uint8* p = cdl_pages[page];
+  if(!p || p == cdl_discard_page)
+   continue;
+
+  uint8*& seen = cdl_seen[page];
+  if(!seen && !(seen = new(std::nothrow) uint8[page_size]()))
+   continue;
+
+  for(uint32 i = 0; i < page_size; i++)
+  {
+   const uint8 gained = p[i] & ~seen[i] & mask;
+
+   seen[i] |= p[i] & mask;
+   if(!gained)
+    continue;
+
+   const uint32 addr = (page << CDL_PAGE_BITS) + i;
+   char buf[16];
+
+   if(addr != run_end)
+   {
+    snprintf(buf, sizeof(buf), "%s0x%08X ", ret.empty() ? "" : "\n", addr);
+    ret += buf;
+   }
+   snprintf(buf, sizeof(buf), "%02X", gained);
+   ret += buf;
+   run_end = addr + 1;
+   count++;
+  }
+ }
+ cdl_dirty_list.clear();
+
+ *nbytes = count;
+ return ret;
+}
+
+// Sampling profiler: clears previous samples. cpu_mask bit 0 = master,
+// bit 1 = slave. interval is in master cycles.
+bool Automation_ProfileStart(uint32 interval, unsigned cpu_mask)
+{
+ if(interval < 16 || interval > (1U << 24) || !(cpu_mask & 3))
+  return false;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  profile_samples[c] = 0;
+  profile_pcs[c].clear();
+  profile_stacks[c].clear();
+ }
+ profile_interval = interval;
+ profile_cpu_mask = cpu_mask & 3;
+ profile_active = true;
+ SS_SetEventNT(&events[SS_EVENT_PROFILE], SH7095_mem_timestamp + profile_interval);
+
+ return true;
+}
+
+// Automation: periodic callback (run_until every=N). SS_EVENT_TICK fires every
+// tick_interval master cycles and calls tick_hook, which mustn't block; to
+// stop emulation it arms a pause in the CPU debug hook instead.
+static void (*tick_hook)(void) = nullptr;
+static sscpu_timestamp_t tick_interval = 0;
+
+static sscpu_timestamp_t Tick_Update(const sscpu_timestamp_t timestamp)
+{
+ if(!tick_hook)
+  return SS_EVENT_DISABLED_TS;
+
+ // ForceEventUpdates() calls every handler early; only tick when due.
+ if(timestamp < events[SS_EVENT_TICK].event_time)
+  return events[SS_EVENT_TICK].event_time;
+
+ tick_hook();
+
+ return timestamp + tick_interval;
+}
+
+void Automation_SetTickHook(void (*hook)(void), uint32 interval)
+{
+ tick_hook = interval ? hook : nullptr;
+ tick_interval = interval;
+ SS_SetEventNT(&events[SS_EVENT_TICK], tick_hook ? SH7095_mem_timestamp + tick_interval : SS_EVENT_DISABLED_TS);
+}
+
+// Stops sampling; collected data stays available to dump.
+void Automation_ProfileStop(void)
+{
+ profile_active = false;
+ SS_SetEventNT(&events[SS_EVENT_PROFILE], SS_EVENT_DISABLED_TS);
+}
+
+bool Automation_ProfileIsActive(void) { return profile_active; }
+uint32 Automation_ProfileGetInterval(void) { return profile_interval; }
+uint64 Automation_ProfileGetSamples(unsigned cpu) { return profile_samples[cpu & 1]; }
+uint32 Automation_ProfileGetStacks(void) { return profile_stacks[0].size() + profile_stacks[1].size(); }
+
+// Cache statistics: zeroes all counters.
+void Automation_CacheStatsStart(void)
+{
+ memset(cstat, 0, sizeof(cstat));
+ memset(cstat_miss, 0, sizeof(cstat_miss));
+ memset(cstat_miss_used, 0, sizeof(cstat_miss_used));
+ cstat_active = true;
+}
+
+void Automation_CacheStatsStop(void)
+{
+ cstat_active = false;
+}
+
+bool Automation_CacheStatsIsActive(void) { return cstat_active; }
+
+static std::vector<CacheStatMiss> CacheStat_SortedMisses(unsigned cpu)
+{
+ std::vector<CacheStatMiss> ret;
+
+ for(const CacheStatMiss& m : cstat_miss[cpu])
+ {
+  if(m.key)
+   ret.push_back(m);
+ }
+ std::sort(ret.begin(), ret.end(), [](const CacheStatMiss& a, const CacheStatMiss& b) { return a.count > b.count || (a.count == b.count && a.key < b.key); });
+
+ return ret;
+}
+
+// One line per CPU with the counters, then up to top lines per CPU of
+// "<cpu> miss 0xLINE i|d <count>", most misses first.
+std::string Automation_CacheStatsFormat(unsigned top)
+{
+ static const char* const cpu_names[2] = { "master", "slave" };
+ std::string ret;
+ char buf[256];
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const CacheStatCounters& cs = cstat[c];
+
+  snprintf(buf, sizeof(buf), "%s%s ihit=%llu imiss=%llu dhit=%llu dmiss=%llu purges=%llu ccr_writes=%llu ccr_flushes=%llu lines=%u dropped=%llu",
+	c ? "\n" : "", cpu_names[c],
+	(unsigned long long)cs.ihit, (unsigned long long)cs.imiss, (unsigned long long)cs.dhit, (unsigned long long)cs.dmiss,
+	(unsigned long long)cs.purges, (unsigned long long)cs.ccr_writes, (unsigned long long)cs.ccr_flushes,
+	cstat_miss_used[c], (unsigned long long)cs.miss_dropped);
+  ret += buf;
+ }
+
+ for(unsigned c = 0; c < 2 && top; c++)
+ {
+  std::vector<CacheStatMiss> misses = CacheStat_SortedMisses(c);
+
+  for(size_t i = 0; i < misses.size() && i < top; i++)
+  {
+   snprintf(buf, sizeof(buf), "\n%s miss 0x%08X %c %u", cpu_names[c], misses[i].key & ~0xFU, (misses[i].key & 2) ? 'i' : 'd', misses[i].count);
+   ret += buf;
+  }
+ }
+
+ return ret;
+}
+
+// "MDFNCST1", then for master and slave: 8 x le64 counters (CacheStatCounters
+// order), le32 n, and n x { le32 line | 2 if instruction, le32 count }, most
+// misses first.
+bool Automation_CacheStatsDump(const char* path)
+{
+ FILE* fp = fopen(path, "wb");
+
+ if(!fp)
+  return false;
+
+ fwrite("MDFNCST1", 1, 8, fp);
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const CacheStatCounters& cs = cstat[c];
+  const uint64 counters[8] = { cs.ihit, cs.imiss, cs.dhit, cs.dmiss, cs.purges, cs.ccr_writes, cs.ccr_flushes, cs.miss_dropped };
+  std::vector<CacheStatMiss> misses = CacheStat_SortedMisses(c);
+  uint8 tmp[8];
+
+  for(uint64 v : counters)
+  {
+   MDFN_en64lsb(tmp, v);
+   fwrite(tmp, 1, 8, fp);
+  }
+
+  MDFN_en32lsb(tmp, misses.size());
+  fwrite(tmp, 1, 4, fp);
+  for(const CacheStatMiss& m : misses)
+  {
+   MDFN_en32lsb(&tmp[0], m.key & ~1U);
+   MDFN_en32lsb(&tmp[4], m.count);
+   fwrite(tmp, 1, 8, fp);
+  }
+ }
+
+ const bool ok = !ferror(fp);
+ fclose(fp);
+ return ok;
+}
+
+// Bus profiler: zeroes all counters.
+void Automation_BusProfileStart(void)
+{
+ memset(&busprof_cur, 0, sizeof(busprof_cur));
+ memset(&busprof_last, 0, sizeof(busprof_last));
+ memset(&busprof_total, 0, sizeof(busprof_total));
+ busprof_active = true;
+}
+
+void Automation_BusProfileStop(void)
+{
+ busprof_active = false;
+}
+
+bool Automation_BusProfileIsActive(void) { return busprof_active; }
+
+// End of an emulated frame: the frame's counters become the "last" set.
+void Automation_BusProfileFrame(void)
+{
+ for(unsigned i = 0; i < sizeof(busprof_cur.count) / sizeof(uint64); i++)
+ {
+  (&busprof_total.count[0][0][0])[i] += (&busprof_cur.count[0][0][0])[i];
+  (&busprof_total.cycles[0][0][0])[i] += (&busprof_cur.cycles[0][0][0])[i];
+ }
+ busprof_last = busprof_cur;
+ memset(&busprof_cur, 0, sizeof(busprof_cur));
+}
+
+// " m.r.HWRAM=<count>/<cycles> ..." for each nonzero counter of the last
+// frame (or of everything since start/reset, if total); m/s = master/slave,
+// r/w = read/write.
+std::string Automation_BusProfileFormat(bool total)
+{
+ static const char* const region_names[BUSPROF_NUM_REGIONS] = { "BIOS", "LWRAM", "HWRAM", "VDP1", "VDP2", "SCSP", "CD", "CART", "SCU", "OTHER" };
+ const BusProfCounters& bc = total ? busprof_total : busprof_last;
+ std::string ret;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  for(unsigned w = 0; w < 2; w++)
+  {
+   for(unsigned r = 0; r < BUSPROF_NUM_REGIONS; r++)
+   {
+    if(!bc.count[c][w][r])
+     continue;
 
-  CS3: 0x06000000...0x07FFFFFF
-	0x06000000...0x07FFFFFF: High RAM/SDRAM(1MiB) (R/W)
-*/
-//
-// Never add anything to SH7095_mem_timestamp when DMAHax is true.
-//
-// When BurstHax is true and we're accessing high work RAM, don't add anything.
-//
-template<typename T, bool IsWrite>
-static INLINE void BusRW_DB_CS0(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+    char buf[80];
+    snprintf(buf, sizeof(buf), " %c.%c.%s=%llu/%llu", "ms"[c], "rw"[w], region_names[r], (unsigned long long)bc.count[c][w][r], (unsigned long long)bc.cycles[c][w][r]);
+    ret += buf;
+   }
+  }
+ }
+
+ return ret;
+}
+
+// Interrupt latency profiler: zeroes the counters and the masking PC table;
+// sources already pending are skipped until they're asserted again.
+void Automation_IntLatencyStart(void)
 {
- //
- // Low(and kinda slow) work RAM
- //
- if(A >= 0x00200000 && A <= 0x003FFFFF)
+ memset(&intlat_cur, 0, sizeof(intlat_cur));
+ memset(&intlat_last, 0, sizeof(intlat_last));
+ memset(&intlat_total, 0, sizeof(intlat_total));
+ memset(intlat_pcs, 0, sizeof(intlat_pcs));
+ intlat_pcs_used = 0;
+ intlat_pcs_dropped = 0;
+ intlat_frames = 0;
+ intlat_pending = 0;
+ intlat_ivec_ts = -1;
+ intlat_active = true;
+}
+
+void Automation_IntLatencyStop(void)
+{
+ intlat_active = false;
+}
+
+bool Automation_IntLatencyIsActive(void) { return intlat_active; }
+
+static void IntLat_Add(IntLatCounters& d, const IntLatCounters& s)
+{
+ for(unsigned i = 0; i < INTLAT_SOURCES; i++)
  {
-  if(!SH2DMAHax)
-   SH7095_mem_timestamp += 7;
-  else
-   *SH2DMAHax += 7;
+  d.count[i] += s.count[i];
+  d.cycles[i] += s.cycles[i];
+  d.max[i] = std::max<uint64>(d.max[i], s.max[i]);
+  d.masked[i] += s.masked[i];
+  d.masked_cycles[i] += s.masked_cycles[i];
+  d.merged[i] += s.merged[i];
+  for(unsigned b = 0; b < INTLAT_BUCKETS; b++)
+   d.hist[i][b] += s.hist[i][b];
+ }
+}
 
-  //
-  // VA0 and VA1 don't map DRAM in the upper 1MiB of the 2MiB region, and return 0xFFFF(~0) on reads.
-  // VA2 mirrors DRAM into the upper 1MiB for both reads and writes, which incidentally breaks "Myst" in the generator room due to
-  //	it trying to load a file that's too large to fit, wrapping around and corrupting essential data in the process.
-  // VA3+ behavior is untested.
-  //
-  // VA0/VA1 behavior is emulated here.
-  //
-  if(MDFN_UNLIKELY(A & 0x100000))
+void Automation_IntLatencyFrame(void)
+{
+ IntLat_Add(intlat_total, intlat_cur);
+ intlat_last = intlat_cur;
+ memset(&intlat_cur, 0, sizeof(intlat_cur));
+ intlat_frames++;
+}
+
+static const char* IntLat_Name(unsigned s)
+{
+ return (s == SCU_INT_EXT0) ? "CD" : (IntNames[s] ? IntNames[s] : "?");
+}
+
+// " VBIN=<count>/<cycles>/<max>/<masked>[b<k>=<n>,...] ..." for each source
+// fetched in the last frame(or since start, if total); b<k> counts latencies
+// in [2^k, 2^(k+1)) cycles.
+std::string Automation_IntLatencyFormat(bool total)
+{
+ const IntLatCounters& c = total ? intlat_total : intlat_last;
+ std::string ret;
+ char buf[96];
+
+ for(unsigned s = 0; s < INTLAT_SOURCES; s++)
+ {
+  if(!c.count[s])
+   continue;
+
+  snprintf(buf, sizeof(buf), " %s=%llu/%llu/%llu/%llu[", IntLat_Name(s), (unsigned long long)c.count[s], (unsigned long long)c.cycles[s], (unsigned long long)c.max[s], (unsigned long long)c.masked[s]);
+  ret += buf;
+  bool first = true;
+  for(unsigned b = 0; b < INTLAT_BUCKETS; b++)
   {
-   if(IsWrite)
-    SS_DBG(SS_DBG_WARNING, "[RAM] %zu-byte write of 0x%08x to revision-dependent address 0x%08x\n", sizeof(T), DB >> (((A & 1) ^ (2 - sizeof(T))) << 3), A);
+   if(!c.hist[s][b])
+    continue;
+
+   snprintf(buf, sizeof(buf), "%sb%u=%llu", first ? "" : ",", b, (unsigned long long)c.hist[s][b]);
+   ret += buf;
+   first = false;
+  }
+  ret += ']';
+ }
+
+ return ret;
+}
+
+// Text report of the totals: per source the counters and histogram, then the
+// PCs where SR.I held interrupts off, most masked cycles first.
+bool Automation_IntLatencyDump(const char* path)
+{
+ FILE* fp = fopen(path, "w");
+
+ if(!fp)
+  return false;
+
+ const IntLatCounters& c = intlat_total;
+
+ fprintf(fp, "# Interrupt latency, SCU assertion to master SH-2 vector fetch, master cycles; %llu frames\n", (unsigned long long)intlat_frames);
+ for(unsigned s = 0; s < INTLAT_SOURCES; s++)
+ {
+  if(!c.count[s] && !c.merged[s])
+   continue;
+
+  fprintf(fp, "%s count=%llu avg=%llu max=%llu masked=%llu masked_cycles=%llu merged=%llu\n", IntLat_Name(s),
+	(unsigned long long)c.count[s], (unsigned long long)(c.count[s] ? c.cycles[s] / c.count[s] : 0), (unsigned long long)c.max[s],
+	(unsigned long long)c.masked[s], (unsigned long long)c.masked_cycles[s], (unsigned long long)c.merged[s]);
+  for(unsigned b = 0; b < INTLAT_BUCKETS; b++)
+  {
+   if(!c.hist[s][b])
+    continue;
+
+   if(b == INTLAT_BUCKETS - 1)
+    fprintf(fp, "  >=%u %llu\n", 1U << b, (unsigned long long)c.hist[s][b]);
    else
+    fprintf(fp, "  %u-%u %llu\n", b ? (1U << b) : 0, (2U << b) - 1, (unsigned long long)c.hist[s][b]);
+  }
+ }
+
+ std::vector<IntLatMaskPC> pcs;
+ for(const IntLatMaskPC& e : intlat_pcs)
+ {
+  if(e.key)
+   pcs.push_back(e);
+ }
+ std::sort(pcs.begin(), pcs.end(), [](const IntLatMaskPC& a, const IntLatMaskPC& b) { return a.cycles > b.cycles || (a.cycles == b.cycles && a.key < b.key); });
+
+ fprintf(fp, "# SR.I masking: PC when IRL was raised, count, cycles held off, max; %llu dropped\n", (unsigned long long)intlat_pcs_dropped);
+ for(const IntLatMaskPC& e : pcs)
+ {
+  const std::string sym = Automation_SymbolFormat(e.key & ~1U);
+  std::string srcs;
+
+  for(unsigned s = 0; s < INTLAT_SOURCES; s++)
+  {
+   if(e.sources & (1U << s))
    {
-    SS_DBG(SS_DBG_WARNING, "[RAM] %zu-byte read from revision-dependent address 0x%08x\n", sizeof(T), A);
-    DB = DB | 0xFFFF;
+    if(!srcs.empty())
+     srcs += ',';
+    srcs += IntLat_Name(s);
+   }
+  }
+  fprintf(fp, "0x%08X %llu %llu %llu %s%s%s\n", e.key & ~1U, (unsigned long long)e.count, (unsigned long long)e.cycles, (unsigned long long)e.max,
+	srcs.c_str(), sym.empty() ? "" : " ", sym.c_str());
+ }
+
+ const bool ok = !ferror(fp);
+ fclose(fp);
+ return ok;
+}
+
+// Sync wait profiler: zeroes the sync points and counters.
+void Automation_SyncProfileStart(void)
+{
+ memset(syncprof_points, 0, sizeof(syncprof_points));
+ memset(syncprof_used, 0, sizeof(syncprof_used));
+ memset(syncprof_dropped, 0, sizeof(syncprof_dropped));
+ for(SyncProfCPU& st : syncprof_cpu)
+ {
+  st.bpc = ~0U;
+  st.taken = false;
+  st.point = nullptr;
+  st.last_ts = 0;
+  st.wait = 0;
+ }
+ memset(syncprof_frame_wait, 0, sizeof(syncprof_frame_wait));
+ memset(syncprof_last_wait, 0, sizeof(syncprof_last_wait));
+ memset(syncprof_total_wait, 0, sizeof(syncprof_total_wait));
+ memset(syncprof_last_cycles, 0, sizeof(syncprof_last_cycles));
+ memset(syncprof_total_cycles, 0, sizeof(syncprof_total_cycles));
+ syncprof_frame_ts = automation_total_cycles + CPU[0].timestamp;
+ syncprof_active = true;
+}
+
+void Automation_SyncProfileStop(void)
+{
+ syncprof_active = false;
+}
+
+bool Automation_SyncProfileIsActive(void) { return syncprof_active; }
+
+// End of an emulated frame. A CPU's frame is the master's elapsed cycles, or 0
+// for the slave while it's held in reset.
+void Automation_SyncProfileFrame(void)
+{
+ const int64 now = automation_total_cycles + CPU[0].timestamp;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  syncprof_last_wait[c] = syncprof_frame_wait[c];
+  syncprof_total_wait[c] += syncprof_frame_wait[c];
+  syncprof_frame_wait[c] = 0;
+  syncprof_last_cycles[c] = (c && CPU[1].timestamp == SS_EVENT_DISABLED_TS) ? 0 : now - syncprof_frame_ts;
+  syncprof_total_cycles[c] += syncprof_last_cycles[c];
+ }
+ syncprof_frame_ts = now;
+}
+
+static std::vector<SyncProfPoint> SyncProf_Sorted(unsigned cpu)
+{
+ std::vector<SyncProfPoint> ret;
+
+ for(const SyncProfPoint& p : syncprof_points[cpu])
+ {
+  if(p.key && p.cycles)
+   ret.push_back(p);
+ }
+ std::sort(ret.begin(), ret.end(), [](const SyncProfPoint& a, const SyncProfPoint& b) { return a.cycles > b.cycles || (a.cycles == b.cycles && a.key < b.key); });
+
+ return ret;
+}
+
+// " m=<wait>/<cycles> s=<wait>/<cycles> m.top=<pc>:<cycles> s.top=<pc>:<cycles>" for
+// the last frame(or since start, if total); top is the sync point with the most
+// wait cycles since start, left out when a CPU has none.
+std::string Automation_SyncProfileFormat(bool total)
+{
+ std::string ret;
+ char buf[96];
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  snprintf(buf, sizeof(buf), " %c=%llu/%llu", "ms"[c], (unsigned long long)(total ? syncprof_total_wait : syncprof_last_wait)[c],
+	(unsigned long long)(total ? syncprof_total_cycles : syncprof_last_cycles)[c]);
+  ret += buf;
+ }
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const SyncProfPoint* best = nullptr;
+
+  for(const SyncProfPoint& p : syncprof_points[c])
+  {
+   if(p.key && p.cycles && (!best || p.cycles > best->cycles))
+    best = &p;
+  }
+
+  if(best)
+  {
+   snprintf(buf, sizeof(buf), " %c.top=%08X:%llu", "ms"[c], best->key & ~1U, (unsigned long long)best->cycles);
+   ret += buf;
+  }
+ }
+
+ return ret;
+}
+
+// Text report since start: per CPU the wait share, then its sync points, most
+// wait cycles first; top = 0 lists all.
+bool Automation_SyncProfileDump(const char* path, unsigned top)
+{
+ static const char* const cpu_names[2] = { "master", "slave" };
+ FILE* fp = fopen(path, "w");
+
+ if(!fp)
+  return false;
+
+ fprintf(fp, "# Sync waits: polling loops on work RAM or FTCSR, cycles spent passing through them\n");
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const std::vector<SyncProfPoint> points = SyncProf_Sorted(c);
+  const uint64 wait = syncprof_total_wait[c];
+  const uint64 cycles = syncprof_total_cycles[c];
+
+  fprintf(fp, "%s wait=%llu cycles=%llu work=%llu wait_pct=%.1f points=%u dropped=%llu\n", cpu_names[c],
+	(unsigned long long)wait, (unsigned long long)cycles, (unsigned long long)(cycles > wait ? cycles - wait : 0),
+	cycles ? 100.0 * wait / cycles : 0.0, syncprof_used[c], (unsigned long long)syncprof_dropped[c]);
+
+  for(size_t i = 0; i < points.size() && (!top || i < top); i++)
+  {
+   const SyncProfPoint& p = points[i];
+   const std::string sym = Automation_SymbolFormat(p.key & ~1U);
+
+   fprintf(fp, "  0x%08X addr=0x%08X waits=%llu passes=%llu cycles=%llu max=%llu pct=%.1f%s%s\n", p.key & ~1U, p.addr,
+	(unsigned long long)p.waits, (unsigned long long)p.passes, (unsigned long long)p.cycles, (unsigned long long)p.max,
+	wait ? 100.0 * p.cycles / wait : 0.0, sym.empty() ? "" : " ", sym.c_str());
+  }
+ }
+
+ const bool ok = !ferror(fp);
+ fclose(fp);
+ return ok;
+}
+
+// Function profiler: clears the tables, e.g. at a frame boundary for a
+// per-frame report.
+void Automation_FuncProfileReset(void)
+{
+ memset(fprof_table, 0, sizeof(fprof_table));
+ memset(fprof_used, 0, sizeof(fprof_used));
+ memset(fprof_dropped, 0, sizeof(fprof_dropped));
+ FProf_Resync();
+}
+
+// cpu_mask bit 0 = master, bit 1 = slave.
+void Automation_FuncProfileStart(unsigned cpu_mask)
+{
+ fprof_cpu_mask = cpu_mask & 3;
+ fprof_active = true;
+ Automation_FuncProfileReset();
+}
+
+void Automation_FuncProfileStop(void)
+{
+ for(unsigned c = 0; c < 2; c++)
+ {
+  if(fprof_active && (fprof_cpu_mask & (1U << c)))
+   FProf_Unwind(c, 0);	// close open frames so inclusive totals include them
+ }
+ fprof_active = false;
+}
+
+bool Automation_FuncProfileIsActive(void) { return fprof_active; }
+uint32 Automation_FuncProfileGetFuncs(void) { return fprof_used[0] + fprof_used[1]; }
+
+// Text report, per CPU, sorted by exclusive cycles:
+//   "<cpu> <func> <calls> <incl> <excl> <excl%> <wait>" with func 0xXXXXXXXX
+// or [root], plus a trailing symbol column with symbols loaded. Percentages are of the cycles elapsed since start/reset. While
+// profiling, open frames are charged up to now without being closed.
+bool Automation_FuncProfileDump(const char* path, unsigned top)
+{
+ static const char* const cpu_names[2] = { "master", "slave" };
+ FILE* fp = fopen(path, "w");
+
+ if(!fp)
+  return false;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  if(!(fprof_cpu_mask & (1U << c)))
+   continue;
+
+  const int64 now = fprof_active ? FProf_Now(c) : fprof_last_ts[c];
+  const uint64 elapsed = now - fprof_start_ts[c];
+  std::vector<FProfEntry> funcs;
+
+  if(fprof_active)
+   FProf_Charge(c, now);
+
+  for(const FProfEntry& e : fprof_table[c])
+  {
+   if(e.func)
+    funcs.push_back(e);
+  }
+
+  if(fprof_active)
+  {
+   for(unsigned i = 0; i < shadow_stack_depth[c]; i++)
+   {
+    for(FProfEntry& e : funcs)
+    {
+     if(e.func == shadow_stack[c][i].target)
+     {
+      e.incl += now - fprof_enter_ts[c][i];
+      break;
+     }
+    }
+   }
+  }
+
+  std::sort(funcs.begin(), funcs.end(), [](const FProfEntry& a, const FProfEntry& b) { return a.excl > b.excl || (a.excl == b.excl && a.func < b.func); });
+  if(top && funcs.size() > top)
+   funcs.resize(top);
+
+  fprintf(fp, "# cpu=%s cycles=%llu functions=%u dropped=%llu\n", cpu_names[c], (unsigned long long)elapsed, fprof_used[c], (unsigned long long)fprof_dropped[c]);
+  fprintf(fp, "# cpu func calls incl_cycles excl_cycles excl_pct wait_cycles%s\n", automation_symbols.empty() ? "" : " symbol");
+  for(const FProfEntry& e : funcs)
+  {
+   char name[16];
+
+   if(e.func == FPROF_ROOT)
+    snprintf(name, sizeof(name), "[root]");
+   else
+    snprintf(name, sizeof(name), "0x%08X", e.func);
+
+   fprintf(fp, "%s %s %u %llu %llu %.2f %llu", cpu_names[c], name, e.calls, (unsigned long long)e.incl, (unsigned long long)e.excl,
+	elapsed ? e.excl * 100.0 / elapsed : 0.0, (unsigned long long)e.wait);
+   if(!automation_symbols.empty())
+   {
+    const std::string sym = (e.func == FPROF_ROOT) ? std::string() : Automation_SymbolFormat(e.func);
+
+    fprintf(fp, " %s", sym.empty() ? "-" : sym.c_str());
+   }
+   fputc('\n', fp);
+  }
+ }
+
+ fclose(fp);
+ return true;
+}
+
+// Call graph: clears the edges; frames already on the shadow stacks aren't
+// charged cycles when they return.
+void Automation_CallGraphReset(void)
+{
+ memset(cgraph_table, 0, sizeof(cgraph_table));
+ memset(cgraph_used, 0, sizeof(cgraph_used));
+ memset(cgraph_dropped, 0, sizeof(cgraph_dropped));
+ memset(cgraph_frame_edge, 0, sizeof(cgraph_frame_edge));
+}
+
+// cpu_mask bit 0 = master, bit 1 = slave.
+void Automation_CallGraphStart(unsigned cpu_mask, bool cycles)
+{
+ cgraph_cpu_mask = cpu_mask & 3;
+ cgraph_cycles = cycles;
+ cgraph_active = true;
+ Automation_CallGraphReset();
+}
+
+void Automation_CallGraphStop(void)
+{
+ cgraph_active = false;
+}
+
+void Automation_CallGraphFrame(uint64 frame)
+{
+ cgraph_frame = frame;
+}
+
+bool Automation_CallGraphIsActive(void) { return cgraph_active; }
+uint32 Automation_CallGraphGetEdges(void) { return cgraph_used[0] + cgraph_used[1]; }
+
+// DOT: one digraph, a cluster per CPU, nodes "m:0x06004000" / "s:..." (or
+// "m:root"), edges labelled with the call count (and cycles). JSON: per CPU,
+// an edge list with caller, callee, calls, first_frame, last_frame and, with
+// cycles, cycles. Cycles of calls still open aren't included. With symbols
+// loaded, DOT nodes are labelled with the name and JSON edges carry
+// caller_sym/callee_sym.
+bool Automation_CallGraphDump(const char* path, bool json)
+{
+ static const char* const cpu_names[2] = { "master", "slave" };
+ FILE* fp = fopen(path, "w");
+ bool first_cpu = true;
+
+ if(!fp)
+  return false;
+
+ fputs(json ? "{\"cpus\": [" : "digraph callgraph {\n node [shape=box, fontname=monospace];\n", fp);
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  if(!(cgraph_cpu_mask & (1U << c)))
+   continue;
+
+  std::vector<CGraphEdge> edges;
+
+  for(const CGraphEdge& e : cgraph_table[c])
+  {
+   if(e.caller)
+    edges.push_back(e);
+  }
+
+  std::sort(edges.begin(), edges.end(), [](const CGraphEdge& a, const CGraphEdge& b) { return a.calls > b.calls || (a.calls == b.calls && (a.caller < b.caller || (a.caller == b.caller && a.callee < b.callee))); });
+
+  if(json)
+  {
+   bool first_edge = true;
+
+   fprintf(fp, "%s\n {\"cpu\": \"%s\", \"dropped\": %llu, \"edges\": [", first_cpu ? "" : ",", cpu_names[c], (unsigned long long)cgraph_dropped[c]);
+   for(const CGraphEdge& e : edges)
+   {
+    char caller[16];
+
+    if(e.caller == FPROF_ROOT)
+     snprintf(caller, sizeof(caller), "root");
+    else
+     snprintf(caller, sizeof(caller), "0x%08X", e.caller);
+
+    fprintf(fp, "%s\n  {\"caller\": \"%s\", \"callee\": \"0x%08X\", \"calls\": %llu, \"first_frame\": %u, \"last_frame\": %u", first_edge ? "" : ",", caller, e.callee, (unsigned long long)e.calls, e.first_frame, e.last_frame);
+    if(!automation_symbols.empty())
+    {
+     const std::string caller_sym = (e.caller == FPROF_ROOT) ? std::string() : Automation_SymbolFormat(e.caller);
+     const std::string callee_sym = Automation_SymbolFormat(e.callee);
+
+     if(!caller_sym.empty())
+      fprintf(fp, ", \"caller_sym\": \"%s\"", caller_sym.c_str());
+     if(!callee_sym.empty())
+      fprintf(fp, ", \"callee_sym\": \"%s\"", callee_sym.c_str());
+    }
+    if(cgraph_cycles)
+     fprintf(fp, ", \"cycles\": %llu", (unsigned long long)e.cycles);
+    fputc('}', fp);
+    first_edge = false;
    }
+   fputs("\n ]}", fp);
+  }
+  else
+  {
+   const char n = cpu_names[c][0];
+
+   fprintf(fp, " subgraph cluster_%s {\n  label=\"%s dropped=%llu\";\n", cpu_names[c], cpu_names[c], (unsigned long long)cgraph_dropped[c]);
+   if(!automation_symbols.empty())
+   {
+    std::vector<uint32> nodes;
 
-   return;
-  }
+    for(const CGraphEdge& e : edges)
+    {
+     if(e.caller != FPROF_ROOT)
+      nodes.push_back(e.caller);
+     nodes.push_back(e.callee);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    for(uint32 a : nodes)
+    {
+     const std::string sym = Automation_SymbolFormat(a);
 
-  // Automation watchpoint: detect writes to Low Work RAM
-  uint32 wp_old_l = 0;
-  bool wp_match_l = false;
-  if(IsWrite && MDFN_UNLIKELY(automation_wp_active && automation_wp_is_lwr))
-  {
-   uint32 write_start = A & 0xFFFFF;
-   uint32 write_end = write_start + sizeof(T);
-   uint32 wp_start = automation_wp_addr;
-   uint32 wp_end = wp_start + 4;
-   if(write_start < wp_end && write_end > wp_start)
+     if(!sym.empty())
+      fprintf(fp, "  \"%c:0x%08X\" [label=\"%s\\n0x%08X\"];\n", n, a, sym.c_str(), a);
+    }
+   }
+   for(const CGraphEdge& e : edges)
    {
-    wp_old_l = ne16_rbo_be<uint32>(WorkRAML, automation_wp_addr & 0xFFFFC);
-    wp_match_l = true;
+    char caller[16];
+
+    if(e.caller == FPROF_ROOT)
+     snprintf(caller, sizeof(caller), "root");
+    else
+     snprintf(caller, sizeof(caller), "0x%08X", e.caller);
+
+    fprintf(fp, "  \"%c:%s\" -> \"%c:0x%08X\" [label=\"%llu", n, caller, n, e.callee, (unsigned long long)e.calls);
+    if(cgraph_cycles)
+     fprintf(fp, "\\n%llu cyc", (unsigned long long)e.cycles);
+    fprintf(fp, "\", tooltip=\"frames %u-%u\"];\n", e.first_frame, e.last_frame);
    }
+   fputs(" }\n", fp);
   }
+  first_cpu = false;
+ }
 
-  if(IsWrite)
-   ne16_wbo_be<T>(WorkRAML, A & 0xFFFFF, DB >> (((A & 1) ^ (2 - sizeof(T))) << 3));
-  else
-   DB = (DB & 0xFFFF0000) | ne16_rbo_be<uint16>(WorkRAML, A & 0xFFFFE);
+ fputs(json ? "\n]}\n" : "}\n", fp);
+ fclose(fp);
+ return true;
+}
+
+// Folded stacks (flamegraph.pl / speedscope / inferno): one line per unique
+// chain, "master;0x06004000;0x0600A120 <cycles>", frames are shadow stack
+// call targets outermost first (symbol names instead when loaded), cycles =
+// samples * interval. Mode 1 (flat) instead writes "<cpu> <pc> <samples>
+// <cycles>" per sampled PC, most samples first; mode 2 (func) sums the sampled
+// PCs into the symbol containing them, "<cpu> <symbol> <samples> <cycles>",
+// with PCs outside every symbol under [unknown].
+bool Automation_ProfileDump(const char* path, unsigned mode)
+{
+ static const char* const cpu_names[2] = { "master", "slave" };
+ FILE* fp = fopen(path, "w");
+
+ if(!fp)
+  return false;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  if(mode == 2)
+  {
+   std::unordered_map<int32, uint64> funcs;
+   std::vector<std::pair<int32, uint64>> sorted;
+
+   for(auto const& e : profile_pcs[c])
+    funcs[Automation_SymbolFind(e.first)] += e.second;
+   sorted.assign(funcs.begin(), funcs.end());
+   std::sort(sorted.begin(), sorted.end(), [](const std::pair<int32, uint64>& a, const std::pair<int32, uint64>& b) { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+   for(auto const& e : sorted)
+    fprintf(fp, "%s %s %llu %llu\n", cpu_names[c], (e.first < 0) ? "[unknown]" : automation_symbols[e.first].name.c_str(), (unsigned long long)e.second, (unsigned long long)(e.second * profile_interval));
+   continue;
+  }
 
-  if(IsWrite && MDFN_UNLIKELY(wp_match_l))
+  if(mode == 1)
   {
-   uint32 wp_new = ne16_rbo_be<uint32>(WorkRAML, automation_wp_addr & 0xFFFFC);
-   if(wp_new != wp_old_l && (!automation_wp_filter_active || wp_new == automation_wp_filter_value))
-    ::Automation_WatchpointHit(CPU[automation_current_cpu].PC, A, wp_old_l, wp_new, CPU[automation_current_cpu].PR, "CPU");
+   std::vector<std::pair<uint32, uint64>> pcs(profile_pcs[c].begin(), profile_pcs[c].end());
+
+   std::sort(pcs.begin(), pcs.end(), [](const std::pair<uint32, uint64>& a, const std::pair<uint32, uint64>& b) { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+   for(auto const& e : pcs)
+    fprintf(fp, "%s 0x%08X %llu %llu\n", cpu_names[c], e.first, (unsigned long long)e.second, (unsigned long long)(e.second * profile_interval));
+   continue;
   }
 
-  // Automation: read watchpoint for Low Work RAM
-  if(!IsWrite && MDFN_UNLIKELY(automation_rwp_active && automation_rwp_is_lwr))
+  for(auto const& e : profile_stacks[c])
   {
-   uint32 read_start = A & 0xFFFFF;
-   uint32 read_end = read_start + sizeof(T);
-   uint32 rwp_start = automation_rwp_addr;
-   uint32 rwp_end = rwp_start + 4;
-   if(read_start < rwp_end && read_end > rwp_start)
+   fputs(cpu_names[c], fp);
+   for(size_t i = 0; i + sizeof(uint32) <= e.first.size(); i += sizeof(uint32))
    {
-    uint32 val = ne16_rbo_be<uint32>(WorkRAML, automation_rwp_addr & 0xFFFFC);
-    ::Automation_ReadWatchpointHit(CPU[automation_current_cpu].PC, A, val, CPU[automation_current_cpu].PR);
+    uint32 target;
+
+    memcpy(&target, &e.first[i], sizeof(uint32));
+    const int32 id = automation_symbols.empty() ? -1 : Automation_SymbolFind(target);
+
+    if(id >= 0 && Symbol_Norm(target) == automation_symbols[id].start)
+     fprintf(fp, ";%s", automation_symbols[id].name.c_str());
+    else
+     fprintf(fp, ";0x%08X", target);
    }
+   fprintf(fp, " %llu\n", (unsigned long long)(e.second * profile_interval));
   }
-
-  return;
  }
 
- //
- // BIOS ROM
- //
- if(A >= 0x00000000 && A <= 0x000FFFFF)
- {
-  if(!SH2DMAHax)
-   SH7095_mem_timestamp += 8;
-  else
-   *SH2DMAHax += 8;
+ fclose(fp);
+ return true;
+}
 
-  if(!IsWrite) 
-   DB = (DB & 0xFFFF0000) | ne16_rbo_be<uint16>(BIOSROM, A & 0x7FFFE);
+// DMA trace logging
+void Automation_EnableDMATrace(const char* path)
+{
+ delete dma_trace_ring;
+ dma_trace_ring = nullptr;
+ FILE* f = fopen(path, "w");
+ if(f)
+ {
+  dma_trace_ring = new TraceRing(f);
+  dma_trace_ring->Printf("# DMA trace: level src dst bytes pc frame\n");
+ }
+}
 
-  return;
+uint64 Automation_DisableDMATrace(void)
+{
+ uint64 dropped = 0;
+ if(dma_trace_ring) {
+  dropped = dma_trace_ring->Dropped();
+  delete dma_trace_ring;
+  dma_trace_ring = nullptr;
  }
+ return dropped;
+}
 
- //
- // SMPC
- //
- if(A >= 0x00100000 && A <= 0x0017FFFF)
+void Automation_LogDMA(int level, uint32 src, uint32 dst, uint32 bytes)
+{
+ uint32 pc = CPU[0].PC;
+ if(unified_bin)
+  unified_bin->DMA(CPU[0].timestamp, level, src, dst, bytes, pc);
+ if(recent_ev)
  {
-  const uint32 SMPC_A = (A & 0x7F) >> 1;
+  char line[RecentEv_TextMax];
+  snprintf(line, sizeof(line), "L%d src=0x%08X dst=0x%08X len=0x%X pc=0x%08X", level, src, dst, bytes, pc);
+  Automation_RecentEvent(automation_total_cycles + CPU[0].timestamp, "DMA", line);
+ }
+ if(!dma_trace_ring) return;
+ dma_trace_ring->Printf("L%d src=0x%08X dst=0x%08X len=0x%X pc=0x%08X cycle=%lld\n",
+  level, src, dst, bytes, pc,
+  (long long)(automation_total_cycles + CPU[0].timestamp));
+}
 
-  if(!SH2DMAHax)
-  {
-   // SH7095_mem_timestamp += 2;
-   CheckEventsByMemTS();
-  }
+// Binary DMA trace(dma_trace_bin). Regions by SH-2 bus address: 0 BIOS ROM, 1 low WRAM,
+// 2 A-bus CS0/CS1, 3 CD block, 4 sound RAM, 5 SCSP registers, 6 VDP1, 7 VDP2, 8 high WRAM,
+// 9 anything else.
+static unsigned DMABin_Region(uint32 A)
+{
+ A &= 0x07FFFFFF;
+
+ if(A < 0x00100000)
+  return 0;
+ else if(A >= 0x00200000 && A < 0x00300000)
+  return 1;
+ else if(A >= 0x02000000 && A < 0x05000000)
+  return 2;
+ else if(A >= 0x05800000 && A < 0x05900000)
+  return 3;
+ else if(A >= 0x05A00000 && A < 0x05B00000)
+  return 4;
+ else if(A >= 0x05B00000 && A < 0x05C00000)
+  return 5;
+ else if(A >= 0x05C00000 && A < 0x05E00000)
+  return 6;
+ else if(A >= 0x05E00000 && A < 0x05FC0000)
+  return 7;
+ else if(A >= 0x06000000)
+  return 8;
+
+ return 9;
+}
 
-  if(IsWrite)
-  {
-   if(sizeof(T) == 2 || (A & 1))
-    SMPC_Write(SH7095_mem_timestamp, SMPC_A, DB);
-  }
-  else
-   DB = (DB & 0xFFFF0000) | 0xFF00 | SMPC_Read(SH7095_mem_timestamp, SMPC_A);
+// 36-byte record: u8 0, u8 source, u8 src region, u8 dst region, le32 src, le32 dst,
+// le32 bytes, le64 start cycle, le64 end cycle, le32 SH-2 stall cycles.
+static void DMABin_Transfer(unsigned source, uint32 src, uint32 dst, uint32 bytes, int64 start, int64 end, uint32 stall)
+{
+ const unsigned sr = DMABin_Region(src);
+ const unsigned dr = DMABin_Region(dst);
+ DMABinSum& s = dmabin_sum[source][sr][dr];
+
+ end = std::max<int64>(start, end);
+ s.count++;
+ s.bytes += bytes;
+ dmabin_frame_transfers++;
+ dmabin_frame_cycles += end - start;
+ dmabin_frame_stall += stall;
+ dmabin_transfers++;
+ dmabin_bytes += bytes;
+
+ if(!dmabin_frames_only)
+ {
+  uint8 rec[36];
+
+  rec[0] = 0;
+  rec[1] = source;
+  rec[2] = sr;
+  rec[3] = dr;
+  MDFN_en32lsb(&rec[4], src);
+  MDFN_en32lsb(&rec[8], dst);
+  MDFN_en32lsb(&rec[12], bytes);
+  MDFN_en64lsb(&rec[16], start);
+  MDFN_en64lsb(&rec[24], end);
+  MDFN_en32lsb(&rec[32], stall);
+  dmabin_ring->Write(rec, sizeof(rec));
+ }
+}
 
-  return;
+// Called by SH7095::DMA_DoTransfer() per transfer unit; a channel run becomes one record when its
+// count reaches 0. ts0/ts1 are DMA_Timestamp before and after the unit.
+static void DMABin_SH2Unit(unsigned cpu, unsigned ch, uint32 sar, uint32 dar, uint32 bytes, sscpu_timestamp_t ts0, sscpu_timestamp_t ts1, bool done)
+{
+ DMABinStart& s = dmabin_sh2[cpu][ch];
+
+ if(!s.open)
+ {
+  s.open = true;
+  s.cycle = automation_total_cycles + ts0;
+  s.src = sar;
+  s.dst = dar;
+  s.bytes = 0;
  }
+ s.bytes += bytes;
 
- //
- // Backup RAM
- //
- if(A >= 0x00180000 && A <= 0x001FFFFF)
+ if(done)
  {
-  if(!SH2DMAHax)
-   SH7095_mem_timestamp += 8;
-  else
-   *SH2DMAHax += 8;
+  s.open = false;
+  DMABin_Transfer(DMABIN_SRC_SH2 + cpu * 2 + ch, s.src, s.dst, s.bytes, s.cycle, automation_total_cycles + ts1, 0);
+ }
+}
 
-  if(IsWrite)
+// SCSP DMA hook(sound.cpp): the whole transfer happens at once, in sound RAM/register word units.
+static void DMABin_SCSP(bool to_ram, uint32 mem_addr, uint32 reg_addr, uint32 length)
+{
+ const uint32 ram = 0x05A00000 + (mem_addr << 1);
+ const uint32 reg = 0x05B00000 + (reg_addr << 1);
+ const int64 now = automation_total_cycles + SH7095_mem_timestamp;
+
+ if(length)
+  DMABin_Transfer(DMABIN_SRC_SCSP, to_ram ? reg : ram, to_ram ? ram : reg, length << 1, now, now, 0);
+}
+
+// 32-byte frame header: u8 1, u8 0, le16 n, le32 transfers, le64 frame, le64 DMA cycles,
+// le64 SH-2 stall cycles; then n x (u8 source, u8 src region, u8 dst region, u8 0,
+// le32 transfers, le64 bytes) for the combinations that moved anything.
+static void DMABin_Frame(uint64 frame)
+{
+ uint8 buf[32 + 16 * DMABIN_SRC__COUNT * DMABIN_REGION__COUNT * DMABIN_REGION__COUNT];
+ uint8* p = buf + 32;
+ unsigned n = 0;
+
+ for(unsigned src = 0; src < DMABIN_SRC__COUNT; src++)
+ {
+  for(unsigned sr = 0; sr < DMABIN_REGION__COUNT; sr++)
   {
-   if(sizeof(T) != 1 || (A & 1))
+   for(unsigned dr = 0; dr < DMABIN_REGION__COUNT; dr++)
    {
-    uint8* const brp = &BackupRAM[(A >> 1) & 0x7FFF];
+    const DMABinSum& s = dmabin_sum[src][sr][dr];
 
-    if(*brp != (uint8)DB)
-    {
-     *brp = (uint8)DB;
-     BackupRAM_Dirty = true;
-    }
+    if(!s.count)
+     continue;
+
+    p[0] = src;
+    p[1] = sr;
+    p[2] = dr;
+    p[3] = 0;
+    MDFN_en32lsb(&p[4], s.count);
+    MDFN_en64lsb(&p[8], s.bytes);
+    p += 16;
+    n++;
    }
   }
-  else
-   DB = (DB & 0xFFFF0000) | 0xFF00 | BackupRAM[(A >> 1) & 0x7FFF];
+ }
+ buf[0] = 1;
+ buf[1] = 0;
+ MDFN_en16lsb(&buf[2], n);
+ MDFN_en32lsb(&buf[4], dmabin_frame_transfers);
+ MDFN_en64lsb(&buf[8], frame);
+ MDFN_en64lsb(&buf[16], dmabin_frame_cycles);
+ MDFN_en64lsb(&buf[24], dmabin_frame_stall);
+ dmabin_ring->Write(buf, p - buf);
+
+ memset(dmabin_sum, 0, sizeof(dmabin_sum));
+ dmabin_frame_transfers = 0;
+ dmabin_frame_cycles = dmabin_frame_stall = 0;
+ dmabin_frames++;
+}
 
-  return;
+bool Automation_DMATraceBinStart(const char* path, bool zlib, bool frames_only)
+{
+ FILE* f;
+ uint8 header[12];
+
+ Automation_DMATraceBinStop(0, nullptr);
+
+ if(!(f = fopen(path, "wb")))
+  return false;
+
+ memcpy(header, "MDFNDMA1", 8);
+ MDFN_en32lsb(&header[8], zlib | (frames_only << 1));
+ fwrite(header, 1, sizeof(header), f);
+ dmabin_ring = new TraceRing(f, true, TraceRing::Default_Capacity, zlib);
+ dmabin_frames_only = frames_only;
+ memset(dmabin_scu, 0, sizeof(dmabin_scu));	// transfers already running aren't recorded
+ memset(dmabin_sh2, 0, sizeof(dmabin_sh2));
+ memset(dmabin_sum, 0, sizeof(dmabin_sum));
+ dmabin_frame_transfers = 0;
+ dmabin_frame_cycles = dmabin_frame_stall = 0;
+ dmabin_transfers = dmabin_bytes = dmabin_frames = 0;
+ Automation_SetSCSPDMAHook(DMABin_SCSP);
+ return true;
+}
+
+// Writes a summary for the partial frame if anything moved in it; returns dropped records.
+// totals, if given, gets transfers, bytes and frame records since the start.
+uint64 Automation_DMATraceBinStop(uint64 frame, uint64* totals)
+{
+ uint64 dropped = 0;
+
+ if(dmabin_ring)
+ {
+  if(dmabin_frame_transfers)
+   DMABin_Frame(frame);
+  dropped = dmabin_ring->Dropped();
+  delete dmabin_ring;	// drains the ring
+  dmabin_ring = nullptr;
+  Automation_SetSCSPDMAHook(nullptr);
+ }
+ if(totals)
+ {
+  totals[0] = dmabin_transfers;
+  totals[1] = dmabin_bytes;
+  totals[2] = dmabin_frames;
  }
+ return dropped;
+}
 
- //
- // FRT trigger region
- //
- if(A >= 0x01000000 && A <= 0x01FFFFFF)
+void Automation_DMATraceBinFrame(uint64 frame)
+{
+ if(dmabin_ring)
+  DMABin_Frame(frame);
+}
+
+bool Automation_DMATraceBinIsActive(void) { return dmabin_ring != nullptr; }
+
+// Memory write profiling
+void Automation_EnableMemProfile(const char* path, uint32 lo, uint32 hi)
+{
+ delete memprofile_ring;
+ memprofile_ring = nullptr;
+ memprofile_lo = lo & 0x0FFFFFFF;
+ memprofile_hi = hi & 0x0FFFFFFF;
+ FILE* f = fopen(path, "w");
+ if(f)
  {
-  if(!SH2DMAHax)
-   SH7095_mem_timestamp += 8;
-  else
-   *SH2DMAHax += 8;
+  memprofile_ring = new TraceRing(f);
+  memprofile_ring->Printf("# Mem write profile: 0x%08X-0x%08X\n# pc addr val sz [chain=callee<-caller<-...]\n",
+   lo, hi);
+ }
+}
 
-  if(IsWrite)
-  {
-   if(sizeof(T) != 1)
-   {
-    const unsigned c = ((A >> 23) & 1) ^ 1;
+uint64 Automation_DisableMemProfile(void)
+{
+ uint64 dropped = 0;
+ if(memprofile_ring) {
+  dropped = memprofile_ring->Dropped();
+  delete memprofile_ring;
+  memprofile_ring = nullptr;
+ }
+ return dropped;
+}
 
-    // FTI logging disabled: was observer effect source (500 stderr writes during boot)
-    CPU[c].SetFTI(true);
-    CPU[c].SetFTI(false);
-   }
-  }
-  return;
+// Memory access heatmap. File: "MDFNHMP1", le32 lo, le32 size, le32 line
+// size (64), le32 top, then per dump: le64 frame, le64 master cycle, le32
+// line count n, le32 top entry count m, le32 (pc, line) pairs dropped because
+// the table was full, n lines of le32 line index and le32 CPU reads, CPU
+// writes, DMA reads, DMA writes (only lines with any), then m entries of le32
+// pc, le32 line index, le32 reads, le32 writes, most accesses first.
+static TraceRing* heatmap_ring = nullptr;
+static unsigned heatmap_every = 1;
+static unsigned heatmap_top = 0;
+static uint64 heatmap_frames = 0;	// frames counted since the last dump
+static uint64 heatmap_dumps = 0;
+static std::vector<uint8> heatmap_buf;
+
+static void Heatmap_Dump(uint64 frame)
+{
+ const uint32 nlines = heatmap_size >> HEATMAP_LINE_BITS;
+ std::vector<const HeatmapPC*> top;
+ uint32 n = 0;
+
+ heatmap_buf.resize(32 + (size_t)nlines * 20 + (size_t)heatmap_top * 16);
+ uint8* p = &heatmap_buf[32];
+
+ for(uint32 i = 0; i < nlines; i++)
+ {
+  const HeatmapLine& l = heatmap_lines[i];
+
+  if(!(l.cpu_read | l.cpu_write | l.dma_read | l.dma_write))
+   continue;
+
+  MDFN_en32lsb(p + 0, i);
+  MDFN_en32lsb(p + 4, l.cpu_read);
+  MDFN_en32lsb(p + 8, l.cpu_write);
+  MDFN_en32lsb(p + 12, l.dma_read);
+  MDFN_en32lsb(p + 16, l.dma_write);
+  p += 20;
+  n++;
  }
 
- //
- // FIXME: Run ST-V hardware test for correct region size and other characteristics.
- //
- //if(A >= 0x00400000 && A <= 0x0047FFFF && ActiveCartType == CART_STV)
- if(A >= 0x00400000 && A <= 0x0040007F && ActiveCartType == CART_STV)
+ if(heatmap_pcs)
  {
-  const uint32 IOGA_A = (A & 0x7F) >> 1;
+  for(uint32 i = 0; i < HEATMAP_PC_SIZE; i++)
+  {
+   if(heatmap_pcs[i].reads | heatmap_pcs[i].writes)
+    top.push_back(&heatmap_pcs[i]);
+  }
 
-  if(IsWrite)
+  auto more = [](const HeatmapPC* a, const HeatmapPC* b) { return (uint64)a->reads + a->writes > (uint64)b->reads + b->writes; };
+  if(top.size() > heatmap_top)
   {
-   if(sizeof(T) == 2 || (A & 1))
-    STVIO_WriteIOGA(SH7095_mem_timestamp, IOGA_A, DB);
+   std::partial_sort(top.begin(), top.begin() + heatmap_top, top.end(), more);
+   top.resize(heatmap_top);
   }
   else
-   DB = ((DB & 0xFFFF0000) | 0xFF00 | STVIO_ReadIOGA(SH7095_mem_timestamp, IOGA_A));
+   std::sort(top.begin(), top.end(), more);
 
-  return;
+  for(const HeatmapPC* e : top)
+  {
+   MDFN_en32lsb(p + 0, e->pc);
+   MDFN_en32lsb(p + 4, e->line);
+   MDFN_en32lsb(p + 8, e->reads);
+   MDFN_en32lsb(p + 12, e->writes);
+   p += 16;
+  }
  }
- //
- //
- //
- if(!SH2DMAHax)
-  SH7095_mem_timestamp += 4;
- else
-  *SH2DMAHax += 4;
 
- if(IsWrite)
-  SS_DBG(SS_DBG_WARNING, "[SH2 BUS] Unknown %zu-byte write of 0x%08x to 0x%08x\n", sizeof(T), DB >> (((A & 1) ^ (2 - sizeof(T))) << 3), A);
- else
-  SS_DBG(SS_DBG_WARNING, "[SH2 BUS] Unknown %zu-byte read from 0x%08x\n", sizeof(T), A);
+ MDFN_en64lsb(&heatmap_buf[0], frame);
+ MDFN_en64lsb(&heatmap_buf[8], automation_total_cycles + CPU[0].timestamp);
+ MDFN_en32lsb(&heatmap_buf[16], n);
+ MDFN_en32lsb(&heatmap_buf[20], top.size());
+ MDFN_en32lsb(&heatmap_buf[24], heatmap_pcs_dropped);
+ MDFN_en32lsb(&heatmap_buf[28], 0);
+ heatmap_ring->Write(heatmap_buf.data(), p - heatmap_buf.data());
+ heatmap_dumps++;
+
+ memset(heatmap_lines, 0, sizeof(HeatmapLine) * nlines);
+ if(heatmap_pcs)
+  memset(heatmap_pcs, 0, sizeof(HeatmapPC) * HEATMAP_PC_SIZE);
+ heatmap_pcs_used = 0;
+ heatmap_pcs_dropped = 0;
+ heatmap_frames = 0;
 }
 
-template<typename T, bool IsWrite>
-static INLINE void BusRW_DB_CS12(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+uint64 Automation_HeatmapStop(uint64 frame, uint64* dumps)
 {
- //
- // CS1 and CS2: SCU
- //
- if(!IsWrite)
-  DB = 0;
+ uint64 dropped = 0;
+
+ if(heatmap_ring)
+ {
+  if(heatmap_frames)
+   Heatmap_Dump(frame);
+  dropped = heatmap_ring->Dropped();
+  delete heatmap_ring;	// drains the ring
+  heatmap_ring = nullptr;
+ }
+ *dumps = heatmap_dumps;
+ delete[] heatmap_lines;
+ heatmap_lines = nullptr;
+ delete[] heatmap_pcs;
+ heatmap_pcs = nullptr;
+ heatmap_buf.clear();
+ heatmap_buf.shrink_to_fit();
+ return dropped;
+}
+
+// [lo, hi] inclusive, masked to 0x0FFFFFFF, at most 64MiB. Dumps every
+// "every" frames and keeps the "top" busiest (pc, line) pairs (0 = no table).
+bool Automation_HeatmapStart(const char* path, uint32 lo, uint32 hi, unsigned every, unsigned top, bool zlib)
+{
+ uint64 dumps;
+
+ lo &= 0x0FFFFFFF;
+ hi &= 0x0FFFFFFF;
+ Automation_HeatmapStop(0, &dumps);
+ if(hi < lo || hi - lo >= (64U << 20))
+  return false;
+
+ FILE* f = fopen(path, "wb");
+ if(!f)
+  return false;
+
+ lo &= ~((1U << HEATMAP_LINE_BITS) - 1);
+ const uint32 size = ((hi - lo) | ((1U << HEATMAP_LINE_BITS) - 1)) + 1;
+ const uint32 nlines = size >> HEATMAP_LINE_BITS;
+ uint8 header[24];
+
+ memcpy(header, "MDFNHMP1", 8);
+ MDFN_en32lsb(&header[8], lo);
+ MDFN_en32lsb(&header[12], size);
+ MDFN_en32lsb(&header[16], 1U << HEATMAP_LINE_BITS);
+ MDFN_en32lsb(&header[20], top);
+ fwrite(header, 1, sizeof(header), f);
+
+ heatmap_ring = new TraceRing(f, true, std::max<size_t>(TraceRing::Default_Capacity, ((size_t)nlines * 20 + (size_t)top * 16 + 32) * 4), zlib);
+ heatmap_every = std::max<unsigned>(1, every);
+ heatmap_top = std::min<unsigned>(top, HEATMAP_PC_SIZE);
+ heatmap_frames = 0;
+ heatmap_dumps = 0;
+ heatmap_pcs_used = 0;
+ heatmap_pcs_dropped = 0;
+ if(heatmap_top)
+  heatmap_pcs = new HeatmapPC[HEATMAP_PC_SIZE]();
+ heatmap_size = size;
+ heatmap_lo = lo;
+ heatmap_lines = new HeatmapLine[nlines]();
+ return true;
+}
+
+void Automation_HeatmapFrame(uint64 frame)
+{
+ if(heatmap_ring && ++heatmap_frames >= heatmap_every)
+  Heatmap_Dump(frame);
+}
+
+bool Automation_HeatmapIsActive(void) { return heatmap_ring != nullptr; }
+
+// Memory read profiling
+void Automation_EnableMemReadProfile(const char* path, uint32 lo, uint32 hi)
+{
+ delete memreadprofile_ring;
+ memreadprofile_ring = nullptr;
+ memreadprofile_lo = lo & 0x0FFFFFFF;
+ memreadprofile_hi = hi & 0x0FFFFFFF;
+ FILE* f = fopen(path, "w");
+ if(f)
+ {
+  memreadprofile_ring = new TraceRing(f);
+  memreadprofile_ring->Printf("# Mem read profile: 0x%08X-0x%08X\n# pc pr addr sz [chain=callee<-caller<-...]\n",
+   lo, hi);
+ }
+}
+
+uint64 Automation_DisableMemReadProfile(void)
+{
+ uint64 dropped = 0;
+ if(memreadprofile_ring) {
+  dropped = memreadprofile_ring->Dropped();
+  delete memreadprofile_ring;
+  memreadprofile_ring = nullptr;
+ }
+ return dropped;
+}
+
+// Ends both CPUs' collapsed runs into the current text trace.
+static void CallTrace_EndRuns(void)
+{
+ for(unsigned c = 0; c < 2; c++)
+  CallTrace_EndRun(c, CPU[0].CallTraceFile);
+}
+
+// ranges: lo/hi pairs, inclusive. All zero/false = no filtering. Resets the counters.
+bool Automation_SetCallTraceFilter(const uint32* include, unsigned n_include, const uint32* exclude, unsigned n_exclude, unsigned max_depth, bool collapse)
+{
+ if(n_include > CALLTRACE_MAX_RANGES || n_exclude > CALLTRACE_MAX_RANGES)
+  return false;
+
+ CallTrace_EndRuns();
+ memcpy(calltrace_include, include, n_include * 2 * sizeof(uint32));
+ memcpy(calltrace_exclude, exclude, n_exclude * 2 * sizeof(uint32));
+ calltrace_n_include = n_include;
+ calltrace_n_exclude = n_exclude;
+ calltrace_max_depth = max_depth;
+ calltrace_collapse = collapse;
+ calltrace_filter = n_include || n_exclude || max_depth || collapse;
+ calltrace_written = calltrace_filtered = calltrace_collapsed = 0;
+ return true;
+}
 
- SCU_FromSH2_BusRW_DB<T, IsWrite>(A, &DB, SH2DMAHax);
+void Automation_CallTraceStats(uint64* written, uint64* filtered, uint64* collapsed)
+{
+ *written = calltrace_written;
+ *filtered = calltrace_filtered;
+ *collapsed = calltrace_collapsed;
 }
 
-template<typename T, bool IsWrite>
-static INLINE void BusRW_DB_CS3(const uint32 A, uint32& DB, const bool BurstHax, int32* SH2DMAHax)
+void Automation_EnableCallTrace(const char* path)
 {
- //
- // CS3: High work RAM/SDRAM, 0x06000000 ... 0x07FFFFFF
- //
- //  Timing is handled in BSC_BusWrite() and BSC_BusRead() in sh7095.inc
- //
+ // Close any existing trace first
+ CallTrace_EndRuns();
+ if(CPU[0].CallTraceFile) { fclose(CPU[0].CallTraceFile); CPU[0].CallTraceFile = nullptr; }
+ if(CPU[1].CallTraceFile) { fclose(CPU[1].CallTraceFile); CPU[1].CallTraceFile = nullptr; }
 
- // Automation watchpoint: detect writes that overlap watched address
- uint32 wp_old = 0;
- bool wp_match = false;
- if(IsWrite && MDFN_UNLIKELY(automation_wp_active && !automation_wp_is_lwr))
- {
-  uint32 write_start = A & 0xFFFFF;
-  uint32 write_end = write_start + sizeof(T);
-  uint32 wp_start = automation_wp_addr;
-  uint32 wp_end = wp_start + 4;
-  if(write_start < wp_end && write_end > wp_start)
-  {
-   wp_old = ne16_rbo_be<uint32>(WorkRAMH, automation_wp_addr & 0xFFFFC);
-   wp_match = true;
-  }
+ FILE* f = fopen(path, "w");
+ if(f) {
+  // Both CPUs write to the same file, distinguished by M/S prefix
+  CPU[0].CallTraceFile = f;
+  CPU[1].CallTraceFile = f;
  }
+}
 
- if(!IsWrite || sizeof(T) == 4)
-  ne16_rwbo_be<uint32, IsWrite>(WorkRAMH, A & 0xFFFFC, &DB);
- else
-  ne16_wbo_be<T>(WorkRAMH, A & 0xFFFFF, DB >> (((A & 3) ^ (4 - sizeof(T))) << 3));
-
- // After write: read new value and report directly (no CPU hook needed)
- if(IsWrite && MDFN_UNLIKELY(wp_match))
- {
-  uint32 wp_new = ne16_rbo_be<uint32>(WorkRAMH, automation_wp_addr & 0xFFFFC);
-  if(wp_new != wp_old && (!automation_wp_filter_active || wp_new == automation_wp_filter_value))
-   ::Automation_WatchpointHit(CPU[automation_current_cpu].PC, A, wp_old, wp_new, CPU[automation_current_cpu].PR, "CPU");
+void Automation_DisableCallTrace(void)
+{
+ CallTrace_EndRuns();
+ if(CPU[0].CallTraceFile) {
+  fclose(CPU[0].CallTraceFile);
  }
+ CPU[0].CallTraceFile = nullptr;
+ CPU[1].CallTraceFile = nullptr;
+}
 
- // Automation: read watchpoint — detect reads that overlap watched address
- if(!IsWrite && MDFN_UNLIKELY(automation_rwp_active && !automation_rwp_is_lwr))
- {
-  uint32 read_start = A & 0xFFFFF;
-  uint32 read_end = read_start + sizeof(T);
-  uint32 rwp_start = automation_rwp_addr;
-  uint32 rwp_end = rwp_start + 4;
-  if(read_start < rwp_end && read_end > rwp_start)
-  {
-   uint32 val = ne16_rbo_be<uint32>(WorkRAMH, automation_rwp_addr & 0xFFFFC);
-   ::Automation_ReadWatchpointHit(CPU[automation_current_cpu].PC, A, val, CPU[automation_current_cpu].PR);
-  }
- }
+static bool call_trace_external = false;
+
+void Automation_SetCallTraceFile(FILE* f)
+{
+ CallTrace_EndRuns();
+ // Close any self-owned trace first
+ if(CPU[0].CallTraceFile && !call_trace_external)
+  fclose(CPU[0].CallTraceFile);
+ CPU[0].CallTraceFile = f;
+ CPU[1].CallTraceFile = f;
+ call_trace_external = (f != nullptr);
 }
 
-//
-//
-//
-static MDFN_COLD uint8 CheatMemRead(uint32 A)
+void Automation_ClearCallTraceFile(void)
 {
- A &= (1U << 27) - 1;
+ CallTrace_EndRuns();
+ if(CPU[0].CallTraceFile && !call_trace_external)
+  fclose(CPU[0].CallTraceFile);
+ CPU[0].CallTraceFile = nullptr;
+ CPU[1].CallTraceFile = nullptr;
+ call_trace_external = false;
+}
 
- return ne16_rbo_be<uint8>(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS], A);
+// Binary unified trace: call, CDB, DMA and (insn_trace_unified) per-instruction
+// records into one packed file plus a frame index.
+uint64 Automation_DisableUnifiedBinTrace(void)
+{
+ uint64 dropped = 0;
+ CPU[0].CallTraceBin = CPU[1].CallTraceBin = nullptr;
+ CPU[0].InsnTraceBin = CPU[1].InsnTraceBin = nullptr;
+ CDB_SetCDBTraceBin(nullptr);
+ if(unified_bin) { dropped = unified_bin->Dropped(); delete unified_bin; unified_bin = nullptr; }
+ return dropped;
 }
 
-static MDFN_COLD void CheatMemWrite(uint32 A, uint8 V)
+bool Automation_EnableUnifiedBinTrace(const char* path, bool zblocks, uint64 frame)
 {
- A &= (1U << 27) - 1;
+ Automation_DisableUnifiedBinTrace();
+ unified_bin = BinTrace::Open(path, zblocks, frame, automation_total_cycles);
+ CPU[0].CallTraceBin = unified_bin;
+ CPU[1].CallTraceBin = unified_bin;
+ CDB_SetCDBTraceBin(unified_bin);
+ return unified_bin != nullptr;
+}
 
- if(FMIsWriteable[A >> SH7095_EXT_MAP_GRAN_BITS])
- {
-  ne16_wbo_be<uint8>(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS], A, V);
+void Automation_UnifiedBinFrame(uint64 frame)
+{
+ if(unified_bin)
+  unified_bin->Frame(frame, automation_total_cycles);
+}
 
-  for(unsigned c = 0; c < 2; c++)
-  {
-   if(CPU[c].CCR & SH7095::CCR_CE)
-   {
-    for(uint32 Abase = 0x00000000; Abase < 0x20000000; Abase += 0x08000000)
-    {
-     CPU[c].Cache_WriteUpdate<uint8>(Abase + A, V);
-    }
-   }
-  }
+static void UnifiedBinNote(const char* text)
+{
+ unified_bin->Text(BinTrace::REC_NOTE, CPU[0].timestamp, text, strlen(text));
+}
+
+// Flight recorder: one ring per recorded CPU, see flight_rec.h.
+static FlightRec* flight_rec[2] = { nullptr, nullptr };
+
+void Automation_FlightRecStop(void)
+{
+ for(unsigned c = 0; c < 2; c++)
+ {
+  CPU[c].FlightRecorder = CPU[c].FlightRecMem = nullptr;
+  delete flight_rec[c];
+  flight_rec[c] = nullptr;
  }
 }
-//
-//
-//
-static void SetFastMemMap(uint32 Astart, uint32 Aend, uint16* ptr, uint32 length, bool is_writeable)
+
+void Automation_FlightRecStart(size_t entries, unsigned cpu_mask, bool mem)
 {
- const uint64 Abound = (uint64)Aend + 1;
- assert((Astart & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
- assert((Abound & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
- assert((length & ((1U << SH7095_EXT_MAP_GRAN_BITS) - 1)) == 0);
- assert(length > 0);
- assert(length <= (Abound - Astart));
+ Automation_FlightRecStop();
 
- for(uint64 A = Astart; A < Abound; A += (1U << SH7095_EXT_MAP_GRAN_BITS))
+ for(unsigned c = 0; c < 2; c++)
  {
-  uintptr_t tmp = (uintptr_t)ptr + ((A - Astart) % length);
-
-  if(A < (1U << 27))
-   FMIsWriteable[A >> SH7095_EXT_MAP_GRAN_BITS] = is_writeable;
+  if(!(cpu_mask & (1U << c)))
+   continue;
 
-  SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] = tmp - A;
+  flight_rec[c] = new FlightRec(entries);
+  CPU[c].FlightRecorder = flight_rec[c];
+  CPU[c].FlightRecMem = mem ? flight_rec[c] : nullptr;
  }
 }
 
-static MDFN_COLD void InitFastMemMap(void)
+bool Automation_FlightRecActive(void) { return flight_rec[0] || flight_rec[1]; }
+
+// Text, oldest first, both CPUs merged by cycle:
+//   "<cycle> M|S <pc> <opcode> <mnemonic>[ r|w<size>@<addr>]"
+// "last" limits each CPU to its newest entries (0 = all held). Returns the
+// number of lines written, -1 if the file can't be created.
+int64 Automation_FlightRecDump(const char* path, size_t last)
 {
- for(unsigned i = 0; i < sizeof(fmap_dummy) / sizeof(fmap_dummy[0]); i++)
- {
-  fmap_dummy[i] = 0;
- }
+ FILE* fp = fopen(path, "w");
+ size_t n[2] = { 0, 0 };
+ size_t i[2] = { 0, 0 };
+ int64 lines = 0;
 
- FMIsWriteable.reset();
- MDFNMP_Init(1ULL << SH7095_EXT_MAP_GRAN_BITS, (1ULL << 27) / (1ULL << SH7095_EXT_MAP_GRAN_BITS));
+ if(!fp)
+  return -1;
 
- for(uint64 A = 0; A < 1ULL << 32; A += (1U << SH7095_EXT_MAP_GRAN_BITS))
+ for(unsigned c = 0; c < 2; c++)
  {
-  SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] = (uintptr_t)fmap_dummy - A;
+  if(!flight_rec[c])
+   continue;
+
+  n[c] = flight_rec[c]->Count();
+  if(last && n[c] > last)
+   i[c] = n[c] - last;
+  fprintf(fp, "# flight recorder cpu=%s capacity=%zu total=%llu shown=%zu\n", c ? "slave" : "master", flight_rec[c]->Capacity(), (unsigned long long)flight_rec[c]->Total(), n[c] - i[c]);
  }
-}
 
-void SS_SetPhysMemMap(uint32 Astart, uint32 Aend, uint16* ptr, uint32 length, bool is_writeable)
-{
- assert(Astart < 0x20000000);
- assert(Aend < 0x20000000);
+ auto peek16 = [](uint32 A) -> uint16 { return *(uint16*)(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] + A); };
+ auto peek32 = [](uint32 A) -> uint32 { return ((uint32)*(uint16*)(SH7095_FastMap[A >> SH7095_EXT_MAP_GRAN_BITS] + A) << 16)
+  | *(uint16*)(SH7095_FastMap[(A|2) >> SH7095_EXT_MAP_GRAN_BITS] + (A|2)); };
 
- if(!ptr)
+ while(i[0] < n[0] || i[1] < n[1])
  {
-  ptr = fmap_dummy;
-  length = sizeof(fmap_dummy);
+  const unsigned c = (i[1] >= n[1] || (i[0] < n[0] && flight_rec[0]->Get(i[0]).cycle <= flight_rec[1]->Get(i[1]).cycle)) ? 0 : 1;
+  const FlightRec::Entry& e = flight_rec[c]->Get(i[c]++);
+  char dis_buf[64];
+
+  SH7095::Disassemble(e.opcode, e.pc + 4, dis_buf, peek16, peek32);
+  fprintf(fp, "%lld %c %08X %04X %s", (long long)e.cycle, c ? 'S' : 'M', e.pc, e.opcode, dis_buf);
+  if(e.access)
+   fprintf(fp, " %c%u@%08X", (e.access & FlightRec::ACCESS_WRITE) ? 'w' : 'r', e.access & 0x7, e.addr);
+  fputc('\n', fp);
+  lines++;
  }
 
- for(uint32 Abase = 0; Abase < 0x40000000; Abase += 0x20000000)
-  SetFastMemMap(Astart + Abase, Aend + Abase, ptr, length, is_writeable);
+ fclose(fp);
+ return lines;
 }
 
-// Automation: read a byte from Saturn address space as the master CPU sees it.
-// Checks the SH-2 cache first (matching the CPU's actual view), then falls back
-// to the backing store (WorkRAMH/WorkRAML/BIOSROM).
-uint8 Automation_ReadMem8(uint32 addr)
+// Recent events: the ring starts empty; CD Block trace lines go to it (as well as to any
+// open CDB trace) until Stop.
+void Automation_RecentEventsStart(void)
 {
- addr &= 0x0FFFFFFF; // Strip mirror bits
+ if(!recent_ev)
+  recent_ev = new RecentEv[RecentEv_Count];
+ recent_ev_total = 0;
+ CDB_SetRecentEvents(true);
+}
 
- // Check master SH-2 cache for cacheable regions (0x00000000-0x07FFFFFF).
- // The SH-2 cache uses bits [28:26] as region, region 0 is cacheable.
- if ((addr >> 26) == 0 && (CPU[0].CCR & SH7095::CCR_CE))
- {
-  uint32 ATM = addr & (0x7FFFF << 10);
-  auto* cent = &CPU[0].Cache[(addr >> 4) & 0x3F];
+void Automation_RecentEventsStop(void)
+{
+ CDB_SetRecentEvents(false);
+ delete[] recent_ev;
+ recent_ev = nullptr;
+}
 
-  for (int way = 0; way < 4; way++) {
-   if (cent->Tag[way] == ATM) {
-    // Cache hit — return the byte from cache data (big-endian)
-    return cent->Data[way][addr & 0x0F];
-   }
-  }
-  // Cache miss — fall through to backing store
- }
+bool Automation_RecentEventsActive(void) { return recent_ev != nullptr; }
 
- if (addr >= 0x06000000 && addr <= 0x060FFFFF) {
-  // WorkRAMH — stored as big-endian uint16 array
-  uint32 off = addr & 0xFFFFF;
-  uint16 w = WorkRAMH[off >> 1];
-  return (off & 1) ? (w & 0xFF) : (w >> 8);
- }
- else if (addr >= 0x00200000 && addr <= 0x002FFFFF) {
-  // WorkRAML
-  uint32 off = addr & 0xFFFFF;
-  uint16 w = WorkRAML[off >> 1];
-  return (off & 1) ? (w & 0xFF) : (w >> 8);
- }
- else if (addr < 0x00080000) {
-  // BIOSROM
-  uint16 w = BIOSROM[addr >> 1];
-  return (addr & 1) ? (w & 0xFF) : (w >> 8);
- }
+void Automation_RecentEvent(int64 cycle, const char* kind, const char* text)
+{
+ if(!recent_ev)
+  return;
 
- else if (addr >= 0x05C00000 && addr <= 0x05C7FFFF) {
-  // VDP1 VRAM (512KB)
-  return VDP1::PeekVRAM(addr - 0x05C00000);
- }
- else if (addr >= 0x05C80000 && addr <= 0x05CFFFFF) {
-  // VDP1 framebuffer (256KB, reads display buffer 0)
-  return VDP1::PeekFB(0, addr - 0x05C80000);
- }
- else if (addr >= 0x05A00000 && addr <= 0x05A7FFFF) {
-  // SCSP sound RAM (512KB)
-  return SOUND_PeekRAM(addr);
- }
- else if (addr >= 0x05E00000 && addr <= 0x05E7FFFF) {
-  // VDP2 VRAM (512KB)
-  return VDP2::PeekVRAM(addr - 0x05E00000);
- }
- else if (addr >= 0x05F00000 && addr <= 0x05F00FFF) {
-  // VDP2 CRAM (4KB)
-  return VDP2::PeekCRAM(addr - 0x05F00000);
- }
+ RecentEv& e = recent_ev[recent_ev_total++ % RecentEv_Count];
 
- return 0xFF; // Unmapped region
+ e.cycle = cycle;
+ e.kind = kind;
+ snprintf(e.text, sizeof(e.text), "%s", text);
 }
 
-void Automation_WriteMem8(uint32 addr, uint8 val)
+// "<cycle> DMA|CDB <details>", oldest first. Returns the lines written, -1 if the file
+// can't be created.
+int64 Automation_RecentEventsDump(const char* path)
 {
- addr &= 0x0FFFFFFF; // Strip mirror bits
+ FILE* fp = fopen(path, "w");
+ const uint64 n = recent_ev ? std::min<uint64>(recent_ev_total, RecentEv_Count) : 0;
 
- if (addr >= 0x06000000 && addr <= 0x060FFFFF) {
-  // WorkRAMH — stored as big-endian uint16 array
-  uint32 off = addr & 0xFFFFF;
-  uint16& w = WorkRAMH[off >> 1];
-  if (off & 1)
-   w = (w & 0xFF00) | val;
-  else
-   w = (w & 0x00FF) | (val << 8);
+ if(!fp)
+  return -1;
 
-  // Invalidate cache line so CPU sees the write
-  uint32 ATM = addr & (0x7FFFF << 10);
-  auto* cent = &CPU[0].Cache[(addr >> 4) & 0x3F];
-  for (int way = 0; way < 4; way++) {
-   if (cent->Tag[way] == ATM) {
-    cent->Data[way][addr & 0x0F] = val;
-   }
-  }
- }
- else if (addr >= 0x00200000 && addr <= 0x002FFFFF) {
-  // WorkRAML
-  uint32 off = addr & 0xFFFFF;
-  uint16& w = WorkRAML[off >> 1];
-  if (off & 1)
-   w = (w & 0xFF00) | val;
-  else
-   w = (w & 0x00FF) | (val << 8);
+ fprintf(fp, "# recent events: <cycle> DMA|CDB <details>, oldest first (%llu of %llu)\n", (unsigned long long)n, (unsigned long long)recent_ev_total);
+ for(uint64 i = recent_ev_total - n; i < recent_ev_total; i++)
+ {
+  const RecentEv& e = recent_ev[i % RecentEv_Count];
+
+  fprintf(fp, "%lld %s %s\n", (long long)e.cycle, e.kind, e.text);
  }
- // Other regions not supported for writes
+
+ fclose(fp);
+ return n;
 }
 
-// Automation: bulk memory read — copies backing store directly for speed.
-// Bypasses SH-2 cache (reads physical memory, not CPU's cached view).
-// For regions stored as big-endian uint16 arrays, converts to byte order.
-void Automation_ReadMemBlock(uint32 addr, uint8* buf, uint32 size)
+uint64 Automation_VBlankInTaken(void)
 {
- addr &= 0x0FFFFFFF;
+ return automation_vbin_taken;
+}
 
- for (uint32 i = 0; i < size; i++) {
-  uint32 a = addr + i;
+// Per-instruction trace: log every CPU instruction between two unified trace events.
+// Triggered by unified trace line count reaching a threshold.
+static int64_t s_unified_line_count = 0;
+static int64_t s_insn_trace_start_line = -1;
+static int64_t s_insn_trace_stop_line = -1;
+static bool s_insn_trace_active = false;
+static TraceRing* s_insn_trace_ring = nullptr;     // separate-file mode (async)
+static TraceRing* s_insn_unified_ring = nullptr;   // unified mode: synchronous view of CallTraceFile
+static bool s_insn_trace_unified = false;  // Write per-insn lines into CallTraceFile
+static bool s_insn_trace_raw = false;      // separate file holds raw records(InsnTraceRaw) instead of text
+
+// insn_trace_window: conditions checked by InsnTraceWindowGate() on the
+// selected CPUs instead of unified line counts.
+enum { TW_OFF = 0, TW_ARMED, TW_OPEN, TW_CLOSED };
+static Automation_InsnTraceWindow s_tw;
+static unsigned s_tw_state = TW_OFF;
+static uint64 s_tw_frame = 0;
+static uint64 s_tw_hits = 0;
+static uint64 s_tw_traced = 0;
+
+static void InsnTraceWindowClear(void)
+{
+ CPU[0].InsnTraceGate = CPU[1].InsnTraceGate = nullptr;
+ s_tw_state = TW_OFF;
+}
 
-  if (a >= 0x06000000 && a <= 0x060FFFFF) {
-   uint32 off = a & 0xFFFFF;
-   uint16 w = WorkRAMH[off >> 1];
-   buf[i] = (off & 1) ? (w & 0xFF) : (w >> 8);
-  }
-  else if (a >= 0x00200000 && a <= 0x002FFFFF) {
-   uint32 off = a & 0xFFFFF;
-   uint16 w = WorkRAML[off >> 1];
-   buf[i] = (off & 1) ? (w & 0xFF) : (w >> 8);
+// Called after every line written to the unified trace file.
+void Automation_UnifiedLineWritten(void)
+{
+ s_unified_line_count++;
+
+ // Start trigger
+ if(s_insn_trace_start_line >= 0 && s_unified_line_count >= s_insn_trace_start_line && !s_insn_trace_active)
+ {
+  s_insn_trace_active = true;
+  if(s_insn_trace_unified && unified_bin)
+  {
+   char note[96];
+   snprintf(note, sizeof(note), "# INSN TRACE START after unified line %lld", (long long)s_unified_line_count);
+   UnifiedBinNote(note);
+   CPU[0].InsnTraceBin = unified_bin;
+   CPU[1].InsnTraceBin = unified_bin;
   }
-  else if (a >= 0x05C00000 && a <= 0x05C7FFFF) {
-   buf[i] = VDP1::PeekVRAM(a - 0x05C00000);
+  else if(s_insn_trace_unified && CPU[0].CallTraceFile)
+  {
+   // Unified mode: point InsnTrace at CallTraceFile so per-instruction
+   // lines are interleaved directly into the unified trace.
+   // The unified file is still written with stdio by the call/CDB tracers,
+   // so the ring is synchronous to keep line order.
+   delete s_insn_unified_ring;
+   s_insn_unified_ring = new TraceRing(CPU[0].CallTraceFile, false);
+   CPU[0].InsnTrace = s_insn_unified_ring;
+   CPU[1].InsnTrace = s_insn_unified_ring;
+   fprintf(CPU[0].CallTraceFile, "# INSN TRACE START after unified line %lld\n", (long long)s_unified_line_count);
   }
-  else if (a >= 0x05E00000 && a <= 0x05E7FFFF) {
-   buf[i] = VDP2::PeekVRAM(a - 0x05E00000);
+  else if(s_insn_trace_raw)
+  {
+   CPU[0].InsnTraceRaw = s_insn_trace_ring;
+   CPU[1].InsnTraceRaw = s_insn_trace_ring;
   }
-  else if (a >= 0x05F00000 && a <= 0x05F00FFF) {
-   buf[i] = VDP2::PeekCRAM(a - 0x05F00000);
+  else
+  {
+   CPU[0].InsnTrace = s_insn_trace_ring;
+   CPU[1].InsnTrace = s_insn_trace_ring;
+   if(s_insn_trace_ring)
+    s_insn_trace_ring->Printf("# INSN TRACE START after unified line %lld\n", (long long)s_unified_line_count);
   }
-  else if (a >= 0x05A00000 && a <= 0x05A7FFFF) {
-   buf[i] = SOUND_PeekRAM(a);
+ }
+
+ // Stop trigger
+ if(s_insn_trace_active && s_insn_trace_stop_line >= 0 && s_unified_line_count >= s_insn_trace_stop_line)
+ {
+  if(s_insn_trace_unified && unified_bin)
+  {
+   char note[96];
+   snprintf(note, sizeof(note), "# INSN TRACE STOP at unified line %lld", (long long)s_unified_line_count);
+   UnifiedBinNote(note);
   }
-  else if (a < 0x00080000) {
-   uint16 w = BIOSROM[a >> 1];
-   buf[i] = (a & 1) ? (w & 0xFF) : (w >> 8);
+  else if(s_insn_trace_unified && CPU[0].CallTraceFile)
+  {
+   fprintf(CPU[0].CallTraceFile, "# INSN TRACE STOP at unified line %lld\n", (long long)s_unified_line_count);
+   fflush(CPU[0].CallTraceFile);
   }
-  else {
-   buf[i] = 0xFF;
+  else if(s_insn_trace_ring)
+  {
+   if(!s_insn_trace_raw)
+    s_insn_trace_ring->Printf("# INSN TRACE STOP at unified line %lld\n", (long long)s_unified_line_count);
+   s_insn_trace_ring->Flush();
   }
+  s_insn_trace_active = false;
+  s_insn_trace_start_line = -1;  // Prevent re-trigger after stop
+  CPU[0].InsnTrace = nullptr;
+  CPU[1].InsnTrace = nullptr;
+  CPU[0].InsnTraceRaw = nullptr;
+  CPU[1].InsnTraceRaw = nullptr;
+  CPU[0].InsnTraceBin = nullptr;
+  CPU[1].InsnTraceBin = nullptr;
+  delete s_insn_unified_ring;
+  s_insn_unified_ring = nullptr;
  }
 }
 
-// Automation: get current master CPU PC (the real register, not the debug pipeline PC).
-uint32 Automation_GetMasterPC(void)
+// raw: "MDFNITR1", then per instruction le64 master cycle, le32 PC, le16
+// opcode, u8 flags(bit 0: slave, bit 1: literal follows), u8 0, and for
+// PC-relative MOV.W/MOV.L the le32 literal they load. Automation_InsnTraceDisasm()
+// turns it into text.
+void Automation_EnableInsnTrace(const char* path, int64_t start_line, int64_t stop_line, bool raw)
 {
- return CPU[0].PC;
+ InsnTraceWindowClear();
+ CPU[0].InsnTrace = nullptr;
+ CPU[1].InsnTrace = nullptr;
+ CPU[0].InsnTraceRaw = nullptr;
+ CPU[1].InsnTraceRaw = nullptr;
+ delete s_insn_trace_ring; s_insn_trace_ring = nullptr;
+ delete s_insn_unified_ring; s_insn_unified_ring = nullptr;
+ s_insn_trace_unified = false;
+ s_insn_trace_raw = raw;
+ if(FILE* f = fopen(path, raw ? "wb" : "w"))
+ {
+  if(raw)
+   fwrite("MDFNITR1", 1, 8, f);
+  s_insn_trace_ring = new TraceRing(f);
+ }
+ s_insn_trace_start_line = start_line;
+ s_insn_trace_stop_line = stop_line;
+ s_insn_trace_active = false;
+ // Start at 2 to account for the 2-line header in the unified trace file.
+ // This way the counter matches the file line number exactly.
+ s_unified_line_count = 2;
+ if(s_insn_trace_ring && !raw)
+ {
+  s_insn_trace_ring->Printf("# Per-instruction trace, lines %lld to %lld\n", (long long)start_line, (long long)stop_line);
+  s_insn_trace_ring->Printf("# Format: timestamp M/S PC opcode\n");
+ }
 }
 
-// Automation: get/set master CPU SR (for interrupt mask level checks).
-uint32 Automation_GetMasterSR(void)
+void Automation_EnableInsnTraceUnified(int64_t start_line, int64_t stop_line)
 {
- return CPU[0].GetRegister(SH7095::GSREG_SR, nullptr, 0);
+ // Like EnableInsnTrace but writes per-instruction lines directly into the
+ // unified trace (CallTraceFile) instead of a separate file.
+ InsnTraceWindowClear();
+ CPU[0].InsnTrace = nullptr;
+ CPU[1].InsnTrace = nullptr;
+ CPU[0].InsnTraceRaw = nullptr;
+ CPU[1].InsnTraceRaw = nullptr;
+ delete s_insn_trace_ring; s_insn_trace_ring = nullptr;
+ delete s_insn_unified_ring; s_insn_unified_ring = nullptr;
+ s_insn_trace_unified = true;
+ s_insn_trace_raw = false;
+ s_insn_trace_start_line = start_line;
+ s_insn_trace_stop_line = stop_line;
+ s_insn_trace_active = false;
+ s_unified_line_count = 2;
 }
 
-void Automation_SetMasterSR(uint32 val)
+static void InsnTraceWindowNote(const char* what, unsigned which, uint32 pc, int64 cycle)
 {
- CPU[0].SetRegister(SH7095::GSREG_SR, val);
+ if(!s_insn_trace_raw)
+  s_insn_trace_ring->Printf("# INSN TRACE %s frame=%llu cycle=%lld cpu=%c pc=0x%08X\n", what, (unsigned long long)s_tw_frame, (long long)cycle, which ? 'S' : 'M', pc);
 }
 
-// Automation: get absolute master cycle count (survives frame-boundary adjustments).
-int64_t Automation_GetMasterCycle(void)
+static void InsnTraceWindowGate(unsigned which, uint32 pc)
 {
- return automation_total_cycles + CPU[0].timestamp;
+ const int64 cycle = automation_total_cycles + CPU[which].timestamp;
+
+ if(s_tw_state == TW_ARMED)
+ {
+  if((int64)s_tw_frame < s_tw.frame_lo || cycle < s_tw.cycle_lo)
+   return;
+
+  if(s_tw.enter_hi && (pc < s_tw.enter_lo || pc >= s_tw.enter_hi))
+   return;
+
+  if(s_tw.after_n && (pc != s_tw.after_pc || ++s_tw_hits < s_tw.after_n))
+   return;
+
+  InsnTraceWindowNote("START", which, pc, cycle);
+  for(unsigned c = 0; c < 2; c++)
+  {
+   if(s_tw.cpu_mask & (1U << c))
+    (s_insn_trace_raw ? CPU[c].InsnTraceRaw : CPU[c].InsnTrace) = s_insn_trace_ring;
+  }
+  s_tw_state = TW_OPEN;
+  s_insn_trace_active = true;
+ }
+
+ if((s_tw.frame_hi >= 0 && (int64)s_tw_frame > s_tw.frame_hi) || (s_tw.cycle_hi >= 0 && cycle >= s_tw.cycle_hi) || (s_tw.count && s_tw_traced >= s_tw.count))
+ {
+  InsnTraceWindowNote("STOP", which, pc, cycle);
+  s_insn_trace_ring->Flush();
+  CPU[0].InsnTrace = CPU[1].InsnTrace = nullptr;
+  CPU[0].InsnTraceRaw = CPU[1].InsnTraceRaw = nullptr;
+  CPU[0].InsnTraceGate = CPU[1].InsnTraceGate = nullptr;
+  s_tw_state = TW_CLOSED;
+  s_insn_trace_active = false;
+  return;
+ }
+ s_tw_traced++;
 }
 
-// Automation: dump master SH-2 CPU registers as a formatted string.
-std::string Automation_DumpRegs(void)
+// The same output as Automation_EnableInsnTrace()(text or raw), but the window
+// is opened and closed by InsnTraceWindowGate(), run before every instruction
+// of a cpu_mask CPU until it closes. frame is the current frame number;
+// Automation_InsnTraceWindowFrame() keeps it current.
+bool Automation_EnableInsnTraceWindow(const char* path, const Automation_InsnTraceWindow& w, bool raw, uint64 frame)
 {
- std::string s = "regs";
- char buf[64];
+ Automation_DisableInsnTrace();
+ if(!(w.cpu_mask & 3))
+  return false;
 
- for (int i = 0; i < 16; i++) {
-  snprintf(buf, sizeof(buf), " R%d=%08X", i, CPU[0].R[i]);
-  s += buf;
- }
+ FILE* f = fopen(path, raw ? "wb" : "w");
 
- snprintf(buf, sizeof(buf), " PC=%08X", CPU[0].PC); s += buf;
- snprintf(buf, sizeof(buf), " SR=%08X", CPU[0].SR); s += buf;
- snprintf(buf, sizeof(buf), " PR=%08X", CPU[0].PR); s += buf;
- snprintf(buf, sizeof(buf), " GBR=%08X", CPU[0].GBR); s += buf;
- snprintf(buf, sizeof(buf), " VBR=%08X", CPU[0].VBR); s += buf;
- snprintf(buf, sizeof(buf), " MACH=%08X", CPU[0].MACH); s += buf;
- snprintf(buf, sizeof(buf), " MACL=%08X", CPU[0].MACL); s += buf;
+ if(!f)
+  return false;
 
- return s;
+ if(raw)
+  fwrite("MDFNITR1", 1, 8, f);
+ s_insn_trace_ring = new TraceRing(f);
+ s_insn_trace_raw = raw;
+ s_insn_trace_unified = false;
+ s_tw = w;
+ s_tw_frame = frame;
+ s_tw_hits = 0;
+ s_tw_traced = 0;
+ s_tw_state = TW_ARMED;
+ for(unsigned c = 0; c < 2; c++)
+  CPU[c].InsnTraceGate = (w.cpu_mask & (1U << c)) ? InsnTraceWindowGate : nullptr;
+
+ if(!raw)
+ {
+  s_insn_trace_ring->Printf("# Per-instruction trace, window cpu=%s frames=%lld-%lld cycles=%lld-%lld enter=0x%08X-0x%08X after=0x%08X:%llu count=%llu\n",
+   (w.cpu_mask == 3) ? "both" : (w.cpu_mask == 1) ? "master" : "slave", (long long)w.frame_lo, (long long)w.frame_hi,
+   (long long)w.cycle_lo, (long long)w.cycle_hi, w.enter_lo, w.enter_hi, w.after_pc, (unsigned long long)w.after_n, (unsigned long long)w.count);
+  s_insn_trace_ring->Printf("# Format: timestamp M/S PC opcode\n");
+ }
+ return true;
 }
 
-// Automation: dump master SH-2 CPU registers to a binary file.
-// Format: 22 x uint32 native-endian: R0-R15, PC, SR, PR, GBR, VBR, MACH
-void Automation_DumpRegsBin(const char* path)
+void Automation_InsnTraceWindowFrame(uint64 frame)
 {
- uint32 regs[22];
- for (int i = 0; i < 16; i++)
-  regs[i] = CPU[0].R[i];
- regs[16] = CPU[0].PC;
- regs[17] = CPU[0].SR;
- regs[18] = CPU[0].PR;
- regs[19] = CPU[0].GBR;
- regs[20] = CPU[0].VBR;
- regs[21] = CPU[0].MACH;
+ s_tw_frame = frame;
+}
 
- FILE* f = fopen(path, "wb");
- if (f) {
-  fwrite(regs, 4, 22, f);
-  fclose(f);
- }
+const char* Automation_InsnTraceWindowState(uint64* traced)
+{
+ static const char* const names[] = { "off", "armed", "open", "closed" };
+
+ *traced = s_tw_traced;
+ return names[s_tw_state];
 }
 
-// Automation: shadow call stack — reads the per-CPU stack maintained by
-// jsr/bsr/bsrf/rts instrumentation. Self-healing via PR matching on rts.
-std::string Automation_CallStack(uint32 /*scan_size*/)
+uint64 Automation_DisableInsnTrace(void)
 {
- // Use automation_current_cpu if valid (0 or 1), default to master
- unsigned cpu = (automation_current_cpu < 2) ? automation_current_cpu : 0;
- uint32 pc = CPU[cpu].PC;
- uint32 pr = CPU[cpu].PR;
- uint32 sp = CPU[cpu].R[15];
+ uint64 dropped = 0;
+ InsnTraceWindowClear();
+ s_insn_trace_active = false;
+ CPU[0].InsnTrace = nullptr;
+ CPU[1].InsnTrace = nullptr;
+ CPU[0].InsnTraceBin = nullptr;
+ CPU[1].InsnTraceBin = nullptr;
+ CPU[0].InsnTraceRaw = nullptr;
+ CPU[1].InsnTraceRaw = nullptr;
+ if(s_insn_trace_ring) { dropped = s_insn_trace_ring->Dropped(); delete s_insn_trace_ring; s_insn_trace_ring = nullptr; }
+ delete s_insn_unified_ring; s_insn_unified_ring = nullptr;
+ s_insn_trace_start_line = -1;
+ s_insn_trace_stop_line = -1;
+ return dropped;
+}
 
- std::string s = "call_stack";
- char buf[128];
+// Text for a window of a raw insn_trace file: records first..first+count-1
+// (count 0 = to the end), one "<cycle> M|S <pc> <opcode> <mnemonic>" line
+// each, as the flight recorder dump prints them. Returns the lines written,
+// -1 if a file can't be opened or the input isn't a raw trace.
+static uint32 s_disasm_literal;
 
- snprintf(buf, sizeof(buf), " cpu=%s PC=0x%08X SP=0x%08X PR=0x%08X",
-  cpu ? "slave" : "master", pc, sp, pr);
- s += buf;
+int64 Automation_InsnTraceDisasm(const char* in_path, const char* out_path, uint64 first, uint64 count)
+{
+ FILE* in = fopen(in_path, "rb");
+ char magic[8];
 
- // Shadow call stack (tracked via jsr/bsr/bsrf/rts instrumentation)
- unsigned depth = shadow_stack_depth[cpu];
- if(depth > 0)
+ if(!in)
+  return -1;
+
+ if(fread(magic, 1, 8, in) != 8 || memcmp(magic, "MDFNITR1", 8))
  {
-  for(int i = (int)depth - 1; i >= 0; i--)
-  {
-   const ShadowCallEntry& e = shadow_stack[cpu][i];
-   snprintf(buf, sizeof(buf), " | 0x%08X->0x%08X ret=0x%08X",
-    e.call_site, e.target, e.return_addr);
-   s += buf;
-  }
+  fclose(in);
+  return -1;
  }
 
- snprintf(buf, sizeof(buf), " | depth=%u", depth);
- s += buf;
+ FILE* out = fopen(out_path, "w");
 
- return s;
-}
+ if(!out)
+ {
+  fclose(in);
+  return -1;
+ }
 
-// Automation: dump slave SH-2 CPU registers as a formatted string.
-std::string Automation_DumpSlaveRegs(void)
-{
- std::string s = "regs_slave";
- char buf[64];
+ auto peek16 = [](uint32 A) -> uint16 { return s_disasm_literal; };
+ auto peek32 = [](uint32 A) -> uint32 { return s_disasm_literal; };
+ uint8 rec[20];
+ uint64 index = 0;
+ int64 lines = 0;
 
- for (int i = 0; i < 16; i++) {
-  snprintf(buf, sizeof(buf), " R%d=%08X", i, CPU[1].R[i]);
-  s += buf;
- }
+ while((!count || index < first + count) && fread(rec, 1, 16, in) == 16)
+ {
+  const bool lit = rec[14] & 0x02;
 
- snprintf(buf, sizeof(buf), " PC=%08X", CPU[1].PC); s += buf;
- snprintf(buf, sizeof(buf), " SR=%08X", CPU[1].SR); s += buf;
- snprintf(buf, sizeof(buf), " PR=%08X", CPU[1].PR); s += buf;
- snprintf(buf, sizeof(buf), " GBR=%08X", CPU[1].GBR); s += buf;
- snprintf(buf, sizeof(buf), " VBR=%08X", CPU[1].VBR); s += buf;
- snprintf(buf, sizeof(buf), " MACH=%08X", CPU[1].MACH); s += buf;
- snprintf(buf, sizeof(buf), " MACL=%08X", CPU[1].MACL); s += buf;
+  if(lit && fread(&rec[16], 1, 4, in) != 4)
+   break;
 
- return s;
-}
+  if(index++ < first)
+   continue;
 
-// Automation: dump slave SH-2 CPU registers to a binary file.
-void Automation_DumpSlaveRegsBin(const char* path)
-{
- uint32 regs[22];
- for (int i = 0; i < 16; i++)
-  regs[i] = CPU[1].R[i];
- regs[16] = CPU[1].PC;
- regs[17] = CPU[1].SR;
- regs[18] = CPU[1].PR;
- regs[19] = CPU[1].GBR;
- regs[20] = CPU[1].VBR;
- regs[21] = CPU[1].MACH;
+  const uint16 op = MDFN_de16lsb(&rec[12]);
+  const uint32 pc = MDFN_de32lsb(&rec[8]);
+  char dis_buf[64];
 
- FILE* f = fopen(path, "wb");
- if (f) {
-  fwrite(regs, 4, 22, f);
-  fclose(f);
+  s_disasm_literal = lit ? MDFN_de32lsb(&rec[16]) : 0;
+  SH7095::Disassemble(op, pc + 4, dis_buf, peek16, peek32);
+  fprintf(out, "%llu %c %08X %04X %s", (unsigned long long)MDFN_de64lsb(&rec[0]), (rec[14] & 0x01) ? 'S' : 'M', pc, op, dis_buf);
+  if(!automation_symbols.empty())
+  {
+   const std::string sym = Automation_SymbolFormat(pc);
+
+   if(!sym.empty())
+    fprintf(out, " <%s>", sym.c_str());
+  }
+  fputc('\n', out);
+  lines++;
  }
+
+ fclose(out);
+ fclose(in);
+ return lines;
 }
 
-// Automation: dump VDP2 internal register state to binary file.
-void Automation_DumpVDP2RegsBin(const char* path)
+// Automation: enable deterministic mode.
+// Bridge: called from SH-2 Exception() macro (inside MDFN_IEN_SS namespace),
+// forwards to the global ::Automation_ExceptionHit() in automation.cpp.
+void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32 pc, uint32 sr, uint32 r15, uint32 pr, uint32 vbr, uint32 handler_pc)
 {
- VDP2::DumpRawRegsBin(path);
+ ::Automation_ExceptionHit(exnum, vecnum, pc, sr, r15, pr, vbr, handler_pc);
 }
 
-// Automation: passive inline hook callback.
-// Called from RunLoop_INLINE BEFORE CPU[0].Step() on every master CPU instruction.
-// At this point, CPU[0].PC is the address of the instruction about to execute.
-// Does NOT go through DebugMode/DBG_CPUHandler/ForceEventUpdates -- zero
-// timing side effects. Observation is completely invisible to the emulated Saturn.
-static void Automation_InlineHookCallback(void)
+// Resets all non-deterministic emulator state to fixed values so that
+// identical inputs always produce identical traces.
+// Currently handles: SMPC RTC (host wall-clock seeding).
+void Automation_SetDeterministic(void)
 {
- uint32 pc = Automation_GetMasterPC();
- ::Automation_DebugHook(pc);
+ // Reset RTC to a fixed time (2000-01-01 00:00:00, Saturday).
+ // This overrides the Time::LocalTime() value set during init.
+ struct tm fixed_time = {};
+ fixed_time.tm_year = 100; // 2000
+ fixed_time.tm_mon  = 0;   // January
+ fixed_time.tm_mday = 1;
+ fixed_time.tm_hour = 0;
+ fixed_time.tm_min  = 0;
+ fixed_time.tm_sec  = 0;
+ fixed_time.tm_wday = 6;   // Saturday
+ SMPC_SetRTC(&fixed_time, 1); // lang=1 (English)
 }
 
-void Automation_EnableCPUHook(void)
+void Automation_SetSMPCPollHook(uint32 (*hook)(unsigned index))
 {
- s_automation_inline_hook = Automation_InlineHookCallback;
+ SMPC_SetPollHook(hook);
 }
 
-void Automation_DisableCPUHook(void)
+unsigned Automation_GetSMPCPollIndex(void)
 {
- s_automation_inline_hook = nullptr;
+ return SMPC_GetPollIndex();
 }
 
-void Automation_SetWatchpoint(uint32 addr)
+#include "sh7095.inc"
+
+//
+// Opcode histogram(op_stats). The SH-2 cores count executions per decoded handler(the
+// InstrDecodeTab index the Step() switch dispatches on, bit 7 set in a delay slot) and
+// conditional branch outcomes; everything else is derived per handler when counting starts,
+// from a representative instruction's disassembly: its name, whether it is an unconditional
+// branch, MAC/DIV/MUL, and the memory accesses it makes by size.
+//
+// Optional per-frame file: "MDFNOPS1", le32 256, 256 x 32-byte NUL-padded handler names,
+// then every N frames le64 frame and for the master and the slave le64 x (OPSUM__COUNT +
+// 256): OPSUM_* totals then handler counts, all deltas since the previous record.
+//
+enum
+{
+ OPSUM_INSNS = 0,
+ OPSUM_DELAY_SLOT,
+ OPSUM_COND_TAKEN,
+ OPSUM_COND_UNTAKEN,
+ OPSUM_BRANCH,		// unconditional: BRA BRAF BSR BSRF JMP JSR RTS RTE
+ OPSUM_MAC,
+ OPSUM_DIV,
+ OPSUM_MUL,
+ OPSUM_READ8,
+ OPSUM_READ16,
+ OPSUM_READ32,
+ OPSUM_WRITE8,
+ OPSUM_WRITE16,
+ OPSUM_WRITE32,
+
+ OPSUM__COUNT
+};
+
+static const char* const opstats_sum_names[OPSUM__COUNT] =
+{
+ "insns", "delay_slot", "cond_taken", "cond_untaken", "branch", "mac", "div", "mul",
+ "read8", "read16", "read32", "write8", "write16", "write32"
+};
+
+struct OpStatsClass
+{
+ char name[32];
+ uint8 sum;		// OPSUM_BRANCH/MAC/DIV/MUL, or 0
+ uint8 reads[3];	// per execution, by size 1/2/4
+ uint8 writes[3];
+};
+
+static SH7095::OpStatsCounters opstats_count[2];
+static SH7095::OpStatsCounters opstats_prev[2];	// at the last per-frame record
+static OpStatsClass opstats_class[256];
+static TraceRing* opstats_ring = nullptr;
+static unsigned opstats_every = 1;
+static unsigned opstats_frames = 0;
+static uint64 opstats_records = 0;
+
+// "MOV.W   @(0x01e,PC),R3 ! 0x1234" -> "MOV.W @(disp,PC),Rn"
+static void OpStats_Shape(const char* dis, char* out, size_t out_size)
 {
- uint32 masked = addr & 0x0FFFFFFF;
- automation_wp_full_addr = addr;
- automation_wp_addr = masked & 0xFFFFF;
- automation_wp_is_lwr = (masked >= 0x00200000 && masked <= 0x003FFFFF);
- automation_wp_active = true;
- automation_wp_filter_active = false;
- automation_wp_filter_value = 0;
+ size_t o = 0;
+ bool space = false;
+
+ auto put = [&](const char* s) { while(*s && o + 1 < out_size) out[o++] = *s++; };
+
+ for(const char* p = dis; *p && *p != '!'; p++)
+ {
+  if(*p == ' ')
+  {
+   space = true;
+   continue;
+  }
+
+  if(space && o)
+   put(" ");
+  space = false;
+
+  if(*p == 'R' && p[1] >= '0' && p[1] <= '9')
+  {
+   put("Rn");
+   while(p[1] >= '0' && p[1] <= '9')
+    p++;
+  }
+  else if(*p == '#')
+  {
+   put("#imm");
+   while(p[1] && p[1] != ',' && p[1] != ' ')
+    p++;
+  }
+  else if(*p == '0' && p[1] == 'x')
+  {
+   put("disp");
+   p++;
+   while(isxdigit((unsigned char)p[1]))
+    p++;
+  }
+  else
+  {
+   const char c[2] = { *p, 0 };
+   put(c);
+  }
+ }
+ out[o] = 0;
 }
 
-void Automation_ClearWatchpoint(void)
-{
- automation_wp_active = false;
- automation_wp_is_lwr = false;
- automation_wp_filter_active = false;
- automation_wp_filter_value = 0;
+static void OpStats_Classify(void)
+{
+ static const uint8 slot_illegal[] = { 0x80, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xF6, 0xFD };	// sh7095_opdefs.inc OP_SLOT_ILLEGAL
+ auto peek16 = [](uint32 A) -> uint16 { return 0; };
+ auto peek32 = [](uint32 A) -> uint32 { return 0; };
+ bool seen[0x80] = { };
+
+ memset(opstats_class, 0, sizeof(opstats_class));
+
+ for(unsigned op = 0; op < 65536; op++)
+ {
+  const unsigned h = InstrDecodeTab[op] & 0x7F;
+  OpStatsClass& c = opstats_class[h];
+  char dis[64];
+
+  if(seen[h])
+   continue;
+  seen[h] = true;
+
+  if(!h)
+  {
+   strcpy(c.name, "(illegal)");
+   continue;
+  }
+
+  SH7095::Disassemble(op, 0, dis, peek16, peek32);
+  OpStats_Shape(dis, c.name, sizeof(c.name));
+
+  const char* const mn = c.name;
+  const char* const dot = strchr(mn, '.');
+  const char* const sp = strchr(mn, ' ');
+  const unsigned size_i = (dot && (!sp || dot < sp)) ? ((dot[1] == 'B') ? 0 : (dot[1] == 'W') ? 1 : (dot[1] == 'L') ? 2 : 3) : 3;
+  auto is = [&](const char* m) { const size_t n = strlen(m); return !strncmp(mn, m, n) && (mn[n] == ' ' || mn[n] == '.' || !mn[n]); };
+
+  if(is("BRA") || is("BRAF") || is("BSR") || is("BSRF") || is("JMP") || is("JSR") || is("RTS") || is("RTE"))
+   c.sum = OPSUM_BRANCH;
+  else if(is("MAC"))
+   c.sum = OPSUM_MAC;
+  else if(is("DIV0S") || is("DIV0U") || is("DIV1"))
+   c.sum = OPSUM_DIV;
+  else if(is("MUL") || is("MULS") || is("MULU") || is("DMULS") || is("DMULU"))
+   c.sum = OPSUM_MUL;
+
+  if(is("RTE"))
+   c.reads[2] = 2;	// PC, SR
+  else if(is("TRAPA"))
+  {
+   c.writes[2] = 2;	// SR, PC
+   c.reads[2] = 1;	// vector
+  }
+  else if(size_i < 3 && sp && strchr(sp, '@'))
+  {
+   const char* const comma = strchr(sp, ',');
+   // Operands split at the first comma outside @(...)
+   const char* split = sp;
+   int depth = 0;
+
+   for(; *split; split++)
+   {
+    if(*split == '(')
+     depth++;
+    else if(*split == ')')
+     depth--;
+    else if(*split == ',' && !depth)
+     break;
+   }
+
+   if(is("MAC"))
+    c.reads[size_i] = 2;
+   else if(is("TAS") || ((is("AND") || is("OR") || is("XOR")) && comma))
+   {
+    c.reads[size_i] = 1;
+    c.writes[size_i] = 1;
+   }
+   else if(is("TST"))
+    c.reads[size_i] = 1;
+   else
+   {
+    if(std::find(sp, split, '@') != split)
+     c.reads[size_i]++;
+    if(*split && strchr(split, '@'))
+     c.writes[size_i]++;
+   }
+  }
+ }
+
+ for(unsigned h = 0x80; h < 0x100; h++)
+ {
+  OpStatsClass& c = opstats_class[h];
+
+  c = opstats_class[h & 0x7F];
+  if(std::find(std::begin(slot_illegal), std::end(slot_illegal), h) != std::end(slot_illegal))
+  {
+   snprintf(c.name, sizeof(c.name), "(slot illegal)");
+   c.sum = 0;
+   memset(c.reads, 0, sizeof(c.reads));
+   memset(c.writes, 0, sizeof(c.writes));
+  }
+  else
+  {
+   const size_t n = std::min<size_t>(strlen(c.name), sizeof(c.name) - 6);
+   memcpy(c.name + n, " [ds]", 6);
+  }
+ }
+
+ strcpy(opstats_class[0x7E].name, "(standby)");
+ strcpy(opstats_class[0x7F].name, "(exception)");
+ strcpy(opstats_class[0xFE].name, "(dma burst)");
+ strcpy(opstats_class[0xFF].name, "(exception)");
 }
 
-void Automation_SetWatchpointFilter(bool active, uint32 value)
+static void OpStats_Sums(const SH7095::OpStatsCounters& c, uint64* sums)
 {
- automation_wp_filter_active = active;
- automation_wp_filter_value = value;
-}
+ memset(sums, 0, sizeof(uint64) * OPSUM__COUNT);
+ for(unsigned h = 0; h < 256; h++)
+ {
+  const OpStatsClass& k = opstats_class[h];
+  const uint64 n = c.handler[h];
 
-void Automation_SetReadWatchpoint(uint32 addr)
-{
- uint32 masked = addr & 0x0FFFFFFF;
- automation_rwp_addr = masked & 0xFFFFF;
- automation_rwp_is_lwr = (masked >= 0x00200000 && masked <= 0x003FFFFF);
- automation_rwp_active = true;
-}
+  if(!n)
+   continue;
 
-void Automation_ClearReadWatchpoint(void)
-{
- automation_rwp_active = false;
- automation_rwp_is_lwr = false;
+  sums[OPSUM_INSNS] += n;
+  if(h & 0x80)
+   sums[OPSUM_DELAY_SLOT] += n;
+  if(k.sum)
+   sums[k.sum] += n;
+  for(unsigned s = 0; s < 3; s++)
+  {
+   sums[OPSUM_READ8 + s] += n * k.reads[s];
+   sums[OPSUM_WRITE8 + s] += n * k.writes[s];
+  }
+ }
+ // Pseudo-handlers aren't instructions.
+ sums[OPSUM_INSNS] -= c.handler[0x7E] + c.handler[0x7F] + c.handler[0xFE] + c.handler[0xFF];
+ sums[OPSUM_DELAY_SLOT] -= c.handler[0xFE] + c.handler[0xFF];
+ sums[OPSUM_COND_TAKEN] = c.cond_taken;
+ sums[OPSUM_COND_UNTAKEN] = c.cond_untaken;
 }
 
-bool Automation_CheckReadWatchpointActive(void)
+static void OpStats_Record(uint64 frame)
 {
- return automation_rwp_active;
-}
+ uint8 buf[8 + 2 * 8 * (OPSUM__COUNT + 256)];
+ uint8* p = buf + 8;
 
-bool Automation_CheckWatchpointActive(void)
-{
- return automation_wp_active;
+ MDFN_en64lsb(buf, frame);
+ for(unsigned cpu = 0; cpu < 2; cpu++)
+ {
+  SH7095::OpStatsCounters d;
+  uint64 sums[OPSUM__COUNT];
+
+  for(unsigned h = 0; h < 256; h++)
+   d.handler[h] = opstats_count[cpu].handler[h] - opstats_prev[cpu].handler[h];
+  d.cond_taken = opstats_count[cpu].cond_taken - opstats_prev[cpu].cond_taken;
+  d.cond_untaken = opstats_count[cpu].cond_untaken - opstats_prev[cpu].cond_untaken;
+  OpStats_Sums(d, sums);
+
+  for(unsigned i = 0; i < OPSUM__COUNT; i++, p += 8)
+   MDFN_en64lsb(p, sums[i]);
+  for(unsigned h = 0; h < 256; h++, p += 8)
+   MDFN_en64lsb(p, d.handler[h]);
+ }
+ opstats_ring->Write(buf, sizeof(buf));
+ memcpy(opstats_prev, opstats_count, sizeof(opstats_prev));
+ opstats_records++;
+ opstats_frames = 0;
 }
 
-void Automation_SetVDP2Watchpoint(uint32 lo, uint32 hi, const char* logpath)
+uint64 Automation_OpStatsStop(uint64 frame, uint64* records)
 {
- automation_vdp2wp_lo = lo;
- automation_vdp2wp_hi = hi;
- if(automation_vdp2wp_log) { fclose(automation_vdp2wp_log); automation_vdp2wp_log = nullptr; }
- automation_vdp2wp_log = fopen(logpath, "w");
- if(automation_vdp2wp_log) fprintf(automation_vdp2wp_log, "# VDP2 VRAM write watchpoint: 0x%08X-0x%08X\n", lo, hi);
- automation_vdp2wp_active = true;
-}
+ uint64 dropped = 0;
 
-void Automation_ClearVDP2Watchpoint(void)
-{
- automation_vdp2wp_active = false;
- if(automation_vdp2wp_log) { fclose(automation_vdp2wp_log); automation_vdp2wp_log = nullptr; }
+ if(opstats_ring)
+ {
+  if(opstats_frames)
+   OpStats_Record(frame);
+  dropped = opstats_ring->Dropped();
+  delete opstats_ring;	// drains the ring
+  opstats_ring = nullptr;
+ }
+ if(records)
+  *records = opstats_records;
+ opstats_records = 0;
+ opstats_active = false;
+ CPU[0].OpStats = CPU[1].OpStats = nullptr;
+ return dropped;
 }
 
-// CDL (Code/Data Logging) — configurable address range
-void Automation_CDLStart(uint32 lo, uint32 hi)
+// cpu_mask bit 0 master, bit 1 slave. path may be null(no per-frame file). Counting needs the
+// DebugMode run loops, which only exist in WANT_DEBUGGER builds.
+bool Automation_OpStatsStart(unsigned cpu_mask, const char* path, unsigned every)
 {
- uint32 masked_lo = lo & 0x0FFFFFFF;
- uint32 masked_hi = hi & 0x0FFFFFFF;
-
- // Validate range
- if(masked_hi <= masked_lo || (masked_hi - masked_lo) > 16 * 1024 * 1024) {
-  cdl_active = false;
-  return;
- }
+#ifdef WANT_DEBUGGER
+ Automation_OpStatsStop(0, nullptr);
+ OpStats_Classify();
+ memset(opstats_count, 0, sizeof(opstats_count));
+ memset(opstats_prev, 0, sizeof(opstats_prev));
 
- // Free previous bitmap if range changed
- if(cdl_bitmap && (masked_lo != cdl_lo || masked_hi != cdl_hi)) {
-  delete[] cdl_bitmap;
-  cdl_bitmap = nullptr;
- }
+ if(path)
+ {
+  FILE* f = fopen(path, "wb");
+  uint8 header[12];
 
- cdl_lo = masked_lo;
- cdl_hi = masked_hi;
- cdl_size = cdl_hi - cdl_lo;
+  if(!f)
+   return false;
 
- if(!cdl_bitmap) {
-  cdl_bitmap = new(std::nothrow) uint8[cdl_size]();
-  if(!cdl_bitmap) {
-   cdl_active = false;
-   cdl_size = 0;
-   return;
-  }
- } else {
-  memset(cdl_bitmap, 0, cdl_size);
+  memcpy(header, "MDFNOPS1", 8);
+  MDFN_en32lsb(&header[8], 256);
+  fwrite(header, 1, sizeof(header), f);
+  for(const OpStatsClass& c : opstats_class)
+   fwrite(c.name, 1, sizeof(c.name), f);
+  opstats_ring = new TraceRing(f);
  }
-
- cdl_active = true;
+ opstats_every = std::max<unsigned>(1, every);
+ opstats_frames = 0;
+ for(unsigned c = 0; c < 2; c++)
+  CPU[c].OpStats = (cpu_mask & (1U << c)) ? &opstats_count[c] : nullptr;
+ opstats_active = true;
+ return true;
+#else
+ return false;
+#endif
 }
 
-void Automation_CDLStop(void)
+void Automation_OpStatsFrame(uint64 frame)
 {
- cdl_active = false;
+ if(opstats_ring && ++opstats_frames >= opstats_every)
+  OpStats_Record(frame);
 }
 
-void Automation_CDLReset(void)
-{
- if(cdl_bitmap)
-  memset(cdl_bitmap, 0, cdl_size);
-}
+bool Automation_OpStatsIsActive(void) { return opstats_active; }
 
-bool Automation_CDLDump(const char* path)
+uint64 Automation_OpStatsTotal(unsigned cpu)
 {
- if(!cdl_bitmap || !cdl_size) return false;
- FILE* f = fopen(path, "wb");
- if(!f) return false;
- // 8-byte header: lo (4 bytes LE) + hi (4 bytes LE)
- // Consumers read this to know the address range
- uint32 header[2] = { cdl_lo, cdl_hi };
- fwrite(header, 4, 2, f);
- fwrite(cdl_bitmap, 1, cdl_size, f);
- fclose(f);
- return true;
+ uint64 sums[OPSUM__COUNT];
+
+ OpStats_Sums(opstats_count[cpu & 1], sums);
+ return sums[OPSUM_INSNS];
 }
 
-bool Automation_CDLIsActive(void)
+// Totals since op_stats_start as text: per CPU the OPSUM_* line, then the "top" busiest
+// handlers(0 = all executed) with count, share and name.
+bool Automation_OpStatsDump(const char* path, unsigned top)
 {
- return cdl_active;
-}
+ FILE* fp = fopen(path, "w");
 
-uint32 Automation_CDLGetLo(void) { return cdl_lo; }
-uint32 Automation_CDLGetHi(void) { return cdl_hi; }
-uint32 Automation_CDLGetSize(void) { return cdl_size; }
+ if(!fp)
+  return false;
 
-// DMA trace logging
-void Automation_EnableDMATrace(const char* path)
-{
- if(dma_trace_file) fclose(dma_trace_file);
- dma_trace_file = fopen(path, "w");
- if(dma_trace_file)
-  fprintf(dma_trace_file, "# DMA trace: level src dst bytes pc frame\n");
-}
+ for(unsigned cpu = 0; cpu < 2; cpu++)
+ {
+  const SH7095::OpStatsCounters& c = opstats_count[cpu];
+  uint64 sums[OPSUM__COUNT];
+  std::vector<unsigned> order;
 
-void Automation_DisableDMATrace(void)
-{
- if(dma_trace_file) {
-  fclose(dma_trace_file);
-  dma_trace_file = nullptr;
- }
-}
+  if(opstats_active && !CPU[cpu].OpStats)
+   continue;
 
-void Automation_LogDMA(int level, uint32 src, uint32 dst, uint32 bytes)
-{
- if(!dma_trace_file) return;
- uint32 pc = CPU[0].PC;
- fprintf(dma_trace_file, "L%d src=0x%08X dst=0x%08X len=0x%X pc=0x%08X cycle=%lld\n",
-  level, src, dst, bytes, pc,
-  (long long)(automation_total_cycles + CPU[0].timestamp));
- fflush(dma_trace_file);
-}
+  OpStats_Sums(c, sums);
+  fprintf(fp, "# op_stats cpu=%s", cpu ? "slave" : "master");
+  for(unsigned i = 0; i < OPSUM__COUNT; i++)
+   fprintf(fp, " %s=%llu", opstats_sum_names[i], (unsigned long long)sums[i]);
+  fputc('\n', fp);
 
-// Memory write profiling
-void Automation_EnableMemProfile(const char* path, uint32 lo, uint32 hi)
-{
- if(memprofile_file) fclose(memprofile_file);
- memprofile_lo = lo & 0x0FFFFFFF;
- memprofile_hi = hi & 0x0FFFFFFF;
- memprofile_file = fopen(path, "w");
- if(memprofile_file)
-  fprintf(memprofile_file, "# Mem write profile: 0x%08X-0x%08X\n# pc addr val sz [chain=callee<-caller<-...]\n",
-   lo, hi);
-}
+  for(unsigned h = 0; h < 256; h++)
+  {
+   if(c.handler[h])
+    order.push_back(h);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return c.handler[a] > c.handler[b]; });
+  if(top && order.size() > top)
+   order.resize(top);
 
-void Automation_DisableMemProfile(void)
-{
- if(memprofile_file) {
-  fclose(memprofile_file);
-  memprofile_file = nullptr;
+  for(unsigned h : order)
+   fprintf(fp, "%c %02X %12llu %6.2f%% %s\n", cpu ? 'S' : 'M', h, (unsigned long long)c.handler[h], sums[OPSUM_INSNS] ? 100.0 * c.handler[h] / sums[OPSUM_INSNS] : 0.0, opstats_class[h].name);
  }
-}
 
-// Memory read profiling
-void Automation_EnableMemReadProfile(const char* path, uint32 lo, uint32 hi)
-{
- if(memreadprofile_file) fclose(memreadprofile_file);
- memreadprofile_lo = lo & 0x0FFFFFFF;
- memreadprofile_hi = hi & 0x0FFFFFFF;
- memreadprofile_file = fopen(path, "w");
- if(memreadprofile_file)
-  fprintf(memreadprofile_file, "# Mem read profile: 0x%08X-0x%08X\n# pc pr addr sz [chain=callee<-caller<-...]\n",
-   lo, hi);
+ fclose(fp);
+ return true;
 }
 
-void Automation_DisableMemReadProfile(void)
+uint64 Automation_DSPProfileStop(uint64* records)
 {
- if(memreadprofile_file) {
-  fclose(memreadprofile_file);
-  memreadprofile_file = nullptr;
+ uint64 dropped = 0;
+
+ automation_dsp_profile = false;
+ if(dsp_trace_ring)
+ {
+  dropped = dsp_trace_ring->Dropped();
+  delete dsp_trace_ring;	// drains the ring
+  dsp_trace_ring = nullptr;
  }
+ if(records)
+  *records = dsp_trace_records;
+ dsp_trace_records = 0;
+ return dropped;
 }
 
-void Automation_EnableCallTrace(const char* path)
+// trace_path may be null(counters only). The trace starts with "MDFNDSP1", le32 flags(bit 0:
+// the rest is in TraceRing deflate blocks), then 16-byte records: le64 master cycle, le32
+// instruction, u8 program RAM address, u8 flags(bit 0 DMA busy before the instruction, bit 1
+// after it, bit 2 the placeholder NOP after a PC load, address meaningless), le16 stall
+// cycles(saturated).
+bool Automation_DSPProfileStart(const char* trace_path, bool zlib)
 {
- // Close any existing trace first
- if(CPU[0].CallTraceFile) { fclose(CPU[0].CallTraceFile); CPU[0].CallTraceFile = nullptr; }
- if(CPU[1].CallTraceFile) { fclose(CPU[1].CallTraceFile); CPU[1].CallTraceFile = nullptr; }
+ Automation_DSPProfileStop(nullptr);
+ memset(dsp_prof_exec, 0, sizeof(dsp_prof_exec));
+ memset(dsp_prof_stall, 0, sizeof(dsp_prof_stall));
 
- FILE* f = fopen(path, "w");
- if(f) {
-  // Both CPUs write to the same file, distinguished by M/S prefix
-  CPU[0].CallTraceFile = f;
-  CPU[1].CallTraceFile = f;
- }
-}
+ if(trace_path)
+ {
+  FILE* f = fopen(trace_path, "wb");
+  uint8 header[12];
 
-void Automation_DisableCallTrace(void)
-{
- if(CPU[0].CallTraceFile) {
-  fclose(CPU[0].CallTraceFile);
+  if(!f)
+   return false;
+
+  memcpy(header, "MDFNDSP1", 8);
+  MDFN_en32lsb(&header[8], zlib);
+  fwrite(header, 1, sizeof(header), f);
+  dsp_trace_ring = new TraceRing(f, true, TraceRing::Default_Capacity, zlib);
  }
- CPU[0].CallTraceFile = nullptr;
- CPU[1].CallTraceFile = nullptr;
+ automation_dsp_next_addr = (uint8)(DSP.PC - 1);
+ automation_dsp_profile = true;
+ return true;
 }
 
-static bool call_trace_external = false;
+bool Automation_DSPProfileIsActive(void) { return automation_dsp_profile; }
 
-void Automation_SetCallTraceFile(FILE* f)
+void Automation_DSPProfileTotals(uint64* insns, uint64* stall)
 {
- // Close any self-owned trace first
- if(CPU[0].CallTraceFile && !call_trace_external)
-  fclose(CPU[0].CallTraceFile);
- CPU[0].CallTraceFile = f;
- CPU[1].CallTraceFile = f;
- call_trace_external = (f != nullptr);
+ *insns = *stall = 0;
+ for(unsigned a = 0; a < 256; a++)
+ {
+  *insns += dsp_prof_exec[a];
+  *stall += dsp_prof_stall[a];
+ }
 }
 
-void Automation_ClearCallTraceFile(void)
+// One line per program RAM address that ran, most cycles(2 per execution plus stalls) first.
+bool Automation_DSPProfileDump(const char* path, unsigned top)
 {
- if(CPU[0].CallTraceFile && !call_trace_external)
-  fclose(CPU[0].CallTraceFile);
- CPU[0].CallTraceFile = nullptr;
- CPU[1].CallTraceFile = nullptr;
- call_trace_external = false;
-}
+ FILE* fp = fopen(path, "w");
+ std::vector<unsigned> order;
+ uint64 insns, stall;
 
-// Per-instruction trace: log every CPU instruction between two unified trace events.
-// Triggered by unified trace line count reaching a threshold.
-static int64_t s_unified_line_count = 0;
-static int64_t s_insn_trace_start_line = -1;
-static int64_t s_insn_trace_stop_line = -1;
-static bool s_insn_trace_active = false;
-static FILE* s_insn_trace_file = nullptr;
-static bool s_insn_trace_unified = false;  // Write per-insn lines into CallTraceFile
+ if(!fp)
+  return false;
 
-// Called after every line written to the unified trace file.
-void Automation_UnifiedLineWritten(void)
-{
- s_unified_line_count++;
+ Automation_DSPProfileTotals(&insns, &stall);
+ const uint64 total = insns * 2 + stall;
+ fprintf(fp, "# dsp_profile instructions=%llu stall=%llu cycles=%llu\n", (unsigned long long)insns, (unsigned long long)stall, (unsigned long long)total);
+ fprintf(fp, "# addr executions stall cycles%% instruction\n");
 
- // Start trigger
- if(s_insn_trace_start_line >= 0 && s_unified_line_count >= s_insn_trace_start_line && !s_insn_trace_active)
+ for(unsigned a = 0; a < 256; a++)
  {
-  s_insn_trace_active = true;
-  if(s_insn_trace_unified && CPU[0].CallTraceFile)
-  {
-   // Unified mode: point InsnTraceFile at CallTraceFile so per-instruction
-   // lines are interleaved directly into the unified trace.
-   CPU[0].InsnTraceFile = CPU[0].CallTraceFile;
-   CPU[1].InsnTraceFile = CPU[1].CallTraceFile;
-   fprintf(CPU[0].CallTraceFile, "# INSN TRACE START after unified line %lld\n", (long long)s_unified_line_count);
-  }
-  else
-  {
-   CPU[0].InsnTraceFile = s_insn_trace_file;
-   CPU[1].InsnTraceFile = s_insn_trace_file;
-   if(s_insn_trace_file)
-    fprintf(s_insn_trace_file, "# INSN TRACE START after unified line %lld\n", (long long)s_unified_line_count);
-  }
+  if(dsp_prof_exec[a])
+   order.push_back(a);
  }
+ auto cycles = [](unsigned a) { return dsp_prof_exec[a] * 2 + dsp_prof_stall[a]; };
+ std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return cycles(a) > cycles(b); });
+ if(top && order.size() > top)
+  order.resize(top);
 
- // Stop trigger
- if(s_insn_trace_active && s_insn_trace_stop_line >= 0 && s_unified_line_count >= s_insn_trace_stop_line)
- {
-  if(s_insn_trace_unified && CPU[0].CallTraceFile)
-  {
-   fprintf(CPU[0].CallTraceFile, "# INSN TRACE STOP at unified line %lld\n", (long long)s_unified_line_count);
-   fflush(CPU[0].CallTraceFile);
-  }
-  else if(s_insn_trace_file)
-  {
-   fprintf(s_insn_trace_file, "# INSN TRACE STOP at unified line %lld\n", (long long)s_unified_line_count);
-   fflush(s_insn_trace_file);
-  }
-  s_insn_trace_active = false;
-  s_insn_trace_start_line = -1;  // Prevent re-trigger after stop
-  CPU[0].InsnTraceFile = nullptr;
-  CPU[1].InsnTraceFile = nullptr;
- }
+ for(unsigned a : order)
+  fprintf(fp, "%02X %12llu %12llu %6.2f%% %08X\n", a, (unsigned long long)dsp_prof_exec[a], (unsigned long long)dsp_prof_stall[a],
+   total ? 100.0 * cycles(a) / total : 0.0, (unsigned)(DSP.ProgRAM[a] >> 32));
+
+ fclose(fp);
+ return true;
 }
 
-void Automation_EnableInsnTrace(const char* path, int64_t start_line, int64_t stop_line)
+// prog: 256 words of program RAM, data: 4 x 64 words of data RAM(bank 0 first).
+void Automation_DSPReadRAM(uint32* prog, uint32* data)
 {
- if(s_insn_trace_file) { fclose(s_insn_trace_file); s_insn_trace_file = nullptr; }
- s_insn_trace_unified = false;
- s_insn_trace_file = fopen(path, "w");
- s_insn_trace_start_line = start_line;
- s_insn_trace_stop_line = stop_line;
- s_insn_trace_active = false;
- // Start at 2 to account for the 2-line header in the unified trace file.
- // This way the counter matches the file line number exactly.
- s_unified_line_count = 2;
- CPU[0].InsnTraceFile = nullptr;
- CPU[1].InsnTraceFile = nullptr;
- if(s_insn_trace_file)
+ for(unsigned i = 0; i < 256; i++)
+  prog[i] = DSP.ProgRAM[i] >> 32;
+ for(unsigned b = 0; b < 4; b++)
  {
-  fprintf(s_insn_trace_file, "# Per-instruction trace, lines %lld to %lld\n", (long long)start_line, (long long)stop_line);
-  fprintf(s_insn_trace_file, "# Format: timestamp M/S PC opcode\n");
-  fflush(s_insn_trace_file);
+  for(unsigned i = 0; i < 64; i++)
+   data[b * 64 + i] = DSP.DataRAM[b][i];
  }
 }
 
-void Automation_EnableInsnTraceUnified(int64_t start_line, int64_t stop_line)
-{
- // Like EnableInsnTrace but writes per-instruction lines directly into the
- // unified trace (CallTraceFile) instead of a separate file.
- if(s_insn_trace_file) { fclose(s_insn_trace_file); s_insn_trace_file = nullptr; }
- s_insn_trace_unified = true;
- s_insn_trace_start_line = start_line;
- s_insn_trace_stop_line = stop_line;
- s_insn_trace_active = false;
- s_unified_line_count = 2;
- CPU[0].InsnTraceFile = nullptr;
- CPU[1].InsnTraceFile = nullptr;
-}
-
-void Automation_DisableInsnTrace(void)
-{
- s_insn_trace_active = false;
- CPU[0].InsnTraceFile = nullptr;
- CPU[1].InsnTraceFile = nullptr;
- if(s_insn_trace_file) { fclose(s_insn_trace_file); s_insn_trace_file = nullptr; }
- s_insn_trace_start_line = -1;
- s_insn_trace_stop_line = -1;
-}
-
-// Automation: enable deterministic mode.
-// Bridge: called from SH-2 Exception() macro (inside MDFN_IEN_SS namespace),
-// forwards to the global ::Automation_ExceptionHit() in automation.cpp.
-void Automation_ExceptionHit(unsigned exnum, unsigned vecnum, uint32 pc, uint32 sr, uint32 r15, uint32 pr, uint32 vbr, uint32 handler_pc)
-{
- ::Automation_ExceptionHit(exnum, vecnum, pc, sr, r15, pr, vbr, handler_pc);
-}
-
-// Resets all non-deterministic emulator state to fixed values so that
-// identical inputs always produce identical traces.
-// Currently handles: SMPC RTC (host wall-clock seeding).
-void Automation_SetDeterministic(void)
+std::string Automation_DSPRegs(void)
 {
- // Reset RTC to a fixed time (2000-01-01 00:00:00, Saturday).
- // This overrides the Time::LocalTime() value set during init.
- struct tm fixed_time = {};
- fixed_time.tm_year = 100; // 2000
- fixed_time.tm_mon  = 0;   // January
- fixed_time.tm_mday = 1;
- fixed_time.tm_hour = 0;
- fixed_time.tm_min  = 0;
- fixed_time.tm_sec  = 0;
- fixed_time.tm_wday = 6;   // Saturday
- SMPC_SetRTC(&fixed_time, 1); // lang=1 (English)
+ char buf[256];
+
+ snprintf(buf, sizeof(buf), "dsp_regs PC=%02X running=%u paused=%u end=%u dma=%u S=%u Z=%u C=%u V=%u TOP=%02X LOP=%03X CT=%02X,%02X,%02X,%02X RA=%02X "
+  "AC=%012llX P=%012llX RX=%08X RY=%08X RA0=%08X WA0=%08X",
+  DSP.PC, (bool)(DSP.State & DSPS::STATE_MASK_EXECUTE), (bool)(DSP.State & DSPS::STATE_MASK_PAUSE), DSP.FlagEnd, DSP.T0_Until < DSP.CycleCounter,
+  DSP.FlagS, DSP.FlagZ, DSP.FlagC, DSP.FlagV, DSP.TOP, DSP.LOP, DSP.CT[0], DSP.CT[1], DSP.CT[2], DSP.CT[3], DSP.RA,
+  (unsigned long long)(DSP.AC.T & 0xFFFFFFFFFFFFULL), (unsigned long long)(DSP.P.T & 0xFFFFFFFFFFFFULL), DSP.RX, DSP.RY, DSP.RAO << 2, DSP.WAO << 2);
+ return buf;
 }
 
-#include "sh7095.inc"
-
 //
 // Running is:
 //   0 at end of (emulation) frame
@@ -1369,6 +6168,51 @@ static int Running;
 event_list_entry events[SS_EVENT__COUNT];
 static sscpu_timestamp_t next_event_ts;
 
+// Automation: event handler calls, rolled once per frame by Automation_EventStatsFrame().
+static uint64 evstat_cur[SS_EVENT__COUNT];
+static uint64 evstat_last[SS_EVENT__COUNT];
+static uint64 evstat_total[SS_EVENT__COUNT];
+
+// Automation: host time per subsystem(perf_stats), in PerfClock_Now() ticks.  Off, it costs one flag test per
+// event and per frame; on, Emulate() runs the RunLoop_Perf variant, which also times the slave's share of each
+// master instruction.
+struct PerfCounters
+{
+ uint64 emulate;		// all of Emulate()
+ uint64 runloop;		// the CPU loop, events included
+ uint64 runloop_events;		// events run from within it
+ uint64 slave;			// slave SH-2, events it ran into excluded
+ uint64 events[SS_EVENT__COUNT];
+ uint64 vdp2_wait;		// emulation thread waiting on the VDP2 render thread(counted in vdp2 too)
+ uint64 driver;			// between the previous Emulate() and this one: blit, throttle, automation
+ uint64 emu_ns;			// emulated time
+ uint64 frames;
+};
+
+static bool perf_on = false;
+static bool perf_in_event = false;	// nested handlers count toward the outer one
+static PerfCounters perf_cur, perf_last, perf_total;
+static uint64 perf_evsum;		// sum of perf_cur.events
+static uint64 perf_prev_end;		// end of the last timed Emulate(), 0 = none or paused since
+static uint64 perf_cal_ticks;		// Emulate() time in ticks and in microseconds, for the tick unit
+static uint64 perf_cal_us;
+
+static NO_INLINE sscpu_timestamp_t Perf_RunEvent(event_list_entry* e, const sscpu_timestamp_t timestamp)
+{
+ const uint64 start = PerfClock_Now();
+ sscpu_timestamp_t nt;
+
+ perf_in_event = true;
+ nt = e->event_handler(timestamp);
+ perf_in_event = false;
+
+ const uint64 dt = PerfClock_Now() - start;
+ perf_cur.events[e - events] += dt;
+ perf_evsum += dt;
+
+ return nt;
+}
+
 template<unsigned c>
 static sscpu_timestamp_t SH_DMA_EventHandler(sscpu_timestamp_t et)
 {
@@ -1424,9 +6268,14 @@ static MDFN_COLD void InitEvents(void)
  events[SS_EVENT_CART].event_handler = CART_GetEventHandler();
 
  events[SS_EVENT_MIDSYNC].event_handler = MidSync;
+
+ events[SS_EVENT_PROFILE].event_handler = Profile_Update;
+ events[SS_EVENT_TICK].event_handler = Tick_Update;
  //
  //
  SS_SetEventNT(&events[SS_EVENT_MIDSYNC], SS_EVENT_DISABLED_TS);
+ SS_SetEventNT(&events[SS_EVENT_PROFILE], SS_EVENT_DISABLED_TS);
+ SS_SetEventNT(&events[SS_EVENT_TICK], SS_EVENT_DISABLED_TS);
 }
 
 static void RebaseTS(const sscpu_timestamp_t timestamp)
@@ -1515,16 +6364,60 @@ void ForceEventUpdates(const sscpu_timestamp_t timestamp)
  }
 #endif
 
- for(unsigned c = 0; c < 2; c++)
-  CPU[c].ForceInternalEventUpdates();
+ for(unsigned c = 0; c < 2; c++)
+  CPU[c].ForceInternalEventUpdates();
+
+ for(unsigned evnum = SS_EVENT__SYNFIRST + 1; evnum < SS_EVENT__SYNLAST; evnum++)
+ {
+  if(events[evnum].event_time != SS_EVENT_DISABLED_TS)
+  {
+   evstat_cur[evnum]++;
+   if(MDFN_UNLIKELY(perf_on) && !perf_in_event)
+    SS_SetEventNT(&events[evnum], Perf_RunEvent(&events[evnum], timestamp));
+   else
+    SS_SetEventNT(&events[evnum], events[evnum].event_handler(timestamp));
+  }
+ }
+
+ next_event_ts = ((Running > 0) ? events[SS_EVENT__SYNFIRST].next->event_time : 0);
+}
+
+// End of an emulated frame: the frame's counts become the "last" set.
+void Automation_EventStatsFrame(void)
+{
+ for(unsigned i = 0; i < SS_EVENT__COUNT; i++)
+  evstat_total[i] += evstat_cur[i];
+
+ memcpy(evstat_last, evstat_cur, sizeof(evstat_last));
+ memset(evstat_cur, 0, sizeof(evstat_cur));
+}
+
+void Automation_EventStatsReset(void)
+{
+ memset(evstat_cur, 0, sizeof(evstat_cur));
+ memset(evstat_last, 0, sizeof(evstat_last));
+ memset(evstat_total, 0, sizeof(evstat_total));
+}
+
+// " sh2_m_dma=<calls> ..." for every scheduled event, from the last frame
+// (or since the last reset, if total).
+std::string Automation_EventStatsFormat(bool total)
+{
+ static const char* const event_names[SS_EVENT__COUNT] =
+ {
+  nullptr, "sh2_m_dma", "sh2_s_dma", "scu_dma", "scu_dsp", "smpc", "vdp1", "vdp2", "cdb", "sound", "cart", "midsync", "profile", nullptr
+ };
+ const uint64* counts = total ? evstat_total : evstat_last;
+ std::string ret;
 
- for(unsigned evnum = SS_EVENT__SYNFIRST + 1; evnum < SS_EVENT__SYNLAST; evnum++)
+ for(unsigned i = SS_EVENT__SYNFIRST + 1; i < SS_EVENT__SYNLAST; i++)
  {
-  if(events[evnum].event_time != SS_EVENT_DISABLED_TS)
-   SS_SetEventNT(&events[evnum], events[evnum].event_handler(timestamp));
+  char buf[48];
+  snprintf(buf, sizeof(buf), " %s=%llu", event_names[i], (unsigned long long)counts[i]);
+  ret += buf;
  }
 
- next_event_ts = ((Running > 0) ? events[SS_EVENT__SYNFIRST].next->event_time : 0);
+ return ret;
 }
 
 static INLINE bool EventHandler(const sscpu_timestamp_t timestamp)
@@ -1538,7 +6431,11 @@ static INLINE bool EventHandler(const sscpu_timestamp_t timestamp)
 #endif
   sscpu_timestamp_t nt;
 
-  nt = e->event_handler(e->event_time);
+  evstat_cur[e - events]++;
+  if(MDFN_UNLIKELY(perf_on) && !perf_in_event)
+   nt = Perf_RunEvent(e, e->event_time);
+  else
+   nt = e->event_handler(e->event_time);
 
 #ifdef MDFN_ENABLE_DEV_BUILD
   if(MDFN_UNLIKELY(nt <= etime))
@@ -1587,13 +6484,16 @@ void SS_RequestMLExit(void)
  #pragma GCC push_options
  #pragma GCC optimize("O2,no-unroll-loops,no-peel-loops,no-crossjumping")
 #endif
-template<bool EmulateICache, bool DebugMode>
+template<bool EmulateICache, bool DebugMode, bool Instrumented, bool Perf = false>
 static INLINE int32 RunLoop_INLINE(EmulateSpecStruct* espec)
 {
  sscpu_timestamp_t eff_ts = 0;
 
  for(unsigned c = 0; c < 2; c++)
+ {
   CPU[c].SetDebugMode(DebugMode);
+  CPU[c].SetInstrumented(Instrumented);
+ }
 
  //printf("%d %d\n", SH7095_mem_timestamp, CPU[0].timestamp);
  do
@@ -1611,20 +6511,52 @@ static INLINE int32 RunLoop_INLINE(EmulateSpecStruct* espec)
     {
      DBG_SetEffTS(eff_ts);
      DBG_CPUHandler<0>();
+     // op_stats runs this loop too, so automation breakpoints and hooks still apply.
+     if(MDFN_UNLIKELY(s_automation_inline_hook != nullptr) && Automation_HookWanted<0>(CPU[0].PC))
+      s_automation_inline_hook();
     }
-    else if(MDFN_UNLIKELY(s_automation_inline_hook != nullptr))
+    else if(Instrumented && MDFN_UNLIKELY(s_automation_inline_hook != nullptr) && Automation_HookWanted<0>(CPU[0].PC))
     {
      s_automation_inline_hook();
     }
+    else if(MDFN_UNLIKELY(CPU[0].IdleSkip))
+    {
+     // Work RAM only when the slave can't write it while the master is skipping ahead.
+     CPU[0].IdleLoopCheck(next_event_ts, CPU[1].timestamp == SS_EVENT_DISABLED_TS);
+    }
+
+    if(Instrumented && EmulateICache)
+     automation_master_in_step = true;
+
+    CPU[0].Step<0, EmulateICache, DebugMode, Instrumented>();
 
-    CPU[0].Step<0, EmulateICache, DebugMode>();
+    if(Instrumented && EmulateICache)
+    {
+     automation_master_in_step = false;
+
+     if(MDFN_UNLIKELY(automation_slave_stop_latched))
+      Automation_SlaveLatchedStop();
+    }
     CPU[0].DMA_BusTimingKludge();
 
+    uint64 perf_start = 0, perf_ev = 0;
+
+    if(Perf)
+    {
+     perf_ev = perf_evsum;
+     perf_start = PerfClock_Now();
+    }
+
     if(EmulateICache)
     {
      if(DebugMode)
       CPU[1].RunSlaveUntil_Debug(CPU[0].timestamp);
-     else
+     //
+     // With a sync quantum, let the slave fall behind by up to that many cycles.  The master's external bus accesses
+     // still catch it up first(CHECK_EXIT_RESUME()), and so does reaching the next event, so everything it can see
+     // of the slave, and every interrupt, is the same as syncing after each instruction.
+     //
+     else if(MDFN_LIKELY(!SlaveSyncQuantum) || (CPU[0].timestamp - CPU[1].timestamp) >= SlaveSyncQuantum || std::max<sscpu_timestamp_t>(CPU[0].timestamp, SH7095_mem_timestamp) >= next_event_ts)
       CPU[1].RunSlaveUntil(CPU[0].timestamp);
     }
     else
@@ -1632,12 +6564,23 @@ static INLINE int32 RunLoop_INLINE(EmulateSpecStruct* espec)
      while(MDFN_LIKELY(CPU[0].timestamp > CPU[1].timestamp))
      {
       if(DebugMode)
+      {
        DBG_CPUHandler<1>();
+       if(MDFN_UNLIKELY(s_automation_slave_hook != nullptr) && Automation_HookWanted<1>(CPU[1].PC))
+        s_automation_slave_hook();
+      }
+      else if(Instrumented && MDFN_UNLIKELY(s_automation_slave_hook != nullptr) && Automation_HookWanted<1>(CPU[1].PC))
+       s_automation_slave_hook();
+      else if(MDFN_UNLIKELY(CPU[1].IdleSkip))
+       CPU[1].IdleLoopCheck(CPU[0].timestamp, true);
 
-      CPU[1].Step<1, false, DebugMode>();
+      CPU[1].Step<1, false, DebugMode, Instrumented>();
      }
     }
 
+    if(Perf)
+     perf_cur.slave += (PerfClock_Now() - perf_start) - (perf_evsum - perf_ev);
+
     eff_ts = CPU[0].timestamp;
     if(SH7095_mem_timestamp > eff_ts)
      eff_ts = SH7095_mem_timestamp;
@@ -1651,16 +6594,54 @@ static INLINE int32 RunLoop_INLINE(EmulateSpecStruct* espec)
  return eff_ts;
 }
 
+//
+// RunLoop has every automation check(traces, CDL, profilers, watchpoints, hooks, the shadow call stack) compiled out,
+// leaving the same per-instruction and per-access work as upstream; RunLoop_Instr is the same loop with them in, used
+// while SS_NeedInstrumented() says something could want them.  The debug and perf loops are always instrumented.
+//
 template<bool EmulateICache>
 static NO_INLINE MDFN_HOT int32 RunLoop(EmulateSpecStruct* espec)
 {
- return RunLoop_INLINE<EmulateICache, false>(espec);
+ return RunLoop_INLINE<EmulateICache, false, false>(espec);
+}
+
+template<bool EmulateICache>
+static NO_INLINE int32 RunLoop_Instr(EmulateSpecStruct* espec)
+{
+ return RunLoop_INLINE<EmulateICache, false, true>(espec);
 }
 
 template<bool EmulateICache>
 static NO_INLINE MDFN_COLD int32 RunLoop_Debug(EmulateSpecStruct* espec)
 {
- return RunLoop_INLINE<EmulateICache, true>(espec);
+ return RunLoop_INLINE<EmulateICache, true, true>(espec);
+}
+
+template<bool EmulateICache>
+static NO_INLINE MDFN_COLD int32 RunLoop_Perf(EmulateSpecStruct* espec)
+{
+ return RunLoop_INLINE<EmulateICache, false, true, true>(espec);
+}
+
+// Checked once per frame.  Everything listed is only turned on by automation commands or settings read between
+// frames, or from inside a CPU hook, which keeps the frame on the instrumented loop anyway.
+static bool SS_NeedInstrumented(void)
+{
+ if(::Automation_IsActive() || cem_detect_armed || cdl_active || fprof_active || cstat_active || busprof_active || syncprof_active)
+  return true;
+
+ if(heatmap_lines || memprofile_ring || memreadprofile_ring || !automation_watches.empty() || s_automation_inline_hook || s_automation_slave_hook)
+  return true;
+
+ for(unsigned c = 0; c < 2; c++)
+ {
+  const SH7095& cpu = CPU[c];
+
+  if(cpu.InsnTraceGate || cpu.InsnTrace || cpu.InsnTraceRaw || cpu.InsnTraceBin || cpu.FlightRecorder || cpu.FlightRecMem || cpu.CallTraceFile || cpu.CallTraceBin)
+   return true;
+ }
+
+ return false;
 }
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -1752,10 +6733,173 @@ static sscpu_timestamp_t MidSync(const sscpu_timestamp_t timestamp)
  return SS_EVENT_DISABLED_TS;
 }
 
+// Automation: perf_stats frame edges.  Emulate() stamps its start and end, the time in between frames is the
+// driver's unless automation was paused(Automation_PerfStatsIdle()).
+static uint64 perf_frame_start, perf_frame_start_us, perf_frame_wait;
+
+static void Perf_StartFrame(void)
+{
+ perf_frame_start = PerfClock_Now();
+ perf_frame_start_us = Time::MonoUS();
+ perf_frame_wait = VDP2REND_GetWaitTicks();
+
+ if(perf_prev_end)
+  perf_cur.driver += perf_frame_start - perf_prev_end;
+}
+
+static void Perf_EndFrame(const int64 master_cycles)
+{
+ const uint64 now = PerfClock_Now();
+ const uint64 hz = MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1);
+
+ perf_cur.emulate += now - perf_frame_start;
+ perf_cur.vdp2_wait += VDP2REND_GetWaitTicks() - perf_frame_wait;
+ perf_cur.emu_ns = hz ? (uint64)master_cycles * 1000000000 / hz : 0;
+ perf_cur.frames = 1;
+ perf_cal_ticks += now - perf_frame_start;
+ perf_cal_us += Time::MonoUS() - perf_frame_start_us;
+ perf_prev_end = now;
+
+ perf_total.emulate += perf_cur.emulate;
+ perf_total.runloop += perf_cur.runloop;
+ perf_total.runloop_events += perf_cur.runloop_events;
+ perf_total.slave += perf_cur.slave;
+ for(unsigned i = 0; i < SS_EVENT__COUNT; i++)
+  perf_total.events[i] += perf_cur.events[i];
+ perf_total.vdp2_wait += perf_cur.vdp2_wait;
+ perf_total.driver += perf_cur.driver;
+ perf_total.emu_ns += perf_cur.emu_ns;
+ perf_total.frames++;
+
+ perf_last = perf_cur;
+ perf_cur = PerfCounters();
+ perf_evsum = 0;
+}
+
+//
+// ss.fastboot: the first time a game is booted, save a state once the master CPU is running the game's first
+// executable(the IP.BIN first read address or above, in high work RAM), and load that state instead of booting the
+// BIOS from then on.  The state file name is keyed by the BIOS SHA-256, disc FD ID, region and cart type, on top of
+// the game MD5 in the usual state file name.
+//
+static struct
+{
+ std::string suffix;	// empty = fast boot off
+ uint32 first_read;
+ bool pending;		// try loading before the first frame
+ bool record;		// save when the game starts
+} FastBoot;
+
+static void FastBoot_Init(const uint8* fd_id, const unsigned region, const int cart_type)
+{
+ std::unique_ptr<uint8[]> buf(new uint8[2048]);
+
+ FastBoot.suffix.clear();
+ FastBoot.pending = FastBoot.record = false;
+
+ if(!MDFN_GetSettingB("ss.fastboot"))
+  return;
+
+ if(cdifs->empty() || (*cdifs)[0]->ReadSectors(buf.get(), 0, 1) != 0x1 || memcmp(&buf[0], "SEGA SEGASATURN ", 16))
+ {
+  MDFN_printf(_("Fast boot: no Saturn IP.BIN in the first sector, disabled.\n"));
+  return;
+ }
+
+ FastBoot.first_read = MDFN_de32msb(&buf[0xF0]) & 0x07FFFFFF;
+ FastBoot.suffix = "fb.";
+
+ for(unsigned i = 0; i < 8; i++)
+  FastBoot.suffix += MDFN_sprintf("%02x", BIOS_SHA256[i]);
+
+ FastBoot.suffix += '.';
+
+ for(unsigned i = 0; i < 8; i++)
+  FastBoot.suffix += MDFN_sprintf("%02x", fd_id[i]);
+
+ FastBoot.suffix += MDFN_sprintf(".%x.%d", region, cart_type);
+ FastBoot.pending = true;
+}
+
+static void FastBoot_Load(void)
+{
+ const std::string path = MDFN_MakeFName(MDFNMKF_STATE, 0, FastBoot.suffix.c_str());
+
+ FastBoot.pending = false;
+ FastBoot.record = true;
+
+ try
+ {
+  GZFileStream fp(path, GZFileStream::MODE::READ);
+
+  MDFNSS_LoadSM(&fp);
+  FastBoot.record = false;
+  MDFN_printf(_("Fast boot: loaded \"%s\".\n"), path.c_str());
+ }
+ catch(MDFN_Error& e)
+ {
+  if(e.GetErrno() != ENOENT)
+   MDFN_Notify(MDFN_NOTICE_WARNING, _("Fast boot state \"%s\" not loaded, booting normally to recreate it: %s"), path.c_str(), e.what());
+ }
+}
+
+static void FastBoot_Check(void)
+{
+ const uint32 pc = CPU[0].PC & 0x07FFFFFF;
+
+ if(pc < FastBoot.first_read || pc < 0x06000000 || pc >= 0x08000000)
+  return;
+
+ std::unique_ptr<MemoryStream> ms(new MemoryStream(65536));
+
+ FastBoot.record = false;
+ MDFNSS_SaveSM(ms.get());
+ MDFNSS_WriteAsync(std::move(ms), MDFN_MakeFName(MDFNMKF_STATE, 0, FastBoot.suffix.c_str()), 6, [](const std::string& path, const std::string& error) {
+  if(error.size())
+   MDFN_Notify(MDFN_NOTICE_WARNING, _("Fast boot state \"%s\" not saved: %s"), path.c_str(), error.c_str());
+  else
+   MDFN_printf(_("Fast boot: saved \"%s\".\n"), path.c_str());
+ });
+}
+
+// Between frames(or while loading a state), with no CPU mid-instruction.
+static MDFN_COLD void CEM_SwitchToFull(const bool live)
+{
+ static const char* const reasons[] = { "associative purge", "CCR purge", "cache-through alias write", "self-modifying code" };
+ const unsigned r = MDFN_tzcount32(cem_hit.reason) & 3;
+
+ cem_switch_pending = false;
+ cem_detect_armed = false;
+ if(NeedEmuICache)
+  return;
+
+ NeedEmuICache = true;
+ for(unsigned c = 0; c < 2; c++)
+  CPU[c].SwitchToICacheEmulation(live);
+
+ if(!live)
+  MDFN_printf(_("CPU Cache Emulation Mode: switched to Full (save state)\n"));
+ else if(!cem_hit.reason)
+  MDFN_printf(_("CPU Cache Emulation Mode: switched to Full (requested)\n"));
+ else
+  MDFN_printf(_("CPU Cache Emulation Mode: switched to Full (%s by %s, address 0x%08x, PC 0x%08x, cycle %lld)\n"), reasons[r], cem_hit.cpu ? "SH2-S" : "SH2-M", cem_hit.addr, cem_hit.pc, (long long)cem_hit.cycle);
+}
+
 static void Emulate(EmulateSpecStruct* espec_arg)
 {
  int32 end_ts;
 
+ if(MDFN_UNLIKELY(FastBoot.pending))
+  FastBoot_Load();
+
+ if(MDFN_UNLIKELY(!freeze_words.empty()))
+  Freeze_Apply();
+
+ const bool perf = perf_on;
+
+ if(MDFN_UNLIKELY(perf))
+  Perf_StartFrame();
+
  espec = espec_arg;
  AllowMidSync = true;
  MDFNGameInfo->mouse_sensitivity = MDFN_GetSettingF("ss.input.mouse_sensitivity");
@@ -1771,19 +6915,40 @@ static void Emulate(EmulateSpecStruct* espec_arg)
  //
  //
  //
+// The interpreter is the only SH-2 engine.  A block recompiler would have to
+// stop at every memory access anyway: MA_until bus contention, the cache
+// emulation, SH7095_mem_timestamp sync with the slave and mid-instruction
+// resume points (ExtBusRead/Write, RunSlaveUntil) all depend on per-access
+// timing, and those accesses are most of what the hot loops do.
 #ifdef WANT_DEBUGGER
  #define RLTDAT(eic) RunLoop_Debug<eic>
 #else
- #define RLTDAT(eic) RunLoop<eic>
+ #define RLTDAT(eic) RunLoop_Instr<eic>
 #endif
- static int32 (*const rltab[2][2])(EmulateSpecStruct*) =
+ static int32 (*const rltab[2][3])(EmulateSpecStruct*) =
  {
-  //DebugMode=false  DebugMode=true
-  { RunLoop<false>, RLTDAT(false) },	// EmulateICache=false
-  { RunLoop<true>,  RLTDAT(true)  },	// EmulateICache=true
+  //Plain            Instrumented          DebugMode=true
+  { RunLoop<false>, RunLoop_Instr<false>, RLTDAT(false) },	// EmulateICache=false
+  { RunLoop<true>,  RunLoop_Instr<true>,  RLTDAT(true)  },	// EmulateICache=true
  };
 #undef RLTDAT
- end_ts = rltab[NeedEmuICache][DBG_NeedCPUHooks()](espec);
+ const bool debug_loop = DBG_NeedCPUHooks() || opstats_active;
+ const unsigned loop_kind = debug_loop ? 2 : SS_NeedInstrumented();
+
+ if(MDFN_UNLIKELY(cem_switch_pending))
+  CEM_SwitchToFull(true);
+
+ if(MDFN_UNLIKELY(perf) && !debug_loop)
+ {
+  const uint64 rl_start = PerfClock_Now();
+  const uint64 rl_ev = perf_evsum;
+
+  end_ts = (NeedEmuICache ? RunLoop_Perf<true> : RunLoop_Perf<false>)(espec);
+  perf_cur.runloop += PerfClock_Now() - rl_start;
+  perf_cur.runloop_events += perf_evsum - rl_ev;
+ }
+ else
+  end_ts = rltab[NeedEmuICache][loop_kind](espec);
  assert(end_ts >= 0);
  ForceEventUpdates(end_ts);
  //
@@ -1823,9 +6988,15 @@ static void Emulate(EmulateSpecStruct* espec_arg)
  //
  //
  //
+#ifdef MDFN_ENABLE_DEV_BUILD
+ SS_DBG_Flush();
+#endif
+ //
+ //
+ //
  if(BackupRAM_Dirty)
  {
-  BackupRAM_SaveDelay = (int64)3 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 3 second delay
+  BackupRAM_SaveDelay = NV_MemoryOnly ? 0 : (int64)3 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 3 second delay
   BackupRAM_Dirty = false;
  }
  else if(BackupRAM_SaveDelay > 0)
@@ -1836,7 +7007,7 @@ static void Emulate(EmulateSpecStruct* espec_arg)
   {
    try
    {
-    SaveBackupRAM();
+    SaveBackupRAMAsync();
    }
    catch(std::exception& e)
    {
@@ -1848,25 +7019,356 @@ static void Emulate(EmulateSpecStruct* espec_arg)
 
  if(CART_GetClearNVDirty())
  {
-  CartNV_SaveDelay = (int64)3 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 3 second delay
+  CartNV_SaveDelay = NV_MemoryOnly ? 0 : (int64)3 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 3 second delay
  }
  else if(CartNV_SaveDelay > 0)
  {
   CartNV_SaveDelay -= espec->MasterCycles;
 
-  if(CartNV_SaveDelay <= 0)
+  if(CartNV_SaveDelay <= 0)
+  {
+   try
+   {
+    SaveCartNVAsync();
+   }
+   catch(std::exception& e)
+   {
+    MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what());
+    CartNV_SaveDelay = (int64)60 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 60 second retry delay.
+   }
+  }
+ }
+
+ if(MDFN_UNLIKELY(perf))
+  Perf_EndFrame(espec->MasterCycles);
+
+ if(MDFN_UNLIKELY(FastBoot.record))
+  FastBoot_Check();
+}
+
+void Automation_PerfStatsStart(void)
+{
+ perf_cur = perf_last = perf_total = PerfCounters();
+ perf_evsum = 0;
+ perf_prev_end = 0;
+ perf_cal_ticks = perf_cal_us = 0;
+ perf_on = true;
+}
+
+void Automation_PerfStatsStop(void)
+{
+ perf_on = false;
+ perf_in_event = false;
+}
+
+bool Automation_PerfStatsIsActive(void) { return perf_on; }
+
+void Automation_PerfStatsIdle(void)
+{
+ perf_prev_end = 0;
+}
+
+// Name and microseconds(per frame, for total the average) of each perf_stats column.
+static std::vector<std::pair<const char*, double>> Perf_Columns(const PerfCounters& c)
+{
+ const double n = std::max<uint64>(1, c.frames);
+ const double us = perf_cal_ticks ? (double)perf_cal_us / perf_cal_ticks / n : 0;
+ const uint64* ev = c.events;
+ uint64 ev_sum = 0;
+
+ for(unsigned i = 0; i < SS_EVENT__COUNT; i++)
+  ev_sum += ev[i];
+
+ const uint64 master = c.runloop - std::min(c.runloop, c.slave + c.runloop_events);
+ const uint64 frame = c.emulate - std::min(c.emulate, c.runloop + (ev_sum - c.runloop_events));
+ const double host = (c.emulate + c.driver) * us;
+ const double emu = c.emu_ns / 1000.0 / n;
+
+ return {
+  { "emu", emu },
+  { "host", host },
+  { "speed", host > 0 ? emu * 100 / host : 0 },
+  { "master", master * us },
+  { "slave", c.slave * us },
+  { "sh2_dma", (ev[SS_EVENT_SH2_M_DMA] + ev[SS_EVENT_SH2_S_DMA]) * us },
+  { "scu", (ev[SS_EVENT_SCU_DMA] + ev[SS_EVENT_SCU_DSP]) * us },
+  { "smpc", ev[SS_EVENT_SMPC] * us },
+  { "vdp1", ev[SS_EVENT_VDP1] * us },
+  { "vdp2", ev[SS_EVENT_VDP2] * us },
+  { "vdp2_wait", c.vdp2_wait * us },
+  { "cdb", ev[SS_EVENT_CDB] * us },
+  { "sound", ev[SS_EVENT_SOUND] * us },
+  { "cart", ev[SS_EVENT_CART] * us },
+  { "other", (ev[SS_EVENT_MIDSYNC] + ev[SS_EVENT_PROFILE] + ev[SS_EVENT_TICK]) * us },
+  { "frame", frame * us },
+  { "driver", c.driver * us },
+ };
+}
+
+// " frames=N emu=<us> host=<us> speed=<%> master=<us> ..." for the last frame, or averaged since start.
+std::string Automation_PerfStatsFormat(bool total)
+{
+ const PerfCounters& c = total ? perf_total : perf_last;
+ std::string ret = " frames=" + std::to_string(c.frames);
+
+ for(auto const& col : Perf_Columns(c))
+ {
+  char buf[48];
+  snprintf(buf, sizeof(buf), " %s=%.1f", col.first, col.second);
+  ret += buf;
+ }
+
+ return ret;
+}
+
+// {"frames":N,"emu":<us>,...} for the last frame; "null" while perf_stats is off.
+std::string Automation_PerfStatsJSON(void)
+{
+ if(!perf_on)
+  return "null";
+
+ std::string ret = "{\"frames\":" + std::to_string(perf_last.frames);
+
+ for(auto const& col : Perf_Columns(perf_last))
+ {
+  char buf[48];
+  snprintf(buf, sizeof(buf), ",\"%s\":%.1f", col.first, col.second);
+  ret += buf;
+ }
+
+ return ret + "}";
+}
+
+// "name":{"bytes":N,"dropped":N} for each async trace writer that's open, comma-separated.
+std::string Automation_TraceWritersJSON(void)
+{
+ const struct { const char* name; uint64 bytes, dropped; bool open; } w[] =
+ {
+  { "unified_trace_bin", unified_bin ? unified_bin->Position() : 0, unified_bin ? unified_bin->Dropped() : 0, unified_bin != nullptr },
+  { "insn_trace", s_insn_trace_ring ? s_insn_trace_ring->Position() : 0, s_insn_trace_ring ? s_insn_trace_ring->Dropped() : 0, s_insn_trace_ring != nullptr },
+  { "dma_trace", dma_trace_ring ? dma_trace_ring->Position() : 0, dma_trace_ring ? dma_trace_ring->Dropped() : 0, dma_trace_ring != nullptr },
+  { "dma_trace_bin", dmabin_ring ? dmabin_ring->Position() : 0, dmabin_ring ? dmabin_ring->Dropped() : 0, dmabin_ring != nullptr },
+  { "mem_profile", memprofile_ring ? memprofile_ring->Position() : 0, memprofile_ring ? memprofile_ring->Dropped() : 0, memprofile_ring != nullptr },
+  { "mem_read_profile", memreadprofile_ring ? memreadprofile_ring->Position() : 0, memreadprofile_ring ? memreadprofile_ring->Dropped() : 0, memreadprofile_ring != nullptr },
+  { "heatmap", heatmap_ring ? heatmap_ring->Position() : 0, heatmap_ring ? heatmap_ring->Dropped() : 0, heatmap_ring != nullptr },
+  { "op_stats", opstats_ring ? opstats_ring->Position() : 0, opstats_ring ? opstats_ring->Dropped() : 0, opstats_ring != nullptr },
+  { "vdp2_watchpoint", automation_vdp2wp_ring ? automation_vdp2wp_ring->Position() : 0, automation_vdp2wp_ring ? automation_vdp2wp_ring->Dropped() : 0, automation_vdp2wp_ring != nullptr },
+ };
+ std::string ret;
+
+ for(auto const& e : w)
+ {
+  if(!e.open)
+   continue;
+
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%s\"%s\":{\"bytes\":%llu,\"dropped\":%llu}", ret.empty() ? "" : ",", e.name, (unsigned long long)e.bytes, (unsigned long long)e.dropped);
+  ret += buf;
+ }
+
+ return ret;
+}
+
+// One CSV line(no newline) for the last frame, or the header.
+std::string Automation_PerfStatsCSV(bool header)
+{
+ std::string ret;
+
+ for(auto const& col : Perf_Columns(perf_last))
+ {
+  char buf[48];
+
+  if(header)
+   snprintf(buf, sizeof(buf), ",%s", col.first);
+  else
+   snprintf(buf, sizeof(buf), ",%.1f", col.second);
+  ret += buf;
+ }
+
+ return ret.substr(1);
+}
+
+//
+// sh2_bench: host time of the master SH-2 interpreter alone on a small loop kernel.  The kernel is written to work
+// RAM and run with Step() directly, with interrupts masked, the slave and every scheduler event held off; it
+// clobbers the machine, so the caller saves and reloads state around it.
+//
+struct SH2BenchKernel
+{
+ const char* name;
+ std::vector<uint16> code;	// loops forever
+};
+
+static const SH2BenchKernel SH2Bench_Kernels[] =
+{
+ // ALU mix: ADD, XOR, SHLL, ADD #imm, SUB, AND, OR, NOT, SHLR, MOV; BRA with an ADD #imm in the delay slot.
+ { "alu", { 0x310C, 0x221A, 0x4300, 0x7405, 0x3548, 0x2659, 0x276B, 0x6177, 0x4201, 0x6323, 0xAFF4, 0x7001 } },
+
+ // Taken and not-taken BT/BF on the low bits of a counter, DT loop with BF back, then BRA.
+ { "branch", { 0x7101, 0x6013, 0xC801, 0x8900, 0x7201, 0xC802, 0x8B00, 0x7302, 0xC804, 0x8900, 0x241A, 0x4610, 0x8BF2, 0xAFF1, 0x0009 } },
+
+ // MAC.L x 4 and MAC.W x 4 from @R1+/@R2+(reset from R8/R9 each pass), STS MACL.
+ { "mac", { 0x6183, 0x6293, 0x012F, 0x012F, 0x012F, 0x012F, 0x412F, 0x412F, 0x412F, 0x412F, 0x031A, 0xAFF3, 0x0009 } },
+
+ // Eight MOV.L loads 0x400 bytes apart: all the same cache set, twice the ways, so they keep missing.
+ { "cache", { 0x6183, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0x6012, 0x319C, 0xAFED, 0x0009 } },
+
+ // On-chip divider: DVSR, DVDNTH, DVDNTL(starts the 64/32 divide) via @(disp,R10), read back the quotient.
+ { "div", { 0x1A10, 0x1A24, 0x1A35, 0x54A5, 0x7301, 0x354C, 0xAFF8, 0x0009 } },
+};
+
+template<bool EmulateICache>
+static uint64 SH2Bench_Run(const uint64 insns)
+{
+ uint64 cycles = 0;
+
+ for(uint64 done = 0; done < insns;)
+ {
+  const uint32 n = std::min<uint64>(65536, insns - done);
+
+  for(uint32 i = 0; i < n; i++)
+   CPU[0].Step<0, EmulateICache, false, false>();
+
+  done += n;
+  //
+  const sscpu_timestamp_t ts = std::min<sscpu_timestamp_t>(CPU[0].timestamp, SH7095_mem_timestamp);
+
+  cycles += ts;
+  SH7095_mem_timestamp -= ts;
+  CPU[0].AdjustTS(-ts);
+ }
+
+ return cycles;
+}
+
+static uint16* SH2Bench_WordPtr(const uint32 addr)
+{
+ const uint32 a = addr & 0x07FFFFFF;
+
+ if(a >= 0x00200000 && a < 0x00300000)
+  return &WorkRAML[(a & 0xFFFFF) >> 1];
+
+ if(a >= 0x06000000 && a < 0x08000000)
+  return &WorkRAMH[(a & 0xFFFFF) >> 1];
+
+ return nullptr;
+}
+
+// "kernel" is one of SH2Bench_Kernels, or "file" for the raw big-endian code at "path"(which must loop itself).  The
+// code goes at "at"(low or high work RAM; cache-through addresses run uncached).  icache_mask: bit 0 runs without
+// instruction cache emulation, bit 1 with.
+bool Automation_SH2Bench(const char* kernel, const char* path, uint32 at, uint64 insns, unsigned icache_mask, std::string* report)
+{
+ std::vector<uint16> code;
+
+ if(!strcmp(kernel, "file"))
+ {
+  FILE* fp = fopen(path, "rb");
+  int c0, c1;
+
+  if(!fp)
+  {
+   *report = "cannot open " + std::string(path);
+   return false;
+  }
+
+  while((c0 = fgetc(fp)) != EOF && (c1 = fgetc(fp)) != EOF)
+   code.push_back((c0 << 8) | c1);
+
+  fclose(fp);
+ }
+ else
+ {
+  for(auto const& k : SH2Bench_Kernels)
+   if(!strcmp(kernel, k.name))
+    code = k.code;
+ }
+
+ if(code.empty())
+ {
+  *report = "unknown or empty kernel " + std::string(kernel);
+  return false;
+ }
+
+ if((at & 1) || !SH2Bench_WordPtr(at) || !SH2Bench_WordPtr(at + code.size() * 2 - 1) || ((at + code.size() * 2 - 1) ^ at) & ~0xFFFFF)
+ {
+  *report = "code doesn't fit in work RAM at the given address";
+  return false;
+ }
+
+ if(!insns || !(icache_mask & 3))
+ {
+  *report = "nothing to run";
+  return false;
+ }
+
+ std::string ret;
+
+ for(unsigned eic = 0; eic < 2; eic++)
+ {
+  if(!(icache_mask & (1U << eic)))
+   continue;
+  //
+  // Same start for each run: code, operand data and registers.
+  //
+  uint16* const p = SH2Bench_WordPtr(at);
+
+  for(size_t i = 0; i < code.size(); i++)
+   p[i] = code[i];
+
+  for(unsigned i = 0; i < 15; i++)
+   CPU[0].SetRegister(SH7095::GSREG_R0 + i, 0x9E3779B9 * (i + 1));
+
+  if(strcmp(kernel, "file"))
   {
-   try
-   {
-    SaveCartNV();
-   }
-   catch(std::exception& e)
+   const uint32 data = (at & ~0x20000000) + ((code.size() * 2 + 0xFFF) & ~0xFFF);
+
+   CPU[0].SetRegister(SH7095::GSREG_R2, 0);
+   CPU[0].SetRegister(SH7095::GSREG_R3, 0x12345);
+   CPU[0].SetRegister(SH7095::GSREG_R6, 1000);
+   CPU[0].SetRegister(SH7095::GSREG_R8, data);
+
+   if(!strcmp(kernel, "cache"))
+    CPU[0].SetRegister(SH7095::GSREG_R9, 0x400);
+   else if(!strcmp(kernel, "div"))
    {
-    MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what());
-    CartNV_SaveDelay = (int64)60 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 60 second retry delay.
+    CPU[0].SetRegister(SH7095::GSREG_R1, 7);
+    CPU[0].SetRegister(SH7095::GSREG_R10, 0xFFFFFF00);
    }
+   else
+    CPU[0].SetRegister(SH7095::GSREG_R9, data + 0x100);
   }
+  CPU[0].SetRegister(SH7095::GSREG_MACH, 0);
+  CPU[0].SetRegister(SH7095::GSREG_MACL, 0);
+  CPU[0].SetRegister(SH7095::GSREG_SR, 0xF0);
+  CPU[0].SetExtHalt(false);
+  CPU[0].SetDebugMode(false);
+  CPU[0].SetInstrumented(false);
+  CPU[0].Automation_SetEmulateICache(eic);
+  CPU[0].Automation_Jump(at, 15);
+  next_event_ts = 0x7FFFFFFF;
+  //
+  //
+  const int64 start_us = Time::MonoUS();
+  const uint64 cycles = eic ? SH2Bench_Run<true>(insns) : SH2Bench_Run<false>(insns);
+  const int64 us = Time::MonoUS() - start_us;
+  uint32 hash = 2166136261U;
+  char buf[160];
+
+  for(unsigned i = 0; i < 16; i++)
+   hash = (hash ^ CPU[0].GetRegister(SH7095::GSREG_R0 + i, nullptr, 0)) * 16777619U;
+
+  hash = (hash ^ CPU[0].GetRegister(SH7095::GSREG_MACL, nullptr, 0)) * 16777619U;
+
+  snprintf(buf, sizeof(buf), " %s: ns/insn=%.2f mips=%.1f cycles/insn=%.2f hash=%08x", eic ? "icache" : "noicache",
+	(double)us * 1000 / insns, us ? (double)insns / us : 0.0, (double)cycles / insns, hash);
+  ret += buf;
  }
+
+ CPU[0].Automation_SetEmulateICache(NeedEmuICache);
+
+ *report = " kernel=" + std::string(kernel) + " insns=" + std::to_string(insns) + ret;
+ return true;
 }
 
 static void OutputMIDI(uint8 v)
@@ -1884,6 +7386,8 @@ static void OutputMIDI(uint8 v)
 
 static MDFN_COLD void Cleanup(void)
 {
+ FastBoot.pending = FastBoot.record = false;
+
  CART_Kill();
 
  DBG_Kill();
@@ -2150,10 +7654,133 @@ static MDFN_COLD bool DetectRegionByFN(const std::string& fn, unsigned* const re
  return false;
 }
 #endif
-static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_hacks, const unsigned cart_type, const unsigned smpc_area, Stream* boot_cart_rom_stream, GameFile* gf, const STVGameInfo* sgi = nullptr)
+// Automation: cache_mode status and control.
+std::string Automation_CacheModeStatus(void)
+{
+ static const char* const reasons[] = { "assoc_purge", "ccr_purge", "alias", "smc" };
+ char buf[192];
+ std::string s = NeedEmuICache ? "full" : (CPU[0].Automation_GetCacheBypassHack() ? "data_cb" : "data");
+
+ s += std::string(" detect=") + (cem_detect_armed ? "armed" : "off");
+ if(cem_hit.reason)
+ {
+  snprintf(buf, sizeof(buf), " switched_by=%s cpu=%s addr=0x%08X pc=0x%08X cycle=%lld", reasons[MDFN_tzcount32(cem_hit.reason)], cem_hit.cpu ? "slave" : "master", cem_hit.addr, cem_hit.pc, (long long)cem_hit.cycle);
+  s += buf;
+ }
+
+ return s;
+}
+
+// mask: CEM_HIT_* to watch for; 0 disarms.  False if already in full mode.
+bool Automation_CacheModeDetect(unsigned mask)
+{
+ if(NeedEmuICache)
+  return false;
+
+ cem_detect_mask = mask;
+ cem_detect_armed = (mask != 0);
+ return true;
+}
+
+// Switch to full emulation before the next frame.
+void Automation_CacheModeFull(void)
+{
+ if(NeedEmuICache || cem_switch_pending)
+  return;
+
+ cem_hit.reason = 0;
+ cem_switch_pending = true;
+}
+
+static unsigned HotMem_Mode = SS_HOTMEM_OFF;	// backing SS_HotMem_Apply() got
+
+//
+// ss.hugepages(see hotmem.h). Called before InitCommon() fills the arena, so on the first game load an
+// untouched, 2 MiB-aligned range faults straight into huge pages; on later loads khugepaged collapses
+// what was already touched. hugetlb copies the arena onto a new MAP_HUGETLB mapping and moves that over
+// the original range, so the addresses everything holds stay valid; once moved it stays moved.
+//
+static void MDFN_COLD SS_HotMem_Apply(unsigned mode)
+{
+#ifdef __linux__
+ void* const base = &SS_HotMem;
+ const size_t size = sizeof(SS_HotMem);
+
+ if(HotMem_Mode == SS_HOTMEM_HUGETLB)
+  return;
+
+ if(mode == SS_HOTMEM_HUGETLB)
+ {
+  void* hp = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+  if(hp != MAP_FAILED)
+  {
+   memcpy(hp, base, size);
+   if(mremap(hp, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, base) != MAP_FAILED)
+   {
+    HotMem_Mode = SS_HOTMEM_HUGETLB;
+    MDFN_printf(_("Hot memory: %zu KiB on explicit huge pages.\n"), size >> 10);
+    return;
+   }
+   munmap(hp, size);
+  }
+  MDFN_printf(_("Hot memory: no explicit huge pages available, using transparent huge pages.\n"));
+  mode = SS_HOTMEM_THP;
+ }
+
+ if(mode == SS_HOTMEM_THP)
+ {
+  if(!madvise(base, size, MADV_HUGEPAGE))
+   HotMem_Mode = SS_HOTMEM_THP;
+  else
+   MDFN_printf(_("Hot memory: madvise(MADV_HUGEPAGE) failed, transparent huge pages unavailable.\n"));
+ }
+#else
+ if(mode != SS_HOTMEM_OFF)
+  MDFN_printf(_("Hot memory: huge pages aren't supported on this platform.\n"));
+#endif
+}
+
+// Automation: arena address, size, backing and how much of it is on huge pages right now(from
+// /proc/self/smaps; -1 where that isn't available).
+std::string Automation_HotMemStatus(void)
+{
+ static const char* const names[] = { "off", "thp", "hugetlb" };
+ const uintptr_t lo = (uintptr_t)&SS_HotMem;
+ const uintptr_t hi = lo + sizeof(SS_HotMem);
+ long long huge_kb = -1;
+ char buf[160];
+
+#ifdef __linux__
+ if(FILE* fp = fopen("/proc/self/smaps", "r"))
+ {
+  char line[256];
+  bool in_range = false;
+
+  huge_kb = 0;
+  while(fgets(line, sizeof(line), fp))
+  {
+   unsigned long long vlo, vhi, kb;
+
+   if(sscanf(line, "%llx-%llx ", &vlo, &vhi) == 2)	// a mapping's header line
+    in_range = vlo < hi && vhi > lo;
+   else if(in_range && (sscanf(line, "AnonHugePages: %llu kB", &kb) == 1 || sscanf(line, "Private_Hugetlb: %llu kB", &kb) == 1 || sscanf(line, "Shared_Hugetlb: %llu kB", &kb) == 1))
+    huge_kb += kb;
+  }
+  fclose(fp);
+ }
+#endif
+ snprintf(buf, sizeof(buf), "base=0x%llx size=%llu align=%llu mode=%s huge_kb=%lld", (unsigned long long)lo, (unsigned long long)sizeof(SS_HotMem),
+	(unsigned long long)SS_HotMem_Align, names[HotMem_Mode], huge_kb);
+ return buf;
+}
+
+static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_hacks, const PerfHints& perf_hints, const unsigned cart_type, const unsigned smpc_area, Stream* boot_cart_rom_stream, GameFile* gf, const STVGameInfo* sgi = nullptr)
 {
  const char* cart_rom_path_sname = nullptr;
 
+ SS_HotMem_Apply(MDFN_GetSettingUI("ss.hugepages"));
+
  //
  // Handle debug overrides for CPU cache emulation mode and horrible hacks.
  //
@@ -2161,7 +7788,15 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
   unsigned ov_cpucache_emumode = MDFN_GetSettingUI("ss.dbg_cem");
   unsigned ov_horrible_hacks = MDFN_GetSettingMultiM("ss.dbg_hh");
 
-  if(ov_cpucache_emumode != CPUCACHE_EMUMODE__COUNT)
+  cem_detect_armed = false;
+  cem_switch_pending = false;
+  memset(&cem_hit, 0, sizeof(cem_hit));
+  if(ov_cpucache_emumode == CPUCACHE_EMUMODE__COUNT + 1)	// detect: the database still wins
+  {
+   cem_detect_mask = MDFN_GetSettingMultiM("ss.dbg_cem_detect");
+   cem_detect_armed = (cpucache_emumode != CPUCACHE_EMUMODE_FULL) && cem_detect_mask;
+  }
+  else if(ov_cpucache_emumode != CPUCACHE_EMUMODE__COUNT)
    cpucache_emumode = ov_cpucache_emumode;
 
   if(ov_horrible_hacks != (unsigned)-1)
@@ -2170,6 +7805,10 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
 
 #ifdef MDFN_ENABLE_DEV_BUILD
  ss_dbg_mask = MDFN_GetSettingMultiM("ss.dbg_mask") | SS_DBG_ERROR | SS_DBG_CDB;
+ DBG_Ring.assign(MDFN_GetSettingUI("ss.dbg_defer"), DBGRec());
+ DBG_Count = 0;
+ DBG_Strings.reserve(DBG_Ring.empty() ? 0 : 1U << 16);
+ DBG_Rate = MDFN_GetSettingUI("ss.dbg_rate");
 
  static const uint32 addrs[] =
  {
@@ -2208,12 +7847,20 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
     break;
    }
   }
-  MDFN_printf(_("CPU Cache Emulation Mode: %s\n"), cem);
+  MDFN_printf(_("CPU Cache Emulation Mode: %s%s\n"), cem, cem_detect_armed ? _(", switching to Full on detection") : "");
  }
  //
  if(horrible_hacks)
   MDFN_printf(_("Horrible hacks: %s\n"), DB_GetHHDescriptions(horrible_hacks).c_str());
  //
+ // Performance profile: only ever turns things on beyond the individual settings.
+ //
+ const bool perf_profile = MDFN_GetSettingB("ss.perf_profile");
+ const PerfHints perf = perf_profile ? perf_hints : PerfHints();
+
+ if(perf_profile)
+  MDFN_printf(_("Performance profile: idle skip mask 0x%x, slave sync quantum %u, CD fast-load %u\n"), perf.idle_skip, perf.slave_quantum, perf.fast_load);
+ //
  {
   MDFN_printf(_("Region: 0x%01x\n"), smpc_area);
   const struct
@@ -2256,7 +7903,13 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
  {
   CPU[c].Init((cpucache_emumode == CPUCACHE_EMUMODE_FULL), (cpucache_emumode == CPUCACHE_EMUMODE_DATA_CB));
   CPU[c].SetMD5((bool)c);
+  CPU[c].IdleSkip = MDFN_GetSettingB("ss.sh2.idle_skip") || ((perf.idle_skip >> c) & 1);
  }
+ SlaveSyncQuantum = NeedEmuICache ? MDFN_GetSettingUI("ss.sh2.slave_quantum") : 0;
+ if(NeedEmuICache && !SlaveSyncQuantum)
+  SlaveSyncQuantum = perf.slave_quantum;
+ if(SlaveSyncQuantum)
+  MDFN_printf(_("Slave CPU sync quantum: %d cycles\n"), SlaveSyncQuantum);
  SH7095_mem_timestamp = 0;
  SH7095_DB = 0;
  automation_total_cycles = 0;
@@ -2307,6 +7960,9 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
  int sls = MDFN_GetSettingI(PAL ? "ss.slstartp" : "ss.slstart");
  int sle = MDFN_GetSettingI(PAL ? "ss.slendp" : "ss.slend");
  const uint64 vdp2_affinity = MDFN_GetSettingUI("ss.affinity.vdp2");
+ const unsigned vdp2_workers = MDFN_GetSettingUI("ss.vdp2_workers");
+ const bool vdp2_tile_cache = MDFN_GetSettingB("ss.vdp2_tile_cache");
+ const unsigned vdp1_workers = MDFN_GetSettingUI("ss.vdp1_workers");
 
  if(PAL)
  {
@@ -2412,10 +8068,13 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
  if(cart_type == CART_STV)
   STVIO_Init(sgi);
 
- VDP1::Init();
- VDP2::Init(PAL, vdp2_affinity);
+ VDP1::Init(vdp1_workers);
+ VDP2::Init(PAL, vdp2_affinity, vdp2_workers, vdp2_tile_cache);
  CDB_Init();
+ CDB_SetFastLoad(MDFN_GetSettingB("ss.cdb.fast_load") || perf.fast_load);
  SOUND_Init(cart_type == CART_STV);
+ SOUND_SetDSPMode(MDFN_GetSettingUI("ss.scsp.dsp"));
+ SOUND_SetSkipWhenSilent(MDFN_GetSettingB("ss.scsp.skip_when_silent"));
 
  {
   const unsigned midi_io = MDFN_GetSettingUI("ss.midi");
@@ -2446,6 +8105,13 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
   MDFN_printf(_("H Blend: %s\n"), h_blend ? _("Enabled") : _("Disabled"));
 
   VDP2::SetGetVideoParams(MDFNGameInfo, correct_aspect, sls, sle, h_overscan, h_blend);
+
+  const bool vdp2_preview = MDFN_GetSettingB("ss.vdp2_preview");
+
+  if(vdp2_preview)
+   MDFN_printf(_("VDP2 Preview: Enabled(not accurate)\n"));
+
+  VDP2REND_SetPreview(vdp2_preview);
  }
 
  MDFN_printf("\n");
@@ -2493,11 +8159,16 @@ static void MDFN_COLD InitCommon(unsigned cpucache_emumode, unsigned horrible_ha
   try { LoadSTVEEPROM();} catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
 
  try { LoadRTC();       } catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
- try { LoadBackupRAM(); } catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
- try { LoadCartNV();    } catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
+ NV_MemoryOnly = MDFN_GetSettingB("ss.nv_memory_only");
 
- BackupBackupRAM();
- BackupCartNV();
+ if(!NV_MemoryOnly)
+ {
+  try { LoadBackupRAM(); } catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
+  try { LoadCartNV();    } catch(MDFN_Error& e) { if(e.GetErrno() != ENOENT) throw; }
+
+  BackupBackupRAM();
+  BackupCartNV();
+ }
 
  BackupRAM_Dirty = false;
  BackupRAM_SaveDelay = 0;
@@ -2552,7 +8223,7 @@ static MDFN_COLD void LoadDBGCD(const std::string& path)
  MDFNGameInfo->RMD->Media.push_back(RMD_Media({"Test CD", 0}));
 
  DBGCDInterfaces.clear();
- DBGCDInterfaces.push_back(CDInterface::Open(&NVFS, path, false, MDFN_GetSettingUI("affinity.cd")));
+ DBGCDInterfaces.push_back(CDInterface::Open(&NVFS, path, false, false, MDFN_GetSettingUI("affinity.cd")));
  cdifs = &DBGCDInterfaces;
 }
 
@@ -2577,7 +8248,7 @@ static MDFN_COLD void Load(GameFile* gf)
 
    MDFNGameInfo->name = sgi->name;
 
-   InitCommon(CPUCACHE_EMUMODE_FULL, HORRIBLEHACK_VDP1RWDRAWSLOWDOWN, CART_STV, region, nullptr, gf, sgi);
+   InitCommon(CPUCACHE_EMUMODE_FULL, HORRIBLEHACK_VDP1RWDRAWSLOWDOWN, PerfHints(), CART_STV, region, nullptr, gf, sgi);
 
    if(sgi->rotate)
     MDFNGameInfo->rotated = MDFN_ROTATE90;
@@ -2616,7 +8287,7 @@ static MDFN_COLD void Load(GameFile* gf)
     LoadDBGCD(dbg_cdpath);
    //
    //
-   InitCommon(CPUCACHE_EMUMODE_FULL, HORRIBLEHACK_VDP1RWDRAWSLOWDOWN, CART_BOOTROM, region, gf->stream, nullptr);
+   InitCommon(CPUCACHE_EMUMODE_FULL, HORRIBLEHACK_VDP1RWDRAWSLOWDOWN, PerfHints(), CART_BOOTROM, region, gf->stream, nullptr);
   }
   else
    throw MDFN_Error(0, _("File unrecognized by \"%s\" module."), MDFNGameInfo->shortname);
@@ -2704,6 +8375,55 @@ static MDFN_COLD void DiscSanityChecks(void)
  }
 }
 
+//
+// "ss.cd_sanity_cache": a passed check is recorded in a small file next to the save files, keyed by the disc
+// set layout MD5(which covers every disc of an M3U set), so later runs of the same set skip the subchannel reads.
+//
+static const char DiscSanityCacheMagic[8] = { 'M', 'D', 'F', 'N', 'C', 'D', 'O', 'K' };
+
+static MDFN_COLD bool DiscSanityCache_Check(void)
+{
+ uint8 buf[8 + 16 + 4];
+
+ try
+ {
+  FileStream fp(MDFN_MakeFName(MDFNMKF_SAV, 0, "cdok"), FileStream::MODE_READ);
+
+  if(fp.read(buf, sizeof(buf), false) != sizeof(buf))
+   return false;
+ }
+ catch(MDFN_Error& e)
+ {
+  if(e.GetErrno() != ENOENT)
+   MDFN_Notify(MDFN_NOTICE_WARNING, _("CD sanity check cache not read: %s"), e.what());
+
+  return false;
+ }
+
+ return !memcmp(buf, DiscSanityCacheMagic, 8) && !memcmp(buf + 8, MDFNGameInfo->MD5, 16) && MDFN_de32lsb(buf + 24) == cdifs->size();
+}
+
+static MDFN_COLD void DiscSanityCache_Save(void)
+{
+ uint8 buf[8 + 16 + 4];
+
+ memcpy(buf, DiscSanityCacheMagic, 8);
+ memcpy(buf + 8, MDFNGameInfo->MD5, 16);
+ MDFN_en32lsb(buf + 24, cdifs->size());
+
+ try
+ {
+  FileStream fp(MDFN_MakeFName(MDFNMKF_SAV, 0, "cdok"), FileStream::MODE_WRITE_SAFE);
+
+  fp.write(buf, sizeof(buf));
+  fp.close();
+ }
+ catch(std::exception& e)
+ {
+  MDFN_Notify(MDFN_NOTICE_WARNING, _("CD sanity check cache not saved: %s"), e.what());
+ }
+}
+
 static MDFN_COLD void LoadCD(std::vector<CDInterface*>* CDInterfaces)
 {
  try
@@ -2714,6 +8434,7 @@ static MDFN_COLD void LoadCD(std::vector<CDInterface*>* CDInterfaces)
   int cart_type;
   unsigned cpucache_emumode;
   unsigned horrible_hacks;
+  PerfHints perf_hints = { 0x3, 64, true };
   uint8 fd_id[16];
   char sgid[16 + 1] = { 0 };
   char sgname[0x70 + 1] = { 0 };
@@ -2732,6 +8453,7 @@ static MDFN_COLD void LoadCD(std::vector<CDInterface*>* CDInterfaces)
   DetectRegion(&region);
   DB_Lookup(nullptr, sgid, sgname, sgarea, fd_id, &region, &cart_type, &cpucache_emumode);
   horrible_hacks = DB_LookupHH(sgid, fd_id);
+  DB_LookupPerf(sgid, fd_id, &perf_hints);
   //
   if(!MDFN_GetSettingB("ss.region_autodetect"))
    region = region_default;
@@ -2740,13 +8462,26 @@ static MDFN_COLD void LoadCD(std::vector<CDInterface*>* CDInterfaces)
    cart_type = ss_cart_setting;
   //
   if(MDFN_GetSettingB("ss.cd_sanity"))
-   DiscSanityChecks();
+  {
+   const bool use_cache = MDFN_GetSettingB("ss.cd_sanity_cache");
+
+   if(use_cache && DiscSanityCache_Check())
+    MDFN_printf(_("CD (image) sanity checks: passed on an earlier run.\n"));
+   else
+   {
+    DiscSanityChecks();
+
+    if(use_cache)
+     DiscSanityCache_Save();
+   }
+  }
   else
    MDFN_printf(_("WARNING: CD (image) sanity checks disabled."));
 
    // TODO: auth ID calc
 
-  InitCommon(cpucache_emumode, horrible_hacks, cart_type, region, nullptr, nullptr);
+  InitCommon(cpucache_emumode, horrible_hacks, perf_hints, cart_type, region, nullptr, nullptr);
+  FastBoot_Init(fd_id, region, cart_type);
  }
  catch(...)
  {
@@ -2758,14 +8493,18 @@ static MDFN_COLD void LoadCD(std::vector<CDInterface*>* CDInterfaces)
 static MDFN_COLD void CloseGame(void)
 {
 #ifdef MDFN_ENABLE_DEV_BUILD
+ SS_DBG_Flush();
  try { VDP1::MakeDump("/tmp/vdp1_dump.h"); } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
  try { VDP2::MakeDump("/tmp/vdp2_dump.h"); } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
 #endif
  //
  //
 
- try { SaveBackupRAM(); } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
- try { SaveCartNV();    } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
+ if(!NV_MemoryOnly)
+ {
+  try { SaveBackupRAM(); } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
+  try { SaveCartNV();    } catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
+ }
 
  if(ActiveCartType == CART_STV)
   try { SaveSTVEEPROM();} catch(std::exception& e) { MDFND_OutputNotice(MDFN_NOTICE_ERROR, e.what()); }
@@ -2784,6 +8523,27 @@ static MDFN_COLD void SaveBackupRAM(void)
  brs.close();
 }
 
+//
+// The periodic saves from Emulate() only copy the data; the state writer thread(MDFNSS_WriteAsync()) writes it to
+// <file>.tmp and renames that over the save file, so neither the emulation thread nor a crash mid-write can be hurt
+// by slow storage.  A failed write is retried after 60 seconds, as with the synchronous saves.
+//
+static MDFN_COLD void SaveBackupRAMAsync(void)
+{
+ std::unique_ptr<MemoryStream> ms(new MemoryStream(sizeof(BackupRAM)));
+
+ ms->write(BackupRAM, sizeof(BackupRAM));
+
+ MDFNSS_WriteAsync(std::move(ms), MDFN_MakeFName(MDFNMKF_SAV, 0, "bkr"), -1, [](const std::string& path, const std::string& error)
+ {
+  if(error.size())
+  {
+   MDFND_OutputNotice(MDFN_NOTICE_ERROR, error.c_str());
+   BackupRAM_SaveDelay = (int64)60 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 60 second retry delay.
+  }
+ });
+}
+
 static MDFN_COLD void LoadBackupRAM(void)
 {
  FileStream brs(MDFN_MakeFName(MDFNMKF_SAV, 0, "bkr"), FileStream::MODE_READ);
@@ -2809,19 +8569,11 @@ static MDFN_COLD void BackupCartNV(void)
   MDFN_BackupSavFile(10, ext);
 }
 
-static MDFN_COLD void LoadCartNV(void)
+static MDFN_COLD void ReadCartNV(const std::string& path, void* nv_ptr, bool nv16, uint64 nv_size)
 {
- const char* ext = nullptr;
- void* nv_ptr = nullptr;
- bool nv16 = false;
- uint64 nv_size = 0;
-
- CART_GetNVInfo(&ext, &nv_ptr, &nv16, &nv_size);
-
- if(ext)
  {
-  //FileStream nvs(MDFN_MakeFName(MDFNMKF_SAV, 0, ext), FileStream::MODE_READ);
-  GZFileStream nvs(MDFN_MakeFName(MDFNMKF_SAV, 0, ext), GZFileStream::MODE::READ);
+  //FileStream nvs(path, FileStream::MODE_READ);
+  GZFileStream nvs(path, GZFileStream::MODE::READ);
 
   nvs.read(nv_ptr, nv_size);
 
@@ -2837,6 +8589,31 @@ static MDFN_COLD void LoadCartNV(void)
  }
 }
 
+static MDFN_COLD void LoadCartNV(void)
+{
+ const char* ext = nullptr;
+ void* nv_ptr = nullptr;
+ bool nv16 = false;
+ uint64 nv_size = 0;
+
+ CART_GetNVInfo(&ext, &nv_ptr, &nv16, &nv_size);
+
+ if(ext)
+  ReadCartNV(MDFN_MakeFName(MDFNMKF_SAV, 0, ext), nv_ptr, nv16, nv_size);
+}
+
+static MDFN_COLD void WriteCartNV(Stream* nvs, const void* nv_ptr, bool nv16, uint64 nv_size)
+{
+ if(nv16)
+ {
+  // Slow...
+  for(uint64 i = 0; i < nv_size; i += 2)
+   nvs->put_BE<uint16>(MDFN_densb<uint16>((const uint8*)nv_ptr + i));
+ }
+ else
+  nvs->write(nv_ptr, nv_size);
+}
+
 static MDFN_COLD void SaveCartNV(void)
 {
  const char* ext = nullptr;
@@ -2851,17 +8628,120 @@ static MDFN_COLD void SaveCartNV(void)
   //FileStream nvs(MDFN_MakeFName(MDFNMKF_SAV, 0, ext), FileStream::MODE_WRITE_INPLACE);
   GZFileStream nvs(MDFN_MakeFName(MDFNMKF_SAV, 0, ext), GZFileStream::MODE::WRITE);
 
-  if(nv16)
+  WriteCartNV(&nvs, nv_ptr, nv16, nv_size);
+
+  nvs.close();
+ }
+}
+
+static MDFN_COLD void SaveCartNVAsync(void)
+{
+ const char* ext = nullptr;
+ void* nv_ptr = nullptr;
+ bool nv16 = false;
+ uint64 nv_size = 0;
+
+ CART_GetNVInfo(&ext, &nv_ptr, &nv16, &nv_size);
+
+ if(ext)
+ {
+  std::unique_ptr<MemoryStream> ms(new MemoryStream(nv_size));
+
+  WriteCartNV(ms.get(), nv_ptr, nv16, nv_size);
+
+  MDFNSS_WriteAsync(std::move(ms), MDFN_MakeFName(MDFNMKF_SAV, 0, ext), 6, [](const std::string& path, const std::string& error)
   {
-   // Slow...
-   for(uint64 i = 0; i < nv_size; i += 2)
-    nvs.put_BE<uint16>(MDFN_densb<uint16>((uint8*)nv_ptr + i));
+   if(error.size())
+   {
+    MDFND_OutputNotice(MDFN_NOTICE_ERROR, error.c_str());
+    CartNV_SaveDelay = (int64)60 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));	// 60 second retry delay.
+   }
+  });
+ }
+}
+
+//
+// nv_dump / nv_load: the same file formats as the .bkr and cart save files, at any path.  A load marks the
+// memory dirty, so it's also saved normally unless ss.nv_memory_only is on.
+//
+bool Automation_NVDump(const char* path, bool cart, std::string* err)
+{
+ try
+ {
+  if(cart)
+  {
+   const char* ext = nullptr;
+   void* nv_ptr = nullptr;
+   bool nv16 = false;
+   uint64 nv_size = 0;
+
+   CART_GetNVInfo(&ext, &nv_ptr, &nv16, &nv_size);
+
+   if(!ext)
+   {
+    *err = "cart has no backup memory";
+    return false;
+   }
+
+   GZFileStream nvs(path, GZFileStream::MODE::WRITE);
+
+   WriteCartNV(&nvs, nv_ptr, nv16, nv_size);
+   nvs.close();
   }
   else
-   nvs.write(nv_ptr, nv_size);
+  {
+   FileStream brs(path, FileStream::MODE_WRITE_SAFE);
 
-  nvs.close();
+   brs.write(BackupRAM, sizeof(BackupRAM));
+   brs.close();
+  }
+ }
+ catch(std::exception& e)
+ {
+  *err = e.what();
+  return false;
+ }
+
+ return true;
+}
+
+bool Automation_NVLoad(const char* path, bool cart, std::string* err)
+{
+ try
+ {
+  if(cart)
+  {
+   const char* ext = nullptr;
+   void* nv_ptr = nullptr;
+   bool nv16 = false;
+   uint64 nv_size = 0;
+
+   CART_GetNVInfo(&ext, &nv_ptr, &nv16, &nv_size);
+
+   if(!ext)
+   {
+    *err = "cart has no backup memory";
+    return false;
+   }
+
+   ReadCartNV(path, nv_ptr, nv16, nv_size);
+   CartNV_SaveDelay = NV_MemoryOnly ? 0 : (int64)3 * (MDFNGameInfo->MasterClock / MDFN_MASTERCLOCK_FIXED(1));
+  }
+  else
+  {
+   FileStream brs(path, FileStream::MODE_READ);
+
+   brs.read(BackupRAM, sizeof(BackupRAM));
+   BackupRAM_Dirty = true;
+  }
+ }
+ catch(std::exception& e)
+ {
+  *err = e.what();
+  return false;
  }
+
+ return true;
 }
 
 static MDFN_COLD void SaveSTVEEPROM(void)
@@ -2896,10 +8776,13 @@ static MDFN_COLD void LoadRTC(void)
  SMPC_LoadNV(&sds);
 }
 
+// SS_EVENT_PROFILE and SS_EVENT_TICK are left out so states stay compatible
+// with builds without them; they're relinked disabled on load and re-armed if
+// in use.
 struct EventsPacker
 {
  enum : size_t { eventcopy_first = SS_EVENT__SYNFIRST + 1 };
- enum : size_t { eventcopy_bound = SS_EVENT__SYNLAST };
+ enum : size_t { eventcopy_bound = SS_EVENT_PROFILE };
 
  bool Restore(const unsigned state_version);
  void Save(void);
@@ -2914,6 +8797,9 @@ INLINE void EventsPacker::Save(void)
 
  for(size_t i = eventcopy_first; i < eventcopy_bound; i++)
  {
+  while(evt == &events[SS_EVENT_PROFILE] || evt == &events[SS_EVENT_TICK])
+   evt = evt->next;
+
   event_times[i - eventcopy_first] = events[i].event_time;
   event_order[i - eventcopy_first] = evt - events;
   assert(event_order[i - eventcopy_first] >= eventcopy_first && event_order[i - eventcopy_first] < eventcopy_bound);
@@ -2960,6 +8846,14 @@ INLINE bool EventsPacker::Restore(const unsigned state_version)
   evt->next->prev = evt;
   evt = evt->next;
  }
+ events[SS_EVENT_PROFILE].event_time = SS_EVENT_DISABLED_TS;
+ evt->next = &events[SS_EVENT_PROFILE];
+ evt->next->prev = evt;
+ evt = evt->next;
+ events[SS_EVENT_TICK].event_time = SS_EVENT_DISABLED_TS;
+ evt->next = &events[SS_EVENT_TICK];
+ evt->next->prev = evt;
+ evt = evt->next;
  evt->next = &events[SS_EVENT__SYNLAST];
  evt->next->prev = evt;
 
@@ -3104,10 +8998,21 @@ static MDFN_COLD void StateAction(StateMem* sm, const unsigned load, const bool
    InitEvents();
   }
 
+  if(RecordedNeedEmuICache && !NeedEmuICache && (cem_detect_armed || cem_switch_pending))
+   CEM_SwitchToFull(false);
   CPU[0].PostStateLoad(load, RecordedNeedEmuICache, NeedEmuICache);
   CPU[1].PostStateLoad(load, RecordedNeedEmuICache, NeedEmuICache);
 
   shadow_stack_depth[0] = shadow_stack_depth[1] = 0;
+
+  if(fprof_active)
+   FProf_Resync();
+
+  if(profile_active)
+   SS_SetEventNT(&events[SS_EVENT_PROFILE], SH7095_mem_timestamp + profile_interval);
+
+  if(tick_hook)
+   SS_SetEventNT(&events[SS_EVENT_TICK], SH7095_mem_timestamp + tick_interval);
  }
 }
 
@@ -3207,6 +9112,24 @@ static const MDFNSetting_EnumList Region_List[] =
  { NULL, 0 },
 };
 
+static const MDFNSetting_EnumList SCSPDSP_List[] =
+{
+ { "interp", SS_SCSP::DSP_MODE_INTERP, gettext_noop("Interpreter") },
+ { "cached", SS_SCSP::DSP_MODE_CACHED, gettext_noop("Predecoded program cache") },
+ { "compare", SS_SCSP::DSP_MODE_COMPARE, gettext_noop("Run both and compare (debug)") },
+
+ { NULL, 0 },
+};
+
+static const MDFNSetting_EnumList HugePages_List[] =
+{
+ { "off", SS_HOTMEM_OFF, gettext_noop("Normal pages") },
+ { "thp", SS_HOTMEM_THP, gettext_noop("Transparent huge pages") },
+ { "hugetlb", SS_HOTMEM_HUGETLB, gettext_noop("Explicit huge pages, else transparent") },
+
+ { NULL, 0 },
+};
+
 static const MDFNSetting_EnumList RTCLang_List[] =
 {
  { "english", SMPC_RTC_LANG_ENGLISH, gettext_noop("English") },
@@ -3317,6 +9240,20 @@ static const MDFNSetting_EnumList CEM_List[] =
  { "full",	CPUCACHE_EMUMODE_FULL,		gettext_noop("Full") },
 
  { "auto",	CPUCACHE_EMUMODE__COUNT,	gettext_noop("Auto") },
+ { "detect",	CPUCACHE_EMUMODE__COUNT + 1,	gettext_noop("Auto, then Full once ss.dbg_cem_detect sees the need") },
+
+ { NULL, 0 },
+};
+
+static const MDFNSetting_EnumList CEMDetect_List[] =
+{
+ { "0",			0								},
+ { "none",		0,				gettext_noop("None")		},
+
+ { "assoc_purge",	CEM_HIT_ASSOC_PURGE,	gettext_noop("Associative cache purge") },
+ { "ccr_purge",		CEM_HIT_CCR_PURGE,	gettext_noop("Whole-cache purge via CCR, outside the BIOS, with the cache enabled") },
+ { "alias",		CEM_HIT_ALIAS,		gettext_noop("Cache-through write to a line the writing CPU has cached") },
+ { "smc",		CEM_HIT_SMC,		gettext_noop("Write within 32 bytes past either CPU's PC") },
 
  { NULL, 0 },
 };
@@ -3346,10 +9283,24 @@ static const MDFNSetting SSSettings[] =
  { "ss.bios_stv_jp", MDFNSF_EMU_STATE | MDFNSF_CAT_PATH, gettext_noop("Path to the Japan ST-V ROM BIOS"), NULL, MDFNST_STRING, "epr-20091.ic8" },
  { "ss.bios_stv_na", MDFNSF_EMU_STATE | MDFNSF_CAT_PATH, gettext_noop("Path to the North America ST-V ROM BIOS"), NULL, MDFNST_STRING, "epr-17952a.ic8" },
  { "ss.bios_stv_eu", MDFNSF_EMU_STATE | MDFNSF_CAT_PATH, gettext_noop("Path to the Europe ST-V ROM BIOS"), NULL, MDFNST_STRING, "epr-17954a.ic8" },
+ { "ss.stv_rom_cache", MDFNSF_CAT_PATH, gettext_noop("Directory for memory-mapped ST-V ROM images."), gettext_noop("When set, an ST-V game's ROM set is converted once into a cache file in this directory(relative to the Mednafen base directory), which later loads memory-map instead of reading and converting the ROM files; instances running the same game share the mapped pages.  Cache files are keyed by the ROM files' names, sizes and modification times.  Empty disables the cache.  Not supported on Windows."), MDFNST_STRING, "" },
 
  { "ss.scsp.resamp_quality", MDFNSF_NOFLAGS, gettext_noop("SCSP output resampler quality."),
 	gettext_noop("0 is lowest quality and CPU usage, 10 is highest quality and CPU usage.  The resampler that this setting refers to is used for converting from 44.1KHz to the sampling rate of the host audio device Mednafen is using.  Changing Mednafen's output rate, via the \"\5sound.rate\" setting, to \"44100\" may bypass the resampler, which can decrease CPU usage by Mednafen, and can increase or decrease audio quality, depending on various operating system and hardware factors."), MDFNST_UINT, "4", "0", "10" },
 
+ { "ss.hugepages", MDFNSF_NOFLAGS, gettext_noop("Huge page backing for hot emulated memory."), gettext_noop("Work RAM, VDP1/VDP2 VRAM, the VDP1 framebuffers and the SH-2 fast map share one 2 MiB-aligned block; huge pages cut TLB misses in the bus and render paths.  \"thp\" advises the block for transparent huge pages.  \"hugetlb\" moves it onto pages reserved in /proc/sys/vm/nr_hugepages, falling back to \"thp\".  Linux only; once a game has run on hugetlb pages the block stays there until exit."), MDFNST_ENUM, "off", NULL, NULL, NULL, NULL, HugePages_List },
+ { "ss.scsp.dsp", MDFNSF_NOFLAGS, gettext_noop("SCSP DSP execution mode."), gettext_noop("\"cached\" decodes each DSP program step once and reuses it until the program is rewritten, instead of decoding all 128 steps every sample.  \"compare\" runs the interpreter and the cached path on every sample, keeps the cached result, and reports how many samples disagreed at exit; it is much slower and meant for debugging."), MDFNST_ENUM, "cached", NULL, NULL, NULL, NULL, SCSPDSP_List },
+
+ { "ss.scsp.skip_when_silent", MDFNSF_NOFLAGS, gettext_noop("Skip SCSP sample generation while sound output is disabled."), gettext_noop("When no sound is being output, the SCSP still runs its timers, interrupts, DMA and slot playback positions, so the sound CPU and games polling the SCSP behave the same, but it does not fetch waveform data, run the DSP, or mix.  DSP writes to sound RAM, and the slot modulation stack, are not updated while this is in effect, so don't use it for movie recording or netplay, or when comparing states against a run with sound on."), MDFNST_BOOL, "0" },
+
+ { "ss.sh2.idle_skip", MDFNSF_EMU_STATE, gettext_noop("Skip SH-2 idle polling loops."), gettext_noop("Detects short loops that only poll SMPC, CD block, VDP1, VDP2 or SCU registers(or work RAM and the FRT status register, for the slave CPU, or for the master CPU while the slave is off) and otherwise only change registers, and once a pass repeats with the same registers and timing, advances the CPU timestamp by whole passes up to the next event.  Polled values are the same as without skipping, but bus contention between the two CPUs during the skipped passes isn't emulated, and a write by the slave CPU to a register the master is polling is seen up to one event late.  Leave disabled when comparing traces or timing against a run without it."), MDFNST_BOOL, "0" },
+ { "ss.sh2.slave_quantum", MDFNSF_EMU_STATE, gettext_noop("Slave SH-2 sync quantum, in cycles."), gettext_noop("With full cache emulation, the slave CPU is normally run up to the master after every master instruction.  A nonzero value lets it fall behind by up to this many cycles instead, which saves host time when the master is running out of its cache.  The slave is still brought up to date before each master access outside the CPU(work RAM, the other chips, the FRT input capture trigger) and before each scheduler event, so the master sees the same slave writes and both CPUs the same interrupts; bus contention timing between the two CPUs can still differ slightly.  No effect with the other cache emulation modes, where the master doesn't synchronize on its bus accesses."), MDFNST_UINT, "0", "0", "4096" },
+ { "ss.perf_profile", MDFNSF_EMU_STATE, gettext_noop("Turn on speed settings per game."), gettext_noop("Enables idle loop skipping(\"ss.sh2.idle_skip\"), a slave CPU sync quantum(\"ss.sh2.slave_quantum\") and CD fast-load(\"ss.cdb.fast_load\") for CD games, except for what the performance profile database keeps off for a game.  A nonzero setting of any of those still applies as usual.  Not used for ST-V games or bootable ROMs."), MDFNST_BOOL, "0" },
+ { "ss.nv_memory_only", MDFNSF_NOFLAGS, gettext_noop("Keep backup RAM and cart backup memory in memory only."), gettext_noop("Internal backup RAM and cart backup memory start out blank and are never read from or written to the save directory; save states still contain them.  Meant for automation runs, which can use the nv_dump and nv_load commands instead."), MDFNST_BOOL, "0" },
+ { "ss.fastboot", MDFNSF_NOFLAGS, gettext_noop("Skip the BIOS boot sequence after the first boot of a CD game."), gettext_noop("The first time a game is booted, a state is saved to the save state directory once the game's first executable starts running.  Later boots load that state instead of going through the BIOS animation and disc check.  The state is specific to the BIOS image, disc, region and cart type; delete it to record it again, e.g. after changing other emulation settings.  Not used for ST-V games or bootable ROMs."), MDFNST_BOOL, "0" },
+
+ { "ss.cdb.fast_load", MDFNSF_EMU_STATE, gettext_noop("Shorten CD seek and data read times."), gettext_noop("Seeks and data sector reads take 1/8 of their normal time, so loading is about 8x faster; CD-DA tracks still play in real time.  The CD block's buffering and interrupt sequence is the same as without it, but games that time their loading, or that stream video or audio from data sectors, may behave differently.  Save states record whether this was enabled, and loading one made with the other setting prints a warning; don't mix it with normal runs when recording movies or comparing against them."), MDFNST_BOOL, "0" },
+
  { "ss.region_autodetect", MDFNSF_EMU_STATE | MDFNSF_UNTRUSTED_SAFE, gettext_noop("Attempt to auto-detect region of game."), NULL, MDFNST_BOOL, "1" },
  { "ss.region_default", MDFNSF_EMU_STATE | MDFNSF_UNTRUSTED_SAFE, gettext_noop("Default region to use."), gettext_noop("Used if region autodetection fails or is disabled."), MDFNST_ENUM, "jp", NULL, NULL, NULL, NULL, Region_List },
 
@@ -3386,6 +9337,7 @@ static const MDFNSetting SSSettings[] =
  { "ss.bios_sanity", MDFNSF_NOFLAGS, gettext_noop("Enable BIOS ROM image sanity checks."), NULL, MDFNST_BOOL, "1" },
 
  { "ss.cd_sanity", MDFNSF_NOFLAGS, gettext_noop("Enable CD (image) sanity checks."), NULL, MDFNST_BOOL, "1" },
+ { "ss.cd_sanity_cache", MDFNSF_NOFLAGS, gettext_noop("Remember passed CD (image) sanity checks."), gettext_noop("Records a passed \"\5ss.cd_sanity\" check in a small \".cdok\" file with the save files, keyed by the disc layout MD5 of the whole disc set, and skips the check on later loads of the same set.  Delete the file, or disable this setting, to check again after changing an image's subchannel data without changing its TOC."), MDFNST_BOOL, "1" },
 
  { "ss.slstart", MDFNSF_NOFLAGS, gettext_noop("First displayed scanline in NTSC mode."), NULL, MDFNST_INT, "0", "0", "239" },
  { "ss.slend", MDFNSF_NOFLAGS, gettext_noop("Last displayed scanline in NTSC mode."), NULL, MDFNST_INT, "239", "0", "239" },
@@ -3394,20 +9346,28 @@ static const MDFNSetting SSSettings[] =
 
  { "ss.h_blend", MDFNSF_NOFLAGS, gettext_noop("Enable horizontal blend(blur) filter."), gettext_noop("Intended for use in combination with the \"goat\" OpenGL shader, or with bilinear interpolation or linear interpolation on the X axis enabled.  Has a more noticeable effect with the Saturn's higher horizontal resolution modes(640/704)."), MDFNST_BOOL, "0" },
 
+ { "ss.vdp2_preview", MDFNSF_NOFLAGS, gettext_noop("Draw only every other line(preview quality, not accurate)."), gettext_noop("Odd lines repeat the line above instead of being drawn, for roughly half the rendering cost; meant for bots and thumbnails of many instances.  Only the output is affected, never emulation or save states."), MDFNST_BOOL, "0" },
+
  { "ss.correct_aspect", MDFNSF_NOFLAGS, gettext_noop("Correct aspect ratio."), gettext_noop("Disabling aspect ratio correction with this setting should be considered a hack.\n\nIf disabling it to allow for sharper pixels by also separately disabling interpolation(though using Mednafen's \"autoipsharper\" OpenGL shader is usually a better option), remember to use scale factors that are multiples of 2, or else games that use high-resolution and interlaced modes will have distorted pixels.\n\nDisabling aspect ratio correction with this setting will allow for the QuickTime movie recording feature to produce much smaller files using much less CPU time."), MDFNST_BOOL, "1" },
 
  { "ss.slstartp", MDFNSF_NOFLAGS, gettext_noop("First displayed scanline in PAL mode."), NULL, MDFNST_INT, "0", "-16", "271" },
  { "ss.slendp", MDFNSF_NOFLAGS, gettext_noop("Last displayed scanline in PAL mode."), NULL, MDFNST_INT, "255", "-16", "271" },
 
  { "ss.affinity.vdp2", MDFNSF_NOFLAGS, gettext_noop("VDP2 rendering thread CPU affinity mask."), gettext_noop("Set to 0 to disable changing affinity."), MDFNST_UINT, "0", "0x0000000000000000", "0xFFFFFFFFFFFFFFFF" },
+ { "ss.vdp1_workers", MDFNSF_NOFLAGS, gettext_noop("Number of helper threads writing VDP1 framebuffer pixels."), gettext_noop("VDP1 commands, and their timing, are still processed on the emulation thread, but the resulting framebuffer writes are queued and applied by this many helper threads, each owning every Nth band of 8 framebuffer lines.  The queues are drained before the CPUs or the debugger access the framebuffer, and before a framebuffer swap.  Output is identical for any value; 0 writes pixels directly."), MDFNST_UINT, "0", "0", "3" },
+ { "ss.vdp2_workers", MDFNSF_NOFLAGS, gettext_noop("Number of helper threads drawing VDP2 NBG layers."), gettext_noop("Each line's NBG0-NBG3 layers are split between the VDP2 rendering thread and this many helper threads, which busy-wait while a frame is being rendered.  Output is identical for any value; 0 renders everything on the VDP2 rendering thread."), MDFNST_UINT, "0", "0", "3" },
+ { "ss.vdp2_tile_cache", MDFNSF_NOFLAGS, gettext_noop("Cache decoded VDP2 NBG cell rows."), gettext_noop("Reuses the decoded pixels of NBG character cells whose VRAM, palette and layer settings haven't changed since they were last drawn.  Helps mostly static tiled backgrounds; output is identical either way."), MDFNST_BOOL, "0" },
 
 #ifdef MDFN_ENABLE_DEV_BUILD
  { "ss.dbg_mask", MDFNSF_SUPPRESS_DOC, gettext_noop("Debug printf mask."), NULL, MDFNST_MULTI_ENUM, "none", NULL, NULL, NULL, NULL, DBGMask_List },
+ { "ss.dbg_defer", MDFNSF_SUPPRESS_DOC, gettext_noop("Debug messages recorded per frame and printed after it."), gettext_noop("0 prints each message as it happens."), MDFNST_UINT, "0", "0", "1048576" },
+ { "ss.dbg_rate", MDFNSF_SUPPRESS_DOC, gettext_noop("Most debug messages per call site per frame."), gettext_noop("0 is unlimited."), MDFNST_UINT, "0", "0", "1000000" },
 #endif
 
  { "ss.dbg_exe_cdpath", MDFNSF_SUPPRESS_DOC | MDFNSF_CAT_PATH, gettext_noop("CD image to use with bootable cart ROM image loading."), NULL, MDFNST_STRING, "" },
 
  { "ss.dbg_cem", MDFNSF_SUPPRESS_DOC | MDFNSF_NONPERSISTENT, gettext_noop("Cache emulation mode debug override."), NULL, MDFNST_ENUM, "auto", NULL, NULL, NULL, NULL, CEM_List },
+ { "ss.dbg_cem_detect", MDFNSF_SUPPRESS_DOC, gettext_noop("What makes ss.dbg_cem detect switch to full cache emulation."), NULL, MDFNST_MULTI_ENUM, "assoc_purge,alias,smc", NULL, NULL, NULL, NULL, CEMDetect_List },
  { "ss.dbg_hh", MDFNSF_SUPPRESS_DOC | MDFNSF_NONPERSISTENT, gettext_noop("Horrible hacks debug override."), NULL, MDFNST_MULTI_ENUM, "auto", NULL, NULL, NULL, NULL, HH_List },
 
  { NULL },
@@ -93,9 +93,11 @@ namespace MDFN_IEN_SS
 #ifdef MDFN_ENABLE_DEV_BUILD
  void SS_DBG(uint32 which, const char* format, ...);
  void SS_DBGTI(uint32 which, const char* format, ...);
+ void SS_DBGV(uint32 which, const char* format, va_list ap);
 #else
  static INLINE void SS_DBG(uint32 which, const char* format, ...) { }
  static INLINE void SS_DBGTI(uint32 which, const char* format, ...) { }
+ static INLINE void SS_DBGV(uint32 which, const char* format, va_list ap) { }
 #endif
 
  template<unsigned which>
@@ -107,7 +109,7 @@ namespace MDFN_IEN_SS
 
    va_start(ap, format);
 
-   trio_vprintf(format, ap);
+   SS_DBGV(which, format, ap);
 
    va_end(ap);
   }
@@ -147,6 +149,9 @@ namespace MDFN_IEN_SS
   SS_EVENT_CART,
 
   SS_EVENT_MIDSYNC,
+
+  SS_EVENT_PROFILE,	// automation sampling profiler; not saved in states, keep last
+  SS_EVENT_TICK,	// automation periodic callback; not saved in states either
   //
   //
   //
@@ -179,6 +184,23 @@ namespace MDFN_IEN_SS
  void SS_SetPhysMemMap(uint32 Astart, uint32 Aend, uint16* ptr, uint32 length, bool is_writeable = false) MDFN_COLD;
 
  void SS_Reset(bool powering_up) MDFN_COLD;
+
+ // Delay between polls of a spin-waiting helper thread.
+ static INLINE void SS_BusyWaitDelay(void)
+ {
+ #ifdef MDFN_SS_BUSYWAIT_PAUSE
+  asm volatile("pause\n\tpause\n\tpause\n\tpause\n\tpause\n\tpause\n\tpause\n\t");
+ #else
+  for(int i = 1000; i; i--)
+  {
+   #ifdef _MSC_VER
+   __nop();
+   #else
+   asm volatile("nop\n\t");
+   #endif
+  }
+ #endif
+ }
 }
 
 #endif
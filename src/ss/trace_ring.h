@@ -0,0 +1,279 @@
+/* trace_ring.h -- Asynchronous ring-buffered writer for automation trace sinks
+ *
+ * Single-producer (the emulation thread) / single-consumer (a background
+ * writer thread) byte ring in front of a FILE*. Producers never block and
+ * never touch stdio: a record that doesn't fit is dropped and counted.
+ * The writer thread drains in large chunks with fwrite().
+ *
+ * A ring can also be created in synchronous mode around a FILE* it doesn't
+ * own; Write() then goes straight to fwrite(). This lets a sink interleave
+ * into a file that other code still writes with plain stdio (the unified
+ * trace) without reordering lines.
+ *
+ * With zblocks set, the writer thread deflates each drained chunk and writes
+ * it as a block: le32 raw_len, le32 comp_len, then comp_len bytes of zlib
+ * data. Position() still counts uncompressed bytes, so offsets recorded by
+ * the producer (e.g. a seek index) are logical stream offsets.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_TRACE_RING_H
+#define __MDFN_SS_TRACE_RING_H
+
+#include <mednafen/types.h>
+#include <mednafen/MThreading.h>
+#include <mednafen/Time.h>
+#include <mednafen/endian.h>
+#include <zlib.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+namespace MDFN_IEN_SS
+{
+
+class TraceRing
+{
+ public:
+
+ enum : size_t { Default_Capacity = (size_t)1 << 23 };	// 8MB
+ enum : size_t { Chunk_Size = (size_t)1 << 16 };		// writer drains in 64KB pieces
+
+ // async=true: takes ownership of fp (closed by the destructor).
+ // async=false: fp is borrowed; writes are synchronous.
+ // zblocks: deflate chunks on the writer thread (async only).
+ TraceRing(FILE* fp_arg, bool async_arg = true, size_t capacity = Default_Capacity, bool zblocks_arg = false)
+	: fp(fp_arg), async(async_arg), zblocks(async_arg && zblocks_arg)
+ {
+  wpos.store(0, std::memory_order_relaxed);
+  rpos.store(0, std::memory_order_relaxed);
+  dropped.store(0, std::memory_order_relaxed);
+  exiting.store(false, std::memory_order_relaxed);
+  flush_req.store(false, std::memory_order_relaxed);
+
+  if(!async)
+   return;
+
+  size_t cap = Chunk_Size;
+  while(cap < capacity)
+   cap <<= 1;
+  size = cap;
+  mask = cap - 1;
+  buf = (uint8*)malloc(cap);
+
+  if(zblocks)
+  {
+   zraw = (uint8*)malloc(Chunk_Size);
+   zout_size = compressBound(Chunk_Size);
+   zout = (uint8*)malloc(zout_size);
+  }
+
+  // Left buffered: chunk-sized fwrite()s bypass the stdio buffer anyway,
+  // and the owner may already have written a file header through it.
+  wake_sem = Mednafen::MThreading::Sem_Create();
+  thread = Mednafen::MThreading::Thread_Create(ThreadEntry, this, "TraceRing");
+ }
+
+ ~TraceRing()
+ {
+  if(!async)
+   return;
+
+  exiting.store(true, std::memory_order_release);
+  Mednafen::MThreading::Sem_Post(wake_sem);
+  Mednafen::MThreading::Thread_Wait(thread, nullptr);
+  Mednafen::MThreading::Sem_Destroy(wake_sem);
+  free(buf);
+  free(zraw);
+  free(zout);
+  fclose(fp);
+ }
+
+ // Returns false if the record was dropped.
+ INLINE bool Write(const void* data, size_t len)
+ {
+  if(!async)
+  {
+   fwrite(data, 1, len, fp);
+   return true;
+  }
+
+  const size_t w = wpos.load(std::memory_order_relaxed);
+  const size_t r = rpos.load(std::memory_order_acquire);
+
+  if(MDFN_UNLIKELY(len > size - (w - r)))
+  {
+   dropped.fetch_add(1, std::memory_order_relaxed);
+   return false;
+  }
+
+  const size_t off = w & mask;
+  const size_t first = std::min<size_t>(len, size - off);
+  memcpy(buf + off, data, first);
+  if(first != len)
+   memcpy(buf, (const uint8*)data + first, len - first);
+
+  wpos.store(w + len, std::memory_order_release);
+
+  // Kick the writer each time a full chunk becomes available.
+  if(((w ^ (w + len)) & ~(size_t)(Chunk_Size - 1)))
+   Mednafen::MThreading::Sem_Post(wake_sem);
+
+  return true;
+ }
+
+ void Printf(const char* format, ...) MDFN_FORMATSTR(gnu_printf, 2, 3)
+ {
+  char tmp[512];
+  va_list ap;
+
+  va_start(ap, format);
+  int n = vsnprintf(tmp, sizeof(tmp), format, ap);
+  va_end(ap);
+
+  if(n < 0)
+   return;
+
+  if((size_t)n < sizeof(tmp))
+  {
+   Write(tmp, n);
+   return;
+  }
+
+  char* big = (char*)malloc(n + 1);
+  va_start(ap, format);
+  vsnprintf(big, n + 1, format, ap);
+  va_end(ap);
+  Write(big, n);
+  free(big);
+ }
+
+ // Block until everything written so far has reached the file.
+ void Flush(void)
+ {
+  if(!async)
+  {
+   fflush(fp);
+   return;
+  }
+
+  const size_t target = wpos.load(std::memory_order_acquire);
+  flush_req.store(true, std::memory_order_release);
+  Mednafen::MThreading::Sem_Post(wake_sem);
+  while(rpos.load(std::memory_order_acquire) < target)
+   Mednafen::Time::SleepMS(1);
+  flush_req.store(false, std::memory_order_release);
+ }
+
+ // Number of records rejected because the ring was full.
+ INLINE uint64 Dropped(void) const { return dropped.load(std::memory_order_relaxed); }
+
+ INLINE bool IsAsync(void) const { return async; }
+
+ // Uncompressed bytes accepted so far (producer side; async only).
+ INLINE uint64 Position(void) const { return wpos.load(std::memory_order_relaxed); }
+
+ private:
+
+ static int ThreadEntry(void* data)
+ {
+  ((TraceRing*)data)->WriterLoop();
+  return 0;
+ }
+
+ void WriterLoop(void)
+ {
+  for(;;)
+  {
+   const bool last = exiting.load(std::memory_order_acquire);
+   const size_t r = rpos.load(std::memory_order_relaxed);
+   const size_t w = wpos.load(std::memory_order_acquire);
+   size_t avail = w - r;
+
+   if(!avail)
+   {
+    if(last)
+     break;
+    Mednafen::MThreading::Sem_TimedWait(wake_sem, 10);
+    continue;
+   }
+
+   // Prefer whole chunks; short tails are written once the producer has
+   // gone quiet for a wait period (or on flush/exit).
+   if(avail < Chunk_Size && !last && !flush_req.load(std::memory_order_acquire)
+	&& Mednafen::MThreading::Sem_TimedWait(wake_sem, 10))
+    continue;
+
+   const size_t off = r & mask;
+   size_t n;
+
+   if(zblocks)
+   {
+    n = std::min<size_t>(avail, Chunk_Size);
+    WriteBlock(r, n);
+   }
+   else
+   {
+    n = std::min<size_t>(avail, size - off);
+    fwrite(buf + off, 1, n, fp);
+   }
+   rpos.store(r + n, std::memory_order_release);
+  }
+  fflush(fp);
+ }
+
+ void WriteBlock(size_t r, size_t n)
+ {
+  const size_t off = r & mask;
+  const uint8* src = buf + off;
+
+  if(n > size - off)
+  {
+   const size_t first = size - off;
+   memcpy(zraw, buf + off, first);
+   memcpy(zraw + first, buf, n - first);
+   src = zraw;
+  }
+
+  uLongf clen = zout_size;
+  uint8 hdr[8];
+
+  if(compress2(zout, &clen, src, n, 1) != Z_OK)
+   clen = 0;	// comp_len == 0: block stored uncompressed
+
+  Mednafen::MDFN_en32lsb(&hdr[0], n);
+  Mednafen::MDFN_en32lsb(&hdr[4], clen);
+  fwrite(hdr, 1, sizeof(hdr), fp);
+  fwrite(clen ? zout : src, 1, clen ? clen : n, fp);
+ }
+
+ FILE* fp;
+ const bool async;
+ const bool zblocks;
+ uint8* buf = nullptr;
+ uint8* zraw = nullptr;
+ uint8* zout = nullptr;
+ size_t zout_size = 0;
+ size_t size = 0;
+ size_t mask = 0;
+ Mednafen::MThreading::Sem* wake_sem = nullptr;
+ Mednafen::MThreading::Thread* thread = nullptr;
+
+ // Producer and consumer positions on separate cache lines (padding rather
+ // than alignas, since operator new here doesn't honor extended alignment).
+ uint8 pad0[64];
+ std::atomic<size_t> wpos;	// producer-owned
+ uint8 pad1[64];
+ std::atomic<size_t> rpos;	// consumer-owned
+ uint8 pad2[64];
+ std::atomic<uint64> dropped;
+ std::atomic<bool> exiting;
+ std::atomic<bool> flush_req;
+};
+
+}
+
+#endif
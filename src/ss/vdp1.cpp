@@ -41,10 +41,19 @@
 #include "ss.h"
 #include <mednafen/mednafen.h>
 #include <mednafen/FileStream.h>
+#include <mednafen/MThreading.h>
 #include "scu.h"
 #include "vdp1.h"
 #include "vdp2.h"
 #include "vdp1_common.h"
+#include "automation_ss.h"
+#include "zblock.h"
+
+#include <chrono>
+#include <bitset>
+
+// Defined in drivers/automation.cpp (global namespace)
+void Automation_VDP1CmdBreakHit(uint32_t addr, uint16_t cmdctrl, const char* type);
 
 enum : int { VDP1_UpdateTimingGran = 263 };
 enum : int { VDP1_IdleTimingGran = 1019 };
@@ -116,8 +125,140 @@ static uint32 EraseYCounter;
 static uint32 InstantDrawSanityLimit; // ss_horrible_hacks
 #endif
 
-uint16 VRAM[0x40000];
-uint16 FB[2][0x20000];
+uint64 VRAMDirty[0x80000 / 32 / 64];	// one bit per 32 bytes of VRAM written since TakeVRAMDirty()
+//
+//
+//
+unsigned FBWorkerCount;
+FBOpQueue FBOpQueues[3];
+uint8 FBOpLineWorker[0x100];
+static MThreading::Thread* FBWorkers[3];
+static MThreading::Sem* FBWorkerSem[3];
+static std::atomic_bool FBWorkersExit;
+
+static INLINE void ApplyFBOp(const FBOp& op)
+{
+ uint16* const fb = &FB[0][0];
+
+ switch(op.kind)
+ {
+  case FBOP_W16:
+	fb[op.dst] = op.pix;
+	break;
+
+  case FBOP_MSB16:
+	fb[op.dst] |= 0x8000;
+	break;
+
+  case FBOP_HALF16:
+	{
+	 const uint16 bg_pix = fb[op.dst];
+
+	 if(bg_pix & 0x8000)
+	  fb[op.dst] = ((op.pix + bg_pix) - ((op.pix ^ bg_pix) & 0x8421)) >> 1;
+	 else
+	  fb[op.dst] = op.pix;
+	}
+	break;
+
+  case FBOP_SHADOW16:
+	{
+	 const uint16 bg_pix = fb[op.dst];
+
+	 if(bg_pix & 0x8000)
+	  fb[op.dst] = ((bg_pix & 0x7BDE) >> 1) | 0x8000;
+	}
+	break;
+
+  case FBOP_W8:
+	ne16_wbo_be<uint8>(fb, op.dst, op.pix);
+	break;
+
+  case FBOP_MSB8:
+	ne16_wbo_be<uint8>(fb, op.dst, (fb[((op.dst >> 10) << 9) + ((op.pix >> 1) & 0x1FF)] | 0x8000) >> (((op.pix & 1) ^ 1) << 3));
+	break;
+ }
+}
+
+static int FBWorkerEntry(void* data)
+{
+ FBOpQueue* const q = (FBOpQueue*)data;
+ MThreading::Sem* const sem = FBWorkerSem[q - FBOpQueues];
+ uint32 r = q->rpos.load(std::memory_order_relaxed);
+ unsigned spins = 0;
+
+ for(;;)
+ {
+  const uint32 w = q->wpos.load(std::memory_order_acquire);
+
+  if(w == r)
+  {
+   if(MDFN_UNLIKELY(FBWorkersExit.load(std::memory_order_acquire)))
+    return 0;
+
+   // Spin for about a millisecond, then sleep until FBOpQueuePublish() or SyncFB() has more.
+   if(spins < 2048)
+   {
+    SS_BusyWaitDelay();
+    spins++;
+   }
+   else
+   {
+    q->sleeping.store(true, std::memory_order_seq_cst);
+    if(q->wpos.load(std::memory_order_seq_cst) == r)
+     MThreading::Sem_TimedWait(sem, 1);
+    q->sleeping.store(false, std::memory_order_relaxed);
+   }
+   continue;
+  }
+
+  do
+  {
+   ApplyFBOp(q->ops[r & (FBOpQueue_Size - 1)]);
+   r++;
+
+   if(!(r & 0x3FF))
+    q->rpos.store(r, std::memory_order_release);
+  } while(r != w);
+
+  q->rpos.store(r, std::memory_order_release);
+  spins = 0;
+ }
+
+ return 0;
+}
+
+void FBOpQueuePublish(FBOpQueue* q)
+{
+ q->wpos.store(q->wpos_local, std::memory_order_seq_cst);
+
+ if(q->sleeping.load(std::memory_order_seq_cst))
+  MThreading::Sem_Post(FBWorkerSem[q - FBOpQueues]);
+}
+
+void FBOpQueueWait(FBOpQueue* q)
+{
+ FBOpQueuePublish(q);
+
+ while((uint32)(q->wpos_local - (q->rpos_cached = q->rpos.load(std::memory_order_acquire))) >= FBOpQueue_Size)
+  SS_BusyWaitDelay();
+}
+
+void SyncFB(void)
+{
+ for(unsigned i = 0; i < FBWorkerCount; i++)
+ {
+  FBOpQueue* const q = &FBOpQueues[i];
+
+  if(q->rpos_cached == q->wpos_local)
+   continue;
+
+  FBOpQueuePublish(q);
+
+  while((q->rpos_cached = q->rpos.load(std::memory_order_acquire)) != q->wpos_local)
+   SS_BusyWaitDelay();
+ }
+}
 //
 //
 //
@@ -133,17 +274,17 @@ static VRAMUsageInfo VRAMWrites[0x40000];
 static uint64 VRAMUsageTSBase;
 static uint64 VRAMUsageStartTS;
 
-static void VRAMUsageInit(void)
+static void VRAMRaceInit(void)
 {
  VRAMUsageTSBase = 0;
 }
 
-static void VRAMUsageAddBaseTime(int32 amount)
+static void VRAMRaceAddBaseTime(int32 amount)
 {
  VRAMUsageTSBase += amount;
 }
 
-static void VRAMUsageStart(void)
+static void VRAMRaceStart(void)
 {
  if(MDFN_UNLIKELY(ss_dbg_mask & SS_DBG_VDP1_RACE))
  {
@@ -159,7 +300,7 @@ static void VRAMUsageStart(void)
  VRAMUsageStartTS = VRAMUsageTSBase;
 }
 
-static void VRAMUsageWrite(uint32 A)
+static void VRAMRaceWrite(uint32 A)
 {
  if(MDFN_UNLIKELY(ss_dbg_mask & SS_DBG_VDP1_RACE))
  {
@@ -173,7 +314,7 @@ static void VRAMUsageWrite(uint32 A)
  }
 }
 
-static void VRAMUsageDrawRead(uint32 A)
+static void VRAMRaceDrawRead(uint32 A)
 {
  if(MDFN_UNLIKELY(ss_dbg_mask & SS_DBG_VDP1_RACE))
  {
@@ -187,7 +328,7 @@ static void VRAMUsageDrawRead(uint32 A)
  }
 }
 
-static void VRAMUsageEnd(void)
+static void VRAMRaceEnd(void)
 {
  if(MDFN_UNLIKELY(ss_dbg_mask & SS_DBG_VDP1_RACE))
  {
@@ -201,17 +342,265 @@ static void VRAMUsageEnd(void)
  }
 }
 #else
-static INLINE void VRAMUsageInit(void) { }
-static INLINE void VRAMUsageAddBaseTime(int32 amount) { }
-static INLINE void VRAMUsageStart(void) { }
-static INLINE void VRAMUsageWrite(uint32 A) { }
-static INLINE void VRAMUsageDrawRead(uint32 A) { }
-static INLINE void VRAMUsageEnd(void) { }
+static INLINE void VRAMRaceInit(void) { }
+static INLINE void VRAMRaceAddBaseTime(int32 amount) { }
+static INLINE void VRAMRaceStart(void) { }
+static INLINE void VRAMRaceWrite(uint32 A) { }
+static INLINE void VRAMRaceDrawRead(uint32 A) { }
+static INLINE void VRAMRaceEnd(void) { }
 #endif
+
 //
+// Draw statistics(Automation_VDP1StatsStart()), rolled once per emulated frame by Automation_VDP1StatsFrame():
+// VDP1 cycles spent drawing, pixels plotted(not transparent, clipped or meshed out), commands and the cycles from
+// each command's fetch to the next one's by type, and how many distinct VRAM words drawing read and the bus wrote.
 //
+// Per-command statistics(Automation_VDP1CmdStatsStart()) keep the same cycles and pixels, plus pixels rejected by
+// clipping, for each command table entry fetched in the frame, keyed by its address.
 //
-void Init(void)
+enum { STATCMD_INVALID = 0xC, STATCMD_SKIP = 0xD, STATCMD_END = 0xE, STATCMD__COUNT = 0xF };
+
+static const char* const StatCmdNames[STATCMD__COUNT] = { "normal", "scaled", "distorted", "distorted_3", "polygon", "polyline", "line", "polyline_7", "uclip", "sclip", "local", "uclip_b", "invalid", "skip", "end" };
+
+struct DrawStatCounters
+{
+ uint64 drawings;
+ uint64 cycles;
+ uint64 pixels;
+ uint64 cmds[STATCMD__COUNT];
+ uint64 cmd_cycles[STATCMD__COUNT];
+ uint64 vram_read_words;
+ uint64 vram_write_words;
+};
+
+bool StatsActive;	// Either kind of statistics is on; also read by PlotPixel() and DrawLine().
+uint64 StatsPixels;	// Running totals, never reset.
+uint64 StatsClipped;
+
+static struct
+{
+ bool on;
+ DrawStatCounters cur, last, total;
+ uint64 frames;
+ uint64 pixels_mark;
+ uint64 vram_read[0x40000 / 64];
+ uint64 vram_write[0x40000 / 64];
+} Stats;
+
+struct CmdStat
+{
+ uint32 frame;	// CmdStats.frame when last reset
+ uint8 type;
+ uint32 fetches;
+ uint64 cycles;
+ uint32 pixels;
+ uint32 clipped;
+};
+
+static struct
+{
+ bool on;
+ uint32 frame;
+ CmdStat slots[0x40000 / 0x10];
+ std::vector<uint16> touched;
+ std::vector<uint16> last;
+ uint64 pixels_mark;
+ uint64 clipped_mark;
+} CmdStats;
+
+// The command currently being drawn, for both kinds of statistics.
+static uint64 StatsEaten;	// Cycles eaten by DoDrawing() calls that have returned.
+static uint64 StatsCmdStart;	// Value of StatsEaten(plus the current call's part) when the current command was fetched
+static unsigned StatsCmdType;
+static int32 StatsCmdSlot = -1;
+
+// Command table entries to break on(Automation_VDP1CmdBreakAdd()), one flag per 32-byte entry.
+static uint8 CmdBreak[0x40000 / 0x10];
+static uint32 CmdBreakCount;
+
+// A is a VRAM word index.
+static INLINE void VRAMUsageWrite(uint32 A)
+{
+ if(MDFN_UNLIKELY(Stats.on))
+  Stats.vram_write[(A >> 6) & 0xFFF] |= (uint64)1 << (A & 0x3F);
+
+ VRAMRaceWrite(A);
+}
+
+static INLINE void VRAMUsageDrawRead(uint32 A)
+{
+ if(MDFN_UNLIKELY(Stats.on))
+  Stats.vram_read[(A >> 6) & 0xFFF] |= (uint64)1 << (A & 0x3F);
+
+ VRAMRaceDrawRead(A);
+}
+
+static unsigned StatCmdType(const uint16 c0)
+{
+ if(c0 & 0x8000)
+  return STATCMD_END;
+ else if(c0 & 0x4000)
+  return STATCMD_SKIP;
+
+ return std::min<unsigned>(c0 & 0xF, STATCMD_INVALID);
+}
+
+// Charges the cycles and pixels since the last call to the current command.
+static void StatsFlushCommand(const uint64 now)
+{
+ if(Stats.on)
+  Stats.cur.cmd_cycles[StatsCmdType] += now - StatsCmdStart;
+
+ if(CmdStats.on && StatsCmdSlot >= 0)
+ {
+  CmdStat* s = &CmdStats.slots[StatsCmdSlot];
+
+  if(s->frame != CmdStats.frame)
+  {
+   const uint8 type = s->type;
+
+   *s = CmdStat();
+   s->frame = CmdStats.frame;
+   s->type = type;
+   CmdStats.touched.push_back(StatsCmdSlot);
+  }
+  s->cycles += now - StatsCmdStart;
+  s->pixels += StatsPixels - CmdStats.pixels_mark;
+  s->clipped += StatsClipped - CmdStats.clipped_mark;
+ }
+
+ StatsCmdStart = now;
+ CmdStats.pixels_mark = StatsPixels;
+ CmdStats.clipped_mark = StatsClipped;
+}
+
+// eaten_call: cycles eaten so far by the current DoDrawing() call.
+static NO_INLINE void StatsCommand(const int32 eaten_call)
+{
+ StatsFlushCommand(StatsEaten + eaten_call);
+
+ StatsCmdType = StatCmdType(CommandData[0]);
+ StatsCmdSlot = CurCommandAddr >> 4;
+
+ if(Stats.on)
+  Stats.cur.cmds[StatsCmdType]++;
+
+ if(CmdStats.on)
+ {
+  CmdStat* s = &CmdStats.slots[StatsCmdSlot];
+
+  if(s->frame != CmdStats.frame)
+  {
+   *s = CmdStat();
+   s->frame = CmdStats.frame;
+   CmdStats.touched.push_back(StatsCmdSlot);
+  }
+  s->type = StatsCmdType;
+  s->fetches++;
+ }
+}
+//
+// Command list capture(Automation_VDP1CaptureStart()) for Automation_VDP1Bench().  The file is "MDFNV1C1", then one
+// record per completed drawing:
+//
+//  le32 flags(bit 0: VRAM or the framebuffer was written by the CPUs during drawing, so replay may differ),
+//  le32 crc32 of the drawn framebuffer afterwards, le32 x CapReg__Count(below), then VRAM and the drawn framebuffer as
+//  they were when drawing started, each as le32 compressed length + zlib data of host-order 16-bit words.
+//
+// Drawings cut short(by a framebuffer swap, or a new drawing start) aren't written, only counted.
+//
+enum
+{
+ CAPREG_TVMR = 0,
+ CAPREG_FBCR,
+ CAPREG_SYSCLIPX,
+ CAPREG_SYSCLIPY,
+ CAPREG_USERCLIPX0,
+ CAPREG_USERCLIPY0,
+ CAPREG_USERCLIPX1,
+ CAPREG_USERCLIPY1,
+ CAPREG_LOCALX,
+ CAPREG_LOCALY,
+
+ CapReg__Count
+};
+
+static struct
+{
+ FILE* fp;
+ bool pending;
+ bool dirty;
+ uint32 frames;
+ uint32 dropped;
+ uint32 regs[CapReg__Count];
+ std::vector<uint16> vram;
+ std::vector<uint16> fb;
+} Cap;
+
+static bool BenchActive;
+
+static void CaptureGetRegs(uint32* regs)
+{
+ regs[CAPREG_TVMR] = TVMR;
+ regs[CAPREG_FBCR] = FBCR;
+ regs[CAPREG_SYSCLIPX] = SysClipX;
+ regs[CAPREG_SYSCLIPY] = SysClipY;
+ regs[CAPREG_USERCLIPX0] = UserClipX0;
+ regs[CAPREG_USERCLIPY0] = UserClipY0;
+ regs[CAPREG_USERCLIPX1] = UserClipX1;
+ regs[CAPREG_USERCLIPY1] = UserClipY1;
+ regs[CAPREG_LOCALX] = LocalX;
+ regs[CAPREG_LOCALY] = LocalY;
+}
+
+static void CaptureSetRegs(const uint32* regs)
+{
+ TVMR = regs[CAPREG_TVMR];
+ FBCR = regs[CAPREG_FBCR];
+ SysClipX = regs[CAPREG_SYSCLIPX];
+ SysClipY = regs[CAPREG_SYSCLIPY];
+ UserClipX0 = regs[CAPREG_USERCLIPX0];
+ UserClipY0 = regs[CAPREG_USERCLIPY0];
+ UserClipX1 = regs[CAPREG_USERCLIPX1];
+ UserClipY1 = regs[CAPREG_USERCLIPY1];
+ LocalX = regs[CAPREG_LOCALX];
+ LocalY = regs[CAPREG_LOCALY];
+}
+
+static void CaptureBegin(void)
+{
+ if(Cap.pending)
+  Cap.dropped++;
+
+ SyncFB();
+ memcpy(Cap.vram.data(), VRAM, sizeof(VRAM));
+ memcpy(Cap.fb.data(), FB[FBDrawWhich], sizeof(FB[0]));
+ CaptureGetRegs(Cap.regs);
+ Cap.pending = true;
+ Cap.dirty = false;
+}
+
+static void CaptureEnd(void)
+{
+ uint8 hdr[4 * (2 + CapReg__Count)];
+
+ SyncFB();
+ MDFN_en32lsb(&hdr[0], Cap.dirty);
+ MDFN_en32lsb(&hdr[4], crc32(0, (const Bytef*)FB[FBDrawWhich], sizeof(FB[0])));
+ for(unsigned i = 0; i < CapReg__Count; i++)
+  MDFN_en32lsb(&hdr[8 + i * 4], Cap.regs[i]);
+
+ fwrite(hdr, 1, sizeof(hdr), Cap.fp);
+ ZBlock_Write(Cap.fp, Cap.vram.data(), Cap.vram.size() * sizeof(uint16));
+ ZBlock_Write(Cap.fp, Cap.fb.data(), Cap.fb.size() * sizeof(uint16));
+
+ Cap.frames++;
+ Cap.pending = false;
+}
+//
+//
+//
+void Init(const unsigned workers)
 {
  vbcdpending = false;
 
@@ -237,18 +626,80 @@ void Init(void)
  FBVBEraseLastTS = 0;
  LastRWTS = 0;
 
- VRAMUsageInit();
+ VRAMRaceInit();
+
+ FBWorkersExit.store(false, std::memory_order_release);
+ FBWorkerCount = std::min<unsigned>(workers, sizeof(FBWorkers) / sizeof(FBWorkers[0]));
+ for(unsigned i = 0; i < 0x100; i++)
+  FBOpLineWorker[i] = FBWorkerCount ? (i / FBOp_BandLines) % FBWorkerCount : 0;
+
+ for(unsigned i = 0; i < FBWorkerCount; i++)
+ {
+  FBOpQueue* const q = &FBOpQueues[i];
+
+  q->wpos.store(0, std::memory_order_release);
+  q->rpos.store(0, std::memory_order_release);
+  q->sleeping.store(false, std::memory_order_release);
+  q->wpos_local = 0;
+  q->rpos_cached = 0;
+
+  FBWorkerSem[i] = MThreading::Sem_Create();
+  FBWorkers[i] = MThreading::Thread_Create(FBWorkerEntry, q, "MDFN VDP1 FB Worker");
+ }
 }
 
 void Kill(void)
 {
+ if(FBWorkerCount)
+ {
+  SyncFB();
+  FBWorkersExit.store(true, std::memory_order_release);
+  for(unsigned i = 0; i < FBWorkerCount; i++)
+  {
+   MThreading::Sem_Post(FBWorkerSem[i]);
+   MThreading::Thread_Wait(FBWorkers[i], NULL);
+   MThreading::Sem_Destroy(FBWorkerSem[i]);
+   FBWorkerSem[i] = NULL;
+  }
+  FBWorkerCount = 0;
+ }
+}
 
+//
+// For fork(): ends the framebuffer workers once their queues are drained; ResumeWorkers() starts them again.
+//
+void SuspendWorkers(void)
+{
+ if(FBWorkerCount && FBWorkers[0])
+ {
+  SyncFB();
+  FBWorkersExit.store(true, std::memory_order_release);
+  for(unsigned i = 0; i < FBWorkerCount; i++)
+  {
+   MThreading::Sem_Post(FBWorkerSem[i]);
+   MThreading::Thread_Wait(FBWorkers[i], NULL);
+   FBWorkers[i] = NULL;
+  }
+ }
+}
+
+void ResumeWorkers(void)
+{
+ if(FBWorkerCount && !FBWorkers[0])
+ {
+  FBWorkersExit.store(false, std::memory_order_release);
+  for(unsigned i = 0; i < FBWorkerCount; i++)
+   FBWorkers[i] = MThreading::Thread_Create(FBWorkerEntry, &FBOpQueues[i], "MDFN VDP1 FB Worker");
+ }
 }
 
 void Reset(bool powering_up)
 {
+ SyncFB();
+
  if(powering_up)
  {
+  memset(VRAMDirty, 0xFF, sizeof(VRAMDirty));
   for(unsigned i = 0; i < 0x40000; i++)
   {
    uint16 val;
@@ -297,6 +748,7 @@ void Reset(bool powering_up)
  FBManualPending = false;
  FBVBErasePending = false;
  FBVBEraseActive = false;
+ Cap.pending = false;
 
  LOPR = 0;
  CurCommandAddr = 0;
@@ -714,12 +1166,19 @@ enum : int { CommandPhaseBias = __COUNTER__ + 1 };
 		}										\
 
 
+static NO_INLINE void CmdBreakCheck(void)
+{
+ if(CmdBreak[CurCommandAddr >> 4] && !BenchActive)
+  ::Automation_VDP1CmdBreakHit(CurCommandAddr << 1, CommandData[0], StatCmdNames[StatCmdType(CommandData[0])]);
+}
+
 static INLINE void DoDrawing(void)
 {
 #if 1
  if(MDFN_UNLIKELY(ss_horrible_hacks & HORRIBLEHACK_VDP1INSTANT))
   CycleCounter = InstantDrawSanityLimit; 
 #endif
+ const int32 stats_cc = CycleCounter;
 
  switch(CommandPhase + CommandPhaseBias)
  {
@@ -731,10 +1190,16 @@ static INLINE void DoDrawing(void)
    // Fetch command data
    memcpy(CommandData, &VRAM[CurCommandAddr], sizeof(CommandData));
 
+   if(MDFN_UNLIKELY(StatsActive))
+    StatsCommand(stats_cc - CycleCounter);
+
+   if(MDFN_UNLIKELY(CmdBreakCount))
+    CmdBreakCheck();
+
    VDP1_EAT_CLOCKS(16);
 
    for(unsigned i = 0; i < 16; i++)
-    VRAMUsageDrawRead((CurCommandAddr + i) * 2);
+    VRAMUsageDrawRead((CurCommandAddr + i) & 0x3FFFF);
 
    //SS_DBGTI(SS_DBG_WARNING | SS_DBG_VDP1, "[VDP1] Command @ 0x%06x: 0x%04x\n", CurCommandAddr, cmd_data[0]);
 
@@ -743,7 +1208,7 @@ static INLINE void DoDrawing(void)
     if(MDFN_UNLIKELY((CommandData[0] & 0xF) >= 0xC))
     {
      DrawingActive = false;
-     VRAMUsageEnd();
+     VRAMRaceEnd();
      goto Breakout;
     }
     else
@@ -790,10 +1255,16 @@ static INLINE void DoDrawing(void)
    {
     SS_DBGTI(SS_DBG_VDP1, "[VDP1] Drawing finished at 0x%05x", CurCommandAddr);
     DrawingActive = false;
-    VRAMUsageEnd();
+    VRAMRaceEnd();
 
     EDSR |= 0x2;	// TODO: Does EDSR reflect IRQ out status?
 
+    if(MDFN_UNLIKELY(BenchActive))
+     goto Breakout;
+
+    if(MDFN_UNLIKELY(Cap.pending))
+     CaptureEnd();
+
     SCU_SetInt(SCU_INT_VDP1, true);
     SCU_SetInt(SCU_INT_VDP1, false);
     goto Breakout;
@@ -831,10 +1302,19 @@ static INLINE void DoDrawing(void)
  }
  Breakout:;
 
+ if(MDFN_UNLIKELY(StatsActive))
+ {
+  StatsEaten += stats_cc - CycleCounter;
+  Stats.cur.cycles += stats_cc - CycleCounter;
+ }
+
 #if 1
  if(MDFN_UNLIKELY(ss_horrible_hacks & HORRIBLEHACK_VDP1INSTANT))
   InstantDrawSanityLimit = CycleCounter;
 #endif
+
+ for(unsigned i = 0; i < FBWorkerCount; i++)
+  FBOpQueuePublish(&FBOpQueues[i]);
 }
 
 sscpu_timestamp_t Update(sscpu_timestamp_t timestamp)
@@ -883,11 +1363,17 @@ static void StartDrawing(void)
  // On draw start, clear CEF.
  EDSR &= ~0x2;
 
+ if(MDFN_UNLIKELY(Cap.fp != NULL))
+  CaptureBegin();
+
  CurCommandAddr = 0;
  RetCommandAddr = -1;
  DrawingActive = true;
  CommandPhase = 0;
- VRAMUsageStart();
+ VRAMRaceStart();
+
+ if(MDFN_UNLIKELY(Stats.on))
+  Stats.cur.drawings++;
 
  CycleCounter = VDP1_UpdateTimingGran;
 }
@@ -979,9 +1465,16 @@ void SetHBVB(const sscpu_timestamp_t event_timestamp, const bool new_hb_status,
     {
      SS_DBGTI(SS_DBG_WARNING | SS_DBG_VDP1, "[VDP1] Drawing aborted by framebuffer swap.");
      DrawingActive = false;
-     VRAMUsageEnd();
+     VRAMRaceEnd();
+
+     if(Cap.pending)
+     {
+      Cap.pending = false;
+      Cap.dropped++;
+     }
     }
 
+    SyncFB();
     FBDrawWhich = !FBDrawWhich;
     FBDrawWhichPtr = FB[FBDrawWhich];
 
@@ -1122,7 +1615,7 @@ void AdjustTS(const int32 delta)
 
  LastRWTS = std::max<sscpu_timestamp_t>(-1000000, LastRWTS + delta);
 
- VRAMUsageAddBaseTime(-delta);
+ VRAMRaceAddBaseTime(-delta);
 }
 
 static INLINE void WriteReg(const unsigned which, const uint16 value)
@@ -1172,7 +1665,7 @@ static INLINE void WriteReg(const unsigned which, const uint16 value)
 	if(DrawingActive)
 	{
 	 DrawingActive = false;
-         VRAMUsageEnd();
+         VRAMRaceEnd();
 	 if(CycleCounter < 0)
 	  CycleCounter = 0;
 	 nt = SH7095_mem_timestamp + VDP1_IdleTimingGran;
@@ -1245,8 +1738,10 @@ MDFN_FASTCALL void Write8_DB(uint32 A, uint16 DB)
  if(A < 0x80000)
  {
   VRAMUsageWrite(A >> 1);
+  VRAMDirty[A >> 11] |= (uint64)1 << ((A >> 5) & 0x3F);
   SS_DBGTI(SS_DBG_VDP1_VRAMW, "[VDP1] Write to VRAM: 0x%02x->VRAM[0x%05x]", (DB >> (((A & 1) ^ 1) << 3)) & 0xFF, A);
   ne16_wbo_be<uint8>(VRAM, A, DB >> (((A & 1) ^ 1) << 3) );
+  Cap.dirty |= Cap.pending;
   return;
  }
 
@@ -1259,7 +1754,9 @@ MDFN_FASTCALL void Write8_DB(uint32 A, uint16 DB)
   if((TVMR & (TVMR_8BPP | TVMR_ROTATE)) == (TVMR_8BPP | TVMR_ROTATE))
    FBA = (FBA & 0x1FF) | ((FBA << 1) & 0x3FC00) | ((FBA >> 8) & 0x200);
 
+  SyncFB();
   ne16_wbo_be<uint8>(FB[FBDrawWhich], FBA & 0x3FFFF, DB >> (((A & 1) ^ 1) << 3) );
+  Cap.dirty |= Cap.pending;
   return;
  }
 
@@ -1274,8 +1771,10 @@ MDFN_FASTCALL void Write16_DB(uint32 A, uint16 DB)
  if(A < 0x80000)
  {
   VRAMUsageWrite(A >> 1);
+  VRAMDirty[A >> 11] |= (uint64)1 << ((A >> 5) & 0x3F);
   SS_DBGTI(SS_DBG_VDP1_VRAMW, "[VDP1] Write to VRAM: 0x%04x->VRAM[0x%05x]", DB, A);
   VRAM[A >> 1] = DB;
+  Cap.dirty |= Cap.pending;
   return;
  }
 
@@ -1288,7 +1787,9 @@ MDFN_FASTCALL void Write16_DB(uint32 A, uint16 DB)
   if((TVMR & (TVMR_8BPP | TVMR_ROTATE)) == (TVMR_8BPP | TVMR_ROTATE))
    FBA = (FBA & 0x1FF) | ((FBA << 1) & 0x3FC00) | ((FBA >> 8) & 0x200);
 
+  SyncFB();
   FB[FBDrawWhich][(FBA >> 1) & 0x1FFFF] = DB;
+  Cap.dirty |= Cap.pending;
   return;
  }
 
@@ -1309,16 +1810,26 @@ MDFN_FASTCALL uint16 Read16_DB(uint32 A)
   if((TVMR & (TVMR_8BPP | TVMR_ROTATE)) == (TVMR_8BPP | TVMR_ROTATE))
    FBA = (FBA & 0x1FF) | ((FBA << 1) & 0x3FC00) | ((FBA >> 8) & 0x200);
 
+  SyncFB();
   return FB[FBDrawWhich][(FBA >> 1) & 0x1FFFF];
  }
 
  return ReadReg((A - 0x100000) >> 1);
 }
 
+// Bit n of word i covers the 32 bytes at (i * 64 + n) * 32.
+void TakeVRAMDirty(uint64* bits)
+{
+ memcpy(bits, VRAMDirty, sizeof(VRAMDirty));
+ memset(VRAMDirty, 0, sizeof(VRAMDirty));
+}
+
 void StateAction(StateMem* sm, const unsigned load, const bool data_only)
 {
  bool tmp_abs_dy_gt_abs_dx = false;
 
+ SyncFB();
+
  SFORMAT Prim_StateRegs[] =
  {
   SFVAR(PrimData.e->d_error, 0x2, sizeof(*PrimData.e), PrimData.e),
@@ -1478,6 +1989,7 @@ void StateAction(StateMem* sm, const unsigned load, const bool data_only)
 
  if(load)
  {
+  memset(VRAMDirty, 0xFF, sizeof(VRAMDirty));
   CurCommandAddr &= 0x3FFFF;
   if(RetCommandAddr >= 0)
    RetCommandAddr &= 0x3FFFF;
@@ -1639,4 +2151,376 @@ void SetRegister(const unsigned id, const uint32 value)
 
 }
 
+//
+// Automation accessors(declared in automation_ss.h); called from the emulation thread.
+//
+using namespace VDP1;
+
+bool Automation_VDP1CaptureStart(const char* path)
+{
+ Automation_VDP1CaptureStop();
+
+ if(!(Cap.fp = fopen(path, "wb")))
+  return false;
+
+ fwrite("MDFNV1C1", 1, 8, Cap.fp);
+ Cap.vram.resize(0x40000);
+ Cap.fb.resize(0x20000);
+ Cap.pending = false;
+ Cap.frames = 0;
+ Cap.dropped = 0;
+
+ return true;
+}
+
+uint32 Automation_VDP1CaptureStop(void)
+{
+ if(!Cap.fp)
+  return Cap.frames;
+
+ fclose(Cap.fp);
+ Cap.fp = NULL;
+ Cap.pending = false;
+ Cap.vram = std::vector<uint16>();
+ Cap.fb = std::vector<uint16>();
+
+ return Cap.frames;
+}
+
+bool Automation_VDP1CaptureIsActive(void)
+{
+ return Cap.fp != NULL;
+}
+
+uint32 Automation_VDP1CaptureDropped(void)
+{
+ return Cap.dropped;
+}
+
+void Automation_VDP1ReadFB(bool display, uint16* dest, uint8* tvmr)
+{
+ SyncFB();
+ memcpy(dest, FB[FBDrawWhich ^ display], sizeof(FB[0]));
+ *tvmr = TVMR;
+}
+
+//
+// Replays each drawing of a capture file 'repeat' times through DoDrawing(), with an unbounded cycle budget, and reports
+// host time, emulated draw cycles, and framebuffer crc32 mismatches against the capture.  All VDP1 state that drawing
+// touches is saved beforehand and restored afterwards, and the drawing end interrupt isn't raised, so emulation resumes
+// unaffected.
+//
+bool Automation_VDP1Bench(const char* path, const unsigned repeat, std::string* report)
+{
+ enum : int32 { Bench_CycleLimit = 0x40000000 };
+ FILE* fp = fopen(path, "rb");
+ char magic[8];
+
+ if(!fp)
+ {
+  *report = "cannot open " + std::string(path);
+  return false;
+ }
+
+ if(fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, "MDFNV1C1", 8))
+ {
+  fclose(fp);
+  *report = "not a VDP1 capture file";
+  return false;
+ }
+
+ SyncFB();
+ //
+ // Save
+ //
+ std::vector<uint16> saved_vram(VRAM, VRAM + 0x40000);
+ std::vector<uint16> saved_fb(FB[FBDrawWhich], FB[FBDrawWhich] + 0x20000);
+ uint32 saved_regs[CapReg__Count];
+ const line_data saved_line_data = LineData;
+ const line_inner_data saved_line_inner_data = LineInnerData;
+ const prim_data saved_prim_data = PrimData;
+ const uint8 saved_edsr = EDSR;
+ const bool saved_drawing_active = DrawingActive;
+ const uint32 saved_cur_command_addr = CurCommandAddr;
+ const int32 saved_ret_command_addr = RetCommandAddr;
+ const int32 saved_cycle_counter = CycleCounter;
+ const int32 saved_command_phase = CommandPhase;
+ const uint32 saved_dta_counter = DTACounter;
+ const uint32 saved_horrible_hacks = ss_horrible_hacks;
+ uint16 saved_command_data[0x10];
+
+ CaptureGetRegs(saved_regs);
+ memcpy(saved_command_data, CommandData, sizeof(CommandData));
+ ss_horrible_hacks &= ~HORRIBLEHACK_VDP1INSTANT;
+ BenchActive = true;
+ const bool saved_stats_active = StatsActive;
+ StatsActive = false;
+ //
+ // Replay
+ //
+ std::vector<uint16> vram(0x40000);
+ std::vector<uint16> fb(0x20000);
+ uint32 frames = 0, mismatches = 0, dirty = 0, timeouts = 0;
+ uint64 cycles = 0;
+ std::chrono::steady_clock::duration elapsed(0);
+ bool ok = true;
+
+ for(;;)
+ {
+  uint8 hdr[4 * (2 + CapReg__Count)];
+  uint32 regs[CapReg__Count];
+  size_t n = fread(hdr, 1, sizeof(hdr), fp);
+
+  if(!n)
+   break;
+
+  if(n != sizeof(hdr) || !ZBlock_Read(fp, vram.data(), vram.size() * sizeof(uint16)) || !ZBlock_Read(fp, fb.data(), fb.size() * sizeof(uint16)))
+  {
+   *report = "truncated or corrupt record " + std::to_string(frames);
+   ok = false;
+   break;
+  }
+
+  for(unsigned i = 0; i < CapReg__Count; i++)
+   regs[i] = MDFN_de32lsb(&hdr[8 + i * 4]);
+
+  for(unsigned r = 0; r < std::max<unsigned>(1, repeat); r++)
+  {
+   memcpy(VRAM, vram.data(), sizeof(VRAM));
+   memcpy(FB[FBDrawWhich], fb.data(), sizeof(FB[0]));
+   CaptureSetRegs(regs);
+   CurCommandAddr = 0;
+   RetCommandAddr = -1;
+   DrawingActive = true;
+   CommandPhase = 0;
+   DTACounter = 0;
+   CycleCounter = Bench_CycleLimit;
+
+   const auto t0 = std::chrono::steady_clock::now();
+   DoDrawing();
+   SyncFB();
+   elapsed += std::chrono::steady_clock::now() - t0;
+
+   cycles += Bench_CycleLimit - CycleCounter;
+   if(r)
+    continue;
+
+   timeouts += DrawingActive;
+   if(crc32(0, (const Bytef*)FB[FBDrawWhich], sizeof(FB[0])) != MDFN_de32lsb(&hdr[4]))
+   {
+    mismatches++;
+    dirty += MDFN_de32lsb(&hdr[0]) & 1;
+   }
+  }
+  frames++;
+ }
+ fclose(fp);
+ //
+ // Restore
+ //
+ BenchActive = false;
+ StatsActive = saved_stats_active;
+ ss_horrible_hacks = saved_horrible_hacks;
+ memcpy(VRAM, saved_vram.data(), sizeof(VRAM));
+ memcpy(FB[FBDrawWhich], saved_fb.data(), sizeof(FB[0]));
+ CaptureSetRegs(saved_regs);
+ LineData = saved_line_data;
+ LineInnerData = saved_line_inner_data;
+ PrimData = saved_prim_data;
+ EDSR = saved_edsr;
+ DrawingActive = saved_drawing_active;
+ CurCommandAddr = saved_cur_command_addr;
+ RetCommandAddr = saved_ret_command_addr;
+ CycleCounter = saved_cycle_counter;
+ CommandPhase = saved_command_phase;
+ DTACounter = saved_dta_counter;
+ memcpy(CommandData, saved_command_data, sizeof(CommandData));
+
+ if(ok)
+ {
+  const double us = std::chrono::duration<double, std::micro>(elapsed).count();
+  const uint64 runs = (uint64)frames * std::max<unsigned>(1, repeat);
+  char buf[256];
+
+  // dirty: mismatching drawings whose VRAM or framebuffer the CPUs wrote to mid-draw
+  snprintf(buf, sizeof(buf), " frames=%u repeat=%u ms=%.2f us_per_frame=%.1f cycles_per_frame=%llu mismatches=%u dirty=%u timeouts=%u", frames, std::max<unsigned>(1, repeat), us / 1000.0, runs ? us / runs : 0.0, (unsigned long long)(runs ? cycles / runs : 0), mismatches, dirty, timeouts);
+  *report = buf;
+ }
+
+ return ok;
+}
+
+static void StatsUpdateActive(void)
+{
+ StatsActive = Stats.on || CmdStats.on;
+}
+
+void Automation_VDP1StatsStart(void)
+{
+ memset(&Stats, 0, sizeof(Stats));
+ Stats.pixels_mark = StatsPixels;
+ StatsCmdStart = StatsEaten;
+ Stats.on = true;
+ StatsUpdateActive();
+}
+
+void Automation_VDP1StatsStop(void)
+{
+ Stats.on = false;
+ StatsUpdateActive();
+}
+
+bool Automation_VDP1StatsIsActive(void)
+{
+ return Stats.on;
+}
+
+// Called once per emulated frame while active.
+void Automation_VDP1StatsFrame(void)
+{
+ DrawStatCounters& c = Stats.cur;
+
+ StatsFlushCommand(StatsEaten);
+
+ c.pixels = StatsPixels - Stats.pixels_mark;
+ Stats.pixels_mark = StatsPixels;
+
+ for(unsigned i = 0; i < 0x40000 / 64; i++)
+ {
+  c.vram_read_words += std::bitset<64>(Stats.vram_read[i]).count();
+  c.vram_write_words += std::bitset<64>(Stats.vram_write[i]).count();
+ }
+ memset(Stats.vram_read, 0, sizeof(Stats.vram_read));
+ memset(Stats.vram_write, 0, sizeof(Stats.vram_write));
+
+ Stats.last = c;
+ Stats.total.drawings += c.drawings;
+ Stats.total.cycles += c.cycles;
+ Stats.total.pixels += c.pixels;
+ for(unsigned i = 0; i < STATCMD__COUNT; i++)
+ {
+  Stats.total.cmds[i] += c.cmds[i];
+  Stats.total.cmd_cycles[i] += c.cmd_cycles[i];
+ }
+ Stats.total.vram_read_words += c.vram_read_words;
+ Stats.total.vram_write_words += c.vram_write_words;
+ Stats.frames++;
+
+ memset(&c, 0, sizeof(c));
+}
+
+// Last frame's counters, or the sums since Automation_VDP1StatsStart(); "type=commands/cycles" only for types seen.
+std::string Automation_VDP1StatsFormat(bool total)
+{
+ const DrawStatCounters& c = total ? Stats.total : Stats.last;
+ std::string ret;
+ char buf[128];
+
+ snprintf(buf, sizeof(buf), " frames=%llu drawings=%llu cycles=%llu pixels=%llu vram_read=%llu vram_write=%llu", (unsigned long long)Stats.frames, (unsigned long long)c.drawings, (unsigned long long)c.cycles, (unsigned long long)c.pixels, (unsigned long long)c.vram_read_words, (unsigned long long)c.vram_write_words);
+ ret += buf;
+ for(unsigned i = 0; i < STATCMD__COUNT; i++)
+ {
+  if(!c.cmds[i])
+   continue;
+
+  snprintf(buf, sizeof(buf), " %s=%llu/%llu", StatCmdNames[i], (unsigned long long)c.cmds[i], (unsigned long long)c.cmd_cycles[i]);
+  ret += buf;
+ }
+
+ return ret;
+}
+
+void Automation_VDP1CmdStatsStart(void)
+{
+ for(CmdStat& s : CmdStats.slots)
+  s = CmdStat();
+
+ CmdStats.frame = 1;
+ CmdStats.touched.clear();
+ CmdStats.last.clear();
+ CmdStats.pixels_mark = StatsPixels;
+ CmdStats.clipped_mark = StatsClipped;
+ StatsCmdStart = StatsEaten;
+ StatsCmdSlot = -1;	// Whatever is being drawn now was fetched before the start.
+ CmdStats.on = true;
+ StatsUpdateActive();
+}
+
+void Automation_VDP1CmdStatsStop(void)
+{
+ CmdStats.on = false;
+ StatsUpdateActive();
+}
+
+bool Automation_VDP1CmdStatsIsActive(void)
+{
+ return CmdStats.on;
+}
+
+// Called once per emulated frame while active; a command still drawing at the frame end is split between frames.
+void Automation_VDP1CmdStatsFrame(void)
+{
+ StatsFlushCommand(StatsEaten);
+
+ CmdStats.last.swap(CmdStats.touched);
+ CmdStats.touched.clear();
+ CmdStats.frame++;
+}
+
+uint32 Automation_VDP1CmdStatsCount(void)
+{
+ return CmdStats.last.size();
+}
+
+// One line per command table entry in the last frame, most cycles first; max = 0 for all of them.
+std::string Automation_VDP1CmdStatsFormat(unsigned max, const char* prefix)
+{
+ std::vector<uint16> order(CmdStats.last);
+ std::string ret;
+ char buf[160];
+
+ std::stable_sort(order.begin(), order.end(), [](uint16 a, uint16 b) { return CmdStats.slots[a].cycles > CmdStats.slots[b].cycles; });
+ if(max && order.size() > max)
+  order.resize(max);
+
+ for(uint16 slot : order)
+ {
+  const CmdStat& s = CmdStats.slots[slot];
+
+  snprintf(buf, sizeof(buf), "%saddr=0x%05X type=%s fetches=%u cycles=%llu pixels=%u clipped=%u\n", prefix, slot << 5, StatCmdNames[s.type], s.fetches, (unsigned long long)s.cycles, s.pixels, s.clipped);
+  ret += buf;
+ }
+
+ return ret;
+}
+
+// addr: byte offset of a 32-byte command table entry in VDP1 VRAM.
+void Automation_VDP1CmdBreakAdd(uint32 addr)
+{
+ uint8& b = CmdBreak[(addr >> 5) & 0x3FFF];
+
+ if(!b)
+ {
+  b = 1;
+  CmdBreakCount++;
+ }
+}
+
+void Automation_VDP1CmdBreakRemove(uint32 addr)
+{
+ uint8& b = CmdBreak[(addr >> 5) & 0x3FFF];
+
+ if(b)
+ {
+  b = 0;
+  CmdBreakCount--;
+ }
+}
+
+void Automation_VDP1CmdBreakClear(void)
+{
+ memset(CmdBreak, 0, sizeof(CmdBreak));
+ CmdBreakCount = 0;
+}
+
 }
@@ -23,6 +23,7 @@
 #define __MDFN_SS_VDP1_H
 
 #include <mednafen/state.h>
+#include "hotmem.h"
 
 namespace MDFN_IEN_SS
 {
@@ -30,8 +31,13 @@ namespace MDFN_IEN_SS
 namespace VDP1
 {
 
-void Init(void) MDFN_COLD;
+static uint16 (&VRAM)[0x40000] = SS_HotMem.VDP1VRAM;
+static uint16 (&FB)[2][0x20000] = SS_HotMem.VDP1FB;
+
+void Init(const unsigned workers) MDFN_COLD;
 void Kill(void) MDFN_COLD;
+void SuspendWorkers(void) MDFN_COLD;
+void ResumeWorkers(void) MDFN_COLD;
 void StateAction(StateMem* sm, const unsigned load, const bool data_only) MDFN_COLD;
 
 void Reset(bool powering_up) MDFN_COLD;
@@ -55,28 +61,37 @@ bool GetLine(const int line, uint16* buf, unsigned w, uint32 rot_x, uint32 rot_y
 
 INLINE uint8 PeekVRAM(const uint32 addr)
 {
- MDFN_HIDE extern uint16 VRAM[0x40000];
-
  return ne16_rbo_be<uint8>(VRAM, addr & 0x7FFFF);
 }
 
+INLINE const uint16* GetVRAMPtr(void)
+{
+ return VRAM;
+}
+
 INLINE void PokeVRAM(const uint32 addr, const uint8 val)
 {
- MDFN_HIDE extern uint16 VRAM[0x40000];
+ MDFN_HIDE extern uint64 VRAMDirty[0x80000 / 32 / 64];
 
  ne16_wbo_be<uint8>(VRAM, addr & 0x7FFFF, val);
+ VRAMDirty[(addr & 0x7FFFF) >> 11] |= (uint64)1 << ((addr >> 5) & 0x3F);
 }
 
+enum { VRAMDirty_Words = 0x80000 / 32 / 64 };
+void TakeVRAMDirty(uint64* bits) MDFN_COLD;	// VRAMDirty_Words words; automation vram_delta
+
+void SyncFB(void);
+
 INLINE uint8 PeekFB(const bool which, const uint32 addr)
 {
- MDFN_HIDE extern uint16 FB[2][0x20000];
+ SyncFB();
 
  return ne16_rbo_be<uint8>(FB[which], addr & 0x3FFFF);
 }
 
 INLINE void PokeFB(const bool which, const uint32 addr, const uint8 val)
 {
- MDFN_HIDE extern uint16 FB[2][0x20000];
+ SyncFB();
 
  ne16_wbo_be<uint8>(FB[which], addr & 0x3FFFF, val);
 }
@@ -22,6 +22,15 @@
 #ifndef __MDFN_SS_VDP1_COMMON_H
 #define __MDFN_SS_VDP1_COMMON_H
 
+#include <atomic>
+#include "vdp1.h"
+
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#elif defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
+
 namespace MDFN_IEN_SS
 {
 
@@ -43,8 +52,6 @@ int32 CMD_Polyline(const uint16*);
 int32 CMD_Line(const uint16*);
 int32 RESUME_Line(const uint16*);
 
-MDFN_HIDE extern uint16 VRAM[0x40000];
-MDFN_HIDE extern uint16 FB[2][0x20000];
 MDFN_HIDE extern uint16* FBDrawWhichPtr;
 
 MDFN_HIDE extern int32 SysClipX, SysClipY;
@@ -53,6 +60,10 @@ MDFN_HIDE extern int32 LocalX, LocalY;
 
 MDFN_HIDE extern uint32 (MDFN_FASTCALL *const TexFetchTab[0x20])(uint32 x);
 
+MDFN_HIDE extern bool StatsActive;	// Automation_VDP1StatsStart(), Automation_VDP1CmdStatsStart()
+MDFN_HIDE extern uint64 StatsPixels;
+MDFN_HIDE extern uint64 StatsClipped;
+
 enum { TVMR_8BPP   = 0x1 };
 enum { TVMR_ROTATE = 0x2 };
 enum { TVMR_HDTV   = 0x4 };
@@ -204,6 +215,112 @@ struct VileTex
  int32 error_adj;
 };
 
+//
+// Optional framebuffer workers(setting "ss.vdp1_workers").  Command processing, and so all of the cycle accounting, stays on
+// the emulation thread; PlotPixel() only queues the framebuffer write it would have made, and the worker threads apply the
+// queued writes.  Each op touches a single FB line(even 8bpp rotated and MSB on reads), so FB lines are binned into bands
+// of FBOp_BandLines, and a band always goes to the same worker, which keeps the order of writes to any one pixel, and with it
+// half-transparency and MSB on read-modify-write, intact.  SyncFB() waits for the queues to drain, and must be called
+// before anything else reads or writes the framebuffer being drawn to.
+//
+enum : uint8
+{
+ FBOP_W16 = 0,		// FB = pix
+ FBOP_MSB16,		// FB |= 0x8000
+ FBOP_HALF16,		// half-transparent against FB, pix already gouraud shaded
+ FBOP_SHADOW16,		// FB halved if its MSB is set
+ FBOP_W8,		// byte = pix
+ FBOP_MSB8		// byte = MSB on of the FB word holding pixel x, x in pix
+};
+
+struct FBOp
+{
+ uint32 dst;	// word index into FB[0][](spans both framebuffers), byte index for FBOP_W8 and FBOP_MSB8
+ uint16 pix;
+ uint8 kind;
+};
+
+enum : uint32 { FBOpQueue_Size = 0x8000 };
+enum : unsigned { FBOp_BandLines = 8 };
+
+struct FBOpQueue
+{
+ alignas(64) std::atomic_uint_least32_t wpos;	// published by the emulation thread
+ alignas(64) std::atomic_uint_least32_t rpos;	// advanced by the worker
+ std::atomic_bool sleeping;
+ alignas(64) uint32 wpos_local;			// emulation thread only
+ uint32 rpos_cached;
+ FBOp ops[FBOpQueue_Size];
+};
+
+MDFN_HIDE extern unsigned FBWorkerCount;
+MDFN_HIDE extern FBOpQueue FBOpQueues[3];
+MDFN_HIDE extern uint8 FBOpLineWorker[0x100];
+
+void FBOpQueueWait(FBOpQueue* q) NO_INLINE;
+void FBOpQueuePublish(FBOpQueue* q);
+
+static INLINE void QueueFBOp(const unsigned line, const uint32 dst, const uint16 pix, const uint8 kind)
+{
+ FBOpQueue* const q = &FBOpQueues[FBOpLineWorker[line & 0xFF]];
+ const uint32 w = q->wpos_local;
+
+ if(MDFN_UNLIKELY((uint32)(w - q->rpos_cached) >= FBOpQueue_Size))
+  FBOpQueueWait(q);
+
+ FBOp* const op = &q->ops[w & (FBOpQueue_Size - 1)];
+ op->dst = dst;
+ op->pix = pix;
+ op->kind = kind;
+ q->wpos_local = w + 1;
+
+ if(!((w + 1) & 0xFF))
+  FBOpQueuePublish(q);
+}
+
+template<unsigned bpp8, bool MSBOn, bool GouraudEn, bool HalfFGEn, bool HalfBGEn>
+static INLINE void QueuePixel(const uint16* fbyptr, int32 x, int32 y, uint16 pix, GourauderTheTerrible* g)
+{
+ const uint32 base = fbyptr - &FB[0][0];
+ const unsigned line = base >> 9;
+
+ if(bpp8)
+ {
+  const uint32 dst = (base << 1) + ((bpp8 == 2) ? ((x & 0x1FF) | ((y & 0x100) << 1)) : (x & 0x3FF));
+
+  if(MSBOn)
+   QueueFBOp(line, dst, x & 0x3FF, FBOP_MSB8);
+  else
+   QueueFBOp(line, dst, (uint8)pix, FBOP_W8);
+ }
+ else
+ {
+  const uint32 dst = base + (x & 0x1FF);
+
+  if(MSBOn)
+   QueueFBOp(line, dst, 0, FBOP_MSB16);
+  else if(HalfBGEn)
+  {
+   if(HalfFGEn)
+    QueueFBOp(line, dst, (GouraudEn ? g->Apply(pix) : pix), FBOP_HALF16);
+   else if(GouraudEn)
+    QueueFBOp(line, dst, 0, FBOP_W16);
+   else
+    QueueFBOp(line, dst, 0, FBOP_SHADOW16);
+  }
+  else
+  {
+   if(GouraudEn)
+    pix = g->Apply(pix);
+
+   if(HalfFGEn)
+    pix = ((pix & 0x7BDE) >> 1) | (pix & 0x8000);
+
+   QueueFBOp(line, dst, pix, FBOP_W16);
+  }
+ }
+}
+
 //
 //
 //
@@ -228,6 +345,18 @@ static INLINE int32 PlotPixel(int32 x, int32 y, uint16 pix, bool transparent, Go
  if(MeshEn)
   transparent |= (x ^ y) & 1;
 
+ if(MDFN_UNLIKELY(StatsActive))
+  StatsPixels += !transparent;
+
+ // Same cycle count as below, which never depends on the framebuffer contents.
+ if(MDFN_UNLIKELY(FBWorkerCount))
+ {
+  if(!transparent)
+   QueuePixel<bpp8, MSBOn, GouraudEn, HalfFGEn, HalfBGEn>(fbyptr, x, y, pix, g);
+
+  return 1 + ((MSBOn || HalfBGEn) ? 5 : 0);
+ }
+
  if(bpp8)
  {
   if(MSBOn)
@@ -448,6 +577,129 @@ static INLINE int32 AdjustDrawTiming(const int32 cycles)
 
 bool SetupDrawLine(int32* const cycle_counter, const bool AA, const bool Textured, const uint16 mode);
 
+//
+// Span fill for horizontal left-to-right lines in the common polygon case(untextured, 16bpp, not double interlace, no
+// mesh/MSB on/half-transparency against the framebuffer), 8 pixels at a time.  Stops(returning to the per-pixel loop in
+// DrawLine()) before any run of 8 that isn't entirely unclipped, wraps the 512-pixel framebuffer line, ends the line, or
+// might reach VDP1_SuspendResumeThreshold, so drawing, cycle counts, and suspend points are unchanged.
+//
+template<bool UserClipEn, bool UserClipMode, bool GouraudEn, bool HalfFGEn>
+static INLINE int32 DrawSpan16(line_inner_data* lidp, const int32 ret_base, const uint32 clipo, const uint32 uclipo0, const uint32 uclipo1)
+{
+ line_inner_data& lid = *lidp;
+ int32 ret = 0;
+
+ while(((lid.term_xy - lid.xy) & 0x7FF) >= 8 && (ret_base + ret + 8) < VDP1_SuspendResumeThreshold)
+ {
+  const uint32 pxy0 = (lid.xy + 1) & 0x07FF07FF;
+  uint32 clipped = 0;
+
+  if(((pxy0 & 0x1FF) + 7) > 0x1FF)
+   break;
+
+  for(unsigned i = 0; i < 8; i++)
+  {
+   const uint32 pxy = pxy0 + i;
+
+   if(UserClipEn && !UserClipMode)
+    clipped |= ((uclipo1 - pxy) | (pxy - uclipo0) | (clipo - pxy)) & 0x80008000;
+   else
+   {
+    clipped |= (clipo - pxy) & 0x80008000;
+
+    if(UserClipEn)
+     clipped |= !(((uclipo1 - pxy) | (pxy - uclipo0)) & 0x80008000);
+   }
+  }
+
+  if(clipped)
+   break;
+  //
+  uint16* const p = &FBDrawWhichPtr[((pxy0 >> 16) & 0xFF) << 9] + (pxy0 & 0x1FF);
+
+  if(GouraudEn)
+  {
+   alignas(16) uint16 gv[8];
+
+   for(unsigned i = 0; i < 8; i++)
+   {
+    gv[i] = lid.g.Current();
+    lid.g.Step();
+   }
+#if defined(HAVE_SSE2_INTRINSICS)
+   const __m128i c = _mm_set1_epi16(lid.color);
+   const __m128i g = _mm_load_si128((const __m128i*)gv);
+   const __m128i m = _mm_set1_epi16(0x1F);
+   const __m128i bias = _mm_set1_epi16(16);
+   const __m128i zero = _mm_setzero_si128();
+   __m128i r = _mm_and_si128(c, _mm_set1_epi16((int16)0x8000));
+
+   #define GCH(s) _mm_slli_epi16(_mm_min_epi16(_mm_max_epi16(_mm_sub_epi16(_mm_add_epi16(_mm_and_si128(_mm_srli_epi16(c, s), m), _mm_and_si128(_mm_srli_epi16(g, s), m)), bias), zero), m), s)
+   r = _mm_or_si128(r, _mm_or_si128(GCH(0), _mm_or_si128(GCH(5), GCH(10))));
+   #undef GCH
+
+   if(HalfFGEn)
+    r = _mm_or_si128(_mm_srli_epi16(_mm_and_si128(r, _mm_set1_epi16(0x7BDE)), 1), _mm_and_si128(r, _mm_set1_epi16((int16)0x8000)));
+
+   _mm_storeu_si128((__m128i*)p, r);
+#elif defined(HAVE_NEON_INTRINSICS)
+   const int16x8_t c = vdupq_n_s16(lid.color);
+   const int16x8_t g = vreinterpretq_s16_u16(vld1q_u16(gv));
+   const int16x8_t m = vdupq_n_s16(0x1F);
+   const int16x8_t bias = vdupq_n_s16(16);
+   const int16x8_t zero = vdupq_n_s16(0);
+   uint16x8_t r = vandq_u16(vreinterpretq_u16_s16(c), vdupq_n_u16(0x8000));
+
+   #define GCH(s) vshlq_n_u16(vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(vsubq_s16(vaddq_s16(vandq_s16(vreinterpretq_s16_u16(vshrq_n_u16(vreinterpretq_u16_s16(c), s)), m), vandq_s16(vreinterpretq_s16_u16(vshrq_n_u16(vreinterpretq_u16_s16(g), s)), m)), bias), zero), m)), s)
+   r = vorrq_u16(r, vorrq_u16(GCH(0), vorrq_u16(GCH(5), GCH(10))));
+   #undef GCH
+
+   if(HalfFGEn)
+    r = vorrq_u16(vshrq_n_u16(vandq_u16(r, vdupq_n_u16(0x7BDE)), 1), vandq_u16(r, vdupq_n_u16(0x8000)));
+
+   vst1q_u16(p, r);
+#else
+   for(unsigned i = 0; i < 8; i++)
+   {
+    uint16 pix = lid.color;
+
+    pix = (pix & 0x8000) | (gouraud_lut[(pix & 0x1F) + (gv[i] & 0x1F)]) | (gouraud_lut[((pix >> 5) & 0x1F) + ((gv[i] >> 5) & 0x1F)] << 5) | (gouraud_lut[((pix >> 10) & 0x1F) + ((gv[i] >> 10) & 0x1F)] << 10);
+
+    if(HalfFGEn)
+     pix = ((pix & 0x7BDE) >> 1) | (pix & 0x8000);
+
+    p[i] = pix;
+   }
+#endif
+  }
+  else
+  {
+   uint16 pix = lid.color;
+
+   if(HalfFGEn)
+    pix = ((pix & 0x7BDE) >> 1) | (pix & 0x8000);
+
+#if defined(HAVE_SSE2_INTRINSICS)
+   _mm_storeu_si128((__m128i*)p, _mm_set1_epi16(pix));
+#elif defined(HAVE_NEON_INTRINSICS)
+   vst1q_u16(p, vdupq_n_u16(pix));
+#else
+   for(unsigned i = 0; i < 8; i++)
+    p[i] = pix;
+#endif
+  }
+
+  if(MDFN_UNLIKELY(StatsActive))
+   StatsPixels += 8;
+
+  lid.xy = (pxy0 + 7) & 0x07FF07FF;
+  lid.drawn_ac = false;
+  ret += 8;
+ }
+
+ return ret;
+}
+
  /* hmm, possible problem with AA and drawn_ac...*/
  #define PBODY(pxy)											\
 	{												\
@@ -473,6 +725,9 @@ bool SetupDrawLine(int32* const cycle_counter, const bool AA, const bool Texture
 	   clipped |= !(((uclipo1 - pxy) | (pxy - uclipo0)) & 0x80008000); 				\
 	 }												\
 													\
+	 if(MDFN_UNLIKELY(StatsActive))									\
+	  StatsClipped += clipped;									\
+													\
 	 ret += PlotPixel<die, bpp8, MSBOn, UserClipEn, UserClipMode, MeshEn, GouraudEn, HalfFGEn, HalfBGEn>(px, py, pix, transparent | clipped, (GouraudEn ? &lid.g : NULL));	\
 	}
 
@@ -485,12 +740,22 @@ static int32 DrawLine(bool* need_line_resume)
  const uint32 uclipo1 = ((UserClipY1 & 0x3FF) << 16) | (UserClipX1 & 0x3FF);
  line_inner_data lid = LineInnerData;
  int32 ret = 0;
+ const bool span_en = !Textured && !die && !bpp8 && !MSBOn && !MeshEn && SPD && !HalfBGEn;
+ const bool span_ok = span_en && lid.xy_inc[0] == 1 && !lid.error_inc && (int32)lid.error < lid.error_cmp && !FBWorkerCount;
 
  do
  {
   bool transparent;
   uint16 pix;
 
+  if(span_en && span_ok)
+  {
+   ret += DrawSpan16<UserClipEn, UserClipMode, GouraudEn, HalfFGEn>(&lid, ret, clipo, uclipo0, uclipo1);
+
+   if(lid.xy == lid.term_xy)
+    break;
+  }
+
   if(Textured)
   {
    /*ret++;*/
@@ -35,6 +35,8 @@
 
 #include "vdp2_common.h"
 #include "vdp2_render.h"
+#include "hotmem.h"
+#include "automation_ss.h"
 
 namespace MDFN_IEN_SS
 {
@@ -88,10 +90,20 @@ static struct
  bool YIn;
 } Window[2];
 
-static uint16 VRAM[262144];
+static uint16 (&VRAM)[262144] = SS_HotMem.VDP2VRAM;
 
 static uint16 CRAM[2048];
 
+// One bit per 32 bytes written since TakeVRAMDirty()/TakeCRAMDirty(); CRAM by
+// CRAM[] index, which is what GetCRAMPtr() readers see.
+static uint64 VRAMDirty[0x80000 / 32 / 64];
+static uint64 CRAMDirty[0x1000 / 32 / 64];
+
+static INLINE void MarkCRAMDirty(const unsigned index)
+{
+ CRAMDirty[index >> 10] |= (uint64)1 << ((index >> 4) & 0x3F);
+}
+
 static struct
 {
  // Signed values are stored sign-extended to the full 32 bits.
@@ -357,11 +369,15 @@ void StartFrame(EmulateSpecStruct* espec, const bool clock28m)
  CRTLineCounter = 0;
 }
 
+// Automation_SetLineHook()
+static void (*LineHook)(uint32 line, bool vb_in, bool vb_out) = nullptr;
+
 //
 //
 static INLINE void IncVCounter(const sscpu_timestamp_t event_timestamp)
 {
  const unsigned prev_nlvc = GetNLVCounter();
+ const bool prev_vb = Out_VB;
  //
  VCounter = (VCounter + 1) & 0x1FF;
 
@@ -467,6 +483,9 @@ static INLINE void IncVCounter(const sscpu_timestamp_t event_timestamp)
  RecalcVRAMPenalty();
 
  SMPC_SetVBVS(event_timestamp, Out_VB, VPhase == VPHASE_VSYNC);
+
+ if(MDFN_UNLIKELY(LineHook != nullptr))
+  LineHook(VCounter, Out_VB && !prev_vb, prev_vb && !Out_VB);
 }
 
 static INLINE int32 AddHCounter(const sscpu_timestamp_t event_timestamp, int32 count)
@@ -764,6 +783,7 @@ static INLINE uint32 RW(uint32 A, uint16* DB)
    const unsigned mask = (sizeof(T) == 2) ? 0xFFFF : (0xFF00 >> ((A & 1) << 3));
 
    VRAM[vri] = (VRAM[vri] &~ mask) | (*DB & mask);
+   VRAMDirty[vri >> 10] |= (uint64)1 << ((vri >> 4) & 0x3F);
   }
   else
    *DB = VRAM[vri];
@@ -785,16 +805,20 @@ static INLINE uint32 RW(uint32 A, uint16* DB)
     case CRAM_MODE_RGB555_1024:
 	(CRAM + 0x000)[cri & 0x3FF] = *DB;
 	(CRAM + 0x400)[cri & 0x3FF] = *DB;
+	MarkCRAMDirty(cri & 0x3FF);
+	MarkCRAMDirty(0x400 | (cri & 0x3FF));
 	break;
 
     case CRAM_MODE_RGB555_2048:
 	CRAM[cri] = *DB;
+	MarkCRAMDirty(cri);
 	break;
 
     case CRAM_MODE_RGB888_1024:
     case CRAM_MODE_ILLEGAL:
     default:
 	CRAM[((cri >> 1) & 0x3FF) | ((cri & 1) << 10)] = *DB;
+	MarkCRAMDirty(((cri >> 1) & 0x3FF) | ((cri & 1) << 10));
 	break;
    }
   }
@@ -884,7 +908,7 @@ void AdjustTS(const int32 delta)
 }
 
 
-void Init(const bool IsPAL, const uint64 affinity)
+void Init(const bool IsPAL, const uint64 affinity, const unsigned nbg_workers, const bool tile_cache)
 {
  SurfInterlaceField = -1;
  PAL = IsPAL;
@@ -896,7 +920,7 @@ void Init(const bool IsPAL, const uint64 affinity)
 
  ExLatchIn = false;
 
- VDP2REND_Init(IsPAL, affinity);
+ VDP2REND_Init(IsPAL, affinity, nbg_workers, tile_cache);
 }
 
 void SetGetVideoParams(MDFNGI* gi, const bool caspect, const int sls, const int sle, const bool show_h_overscan, const bool dohblend)
@@ -919,6 +943,12 @@ void Kill(void)
 //
 void Reset(bool powering_up)
 {
+ if(powering_up)
+ {
+  memset(VRAMDirty, 0xFF, sizeof(VRAMDirty));
+  memset(CRAMDirty, 0xFF, sizeof(CRAMDirty));
+ }
+
  memset(RawRegs, 0, sizeof(RawRegs));
 
  DisplayOn = false;
@@ -1392,6 +1422,16 @@ uint8 PeekVRAM(uint32 addr)
  return ne16_rbo_be<uint8>(VRAM, addr & 0x7FFFF);
 }
 
+const uint16* GetVRAMPtr(void)
+{
+ return VRAM;
+}
+
+const uint16* GetCRAMPtr(void)
+{
+ return CRAM;
+}
+
 uint8 PeekCRAM(uint32 addr)
 {
  addr &= 0xFFF;
@@ -1404,9 +1444,22 @@ void PokeVRAM(uint32 addr, const uint8 val)
  addr &= 0x7FFFF;
 
  ne16_wbo_be<uint8>(VRAM, addr, val);
+ VRAMDirty[addr >> 11] |= (uint64)1 << ((addr >> 5) & 0x3F);
  VDP2REND_Write16_DB(addr & ~1, ne16_rbo_be<uint16>(VRAM, addr & ~1));
 }
 
+void TakeVRAMDirty(uint64* bits)
+{
+ memcpy(bits, VRAMDirty, sizeof(VRAMDirty));
+ memset(VRAMDirty, 0, sizeof(VRAMDirty));
+}
+
+void TakeCRAMDirty(uint64* bits)
+{
+ memcpy(bits, CRAMDirty, sizeof(CRAMDirty));
+ memset(CRAMDirty, 0, sizeof(CRAMDirty));
+}
+
 void SetLayerEnableMask(uint64 mask)
 {
  VDP2REND_SetLayerEnableMask(mask);
@@ -1537,6 +1590,12 @@ void StateAction(StateMem* sm, const unsigned load, const bool data_only)
  }
 
  VDP2REND_StateAction(sm, load, data_only, RawRegs, CRAM, VRAM);
+
+ if(load)
+ {
+  memset(VRAMDirty, 0xFF, sizeof(VRAMDirty));
+  memset(CRAMDirty, 0xFF, sizeof(CRAMDirty));
+ }
 }
 
 void DumpRawRegsBin(const char* path)
@@ -1578,4 +1637,13 @@ void MakeDump(const std::string& path)
 
 }
 
+//
+// Called at the start of every line(the VDP2 HSYNC event) with the new line counter(0 = first line of the active
+// display) and whether VBlank output just went on or off; no per-instruction cost when unset.
+//
+void Automation_SetLineHook(void (*hook)(uint32 line, bool vb_in, bool vb_out))
+{
+ VDP2::LineHook = hook;
+}
+
 }
@@ -31,7 +31,7 @@ uint32 Write8_DB(uint32 A, uint16 DB) MDFN_HOT;
 uint32 Write16_DB(uint32 A, uint16 DB) MDFN_HOT;
 uint16 Read16_DB(uint32 A) MDFN_HOT;
 
-void Init(const bool IsPAL, const uint64 affinity) MDFN_COLD;
+void Init(const bool IsPAL, const uint64 affinity, const unsigned nbg_workers, const bool tile_cache) MDFN_COLD;
 void SetGetVideoParams(MDFNGI* gi, const bool caspect, const int sls, const int sle, const bool show_h_overscan, const bool dohblend) MDFN_COLD;
 void Kill(void) MDFN_COLD;
 void StateAction(StateMem* sm, const unsigned load, const bool data_only) MDFN_COLD;
@@ -151,6 +151,12 @@ uint8 PeekVRAM(uint32 addr) MDFN_COLD;
 uint8 PeekCRAM(uint32 addr);
 void PokeVRAM(uint32 addr, const uint8 val) MDFN_COLD;
 void DumpRawRegsBin(const char* path);
+const uint16* GetVRAMPtr(void);	// automation bulk reads(big-endian 16-bit words)
+const uint16* GetCRAMPtr(void);
+// 32-byte blocks written since the last call (bit n of word i = block i * 64 + n), then cleared; automation vram_delta.
+enum { VRAMDirty_Words = 0x80000 / 32 / 64, CRAMDirty_Words = 0x1000 / 32 / 64 };
+void TakeVRAMDirty(uint64* bits) MDFN_COLD;
+void TakeCRAMDirty(uint64* bits) MDFN_COLD;
 void MakeDump(const std::string& path) MDFN_COLD;
 
 INLINE uint32 PeekLine(void) { MDFN_HIDE extern int32 VCounter; return VCounter; }
@@ -30,8 +30,20 @@
 #include <mednafen/MThreading.h>
 #include "vdp2_common.h"
 #include "vdp2_render.h"
+#include "hotmem.h"
+#include "automation_ss.h"
+#include "perf_clock.h"
+#include "zblock.h"
+#include <mednafen/MemoryStream.h>
 
 #include <atomic>
+#include <chrono>
+
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#elif defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
 
 namespace MDFN_IEN_SS
 {
@@ -47,8 +59,9 @@ static int LineVisFirst, LineVisLast;
 static uint32 NextOutLine;
 static bool Clock28M;
 static unsigned VisibleLines;
-static VDP2Rend_LIB LIB[256];
-static uint16 VRAM[262144];
+static VDP2Rend_LIB (&LIB)[256] = SS_HotMem.VDP2RendLIB;
+static uint16 (&VRAM)[262144] = SS_HotMem.VDP2RendVRAM;
+static uint32 VRAMGen[262144 >> 4];	// incremented by each write to the 16-word block, for the tile cache
 static uint16 CRAM[2048];
 
 static uint8 HRes, VRes;
@@ -455,6 +468,7 @@ struct RotVars
  int32 kx, ky;	// .16
 
  bool use_coeff;
+ uint8 coeff_mode;	// (KTCTL >> 2) & 0x3
  uint32 base_coeff;
 
  TileFetcher<true> tf;
@@ -468,11 +482,6 @@ static struct
  {
   uint64 nbg[4][8 + 704 + 8];
   struct
-  {
-   uint8 dummy[sizeof(nbg) / 2];
-   uint16 vcscr[2][88 + 1 + 1];	// + 1 for fine x scroll != 0, + 1 for pointer shenanigans in FetchVCScroll
-  };
-  struct
   {
    uint8 rotdummy[sizeof(nbg) / 4];
    uint8 rotabsel[352];	// Also used as a scratch buffer in T_DrawRBG() to handle mosaic-related junk.
@@ -480,7 +489,11 @@ static struct
    uint32 rotcoeff[352];
   };
  };
+ uint16 vcscr[2][88 + 1 + 1];	// + 1 for fine x scroll != 0, + 1 for pointer shenanigans in FetchVCScroll; not
+				// overlapping nbg[2], since NBG0/1 may be drawn concurrently with NBG2/3(see NBGJob).
  alignas(16) uint8 lc[704];
+ alignas(16) uint64 mix[704];	// MixIt() top pixel, prior to color calc, color offset and shadow(see MixFinish())
+ alignas(16) uint32 mixsec[704];	// if its PIX_CCE, second color in bits 0-23 and top pixel's ratio ^ 0x1F in bits 24-28
 } LB;
 
 // ColorOffsEn, etc. ?...hmm, discrepancy with ColorCalcEn and LineColorEn...
@@ -502,8 +515,11 @@ enum
 //
 //
 static uint32 ColorCache[2048];
+static uint32 ColorCacheGen;	// incremented by each ColorCache update, for the tile cache
 static void CacheCRE(const unsigned cri)
 {
+ ColorCacheGen++;
+
  if(CRAM_Mode & CRAM_MODE_RGB888_1024)
  {
   (ColorCache + 0x000)[cri >> 1] = (ColorCache + 0x400)[cri >> 1] = (((CRAM + 0x000)[(cri >> 1) & 0x3FF] & 0x80FF) << 16) | ((CRAM + 0x400)[(cri >> 1) & 0x3FF] << 0);
@@ -536,12 +552,15 @@ static void RecalcColorCache(void)
  }
 }
 
+static uint16 RegsShadow[0x100];	// Last value written to each register, for frame capture; mirrors vdp2.cpp's RawRegs.
+
 //
 // Register writes seem to always be 16-bit
 //
 static INLINE void RegsWrite(uint32 A, uint16 V)
 {
  A &= 0x1FE;
+ RegsShadow[A >> 1] = V;
 
  switch(A)
  {
@@ -950,6 +969,7 @@ static INLINE void MemW(uint32 A, const uint16 DB)
   const unsigned mask = (sizeof(T) == 2) ? 0xFFFF : (0xFF00 >> ((A & 1) << 3));
 
   VRAM[vri] = (VRAM[vri] &~ mask) | (DB & mask);
+  VRAMGen[vri >> 4]++;
 
   return;
  }
@@ -1004,6 +1024,7 @@ static void Reset(bool powering_up)
   memset(VRAM, 0, sizeof(VRAM));
   memset(CRAM, 0, sizeof(CRAM));
  }
+ memset(RegsShadow, 0, sizeof(RegsShadow));
  //
  //
  CRKTE = false;
@@ -1489,6 +1510,64 @@ static INLINE uint32 rgb15_to_rgb24(uint16 src)
  return ((((src << 3) & 0xF8) | ((src << 6) & 0xF800) | ((src << 9) & 0xF80000) | ((src << 16) & 0x80000000)));;
 }
 
+//
+// Optional decoded cell row cache(setting "ss.vdp2_tile_cache") for the NBG character layers: the 8 pixels of a cell row,
+// as produced by MakeNBGRBGPix()/MakeNBG23Pix() for a given fetch, keyed by the character data address, palette offset,
+// pixel base flags, the draw function's mode, the special function code, and the pattern name data's flip, priority and
+// color calc bits.  An entry is only used while the VRAM block holding the row and the color cache are unwritten since it
+// was filled.  One table per NBG, since each layer is drawn by only one thread at a time(see NBGJob).
+//
+struct TileCacheEntry
+{
+ uint32 cg_addr;
+ uint32 pcco;
+ uint32 pbor;
+ uint32 meta;	// bit 31 set on valid entries
+ uint32 vram_gen;
+ uint32 cc_gen;
+ uint64 pix[8];	// NBG0/1: indexed by (x & 7); NBG2/3: in output order
+};
+
+enum : unsigned { TileCache_Bits = 9 };
+static bool TileCacheEnable;
+static TileCacheEntry TileCache[4][1U << TileCache_Bits];
+
+template<unsigned TA_bpp, bool TA_isrgb, bool TA_igntp, unsigned TA_PrioMode, unsigned TA_CCMode>
+static INLINE uint32 TileCacheMeta(const unsigned n)
+{
+ const uint8 code = SFCODE >> (((SFSEL >> n) & 1) << 3);
+
+ return 0x80000000U | TA_bpp | (TA_isrgb << 6) | (TA_igntp << 7) | (TA_PrioMode << 8) | (TA_CCMode << 10) | ((n >= 2) << 12) | (code << 16);
+}
+
+// Returns nullptr if the row can't be cached; otherwise the row's entry, with *hit set if its pixels are current, or its key
+// set up for the caller to fill in the pixels.
+template<typename T>
+static INLINE TileCacheEntry* TileCacheLookup(const unsigned n, const T& tf, const uint32 pbor, uint32 meta, bool* hit)
+{
+ if(tf.tile_vrb == DummyTileNT)
+  return nullptr;
+
+ const uint32 cg_addr = tf.tile_vrb - VRAM;
+ const uint32 vram_gen = VRAMGen[cg_addr >> 4];
+ TileCacheEntry* e = &TileCache[n][((cg_addr ^ (tf.pcco << 9)) * 0x9E3779B1U) >> (32 - TileCache_Bits)];
+
+ meta |= (tf.spr << 24) | (tf.scc << 25) | ((tf.cellx_xor & 0x7) ? (1U << 26) : 0);
+
+ *hit = (e->cg_addr == cg_addr && e->pcco == tf.pcco && e->pbor == pbor && e->meta == meta && e->vram_gen == vram_gen && e->cc_gen == ColorCacheGen);
+ if(!*hit)
+ {
+  e->cg_addr = cg_addr;
+  e->pcco = tf.pcco;
+  e->pbor = pbor;
+  e->meta = meta;
+  e->vram_gen = vram_gen;
+  e->cc_gen = ColorCacheGen;
+ }
+
+ return e;
+}
+
 template<bool TA_bmen, unsigned TA_bpp, bool TA_isrgb, bool TA_igntp, unsigned TA_PrioMode, unsigned TA_CCMode, typename T>
 static INLINE uint64 MakeNBGRBGPix(T& tf, const uint32 pix_base_or, const int16* sfcode_lut, const uint32 ix, const uint32 iy)
 {
@@ -1617,6 +1696,43 @@ static void T_DrawNBG(const unsigned n, uint64* bgbuf, const unsigned w, const u
    xc += xcinc;
   }
  }
+ else if(!TA_bmen && TileCacheEnable)
+ {
+  const uint32 tc_meta = TileCacheMeta<TA_bpp, TA_isrgb, TA_igntp, TA_PrioMode, TA_CCMode>(n);
+  uint64 row_tmp[8];
+  const uint64* row = row_tmp;
+
+  for(unsigned i = 0; MDFN_LIKELY(i < w); i++)
+  {
+   const uint32 ix = xc >> 8;
+
+   if((ix >> 3) != prev_ix)
+   {
+    prev_ix = ix >> 3;
+    //
+    if(VCSEn)
+     iy = LB.vcscr[n][(i + 7) >> 3];
+
+    tf.Fetch<TA_bpp>(TA_bmen, ix, iy);
+
+    bool hit;
+    TileCacheEntry* e = TileCacheLookup(n, tf, pix_base_or, tc_meta, &hit);
+    uint64* dst = e ? e->pix : row_tmp;
+
+    if(!e || !hit)
+    {
+     for(unsigned x = 0; x < 8; x++)
+      dst[x] = MakeNBGRBGPix<TA_bmen, TA_bpp, TA_isrgb, TA_igntp, TA_PrioMode, TA_CCMode>(tf, pix_base_or, sfcode_lut, (ix &~ 0x7) | x, iy);
+    }
+    row = dst;
+   }
+   //
+   //
+   //
+   bgbuf[i] = row[ix & 0x7];
+   xc += xcinc;
+  }
+ }
  else
  {
   for(unsigned i = 0; MDFN_LIKELY(i < w); i++)
@@ -1731,9 +1847,12 @@ static void T_DrawNBG23(const unsigned n, uint64* bgbuf, const unsigned w, const
   tc--;
  }
 
+ const uint32 tc_meta = TileCacheMeta<TA_bpp, false, TA_igntp, TA_PrioMode, TA_CCMode>(n);
+
  while(MDFN_LIKELY(tc--))
  {
   uint32 pbor = pix_base_or;
+  TileCacheEntry* tce = nullptr;
 
   tf.Fetch<TA_bpp>(false, tx << 3, yscr);
 
@@ -1742,6 +1861,20 @@ static void T_DrawNBG23(const unsigned n, uint64* bgbuf, const unsigned w, const
 
   if(TA_PrioMode == 1 || TA_PrioMode == 2)
    pbor |= (tf.spr << PIX_PRIO_SHIFT);
+
+  if(TileCacheEnable)
+  {
+   bool hit;
+
+   tce = TileCacheLookup(n, tf, pbor, tc_meta, &hit);
+   if(tce && hit)
+   {
+    memcpy(bgbuf, tce->pix, sizeof(tce->pix));
+    tx++;
+    bgbuf += 8;
+    continue;
+   }
+  }
   //
   //
   auto* const mbp = MakeNBG23Pix<TA_igntp, TA_PrioMode, TA_CCMode>;
@@ -1797,6 +1930,9 @@ static void T_DrawNBG23(const unsigned n, uint64* bgbuf, const unsigned w, const
    }
   }
 
+  if(tce)
+   memcpy(tce->pix, bgbuf, sizeof(tce->pix));
+
   //
   //
   //
@@ -1848,6 +1984,54 @@ static INLINE uint32 ReadCoeff(const unsigned i, const uint32 addr)
  return coeff;
 }
 
+// One line of per-dot coefficients for a single rotation parameter set(RPMD 0/1, or 2 with parameter A's coefficients
+// choosing between A and B), with the KTCTL data size and line color enable hoisted out of the loop; same results as
+// GetCoeffAddr() + ReadCoeff() per dot.
+template<bool TA_half, bool TA_lc, bool TA_rpmd2>
+static void T_ReadCoeffLine(uint32 accum, const uint32 dkax, const bool* bank_tab, const unsigned rbg_w, const uint32 coeff_b)
+{
+ const uint16* src = (CRKTE ? &CRAM[0x400] : VRAM);
+ const uint32 src_mask = (CRKTE ? 0x3FF : 0x3FFFF);
+
+ for(unsigned x = 0; MDFN_LIKELY(x < rbg_w); x++)
+ {
+  const uint32 addr = ((accum >> 10) << !TA_half) & src_mask;
+  uint32 coeff = 0;
+
+  accum += dkax;
+
+  if(bank_tab[addr >> 16])
+  {
+   if(TA_half)
+   {
+    const uint16 tmp = src[addr];
+    coeff = (sign_x_to_s32(21, tmp << 6) & 0x00FFFFFF) | ((tmp & 0x8000) << 16);
+   }
+   else
+    coeff = (src[addr] << 16) | src[addr + 1];
+  }
+
+  if(TA_lc)
+   LB.lc[x] = (coeff >> 24) & 0x7F;
+
+  if(TA_rpmd2)
+  {
+   LB.rotabsel[x] = coeff >> 31;
+
+   if((int32)coeff < 0)
+    coeff = coeff_b;
+  }
+
+  LB.rotcoeff[x] = coeff;
+ }
+}
+
+static void (*const ReadCoeffLine[2][2][2])(uint32 accum, const uint32 dkax, const bool* bank_tab, const unsigned rbg_w, const uint32 coeff_b) =
+{
+ { { T_ReadCoeffLine<0, 0, 0>, T_ReadCoeffLine<0, 0, 1> }, { T_ReadCoeffLine<0, 1, 0>, T_ReadCoeffLine<0, 1, 1> } },
+ { { T_ReadCoeffLine<1, 0, 0>, T_ReadCoeffLine<1, 0, 1> }, { T_ReadCoeffLine<1, 1, 0>, T_ReadCoeffLine<1, 1, 1> } },
+};
+
 // Coefficient table reading can (temporarily) override kx, ky, and/or Xp
 //
 // When RBG1 is enabled, line color screen uses rotation parameter A coefficient table
@@ -1963,12 +2147,63 @@ static void SetupRotVars(const T* rs, const unsigned rbg_w)
   //
   LB.rotv[0].use_coeff = (bool)(KTCTL[0] & 0x1);
   LB.rotv[1].use_coeff = (bool)(KTCTL[1] & 0x1);
+  LB.rotv[0].coeff_mode = (KTCTL[0] >> 2) & 0x3;
+  LB.rotv[1].coeff_mode = (KTCTL[1] >> 2) & 0x3;
 
   uint32 coeff[2];
 
   for(unsigned i = 0; i < 2; i++)
    LB.rotv[i].base_coeff = coeff[i] = ReadCoeff(i, GetCoeffAddr(i, rs[i].KAstAccum));
 
+  if(perdot_mask)
+  {
+   //
+   // Not per-dot: every dot gets the line's first coefficient(s).
+   //
+   if(EffRPMD == 2)
+   {
+    const uint8 sel = coeff[0] >> 31;
+    const uint32 c = ((int32)coeff[0] < 0) ? coeff[1] : coeff[0];
+
+    for(unsigned x = 0; MDFN_LIKELY(x < rbg_w); x++)
+    {
+     LB.rotabsel[x] = sel;
+     LB.rotcoeff[x] = c;
+    }
+
+    if(KTCTL[0] & 0x10)
+     memset(LB.lc, (coeff[0] >> 24) & 0x7F, rbg_w);
+   }
+   else if(EffRPMD < 2 && RPMD < 2)
+   {
+    for(unsigned x = 0; MDFN_LIKELY(x < rbg_w); x++)
+     LB.rotcoeff[x] = coeff[RPMD];
+
+    if(KTCTL[RPMD] & 0x10)
+     memset(LB.lc, (coeff[RPMD] >> 24) & 0x7F, rbg_w);
+   }
+   else
+   {
+    for(unsigned x = 0; MDFN_LIKELY(x < rbg_w); x++)
+    {
+     const unsigned i = LB.rotabsel[x];
+
+     if(KTCTL[i] & 0x10)
+      LB.lc[x] = (coeff[i] >> 24) & 0x7F;
+
+     LB.rotcoeff[x] = coeff[i];
+    }
+   }
+   return;
+  }
+  else if(EffRPMD == 2 || (EffRPMD < 2 && RPMD < 2))
+  {
+   const unsigned i = (EffRPMD == 2) ? 0 : RPMD;
+
+   ReadCoeffLine[(bool)(KTCTL[i] & 0x2)][(bool)(KTCTL[i] & 0x10)][EffRPMD == 2](rs[i].KAstAccum, rs[i].DKAx, bank_tab, rbg_w, coeff[1]);
+   return;
+  }
+
   //if(grumpus == 8)
   // printf("BankTab: %d %d %d %d, UC: %d %d, Coeff: @0x%05x=0x%08x @0x%05x=0x%08x, DKAx: %f %f\n", bank_tab[0], bank_tab[1], bank_tab[2], bank_tab[3], LB.rotv[0].use_coeff, LB.rotv[1].use_coeff, GetCoeffAddr(0, rs[0].KAstAccum), coeff[0], GetCoeffAddr(1, rs[1].KAstAccum), coeff[1], rs[0].DKAx / 1024.0, rs[1].DKAx / 1024.0);
 
@@ -2039,7 +2274,7 @@ static void T_DrawRBG(const bool rn, uint64* bgbuf, const unsigned w, const uint
 
    const uint32 sext = sign_x_to_s32(24, coeff);
  
-   switch((KTCTL[ab] >> 2) & 0x3)
+   switch(r.coeff_mode)
    {
     case 0: kx = ky = sext; break;
     case 1: kx = sext; break;
@@ -2135,81 +2370,59 @@ static INLINE void MakeSpriteCCLUT(void)
   SpriteCC3Mask = 1U << PIX_CCE_SHIFT;
 }
 
-template<bool TA_HiRes, bool TA_TPShadSel, unsigned TA_SPCTL_Low>
-static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsigned w)
+// Decodes one sprite framebuffer pixel(after the 8-bit hires expansion) for the current line's settings.
+template<bool TA_TPShadSel, unsigned TA_SPCTL_Low>
+static INLINE uint64 T_DecodeSpritePix(unsigned src, const size_t cao, const uint32 spix_base_or)
 {
  const unsigned SpriteType = (TA_SPCTL_Low & 0xF);
  const bool SpriteWinEn = (TA_SPCTL_Low & 0x10);
  const bool SpriteColorMode = (TA_SPCTL_Low & 0x20);
- //
- const size_t cao = CRAMAddrOffs_Sprite << 8;
- uint32 spix_base_or = 0;
-
- spix_base_or |= ((ColorOffsEn >> 6) & 1) << PIX_COE_SHIFT;
- spix_base_or |= ((ColorOffsSel >> 6) & 1) << PIX_COSEL_SHIFT;
- spix_base_or |= ((LineColorEn >> 5/*5 here, not 6*/) & 1) << PIX_LCE_SHIFT;
- spix_base_or |= (((CCCTL >> 12) & 0x7) == 0x0) << PIX_GRAD_SHIFT;
- spix_base_or |= ((CCCTL >> 6) & 1) << PIX_LAYER_CCE_SHIFT;
+ unsigned pr = 0, cc = 0;
+ bool tp = false;
+ uint64 spix;
 
- for(unsigned i = 0; MDFN_LIKELY(i < w); i++)
+ if(SpriteColorMode && (src & 0x8000))
  {
-  unsigned src;
-  unsigned pr = 0, cc = 0;
-  bool tp = false;
-  uint64 spix;
-
-  src = vdp1sb[i >> TA_HiRes];
-
-  if(vdp1_hires8)
-  {
-   if(TA_HiRes)
-    src = 0xFF00 | (src >> (((i & 1) ^ 1) << 3));
-   else
-    src = 0xFF00 | (src >> 8);
-  }
+  spix = (uint64)rgb15_to_rgb24(src) << PIX_RGB_SHIFT;
+  spix |= 1U << PIX_ISRGB_SHIFT;
+  spix |= SpriteCC3Mask;
 
-  if(SpriteColorMode && (src & 0x8000))
+  if(SpriteType & 0x8)
+   tp = !(src & 0xFF);
+  else if(SpriteWinEn)
   {
-   spix = (uint64)rgb15_to_rgb24(src) << PIX_RGB_SHIFT;
-   spix |= 1U << PIX_ISRGB_SHIFT;
-   spix |= SpriteCC3Mask;
-
-   if(SpriteType & 0x8)
-    tp = !(src & 0xFF);
-   else if(SpriteWinEn)
-   {
-    if(SpriteType >= 0x2 && SpriteType <= 0x7)
-     tp = !(src & 0x7FFF);
-   }
+   if(SpriteType >= 0x2 && SpriteType <= 0x7)
+    tp = !(src & 0x7FFF);
   }
-  else
-  {
-   bool nshad = false;
-   bool sd = false;
-   unsigned dc;
+ }
+ else
+ {
+  bool nshad = false;
+  bool sd = false;
+  unsigned dc;
 
-   if(SpriteType & 0x8)
-    src &= 0xFF;
+  if(SpriteType & 0x8)
+   src &= 0xFF;
 
-   tp = !src;
+  tp = !src;
 
-   switch(SpriteType)
-   {
-     case 0x0:
+  switch(SpriteType)
+  {
+    case 0x0:
 	pr = (src >> 14) & 0x3;
 	cc = (src >> 11) & 0x7;
 	dc = src & 0x7FF;
 	nshad = (dc == 0x7FE);
 	break;
 
-     case 0x1:
+    case 0x1:
 	pr = (src >> 13) & 0x7;
 	cc = (src >> 11) & 0x3;
 	dc = src & 0x7FF;
 	nshad = (dc == 0x7FE);
 	break;
 
-     case 0x2:
+    case 0x2:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 14) & 0x1;
 	cc = (src >> 11) & 0x7;
@@ -2217,7 +2430,7 @@ static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsig
 	nshad = (dc == 0x7FE);
 	break;
 
-     case 0x3:
+    case 0x3:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 13) & 0x3;
 	cc = (src >> 11) & 0x3;
@@ -2225,7 +2438,7 @@ static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsig
 	nshad = (dc == 0x7FE);
 	break;
 
-     case 0x4:
+    case 0x4:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 13) & 0x3;
 	cc = (src >> 10) & 0x7;
@@ -2233,7 +2446,7 @@ static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsig
 	nshad = (dc == 0x3FE);
 	break;
 
-     case 0x5:
+    case 0x5:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 12) & 0x7;
 	cc = (src >> 11) & 0x1;
@@ -2241,7 +2454,7 @@ static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsig
 	nshad = (dc == 0x7FE);
 	break;
 
-     case 0x6:
+    case 0x6:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 12) & 0x7;
 	cc = (src >> 10) & 0x3;
@@ -2249,105 +2462,168 @@ static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsig
 	nshad = (dc == 0x3FE);
 	break;
 
-     case 0x7:
+    case 0x7:
 	sd = (src >> 15) & 0x1;
 	pr = (src >> 12) & 0x7;
 	cc = (src >>  9) & 0x7;
 	dc = src & 0x1FF;
 	nshad = (dc == 0x1FE);
 	break;
-     //
-     //
-     //
-     case 0x8:
+    //
+    //
+    //
+    case 0x8:
 	pr = (src >> 7) & 0x1;
 	dc = src & 0x7F;
 	nshad = (dc == 0x7E);
 	break;
 
-     case 0x9:
+    case 0x9:
 	pr = (src >> 7) & 0x1;
 	cc = (src >> 6) & 0x1;
 	dc = src & 0x3F;
 	nshad = (dc == 0x3E);
 	break;
 
-     case 0xA:
+    case 0xA:
 	pr = (src >> 6) & 0x3;
 	dc = src & 0x3F;
 	nshad = (dc == 0x3E);
 	break;
 
-     case 0xB:
+    case 0xB:
 	cc = (src >> 6) & 0x3;
 	dc = src & 0x3F;
 	nshad = (dc == 0x3E);
 	break;
-     //
-     case 0xC:
+    //
+    case 0xC:
 	pr = (src >> 7) & 0x1;
 	dc = src & 0xFF;
 	nshad = (dc == 0xFE);
 	break;
 
-     case 0xD:
+    case 0xD:
 	pr = (src >> 7) & 0x1;
 	cc = (src >> 6) & 0x1;
 	dc = src & 0xFF;
 	nshad = (dc == 0xFE);
 	break;
 
-     case 0xE:
+    case 0xE:
 	pr = (src >> 6) & 0x3;
 	dc = src & 0xFF;
 	nshad = (dc == 0xFE);
 	break;
 
-     case 0xF:
+    case 0xF:
 	cc = (src >> 6) & 0x3;
 	dc = src & 0xFF;
 	nshad = (dc == 0xFE);
 	break;
+  }
+  //
+  //
+  //
+  uint32 rgb24 = ColorCache[(cao + dc) & 0x7FF];
+
+  spix = (uint64)rgb24 << PIX_RGB_SHIFT;
+
+  spix |= ((int32)rgb24 >> 31) & SpriteCC3Mask;
+
+  if(SpriteWinEn)	// Sprite window enable
+   spix |= ((uint64)sd << PIX_SWBIT_SHIFT);
+
+  if(nshad)
+   spix |= 1 << PIX_DOSHAD_SHIFT;
+  else
+  {
+   if(SpriteWinEn)
+   {
+    if(SpriteType >= 0x2 && SpriteType <= 0x7)
+     tp = !(src & 0x7FFF);
    }
-   //
-   //
-   //
-   uint32 rgb24 = ColorCache[(cao + dc) & 0x7FF];
+   else if(sd)
+   {
+    if(src & 0x7FFF)
+     spix |= 1 << PIX_SELFSHAD_SHIFT;
+    else if(TA_TPShadSel)
+     spix |= 1 << PIX_DOSHAD_SHIFT;
+    else
+     tp = true;
+   }
+  }
+ }
+
+ spix |= spix_base_or;
+ spix |= (tp ? 0 : SpritePrioNum[pr]) << PIX_PRIO_SHIFT;
+ spix |= SpriteCCRatio[cc] << PIX_CCRATIO_SHIFT;
+ spix |= SpriteCCLUT[pr];
+
+ return spix;
+}
+
+//
+// The decode depends only on the pixel value, so runs of the same value(transparent areas, flat fills) reuse the
+// previous result, and the 8-bit palette types, which only look at the low 8 bits, memoize all 256 values per line.
+//
+template<bool TA_HiRes, bool TA_TPShadSel, unsigned TA_SPCTL_Low>
+static void T_DrawSpriteData(const uint16* vdp1sb, const bool vdp1_hires8, unsigned w)
+{
+ const unsigned SpriteType = (TA_SPCTL_Low & 0xF);
+ const bool SpriteColorMode = (TA_SPCTL_Low & 0x20);
+ //
+ const size_t cao = CRAMAddrOffs_Sprite << 8;
+ uint32 spix_base_or = 0;
+
+ spix_base_or |= ((ColorOffsEn >> 6) & 1) << PIX_COE_SHIFT;
+ spix_base_or |= ((ColorOffsSel >> 6) & 1) << PIX_COSEL_SHIFT;
+ spix_base_or |= ((LineColorEn >> 5/*5 here, not 6*/) & 1) << PIX_LCE_SHIFT;
+ spix_base_or |= (((CCCTL >> 12) & 0x7) == 0x0) << PIX_GRAD_SHIFT;
+ spix_base_or |= ((CCCTL >> 6) & 1) << PIX_LAYER_CCE_SHIFT;
 
-   spix = (uint64)rgb24 << PIX_RGB_SHIFT;
+ uint64 lut8[(SpriteType & 0x8) ? 256 : 1];
+ bool lut8_valid[(SpriteType & 0x8) ? 256 : 1];
+ unsigned prev_src = ~0U;
+ uint64 prev_spix = 0;
 
-   spix |= ((int32)rgb24 >> 31) & SpriteCC3Mask;
+ if(SpriteType & 0x8)
+  memset(lut8_valid, 0, sizeof(lut8_valid));
+
+ for(unsigned i = 0; MDFN_LIKELY(i < w); i++)
+ {
+  unsigned src;
 
-   if(SpriteWinEn)	// Sprite window enable
-    spix |= ((uint64)sd << PIX_SWBIT_SHIFT);
+  src = vdp1sb[i >> TA_HiRes];
 
-   if(nshad)
-    spix |= 1 << PIX_DOSHAD_SHIFT;
+  if(vdp1_hires8)
+  {
+   if(TA_HiRes)
+    src = 0xFF00 | (src >> (((i & 1) ^ 1) << 3));
    else
+    src = 0xFF00 | (src >> 8);
+  }
+
+  if(src != prev_src)
+  {
+   prev_src = src;
+
+   if((SpriteType & 0x8) && !(SpriteColorMode && (src & 0x8000)))
    {
-    if(SpriteWinEn)
-    {
-     if(SpriteType >= 0x2 && SpriteType <= 0x7)
-      tp = !(src & 0x7FFF);
-    }
-    else if(sd)
+    const uint8 k = src;
+
+    if(!lut8_valid[k])
     {
-     if(src & 0x7FFF)
-      spix |= 1 << PIX_SELFSHAD_SHIFT;
-     else if(TA_TPShadSel)
-      spix |= 1 << PIX_DOSHAD_SHIFT;
-     else
-      tp = true;
+     lut8[k] = T_DecodeSpritePix<TA_TPShadSel, TA_SPCTL_Low>(src, cao, spix_base_or);
+     lut8_valid[k] = true;
     }
+    prev_spix = lut8[k];
    }
+   else
+    prev_spix = T_DecodeSpritePix<TA_TPShadSel, TA_SPCTL_Low>(src, cao, spix_base_or);
   }
 
-  spix |= spix_base_or;
-  spix |= (tp ? 0 : SpritePrioNum[pr]) << PIX_PRIO_SHIFT;
-  spix |= SpriteCCRatio[cc] << PIX_CCRATIO_SHIFT;
-  spix |= SpriteCCLUT[pr];
-
-  LB.spr[i] = spix;
+  LB.spr[i] = prev_spix;
  }
 }
 
@@ -2377,45 +2653,235 @@ enum
  MIXIT_SPECIAL_HIRES_CRAM12 = 0x6
 };
 
-template<bool TA_rbgdualen, unsigned TA_Special, bool TA_CCRTMD, bool TA_CCMD>
-static void T_MixIt(uint32* target, const unsigned vdp2_line, const unsigned w, const uint32 back_rgb24, const uint64* blursrc)
+//
+// Last stage of MixIt(): color calculation, color offset and sprite shadow for each LB.mix[] pixel, and the conversion to the
+// target's 32-bit pixels.  Every pixel goes through the same arithmetic with only per-pixel flags deciding which results are
+// kept, so this part is done with SSE2 or NEON when available; the vector versions must stay bit-identical to the scalar one.
+//
+template<bool TA_CCMD>
+static INLINE uint32 MixFinishPix(uint64 pix, const uint32 sec)
 {
- //printf("MixIt: %d, %d, %d, %d\n", TA_rbgdualen, TA_Special, TA_CCRTMD, TA_CCMD);
- const uint32* lclut = &ColorCache[CurLCColor &~ 0x7F];
- uint32 blurprev[2];
+ if(pix & (1U << PIX_CCE_SHIFT))
+ {
+  const uint32 fore_rgb = pix >> PIX_RGB_SHIFT;
+  const uint32 sec_rgb = sec;
+  uint32 new_rgb;
 
- if(TA_Special == MIXIT_SPECIAL_GRAD)
-  blurprev[0] = blurprev[1] = *blursrc >> PIX_RGB_SHIFT;
+  if(TA_CCMD)	// Ignore ratio, add as-is.
+  {
+   new_rgb =  std::min<unsigned>(0x0000FF, (fore_rgb & 0x0000FF) + (sec_rgb & 0x0000FF));
+   new_rgb |= std::min<unsigned>(0x00FF00, (fore_rgb & 0x00FF00) + (sec_rgb & 0x00FF00));
+   new_rgb |= std::min<unsigned>(0xFF0000, (fore_rgb & 0xFF0000) + (sec_rgb & 0xFF0000));
+  }
+  else
+  {
+   unsigned fore_ratio = sec >> 24;
+   unsigned sec_ratio = 0x20 - fore_ratio;
 
- uint32 line_pix_l;
- {
-  line_pix_l = 0U << PIX_ISRGB_SHIFT;
-  line_pix_l |= LineColorCCRatio << PIX_CCRATIO_SHIFT;
-  line_pix_l |= ((CCCTL >> 5) & 1) << PIX_CCE_SHIFT;
-  line_pix_l |= ((CCCTL >> 5) & 1) << PIX_LAYER_CCE_SHIFT;
+   new_rgb =  ((((fore_rgb & 0x0000FF) * fore_ratio) + ((sec_rgb & 0x0000FF) * sec_ratio)) >> 5);
+   new_rgb |= ((((fore_rgb & 0x00FF00) * fore_ratio) + ((sec_rgb & 0x00FF00) * sec_ratio)) >> 5) & 0x00FF00;
+   new_rgb |= ((((fore_rgb & 0xFF0000) * fore_ratio) + ((sec_rgb & 0xFF0000) * sec_ratio)) >> 5) & 0xFF0000;
+  }
+  pix = ((uint64)new_rgb << 32) | (uint32)pix;
  }
 
  //
+ // Color offset
  //
- uint64 back_pix;
+ if(pix & (1U << PIX_COE_SHIFT))
  {
-  back_pix = (uint64)back_rgb24 << PIX_RGB_SHIFT;
-  back_pix |= 1U << PIX_ISRGB_SHIFT;
-  back_pix |= ((ColorOffsEn >> 5) & 1) << PIX_COE_SHIFT;
-  back_pix |= ((ColorOffsSel >> 5) & 1) << PIX_COSEL_SHIFT;
-  back_pix |= ((SDCTL >> 5) & 1) << PIX_SHADEN_SHIFT;
-  back_pix |= BackCCRatio << PIX_CCRATIO_SHIFT;
+  const unsigned sel = (pix >> PIX_COSEL_SHIFT) & 1;
+  const uint32 rgb_tmp = pix >> PIX_RGB_SHIFT;
+  int32 rt, gt, bt;
+
+  rt = ColorOffs[sel][0] + (rgb_tmp & 0x000000FF);
+  if(rt < 0) rt = 0;
+  if(rt & 0x00000100) rt = 0x000000FF;
+
+  gt = ColorOffs[sel][1] + (rgb_tmp & 0x0000FF00);
+  if(gt < 0) gt = 0;
+  if(gt & 0x00010000) gt = 0x0000FF00;
+
+  bt = ColorOffs[sel][2] + (rgb_tmp & 0x00FF0000);
+  if(bt < 0) bt = 0;
+  if(bt & 0x01000000) bt = 0x00FF0000;
+
+  pix = (uint32)pix | ((uint64)(uint32)(rt | gt | bt) << PIX_RGB_SHIFT);
  }
 
- for(uint32 i = 0; MDFN_LIKELY(i < w); i++)
- {
-  uint64 pix = back_pix;
-  uint32 blurcake;
+ //
+ // Sprite shadow
+ //
+ if((uint8)pix >= PIX_SHADHALVTEST8_VAL)
+  pix = (uint32)pix | ((pix >> 1) & 0x7F7F7F00000000ULL);
 
-  //
-  // Listed from lowest priority to greatest priority when prio levels are equal(back pixel has prio level of 0,
-  // and should display on "top" of any other layers).
-  //
+ return pix >> PIX_RGB_SHIFT;
+}
+
+template<bool TA_CCMD>
+static void MixFinish(uint32* target, const unsigned w)
+{
+ assert(!(w & 1));
+ unsigned i = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+ //
+ // Two pixels per iteration, one 16-bit lane per channel: [R0 G0 B0 X0 R1 G1 B1 X1], X being the top byte of the RGB field,
+ // or the ratio for mixsec[].
+ //
+ const __m128i zero = _mm_setzero_si128();
+ const __m128i rgb_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+ const __m128i x_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+ const __m128i bit_cce = _mm_set1_epi16(1U << PIX_CCE_SHIFT);
+ const __m128i bit_coe = _mm_set1_epi16(1U << PIX_COE_SHIFT);
+ const __m128i bit_cosel = _mm_set1_epi16(1U << PIX_COSEL_SHIFT);
+ const __m128i shadtest = _mm_set1_epi16(PIX_SHADHALVTEST8_VAL - 1);
+ const __m128i lobyte = _mm_set1_epi16(0xFF);
+ const __m128i ratio_max = _mm_set1_epi16(0x20);
+ __m128i offs[2];
+
+ for(unsigned sel = 0; sel < 2; sel++)
+ {
+  const int16 r = ColorOffs[sel][0], g = ColorOffs[sel][1] >> 8, b = ColorOffs[sel][2] >> 16;
+
+  offs[sel] = _mm_set_epi16(0, b, g, r, 0, b, g, r);
+ }
+
+ for(; MDFN_LIKELY(i < w); i += 2)
+ {
+  const __m128i p = _mm_shuffle_epi32(_mm_load_si128((const __m128i*)&LB.mix[i]), _MM_SHUFFLE(3, 1, 2, 0));	// [flags0 flags1 rgb0 rgb1]
+  const __m128i fore = _mm_unpackhi_epi8(p, zero);
+  const __m128i sec = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&LB.mixsec[i]), zero);
+  const __m128i fl = _mm_shufflehi_epi16(_mm_shufflelo_epi16(_mm_unpacklo_epi32(p, p), _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0));
+  const __m128i m_cce = _mm_cmpeq_epi16(_mm_and_si128(fl, bit_cce), bit_cce);
+  const __m128i m_coe = _mm_cmpeq_epi16(_mm_and_si128(fl, bit_coe), bit_coe);
+  const __m128i m_cosel = _mm_cmpeq_epi16(_mm_and_si128(fl, bit_cosel), bit_cosel);
+  const __m128i m_shad = _mm_cmpgt_epi16(_mm_and_si128(fl, lobyte), shadtest);
+  __m128i cc, v, o;
+
+  if(TA_CCMD)
+   cc = _mm_min_epi16(_mm_add_epi16(fore, sec), lobyte);
+  else
+  {
+   const __m128i fore_ratio = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sec, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+   const __m128i sec_ratio = _mm_sub_epi16(ratio_max, fore_ratio);
+
+   cc = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(fore, fore_ratio), _mm_mullo_epi16(sec, sec_ratio)), 5);
+  }
+  cc = _mm_and_si128(cc, rgb_lanes);	// X = 0
+  v = _mm_or_si128(_mm_and_si128(m_cce, cc), _mm_andnot_si128(m_cce, fore));
+
+  o = _mm_or_si128(_mm_and_si128(m_cosel, offs[1]), _mm_andnot_si128(m_cosel, offs[0]));
+  v = _mm_add_epi16(v, _mm_and_si128(m_coe, o));
+  v = _mm_max_epi16(_mm_min_epi16(v, lobyte), zero);
+  v = _mm_andnot_si128(_mm_and_si128(m_coe, x_lanes), v);	// X = 0
+
+  v = _mm_or_si128(_mm_and_si128(m_shad, _mm_and_si128(_mm_srli_epi16(v, 1), rgb_lanes)), _mm_andnot_si128(m_shad, v));
+
+  _mm_storel_epi64((__m128i*)&target[i], _mm_packus_epi16(v, v));
+ }
+#elif defined(HAVE_NEON_INTRINSICS)
+ //
+ // Two pixels per iteration, one 16-bit lane per channel: [R0 G0 B0 X0 R1 G1 B1 X1], X being the top byte of the RGB field,
+ // or the ratio for mixsec[].
+ //
+ static const uint16 rgb_lanes_init[8] = { 0xFFFF, 0xFFFF, 0xFFFF, 0, 0xFFFF, 0xFFFF, 0xFFFF, 0 };
+ const uint16x8_t rgb_lanes = vld1q_u16(rgb_lanes_init);
+ const uint16x8_t x_lanes = vmvnq_u16(rgb_lanes);
+ const uint16x8_t bit_cce = vdupq_n_u16(1U << PIX_CCE_SHIFT);
+ const uint16x8_t bit_coe = vdupq_n_u16(1U << PIX_COE_SHIFT);
+ const uint16x8_t bit_cosel = vdupq_n_u16(1U << PIX_COSEL_SHIFT);
+ const uint16x8_t shadtest = vdupq_n_u16(PIX_SHADHALVTEST8_VAL);
+ const uint16x8_t lobyte = vdupq_n_u16(0xFF);
+ int16x8_t offs[2];
+
+ for(unsigned sel = 0; sel < 2; sel++)
+ {
+  const int16 init[8] = { (int16)ColorOffs[sel][0], (int16)(ColorOffs[sel][1] >> 8), (int16)(ColorOffs[sel][2] >> 16), 0,
+			  (int16)ColorOffs[sel][0], (int16)(ColorOffs[sel][1] >> 8), (int16)(ColorOffs[sel][2] >> 16), 0 };
+
+  offs[sel] = vld1q_s16(init);
+ }
+
+ for(; MDFN_LIKELY(i < w); i += 2)
+ {
+  const uint32x2x2_t p = vld2_u32((const uint32*)&LB.mix[i]);	// val[0] = [flags0 flags1], val[1] = [rgb0 rgb1]
+  const uint16x8_t fore = vmovl_u8(vreinterpret_u8_u32(p.val[1]));
+  const uint16x8_t sec = vmovl_u8(vld1_u8((const uint8*)&LB.mixsec[i]));
+  const uint16x4_t f16 = vreinterpret_u16_u32(p.val[0]);
+  const uint16x8_t fl = vcombine_u16(vdup_lane_u16(f16, 0), vdup_lane_u16(f16, 2));
+  const uint16x8_t m_cce = vtstq_u16(fl, bit_cce);
+  const uint16x8_t m_coe = vtstq_u16(fl, bit_coe);
+  const uint16x8_t m_cosel = vtstq_u16(fl, bit_cosel);
+  const uint16x8_t m_shad = vcgeq_u16(vandq_u16(fl, lobyte), shadtest);
+  uint16x8_t cc;
+  int16x8_t v;
+
+  if(TA_CCMD)
+   cc = vminq_u16(vaddq_u16(fore, sec), lobyte);
+  else
+  {
+   const uint16x8_t fore_ratio = vcombine_u16(vdup_lane_u16(vget_low_u16(sec), 3), vdup_lane_u16(vget_high_u16(sec), 3));
+   const uint16x8_t sec_ratio = vsubq_u16(vdupq_n_u16(0x20), fore_ratio);
+
+   cc = vshrq_n_u16(vmlaq_u16(vmulq_u16(fore, fore_ratio), sec, sec_ratio), 5);
+  }
+  cc = vandq_u16(cc, rgb_lanes);	// X = 0
+  v = vreinterpretq_s16_u16(vbslq_u16(m_cce, cc, fore));
+
+  v = vaddq_s16(v, vandq_s16(vreinterpretq_s16_u16(m_coe), vbslq_s16(m_cosel, offs[1], offs[0])));
+  v = vmaxq_s16(vminq_s16(v, vreinterpretq_s16_u16(lobyte)), vdupq_n_s16(0));
+  v = vbicq_s16(v, vreinterpretq_s16_u16(vandq_u16(m_coe, x_lanes)));	// X = 0
+
+  const uint16x8_t vu = vreinterpretq_u16_s16(v);
+
+  vst1_u8((uint8*)&target[i], vmovn_u16(vbslq_u16(m_shad, vandq_u16(vshrq_n_u16(vu, 1), rgb_lanes), vu)));
+ }
+#endif
+
+ for(; MDFN_LIKELY(i < w); i++)
+  target[i] = MixFinishPix<TA_CCMD>(LB.mix[i], LB.mixsec[i]);
+}
+
+template<bool TA_rbgdualen, unsigned TA_Special, bool TA_CCRTMD, bool TA_CCMD>
+static void T_MixIt(uint32* target, const unsigned vdp2_line, const unsigned w, const uint32 back_rgb24, const uint64* blursrc)
+{
+ //printf("MixIt: %d, %d, %d, %d\n", TA_rbgdualen, TA_Special, TA_CCRTMD, TA_CCMD);
+ const uint32* lclut = &ColorCache[CurLCColor &~ 0x7F];
+ uint32 blurprev[2];
+
+ if(TA_Special == MIXIT_SPECIAL_GRAD)
+  blurprev[0] = blurprev[1] = *blursrc >> PIX_RGB_SHIFT;
+
+ uint32 line_pix_l;
+ {
+  line_pix_l = 0U << PIX_ISRGB_SHIFT;
+  line_pix_l |= LineColorCCRatio << PIX_CCRATIO_SHIFT;
+  line_pix_l |= ((CCCTL >> 5) & 1) << PIX_CCE_SHIFT;
+  line_pix_l |= ((CCCTL >> 5) & 1) << PIX_LAYER_CCE_SHIFT;
+ }
+
+ //
+ //
+ uint64 back_pix;
+ {
+  back_pix = (uint64)back_rgb24 << PIX_RGB_SHIFT;
+  back_pix |= 1U << PIX_ISRGB_SHIFT;
+  back_pix |= ((ColorOffsEn >> 5) & 1) << PIX_COE_SHIFT;
+  back_pix |= ((ColorOffsSel >> 5) & 1) << PIX_COSEL_SHIFT;
+  back_pix |= ((SDCTL >> 5) & 1) << PIX_SHADEN_SHIFT;
+  back_pix |= BackCCRatio << PIX_CCRATIO_SHIFT;
+ }
+
+ for(uint32 i = 0; MDFN_LIKELY(i < w); i++)
+ {
+  uint64 pix = back_pix;
+  uint32 blurcake;
+
+  //
+  // Listed from lowest priority to greatest priority when prio levels are equal(back pixel has prio level of 0,
+  // and should display on "top" of any other layers).
+  //
   uint64 tmp_pix[8] =
   {
    (TA_rbgdualen ? 0 : (LB.nbg[3] + 8)[i]),
@@ -2550,63 +3016,18 @@ static void T_MixIt(uint32* target, const unsigned vdp2_line, const unsigned w,
     }
    }
 
-   uint32 fore_rgb = pix >> PIX_RGB_SHIFT;
    uint32 sec_rgb = pix2 >> PIX_RGB_SHIFT;
-   uint32 new_rgb;
 
    if(TA_Special == MIXIT_SPECIAL_HIRES_CRAM12 && !(pix2 & (1U << PIX_ISRGB_SHIFT)))
-    sec_rgb = fore_rgb;
-
-   if(TA_CCMD)	// Ignore ratio, add as-is.
-   {
-    new_rgb =  std::min<unsigned>(0x0000FF, (fore_rgb & 0x0000FF) + (sec_rgb & 0x0000FF));
-    new_rgb |= std::min<unsigned>(0x00FF00, (fore_rgb & 0x00FF00) + (sec_rgb & 0x00FF00));
-    new_rgb |= std::min<unsigned>(0xFF0000, (fore_rgb & 0xFF0000) + (sec_rgb & 0xFF0000));
-   }
-   else
-   {
-    unsigned fore_ratio = ((uint32)(TA_CCRTMD ? pix2 : pix) >> PIX_CCRATIO_SHIFT) ^ 0x1F;
-    unsigned sec_ratio = 0x20 - fore_ratio;
-
-    new_rgb =  ((((fore_rgb & 0x0000FF) * fore_ratio) + ((sec_rgb & 0x0000FF) * sec_ratio)) >> 5);
-    new_rgb |= ((((fore_rgb & 0x00FF00) * fore_ratio) + ((sec_rgb & 0x00FF00) * sec_ratio)) >> 5) & 0x00FF00;
-    new_rgb |= ((((fore_rgb & 0xFF0000) * fore_ratio) + ((sec_rgb & 0xFF0000) * sec_ratio)) >> 5) & 0xFF0000;
-   }
-   pix = ((uint64)new_rgb << 32) | (uint32)pix;
-  }
-
-  //
-  // Color offset
-  //
-  if(pix & (1U << PIX_COE_SHIFT))
-  {
-   const unsigned sel = (pix >> PIX_COSEL_SHIFT) & 1;
-   const uint32 rgb_tmp = pix >> PIX_RGB_SHIFT;
-   int32 rt, gt, bt;
-
-   rt = ColorOffs[sel][0] + (rgb_tmp & 0x000000FF);
-   if(rt < 0) rt = 0;
-   if(rt & 0x00000100) rt = 0x000000FF;
-
-   gt = ColorOffs[sel][1] + (rgb_tmp & 0x0000FF00);
-   if(gt < 0) gt = 0;
-   if(gt & 0x00010000) gt = 0x0000FF00;
+    sec_rgb = pix >> PIX_RGB_SHIFT;
 
-   bt = ColorOffs[sel][2] + (rgb_tmp & 0x00FF0000);
-   if(bt < 0) bt = 0;
-   if(bt & 0x01000000) bt = 0x00FF0000;
-
-   pix = (uint32)pix | ((uint64)(uint32)(rt | gt | bt) << PIX_RGB_SHIFT);
+   LB.mixsec[i] = (sec_rgb & 0xFFFFFF) | (((uint32)((TA_CCRTMD ? pix2 : pix) >> PIX_CCRATIO_SHIFT) & 0x1F) ^ 0x1F) << 24;
   }
 
-  //
-  // Sprite shadow
-  //
-  if((uint8)pix >= PIX_SHADHALVTEST8_VAL)
-   pix = (uint32)pix | ((pix >> 1) & 0x7F7F7F00000000ULL);
-
-  target[i] = pix >> PIX_RGB_SHIFT;
+  LB.mix[i] = pix;
  }
+
+ MixFinish<TA_CCMD>(target, w);
 }
 
 //template<bool TA_rbgdualen, unsigned TA_Special, bool TA_CCRTMD, bool TA_CCMD>
@@ -2677,6 +3098,42 @@ static void ReorderRGB(uint32* target, const unsigned w, const unsigned Rshift,
  assert(!(w & 1));
  uint32* const bound = target + w;
 
+#if defined(HAVE_SSE2_INTRINSICS)
+ {
+  const __m128i lobyte = _mm_set1_epi32(0xFF);
+  const __m128i rs = _mm_cvtsi32_si128(Rshift), gs = _mm_cvtsi32_si128(Gshift), bs = _mm_cvtsi32_si128(Bshift);
+
+  for(uint32* const bound4 = target + (w & ~3); MDFN_LIKELY(target != bound4); target += 4)
+  {
+   const __m128i tmp = _mm_loadu_si128((const __m128i*)target);
+   __m128i r, g, b;
+
+   r = _mm_sll_epi32(_mm_and_si128(tmp, lobyte), rs);
+   g = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(tmp, 8), lobyte), gs);
+   b = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(tmp, 16), lobyte), bs);
+
+   _mm_storeu_si128((__m128i*)target, _mm_or_si128(r, _mm_or_si128(g, b)));
+  }
+ }
+#elif defined(HAVE_NEON_INTRINSICS)
+ {
+  const uint32x4_t lobyte = vdupq_n_u32(0xFF);
+  const int32x4_t rs = vdupq_n_s32(Rshift), gs = vdupq_n_s32(Gshift), bs = vdupq_n_s32(Bshift);
+
+  for(uint32* const bound4 = target + (w & ~3); MDFN_LIKELY(target != bound4); target += 4)
+  {
+   const uint32x4_t tmp = vld1q_u32(target);
+   uint32x4_t r, g, b;
+
+   r = vshlq_u32(vandq_u32(tmp, lobyte), rs);
+   g = vshlq_u32(vandq_u32(vshrq_n_u32(tmp, 8), lobyte), gs);
+   b = vshlq_u32(vandq_u32(vshrq_n_u32(tmp, 16), lobyte), bs);
+
+   vst1q_u32(target, vorrq_u32(r, vorrq_u32(g, b)));
+  }
+ }
+#endif
+
  while(MDFN_LIKELY(target != bound))
  {
   const uint32 tmp0 = target[0];
@@ -2694,8 +3151,268 @@ static void ReorderRGB(uint32* target, const unsigned w, const unsigned Rshift,
  }
 }
 
+//
+// Optional render timing(automation "vdp2_timing"): nanoseconds spent per layer, summed by the render thread over a frame
+// and collected in VDP2REND_EndFrame(), which lets the work queue drain first while timing is on.
+//
+enum
+{
+ RTIME_SETUP = 0,		// line scroll, line window, mosaic, vertical cell scroll
+ RTIME_SPRITE,
+ RTIME_RBG0,
+ RTIME_RBG1,
+ RTIME_NBG0,			// through RTIME_NBG0 + 3
+ RTIME_MIX = RTIME_NBG0 + 4,	// sprite window, border, MixIt(), ReorderRGB(), hblend
+ RTIME__COUNT
+};
+
+struct RTimeCounters
+{
+ uint64 ns[RTIME__COUNT];
+ uint64 line_ns;		// whole-line times, summed
+ uint64 max_line_ns;
+ uint32 max_line;		// output line of max_line_ns
+ uint32 lines;
+};
+
+static bool RTimeOn;		// render thread's view, changed via COMMAND_SET_RTIME
+static bool RTimeActive;	// emulation thread's view
+static RTimeCounters RTimeCur;	// frame in progress, written by the render thread
+static RTimeCounters RTimeLast, RTimeTotal;
+static uint64 RTimeFrames;
+
+static INLINE uint64 RTimeNow(void)
+{
+ return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#define RTIME_MARK(which)								\
+	if(MDFN_UNLIKELY(RTimeOn))							\
+	{										\
+	 const uint64 rt_now = RTimeNow();						\
+	 RTimeCur.ns[(which)] += rt_now - rt_prev;					\
+	 rt_prev = rt_now;								\
+	}
+
+//
+// Per-layer capture(Automation_VDP2LayerCaptureStart()): over one rendered frame, DrawLine() also copies each layer's line
+// buffer, as MixIt() is about to read it, into a plane of its own, so every layer comes out of the same pass.  The file is
+// "MDFNV2L1", le32 plane count(8), le32 lines(576), le32 plane width(704), le32 flags(bit 0: InterlaceOn, bit 1:
+// InterlaceField), then per output line le16 width(0 if the line wasn't drawn), le16 VDP2 line, le32 flags(bit 0: RBG0
+// and RBG1 both on, so the NBG0 plane holds RBG1 and NBG1-3 are empty), then each plane as le32 compressed length + zlib
+// data of lines * width host-order uint32s: RGB in bits 0-23(red lowest), priority in bits 24-26(0 = transparent; always 0
+// in the line color and back planes).  Pixels start at the line's left edge, not counting the border.
+//
+enum
+{
+ LAYERCAP_SPRITE = 0,
+ LAYERCAP_RBG0,
+ LAYERCAP_NBG0,		// through LAYERCAP_NBG0 + 3; RBG1 when both RBGs are on
+ LAYERCAP_LINECOLOR = LAYERCAP_NBG0 + 4,
+ LAYERCAP_BACK,
+ LAYERCAP__COUNT
+};
+
+enum : size_t { LAYERCAP_LINES = 576, LAYERCAP_WIDTH = 704 };
+
+static struct
+{
+ FILE* fp;
+ bool recording;		// emulation thread's view: this frame goes to fp
+ std::vector<uint32> planes;	// [LAYERCAP__COUNT][LAYERCAP_LINES][LAYERCAP_WIDTH]
+ uint16 width[LAYERCAP_LINES];
+ uint16 vdp2_line[LAYERCAP_LINES];
+ bool rbgdual[LAYERCAP_LINES];
+} LayerCap;
+
+static bool LayerCapOn;		// render thread's view, changed via COMMAND_SET_LAYERCAP
+
+//
+// Preview mode(VDP2REND_SetPreview(), "ss.vdp2_preview"): odd VDP2 lines skip the layer draws and mixing and repeat the
+// line above, for about half the render cost.  Output only, and not accurate: the line scroll, line window, back and
+// line color table and vertical cell scroll state still advance on every line, so render state(and save states) match
+// a full render, and so do even lines unless they depend on VDP1 or VRAM changes made only on skipped ones.  Off
+// while a layer capture is recording.
+//
+static bool PreviewOn;		// render thread's view, changed via COMMAND_SET_PREVIEW
+static bool PreviewOnEmu;	// emulation thread's view
+static int32 PreviewLastLine = -1;	// vdp2_line and out_line of the line drawn last
+static uint16 PreviewLastOut;
+
+static INLINE bool PreviewCopyLine(const uint16 out_line, const uint16 vdp2_line)
+{
+ if(!(vdp2_line & 1) || LayerCapOn || PreviewLastLine != (int32)vdp2_line - 1)
+  return false;
+
+ const uint32* src = espec->surface->pixels + PreviewLastOut * espec->surface->pitchinpix;
+ uint32* dst = espec->surface->pixels + out_line * espec->surface->pitchinpix;
+
+ espec->LineWidths[out_line] = espec->LineWidths[PreviewLastOut];
+ memcpy(dst, src, (espec->DisplayRect.x + espec->LineWidths[PreviewLastOut]) * sizeof(uint32));
+
+ return true;
+}
+
+static NO_INLINE void LayerCapLine(const uint16 out_line, const uint16 vdp2_line, const unsigned w, const uint32 back_rgb24, const bool rbgdualen)
+{
+ const uint64* const src[LAYERCAP_LINECOLOR] = { LB.spr, LB.rbg0, LB.nbg[0] + 8, LB.nbg[1] + 8, LB.nbg[2] + 8, LB.nbg[3] + 8 };
+ const unsigned nsrc = rbgdualen ? LAYERCAP_NBG0 + 1 : LAYERCAP_LINECOLOR;
+ const uint32* lclut = &ColorCache[CurLCColor &~ 0x7F];
+ uint32* const row = &LayerCap.planes[out_line * LAYERCAP_WIDTH];
+
+ for(unsigned p = 0; p < nsrc; p++)
+ {
+  uint32* d = row + p * LAYERCAP_LINES * LAYERCAP_WIDTH;
+
+  for(unsigned i = 0; i < w; i++)
+   d[i] = ((src[p][i] >> PIX_RGB_SHIFT) & 0xFFFFFF) | (((src[p][i] >> PIX_PRIO_SHIFT) & 0x7) << 24);
+ }
+
+ {
+  uint32* d = row + LAYERCAP_LINECOLOR * LAYERCAP_LINES * LAYERCAP_WIDTH;
+
+  for(unsigned i = 0; i < w; i++)
+   d[i] = lclut[LB.lc[i]] & 0xFFFFFF;
+ }
+
+ {
+  uint32* d = row + LAYERCAP_BACK * LAYERCAP_LINES * LAYERCAP_WIDTH;
+
+  for(unsigned i = 0; i < w; i++)
+   d[i] = back_rgb24;
+ }
+
+ LayerCap.width[out_line] = w;
+ LayerCap.vdp2_line[out_line] = vdp2_line;
+ LayerCap.rbgdual[out_line] = rbgdualen;
+}
+
+//
+// Optional NBG layer workers(setting "ss.vdp2_workers"): each NBG0-3 pass of a line reads only state that stays frozen while the
+// render thread is in DrawLine(), and writes only its own LB.nbg[n], so the passes of a line are spread over the render thread
+// and up to 3 helper threads, and all joined before the sprite window and mixing.  Which thread draws which layer doesn't
+// affect the output.  Lines themselves stay sequential; line scroll, line window, mosaic and vertical counters carry over from
+// one line to the next, and register writes are interleaved with the lines in the work queue.
+//
+struct NBGJob
+{
+ void (*draw)(const unsigned n, uint64* bgbuf, const unsigned w, const uint32 pix_base_or);
+ unsigned n;
+ uint32 pix_base_or;
+ uint64 ns;		// filled in when NBGJobRTime
+};
+
+static unsigned NBGWorkerCount;
+static MThreading::Thread* NBGWorkers[3];
+static MThreading::Sem* NBGWorkerSem;
+static NBGJob NBGJobs[4];
+static unsigned NBGJobCount;	// render thread only; workers get it from NBGJobClaim
+static unsigned NBGJobW;
+static bool NBGJobRTime;
+//
+// Bits 0-2: next job to claim, bits 3-5: job count, bits 6-31: generation(bumped per line).  Jobs are claimed with a CAS on the
+// whole word, so a worker that is still in TakeNBGJobs() for a previous line can never claim a job of the next one.
+//
+enum : unsigned { NBGJOB_COUNT_SHIFT = 3, NBGJOB_GEN_SHIFT = 6 };
+static std::atomic_uint_least32_t NBGJobClaim, NBGJobDone;
+static std::atomic_bool NBGWorkersExit;
+
+static INLINE void DoNBGJob(NBGJob* const j)
+{
+ uint64* const bgbuf = LB.nbg[j->n] + 8;
+ const uint64 t0 = NBGJobRTime ? RTimeNow() : 0;
+
+ j->draw(j->n, bgbuf, NBGJobW, j->pix_base_or);
+ ApplyHMosaic(j->n, bgbuf, NBGJobW);
+ ApplyWin(j->n, bgbuf);
+
+ if(NBGJobRTime)
+  j->ns = RTimeNow() - t0;
+}
+
+static void TakeNBGJobs(const uint32 gen)
+{
+ uint32 c = NBGJobClaim.load(std::memory_order_acquire);
+
+ for(;;)
+ {
+  const unsigned i = c & 0x7;
+
+  if((c >> NBGJOB_GEN_SHIFT) != gen || i >= ((c >> NBGJOB_COUNT_SHIFT) & 0x7))
+   break;
+
+  if(!NBGJobClaim.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+   continue;
+
+  DoNBGJob(&NBGJobs[i]);
+  NBGJobDone.fetch_add(1, std::memory_order_release);
+  c++;
+ }
+}
+
+static int NBGWorkerEntry(void* data)
+{
+ uint32 gen = NBGJobClaim.load(std::memory_order_acquire) >> NBGJOB_GEN_SHIFT;
+
+ for(;;)
+ {
+  unsigned spins = 0;
+  uint32 g;
+
+  // Spin for about a millisecond after the last line, then poll at 1ms intervals until the next frame starts.  The render
+  // thread takes jobs itself, so it never waits on a worker that's asleep.
+  while((g = NBGJobClaim.load(std::memory_order_acquire) >> NBGJOB_GEN_SHIFT) == gen)
+  {
+   if(MDFN_UNLIKELY(NBGWorkersExit.load(std::memory_order_acquire)))
+    return 0;
+
+   if(spins < 2048)
+   {
+    SS_BusyWaitDelay();
+    spins++;
+   }
+   else
+    MThreading::Sem_TimedWait(NBGWorkerSem, 1);
+  }
+  gen = g;
+
+  TakeNBGJobs(gen);
+ }
+
+ return 0;
+}
+
+static void RunNBGJobs(const unsigned w)
+{
+ NBGJobW = w;
+ NBGJobRTime = RTimeOn;
+
+ if(NBGWorkerCount && NBGJobCount > 1)
+ {
+  // Every claim of the previous line has finished(NBGJobDone), so this one release store publishes the count along with the
+  // jobs and NBGJobW/NBGJobRTime.
+  const uint32 gen = ((NBGJobClaim.load(std::memory_order_relaxed) >> NBGJOB_GEN_SHIFT) + 1) & ((1U << (32 - NBGJOB_GEN_SHIFT)) - 1);
+
+  NBGJobDone.store(0, std::memory_order_relaxed);
+  NBGJobClaim.store((gen << NBGJOB_GEN_SHIFT) | (NBGJobCount << NBGJOB_COUNT_SHIFT), std::memory_order_release);
+
+  TakeNBGJobs(gen);
+
+  while(NBGJobDone.load(std::memory_order_acquire) != NBGJobCount)
+   SS_BusyWaitDelay();
+ }
+ else
+ {
+  for(unsigned i = 0; i < NBGJobCount; i++)
+   DoNBGJob(&NBGJobs[i]);
+ }
+}
+
 static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, const bool field)
 {
+ const uint64 rt_line_start = MDFN_UNLIKELY(RTimeOn) ? RTimeNow() : 0;
+ bool preview_copy = false;
+ uint64 rt_prev = rt_line_start;
  uint32* target;
  const int32 tvdw = ((!CorrectAspect || Clock28M) ? 352 : 330) << ((HRes & 0x2) >> 1);
  const unsigned rbg_w = ((HRes & 0x1) ? 352 : 320);
@@ -2903,6 +3620,7 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
 
    std::sort(WinPieces.begin(), WinPieces.end());
   }
+  RTIME_MARK(RTIME_SETUP)
 
   //
   //
@@ -2914,6 +3632,28 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
    //printf("WinControl[WINLAYER_CC]=%02x\n", WinControl[WINLAYER_CC]);
   }
 
+  for(unsigned n = 0; n < 4; n++)
+  {
+   if(!MosaicVCount || !(MZCTL & (1U << n)))
+   {
+    if(n < 2)
+    {
+     MosEff_YCoordAccum[n] = YCoordAccum[n];	// Don't + (InterlaceMode == IM_DOUBLE && field)
+    }
+    else
+    {
+     MosEff_NBG23_YCounter[n & 1] = NBG23_YCounter[n & 1] + (InterlaceMode == IM_DOUBLE && field);
+    }
+   }
+  }
+
+  if(SCRCTL & 0x0101)
+   FetchVCScroll(w);	// Call after handling line scroll, and before DrawNBG() stuff
+  RTIME_MARK(RTIME_SETUP)
+
+  if(MDFN_UNLIKELY(PreviewOn) && (preview_copy = PreviewCopyLine(out_line, vdp2_line)))
+   goto LineDone;
+
   //
   // Process sprite data before NBG0-3 and RBG0-1, but defer applying the window until after NBG and RBG are handled(so the sprite window
   // bit in the sprite linebuffer data isn't trashed prematurely).
@@ -2925,6 +3665,7 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
   }
   else
    MDFN_FastArraySet(LB.spr, 0, w);
+  RTIME_MARK(RTIME_SPRITE)
   //
   //
   //
@@ -2972,6 +3713,7 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
    }
    else
     MDFN_FastArraySet(LB.rbg0, 0, w);
+   RTIME_MARK(RTIME_RBG0)
 
    // RBG1
    if(BGON & UserLayerEnableMask & 0x20)
@@ -3006,6 +3748,7 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
    }
    else if(BGON & 0x20)
     MDFN_FastArraySet(LB.nbg[0] + 8, 0, w);
+   RTIME_MARK(RTIME_RBG1)
   }
   else
   {
@@ -3015,26 +3758,10 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
   //
   //
   //
-  for(unsigned n = 0; n < 4; n++)
-  {
-   if(!MosaicVCount || !(MZCTL & (1U << n)))
-   {
-    if(n < 2)
-    {
-     MosEff_YCoordAccum[n] = YCoordAccum[n];	// Don't + (InterlaceMode == IM_DOUBLE && field)
-    }
-    else
-    {
-     MosEff_NBG23_YCounter[n & 1] = NBG23_YCounter[n & 1] + (InterlaceMode == IM_DOUBLE && field);
-    }
-   }
-  }
-
-  if(SCRCTL & 0x0101)
-   FetchVCScroll(w);	// Call after handling line scroll, and before DrawNBG() stuff
-
   if((BGON & 0x30) != 0x30)
   {
+   NBGJobCount = 0;
+
    for(unsigned n = (bool)(BGON & 0x20); n < 4; n++)
    {
     if(((BGON >> n) & 1) && MDFN_LIKELY((UserLayerEnableMask >> n) & 1))
@@ -3088,18 +3815,25 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
      else
       pix_base_or |= (prio << PIX_PRIO_SHIFT);
 
-     if(n < 2)
-      DrawNBG[bmen][colornum][igntp][priomode % 3][ccmode](n, LB.nbg[n] + 8, w, pix_base_or);
-     else
-      DrawNBG23[colornum][igntp][priomode % 3][ccmode](n, LB.nbg[n] + 8, w, pix_base_or);
+     NBGJob* const j = &NBGJobs[NBGJobCount++];
 
-     ApplyHMosaic(n, LB.nbg[n] + 8, w);
-     ApplyWin(n, LB.nbg[n] + 8);
+     j->draw = (n < 2) ? DrawNBG[bmen][colornum][igntp][priomode % 3][ccmode] : DrawNBG23[colornum][igntp][priomode % 3][ccmode];
+     j->n = n;
+     j->pix_base_or = pix_base_or;
     }
     else
      MDFN_FastArraySet(LB.nbg[n] + 8, 0, w);
    }
-  }
+
+   RunNBGJobs(w);
+
+   if(MDFN_UNLIKELY(RTimeOn))
+   {
+    for(unsigned i = 0; i < NBGJobCount; i++)
+     RTimeCur.ns[RTIME_NBG0 + NBGJobs[i].n] += NBGJobs[i].ns;
+    rt_prev = RTimeNow();
+   }
+  }
 
   //
   //
@@ -3146,6 +3880,9 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
      special = MIXIT_SPECIAL_HIRES_CRAM12;
    }
 
+   if(MDFN_UNLIKELY(LayerCapOn))
+    LayerCapLine(out_line, vdp2_line, w, back_rgb24, rbgdualen);
+
    MixIt[rbgdualen][special][CCRTMD][CCMD](target + tvxo, vdp2_line, w, back_rgb24, blursrc);
    ReorderRGB(target + tvxo, w, espec->surface->format.Rshift, espec->surface->format.Gshift, espec->surface->format.Bshift);
   }
@@ -3155,6 +3892,7 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
   //
   // FIXME: Timing
   //
+  LineDone:;
   for(unsigned n = 0; n < 2; n++)
   {
    YCoordAccum[n] += YCoordInc[n] << (InterlaceMode == IM_DOUBLE);
@@ -3167,22 +3905,44 @@ static NO_INLINE void DrawLine(const uint16 out_line, const uint16 vdp2_line, co
    MosaicVCount++;
  }
 
+ if(!preview_copy)
+ {
+  PreviewLastLine = vdp2_line;
+  PreviewLastOut = out_line;
+ }
+
  //
  //
  //
- if(DoHBlend)
+ if(DoHBlend && !preview_copy)	// A copied line is already blended.
  {
   espec->LineWidths[out_line] = ApplyHBlend(espec->surface->pixels + out_line * espec->surface->pitchinpix + espec->DisplayRect.x, espec->LineWidths[out_line]);
 
   // Kind of late, but meh. ;p
   assert((espec->DisplayRect.x + espec->LineWidths[out_line]) <= 704);
  }
+
+ if(MDFN_UNLIKELY(RTimeOn))
+ {
+  RTIME_MARK(RTIME_MIX)
+  const uint64 lt = rt_prev - rt_line_start;
+
+  RTimeCur.line_ns += lt;
+  if(lt > RTimeCur.max_line_ns)
+  {
+   RTimeCur.max_line_ns = lt;
+   RTimeCur.max_line = out_line;
+  }
+  RTimeCur.lines++;
+ }
 }
+#undef RTIME_MARK
 
 //
 //
 //
 static MThreading::Thread* RThread = NULL;
+static uint64 RThreadAffinity;
 
 enum
 {
@@ -3195,6 +3955,12 @@ enum
 
  COMMAND_SET_BUSYWAIT,
 
+ COMMAND_SET_RTIME,
+
+ COMMAND_SET_LAYERCAP,
+
+ COMMAND_SET_PREVIEW,
+
  COMMAND_RESET,
  COMMAND_EXIT
 };
@@ -3214,10 +3980,92 @@ static bool DoBusyWait;
 static MThreading::Sem* WakeupSem;
 static bool DoWakeupIfNecessary;
 
+//
+// Blocking without polling: the render thread sets RThreadIdle before sleeping on WakeupSem with an empty queue, and
+// RThreadWake() posts it once.  The emulation thread, waiting for the queue to drop to WQ_WriterLimit - 1 entries
+// or fewer(full queue, or empty for a drain), sleeps on WriterSem, which the render thread posts once it has.  Flag
+// stores and queue count loads on either side are seq_cst, so one of the two always sees the other.
+//
+static std::atomic<bool> RThreadIdle;
+static std::atomic_uint_least32_t WQ_WriterLimit;	// 0 = emulation thread not waiting
+static MThreading::Sem* WriterSem;
+
+static INLINE void RThreadWake(void)
+{
+ if(RThreadIdle.load(std::memory_order_seq_cst) && RThreadIdle.exchange(false, std::memory_order_seq_cst))
+  MThreading::Sem_Post(WakeupSem);
+}
+
+// Emulation thread; returns once the render thread has left at most 'limit' entries queued.
+static NO_INLINE void WQ_WaitDrain(const uint32 limit)
+{
+ WQ_WriterLimit.store(limit + 1, std::memory_order_seq_cst);
+ RThreadWake();
+
+ while(WQ_InCount.load(std::memory_order_seq_cst) > limit)
+  MThreading::Sem_Wait(WriterSem);
+
+ WQ_WriterLimit.store(0, std::memory_order_relaxed);
+}
+
+//
+// Frame capture(Automation_VDP2CaptureStart()) for Automation_VDP2Bench().  The file is "MDFNV2C1", then one record per
+// rendered frame:
+//
+//  le32 crc32 of the frame's output lines(per line: its LineWidths entry, then that many pixels from DisplayRect.x),
+//  le64 surface pixel format tag, le32 flags(bit 0: InterlaceOn, bit 1: InterlaceField), le32 DisplayRect.x,
+//  le32 command count, le32 LIB count, le32 render state length, the render state(MDFNSS_SaveInternal() of
+//  VDP2REND_StateAction()), then registers, CRAM, VRAM, the commands and the LIB entries of their DRAW_LINE commands,
+//  each as le32 compressed length + zlib data in host layout.
+//
+// Registers, memory and render state are as they were when the frame started; the commands are every work queue write,
+// reset, layer enable mask and line draw over the frame, in order.  Skipped frames aren't captured.
+//
+struct RenderSnapshot
+{
+ uint16 regs[0x100];
+ uint16 cram[2048];
+ uint16 vram[262144];
+ std::vector<uint8> state;
+};
+
+static struct
+{
+ FILE* fp;
+ uint32 frames;
+ uint32 frames_left;
+ bool recording;
+ std::unique_ptr<RenderSnapshot> snap;
+ std::vector<WQ_Entry> cmds;
+ std::vector<VDP2Rend_LIB> libs;
+} Cap;
+
+// Emulation thread time spent waiting on the render thread(full queue, end of frame), in PerfClock_Now() units.
+static uint64 WaitTicks;
+
+uint64 VDP2REND_GetWaitTicks(void)
+{
+ return WaitTicks;
+}
+
 static INLINE void WWQ(uint16 command, uint32 arg32 = 0, uint16 arg16 = 0)
 {
- while(MDFN_UNLIKELY(WQ_InCount.load(std::memory_order_acquire) == WQ.size()))
-  Time::SleepMS(1);
+ if(MDFN_UNLIKELY(WQ_InCount.load(std::memory_order_acquire) == WQ.size()))
+ {
+  const uint64 wait_start = PerfClock_Now();
+
+  // Let it get well below full, so the two threads don't trade wakeups per entry.
+  WQ_WaitDrain(WQ.size() - WQ.size() / 8);
+
+  WaitTicks += PerfClock_Now() - wait_start;
+ }
+
+ if(MDFN_UNLIKELY(Cap.recording) && command != COMMAND_SET_BUSYWAIT && command != COMMAND_SET_RTIME && command != COMMAND_SET_LAYERCAP && command != COMMAND_EXIT)
+ {
+  Cap.cmds.push_back({ command, arg16, arg32 });
+  if(command == COMMAND_DRAW_LINE)
+   Cap.libs.push_back(LIB[arg32 >> 16]);
+ }
 
  WQ_Entry* wqe = &WQ[WQ_WritePos];
 
@@ -3226,7 +4074,10 @@ static INLINE void WWQ(uint16 command, uint32 arg32 = 0, uint16 arg16 = 0)
  wqe->Arg32 = arg32;
 
  WQ_WritePos = (WQ_WritePos + 1) % WQ.size();
- WQ_InCount.fetch_add(1, std::memory_order_release);
+
+ // Writes wake a sleeping render thread in batches(DrawLine() wakes it for lines), everything else right away.
+ if(MDFN_UNLIKELY(!((WQ_InCount.fetch_add(1, std::memory_order_seq_cst) + 1) & 0x3FF)) || command > COMMAND_DRAW_LINE)
+  RThreadWake();
 }
 
 static int RThreadEntry(void* data)
@@ -3238,22 +4089,14 @@ static int RThreadEntry(void* data)
   while(MDFN_UNLIKELY(WQ_InCount.load(std::memory_order_acquire) == 0))
   {
    if(!DoBusyWait)
-    MThreading::Sem_TimedWait(WakeupSem, 1);
-   else
    {
-#ifdef MDFN_SS_BUSYWAIT_PAUSE
-    asm volatile("pause\n\tpause\n\tpause\n\tpause\n\tpause\n\tpause\n\tpause\n\t");
-#else
-    for(int i = 1000; i; i--)
-    {
-     #ifdef _MSC_VER
-     __nop();
-     #else
-     asm volatile("nop\n\t");
-     #endif
-    }
-#endif
+    RThreadIdle.store(true, std::memory_order_seq_cst);
+    if(WQ_InCount.load(std::memory_order_seq_cst) == 0)
+     MThreading::Sem_Wait(WakeupSem);
+    RThreadIdle.store(false, std::memory_order_relaxed);
    }
+   else
+    SS_BusyWaitDelay();
   }
   //
   //
@@ -3289,6 +4132,19 @@ static int RThreadEntry(void* data)
 	DoBusyWait = wqe->Arg32;
 	break;
 
+   case COMMAND_SET_RTIME:
+	RTimeOn = wqe->Arg32;
+	memset(&RTimeCur, 0, sizeof(RTimeCur));
+	break;
+
+   case COMMAND_SET_LAYERCAP:
+	LayerCapOn = wqe->Arg32;
+	break;
+
+   case COMMAND_SET_PREVIEW:
+	PreviewOn = wqe->Arg32;
+	break;
+
    case COMMAND_EXIT:
 	Running = false;
 	break;
@@ -3297,35 +4153,188 @@ static int RThreadEntry(void* data)
   //
   //
   WQ_ReadPos = (WQ_ReadPos + 1) % WQ.size();
-  WQ_InCount.fetch_sub(1, std::memory_order_release);
+  {
+   const uint32 left = WQ_InCount.fetch_sub(1, std::memory_order_seq_cst) - 1;
+   const uint32 wl = WQ_WriterLimit.load(std::memory_order_seq_cst);
+
+   if(MDFN_UNLIKELY(wl != 0) && left < wl && WQ_WriterLimit.exchange(0, std::memory_order_seq_cst))
+    MThreading::Sem_Post(WriterSem);
+  }
  }
 
  return 0;
 }
 
 
+static RenderSnapshot* SnapshotCur;
+
+static void SnapshotStateAction(StateMem* sm, const unsigned load, const bool data_only)
+{
+ VDP2REND_StateAction(sm, load, data_only, SnapshotCur->regs, SnapshotCur->cram, SnapshotCur->vram);
+}
+
+// Work queue must be empty.
+static void TakeSnapshot(RenderSnapshot* rs)
+{
+ MemoryStream ms(65536);
+
+ memcpy(rs->regs, RegsShadow, sizeof(rs->regs));
+ memcpy(rs->cram, CRAM, sizeof(rs->cram));
+ memcpy(rs->vram, VRAM, sizeof(rs->vram));
+
+ SnapshotCur = rs;
+ MDFNSS_SaveInternal(&ms, SnapshotStateAction);
+ rs->state.assign(ms.map(), ms.map() + ms.size());
+}
+
+static void RestoreSnapshot(RenderSnapshot* rs)
+{
+ MemoryStream ms(rs->state.size(), true);
+
+ memcpy(ms.map(), rs->state.data(), rs->state.size());
+ SnapshotCur = rs;
+ MDFNSS_LoadInternal(&ms, SnapshotStateAction);
+}
+
+static void CaptureFrameStart(void)
+{
+ WQ_WaitDrain(0);
+
+ TakeSnapshot(Cap.snap.get());
+ Cap.cmds.clear();
+ Cap.libs.clear();
+ Cap.recording = true;
+}
+
+static uint32 HashFrameLines(const EmulateSpecStruct* es, const std::vector<WQ_Entry>& cmds)
+{
+ uint32 crc = 0;
+
+ for(const WQ_Entry& e : cmds)
+ {
+  if(e.Command != COMMAND_DRAW_LINE)
+   continue;
+
+  const uint16 out_line = (uint16)e.Arg32;
+  const int32 lw = es->LineWidths[out_line];
+  uint8 lwb[4];
+
+  MDFN_en32lsb(lwb, lw);
+  crc = crc32(crc, lwb, sizeof(lwb));
+  crc = crc32(crc, (const Bytef*)(es->surface->pixels + out_line * es->surface->pitchinpix + es->DisplayRect.x), std::max<int32>(0, lw) * sizeof(uint32));
+ }
+
+ return crc;
+}
+
+static void LayerCaptureFrameStart(void)
+{
+ std::fill(LayerCap.planes.begin(), LayerCap.planes.end(), 0);
+ memset(LayerCap.width, 0, sizeof(LayerCap.width));
+ LayerCap.recording = true;
+ WWQ(COMMAND_SET_LAYERCAP, true);
+}
+
+static void LayerCaptureFrameEnd(void)
+{
+ uint8 hdr[4 * 4];
+
+ WWQ(COMMAND_SET_LAYERCAP, false);
+ while(WQ_InCount.load(std::memory_order_acquire) != 0)
+ {
+ }
+ LayerCap.recording = false;
+
+ MDFN_en32lsb(&hdr[0], LAYERCAP__COUNT);
+ MDFN_en32lsb(&hdr[4], LAYERCAP_LINES);
+ MDFN_en32lsb(&hdr[8], LAYERCAP_WIDTH);
+ MDFN_en32lsb(&hdr[12], espec->InterlaceOn | (espec->InterlaceField << 1));
+ fwrite(hdr, 1, sizeof(hdr), LayerCap.fp);
+
+ for(size_t i = 0; i < LAYERCAP_LINES; i++)
+ {
+  uint8 lhdr[8];
+
+  MDFN_en16lsb(&lhdr[0], LayerCap.width[i]);
+  MDFN_en16lsb(&lhdr[2], LayerCap.vdp2_line[i]);
+  MDFN_en32lsb(&lhdr[4], LayerCap.rbgdual[i]);
+  fwrite(lhdr, 1, sizeof(lhdr), LayerCap.fp);
+ }
+
+ for(unsigned p = 0; p < LAYERCAP__COUNT; p++)
+  ZBlock_Write(LayerCap.fp, &LayerCap.planes[p * LAYERCAP_LINES * LAYERCAP_WIDTH], LAYERCAP_LINES * LAYERCAP_WIDTH * sizeof(uint32));
+
+ Automation_VDP2LayerCaptureStop();
+}
+
+// Called with the frame's lines all drawn.
+static void CaptureFrameEnd(void)
+{
+ uint8 hdr[4 + 8 + 4 * 6];
+
+ while(WQ_InCount.load(std::memory_order_acquire) != 0)
+ {
+ }
+ Cap.recording = false;
+
+ MDFN_en32lsb(&hdr[0], HashFrameLines(espec, Cap.cmds));
+ MDFN_en64lsb(&hdr[4], espec->surface->format.tag);
+ MDFN_en32lsb(&hdr[12], espec->InterlaceOn | (espec->InterlaceField << 1));
+ MDFN_en32lsb(&hdr[16], espec->DisplayRect.x);
+ MDFN_en32lsb(&hdr[20], Cap.cmds.size());
+ MDFN_en32lsb(&hdr[24], Cap.libs.size());
+ MDFN_en32lsb(&hdr[28], Cap.snap->state.size());
+ fwrite(hdr, 1, sizeof(hdr), Cap.fp);
+ fwrite(Cap.snap->state.data(), 1, Cap.snap->state.size(), Cap.fp);
+ ZBlock_Write(Cap.fp, Cap.snap->regs, sizeof(Cap.snap->regs));
+ ZBlock_Write(Cap.fp, Cap.snap->cram, sizeof(Cap.snap->cram));
+ ZBlock_Write(Cap.fp, Cap.snap->vram, sizeof(Cap.snap->vram));
+ ZBlock_Write(Cap.fp, Cap.cmds.data(), Cap.cmds.size() * sizeof(WQ_Entry));
+ ZBlock_Write(Cap.fp, Cap.libs.data(), Cap.libs.size() * sizeof(VDP2Rend_LIB));
+ Cap.frames++;
+
+ if(Cap.frames_left && !--Cap.frames_left)
+  Automation_VDP2CaptureStop();
+}
+
 //
 //
 //
 //
 //
-void VDP2REND_Init(const bool IsPAL, const uint64 affinity)
+void VDP2REND_Init(const bool IsPAL, const uint64 affinity, const unsigned nbg_workers, const bool tile_cache)
 {
  PAL = IsPAL;
  VisibleLines = PAL ? 288 : 240;
  //
  UserLayerEnableMask = ~0U;
  Clock28M = false;
+ TileCacheEnable = tile_cache;
+ memset(TileCache, 0, sizeof(TileCache));
  //
  WQ_ReadPos = 0;
  WQ_WritePos = 0;
  WQ_InCount.store(0, std::memory_order_release); 
  DrawCounter.store(0, std::memory_order_release);
+ RThreadIdle.store(false, std::memory_order_release);
+ WQ_WriterLimit.store(0, std::memory_order_release);
 
  WakeupSem = MThreading::Sem_Create();
+ WriterSem = MThreading::Sem_Create();
+ RThreadAffinity = affinity;
  RThread = MThreading::Thread_Create(RThreadEntry, NULL, "MDFN VDP2 Render");
  if(affinity)
   MThreading::Thread_SetAffinity(RThread, affinity);
+
+ NBGJobClaim.store(0, std::memory_order_release);
+ NBGWorkersExit.store(false, std::memory_order_release);
+ NBGWorkerCount = std::min<unsigned>(nbg_workers, sizeof(NBGWorkers) / sizeof(NBGWorkers[0]));
+ if(NBGWorkerCount)
+ {
+  NBGWorkerSem = MThreading::Sem_Create();
+  for(unsigned i = 0; i < NBGWorkerCount; i++)
+   NBGWorkers[i] = MThreading::Thread_Create(NBGWorkerEntry, NULL, "MDFN VDP2 NBG Worker");
+ }
 }
 
 // Needed for ss.correct_aspect == 0
@@ -3387,17 +4396,83 @@ void VDP2REND_SetGetVideoParams(MDFNGI* gi, const bool caspect, const int sls, c
 
 void VDP2REND_Kill(void)
 {
+ Automation_VDP2CaptureStop();
+ Automation_VDP2LayerCaptureStop();
+
  if(RThread != NULL)
  {
   WWQ(COMMAND_EXIT);
   MThreading::Thread_Wait(RThread, NULL);
  }
 
+ if(NBGWorkerCount)
+ {
+  NBGWorkersExit.store(true, std::memory_order_release);
+  for(unsigned i = 0; i < NBGWorkerCount; i++)
+  {
+   MThreading::Sem_Post(NBGWorkerSem);
+   MThreading::Thread_Wait(NBGWorkers[i], NULL);
+  }
+  MThreading::Sem_Destroy(NBGWorkerSem);
+  NBGWorkerSem = NULL;
+  NBGWorkerCount = 0;
+ }
+
  if(WakeupSem != NULL)
  {
   MThreading::Sem_Destroy(WakeupSem);
   WakeupSem = NULL;
  }
+
+ if(WriterSem != NULL)
+ {
+  MThreading::Sem_Destroy(WriterSem);
+  WriterSem = NULL;
+ }
+}
+
+//
+// For fork(): ends the render thread and NBG workers once the render thread has run everything already queued,
+// without touching any render state; VDP2REND_ResumeThreads() starts them again.
+//
+void VDP2REND_SuspendThreads(void)
+{
+ if(RThread != NULL)
+ {
+  WWQ(COMMAND_EXIT);
+  MThreading::Thread_Wait(RThread, NULL);
+  RThread = NULL;
+ }
+
+ if(NBGWorkerCount)
+ {
+  NBGWorkersExit.store(true, std::memory_order_release);
+  for(unsigned i = 0; i < NBGWorkerCount; i++)
+   MThreading::Sem_Post(NBGWorkerSem);
+
+  for(unsigned i = 0; i < NBGWorkerCount; i++)
+  {
+   MThreading::Thread_Wait(NBGWorkers[i], NULL);
+   NBGWorkers[i] = NULL;
+  }
+ }
+}
+
+void VDP2REND_ResumeThreads(void)
+{
+ if(RThread == NULL)
+ {
+  RThread = MThreading::Thread_Create(RThreadEntry, NULL, "MDFN VDP2 Render");
+  if(RThreadAffinity)
+   MThreading::Thread_SetAffinity(RThread, RThreadAffinity);
+ }
+
+ if(NBGWorkerCount && NBGWorkers[0] == NULL)
+ {
+  NBGWorkersExit.store(false, std::memory_order_release);
+  for(unsigned i = 0; i < NBGWorkerCount; i++)
+   NBGWorkers[i] = MThreading::Thread_Create(NBGWorkerEntry, NULL, "MDFN VDP2 NBG Worker");
+ }
 }
 
 void VDP2REND_StartFrame(EmulateSpecStruct* espec_arg, const bool clock28m, const int SurfInterlaceField)
@@ -3420,19 +4495,60 @@ void VDP2REND_StartFrame(EmulateSpecStruct* espec_arg, const bool clock28m, cons
  espec->DisplayRect.y = LineVisFirst << espec->InterlaceOn;
  espec->DisplayRect.w = 0;
  espec->DisplayRect.h = (LineVisLast + 1 - LineVisFirst) << espec->InterlaceOn;
+
+ if(MDFN_UNLIKELY(Cap.fp != NULL) && !espec->skip)
+  CaptureFrameStart();
+
+ if(MDFN_UNLIKELY(LayerCap.fp != NULL) && !espec->skip)
+  LayerCaptureFrameStart();
 }
 
 void VDP2REND_EndFrame(void)
 {
+ const uint64 wait_start = PerfClock_Now();
+
  while(MDFN_UNLIKELY(DrawCounter.load(std::memory_order_acquire) != 0))
  {
   //fprintf(stderr, "SLEEEEP\n");
   //Time::SleepMS(1);
  }
 
+ WaitTicks += PerfClock_Now() - wait_start;
+
  WWQ(COMMAND_SET_BUSYWAIT, false);
 
- if(NextOutLine < VisibleLines)
+ if(MDFN_UNLIKELY(Cap.recording))
+  CaptureFrameEnd();
+
+ if(MDFN_UNLIKELY(LayerCap.recording))
+  LayerCaptureFrameEnd();
+
+ if(MDFN_UNLIKELY(RTimeActive))
+ {
+  // Once the queue is empty the render thread is idle, and RTimeCur is ours until the next WWQ().
+  while(WQ_InCount.load(std::memory_order_acquire) != 0)
+  {
+  }
+
+  if(!espec->skip)
+  {
+   RTimeLast = RTimeCur;
+   for(unsigned i = 0; i < RTIME__COUNT; i++)
+    RTimeTotal.ns[i] += RTimeCur.ns[i];
+   RTimeTotal.line_ns += RTimeCur.line_ns;
+   RTimeTotal.lines += RTimeCur.lines;
+   if(RTimeCur.max_line_ns > RTimeTotal.max_line_ns)
+   {
+    RTimeTotal.max_line_ns = RTimeCur.max_line_ns;
+    RTimeTotal.max_line = RTimeCur.max_line;
+   }
+   RTimeFrames++;
+  }
+  memset(&RTimeCur, 0, sizeof(RTimeCur));
+ }
+
+ // Skipped frames leave the surface alone; see VDP2REND_DrawLine().
+ if(NextOutLine < VisibleLines && !espec->skip)
  {
   //printf("OutLineCounter(%d) < VisibleLines(%d)\n", OutLineCounter, VisibleLines);
   do
@@ -3463,6 +4579,11 @@ void VDP2REND_DrawLine(const int vdp2_line, const uint32 crt_line, const bool fi
 {
  const unsigned bwthresh = VisibleLines - 48;
 
+ // Nothing to compose when the driver skips the frame(e.g. automation headless runs).  Per-frame
+ // render state is reinitialized at vdp2_line 0, so the next drawn frame comes out the same.
+ if(MDFN_UNLIKELY(espec->skip))
+  return;
+
  if(MDFN_LIKELY(crt_line < VisibleLines))
  {
   uint16 out_line = crt_line;
@@ -3477,7 +4598,6 @@ void VDP2REND_DrawLine(const int vdp2_line, const uint32 crt_line, const bool fi
   if(crt_line == bwthresh)
   {
    WWQ(COMMAND_SET_BUSYWAIT, true);
-   MThreading::Sem_Post(WakeupSem);
   }
   else if(crt_line < bwthresh)
   {
@@ -3486,7 +4606,7 @@ void VDP2REND_DrawLine(const int vdp2_line, const uint32 crt_line, const bool fi
    else if((wdcq + 1) >= 64 && DoWakeupIfNecessary)
    {
     //printf("Post Wakeup: %3d --- crt_line=%3d\n", wdcq + 1, crt_line);
-    MThreading::Sem_Post(WakeupSem);
+    RThreadWake();
     DoWakeupIfNecessary = false;
    }
   }
@@ -3505,6 +4625,12 @@ void VDP2REND_SetLayerEnableMask(uint64 mask)
  WWQ(COMMAND_SET_LEM, mask);
 }
 
+void VDP2REND_SetPreview(bool enabled)
+{
+ PreviewOnEmu = enabled;
+ WWQ(COMMAND_SET_PREVIEW, enabled);
+}
+
 void VDP2REND_Write8_DB(uint32 A, uint16 DB)
 {
  //if(DrawCounter.load(std::memory_order_acquire) != 0)
@@ -3523,8 +4649,7 @@ void VDP2REND_Write16_DB(uint32 A, uint16 DB)
 
 void VDP2REND_StateAction(StateMem* sm, const unsigned load, const bool data_only, uint16 (&rr)[0x100], uint16 (&cr)[2048], uint16 (&vr)[262144])
 {
- while(MDFN_UNLIKELY(WQ_InCount.load(std::memory_order_acquire) != 0))
-  Time::SleepMS(1);
+ WQ_WaitDrain(0);
  //
  //
  //
@@ -3578,9 +4703,424 @@ void VDP2REND_StateAction(StateMem* sm, const unsigned load, const bool data_onl
  {
   memcpy(VRAM, vr, sizeof(VRAM));
   memcpy(CRAM, cr, sizeof(CRAM));
+  memset(TileCache, 0, sizeof(TileCache));
 
   RecalcColorCache();
  }
 }
 
+//
+// Automation accessors(declared in automation_ss.h); called from the emulation thread.
+//
+void Automation_VDP2SetPreview(bool enabled)
+{
+ VDP2REND_SetPreview(enabled);
+}
+
+bool Automation_VDP2PreviewIsActive(void)
+{
+ return PreviewOnEmu;
+}
+
+void Automation_VDP2TimingStart(void)
+{
+ memset(&RTimeLast, 0, sizeof(RTimeLast));
+ memset(&RTimeTotal, 0, sizeof(RTimeTotal));
+ RTimeFrames = 0;
+ RTimeActive = true;
+ WWQ(COMMAND_SET_RTIME, true);
+}
+
+void Automation_VDP2TimingStop(void)
+{
+ if(!RTimeActive)
+  return;
+
+ RTimeActive = false;
+ WWQ(COMMAND_SET_RTIME, false);
+}
+
+bool Automation_VDP2TimingIsActive(void)
+{
+ return RTimeActive;
+}
+
+// " frames=N lines=L setup=<us> spr=<us> ... mix=<us> line=<us> max_line=<us>@<line>" for the last
+// rendered frame, or averaged per frame since start if total.
+std::string Automation_VDP2TimingFormat(bool total)
+{
+ static const char* const names[RTIME__COUNT] = { "setup", "spr", "rbg0", "rbg1", "nbg0", "nbg1", "nbg2", "nbg3", "mix" };
+ const RTimeCounters& c = total ? RTimeTotal : RTimeLast;
+ const double div = (total && RTimeFrames) ? 1000.0 * RTimeFrames : 1000.0;
+ std::string ret;
+ char buf[64];
+
+ snprintf(buf, sizeof(buf), " frames=%llu lines=%u", (unsigned long long)RTimeFrames, (unsigned)(total && RTimeFrames ? c.lines / RTimeFrames : c.lines));
+ ret += buf;
+ for(unsigned i = 0; i < RTIME__COUNT; i++)
+ {
+  snprintf(buf, sizeof(buf), " %s=%.1f", names[i], c.ns[i] / div);
+  ret += buf;
+ }
+ snprintf(buf, sizeof(buf), " line=%.1f max_line=%.1f@%u", c.line_ns / div, c.max_line_ns / 1000.0, (unsigned)c.max_line);
+ ret += buf;
+
+ return ret;
+}
+
+// Two short lines for the FPS overlay: last frame's render time, and its most expensive layer's share.
+std::string Automation_VDP2TimingSummary(void)
+{
+ static const char* const names[RTIME__COUNT] = { "SU", "SP", "R0", "R1", "N0", "N1", "N2", "N3", "MX" };
+ unsigned top = 0;
+ char buf[32];
+
+ for(unsigned i = 1; i < RTIME__COUNT; i++)
+ {
+  if(RTimeLast.ns[i] > RTimeLast.ns[top])
+   top = i;
+ }
+
+ snprintf(buf, sizeof(buf), "%.2fms\n%s %u%%", RTimeLast.line_ns / 1000000.0, names[top], (unsigned)(RTimeLast.line_ns ? RTimeLast.ns[top] * 100 / RTimeLast.line_ns : 0));
+
+ return buf;
+}
+
+
+bool Automation_VDP2CaptureStart(const char* path, const uint32 frames)
+{
+ Automation_VDP2CaptureStop();
+
+ if(!(Cap.fp = fopen(path, "wb")))
+  return false;
+
+ fwrite("MDFNV2C1", 1, 8, Cap.fp);
+ Cap.snap.reset(new RenderSnapshot());
+ Cap.frames = 0;
+ Cap.frames_left = frames;
+ Cap.recording = false;
+
+ return true;
+}
+
+uint32 Automation_VDP2CaptureStop(void)
+{
+ if(!Cap.fp)
+  return Cap.frames;
+
+ fclose(Cap.fp);
+ Cap.fp = NULL;
+ Cap.recording = false;
+ Cap.snap.reset();
+ Cap.cmds = std::vector<WQ_Entry>();
+ Cap.libs = std::vector<VDP2Rend_LIB>();
+
+ return Cap.frames;
+}
+
+bool Automation_VDP2CaptureIsActive(void)
+{
+ return Cap.fp != NULL;
+}
+
+bool Automation_VDP2LayerCaptureStart(const char* path)
+{
+ Automation_VDP2LayerCaptureStop();
+
+ if(!(LayerCap.fp = fopen(path, "wb")))
+  return false;
+
+ fwrite("MDFNV2L1", 1, 8, LayerCap.fp);
+ LayerCap.planes.resize(LAYERCAP__COUNT * LAYERCAP_LINES * LAYERCAP_WIDTH);
+ LayerCap.recording = false;
+
+ return true;
+}
+
+void Automation_VDP2LayerCaptureStop(void)
+{
+ if(!LayerCap.fp)
+  return;
+
+ // Not mid-frame: the render thread may still be writing planes.
+ if(LayerCap.recording)
+ {
+  WWQ(COMMAND_SET_LAYERCAP, false);
+  while(WQ_InCount.load(std::memory_order_acquire) != 0)
+  {
+  }
+  LayerCap.recording = false;
+ }
+
+ fclose(LayerCap.fp);
+ LayerCap.fp = NULL;
+ LayerCap.planes = std::vector<uint32>();
+}
+
+bool Automation_VDP2LayerCaptureIsPending(void)
+{
+ return LayerCap.fp != NULL;
+}
+
+struct BenchFrame
+{
+ uint32 crc;
+ uint64 format_tag;
+ uint32 flags;
+ int32 display_x;
+ std::unique_ptr<RenderSnapshot> snap;
+ std::vector<WQ_Entry> cmds;
+ std::vector<VDP2Rend_LIB> libs;
+};
+
+// Returns false at a clean end of file; throws on a truncated or inconsistent record.
+static bool BenchReadFrame(FILE* fp, const uint32 index, BenchFrame* bf)
+{
+ enum : uint32 { Max_Entries = 1U << 20 };
+ uint8 hdr[4 + 8 + 4 * 6];
+ const size_t n = fread(hdr, 1, sizeof(hdr), fp);
+
+ if(!n)
+  return false;
+
+ const uint32 cmd_count = (n == sizeof(hdr)) ? MDFN_de32lsb(&hdr[20]) : 0;
+ const uint32 lib_count = (n == sizeof(hdr)) ? MDFN_de32lsb(&hdr[24]) : 0;
+ const uint32 state_len = (n == sizeof(hdr)) ? MDFN_de32lsb(&hdr[28]) : 0;
+ bool ok = (n == sizeof(hdr) && cmd_count <= Max_Entries && lib_count <= cmd_count && state_len <= Max_Entries);
+
+ if(ok)
+ {
+  bf->crc = MDFN_de32lsb(&hdr[0]);
+  bf->format_tag = MDFN_de64lsb(&hdr[4]);
+  bf->flags = MDFN_de32lsb(&hdr[12]);
+  bf->display_x = MDFN_de32lsb(&hdr[16]);
+  bf->snap.reset(new RenderSnapshot());
+  bf->snap->state.resize(state_len);
+  bf->cmds.resize(cmd_count);
+  bf->libs.resize(lib_count);
+
+  ok = fread(bf->snap->state.data(), 1, state_len, fp) == state_len &&
+	ZBlock_Read(fp, bf->snap->regs, sizeof(bf->snap->regs)) &&
+	ZBlock_Read(fp, bf->snap->cram, sizeof(bf->snap->cram)) &&
+	ZBlock_Read(fp, bf->snap->vram, sizeof(bf->snap->vram)) &&
+	ZBlock_Read(fp, bf->cmds.data(), cmd_count * sizeof(WQ_Entry)) &&
+	ZBlock_Read(fp, bf->libs.data(), lib_count * sizeof(VDP2Rend_LIB));
+ }
+
+ if(ok)
+ {
+  uint32 lines = 0;
+
+  for(const WQ_Entry& e : bf->cmds)
+  {
+   if(e.Command == COMMAND_DRAW_LINE)
+   {
+    ok &= (uint16)e.Arg32 < 576 && (e.Arg32 >> 16) < 256;
+    lines++;
+   }
+  }
+  ok &= (lines == lib_count) && bf->display_x >= 0 && bf->display_x < 704;
+ }
+
+ if(!ok)
+  throw MDFN_Error(0, "truncated or corrupt record %u", index);
+
+ return true;
+}
+
+// Runs one captured frame's commands from its snapshot, as the render thread would; returns the output crc32.
+static uint32 BenchRunFrame(const BenchFrame& bf, EmulateSpecStruct* es)
+{
+ size_t li = 0;
+
+ RestoreSnapshot(bf.snap.get());
+ espec = es;
+
+ for(const WQ_Entry& e : bf.cmds)
+ {
+  switch(e.Command)
+  {
+   case COMMAND_WRITE8:
+	MemW<uint8>(e.Arg32, e.Arg16);
+	break;
+
+   case COMMAND_WRITE16:
+	MemW<uint16>(e.Arg32, e.Arg16);
+	break;
+
+   case COMMAND_DRAW_LINE:
+	LIB[e.Arg32 >> 16] = bf.libs[li++];
+	DrawLine((uint16)e.Arg32, e.Arg32 >> 16, e.Arg16);
+	break;
+
+   case COMMAND_RESET:
+	Reset(e.Arg32);
+	break;
+
+   case COMMAND_SET_LEM:
+	UserLayerEnableMask = e.Arg32;
+	break;
+  }
+ }
+
+ espec = NULL;
+
+ return HashFrameLines(es, bf.cmds);
+}
+
+//
+// Replays each frame of a capture file 'repeat' times on the calling thread, once single-threaded and once more with the
+// NBG workers if any were configured, and reports host nanoseconds per line, per-layer cost(single-threaded pass) and
+// output crc32 mismatches against the capture(preview mode off).  Render state, memory, LIB, the layer enable mask and
+// preview mode are saved beforehand and restored afterwards, so emulation resumes unaffected.  Must be called between frames.
+//
+bool Automation_VDP2Bench(const char* path, const unsigned repeat, std::string* report)
+{
+ static const char* const names[RTIME__COUNT] = { "setup", "spr", "rbg0", "rbg1", "nbg0", "nbg1", "nbg2", "nbg3", "mix" };
+ const unsigned reps = std::max<unsigned>(1, repeat);
+ FILE* fp;
+ char magic[8];
+
+ if(espec)
+ {
+  *report = "frame in progress";
+  return false;
+ }
+
+ if(!(fp = fopen(path, "rb")))
+ {
+  *report = "cannot open " + std::string(path);
+  return false;
+ }
+
+ if(fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, "MDFNV2C1", 8))
+ {
+  fclose(fp);
+  *report = "not a VDP2 capture file";
+  return false;
+ }
+
+ WQ_WaitDrain(0);
+ //
+ // Save
+ //
+ std::unique_ptr<RenderSnapshot> saved(new RenderSnapshot());
+ std::unique_ptr<VDP2Rend_LIB[]> saved_lib(new VDP2Rend_LIB[256]);
+ const uint32 saved_lem = UserLayerEnableMask;
+ const bool saved_preview_on = PreviewOn;
+ const bool saved_rtime_on = RTimeOn;
+ const RTimeCounters saved_rtime_cur = RTimeCur;
+ const unsigned saved_workers = NBGWorkerCount;
+
+ std::copy(LIB, LIB + 256, saved_lib.get());
+ try
+ {
+  TakeSnapshot(saved.get());
+ }
+ catch(std::exception& e)
+ {
+  fclose(fp);
+  *report = e.what();
+  return false;
+ }
+ //
+ // Replay
+ //
+ std::unique_ptr<MDFN_Surface> surf;
+ std::unique_ptr<int32[]> line_widths(new int32[576]);
+ EmulateSpecStruct bes;
+ BenchFrame bf;
+ RTimeCounters st_total, mt_total;
+ uint32 frames = 0, st_mismatches = 0, mt_mismatches = 0;
+ bool ok = true;
+
+ memset(&st_total, 0, sizeof(st_total));
+ memset(&mt_total, 0, sizeof(mt_total));
+ bes.LineWidths = line_widths.get();
+ RTimeOn = true;
+ PreviewOn = false;
+
+ try
+ {
+  while(BenchReadFrame(fp, frames, &bf))
+  {
+   if(!surf || surf->format.tag != bf.format_tag)
+    surf.reset(new MDFN_Surface(NULL, 704, 576, 704, MDFN_PixelFormat(bf.format_tag)));
+
+   bes.surface = surf.get();
+   bes.DisplayRect.x = bf.display_x;
+   bes.InterlaceOn = bf.flags & 1;
+   bes.InterlaceField = (bf.flags >> 1) & 1;
+
+   for(unsigned pass = 0; pass < (saved_workers ? 2 : 1); pass++)
+   {
+    RTimeCounters& total = pass ? mt_total : st_total;
+
+    NBGWorkerCount = pass ? saved_workers : 0;
+    for(unsigned r = 0; r < reps; r++)
+    {
+     memset(&RTimeCur, 0, sizeof(RTimeCur));
+     const uint32 crc = BenchRunFrame(bf, &bes);
+
+     for(unsigned i = 0; i < RTIME__COUNT; i++)
+      total.ns[i] += RTimeCur.ns[i];
+     total.line_ns += RTimeCur.line_ns;
+     total.lines += RTimeCur.lines;
+
+     if(!r && crc != bf.crc)
+      (pass ? mt_mismatches : st_mismatches)++;
+    }
+   }
+   frames++;
+  }
+ }
+ catch(std::exception& e)
+ {
+  *report = e.what();
+  ok = false;
+ }
+ fclose(fp);
+ espec = NULL;
+ //
+ // Restore
+ //
+ NBGWorkerCount = saved_workers;
+ RestoreSnapshot(saved.get());
+ std::copy(saved_lib.get(), saved_lib.get() + 256, LIB);
+ UserLayerEnableMask = saved_lem;
+ PreviewOn = saved_preview_on;
+ RTimeOn = saved_rtime_on;
+ RTimeCur = saved_rtime_cur;
+
+ if(ok)
+ {
+  const double st_lines = std::max<uint32>(1, st_total.lines);
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), " frames=%u lines=%u repeat=%u", frames, st_total.lines / reps, reps);
+  *report = buf;
+  snprintf(buf, sizeof(buf), " st_ns_line=%.1f", st_total.line_ns / st_lines);
+  *report += buf;
+  if(saved_workers)
+  {
+   snprintf(buf, sizeof(buf), " mt_ns_line=%.1f", mt_total.line_ns / (double)std::max<uint32>(1, mt_total.lines));
+   *report += buf;
+  }
+  for(unsigned i = 0; i < RTIME__COUNT; i++)
+  {
+   snprintf(buf, sizeof(buf), " %s=%.1f", names[i], st_total.ns[i] / st_lines);
+   *report += buf;
+  }
+  snprintf(buf, sizeof(buf), " mismatches=%u", st_mismatches);
+  *report += buf;
+  if(saved_workers)
+  {
+   snprintf(buf, sizeof(buf), " mt_mismatches=%u", mt_mismatches);
+   *report += buf;
+  }
+ }
+
+ return ok;
+}
+
 }
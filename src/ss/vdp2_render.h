@@ -25,14 +25,17 @@
 namespace MDFN_IEN_SS
 {
 
-void VDP2REND_Init(const bool IsPAL, const uint64 affinity) MDFN_COLD;
+void VDP2REND_Init(const bool IsPAL, const uint64 affinity, const unsigned nbg_workers, const bool tile_cache) MDFN_COLD;
 void VDP2REND_SetGetVideoParams(MDFNGI* gi, const bool caspect, const int sls, const int sle, const bool show_h_overscan, const bool dohblend) MDFN_COLD;
 void VDP2REND_Kill(void) MDFN_COLD;
+void VDP2REND_SuspendThreads(void) MDFN_COLD;
+void VDP2REND_ResumeThreads(void) MDFN_COLD;
 void VDP2REND_GetGunXTranslation(const bool clock28m, float* scale, float* offs);
 void VDP2REND_StartFrame(EmulateSpecStruct* espec, const bool clock28m, const int SurfInterlaceField);
 void VDP2REND_EndFrame(void);
 void VDP2REND_Reset(bool powering_up) MDFN_COLD;
 void VDP2REND_SetLayerEnableMask(uint64 mask) MDFN_COLD;
+void VDP2REND_SetPreview(bool enabled) MDFN_COLD;	// Half the lines repeated; output only, not accurate.
 
 void VDP2REND_StateAction(StateMem* sm, const unsigned load, const bool data_only, uint16 (&rr)[0x100], uint16 (&cr)[2048], uint16 (&vr)[262144]) MDFN_COLD;
 
@@ -58,6 +61,8 @@ void VDP2REND_DrawLine(int vdp2_line, const uint32 crt_line, const bool field);
 void VDP2REND_Write8_DB(uint32 A, uint16 DB) MDFN_HOT;
 void VDP2REND_Write16_DB(uint32 A, uint16 DB) MDFN_HOT;
 
+uint64 VDP2REND_GetWaitTicks(void);	// running total, in PerfClock_Now() units(perf_clock.h)
+
 }
 
 #endif
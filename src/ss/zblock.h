@@ -0,0 +1,55 @@
+/* zblock.h -- Length-prefixed zlib blocks for capture files
+ *
+ * A block is le32 compressed length, then that many bytes of zlib data. The
+ * reader knows the uncompressed size up front (a VRAM image, a command list
+ * whose count was stored earlier), and rejects a block that doesn't inflate
+ * to exactly that size. Used by the VDP1 and VDP2 capture/bench commands.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#ifndef __MDFN_SS_ZBLOCK_H
+#define __MDFN_SS_ZBLOCK_H
+
+#include <mednafen/types.h>
+#include <mednafen/endian.h>
+#include <zlib.h>
+#include <cstdio>
+#include <vector>
+
+namespace MDFN_IEN_SS
+{
+
+static INLINE void ZBlock_Write(FILE* fp, const void* data, const size_t len)
+{
+ std::vector<Bytef> z(compressBound(len));
+ uLongf zlen = z.size();
+ uint8 hdr[4];
+
+ compress2(z.data(), &zlen, (const Bytef*)data, len, 1);
+ Mednafen::MDFN_en32lsb(hdr, zlen);
+ fwrite(hdr, 1, sizeof(hdr), fp);
+ fwrite(z.data(), 1, zlen, fp);
+}
+
+static INLINE bool ZBlock_Read(FILE* fp, void* data, const size_t len)
+{
+ uint8 hdr[4];
+
+ if(fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr))
+  return false;
+
+ const uint32 zlen = Mednafen::MDFN_de32lsb(hdr);
+ uLongf out_len = len;
+
+ if(zlen > compressBound(len))
+  return false;
+
+ std::vector<Bytef> z(zlen);
+
+ return fread(z.data(), 1, zlen, fp) == zlen && uncompress((Bytef*)data, &out_len, z.data(), zlen) == Z_OK && out_len == len;
+}
+
+}
+
+#endif
@@ -30,7 +30,15 @@
 #include "video/resize.h"
 
 #include "MemoryStream.h"
+#include "ExtMemStream.h"
+#include "FileStream.h"
 #include "compress/GZFileStream.h"
+#include <mednafen/MThreading.h>
+#include <mednafen/NativeVFS.h>
+#define XXH_STATIC_LINKING_ONLY
+#include "zstd/common/xxhash.h"
+
+#include <deque>
 
 namespace Mednafen
 {
@@ -42,6 +50,21 @@ struct StateSectionMapEntry
  bool used;
 };
 
+// One data-only section in a raw state file(MDFNSS_SaveRaw()); offset is from the start of the state data.
+struct RawStateSection
+{
+ char name[32];
+ uint64 offset;
+ uint64 size;
+};
+
+struct SFMapEntry
+{
+ const char* name;
+ const SFORMAT* sf;
+ bool found;	// Used for identifying variables that are missing in the save state.
+};
+
 struct StateMem
 {
  StateMem(Stream*s, bool svbe_ = false, int fuzz_ = MDFNSS_FUZZ_DISABLED) : st(s), svbe(svbe_), fuzz(fuzz_) { };
@@ -52,6 +75,28 @@ struct StateMem
  int fuzz = MDFNSS_FUZZ_DISABLED;
 
  std::map<std::string, StateSectionMapEntry> secmap; // For loads
+ std::vector<SFMapEntry> sfmap;	// For loads, scratch for ReadStateChunk(); kept around so its memory is reused across sections.
+
+ //
+ // Data-only fast path, when "st" is a MemoryStream: each section's SFORMAT tree is flattened into "fast_ops",
+ // which is then copied straight from/to the stream's buffer in one go.
+ //
+ struct FastOp
+ {
+  uint8* p;
+  uint64 size;
+  uint32 count;
+  bool align;
+  size_t stride;
+ };
+ MemoryStream* ms = nullptr;
+ std::vector<FastOp> fast_ops;
+
+ bool mapped = false;	// Loading: "st" is over memory that stays put(MDFNSS_LoadRaw()), copied from in place like "ms".
+ std::vector<RawStateSection>* raw_index = nullptr;	// Raw state sections, recorded on save and checked on load.
+ size_t raw_next = 0;
+
+ std::vector<std::pair<std::string, uint64>>* section_hashes = nullptr;	// MDFNSS_HashSections(): hash sections, store nothing.
 
  std::exception_ptr deferred_error;
  void ThrowDeferred(void);
@@ -140,17 +185,12 @@ static void SubWrite(Stream *st, const SFORMAT *sf)
  }
 }
 
-struct compare_cstr
+static bool SFMapEntryNameLess(const SFMapEntry& a, const SFMapEntry& b)
 {
- bool operator()(const char *s1, const char *s2) const
- {
-  return(strcmp(s1, s2) < 0);
- }
-};
-
-typedef std::map<const char *, const SFORMAT *, compare_cstr> SFMap_t;
+ return strcmp(a.name, b.name) < 0;
+}
 
-static void MakeSFMap(const SFORMAT *sf, SFMap_t &sfmap)
+static void MakeSFMapSub(const SFORMAT *sf, std::vector<SFMapEntry>* sfmap)
 {
  while(sf->size || sf->name) // Size can sometimes be zero, so also check for the text name.  These two should both be zero only at the end of a struct.
  {
@@ -161,27 +201,51 @@ static void MakeSFMap(const SFORMAT *sf, SFMap_t &sfmap)
   }
 
   if(sf->size == ~0U)            /* Link to another SFORMAT structure. */
-   MakeSFMap((const SFORMAT *)sf->data, sfmap);
+   MakeSFMapSub((const SFORMAT *)sf->data, sfmap);
   else
   {
    assert(sf->name);
 
-   if(sfmap.find(sf->name) != sfmap.end())
-    printf("Duplicate save state variable in internal emulator structures(CLUB THE PROGRAMMERS WITH BREADSTICKS): %s\n", sf->name);
-
-   sfmap[sf->name] = sf;
+   sfmap->push_back({ sf->name, sf, false });
   }
 
   sf++;
  }
 }
 
-static void ReadStateChunk(Stream *st, const SFORMAT *sf, const char* sname, uint32 size, const bool svbe, const int fuzz)
+//
+// Sorted by name; on duplicate names, the last one wins.
+//
+static void MakeSFMap(const SFORMAT *sf, std::vector<SFMapEntry>* sfmap)
 {
- SFMap_t sfmap;
- SFMap_t sfmap_found;	// Used for identifying variables that are missing in the save state.
+ sfmap->clear();
+ MakeSFMapSub(sf, sfmap);
+ std::stable_sort(sfmap->begin(), sfmap->end(), SFMapEntryNameLess);
 
- MakeSFMap(sf, sfmap);
+ size_t o = 0;
+
+ for(size_t i = 0; i < sfmap->size(); i++)
+ {
+  if(o && !strcmp((*sfmap)[o - 1].name, (*sfmap)[i].name))
+  {
+   printf("Duplicate save state variable in internal emulator structures(CLUB THE PROGRAMMERS WITH BREADSTICKS): %s\n", (*sfmap)[i].name);
+   (*sfmap)[o - 1] = (*sfmap)[i];
+  }
+  else
+   (*sfmap)[o++] = (*sfmap)[i];
+ }
+
+ sfmap->resize(o);
+}
+
+static void ReadStateChunk(StateMem* sm, const SFORMAT *sf, const char* sname, uint32 size)
+{
+ Stream* const st = sm->st;
+ const bool svbe = sm->svbe;
+ const int fuzz = sm->fuzz;
+ std::vector<SFMapEntry>& sfmap = sm->sfmap;
+
+ MakeSFMap(sf, &sfmap);
 
  uint64 temp = st->tell();
  while(st->tell() < (temp + size))
@@ -196,13 +260,12 @@ static void ReadStateChunk(Stream *st, const SFORMAT *sf, const char* sname, uin
 
   recorded_size = st->get_LE<uint32>();
 
-  SFMap_t::iterator sfmit;
-
-  sfmit = sfmap.find((char *)toa + 1);
+  const SFMapEntry key = { (char *)toa + 1, nullptr, false };
+  auto sfmit = std::lower_bound(sfmap.begin(), sfmap.end(), key, SFMapEntryNameLess);
 
-  if(MDFN_LIKELY(sfmit != sfmap.end()))
+  if(MDFN_LIKELY(sfmit != sfmap.end() && !strcmp(sfmit->name, key.name)))
   {
-   const SFORMAT *tmp = sfmit->second;
+   const SFORMAT *tmp = sfmit->sf;
 
    if(recorded_size != tmp->size * (1 + tmp->repcount))
    {
@@ -218,7 +281,7 @@ static void ReadStateChunk(Stream *st, const SFORMAT *sf, const char* sname, uin
     uint32 repcount = tmp->repcount;
     const size_t repstride = tmp->repstride; 
 
-    sfmap_found[tmp->name] = tmp;
+    sfmit->found = true;
 
     do
     {
@@ -291,11 +354,11 @@ static void ReadStateChunk(Stream *st, const SFORMAT *sf, const char* sname, uin
   }
  } // while(...)
 
- for(SFMap_t::const_iterator it = sfmap.begin(); it != sfmap.end(); it++)
+ for(const SFMapEntry& e : sfmap)
  {
-  if(sfmap_found.find(it->second->name) == sfmap_found.end())
+  if(!e.found)
   {
-   printf("Variable of bytesize %u missing from save state section \"%s\": %s\n", it->second->size * (1 + it->second->repcount), sname, it->second->name);
+   printf("Variable of bytesize %u missing from save state section \"%s\": %s\n", e.sf->size * (1 + e.sf->repcount), sname, e.name);
   }
  }
 }
@@ -350,6 +413,118 @@ static void FastRWChunk(Stream *st, const SFORMAT *sf)
  }
 }
 
+//
+// Builds the same layout FastRWChunk() reads/writes, as a list of copies; runs of adjacent variables
+// that are also adjacent in memory are merged into one copy.
+//
+static void CompileFastChunk(std::vector<StateMem::FastOp>* ops, const SFORMAT *sf)
+{
+ while(sf->size || sf->name)
+ {
+  if(!sf->size || !sf->data)
+  {
+   sf++;
+   continue;
+  }
+
+  if(sf->size == ~0U)		/* Link to another struct.	*/
+  {
+   CompileFastChunk(ops, (const SFORMAT *)sf->data);
+
+   sf++;
+   continue;
+  }
+
+  StateMem::FastOp op;
+
+  op.p = (uint8*)sf->data;
+  op.size = sf->size;
+  op.count = sf->repcount + 1;
+  op.stride = sf->repstride;
+
+  if(!sf->type)
+   op.size *= sizeof(bool);
+
+  op.align = (op.size >= 65536);
+
+  if(op.count == 1 && !op.align && !ops->empty())
+  {
+   StateMem::FastOp& prev = ops->back();
+
+   if(prev.count == 1 && (prev.p + prev.size) == op.p)
+   {
+    prev.size += op.size;
+    sf++;
+    continue;
+   }
+  }
+
+  ops->push_back(op);
+  sf++;
+ }
+}
+
+template<bool load>
+static void FastRWChunk(StateMem* sm, const SFORMAT *sf)
+{
+ MemoryStream* const ms = sm->ms;
+ const uint64 start_pos = sm->st->tell();
+ uint64 end_pos = start_pos;
+
+ sm->fast_ops.clear();
+ CompileFastChunk(&sm->fast_ops, sf);
+
+ for(const StateMem::FastOp& op : sm->fast_ops)
+ {
+  if(op.align)
+   end_pos = (end_pos + 15) &~ 15;
+
+  end_pos += op.size * op.count;
+ }
+
+ uint8* d;
+
+ if(!ms)	// sm->mapped
+ {
+  Stream* const st = sm->st;
+
+  if(end_pos > st->map_size())
+   throw MDFN_Error(0, _("Unexpected end of save state data."));
+
+  d = st->map() + start_pos;
+  st->seek(end_pos, SEEK_SET);
+ }
+ else
+  d = load ? (uint8*)ms->read_map(end_pos - start_pos) : ms->write_map(end_pos - start_pos);
+ uint64 pos = start_pos;
+
+ for(const StateMem::FastOp& op : sm->fast_ops)
+ {
+  if(op.align)
+  {
+   const uint64 pad = ((pos + 15) &~ 15) - pos;
+
+   if(!load)
+    memset(d, 0, pad);
+
+   d += pad;
+   pos += pad;
+  }
+
+  uint8* p = op.p;
+
+  for(uint32 i = op.count; i; i--, p += op.stride, d += op.size)
+  {
+   if(load)
+    memcpy(p, d, op.size);
+   else
+    memcpy(d, p, op.size);
+  }
+
+  pos += op.size * op.count;
+ }
+}
+
 //
 // When updating this function make sure to adhere to the guarantees in state.h.
 //
@@ -366,10 +541,32 @@ bool MDFNSS_StateAction(StateMem *sm, const unsigned load, const bool data_only,
  {
   Stream* st = sm->st;
 
+  if(MDFN_UNLIKELY(sm->section_hashes))
+  {
+   XXH64_state_t xst;
+
+   assert(!load && data_only);
+   XXH64_reset(&xst, 0);
+   sm->fast_ops.clear();
+   CompileFastChunk(&sm->fast_ops, sf);
+
+   for(const StateMem::FastOp& op : sm->fast_ops)
+   {
+    const uint8* p = op.p;
+
+    for(uint32 i = op.count; i; i--, p += op.stride)
+     XXH64_update(&xst, p, op.size);
+   }
+
+   sm->section_hashes->push_back(std::make_pair(std::string(sname), (uint64)XXH64_digest(&xst)));
+   return true;
+  }
+
   if(MDFN_LIKELY(data_only))	// Not particularly likely, but it's more important to optimize for this code path...
   {
    static const uint8 SSFastCanary[8] = { 0x42, 0xA3, 0x10, 0x87, 0xBC, 0x6D, 0xF2, 0x79 };
    char sname_canary[32 + 8];
+   const uint64 sec_pos = sm->raw_index ? st->tell() : 0;
 
    if(load)
    {
@@ -381,7 +578,20 @@ bool MDFNSS_StateAction(StateMem *sm, const unsigned load, const bool data_only,
     if(memcmp(sname_canary + 32, SSFastCanary, 8))
      throw MDFN_Error(0, _("Section canary is a zombie AAAAAAAAAAGH!"));
 
-    FastRWChunk<true>(st, sf);
+    if(sm->ms || sm->mapped)
+     FastRWChunk<true>(sm, sf);
+    else
+     FastRWChunk<true>(st, sf);
+
+    if(sm->raw_index)
+    {
+     const RawStateSection* rs = (sm->raw_next < sm->raw_index->size()) ? &(*sm->raw_index)[sm->raw_next] : nullptr;
+
+     if(!rs || strncmp(rs->name, sname, 32) || rs->offset != sec_pos || rs->size != (st->tell() - sec_pos))
+      throw MDFN_Error(0, _("Raw save state section \"%.32s\" doesn't match this build's layout."), sname);
+
+     sm->raw_next++;
+    }
    }
    else
    {
@@ -390,7 +600,20 @@ bool MDFNSS_StateAction(StateMem *sm, const unsigned load, const bool data_only,
     memcpy(sname_canary + 32, SSFastCanary, 8);
     st->write(sname_canary, 32 + 8);
 
-    FastRWChunk<false>(st, sf);
+    if(sm->ms)
+     FastRWChunk<false>(sm, sf);
+    else
+     FastRWChunk<false>(st, sf);
+
+    if(sm->raw_index)
+    {
+     RawStateSection rs;
+
+     memcpy(rs.name, sname_canary, 32);
+     rs.offset = sec_pos;
+     rs.size = st->tell() - sec_pos;
+     sm->raw_index->push_back(rs);
+    }
    }
   }
   else
@@ -414,7 +637,7 @@ bool MDFNSS_StateAction(StateMem *sm, const unsigned load, const bool data_only,
     {
      msme->second.used = true;
      st->seek(msme->second.pos, SEEK_SET);
-     ReadStateChunk(st, sf, sname, msme->second.size, sm->svbe, sm->fuzz);
+     ReadStateChunk(sm, sf, sname, msme->second.size);
     }
    }
    else
@@ -467,6 +690,21 @@ void StateMem::ThrowDeferred(void)
  }
 }
 
+void MDFNSS_HashSections(std::vector<std::pair<std::string, uint64>>* hashes)
+{
+	if(!MDFNGameInfo->StateAction)
+	{
+	 throw MDFN_Error(0, _("Module \"%s\" doesn't support save states."), MDFNGameInfo->shortname);
+	}
+
+	StateMem sm(nullptr);
+
+	hashes->clear();
+	sm.section_hashes = hashes;
+	MDFN_StateAction(&sm, 0, true);
+	sm.ThrowDeferred();
+}
+
 void MDFNSS_SaveSM(Stream *st, bool data_only, const MDFN_Surface *surface, const MDFN_Rect *DisplayRect, const int32 *LineWidths)
 {
 	if(!MDFNGameInfo->StateAction)
@@ -478,6 +716,7 @@ void MDFNSS_SaveSM(Stream *st, bool data_only, const MDFN_Surface *surface, cons
 
 	if(data_only)
 	{
+	 sm.ms = dynamic_cast<MemoryStream*>(st);
 	 MDFN_StateAction(&sm, 0, true);
 	 sm.ThrowDeferred();
 	}
@@ -596,53 +835,121 @@ void MDFNSS_LoadSM(Stream *st, bool data_only, const int fuzz)
 	if(MDFN_LIKELY(data_only))
 	{
 	 StateMem sm(st);
+	 sm.ms = dynamic_cast<MemoryStream*>(st);
 	 MDFN_StateAction(&sm, MEDNAFEN_VERSION_NUMERIC, true);
 	 sm.ThrowDeferred();
 	}
 	else
 	{
-         uint8 header[32];
-	 uint32 width, height, preview_len;
-  	 uint32 stateversion;
-	 uint32 total_len;
-	 int64 start_pos;
-	 bool svbe;
+	 StateLoader sl;
 
-	 start_pos = st->tell();
-         st->read(header, 32);
+	 sl.Load(st, fuzz);
+	}
+}
 
-         if(memcmp(header, "MEDNAFENSVESTATE", 16) && memcmp(header, "MDFNSVST", 8))
-	  throw MDFN_Error(0, _("Missing/Wrong save state header ID."));
+StateLoader::StateLoader() : secmap_map(nullptr), secmap_pos(0), secmap_len(0)
+{
 
-	 stateversion = MDFN_de32lsb(header + 16);
-	 total_len = MDFN_de32lsb(header + 20) & 0x7FFFFFFF;
-         svbe = MDFN_de32lsb(header + 20) & 0x80000000;
-         width = MDFN_de32lsb(header + 24);
-         height = MDFN_de32lsb(header + 28);
-	 preview_len = width * height * 3;
+}
 
-	 if((int)stateversion < 0x900)	// Ensuring that (int)stateversion is > 0 is the most important part.
-	  throw MDFN_Error(0, _("Invalid/Unsupported version in save state header."));
+StateLoader::~StateLoader()
+{
 
-	 st->seek(preview_len, SEEK_CUR);				// Skip preview
+}
 
-	 {
-	  StateMem sm(st, svbe, fuzz);
+//
+// Checks that every cached section map entry still points at a section header with the same name and size, in
+// the same mapped blob, so that the map can be reused without re-parsing.
+//
+bool StateLoader::SectionMapValid(Stream* st, const uint64 start_pos, const uint32 total_len)
+{
+ const uint8* const map = st->map();
 
-	  MakeSectionMap(&sm, start_pos + total_len);
+ if(!map || map != secmap_map || start_pos != secmap_pos || total_len != secmap_len || (start_pos + total_len) > st->map_size())
+  return false;
 
-	  MDFN_StateAction(&sm, stateversion, false);			// Load state data.
+ for(auto& msme : sm->secmap)
+ {
+  const StateSectionMapEntry& sme = msme.second;
 
-	  for(auto msme : sm.secmap)
-	  {
-	   if(!msme.second.used)
-	    printf("Warning: Unused section \"%s\".\n", msme.first.c_str());
-	  }
+  if(sme.pos < (start_pos + 32 + 4) || (sme.pos + sme.size) > (start_pos + total_len))
+   return false;
 
-	  sm.ThrowDeferred();
-	 }
-	 st->seek(start_pos + total_len, SEEK_SET);			// Seek to just beyond end of save state before returning.
-	}
+  if(strncmp((const char*)map + sme.pos - 32 - 4, msme.first.c_str(), 32) || MDFN_de32lsb(map + sme.pos - 4) != sme.size)
+   return false;
+ }
+
+ return true;
+}
+
+void StateLoader::Load(Stream* st, const int fuzz)
+{
+ uint8 header[32];
+ uint32 width, height, preview_len;
+ uint32 stateversion;
+ uint32 total_len;
+ int64 start_pos;
+ bool svbe;
+
+ if(!MDFNGameInfo->StateAction)
+ {
+  throw MDFN_Error(0, _("Module \"%s\" doesn't support save states."), MDFNGameInfo->shortname);
+ }
+
+ start_pos = st->tell();
+ st->read(header, 32);
+
+ if(memcmp(header, "MEDNAFENSVESTATE", 16) && memcmp(header, "MDFNSVST", 8))
+  throw MDFN_Error(0, _("Missing/Wrong save state header ID."));
+
+ stateversion = MDFN_de32lsb(header + 16);
+ total_len = MDFN_de32lsb(header + 20) & 0x7FFFFFFF;
+ svbe = MDFN_de32lsb(header + 20) & 0x80000000;
+ width = MDFN_de32lsb(header + 24);
+ height = MDFN_de32lsb(header + 28);
+ preview_len = width * height * 3;
+
+ if((int)stateversion < 0x900)	// Ensuring that (int)stateversion is > 0 is the most important part.
+  throw MDFN_Error(0, _("Invalid/Unsupported version in save state header."));
+
+ st->seek(preview_len, SEEK_CUR);				// Skip preview
+
+ if(!sm)
+  sm.reset(new StateMem(st));
+
+ sm->st = st;
+ sm->svbe = svbe;
+ sm->fuzz = fuzz;
+ sm->deferred_error = nullptr;
+
+ if(SectionMapValid(st, start_pos, total_len))
+ {
+  for(auto& msme : sm->secmap)
+   msme.second.used = false;
+ }
+ else
+ {
+  secmap_map = nullptr;
+  sm->secmap.clear();
+
+  MakeSectionMap(sm.get(), start_pos + total_len);
+
+  secmap_map = st->map();
+  secmap_pos = start_pos;
+  secmap_len = total_len;
+ }
+
+ MDFN_StateAction(sm.get(), stateversion, false);			// Load state data.
+
+ for(const auto& msme : sm->secmap)
+ {
+  if(!msme.second.used)
+   printf("Warning: Unused section \"%s\".\n", msme.first.c_str());
+ }
+
+ sm->ThrowDeferred();
+
+ st->seek(start_pos + total_len, SEEK_SET);			// Seek to just beyond end of save state before returning.
 }
 
 void MDFNSS_SaveInternal(Stream* st, void (*safunc)(StateMem*, const unsigned, const bool))
@@ -665,6 +972,335 @@ void MDFNSS_LoadInternal(Stream* st, void (*safunc)(StateMem*, const unsigned, c
  sm.ThrowDeferred();
 }
 
+//
+// Raw state file layout, all little-endian:
+//	0	"MDFNRAW1"
+//	8	u32 MEDNAFEN_VERSION_NUMERIC
+//	12	u32 section count
+//	16	u64 data offset(a multiple of RawState_Align)
+//	24	u64 data length
+//	32	game MD5[16]
+//	48	u64 epoch time
+//	56	zero[8]
+//	64	section index: count x { name[32], u64 offset in data, u64 size(canary included) }
+//	data	the data-only state, as MDFNSS_SaveSM(st, true) would write it
+//
+enum : uint64 { RawState_Align = 4096 };
+
+void MDFNSS_SaveRaw(const std::string& path)
+{
+ if(!MDFNGameInfo->StateAction)
+  throw MDFN_Error(0, _("Module \"%s\" doesn't support save states."), MDFNGameInfo->shortname);
+ //
+ MemoryStream ms(65536);
+ std::vector<RawStateSection> index;
+ {
+  StateMem sm(&ms);
+
+  sm.ms = &ms;
+  sm.raw_index = &index;
+  MDFN_StateAction(&sm, 0, true);
+  sm.ThrowDeferred();
+ }
+ const uint64 data_pos = (64 + index.size() * 48 + RawState_Align - 1) &~ (RawState_Align - 1);
+ uint8 header[64];
+
+ memset(header, 0, sizeof(header));
+ memcpy(header, "MDFNRAW1", 8);
+ MDFN_en32lsb(header + 8, MEDNAFEN_VERSION_NUMERIC);
+ MDFN_en32lsb(header + 12, index.size());
+ MDFN_en64lsb(header + 16, data_pos);
+ MDFN_en64lsb(header + 24, ms.size());
+ memcpy(header + 32, MDFNGameInfo->MD5, 16);
+ MDFN_en64lsb(header + 48, Time::EpochTime());
+ //
+ // Written to "path".tmp and renamed into place, so a loader never maps a half-written file.
+ //
+ const std::string tmp_path = path + ".tmp";
+
+ try
+ {
+  {
+   FileStream fp(tmp_path, FileStream::MODE_WRITE);
+   std::vector<uint8> pad(data_pos - 64 - index.size() * 48, 0);
+
+   fp.write(header, sizeof(header));
+   for(const RawStateSection& rs : index)
+   {
+    fp.write(rs.name, 32);
+    fp.put_LE<uint64>(rs.offset);
+    fp.put_LE<uint64>(rs.size);
+   }
+   fp.write(pad.data(), pad.size());
+   fp.write(ms.map(), ms.size());
+   fp.close();
+  }
+  NVFS.rename(tmp_path, path);
+ }
+ catch(...)
+ {
+  try
+  {
+   NVFS.unlink(tmp_path);
+  }
+  catch(...)
+  {
+
+  }
+  throw;
+ }
+}
+
+void MDFNSS_LoadRaw(const std::string& path)
+{
+ if(!MDFNGameInfo->StateAction)
+  throw MDFN_Error(0, _("Module \"%s\" doesn't support save states."), MDFNGameInfo->shortname);
+ //
+ FileStream fp(path, FileStream::MODE_READ);
+ std::unique_ptr<MemoryStream> copy;
+ const uint8* m = fp.map();
+ uint64 m_size = fp.map_size();
+
+ if(!m)	// No mmap(); read it instead.
+ {
+  copy.reset(new MemoryStream(fp.size(), -1));
+  fp.read(copy->map(), copy->size());
+  m = copy->map();
+  m_size = copy->size();
+ }
+
+ if(m_size < 64 || memcmp(m, "MDFNRAW1", 8))
+  throw MDFN_Error(0, _("Missing/Wrong raw save state header ID."));
+
+ const uint32 version = MDFN_de32lsb(m + 8);
+ const uint32 count = MDFN_de32lsb(m + 12);
+ const uint64 data_pos = MDFN_de64lsb(m + 16);
+ const uint64 data_len = MDFN_de64lsb(m + 24);
+
+ if(version != MEDNAFEN_VERSION_NUMERIC)
+  throw MDFN_Error(0, _("Raw save state was made by a different Mednafen version(0x%06x)."), version);
+
+ if(memcmp(m + 32, MDFNGameInfo->MD5, 16))
+  throw MDFN_Error(0, _("Raw save state was made with a different game."));
+
+ if(data_pos < 64 + (uint64)count * 48 || data_pos > m_size || data_len > (m_size - data_pos))
+  throw MDFN_Error(0, _("Raw save state is truncated."));
+
+ std::vector<RawStateSection> index(count);
+
+ for(uint32 i = 0; i < count; i++)
+ {
+  const uint8* e = m + 64 + i * 48;
+
+  memcpy(index[i].name, e, 32);
+  index[i].offset = MDFN_de64lsb(e + 32);
+  index[i].size = MDFN_de64lsb(e + 40);
+ }
+ //
+ ExtMemStream es(m + data_pos, data_len);
+ StateMem sm(&es);
+
+ sm.mapped = true;
+ sm.raw_index = &index;
+ MDFN_StateAction(&sm, MEDNAFEN_VERSION_NUMERIC, true);
+ sm.ThrowDeferred();
+
+ if(sm.raw_next != index.size())
+  throw MDFN_Error(0, _("Raw save state has %u sections, this build loaded %u."), count, (unsigned)sm.raw_next);
+}
+
+//
+// Background state file writer.  "queue" and "finished" are protected by "mutex"; the front of "queue" is the job
+// being written, and is only popped after it's finished, so an empty queue means the worker is idle.
+//
+struct AsyncWriteJob
+{
+ std::unique_ptr<MemoryStream> st;
+ std::string path;
+ int level;
+ std::function<void(const std::string&, const std::string&)> done;
+ std::string error;
+};
+
+static struct
+{
+ MThreading::Thread* thread = nullptr;
+ MThreading::Mutex* mutex = nullptr;
+ MThreading::Cond* work_cond = nullptr;	// Signalled when a job is queued, or on quit.
+ MThreading::Cond* idle_cond = nullptr;	// Signalled when the queue becomes empty.
+
+ std::deque<AsyncWriteJob> queue;
+ std::deque<AsyncWriteJob> finished;
+ bool quit = false;
+} AW;
+
+static void AsyncWriteJobRun(AsyncWriteJob* job)
+{
+ const std::string tmp_path = job->path + ".tmp";
+
+ try
+ {
+  {
+   GZFileStream gp(tmp_path, GZFileStream::MODE::WRITE, job->level);
+
+   gp.write(job->st->map(), job->st->size());
+   gp.close();
+  }
+  NVFS.rename(tmp_path, job->path);
+ }
+ catch(std::exception& e)
+ {
+  job->error = e.what();
+
+  try
+  {
+   NVFS.unlink(tmp_path);
+  }
+  catch(...)
+  {
+
+  }
+ }
+ job->st.reset();
+}
+
+static int AsyncWriteThread(void* arg)
+{
+ MThreading::Mutex_Lock(AW.mutex);
+
+ for(;;)
+ {
+  while(AW.queue.empty() && !AW.quit)
+   MThreading::Cond_Wait(AW.work_cond, AW.mutex);
+
+  if(AW.queue.empty())
+   break;
+
+  AsyncWriteJob* job = &AW.queue.front();
+
+  MThreading::Mutex_Unlock(AW.mutex);
+  AsyncWriteJobRun(job);
+  MThreading::Mutex_Lock(AW.mutex);
+
+  AW.finished.push_back(std::move(*job));
+  AW.queue.pop_front();
+
+  if(AW.queue.empty())
+   MThreading::Cond_Signal(AW.idle_cond);
+ }
+
+ MThreading::Mutex_Unlock(AW.mutex);
+
+ return 0;
+}
+
+void MDFNSS_WriteAsync(std::unique_ptr<MemoryStream> st, const std::string& path, const int level, std::function<void(const std::string&, const std::string&)> done)
+{
+ if(!AW.thread)
+ {
+  if(!AW.mutex)
+   AW.mutex = MThreading::Mutex_Create();
+
+  if(!AW.work_cond)
+   AW.work_cond = MThreading::Cond_Create();
+
+  if(!AW.idle_cond)
+   AW.idle_cond = MThreading::Cond_Create();
+
+  AW.quit = false;
+  AW.thread = MThreading::Thread_Create(AsyncWriteThread, nullptr, "MDFN State Writer");
+ }
+
+ AsyncWriteJob job;
+
+ job.st = std::move(st);
+ job.path = path;
+ job.level = level;
+ job.done = std::move(done);
+
+ MThreading::Mutex_Lock(AW.mutex);
+ AW.queue.push_back(std::move(job));	// std::deque::push_back() doesn't invalidate references to other elements.
+ MThreading::Cond_Signal(AW.work_cond);
+ MThreading::Mutex_Unlock(AW.mutex);
+}
+
+void MDFNSS_PollAsync(void)
+{
+ if(!AW.mutex)
+  return;
+
+ for(;;)
+ {
+  AsyncWriteJob job;
+
+  MThreading::Mutex_Lock(AW.mutex);
+
+  if(AW.finished.empty())
+  {
+   MThreading::Mutex_Unlock(AW.mutex);
+   break;
+  }
+
+  job = std::move(AW.finished.front());
+  AW.finished.pop_front();
+  MThreading::Mutex_Unlock(AW.mutex);
+  //
+  if(job.done)
+   job.done(job.path, job.error);
+  else if(job.error.size())
+   MDFND_OutputNotice(MDFN_NOTICE_ERROR, job.error.c_str());
+ }
+}
+
+void MDFNSS_WaitAsync(void)
+{
+ if(!AW.mutex)
+  return;
+
+ MThreading::Mutex_Lock(AW.mutex);
+
+ while(!AW.queue.empty())
+  MThreading::Cond_Wait(AW.idle_cond, AW.mutex);
+
+ MThreading::Mutex_Unlock(AW.mutex);
+
+ MDFNSS_PollAsync();
+}
+
+void MDFNSS_KillAsync(void)
+{
+ MDFNSS_WaitAsync();
+
+ if(AW.thread)
+ {
+  MThreading::Mutex_Lock(AW.mutex);
+  AW.quit = true;
+  MThreading::Cond_Signal(AW.work_cond);
+  MThreading::Mutex_Unlock(AW.mutex);
+
+  MThreading::Thread_Wait(AW.thread, nullptr);
+  AW.thread = nullptr;
+ }
+
+ if(AW.idle_cond)
+ {
+  MThreading::Cond_Destroy(AW.idle_cond);
+  AW.idle_cond = nullptr;
+ }
+
+ if(AW.work_cond)
+ {
+  MThreading::Cond_Destroy(AW.work_cond);
+  AW.work_cond = nullptr;
+ }
+
+ if(AW.mutex)
+ {
+  MThreading::Mutex_Destroy(AW.mutex);
+  AW.mutex = nullptr;
+ }
+}
+
 //
 //
 //
@@ -679,6 +1315,8 @@ void MDFNSS_CheckStates(void)
         if(!MDFNGameInfo->StateAction) 
          return;
 
+	MDFNSS_WaitAsync();
+
 	for(int ssel = 0; ssel < 10; ssel++)
         {
 	 SaveStateStatus[ssel] = false;
@@ -713,6 +1351,8 @@ void MDFNSS_GetStateInfo(const std::string& path, StateStatusStruct* status)
  uint32 StateShowPBHeight;
  uint8 *previewbuffer = NULL;
 
+ MDFNSS_WaitAsync();
+
  try
  {
   GZFileStream fp(path, GZFileStream::MODE::READ);
@@ -810,20 +1450,35 @@ bool MDFNI_SaveState(const char *fname, const char *suffix, const MDFN_Surface *
   }
 
   //
+  // Serialize now, so the state is of this exact point in emulation; compression and writing happen in the background.
   //
   {
-   MemoryStream st(65536);
+   std::unique_ptr<MemoryStream> st(new MemoryStream(65536));
 
-   MDFNSS_SaveSM(&st, false, surface, DisplayRect, LineWidths);
+   MDFNSS_SaveSM(st.get(), false, surface, DisplayRect, LineWidths);
 
    //
    //
    //
-   GZFileStream gp(fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_STATE,CurrentState,suffix),
-			GZFileStream::MODE::WRITE, MDFN_GetSettingI("filesys.state_comp_level"));
+   const bool slot = !fname && !suffix;
+   const int slot_num = CurrentState;
 
-   gp.write(st.map(), st.size());
-   gp.close();
+   MDFNSS_WriteAsync(std::move(st), fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_STATE,CurrentState,suffix), MDFN_GetSettingI("filesys.state_comp_level"),
+	[slot, slot_num](const std::string& path, const std::string& error)
+	{
+	 if(error.size())
+	 {
+	  if(slot)
+	   MDFN_Notify(MDFN_NOTICE_ERROR, _("State %d save error: %s"), slot_num, error.c_str());
+	  else
+	   MDFND_OutputNotice(MDFN_NOTICE_ERROR, error.c_str());
+
+	  if(MDFNnetplay)
+	   MDFND_NetplayText(error.c_str(), false);
+	 }
+	 else if(slot)
+	  MDFN_Notify(MDFN_NOTICE_STATUS, _("State %d saved."), slot_num);
+	});
   }
 
   MDFND_SetStateStatus(NULL);
@@ -832,7 +1487,6 @@ bool MDFNI_SaveState(const char *fname, const char *suffix, const MDFN_Surface *
   {
    SaveStateStatus[CurrentState] = true;
    RecentlySavedState = CurrentState;
-   MDFN_Notify(MDFN_NOTICE_STATUS, _("State %d saved."), CurrentState);
   }
  }
  catch(std::exception &e)
@@ -857,6 +1511,8 @@ bool MDFNI_LoadState(const char *fname, const char *suffix) noexcept
 
  try
  {
+  MDFNSS_WaitAsync();
+
   /* For network play and movies, be load the state locally, and then save the state to a temporary buffer,
      and send or record that.  This ensures that if an older state is loaded that is missing some
      information expected in newer save states, desynchronization won't occur(at least not
@@ -864,23 +1520,32 @@ bool MDFNI_LoadState(const char *fname, const char *suffix) noexcept
   */
 
   {
-   GZFileStream st(fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_STATE,CurrentState,suffix), GZFileStream::MODE::READ);
+   const std::string path = fname ? std::string(fname) : MDFN_MakeFName(MDFNMKF_STATE,CurrentState,suffix);
+   GZFileStream st(path, GZFileStream::MODE::READ);
    uint8 header[32];
    uint32 st_len;
 
    st.read(header, 32);
 
-   st_len = MDFN_de32lsb(header + 16 + 4) & 0x7FFFFFFF;
+   if(!memcmp(header, "MDFNRAW1", 8))
+   {
+    st.close();
+    MDFNSS_LoadRaw(path);
+   }
+   else
+   {
+    st_len = MDFN_de32lsb(header + 16 + 4) & 0x7FFFFFFF;
 
-   if(st_len < 32)
-    throw MDFN_Error(0, _("Save state header length field is bad."));
+    if(st_len < 32)
+     throw MDFN_Error(0, _("Save state header length field is bad."));
 
-   MemoryStream sm(st_len, -1);
+    MemoryStream sm(st_len, -1);
 
-   memcpy(sm.map(), header, 32);
-   st.read(sm.map() + 32, st_len - 32);
+    memcpy(sm.map(), header, 32);
+    st.read(sm.map() + 32, st_len - 32);
 
-   MDFNSS_LoadSM(&sm, false);
+    MDFNSS_LoadSM(&sm, false);
+   }
   }
 
   if(MDFNnetplay)
@@ -26,8 +26,11 @@
 #include "state-common.h"
 #include "Stream.h"
 
+#include <functional>
+
 namespace Mednafen
 {
+class MemoryStream;
 
 void MDFNSS_GetStateInfo(const std::string& path, StateStatusStruct* status);
 
@@ -59,6 +62,61 @@ enum : int
 void MDFNSS_SaveSM(Stream *st, bool data_only = false, const MDFN_Surface *surface = (MDFN_Surface *)NULL, const MDFN_Rect *DisplayRect = (MDFN_Rect*)NULL, const int32 *LineWidths = (int32*)NULL);
 void MDFNSS_LoadSM(Stream *st, bool data_only = false, const int fuzz = MDFNSS_FUZZ_DISABLED);
 
+//
+// Background writing of save state files.  MDFNSS_WriteAsync() takes a finished, uncompressed save state(e.g. from
+// MDFNSS_SaveSM() into a MemoryStream), and a worker thread gzip-compresses it at "level" into "path".tmp, then renames
+// that over "path"; an error or crash never leaves a partially-written file at "path".  Writes finish in queue order.
+//
+// "done", if set, is called with the path and an empty error string on success, or the error message, from
+// MDFNSS_PollAsync() or MDFNSS_WaitAsync() on the calling thread, never from the worker thread.
+//
+void MDFNSS_WriteAsync(std::unique_ptr<MemoryStream> st, const std::string& path, const int level, std::function<void(const std::string&, const std::string&)> done = nullptr);
+void MDFNSS_PollAsync(void);	// Runs "done" for finished writes, without waiting.
+void MDFNSS_WaitAsync(void);	// Waits until every queued write has finished, then runs "done" for them.
+void MDFNSS_KillAsync(void);	// MDFNSS_WaitAsync(), and ends the worker thread.
+
+//
+// Raw state files("MDFNRAW1", layout in state.cpp): the data-only state, uncompressed and page-aligned behind a
+// section index.  MDFNSS_LoadRaw() mmap()s the file and copies each variable straight out of the mapping, so
+// processes loading the same file share its page cache and nothing is decompressed or parsed.  The data-only
+// layout is that of the compiled SFORMAT tables, so a raw state only loads into the same build(checked per section
+// against the index) and the same game(MD5); MDFNI_LoadState() accepts them too.  The file is written to
+// "path".tmp and renamed into place.  Both throw exceptions on errors.
+//
+void MDFNSS_SaveRaw(const std::string& path);
+void MDFNSS_LoadRaw(const std::string& path);
+
+//
+// XXH64 of each section's data-only variables, in save order, hashed in place(nothing is copied or written).  The
+// hashes are of host-order data, so they compare across runs of builds with the same SFORMAT layout on hosts of the
+// same byte order.  Throws exceptions on errors.
+//
+void MDFNSS_HashSections(std::vector<std::pair<std::string, uint64>>* hashes);
+
+//
+// Reusable context for loading normal(not data-only) save states, e.g. reloading the same checkpoint over and over.
+// The section map of the last loaded state is kept, and is reused without re-parsing when the next load
+// is from the same mapped MemoryStream buffer with the same layout; scratch memory is reused across loads.
+//
+// Load() behaves like MDFNSS_LoadSM(st, false, fuzz).
+//
+class StateLoader
+{
+ public:
+ StateLoader();
+ ~StateLoader();
+
+ void Load(Stream* st, const int fuzz = MDFNSS_FUZZ_DISABLED);
+
+ private:
+ bool SectionMapValid(Stream* st, const uint64 start_pos, const uint32 total_len);
+
+ std::unique_ptr<StateMem> sm;
+ const uint8* secmap_map;
+ uint64 secmap_pos;
+ uint32 secmap_len;
+};
+
 void MDFNSS_CheckStates(void);
 
 // For emulation modules' internal use.
@@ -25,6 +25,7 @@
 #include "state_rewind.h"
 
 #include <mednafen/MemoryStream.h>
+#include <mednafen/MThreading.h>
 #include <mednafen/quicklz/quicklz.h>
 
 #if QLZ_COMPRESSION_LEVEL != 0
@@ -34,9 +35,17 @@
 namespace Mednafen
 {
 
+//
+// Each packet is the XOR of two consecutive states, which is zero wherever the state didn't change between the two frames.
+// Only the nonzero pages are kept(and compressed), so frames where most of RAM and VRAM is untouched cost little to store
+// and little to compress.  Compression runs on a worker thread while the next frame is emulated.
+//
+enum : uint32 { SRW_PageSize = 4096 };
+
 struct StateMemPacket
 {
-	std::unique_ptr<MemoryStream> data;
+	std::unique_ptr<MemoryStream> data;	// QuickLZ-compressed nonzero pages, in order; empty if there were none.
+	std::vector<uint32> pages;		// Index of each nonzero page.
 	uint32 uncompressed_len = 0;
 };
 
@@ -44,19 +53,154 @@ static bool Active = false;
 static bool Enabled = false;
 static std::vector<StateMemPacket> bcs;
 static size_t bcs_pos;
+static uint64 bcs_bytes;	// Total compressed size of packets in bcs.
+static uint64 bcs_bytes_limit;
 
 static uint32 SRW_AllocHint;
 static std::unique_ptr<MemoryStream> ss_prev;
 
-static union
+static char qlz_scratch_decompress[QLZ_SCRATCH_DECOMPRESS];
+
+static struct
+{
+ MThreading::Thread* thread = nullptr;
+ MThreading::Sem* start = nullptr;
+ MThreading::Sem* done = nullptr;
+
+ // Owned by the worker between posting "start" and waiting on "done".
+ StateMemPacket* dest;
+ std::unique_ptr<MemoryStream> src;
+ std::exception_ptr error;
+ bool quit;
+ bool pending = false;
+
+ char qlz_scratch[QLZ_SCRATCH_COMPRESS];
+} Comp;
+
+static void DoCompress(StateMemPacket* dest, MemoryStream* data)
+{
+ static const uint8 zero_page[SRW_PageSize] = { 0 };
+ const uint32 uncompressed_len = data->size();
+ uint8* const p = data->map();
+ uint32 packed_len = 0;
+
+ dest->pages.clear();
+ dest->uncompressed_len = uncompressed_len;
+
+ for(uint32 offs = 0; offs < uncompressed_len; offs += SRW_PageSize)
+ {
+  const uint32 n = std::min<uint32>(SRW_PageSize, uncompressed_len - offs);
+
+  if(memcmp(p + offs, zero_page, n))
+  {
+   dest->pages.push_back(offs / SRW_PageSize);
+   memmove(p + packed_len, p + offs, n);
+   packed_len += n;
+  }
+ }
+
+ std::unique_ptr<MemoryStream> tmp_buf(new MemoryStream(packed_len ? (packed_len + 400) : 0, -1));
+
+ if(packed_len)
+ {
+  tmp_buf->truncate(qlz_compress(p, (char*)tmp_buf->map(), packed_len, Comp.qlz_scratch));
+  tmp_buf->shrink_to_fit();
+ }
+
+ dest->data = std::move(tmp_buf);
+}
+
+static int CompressThread(void* arg)
+{
+ for(;;)
+ {
+  MThreading::Sem_Wait(Comp.start);
+
+  if(Comp.quit)
+   break;
+
+  try
+  {
+   DoCompress(Comp.dest, Comp.src.get());
+  }
+  catch(...)
+  {
+   Comp.error = std::current_exception();
+  }
+  Comp.src.reset(nullptr);
+
+  MThreading::Sem_Post(Comp.done);
+ }
+
+ return 0;
+}
+
+// Waits for the packet being compressed, if any, then accounts for its size and drops the oldest packets if over the memory limit.
+static void WaitCompress(void)
 {
- char compress[QLZ_SCRATCH_COMPRESS];
- char decompress[QLZ_SCRATCH_DECOMPRESS];
-} qlz_scratch;
+ if(!Comp.pending)
+  return;
+
+ MThreading::Sem_Wait(Comp.done);
+ Comp.pending = false;
+
+ if(Comp.error)
+ {
+  std::exception_ptr e = Comp.error;
+  Comp.error = nullptr;
+  std::rethrow_exception(e);
+ }
+
+ bcs_bytes += Comp.dest->data->size();
+
+ if(bcs_bytes_limit)
+ {
+  for(size_t i = 0; i < bcs.size() && bcs_bytes > bcs_bytes_limit; i++)
+  {
+   StateMemPacket* smp = &bcs[(bcs_pos + i) % bcs.size()];
+
+   if(smp != Comp.dest && smp->data)
+   {
+    bcs_bytes -= smp->data->size();
+    smp->data.reset(nullptr);
+    smp->pages.clear();
+   }
+  }
+ }
+}
 
 static void Cleanup(void)
 {
+ if(Comp.thread)
+ {
+  if(Comp.pending)
+  {
+   MThreading::Sem_Wait(Comp.done);
+   Comp.pending = false;
+  }
+  Comp.quit = true;
+  MThreading::Sem_Post(Comp.start);
+  MThreading::Thread_Wait(Comp.thread, nullptr);
+  Comp.thread = nullptr;
+ }
+
+ if(Comp.start)
+ {
+  MThreading::Sem_Destroy(Comp.start);
+  Comp.start = nullptr;
+ }
+
+ if(Comp.done)
+ {
+  MThreading::Sem_Destroy(Comp.done);
+  Comp.done = nullptr;
+ }
+
+ Comp.src.reset(nullptr);
+ Comp.error = nullptr;
+
  bcs.clear();
+ bcs_bytes = 0;
  ss_prev.reset(nullptr);
 }
 
@@ -71,10 +215,19 @@ void MDFNSRW_Begin(void) noexcept
   {
    bcs.resize(std::max<size_t>(3, MDFN_GetSettingUI("srwframes")) - 1);
    bcs_pos = 0;
-   memset(&qlz_scratch, 0, sizeof(qlz_scratch));
+   bcs_bytes = 0;
+   bcs_bytes_limit = (uint64)MDFN_GetSettingUI("srwmemory") << 20;
+   memset(qlz_scratch_decompress, 0, sizeof(qlz_scratch_decompress));
+   memset(Comp.qlz_scratch, 0, sizeof(Comp.qlz_scratch));
 
    SRW_AllocHint = 8192;
 
+   Comp.quit = false;
+   Comp.pending = false;
+   Comp.start = MThreading::Sem_Create();
+   Comp.done = MThreading::Sem_Create();
+   Comp.thread = MThreading::Thread_Create(CompressThread, nullptr, "MDFN Rewind Compress");
+
    Active = true;
   }
   catch(std::exception &e)
@@ -106,26 +259,13 @@ static INLINE void DoXORFilter(MemoryStream* prev, MemoryStream* cur) noexcept
  MDFN_FastMemXOR(prev->map(), cur->map(), std::min(prev->size(), cur->size()));
 }
 
-
-static INLINE std::unique_ptr<MemoryStream> DoCompress(MemoryStream* data)
-{
- const uint32 uncompressed_len = data->size();
- const uint32 max_compressed_len = (uncompressed_len + 400);
- std::unique_ptr<MemoryStream> tmp_buf(new MemoryStream(max_compressed_len, -1));
- uint32 dst_len;
-
- dst_len = qlz_compress(data->map(), (char*)tmp_buf->map(), uncompressed_len, qlz_scratch.compress);
- tmp_buf->truncate(dst_len);
- tmp_buf->shrink_to_fit();
-
- return tmp_buf;
-}
-
 //
 //
 //
 static bool DoRewind(void)
 {
+ WaitCompress();
+
  //
  // No save states available.
  //
@@ -146,8 +286,26 @@ static bool DoRewind(void)
  if(smp->data)
  {
   std::unique_ptr<MemoryStream> tmp(new MemoryStream(smp->uncompressed_len, -1));
-  qlz_decompress((char*)smp->data->map(), tmp->map(), qlz_scratch.decompress);
+  const uint32 packed_len = smp->pages.size() ? qlz_size_decompressed((char*)smp->data->map()) : 0;
+  std::unique_ptr<uint8[]> packed(new uint8[std::max<uint32>(1, packed_len)]);
+  const uint8* src = packed.get();
+
+  if(packed_len)
+   qlz_decompress((char*)smp->data->map(), packed.get(), qlz_scratch_decompress);
+
+  memset(tmp->map(), 0, smp->uncompressed_len);
+  for(uint32 pg : smp->pages)
+  {
+   const uint32 offs = pg * SRW_PageSize;
+   const uint32 n = std::min<uint32>(SRW_PageSize, smp->uncompressed_len - offs);
+
+   memcpy(tmp->map() + offs, src, n);
+   src += n;
+  }
+
+  bcs_bytes -= smp->data->size();
   smp->data.reset(nullptr);
+  smp->pages.clear();
   bcs_pos = (bcs_pos + bcs.size() - 1) % bcs.size();
   //
   DoXORFilter(tmp.get(), ss_prev.get());
@@ -172,6 +330,8 @@ static void DoRecord(void)
 
  SRW_AllocHint = std::max<uint32>(SRW_AllocHint, ss_cur->size());
 
+ WaitCompress();
+
  //
  // Compress previous state if it exists.
  //
@@ -179,10 +339,19 @@ static void DoRecord(void)
  {
   DoXORFilter(ss_prev.get(), ss_cur.get());
 
-  //printf("Compress: %zu\n", ss_prev->size());
+  StateMemPacket* smp = &bcs[bcs_pos];
+
+  if(smp->data)
+  {
+   bcs_bytes -= smp->data->size();
+   smp->data.reset(nullptr);
+  }
+
+  Comp.dest = smp;
+  Comp.src = std::move(ss_prev);
+  Comp.pending = true;
+  MThreading::Sem_Post(Comp.start);
 
-  bcs[bcs_pos].data = DoCompress(ss_prev.get());
-  bcs[bcs_pos].uncompressed_len = ss_prev->size();
   bcs_pos = (bcs_pos + 1) % bcs.size();
  }
 
@@ -219,6 +388,67 @@ bool MDFNSRW_Frame(bool rewind) noexcept
  }
 }
 
+uint32 MDFNSRW_Rewind(uint32 frames)
+{
+ uint32 ret = 0;
+
+ if(!Active)
+  return 0;
+
+ try
+ {
+  WaitCompress();
+
+  while(ret < frames && ss_prev)
+  {
+   // DoRewind() loads ss_prev, then makes the next older state ss_prev if there is one; without one, another
+   // DoRewind() would just load the same state again.
+   const bool older = (bool)bcs[(bcs_pos + bcs.size() - 1) % bcs.size()].data;
+
+   DoRewind();
+   ret++;
+
+   if(!older)
+    break;
+  }
+ }
+ catch(...)
+ {
+  MDFNSRW_End();
+  throw;
+ }
+
+ return ret;
+}
+
+void MDFNSRW_GetStatus(MDFNSRW_Status* status) noexcept
+{
+ status->running = Active;
+ status->frames = 0;
+ status->capacity = Active ? bcs.size() + 1 : 0;
+ status->bytes = bcs_bytes;
+ status->bytes_limit = bcs_bytes_limit;
+ status->state_bytes = ss_prev ? ss_prev->size() : 0;
+
+ if(!Active || !ss_prev)
+  return;
+
+ //
+ // ss_prev, then each older packet back to the first dropped or never-filled one.  The packet still being compressed
+ // (Comp.dest) is always the newest, and will be there; the worker owns it, so don't look at it.
+ //
+ status->frames = 1;
+ for(size_t i = 1; i <= bcs.size(); i++)
+ {
+  const StateMemPacket* smp = &bcs[(bcs_pos + bcs.size() - i) % bcs.size()];
+
+  if(!(Comp.pending && smp == Comp.dest) && !smp->data)
+   break;
+
+  status->frames++;
+ }
+}
+
 bool MDFNI_EnableStateRewind(bool enable)
 {
  Enabled = enable;
@@ -28,6 +28,22 @@ bool MDFNSRW_IsRunning(void) noexcept;
 void MDFNSRW_Begin(void) noexcept;
 void MDFNSRW_End(void) noexcept;
 bool MDFNSRW_Frame(bool) noexcept;
+
+// Automation: go back up to "frames" frames at once, as that many rewinding frames would without emulating in between.
+// Returns how many frames were rewound(0 if rewinding isn't running or there's no history).  Throws on error, after
+// stopping rewinding.
+uint32 MDFNSRW_Rewind(uint32 frames);
+
+struct MDFNSRW_Status
+{
+ bool running;
+ uint32 frames;		// How many frames MDFNSRW_Rewind() could go back right now.
+ uint32 capacity;	// srwframes
+ uint64 bytes;		// Compressed history size, and its srwmemory limit(0 = none).
+ uint64 bytes_limit;
+ uint32 state_bytes;	// Uncompressed size of one state.
+};
+void MDFNSRW_GetStatus(MDFNSRW_Status* status) noexcept;
 }
 
 #endif
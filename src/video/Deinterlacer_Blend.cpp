@@ -23,6 +23,14 @@
 #include "Deinterlacer.h"
 #include "Deinterlacer_Blend.h"
 
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#endif
+
+#if defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
+
 namespace Mednafen
 {
 
@@ -106,6 +114,48 @@ INLINE T Deinterlacer_Blend::Blend(T a, T b)
  }
 }
 
+//
+// (a & b) + (((a ^ b) & ~m) >> 1) is the same per-channel floor average as Blend()'s non-RG
+// form, but never carries out of a channel or a pixel, so 32-bit lanes serve both pixel sizes.
+//
+template<typename T, bool rg, unsigned cc0s, unsigned cc1s, unsigned cc2s>
+INLINE void Deinterlacer_Blend::BlendLine(T* d, const T* a, const T* b, int32 w)
+{
+ int32 x = 0;
+
+ if(sizeof(T) >= 2 && !rg)
+ {
+  const uint32 m = (sizeof(T) == 4) ? 0x01010101 : (((1U << cc0s) | (1U << cc1s) | (1U << cc2s)) * 0x10001);
+  const int32 ppv = 16 / sizeof(T);
+
+#if defined(HAVE_SSE2_INTRINSICS)
+  const __m128i vm = _mm_set1_epi32(m);
+
+  for(; MDFN_LIKELY((x + ppv) <= w); x += ppv)
+  {
+   const __m128i va = _mm_loadu_si128((const __m128i*)&a[x]);
+   const __m128i vb = _mm_loadu_si128((const __m128i*)&b[x]);
+
+   _mm_storeu_si128((__m128i*)&d[x], _mm_add_epi32(_mm_and_si128(va, vb), _mm_srli_epi32(_mm_andnot_si128(vm, _mm_xor_si128(va, vb)), 1)));
+  }
+#elif defined(HAVE_NEON_INTRINSICS)
+  const uint32x4_t vm = vdupq_n_u32(m);
+
+  for(; MDFN_LIKELY((x + ppv) <= w); x += ppv)
+  {
+   const uint32x4_t va = vld1q_u32((const uint32*)&a[x]);
+   const uint32x4_t vb = vld1q_u32((const uint32*)&b[x]);
+
+   vst1q_u32((uint32*)&d[x], vaddq_u32(vandq_u32(va, vb), vshrq_n_u32(vbicq_u32(veorq_u32(va, vb), vm), 1)));
+  }
+#endif
+  (void)ppv;
+ }
+
+ for(; MDFN_LIKELY(x < w); x++)
+  d[x] = Blend<T, rg, cc0s, cc1s, cc2s>(a[x], b[x]);
+}
+
 template<typename T, bool rg, unsigned cc0s, unsigned cc1s, unsigned cc2s>
 NO_INLINE void Deinterlacer_Blend::InternalProcess(MDFN_Surface* surface, MDFN_Rect& dr, int32* LineWidths, const bool field)
 {
@@ -143,8 +193,7 @@ NO_INLINE void Deinterlacer_Blend::InternalProcess(MDFN_Surface* surface, MDFN_R
    {
     T* s = field ? prevlp : (T*)&prev_field_delay[0];
 
-    for(int32 x = 0; MDFN_LIKELY(x < w); x++)
-     curlp[x] = Blend<T, rg, cc0s, cc1s, cc2s>(curlp[x], s[x]);
+    BlendLine<T, rg, cc0s, cc1s, cc2s>(curlp, curlp, s, w);
    }
    else
    {
@@ -160,8 +209,7 @@ NO_INLINE void Deinterlacer_Blend::InternalProcess(MDFN_Surface* surface, MDFN_R
 
     assert(w == prev_field_w[i + field]);
 
-    for(int32 x = 0; MDFN_LIKELY(x < w); x++)
-     t[x] = Blend<T, rg, cc0s, cc1s, cc2s>(d[x], s[x]);
+    BlendLine<T, rg, cc0s, cc1s, cc2s>(t, d, s, w);
    }
   }
   else
@@ -42,6 +42,9 @@ class Deinterlacer_Blend : public Deinterlacer
  template<typename T, bool gc, unsigned cc0s, unsigned cc1s, unsigned cc2s>
  T Blend(T a, T b);
 
+ template<typename T, bool gc, unsigned cc0s, unsigned cc1s, unsigned cc2s>
+ void BlendLine(T* d, const T* a, const T* b, int32 w);
+
  template<typename T, bool gc, unsigned cc0s, unsigned cc1s, unsigned cc2s>
  void InternalProcess(MDFN_Surface* surface, MDFN_Rect& dr, int32* LineWidths, const bool field);
 
@@ -23,6 +23,14 @@
 #include <mednafen/video/surface.h>
 #include <mednafen/video/convert.h>
 
+#if defined(HAVE_SSE2_INTRINSICS)
+ #include <emmintrin.h>
+#endif
+
+#if defined(HAVE_NEON_INTRINSICS)
+ #include <arm_neon.h>
+#endif
+
 namespace Mednafen
 {
 //
@@ -159,8 +167,51 @@ static void Convert_xxxx8888(const void* src, void* dest, uint32 count, const MD
  const unsigned sh[4] = { (uint8)drs[(tmp >> 0) & 3], (uint8)drs[(tmp >> 8) & 3], (uint8)drs[(tmp >> 16) & 3], (uint8)drs[(tmp >> 24) & 3] };
  uint32* src_row = (uint32*)src;
  uint32* dest_row = src_equals_dest ? src_row : (uint32*)dest;
+ unsigned x = 0;
 
- for(unsigned x = 0; MDFN_LIKELY(x < count); x++)
+ //
+ // Four pixels at a time; the shift counts are only known at run time, so use the
+ // shift-by-register forms rather than a byte shuffle.
+ //
+#if defined(HAVE_SSE2_INTRINSICS)
+ {
+  const __m128i lo8 = _mm_set1_epi32(0xFF);
+  const __m128i sc[4] = { _mm_cvtsi32_si128(sh[0]), _mm_cvtsi32_si128(sh[1]), _mm_cvtsi32_si128(sh[2]), _mm_cvtsi32_si128(sh[3]) };
+
+  for(; MDFN_LIKELY((x + 4) <= count); x += 4)
+  {
+   const __m128i c = _mm_loadu_si128((const __m128i*)&src_row[x]);
+   __m128i d;
+
+   d =                 _mm_sll_epi32(_mm_and_si128(c, lo8), sc[0]);
+   d = _mm_or_si128(d, _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(c,  8), lo8), sc[1]));
+   d = _mm_or_si128(d, _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(c, 16), lo8), sc[2]));
+   d = _mm_or_si128(d, _mm_sll_epi32(_mm_srli_epi32(c, 24), sc[3]));
+
+   _mm_storeu_si128((__m128i*)&dest_row[x], d);
+  }
+ }
+#elif defined(HAVE_NEON_INTRINSICS)
+ {
+  const uint32x4_t lo8 = vdupq_n_u32(0xFF);
+  const int32x4_t sc[4] = { vdupq_n_s32(sh[0]), vdupq_n_s32(sh[1]), vdupq_n_s32(sh[2]), vdupq_n_s32(sh[3]) };
+
+  for(; MDFN_LIKELY((x + 4) <= count); x += 4)
+  {
+   const uint32x4_t c = vld1q_u32(&src_row[x]);
+   uint32x4_t d;
+
+   d =            vshlq_u32(vandq_u32(c, lo8), sc[0]);
+   d = vorrq_u32(d, vshlq_u32(vandq_u32(vshrq_n_u32(c,  8), lo8), sc[1]));
+   d = vorrq_u32(d, vshlq_u32(vandq_u32(vshrq_n_u32(c, 16), lo8), sc[2]));
+   d = vorrq_u32(d, vshlq_u32(vshrq_n_u32(c, 24), sc[3]));
+
+   vst1q_u32(&dest_row[x], d);
+  }
+ }
+#endif
+
+ for(; MDFN_LIKELY(x < count); x++)
  {
   uint32 c = src_row[x];
 
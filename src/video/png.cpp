@@ -18,11 +18,203 @@
 #include "video-common.h"
 
 #include <zlib.h>
+#include <mednafen/MThreading.h>
 #include "png.h"
 
 namespace Mednafen
 {
 
+enum : size_t { PNG_MinStripeBytes = 128 * 1024 };
+enum : size_t { PNG_WindowSize = 32768 };
+
+static INLINE uint8 Paeth(const int a, const int b, const int c)
+{
+ const int p = a + b - c;
+ const int pa = abs(p - a);
+ const int pb = abs(p - b);
+ const int pc = abs(p - c);
+
+ if(pa <= pb && pa <= pc)
+  return a;
+ else if(pb <= pc)
+  return b;
+
+ return c;
+}
+
+//
+// Picks each row's filter by the usual minimum-sum-of-absolute-differences heuristic (treating filtered
+// bytes as signed), then writes the row filtered that way.  "raw" and "dst" hold h rows of row_bytes
+// bytes each, the first byte of a row being its filter type.
+//
+static void FilterRows(uint8* dst, const uint8* raw, const unsigned bpp, const size_t row_bytes, const int h)
+{
+ const size_t n = row_bytes - 1;
+
+ for(int y = 0; y < h; y++)
+ {
+  const uint8* cur = raw + y * row_bytes + 1;
+  const uint8* prev = y ? (cur - row_bytes) : nullptr;
+  uint8* out = dst + y * row_bytes;
+  uint32 sums[5] = { 0, 0, 0, 0, 0 };
+  unsigned best = 0;
+
+  for(size_t x = 0; MDFN_LIKELY(x < n); x++)
+  {
+   const int a = (x >= bpp) ? cur[x - bpp] : 0;
+   const int b = prev ? prev[x] : 0;
+   const int c = (prev && x >= bpp) ? prev[x - bpp] : 0;
+   const int v = cur[x];
+
+   sums[0] += abs((int8)v);
+   sums[1] += abs((int8)(v - a));
+   sums[2] += abs((int8)(v - b));
+   sums[3] += abs((int8)(v - ((a + b) >> 1)));
+   sums[4] += abs((int8)(v - Paeth(a, b, c)));
+  }
+
+  for(unsigned f = 1; f < 5; f++)
+  {
+   if(sums[f] < sums[best])
+    best = f;
+  }
+
+  out[0] = best;
+  out++;
+
+  for(size_t x = 0; MDFN_LIKELY(x < n); x++)
+  {
+   const int a = (x >= bpp) ? cur[x - bpp] : 0;
+   const int b = prev ? prev[x] : 0;
+   const int c = (prev && x >= bpp) ? prev[x - bpp] : 0;
+   const int v = cur[x];
+
+   switch(best)
+   {
+    case 0: out[x] = v; break;
+    case 1: out[x] = v - a; break;
+    case 2: out[x] = v - b; break;
+    case 3: out[x] = v - ((a + b) >> 1); break;
+    case 4: out[x] = v - Paeth(a, b, c); break;
+   }
+  }
+ }
+}
+
+//
+// One stripe of the IDAT zlib stream, deflated independently as raw deflate primed with the preceding
+// 32KiB of image data(as pigz does); all but the last end on a sync flush so the stripes concatenate
+// into a single valid deflate stream.
+//
+struct DeflateStripe
+{
+ const uint8* data;
+ size_t len;
+ size_t dict_len;
+ int zlevel;
+ bool last;
+ bool ok;
+ std::vector<uint8> out;
+};
+
+static int DeflateStripe_Entry(void* arg)
+{
+ DeflateStripe* ds = (DeflateStripe*)arg;
+ z_stream zs;
+
+ memset(&zs, 0, sizeof(zs));
+ ds->ok = false;
+
+ if(deflateInit2(&zs, ds->zlevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  return 0;
+
+ if(ds->dict_len && deflateSetDictionary(&zs, ds->data - ds->dict_len, ds->dict_len) != Z_OK)
+ {
+  deflateEnd(&zs);
+  return 0;
+ }
+
+ ds->out.resize(deflateBound(&zs, ds->len) + 64);
+
+ zs.next_in = (Bytef*)ds->data;
+ zs.avail_in = ds->len;
+ zs.next_out = &ds->out[0];
+ zs.avail_out = ds->out.size();
+
+ const int zr = deflate(&zs, ds->last ? Z_FINISH : Z_SYNC_FLUSH);
+
+ if((ds->last ? (zr == Z_STREAM_END) : (zr == Z_OK)) && !zs.avail_in)
+ {
+  ds->out.resize(zs.total_out);
+  ds->ok = true;
+ }
+
+ deflateEnd(&zs);
+
+ return 0;
+}
+
+static void CompressIDAT(std::vector<uint8>* compmem, const uint8* data, const size_t len, const int zlevel, const unsigned threads)
+{
+ const unsigned num_stripes = std::max<size_t>(1, std::min<size_t>(threads, len / PNG_MinStripeBytes));
+ std::vector<DeflateStripe> stripes(num_stripes);
+ std::vector<MThreading::Thread*> workers;
+ size_t pos = 0;
+
+ for(unsigned i = 0; i < num_stripes; i++)
+ {
+  DeflateStripe* ds = &stripes[i];
+  const size_t end = (i + 1 == num_stripes) ? len : (len / num_stripes) * (i + 1);
+
+  ds->data = data + pos;
+  ds->len = end - pos;
+  ds->dict_len = std::min<size_t>(pos, PNG_WindowSize);
+  ds->zlevel = zlevel;
+  ds->last = (i + 1 == num_stripes);
+
+  pos = end;
+ }
+
+ for(unsigned i = 1; i < num_stripes; i++)
+  workers.push_back(MThreading::Thread_Create(DeflateStripe_Entry, &stripes[i], "MDFN PNG Deflate"));
+
+ DeflateStripe_Entry(&stripes[0]);
+
+ for(auto* w : workers)
+  MThreading::Thread_Wait(w, nullptr);
+ //
+ //
+ const int eff_level = (zlevel < 0) ? 6 : zlevel;
+ unsigned flg = ((eff_level < 2) ? 0 : ((eff_level < 6) ? 1 : ((eff_level == 6) ? 2 : 3))) << 6;
+ size_t total = 2 + 4;
+
+ flg += 31 - (((0x78 << 8) | flg) % 31);
+
+ for(auto const& ds : stripes)
+ {
+  if(!ds.ok)
+   throw MDFN_Error(0, _("zlib error compressing PNG image data."));
+
+  total += ds.out.size();
+ }
+
+ compmem->resize(total);
+
+ uint8* d = &(*compmem)[0];
+
+ d[0] = 0x78;
+ d[1] = flg;
+ d += 2;
+
+ for(auto const& ds : stripes)
+ {
+  memcpy(d, &ds.out[0], ds.out.size());
+  d += ds.out.size();
+ }
+
+ MDFN_en32msb(d, adler32(adler32(0, nullptr, 0), data, len));
+}
+
 void PNGWrite::WriteChunk(FileStream &pngfile, uint32 size, const char *type, const uint8 *data)
 {
  uint32 crc;
@@ -50,9 +242,9 @@ PNGWrite::~PNGWrite()
 
 }
 
-PNGWrite::PNGWrite(const std::string& path, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths) : ownfile(path, FileStream::MODE_WRITE_SAFE)
+PNGWrite::PNGWrite(const std::string& path, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths, const int zlevel, const unsigned threads) : ownfile(path, FileStream::MODE_WRITE_SAFE)
 {
- WriteIt(ownfile, src, rect, LineWidths);
+ WriteIt(ownfile, src, rect, LineWidths, zlevel, threads);
  ownfile.close();
 }
 
@@ -116,9 +308,8 @@ INLINE void PNGWrite::EncodeImage(const MDFN_Surface *src, const MDFN_PixelForma
  }
 }
 
-void PNGWrite::WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_Rect &rect_in, const int32 *LineWidths)
+void PNGWrite::WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_Rect &rect_in, const int32 *LineWidths, const int zlevel, const unsigned threads)
 {
- uLongf compmemsize;
  int png_width;
  const MDFN_PixelFormat format = src->format;
  const MDFN_Rect rect = rect_in;
@@ -144,10 +335,6 @@ void PNGWrite::WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_
  if(!png_width)
   throw(MDFN_Error(0, "Refusing to save a zero-width PNG."));
 
- compmemsize = (uLongf)( (rect.h * (png_width + 1) * 3 * 1.001 + 1) + 12 );
-
- compmem.resize(compmemsize);
-
  {
   static const uint8 header[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
   pngfile.write(header, 8);
@@ -168,7 +355,7 @@ void PNGWrite::WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_
    chunko[9]=2;				// Color type; RGB triplet
 
   chunko[10]=0;				// compression: deflate
-  chunko[11]=0;				// Basic adaptive filter set(though none are used).
+  chunko[11]=0;				// Basic adaptive filter set.
   chunko[12]=0;				// No interlace.
 
   WriteChunk(pngfile, 13, "IHDR", chunko);
@@ -227,12 +414,21 @@ void PNGWrite::WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_
 
   //printf("%u\n", MDFND_GetTime() - st);
 
-  if(compress(&compmem[0], &compmemsize, &tmp_buffer[0], rect.h * (png_width * ((format.opp == 1) ? 1 : 3) + 1)) != Z_OK)
+  const unsigned bpp = (format.opp == 1) ? 1 : 3;
+  const size_t row_bytes = png_width * bpp + 1;
+  const uint8* idat_data = &tmp_buffer[0];
+
+  // Palette indices don't predict well, so those rows stay unfiltered.
+  if(bpp > 1)
   {
-   throw(MDFN_Error(0, "zlib error"));	// TODO: verbosify
+   filt_buffer.resize(tmp_buffer.size());
+   FilterRows(&filt_buffer[0], &tmp_buffer[0], bpp, row_bytes, rect.h);
+   idat_data = &filt_buffer[0];
   }
 
-  WriteChunk(pngfile, compmemsize, "IDAT", &compmem[0]);
+  CompressIDAT(&compmem, idat_data, row_bytes * rect.h, zlevel, threads);
+
+  WriteChunk(pngfile, compmem.size(), "IDAT", &compmem[0]);
  }
  //
  //
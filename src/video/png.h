@@ -11,7 +11,9 @@ class PNGWrite
 {
  public:
 
- PNGWrite(const std::string& path, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths);
+ // zlevel: zlib compression level(0-9), or -1 for zlib's default.
+ // threads: maximum number of row stripes deflated in parallel; images under 128KiB per stripe use fewer.
+ PNGWrite(const std::string& path, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths, const int zlevel = -1, const unsigned threads = 1);
  ~PNGWrite();
 
 
@@ -19,12 +21,13 @@ class PNGWrite
 
  private:
 
- void WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths);
+ void WriteIt(FileStream &pngfile, const MDFN_Surface *src, const MDFN_Rect &rect, const int32 *LineWidths, const int zlevel, const unsigned threads);
  void EncodeImage(const MDFN_Surface *src, const MDFN_PixelFormat &format, const MDFN_Rect &rect, const int32 *LineWidths, const int png_width);
 
  FileStream ownfile;
  std::vector<uint8> compmem;
  std::vector<uint8> tmp_buffer;
+ std::vector<uint8> filt_buffer;
 };
 
 }
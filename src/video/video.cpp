@@ -49,7 +49,7 @@ void MDFNI_SaveSnapshot(const MDFN_Surface *src, const MDFN_Rect *rect, const in
  {
   const unsigned u = GetIncSnapIndex();
 
-  PNGWrite(MDFN_MakeFName(MDFNMKF_SNAP, u, "png"), src, *rect, LineWidths);
+  PNGWrite(MDFN_MakeFName(MDFNMKF_SNAP, u, "png"), src, *rect, LineWidths, MDFN_GetSettingI("filesys.snap_comp_level"), MDFN_GetSettingUI("filesys.snap_comp_threads"));
 
   MDFN_Notify(MDFN_NOTICE_STATUS, _("Screen snapshot %u saved."), u);
  }
@@ -0,0 +1,644 @@
+/* tracedb.cpp -- Queries over binary unified traces
+ *
+ * Answers the usual questions about a unified_trace_bin file ("MDFNUTB1", see
+ * src/ss/bin_trace.h) without converting it to text first. Plain traces are
+ * memory-mapped, zlib-block traces are inflated one block at a time, and the
+ * <path>.idx frame index is used to start at the first frame or cycle a query
+ * can match and to stop after the last one.
+ *
+ *   tracedb calls TRACE <target> [range]            every call to target: cycle, frame, cpu, caller
+ *   tracedb callers TRACE <target> [--top N] [range]  caller PCs of target, most frequent first
+ *   tracedb insns TRACE <lo>:<hi> [--count] [range]   instructions with PC in [lo, hi); --count
+ *                                                     gives executions per PC instead
+ *   tracedb first_write TRACE <addr> [--size N] [range]
+ *                                                     first store or SCU DMA covering [addr, addr+N)
+ *
+ *   range: --frames A:B (inclusive), --after CYCLE, --before CYCLE, --cpu master|slave
+ *
+ * Addresses are hex. Stores are decoded from each INSN record's opcode and the
+ * registers it carries (their values before the instruction runs), so
+ * first_write needs the trace to have been recorded with insn_trace_unified on;
+ * without it only SCU DMA destinations are seen. Writes by interrupt and
+ * exception entry, the SH-2 DMACs, the SCU DSP and the 68K are not in the trace.
+ *
+ * Part of mednafen-saturn-debug fork.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+enum : uint8_t
+{
+ REC_CALL = 1,
+ REC_INSN = 2,
+ REC_CDB = 3,
+ REC_DMA = 4,
+ REC_NOTE = 5,
+ REC_FRAME = 6,
+
+ TAG_SLAVE = 0x80
+};
+
+enum : uint32_t { FLAG_ZBLOCKS = 0x1 };
+enum : unsigned { HEADER_SIZE = 12, Num_Regs = 21, REG_R0 = 0, REG_R15 = 15, REG_GBR = 18 };
+
+struct Error : public std::runtime_error
+{
+ explicit Error(const std::string& what) : std::runtime_error(what) { }
+};
+
+static uint32_t le32(const uint8_t* p)
+{
+ return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t le64(const uint8_t* p)
+{
+ return le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+// Read-only view of a whole file: mmap()ed where available.
+class MappedFile
+{
+ public:
+
+ explicit MappedFile(const std::string& path) : data(nullptr), size(0), mapped(false)
+ {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+
+  if (fd < 0)
+   throw Error(path + ": " + strerror(errno));
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+   void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+   if (p != MAP_FAILED) {
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data = (const uint8_t*)p;
+    size = st.st_size;
+    mapped = true;
+   }
+  }
+  close(fd);
+  if (mapped)
+   return;
+#endif
+  FILE* f = fopen(path.c_str(), "rb");
+  uint8_t buf[1 << 16];
+  size_t n;
+
+  if (!f)
+   throw Error(path + ": " + strerror(errno));
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+   copy.insert(copy.end(), buf, buf + n);
+  fclose(f);
+  data = copy.data();
+  size = copy.size();
+ }
+
+ ~MappedFile()
+ {
+#ifndef _WIN32
+  if (mapped)
+   munmap((void*)data, size);
+#endif
+ }
+
+ MappedFile(const MappedFile&) = delete;
+ MappedFile& operator=(const MappedFile&) = delete;
+
+ const uint8_t* data;
+ size_t size;
+
+ private:
+
+ bool mapped;
+ std::vector<uint8_t> copy;
+};
+
+struct IndexEntry
+{
+ uint64_t frame, base, offset;
+};
+
+static std::vector<IndexEntry> load_index(const std::string& path)
+{
+ std::vector<IndexEntry> ret;
+ FILE* f = fopen((path + ".idx").c_str(), "rb");
+ uint8_t ent[24];
+
+ if (!f)
+  return ret;
+ if (fread(ent, 1, 8, f) != 8 || memcmp(ent, "MDFNUTI1", 8)) {
+  fclose(f);
+  throw Error(path + ".idx: bad magic");
+ }
+ while (fread(ent, 1, sizeof(ent), f) == sizeof(ent))
+  ret.push_back({ le64(ent), le64(ent + 8), le64(ent + 16) });
+ fclose(f);
+ return ret;
+}
+
+// Logical (uncompressed) record stream from some offset on.
+class Stream
+{
+ public:
+
+ Stream(const MappedFile& mf_arg, bool zblocks_arg, uint64_t offset) : mf(mf_arg), zblocks(zblocks_arg), file_pos(HEADER_SIZE)
+ {
+  if (!zblocks) {
+   p = mf.data + std::min<uint64_t>(mf.size, HEADER_SIZE + offset);
+   end = mf.data + mf.size;
+   return;
+  }
+
+  // Skip whole blocks up to the one holding the offset.
+  uint64_t raw_pos = 0;
+
+  p = end = nullptr;
+  while (file_pos + 8 <= mf.size) {
+   const uint32_t raw_len = le32(mf.data + file_pos);
+   const uint32_t comp_len = le32(mf.data + file_pos + 4);
+
+   if (raw_pos + raw_len > offset) {
+    Refill();
+    p += offset - raw_pos;
+    return;
+   }
+   file_pos += 8 + (comp_len ? comp_len : raw_len);
+   raw_pos += raw_len;
+  }
+ }
+
+ // Pointer to the next n bytes, or nullptr at the end of the stream.
+ const uint8_t* Get(size_t n)
+ {
+  if ((size_t)(end - p) < n && (!zblocks || !Refill(n)))
+   return nullptr;
+
+  const uint8_t* ret = p;
+  p += n;
+  return ret;
+ }
+
+ bool Byte(uint8_t* v)
+ {
+  const uint8_t* b = Get(1);
+  if (b)
+   *v = *b;
+  return b != nullptr;
+ }
+
+ bool Varint(uint32_t* v)
+ {
+  uint8_t b;
+  unsigned shift = 0;
+
+  *v = 0;
+  do {
+   if (!Byte(&b) || shift > 28)
+    return false;
+   *v |= (uint32_t)(b & 0x7F) << shift;
+   shift += 7;
+  } while (b & 0x80);
+  return true;
+ }
+
+ private:
+
+ // Appends the next block(s) after what's left unread until n bytes are available.
+ bool Refill(size_t n = 1)
+ {
+  std::vector<uint8_t> next(p, end);
+
+  while (next.size() < n) {
+   if (file_pos + 8 > mf.size)
+    return false;
+
+   const uint32_t raw_len = le32(mf.data + file_pos);
+   const uint32_t comp_len = le32(mf.data + file_pos + 4);
+   const uint8_t* src = mf.data + file_pos + 8;
+   const size_t have = next.size();
+
+   if (file_pos + 8 + (comp_len ? comp_len : raw_len) > mf.size)
+    return false;
+   next.resize(have + raw_len);
+   if (!comp_len)
+    memcpy(&next[have], src, raw_len);
+   else {
+    uLongf dest_len = raw_len;
+
+    if (uncompress(&next[have], &dest_len, src, comp_len) != Z_OK || dest_len != raw_len)
+     throw Error("corrupt zlib block at file offset " + std::to_string(file_pos));
+   }
+   file_pos += 8 + (comp_len ? comp_len : raw_len);
+  }
+
+  buf.swap(next);
+  p = buf.data();
+  end = p + buf.size();
+  return true;
+ }
+
+ const MappedFile& mf;
+ const bool zblocks;
+ uint64_t file_pos;
+ std::vector<uint8_t> buf;
+ const uint8_t* p;
+ const uint8_t* end;
+};
+
+struct Record
+{
+ uint8_t type;
+ unsigned cpu;
+ uint64_t cycle;	// absolute master cycle: frame base + timestamp
+ uint64_t frame;
+ uint32_t a, b;		// CALL: caller, target; INSN: PC, opcode; DMA: dst, length
+ const uint32_t* regs;	// INSN: registers before it runs
+};
+
+struct Range
+{
+ uint64_t frame_lo = 0, frame_hi = UINT64_MAX;
+ uint64_t cycle_lo = 0, cycle_hi = UINT64_MAX;
+ int cpu = -1;
+};
+
+// Calls fn(const Record&) for each CALL/INSN/DMA record in range, until it returns false.
+template<typename T>
+static void scan(const std::string& path, const Range& range, T fn)
+{
+ const MappedFile mf(path);
+
+ if (mf.size < HEADER_SIZE || memcmp(mf.data, "MDFNUTB1", 8))
+  throw Error(path + ": not a binary unified trace");
+
+ const bool zblocks = le32(mf.data + 8) & FLAG_ZBLOCKS;
+ const std::vector<IndexEntry> index = load_index(path);
+ uint64_t offset = 0;
+
+ // Last index entry at or before the start of the range.
+ for (const IndexEntry& e : index) {
+  if (e.frame > range.frame_lo || e.base > range.cycle_lo)
+   break;
+  offset = e.offset;
+ }
+
+ Stream s(mf, zblocks, offset);
+ uint32_t regs[2][Num_Regs] = { { 0 } };
+ uint32_t ts = 0;
+ uint64_t base = 0, frame = 0;
+ uint8_t tag;
+
+ while (s.Byte(&tag)) {
+  const uint8_t kind = tag & 0x0F;
+  const unsigned cpu = (tag & TAG_SLAVE) ? 1 : 0;
+  const uint8_t* p;
+  uint32_t d;
+  Record r;
+
+  if (kind == REC_FRAME) {
+   if (!(p = s.Get(16)))
+    break;
+   base = le64(p);
+   frame = le64(p + 8);
+   ts = 0;
+   if (frame > range.frame_hi || base > range.cycle_hi)
+    break;
+   continue;
+  }
+
+  if (!s.Varint(&d))
+   break;
+  ts += (d >> 1) ^ -(d & 1);
+
+  r.type = kind;
+  r.cpu = cpu;
+  r.cycle = base + ts;
+  r.frame = frame;
+  r.regs = nullptr;
+
+  if (kind == REC_CALL) {
+   if (!(p = s.Get(8)))
+    break;
+   r.a = le32(p);
+   r.b = le32(p + 4);
+  } else if (kind == REC_INSN) {
+   uint32_t mask;
+
+   if (!(p = s.Get(6)))
+    break;
+   r.a = le32(p);
+   r.b = p[4] | (p[5] << 8);
+   if (!s.Varint(&mask))
+    break;
+   for (unsigned i = 0; i < Num_Regs; i++) {
+    if (mask & (1U << i)) {
+     if (!(p = s.Get(4)))
+      return;
+     regs[cpu][i] = le32(p);
+    }
+   }
+   r.regs = regs[cpu];
+  } else if (kind == REC_CDB || kind == REC_NOTE) {
+   uint32_t len;
+
+   if (!s.Varint(&len) || !s.Get(len))
+    break;
+   continue;
+  } else if (kind == REC_DMA) {
+   if (!(p = s.Get(17)))
+    break;
+   r.a = le32(p + 5);
+   r.b = le32(p + 9);
+  } else
+   throw Error(path + ": bad record tag " + std::to_string(tag));
+
+  if (r.cycle > range.cycle_hi)
+   break;
+  if (frame < range.frame_lo || r.cycle < range.cycle_lo || (range.cpu >= 0 && (int)cpu != range.cpu))
+   continue;
+  if (!fn(r))
+   break;
+ }
+}
+
+// Address and size an SH-2 instruction stores to, from its registers before it runs; false if it doesn't store.
+static bool store_target(uint16_t op, const uint32_t* r, uint32_t* addr, uint32_t* size)
+{
+ const unsigned n = (op >> 8) & 0xF;
+ const unsigned m = (op >> 4) & 0xF;
+ const unsigned sz = 1U << (op & 0x3);
+
+ switch (op >> 12) {
+  case 0x0:	// MOV.x Rm,@(R0,Rn)
+   if ((op & 0xF) >= 0x4 && (op & 0xF) <= 0x6) {
+    *addr = r[REG_R0] + r[n];
+    *size = 1U << ((op & 0xF) - 4);
+    return true;
+   }
+   return false;
+
+  case 0x1:	// MOV.L Rm,@(disp,Rn)
+   *addr = r[n] + ((op & 0xF) << 2);
+   *size = 4;
+   return true;
+
+  case 0x2:
+   if ((op & 0xF) <= 0x2) {	// MOV.x Rm,@Rn
+    *addr = r[n];
+    *size = sz;
+    return true;
+   }
+   if ((op & 0xF) >= 0x4 && (op & 0xF) <= 0x6) {	// MOV.x Rm,@-Rn
+    *size = 1U << ((op & 0xF) - 4);
+    *addr = r[n] - *size;
+    return true;
+   }
+   return false;
+
+  case 0x4:
+   if ((op & 0xCF) == 0x02 || (op & 0xCF) == 0x03) {	// STS.L MACH/MACL/PR,@-Rn; STC.L SR/GBR/VBR,@-Rn
+    *addr = r[n] - 4;
+    *size = 4;
+    return true;
+   }
+   if ((op & 0xFF) == 0x1B) {	// TAS.B @Rn
+    *addr = r[n];
+    *size = 1;
+    return true;
+   }
+   return false;
+
+  case 0x8:
+   if (n == 0x0 || n == 0x1) {	// MOV.B/W R0,@(disp,Rm)
+    *size = 1U << n;
+    *addr = r[m] + (op & 0xF) * *size;
+    return true;
+   }
+   return false;
+
+  case 0xC:
+   if (n <= 0x2) {	// MOV.B/W/L R0,@(disp,GBR)
+    *size = 1U << n;
+    *addr = r[REG_GBR] + (op & 0xFF) * *size;
+    return true;
+   }
+   if (n == 0x3) {	// TRAPA: SR and PC pushed
+    *addr = r[REG_R15] - 8;
+    *size = 8;
+    return true;
+   }
+   if (n >= 0xD) {	// AND.B/XOR.B/OR.B #imm,@(R0,GBR)
+    *addr = r[REG_R0] + r[REG_GBR];
+    *size = 1;
+    return true;
+   }
+   return false;
+ }
+
+ return false;
+}
+
+static uint32_t parse_hex(const std::string& s)
+{
+ char* end;
+ const unsigned long long v = strtoull(s.c_str(), &end, 16);
+
+ if (s.empty() || *end || v > 0xFFFFFFFFULL)
+  throw Error("bad address \"" + s + "\"");
+ return (uint32_t)v;
+}
+
+static void parse_pair(const std::string& s, uint64_t* lo, uint64_t* hi, bool hex)
+{
+ const size_t colon = s.find(':');
+ char* end;
+
+ if (colon == std::string::npos)
+  throw Error("bad range \"" + s + "\" (LO:HI)");
+ *lo = strtoull(s.substr(0, colon).c_str(), &end, hex ? 16 : 10);
+ *hi = strtoull(s.c_str() + colon + 1, &end, hex ? 16 : 10);
+ if (*end || *hi < *lo)
+  throw Error("bad range \"" + s + "\" (LO:HI)");
+}
+
+static const char* cpu_name(unsigned cpu)
+{
+ return cpu ? "slave" : "master";
+}
+
+static int usage(void)
+{
+ fprintf(stderr,
+  "usage: tracedb calls TRACE <target> [range]\n"
+  "       tracedb callers TRACE <target> [--top N] [range]\n"
+  "       tracedb insns TRACE <lo>:<hi> [--count] [range]\n"
+  "       tracedb first_write TRACE <addr> [--size N] [range]\n"
+  "range: --frames A:B  --after CYCLE  --before CYCLE  --cpu master|slave\n"
+  "Addresses in hex; TRACE is a unified_trace_bin file (its .idx is used when present).\n");
+ return 2;
+}
+
+static int run(int argc, char* argv[])
+{
+ if (argc < 4)
+  return usage();
+
+ const std::string cmd = argv[1];
+ const std::string path = argv[2];
+ const std::string what = argv[3];
+ Range range;
+ unsigned top = 20;
+ uint32_t size = 1;
+ bool count = false;
+
+ for (int i = 4; i < argc; i++) {
+  const std::string a = argv[i];
+  const bool has_val = (i + 1) < argc;
+
+  if (a == "--frames" && has_val)
+   parse_pair(argv[++i], &range.frame_lo, &range.frame_hi, false);
+  else if (a == "--after" && has_val)
+   range.cycle_lo = strtoull(argv[++i], nullptr, 10);
+  else if (a == "--before" && has_val)
+   range.cycle_hi = strtoull(argv[++i], nullptr, 10);
+  else if (a == "--cpu" && has_val) {
+   const std::string c = argv[++i];
+   if (c != "master" && c != "slave")
+    return usage();
+   range.cpu = (c == "slave");
+  } else if (a == "--top" && has_val)
+   top = std::max(1, atoi(argv[++i]));
+  else if (a == "--size" && has_val)
+   size = std::max(1, atoi(argv[++i]));
+  else if (a == "--count")
+   count = true;
+  else
+   return usage();
+ }
+
+ if (cmd == "calls") {
+  const uint32_t target = parse_hex(what);
+  uint64_t hits = 0;
+
+  scan(path, range, [&](const Record& r) {
+   if (r.type == REC_CALL && r.b == target) {
+    printf("cycle=%llu frame=%llu %s caller=0x%08X\n", (unsigned long long)r.cycle, (unsigned long long)r.frame, cpu_name(r.cpu), r.a);
+    hits++;
+   }
+   return true;
+  });
+  printf("# %llu calls to 0x%08X\n", (unsigned long long)hits, target);
+  return 0;
+ }
+
+ if (cmd == "callers") {
+  const uint32_t target = parse_hex(what);
+  std::unordered_map<uint32_t, uint64_t> callers;
+  uint64_t hits = 0;
+
+  scan(path, range, [&](const Record& r) {
+   if (r.type == REC_CALL && r.b == target) {
+    callers[r.a]++;
+    hits++;
+   }
+   return true;
+  });
+
+  std::vector<std::pair<uint32_t, uint64_t>> sorted(callers.begin(), callers.end());
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint32_t, uint64_t>& x, const std::pair<uint32_t, uint64_t>& y) {
+   return x.second != y.second ? x.second > y.second : x.first < y.first;
+  });
+  for (size_t i = 0; i < sorted.size() && i < top; i++)
+   printf("0x%08X %llu\n", sorted[i].first, (unsigned long long)sorted[i].second);
+  printf("# %llu calls to 0x%08X from %zu callers\n", (unsigned long long)hits, target, sorted.size());
+  return 0;
+ }
+
+ if (cmd == "insns") {
+  uint64_t lo, hi;
+  std::map<uint32_t, uint64_t> per_pc;
+  uint64_t hits = 0;
+
+  parse_pair(what, &lo, &hi, true);
+  scan(path, range, [&](const Record& r) {
+   if (r.type == REC_INSN && r.a >= lo && r.a < hi) {
+    if (count)
+     per_pc[r.a]++;
+    else
+     printf("cycle=%llu frame=%llu %s pc=0x%08X op=0x%04X\n", (unsigned long long)r.cycle, (unsigned long long)r.frame, cpu_name(r.cpu), r.a, r.b);
+    hits++;
+   }
+   return true;
+  });
+  for (const auto& e : per_pc)
+   printf("0x%08X %llu\n", e.first, (unsigned long long)e.second);
+  printf("# %llu instructions\n", (unsigned long long)hits);
+  return 0;
+ }
+
+ if (cmd == "first_write") {
+  const uint64_t lo = parse_hex(what);
+  const uint64_t hi = lo + size;
+  bool found = false;
+
+  scan(path, range, [&](const Record& r) {
+   uint32_t addr, len;
+
+   if (r.type == REC_INSN && store_target(r.b, r.regs, &addr, &len)) {
+    if (addr < hi && addr + (uint64_t)len > lo) {
+     printf("cycle=%llu frame=%llu %s pc=0x%08X op=0x%04X addr=0x%08X size=%u\n", (unsigned long long)r.cycle, (unsigned long long)r.frame,
+            cpu_name(r.cpu), r.a, r.b, addr, len);
+     found = true;
+    }
+   } else if (r.type == REC_DMA && r.a < hi && r.a + (uint64_t)r.b > lo) {
+    printf("cycle=%llu frame=%llu scu_dma dst=0x%08X len=0x%X\n", (unsigned long long)r.cycle, (unsigned long long)r.frame, r.a, r.b);
+    found = true;
+   }
+   return !found;
+  });
+  if (!found)
+   printf("# no write to 0x%08X in range\n", (uint32_t)lo);
+  return 0;
+ }
+
+ return usage();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+ try {
+  return run(argc, argv);
+ } catch (std::exception& e) {
+  fprintf(stderr, "tracedb: %s\n", e.what());
+  return 1;
+ }
+}
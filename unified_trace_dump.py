@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Convert a binary unified trace (unified_trace_bin) back to the text format.
+
+Output matches what `unified_trace` / `insn_trace_unified` write, except that
+per-instruction lines carry `.word 0xNNNN` where the text trace has the
+disassembled mnemonic. DMA records (binary trace only) print as
+`<ts> DMA L<level> src=... dst=... len=... pc=...`.
+
+The <path>.idx sidecar is used to start at a frame or cycle without
+scanning the file from the beginning. Record layout: src/ss/bin_trace.h.
+
+Usage:
+    unified_trace_dump.py trace.utb                   # whole trace
+    unified_trace_dump.py trace.utb --frame 1200      # from frame 1200
+    unified_trace_dump.py trace.utb --cycle 123456789 --frames
+"""
+
+import argparse
+import bisect
+import os
+import struct
+import sys
+import zlib
+
+REC_CALL, REC_INSN, REC_CDB, REC_DMA, REC_NOTE, REC_FRAME = 1, 2, 3, 4, 5, 6
+TAG_SLAVE = 0x80
+FLAG_ZBLOCKS = 0x1
+HEADER_SIZE = 12
+REG_NAMES = ["R%d" % i for i in range(16)] + ["PR", "SR", "GBR", "MACH", "MACL"]
+
+
+def load_index(path):
+    """Return a list of (frame, cycle_base, offset), or [] if there's no index."""
+    try:
+        with open(path + ".idx", "rb") as f:
+            data = f.read()
+    except OSError:
+        return []
+    if data[:8] != b"MDFNUTI1":
+        raise ValueError("%s.idx: bad magic" % path)
+    n = (len(data) - 8) // 24
+    return [struct.unpack_from("<QQQ", data, 8 + i * 24) for i in range(n)]
+
+
+class Stream:
+    """Uncompressed record stream, optionally starting at a logical offset."""
+
+    def __init__(self, f, zblocks, offset):
+        self.f = f
+        self.zblocks = zblocks
+        self.buf = b""
+        self.pos = 0
+        if not zblocks:
+            f.seek(HEADER_SIZE + offset)
+            return
+        # Skip whole blocks until the one containing the offset.
+        f.seek(HEADER_SIZE)
+        raw_pos = 0
+        while True:
+            hdr = f.read(8)
+            if len(hdr) < 8:
+                return
+            raw_len, comp_len = struct.unpack("<II", hdr)
+            if raw_pos + raw_len > offset:
+                self.buf = self._inflate(raw_len, comp_len)
+                self.pos = offset - raw_pos
+                return
+            f.seek(comp_len if comp_len else raw_len, os.SEEK_CUR)
+            raw_pos += raw_len
+
+    def _inflate(self, raw_len, comp_len):
+        if not comp_len:
+            return self.f.read(raw_len)
+        return zlib.decompress(self.f.read(comp_len))
+
+    def _refill(self):
+        rest = self.buf[self.pos:]
+        if self.zblocks:
+            hdr = self.f.read(8)
+            if len(hdr) < 8:
+                return False
+            more = self._inflate(*struct.unpack("<II", hdr))
+        else:
+            more = self.f.read(1 << 20)
+        if not more:
+            return False
+        self.buf = rest + more
+        self.pos = 0
+        return True
+
+    def read(self, n):
+        while len(self.buf) - self.pos < n:
+            if not self._refill():
+                raise EOFError
+        ret = self.buf[self.pos:self.pos + n]
+        self.pos += n
+        return ret
+
+    def byte(self):
+        return self.read(1)[0]
+
+    def varint(self):
+        v = shift = 0
+        while True:
+            b = self.byte()
+            v |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return v
+            shift += 7
+
+
+def dump(path, out, start_frame=None, start_cycle=None, frame_markers=False):
+    with open(path, "rb") as f:
+        hdr = f.read(HEADER_SIZE)
+        if hdr[:8] != b"MDFNUTB1":
+            raise ValueError("%s: not a binary unified trace" % path)
+        (flags,) = struct.unpack_from("<I", hdr, 8)
+
+        offset = 0
+        index = load_index(path)
+        if index and start_frame is not None:
+            i = bisect.bisect_right([e[0] for e in index], start_frame) - 1
+            offset = index[max(i, 0)][2]
+        elif index and start_cycle is not None:
+            i = bisect.bisect_right([e[1] for e in index], start_cycle) - 1
+            offset = index[max(i, 0)][2]
+
+        out.write("# Unified trace: <sh2_cycle> <source> <details>\n"
+                  "# M/S = SH-2 master/slave call, CMD/DRV/IRQ/BUF = CD Block\n")
+
+        s = Stream(f, flags & FLAG_ZBLOCKS, offset)
+        ts = 0
+        base = 0
+        frame = 0
+        regs = [[0] * len(REG_NAMES), [0] * len(REG_NAMES)]
+        try:
+            while True:
+                tag = s.byte()
+                kind = tag & 0x0F
+                cpu = 1 if tag & TAG_SLAVE else 0
+
+                if kind == REC_FRAME:
+                    base, frame = struct.unpack("<QQ", s.read(16))
+                    ts = 0
+                    if frame_markers and (start_frame is None or frame >= start_frame):
+                        out.write("# FRAME %d cycle=%d\n" % (frame, base))
+                    continue
+
+                d = s.varint()
+                ts = (ts + ((d >> 1) ^ -(d & 1))) & 0xFFFFFFFF
+
+                if kind == REC_CALL:
+                    frm, to = struct.unpack("<II", s.read(8))
+                    line = "%u %c %08X %08X" % (ts, "MS"[cpu], frm, to)
+                elif kind == REC_INSN:
+                    pc, op = struct.unpack("<IH", s.read(6))
+                    mask = s.varint()
+                    r = regs[cpu]
+                    for i in range(len(REG_NAMES)):
+                        if mask & (1 << i):
+                            (r[i],) = struct.unpack("<I", s.read(4))
+                    line = "%u %c %08X %-28s %s" % (
+                        ts, "ms"[cpu], pc, ".word 0x%04X" % op,
+                        " ".join("%s=%08X" % (n, v) for n, v in zip(REG_NAMES, r)))
+                elif kind in (REC_CDB, REC_NOTE):
+                    text = s.read(s.varint()).decode("latin-1")
+                    line = text if kind == REC_NOTE else "%u %s" % (ts, text)
+                elif kind == REC_DMA:
+                    lvl, src, dst, n, pc = struct.unpack("<BIIII", s.read(17))
+                    line = "%u DMA L%d src=0x%08X dst=0x%08X len=0x%X pc=0x%08X" % (
+                        ts, lvl, src, dst, n, pc)
+                else:
+                    raise ValueError("bad record tag 0x%02X" % tag)
+
+                if start_frame is not None and frame < start_frame:
+                    continue
+                if start_cycle is not None and base + ts < start_cycle:
+                    continue
+                out.write(line + "\n")
+        except EOFError:
+            pass
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("trace", help="binary unified trace file")
+    ap.add_argument("--frame", type=int, help="start at this frame")
+    ap.add_argument("--cycle", type=int, help="start at this absolute SH-2 cycle")
+    ap.add_argument("--frames", action="store_true",
+                    help="emit '# FRAME <n> cycle=<base>' marker lines")
+    ap.add_argument("-o", "--output", help="write text here instead of stdout")
+    args = ap.parse_args()
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    try:
+        dump(args.trace, out, args.frame, args.cycle, args.frames)
+    except BrokenPipeError:
+        pass
+    finally:
+        if args.output:
+            out.close()
+
+
+if __name__ == "__main__":
+    main()
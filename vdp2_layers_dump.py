@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Summarize or export a per-layer VDP2 capture (vdp2_layer_capture <path>).
+
+File layout (comment above LayerCap in src/ss/vdp2_render.cpp): "MDFNV2L1", le32
+plane count, le32 lines, le32 plane width, le32 flags (bit 0: interlaced, bit 1:
+field), then per line le16 width (0 = not drawn), le16 VDP2 line, le32 flags
+(bit 0: RBG0 and RBG1 both on), then each plane as le32 compressed length + zlib
+data of lines * width uint32s: RGB in bits 0-23 (red lowest), priority in bits
+24-26 (0 = transparent; always 0 in the line color and back planes).
+
+Usage:
+    vdp2_layers_dump.py layers.bin                     # per plane: opaque pixels, priorities used
+    vdp2_layers_dump.py layers.bin --ppm out           # out_<plane>.ppm, transparent pixels in --key
+    vdp2_layers_dump.py layers.bin --ppm out --prio    # out_<plane>_prio.pgm as well (priority * 36)
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+PLANES = ["spr", "rbg0", "nbg0", "nbg1", "nbg2", "nbg3", "lc", "back"]
+
+
+def load(path):
+    """Return (flags, lines, planes): lines is [(out_line, width, vdp2_line, line_flags)]
+    for drawn lines, planes one list of uint32 rows per plane, indexed like lines."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"MDFNV2L1":
+        raise ValueError("%s: not a VDP2 layer capture" % path)
+    count, nlines, width, flags = struct.unpack_from("<IIII", data, 8)
+    pos = 24
+    lines = []
+    for i in range(nlines):
+        w, vline, lflags = struct.unpack_from("<HHI", data, pos)
+        pos += 8
+        if w:
+            lines.append((i, w, vline, lflags))
+    planes = []
+    for p in range(count):
+        (zlen,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        raw = zlib.decompress(data[pos:pos + zlen])
+        pos += zlen
+        pix = struct.unpack("<%dI" % (nlines * width), raw)
+        planes.append([pix[i * width:i * width + w] for i, w, _, _ in lines])
+    return flags, lines, planes
+
+
+def write_ppm(path, rows, width, key):
+    with open(path, "wb") as f:
+        f.write(b"P6\n%d %d\n255\n" % (width, len(rows)))
+        for row in rows:
+            out = bytearray()
+            for x in range(width):
+                v = row[x] if x < len(row) else 0
+                if not (v >> 24) & 0x7 and key is not None:
+                    v = key
+                out += bytes((v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF))
+            f.write(out)
+
+
+def write_pgm(path, rows, width):
+    with open(path, "wb") as f:
+        f.write(b"P5\n%d %d\n255\n" % (width, len(rows)))
+        for row in rows:
+            f.write(bytes(((row[x] >> 24) & 0x7) * 36 if x < len(row) else 0 for x in range(width)))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--ppm", metavar="PREFIX", help="write PREFIX_<plane>.ppm per plane")
+    ap.add_argument("--prio", action="store_true", help="with --ppm, also PREFIX_<plane>_prio.pgm")
+    ap.add_argument("--key", default="FF00FF", help="RGB hex for transparent pixels (default FF00FF)")
+    args = ap.parse_args()
+
+    flags, lines, planes = load(args.file)
+    out = sys.stdout
+    width = max((w for _, w, _, _ in lines), default=0)
+    try:
+        out.write("# %d lines drawn, width %d%s\n" % (len(lines), width,
+                                                    " interlaced field=%d" % (flags >> 1 & 1) if flags & 1 else ""))
+        if any(lf & 1 for _, _, _, lf in lines):
+            out.write("# RBG0 and RBG1 both on: nbg0 holds RBG1\n")
+        for p, rows in enumerate(planes):
+            name = PLANES[p] if p < len(PLANES) else "plane%d" % p
+            if args.ppm:
+                key = int(args.key, 16)
+                key = ((key >> 16) & 0xFF) | (key & 0xFF00) | ((key & 0xFF) << 16)
+                # Line color and back have no priority; export them as they are.
+                write_ppm("%s_%s.ppm" % (args.ppm, name), rows, width, key if p < 6 else None)
+                if args.prio and p < 6:
+                    write_pgm("%s_%s_prio.pgm" % (args.ppm, name), rows, width)
+            if p >= 6:
+                colors = len(set(v & 0xFFFFFF for row in rows for v in row))
+                out.write("%-5s colors=%d\n" % (name, colors))
+                continue
+            opaque = 0
+            prios = {}
+            for row in rows:
+                for v in row:
+                    pr = (v >> 24) & 0x7
+                    if pr:
+                        opaque += 1
+                        prios[pr] = prios.get(pr, 0) + 1
+            total = sum(len(row) for row in rows)
+            out.write("%-5s opaque=%d/%d prio=%s\n" % (name, opaque, total,
+                                                     ",".join("%d:%d" % e for e in sorted(prios.items())) or "-"))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
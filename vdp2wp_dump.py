@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Print a binary or aggregate VDP2 watchpoint file (vdp2_watchpoint bin|agg).
+
+File layout (Automation_SetVDP2Watchpoint in src/ss/ss.cpp): "MDFNV2W1"
+(binary) or "MDFNV2A1" (aggregate), le32 lo, le32 hi, le32 line size, le32
+flags (bit 0: the rest is in TraceRing deflate blocks of le32 raw_len, le32
+comp_len, data). Binary records are 20 bytes: le64 cycle, le32 pc, le32 addr,
+le16 value, u8 size, u8 source. Aggregate frames are le64 frame, le32 n, then
+n lines of le32 addr, le32 writes, u8 k, u8 overflow, le16 0, k x le32 pc.
+
+Usage:
+    vdp2wp_dump.py vdp2.bin                  # one line per write / per frame
+    vdp2wp_dump.py vdp2.agg --summary        # lines over the whole file, busiest first
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+SOURCES = ["CPU0", "CPU1", "DMA", "DSP", "SH2DMA0", "SH2DMA1"]
+
+
+def payload(path):
+    """Return (magic, lo, hi, line_size, body bytes)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    magic = data[:8]
+    if magic not in (b"MDFNV2W1", b"MDFNV2A1"):
+        raise ValueError("%s: not a VDP2 watchpoint file" % path)
+    lo, hi, line, flags = struct.unpack_from("<IIII", data, 8)
+    body = data[24:]
+    if flags & 1:
+        chunks = []
+        pos = 0
+        while pos + 8 <= len(body):
+            raw_len, comp_len = struct.unpack_from("<II", body, pos)
+            pos += 8
+            if comp_len:
+                chunks.append(zlib.decompress(body[pos:pos + comp_len]))
+                pos += comp_len
+            else:
+                chunks.append(body[pos:pos + raw_len])
+                pos += raw_len
+        body = b"".join(chunks)
+    return magic, lo, hi, line, body
+
+
+def records(body):
+    for pos in range(0, len(body) - 19, 20):
+        yield struct.unpack_from("<QIIHBB", body, pos)
+
+
+def frames(body):
+    pos = 0
+    while pos + 12 <= len(body):
+        frame, n = struct.unpack_from("<QI", body, pos)
+        pos += 12
+        lines = []
+        for _ in range(n):
+            addr, writes, k, overflow = struct.unpack_from("<IIBB", body, pos)
+            pos += 12
+            pcs = list(struct.unpack_from("<%dI" % k, body, pos))
+            pos += 4 * k
+            lines.append((addr, writes, pcs, bool(overflow)))
+        yield frame, lines
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("--summary", action="store_true",
+                    help="aggregate: total writes per line over all frames, busiest first")
+    args = ap.parse_args()
+
+    magic, lo, hi, line, body = payload(args.file)
+    out = sys.stdout
+    try:
+        if magic == b"MDFNV2W1":
+            out.write("# VDP2 writes 0x%08X-0x%08X\n" % (lo, hi))
+            for cycle, pc, addr, val, size, src in records(body):
+                name = SOURCES[src] if src < len(SOURCES) else str(src)
+                out.write("cycle=%d pc=0x%08X addr=0x%08X val=0x%04X size=%d source=%s\n"
+                          % (cycle, pc, addr, val, size, name))
+        elif args.summary:
+            total = {}
+            for _, lines in frames(body):
+                for addr, writes, pcs, overflow in lines:
+                    t = total.setdefault(addr, [0, 0, set(), False])
+                    t[0] += writes
+                    t[1] += 1
+                    t[2].update(pcs)
+                    t[3] |= overflow
+            out.write("# VDP2 lines 0x%08X-0x%08X, %d bytes each\n" % (lo, hi, line))
+            for addr, (writes, nframes, pcs, overflow) in sorted(total.items(), key=lambda e: -e[1][0]):
+                out.write("0x%08X writes=%d frames=%d pcs=%s%s\n"
+                          % (addr, writes, nframes, ",".join("0x%08X" % p for p in sorted(pcs)),
+                             " +more" if overflow else ""))
+        else:
+            out.write("# VDP2 lines 0x%08X-0x%08X, %d bytes each\n" % (lo, hi, line))
+            for frame, lines in frames(body):
+                out.write("frame %d lines=%d\n" % (frame, len(lines)))
+                for addr, writes, pcs, overflow in lines:
+                    out.write("  0x%08X writes=%d pcs=%s%s\n"
+                              % (addr, writes, ",".join("0x%08X" % p for p in pcs),
+                                 " +more" if overflow else ""))
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == "__main__":
+    main()
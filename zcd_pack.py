@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Pack a CD image data file (.bin/.img/.iso) into the hunk-compressed ZCD format, or unpack one.
+
+File layout (CDAccess_ZCDStream in src/cdrom/CDAccess_ZCD.h), all little-endian:
+"MDFNZCD1", le32 hunk size, le32 hunk count, le64 uncompressed size, le64 file
+offset of each hunk plus one for the end, then the hunks. A hunk is a zstd frame,
+or stored as-is when compressing doesn't make it smaller.
+
+The emulator detects ZCD files by their header, not their name, so point the cue
+sheet's FILE line (or name the CCD's .img) at the packed file.
+
+Uses Python's compression.zstd (3.14+), or the zstandard module, or the zstd
+command-line tool, in that order.
+
+Usage:
+    zcd_pack.py game.bin game.bin.zcd             # pack, default 16-sector hunks
+    zcd_pack.py game.bin game.bin.zcd --level 19 --hunk-sectors 32
+    zcd_pack.py --unpack game.bin.zcd game.bin
+"""
+
+import argparse
+import struct
+import subprocess
+import sys
+
+MAGIC = b"MDFNZCD1"
+SECTOR = 2352
+
+
+def compressor(level):
+    try:
+        from compression import zstd
+        return lambda data: zstd.compress(data, level=level)
+    except ImportError:
+        pass
+    try:
+        import zstandard
+        cctx = zstandard.ZstdCompressor(level=level)
+        return cctx.compress
+    except ImportError:
+        pass
+    return lambda data: subprocess.run(["zstd", "-q", "-c", "-%d" % level, "--ultra"],
+                                       input=data, stdout=subprocess.PIPE, check=True).stdout
+
+
+def decompressor():
+    try:
+        from compression import zstd
+        return zstd.decompress
+    except ImportError:
+        pass
+    try:
+        import zstandard
+        dctx = zstandard.ZstdDecompressor()
+        return dctx.decompress
+    except ImportError:
+        pass
+    return lambda data: subprocess.run(["zstd", "-q", "-d", "-c"],
+                                       input=data, stdout=subprocess.PIPE, check=True).stdout
+
+
+def pack(src, dst, hunk_size, level):
+    compress = compressor(level)
+    with open(src, "rb") as f:
+        data = f.read()
+    n = (len(data) + hunk_size - 1) // hunk_size
+    hunks = []
+    for i in range(n):
+        raw = data[i * hunk_size:(i + 1) * hunk_size]
+        c = compress(raw)
+        hunks.append(c if len(c) < len(raw) else raw)
+    offs = [24 + (n + 1) * 8]
+    for h in hunks:
+        offs.append(offs[-1] + len(h))
+    with open(dst, "wb") as f:
+        f.write(MAGIC + struct.pack("<IIQ", hunk_size, n, len(data)))
+        f.write(struct.pack("<%dQ" % (n + 1), *offs))
+        for h in hunks:
+            f.write(h)
+    sys.stderr.write("%s: %d -> %d bytes (%.1f%%), %d hunks\n"
+                     % (dst, len(data), offs[-1], 100.0 * offs[-1] / max(1, len(data)), n))
+
+
+def unpack(src, dst):
+    decompress = decompressor()
+    with open(src, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        raise ValueError("%s: not a ZCD file" % src)
+    hunk_size, n, total = struct.unpack_from("<IIQ", data, 8)
+    offs = struct.unpack_from("<%dQ" % (n + 1), data, 24)
+    with open(dst, "wb") as f:
+        for i in range(n):
+            ulen = min(hunk_size, total - i * hunk_size)
+            h = data[offs[i]:offs[i + 1]]
+            f.write(h if len(h) == ulen else decompress(h))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("input")
+    ap.add_argument("output")
+    ap.add_argument("--unpack", action="store_true", help="expand a ZCD file back to raw")
+    ap.add_argument("--hunk-sectors", type=int, default=16, help="2352-byte sectors per hunk (default 16)")
+    ap.add_argument("--level", type=int, default=12, help="zstd level (default 12)")
+    args = ap.parse_args()
+
+    if not 1 <= args.hunk_sectors * SECTOR <= 1 << 20:
+        ap.error("hunk size must be 1 to 445 sectors")
+
+    if args.unpack:
+        unpack(args.input, args.output)
+    else:
+        pack(args.input, args.output, args.hunk_sectors * SECTOR, args.level)
+
+
+if __name__ == "__main__":
+    main()